@@ -31,6 +31,7 @@
 static int verbose = 0;
 static int warning = 0;
 static int debug = 0;
+static const char *compile_file = NULL;
 
 static void interpret_filename(const char *file)
 {
@@ -61,7 +62,16 @@ static void interpret_filename(const char *file)
 	cfg.debug = debug;
 	cfg.in = in;
 	cfg.out = cfg.eout = cfg.vout = cfg.wout = cfg.dout = out;
-	err = alsa_lisp(&cfg, NULL);
+	if (compile_file) {
+		snd_output_t *cout;
+		if ((err = snd_output_stdio_open(&cout, compile_file, "w")) < 0) {
+			fprintf(stderr, "unable to open filename '%s' (%s)\n", compile_file, snd_strerror(err));
+		} else {
+			err = alsa_lisp_compile(&cfg, cout);
+			snd_output_close(cout);
+		}
+	} else
+		err = alsa_lisp(&cfg, NULL);
 	if (err < 0)
 		fprintf(stderr, "alsa lisp returned error %i (%s)\n", err, strerror(err));
 	else if (verbose)
@@ -73,6 +83,7 @@ static void interpret_filename(const char *file)
 static void usage(void)
 {
 	fprintf(stderr, "usage: alsalisp [-vdw] [file...]\n");
+	fprintf(stderr, "       alsalisp -c output [file]\n");
 	exit(1);
 }
 
@@ -80,7 +91,7 @@ int main(int argc, char **argv)
 {
 	int c;
 
-	while ((c = getopt(argc, argv, "vdw")) != -1) {
+	while ((c = getopt(argc, argv, "vdwc:")) != -1) {
 		switch (c) {
 		case 'v':
 			verbose = 1;
@@ -91,6 +102,9 @@ int main(int argc, char **argv)
 		case 'w':
 			warning = 1;
 			break;
+		case 'c':
+			compile_file = optarg;
+			break;
 		case '?':
 		default:
 			usage();
@@ -99,6 +113,8 @@ int main(int argc, char **argv)
 	}
 	argc -= optind;
 	argv += optind;
+	if (compile_file && argc > 1)
+		usage();
 
 	if (argc < 1)
 		interpret_filename(NULL);
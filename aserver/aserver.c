@@ -21,6 +21,8 @@
 #include <sys/shm.h>
 #include <sys/socket.h>
 #include <sys/poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/un.h>
 #include <sys/uio.h>
 #include <stdio.h>
@@ -29,11 +31,15 @@
 #include <stddef.h>
 #include <getopt.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #include <limits.h>
 #include <signal.h>
 
 #include "aserver.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 char *command;
 
@@ -107,8 +113,7 @@ static int make_inet_socket(int port)
 	return sock;
 }
 
-struct pollfd *pollfds;
-unsigned int pollfds_count = 0;
+int epoll_fd = -1;
 typedef struct waiter waiter_t;
 typedef int (*waiter_handler_t)(waiter_t *waiter, unsigned short events);
 struct waiter {
@@ -118,34 +123,35 @@ struct waiter {
 };
 waiter_t *waiters;
 
-static void add_waiter(int fd, unsigned short events, waiter_handler_t handler,
+static int add_waiter(int fd, unsigned short events, waiter_handler_t handler,
 		void *data)
 {
 	waiter_t *w = &waiters[fd];
-	struct pollfd *pfd = &pollfds[pollfds_count];
+	struct epoll_event ev;
 	assert(!w->handler);
-	pfd->fd = fd;
-	pfd->events = events;
-	pfd->revents = 0;
 	w->fd = fd;
 	w->private_data = data;
 	w->handler = handler;
-	pollfds_count++;
+	ev.events = events;
+	ev.data.fd = fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		int err = -errno;
+		/* EPERM: files are always ready, poll() did not tell */
+		if (err != -EPERM)
+			SYSERROR("epoll_ctl failed");
+		w->handler = 0;
+		return err;
+	}
+	return 0;
 }
 
 static void del_waiter(int fd)
 {
 	waiter_t *w = &waiters[fd];
-	unsigned int k;
 	assert(w->handler);
 	w->handler = 0;
-	for (k = 0; k < pollfds_count; ++k) {
-		if (pollfds[k].fd == fd)
-			break;
-	}
-	assert(k < pollfds_count);
-	pollfds_count--;
-	memmove(&pollfds[k], &pollfds[k + 1], pollfds_count - k);
+	/* fails for a descriptor closed already, which left the set then */
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
 }
 
 typedef struct client client_t;
@@ -158,6 +164,10 @@ typedef struct {
 
 struct client {
 	struct list_head list;
+	struct list_head job;		/* queued for a worker */
+	int busy;			/* a worker runs a command */
+	int hangup;			/* the poll socket hung up meanwhile */
+	int job_err;
 	int poll_fd;
 	int ctrl_fd;
 	int local;
@@ -178,6 +188,9 @@ struct client {
 		struct {
 			snd_ctl_t *handle;
 			int fd;
+			snd_ctl_t *monitor;	/* events for the published values */
+			int monitor_fd;
+			unsigned int nocache[CTL_SHM_VALUES]; /* numids never published */
 		} ctl;
 #if 0
 		struct {
@@ -200,9 +213,14 @@ struct client {
 	union {
 		struct {
 			int ctrl_id;
-			void *ctrl;
+			void *ctrl;	/* private memory with tcp */
 		} shm;
 	} transport;
+	struct {
+		void *buf;		/* frames on the wire */
+		size_t buf_size;
+		snd_pcm_uframes_t hw;	/* capture: frames sent up to here */
+	} tcp;
 };
 
 LIST_HEAD(clients);
@@ -239,6 +257,21 @@ static int pcm_handler(waiter_t *waiter, unsigned short events)
 }
 #endif
 
+/*
+ * With a hw PCM whose pointers are the mmapped status and control pages
+ * of the kernel, the client reads the state and both pointers from the
+ * pages itself and commits by moving appl_ptr there; nothing the server
+ * would do for these requests is left out then.
+ */
+static void pcm_shm_update_direct(snd_pcm_t *pcm, volatile snd_pcm_shm_ctrl_t *ctrl)
+{
+	ctrl->direct = snd_pcm_type(pcm) == SND_PCM_TYPE_HW &&
+		ctrl->hw.use_mmap && ctrl->appl.use_mmap &&
+		ctrl->hw.offset == SNDRV_PCM_MMAP_OFFSET_STATUS +
+			(off_t)offsetof(struct snd_pcm_mmap_status, hw_ptr) &&
+		ctrl->appl.offset == SNDRV_PCM_MMAP_OFFSET_CONTROL;
+}
+
 static void pcm_shm_hw_ptr_changed(snd_pcm_t *pcm, snd_pcm_t *src ATTRIBUTE_UNUSED)
 {
 	client_t *client = pcm->hw.private_data;
@@ -249,6 +282,7 @@ static void pcm_shm_hw_ptr_changed(snd_pcm_t *pcm, snd_pcm_t *src ATTRIBUTE_UNUS
 	if (pcm->hw.fd >= 0) {
 		ctrl->hw.use_mmap = 1;
 		ctrl->hw.offset = pcm->hw.offset;
+		pcm_shm_update_direct(pcm, ctrl);
 		return;
 	}
 	ctrl->hw.use_mmap = 0;
@@ -256,6 +290,7 @@ static void pcm_shm_hw_ptr_changed(snd_pcm_t *pcm, snd_pcm_t *src ATTRIBUTE_UNUS
 	for (loop = pcm->hw.master; loop; loop = loop->hw.master)
 		loop->hw.ptr = &ctrl->hw.ptr;
 	pcm->hw.ptr = &ctrl->hw.ptr;
+	ctrl->direct = 0;
 }
 
 static void pcm_shm_appl_ptr_changed(snd_pcm_t *pcm, snd_pcm_t *src ATTRIBUTE_UNUSED)
@@ -268,6 +303,7 @@ static void pcm_shm_appl_ptr_changed(snd_pcm_t *pcm, snd_pcm_t *src ATTRIBUTE_UN
 	if (pcm->appl.fd >= 0) {
 		ctrl->appl.use_mmap = 1;
 		ctrl->appl.offset = pcm->appl.offset;
+		pcm_shm_update_direct(pcm, ctrl);
 		return;
 	}
 	ctrl->appl.use_mmap = 0;
@@ -275,6 +311,7 @@ static void pcm_shm_appl_ptr_changed(snd_pcm_t *pcm, snd_pcm_t *src ATTRIBUTE_UN
 	for (loop = pcm->appl.master; loop; loop = loop->appl.master)
 		loop->appl.ptr = &ctrl->appl.ptr;
 	pcm->appl.ptr = &ctrl->appl.ptr;
+	ctrl->direct = 0;
 }
 
 static int pcm_shm_open(client_t *client, int *cookie)
@@ -385,36 +422,13 @@ static void async_handler(snd_async_handler_t *handler)
 	kill(client->async_pid, client->async_sig);
 }
 
-static int pcm_shm_cmd(client_t *client)
+/* the commands served the same way by both transports */
+static void pcm_cmd(client_t *client, int cmd)
 {
-	volatile snd_pcm_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
-	char buf[1];
-	int err;
-	int cmd;
-	snd_pcm_t *pcm;
-	err = read(client->ctrl_fd, buf, 1);
-	if (err != 1)
-		return -EBADFD;
-	cmd = ctrl->cmd;
-	ctrl->cmd = 0;
-	pcm = client->device.pcm.handle;
+	snd_pcm_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
+	snd_pcm_t *pcm = client->device.pcm.handle;
+
 	switch (cmd) {
-	case SND_PCM_IOCTL_ASYNC:
-		ctrl->result = snd_pcm_async(pcm, ctrl->u.async.sig, ctrl->u.async.pid);
-		if (ctrl->result < 0)
-			break;
-		if (ctrl->u.async.sig >= 0) {
-			assert(client->async_sig < 0);
-			ctrl->result = snd_async_add_pcm_handler(&client->async_handler, pcm, async_handler, client);
-			if (ctrl->result < 0)
-				break;
-		} else {
-			assert(client->async_sig >= 0);
-			snd_async_del_handler(client->async_handler);
-		}
-		client->async_sig = ctrl->u.async.sig;
-		client->async_pid = ctrl->u.async.pid;
-		break;
 	case SNDRV_PCM_IOCTL_INFO:
 		ctrl->result = snd_pcm_info(pcm, (snd_pcm_info_t *) &ctrl->u.info);
 		break;
@@ -463,30 +477,66 @@ static int pcm_shm_cmd(client_t *client)
 	case SNDRV_PCM_IOCTL_PAUSE:
 		ctrl->result = snd_pcm_pause(pcm, ctrl->u.pause.enable);
 		break;
-	case SNDRV_PCM_IOCTL_CHANNEL_INFO:
-		ctrl->result = snd_pcm_channel_info(pcm, (snd_pcm_channel_info_t *) &ctrl->u.channel_info);
-		if (ctrl->result >= 0 &&
-		    ctrl->u.channel_info.type == SND_PCM_AREA_MMAP)
-			return shm_ack_fd(client, ctrl->u.channel_info.u.mmap.fd);
-		break;
 	case SNDRV_PCM_IOCTL_REWIND:
 		ctrl->result = snd_pcm_rewind(pcm, ctrl->u.rewind.frames);
 		break;
 	case SND_PCM_IOCTL_FORWARD:
 		ctrl->result = snd_pcm_forward(pcm, ctrl->u.forward.frames);
 		break;
-	case SNDRV_PCM_IOCTL_LINK:
-	{
-		/* FIXME */
-		ctrl->result = -ENOSYS;
-		break;
-	}
 	case SNDRV_PCM_IOCTL_UNLINK:
 		ctrl->result = snd_pcm_unlink(pcm);
 		break;
 	case SNDRV_PCM_IOCTL_RESUME:
 		ctrl->result = snd_pcm_resume(pcm);
 		break;
+	default:
+		ERROR("Bogus cmd: %x", cmd);
+		ctrl->result = -ENOSYS;
+	}
+}
+
+static int pcm_shm_cmd(client_t *client)
+{
+	volatile snd_pcm_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
+	char buf[1];
+	int err;
+	int cmd;
+	snd_pcm_t *pcm;
+	err = read(client->ctrl_fd, buf, 1);
+	if (err != 1)
+		return -EBADFD;
+	cmd = ctrl->cmd;
+	ctrl->cmd = 0;
+	pcm = client->device.pcm.handle;
+	switch (cmd) {
+	case SND_PCM_IOCTL_ASYNC:
+		ctrl->result = snd_pcm_async(pcm, ctrl->u.async.sig, ctrl->u.async.pid);
+		if (ctrl->result < 0)
+			break;
+		if (ctrl->u.async.sig >= 0) {
+			assert(client->async_sig < 0);
+			ctrl->result = snd_async_add_pcm_handler(&client->async_handler, pcm, async_handler, client);
+			if (ctrl->result < 0)
+				break;
+		} else {
+			assert(client->async_sig >= 0);
+			snd_async_del_handler(client->async_handler);
+		}
+		client->async_sig = ctrl->u.async.sig;
+		client->async_pid = ctrl->u.async.pid;
+		break;
+	case SNDRV_PCM_IOCTL_CHANNEL_INFO:
+		ctrl->result = snd_pcm_channel_info(pcm, (snd_pcm_channel_info_t *) &ctrl->u.channel_info);
+		if (ctrl->result >= 0 &&
+		    ctrl->u.channel_info.type == SND_PCM_AREA_MMAP)
+			return shm_ack_fd(client, ctrl->u.channel_info.u.mmap.fd);
+		break;
+	case SNDRV_PCM_IOCTL_LINK:
+	{
+		/* FIXME */
+		ctrl->result = -ENOSYS;
+		break;
+	}
 	case SND_PCM_IOCTL_MMAP:
 	{
 		ctrl->result = snd_pcm_mmap(pcm);
@@ -512,8 +562,7 @@ static int pcm_shm_cmd(client_t *client)
 	case SND_PCM_IOCTL_APPL_PTR_FD:
 		return shm_rbptr_fd(client, &pcm->appl);
 	default:
-		ERROR("Bogus cmd: %x", ctrl->cmd);
-		ctrl->result = -ENOSYS;
+		pcm_cmd(client, cmd);
 	}
 	return shm_ack(client);
 }
@@ -524,6 +573,303 @@ transport_ops_t pcm_shm_ops = {
 	.close	= pcm_shm_close,
 };
 
+/*
+ * TCP transport: each request brings the whole control block, the answer
+ * takes it back with the current pointers.  Playback commits carry their
+ * frames and are not answered; an answer for capture carries the frames
+ * captured since the previous one.  A byte on the poll socket tells the
+ * client that its PCM turned ready while a request left it waiting.
+ */
+static int tcp_send(int sock, struct iovec *iov, int count)
+{
+	struct msghdr msg;
+	ssize_t n;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = count;
+	while (msg.msg_iovlen) {
+		n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		while (msg.msg_iovlen && (size_t)n >= msg.msg_iov->iov_len) {
+			n -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+		if (msg.msg_iovlen) {
+			msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + n;
+			msg.msg_iov->iov_len -= n;
+		}
+	}
+	return 0;
+}
+
+static int tcp_recv(int sock, void *buf, size_t size)
+{
+	ssize_t n;
+
+	while (size) {
+		n = recv(sock, buf, size, MSG_WAITALL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -EBADFD;
+		buf = (char *)buf + n;
+		size -= n;
+	}
+	return 0;
+}
+
+static void *tcp_buf(client_t *client, size_t size)
+{
+	void *buf;
+
+	if (size > client->tcp.buf_size) {
+		buf = realloc(client->tcp.buf, size);
+		if (!buf)
+			return NULL;
+		client->tcp.buf = buf;
+		client->tcp.buf_size = size;
+	}
+	return client->tcp.buf;
+}
+
+static void tcp_areas(snd_pcm_t *pcm, snd_pcm_channel_area_t *areas, void *buf)
+{
+	unsigned int c;
+
+	for (c = 0; c < pcm->channels; c++) {
+		areas[c].addr = buf;
+		areas[c].first = c * pcm->sample_bits;
+		areas[c].step = pcm->frame_bits;
+	}
+}
+
+static int pcm_tcp_open(client_t *client, int *cookie)
+{
+	snd_pcm_t *pcm;
+	int err, one = 1;
+
+	err = snd_pcm_open(&pcm, client->name, client->stream, SND_PCM_NONBLOCK);
+	if (err < 0)
+		return err;
+	client->transport.shm.ctrl = calloc(1, PCM_SHM_SIZE);
+	if (!client->transport.shm.ctrl) {
+		snd_pcm_close(pcm);
+		return -ENOMEM;
+	}
+	client->device.pcm.handle = pcm;
+	client->device.pcm.fd = -1;
+	client->tcp.hw = 0;
+	if (setsockopt(client->ctrl_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) < 0)
+		SYSERROR("setsockopt TCP_NODELAY failed");
+	*cookie = 0;
+	return 0;
+}
+
+static int pcm_tcp_close(client_t *client)
+{
+	int err;
+
+	if (client->polling) {
+		del_waiter(client->device.pcm.fd);
+		client->polling = 0;
+	}
+	err = snd_pcm_close(client->device.pcm.handle);
+	if (err < 0)
+		ERROR("snd_pcm_close");
+	free(client->transport.shm.ctrl);
+	client->transport.shm.ctrl = NULL;
+	free(client->tcp.buf);
+	client->tcp.buf = NULL;
+	client->tcp.buf_size = 0;
+	client->open = 0;
+	return 0;
+}
+
+static int pcm_tcp_poll_handler(waiter_t *waiter, unsigned short events)
+{
+	client_t *client = waiter->private_data;
+	struct pollfd pfd;
+	unsigned short revents;
+	char buf[1] = { 0 };
+
+	pfd.fd = waiter->fd;
+	pfd.events = 0;
+	pfd.revents = events;
+	if (snd_pcm_poll_descriptors_revents(client->device.pcm.handle,
+					     &pfd, 1, &revents) >= 0 && !revents)
+		return 0;
+	del_waiter(waiter->fd);
+	client->polling = 0;
+	if (send(client->poll_fd, buf, 1, MSG_NOSIGNAL) != 1) {
+		SYSERROR("send failed");
+		return -errno;
+	}
+	return 0;
+}
+
+/* wake the client once its PCM is ready */
+static void pcm_tcp_arm(client_t *client)
+{
+	snd_pcm_t *pcm = client->device.pcm.handle;
+	struct pollfd *pfds;
+	char buf[1] = { 0 };
+	if (client->polling)
+		return;
+	pfds = alloca(sizeof(*pfds));
+	/* without a single descriptor to wait for, the client checks again */
+	if (snd_pcm_poll_descriptors_count(pcm) != 1 ||
+	    snd_pcm_poll_descriptors(pcm, pfds, 1) != 1 ||
+	    add_waiter(pfds->fd, pfds->events, pcm_tcp_poll_handler, client) < 0) {
+		if (send(client->poll_fd, buf, 1, MSG_NOSIGNAL) != 1)
+			SYSERROR("send failed");
+		return;
+	}
+	client->device.pcm.fd = pfds->fd;
+	client->polling = 1;
+}
+
+/* the capture frames the client has not got yet, up to end */
+static int pcm_tcp_capture(client_t *client, snd_pcm_uframes_t end,
+			   struct iovec *iov)
+{
+	snd_pcm_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
+	snd_pcm_t *pcm = client->device.pcm.handle;
+	snd_pcm_channel_area_t *areas = alloca(pcm->channels * sizeof(*areas));
+	snd_pcm_sframes_t frames, avail;
+	snd_pcm_uframes_t offset, done = 0, n;
+
+	frames = end - client->tcp.hw;
+	if (frames < 0)
+		frames += pcm->boundary;
+	avail = end - *pcm->appl.ptr;
+	if (avail < 0)
+		avail += pcm->boundary;
+	if (frames > avail)
+		frames = avail;
+	if ((snd_pcm_uframes_t)frames > pcm->buffer_size)
+		frames = pcm->buffer_size;
+	client->tcp.hw = end;
+	if (frames <= 0 || !pcm->running_areas)
+		return 0;
+	iov->iov_len = snd_pcm_frames_to_bytes(pcm, frames);
+	iov->iov_base = tcp_buf(client, iov->iov_len);
+	if (!iov->iov_base)
+		return 0;
+	tcp_areas(pcm, areas, iov->iov_base);
+	offset = (end + pcm->boundary - frames) % pcm->boundary % pcm->buffer_size;
+	while (done < (snd_pcm_uframes_t)frames) {
+		n = pcm->buffer_size - offset;
+		if (n > frames - done)
+			n = frames - done;
+		snd_pcm_areas_copy(areas, done, pcm->running_areas, offset,
+				   pcm->channels, n, pcm->format);
+		done += n;
+		offset = 0;
+	}
+	ctrl->data_frames = frames;
+	return 1;
+}
+
+static int pcm_tcp_reply(client_t *client, int cmd)
+{
+	snd_pcm_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
+	snd_pcm_t *pcm = client->device.pcm.handle;
+	struct iovec iov[2];
+	int count = 1;
+
+	ctrl->data_frames = 0;
+	if (pcm->setup) {
+		ctrl->hw.ptr = *pcm->hw.ptr;
+		ctrl->appl.ptr = *pcm->appl.ptr;
+		/*
+		 * a plugin fills the ring of a capture up to the avail it
+		 * reports, which may trail its hw_ptr
+		 */
+		if (pcm->stream == SND_PCM_STREAM_CAPTURE &&
+		    cmd == SND_PCM_IOCTL_AVAIL_UPDATE && ctrl->result >= 0)
+			count += pcm_tcp_capture(client, (ctrl->appl.ptr + ctrl->result) %
+						 pcm->boundary, &iov[1]);
+	}
+	if ((cmd == SND_PCM_IOCTL_AVAIL_UPDATE && ctrl->result >= 0 &&
+	     (snd_pcm_uframes_t)ctrl->result < pcm->avail_min) ||
+	    (cmd == SNDRV_PCM_IOCTL_DRAIN && ctrl->result >= 0))
+		pcm_tcp_arm(client);
+	iov[0].iov_base = ctrl;
+	iov[0].iov_len = PCM_SHM_SIZE;
+	return tcp_send(client->ctrl_fd, iov, count);
+}
+
+/* move the appl_ptr for a commit, with the frames for playback */
+static int pcm_tcp_commit(client_t *client)
+{
+	snd_pcm_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
+	snd_pcm_t *pcm = client->device.pcm.handle;
+	snd_pcm_channel_area_t *areas = NULL;
+	const snd_pcm_channel_area_t *ring;
+	snd_pcm_uframes_t frames = ctrl->u.mmap_commit.frames, done = 0;
+	snd_pcm_uframes_t offset, n;
+	snd_pcm_sframes_t res;
+	size_t size;
+	void *buf;
+	int err;
+
+	if (ctrl->data_frames) {
+		if (!pcm->setup || ctrl->data_frames != frames ||
+		    frames > pcm->buffer_size)
+			return -EBADFD;
+		size = snd_pcm_frames_to_bytes(pcm, frames);
+		buf = tcp_buf(client, size);
+		if (!buf)
+			return -ENOMEM;
+		err = tcp_recv(client->ctrl_fd, buf, size);
+		if (err < 0)
+			return err;
+		areas = alloca(pcm->channels * sizeof(*areas));
+		tcp_areas(pcm, areas, buf);
+	}
+	while (done < frames) {
+		n = frames - done;
+		if (snd_pcm_mmap_begin(pcm, &ring, &offset, &n) < 0 || !n)
+			break;
+		if (areas)
+			snd_pcm_areas_copy(ring, offset, areas, done,
+					   pcm->channels, n, pcm->format);
+		res = snd_pcm_mmap_commit(pcm, offset, n);
+		if (res <= 0)
+			break;
+		done += res;
+	}
+	return 0;
+}
+
+static int pcm_tcp_cmd(client_t *client)
+{
+	snd_pcm_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
+	int err, cmd;
+
+	err = tcp_recv(client->ctrl_fd, ctrl, PCM_SHM_SIZE);
+	if (err < 0)
+		return err;
+	cmd = ctrl->cmd;
+	ctrl->cmd = 0;
+	if (cmd == SND_PCM_IOCTL_MMAP_COMMIT)
+		return pcm_tcp_commit(client);
+	pcm_cmd(client, cmd);
+	return pcm_tcp_reply(client, cmd);
+}
+
+transport_ops_t pcm_tcp_ops = {
+	.open	= pcm_tcp_open,
+	.cmd	= pcm_tcp_cmd,
+	.close	= pcm_tcp_close,
+};
+
 static int ctl_handler(waiter_t *waiter, unsigned short events)
 {
 	client_t *client = waiter->private_data;
@@ -541,6 +887,124 @@ static int ctl_handler(waiter_t *waiter, unsigned short events)
 	return 0;
 }
 
+static snd_ctl_shm_values_t *ctl_shm_values(client_t *client)
+{
+	if (!client->device.ctl.monitor)
+		return NULL;
+	return (snd_ctl_shm_values_t *)((char *)client->transport.shm.ctrl +
+					CTL_SHM_VALUES_OFFSET);
+}
+
+/* empty the slot of numid, or all slots when numid is 0 */
+static void ctl_value_drop(client_t *client, unsigned int numid)
+{
+	snd_ctl_shm_values_t *values = ctl_shm_values(client);
+	snd_ctl_shm_value_t *slot;
+	unsigned int k;
+
+	if (!values)
+		return;
+	for (k = 0; k < CTL_SHM_VALUES; k++) {
+		slot = &values->slots[k];
+		if (!slot->numid || (numid && slot->numid != numid))
+			continue;
+		__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		slot->numid = 0;
+		__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+	}
+}
+
+/* publish a value just read from the card */
+static void ctl_value_publish(client_t *client, const snd_ctl_elem_value_t *value)
+{
+	snd_ctl_shm_values_t *values = ctl_shm_values(client);
+	unsigned int numid = value->id.numid;
+	unsigned int idx = numid % CTL_SHM_VALUES;
+	snd_ctl_shm_value_t *slot;
+	snd_ctl_elem_info_t info = {0};
+
+	if (!values || !numid)
+		return;
+	slot = &values->slots[idx];
+	if (slot->numid != numid) {
+		if (client->device.ctl.nocache[idx] == numid)
+			return;
+		info.id.numid = numid;
+		if (snd_ctl_elem_info(client->device.ctl.monitor, &info) < 0 ||
+		    !snd_ctl_elem_info_is_readable(&info) ||
+		    snd_ctl_elem_info_is_volatile(&info)) {
+			client->device.ctl.nocache[idx] = numid;
+			return;
+		}
+	}
+	__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	slot->numid = numid;
+	slot->value = *value;
+	__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+}
+
+/* bring the published values up to date with the queued events */
+static void ctl_monitor_drain(client_t *client)
+{
+	snd_ctl_shm_values_t *values = ctl_shm_values(client);
+	snd_ctl_t *monitor = client->device.ctl.monitor;
+	snd_ctl_elem_value_t value;
+	snd_ctl_event_t event;
+	unsigned int numid, mask, idx;
+
+	if (!values)
+		return;
+	while (snd_ctl_read(monitor, &event) > 0) {
+		if (snd_ctl_event_get_type(&event) != SND_CTL_EVENT_ELEM)
+			continue;
+		numid = snd_ctl_event_elem_get_numid(&event);
+		mask = snd_ctl_event_elem_get_mask(&event);
+		idx = numid % CTL_SHM_VALUES;
+		if (mask == SND_CTL_EVENT_MASK_REMOVE ||
+		    (mask & (SND_CTL_EVENT_MASK_INFO | SND_CTL_EVENT_MASK_ADD))) {
+			ctl_value_drop(client, numid);
+			if (client->device.ctl.nocache[idx] == numid)
+				client->device.ctl.nocache[idx] = 0;
+		} else if ((mask & SND_CTL_EVENT_MASK_VALUE) &&
+			   values->slots[idx].numid == numid) {
+			memset(&value, 0, sizeof(value));
+			value.id.numid = numid;
+			if (snd_ctl_elem_read(monitor, &value) < 0)
+				ctl_value_drop(client, numid);
+			else
+				ctl_value_publish(client, &value);
+		}
+	}
+}
+
+static int ctl_monitor_handler(waiter_t *waiter, unsigned short events ATTRIBUTE_UNUSED)
+{
+	ctl_monitor_drain(waiter->private_data);
+	return 0;
+}
+
+/* open a second handle on the card whose events keep the values current */
+static void ctl_monitor_open(client_t *client)
+{
+	snd_ctl_shm_values_t *values;
+	snd_ctl_t *monitor;
+
+	if (snd_ctl_open(&monitor, client->name, SND_CTL_NONBLOCK) < 0)
+		return;
+	if (snd_ctl_subscribe_events(monitor, 1) < 0) {
+		snd_ctl_close(monitor);
+		return;
+	}
+	client->device.ctl.monitor = monitor;
+	client->device.ctl.monitor_fd = _snd_ctl_poll_descriptor(monitor);
+	memset(client->device.ctl.nocache, 0, sizeof(client->device.ctl.nocache));
+	add_waiter(client->device.ctl.monitor_fd, POLLIN, ctl_monitor_handler, client);
+	values = ctl_shm_values(client);
+	values->magic = CTL_SHM_VALUES_MAGIC;
+}
+
 static int ctl_shm_open(client_t *client, int *cookie)
 {
 	int shmid;
@@ -553,7 +1017,7 @@ static int ctl_shm_open(client_t *client, int *cookie)
 	client->device.ctl.handle = ctl;
 	client->device.ctl.fd = _snd_ctl_poll_descriptor(ctl);
 
-	shmid = shmget(IPC_PRIVATE, CTL_SHM_SIZE, 0666);
+	shmid = shmget(IPC_PRIVATE, CTL_SHM_TOTAL_SIZE, 0666);
 	if (shmid < 0) {
 		result = -errno;
 		SYSERROR("shmget failed");
@@ -570,6 +1034,7 @@ static int ctl_shm_open(client_t *client, int *cookie)
 	*cookie = shmid;
 	add_waiter(client->device.ctl.fd, POLLIN, ctl_handler, client);
 	client->polling = 1;
+	ctl_monitor_open(client);
 	return 0;
 
  _err:
@@ -586,6 +1051,11 @@ static int ctl_shm_close(client_t *client)
 		del_waiter(client->device.ctl.fd);
 		client->polling = 0;
 	}
+	if (client->device.ctl.monitor) {
+		del_waiter(client->device.ctl.monitor_fd);
+		snd_ctl_close(client->device.ctl.monitor);
+		client->device.ctl.monitor = NULL;
+	}
 	err = snd_ctl_close(client->device.ctl.handle);
 	ctrl->result = err;
 	if (err < 0) 
@@ -616,6 +1086,7 @@ static int ctl_shm_cmd(client_t *client)
 	cmd = ctrl->cmd;
 	ctrl->cmd = 0;
 	ctl = client->device.ctl.handle;
+	ctl_monitor_drain(client);
 	switch (cmd) {
 	case SND_CTL_IOCTL_ASYNC:
 		ctrl->result = snd_ctl_async(ctl, ctrl->u.async.sig, ctrl->u.async.pid);
@@ -656,10 +1127,36 @@ static int ctl_shm_cmd(client_t *client)
 		break;
 	case SNDRV_CTL_IOCTL_ELEM_READ:
 		ctrl->result = snd_ctl_elem_read(ctl, &ctrl->u.element_read);
+		if (ctrl->result >= 0)
+			ctl_value_publish(client, &ctrl->u.element_read);
 		break;
 	case SNDRV_CTL_IOCTL_ELEM_WRITE:
 		ctrl->result = snd_ctl_elem_write(ctl, &ctrl->u.element_write);
+		ctl_value_drop(client, ctrl->u.element_write.id.numid);
 		break;
+	case SND_CTL_IOCTL_ELEM_READ_MANY:
+	case SND_CTL_IOCTL_ELEM_WRITE_MANY:
+	{
+		snd_ctl_elem_value_t *data = (snd_ctl_elem_value_t *) ctrl->data;
+		unsigned int k, count = ctrl->u.element_many;
+		int *res = (int *)(data + count);
+		if (count > CTL_SHM_MANY_MAX) {
+			ctrl->result = -EFAULT;
+			break;
+		}
+		for (k = 0; k < count; k++) {
+			if (cmd == SND_CTL_IOCTL_ELEM_READ_MANY) {
+				res[k] = snd_ctl_elem_read(ctl, &data[k]);
+				if (res[k] >= 0)
+					ctl_value_publish(client, &data[k]);
+			} else {
+				res[k] = snd_ctl_elem_write(ctl, &data[k]);
+				ctl_value_drop(client, data[k].id.numid);
+			}
+		}
+		ctrl->result = 0;
+		break;
+	}
 	case SNDRV_CTL_IOCTL_ELEM_LOCK:
 		ctrl->result = snd_ctl_elem_lock(ctl, &ctrl->u.element_lock);
 		break;
@@ -763,6 +1260,13 @@ static int snd_client_open(client_t *client)
 			goto _answer;
 		}
 		break;
+	case SND_TRANSPORT_TYPE_TCP:
+		if (client->local || req.dev_type != SND_DEV_TYPE_PCM) {
+			ans.result = -EINVAL;
+			goto _answer;
+		}
+		client->ops = &pcm_tcp_ops;
+		break;
 	default:
 		ans.result = -EINVAL;
 		goto _answer;
@@ -792,35 +1296,196 @@ static int snd_client_open(client_t *client)
 	return 0;
 }
 
-static int client_poll_handler(waiter_t *waiter, unsigned short events ATTRIBUTE_UNUSED)
+/* release a client whose peer went away */
+static void client_free(client_t *client)
 {
-	client_t *client = waiter->private_data;
 	if (client->open)
 		client->ops->close(client);
-	close(client->poll_fd);
+	if (!client->local) {
+		if (waiters[client->poll_fd].handler)
+			del_waiter(client->poll_fd);
+		close(client->poll_fd);
+	}
+	if (waiters[client->ctrl_fd].handler)
+		del_waiter(client->ctrl_fd);
 	close(client->ctrl_fd);
-	del_waiter(client->poll_fd);
-	del_waiter(client->ctrl_fd);
 	list_del(&client->list);
 	free(client);
+}
+
+static int client_poll_handler(waiter_t *waiter, unsigned short events ATTRIBUTE_UNUSED)
+{
+	client_t *client = waiter->private_data;
+	if (client->busy) {
+		/* freed when the worker is done */
+		del_waiter(client->poll_fd);
+		client->hangup = 1;
+		return 0;
+	}
+	client_free(client);
 	return 0;
 }
 
+/*
+ * PCM commands which may wait for the device or a slow slave run on a
+ * pool of workers, so that the other clients are served meanwhile.  The
+ * control socket of the client leaves the set until the worker is done;
+ * the commands of the streaming path stay here, where they cost less
+ * than the handoff.
+ */
+static int cmd_may_block(client_t *client)
+{
+	volatile snd_pcm_shm_ctrl_t *ctrl = client->transport.shm.ctrl;
+
+	if (client->ops != &pcm_shm_ops)
+		return 0;
+	switch (ctrl->cmd) {
+	case SNDRV_PCM_IOCTL_HW_PARAMS:
+	case SNDRV_PCM_IOCTL_HW_REFINE:
+	case SNDRV_PCM_IOCTL_HW_FREE:
+	case SNDRV_PCM_IOCTL_SW_PARAMS:
+	case SNDRV_PCM_IOCTL_PREPARE:
+	case SNDRV_PCM_IOCTL_RESET:
+	case SNDRV_PCM_IOCTL_START:
+	case SNDRV_PCM_IOCTL_DRAIN:
+	case SNDRV_PCM_IOCTL_DROP:
+	case SNDRV_PCM_IOCTL_PAUSE:
+	case SNDRV_PCM_IOCTL_RESUME:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+#ifdef HAVE_LIBPTHREAD
+
+#define MAX_WORKERS	16
+
+static int client_ctrl_handler(waiter_t *waiter, unsigned short events);
+
+static pthread_mutex_t jobs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobs_cond = PTHREAD_COND_INITIALIZER;
+static LIST_HEAD(jobs);
+static LIST_HEAD(jobs_done);
+static int jobs_fd = -1;		/* readable when a job is done */
+static unsigned int workers;
+
+static void *worker(void *data ATTRIBUTE_UNUSED)
+{
+	client_t *client;
+	uint64_t one = 1;
+
+	pthread_mutex_lock(&jobs_mutex);
+	while (1) {
+		while (list_empty(&jobs))
+			pthread_cond_wait(&jobs_cond, &jobs_mutex);
+		client = list_entry(jobs.next, client_t, job);
+		list_del(&client->job);
+		pthread_mutex_unlock(&jobs_mutex);
+		client->job_err = client->ops->cmd(client);
+		pthread_mutex_lock(&jobs_mutex);
+		list_add_tail(&client->job, &jobs_done);
+		if (write(jobs_fd, &one, sizeof(one)) != sizeof(one))
+			SYSERROR("write failed");
+	}
+	return NULL;
+}
+
+static int queue_job(client_t *client)
+{
+	if (!workers)
+		return client->ops->cmd(client);
+	del_waiter(client->ctrl_fd);
+	client->busy = 1;
+	pthread_mutex_lock(&jobs_mutex);
+	list_add_tail(&client->job, &jobs);
+	pthread_cond_signal(&jobs_cond);
+	pthread_mutex_unlock(&jobs_mutex);
+	return 0;
+}
+
+/* give the clients of the finished jobs back to the loop */
+static int jobs_handler(waiter_t *waiter ATTRIBUTE_UNUSED, unsigned short events ATTRIBUTE_UNUSED)
+{
+	LIST_HEAD(done);
+	struct list_head *pos, *npos;
+	client_t *client;
+	uint64_t cnt;
+
+	if (read(jobs_fd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN)
+		return -errno;
+	pthread_mutex_lock(&jobs_mutex);
+	while (!list_empty(&jobs_done)) {
+		pos = jobs_done.next;
+		list_del(pos);
+		list_add_tail(pos, &done);
+	}
+	pthread_mutex_unlock(&jobs_mutex);
+	list_for_each_safe(pos, npos, &done) {
+		client = list_entry(pos, client_t, job);
+		list_del(&client->job);
+		client->busy = 0;
+		if (client->job_err < 0)
+			ERROR("waiter handler failed");
+		if (client->hangup) {
+			client_free(client);
+			continue;
+		}
+		add_waiter(client->ctrl_fd, POLLIN | POLLHUP | EPOLLRDHUP, client_ctrl_handler, client);
+	}
+	return 0;
+}
+
+static void start_workers(void)
+{
+	pthread_t thread;
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	jobs_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (jobs_fd < 0) {
+		SYSERROR("eventfd failed");
+		return;
+	}
+	add_waiter(jobs_fd, POLLIN, jobs_handler, NULL);
+	if (n < 1)
+		n = 1;
+	if (n > MAX_WORKERS)
+		n = MAX_WORKERS;
+	for (; workers < n; workers++) {
+		if (pthread_create(&thread, NULL, worker, NULL)) {
+			ERROR("cannot start a worker");
+			break;
+		}
+		pthread_detach(thread);
+	}
+}
+
+#else
+
+static int queue_job(client_t *client)
+{
+	return client->ops->cmd(client);
+}
+
+static void start_workers(void)
+{
+}
+
+#endif /* HAVE_LIBPTHREAD */
+
 static int client_ctrl_handler(waiter_t *waiter, unsigned short events)
 {
 	client_t *client = waiter->private_data;
-	if (events & POLLHUP) {
-		if (client->open)
-			client->ops->close(client);
-		close(client->ctrl_fd);
-		del_waiter(client->ctrl_fd);
-		list_del(&client->list);
-		free(client);
+	/* a TCP peer closing shows as a read hangup only */
+	if (events & (POLLHUP | EPOLLRDHUP)) {
+		client_free(client);
 		return 0;
 	}
-	if (client->open)
+	if (client->open) {
+		if (cmd_may_block(client))
+			return queue_job(client);
 		return client->ops->cmd(client);
-	else
+	} else
 		return snd_client_open(client);
 }
 
@@ -865,8 +1530,8 @@ static int inet_pending_handler(waiter_t *waiter, unsigned short events)
 	client->local = 0;
 	client->poll_fd = pdata->fd;
 	client->ctrl_fd = waiter->fd;
-	add_waiter(client->ctrl_fd, POLLIN | POLLHUP, client_ctrl_handler, client);
-	add_waiter(client->poll_fd, POLLHUP, client_poll_handler, client);
+	add_waiter(client->ctrl_fd, POLLIN | POLLHUP | EPOLLRDHUP, client_ctrl_handler, client);
+	add_waiter(client->poll_fd, POLLHUP | EPOLLRDHUP, client_poll_handler, client);
 	client->open = 0;
 	list_add_tail(&client->list, &clients);
 	list_del(&pending->list);
@@ -889,7 +1554,7 @@ static int local_handler(waiter_t *waiter, unsigned short events ATTRIBUTE_UNUSE
 		client->ctrl_fd = sock;
 		client->local = 1;
 		client->open = 0;
-		add_waiter(sock, POLLIN | POLLHUP, client_ctrl_handler, client);
+		add_waiter(sock, POLLIN | POLLHUP | EPOLLRDHUP, client_ctrl_handler, client);
 		list_add_tail(&client->list, &clients);
 	}
 	return 0;
@@ -928,8 +1593,14 @@ static int server(const char *sockname, int port)
 		SYSERROR("sysconf failed");
 		return result;
 	}
-	pollfds = calloc((size_t) open_max, sizeof(*pollfds));
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0) {
+		result = -errno;
+		SYSERROR("epoll_create1 failed");
+		return result;
+	}
 	waiters = calloc((size_t) open_max, sizeof(*waiters));
+	start_workers();
 
 	if (sockname) {
 		int sock = make_local_socket(sockname);
@@ -965,32 +1636,27 @@ static int server(const char *sockname, int port)
 	}
 
 	while (1) {
-		struct pollfd pfds[open_max];
-		size_t pfds_count;
+		struct epoll_event events[64];
+		int count;
 		do {
-			err = poll(pollfds, pollfds_count, -1);
-		} while (err == 0);
-		if (err < 0) {
-			SYSERROR("poll failed");
+			count = epoll_wait(epoll_fd, events, 64, -1);
+		} while (count == 0 || (count < 0 && errno == EINTR));
+		if (count < 0) {
+			SYSERROR("epoll_wait failed");
 			continue;
 		}
 
-		pfds_count = pollfds_count;
-		memcpy(pfds, pollfds, sizeof(*pfds) * pfds_count);
-		for (k = 0; k < pfds_count; k++) {
-			struct pollfd *pfd = &pfds[k];
-			if (pfd->revents) {
-				waiter_t *w = &waiters[pfd->fd];
-				if (!w->handler)
-					continue;
-				err = w->handler(w, pfd->revents);
-				if (err < 0)
-					ERROR("waiter handler failed");
-			}
+		for (k = 0; k < (unsigned int)count; k++) {
+			waiter_t *w = &waiters[events[k].data.fd];
+			if (!w->handler)
+				continue;
+			err = w->handler(w, events[k].events);
+			if (err < 0)
+				ERROR("waiter handler failed");
 		}
 	}
  _end:
-	free(pollfds);
+	close(epoll_fd);
 	free(waiters);
 	return result;
 }
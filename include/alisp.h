@@ -38,6 +38,7 @@ struct alisp_seq_iterator;
 struct alisp_cfg *alsa_lisp_default_cfg(snd_input_t *input);
 void alsa_lisp_default_cfg_free(struct alisp_cfg *cfg);
 int alsa_lisp(struct alisp_cfg *cfg, struct alisp_instance **instance);
+int alsa_lisp_compile(struct alisp_cfg *cfg, snd_output_t *out);
 void alsa_lisp_free(struct alisp_instance *instance);
 int alsa_lisp_function(struct alisp_instance *instance, struct alisp_seq_iterator **result,
 		       const char *id, const char *args, ...)
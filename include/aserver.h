@@ -63,6 +63,8 @@ typedef struct {
 	int cmd;
 	snd_pcm_shm_rbptr_t hw;
 	snd_pcm_shm_rbptr_t appl;
+	int direct;		/* hw is the kernel status page, appl its control */
+	snd_pcm_uframes_t data_frames;	/* tcp: frames following the message */
 	union {
 		struct {
 			int sig;
@@ -111,6 +113,8 @@ typedef struct {
 #define SND_CTL_IOCTL_CLOSE		_IO ('U', 0xf2)
 #define SND_CTL_IOCTL_POLL_DESCRIPTOR	_IO ('U', 0xf3)
 #define SND_CTL_IOCTL_ASYNC		_IO ('U', 0xf4)
+#define SND_CTL_IOCTL_ELEM_READ_MANY	_IO ('U', 0xf5)
+#define SND_CTL_IOCTL_ELEM_WRITE_MANY	_IO ('U', 0xf6)
 
 typedef struct {
 	int result;
@@ -136,12 +140,37 @@ typedef struct {
 		int rawmidi_prefer_subdevice;
 		unsigned int power_state;
 		snd_ctl_event_t read;
+		unsigned int element_many;	/* values in data, results behind them */
 	} u;
 	char data[0];
 } snd_ctl_shm_ctrl_t;
 
 #define CTL_SHM_SIZE 65536
 #define CTL_SHM_DATA_MAXLEN (CTL_SHM_SIZE - offsetof(snd_ctl_shm_ctrl_t, data))
+#define CTL_SHM_MANY_MAX (CTL_SHM_DATA_MAXLEN / (sizeof(snd_ctl_elem_value_t) + sizeof(int)))
+
+/*
+ * Element values published by the server behind the control block, so
+ * that the client reads them without a round trip.  The server keeps the
+ * slots up to date from the events of the card; a slot is stable while
+ * its seq is even and unchanged over the copy.
+ */
+#define CTL_SHM_VALUES		64
+#define CTL_SHM_VALUES_MAGIC	0x56435341	/* "ASCV" */
+
+typedef struct {
+	unsigned int seq;		/* odd while the server updates it */
+	unsigned int numid;		/* 0 when the slot is empty */
+	snd_ctl_elem_value_t value;
+} snd_ctl_shm_value_t;
+
+typedef struct {
+	unsigned int magic;		/* set when the server fills the slots */
+	snd_ctl_shm_value_t slots[CTL_SHM_VALUES];
+} snd_ctl_shm_values_t;
+
+#define CTL_SHM_VALUES_OFFSET	CTL_SHM_SIZE
+#define CTL_SHM_TOTAL_SIZE	(CTL_SHM_VALUES_OFFSET + sizeof(snd_ctl_shm_values_t))
 
 typedef struct {
 	unsigned char dev_type;
@@ -93,6 +93,10 @@ int snd_config_update(void);
 int snd_config_update_r(snd_config_t **top, snd_config_update_t **update, const char *path);
 int snd_config_update_free(snd_config_update_t *update);
 int snd_config_update_free_global(void);
+int snd_config_update_add_callback(void (*callback)(void *private_data),
+				   void *private_data);
+int snd_config_update_remove_callback(void (*callback)(void *private_data),
+				      void *private_data);
 
 int snd_config_update_ref(snd_config_t **top);
 void snd_config_ref(snd_config_t *top);
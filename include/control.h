@@ -241,12 +241,18 @@ snd_ctl_t *snd_async_handler_get_ctl(snd_async_handler_t *handler);
 int snd_ctl_poll_descriptors_count(snd_ctl_t *ctl);
 int snd_ctl_poll_descriptors(snd_ctl_t *ctl, struct pollfd *pfds, unsigned int space);
 int snd_ctl_poll_descriptors_revents(snd_ctl_t *ctl, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
+int snd_ctl_evloop_add(snd_evloop_t *loop, snd_evloop_source_t **srcp, snd_ctl_t *ctl,
+		snd_evloop_callback_t callback, void *private_data);
 int snd_ctl_subscribe_events(snd_ctl_t *ctl, int subscribe);
 int snd_ctl_card_info(snd_ctl_t *ctl, snd_ctl_card_info_t *info);
 int snd_ctl_elem_list(snd_ctl_t *ctl, snd_ctl_elem_list_t *list);
 int snd_ctl_elem_info(snd_ctl_t *ctl, snd_ctl_elem_info_t *info);
 int snd_ctl_elem_read(snd_ctl_t *ctl, snd_ctl_elem_value_t *data);
 int snd_ctl_elem_write(snd_ctl_t *ctl, snd_ctl_elem_value_t *data);
+int snd_ctl_elem_read_many(snd_ctl_t *ctl, snd_ctl_elem_value_t **data,
+			   int *errors, unsigned int count);
+int snd_ctl_elem_write_many(snd_ctl_t *ctl, snd_ctl_elem_value_t **data,
+			    int *errors, unsigned int count);
 int snd_ctl_elem_lock(snd_ctl_t *ctl, snd_ctl_elem_id_t *id);
 int snd_ctl_elem_unlock(snd_ctl_t *ctl, snd_ctl_elem_id_t *id);
 int snd_ctl_elem_tlv_read(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id,
@@ -429,6 +435,11 @@ int snd_ctl_add_integer_elem_set(snd_ctl_t *ctl, snd_ctl_elem_info_t *info,
 				 unsigned int element_count,
 				 unsigned int member_count,
 				 long min, long max, long step);
+int snd_ctl_add_integer_elem_set_tlv(snd_ctl_t *ctl, snd_ctl_elem_info_t *info,
+				     unsigned int element_count,
+				     unsigned int member_count,
+				     long min, long max, long step,
+				     const unsigned int *tlv);
 int snd_ctl_add_integer64_elem_set(snd_ctl_t *ctl, snd_ctl_elem_info_t *info,
 				   unsigned int element_count,
 				   unsigned int member_count,
@@ -559,6 +570,8 @@ static __inline__ int snd_hctl_abort(snd_hctl_t *hctl) { return snd_hctl_nonbloc
 int snd_hctl_poll_descriptors_count(snd_hctl_t *hctl);
 int snd_hctl_poll_descriptors(snd_hctl_t *hctl, struct pollfd *pfds, unsigned int space);
 int snd_hctl_poll_descriptors_revents(snd_hctl_t *ctl, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
+int snd_hctl_evloop_add(snd_evloop_t *loop, snd_evloop_source_t **srcp, snd_hctl_t *hctl,
+		snd_evloop_callback_t callback, void *private_data);
 unsigned int snd_hctl_get_count(snd_hctl_t *hctl);
 int snd_hctl_set_compare(snd_hctl_t *hctl, snd_hctl_compare_t hsort);
 snd_hctl_elem_t *snd_hctl_first_elem(snd_hctl_t *hctl);
@@ -570,6 +583,7 @@ void *snd_hctl_get_callback_private(snd_hctl_t *hctl);
 int snd_hctl_load(snd_hctl_t *hctl);
 int snd_hctl_free(snd_hctl_t *hctl);
 int snd_hctl_handle_events(snd_hctl_t *hctl);
+int snd_hctl_set_coalesce_events(snd_hctl_t *hctl, int enable);
 const char *snd_hctl_name(snd_hctl_t *hctl);
 int snd_hctl_wait(snd_hctl_t *hctl, int timeout);
 snd_ctl_t *snd_hctl_ctl(snd_hctl_t *hctl);
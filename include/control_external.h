@@ -74,7 +74,7 @@ typedef int (snd_ctl_ext_tlv_rw_t)(snd_ctl_ext_t *ext, snd_ctl_ext_key_t key, in
  */
 #define SND_CTL_EXT_VERSION_MAJOR	1	/**< Protocol major version */
 #define SND_CTL_EXT_VERSION_MINOR	0	/**< Protocol minor version */
-#define SND_CTL_EXT_VERSION_TINY	1	/**< Protocol tiny version */
+#define SND_CTL_EXT_VERSION_TINY	2	/**< Protocol tiny version */
 /**
  * external plugin protocol version
  */
@@ -251,6 +251,28 @@ struct snd_ctl_ext_callback {
 	 * mangle the revents of poll descriptors
 	 */
 	int (*poll_revents)(snd_ctl_ext_t *ext, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
+	/**
+	 * fill the ids of up to count elements from the given offset and
+	 * return the number filled; optional (since protocol 1.0.2)
+	 */
+	int (*elem_list_many)(snd_ctl_ext_t *ext, unsigned int offset,
+			      snd_ctl_elem_id_t **ids, unsigned int count);
+	/**
+	 * read the current values of several elements, storing the result
+	 * of each element in errors; return 0 or a negative error code of
+	 * the whole transfer, -ENOSYS for single reads; optional (since
+	 * protocol 1.0.2)
+	 */
+	int (*read_many)(snd_ctl_ext_t *ext, const snd_ctl_ext_key_t *keys,
+			 snd_ctl_elem_value_t **values, int *errors,
+			 unsigned int count);
+	/**
+	 * update the values of several elements, like read_many; optional
+	 * (since protocol 1.0.2)
+	 */
+	int (*write_many)(snd_ctl_ext_t *ext, const snd_ctl_ext_key_t *keys,
+			  snd_ctl_elem_value_t **values, int *errors,
+			  unsigned int count);
 };
 
 /**
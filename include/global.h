@@ -126,6 +126,46 @@ int snd_async_del_handler(snd_async_handler_t *handler);
 int snd_async_handler_get_fd(snd_async_handler_t *handler);
 int snd_async_handler_get_signo(snd_async_handler_t *handler);
 void *snd_async_handler_get_callback_private(snd_async_handler_t *handler);
+int snd_async_use_thread(int enable);
+
+/**
+ * \brief Internal structure for an event loop.
+ *
+ * An event loop waits for the events of many handles with one epoll
+ * set.  Applications don't access its contents directly.
+ */
+typedef struct _snd_evloop snd_evloop_t;
+
+/** \brief Internal structure for a handle registered with an event loop. */
+typedef struct _snd_evloop_source snd_evloop_source_t;
+
+/**
+ * \brief Event loop callback.
+ *
+ * \p revents are the events of the handle as returned by its
+ * poll_descriptors_revents function.  See #snd_evloop_dispatch.
+ */
+typedef void (*snd_evloop_callback_t)(snd_evloop_source_t *src, unsigned short revents);
+
+int snd_evloop_open(snd_evloop_t **loopp);
+int snd_evloop_close(snd_evloop_t *loop);
+int snd_evloop_get_fd(snd_evloop_t *loop);
+int snd_evloop_dispatch(snd_evloop_t *loop, int timeout);
+int snd_evloop_add_fds(snd_evloop_t *loop, snd_evloop_source_t **srcp,
+		       const struct pollfd *pfds, unsigned int count,
+		       snd_evloop_callback_t callback, void *private_data);
+int snd_evloop_add_timer(snd_evloop_t *loop, snd_evloop_source_t **srcp,
+			 unsigned int timeout, unsigned int interval,
+			 snd_evloop_callback_t callback, void *private_data);
+int snd_evloop_timer_set(snd_evloop_source_t *src, unsigned int timeout,
+			 unsigned int interval);
+int snd_evloop_remove(snd_evloop_source_t *src);
+int snd_evloop_source_refresh(snd_evloop_source_t *src);
+void *snd_evloop_source_get_handle(snd_evloop_source_t *src);
+void *snd_evloop_source_get_callback_private(snd_evloop_source_t *src);
+
+int snd_lib_thread_set_scheduler(int policy, int priority);
+int snd_lib_thread_set_affinity(const char *cpus);
 
 struct snd_shm_area *snd_shm_area_create(int shmid, void *ptr);
 struct snd_shm_area *snd_shm_area_share(struct snd_shm_area *area);
@@ -201,6 +201,7 @@
 
 #include "seqmid.h"
 #include "seq_midi_event.h"
+#include "seq_smf.h"
 #include "list.h"
 
 struct _snd_async_handler {
@@ -220,6 +221,7 @@ struct _snd_async_handler {
 	void *private_data;
 	struct list_head glist;
 	struct list_head hlist;
+	int dfd;		/* dispatcher thread: dup of fd in its epoll */
 };
 
 typedef enum _snd_set_mode {
@@ -239,12 +241,41 @@ int snd_receive_fd(int sock, void *data, size_t len, int *fd);
 
 /*
  * error messages
+ *
+ * inside the library every call site checks first whether its message is
+ * printed at all: the output of the default handlers is limited per call
+ * site, and debug messages without LIBASOUND_DEBUG aren't formatted
  */
+struct snd_err_ratelimit {
+	long stamp;		/* second of the current budget */
+	unsigned int count;	/* messages printed in it */
+	unsigned int missed;	/* messages dropped in it */
+	int exempt;		/* 0 = not known yet, 1 = limited, 2 = exempt */
+	const char *file;	/* of the call site, set with exempt */
+	int line;
+	const char *function;
+	struct snd_err_ratelimit *next;	/* in the list of pending counts */
+};
+int snd_lib_error_ratelimit(struct snd_err_ratelimit *rl, int debug,
+			    const char *file, int line, const char *function);
+
+#undef SNDERR
+#undef SYSERR
+#define __SNDERR(handler, debug, err, args...) do { \
+	static struct snd_err_ratelimit __snd_err_rl; \
+	int __snd_err = (err); \
+	if (snd_lib_error_ratelimit(&__snd_err_rl, debug, __FILE__, __LINE__, \
+				    __FUNCTION__)) \
+		handler(__FILE__, __LINE__, __FUNCTION__, __snd_err, ##args); \
+} while (0)
+#define SNDERR(args...) __SNDERR(snd_lib_error, 0, 0, ##args)
+#define SYSERR(args...) __SNDERR(snd_lib_error, 0, errno, ##args)
+
 #ifndef NDEBUG
 #define CHECK_SANITY(x) x
 extern snd_lib_error_handler_t snd_err_msg;
-#define SNDMSG(args...) snd_err_msg(__FILE__, __LINE__, __FUNCTION__, 0, ##args)
-#define SYSMSG(args...) snd_err_msg(__FILE__, __LINE__, __FUNCTION__, errno, ##args)
+#define SNDMSG(args...) __SNDERR(snd_err_msg, 1, 0, ##args)
+#define SYSMSG(args...) __SNDERR(snd_err_msg, 1, errno, ##args)
 #else
 #define CHECK_SANITY(x) 0 /* not evaluated */
 #define SNDMSG(args...) /* nop */
@@ -337,6 +368,99 @@ static inline int snd_open_device(const char *filename, int fmode)
 	snd1_config_check_hop
 #define snd_config_search_alias_hooks \
 	snd1_config_search_alias_hooks
+#define snd_config_search_definition_shared \
+	snd1_config_search_definition_shared
+#define snd_config_definition_log \
+	snd1_config_definition_log
+#define snd_config_pack \
+	snd1_config_pack
+#define snd_config_unpack \
+	snd1_config_unpack
+#define snd_card_get_info_cached \
+	snd1_card_get_info_cached
+#define snd_input_span \
+	snd1_input_span
+#define snd_hctl_elem_info_cached \
+	snd1_hctl_elem_info_cached
+#define snd_device_name_hint_cache_cleanup \
+	snd1_device_name_hint_cache_cleanup
+#define snd_mixer_simple_cache_cleanup \
+	snd1_mixer_simple_cache_cleanup
+#define snd_timer_query_cache_cleanup \
+	snd1_timer_query_cache_cleanup
+#define snd_ucm_cache_cleanup \
+	snd1_ucm_cache_cleanup
+#define snd_tlv_dB_table_new \
+	snd1_tlv_dB_table_new
+#define snd_tlv_dB_table_free \
+	snd1_tlv_dB_table_free
+#define snd_tlv_dB_table_match \
+	snd1_tlv_dB_table_match
+#define snd_tlv_dB_table_get_range \
+	snd1_tlv_dB_table_get_range
+#define snd_tlv_dB_table_to_dB \
+	snd1_tlv_dB_table_to_dB
+#define snd_tlv_dB_table_from_dB \
+	snd1_tlv_dB_table_from_dB
+#define snd_evloop_add_source \
+	snd1_evloop_add_source
+
+/* poll descriptor functions of a handle type, see evloop.c */
+typedef struct {
+	int (*count)(void *handle);
+	int (*descriptors)(void *handle, struct pollfd *pfds, unsigned int space);
+	int (*revents)(void *handle, struct pollfd *pfds, unsigned int nfds,
+		       unsigned short *revents);
+} snd_evloop_ops_t;
+
+int snd_evloop_add_source(snd_evloop_t *loop, snd_evloop_source_t **srcp,
+			  const snd_evloop_ops_t *ops, void *handle, short events,
+			  snd_evloop_callback_t callback, void *private_data);
+
+/* the shared inotify instance, see watch.c */
+#define snd_watch_add \
+	snd1_watch_add
+#define snd_watch_changed \
+	snd1_watch_changed
+#define snd_watch_reset \
+	snd1_watch_reset
+#define snd_watch_remove \
+	snd1_watch_remove
+
+typedef struct {
+	unsigned int epoch;	/* 0 = no watch */
+	int wd;
+	unsigned int events;	/* count acted on */
+} snd_watch_t;
+
+int snd_watch_add(snd_watch_t *w, const char *path, unsigned int mask);
+int snd_watch_changed(const snd_watch_t *w);
+void snd_watch_reset(snd_watch_t *w);
+void snd_watch_remove(snd_watch_t *w);
+
+/* scheduling of the threads and processes of the library, see thread.c */
+#include <sched.h>
+typedef struct {
+	int policy;		/* -1 to inherit */
+	int priority;
+	int affinity;		/* cpus is valid */
+	cpu_set_t cpus;
+} snd_thread_sched_t;
+
+#define snd_thread_sched_get \
+	snd1_thread_sched_get
+#define snd_thread_sched_apply_self \
+	snd1_thread_sched_apply_self
+#define snd_thread_create \
+	snd1_thread_create
+
+void snd_thread_sched_get(snd_thread_sched_t *sched);
+void snd_thread_sched_apply_self(const snd_thread_sched_t *sched);
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+int snd_thread_create(pthread_t *thread, const pthread_attr_t *attr,
+		      void *(*func)(void *), void *arg);
+#endif
 
 /* dlobj cache */
 void *snd_dlobj_cache_get(const char *lib, const char *name, const char *version, int verbose);
@@ -346,8 +470,55 @@ void snd_dlobj_cache_cleanup(void);
 /* for recursive checks */
 void snd_config_set_hop(snd_config_t *conf, int hop);
 int snd_config_check_hop(snd_config_t *conf);
+
+/* the rest of an input as one block, see input.c */
+int snd_input_span(snd_input_t *input, const char **data, size_t *size);
+
+/* card info, cached while the cards do not change */
+int snd_card_get_info_cached(int card, snd_ctl_card_info_t *info);
+
+/* element info, cached until an info event of the element */
+int snd_hctl_elem_info_cached(snd_hctl_elem_t *elem, snd_ctl_elem_info_t *info);
+
+/* device name hints, see namehint.c */
+void snd_device_name_hint_cache_cleanup(void);
+
+/* simple mixer modules and smixer.conf, see mixer/simple_abst.c */
+void snd_mixer_simple_cache_cleanup(void);
+
+/* timer list of the hw query interface, see timer/timer_query.c */
+void snd_timer_query_cache_cleanup(void);
+
+/* parsed use case configurations, see ucm/parser.c */
+void snd_ucm_cache_cleanup(void);
+
+/* dB TLV compiled for a volume range, see tlv.c */
+struct snd_tlv_dB_table;
+int snd_tlv_dB_table_new(struct snd_tlv_dB_table **tablep, unsigned int *tlv,
+			 long rangemin, long rangemax);
+void snd_tlv_dB_table_free(struct snd_tlv_dB_table *table);
+int snd_tlv_dB_table_match(struct snd_tlv_dB_table *table, unsigned int *tlv,
+			   long rangemin, long rangemax);
+int snd_tlv_dB_table_get_range(struct snd_tlv_dB_table *table,
+			       long *min, long *max);
+int snd_tlv_dB_table_to_dB(struct snd_tlv_dB_table *table, long volume,
+			   long *db_gain);
+int snd_tlv_dB_table_from_dB(struct snd_tlv_dB_table *table, long db_gain,
+			     long *value, int xdir);
+
+/* read only definition lookup, see conf.c */
+int snd_config_search_definition_shared(snd_config_t *config,
+					const char *base, const char *name,
+					snd_config_t **result);
 #define SND_CONF_MAX_HOPS	64
 
+/* record or replay the definition searches of the thread, see conf.c */
+void snd_config_definition_log(snd_config_t *log, int replay);
+
+/* a tree in one block, see conf.c */
+int snd_config_pack(snd_config_t *config, void **bufp, size_t *sizep);
+int snd_config_unpack(snd_config_t *top, const void *buf, size_t size);
+
 int snd_config_search_alias_hooks(snd_config_t *config,
                                   const char *base, const char *key,
 				  snd_config_t **result);
@@ -93,6 +93,11 @@ struct sm_elem_ops {
 	int (*enum_item_name)(snd_mixer_elem_t *elem, unsigned int item, size_t maxlen, char *buf);
 	int (*get_enum_item)(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, unsigned int *itemp);
 	int (*set_enum_item)(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, unsigned int item);
+	/* optional, while held the changes of several channels may be written at once */
+	int (*hold)(snd_mixer_elem_t *elem, int hold);
+	/* optional, volume and dB of channels 0..count-1, returns the count filled */
+	int (*get_levels)(snd_mixer_elem_t *elem, int dir, long *volume,
+			  long *dBvalue, unsigned int count);
 };
 
 int snd_mixer_selem_compare(const snd_mixer_elem_t *c1, const snd_mixer_elem_t *c2);
@@ -369,6 +369,10 @@ typedef long snd_pcm_sframes_t;
 #define SND_PCM_NO_AUTO_FORMAT		0x00040000
 /** Disable soft volume control */
 #define SND_PCM_NO_SOFTVOL		0x00080000
+/** Disable the thread-safe locking, the handle is used from one thread only */
+#define SND_PCM_NO_THREAD_SAFE		0x00100000
+/** Lock the buffers of the plugins in memory and fault them in at hw_params time */
+#define SND_PCM_LOCK_BUFFERS		0x00200000
 
 /** PCM handle */
 typedef struct _snd_pcm snd_pcm_t;
@@ -483,6 +487,8 @@ snd_pcm_stream_t snd_pcm_stream(snd_pcm_t *pcm);
 int snd_pcm_poll_descriptors_count(snd_pcm_t *pcm);
 int snd_pcm_poll_descriptors(snd_pcm_t *pcm, struct pollfd *pfds, unsigned int space);
 int snd_pcm_poll_descriptors_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
+int snd_pcm_evloop_add(snd_evloop_t *loop, snd_evloop_source_t **srcp, snd_pcm_t *pcm,
+		snd_evloop_callback_t callback, void *private_data);
 int snd_pcm_nonblock(snd_pcm_t *pcm, int nonblock);
 static __inline__ int snd_pcm_abort(snd_pcm_t *pcm) { return snd_pcm_nonblock(pcm, 2); }
 int snd_async_add_pcm_handler(snd_async_handler_t **handler, snd_pcm_t *pcm, 
@@ -509,6 +515,7 @@ int snd_pcm_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail, snd_htimestamp_
 snd_pcm_sframes_t snd_pcm_avail(snd_pcm_t *pcm);
 snd_pcm_sframes_t snd_pcm_avail_update(snd_pcm_t *pcm);
 int snd_pcm_avail_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *availp, snd_pcm_sframes_t *delayp);
+int snd_pcm_avail_status(snd_pcm_t *pcm, snd_pcm_status_t *status);
 snd_pcm_sframes_t snd_pcm_rewindable(snd_pcm_t *pcm);
 snd_pcm_sframes_t snd_pcm_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames);
 snd_pcm_sframes_t snd_pcm_forwardable(snd_pcm_t *pcm);
@@ -521,6 +528,9 @@ int snd_pcm_wait(snd_pcm_t *pcm, int timeout);
 
 int snd_pcm_link(snd_pcm_t *pcm1, snd_pcm_t *pcm2);
 int snd_pcm_unlink(snd_pcm_t *pcm);
+int snd_pcm_wait_all(snd_pcm_t **pcms, unsigned int count, int timeout);
+snd_pcm_sframes_t snd_pcm_avail_update_all(snd_pcm_t **pcms, unsigned int count,
+					   snd_pcm_sframes_t *avail);
 
 /** channel mapping API version number */
 #define SND_CHMAP_API_VERSION	((1 << 16) | (0 << 8) | 1)
@@ -1067,6 +1077,76 @@ int snd_pcm_hw_params_dump(snd_pcm_hw_params_t *params, snd_output_t *out);
 int snd_pcm_sw_params_dump(snd_pcm_sw_params_t *params, snd_output_t *out);
 int snd_pcm_status_dump(snd_pcm_status_t *status, snd_output_t *out);
 
+/** PCM hot-path statistics slot */
+typedef enum _snd_pcm_stat {
+	/** snd_pcm_write_areas transfer callback */
+	SND_PCM_STAT_WRITE_AREAS = 0,
+	/** snd_pcm_read_areas transfer callback */
+	SND_PCM_STAT_READ_AREAS,
+	/** avail_update */
+	SND_PCM_STAT_AVAIL_UPDATE,
+	/** mmap_commit */
+	SND_PCM_STAT_MMAP_COMMIT,
+	/** hwsync */
+	SND_PCM_STAT_HWSYNC,
+	/** poll_descriptors_revents */
+	SND_PCM_STAT_POLL_REVENTS,
+	SND_PCM_STAT_LAST = SND_PCM_STAT_POLL_REVENTS
+} snd_pcm_stat_t;
+
+/** PCM hot-path statistics counter */
+typedef struct _snd_pcm_stat_counter {
+	unsigned long calls;		/**< number of calls */
+	unsigned long long total_ns;	/**< cumulative time in nanoseconds */
+	unsigned long long max_ns;	/**< longest call in nanoseconds */
+} snd_pcm_stat_counter_t;
+
+const char *snd_pcm_stat_name(const snd_pcm_stat_t stat);
+int snd_pcm_stats_enable(snd_pcm_t *pcm, int enable);
+int snd_pcm_stats_get(snd_pcm_t *pcm, snd_pcm_stat_t stat,
+		      snd_pcm_stat_counter_t *counter);
+int snd_pcm_dump_stats(snd_pcm_t *pcm, snd_output_t *out);
+
+/** PCM trace event */
+typedef enum _snd_pcm_trace_event {
+	/** hw plugin avail_update; result = avail or error */
+	SND_PCM_TRACE_HW_AVAIL_UPDATE = 0,
+	/** going to sleep in snd_pcm_wait(); result = timeout */
+	SND_PCM_TRACE_WAIT,
+	/** woken up in snd_pcm_wait(); result = wait result */
+	SND_PCM_TRACE_WAKEUP,
+	/** dmix/dsnoop/dshare slave pointer sync; result = frames moved */
+	SND_PCM_TRACE_DIRECT_SYNC,
+	SND_PCM_TRACE_LAST = SND_PCM_TRACE_DIRECT_SYNC
+} snd_pcm_trace_event_t;
+
+/** PCM trace record */
+typedef struct _snd_pcm_trace_record {
+	unsigned long long seq;		/**< record index + 1, 0 while written */
+	unsigned long long tstamp_ns;	/**< CLOCK_MONOTONIC time stamp */
+	unsigned long long handle;	/**< address of the PCM handle */
+	unsigned long long hw_ptr;	/**< hw_ptr of the PCM */
+	unsigned long long appl_ptr;	/**< appl_ptr of the PCM */
+	long long result;		/**< event specific value */
+	unsigned int event;		/**< #snd_pcm_trace_event_t */
+	unsigned int reserved;
+} snd_pcm_trace_record_t;
+
+/** PCM trace ring magic */
+#define SND_PCM_TRACE_MAGIC	0x50435452	/* PCTR */
+
+/** PCM trace ring header, followed by size records */
+typedef struct _snd_pcm_trace_ring {
+	unsigned int magic;		/**< #SND_PCM_TRACE_MAGIC */
+	unsigned int size;		/**< number of records, power of two */
+	unsigned long long head;	/**< records written so far */
+} snd_pcm_trace_ring_t;
+
+const char *snd_pcm_trace_event_name(const snd_pcm_trace_event_t event);
+int snd_pcm_trace_start(unsigned int records, long ipc_key);
+void snd_pcm_trace_stop(void);
+int snd_pcm_trace_dump(snd_output_t *out);
+
 /** \} */
 
 /**
@@ -1083,6 +1163,13 @@ int snd_pcm_mmap_begin(snd_pcm_t *pcm,
 snd_pcm_sframes_t snd_pcm_mmap_commit(snd_pcm_t *pcm,
 				      snd_pcm_uframes_t offset,
 				      snd_pcm_uframes_t frames);
+int snd_pcm_mmap_begin_all(snd_pcm_t **pcms, unsigned int count,
+			   const snd_pcm_channel_area_t **areas,
+			   snd_pcm_uframes_t *offsets,
+			   snd_pcm_uframes_t *frames);
+snd_pcm_sframes_t snd_pcm_mmap_commit_all(snd_pcm_t **pcms, unsigned int count,
+					  const snd_pcm_uframes_t *offsets,
+					  snd_pcm_uframes_t frames);
 snd_pcm_sframes_t snd_pcm_mmap_writei(snd_pcm_t *pcm, const void *buffer, snd_pcm_uframes_t size);
 snd_pcm_sframes_t snd_pcm_mmap_readi(snd_pcm_t *pcm, void *buffer, snd_pcm_uframes_t size);
 snd_pcm_sframes_t snd_pcm_mmap_writen(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t size);
@@ -1090,6 +1177,102 @@ snd_pcm_sframes_t snd_pcm_mmap_readn(snd_pcm_t *pcm, void **bufs, snd_pcm_uframe
 
 /** \} */
 
+/**
+ * \defgroup PCM_Sched Timer Driven Scheduler
+ * \ingroup PCM
+ * Services a set of mmap PCMs from the expiries of one timer.
+ * \{
+ */
+
+/** PCM scheduler handle */
+typedef struct _snd_pcm_sched snd_pcm_sched_t;
+/** function processing the available frames of a scheduled PCM */
+typedef snd_pcm_sframes_t (*snd_pcm_sched_callback_t)(snd_pcm_t *pcm,
+						       const snd_pcm_channel_area_t *areas,
+						       snd_pcm_uframes_t offset,
+						       snd_pcm_uframes_t frames,
+						       void *private_data);
+
+int snd_pcm_sched_open(snd_pcm_sched_t **schedp, const char *timer_name,
+		       unsigned int period_us);
+int snd_pcm_sched_close(snd_pcm_sched_t *sched);
+int snd_pcm_sched_add(snd_pcm_sched_t *sched, snd_pcm_t *pcm,
+		      snd_pcm_sched_callback_t callback, void *private_data);
+int snd_pcm_sched_remove(snd_pcm_sched_t *sched, snd_pcm_t *pcm);
+int snd_pcm_sched_status(snd_pcm_sched_t *sched, snd_pcm_t *pcm);
+int snd_pcm_sched_run(snd_pcm_sched_t *sched, int timeout);
+int snd_pcm_sched_poll_descriptors(snd_pcm_sched_t *sched, struct pollfd *pfds,
+				   unsigned int space);
+
+/** \} */
+
+/**
+ * \defgroup PCM_Clock Audio Clock Analyzer
+ * \ingroup PCM
+ * Estimates the rate, drift and jitter of the audio clock of a PCM.
+ * \{
+ */
+
+/** PCM audio clock analyzer handle */
+typedef struct _snd_pcm_clock snd_pcm_clock_t;
+
+int snd_pcm_clock_open(snd_pcm_clock_t **clockp, snd_pcm_t *pcm,
+		       double bandwidth);
+void snd_pcm_clock_close(snd_pcm_clock_t *clock);
+void snd_pcm_clock_reset(snd_pcm_clock_t *clock);
+int snd_pcm_clock_update(snd_pcm_clock_t *clock, const snd_pcm_status_t *status);
+double snd_pcm_clock_get_rate(const snd_pcm_clock_t *clock);
+double snd_pcm_clock_get_drift(const snd_pcm_clock_t *clock);
+double snd_pcm_clock_get_jitter(const snd_pcm_clock_t *clock);
+double snd_pcm_clock_get_elapsed(const snd_pcm_clock_t *clock,
+				 unsigned long long *frames);
+int snd_pcm_clock_get_tstamp(const snd_pcm_clock_t *clock,
+			     snd_pcm_sframes_t frames,
+			     snd_htimestamp_t *tstamp);
+
+/** \} */
+
+/**
+ * \defgroup PCM_Pool Pool of Prepared Handles
+ * \ingroup PCM
+ * Keeps handles of a PCM set up and prepared, to start streams without
+ * the time of the open.
+ * \{
+ */
+
+/** PCM handle pool */
+typedef struct _snd_pcm_pool snd_pcm_pool_t;
+
+int snd_pcm_pool_open(snd_pcm_pool_t **poolp, const char *name,
+		      snd_pcm_stream_t stream, int mode,
+		      const snd_pcm_hw_params_t *hw_params,
+		      const snd_pcm_sw_params_t *sw_params,
+		      unsigned int count);
+void snd_pcm_pool_close(snd_pcm_pool_t *pool);
+int snd_pcm_pool_fill(snd_pcm_pool_t *pool);
+int snd_pcm_pool_acquire(snd_pcm_pool_t *pool, snd_pcm_t **pcmp);
+int snd_pcm_pool_release(snd_pcm_pool_t *pool, snd_pcm_t *pcm);
+unsigned int snd_pcm_pool_get_avail(snd_pcm_pool_t *pool);
+
+/** \} */
+
+/**
+ * \defgroup PCM_Descriptor Descriptors of Resolved Chains
+ * \ingroup PCM
+ * Stores the resolved definitions and the chosen parameters of a PCM,
+ * to open it again in another process without the configuration work.
+ * \{
+ */
+
+int snd_pcm_descriptor_create(void **descp, size_t *sizep, const char *name,
+			      snd_pcm_stream_t stream, int mode,
+			      const snd_pcm_hw_params_t *hw_params,
+			      const snd_pcm_sw_params_t *sw_params);
+int snd_pcm_open_descriptor(snd_pcm_t **pcmp, const void *desc, size_t size,
+			    int mode);
+
+/** \} */
+
 /**
  * \defgroup PCM_Helpers Helper Functions
  * \ingroup PCM
@@ -1200,6 +1383,12 @@ typedef struct _snd_pcm_scope_ops {
 	void (*close)(snd_pcm_scope_t *scope);
 } snd_pcm_scope_ops_t;
 
+/** #SND_PCM_TYPE_METER batched update: frames ptr ... ptr + frames - 1
+ * (modulo the boundary) were added to the meter buffer */
+typedef void (*snd_pcm_scope_range_callback_t)(snd_pcm_scope_t *scope,
+					       snd_pcm_uframes_t ptr,
+					       snd_pcm_uframes_t frames);
+
 snd_pcm_uframes_t snd_pcm_meter_get_bufsize(snd_pcm_t *pcm);
 unsigned int snd_pcm_meter_get_channels(snd_pcm_t *pcm);
 unsigned int snd_pcm_meter_get_rate(snd_pcm_t *pcm);
@@ -1210,6 +1399,8 @@ snd_pcm_scope_t *snd_pcm_meter_search_scope(snd_pcm_t *pcm, const char *name);
 int snd_pcm_scope_malloc(snd_pcm_scope_t **ptr);
 void snd_pcm_scope_set_ops(snd_pcm_scope_t *scope,
 			   const snd_pcm_scope_ops_t *val);
+void snd_pcm_scope_set_range_callback(snd_pcm_scope_t *scope,
+				      snd_pcm_scope_range_callback_t val);
 void snd_pcm_scope_set_name(snd_pcm_scope_t *scope, const char *val);
 const char *snd_pcm_scope_get_name(snd_pcm_scope_t *scope);
 void *snd_pcm_scope_get_callback_private(snd_pcm_scope_t *scope);
@@ -1219,6 +1410,23 @@ int snd_pcm_scope_s16_open(snd_pcm_t *pcm, const char *name,
 int16_t *snd_pcm_scope_s16_get_channel_buffer(snd_pcm_scope_t *scope,
 					      unsigned int channel);
 
+/** Results of the peak scope, followed by channels peak and then
+ * channels RMS values as floats (1.0 = full scale) */
+typedef struct _snd_pcm_scope_peak_info {
+	/** number of channels */
+	unsigned int channels;
+	/** odd while an update is in progress, read again if changed */
+	unsigned int seq;
+	/** frames measured by the last update */
+	unsigned int frames;
+	/** reserved */
+	unsigned int reserved;
+} snd_pcm_scope_peak_info_t;
+
+int snd_pcm_scope_peak_open(snd_pcm_t *pcm, const char *name, long ipc_key,
+			    snd_pcm_scope_t **scopep);
+const snd_pcm_scope_peak_info_t *snd_pcm_scope_peak_get_info(snd_pcm_scope_t *scope);
+
 /** \} */
 
 /**
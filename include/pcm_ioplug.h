@@ -71,7 +71,7 @@ typedef snd_pcm_ioplug_callback snd_pcm_ioplug_callback_t;
  */
 #define SND_PCM_IOPLUG_VERSION_MAJOR	1	/**< Protocol major version */
 #define SND_PCM_IOPLUG_VERSION_MINOR	0	/**< Protocol minor version */
-#define SND_PCM_IOPLUG_VERSION_TINY	2	/**< Protocol tiny version */
+#define SND_PCM_IOPLUG_VERSION_TINY	3	/**< Protocol tiny version */
 /**
  * IO-plugin protocol version
  */
@@ -119,6 +119,17 @@ struct snd_pcm_ioplug {
 	unsigned int rate;		/**< rate; filled after hw_params is called */
 	snd_pcm_uframes_t period_size;	/**< period size; filled after hw_params is called */
 	snd_pcm_uframes_t buffer_size;	/**< buffer size; filled after hw_params is called */
+
+	/**
+	 * buffer owned by the plugin, used as the mmap buffer of the PCM;
+	 * optional, set in the hw_params callback; since v1.0.3
+	 */
+	const snd_pcm_channel_area_t *mmap_areas;
+	/**
+	 * current DMA position published by the plugin, read instead of
+	 * calling the pointer callback; optional; since v1.0.3
+	 */
+	const volatile snd_pcm_sframes_t *hw_pos;
 };
 
 /** Callback table of ioplug */
@@ -132,7 +143,8 @@ struct snd_pcm_ioplug_callback {
 	 */
 	int (*stop)(snd_pcm_ioplug_t *io);
 	/**
-	 * get the current DMA position; required, called inside mutex lock
+	 * get the current DMA position; required unless hw_pos is set,
+	 * called inside mutex lock
 	 */
 	snd_pcm_sframes_t (*pointer)(snd_pcm_ioplug_t *io);
 	/**
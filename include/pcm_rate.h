@@ -38,7 +38,13 @@ extern "C" {
 /**
  * Protocol version
  */
-#define SND_PCM_RATE_PLUGIN_VERSION	0x010002
+#define SND_PCM_RATE_PLUGIN_VERSION	0x010003
+
+/**
+ * Flag for get_supported_formats: the input and output formats
+ * must be identical
+ */
+#define SND_PCM_RATE_FLAG_SYNC_FORMATS	(1U << 0)
 
 /** hw_params information for a single side */
 typedef struct snd_pcm_rate_side_info {
@@ -114,6 +120,32 @@ typedef struct snd_pcm_rate_ops {
 	 * new ops since version 0x010002
 	 */
 	void (*dump)(void *obj, snd_output_t *out);
+	/**
+	 * return the formats processed natively by convert, as bit masks
+	 * of (1ULL << format), and SND_PCM_RATE_FLAG_* flags; optional,
+	 * formats not listed here go through convert_s16;
+	 * new ops since version 0x010003
+	 */
+	int (*get_supported_formats)(void *obj, u_int64_t *in_formats,
+				     u_int64_t *out_formats,
+				     unsigned int *flags);
+	/**
+	 * return the size in bytes of the converter state saved at each
+	 * period boundary for rewinding, or zero when it cannot be saved;
+	 * optional, called at prepare;
+	 * new ops since version 0x010003
+	 */
+	size_t (*state_size)(void *obj);
+	/**
+	 * save the converter state into buf;
+	 * new ops since version 0x010003
+	 */
+	void (*save_state)(void *obj, void *buf);
+	/**
+	 * restore the converter state from buf;
+	 * new ops since version 0x010003
+	 */
+	void (*restore_state)(void *obj, const void *buf);
 } snd_pcm_rate_ops_t;
 
 /** open function type */
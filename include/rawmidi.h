@@ -87,6 +87,8 @@ int snd_rawmidi_close(snd_rawmidi_t *rmidi);
 int snd_rawmidi_poll_descriptors_count(snd_rawmidi_t *rmidi);
 int snd_rawmidi_poll_descriptors(snd_rawmidi_t *rmidi, struct pollfd *pfds, unsigned int space);
 int snd_rawmidi_poll_descriptors_revents(snd_rawmidi_t *rawmidi, struct pollfd *pfds, unsigned int nfds, unsigned short *revent);
+int snd_rawmidi_evloop_add(snd_evloop_t *loop, snd_evloop_source_t **srcp, snd_rawmidi_t *rawmidi,
+		snd_evloop_callback_t callback, void *private_data);
 int snd_rawmidi_nonblock(snd_rawmidi_t *rmidi, int nonblock);
 size_t snd_rawmidi_info_sizeof(void);
 /** \hideinitializer
@@ -145,6 +147,13 @@ int snd_rawmidi_drain(snd_rawmidi_t *rmidi);
 int snd_rawmidi_drop(snd_rawmidi_t *rmidi);
 ssize_t snd_rawmidi_write(snd_rawmidi_t *rmidi, const void *buffer, size_t size);
 ssize_t snd_rawmidi_read(snd_rawmidi_t *rmidi, void *buffer, size_t size);
+struct iovec;
+ssize_t snd_rawmidi_writev(snd_rawmidi_t *rmidi, const struct iovec *iov, int iovcnt);
+int snd_rawmidi_set_output_buffer(snd_rawmidi_t *rmidi, size_t size, size_t threshold);
+int snd_rawmidi_flush(snd_rawmidi_t *rmidi);
+ssize_t snd_rawmidi_tread(snd_rawmidi_t *rmidi, snd_htimestamp_t *tstamp, void *buffer, size_t size);
+int snd_rawmidi_set_wakeup_window(snd_rawmidi_t *rmidi, unsigned int usec);
+unsigned int snd_rawmidi_get_wakeup_window(snd_rawmidi_t *rmidi);
 const char *snd_rawmidi_name(snd_rawmidi_t *rmidi);
 snd_rawmidi_type_t snd_rawmidi_type(snd_rawmidi_t *rmidi);
 snd_rawmidi_stream_t snd_rawmidi_stream(snd_rawmidi_t *rawmidi);
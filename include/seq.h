@@ -83,6 +83,8 @@ int snd_seq_close(snd_seq_t *handle);
 int snd_seq_poll_descriptors_count(snd_seq_t *handle, short events);
 int snd_seq_poll_descriptors(snd_seq_t *handle, struct pollfd *pfds, unsigned int space, short events);
 int snd_seq_poll_descriptors_revents(snd_seq_t *seq, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
+int snd_seq_evloop_add(snd_evloop_t *loop, snd_evloop_source_t **srcp, snd_seq_t *seq, short events,
+		snd_evloop_callback_t callback, void *private_data);
 int snd_seq_nonblock(snd_seq_t *handle, int nonblock);
 int snd_seq_client_id(snd_seq_t *handle);
 
@@ -90,6 +92,10 @@ size_t snd_seq_get_output_buffer_size(snd_seq_t *handle);
 size_t snd_seq_get_input_buffer_size(snd_seq_t *handle);
 int snd_seq_set_output_buffer_size(snd_seq_t *handle, size_t size);
 int snd_seq_set_input_buffer_size(snd_seq_t *handle, size_t size);
+int snd_seq_set_output_buffer_max(snd_seq_t *handle, size_t size);
+int snd_seq_direct_connect(snd_seq_t *src, int src_port, snd_seq_t *dest, int dest_port, unsigned int size);
+int snd_seq_direct_disconnect(snd_seq_t *src, int src_port, snd_seq_t *dest, int dest_port);
+int snd_seq_get_output_flush_stats(snd_seq_t *handle, unsigned long *flushes, unsigned long *bytes);
 
 /** system information container */
 typedef struct _snd_seq_system_info snd_seq_system_info_t;
@@ -387,6 +393,31 @@ int snd_seq_query_port_subscribers(snd_seq_t *seq, snd_seq_query_subscribe_t * s
 /** \} */
 
 
+/**
+ *  \defgroup SeqGraph Sequencer Graph Snapshot
+ *  Sequencer Graph Snapshot
+ *  \ingroup Sequencer
+ *  \{
+ */
+
+/** client, port and subscription snapshot container */
+typedef struct _snd_seq_graph snd_seq_graph_t;
+
+int snd_seq_graph_create(snd_seq_t *seq, snd_seq_graph_t **graphp);
+void snd_seq_graph_free(snd_seq_graph_t *graph);
+int snd_seq_graph_refresh(snd_seq_graph_t *graph);
+int snd_seq_graph_update(snd_seq_graph_t *graph, const snd_seq_event_t *ev);
+
+unsigned int snd_seq_graph_get_clients_count(const snd_seq_graph_t *graph);
+const snd_seq_client_info_t *snd_seq_graph_get_client(const snd_seq_graph_t *graph, unsigned int idx);
+unsigned int snd_seq_graph_get_ports_count(const snd_seq_graph_t *graph);
+const snd_seq_port_info_t *snd_seq_graph_get_port(const snd_seq_graph_t *graph, unsigned int idx);
+unsigned int snd_seq_graph_get_subs_count(const snd_seq_graph_t *graph);
+const snd_seq_port_subscribe_t *snd_seq_graph_get_sub(const snd_seq_graph_t *graph, unsigned int idx);
+
+/** \} */
+
+
 /**
  *  \defgroup SeqQueue Sequencer Queue Interface
  *  Sequencer Queue Interface
@@ -453,6 +484,7 @@ const snd_seq_real_time_t *snd_seq_queue_status_get_real_time(const snd_seq_queu
 unsigned int snd_seq_queue_status_get_status(const snd_seq_queue_status_t *info);
 
 int snd_seq_get_queue_status(snd_seq_t *handle, int q, snd_seq_queue_status_t *status);
+int snd_seq_get_queue_clock(snd_seq_t *handle, int q, snd_seq_queue_status_t *status);
 
 /*
  */
@@ -521,8 +553,15 @@ ssize_t snd_seq_event_length(snd_seq_event_t *ev);
 int snd_seq_event_output(snd_seq_t *handle, snd_seq_event_t *ev);
 int snd_seq_event_output_buffer(snd_seq_t *handle, snd_seq_event_t *ev);
 int snd_seq_event_output_direct(snd_seq_t *handle, snd_seq_event_t *ev);
+int snd_seq_event_output_reserve(snd_seq_t *handle, snd_seq_event_t **evp, unsigned int count);
+int snd_seq_event_output_commit(snd_seq_t *handle, unsigned int count);
 int snd_seq_event_input(snd_seq_t *handle, snd_seq_event_t **ev);
+int snd_seq_event_input_many(snd_seq_t *handle, snd_seq_event_t **evs, unsigned int count);
 int snd_seq_event_input_pending(snd_seq_t *seq, int fetch_sequencer);
+void snd_seq_input_filter_clear(snd_seq_t *seq);
+int snd_seq_input_filter_add_type(snd_seq_t *seq, int event_type);
+int snd_seq_input_filter_add_port(snd_seq_t *seq, int port);
+int snd_seq_input_filter_add_channel(snd_seq_t *seq, int channel);
 int snd_seq_drain_output(snd_seq_t *handle);
 int snd_seq_event_output_pending(snd_seq_t *seq);
 int snd_seq_extract_output(snd_seq_t *handle, snd_seq_event_t **ev);
@@ -54,6 +54,10 @@ long snd_midi_event_encode(snd_midi_event_t *dev, const unsigned char *buf, long
 int snd_midi_event_encode_byte(snd_midi_event_t *dev, int c, snd_seq_event_t *ev);
 /* decode from event to bytes - return number of written bytes if success */
 long snd_midi_event_decode(snd_midi_event_t *dev, unsigned char *buf, long count, const snd_seq_event_t *ev);
+long snd_midi_event_encode_many(snd_midi_event_t *dev, const unsigned char *buf, long count,
+				snd_seq_event_t *evs, unsigned int nevs, unsigned int *nencoded);
+long snd_midi_event_decode_many(snd_midi_event_t *dev, unsigned char *buf, long count,
+				const snd_seq_event_t *evs, unsigned int nevs, unsigned int *ndecoded);
 
 /** \} */
 
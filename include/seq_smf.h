@@ -0,0 +1,59 @@
+/**
+ * \file include/seq_smf.h
+ * \brief Application interface library for the ALSA driver
+ *
+ * Application interface library for the ALSA driver
+ */
+/*
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#ifndef __ALSA_SEQ_SMF_H
+#define __ALSA_SEQ_SMF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  \defgroup SeqSMF Standard MIDI File player
+ *  \ingroup Sequencer
+ *  Streaming Standard MIDI File player
+ *  \{
+ */
+
+/** container for a Standard MIDI File being played */
+typedef struct snd_seq_smf snd_seq_smf_t;
+
+int snd_seq_smf_open(snd_seq_smf_t **smfp, const char *filename);
+void snd_seq_smf_close(snd_seq_smf_t *smf);
+int snd_seq_smf_get_format(const snd_seq_smf_t *smf);
+unsigned int snd_seq_smf_get_tracks(const snd_seq_smf_t *smf);
+int snd_seq_smf_get_ppq(const snd_seq_smf_t *smf);
+void snd_seq_smf_set_output(snd_seq_smf_t *smf, int port, int queue);
+int snd_seq_smf_init_queue(snd_seq_smf_t *smf, snd_seq_t *seq);
+void snd_seq_smf_rewind(snd_seq_smf_t *smf);
+int snd_seq_smf_read(snd_seq_smf_t *smf, snd_seq_event_t *evs, unsigned int count);
+int snd_seq_smf_play(snd_seq_smf_t *smf, snd_seq_t *seq, unsigned int lookahead);
+int snd_seq_smf_eof(const snd_seq_smf_t *smf);
+
+/** \} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ALSA_SEQ_SMF_H */
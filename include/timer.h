@@ -146,6 +146,7 @@ int snd_timer_query_next_device(snd_timer_query_t *handle, snd_timer_id_t *tid);
 int snd_timer_query_info(snd_timer_query_t *handle, snd_timer_ginfo_t *info);
 int snd_timer_query_params(snd_timer_query_t *handle, snd_timer_gparams_t *params);
 int snd_timer_query_status(snd_timer_query_t *handle, snd_timer_gstatus_t *status);
+int snd_timer_query_list(snd_timer_query_t *handle, snd_timer_ginfo_t ***list, unsigned int *count);
 
 int snd_timer_open(snd_timer_t **handle, const char *name, int mode);
 int snd_timer_open_lconf(snd_timer_t **handle, const char *name, int mode, snd_config_t *lconf);
@@ -156,6 +157,8 @@ snd_timer_t *snd_async_handler_get_timer(snd_async_handler_t *handler);
 int snd_timer_poll_descriptors_count(snd_timer_t *handle);
 int snd_timer_poll_descriptors(snd_timer_t *handle, struct pollfd *pfds, unsigned int space);
 int snd_timer_poll_descriptors_revents(snd_timer_t *timer, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
+int snd_timer_evloop_add(snd_evloop_t *loop, snd_evloop_source_t **srcp, snd_timer_t *timer,
+		snd_evloop_callback_t callback, void *private_data);
 int snd_timer_info(snd_timer_t *handle, snd_timer_info_t *timer);
 int snd_timer_params(snd_timer_t *handle, snd_timer_params_t *params);
 int snd_timer_status(snd_timer_t *handle, snd_timer_status_t *status);
@@ -163,6 +166,7 @@ int snd_timer_start(snd_timer_t *handle);
 int snd_timer_stop(snd_timer_t *handle);
 int snd_timer_continue(snd_timer_t *handle);
 ssize_t snd_timer_read(snd_timer_t *handle, void *buffer, size_t size);
+long snd_timer_read_ticks(snd_timer_t *handle, unsigned long *resolution, snd_htimestamp_t *tstamp);
 
 size_t snd_timer_id_sizeof(void);
 /** allocate #snd_timer_id_t container on stack */
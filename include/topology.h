@@ -673,6 +673,18 @@ void snd_tplg_free(snd_tplg_t *tplg);
 int snd_tplg_build_file(snd_tplg_t *tplg, const char *infile,
 	const char *outfile);
 
+/**
+ * \brief Keep the binaries built from text files in a cache directory.
+ * \param tplg Topology instance.
+ * \param dir Existing cache directory, NULL disables the cache.
+ * \return Zero on success, otherwise a negative error code
+ *
+ * snd_tplg_build_file() then keys each build on the content of the
+ * configuration with its includes and data files and reuses the binary
+ * of an earlier build with the same key without parsing the topology.
+ */
+int snd_tplg_set_cache(snd_tplg_t *tplg, const char *dir);
+
 /**
  * \brief Enable verbose reporting of binary file output
  * \param tplg Topology Instance
@@ -680,6 +692,18 @@ int snd_tplg_build_file(snd_tplg_t *tplg, const char *infile,
  */
 void snd_tplg_verbose(snd_tplg_t *tplg, int verbose);
 
+/**
+ * \brief Build the elements of each pass on several threads.
+ * \param tplg Topology Instance
+ * \param threads Number of threads, 0 or 1 builds in the calling thread
+ * \return Zero on success, otherwise a negative error code
+ *
+ * The data, control and widget elements are built in parallel, the
+ * passes themselves and the binary output keep their order, so the
+ * output does not depend on the number of threads.
+ */
+int snd_tplg_set_threads(snd_tplg_t *tplg, unsigned int threads);
+
 /** \struct snd_tplg_tlv_template
  * \brief Template type for all TLV objects.
  */
@@ -911,6 +935,15 @@ int snd_tplg_add_object(snd_tplg_t *tplg, snd_tplg_obj_template_t *t);
  */
 int snd_tplg_build(snd_tplg_t *tplg, const char *outfile);
 
+/**
+ * \brief Build all registered topology data into a binary in memory.
+ * \param tplg Topology instance.
+ * \param bin Returned binary topology, free it with free().
+ * \param size Returned size of the binary in bytes.
+ * \return Zero on success, otherwise a negative error code
+ */
+int snd_tplg_build_bin(snd_tplg_t *tplg, void **bin, size_t *size);
+
 /**
  * \brief Attach private data to topology manifest.
  * \param tplg Topology instance.
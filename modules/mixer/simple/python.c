@@ -27,6 +27,7 @@
 
 struct python_priv {
 	int py_initialized;
+	PyThreadState *py_tstate;	/* for the event callbacks */
 	PyObject *py_event_func;
 	PyObject *py_mdict;
 	PyObject *py_mixer;
@@ -56,20 +57,76 @@ struct pymixer {
 
 static PyInterpreterState *main_interpreter;
 
+/*
+ * The interned names of the looked up attributes; each ops call used to
+ * intern (and leak) its attribute name again.  Dropped in
+ * alsa_mixer_simple_free() before the interpreter goes away.
+ */
+static struct pyattr {
+	char *name;
+	PyObject *obj;
+} *pyattrs;
+static int pyattr_count;
+
+static PyObject *attr_name(const char *attr)
+{
+	struct pyattr *a;
+	PyObject *obj;
+	char *name;
+	int idx;
+
+	for (idx = 0; idx < pyattr_count; idx++) {
+		if (!strcmp(pyattrs[idx].name, attr))
+			return pyattrs[idx].obj;
+	}
+	obj = PyString_InternFromString(attr);
+	if (obj == NULL)
+		return NULL;
+	name = strdup(attr);
+	a = name ? realloc(pyattrs, sizeof(*a) * (pyattr_count + 1)) : NULL;
+	if (a == NULL) {
+		free(name);
+		return obj;	/* leaked like before, but still usable */
+	}
+	a[pyattr_count].name = name;
+	a[pyattr_count].obj = obj;
+	pyattrs = a;
+	pyattr_count++;
+	return obj;
+}
+
+static void attr_names_free(void)
+{
+	int idx;
+
+	for (idx = 0; idx < pyattr_count; idx++) {
+		free(pyattrs[idx].name);
+		Py_DECREF(pyattrs[idx].obj);
+	}
+	free(pyattrs);
+	pyattrs = NULL;
+	pyattr_count = 0;
+}
+
 static void *get_C_ptr(PyObject *obj, const char *attr)
 {
-	PyObject *o;
+	PyObject *name, *o;
+	void *ptr;
 
-	o = PyObject_GetAttr(obj, PyString_InternFromString(attr));
+	name = attr_name(attr);
+	o = name ? PyObject_GetAttr(obj, name) : NULL;
 	if (!o) {
 		PyErr_Format(PyExc_TypeError, "missing '%s' attribute", attr);
 		return NULL;
 	}
 	if (!PyInt_Check(o)) {
 		PyErr_Format(PyExc_TypeError, "'%s' attribute is not integer", attr);
+		Py_DECREF(o);
 		return NULL;
 	}
-	return (void *)PyInt_AsLong(o);
+	ptr = (void *)PyInt_AsLong(o);
+	Py_DECREF(o);
+	return ptr;
 }
 
 static struct pymelem *melem_to_pymelem(snd_mixer_elem_t *elem)
@@ -79,12 +136,13 @@ static struct pymelem *melem_to_pymelem(snd_mixer_elem_t *elem)
 
 static int pcall(struct pymelem *pymelem, const char *attr, PyObject *args, PyObject **_res)
 {
-	PyObject *obj = (PyObject *)pymelem, *res;
+	PyObject *obj = (PyObject *)pymelem, *name, *res;
 	int xres = 0;
 
 	if (_res)
 		*_res = NULL;
-	obj = PyObject_GetAttr(obj, PyString_InternFromString(attr));
+	name = attr_name(attr);
+	obj = name ? PyObject_GetAttr(obj, name) : NULL;
 	if (!obj) {
 		PyErr_Format(PyExc_TypeError, "missing '%s' attribute", attr);
 		PyErr_Print();
@@ -93,6 +151,7 @@ static int pcall(struct pymelem *pymelem, const char *attr, PyObject *args, PyOb
 		return -EIO;
 	}
 	res = PyObject_CallObject(obj, args);
+	Py_DECREF(obj);
 	Py_XDECREF(args);
 	if (res == NULL) {
 		PyErr_Print();
@@ -910,12 +969,17 @@ int alsa_mixer_simple_event(snd_mixer_class_t *class, unsigned int mask,
 			    snd_hctl_elem_t *helem, snd_mixer_elem_t *melem)
 {
 	struct python_priv *priv = snd_mixer_sbasic_get_private(class);
-	PyThreadState *tstate, *origstate;
+	PyThreadState *origstate;
 	PyObject *t, *o, *r;
 	int res = -ENOMEM;
 
-	tstate = PyThreadState_New(main_interpreter);
-        origstate = PyThreadState_Swap(tstate);
+	/* one thread state serves all events of the class */
+	if (priv->py_tstate == NULL) {
+		priv->py_tstate = PyThreadState_New(main_interpreter);
+		if (priv->py_tstate == NULL)
+			return -ENOMEM;
+	}
+        origstate = PyThreadState_Swap(priv->py_tstate);
         
         t = PyTuple_New(3);
         if (t) {
@@ -925,8 +989,11 @@ int alsa_mixer_simple_event(snd_mixer_class_t *class, unsigned int mask,
 	        	if (o == NULL)
         			o = new_helem(priv, helem);
 		}
-        	if (o == NULL)
+        	if (o == NULL) {
+        		Py_DECREF(t);
+        		PyThreadState_Swap(origstate);
         		return 0;
+		}
         	if (PyTuple_SET_ITEM(t, 1, o))
         		Py_INCREF(o);
         	o = melem ? find_melem(priv, melem) : Py_None;
@@ -947,7 +1014,7 @@ int alsa_mixer_simple_event(snd_mixer_class_t *class, unsigned int mask,
 			res = -EIO;
 		}
 	}
-	
+	PyThreadState_Swap(origstate);
 	return res;
 }
 
@@ -959,8 +1026,13 @@ static void alsa_mixer_simple_free(snd_mixer_class_t *class)
 		pymixer_free((struct pymixer *)priv->py_mixer);
 		Py_DECREF(priv->py_mixer);
 	}
+	if (priv->py_tstate) {
+		PyThreadState_Clear(priv->py_tstate);
+		PyThreadState_Delete(priv->py_tstate);
+	}
 	if (priv->py_initialized) {
 		Py_XDECREF(priv->py_event_func);
+		attr_names_free();
 		Py_Finalize();
 	}
 	free(priv);
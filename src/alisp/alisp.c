@@ -26,6 +26,7 @@
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
@@ -58,14 +59,15 @@ static int alisp_include_file(struct alisp_instance *instance, const char *filen
  *  object handling
  */
 
+/* FNV-1a */
 static int get_string_hash(const char *s)
 {
-	int val = 0;
+	unsigned int val = 2166136261u;
 	if (s == NULL)
-		return val;
+		return 0;
 	while (*s)
-		val += *s++;
-	return val & ALISP_OBJ_PAIR_HASH_MASK;
+		val = (val ^ (unsigned char)*s++) * 16777619u;
+	return (val ^ (val >> 16)) & ALISP_OBJ_PAIR_HASH_MASK;
 }
 
 static void nomem(void)
@@ -130,18 +132,26 @@ static struct alisp_object * new_object(struct alisp_instance *instance, int typ
 	struct alisp_object * p;
 
 	if (list_empty(&instance->free_objs_list)) {
-		p = (struct alisp_object *)malloc(sizeof(struct alisp_object));
-		if (p == NULL) {
+		struct alisp_object_chunk *chunk;
+		int i;
+
+		/* the objects are kept in chunks until the instance is freed */
+		chunk = malloc(sizeof(*chunk));
+		if (chunk == NULL) {
 			nomem();
 			return NULL;
 		}
-		lisp_debug(instance, "allocating cons %p", p);
-	} else {
-		p = (struct alisp_object *)instance->free_objs_list.next;
-		list_del(&p->list);
-		instance->free_objs--;
-		lisp_debug(instance, "recycling cons %p", p);
-	}
+		lisp_debug(instance, "allocating chunk %p", chunk);
+		chunk->next = instance->chunks;
+		instance->chunks = chunk;
+		for (i = ALISP_OBJ_CHUNK - 1; i >= 0; i--)
+			list_add(&chunk->objs[i].list, &instance->free_objs_list);
+		instance->free_objs += ALISP_OBJ_CHUNK;
+	}
+	p = (struct alisp_object *)instance->free_objs_list.next;
+	list_del(&p->list);
+	instance->free_objs--;
+	lisp_debug(instance, "recycling cons %p", p);
 
 	instance->used_objs++;
 
@@ -188,11 +198,6 @@ static void delete_object(struct alisp_instance *instance, struct alisp_object *
 	list_del(&p->list);
 	instance->used_objs--;
 	free_object(p);
-	if (instance->free_objs >= ALISP_FREE_OBJ_POOL) {
-		lisp_debug(instance, "freed cons %p", p);
-		free(p);
-		return;
-	}
 	lisp_debug(instance, "moved cons %p to free list", p);
 	list_add(&p->list, &instance->free_objs_list);
 	instance->free_objs++;
@@ -286,12 +291,14 @@ static void free_objects(struct alisp_instance *instance)
 				delete_object(instance, p);
 			}
 		}
-	list_for_each_safe(pos, pos1, &instance->free_objs_list) {
-		p = list_entry(pos, struct alisp_object, list);
-		list_del(&p->list);
-		free(p);
-		lisp_debug(instance, "freed (all) cons %p", p);
+	while (instance->chunks) {
+		struct alisp_object_chunk *chunk = instance->chunks;
+		instance->chunks = chunk->next;
+		lisp_debug(instance, "freed chunk %p", chunk);
+		free(chunk);
 	}
+	INIT_LIST_HEAD(&instance->free_objs_list);
+	instance->free_objs = 0;
 }
 
 static struct alisp_object * search_object_identifier(struct alisp_instance *instance, const char *s)
@@ -497,11 +504,34 @@ void alsa_lisp_init_objects(void)
  * lexer
  */ 
 
+/* read the input from its span when it has one, like the config parser */
+static void xsetin(struct alisp_instance *instance, snd_input_t *in)
+{
+	const char *data;
+	size_t size;
+
+	instance->in = in;
+	instance->in_ptr = instance->in_end = NULL;
+	instance->compiled = 0;
+	if (snd_input_span(in, &data, &size) >= 0 && data) {
+		instance->in_ptr = data;
+		instance->in_end = data + size;
+		if (size >= ALISP_COMPILED_MAGIC_SIZE &&
+		    !memcmp(data, ALISP_COMPILED_MAGIC, ALISP_COMPILED_MAGIC_SIZE)) {
+			instance->in_ptr += ALISP_COMPILED_MAGIC_SIZE;
+			instance->compiled = 1;
+		}
+	}
+}
+
 static int xgetc(struct alisp_instance *instance)
 {
 	instance->charno++;
 	if (instance->lex_bufp > instance->lex_buf)
 		return *--(instance->lex_bufp);
+	if (instance->in_ptr)
+		return instance->in_ptr < instance->in_end ?
+			(unsigned char)*instance->in_ptr++ : EOF;
 	return snd_input_getc(instance->in);
 }
 
@@ -820,6 +850,169 @@ static struct alisp_object * parse_object(struct alisp_instance *instance, int h
 	return p;
 }
 
+/*
+ *  compiled forms
+ *
+ *  The parsed objects in prefix order, read back without lexing; see
+ *  alsa_lisp_compile().  Numbers are kept in the byte order of the host.
+ */
+
+static int compile_bytes(snd_output_t *out, const void *data, size_t size)
+{
+	const unsigned char *p = data;
+	int err;
+
+	while (size-- > 0) {
+		err = snd_output_putc(out, *p++);
+		if (err < 0)
+			return err;
+	}
+	return 0;
+}
+
+static int compile_text(snd_output_t *out, int tag, const char *s)
+{
+	uint32_t len = strlen(s);
+	int err;
+
+	err = snd_output_putc(out, tag);
+	if (err >= 0)
+		err = compile_bytes(out, &len, sizeof(len));
+	if (err >= 0)
+		err = compile_bytes(out, s, len);
+	return err;
+}
+
+static int compile_object(snd_output_t *out, struct alisp_object * p)
+{
+	int64_t i;
+	int err;
+
+	for (;;) {
+		switch (alisp_get_type(p)) {
+		case ALISP_OBJ_NIL:
+			return snd_output_putc(out, ALISP_TAG_NIL);
+		case ALISP_OBJ_T:
+			return snd_output_putc(out, ALISP_TAG_T);
+		case ALISP_OBJ_INTEGER:
+			i = p->value.i;
+			err = snd_output_putc(out, ALISP_TAG_INTEGER);
+			return err < 0 ? err : compile_bytes(out, &i, sizeof(i));
+		case ALISP_OBJ_FLOAT:
+			err = snd_output_putc(out, ALISP_TAG_FLOAT);
+			return err < 0 ? err : compile_bytes(out, &p->value.f, sizeof(p->value.f));
+		case ALISP_OBJ_IDENTIFIER:
+			return compile_text(out, ALISP_TAG_IDENTIFIER, p->value.s);
+		case ALISP_OBJ_STRING:
+			return compile_text(out, ALISP_TAG_STRING, p->value.s);
+		case ALISP_OBJ_CONS:
+			err = snd_output_putc(out, ALISP_TAG_CONS);
+			if (err >= 0)
+				err = compile_object(out, p->value.c.car);
+			if (err < 0)
+				return err;
+			p = p->value.c.cdr;
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+}
+
+static int decode_bytes(struct alisp_instance *instance, void *data, size_t size)
+{
+	if ((size_t)(instance->in_end - instance->in_ptr) < size)
+		return -EINVAL;
+	memcpy(data, instance->in_ptr, size);
+	instance->in_ptr += size;
+	return 0;
+}
+
+static struct alisp_object * decode_text(struct alisp_instance *instance, int tag)
+{
+	struct alisp_object * p;
+	uint32_t len;
+	char *s;
+
+	if (decode_bytes(instance, &len, sizeof(len)) < 0 ||
+	    (size_t)(instance->in_end - instance->in_ptr) < len)
+		return NULL;
+	s = malloc(len + 1);
+	if (s == NULL) {
+		nomem();
+		return NULL;
+	}
+	memcpy(s, instance->in_ptr, len);
+	s[len] = '\0';
+	instance->in_ptr += len;
+	if (tag == ALISP_TAG_STRING)
+		p = new_string(instance, s);
+	else
+		p = new_identifier(instance, s);
+	free(s);
+	return p;
+}
+
+static struct alisp_object * decode_object(struct alisp_instance *instance)
+{
+	struct alisp_object * p;
+	unsigned char tag;
+	int64_t i;
+	double f;
+
+	if (decode_bytes(instance, &tag, 1) < 0)
+		return NULL;
+	switch (tag) {
+	case ALISP_TAG_NIL:
+		return &alsa_lisp_nil;
+	case ALISP_TAG_T:
+		return &alsa_lisp_t;
+	case ALISP_TAG_INTEGER:
+		if (decode_bytes(instance, &i, sizeof(i)) < 0)
+			return NULL;
+		return new_integer(instance, i);
+	case ALISP_TAG_FLOAT:
+		if (decode_bytes(instance, &f, sizeof(f)) < 0)
+			return NULL;
+		return new_float(instance, f);
+	case ALISP_TAG_IDENTIFIER:
+	case ALISP_TAG_STRING:
+		return decode_text(instance, tag);
+	case ALISP_TAG_CONS:
+		p = new_object(instance, ALISP_OBJ_CONS);
+		if (p == NULL)
+			return NULL;
+		p->value.c.car = decode_object(instance);
+		if (p->value.c.car)
+			p->value.c.cdr = decode_object(instance);
+		if (p->value.c.car == NULL || p->value.c.cdr == NULL) {
+			if (p->value.c.car == NULL)
+				p->value.c.car = &alsa_lisp_nil;
+			p->value.c.cdr = &alsa_lisp_nil;
+			delete_tree(instance, p);
+			return NULL;
+		}
+		return p;
+	default:
+		return NULL;
+	}
+}
+
+/* the next top level form of the input, NULL at its end */
+static struct alisp_object * read_object(struct alisp_instance *instance)
+{
+	struct alisp_object * p;
+
+	if (!instance->compiled)
+		return parse_object(instance, 0);
+	if (instance->in_ptr >= instance->in_end)
+		return NULL;
+	p = decode_object(instance);
+	if (p == NULL)
+		lisp_warn(instance, "bad compiled form");
+	return p;
+}
+
 /*
  *  object manipulation
  */
@@ -3147,7 +3340,9 @@ static struct alisp_object * F_eval(struct alisp_instance *instance, struct alis
 
 static int alisp_include_file(struct alisp_instance *instance, const char *filename)
 {
-	snd_input_t *old_in;
+	snd_input_t *old_in, *in;
+	const char *old_ptr, *old_end;
+	int old_compiled;
 	struct alisp_object *p, *p1;
 	char *name;
 	int retval = 0, err;
@@ -3156,16 +3351,20 @@ static int alisp_include_file(struct alisp_instance *instance, const char *filen
 	if (err < 0)
 		return err;
 	old_in = instance->in;
-	err = snd_input_stdio_open(&instance->in, name, "r");
+	old_ptr = instance->in_ptr;
+	old_end = instance->in_end;
+	old_compiled = instance->compiled;
+	err = snd_input_stdio_open(&in, name, "r");
 	if (err < 0) {
 		retval = err;
 		goto _err;
 	}
+	xsetin(instance, in);
 	if (instance->verbose)
 		lisp_verbose(instance, "** include filename '%s'", name);
 
 	for (;;) {
-		if ((p = parse_object(instance, 0)) == NULL)
+		if ((p = read_object(instance)) == NULL)
 			break;
 		if (instance->verbose) {
 			lisp_verbose(instance, "** code");
@@ -3193,24 +3392,26 @@ static int alisp_include_file(struct alisp_instance *instance, const char *filen
        _err:
 	free(name);
 	instance->in = old_in;
+	instance->in_ptr = old_ptr;
+	instance->in_end = old_end;
+	instance->compiled = old_compiled;
 	return retval;
 }
  
-int alsa_lisp(struct alisp_cfg *cfg, struct alisp_instance **_instance)
+static struct alisp_instance *new_instance(struct alisp_cfg *cfg)
 {
 	struct alisp_instance *instance;
-	struct alisp_object *p, *p1;
-	int i, j, retval = 0;
+	int i, j;
 	
 	instance = (struct alisp_instance *)calloc(1, sizeof(struct alisp_instance));
 	if (instance == NULL) {
 		nomem();
-		return -ENOMEM;
+		return NULL;
 	}
 	instance->verbose = cfg->verbose && cfg->vout;
 	instance->warning = cfg->warning && cfg->wout;
 	instance->debug = cfg->debug && cfg->dout;
-	instance->in = cfg->in;
+	xsetin(instance, cfg->in);
 	instance->out = cfg->out;
 	instance->vout = cfg->vout;
 	instance->eout = cfg->eout;
@@ -3224,9 +3425,21 @@ int alsa_lisp(struct alisp_cfg *cfg, struct alisp_instance **_instance)
 	}
 	
 	init_lex(instance);
+	return instance;
+}
+
+int alsa_lisp(struct alisp_cfg *cfg, struct alisp_instance **_instance)
+{
+	struct alisp_instance *instance;
+	struct alisp_object *p, *p1;
+	int retval = 0;
+
+	instance = new_instance(cfg);
+	if (instance == NULL)
+		return -ENOMEM;
 
 	for (;;) {
-		if ((p = parse_object(instance, 0)) == NULL)
+		if ((p = read_object(instance)) == NULL)
 			break;
 		if (instance->verbose) {
 			lisp_verbose(instance, "** code");
@@ -3258,6 +3471,28 @@ int alsa_lisp(struct alisp_cfg *cfg, struct alisp_instance **_instance)
 	return retval;
 }
 
+/*
+ * Write the forms of the program as compiled forms, which alsa_lisp()
+ * and include read without lexing and parsing.
+ */
+int alsa_lisp_compile(struct alisp_cfg *cfg, snd_output_t *out)
+{
+	struct alisp_instance *instance;
+	struct alisp_object *p;
+	int err;
+
+	instance = new_instance(cfg);
+	if (instance == NULL)
+		return -ENOMEM;
+	err = compile_bytes(out, ALISP_COMPILED_MAGIC, ALISP_COMPILED_MAGIC_SIZE);
+	while (err >= 0 && (p = read_object(instance)) != NULL) {
+		err = compile_object(out, p);
+		delete_tree(instance, p);
+	}
+	alsa_lisp_free(instance);
+	return err < 0 ? err : 0;
+}
+
 void alsa_lisp_free(struct alisp_instance *instance)
 {
 	if (instance == NULL)
@@ -116,10 +116,28 @@ struct alisp_object_pair {
 };
 
 #define ALISP_LEX_BUF_MAX	16
-#define ALISP_OBJ_PAIR_HASH_SHIFT 4
+#define ALISP_COMPILED_MAGIC	"\0alisp1\n"	/* starts compiled forms */
+#define ALISP_COMPILED_MAGIC_SIZE 8
+
+/* the tags of compiled objects */
+enum alisp_compiled_tags {
+	ALISP_TAG_NIL = 1,
+	ALISP_TAG_T,
+	ALISP_TAG_INTEGER,	/* int64_t */
+	ALISP_TAG_FLOAT,	/* double */
+	ALISP_TAG_IDENTIFIER,	/* uint32_t length, bytes */
+	ALISP_TAG_STRING,	/* uint32_t length, bytes */
+	ALISP_TAG_CONS,		/* car, cdr */
+};
+#define ALISP_OBJ_PAIR_HASH_SHIFT 8
 #define ALISP_OBJ_PAIR_HASH_SIZE (1<<ALISP_OBJ_PAIR_HASH_SHIFT)
 #define ALISP_OBJ_PAIR_HASH_MASK (ALISP_OBJ_PAIR_HASH_SIZE-1)
-#define ALISP_FREE_OBJ_POOL	512	/* free objects above this pool */
+#define ALISP_OBJ_CHUNK		256	/* objects allocated at once */
+
+struct alisp_object_chunk {
+	struct alisp_object_chunk *next;
+	struct alisp_object objs[ALISP_OBJ_CHUNK];
+};
 
 struct alisp_instance {
 	int verbose: 1,
@@ -133,6 +151,9 @@ struct alisp_instance {
 	snd_output_t *wout;	/* warning output */
 	snd_output_t *dout;	/* debug output */
 	/* lexer */
+	const char *in_ptr;	/* the read position in the span of in */
+	const char *in_end;
+	int compiled;		/* the span holds compiled forms */
 	int charno;
 	int lineno;
 	int lex_buf[ALISP_LEX_BUF_MAX];
@@ -144,6 +165,7 @@ struct alisp_instance {
 	long free_objs;
 	long used_objs;
 	long max_objs;
+	struct alisp_object_chunk *chunks;
 	struct list_head free_objs_list;
 	struct list_head used_objs_list[ALISP_OBJ_PAIR_HASH_SIZE][ALISP_OBJ_LAST_SEARCH + 1];
 	/* set object */
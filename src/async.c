@@ -27,6 +27,11 @@
 #include "pcm/pcm_local.h"
 #include "control/control_local.h"
 #include <signal.h>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
 
 static struct sigaction previous_action;
 #define MAX_SIG_FUNCTION_CODE 10 /* i.e. SIG_DFL SIG_IGN SIG_HOLD et al */
@@ -52,6 +57,202 @@ static const int snd_async_signo = SIGIO;
 
 static LIST_HEAD(snd_async_handlers);
 
+#ifdef HAVE_LIBPTHREAD
+/*
+ * With snd_async_use_thread() the handlers are served by a thread
+ * waiting on an epoll set instead of a signal.  Each handler adds a dup
+ * of its descriptor to the set, so several handlers of one descriptor
+ * get an entry each and an event finds its handler at once.  The edge
+ * triggered entries fire on each wakeup of the driver, like the signal.
+ *
+ * A deleted handler is kept on the zombie list until the thread is done
+ * with the events it already got, then the thread frees it.
+ */
+static int snd_async_thread;
+static int snd_async_epoll_fd = -1;
+static int snd_async_wake_fd = -1;
+static LIST_HEAD(snd_async_zombies);
+static pthread_mutex_t snd_async_mutex;
+static pthread_once_t snd_async_mutex_once = PTHREAD_ONCE_INIT;
+
+static void snd_async_init_mutex(void)
+{
+	pthread_mutexattr_t attr;
+
+	/* a callback may delete handlers */
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&snd_async_mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+static inline void snd_async_lock(void)
+{
+	pthread_once(&snd_async_mutex_once, snd_async_init_mutex);
+	pthread_mutex_lock(&snd_async_mutex);
+}
+
+static inline void snd_async_unlock(void)
+{
+	pthread_mutex_unlock(&snd_async_mutex);
+}
+
+static void *snd_async_dispatcher(void *arg ATTRIBUTE_UNUSED)
+{
+	struct epoll_event events[32];
+	snd_async_handler_t *h;
+	uint64_t cnt;
+	int i, n;
+
+	for (;;) {
+		n = epoll_wait(snd_async_epoll_fd, events, 32, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			SYSERR("epoll_wait");
+			return NULL;
+		}
+		snd_async_lock();
+		for (i = 0; i < n; i++) {
+			h = events[i].data.ptr;
+			if (!h) {
+				if (read(snd_async_wake_fd, &cnt, sizeof(cnt)) < 0)
+					continue;
+				continue;
+			}
+			if (h->callback)
+				h->callback(h);
+		}
+		while (!list_empty(&snd_async_zombies)) {
+			h = list_entry(snd_async_zombies.next, snd_async_handler_t, glist);
+			list_del(&h->glist);
+			free(h);
+		}
+		snd_async_unlock();
+	}
+}
+
+static int snd_async_start_thread(void)
+{
+	struct epoll_event ev;
+	pthread_attr_t attr;
+	pthread_t thread;
+	int err;
+
+	if (snd_async_epoll_fd >= 0)
+		return 0;
+	snd_async_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (snd_async_epoll_fd < 0) {
+		SYSERR("epoll_create1");
+		return -errno;
+	}
+	snd_async_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (snd_async_wake_fd < 0) {
+		SYSERR("eventfd");
+		err = -errno;
+		goto _err;
+	}
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	if (epoll_ctl(snd_async_epoll_fd, EPOLL_CTL_ADD, snd_async_wake_fd, &ev) < 0) {
+		SYSERR("epoll_ctl");
+		err = -errno;
+		goto _err;
+	}
+	/* the thread serves the process until it exits */
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	err = -snd_thread_create(&thread, &attr, snd_async_dispatcher, NULL);
+	pthread_attr_destroy(&attr);
+	if (err == 0)
+		return 0;
+ _err:
+	if (snd_async_wake_fd >= 0)
+		close(snd_async_wake_fd);
+	close(snd_async_epoll_fd);
+	snd_async_wake_fd = snd_async_epoll_fd = -1;
+	return err;
+}
+
+static int snd_async_thread_add(snd_async_handler_t *h)
+{
+	struct epoll_event ev;
+	int err;
+
+	err = snd_async_start_thread();
+	if (err < 0)
+		return err;
+	h->dfd = fcntl(h->fd, F_DUPFD_CLOEXEC, 0);
+	if (h->dfd < 0) {
+		SYSERR("fcntl");
+		return -errno;
+	}
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLERR | EPOLLET;
+	ev.data.ptr = h;
+	if (epoll_ctl(snd_async_epoll_fd, EPOLL_CTL_ADD, h->dfd, &ev) < 0) {
+		err = -errno;
+		SYSERR("epoll_ctl");
+		close(h->dfd);
+		return err;
+	}
+	return 0;
+}
+
+static void snd_async_thread_del(snd_async_handler_t *h)
+{
+	uint64_t one = 1;
+
+	epoll_ctl(snd_async_epoll_fd, EPOLL_CTL_DEL, h->dfd, NULL);
+	close(h->dfd);
+	h->callback = NULL;
+	list_add_tail(&h->glist, &snd_async_zombies);
+	if (write(snd_async_wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		SYSERR("write");
+}
+
+/**
+ * \brief Serves the async handlers from a thread instead of a signal.
+ * \param enable 1 to use the dispatcher thread, 0 to use the signal
+ * \result Zero if successful, otherwise a negative error code.
+ *
+ * The mode can be changed only while no async handler is registered.
+ * With the thread, the callbacks run in a thread of the library that
+ * waits for the descriptors of the handlers with epoll, no signal is
+ * raised and #snd_async_handler_get_signo returns 0.  The callbacks of
+ * all handlers are serialized; they may delete handlers.  A callback
+ * does not run anymore once #snd_async_del_handler has returned, unless
+ * that was called from a callback.
+ */
+int snd_async_use_thread(int enable)
+{
+	int err = 0;
+
+	snd_async_lock();
+	if (!list_empty(&snd_async_handlers))
+		err = -EBUSY;
+	else
+		snd_async_thread = !!enable;
+	snd_async_unlock();
+	return err;
+}
+#else
+/**
+ * \brief Serves the async handlers from a thread instead of a signal.
+ * \param enable 1 to use the dispatcher thread, 0 to use the signal
+ * \result Zero if successful, otherwise a negative error code.
+ *
+ * The library is built without threads; only the signal is available.
+ */
+int snd_async_use_thread(int enable)
+{
+	return enable ? -ENOSYS : 0;
+}
+
+#define snd_async_thread	0
+static inline void snd_async_lock(void) {}
+static inline void snd_async_unlock(void) {}
+#endif
+
 static void snd_async_handler(int signo ATTRIBUTE_UNUSED, siginfo_t *siginfo, void *context ATTRIBUTE_UNUSED)
 {
 	int fd;
@@ -109,9 +310,27 @@ int snd_async_add_handler(snd_async_handler_t **handler, int fd,
 	h->fd = fd;
 	h->callback = callback;
 	h->private_data = private_data;
+	h->type = SND_ASYNC_HANDLER_GENERIC;
+	h->dfd = -1;
+	INIT_LIST_HEAD(&h->hlist);
+#ifdef HAVE_LIBPTHREAD
+	snd_async_lock();
+	if (snd_async_thread) {
+		int err = snd_async_thread_add(h);
+		if (err < 0) {
+			snd_async_unlock();
+			free(h);
+			return err;
+		}
+		list_add_tail(&h->glist, &snd_async_handlers);
+		snd_async_unlock();
+		*handler = h;
+		return 0;
+	}
+	snd_async_unlock();
+#endif
 	was_empty = list_empty(&snd_async_handlers);
 	list_add_tail(&h->glist, &snd_async_handlers);
-	INIT_LIST_HEAD(&h->hlist);
 	*handler = h;
 	if (was_empty) {
 		int err;
@@ -138,9 +357,22 @@ int snd_async_add_handler(snd_async_handler_t **handler, int fd,
 int snd_async_del_handler(snd_async_handler_t *handler)
 {
 	int err = 0;
-	int was_empty = list_empty(&snd_async_handlers);
+	int was_empty;
 	assert(handler);
+	snd_async_lock();
+	was_empty = list_empty(&snd_async_handlers);
 	list_del(&handler->glist);
+	if (snd_async_thread) {
+		/* the device never got the signal set */
+		if (!list_empty(&handler->hlist))
+			list_del(&handler->hlist);
+#ifdef HAVE_LIBPTHREAD
+		snd_async_thread_del(handler);
+#endif
+		snd_async_unlock();
+		return 0;
+	}
+	snd_async_unlock();
 	if (!was_empty
 	 && list_empty(&snd_async_handlers)) {
 		err = sigaction(snd_async_signo, &previous_action, NULL);
@@ -180,11 +412,14 @@ int snd_async_del_handler(snd_async_handler_t *handler)
  *
  * The signal number for async handlers usually is \c SIGIO,
  * but wizards can redefine it to a realtime signal
- * when compiling the ALSA library.
+ * when compiling the ALSA library.  It is 0 for handlers served by
+ * the dispatcher thread, see #snd_async_use_thread.
  */
 int snd_async_handler_get_signo(snd_async_handler_t *handler)
 {
 	assert(handler);
+	if (handler->dfd >= 0)
+		return 0;
 	return snd_async_signo;
 }
 
@@ -417,7 +417,10 @@ beginning:</P>
 #include "local.h"
 #include <stdarg.h>
 #include <limits.h>
+#include <stdint.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/inotify.h>
 #include <dirent.h>
 #include <locale.h>
 #ifdef HAVE_LIBPTHREAD
@@ -444,16 +447,39 @@ struct _snd_config {
 		struct {
 			struct list_head fields;
 			int join;
+			struct config_index *index;	/* built on demand */
 		} compound;
 	} u;
 	struct list_head list;
 	snd_config_t *parent;
+	snd_config_t *hash_next;	/* chain in the index of the parent */
 	int hop;
 };
 
+/*
+ * Compounds with many children (like pcm and ctl at the root) get a hash
+ * index of their children at the first search.  The index chains the
+ * nodes through hash_next in their list order and is kept up to date on
+ * every change of the children; fields stays the iteration order.
+ */
+#define CONFIG_INDEX_MIN	32
+
+struct config_index {
+	unsigned int mask;
+	unsigned int count;
+	snd_config_t *bucket[0];
+};
+
+/*
+ * When the input can hand out its contents as one block (see
+ * snd_input_span()), ptr is the read position in it and strings are
+ * taken as slices of it; otherwise ptr is NULL and the input is read
+ * with snd_input_getc().
+ */
 struct filedesc {
 	char *name;
 	snd_input_t *in;
+	const char *base, *ptr, *end;
 	unsigned int line, column;
 	struct filedesc *next;
 };
@@ -469,6 +495,7 @@ typedef struct {
 	struct filedesc *current;
 	int unget;
 	int ch;
+	unsigned int includes;		/* count of <file> includes */
 } input_t;
 
 #ifdef HAVE_LIBPTHREAD
@@ -494,10 +521,62 @@ static inline void snd_config_unlock(void)
 	pthread_mutex_unlock(&snd_config_update_mutex);
 }
 
+/*
+ * snd_config and snd_config_global_update are replaced with the update
+ * mutex held and this lock held for writing.  Taking a reference of an
+ * unchanged snd_config needs the lock for reading only, so such readers
+ * do not wait for each other.  Hooks run by the writer may open devices
+ * and so come back as readers or writers; the writer thread is recorded
+ * to let them through.
+ */
+static pthread_rwlock_t snd_config_global_rwlock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_t snd_config_global_writer;
+static int snd_config_global_depth;
+
+static inline int snd_config_global_owned(void)
+{
+	return __atomic_load_n(&snd_config_global_depth, __ATOMIC_RELAXED) &&
+	       pthread_equal(snd_config_global_writer, pthread_self());
+}
+
+/* returns 1 if the lock was taken and must be released */
+static inline int snd_config_global_rdlock(void)
+{
+	if (snd_config_global_owned())
+		return 0;
+	pthread_rwlock_rdlock(&snd_config_global_rwlock);
+	return 1;
+}
+
+static inline void snd_config_global_rdunlock(int locked)
+{
+	if (locked)
+		pthread_rwlock_unlock(&snd_config_global_rwlock);
+}
+
+static inline void snd_config_global_wrlock(void)
+{
+	if (!snd_config_global_owned()) {
+		pthread_rwlock_wrlock(&snd_config_global_rwlock);
+		snd_config_global_writer = pthread_self();
+	}
+	__atomic_fetch_add(&snd_config_global_depth, 1, __ATOMIC_RELAXED);
+}
+
+static inline void snd_config_global_unlock(void)
+{
+	if (__atomic_sub_fetch(&snd_config_global_depth, 1, __ATOMIC_RELAXED) == 0)
+		pthread_rwlock_unlock(&snd_config_global_rwlock);
+}
+
 #else
 
 static inline void snd_config_lock(void) { }
 static inline void snd_config_unlock(void) { }
+static inline int snd_config_global_rdlock(void) { return 0; }
+static inline void snd_config_global_rdunlock(int locked ATTRIBUTE_UNUSED) { }
+static inline void snd_config_global_wrlock(void) { }
+static inline void snd_config_global_unlock(void) { }
 
 #endif
 
@@ -586,7 +665,10 @@ static int get_char(input_t *input)
 	}
  again:
 	fd = input->current;
-	c = snd_input_getc(fd->in);
+	if (fd->ptr)
+		c = fd->ptr < fd->end ? (unsigned char)*fd->ptr++ : EOF;
+	else
+		c = snd_input_getc(fd->in);
 	switch (c) {
 	case '\n':
 		fd->column = 0;
@@ -618,20 +700,55 @@ static void unget_char(int c, input_t *input)
 	input->unget = 1;
 }
 
-static int get_delimstring(char **string, int delim, input_t *input);
+#define LOCAL_STR_BUFSIZE	64
+struct local_string {
+	char *buf;
+	size_t alloc;
+	size_t idx;
+	char tmpbuf[LOCAL_STR_BUFSIZE];
+};
+
+/*
+ * A string read from the input: a slice of the input block when it
+ * could be taken as it is, otherwise collected in buf.
+ */
+struct token {
+	const char *str;
+	size_t len;
+	struct local_string buf;
+};
+
+static void filedesc_span(struct filedesc *fd)
+{
+	const char *data;
+	size_t size;
+
+	fd->base = fd->ptr = fd->end = NULL;
+	if (snd_input_span(fd->in, &data, &size) >= 0 && data) {
+		fd->base = fd->ptr = data;
+		fd->end = data + size;
+	}
+}
+
+static int get_delimstring(struct token *tok, int delim, input_t *input);
+static char *token_dup(struct token *tok);
 
 static int get_char_skip_comments(input_t *input)
 {
+	struct filedesc *fd;
 	int c;
 	while (1) {
 		c = get_char(input);
 		if (c == '<') {
 			char *str;
 			snd_input_t *in;
-			struct filedesc *fd;
-			int err = get_delimstring(&str, '>', input);
+			struct token tok;
+			int err = get_delimstring(&tok, '>', input);
 			if (err < 0)
 				return err;
+			str = token_dup(&tok);
+			if (!str)
+				return -ENOMEM;
 			if (!strncmp(str, "confdir:", 8)) {
 				char *tmp = malloc(strlen(ALSA_CONFIG_DIR) + 1 + strlen(str + 8) + 1);
 				if (tmp == NULL) {
@@ -655,14 +772,27 @@ static int get_char_skip_comments(input_t *input)
 			}
 			fd->name = str;
 			fd->in = in;
+			filedesc_span(fd);
 			fd->next = input->current;
 			fd->line = 1;
 			fd->column = 0;
 			input->current = fd;
+			input->includes++;
 			continue;
 		}
 		if (c != '#')
 			break;
+		fd = input->current;
+		if (fd->ptr) {
+			const char *nl = memchr(fd->ptr, '\n', fd->end - fd->ptr);
+			if (nl) {
+				fd->ptr = nl + 1;
+				fd->line++;
+				fd->column = 0;
+				continue;
+			}
+			/* the last line has no end, count its columns */
+		}
 		while (1) {
 			c = get_char(input);
 			if (c < 0)
@@ -731,14 +861,6 @@ static int get_quotedchar(input_t *input)
 	}
 }
 
-#define LOCAL_STR_BUFSIZE	64
-struct local_string {
-	char *buf;
-	size_t alloc;
-	size_t idx;
-	char tmpbuf[LOCAL_STR_BUFSIZE];
-};
-
 static void init_local_string(struct local_string *s)
 {
 	memset(s, 0, sizeof(*s));
@@ -773,81 +895,158 @@ static int add_char_local_string(struct local_string *s, int c)
 	return 0;
 }
 
-static char *copy_local_string(struct local_string *s)
+static int add_slice_local_string(struct local_string *s, const char *str, size_t len)
+{
+	for (; len > 0; len--)
+		if (add_char_local_string(s, (unsigned char)*str++) < 0)
+			return -ENOMEM;
+	return 0;
+}
+
+static void token_init(struct token *tok)
+{
+	init_local_string(&tok->buf);
+	tok->str = NULL;
+	tok->len = 0;
+}
+
+/* the token was collected in its buffer */
+static void token_set_buf(struct token *tok)
+{
+	tok->str = tok->buf.buf;
+	tok->len = tok->buf.idx;
+}
+
+static void token_free(struct token *tok)
 {
-	char *dst = malloc(s->idx + 1);
+	free_local_string(&tok->buf);
+}
+
+/* a malloc'ed copy of the token, which is freed */
+static char *token_dup(struct token *tok)
+{
+	char *dst = malloc(tok->len + 1);
 	if (dst) {
-		memcpy(dst, s->buf, s->idx);
-		dst[s->idx] = '\0';
+		memcpy(dst, tok->str, tok->len);
+		dst[tok->len] = '\0';
 	}
+	token_free(tok);
 	return dst;
 }
 
-static int get_freestring(char **string, int id, input_t *input)
+static inline int freestring_end(int c, int id)
 {
-	struct local_string str;
+	switch (c) {
+	case '.':
+		return id;
+	case ' ':
+	case '\f':
+	case '\t':
+	case '\n':
+	case '\r':
+	case '=':
+	case ',':
+	case ';':
+	case '{':
+	case '}':
+	case '[':
+	case ']':
+	case '\'':
+	case '"':
+	case '\\':
+	case '#':
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/* called with the first character of the string pushed back */
+static int get_freestring(struct token *tok, int id, input_t *input)
+{
+	struct filedesc *fd = input->current;
 	int c;
 
-	init_local_string(&str);
+	token_init(tok);
+	if (fd->ptr && input->unget && fd->ptr > fd->base &&
+	    (unsigned char)fd->ptr[-1] == input->ch) {
+		const char *start = fd->ptr - 1, *p = fd->ptr;
+		input->unget = 0;
+		while (p < fd->end && !freestring_end((unsigned char)*p, id))
+			p++;
+		/* no tabs or newlines in between */
+		fd->column += p - fd->ptr;
+		fd->ptr = p;
+		if (p < fd->end || !fd->next) {
+			tok->str = start;
+			tok->len = p - start;
+			return 0;
+		}
+		/* the string continues after the end of an included file */
+		if (add_slice_local_string(&tok->buf, start, p - start) < 0) {
+			token_free(tok);
+			return -ENOMEM;
+		}
+	}
 	while (1) {
 		c = get_char(input);
 		if (c < 0) {
 			if (c == LOCAL_UNEXPECTED_EOF) {
-				*string = copy_local_string(&str);
-				if (! *string)
-					c = -ENOMEM;
-				else
-					c = 0;
+				token_set_buf(tok);
+				return 0;
 			}
 			break;
 		}
-		switch (c) {
-		case '.':
-			if (!id)
-				break;
-		case ' ':
-		case '\f':
-		case '\t':
-		case '\n':
-		case '\r':
-		case '=':
-		case ',':
-		case ';':
-		case '{':
-		case '}':
-		case '[':
-		case ']':
-		case '\'':
-		case '"':
-		case '\\':
-		case '#':
-			*string = copy_local_string(&str);
-			if (! *string)
-				c = -ENOMEM;
-			else {
-				unget_char(c, input);
-				c = 0;
-			}
-			goto _out;
-		default:
-			break;
+		if (freestring_end(c, id)) {
+			unget_char(c, input);
+			token_set_buf(tok);
+			return 0;
 		}
-		if (add_char_local_string(&str, c) < 0) {
+		if (add_char_local_string(&tok->buf, c) < 0) {
 			c = -ENOMEM;
 			break;
 		}
 	}
- _out:
-	free_local_string(&str);
+	token_free(tok);
 	return c;
 }
 			
-static int get_delimstring(char **string, int delim, input_t *input)
+static int get_delimstring(struct token *tok, int delim, input_t *input)
 {
-	struct local_string str;
+	struct filedesc *fd = input->current;
 	int c;
 
-	init_local_string(&str);
+	token_init(tok);
+	if (fd->ptr && !input->unget) {
+		const char *start = fd->ptr, *p = fd->ptr;
+		for (; p < fd->end && *p != delim && *p != '\\'; p++) {
+			switch (*p) {
+			case '\n':
+				fd->column = 0;
+				fd->line++;
+				break;
+			case '\t':
+				fd->column += 8 - fd->column % 8;
+				break;
+			default:
+				fd->column++;
+				break;
+			}
+		}
+		fd->ptr = p;
+		if (p < fd->end && *p == delim) {
+			fd->ptr++;
+			fd->column++;
+			tok->str = start;
+			tok->len = p - start;
+			return 0;
+		}
+		/* an escape or the end of the file, go on char by char */
+		if (add_slice_local_string(&tok->buf, start, p - start) < 0) {
+			token_free(tok);
+			return -ENOMEM;
+		}
+	}
 	while (1) {
 		c = get_char(input);
 		if (c < 0)
@@ -859,24 +1058,23 @@ static int get_delimstring(char **string, int delim, input_t *input)
 			if (c == '\n')
 				continue;
 		} else if (c == delim) {
-			*string = copy_local_string(&str);
-			if (! *string)
-				c = -ENOMEM;
-			else
-				c = 0;
-			break;
+			token_set_buf(tok);
+			return 0;
 		}
-		if (add_char_local_string(&str, c) < 0) {
+		if (add_char_local_string(&tok->buf, c) < 0) {
 			c = -ENOMEM;
 			break;
 		}
 	}
-	 free_local_string(&str);
-	 return c;
+	token_free(tok);
+	return c;
 }
 
-/* Return 0 for free string, 1 for delimited string */
-static int get_string(char **string, int id, input_t *input)
+/*
+ * Return 0 for free string, 1 for delimited string.  The token must be
+ * released with token_free().
+ */
+static int get_string(struct token *tok, int id, input_t *input)
 {
 	int c = get_nonwhite(input), err;
 	if (c < 0)
@@ -894,54 +1092,270 @@ static int get_string(char **string, int id, input_t *input)
 		return LOCAL_UNEXPECTED_CHAR;
 	case '\'':
 	case '"':
-		err = get_delimstring(string, c, input);
+		err = get_delimstring(tok, c, input);
 		if (err < 0)
 			return err;
 		return 1;
 	default:
 		unget_char(c, input);
-		err = get_freestring(string, id, input);
+		err = get_freestring(tok, id, input);
 		if (err < 0)
 			return err;
 		return 0;
 	}
 }
 
-static int _snd_config_make(snd_config_t **config, char **id, snd_config_type_t type)
+static unsigned int config_hash(const char *id, size_t len)
+{
+	unsigned int h = 2166136261U;
+
+	while (len--)
+		h = (h ^ (unsigned char)*id++) * 16777619U;
+	return h;
+}
+
+/*
+ * Ids and string values are interned: equal strings share one
+ * refcounted copy, so copies and expansions of a tree do not allocate
+ * strings.  The copies are immutable.
+ */
+struct config_str {
+	struct config_str *next;
+	unsigned int refs;
+	unsigned int hash;
+	char s[0];
+};
+
+static struct config_str **config_strs;
+static unsigned int config_strs_mask;
+static unsigned int config_strs_count;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t config_strs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static inline void config_strs_lock(void)
+{
+	pthread_mutex_lock(&config_strs_mutex);
+}
+static inline void config_strs_unlock(void)
+{
+	pthread_mutex_unlock(&config_strs_mutex);
+}
+#else
+static inline void config_strs_lock(void) {}
+static inline void config_strs_unlock(void) {}
+#endif
+
+static inline struct config_str *config_str_entry(const char *str)
+{
+	return (struct config_str *)(str - offsetof(struct config_str, s));
+}
+
+static void config_strs_grow(void)
+{
+	unsigned int size = config_strs_mask ? (config_strs_mask + 1) * 2 : 256;
+	struct config_str **table, *e, *next;
+	unsigned int i;
+
+	table = calloc(size, sizeof(*table));
+	if (!table)
+		return;		/* keep the longer chains */
+	for (i = 0; config_strs && i <= config_strs_mask; i++) {
+		for (e = config_strs[i]; e; e = next) {
+			next = e->next;
+			e->next = table[e->hash & (size - 1)];
+			table[e->hash & (size - 1)] = e;
+		}
+	}
+	free(config_strs);
+	config_strs = table;
+	config_strs_mask = size - 1;
+}
+
+/* as config_str_get(), for the first len bytes of str */
+static char *config_str_getn(const char *str, size_t len)
+{
+	unsigned int hash = config_hash(str, len);
+	struct config_str *e;
+
+	config_strs_lock();
+	if (config_strs_count >= config_strs_mask)
+		config_strs_grow();
+	if (!config_strs) {
+		config_strs_unlock();
+		return NULL;
+	}
+	for (e = config_strs[hash & config_strs_mask]; e; e = e->next) {
+		if (e->hash == hash && (e->s == str || !strncmp(e->s, str, len)) &&
+		    e->s[len] == '\0') {
+			e->refs++;
+			config_strs_unlock();
+			return e->s;
+		}
+	}
+	e = malloc(sizeof(*e) + len + 1);
+	if (e) {
+		e->refs = 1;
+		e->hash = hash;
+		memcpy(e->s, str, len);
+		e->s[len] = '\0';
+		e->next = config_strs[hash & config_strs_mask];
+		config_strs[hash & config_strs_mask] = e;
+		config_strs_count++;
+	}
+	config_strs_unlock();
+	return e ? e->s : NULL;
+}
+
+/* return the interned copy of str with a reference, NULL when out of memory */
+static char *config_str_get(const char *str)
+{
+	return config_str_getn(str, strlen(str));
+}
+
+/* as config_str_get(), for a malloc'ed string which is freed */
+static char *config_str_take(char *str)
+{
+	char *s = config_str_get(str);
+
+	free(str);
+	return s;
+}
+
+static void config_str_put(char *str)
+{
+	struct config_str *e, **p;
+
+	if (!str)
+		return;
+	e = config_str_entry(str);
+	config_strs_lock();
+	if (--e->refs == 0) {
+		for (p = &config_strs[e->hash & config_strs_mask]; *p != e;
+		     p = &(*p)->next)
+			;
+		*p = e->next;
+		config_strs_count--;
+		free(e);
+	}
+	config_strs_unlock();
+}
+
+static void config_index_link(struct config_index *index, snd_config_t *n)
+{
+	snd_config_t **p;
+
+	p = &index->bucket[config_str_entry(n->id)->hash & index->mask];
+	while (*p)
+		p = &(*p)->hash_next;
+	n->hash_next = NULL;
+	*p = n;
+	index->count++;
+}
+
+static void config_index_free(snd_config_t *config)
+{
+	free(config->u.compound.index);
+	config->u.compound.index = NULL;
+}
+
+/* (re)build the index of a compound */
+static void config_index_build(snd_config_t *config)
+{
+	struct config_index *index;
+	snd_config_iterator_t i, next;
+	unsigned int count = 0, size = CONFIG_INDEX_MIN;
+
+	config_index_free(config);
+	snd_config_for_each(i, next, config)
+		count++;
+	while (size < count)
+		size <<= 1;
+	index = calloc(1, sizeof(*index) + size * sizeof(index->bucket[0]));
+	if (!index)
+		return;
+	index->mask = size - 1;
+	snd_config_for_each(i, next, config)
+		config_index_link(index, snd_config_iterator_entry(i));
+	config->u.compound.index = index;
+}
+
+/* a child was added to the end of the list */
+static void config_index_add(snd_config_t *parent, snd_config_t *n)
+{
+	struct config_index *index = parent->u.compound.index;
+
+	if (!index)
+		return;
+	if (index->count >= 2 * (index->mask + 1))
+		config_index_build(parent);
+	else
+		config_index_link(index, n);
+}
+
+/* a child is about to be removed or renamed */
+static void config_index_del(snd_config_t *parent, snd_config_t *n)
+{
+	struct config_index *index = parent->u.compound.index;
+	snd_config_t **p;
+
+	if (!index)
+		return;
+	p = &index->bucket[config_str_entry(n->id)->hash & index->mask];
+	while (*p && *p != n)
+		p = &(*p)->hash_next;
+	if (*p) {
+		*p = n->hash_next;
+		index->count--;
+	}
+}
+
+/* make a node owning the reference of the interned id */
+static int config_make(snd_config_t **config, char *id, snd_config_type_t type)
 {
 	snd_config_t *n;
 	assert(config);
 	n = calloc(1, sizeof(*n));
 	if (n == NULL) {
-		if (*id) {
-			free(*id);
-			*id = NULL;
-		}
+		config_str_put(id);
 		return -ENOMEM;
 	}
-	if (id) {
-		n->id = *id;
-		*id = NULL;
-	}
+	n->id = id;
 	n->type = type;
 	if (type == SND_CONFIG_TYPE_COMPOUND)
 		INIT_LIST_HEAD(&n->u.compound.fields);
 	*config = n;
 	return 0;
 }
+
+/* make a node from a malloc'ed id, which is consumed */
+static int _snd_config_make(snd_config_t **config, char **id, snd_config_type_t type)
+{
+	char *s = NULL;
+
+	if (id && *id) {
+		s = config_str_take(*id);
+		*id = NULL;
+		if (!s)
+			return -ENOMEM;
+	}
+	return config_make(config, s, type);
+}
 	
 
+/* make a child of parent from an interned id, which is consumed */
 static int _snd_config_make_add(snd_config_t **config, char **id,
 				snd_config_type_t type, snd_config_t *parent)
 {
 	snd_config_t *n;
 	int err;
 	assert(parent->type == SND_CONFIG_TYPE_COMPOUND);
-	err = _snd_config_make(&n, id, type);
+	err = config_make(&n, *id, type);
+	*id = NULL;
 	if (err < 0)
 		return err;
 	n->parent = parent;
 	list_add_tail(&n->list, &parent->u.compound.fields);
+	config_index_add(parent, n);
 	*config = n;
 	return 0;
 }
@@ -950,43 +1364,74 @@ static int _snd_config_search(snd_config_t *config,
 			      const char *id, int len, snd_config_t **result)
 {
 	snd_config_iterator_t i, next;
+	struct config_index *index = config->u.compound.index;
+	unsigned int count = 0;
+	size_t l = len < 0 ? strlen(id) : (size_t)len;
+	snd_config_t *n;
+
+	if (index) {
+		n = index->bucket[config_hash(id, l) & index->mask];
+		for (; n; n = n->hash_next) {
+			if ((len < 0 && n->id == id) ||
+			    (strlen(n->id) == l && memcmp(n->id, id, l) == 0))
+				goto _found;
+		}
+		return -ENOENT;
+	}
 	snd_config_for_each(i, next, config) {
-		snd_config_t *n = snd_config_iterator_entry(i);
-		if (len < 0) {
-			if (strcmp(n->id, id) != 0)
-				continue;
-		} else if (strlen(n->id) != (size_t) len ||
-			   memcmp(n->id, id, (size_t) len) != 0)
-				continue;
-		if (result)
-			*result = n;
-		return 0;
+		n = snd_config_iterator_entry(i);
+		count++;
+		if (strlen(n->id) != l || memcmp(n->id, id, l) != 0)
+			continue;
+		if (count >= CONFIG_INDEX_MIN)
+			config_index_build(config);
+		goto _found;
 	}
+	if (count >= CONFIG_INDEX_MIN)
+		config_index_build(config);
 	return -ENOENT;
+ _found:
+	if (result)
+		*result = n;
+	return 0;
 }
 
 static int parse_value(snd_config_t **_n, snd_config_t *parent, input_t *input, char **id, int skip)
 {
 	snd_config_t *n = *_n;
-	char *s;
+	struct token tok;
 	int err;
 
-	err = get_string(&s, 0, input);
+	err = get_string(&tok, 0, input);
 	if (err < 0)
 		return err;
 	if (skip) {
-		free(s);
+		token_free(&tok);
 		return 0;
 	}
-	if (err == 0 && ((s[0] >= '0' && s[0] <= '9') || s[0] == '-')) {
+	if (err == 0 && tok.len > 0 &&
+	    ((tok.str[0] >= '0' && tok.str[0] <= '9') || tok.str[0] == '-')) {
+		char num[LOCAL_STR_BUFSIZE], *s = num;
 		long long i;
+		if (tok.len < sizeof(num)) {
+			memcpy(num, tok.str, tok.len);
+			num[tok.len] = '\0';
+		} else {
+			s = strndup(tok.str, tok.len);
+			if (!s) {
+				token_free(&tok);
+				return -ENOMEM;
+			}
+		}
 		errno = 0;
 		err = safe_strtoll(s, &i);
 		if (err < 0) {
 			double r;
 			err = safe_strtod(s, &r);
 			if (err >= 0) {
-				free(s);
+				if (s != num)
+					free(s);
+				token_free(&tok);
 				if (n) {
 					if (n->type != SND_CONFIG_TYPE_REAL) {
 						SNDERR("%s is not a real", *id);
@@ -1002,7 +1447,9 @@ static int parse_value(snd_config_t **_n, snd_config_t *parent, input_t *input,
 				return 0;
 			}
 		} else {
-			free(s);
+			if (s != num)
+				free(s);
+			token_free(&tok);
 			if (n) {
 				if (n->type != SND_CONFIG_TYPE_INTEGER && n->type != SND_CONFIG_TYPE_INTEGER64) {
 					SNDERR("%s is not an integer", *id);
@@ -1023,20 +1470,27 @@ static int parse_value(snd_config_t **_n, snd_config_t *parent, input_t *input,
 			*_n = n;
 			return 0;
 		}
+		if (s != num)
+			free(s);
 	}
 	if (n) {
 		if (n->type != SND_CONFIG_TYPE_STRING) {
 			SNDERR("%s is not a string", *id);
-			free(s);
+			token_free(&tok);
 			return -EINVAL;
 		}
 	} else {
 		err = _snd_config_make_add(&n, id, SND_CONFIG_TYPE_STRING, parent);
-		if (err < 0)
+		if (err < 0) {
+			token_free(&tok);
 			return err;
+		}
 	}
-	free(n->u.string);
-	n->u.string = s;
+	config_str_put(n->u.string);
+	n->u.string = config_str_getn(tok.str, tok.len);
+	token_free(&tok);
+	if (!n->u.string)
+		return -ENOMEM;
 	*_n = n;
 	return 0;
 }
@@ -1054,7 +1508,7 @@ static int parse_array_def(snd_config_t *parent, input_t *input, int idx, int sk
 	if (!skip) {
 		char static_id[12];
 		snprintf(static_id, sizeof(static_id), "%i", idx);
-		id = strdup(static_id);
+		id = config_str_get(static_id);
 		if (id == NULL)
 			return -ENOMEM;
 	}
@@ -1110,7 +1564,7 @@ static int parse_array_def(snd_config_t *parent, input_t *input, int idx, int sk
 	}
 	err = 0;
       __end:
-	free(id);
+	config_str_put(id);
       	return err;
 }
 
@@ -1134,6 +1588,7 @@ static int parse_array_defs(snd_config_t *parent, input_t *input, int skip, int
 static int parse_def(snd_config_t *parent, input_t *input, int skip, int override)
 {
 	char *id = NULL;
+	struct token tok;
 	int c;
 	int err;
 	snd_config_t *n;
@@ -1159,20 +1614,24 @@ static int parse_def(snd_config_t *parent, input_t *input, int skip, int overrid
 			mode = !override ? MERGE_CREATE : OVERRIDE;
 			unget_char(c, input);
 		}
-		err = get_string(&id, 1, input);
+		err = get_string(&tok, 1, input);
 		if (err < 0)
 			return err;
+		id = config_str_getn(tok.str, tok.len);
+		token_free(&tok);
+		if (!id)
+			return -ENOMEM;
 		c = get_nonwhite(input);
 		if (c != '.')
 			break;
 		if (skip) {
-			free(id);
+			config_str_put(id);
 			continue;
 		}
 		if (_snd_config_search(parent, id, -1, &n) == 0) {
 			if (mode == DONT_OVERRIDE) {
 				skip = 1;
-				free(id);
+				config_str_put(id);
 				continue;
 			}
 			if (mode != OVERRIDE) {
@@ -1182,7 +1641,7 @@ static int parse_def(snd_config_t *parent, input_t *input, int skip, int overrid
 				}
 				n->u.compound.join = 1;
 				parent = n;
-				free(id);
+				config_str_put(id);
 				continue;
 			}
 			snd_config_delete(n);
@@ -1271,7 +1730,7 @@ static int parse_def(snd_config_t *parent, input_t *input, int skip, int overrid
 		unget_char(c, input);
 	}
       __end:
-	free(id);
+	config_str_put(id);
 	return err;
 }
 		
@@ -1495,13 +1954,15 @@ int snd_config_substitute(snd_config_t *dst, snd_config_t *src)
 		}
 		src->u.compound.fields.next->prev = &dst->u.compound.fields;
 		src->u.compound.fields.prev->next = &dst->u.compound.fields;
+		config_index_free(dst);
 	} else if (dst->type == SND_CONFIG_TYPE_COMPOUND) {
 		int err;
 		err = snd_config_delete_compound_members(dst);
 		if (err < 0)
 			return err;
+		config_index_free(dst);
 	}
-	free(dst->id);
+	config_str_put(dst->id);
 	dst->id = src->id;
 	dst->type = src->type;
 	dst->u = src->u;
@@ -1619,7 +2080,7 @@ int snd_config_set_id(snd_config_t *config, const char *id)
 					return -EEXIST;
 			}
 		}
-		new_id = strdup(id);
+		new_id = config_str_get(id);
 		if (!new_id)
 			return -ENOMEM;
 	} else {
@@ -1627,8 +2088,12 @@ int snd_config_set_id(snd_config_t *config, const char *id)
 			return -EINVAL;
 		new_id = NULL;
 	}
-	free(config->id);
+	if (config->parent)
+		config_index_del(config->parent, config);
+	config_str_put(config->id);
 	config->id = new_id;
+	if (config->parent)
+		config_index_add(config->parent, config);
 	return 0;
 }
 
@@ -1654,7 +2119,8 @@ int snd_config_top(snd_config_t **config)
 	return _snd_config_make(config, 0, SND_CONFIG_TYPE_COMPOUND);
 }
 
-static int snd_config_load1(snd_config_t *config, snd_input_t *in, int override)
+static int snd_config_load1(snd_config_t *config, snd_input_t *in, int override,
+			    unsigned int *includes)
 {
 	int err;
 	input_t input;
@@ -1665,12 +2131,16 @@ static int snd_config_load1(snd_config_t *config, snd_input_t *in, int override)
 		return -ENOMEM;
 	fd->name = NULL;
 	fd->in = in;
+	filedesc_span(fd);
 	fd->line = 1;
 	fd->column = 0;
 	fd->next = NULL;
 	input.current = fd;
 	input.unget = 0;
+	input.includes = 0;
 	err = parse_defs(config, &input, 0, override);
+	if (includes)
+		*includes = input.includes;
 	fd = input.current;
 	if (err < 0) {
 		const char *str;
@@ -1733,7 +2203,7 @@ static int snd_config_load1(snd_config_t *config, snd_input_t *in, int override)
  */
 int snd_config_load(snd_config_t *config, snd_input_t *in)
 {
-	return snd_config_load1(config, in, 0);
+	return snd_config_load1(config, in, 0, NULL);
 }
 
 /**
@@ -1748,7 +2218,7 @@ int snd_config_load(snd_config_t *config, snd_input_t *in)
  */
 int snd_config_load_override(snd_config_t *config, snd_input_t *in)
 {
-	return snd_config_load1(config, in, 1);
+	return snd_config_load1(config, in, 1, NULL);
 }
 
 /**
@@ -1777,17 +2247,14 @@ int snd_config_load_override(snd_config_t *config, snd_input_t *in)
  */
 int snd_config_add(snd_config_t *parent, snd_config_t *child)
 {
-	snd_config_iterator_t i, next;
 	assert(parent && child);
 	if (!child->id || child->parent)
 		return -EINVAL;
-	snd_config_for_each(i, next, parent) {
-		snd_config_t *n = snd_config_iterator_entry(i);
-		if (strcmp(child->id, n->id) == 0)
-			return -EEXIST;
-	}
+	if (_snd_config_search(parent, child->id, -1, NULL) == 0)
+		return -EEXIST;
 	child->parent = parent;
 	list_add_tail(&child->list, &parent->u.compound.fields);
+	config_index_add(parent, child);
 	return 0;
 }
 
@@ -1807,12 +2274,225 @@ int snd_config_add(snd_config_t *parent, snd_config_t *child)
 int snd_config_remove(snd_config_t *config)
 {
 	assert(config);
-	if (config->parent)
+	if (config->parent) {
+		config_index_del(config->parent, config);
 		list_del(&config->list);
+	}
 	config->parent = NULL;
 	return 0;
 }
 
+#ifndef DOC_HIDDEN
+/*
+ * The card files of load_for_all_cards are loaded on demand: the hook
+ * only notes the drivers of the present cards on the compound it was
+ * called for (root), see config_lazy_search().
+ */
+struct config_lazy_card {
+	struct config_lazy_card *next;
+	char *driver;
+	int loaded;
+};
+
+struct config_lazy {
+	struct config_lazy *next;
+	snd_config_t *root;
+	snd_config_t *hook;		/* copy of the hook definition */
+	struct config_lazy_card *cards;
+	unsigned int pending;		/* cards not loaded yet */
+	int loading;			/* no nested loads from the hook */
+};
+
+static struct config_lazy *config_lazy_list;
+
+static void config_lazy_free(struct config_lazy *lazy)
+{
+	struct config_lazy_card *card, *next;
+
+	for (card = lazy->cards; card; card = next) {
+		next = card->next;
+		free(card->driver);
+		free(card);
+	}
+	snd_config_delete(lazy->hook);
+	free(lazy);
+}
+
+/*
+ * Forget the pending card files of a compound being deleted.  The last
+ * reference of an old tree may go away in any thread, so the list is
+ * changed under the config lock like in config_lazy_search().
+ */
+static void config_lazy_drop(snd_config_t *config)
+{
+	struct config_lazy **p, *lazy, *dropped = NULL;
+
+	snd_config_lock();
+	for (p = &config_lazy_list; (lazy = *p) != NULL; ) {
+		if (lazy->root == config) {
+			*p = lazy->next;
+			lazy->next = dropped;
+			dropped = lazy;
+		} else
+			p = &lazy->next;
+	}
+	snd_config_unlock();
+	/* freed unlocked, deleting the hook copies comes back here */
+	while ((lazy = dropped) != NULL) {
+		dropped = lazy->next;
+		config_lazy_free(lazy);
+	}
+}
+#endif
+
+#ifndef DOC_HIDDEN
+#ifdef HAVE___THREAD
+#define TLS_PFX		__thread
+#else
+#define TLS_PFX		/* NOP */
+#endif
+
+/*
+ * The shared definitions a thread holds, see config_expand().  The node
+ * counts them in its refcount; the entry keeps the hop of the open which
+ * holds it, as the node is read by other opens at the same time.
+ */
+struct config_shared {
+	snd_config_t *config;
+	int hop;
+	struct config_shared *next;
+};
+
+static TLS_PFX struct config_shared *config_shared_list;
+
+static int config_free(snd_config_t *config);
+
+/* the last one taken by this thread, called with the lock held */
+static struct config_shared **config_shared_find(snd_config_t *config)
+{
+	struct config_shared **p;
+
+	for (p = &config_shared_list; *p; p = &(*p)->next)
+		if ((*p)->config == config)
+			return p;
+	return NULL;
+}
+
+/* take a reference, called with the lock held */
+static int config_shared_get(snd_config_t *config)
+{
+	struct config_shared *ref = malloc(sizeof(*ref));
+
+	if (!ref)
+		return -ENOMEM;
+	ref->config = config;
+	ref->hop = 0;
+	ref->next = config_shared_list;
+	config_shared_list = ref;
+	__atomic_fetch_add(&config->refcount, 1, __ATOMIC_RELAXED);
+	return 0;
+}
+
+/*
+ * Release a reference of this thread, returns 0 when it holds none.  A
+ * node deleted from its tree meanwhile goes with the last reference.
+ */
+static int config_shared_put(snd_config_t *config)
+{
+	struct config_shared **p, *ref;
+	int last;
+
+	if (!__atomic_load_n(&config_shared_list, __ATOMIC_RELAXED))
+		return 0;
+	snd_config_lock();
+	p = config_shared_find(config);
+	if (!p) {
+		snd_config_unlock();
+		return 0;
+	}
+	ref = *p;
+	*p = ref->next;
+	free(ref);
+	last = __atomic_sub_fetch(&config->refcount, 1, __ATOMIC_ACQ_REL) == 0 &&
+	       !config->parent;
+	snd_config_unlock();
+	if (last)
+		config_free(config);
+	return 1;
+}
+
+/*
+ * The owner deletes a node.  With shared references left, it is only
+ * unlinked from its parent, and freed by the last of them.  A top node
+ * has the references of snd_config_update_ref() instead, one is dropped.
+ */
+static int config_disown(snd_config_t *config)
+{
+	int refs = __atomic_load_n(&config->refcount, __ATOMIC_ACQUIRE);
+
+	if (refs <= 0)
+		return 0;
+	if (config->parent) {
+		snd_config_lock();
+		if (config->refcount > 0) {
+			config_index_del(config->parent, config);
+			list_del(&config->list);
+			config->parent = NULL;
+			refs = 1;
+		} else {
+			refs = 0;
+		}
+		snd_config_unlock();
+		return refs;
+	}
+	while (refs > 0) {
+		if (__atomic_compare_exchange_n(&config->refcount, &refs, refs - 1,
+						0, __ATOMIC_ACQ_REL,
+						__ATOMIC_ACQUIRE))
+			return 1;
+	}
+	return 0;
+}
+
+static int config_free(snd_config_t *config)
+{
+	if (config_disown(config))
+		return 0;
+	switch (config->type) {
+	case SND_CONFIG_TYPE_COMPOUND:
+	{
+		int err;
+		struct list_head *i;
+		if (__atomic_load_n(&config_lazy_list, __ATOMIC_ACQUIRE))
+			config_lazy_drop(config);
+		config_index_free(config);
+		i = config->u.compound.fields.next;
+		while (i != &config->u.compound.fields) {
+			struct list_head *nexti = i->next;
+			snd_config_t *child = snd_config_iterator_entry(i);
+			err = config_free(child);
+			if (err < 0)
+				return err;
+			i = nexti;
+		}
+		break;
+	}
+	case SND_CONFIG_TYPE_STRING:
+		config_str_put(config->u.string);
+		break;
+	default:
+		break;
+	}
+	if (config->parent) {
+		config_index_del(config->parent, config);
+		list_del(&config->list);
+	}
+	config_str_put(config->id);
+	free(config);
+	return 0;
+}
+#endif /* DOC_HIDDEN */
+
 /**
  * \brief Frees a configuration node.
  * \param config Handle to the configuration node to be deleted.
@@ -1838,37 +2518,9 @@ int snd_config_remove(snd_config_t *config)
 int snd_config_delete(snd_config_t *config)
 {
 	assert(config);
-	if (config->refcount > 0) {
-		config->refcount--;
+	if (config_shared_put(config))
 		return 0;
-	}
-	switch (config->type) {
-	case SND_CONFIG_TYPE_COMPOUND:
-	{
-		int err;
-		struct list_head *i;
-		i = config->u.compound.fields.next;
-		while (i != &config->u.compound.fields) {
-			struct list_head *nexti = i->next;
-			snd_config_t *child = snd_config_iterator_entry(i);
-			err = snd_config_delete(child);
-			if (err < 0)
-				return err;
-			i = nexti;
-		}
-		break;
-	}
-	case SND_CONFIG_TYPE_STRING:
-		free(config->u.string);
-		break;
-	default:
-		break;
-	}
-	if (config->parent)
-		list_del(&config->list);
-	free(config->id);
-	free(config);
-	return 0;
+	return config_free(config);
 }
 
 /**
@@ -1934,12 +2586,12 @@ int snd_config_make(snd_config_t **config, const char *id,
 	char *id1;
 	assert(config);
 	if (id) {
-		id1 = strdup(id);
+		id1 = config_str_get(id);
 		if (!id1)
 			return -ENOMEM;
 	} else
 		id1 = NULL;
-	return _snd_config_make(config, &id1, type);
+	return config_make(config, id1, type);
 }
 
 /**
@@ -2225,7 +2877,7 @@ int snd_config_imake_string(snd_config_t **config, const char *id, const char *v
 	if (err < 0)
 		return err;
 	if (value) {
-		tmp->u.string = strdup(value);
+		tmp->u.string = config_str_get(value);
 		if (!tmp->u.string) {
 			snd_config_delete(tmp);
 			return -ENOMEM;
@@ -2247,13 +2899,13 @@ int snd_config_imake_safe_string(snd_config_t **config, const char *id, const ch
 	if (err < 0)
 		return err;
 	if (value) {
-		tmp->u.string = strdup(value);
-		if (!tmp->u.string) {
+		char *safe = strdup(value);
+		if (!safe) {
 			snd_config_delete(tmp);
 			return -ENOMEM;
 		}
 
-		for (c = tmp->u.string; *c; c++) {
+		for (c = safe; *c; c++) {
 			if (*c == ' ' || *c == '-' || *c == '_' ||
 				(*c >= '0' && *c <= '9') ||
 				(*c >= 'a' && *c <= 'z') ||
@@ -2261,6 +2913,11 @@ int snd_config_imake_safe_string(snd_config_t **config, const char *id, const ch
 					continue;
 			*c = '_';
 		}
+		tmp->u.string = config_str_take(safe);
+		if (!tmp->u.string) {
+			snd_config_delete(tmp);
+			return -ENOMEM;
+		}
 	} else {
 		tmp->u.string = NULL;
 	}
@@ -2386,13 +3043,13 @@ int snd_config_set_string(snd_config_t *config, const char *value)
 	if (config->type != SND_CONFIG_TYPE_STRING)
 		return -EINVAL;
 	if (value) {
-		new_string = strdup(value);
+		new_string = config_str_get(value);
 		if (!new_string)
 			return -ENOMEM;
 	} else {
 		new_string = NULL;
 	}
-	free(config->u.string);
+	config_str_put(config->u.string);
 	config->u.string = new_string;
 	return 0;
 }
@@ -2477,10 +3134,10 @@ int snd_config_set_ascii(snd_config_t *config, const char *ascii)
 		}
 	case SND_CONFIG_TYPE_STRING:
 		{
-			char *ptr = strdup(ascii);
+			char *ptr = config_str_get(ascii);
 			if (ptr == NULL)
 				return -ENOMEM;
-			free(config->u.string);
+			config_str_put(config->u.string);
 			config->u.string = ptr;
 		}
 		break;
@@ -3118,6 +3775,7 @@ int snd_config_search_alias(snd_config_t *config,
 }
 
 static int snd_config_hooks(snd_config_t *config, snd_config_t *private_data);
+static int config_lazy_search(snd_config_t *config, const char *key);
 
 /**
  * \brief Searches for a node in a configuration tree and expands hooks.
@@ -3147,6 +3805,9 @@ int snd_config_search_hooks(snd_config_t *config, const char *key, snd_config_t
 					err = snd_config_hooks(config, NULL); \
 					if (err < 0) \
 						return err; \
+					err = config_lazy_search(config, key); \
+					if (err < 0) \
+						return err; \
 			 );
 }
 
@@ -3181,6 +3842,9 @@ int snd_config_searcha_hooks(snd_config_t *root, snd_config_t *config, const cha
 					err = snd_config_hooks(config, NULL); \
 					if (err < 0) \
 						return err; \
+					err = config_lazy_search(config, key); \
+					if (err < 0) \
+						return err; \
 			 );
 }
 
@@ -3254,6 +3918,9 @@ int snd_config_search_alias_hooks(snd_config_t *config,
 /** The name of the default files used by #snd_config_update. */
 #define ALSA_CONFIG_PATH_DEFAULT ALSA_CONFIG_DIR "/alsa.conf"
 
+/** The name of the environment variable naming the binary cache of the #snd_config_update files. */
+#define ALSA_CONFIG_CACHE_VAR "ALSA_CONFIG_CACHE"
+
 /**
  * \ingroup Config
  * \brief Configuration top-level node (the global configuration).
@@ -3279,25 +3946,550 @@ int snd_config_search_alias_hooks(snd_config_t *config,
  */
 snd_config_t *snd_config = NULL;
 
-#ifndef DOC_HIDDEN
-struct finfo {
-	char *name;
-	dev_t dev;
-	ino_t ino;
-	time_t mtime;
-};
+#ifndef DOC_HIDDEN
+struct finfo {
+	char *name;
+	dev_t dev;
+	ino_t ino;
+	time_t mtime;
+};
+
+struct _snd_config_update {
+	unsigned int count;
+	struct finfo *finfo;
+	char *configs;		/* the file list this update was made from */
+	snd_watch_t *watch;	/* of the directories of the files, or NULL */
+	unsigned int watch_count;
+};
+
+static void config_update_unwatch(snd_config_update_t *update)
+{
+	unsigned int k;
+
+	for (k = 0; k < update->watch_count; k++)
+		snd_watch_remove(&update->watch[k]);
+	free(update->watch);
+	update->watch = NULL;
+	update->watch_count = 0;
+}
+
+/*
+ * Watch the directories of the configured files, so an unchanged
+ * configuration is recognized by unchanged inotify event counts (see
+ * watch.c) instead of a stat() of each file.  The watch is set up before
+ * the files are examined; a change racing with that shows up as an event
+ * later.
+ */
+static void config_update_watch(snd_config_update_t *update,
+				const char *configs)
+{
+	const char *c;
+	size_t l;
+	int err;
+
+	update->watch = calloc(update->count, sizeof(*update->watch));
+	if (!update->watch)
+		return;
+	for (c = configs; (l = strcspn(c, ": ")) > 0; ) {
+		char name[l + 1], *file, *dir;
+		memcpy(name, c, l);
+		name[l] = 0;
+		if (update->watch_count == update->count ||
+		    snd_user_file(name, &file) < 0)
+			goto _err;
+		dir = strrchr(file, '/');
+		if (dir == file)
+			dir[1] = '\0';
+		else if (dir)
+			*dir = '\0';
+		err = snd_watch_add(&update->watch[update->watch_count],
+				    dir ? file : ".",
+				    IN_CREATE | IN_DELETE | IN_MOVE |
+				    IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE |
+				    IN_DELETE_SELF | IN_MOVE_SELF);
+		free(file);
+		/* a missing directory could not be noticed appearing */
+		if (err < 0)
+			goto _err;
+		update->watch_count++;
+		c += l;
+		if (!*c)
+			break;
+		c++;
+	}
+	return;
+ _err:
+	config_update_unwatch(update);
+}
+
+/*
+ * Returns 1 when nothing happened to the files of update since its
+ * watch was set or reset.  It may run concurrently for the global update
+ * (see snd_config_update_ref()), it only reads the watch.
+ */
+static int config_update_quiet(snd_config_update_t *update, const char *configs)
+{
+	unsigned int k;
+
+	if (!update->watch)
+		return 0;
+	if (!update->configs || strcmp(update->configs, configs))
+		return 0;
+	for (k = 0; k < update->watch_count; k++)
+		if (snd_watch_changed(&update->watch[k]))
+			return 0;
+	return 1;
+}
+
+/* the list of files to read, cfgs or the default */
+static const char *config_update_files(const char *cfgs)
+{
+	const char *configs = cfgs;
+
+	if (!configs) {
+		configs = getenv(ALSA_CONFIG_PATH_VAR);
+		if (!configs || !*configs)
+			configs = ALSA_CONFIG_PATH_DEFAULT;
+	}
+	return configs;
+}
+
+/* the files are about to be compared, restart watching */
+static void config_update_reset(snd_config_update_t *update)
+{
+	unsigned int k;
+
+	for (k = 0; k < update->watch_count; k++) {
+		if (snd_watch_changed(&update->watch[k]) < 0) {
+			/* e.g. after fork, a new watch is set up */
+			config_update_unwatch(update);
+			return;
+		}
+	}
+	for (k = 0; k < update->watch_count; k++)
+		snd_watch_reset(&update->watch[k]);
+}
+
+/*
+ * Binary cache of the files read by snd_config_update_r().  They are
+ * loaded into an empty tree before the hooks run, so that tree depends
+ * on their contents only.  It is stored as a preorder list of nodes
+ * followed by a string table and is used while the name, device, inode
+ * and mtime of every file match.  Files with <include> directives are
+ * not cached.
+ */
+#define CONFIG_CACHE_MAGIC	0x43464341	/* "ACFC" */
+#define CONFIG_CACHE_VERSION	1
+#define CONFIG_CACHE_NONE	0xffffffffU
+#define CONFIG_CACHE_MAX_DEPTH	64
+
+struct config_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t files;
+	uint32_t nodes;
+	uint32_t strings;		/* size of the string table */
+	uint32_t reserved;
+};
+
+struct config_cache_file {
+	uint64_t dev;
+	uint64_t ino;
+	int64_t mtime;
+	uint32_t name;
+	uint32_t reserved;
+};
+
+struct config_cache_node {
+	uint32_t id;
+	uint32_t type;
+	uint32_t join;
+	uint32_t children;
+	union {
+		int64_t integer;
+		double real;
+		uint32_t string;
+	} u;
+};
+
+struct config_cache {
+	struct config_cache_node *nodes;
+	unsigned int count, alloc;
+	char *strings;
+	size_t len, size;
+};
+
+static int config_cache_string(struct config_cache *cache, const char *str,
+			       uint32_t *off)
+{
+	size_t len;
+
+	if (!str) {
+		*off = CONFIG_CACHE_NONE;
+		return 0;
+	}
+	len = strlen(str) + 1;
+	if (cache->len + len > cache->size) {
+		size_t size = cache->size ? cache->size * 2 : 4096;
+		char *p;
+		while (size < cache->len + len)
+			size *= 2;
+		p = realloc(cache->strings, size);
+		if (!p)
+			return -ENOMEM;
+		cache->strings = p;
+		cache->size = size;
+	}
+	if (cache->len + len >= CONFIG_CACHE_NONE)
+		return -E2BIG;
+	memcpy(cache->strings + cache->len, str, len);
+	*off = cache->len;
+	cache->len += len;
+	return 0;
+}
+
+static int config_cache_add(struct config_cache *cache, snd_config_t *config)
+{
+	struct config_cache_node *cn;
+	snd_config_iterator_t i, next;
+	unsigned int idx;
+	uint32_t id;
+	int err;
+
+	err = config_cache_string(cache, config->id, &id);
+	if (err < 0)
+		return err;
+	if (cache->count == cache->alloc) {
+		unsigned int alloc = cache->alloc ? cache->alloc * 2 : 256;
+		cn = realloc(cache->nodes, alloc * sizeof(*cn));
+		if (!cn)
+			return -ENOMEM;
+		cache->nodes = cn;
+		cache->alloc = alloc;
+	}
+	idx = cache->count++;
+	cn = &cache->nodes[idx];
+	memset(cn, 0, sizeof(*cn));
+	cn->id = id;
+	cn->type = config->type;
+	switch (config->type) {
+	case SND_CONFIG_TYPE_INTEGER:
+		cn->u.integer = config->u.integer;
+		break;
+	case SND_CONFIG_TYPE_INTEGER64:
+		cn->u.integer = config->u.integer64;
+		break;
+	case SND_CONFIG_TYPE_REAL:
+		cn->u.real = config->u.real;
+		break;
+	case SND_CONFIG_TYPE_STRING:
+		return config_cache_string(cache, config->u.string,
+					   &cn->u.string);
+	case SND_CONFIG_TYPE_COMPOUND:
+		cn->join = config->u.compound.join;
+		snd_config_for_each(i, next, config) {
+			err = config_cache_add(cache, snd_config_iterator_entry(i));
+			if (err < 0)
+				return err;
+			/* nodes may have moved */
+			cache->nodes[idx].children++;
+		}
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/* write the tree to a temporary file and move it over the cache */
+static void config_cache_save(snd_config_t *top, snd_config_update_t *update,
+			      const char *path)
+{
+	struct config_cache cache;
+	struct config_cache_header hdr;
+	struct config_cache_file *files = NULL;
+	char *tmp = NULL;
+	unsigned int k;
+	FILE *fp;
+	int fd, err;
+
+	memset(&cache, 0, sizeof(cache));
+	files = calloc(update->count, sizeof(*files));
+	if (!files)
+		goto _end;
+	for (k = 0; k < update->count; k++) {
+		struct finfo *fi = &update->finfo[k];
+		files[k].dev = fi->dev;
+		files[k].ino = fi->ino;
+		files[k].mtime = fi->mtime;
+		if (config_cache_string(&cache, fi->name, &files[k].name) < 0)
+			goto _end;
+	}
+	if (config_cache_add(&cache, top) < 0)
+		goto _end;
+	hdr.magic = CONFIG_CACHE_MAGIC;
+	hdr.version = CONFIG_CACHE_VERSION;
+	hdr.files = update->count;
+	hdr.nodes = cache.count;
+	hdr.strings = cache.len;
+	hdr.reserved = 0;
+	tmp = malloc(strlen(path) + 8);
+	if (!tmp)
+		goto _end;
+	sprintf(tmp, "%s.XXXXXX", path);
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		free(tmp);
+		tmp = NULL;
+		goto _end;
+	}
+	fchmod(fd, 0644);
+	fp = fdopen(fd, "w");
+	if (!fp) {
+		close(fd);
+		goto _unlink;
+	}
+	err = fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+	      fwrite(files, sizeof(*files), hdr.files, fp) != hdr.files ||
+	      fwrite(cache.nodes, sizeof(*cache.nodes), hdr.nodes, fp) != hdr.nodes ||
+	      fwrite(cache.strings, 1, hdr.strings, fp) != hdr.strings;
+	if (fclose(fp) || err)
+		goto _unlink;
+	if (rename(tmp, path) == 0)
+		goto _end;
+ _unlink:
+	unlink(tmp);
+ _end:
+	free(tmp);
+	free(files);
+	free(cache.nodes);
+	free(cache.strings);
+}
+
+struct config_cache_view {
+	const struct config_cache_header *hdr;
+	const struct config_cache_file *files;
+	const struct config_cache_node *nodes;
+	const char *strings;
+};
+
+static int config_cache_strdup(const struct config_cache_view *v, uint32_t off,
+			       char **str)
+{
+	if (off == CONFIG_CACHE_NONE) {
+		*str = NULL;
+		return 0;
+	}
+	if (off >= v->hdr->strings)
+		return -EINVAL;
+	*str = config_str_get(v->strings + off);
+	return *str ? 0 : -ENOMEM;
+}
+
+static int config_cache_build(snd_config_t *parent,
+			      const struct config_cache_view *v,
+			      uint32_t *idx, int depth)
+{
+	const struct config_cache_node *cn;
+	snd_config_t *n;
+	uint32_t k;
+	char *id;
+	int err;
+
+	if (*idx >= v->hdr->nodes || depth > CONFIG_CACHE_MAX_DEPTH)
+		return -EINVAL;
+	cn = &v->nodes[(*idx)++];
+	/* only the types which are stored, anything else is corrupt */
+	switch (cn->type) {
+	case SND_CONFIG_TYPE_INTEGER:
+	case SND_CONFIG_TYPE_INTEGER64:
+	case SND_CONFIG_TYPE_REAL:
+	case SND_CONFIG_TYPE_STRING:
+	case SND_CONFIG_TYPE_COMPOUND:
+		break;
+	default:
+		return -EINVAL;
+	}
+	if (cn->id == CONFIG_CACHE_NONE)
+		return -EINVAL;
+	err = config_cache_strdup(v, cn->id, &id);
+	if (err < 0)
+		return err;
+	err = config_make(&n, id, cn->type);
+	if (err < 0)
+		return err;
+	n->parent = parent;
+	list_add_tail(&n->list, &parent->u.compound.fields);
+	config_index_add(parent, n);
+	switch (cn->type) {
+	case SND_CONFIG_TYPE_INTEGER:
+		n->u.integer = cn->u.integer;
+		break;
+	case SND_CONFIG_TYPE_INTEGER64:
+		n->u.integer64 = cn->u.integer;
+		break;
+	case SND_CONFIG_TYPE_REAL:
+		n->u.real = cn->u.real;
+		break;
+	case SND_CONFIG_TYPE_STRING:
+		return config_cache_strdup(v, cn->u.string, &n->u.string);
+	case SND_CONFIG_TYPE_COMPOUND:
+		n->u.compound.join = cn->join;
+		for (k = 0; k < cn->children; k++) {
+			err = config_cache_build(n, v, idx, depth + 1);
+			if (err < 0)
+				return err;
+		}
+		break;
+	}
+	return 0;
+}
+
+/* check the layout of a cache or of a packed tree */
+static int config_cache_view(struct config_cache_view *v, const void *buf,
+			     size_t size, uint32_t magic)
+{
+	if (size < sizeof(*v->hdr))
+		return -EINVAL;
+	v->hdr = buf;
+	if (v->hdr->magic != magic ||
+	    v->hdr->version != CONFIG_CACHE_VERSION ||
+	    v->hdr->nodes == 0 || v->hdr->strings == 0 ||
+	    (size - sizeof(*v->hdr)) / sizeof(*v->nodes) < v->hdr->nodes ||
+	    sizeof(*v->hdr) + (size_t)v->hdr->files * sizeof(*v->files) +
+	    (size_t)v->hdr->nodes * sizeof(*v->nodes) +
+	    v->hdr->strings != size)
+		return -EINVAL;
+	v->files = (const void *)(v->hdr + 1);
+	v->nodes = (const void *)(v->files + v->hdr->files);
+	v->strings = (const char *)(v->nodes + v->hdr->nodes);
+	if (v->strings[v->hdr->strings - 1] != '\0')
+		return -EINVAL;
+	return 0;
+}
+
+/* add the children of the stored top node to top */
+static int config_cache_build_top(snd_config_t *top,
+				  const struct config_cache_view *v)
+{
+	const struct config_cache_node *root = &v->nodes[0];
+	uint32_t idx, k;
+	int err;
+
+	if (root->type != SND_CONFIG_TYPE_COMPOUND)
+		return -EINVAL;
+	idx = 1;
+	for (k = 0; k < root->children; k++) {
+		err = config_cache_build(top, v, &idx, 0);
+		if (err < 0)
+			return err;
+	}
+	return idx == v->hdr->nodes ? 0 : -EINVAL;
+}
+
+/* load the tree into the empty top when the cache matches the files */
+static int config_cache_load(snd_config_t *top, snd_config_update_t *update,
+			     const char *path)
+{
+	struct config_cache_view v;
+	struct stat st;
+	void *map;
+	size_t size;
+	uint32_t k;
+	int fd, err = -EINVAL;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(*v.hdr)) {
+		close(fd);
+		return -EINVAL;
+	}
+	size = st.st_size;
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -errno;
+	if (config_cache_view(&v, map, size, CONFIG_CACHE_MAGIC) < 0 ||
+	    v.hdr->files != update->count)
+		goto _end;
+	for (k = 0; k < update->count; k++) {
+		const struct config_cache_file *cf = &v.files[k];
+		struct finfo *fi = &update->finfo[k];
+		if (cf->name >= v.hdr->strings ||
+		    strcmp(v.strings + cf->name, fi->name) ||
+		    cf->dev != (uint64_t)fi->dev ||
+		    cf->ino != (uint64_t)fi->ino ||
+		    cf->mtime != (int64_t)fi->mtime) {
+			err = -ESTALE;
+			goto _end;
+		}
+	}
+	err = config_cache_build_top(top, &v);
+ _end:
+	munmap(map, size);
+	return err;
+}
+
+/*
+ * A tree packed into one block in the layout of the cache, without the
+ * file list, e.g. to pass it to another process.
+ */
+#define CONFIG_PACK_MAGIC	0x50464341	/* "ACFP" */
+
+int snd_config_pack(snd_config_t *config, void **bufp, size_t *sizep)
+{
+	struct config_cache cache;
+	struct config_cache_header hdr;
+	size_t size;
+	char *buf;
+	int err;
+
+	memset(&cache, 0, sizeof(cache));
+	err = config_cache_add(&cache, config);
+	if (err < 0)
+		goto _end;
+	hdr.magic = CONFIG_PACK_MAGIC;
+	hdr.version = CONFIG_CACHE_VERSION;
+	hdr.files = 0;
+	hdr.nodes = cache.count;
+	hdr.strings = cache.len;
+	hdr.reserved = 0;
+	size = sizeof(hdr) + cache.count * sizeof(*cache.nodes) + cache.len;
+	buf = malloc(size);
+	if (!buf) {
+		err = -ENOMEM;
+		goto _end;
+	}
+	memcpy(buf, &hdr, sizeof(hdr));
+	memcpy(buf + sizeof(hdr), cache.nodes, cache.count * sizeof(*cache.nodes));
+	memcpy(buf + size - cache.len, cache.strings, cache.len);
+	*bufp = buf;
+	*sizep = size;
+ _end:
+	free(cache.nodes);
+	free(cache.strings);
+	return err;
+}
+
+/* add the children of a packed tree to top, buf aligned to 8 bytes */
+int snd_config_unpack(snd_config_t *top, const void *buf, size_t size)
+{
+	struct config_cache_view v;
+	int err;
 
-struct _snd_config_update {
-	unsigned int count;
-	struct finfo *finfo;
-};
+	assert(top->type == SND_CONFIG_TYPE_COMPOUND);
+	err = config_cache_view(&v, buf, size, CONFIG_PACK_MAGIC);
+	if (err < 0 || v.hdr->files)
+		return -EINVAL;
+	return config_cache_build_top(top, &v);
+}
 #endif /* DOC_HIDDEN */
 
 static snd_config_update_t *snd_config_global_update = NULL;
 
 static int snd_config_hooks_call(snd_config_t *root, snd_config_t *config, snd_config_t *private_data)
 {
-	void *h = NULL;
 	snd_config_t *c, *func_conf = NULL;
 	char *buf = NULL;
 	const char *lib = NULL, *func_name = NULL;
@@ -3359,17 +4551,9 @@ static int snd_config_hooks_call(snd_config_t *root, snd_config_t *config, snd_c
 		buf[len-1] = '\0';
 		func_name = buf;
 	}
-	h = snd_dlopen(lib, RTLD_NOW);
-	func = h ? snd_dlsym(h, func_name, SND_DLSYM_VERSION(SND_CONFIG_DLSYM_VERSION_HOOK)) : NULL;
-	err = 0;
-	if (!h) {
-		SNDERR("Cannot open shared library %s", lib);
-		err = -ENOENT;
-	} else if (!func) {
-		SNDERR("symbol %s is not defined inside %s", func_name, lib);
-		snd_dlclose(h);
-		err = -ENXIO;
-	}
+	func = snd_dlobj_cache_get(lib, func_name,
+			SND_DLSYM_VERSION(SND_CONFIG_DLSYM_VERSION_HOOK), 1);
+	err = func ? 0 : -ENXIO;
 	_err:
 	if (func_conf)
 		snd_config_delete(func_conf);
@@ -3378,7 +4562,7 @@ static int snd_config_hooks_call(snd_config_t *root, snd_config_t *config, snd_c
 		err = func(root, config, &nroot, private_data);
 		if (err < 0)
 			SNDERR("function %s returned error: %s", func_name, snd_strerror(err));
-		snd_dlclose(h);
+		snd_dlobj_cache_put(func);
 		if (err >= 0 && nroot)
 			err = snd_config_substitute(root, nroot);
 	}
@@ -3619,25 +4803,42 @@ int snd_determine_driver(int card, char **driver);
  * This function works like #snd_config_hook_load, but the files are
  * loaded once for each sound card.  The driver name is available with
  * the \c private_string function to customize the file name.
+ *
+ * The files are not loaded by this function.  The files of a card are
+ * loaded when a search expanding hooks (like #snd_config_search_hooks)
+ * in \a root first asks for the driver name, or when such a search
+ * below \a root does not find a node the pending files might define.
  */
 int snd_config_hook_load_for_all_cards(snd_config_t *root, snd_config_t *config, snd_config_t **dst, snd_config_t *private_data ATTRIBUTE_UNUSED)
 {
-	int card = -1, err;
-	
+	struct config_lazy *lazy;
+	struct config_lazy_card *card, **tail;
+	int idx = -1, err;
+
+	lazy = calloc(1, sizeof(*lazy));
+	if (!lazy)
+		return -ENOMEM;
+	err = snd_config_copy(&lazy->hook, config);
+	if (err < 0) {
+		free(lazy);
+		return err;
+	}
+	lazy->root = root;
+	tail = &lazy->cards;
 	do {
-		err = snd_card_next(&card);
+		err = snd_card_next(&idx);
 		if (err < 0)
-			return err;
-		if (card >= 0) {
-			snd_config_t *n, *private_data = NULL;
+			goto _err;
+		if (idx >= 0) {
+			snd_config_t *n;
 			const char *driver;
 			char *fdriver = NULL;
-			err = snd_determine_driver(card, &fdriver);
+			err = snd_determine_driver(idx, &fdriver);
 			if (err < 0)
-				return err;
+				goto _err;
 			if (snd_config_search(root, fdriver, &n) >= 0) {
 				if (snd_config_get_string(n, &driver) < 0)
-					goto __err;
+					goto __next;
 				assert(driver);
 				while (1) {
 					char *s = strchr(driver, '.');
@@ -3646,26 +4847,140 @@ int snd_config_hook_load_for_all_cards(snd_config_t *root, snd_config_t *config,
 					driver = s + 1;
 				}
 				if (snd_config_search(root, driver, &n) >= 0)
-					goto __err;
+					goto __next;
 			} else {
 				driver = fdriver;
 			}
-			err = snd_config_imake_string(&private_data, "string", driver);
-			if (err < 0)
-				goto __err;
-			err = snd_config_hook_load(root, config, &n, private_data);
-		      __err:
-			if (private_data)
-				snd_config_delete(private_data);
+			for (card = lazy->cards; card; card = card->next)
+				if (!strcmp(card->driver, driver))
+					goto __next;
+			card = calloc(1, sizeof(*card));
+			if (card)
+				card->driver = strdup(driver);
+			if (!card || !card->driver) {
+				free(card);
+				free(fdriver);
+				err = -ENOMEM;
+				goto _err;
+			}
+			*tail = card;
+			tail = &card->next;
+			lazy->pending++;
+		      __next:
 			free(fdriver);
-			if (err < 0)
-				return err;
 		}
-	} while (card >= 0);
+	} while (idx >= 0);
 	*dst = NULL;
+	if (!lazy->cards) {
+		config_lazy_free(lazy);
+		return 0;
+	}
+	snd_config_lock();
+	lazy->next = config_lazy_list;
+	config_lazy_list = lazy;
+	snd_config_unlock();
 	return 0;
+ _err:
+	config_lazy_free(lazy);
+	return err;
 }
+
 #ifndef DOC_HIDDEN
+/* load the files of a pending card */
+static int config_lazy_load(struct config_lazy *lazy,
+			    struct config_lazy_card *card)
+{
+	snd_config_t *private_data, *n;
+	int err;
+
+	card->loaded = 1;
+	lazy->pending--;
+	err = snd_config_imake_string(&private_data, "string", card->driver);
+	if (err < 0)
+		return err;
+	lazy->loading = 1;
+	err = snd_config_hook_load(lazy->root, lazy->hook, &n, private_data);
+	lazy->loading = 0;
+	snd_config_delete(private_data);
+	return err;
+}
+
+static struct config_lazy_card *config_lazy_card(struct config_lazy *lazy,
+						 const char *driver, int len)
+{
+	struct config_lazy_card *card;
+
+	for (card = lazy->cards; card; card = card->next) {
+		if (!strncmp(card->driver, driver, len) &&
+		    card->driver[len] == '\0')
+			return card;
+	}
+	return NULL;
+}
+
+/*
+ * Called by the searches expanding hooks before config is searched for
+ * the first id of key.  The files of a pending card are loaded when the
+ * id below root names its driver.  Other ids are looked up as they are,
+ * and only when that fails the remaining cards are loaded in the card
+ * order until one of them defines the id, so definitions shared by all
+ * card files (like cards.pcm.front) come from the first card loaded.
+ * Nodes missing below the node of a loaded card load nothing.
+ */
+static int config_lazy_search(snd_config_t *config, const char *key)
+{
+	struct config_lazy **p, *lazy;
+	struct config_lazy_card *card;
+	snd_config_t *n, *c, *top = NULL;
+	const char *dot;
+	int len, err = 0;
+
+	if (!__atomic_load_n(&config_lazy_list, __ATOMIC_ACQUIRE))
+		return 0;
+	snd_config_lock();
+	for (c = config; c; top = c, c = c->parent) {
+		for (p = &config_lazy_list; *p; p = &(*p)->next)
+			if ((*p)->root == c)
+				goto __found;
+	}
+	snd_config_unlock();
+	return 0;
+      __found:
+	lazy = *p;
+	if (lazy->loading)
+		goto __end;
+	if (top) {
+		/* below root, top is the child of root on the way */
+		card = config_lazy_card(lazy, top->id, strlen(top->id));
+		if (card && card->loaded)
+			goto __end;
+	}
+	dot = strchr(key, '.');
+	len = dot ? dot - key : (int)strlen(key);
+	if (!top) {
+		card = config_lazy_card(lazy, key, len);
+		if (card && !card->loaded)
+			err = config_lazy_load(lazy, card);
+	}
+	for (card = lazy->cards; card && err >= 0; card = card->next) {
+		if (card->loaded)
+			continue;
+		if (_snd_config_search(config, key, len, &n) >= 0)
+			break;
+		err = config_lazy_load(lazy, card);
+	}
+	if (!lazy->pending) {
+		/* the loaded files may have added entries in front */
+		for (p = &config_lazy_list; *p != lazy; p = &(*p)->next)
+			;
+		*p = lazy->next;
+		config_lazy_free(lazy);
+	}
+      __end:
+	snd_config_unlock();
+	return err;
+}
+
 SND_DLSYM_BUILD_VERSION(snd_config_hook_load_for_all_cards, SND_CONFIG_DLSYM_VERSION_HOOK);
 #endif
 
@@ -3688,6 +5003,18 @@ SND_DLSYM_BUILD_VERSION(snd_config_hook_load_for_all_cards, SND_CONFIG_DLSYM_VER
  * The global configuration files are specified in the environment variable
  * \c ALSA_CONFIG_PATH.
  *
+ * The directories of the files are watched with inotify; while no event
+ * arrived, the files are known to be unchanged and are not examined at
+ * all.  Without the watch (e.g. a directory does not exist), each call
+ * compares the device, inode and modification time of every file.
+ *
+ * When the environment variable \c ALSA_CONFIG_CACHE names a file, the
+ * parsed contents of these files are kept there in binary form and
+ * read back instead of parsing the text as long as no file was changed
+ * (the device, inode and modification time of each file are compared).
+ * The hooks, like the loading of alsa.conf.d and the card configurations,
+ * still run on every reread.
+ *
  * \warning If the configuration tree is reread, all string pointers and
  * configuration node handles previously obtained from this tree become
  * invalid.
@@ -3705,15 +5032,16 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 	snd_config_update_t *local;
 	snd_config_update_t *update;
 	snd_config_t *top;
+	const char *cache;
 	
 	assert(_top && _update);
 	top = *_top;
 	update = *_update;
-	configs = cfgs;
-	if (!configs) {
-		configs = getenv(ALSA_CONFIG_PATH_VAR);
-		if (!configs || !*configs)
-			configs = ALSA_CONFIG_PATH_DEFAULT;
+	configs = config_update_files(cfgs);
+	if (top && update) {
+		if (config_update_quiet(update, configs))
+			return 0;
+		config_update_reset(update);
 	}
 	for (k = 0, c = configs; (l = strcspn(c, ": ")) > 0; ) {
 		c += l;
@@ -3735,6 +5063,9 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 		free(local);
 		return -ENOMEM;
 	}
+	local->configs = strdup(configs);
+	if (local->configs)
+		config_update_watch(local, configs);
 	for (k = 0, c = configs; (l = strcspn(c, ": ")) > 0; ) {
 		char name[l + 1];
 		memcpy(name, c, l);
@@ -3776,6 +5107,16 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 		    lf->mtime != uf->mtime)
 			goto _reread;
 	}
+	/* nothing changed, keep watching with the fresh queue if needed */
+	if (!update->watch && local->watch) {
+		free(update->configs);
+		update->configs = local->configs;
+		update->watch = local->watch;
+		update->watch_count = local->watch_count;
+		local->configs = NULL;
+		local->watch = NULL;
+		local->watch_count = 0;
+	}
 	err = 0;
 
  _end:
@@ -3809,20 +5150,38 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 		goto _end;
 	if (!local)
 		goto _skip;
+	cache = getenv(ALSA_CONFIG_CACHE_VAR);
+	if (cache && *cache) {
+		if (config_cache_load(top, local, cache) >= 0)
+			goto _skip;
+		/* drop what a broken cache left behind */
+		snd_config_delete(top);
+		err = snd_config_top(&top);
+		if (err < 0) {
+			top = NULL;
+			goto _end;
+		}
+	}
 	for (k = 0; k < local->count; ++k) {
 		snd_input_t *in;
+		unsigned int includes;
 		err = snd_input_stdio_open(&in, local->finfo[k].name, "r");
 		if (err >= 0) {
-			err = snd_config_load(top, in);
+			err = snd_config_load1(top, in, 0, &includes);
 			snd_input_close(in);
 			if (err < 0) {
 				SNDERR("%s may be old or corrupted: consider to remove or fix it", local->finfo[k].name);
 				goto _end;
 			}
+			if (includes)
+				cache = NULL;
 		} else {
 			SNDERR("cannot access file %s", local->finfo[k].name);
+			cache = NULL;
 		}
 	}
+	if (cache && *cache)
+		config_cache_save(top, local, cache);
  _skip:
 	err = snd_config_hooks(top, NULL);
 	if (err < 0) {
@@ -3834,6 +5193,115 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 	return 1;
 }
 
+#ifndef DOC_HIDDEN
+struct config_update_callback {
+	void (*callback)(void *private_data);
+	void *private_data;
+	struct list_head list;
+};
+
+static LIST_HEAD(config_update_callbacks);
+
+/* called with the global configuration locked after it was reread */
+static void config_update_notify(void)
+{
+	struct list_head *pos, *next;
+
+	list_for_each_safe(pos, next, &config_update_callbacks) {
+		struct config_update_callback *cb;
+		cb = list_entry(pos, struct config_update_callback, list);
+		cb->callback(cb->private_data);
+	}
+}
+#endif
+
+/**
+ * \brief Subscribes to rereads of the global configuration.
+ * \param callback Function called after #snd_config was reread.
+ * \param private_data Value passed to \a callback.
+ * \return Zero if successful, otherwise a negative error code.
+ *
+ * The callback runs whenever #snd_config_update or #snd_config_update_ref
+ * (also called by the open functions of the devices) replaced
+ * #snd_config, so an application can drop handles made with the old
+ * configuration without polling.  The callback is called with the
+ * global configuration locked; it may use the configuration functions,
+ * but must not block.
+ *
+ * The check for changed files is cheap: while the configuration files
+ * are watched by inotify, nothing but an empty read of the queue is done
+ * when they did not change.
+ */
+int snd_config_update_add_callback(void (*callback)(void *private_data),
+				   void *private_data)
+{
+	struct config_update_callback *cb;
+
+	if (!callback)
+		return -EINVAL;
+	cb = malloc(sizeof(*cb));
+	if (!cb)
+		return -ENOMEM;
+	cb->callback = callback;
+	cb->private_data = private_data;
+	snd_config_lock();
+	list_add_tail(&cb->list, &config_update_callbacks);
+	snd_config_unlock();
+	return 0;
+}
+
+/**
+ * \brief Unsubscribes from rereads of the global configuration.
+ * \param callback Function given to #snd_config_update_add_callback.
+ * \param private_data Value given to #snd_config_update_add_callback.
+ * \return Zero if successful, -ENOENT if no such subscription exists.
+ */
+int snd_config_update_remove_callback(void (*callback)(void *private_data),
+				      void *private_data)
+{
+	struct list_head *pos;
+	int err = -ENOENT;
+
+	snd_config_lock();
+	list_for_each(pos, &config_update_callbacks) {
+		struct config_update_callback *cb;
+		cb = list_entry(pos, struct config_update_callback, list);
+		if (cb->callback == callback && cb->private_data == private_data) {
+			list_del(&cb->list);
+			free(cb);
+			err = 0;
+			break;
+		}
+	}
+	snd_config_unlock();
+	return err;
+}
+
+#ifndef DOC_HIDDEN
+/*
+ * Take a reference of snd_config if its files did not change; returns 0
+ * when the configuration has to be updated with the update mutex held.
+ */
+static int config_global_get(snd_config_t **top)
+{
+	const char *configs = config_update_files(NULL);
+	int ret = 0, locked;
+
+	locked = snd_config_global_rdlock();
+	if (snd_config && snd_config_global_update &&
+	    config_update_quiet(snd_config_global_update, configs)) {
+		if (top) {
+			__atomic_fetch_add(&snd_config->refcount, 1,
+					   __ATOMIC_RELAXED);
+			*top = snd_config;
+		}
+		ret = 1;
+	}
+	snd_config_global_rdunlock(locked);
+	return ret;
+}
+#endif
+
 /** 
  * \brief Updates #snd_config by rereading the global configuration files (if needed).
  * \return 0 if #snd_config was up to date, 1 if #snd_config was
@@ -3856,8 +5324,14 @@ int snd_config_update(void)
 {
 	int err;
 
+	if (config_global_get(NULL))
+		return 0;
 	snd_config_lock();
+	snd_config_global_wrlock();
 	err = snd_config_update_r(&snd_config, &snd_config_global_update, NULL);
+	snd_config_global_unlock();
+	if (err > 0)
+		config_update_notify();
 	snd_config_unlock();
 	return err;
 }
@@ -3871,7 +5345,8 @@ int snd_config_update(void)
  * so that the obtained tree won't be deleted until unreferenced by
  * #snd_config_unref.
  *
- * This function is supposed to be thread-safe.
+ * This function is supposed to be thread-safe.  While the configuration
+ * files did not change, concurrent calls do not wait for each other.
  */
 int snd_config_update_ref(snd_config_t **top)
 {
@@ -3879,18 +5354,25 @@ int snd_config_update_ref(snd_config_t **top)
 
 	if (top)
 		*top = NULL;
+	if (config_global_get(top))
+		return 0;
 	snd_config_lock();
+	snd_config_global_wrlock();
 	err = snd_config_update_r(&snd_config, &snd_config_global_update, NULL);
 	if (err >= 0) {
 		if (snd_config) {
 			if (top) {
-				snd_config->refcount++;
+				__atomic_fetch_add(&snd_config->refcount, 1,
+						   __ATOMIC_RELAXED);
 				*top = snd_config;
 			}
 		} else {
 			err = -ENODEV;
 		}
 	}
+	snd_config_global_unlock();
+	if (err > 0)
+		config_update_notify();
 	snd_config_unlock();
 	return err;
 }
@@ -3904,10 +5386,8 @@ int snd_config_update_ref(snd_config_t **top)
  */
 void snd_config_ref(snd_config_t *cfg)
 {
-	snd_config_lock();
 	if (cfg)
-		cfg->refcount++;
-	snd_config_unlock();
+		__atomic_fetch_add(&cfg->refcount, 1, __ATOMIC_RELAXED);
 }
 
 /**
@@ -3924,10 +5404,9 @@ void snd_config_ref(snd_config_t *cfg)
  */
 void snd_config_unref(snd_config_t *cfg)
 {
-	snd_config_lock();
+	/* the last reference is a tree no longer published as snd_config */
 	if (cfg)
 		snd_config_delete(cfg);
-	snd_config_unlock();
 }
 
 /** 
@@ -3943,6 +5422,8 @@ int snd_config_update_free(snd_config_update_t *update)
 	for (k = 0; k < update->count; k++)
 		free(update->finfo[k].name);
 	free(update->finfo);
+	free(update->configs);
+	config_update_unwatch(update);
 	free(update);
 	return 0;
 }
@@ -3960,15 +5441,27 @@ int snd_config_update_free(snd_config_update_t *update)
 int snd_config_update_free_global(void)
 {
 	snd_config_lock();
+	snd_config_global_wrlock();
 	if (snd_config)
 		snd_config_delete(snd_config);
 	snd_config = NULL;
 	if (snd_config_global_update)
 		snd_config_update_free(snd_config_global_update);
 	snd_config_global_update = NULL;
+	snd_config_global_unlock();
 	snd_config_unlock();
 	/* FIXME: better to place this in another place... */
 	snd_dlobj_cache_cleanup();
+	snd_device_name_hint_cache_cleanup();
+#if defined(BUILD_MIXER) && defined(HAVE_LIBDL)
+	snd_mixer_simple_cache_cleanup();
+#endif
+#ifdef BUILD_PCM
+	snd_timer_query_cache_cleanup();
+#endif
+#ifdef BUILD_UCM
+	snd_ucm_cache_cleanup();
+#endif
 
 	return 0;
 }
@@ -4293,7 +5786,6 @@ static int _snd_config_evaluate(snd_config_t *src,
 		const char *str;
 		int (*func)(snd_config_t **dst, snd_config_t *root,
 			    snd_config_t *src, snd_config_t *private_data) = NULL;
-		void *h = NULL;
 		snd_config_t *c, *func_conf = NULL;
 		err = snd_config_search(src, "@func", &c);
 		if (err < 0)
@@ -4347,20 +5839,9 @@ static int _snd_config_evaluate(snd_config_t *src,
 			buf[len-1] = '\0';
 			func_name = buf;
 		}
-		h = snd_dlopen(lib, RTLD_NOW);
-		if (h)
-			func = snd_dlsym(h, func_name, SND_DLSYM_VERSION(SND_CONFIG_DLSYM_VERSION_EVALUATE));
-		err = 0;
-		if (!h) {
-			SNDERR("Cannot open shared library %s", lib);
-			err = -ENOENT;
-			goto _errbuf;
-		} else if (!func) {
-			SNDERR("symbol %s is not defined inside %s", func_name, lib);
-			snd_dlclose(h);
-			err = -ENXIO;
-			goto _errbuf;
-		}
+		func = snd_dlobj_cache_get(lib, func_name,
+				SND_DLSYM_VERSION(SND_CONFIG_DLSYM_VERSION_EVALUATE), 1);
+		err = func ? 0 : -ENXIO;
 	       _err:
 		if (func_conf)
 			snd_config_delete(func_conf);
@@ -4369,7 +5850,7 @@ static int _snd_config_evaluate(snd_config_t *src,
 			err = func(&eval, root, src, private_data);
 			if (err < 0)
 				SNDERR("function %s returned error: %s", func_name, snd_strerror(err));
-			snd_dlclose(h);
+			snd_dlobj_cache_put(func);
 			if (err >= 0 && eval) {
 				/* substitute merges compound members */
 				/* we don't want merging at all */
@@ -4378,7 +5859,6 @@ static int _snd_config_evaluate(snd_config_t *src,
 					err = snd_config_substitute(src, eval);
 			}
 		}
-	       _errbuf:
 		free(buf);
 		if (err < 0)
 			return err;
@@ -4789,25 +6269,31 @@ static int parse_args(snd_config_t *subs, const char *str, snd_config_t *defs)
 	return 0;
 }
 
-/**
- * \brief Expands a configuration node, applying arguments and functions.
- * \param[in] config Handle to the configuration node.
- * \param[in] root Handle to the root configuration node.
- * \param[in] args Arguments string, can be \c NULL.
- * \param[in] private_data Handle to the private data node for functions.
- * \param[out] result The function puts the handle to the result
- *                    configuration node at the address specified by
- *                    \a result.
- * \return A non-negative value if successful, otherwise a negative error code.
- *
- * If \a config has arguments (defined by a child with id \c \@args),
- * this function replaces any string node beginning with $ with the
- * respective argument value, or the default argument value, or nothing.
- * Furthermore, any functions are evaluated (see #snd_config_evaluate).
- * The resulting copy of \a config is returned in \a result.
+#ifndef DOC_HIDDEN
+/* does the subtree contain any function to be evaluated? */
+static int config_has_func(snd_config_t *config)
+{
+	snd_config_iterator_t i, next;
+
+	if (config->type != SND_CONFIG_TYPE_COMPOUND)
+		return 0;
+	snd_config_for_each(i, next, config) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		if (strcmp(n->id, "@func") == 0 || config_has_func(n))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * With share set, a definition without arguments and functions is not
+ * copied: the node itself is returned as a reference of the thread.
+ * snd_config_delete() from the thread releases it; deleted by the owner
+ * meanwhile, the node is detached from its tree and freed at the release.
  */
-int snd_config_expand(snd_config_t *config, snd_config_t *root, const char *args,
-		      snd_config_t *private_data, snd_config_t **result)
+static int config_expand(snd_config_t *config, snd_config_t *root, const char *args,
+			 snd_config_t *private_data, snd_config_t **result,
+			 int share)
 {
 	int err;
 	snd_config_t *defs, *subs = NULL, *res;
@@ -4817,6 +6303,11 @@ int snd_config_expand(snd_config_t *config, snd_config_t *root, const char *args
 			SNDERR("Unknown parameters %s", args);
 			return -EINVAL;
 		}
+		if (share && !config_has_func(config) &&
+		    config_shared_get(config) >= 0) {
+			*result = config;
+			return 1;
+		}
 		err = snd_config_copy(&res, config);
 		if (err < 0)
 			return err;
@@ -4858,6 +6349,37 @@ int snd_config_expand(snd_config_t *config, snd_config_t *root, const char *args
 		snd_config_delete(subs);
 	return err;
 }
+#endif /* DOC_HIDDEN */
+
+/**
+ * \brief Expands a configuration node, applying arguments and functions.
+ * \param[in] config Handle to the configuration node.
+ * \param[in] root Handle to the root configuration node.
+ * \param[in] args Arguments string, can be \c NULL.
+ * \param[in] private_data Handle to the private data node for functions.
+ * \param[out] result The function puts the handle to the result
+ *                    configuration node at the address specified by
+ *                    \a result.
+ * \return A non-negative value if successful, otherwise a negative error code.
+ *
+ * If \a config has arguments (defined by a child with id \c \@args),
+ * this function replaces any string node beginning with $ with the
+ * respective argument value, or the default argument value, or nothing.
+ * Furthermore, any functions are evaluated (see #snd_config_evaluate).
+ * The resulting copy of \a config is returned in \a result.
+ */
+int snd_config_expand(snd_config_t *config, snd_config_t *root, const char *args,
+		      snd_config_t *private_data, snd_config_t **result)
+{
+	return config_expand(config, root, args, private_data, result, 0);
+}
+
+
+#ifndef DOC_HIDDEN
+static int config_search_definition(snd_config_t *config,
+				    const char *base, const char *name,
+				    snd_config_t **result, int share);
+#endif
 
 /**
  * \brief Searches for a definition in a configuration tree, using
@@ -4891,11 +6413,106 @@ int snd_config_expand(snd_config_t *config, snd_config_t *root, const char *args
 int snd_config_search_definition(snd_config_t *config,
 				 const char *base, const char *name,
 				 snd_config_t **result)
+{
+	return config_search_definition(config, base, name, result, 0);
+}
+
+#ifndef DOC_HIDDEN
+/*
+ * Like snd_config_search_definition(), but a definition which needs no
+ * expansion is returned as a reference into config rather than a copy.
+ * The result must be treated as read only and released with
+ * snd_config_delete() by the same thread.  snd_config_set_hop() keeps the
+ * hop with the reference, not in the node.
+ */
+int snd_config_search_definition_shared(snd_config_t *config,
+					const char *base, const char *name,
+					snd_config_t **result)
+{
+	return config_search_definition(config, base, name, result, 1);
+}
+#endif
+
+#ifndef DOC_HIDDEN
+/*
+ * Definition log: while a thread has a log set, the outermost definition
+ * searches of the thread are recorded in it, as copies of their results
+ * with the base and the name including the arguments as id.  In replay
+ * mode the searches are answered from it instead, without the search,
+ * the expansion and the functions they took; a search which is not in
+ * the log runs as usual.  See pcm_descriptor.c.
+ */
+static TLS_PFX snd_config_t *definition_log;
+static TLS_PFX int definition_replay;
+static TLS_PFX int definition_depth;
+
+void snd_config_definition_log(snd_config_t *log, int replay)
+{
+	definition_log = log;
+	definition_replay = replay;
+	definition_depth = 0;
+}
+
+static snd_config_t *definition_log_find(const char *key)
+{
+	snd_config_iterator_t i, next;
+
+	snd_config_for_each(i, next, definition_log) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		if (n->id && !strcmp(n->id, key))
+			return n;
+	}
+	return NULL;
+}
+
+static int config_search_definition_log(snd_config_t *config,
+					const char *base, const char *name,
+					snd_config_t **result, int share)
+{
+	snd_config_t *n, *copy;
+	char *key;
+	int err;
+
+	if (base) {
+		key = malloc(strlen(base) + strlen(name) + 2);
+		if (key)
+			sprintf(key, "%s.%s", base, name);
+	} else {
+		key = strdup(name);
+	}
+	if (!key)
+		return -ENOMEM;
+	n = definition_log_find(key);
+	if (n && definition_replay) {
+		free(key);
+		err = snd_config_copy(result, n);
+		return err < 0 ? err : 1;
+	}
+	definition_depth++;
+	err = config_search_definition(config, base, name, result, share);
+	definition_depth--;
+	if (err >= 0 && !n && !definition_replay &&
+	    snd_config_copy(&copy, *result) >= 0) {
+		if (snd_config_set_id(copy, key) < 0 ||
+		    snd_config_add(definition_log, copy) < 0)
+			snd_config_delete(copy);
+	}
+	free(key);
+	return err;
+}
+#endif /* DOC_HIDDEN */
+
+static int config_search_definition(snd_config_t *config,
+				    const char *base, const char *name,
+				    snd_config_t **result, int share)
 {
 	snd_config_t *conf;
 	char *key;
 	const char *args = strchr(name, ':');
 	int err;
+	if (definition_log && !definition_depth)
+		return config_search_definition_log(config, base, name,
+						    result, share);
 	if (args) {
 		args++;
 		key = alloca(args - name);
@@ -4914,25 +6531,41 @@ int snd_config_search_definition(snd_config_t *config,
 		snd_config_unlock();
 		return err;
 	}
-	err = snd_config_expand(conf, config, args, NULL, result);
+	err = config_expand(conf, config, args, NULL, result, share);
 	snd_config_unlock();
 	return err;
 }
 
 #ifndef DOC_HIDDEN
+/* a shared definition keeps the hop with the reference of the thread */
 void snd_config_set_hop(snd_config_t *conf, int hop)
 {
-	conf->hop = hop;
+	struct config_shared **p;
+
+	snd_config_lock();
+	p = config_shared_find(conf);
+	if (p)
+		(*p)->hop = hop;
+	else
+		conf->hop = hop;
+	snd_config_unlock();
 }
 
 int snd_config_check_hop(snd_config_t *conf)
 {
+	struct config_shared **p;
+	int hop;
+
 	if (conf) {
-		if (conf->hop >= SND_CONF_MAX_HOPS) {
+		snd_config_lock();
+		p = config_shared_find(conf);
+		hop = p ? (*p)->hop : conf->hop;
+		snd_config_unlock();
+		if (hop >= SND_CONF_MAX_HOPS) {
 			SYSERR("Too many definition levels (looped?)\n");
 			return -EINVAL;
 		}
-		return conf->hop;
+		return hop;
 	}
 	return 0;
 }
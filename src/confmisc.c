@@ -663,33 +663,21 @@ SND_DLSYM_BUILD_VERSION(snd_func_private_string, SND_CONFIG_DLSYM_VERSION_EVALUA
 #ifndef DOC_HIDDEN
 int snd_determine_driver(int card, char **driver)
 {
-	snd_ctl_t *ctl = NULL;
 	snd_ctl_card_info_t info = {0};
 	char *res = NULL;
 	int err;
 
 	assert(card >= 0 && card <= SND_MAX_CARDS);
-	err = open_ctl(card, &ctl);
-	if (err < 0) {
-		SNDERR("could not open control for card %i", card);
-		goto __error;
-	}
-	err = snd_ctl_card_info(ctl, &info);
+	err = snd_card_get_info_cached(card, &info);
 	if (err < 0) {
-		SNDERR("snd_ctl_card_info error: %s", snd_strerror(err));
-		goto __error;
+		SNDERR("could not get info for card %i: %s", card, snd_strerror(err));
+		return err;
 	}
 	res = strdup(snd_ctl_card_info_get_driver(&info));
 	if (res == NULL)
-		err = -ENOMEM;
-	else {
-		*driver = res;
-		err = 0;
-	}
-      __error:
-	if (ctl)
-		snd_ctl_close(ctl);
-	return err;
+		return -ENOMEM;
+	*driver = res;
+	return 0;
 }
 #endif
 
@@ -861,7 +849,6 @@ SND_DLSYM_BUILD_VERSION(snd_func_card_driver, SND_CONFIG_DLSYM_VERSION_EVALUATE)
 int snd_func_card_id(snd_config_t **dst, snd_config_t *root, snd_config_t *src,
 		     snd_config_t *private_data)
 {
-	snd_ctl_t *ctl = NULL;
 	snd_ctl_card_info_t info = {0};
 	const char *id;
 	int card, err;
@@ -869,23 +856,15 @@ int snd_func_card_id(snd_config_t **dst, snd_config_t *root, snd_config_t *src,
 	card = parse_card(root, src, private_data);
 	if (card < 0)
 		return card;
-	err = open_ctl(card, &ctl);
-	if (err < 0) {
-		SNDERR("could not open control for card %i", card);
-		goto __error;
-	}
-	err = snd_ctl_card_info(ctl, &info);
+	err = snd_card_get_info_cached(card, &info);
 	if (err < 0) {
-		SNDERR("snd_ctl_card_info error: %s", snd_strerror(err));
-		goto __error;
+		SNDERR("could not get info for card %i: %s", card, snd_strerror(err));
+		return err;
 	}
 	err = snd_config_get_id(src, &id);
 	if (err >= 0)
 		err = snd_config_imake_string(dst, id,
 					      snd_ctl_card_info_get_id(&info));
-      __error:
-      	if (ctl)
-      		snd_ctl_close(ctl);
 	return err;
 }
 #ifndef DOC_HIDDEN
@@ -912,7 +891,6 @@ SND_DLSYM_BUILD_VERSION(snd_func_card_id, SND_CONFIG_DLSYM_VERSION_EVALUATE);
 int snd_func_card_name(snd_config_t **dst, snd_config_t *root,
 		       snd_config_t *src, snd_config_t *private_data)
 {
-	snd_ctl_t *ctl = NULL;
 	snd_ctl_card_info_t info = {0};
 	const char *id;
 	int card, err;
@@ -920,23 +898,15 @@ int snd_func_card_name(snd_config_t **dst, snd_config_t *root,
 	card = parse_card(root, src, private_data);
 	if (card < 0)
 		return card;
-	err = open_ctl(card, &ctl);
+	err = snd_card_get_info_cached(card, &info);
 	if (err < 0) {
-		SNDERR("could not open control for card %i", card);
-		goto __error;
-	}
-	err = snd_ctl_card_info(ctl, &info);
-	if (err < 0) {
-		SNDERR("snd_ctl_card_info error: %s", snd_strerror(err));
-		goto __error;
+		SNDERR("could not get info for card %i: %s", card, snd_strerror(err));
+		return err;
 	}
 	err = snd_config_get_id(src, &id);
 	if (err >= 0)
 		err = snd_config_imake_safe_string(dst, id,
 					snd_ctl_card_info_get_name(&info));
-      __error:
-      	if (ctl)
-      		snd_ctl_close(ctl);
 	return err;
 }
 #ifndef DOC_HIDDEN
@@ -31,50 +31,194 @@
 #include <string.h>
 #include <ctype.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
 #include <sys/ioctl.h>
+#include <sys/inotify.h>
 #include "control_local.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef DOC_HIDDEN
 #define SND_FILE_CONTROL	ALSA_DEVICE_DIRECTORY "controlC%i"
 #define SND_FILE_LOAD		ALOAD_DEVICE_DIRECTORY "aloadC%i"
 #endif
 
-static int snd_card_load2(const char *control)
+/*
+ * Card info cache.  The info of a card does not change while the card
+ * is present, and a card coming or going creates or removes its device
+ * nodes.  An inotify watch on the device directory drops the whole
+ * cache on any such change, so looking up a known card needs no device
+ * open.  Without a working watch nothing is cached.  Besides the info
+ * only the absence of a card is cached: an error like -EACCES may go
+ * away without a hotplug, e.g. when logind sets the ACL of the control
+ * device of a seat, which the watch reports as an attribute change.
+ *
+ * The cache is filled in one pass: the device directory is read once to
+ * learn which cards are present, and only their control devices are
+ * opened, instead of probing every possible card one after another.
+ */
+static struct {
+	int res;		/* 0 if unknown, card + 1 or a negative error */
+	snd_ctl_card_info_t info;
+} card_cache[SND_MAX_CARDS];
+static snd_watch_t card_cache_watch;
+static int card_cache_filled;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t card_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void card_cache_lock(void)
+{
+	pthread_mutex_lock(&card_cache_mutex);
+}
+
+static inline void card_cache_unlock(void)
+{
+	pthread_mutex_unlock(&card_cache_mutex);
+}
+#else
+static inline void card_cache_lock(void) {}
+static inline void card_cache_unlock(void) {}
+#endif
+
+/* apply the pending device directory events, returns 0 if the cache is usable */
+static int card_cache_sync(void)
+{
+	int res, err;
+
+	res = snd_watch_changed(&card_cache_watch);
+	if (res < 0) {
+		/* not set up yet, or a fork or overflow ended the watch */
+		snd_watch_remove(&card_cache_watch);
+		err = snd_watch_add(&card_cache_watch, ALSA_DEVICE_DIRECTORY,
+				    IN_CREATE | IN_DELETE | IN_MOVE | IN_ATTRIB |
+				    IN_DELETE_SELF | IN_MOVE_SELF);
+		if (err < 0)
+			return err;
+	} else if (res > 0) {
+		snd_watch_reset(&card_cache_watch);
+	}
+	if (res) {
+		memset(card_cache, 0, sizeof(card_cache));
+		card_cache_filled = 0;
+	}
+	return 0;
+}
+
+static int snd_card_load2(const char *control, snd_ctl_card_info_t *info)
 {
 	int open_dev;
-	snd_ctl_card_info_t info;
 
 	open_dev = snd_open_device(control, O_RDONLY);
 	if (open_dev >= 0) {
-		if (ioctl(open_dev, SNDRV_CTL_IOCTL_CARD_INFO, &info) < 0) {
+		if (ioctl(open_dev, SNDRV_CTL_IOCTL_CARD_INFO, info) < 0) {
 			int err = -errno;
 			close(open_dev);
 			return err;
 		}
 		close(open_dev);
-		return info.card;
+		return info->card;
 	} else {
 		return -errno;
 	}
 }
 
-static int snd_card_load1(int card)
+/* load the info of all present cards, called with the cache lock held */
+static void card_cache_fill(void)
+{
+	char control[sizeof(SND_FILE_CONTROL) + sizeof(SND_FILE_LOAD) + 10];
+	char present[SND_MAX_CARDS];
+	struct dirent *entry;
+	DIR *dir;
+	int card, res;
+
+	card_cache_filled = 1;
+	dir = opendir(ALSA_DEVICE_DIRECTORY);
+	if (dir == NULL)
+		return;
+	memset(present, 0, sizeof(present));
+	while ((entry = readdir(dir)) != NULL) {
+		if (sscanf(entry->d_name, "controlC%d", &card) == 1 &&
+		    card >= 0 && card < SND_MAX_CARDS)
+			present[card] = 1;
+	}
+	closedir(dir);
+	for (card = 0; card < SND_MAX_CARDS; card++) {
+		if (card_cache[card].res)
+			continue;
+		if (!present[card]) {
+#ifdef SUPPORT_ALOAD
+			/* opening the aload device may still load the driver */
+			sprintf(control, SND_FILE_LOAD, card);
+			if (access(control, F_OK) == 0)
+				continue;
+#endif
+			/* the watch reports a card showing up later */
+			card_cache[card].res = -ENOENT;
+			continue;
+		}
+		sprintf(control, SND_FILE_CONTROL, card);
+		res = snd_card_load2(control, &card_cache[card].info);
+		if (res >= 0 || res == -ENOENT)
+			card_cache[card].res = res >= 0 ? res + 1 : res;
+	}
+}
+
+static int snd_card_load1(int card, snd_ctl_card_info_t *info)
 {
-	int res;
+	int res, cached;
 	char control[sizeof(SND_FILE_CONTROL) + 10];
+	snd_ctl_card_info_t tmp;
 
+	if (!info)
+		info = &tmp;
+	if (card < 0 || card >= SND_MAX_CARDS)
+		return -EINVAL;
+	card_cache_lock();
+	cached = card_cache_sync() >= 0;
+	if (cached && !card_cache_filled)
+		card_cache_fill();
+	if (cached && card_cache[card].res) {
+		res = card_cache[card].res;
+		if (res > 0) {
+			*info = card_cache[card].info;
+			res--;
+		}
+		card_cache_unlock();
+		return res;
+	}
 	sprintf(control, SND_FILE_CONTROL, card);
-	res = snd_card_load2(control);
+	res = snd_card_load2(control, info);
 #ifdef SUPPORT_ALOAD
 	if (res < 0) {
 		char aload[sizeof(SND_FILE_LOAD) + 10];
 		sprintf(aload, SND_FILE_LOAD, card);
-		res = snd_card_load2(aload);
+		res = snd_card_load2(aload, info);
 	}
+	/* a later open may still load the driver */
+	if (res < 0)
+		cached = 0;
 #endif
+	if (cached && (res >= 0 || res == -ENOENT)) {
+		card_cache[card].res = res >= 0 ? res + 1 : res;
+		if (res >= 0)
+			card_cache[card].info = *info;
+	}
+	card_cache_unlock();
 	return res;
 }
 
+#ifndef DOC_HIDDEN
+/* get the card info, from the cache when the card is known */
+int snd_card_get_info_cached(int card, snd_ctl_card_info_t *info)
+{
+	int err = snd_card_load1(card, info);
+	return err < 0 ? err : 0;
+}
+#endif
+
 /**
  * \brief Try to load the driver for a card.
  * \param card Card number.
@@ -82,7 +226,7 @@ static int snd_card_load1(int card)
  */
 int snd_card_load(int card)
 {
-	return !!(snd_card_load1(card) >= 0);
+	return !!(snd_card_load1(card, NULL) >= 0);
 }
 
 /**
@@ -125,7 +269,6 @@ int snd_card_next(int *rcard)
 int snd_card_get_index(const char *string)
 {
 	int card, err;
-	snd_ctl_t *handle;
 	snd_ctl_card_info_t info;
 
 	if (!string || *string == '\0')
@@ -136,25 +279,16 @@ int snd_card_get_index(const char *string)
 			return -EINVAL;
 		if (card < 0 || card >= SND_MAX_CARDS)
 			return -EINVAL;
-		err = snd_card_load1(card);
+		err = snd_card_load1(card, NULL);
 		if (err >= 0)
 			return card;
 		return err;
 	}
 	if (string[0] == '/')	/* device name */
-		return snd_card_load2(string);
+		return snd_card_load2(string, &info);
 	for (card = 0; card < SND_MAX_CARDS; card++) {
-#ifdef SUPPORT_ALOAD
-		if (! snd_card_load(card))
-			continue;
-#endif
-		if (snd_ctl_hw_open(&handle, NULL, card, 0) < 0)
+		if (snd_card_load1(card, &info) < 0)
 			continue;
-		if (snd_ctl_card_info(handle, &info) < 0) {
-			snd_ctl_close(handle);
-			continue;
-		}
-		snd_ctl_close(handle);
 		if (!strcmp((const char *)info.id, string))
 			return card;
 	}
@@ -172,19 +306,13 @@ int snd_card_get_index(const char *string)
  */
 int snd_card_get_name(int card, char **name)
 {
-	snd_ctl_t *handle;
 	snd_ctl_card_info_t info;
 	int err;
 	
 	if (name == NULL)
 		return -EINVAL;
-	if ((err = snd_ctl_hw_open(&handle, NULL, card, 0)) < 0)
-		return err;
-	if ((err = snd_ctl_card_info(handle, &info)) < 0) {
-		snd_ctl_close(handle);
+	if ((err = snd_card_get_info_cached(card, &info)) < 0)
 		return err;
-	}
-	snd_ctl_close(handle);
 	*name = strdup((const char *)info.name);
 	if (*name == NULL)
 		return -ENOMEM;
@@ -202,19 +330,13 @@ int snd_card_get_name(int card, char **name)
  */
 int snd_card_get_longname(int card, char **name)
 {
-	snd_ctl_t *handle;
 	snd_ctl_card_info_t info;
 	int err;
 	
 	if (name == NULL)
 		return -EINVAL;
-	if ((err = snd_ctl_hw_open(&handle, NULL, card, 0)) < 0)
-		return err;
-	if ((err = snd_ctl_card_info(handle, &info)) < 0) {
-		snd_ctl_close(handle);
+	if ((err = snd_card_get_info_cached(card, &info)) < 0)
 		return err;
-	}
-	snd_ctl_close(handle);
 	*name = strdup((const char *)info.longname);
 	if (*name == NULL)
 		return -ENOMEM;
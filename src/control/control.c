@@ -253,6 +253,49 @@ int snd_ctl_poll_descriptors_revents(snd_ctl_t *ctl, struct pollfd *pfds, unsign
 	return -EINVAL;
 }
 
+static int snd_ctl_evloop_count(void *handle)
+{
+	return snd_ctl_poll_descriptors_count(handle);
+}
+
+static int snd_ctl_evloop_descriptors(void *handle, struct pollfd *pfds, unsigned int space)
+{
+	return snd_ctl_poll_descriptors(handle, pfds, space);
+}
+
+static int snd_ctl_evloop_revents(void *handle, struct pollfd *pfds, unsigned int nfds,
+		unsigned short *revents)
+{
+	return snd_ctl_poll_descriptors_revents(handle, pfds, nfds, revents);
+}
+
+static const snd_evloop_ops_t snd_ctl_evloop_ops = {
+	.count = snd_ctl_evloop_count,
+	.descriptors = snd_ctl_evloop_descriptors,
+	.revents = snd_ctl_evloop_revents,
+};
+
+/**
+ * \brief Registers a CTL handle with an event loop
+ * \param loop Event loop
+ * \param srcp Returned source, may be NULL
+ * \param ctl CTL handle
+ * \param callback Callback for the events of the handle
+ * \param private_data Value for #snd_evloop_source_get_callback_private
+ * \return 0 on success otherwise a negative error code
+ *
+ * The callback gets the events translated by
+ * #snd_ctl_poll_descriptors_revents.  The poll descriptors are read
+ * once; see #snd_evloop_source_refresh.
+ */
+int snd_ctl_evloop_add(snd_evloop_t *loop, snd_evloop_source_t **srcp, snd_ctl_t *ctl,
+		snd_evloop_callback_t callback, void *private_data)
+{
+	assert(ctl);
+	return snd_evloop_add_source(loop, srcp, &snd_ctl_evloop_ops, ctl, 0,
+				     callback, private_data);
+}
+
 /**
  * \brief Ask to be informed about events (poll, #snd_async_add_ctl_handler, #snd_ctl_read)
  * \param ctl CTL handle
@@ -419,6 +462,44 @@ int snd_ctl_add_integer_elem_set(snd_ctl_t *ctl, snd_ctl_elem_info_t *info,
 	return 0;
 }
 
+/**
+ * \brief Create and add some user-defined integer elements sharing a TLV.
+ * \param ctl A handle of backend module for control interface.
+ * \param info Common iformation for a new element set, with ID of the first new
+ *	       element.
+ * \param element_count The number of elements added by this operation.
+ * \param member_count The number of members which a element has to
+ *			   represent its states.
+ * \param min Minimum value for each member of the elements.
+ * \param max Maximum value for each member of the elements.
+ * \param step The step of value for each member in the elements.
+ * \param tlv TLV data for all the elements, or NULL for none.
+ * \return Zero on success, otherwise a negative error code.
+ *
+ * This function works as snd_ctl_add_integer_elem_set(), then writes
+ * \a tlv once for the whole set: the elements of a set share one TLV,
+ * so e.g. a dB scale does not need to be written for each channel
+ * control separately.  When the TLV cannot be written, the new elements
+ * are removed again and the error is returned.
+ */
+int snd_ctl_add_integer_elem_set_tlv(snd_ctl_t *ctl, snd_ctl_elem_info_t *info,
+				     unsigned int element_count,
+				     unsigned int member_count,
+				     long min, long max, long step,
+				     const unsigned int *tlv)
+{
+	int err;
+
+	err = snd_ctl_add_integer_elem_set(ctl, info, element_count,
+					   member_count, min, max, step);
+	if (err < 0 || !tlv)
+		return err;
+	err = snd_ctl_elem_tlv_write(ctl, &info->id, tlv);
+	if (err < 0)
+		snd_ctl_elem_remove(ctl, &info->id);
+	return err < 0 ? err : 0;
+}
+
 /**
  * \brief Create and add some user-defined control elements of integer64 type.
  * \param ctl A handle of backend module for control interface.
@@ -883,6 +964,88 @@ int snd_ctl_elem_write(snd_ctl_t *ctl, snd_ctl_elem_value_t *data)
 	return ctl->ops->element_write(ctl, data);
 }
 
+#ifndef DOC_HIDDEN
+#define CTL_MANY_CHUNK	64
+
+static int snd_ctl_elem_many(snd_ctl_t *ctl, snd_ctl_elem_value_t **data,
+			     int *errors, unsigned int count, int write)
+{
+	int (*many)(snd_ctl_t *, snd_ctl_elem_value_t **, int *, unsigned int);
+	int (*one)(snd_ctl_t *, snd_ctl_elem_value_t *);
+	int buf[CTL_MANY_CHUNK], *res;
+	int err, first = 0;
+	unsigned int k, n;
+
+	assert(ctl && (data || !count));
+	many = write ? ctl->ops->element_write_many : ctl->ops->element_read_many;
+	one = write ? ctl->ops->element_write : ctl->ops->element_read;
+	while (count > 0) {
+		n = count;
+		res = errors;
+		if (!res) {
+			if (n > CTL_MANY_CHUNK)
+				n = CTL_MANY_CHUNK;
+			res = buf;
+		}
+		for (k = 0; k < n; k++)
+			assert(data[k] && (data[k]->id.name[0] || data[k]->id.numid));
+		err = many ? many(ctl, data, res, n) : -ENOSYS;
+		if (err == -ENOSYS) {
+			for (k = 0; k < n; k++)
+				res[k] = one(ctl, data[k]);
+		} else if (err < 0)
+			return err;
+		for (k = 0; k < n && !first; k++)
+			if (res[k] < 0)
+				first = res[k];
+		data += n;
+		count -= n;
+		if (errors)
+			errors += n;
+	}
+	return first;
+}
+#endif
+
+/**
+ * \brief Get the values of several CTL elements
+ * \param ctl CTL handle
+ * \param data Array of \a count element values, identified by their ids
+ * \param errors Array receiving the result of each element, or NULL
+ * \param count Number of elements
+ * \return 0 when all values were read, otherwise the first negative
+ *         error code of an element or of the transport
+ *
+ * The elements are read in array order.  A failing element does not
+ * stop the others; its value is left unchanged.  Over the shm backend
+ * the values travel in as few server round trips as fit in the shared
+ * memory area.
+ */
+int snd_ctl_elem_read_many(snd_ctl_t *ctl, snd_ctl_elem_value_t **data,
+			   int *errors, unsigned int count)
+{
+	return snd_ctl_elem_many(ctl, data, errors, count, 0);
+}
+
+/**
+ * \brief Set the values of several CTL elements
+ * \param ctl CTL handle
+ * \param data Array of \a count element values, identified by their ids
+ * \param errors Array receiving the result of each element as
+ *        #snd_ctl_elem_write() returns it, or NULL
+ * \param count Number of elements
+ * \return 0 when all values were written, otherwise the first negative
+ *         error code of an element or of the transport
+ *
+ * The elements are written in array order.  A failing element does
+ * not stop the others.
+ */
+int snd_ctl_elem_write_many(snd_ctl_t *ctl, snd_ctl_elem_value_t **data,
+			    int *errors, unsigned int count)
+{
+	return snd_ctl_elem_many(ctl, data, errors, count, 1);
+}
+
 static int snd_ctl_tlv_do(snd_ctl_t *ctl, int op_flag,
 			  const snd_ctl_elem_id_t *id,
 		          unsigned int *tlv, unsigned int tlv_size)
@@ -1138,6 +1301,10 @@ int snd_ctl_read(snd_ctl_t *ctl, snd_ctl_event_t *event)
  * \param ctl CTL handle
  * \param timeout maximum time in milliseconds to wait
  * \return 0 otherwise a negative error code on failure
+ *
+ * The poll descriptors are read for each call.  To wait for many
+ * handles or in a loop with timeouts, add them to an event loop with
+ * #snd_ctl_evloop_add and #snd_evloop_add_timer instead.
  */
 int snd_ctl_wait(snd_ctl_t *ctl, int timeout)
 {
@@ -1196,7 +1363,8 @@ int snd_async_add_ctl_handler(snd_async_handler_t **handler, snd_ctl_t *ctl,
 	h->u.ctl = ctl;
 	was_empty = list_empty(&ctl->async_handlers);
 	list_add_tail(&h->hlist, &ctl->async_handlers);
-	if (was_empty) {
+	/* no signal with the dispatcher thread */
+	if (was_empty && snd_async_handler_get_signo(h)) {
 		err = snd_ctl_async(ctl, snd_async_handler_get_signo(h), getpid());
 		if (err < 0) {
 			snd_async_del_handler(h);
@@ -39,6 +39,14 @@
 const char *_snd_module_control_ext = "";
 #endif
 
+#define CTL_EXT_MANY_CHUNK	64
+
+/* the bulk callbacks exist in the callback table of the plugin */
+static inline int has_many(snd_ctl_ext_t *ext)
+{
+	return ext->version >= SNDRV_PROTOCOL_VERSION(1, 0, 2);
+}
+
 static int snd_ctl_ext_close(snd_ctl_t *handle)
 {
 	snd_ctl_ext_t *ext = handle->private_data;
@@ -100,6 +108,35 @@ static int snd_ctl_ext_elem_list(snd_ctl_t *handle, snd_ctl_elem_list_t *list)
 	list->used = 0;
 	ids = list->pids;
 	offset = list->offset;
+	if (has_many(ext) && ext->callback->elem_list_many) {
+		snd_ctl_elem_id_t *idp[CTL_EXT_MANY_CHUNK];
+		unsigned int n;
+
+		while (list->used < list->space && offset < list->count) {
+			n = list->count - offset;
+			if (n > list->space - list->used)
+				n = list->space - list->used;
+			if (n > CTL_EXT_MANY_CHUNK)
+				n = CTL_EXT_MANY_CHUNK;
+			for (i = 0; i < n; i++) {
+				snd_ctl_elem_id_clear(&ids[i]);
+				idp[i] = &ids[i];
+			}
+			ret = ext->callback->elem_list_many(ext, offset, idp, n);
+			if (ret < 0)
+				return ret;
+			if (ret == 0)
+				break;
+			if ((unsigned int)ret > n)
+				ret = n;
+			for (i = 0; i < (unsigned int)ret; i++)
+				ids[i].numid = offset + i + 1; /* fake number */
+			list->used += ret;
+			offset += ret;
+			ids += ret;
+		}
+		return 0;
+	}
 	for (i = 0; i < list->space; i++) {
 		if (offset >= list->count)
 			break;
@@ -312,6 +349,74 @@ static int snd_ctl_ext_elem_write(snd_ctl_t *handle, snd_ctl_elem_value_t *contr
 	return ret;
 }
 
+/*
+ * The keys are looked up in the library, the plugin gets the found
+ * elements in one call per chunk and does one round trip for them.
+ */
+static int snd_ctl_ext_elem_many(snd_ctl_t *handle,
+				 snd_ctl_elem_value_t **controls,
+				 int *errors, unsigned int count, int write)
+{
+	snd_ctl_ext_t *ext = handle->private_data;
+	int (*many)(snd_ctl_ext_t *, const snd_ctl_ext_key_t *,
+		    snd_ctl_elem_value_t **, int *, unsigned int);
+	snd_ctl_ext_key_t keys[CTL_EXT_MANY_CHUNK];
+	snd_ctl_elem_value_t *values[CTL_EXT_MANY_CHUNK];
+	int res[CTL_EXT_MANY_CHUNK];
+	unsigned int idx[CTL_EXT_MANY_CHUNK];
+	unsigned int k, n, found;
+	int err = 0;
+
+	if (!has_many(ext))
+		return -ENOSYS;
+	many = write ? ext->callback->write_many : ext->callback->read_many;
+	if (!many)
+		return -ENOSYS;
+	while (count > 0) {
+		n = count > CTL_EXT_MANY_CHUNK ? CTL_EXT_MANY_CHUNK : count;
+		found = 0;
+		for (k = 0; k < n; k++) {
+			snd_ctl_ext_key_t key = get_elem(ext, &controls[k]->id);
+
+			if (key == SND_CTL_EXT_KEY_NOT_FOUND) {
+				errors[k] = -ENOENT;
+				continue;
+			}
+			keys[found] = key;
+			values[found] = controls[k];
+			res[found] = 0;
+			idx[found++] = k;
+		}
+		err = found ? many(ext, keys, values, res, found) : 0;
+		for (k = 0; k < found; k++) {
+			if (err >= 0)
+				errors[idx[k]] = res[k];
+			if (ext->callback->free_key)
+				ext->callback->free_key(ext, keys[k]);
+		}
+		if (err < 0)
+			return err;
+		controls += n;
+		errors += n;
+		count -= n;
+	}
+	return 0;
+}
+
+static int snd_ctl_ext_elem_read_many(snd_ctl_t *handle,
+				      snd_ctl_elem_value_t **controls,
+				      int *errors, unsigned int count)
+{
+	return snd_ctl_ext_elem_many(handle, controls, errors, count, 0);
+}
+
+static int snd_ctl_ext_elem_write_many(snd_ctl_t *handle,
+				       snd_ctl_elem_value_t **controls,
+				       int *errors, unsigned int count)
+{
+	return snd_ctl_ext_elem_many(handle, controls, errors, count, 1);
+}
+
 static int snd_ctl_ext_elem_lock(snd_ctl_t *handle ATTRIBUTE_UNUSED,
 				 snd_ctl_elem_id_t *id ATTRIBUTE_UNUSED)
 {
@@ -472,6 +577,8 @@ static const snd_ctl_ops_t snd_ctl_ext_ops = {
 	.element_remove = snd_ctl_ext_elem_remove,
 	.element_read = snd_ctl_ext_elem_read,
 	.element_write = snd_ctl_ext_elem_write,
+	.element_read_many = snd_ctl_ext_elem_read_many,
+	.element_write_many = snd_ctl_ext_elem_write_many,
 	.element_lock = snd_ctl_ext_elem_lock,
 	.element_unlock = snd_ctl_ext_elem_unlock,
 	.element_tlv = snd_ctl_ext_elem_tlv,
@@ -689,6 +796,17 @@ set the static poll_fd, you can define these callbacks to return dynamically.
 Also, when multiple poll descriptors are required, use these callbacks.
 The poll_revents callback is used for handle poll revents.
 
+A plugin behind a transport with round trips (e.g. a bridge to a sound
+server) can define the bulk callbacks of protocol 1.0.2.  The
+elem_list_many callback fills the IDs of several elements at once and returns
+how many it filled; #snd_hctl_load() and #snd_ctl_elem_list() then list the
+elements in one call.  The read_many and write_many callbacks get the keys of
+several elements, as found by find_elem, with their values; they store the
+result of each element like the single read and write callbacks return it,
+and return 0 or a negative error of the whole transfer.  They serve
+#snd_ctl_elem_read_many() and #snd_ctl_elem_write_many().  Returning -ENOSYS
+falls back to the single callbacks.
+
 */
 
 /**
@@ -344,6 +344,20 @@ static int snd_ctl_hw_read(snd_ctl_t *handle, snd_ctl_event_t *event)
 	return 1;
 }
 
+static int snd_ctl_hw_read_many(snd_ctl_t *handle, snd_ctl_event_t *events,
+				unsigned int count)
+{
+	snd_ctl_hw_t *hw = handle->private_data;
+	ssize_t res = read(hw->fd, events, count * sizeof(*events));
+	if (res <= 0)
+		return -errno;
+	if (CHECK_SANITY(res % sizeof(*events))) {
+		SNDMSG("snd_ctl_hw_read_many: read size error (got:%d)\n", res);
+		return -EINVAL;
+	}
+	return res / sizeof(*events);
+}
+
 static const snd_ctl_ops_t snd_ctl_hw_ops = {
 	.close = snd_ctl_hw_close,
 	.nonblock = snd_ctl_hw_nonblock,
@@ -371,6 +385,7 @@ static const snd_ctl_ops_t snd_ctl_hw_ops = {
 	.set_power_state = snd_ctl_hw_set_power_state,
 	.get_power_state = snd_ctl_hw_get_power_state,
 	.read = snd_ctl_hw_read,
+	.read_many = snd_ctl_hw_read_many,
 };
 
 int snd_ctl_hw_open(snd_ctl_t **handle, const char *name, int card, int mode)
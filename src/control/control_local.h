@@ -34,6 +34,11 @@ typedef struct _snd_ctl_ops {
 	int (*element_remove)(snd_ctl_t *handle, snd_ctl_elem_id_t *id);
 	int (*element_read)(snd_ctl_t *handle, snd_ctl_elem_value_t *control);
 	int (*element_write)(snd_ctl_t *handle, snd_ctl_elem_value_t *control);
+	/* optional, the results go to errors; -ENOSYS falls back to single calls */
+	int (*element_read_many)(snd_ctl_t *handle, snd_ctl_elem_value_t **controls,
+				 int *errors, unsigned int count);
+	int (*element_write_many)(snd_ctl_t *handle, snd_ctl_elem_value_t **controls,
+				  int *errors, unsigned int count);
 	int (*element_lock)(snd_ctl_t *handle, snd_ctl_elem_id_t *lock);
 	int (*element_unlock)(snd_ctl_t *handle, snd_ctl_elem_id_t *unlock);
 	int (*element_tlv)(snd_ctl_t *handle, int op_flag, unsigned int numid,
@@ -49,6 +54,8 @@ typedef struct _snd_ctl_ops {
 	int (*set_power_state)(snd_ctl_t *handle, unsigned int state);
 	int (*get_power_state)(snd_ctl_t *handle, unsigned int *state);
 	int (*read)(snd_ctl_t *handle, snd_ctl_event_t *event);
+	/* optional, returns the count of events stored */
+	int (*read_many)(snd_ctl_t *handle, snd_ctl_event_t *events, unsigned int count);
 	int (*poll_descriptors_count)(snd_ctl_t *handle);
 	int (*poll_descriptors)(snd_ctl_t *handle, struct pollfd *pfds, unsigned int space);
 	int (*poll_revents)(snd_ctl_t *handle, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
@@ -70,6 +77,11 @@ struct _snd_hctl_elem {
 	snd_ctl_elem_id_t id; 		/* must be always on top */
 	struct list_head list;		/* links for list of all helems */
 	int compare_weight;		/* compare weight (reversed) */
+	snd_hctl_elem_t *numid_next;	/* chain in the numid hash */
+	snd_hctl_elem_t *name_next;	/* chain in the name hash */
+	snd_ctl_elem_info_t *info;	/* cached info, NULL when unknown */
+	unsigned int pending_mask;	/* coalesced event mask not thrown yet */
+	snd_hctl_elem_t *pending_next;	/* chain of elements with pending events */
 	/* event callback */
 	snd_hctl_elem_callback_t callback;
 	void *callback_private;
@@ -83,7 +95,14 @@ struct _snd_hctl {
 	unsigned int alloc;	
 	unsigned int count;
 	snd_hctl_elem_t **pelems;
+	unsigned int hash_mask;		/* hash size - 1, 0 without hash */
+	snd_hctl_elem_t **numid_hash;
+	snd_hctl_elem_t **name_hash;
 	snd_hctl_compare_t compare;
+	int coalesce;			/* coalesce value and info events */
+	snd_hctl_elem_t *pending;	/* elements with coalesced events */
+	struct snd_ctl_value_cache *value_cache; /* shared element values */
+	int value_cache_tried;
 	snd_hctl_callback_t callback;
 	void *callback_private;
 };
@@ -91,6 +110,10 @@ struct _snd_hctl {
 
 /* make local functions really local */
 #define snd_ctl_new	snd1_ctl_new
+#define snd_ctl_value_cache_get		snd1_ctl_value_cache_get
+#define snd_ctl_value_cache_put		snd1_ctl_value_cache_put
+#define snd_ctl_value_cache_read	snd1_ctl_value_cache_read
+#define snd_ctl_value_cache_invalidate	snd1_ctl_value_cache_invalidate
 
 int snd_ctl_new(snd_ctl_t **ctlp, snd_ctl_type_t type, const char *name);
 int _snd_ctl_poll_descriptor(snd_ctl_t *ctl);
@@ -98,5 +121,11 @@ int _snd_ctl_poll_descriptor(snd_ctl_t *ctl);
 int snd_ctl_hw_open(snd_ctl_t **handle, const char *name, int card, int mode);
 int snd_ctl_shm_open(snd_ctl_t **handlep, const char *name, const char *sockname, const char *sname, int mode);
 int snd_ctl_async(snd_ctl_t *ctl, int sig, pid_t pid);
+struct snd_ctl_value_cache *snd_ctl_value_cache_get(snd_ctl_t *ctl);
+void snd_ctl_value_cache_put(struct snd_ctl_value_cache *cache);
+int snd_ctl_value_cache_read(struct snd_ctl_value_cache *cache,
+			     snd_ctl_t *ctl, snd_ctl_elem_value_t *value);
+void snd_ctl_value_cache_invalidate(struct snd_ctl_value_cache *cache,
+				    unsigned int numid);
 
 #define CTLINABORT(x) ((x)->nonblock == 2)
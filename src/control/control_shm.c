@@ -44,6 +44,7 @@ const char *_snd_module_control_shm = "";
 typedef struct {
 	int socket;
 	volatile snd_ctl_shm_ctrl_t *ctrl;
+	volatile snd_ctl_shm_values_t *values;	/* NULL when not published */
 } snd_ctl_shm_t;
 #endif
 
@@ -186,11 +187,35 @@ static int snd_ctl_shm_elem_info(snd_ctl_t *ctl, snd_ctl_elem_info_t *info)
 	return err;
 }
 
+/* copy a value published by the server, returns 0 when it must be asked */
+static int snd_ctl_shm_read_local(snd_ctl_shm_t *shm, snd_ctl_elem_value_t *control)
+{
+	unsigned int numid = control->id.numid;
+	volatile snd_ctl_shm_value_t *slot;
+	snd_ctl_elem_value_t value;
+	unsigned int seq;
+
+	if (!shm->values || !numid)
+		return 0;
+	slot = &shm->values->slots[numid % CTL_SHM_VALUES];
+	seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+	if ((seq & 1) || slot->numid != numid)
+		return 0;
+	memcpy(&value, (const void *)&slot->value, sizeof(value));
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq)
+		return 0;
+	*control = value;
+	return 1;
+}
+
 static int snd_ctl_shm_elem_read(snd_ctl_t *ctl, snd_ctl_elem_value_t *control)
 {
 	snd_ctl_shm_t *shm = ctl->private_data;
 	volatile snd_ctl_shm_ctrl_t *ctrl = shm->ctrl;
 	int err;
+	if (snd_ctl_shm_read_local(shm, control))
+		return 0;
 	ctrl->u.element_read = *control;
 	ctrl->cmd = SNDRV_CTL_IOCTL_ELEM_READ;
 	err = snd_ctl_shm_action(ctl);
@@ -214,6 +239,81 @@ static int snd_ctl_shm_elem_write(snd_ctl_t *ctl, snd_ctl_elem_value_t *control)
 	return err;
 }
 
+static int snd_ctl_shm_elem_many(snd_ctl_t *ctl, snd_ctl_elem_value_t **controls,
+				 int *errors, unsigned int count, int cmd)
+{
+	snd_ctl_shm_t *shm = ctl->private_data;
+	volatile snd_ctl_shm_ctrl_t *ctrl = shm->ctrl;
+	snd_ctl_elem_value_t *data = (snd_ctl_elem_value_t *)ctrl->data;
+	unsigned int k, n;
+	int *res;
+	int err;
+
+	while (count > 0) {
+		n = count < CTL_SHM_MANY_MAX ? count : CTL_SHM_MANY_MAX;
+		for (k = 0; k < n; k++)
+			data[k] = *controls[k];
+		ctrl->u.element_many = n;
+		ctrl->cmd = cmd;
+		err = snd_ctl_shm_action(ctl);
+		if (err < 0)
+			return err;
+		res = (int *)(data + n);
+		for (k = 0; k < n; k++) {
+			errors[k] = res[k];
+			if (res[k] >= 0)
+				*controls[k] = data[k];
+		}
+		controls += n;
+		errors += n;
+		count -= n;
+	}
+	return 0;
+}
+
+static int snd_ctl_shm_elem_read_many(snd_ctl_t *ctl, snd_ctl_elem_value_t **controls,
+				      int *errors, unsigned int count)
+{
+	snd_ctl_shm_t *shm = ctl->private_data;
+	snd_ctl_elem_value_t **missed;
+	unsigned int *index;
+	unsigned int k, n = 0;
+	int *res;
+	int err = 0;
+
+	if (!shm->values)
+		return snd_ctl_shm_elem_many(ctl, controls, errors, count,
+					     SND_CTL_IOCTL_ELEM_READ_MANY);
+	missed = malloc(count * (sizeof(*missed) + sizeof(*index) + sizeof(*res)));
+	if (!missed)
+		return -ENOMEM;
+	index = (unsigned int *)(missed + count);
+	res = (int *)(index + count);
+	for (k = 0; k < count; k++) {
+		if (snd_ctl_shm_read_local(shm, controls[k])) {
+			errors[k] = 0;
+			continue;
+		}
+		missed[n] = controls[k];
+		index[n++] = k;
+	}
+	if (n > 0) {
+		err = snd_ctl_shm_elem_many(ctl, missed, res, n,
+					    SND_CTL_IOCTL_ELEM_READ_MANY);
+		for (k = 0; err >= 0 && k < n; k++)
+			errors[index[k]] = res[k];
+	}
+	free(missed);
+	return err;
+}
+
+static int snd_ctl_shm_elem_write_many(snd_ctl_t *ctl, snd_ctl_elem_value_t **controls,
+				       int *errors, unsigned int count)
+{
+	return snd_ctl_shm_elem_many(ctl, controls, errors, count,
+				     SND_CTL_IOCTL_ELEM_WRITE_MANY);
+}
+
 static int snd_ctl_shm_elem_lock(snd_ctl_t *ctl, snd_ctl_elem_id_t *id)
 {
 	snd_ctl_shm_t *shm = ctl->private_data;
@@ -407,6 +507,8 @@ static const snd_ctl_ops_t snd_ctl_shm_ops = {
 	.element_info = snd_ctl_shm_elem_info,
 	.element_read = snd_ctl_shm_elem_read,
 	.element_write = snd_ctl_shm_elem_write,
+	.element_read_many = snd_ctl_shm_elem_read_many,
+	.element_write_many = snd_ctl_shm_elem_write_many,
 	.element_lock = snd_ctl_shm_elem_lock,
 	.element_unlock = snd_ctl_shm_elem_unlock,
 	.hwdep_next_device = snd_ctl_shm_hwdep_next_device,
@@ -441,6 +543,25 @@ static int make_local_socket(const char *filename)
 	return sock;
 }
 
+/* the values published behind the control block by a server which has them */
+static volatile snd_ctl_shm_values_t *snd_ctl_shm_values(snd_ctl_shm_ctrl_t *ctrl, int shmid)
+{
+	volatile snd_ctl_shm_values_t *values;
+	struct shmid_ds buf;
+	char *p;
+
+	p = getenv("LIBASOUND_CTL_CACHE");
+	if (p && *p == '0')
+		return NULL;
+	if (shmctl(shmid, IPC_STAT, &buf) < 0 ||
+	    buf.shm_segsz < CTL_SHM_TOTAL_SIZE)
+		return NULL;
+	values = (snd_ctl_shm_values_t *)((char *)ctrl + CTL_SHM_VALUES_OFFSET);
+	if (values->magic != CTL_SHM_VALUES_MAGIC)
+		return NULL;
+	return values;
+}
+
 int snd_ctl_shm_open(snd_ctl_t **handlep, const char *name, const char *sockname, const char *sname, int mode)
 {
 	snd_ctl_t *ctl;
@@ -511,6 +632,7 @@ int snd_ctl_shm_open(snd_ctl_t **handlep, const char *name, const char *sockname
 
 	shm->socket = sock;
 	shm->ctrl = ctrl;
+	shm->values = snd_ctl_shm_values(ctrl, ans.cookie);
 
 	err = snd_ctl_new(&ctl, SND_CTL_TYPE_SHM, name);
 	if (err < 0) {
@@ -552,6 +674,7 @@ int _snd_ctl_shm_open(snd_ctl_t **handlep, char *name, snd_config_t *root, snd_c
 		if (snd_config_get_id(n, &id) < 0)
 			continue;
 		if (_snd_conf_generic_id(id))
+			continue;
 		if (strcmp(id, "server") == 0) {
 			err = snd_config_get_string(n, &server);
 			if (err < 0) {
@@ -115,6 +115,8 @@ int snd_hctl_close(snd_hctl_t *hctl)
 	assert(hctl);
 	err = snd_ctl_close(hctl->ctl);
 	snd_hctl_free(hctl);
+	if (hctl->value_cache)
+		snd_ctl_value_cache_put(hctl->value_cache);
 	free(hctl);
 	return err;
 }
@@ -198,6 +200,49 @@ int snd_hctl_poll_descriptors_revents(snd_hctl_t *hctl, struct pollfd *pfds, uns
 	return snd_ctl_poll_descriptors_revents(hctl->ctl, pfds, nfds, revents);
 }
 
+static int snd_hctl_evloop_count(void *handle)
+{
+	return snd_hctl_poll_descriptors_count(handle);
+}
+
+static int snd_hctl_evloop_descriptors(void *handle, struct pollfd *pfds, unsigned int space)
+{
+	return snd_hctl_poll_descriptors(handle, pfds, space);
+}
+
+static int snd_hctl_evloop_revents(void *handle, struct pollfd *pfds, unsigned int nfds,
+		unsigned short *revents)
+{
+	return snd_hctl_poll_descriptors_revents(handle, pfds, nfds, revents);
+}
+
+static const snd_evloop_ops_t snd_hctl_evloop_ops = {
+	.count = snd_hctl_evloop_count,
+	.descriptors = snd_hctl_evloop_descriptors,
+	.revents = snd_hctl_evloop_revents,
+};
+
+/**
+ * \brief Registers an HCTL handle with an event loop
+ * \param loop Event loop
+ * \param srcp Returned source, may be NULL
+ * \param hctl HCTL handle
+ * \param callback Callback for the events of the handle
+ * \param private_data Value for #snd_evloop_source_get_callback_private
+ * \return 0 on success otherwise a negative error code
+ *
+ * The callback gets the events translated by
+ * #snd_hctl_poll_descriptors_revents.  The poll descriptors are read
+ * once; see #snd_evloop_source_refresh.
+ */
+int snd_hctl_evloop_add(snd_evloop_t *loop, snd_evloop_source_t **srcp, snd_hctl_t *hctl,
+		snd_evloop_callback_t callback, void *private_data)
+{
+	assert(hctl);
+	return snd_evloop_add_source(loop, srcp, &snd_hctl_evloop_ops, hctl, 0,
+				     callback, private_data);
+}
+
 static int snd_hctl_throw_event(snd_hctl_t *hctl, unsigned int mask,
 			 snd_hctl_elem_t *elem)
 {
@@ -317,6 +362,129 @@ static int get_compare_weight(const snd_ctl_elem_id_t *id)
 	return res + res1;
 }
 
+/*
+ * Besides the array sorted by the compare function, the elements are
+ * hashed by numid and by iface, device, subdevice, name and index.
+ * These are exactly the fields snd_hctl_compare_fast() and the default
+ * compare look at, so with either compare a search is a hash lookup.
+ */
+#define HCTL_HASH_MIN	64
+
+static unsigned int hctl_numid_hash(const snd_ctl_elem_id_t *id)
+{
+	return id->numid * 2654435761U;
+}
+
+static unsigned int hctl_name_hash(const snd_ctl_elem_id_t *id)
+{
+	const unsigned char *name = id->name;
+	unsigned int hash = 2166136261U;
+
+	hash = (hash ^ id->iface) * 16777619U;
+	hash = (hash ^ id->device) * 16777619U;
+	hash = (hash ^ id->subdevice) * 16777619U;
+	hash = (hash ^ id->index) * 16777619U;
+	while (*name && name < id->name + sizeof(id->name))
+		hash = (hash ^ *name++) * 16777619U;
+	return hash;
+}
+
+static int hctl_name_equal(const snd_ctl_elem_id_t *id1,
+			   const snd_ctl_elem_id_t *id2)
+{
+	return id1->iface == id2->iface &&
+	       id1->device == id2->device &&
+	       id1->subdevice == id2->subdevice &&
+	       id1->index == id2->index &&
+	       !strcmp((const char *)id1->name, (const char *)id2->name);
+}
+
+static void hctl_hash_add(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
+{
+	snd_hctl_elem_t **slot;
+
+	slot = &hctl->numid_hash[hctl_numid_hash(&elem->id) & hctl->hash_mask];
+	elem->numid_next = *slot;
+	*slot = elem;
+	slot = &hctl->name_hash[hctl_name_hash(&elem->id) & hctl->hash_mask];
+	elem->name_next = *slot;
+	*slot = elem;
+}
+
+static void hctl_hash_del(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
+{
+	snd_hctl_elem_t **slot;
+
+	if (!hctl->hash_mask)
+		return;
+	slot = &hctl->numid_hash[hctl_numid_hash(&elem->id) & hctl->hash_mask];
+	while (*slot != elem)
+		slot = &(*slot)->numid_next;
+	*slot = elem->numid_next;
+	slot = &hctl->name_hash[hctl_name_hash(&elem->id) & hctl->hash_mask];
+	while (*slot != elem)
+		slot = &(*slot)->name_next;
+	*slot = elem->name_next;
+}
+
+static void hctl_hash_free(snd_hctl_t *hctl)
+{
+	free(hctl->numid_hash);
+	free(hctl->name_hash);
+	hctl->numid_hash = NULL;
+	hctl->name_hash = NULL;
+	hctl->hash_mask = 0;
+}
+
+/* size the hash for count elements and rehash them */
+static int hctl_hash_resize(snd_hctl_t *hctl, unsigned int count)
+{
+	snd_hctl_elem_t **numid_hash, **name_hash;
+	unsigned int size = HCTL_HASH_MIN, k;
+
+	while (size < count)
+		size <<= 1;
+	if (size - 1 <= hctl->hash_mask)
+		return 0;
+	numid_hash = calloc(size, sizeof(*numid_hash));
+	name_hash = calloc(size, sizeof(*name_hash));
+	if (!numid_hash || !name_hash) {
+		free(numid_hash);
+		free(name_hash);
+		return -ENOMEM;
+	}
+	hctl_hash_free(hctl);
+	hctl->numid_hash = numid_hash;
+	hctl->name_hash = name_hash;
+	hctl->hash_mask = size - 1;
+	for (k = 0; k < hctl->count; k++)
+		hctl_hash_add(hctl, hctl->pelems[k]);
+	return 0;
+}
+
+/* NULL when the compare in use does not match the hash keys */
+static snd_hctl_elem_t *hctl_hash_find(snd_hctl_t *hctl,
+				       const snd_ctl_elem_id_t *id, int *hit)
+{
+	snd_hctl_elem_t *elem = NULL;
+
+	*hit = 0;
+	if (!hctl->hash_mask)
+		return NULL;
+	if (hctl->compare == snd_hctl_compare_default) {
+		elem = hctl->name_hash[hctl_name_hash(id) & hctl->hash_mask];
+		while (elem && !hctl_name_equal(&elem->id, id))
+			elem = elem->name_next;
+		*hit = 1;
+	} else if (hctl->compare == snd_hctl_compare_fast) {
+		elem = hctl->numid_hash[hctl_numid_hash(id) & hctl->hash_mask];
+		while (elem && elem->id.numid != id->numid)
+			elem = elem->numid_next;
+		*hit = 1;
+	}
+	return elem;
+}
+
 static int _snd_hctl_find_elem(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id, int *dir)
 {
 	unsigned int l, u;
@@ -348,6 +516,8 @@ static int snd_hctl_elem_add(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
 	int dir;
 	int idx; 
 	elem->compare_weight = get_compare_weight(&elem->id);
+	if (hctl_hash_resize(hctl, hctl->count + 1) < 0)
+		return -ENOMEM;
 	if (hctl->count == hctl->alloc) {
 		snd_hctl_elem_t **h;
 		hctl->alloc += 32;
@@ -376,15 +546,111 @@ static int snd_hctl_elem_add(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
 		hctl->pelems[idx] = elem;
 	}
 	hctl->count++;
+	hctl_hash_add(hctl, elem);
 	return snd_hctl_throw_event(hctl, SNDRV_CTL_EVENT_MASK_ADD, elem);
 }
 
+#define HCTL_EVENTS_MAX 32
+
+/*
+ * Add the elements of several ADD events, i.e. a new element set, at
+ * once: each finds its place by bisection against the present elements
+ * and one pass from the tail makes room for all of them, instead of
+ * one memmove of the array per element.  Ids already present are skipped.
+ */
+static int snd_hctl_elem_add_many(snd_hctl_t *hctl, const snd_ctl_event_t *events,
+				  unsigned int count)
+{
+	snd_hctl_elem_t *elems[HCTL_EVENTS_MAX], *elem;
+	unsigned int pos[HCTL_EVENTS_MAX], order[HCTL_EVENTS_MAX];
+	unsigned int i, j, k, n = 0, end;
+	int dir, idx, res;
+
+	assert(count <= HCTL_EVENTS_MAX);
+	if (hctl_hash_resize(hctl, hctl->count + count) < 0)
+		return -ENOMEM;
+	if (hctl->count + count > hctl->alloc) {
+		snd_hctl_elem_t **h;
+		unsigned int alloc = hctl->count + count + 32;
+		h = realloc(hctl->pelems, sizeof(*h) * alloc);
+		if (!h)
+			return -ENOMEM;
+		hctl->pelems = h;
+		hctl->alloc = alloc;
+	}
+	for (i = 0; i < count; i++) {
+		if (snd_hctl_find_elem(hctl, &events[i].data.elem.id))
+			continue;
+		elem = calloc(1, sizeof(*elem));
+		if (!elem) {
+			while (n > 0)
+				free(elems[--n]);
+			return -ENOMEM;
+		}
+		elem->id = events[i].data.elem.id;
+		elem->hctl = hctl;
+		elem->compare_weight = get_compare_weight(&elem->id);
+		if (hctl->count == 0) {
+			pos[n] = 0;
+		} else {
+			idx = _snd_hctl_find_elem(hctl, &elem->id, &dir);
+			pos[n] = dir > 0 ? idx + 1 : idx;
+		}
+		/* insertion sort by place, the ids of a set come in order */
+		for (j = n; j > 0; j--) {
+			k = order[j - 1];
+			if (pos[k] < pos[n] ||
+			    (pos[k] == pos[n] &&
+			     hctl->compare(elems[k], elem) < 0))
+				break;
+			order[j] = k;
+		}
+		order[j] = n;
+		elems[n++] = elem;
+	}
+	if (!n)
+		return 0;
+	/* move the present elements behind each new one from the tail */
+	end = hctl->count;
+	for (j = n; j > 0; j--) {
+		k = order[j - 1];
+		memmove(hctl->pelems + pos[k] + j, hctl->pelems + pos[k],
+			(end - pos[k]) * sizeof(*hctl->pelems));
+		hctl->pelems[pos[k] + j - 1] = elems[k];
+		end = pos[k];
+	}
+	hctl->count += n;
+	for (j = 0; j < n; j++) {
+		k = order[j];
+		idx = pos[k] + j;
+		if (idx > 0)
+			list_add(&elems[k]->list, &hctl->pelems[idx - 1]->list);
+		else
+			list_add(&elems[k]->list, &hctl->elems);
+		hctl_hash_add(hctl, elems[k]);
+	}
+	for (i = 0; i < n; i++) {
+		res = snd_hctl_throw_event(hctl, SNDRV_CTL_EVENT_MASK_ADD, elems[i]);
+		if (res < 0)
+			return res;
+	}
+	return 0;
+}
+
 static void snd_hctl_elem_remove(snd_hctl_t *hctl, unsigned int idx)
 {
 	snd_hctl_elem_t *elem = hctl->pelems[idx];
 	unsigned int m;
 	snd_hctl_elem_throw_event(elem, SNDRV_CTL_EVENT_MASK_REMOVE);
+	if (elem->pending_mask) {
+		snd_hctl_elem_t **p = &hctl->pending;
+		while (*p != elem)
+			p = &(*p)->pending_next;
+		*p = elem->pending_next;
+	}
+	hctl_hash_del(hctl, elem);
 	list_del(&elem->list);
+	free(elem->info);
 	free(elem);
 	hctl->count--;
 	m = hctl->count - idx;
@@ -406,6 +672,7 @@ int snd_hctl_free(snd_hctl_t *hctl)
 	free(hctl->pelems);
 	hctl->pelems = 0;
 	hctl->alloc = 0;
+	hctl_hash_free(hctl);
 	INIT_LIST_HEAD(&hctl->elems);
 	return 0;
 }
@@ -550,8 +817,14 @@ snd_hctl_elem_t *snd_hctl_elem_prev(snd_hctl_elem_t *elem)
  */
 snd_hctl_elem_t *snd_hctl_find_elem(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id)
 {
-	int dir;
-	int res = _snd_hctl_find_elem(hctl, id, &dir);
+	snd_hctl_elem_t *elem;
+	int dir, hit;
+	int res;
+
+	elem = hctl_hash_find(hctl, id, &hit);
+	if (hit)
+		return elem;
+	res = _snd_hctl_find_elem(hctl, id, &dir);
 	if (res < 0 || dir != 0)
 		return NULL;
 	return hctl->pelems[res];
@@ -609,6 +882,11 @@ int snd_hctl_load(snd_hctl_t *hctl)
 	if (!hctl->compare)
 		hctl->compare = snd_hctl_compare_default;
 	snd_hctl_sort(hctl);
+	err = hctl_hash_resize(hctl, hctl->count);
+	if (err < 0) {
+		snd_hctl_free(hctl);
+		goto _end;
+	}
 	for (idx = 0; idx < hctl->count; idx++) {
 		int res = snd_hctl_throw_event(hctl, SNDRV_CTL_EVENT_MASK_ADD,
 					       hctl->pelems[idx]);
@@ -671,6 +949,10 @@ unsigned int snd_hctl_get_count(snd_hctl_t *hctl)
  * \return a positive value on success otherwise a negative error code
  * \retval 0 timeout occurred
  * \retval 1 an event is pending
+ *
+ * The poll descriptors are read for each call.  To wait for many
+ * handles or in a loop with timeouts, add them to an event loop with
+ * #snd_hctl_evloop_add and #snd_evloop_add_timer instead.
  */
 int snd_hctl_wait(snd_hctl_t *hctl, int timeout)
 {
@@ -726,9 +1008,38 @@ snd_ctl_t *snd_hctl_ctl(snd_hctl_t *hctl)
 	return hctl->ctl;
 }
 
+/* throw the coalesced events, in the order the elements got them first */
+static int snd_hctl_flush_events(snd_hctl_t *hctl)
+{
+	snd_hctl_elem_t *elem, *last = NULL, *next;
+	unsigned int mask;
+	int res, err = 0;
+
+	/* the chain is built by prepending, reverse it first */
+	for (elem = hctl->pending; elem; elem = next) {
+		next = elem->pending_next;
+		elem->pending_next = last;
+		last = elem;
+	}
+	hctl->pending = NULL;
+	for (elem = last; elem; elem = next) {
+		next = elem->pending_next;
+		mask = elem->pending_mask;
+		elem->pending_next = NULL;
+		elem->pending_mask = 0;
+		if (err < 0)
+			continue;
+		res = snd_hctl_elem_throw_event(elem, mask);
+		if (res < 0)
+			err = res;
+	}
+	return err;
+}
+
 static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 {
 	snd_hctl_elem_t *elem;
+	unsigned int mask;
 	int res;
 
 	assert(hctl);
@@ -739,7 +1050,14 @@ static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 	default:
 		return 0;
 	}
-	if (event->data.elem.mask == SNDRV_CTL_EVENT_MASK_REMOVE) {
+	mask = event->data.elem.mask;
+	if (hctl->pending && (mask == SNDRV_CTL_EVENT_MASK_REMOVE ||
+			      (mask & SNDRV_CTL_EVENT_MASK_ADD))) {
+		res = snd_hctl_flush_events(hctl);
+		if (res < 0)
+			return res;
+	}
+	if (mask == SNDRV_CTL_EVENT_MASK_REMOVE) {
 		int dir;
 		res = _snd_hctl_find_elem(hctl, &event->data.elem.id, &dir);
 		if (res < 0 || dir != 0)
@@ -747,7 +1065,7 @@ static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 		snd_hctl_elem_remove(hctl, (unsigned int) res);
 		return 0;
 	}
-	if (event->data.elem.mask & SNDRV_CTL_EVENT_MASK_ADD) {
+	if (mask & SNDRV_CTL_EVENT_MASK_ADD) {
 		elem = calloc(1, sizeof(snd_hctl_elem_t));
 		if (elem == NULL)
 			return -ENOMEM;
@@ -757,43 +1075,111 @@ static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 		if (res < 0)
 			return res;
 	}
-	if (event->data.elem.mask & (SNDRV_CTL_EVENT_MASK_VALUE |
-				     SNDRV_CTL_EVENT_MASK_INFO)) {
+	mask &= SNDRV_CTL_EVENT_MASK_VALUE | SNDRV_CTL_EVENT_MASK_INFO;
+	if (mask) {
 		elem = snd_hctl_find_elem(hctl, &event->data.elem.id);
 		if (!elem)
 			return -ENOENT;
-		res = snd_hctl_elem_throw_event(elem, event->data.elem.mask &
-						(SNDRV_CTL_EVENT_MASK_VALUE |
-						 SNDRV_CTL_EVENT_MASK_INFO));
+		if (mask & SNDRV_CTL_EVENT_MASK_INFO) {
+			free(elem->info);
+			elem->info = NULL;
+		}
+		if (hctl->coalesce) {
+			if (!elem->pending_mask) {
+				elem->pending_next = hctl->pending;
+				hctl->pending = elem;
+			}
+			elem->pending_mask |= mask;
+			return 0;
+		}
+		res = snd_hctl_elem_throw_event(elem, mask);
 		if (res < 0)
 			return res;
 	}
 	return 0;
 }
 
+/* read as many pending events as the ctl backend hands out in one go */
+static int snd_hctl_read_events(snd_hctl_t *hctl, snd_ctl_event_t *events)
+{
+	snd_ctl_t *ctl = hctl->ctl;
+
+	if (ctl->ops->read_many)
+		return ctl->ops->read_many(ctl, events, HCTL_EVENTS_MAX);
+	return snd_ctl_read(ctl, events);
+}
+
 /**
  * \brief Handle pending HCTL events invoking callbacks
  * \param hctl HCTL handle
  * \return 0 otherwise a negative error code on failure
+ *
+ * With event coalescing enabled (see #snd_hctl_set_coalesce_events),
+ * the callback of an element is invoked once with all value and info
+ * events received for it, when the pending events are drained.
  */
 int snd_hctl_handle_events(snd_hctl_t *hctl)
 {
-	snd_ctl_event_t event;
+	snd_ctl_event_t events[HCTL_EVENTS_MAX];
+	unsigned int i, n;
 	int res;
 	unsigned int count = 0;
 	
 	assert(hctl);
 	assert(hctl->ctl);
-	while ((res = snd_ctl_read(hctl->ctl, &event)) != 0 &&
+	while ((res = snd_hctl_read_events(hctl, events)) != 0 &&
 	       res != -EAGAIN) {
 		if (res < 0)
-			return res;
-		res = snd_hctl_handle_event(hctl, &event);
-		if (res < 0)
-			return res;
-		count++;
+			goto _end;
+		for (i = 0; i < res; i += n) {
+			int err;
+			/* a run of plain ADD events is inserted in one go */
+			for (n = 0; i + n < (unsigned int)res; n++)
+				if (events[i + n].type != SND_CTL_EVENT_ELEM ||
+				    events[i + n].data.elem.mask != SNDRV_CTL_EVENT_MASK_ADD)
+					break;
+			if (n > 1) {
+				err = hctl->pending ? snd_hctl_flush_events(hctl) : 0;
+				if (err >= 0)
+					err = snd_hctl_elem_add_many(hctl, &events[i], n);
+			} else {
+				n = 1;
+				err = snd_hctl_handle_event(hctl, &events[i]);
+			}
+			if (err < 0) {
+				res = err;
+				goto _end;
+			}
+		}
+		count += res;
 	}
-	return count;
+	res = count;
+ _end:
+	if (hctl->pending) {
+		int err = snd_hctl_flush_events(hctl);
+		if (err < 0 && res >= 0)
+			res = err;
+	}
+	return res;
+}
+
+/**
+ * \brief Enable or disable coalescing of HCTL element events
+ * \param hctl HCTL handle
+ * \param enable 0 = disable, 1 = enable
+ * \return 0 on success otherwise a negative error code
+ *
+ * When enabled, #snd_hctl_handle_events collapses the value and info
+ * events of one element into a single callback with the combined mask.
+ * The callback reading the element back sees its latest state, which
+ * saves the work for the intermediate values of an event burst.
+ * Add and remove events are never coalesced.
+ */
+int snd_hctl_set_coalesce_events(snd_hctl_t *hctl, int enable)
+{
+	assert(hctl);
+	hctl->coalesce = enable ? 1 : 0;
+	return 0;
 }
 
 /**
@@ -811,6 +1197,39 @@ int snd_hctl_elem_info(snd_hctl_elem_t *elem, snd_ctl_elem_info_t *info)
 	return snd_ctl_elem_info(elem->hctl->ctl, info);
 }
 
+#ifndef DOC_HIDDEN
+/*
+ * Like snd_hctl_elem_info(), but the answer is kept until the next info
+ * event of the element.  The lock owner in the info is not tracked by
+ * events, so this is for the mixer, not for the public function.  An
+ * enumerated item other than the cached one is always queried.
+ */
+int snd_hctl_elem_info_cached(snd_hctl_elem_t *elem, snd_ctl_elem_info_t *info)
+{
+	snd_ctl_elem_info_t *cached;
+	int err;
+
+	assert(elem);
+	assert(elem->hctl);
+	assert(info);
+	cached = elem->info;
+	if (cached && (cached->type != SND_CTL_ELEM_TYPE_ENUMERATED ||
+		       cached->value.enumerated.item == info->value.enumerated.item)) {
+		*info = *cached;
+		return 0;
+	}
+	err = snd_hctl_elem_info(elem, info);
+	if (err < 0 || cached)
+		return err;
+	cached = malloc(sizeof(*cached));
+	if (cached) {
+		*cached = *info;
+		elem->info = cached;
+	}
+	return 0;
+}
+#endif
+
 /**
  * \brief Get value for an HCTL element
  * \param elem HCTL element
@@ -819,11 +1238,20 @@ int snd_hctl_elem_info(snd_hctl_elem_t *elem, snd_ctl_elem_info_t *info)
  */
 int snd_hctl_elem_read(snd_hctl_elem_t *elem, snd_ctl_elem_value_t * value)
 {
+	snd_hctl_t *hctl;
+
 	assert(elem);
 	assert(elem->hctl);
 	assert(value);
+	hctl = elem->hctl;
 	value->id = elem->id;
-	return snd_ctl_elem_read(elem->hctl->ctl, value);
+	if (!hctl->value_cache_tried) {
+		hctl->value_cache = snd_ctl_value_cache_get(hctl->ctl);
+		hctl->value_cache_tried = 1;
+	}
+	if (hctl->value_cache)
+		return snd_ctl_value_cache_read(hctl->value_cache, hctl->ctl, value);
+	return snd_ctl_elem_read(hctl->ctl, value);
 }
 
 /**
@@ -840,6 +1268,9 @@ int snd_hctl_elem_write(snd_hctl_elem_t *elem, snd_ctl_elem_value_t * value)
 	assert(elem->hctl);
 	assert(value);
 	value->id = elem->id;
+	if (elem->hctl->value_cache)
+		snd_ctl_value_cache_invalidate(elem->hctl->value_cache,
+					       elem->id.numid);
 	return snd_ctl_elem_write(elem->hctl->ctl, value);
 }
 
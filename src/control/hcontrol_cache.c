@@ -0,0 +1,348 @@
+/*
+ *  Control Interface - process wide cache of element values
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * All HCTL handles of a process opened on the same card share one cache
+ * of element values.  The cache owns a control handle of its own which
+ * is subscribed to the events of the card; the queued events are drained
+ * before each lookup, so a value changed through any handle of any
+ * process is never served from the cache.  Volatile elements, which may
+ * change without an event, are always read from the driver.  A child
+ * process shares the event queue with its parent after fork(), so it
+ * drops the inherited values and subscribes with a control handle of
+ * its own before using the cache.
+ *
+ * Setting LIBASOUND_CTL_CACHE=0 in the environment disables the cache.
+ */
+
+#include <unistd.h>
+#include "control_local.h"
+#ifdef THREAD_SAFE_API
+#include <pthread.h>
+#endif
+
+#ifndef DOC_HIDDEN
+
+#define VCACHE_HASH_SIZE	128
+#define VCACHE_EVENTS		32
+
+struct vcache_entry {
+	struct vcache_entry *next;
+	unsigned int numid;
+	int valid;
+	size_t size;			/* value bytes, 0 = never cached */
+	unsigned char data[0];
+};
+
+struct snd_ctl_value_cache {
+	struct snd_ctl_value_cache *next;
+	int card;
+	unsigned int refs;
+	unsigned int gen;		/* bumped by every invalidation */
+	snd_ctl_t *ctl;			/* subscribed to the card events, or NULL */
+	pid_t pid;			/* process which subscribed ctl */
+	struct vcache_entry *hash[VCACHE_HASH_SIZE];
+};
+
+static struct snd_ctl_value_cache *vcache_list;
+
+#ifdef THREAD_SAFE_API
+static pthread_mutex_t vcache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static inline void vcache_lock(void)
+{
+	pthread_mutex_lock(&vcache_mutex);
+}
+static inline void vcache_unlock(void)
+{
+	pthread_mutex_unlock(&vcache_mutex);
+}
+#else
+static inline void vcache_lock(void) {}
+static inline void vcache_unlock(void) {}
+#endif
+
+static struct vcache_entry **vcache_slot(struct snd_ctl_value_cache *cache,
+					 unsigned int numid)
+{
+	struct vcache_entry **p = &cache->hash[numid % VCACHE_HASH_SIZE];
+
+	while (*p && (*p)->numid != numid)
+		p = &(*p)->next;
+	return p;
+}
+
+static void vcache_drop(struct snd_ctl_value_cache *cache, unsigned int numid)
+{
+	struct vcache_entry **p = vcache_slot(cache, numid);
+	struct vcache_entry *e = *p;
+
+	if (e) {
+		*p = e->next;
+		free(e);
+	}
+}
+
+static void vcache_flush(struct snd_ctl_value_cache *cache)
+{
+	struct vcache_entry *e, *next;
+	unsigned int i;
+
+	for (i = 0; i < VCACHE_HASH_SIZE; i++) {
+		for (e = cache->hash[i]; e; e = next) {
+			next = e->next;
+			free(e);
+		}
+		cache->hash[i] = NULL;
+	}
+	cache->gen++;
+}
+
+static int vcache_subscribe(struct snd_ctl_value_cache *cache)
+{
+	int err;
+
+	err = snd_ctl_hw_open(&cache->ctl, "hw", cache->card, SND_CTL_NONBLOCK);
+	if (err < 0) {
+		cache->ctl = NULL;
+		return err;
+	}
+	err = snd_ctl_subscribe_events(cache->ctl, 1);
+	if (err < 0) {
+		snd_ctl_close(cache->ctl);
+		cache->ctl = NULL;
+		return err;
+	}
+	cache->pid = getpid();
+	return 0;
+}
+
+/*
+ * Returns 1 when the cache may be used by this process, called with the
+ * lock held.  The events a child process would read from the inherited
+ * handle are missing for the parent and the other way round, so the
+ * child forgets everything and subscribes again; it only closes its own
+ * copy of the descriptor, which leaves the parent subscribed.
+ */
+static int vcache_usable(struct snd_ctl_value_cache *cache)
+{
+	if (cache->pid == getpid())
+		return cache->ctl != NULL;
+	vcache_flush(cache);
+	if (cache->ctl)
+		snd_ctl_close(cache->ctl);
+	cache->pid = getpid();
+	return vcache_subscribe(cache) >= 0;
+}
+
+/* apply the queued events of the card, called with the lock held */
+static void vcache_drain(struct snd_ctl_value_cache *cache)
+{
+	snd_ctl_event_t events[VCACHE_EVENTS];
+	struct vcache_entry *e;
+	unsigned int mask;
+	int i, res;
+
+	while ((res = cache->ctl->ops->read_many(cache->ctl, events,
+						 VCACHE_EVENTS)) > 0) {
+		for (i = 0; i < res; i++) {
+			if (events[i].type != SND_CTL_EVENT_ELEM)
+				continue;
+			mask = events[i].data.elem.mask;
+			if (mask == SNDRV_CTL_EVENT_MASK_REMOVE ||
+			    (mask & (SNDRV_CTL_EVENT_MASK_INFO |
+				     SNDRV_CTL_EVENT_MASK_ADD))) {
+				vcache_drop(cache, events[i].data.elem.id.numid);
+			} else if (mask & SNDRV_CTL_EVENT_MASK_VALUE) {
+				e = *vcache_slot(cache, events[i].data.elem.id.numid);
+				if (e)
+					e->valid = 0;
+			}
+			cache->gen++;
+		}
+	}
+}
+
+/* count of value bytes worth keeping, 0 when the element must be read */
+static size_t vcache_value_size(snd_ctl_elem_info_t *info)
+{
+	if (!(info->access & SNDRV_CTL_ELEM_ACCESS_READ) ||
+	    (info->access & SNDRV_CTL_ELEM_ACCESS_VOLATILE))
+		return 0;
+	switch (info->type) {
+	case SND_CTL_ELEM_TYPE_BOOLEAN:
+	case SND_CTL_ELEM_TYPE_INTEGER:
+		return info->count * sizeof(long);
+	case SND_CTL_ELEM_TYPE_INTEGER64:
+		return info->count * sizeof(long long);
+	case SND_CTL_ELEM_TYPE_ENUMERATED:
+		return info->count * sizeof(unsigned int);
+	case SND_CTL_ELEM_TYPE_BYTES:
+		return info->count;
+	case SND_CTL_ELEM_TYPE_IEC958:
+		return sizeof(struct snd_aes_iec958);
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Get the value cache shared by all handles on the card of ctl.  NULL
+ * is returned when ctl is not a hw handle or the cache is disabled.
+ */
+struct snd_ctl_value_cache *snd_ctl_value_cache_get(snd_ctl_t *ctl)
+{
+	static int enabled = -1;
+	struct snd_ctl_value_cache *cache;
+	snd_ctl_card_info_t info;
+	int err;
+
+	if (enabled < 0) {
+		char *p = getenv("LIBASOUND_CTL_CACHE");
+		enabled = !p || *p != '0';
+	}
+	if (!enabled || ctl->type != SND_CTL_TYPE_HW)
+		return NULL;
+	if (snd_ctl_card_info(ctl, &info) < 0)
+		return NULL;
+	vcache_lock();
+	for (cache = vcache_list; cache; cache = cache->next) {
+		if (cache->card == info.card) {
+			cache->refs++;
+			goto _end;
+		}
+	}
+	cache = calloc(1, sizeof(*cache));
+	if (!cache)
+		goto _end;
+	cache->card = info.card;
+	err = vcache_subscribe(cache);
+	if (err < 0) {
+		free(cache);
+		cache = NULL;
+		goto _end;
+	}
+	cache->refs = 1;
+	cache->next = vcache_list;
+	vcache_list = cache;
+ _end:
+	vcache_unlock();
+	return cache;
+}
+
+/* release a reference taken by snd_ctl_value_cache_get() */
+void snd_ctl_value_cache_put(struct snd_ctl_value_cache *cache)
+{
+	struct snd_ctl_value_cache **p;
+
+	vcache_lock();
+	if (--cache->refs > 0) {
+		vcache_unlock();
+		return;
+	}
+	for (p = &vcache_list; *p != cache; p = &(*p)->next)
+		;
+	*p = cache->next;
+	vcache_unlock();
+	vcache_flush(cache);
+	if (cache->ctl)
+		snd_ctl_close(cache->ctl);
+	free(cache);
+}
+
+/*
+ * Read an element value through the cache.  A miss reads the value with
+ * ctl and keeps it unless an event for the card arrived meanwhile.
+ */
+int snd_ctl_value_cache_read(struct snd_ctl_value_cache *cache,
+			     snd_ctl_t *ctl, snd_ctl_elem_value_t *value)
+{
+	unsigned int numid = value->id.numid;
+	snd_ctl_elem_info_t info;
+	struct vcache_entry *e, **p;
+	unsigned int gen;
+	size_t size;
+	int known, err;
+
+	if (!numid)
+		return snd_ctl_elem_read(ctl, value);
+	vcache_lock();
+	if (!vcache_usable(cache)) {
+		vcache_unlock();
+		return snd_ctl_elem_read(ctl, value);
+	}
+	vcache_drain(cache);
+	e = *vcache_slot(cache, numid);
+	if (e && (e->valid || !e->size)) {
+		size = e->size;
+		if (size)
+			memcpy(&value->value, e->data, size);
+		vcache_unlock();
+		return size ? 0 : snd_ctl_elem_read(ctl, value);
+	}
+	gen = cache->gen;
+	known = e != NULL;
+	size = known ? e->size : 0;
+	vcache_unlock();
+	if (!known) {
+		memset(&info, 0, sizeof(info));
+		info.id.numid = numid;
+		err = snd_ctl_elem_info(cache->ctl, &info);
+		size = err < 0 ? 0 : vcache_value_size(&info);
+	}
+	err = snd_ctl_elem_read(ctl, value);
+	if (err < 0)
+		return err;
+	vcache_lock();
+	vcache_drain(cache);
+	if (cache->gen == gen) {
+		p = vcache_slot(cache, numid);
+		e = *p;
+		if (!e) {
+			e = malloc(sizeof(*e) + size);
+			if (e) {
+				e->next = NULL;
+				e->numid = numid;
+				e->size = size;
+				*p = e;
+			}
+		}
+		if (e && e->size == size) {
+			memcpy(e->data, &value->value, size);
+			e->valid = 1;
+		}
+	}
+	vcache_unlock();
+	return err;
+}
+
+/* forget the value of an element written through this process */
+void snd_ctl_value_cache_invalidate(struct snd_ctl_value_cache *cache,
+				    unsigned int numid)
+{
+	struct vcache_entry *e;
+
+	vcache_lock();
+	e = *vcache_slot(cache, numid);
+	if (e)
+		e->valid = 0;
+	cache->gen++;
+	vcache_unlock();
+}
+
+#endif /* DOC_HIDDEN */
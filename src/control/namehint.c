@@ -26,6 +26,9 @@
  */
 
 #include "local.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef DOC_HIDDEN
 #define DEV_SKIP	9999 /* some non-existing device number */
@@ -47,12 +50,8 @@ struct hint_list {
 };
 #endif
 
-static int hint_list_add(struct hint_list *list,
-			 const char *name,
-			 const char *description)
+static int hint_list_push(struct hint_list *list, char *x)
 {
-	char *x;
-
 	if (list->count + 1 >= list->allocated) {
 		char **n = realloc(list->list, (list->allocated + 10) * sizeof(char *));
 		if (n == NULL)
@@ -61,6 +60,17 @@ static int hint_list_add(struct hint_list *list,
 		list->allocated += 10;
 		list->list = n;
 	}
+	list->list[list->count++] = x;
+	return 0;
+}
+
+static int hint_list_add(struct hint_list *list,
+			 const char *name,
+			 const char *description)
+{
+	char *x;
+	int err;
+
 	if (name == NULL) {
 		x = NULL;
 	} else {
@@ -74,8 +84,10 @@ static int hint_list_add(struct hint_list *list,
 			strcat(x, description);
 		}
 	}
-	list->list[list->count++] = x;
-	return 0;
+	err = hint_list_push(list, x);
+	if (err < 0)
+		free(x);
+	return err;
 }
 
 static void zero_handler(const char *file ATTRIBUTE_UNUSED,
@@ -519,6 +531,278 @@ static int add_software_devices(snd_config_t *config, snd_config_t *rw_config,
 	return 0;
 }
 
+/*
+ * Hint cache.  Building the hints opens every card and expands the
+ * definition of every device, so the results are kept per interface:
+ * the hints of each card, keyed by its card info, and the hints of the
+ * software devices, kept while the set of cards stays the same.  The
+ * configuration is held with snd_config_update_r(); any change of the
+ * configuration files drops the whole cache.
+ */
+#ifndef DOC_HIDDEN
+struct hint_set {
+	char **list;
+	unsigned int count;
+};
+
+struct hint_cache_card {
+	struct hint_cache_card *next;
+	int card;
+	snd_ctl_card_info_t info;
+	struct hint_set hints;
+};
+
+struct hint_cache {
+	struct hint_cache *next;
+	char *iface;
+	int software_valid;
+	struct hint_set software;
+	struct hint_cache_card *cards;
+};
+
+static struct hint_cache *hint_caches;
+static snd_config_t *hint_config;
+static snd_config_update_t *hint_config_update;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t hint_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void hint_cache_lock(void)
+{
+	pthread_mutex_lock(&hint_cache_mutex);
+}
+
+static inline void hint_cache_unlock(void)
+{
+	pthread_mutex_unlock(&hint_cache_mutex);
+}
+#else
+static inline void hint_cache_lock(void) {}
+static inline void hint_cache_unlock(void) {}
+#endif
+#endif /* DOC_HIDDEN */
+
+static void hint_set_free(struct hint_set *set)
+{
+	unsigned int i;
+
+	for (i = 0; i < set->count; i++)
+		free(set->list[i]);
+	free(set->list);
+	set->list = NULL;
+	set->count = 0;
+}
+
+/* keep a copy of the hints added to list from index start on */
+static int hint_set_store(struct hint_set *set, struct hint_list *list,
+			  unsigned int start)
+{
+	unsigned int i;
+
+	hint_set_free(set);
+	if (list->count == start)
+		return 0;
+	set->list = calloc(list->count - start, sizeof(char *));
+	if (set->list == NULL)
+		return -ENOMEM;
+	for (i = start; i < list->count; i++) {
+		set->list[set->count] = strdup(list->list[i]);
+		if (set->list[set->count] == NULL) {
+			hint_set_free(set);
+			return -ENOMEM;
+		}
+		set->count++;
+	}
+	return 0;
+}
+
+static int hint_set_copy(struct hint_list *list, const struct hint_set *set)
+{
+	unsigned int i;
+	char *x;
+	int err;
+
+	for (i = 0; i < set->count; i++) {
+		x = strdup(set->list[i]);
+		if (x == NULL)
+			return -ENOMEM;
+		err = hint_list_push(list, x);
+		if (err < 0) {
+			free(x);
+			return err;
+		}
+	}
+	return 0;
+}
+
+static void hint_cache_card_free(struct hint_cache_card *c)
+{
+	hint_set_free(&c->hints);
+	free(c);
+}
+
+static void hint_cache_flush(void)
+{
+	struct hint_cache *cache;
+	struct hint_cache_card *c;
+
+	while ((cache = hint_caches) != NULL) {
+		hint_caches = cache->next;
+		while ((c = cache->cards) != NULL) {
+			cache->cards = c->next;
+			hint_cache_card_free(c);
+		}
+		hint_set_free(&cache->software);
+		free(cache->iface);
+		free(cache);
+	}
+}
+
+static struct hint_cache *hint_cache_get(const char *iface)
+{
+	struct hint_cache *cache;
+
+	for (cache = hint_caches; cache; cache = cache->next)
+		if (strcmp(cache->iface, iface) == 0)
+			return cache;
+	cache = calloc(1, sizeof(*cache));
+	if (cache == NULL)
+		return NULL;
+	cache->iface = strdup(iface);
+	if (cache->iface == NULL) {
+		free(cache);
+		return NULL;
+	}
+	cache->next = hint_caches;
+	hint_caches = cache;
+	return cache;
+}
+
+/*
+ * Look up the hints of a card whose info is still the one seen when the
+ * hints were built.  Entries of cards which changed are dropped.
+ */
+static struct hint_cache_card *hint_cache_card_find(struct hint_cache *cache,
+						    int card)
+{
+	struct hint_cache_card *c, **p;
+	snd_ctl_card_info_t info;
+
+	for (p = &cache->cards; (c = *p) != NULL; p = &c->next)
+		if (c->card == card)
+			break;
+	if (c == NULL)
+		return NULL;
+	memset(&info, 0, sizeof(info));
+	if (snd_card_get_info_cached(card, &info) >= 0 &&
+	    memcmp(&info, &c->info, sizeof(info)) == 0)
+		return c;
+	*p = c->next;
+	hint_cache_card_free(c);
+	return NULL;
+}
+
+/*
+ * Drop the entries of cards which are gone or changed.  The software
+ * devices may refer to the cards, so their hints are dropped, too, when
+ * the set of cards is not the cached one.
+ */
+static void hint_cache_sync(struct hint_cache *cache)
+{
+	struct hint_cache_card *c, **p;
+	int card = -1, changed = 0;
+
+	for (p = &cache->cards; (c = *p) != NULL; ) {
+		if (snd_card_load(c->card)) {
+			p = &c->next;
+			continue;
+		}
+		*p = c->next;
+		hint_cache_card_free(c);
+		changed = 1;
+	}
+	while (snd_card_next(&card) >= 0 && card >= 0)
+		if (hint_cache_card_find(cache, card) == NULL)
+			changed = 1;
+	if (changed)
+		cache->software_valid = 0;
+}
+
+static int hint_rw_config(snd_config_t **rw_config)
+{
+	if (*rw_config)
+		return 0;
+	return snd_config_copy(rw_config, hint_config);
+}
+
+static int add_card_cached(struct hint_cache *cache, snd_config_t **rw_config,
+			   struct hint_list *list, int card)
+{
+	struct hint_cache_card *c;
+	unsigned int start = list->count;
+	int err;
+
+	c = cache ? hint_cache_card_find(cache, card) : NULL;
+	if (c)
+		return hint_set_copy(list, &c->hints);
+	err = hint_rw_config(rw_config);
+	if (err < 0)
+		return err;
+	err = get_card_name(list, card);
+	if (err < 0)
+		return err;
+	err = add_card(hint_config, *rw_config, list, card);
+	if (err < 0 || cache == NULL)
+		return err;
+	c = calloc(1, sizeof(*c));
+	if (c == NULL)
+		return 0;
+	c->card = card;
+	if (snd_card_get_info_cached(card, &c->info) < 0 ||
+	    hint_set_store(&c->hints, list, start) < 0) {
+		hint_cache_card_free(c);
+		return 0;
+	}
+	c->next = cache->cards;
+	cache->cards = c;
+	return 0;
+}
+
+static void add_software_devices_cached(struct hint_cache *cache,
+					snd_config_t **rw_config,
+					struct hint_list *list)
+{
+	unsigned int start = list->count;
+
+	if (cache && cache->software_valid) {
+		hint_set_copy(list, &cache->software);
+		return;
+	}
+	if (hint_rw_config(rw_config) < 0)
+		return;
+	if (add_software_devices(hint_config, *rw_config, list) < 0 ||
+	    cache == NULL)
+		return;
+	if (hint_set_store(&cache->software, list, start) >= 0)
+		cache->software_valid = 1;
+}
+
+#ifndef DOC_HIDDEN
+/* release the hint cache, see snd_config_update_free_global() */
+void snd_device_name_hint_cache_cleanup(void)
+{
+	hint_cache_lock();
+	hint_cache_flush();
+	if (hint_config)
+		snd_config_delete(hint_config);
+	hint_config = NULL;
+	if (hint_config_update)
+		snd_config_update_free(hint_config_update);
+	hint_config_update = NULL;
+	hint_cache_unlock();
+}
+#endif
+
 /**
  * \brief Get a set of device name hints
  * \param card Card number or -1 (means all cards)
@@ -550,19 +834,21 @@ int snd_device_name_hint(int card, const char *iface, void ***hints)
 	struct hint_list list;
 	char ehints[24];
 	const char *str;
-	snd_config_t *conf, *local_config = NULL, *local_config_rw = NULL;
-	snd_config_update_t *local_config_update = NULL;
+	snd_config_t *conf, *local_config_rw = NULL;
 	snd_config_iterator_t i, next;
+	struct hint_cache *cache;
 	int err;
 
 	if (hints == NULL)
 		return -EINVAL;
-	err = snd_config_update_r(&local_config, &local_config_update, NULL);
-	if (err < 0)
-		return err;
-	err = snd_config_copy(&local_config_rw, local_config);
-	if (err < 0)
+	hint_cache_lock();
+	err = snd_config_update_r(&hint_config, &hint_config_update, NULL);
+	if (err < 0) {
+		hint_cache_unlock();
 		return err;
+	}
+	if (err > 0)
+		hint_cache_flush();
 	list.list = NULL;
 	list.count = list.allocated = 0;
 	list.siface = iface;
@@ -587,22 +873,21 @@ int snd_device_name_hint(int card, const char *iface, void ***hints)
 		goto __error;
 	}
 
-	if (snd_config_search(local_config, "defaults.namehint.showall", &conf) >= 0)
+	/* without a cache entry the hints are simply built every time */
+	cache = hint_cache_get(iface);
+	if (snd_config_search(hint_config, "defaults.namehint.showall", &conf) >= 0)
 		list.show_all = snd_config_get_bool(conf) > 0;
 	if (card >= 0) {
-		err = get_card_name(&list, card);
-		if (err >= 0)
-			err = add_card(local_config, local_config_rw, &list, card);
+		err = add_card_cached(cache, &local_config_rw, &list, card);
 	} else {
-		add_software_devices(local_config, local_config_rw, &list);
+		if (cache)
+			hint_cache_sync(cache);
+		add_software_devices_cached(cache, &local_config_rw, &list);
 		err = snd_card_next(&card);
 		if (err < 0)
 			goto __error;
 		while (card >= 0) {
-			err = get_card_name(&list, card);
-			if (err < 0)
-				goto __error;
-			err = add_card(local_config, local_config_rw, &list, card);
+			err = add_card_cached(cache, &local_config_rw, &list, card);
 			if (err < 0)
 				goto __error;
 			err = snd_card_next(&card);
@@ -611,7 +896,7 @@ int snd_device_name_hint(int card, const char *iface, void ***hints)
 		}
 	}
 	sprintf(ehints, "namehint.%s", list.siface);
-	err = snd_config_search(local_config, ehints, &conf);
+	err = snd_config_search(hint_config, ehints, &conf);
 	if (err >= 0) {
 		snd_config_for_each(i, next, conf) {
 			if (snd_config_get_string(snd_config_iterator_entry(i),
@@ -636,10 +921,7 @@ int snd_device_name_hint(int card, const char *iface, void ***hints)
 	free(list.cardname);
 	if (local_config_rw)
 		snd_config_delete(local_config_rw);
-	if (local_config)
-		snd_config_delete(local_config);
-	if (local_config_update)
-		snd_config_update_free(local_config_update);
+	hint_cache_unlock();
 	return err;
 }
 
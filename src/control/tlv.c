@@ -117,6 +117,229 @@ int snd_tlv_parse_dB_info(unsigned int *tlv,
 	return -EINVAL; /* not found */
 }
 
+#ifndef DOC_HIDDEN
+/* a dB TLV other than a range, decoded for the conversions */
+struct tlv_leaf {
+	unsigned int type;
+	unsigned int flags;		/* tlv[3] */
+	int min;			/* tlv[2] */
+	int max;			/* tlv[3] */
+#ifndef HAVE_SOFT_FLOAT
+	int prepared;			/* the linear gains below are valid */
+	double lmin, lmax;		/* linear gains of min and max */
+	double vmin, vmax;		/* the same, with mute and 0dB mapped */
+#endif
+};
+#endif
+
+static void tlv_leaf_init(struct tlv_leaf *leaf, const unsigned int *tlv)
+{
+	memset(leaf, 0, sizeof(*leaf));
+	leaf->type = tlv[0];
+	switch (leaf->type) {
+	case SND_CTL_TLVT_DB_SCALE:
+	case SND_CTL_TLVT_DB_MINMAX:
+	case SND_CTL_TLVT_DB_MINMAX_MUTE:
+	case SND_CTL_TLVT_DB_LINEAR:
+		leaf->flags = tlv[3];
+		leaf->min = tlv[2];
+		leaf->max = tlv[3];
+		break;
+	}
+}
+
+#ifndef HAVE_SOFT_FLOAT
+/* precalculate the linear gains of a DB_LINEAR leaf */
+static void tlv_leaf_prepare(struct tlv_leaf *leaf)
+{
+	if (leaf->type != SND_CTL_TLVT_DB_LINEAR)
+		return;
+	leaf->lmin = pow(10.0, leaf->min/2000.0);
+	leaf->lmax = pow(10.0, leaf->max/2000.0);
+	leaf->vmin = (leaf->min <= SND_CTL_TLV_DB_GAIN_MUTE) ? 0.0 : leaf->lmin;
+	leaf->vmax = !leaf->max ? 1.0 : leaf->lmax;
+	leaf->prepared = 1;
+}
+#endif
+
+static int tlv_leaf_get_dB_range(const struct tlv_leaf *leaf,
+				 long rangemin, long rangemax,
+				 long *min, long *max)
+{
+	switch (leaf->type) {
+	case SND_CTL_TLVT_DB_SCALE: {
+		int step;
+		if (leaf->flags & 0x10000)
+			*min = SND_CTL_TLV_DB_GAIN_MUTE;
+		else
+			*min = leaf->min;
+		step = (leaf->flags & 0xffff);
+		*max = leaf->min + step * (rangemax - rangemin);
+		return 0;
+	}
+	case SND_CTL_TLVT_DB_MINMAX:
+	case SND_CTL_TLVT_DB_LINEAR:
+		*min = leaf->min;
+		*max = leaf->max;
+		return 0;
+	case SND_CTL_TLVT_DB_MINMAX_MUTE:
+		*min = SND_CTL_TLV_DB_GAIN_MUTE;
+		*max = leaf->max;
+		return 0;
+	}
+	return -EINVAL;
+}
+
+static int tlv_leaf_convert_to_dB(const struct tlv_leaf *leaf,
+				  long rangemin, long rangemax,
+				  long volume, long *db_gain)
+{
+	switch (leaf->type) {
+	case SND_CTL_TLVT_DB_SCALE: {
+		int min, step, mute;
+		min = leaf->min;
+		step = (leaf->flags & 0xffff);
+		mute = (leaf->flags >> 16) & 1;
+		if (mute && volume <= rangemin)
+			*db_gain = SND_CTL_TLV_DB_GAIN_MUTE;
+		else
+			*db_gain = (volume - rangemin) * step + min;
+		return 0;
+	}
+	case SND_CTL_TLVT_DB_MINMAX:
+	case SND_CTL_TLVT_DB_MINMAX_MUTE: {
+		int mindb, maxdb;
+		mindb = leaf->min;
+		maxdb = leaf->max;
+		if (volume <= rangemin || rangemax <= rangemin) {
+			if (leaf->type == SND_CTL_TLVT_DB_MINMAX_MUTE)
+				*db_gain = SND_CTL_TLV_DB_GAIN_MUTE;
+			else
+				*db_gain = mindb;
+		} else if (volume >= rangemax)
+			*db_gain = maxdb;
+		else
+			*db_gain = (maxdb - mindb) * (volume - rangemin) /
+				(rangemax - rangemin) + mindb;
+		return 0;
+	}
+#ifndef HAVE_SOFT_FLOAT
+	case SND_CTL_TLVT_DB_LINEAR: {
+		int mindb = leaf->min;
+		int maxdb = leaf->max;
+		if (volume <= rangemin || rangemax <= rangemin)
+			*db_gain = mindb;
+		else if (volume >= rangemax)
+			*db_gain = maxdb;
+		else {
+			double val = (double)(volume - rangemin) /
+				(double)(rangemax - rangemin);
+			if (mindb <= SND_CTL_TLV_DB_GAIN_MUTE)
+				*db_gain = (long)(100.0 * 20.0 * log10(val)) +
+					maxdb;
+			else {
+				double lmin, lmax;
+				if (leaf->prepared) {
+					lmin = leaf->lmin;
+					lmax = leaf->lmax;
+				} else {
+					lmin = pow(10.0, mindb/2000.0);
+					lmax = pow(10.0, maxdb/2000.0);
+				}
+				val = (lmax - lmin) * val + lmin;
+				*db_gain = (long)(100.0 * 20.0 * log10(val));
+			}
+		}
+		return 0;
+	}
+#endif
+	}
+	return -EINVAL;
+}
+
+static int tlv_leaf_convert_from_dB(const struct tlv_leaf *leaf,
+				    long rangemin, long rangemax,
+				    long db_gain, long *value, int xdir)
+{
+	switch (leaf->type) {
+	case SND_CTL_TLVT_DB_SCALE: {
+		int min, step, max;
+		min = leaf->min;
+		step = (leaf->flags & 0xffff);
+		max = min + (int)(step * (rangemax - rangemin));
+		if (db_gain <= min)
+			if (db_gain > SND_CTL_TLV_DB_GAIN_MUTE && xdir > 0 &&
+			    (leaf->flags & 0x10000))
+				*value = rangemin + 1;
+			else
+				*value = rangemin;
+		else if (db_gain >= max)
+			*value = rangemax;
+		else {
+			long v = (db_gain - min) * (rangemax - rangemin);
+			if (xdir > 0)
+				v += (max - min) - 1;
+			v = v / (max - min) + rangemin;
+			*value = v;
+		}
+		return 0;
+	}
+	case SND_CTL_TLVT_DB_MINMAX:
+	case SND_CTL_TLVT_DB_MINMAX_MUTE: {
+		int min, max;
+		min = leaf->min;
+		max = leaf->max;
+		if (db_gain <= min)
+			if (db_gain > SND_CTL_TLV_DB_GAIN_MUTE && xdir > 0 &&
+			    leaf->type == SND_CTL_TLVT_DB_MINMAX_MUTE)
+				*value = rangemin + 1;
+			else
+				*value = rangemin;
+		else if (db_gain >= max)
+			*value = rangemax;
+		else {
+			long v = (db_gain - min) * (rangemax - rangemin);
+			if (xdir > 0)
+				v += (max - min) - 1;
+			v = v / (max - min) + rangemin;
+			*value = v;
+		}
+		return 0;
+	}
+#ifndef HAVE_SOFT_FLOAT
+	case SND_CTL_TLVT_DB_LINEAR: {
+		int min, max;
+		min = leaf->min;
+		max = leaf->max;
+		if (db_gain <= min)
+			*value = rangemin;
+		else if (db_gain >= max)
+			*value = rangemax;
+		else {
+			double vmin, vmax, v;
+			if (leaf->prepared) {
+				vmin = leaf->vmin;
+				vmax = leaf->vmax;
+			} else {
+				vmin = (min <= SND_CTL_TLV_DB_GAIN_MUTE) ? 0.0 :
+					pow(10.0,  (double)min / 2000.0);
+				vmax = !max ? 1.0 : pow(10.0,  (double)max / 2000.0);
+			}
+			v = pow(10.0, (double)db_gain / 2000.0);
+			v = (v - vmin) * (rangemax - rangemin) / (vmax - vmin);
+			if (xdir > 0)
+				v = ceil(v);
+			*value = (long)v + rangemin;
+		}
+		return 0;
+	}
+#endif
+	default:
+		break;
+	}
+	return -EINVAL;
+}
+
 /**
  * \brief Get the dB min/max values
  * \param tlv the TLV source returned by #snd_tlv_parse_dB_info()
@@ -129,6 +352,7 @@ int snd_tlv_parse_dB_info(unsigned int *tlv,
 int snd_tlv_get_dB_range(unsigned int *tlv, long rangemin, long rangemax,
 			 long *min, long *max)
 {
+	struct tlv_leaf leaf;
 	int err;
 
 	switch (tlv[0]) {
@@ -165,27 +389,10 @@ int snd_tlv_get_dB_range(unsigned int *tlv, long rangemin, long rangemax,
 		}
 		return 0;
 	}
-	case SND_CTL_TLVT_DB_SCALE: {
-		int step;
-		if (tlv[3] & 0x10000)
-			*min = SND_CTL_TLV_DB_GAIN_MUTE;
-		else
-			*min = (int)tlv[2];
-		step = (tlv[3] & 0xffff);
-		*max = (int)tlv[2] + step * (rangemax - rangemin);
-		return 0;
-	}
-	case SND_CTL_TLVT_DB_MINMAX:
-	case SND_CTL_TLVT_DB_LINEAR:
-		*min = (int)tlv[2];
-		*max = (int)tlv[3];
-		return 0;
-	case SND_CTL_TLVT_DB_MINMAX_MUTE:
-		*min = SND_CTL_TLV_DB_GAIN_MUTE;
-		*max = (int)tlv[3];
-		return 0;
+	default:
+		tlv_leaf_init(&leaf, tlv);
+		return tlv_leaf_get_dB_range(&leaf, rangemin, rangemax, min, max);
 	}
-	return -EINVAL;
 }
 
 /**
@@ -200,6 +407,8 @@ int snd_tlv_get_dB_range(unsigned int *tlv, long rangemin, long rangemax,
 int snd_tlv_convert_to_dB(unsigned int *tlv, long rangemin, long rangemax,
 			  long volume, long *db_gain)
 {
+	struct tlv_leaf leaf;
+
 	switch (tlv[0]) {
 	case SND_CTL_TLVT_DB_RANGE: {
 		unsigned int pos, len;
@@ -218,61 +427,11 @@ int snd_tlv_convert_to_dB(unsigned int *tlv, long rangemin, long rangemax,
 		}
 		return -EINVAL;
 	}
-	case SND_CTL_TLVT_DB_SCALE: {
-		int min, step, mute;
-		min = tlv[2];
-		step = (tlv[3] & 0xffff);
-		mute = (tlv[3] >> 16) & 1;
-		if (mute && volume <= rangemin)
-			*db_gain = SND_CTL_TLV_DB_GAIN_MUTE;
-		else
-			*db_gain = (volume - rangemin) * step + min;
-		return 0;
-	}
-	case SND_CTL_TLVT_DB_MINMAX:
-	case SND_CTL_TLVT_DB_MINMAX_MUTE: {
-		int mindb, maxdb;
-		mindb = tlv[2];
-		maxdb = tlv[3];
-		if (volume <= rangemin || rangemax <= rangemin) {
-			if (tlv[0] == SND_CTL_TLVT_DB_MINMAX_MUTE)
-				*db_gain = SND_CTL_TLV_DB_GAIN_MUTE;
-			else
-				*db_gain = mindb;
-		} else if (volume >= rangemax)
-			*db_gain = maxdb;
-		else
-			*db_gain = (maxdb - mindb) * (volume - rangemin) /
-				(rangemax - rangemin) + mindb;
-		return 0;
-	}
-#ifndef HAVE_SOFT_FLOAT
-	case SND_CTL_TLVT_DB_LINEAR: {
-		int mindb = tlv[2];
-		int maxdb = tlv[3];
-		if (volume <= rangemin || rangemax <= rangemin)
-			*db_gain = mindb;
-		else if (volume >= rangemax)
-			*db_gain = maxdb;
-		else {
-			double val = (double)(volume - rangemin) /
-				(double)(rangemax - rangemin);
-			if (mindb <= SND_CTL_TLV_DB_GAIN_MUTE)
-				*db_gain = (long)(100.0 * 20.0 * log10(val)) +
-					maxdb;
-			else {
-				/* FIXME: precalculate and cache these values */
-				double lmin = pow(10.0, mindb/2000.0);
-				double lmax = pow(10.0, maxdb/2000.0);
-				val = (lmax - lmin) * val + lmin;
-				*db_gain = (long)(100.0 * 20.0 * log10(val));
-			}
-		}
-		return 0;
-	}
-#endif
+	default:
+		tlv_leaf_init(&leaf, tlv);
+		return tlv_leaf_convert_to_dB(&leaf, rangemin, rangemax,
+					      volume, db_gain);
 	}
-	return -EINVAL;
 }
 
 /**
@@ -289,6 +448,8 @@ int snd_tlv_convert_to_dB(unsigned int *tlv, long rangemin, long rangemax,
 int snd_tlv_convert_from_dB(unsigned int *tlv, long rangemin, long rangemax,
 			    long db_gain, long *value, int xdir)
 {
+	struct tlv_leaf leaf;
+
 	switch (tlv[0]) {
 	case SND_CTL_TLVT_DB_RANGE: {
 		long dbmin, dbmax, prev_submax;
@@ -323,78 +484,204 @@ int snd_tlv_convert_from_dB(unsigned int *tlv, long rangemin, long rangemax,
 		*value = prev_submax;
 		return 0;
 	}
-	case SND_CTL_TLVT_DB_SCALE: {
-		int min, step, max;
-		min = tlv[2];
-		step = (tlv[3] & 0xffff);
-		max = min + (int)(step * (rangemax - rangemin));
-		if (db_gain <= min)
-			if (db_gain > SND_CTL_TLV_DB_GAIN_MUTE && xdir > 0 &&
-			    (tlv[3] & 0x10000))
-				*value = rangemin + 1;
-			else
-				*value = rangemin;
-		else if (db_gain >= max)
-			*value = rangemax;
-		else {
-			long v = (db_gain - min) * (rangemax - rangemin);
-			if (xdir > 0)
-				v += (max - min) - 1;
-			v = v / (max - min) + rangemin;
-			*value = v;
-		}
-		return 0;
+	default:
+		tlv_leaf_init(&leaf, tlv);
+		return tlv_leaf_convert_from_dB(&leaf, rangemin, rangemax,
+						db_gain, value, xdir);
 	}
-	case SND_CTL_TLVT_DB_MINMAX:
-	case SND_CTL_TLVT_DB_MINMAX_MUTE: {
-		int min, max;
-		min = tlv[2];
-		max = tlv[3];
-		if (db_gain <= min)
-			if (db_gain > SND_CTL_TLV_DB_GAIN_MUTE && xdir > 0 &&
-			    tlv[0] == SND_CTL_TLVT_DB_MINMAX_MUTE)
-				*value = rangemin + 1;
-			else
-				*value = rangemin;
-		else if (db_gain >= max)
-			*value = rangemax;
-		else {
-			long v = (db_gain - min) * (rangemax - rangemin);
-			if (xdir > 0)
-				v += (max - min) - 1;
-			v = v / (max - min) + rangemin;
-			*value = v;
+}
+
+#ifndef DOC_HIDDEN
+/* volume ranges up to this span get a lookup table for snd_tlv_dB_table_to_dB() */
+#define DB_TABLE_MAX_VOLUMES	1024
+
+struct tlv_dB_point {
+	long db_gain;
+	int err;
+};
+
+struct tlv_dB_sub {
+	long submin, submax;		/* submax clipped to rangemax */
+	long dbmin, dbmax;		/* as seen by snd_tlv_convert_from_dB() */
+	int range_err;
+	unsigned int *tlv;		/* nested ranges are converted raw */
+	struct tlv_leaf leaf;
+};
+
+struct snd_tlv_dB_table {
+	unsigned int *tlv;
+	long rangemin, rangemax;
+	struct tlv_leaf leaf;		/* when tlv is not a DB_RANGE */
+	int from_err;			/* DB_RANGE rejected by the from_dB loop */
+	unsigned int subs_count;
+	struct tlv_dB_sub *subs;
+	struct tlv_dB_point *points;	/* rangemin .. rangemax, or NULL */
+};
+#endif
+
+/* the conversion to dB of a table without the lookup of the points */
+static int tlv_dB_table_convert(struct snd_tlv_dB_table *t, long volume,
+				long *db_gain)
+{
+	if (t->tlv[0] == SND_CTL_TLVT_DB_RANGE)
+		return snd_tlv_convert_to_dB(t->tlv, t->rangemin, t->rangemax,
+					     volume, db_gain);
+	return tlv_leaf_convert_to_dB(&t->leaf, t->rangemin, t->rangemax,
+				      volume, db_gain);
+}
+
+/*
+ * Compile the dB TLV returned by snd_tlv_parse_dB_info() for the given
+ * raw volume range.  The table refers to tlv, which must stay valid
+ * until snd_tlv_dB_table_free(); the results of the table functions are
+ * the same as of the snd_tlv_* conversions for the same arguments.
+ */
+int snd_tlv_dB_table_new(struct snd_tlv_dB_table **tablep, unsigned int *tlv,
+			 long rangemin, long rangemax)
+{
+	struct snd_tlv_dB_table *t;
+	unsigned int pos, len;
+	long v;
+
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		return -ENOMEM;
+	t->tlv = tlv;
+	t->rangemin = rangemin;
+	t->rangemax = rangemax;
+	if (tlv[0] == SND_CTL_TLVT_DB_RANGE) {
+		long dbmin = 0, dbmax = 0;
+		len = int_index(tlv[1]);
+		if (len < 6 || len > MAX_TLV_RANGE_SIZE) {
+			t->from_err = 1;
+			goto _points;
 		}
-		return 0;
-	}
+		t->subs = calloc(len / 4, sizeof(*t->subs));
+		if (!t->subs)
+			goto _nomem;
+		for (pos = 2; pos + 4 <= len; pos += int_index(tlv[pos + 3]) + 4) {
+			struct tlv_dB_sub *sub = &t->subs[t->subs_count++];
+			sub->submin = (int)tlv[pos];
+			sub->submax = (int)tlv[pos + 1];
+			if (rangemax < sub->submax)
+				sub->submax = rangemax;
+			sub->tlv = tlv + pos + 2;
+			sub->range_err = snd_tlv_get_dB_range(sub->tlv,
+							      sub->submin,
+							      sub->submax,
+							      &dbmin, &dbmax);
+			sub->dbmin = dbmin;
+			sub->dbmax = dbmax;
+			tlv_leaf_init(&sub->leaf, sub->tlv);
 #ifndef HAVE_SOFT_FLOAT
-	case SND_CTL_TLVT_DB_LINEAR: {
-		int min, max;
-		min = tlv[2];
-		max = tlv[3];
-		if (db_gain <= min)
-			*value = rangemin;
-		else if (db_gain >= max)
-			*value = rangemax;
-		else {
-			/* FIXME: precalculate and cache vmin and vmax */
-			double vmin, vmax, v;
-			vmin = (min <= SND_CTL_TLV_DB_GAIN_MUTE) ? 0.0 :
-				pow(10.0,  (double)min / 2000.0);
-			vmax = !max ? 1.0 : pow(10.0,  (double)max / 2000.0);
-			v = pow(10.0, (double)db_gain / 2000.0);
-			v = (v - vmin) * (rangemax - rangemin) / (vmax - vmin);
-			if (xdir > 0)
-				v = ceil(v);
-			*value = (long)v + rangemin;
+			tlv_leaf_prepare(&sub->leaf);
+#endif
+			if (rangemax == sub->submax)
+				break;
+		}
+	} else {
+		tlv_leaf_init(&t->leaf, tlv);
+#ifndef HAVE_SOFT_FLOAT
+		tlv_leaf_prepare(&t->leaf);
+#endif
+	}
+ _points:
+	if (rangemin <= rangemax &&
+	    (unsigned long)rangemax - (unsigned long)rangemin <
+	    DB_TABLE_MAX_VOLUMES) {
+		t->points = malloc((rangemax - rangemin + 1) * sizeof(*t->points));
+		if (!t->points)
+			goto _nomem;
+		for (v = rangemin; v <= rangemax; v++) {
+			struct tlv_dB_point *p = &t->points[v - rangemin];
+			p->err = tlv_dB_table_convert(t, v, &p->db_gain);
 		}
+	}
+	*tablep = t;
+	return 0;
+
+ _nomem:
+	snd_tlv_dB_table_free(t);
+	return -ENOMEM;
+}
+
+/* free a table compiled by snd_tlv_dB_table_new() */
+void snd_tlv_dB_table_free(struct snd_tlv_dB_table *table)
+{
+	if (!table)
+		return;
+	free(table->subs);
+	free(table->points);
+	free(table);
+}
+
+/* check whether the table was compiled for the given TLV and volume range */
+int snd_tlv_dB_table_match(struct snd_tlv_dB_table *table, unsigned int *tlv,
+			   long rangemin, long rangemax)
+{
+	return table->tlv == tlv && table->rangemin == rangemin &&
+		table->rangemax == rangemax;
+}
+
+/* same as snd_tlv_get_dB_range(), which needs no floating point */
+int snd_tlv_dB_table_get_range(struct snd_tlv_dB_table *table,
+			       long *min, long *max)
+{
+	return snd_tlv_get_dB_range(table->tlv, table->rangemin,
+				    table->rangemax, min, max);
+}
+
+/* same as snd_tlv_convert_to_dB() */
+int snd_tlv_dB_table_to_dB(struct snd_tlv_dB_table *table, long volume,
+			   long *db_gain)
+{
+	if (table->points && volume >= table->rangemin &&
+	    volume <= table->rangemax) {
+		struct tlv_dB_point *p = &table->points[volume - table->rangemin];
+		if (p->err < 0)
+			return p->err;
+		*db_gain = p->db_gain;
 		return 0;
 	}
-#endif
-	default:
-		break;
+	return tlv_dB_table_convert(table, volume, db_gain);
+}
+
+/* same as snd_tlv_convert_from_dB() */
+int snd_tlv_dB_table_from_dB(struct snd_tlv_dB_table *table, long db_gain,
+			     long *value, int xdir)
+{
+	struct tlv_dB_sub *sub;
+	long prev_submax = 0;
+	unsigned int i;
+
+	if (table->tlv[0] != SND_CTL_TLVT_DB_RANGE)
+		return tlv_leaf_convert_from_dB(&table->leaf, table->rangemin,
+						table->rangemax, db_gain,
+						value, xdir);
+	if (table->from_err)
+		return -EINVAL;
+	for (i = 0; i < table->subs_count; i++) {
+		sub = &table->subs[i];
+		if (!sub->range_err &&
+		    db_gain >= sub->dbmin && db_gain <= sub->dbmax) {
+			if (sub->leaf.type == SND_CTL_TLVT_DB_RANGE)
+				return snd_tlv_convert_from_dB(sub->tlv,
+							       sub->submin,
+							       sub->submax,
+							       db_gain, value,
+							       xdir);
+			return tlv_leaf_convert_from_dB(&sub->leaf,
+							sub->submin,
+							sub->submax,
+							db_gain, value, xdir);
+		} else if (db_gain < sub->dbmin) {
+			*value = xdir > 0 || i == 0 ? sub->submin : prev_submax;
+			return 0;
+		}
+		prev_submax = sub->submax;
 	}
-	return -EINVAL;
+	*value = prev_submax;
+	return 0;
 }
 
 #ifndef DOC_HIDDEN
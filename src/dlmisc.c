@@ -27,7 +27,6 @@
  *
  */
 
-#include "list.h"
 #include "local.h"
 #ifdef HAVE_LIBPTHREAD
 #include <pthread.h>
@@ -195,15 +194,29 @@ void *snd_dlsym(void *handle, const char *name, const char *version)
  */
 
 #ifndef DOC_HIDDEN
+/*
+ * Resolved symbols are kept until snd_dlobj_cache_cleanup() even when
+ * nobody holds a reference, so opening the same plugin, hook or
+ * function again costs one hash lookup instead of a dlopen() and up to
+ * two dlsym() calls.  Entries are hashed by library and symbol name for
+ * lookups and by the function pointer for snd_dlobj_cache_put().
+ */
+#define DLOBJ_HASH_SIZE		64
+
 struct dlobj_cache {
 	const char *lib;
 	const char *name;
 	void *dlobj;
 	void *func;
 	unsigned int refcnt;
-	struct list_head list;
+	unsigned int hash;
+	struct dlobj_cache *name_next;
+	struct dlobj_cache *func_next;
 };
 
+static struct dlobj_cache *dlobj_name_hash[DLOBJ_HASH_SIZE];
+static struct dlobj_cache *dlobj_func_hash[DLOBJ_HASH_SIZE];
+
 #ifdef HAVE_LIBPTHREAD
 static pthread_mutex_t snd_dlobj_mutex = PTHREAD_MUTEX_INITIALIZER;
 
@@ -221,30 +234,56 @@ static inline void snd_dlobj_lock(void) {}
 static inline void snd_dlobj_unlock(void) {}
 #endif
 
-static LIST_HEAD(pcm_dlobj_list);
+static unsigned int dlobj_hash_str(unsigned int hash, const char *str)
+{
+	while (*str)
+		hash = (hash ^ (unsigned char)*str++) * 16777619U;
+	return hash;
+}
+
+static inline unsigned int dlobj_hash(const char *lib, const char *name)
+{
+	unsigned int hash = 2166136261U;
+
+	if (lib)
+		hash = dlobj_hash_str(hash, lib);
+	hash = (hash ^ '/') * 16777619U;
+	return dlobj_hash_str(hash, name);
+}
+
+static inline struct dlobj_cache **dlobj_func_slot(void *func)
+{
+	return &dlobj_func_hash[((unsigned long)func >> 4) % DLOBJ_HASH_SIZE];
+}
+
+static struct dlobj_cache *dlobj_find(const char *lib, const char *name,
+				      unsigned int hash)
+{
+	struct dlobj_cache *c;
+
+	for (c = dlobj_name_hash[hash % DLOBJ_HASH_SIZE]; c; c = c->name_next) {
+		if (c->hash != hash || strcmp(c->name, name))
+			continue;
+		if (c->lib == NULL ? lib == NULL : lib && !strcmp(c->lib, lib))
+			return c;
+	}
+	return NULL;
+}
 
 void *snd_dlobj_cache_get(const char *lib, const char *name,
 			  const char *version, int verbose)
 {
-	struct list_head *p;
-	struct dlobj_cache *c;
+	struct dlobj_cache *c, **slot;
+	unsigned int hash = dlobj_hash(lib, name);
 	void *func, *dlobj;
 
 	snd_dlobj_lock();
-	list_for_each(p, &pcm_dlobj_list) {
-		c = list_entry(p, struct dlobj_cache, list);
-		if (c->lib && lib && strcmp(c->lib, lib) != 0)
-			continue;
-		if (!c->lib && lib)
-			continue;
-		if (!lib && c->lib)
-			continue;
-		if (strcmp(c->name, name) == 0) {
-			c->refcnt++;
-			func = c->func;
-			snd_dlobj_unlock();
-			return func;
-		}
+	c = dlobj_find(lib, name, hash);
+	if (c) {
+		c->refcnt++;
+		func = c->func;
+		snd_dlobj_unlock();
+		return func;
 	}
 
 	dlobj = snd_dlopen(lib, RTLD_NOW);
@@ -280,14 +319,19 @@ void *snd_dlobj_cache_get(const char *lib, const char *name,
 	}
 	c->dlobj = dlobj;
 	c->func = func;
-	list_add_tail(&c->list, &pcm_dlobj_list);
+	c->hash = hash;
+	slot = &dlobj_name_hash[hash % DLOBJ_HASH_SIZE];
+	c->name_next = *slot;
+	*slot = c;
+	slot = dlobj_func_slot(func);
+	c->func_next = *slot;
+	*slot = c;
 	snd_dlobj_unlock();
 	return func;
 }
 
 int snd_dlobj_cache_put(void *func)
 {
-	struct list_head *p;
 	struct dlobj_cache *c;
 	unsigned int refcnt;
 
@@ -295,8 +339,7 @@ int snd_dlobj_cache_put(void *func)
 		return -ENOENT;
 
 	snd_dlobj_lock();
-	list_for_each(p, &pcm_dlobj_list) {
-		c = list_entry(p, struct dlobj_cache, list);
+	for (c = *dlobj_func_slot(func); c; c = c->func_next) {
 		if (c->func == func) {
 			refcnt = c->refcnt;
 			if (c->refcnt > 0)
@@ -311,21 +354,27 @@ int snd_dlobj_cache_put(void *func)
 
 void snd_dlobj_cache_cleanup(void)
 {
-	struct list_head *p, *npos;
-	struct dlobj_cache *c;
+	struct dlobj_cache *c, **p, **f;
+	unsigned int i;
 
 	snd_dlobj_lock();
-	list_for_each_safe(p, npos, &pcm_dlobj_list) {
-		c = list_entry(p, struct dlobj_cache, list);
-		if (c->refcnt)
-			continue;
-		list_del(p);
-		snd_dlclose(c->dlobj);
-		free((void *)c->name); /* shut up gcc warning */
-		free((void *)c->lib); /* shut up gcc warning */
-		free(c);
+	for (i = 0; i < DLOBJ_HASH_SIZE; i++) {
+		p = &dlobj_name_hash[i];
+		while ((c = *p) != NULL) {
+			if (c->refcnt) {
+				p = &c->name_next;
+				continue;
+			}
+			*p = c->name_next;
+			for (f = dlobj_func_slot(c->func); *f != c; f = &(*f)->func_next)
+				;
+			*f = c->func_next;
+			snd_dlclose(c->dlobj);
+			free((void *)c->name); /* shut up gcc warning */
+			free((void *)c->lib); /* shut up gcc warning */
+			free(c);
+		}
 	}
-
 	snd_dlobj_unlock();
 }
 #endif
@@ -32,6 +32,7 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <time.h>
 #include "local.h"
 
 /**
@@ -149,13 +150,26 @@ const char *snd_asoundlib_version(void)
 /*
  * internal error handling
  */
+static int snd_err_msg_enabled(void)
+{
+	static int enabled = -1;
+	const char *verbose;
+
+	if (enabled < 0) {
+		verbose = getenv("LIBASOUND_DEBUG");
+		enabled = verbose && *verbose;
+	}
+	return enabled;
+}
+
 static void snd_err_msg_default(const char *file, int line, const char *function, int err, const char *fmt, ...)
 {
 	va_list arg;
+#ifdef ALSA_DEBUG_ASSERT
 	const char *verbose;
+#endif
 	
-	verbose = getenv("LIBASOUND_DEBUG");
-	if (! verbose || ! *verbose)
+	if (!snd_err_msg_enabled())
 		return;
 	va_start(arg, fmt);
 	fprintf(stderr, "ALSA lib %s:%i:(%s) ", file, line, function);
@@ -177,3 +191,122 @@ static void snd_err_msg_default(const char *file, int line, const char *function
 snd_lib_error_handler_t snd_err_msg = snd_err_msg_default;
 
 #endif
+
+#ifndef DOC_HIDDEN
+#define ERR_RATELIMIT_BURST	10	/* messages per second and call site */
+
+/*
+ * Call sites with dropped messages not reported yet.  The count of a
+ * site is printed once its second is over, by the next message of any
+ * site, or at exit.
+ */
+static struct snd_err_ratelimit *err_pending;
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t err_pending_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define err_pending_lock()	pthread_mutex_lock(&err_pending_mutex)
+#define err_pending_unlock()	pthread_mutex_unlock(&err_pending_mutex)
+#else
+#define err_pending_lock()	do { } while (0)
+#define err_pending_unlock()	do { } while (0)
+#endif
+
+static void err_report_missed(struct snd_err_ratelimit *rl)
+{
+	fprintf(stderr, "ALSA lib %s:%i:(%s) %u similar messages suppressed\n",
+		rl->file, rl->line, rl->function, rl->missed);
+	rl->missed = 0;
+}
+
+/* report the counts of the sites whose second is over, or all of them */
+static void err_report_pending(long now, int all)
+{
+	struct snd_err_ratelimit **p, *rl;
+
+	err_pending_lock();
+	for (p = &err_pending; (rl = *p) != NULL; ) {
+		if (all || rl->stamp != now) {
+			*p = rl->next;
+			rl->next = NULL;
+			err_report_missed(rl);
+		} else
+			p = &rl->next;
+	}
+	err_pending_unlock();
+}
+
+static void snd_lib_error_end(void) __attribute__ ((destructor));
+
+static void snd_lib_error_end(void)
+{
+	if (err_pending)
+		err_report_pending(0, 1);
+}
+
+/*
+ * Configuration and open errors are reported once per attempt and are
+ * not limited: a parse error or a missing device must always be seen.
+ */
+static int err_site_exempt(const char *file, const char *function)
+{
+	const char *base = strrchr(file, '/');
+
+	base = base ? base + 1 : file;
+	if (!strcmp(base, "conf.c") || !strcmp(base, "confmisc.c"))
+		return 1;
+	return strstr(function, "open") || strstr(function, "load") ||
+	       strstr(function, "parse");
+}
+
+/*
+ * called by SNDERR() and friends before the message is formatted:
+ * a handler set by the application gets everything, the default ones
+ * print at most ERR_RATELIMIT_BURST messages per second of a call site
+ * to stderr and note how many were dropped; the counters may race
+ * between threads, which only blurs the limit
+ */
+int snd_lib_error_ratelimit(struct snd_err_ratelimit *rl, int debug,
+			    const char *file, int line, const char *function)
+{
+	struct timespec ts;
+
+	if (debug) {
+#ifndef NDEBUG
+		if (snd_err_msg != snd_err_msg_default)
+			return 1;
+		if (!snd_err_msg_enabled())
+			return 0;
+#endif
+	} else if (snd_lib_error != snd_lib_error_default || local_error)
+		return 1;
+#ifdef CLOCK_MONOTONIC_COARSE
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+	if (err_pending)
+		err_report_pending(ts.tv_sec, 0);
+	if (!rl->exempt) {
+		rl->file = file;
+		rl->line = line;
+		rl->function = function;
+		rl->exempt = err_site_exempt(file, function) ? 2 : 1;
+	}
+	if (rl->exempt == 2)
+		return 1;
+	if (rl->stamp != ts.tv_sec) {
+		rl->stamp = ts.tv_sec;
+		rl->count = 0;
+	}
+	if (rl->count >= ERR_RATELIMIT_BURST) {
+		err_pending_lock();
+		if (!rl->missed++) {
+			rl->next = err_pending;
+			err_pending = rl;
+		}
+		err_pending_unlock();
+		return 0;
+	}
+	rl->count++;
+	return 1;
+}
+#endif /* DOC_HIDDEN */
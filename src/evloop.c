@@ -0,0 +1,656 @@
+/**
+ * \file evloop.c
+ * \brief Event loop helper
+ * \date 2026
+ *
+ * The event loop keeps the poll descriptors of registered handles in
+ * one epoll set and calls a callback for each handle with events.
+ */
+/*
+ *  Event loop helper
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#include "local.h"
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+/*
+ * Each poll descriptor of a source gets an epoll entry pointing to its
+ * slot, so a wakeup touches only the sources with events.  The epoll
+ * set is level triggered with the events the handle asked for, like
+ * poll().  A descriptor already in the set (two handles of one device,
+ * or a shared timer) is added as a dup, since epoll keys the entries
+ * by descriptor.  Descriptors epoll refuses (regular files, /dev/null
+ * of the null plugins) are always ready for poll(), so they are kept
+ * on a list and reported on each dispatch.
+ *
+ * A removed source is kept on the zombie list until the dispatch is
+ * done with the events it already got.
+ *
+ * A timer is a timerfd in the same set, so a loop waiting for handles
+ * and a deadline still makes one epoll_wait() per wakeup, and the
+ * deadline stays put across the wakeups of the handles instead of
+ * being computed again for each wait.
+ */
+
+#define EVLOOP_EVENTS	64
+
+typedef struct {
+	snd_evloop_source_t *src;
+	int fd;			/* the registered descriptor, maybe a dup */
+	int always;		/* not pollable with epoll, always ready */
+} snd_evloop_slot_t;
+
+struct _snd_evloop_source {
+	snd_evloop_t *loop;
+	const snd_evloop_ops_t *ops;
+	void *handle;
+	short events;
+	snd_evloop_callback_t callback;
+	void *private_data;
+	unsigned int count;
+	struct pollfd *pfds;
+	snd_evloop_slot_t *slots;
+	unsigned int always;
+	unsigned int stamp;
+	int removed;
+	snd_evloop_source_t *ready;
+	struct list_head list;
+	struct list_head alist;
+};
+
+struct _snd_evloop {
+	int epoll_fd;
+	unsigned int stamp;
+	int dispatching;
+	struct list_head sources;
+	struct list_head always;
+	struct list_head zombies;
+	struct epoll_event events[EVLOOP_EVENTS];
+};
+
+/**
+ * \brief Creates an event loop.
+ * \param loopp Returned event loop
+ * \return 0 on success otherwise a negative error code
+ */
+int snd_evloop_open(snd_evloop_t **loopp)
+{
+	snd_evloop_t *loop;
+
+	assert(loopp);
+	loop = calloc(1, sizeof(*loop));
+	if (!loop)
+		return -ENOMEM;
+	loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (loop->epoll_fd < 0) {
+		int err = -errno;
+		SYSERR("epoll_create1");
+		free(loop);
+		return err;
+	}
+	INIT_LIST_HEAD(&loop->sources);
+	INIT_LIST_HEAD(&loop->always);
+	INIT_LIST_HEAD(&loop->zombies);
+	*loopp = loop;
+	return 0;
+}
+
+static void evloop_free_source(snd_evloop_source_t *src)
+{
+	free(src->pfds);
+	free(src->slots);
+	free(src);
+}
+
+static void evloop_unregister(snd_evloop_source_t *src)
+{
+	snd_evloop_t *loop = src->loop;
+	unsigned int i;
+
+	for (i = 0; i < src->count; i++) {
+		snd_evloop_slot_t *slot = &src->slots[i];
+
+		if (slot->always || slot->fd < 0)
+			continue;
+		epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, slot->fd, NULL);
+		if (slot->fd != src->pfds[i].fd)
+			close(slot->fd);
+	}
+	if (src->always)
+		list_del(&src->alist);
+	src->always = 0;
+	src->count = 0;
+}
+
+static int evloop_register(snd_evloop_source_t *src)
+{
+	snd_evloop_t *loop = src->loop;
+	struct epoll_event ev;
+	unsigned int i;
+	int err;
+
+	for (i = 0; i < src->count; i++) {
+		snd_evloop_slot_t *slot = &src->slots[i];
+		struct pollfd *pfd = &src->pfds[i];
+
+		slot->src = src;
+		slot->fd = -1;
+		slot->always = 0;
+		if (src->events)
+			pfd->events &= src->events;
+		if (!(pfd->events & (POLLIN | POLLOUT | POLLPRI)))
+			continue;
+		/* EPOLLIN, EPOLLOUT and EPOLLPRI have the values of poll() */
+		ev.events = pfd->events & (POLLIN | POLLOUT | POLLPRI);
+		ev.data.ptr = slot;
+		if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, pfd->fd, &ev) == 0) {
+			slot->fd = pfd->fd;
+			continue;
+		}
+		if (errno == EPERM) {
+			slot->always = 1;
+			src->always++;
+			continue;
+		}
+		if (errno != EEXIST)
+			goto _err;
+		slot->fd = fcntl(pfd->fd, F_DUPFD_CLOEXEC, 0);
+		if (slot->fd < 0)
+			goto _err;
+		if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, slot->fd, &ev) < 0) {
+			err = errno;
+			close(slot->fd);
+			slot->fd = -1;
+			errno = err;
+			goto _err;
+		}
+	}
+	if (src->always)
+		list_add_tail(&src->alist, &loop->always);
+	return 0;
+ _err:
+	err = -errno;
+	SYSERR("cannot add poll descriptor %d", src->pfds[i].fd);
+	src->count = i;
+	if (src->always)
+		list_add_tail(&src->alist, &loop->always);
+	evloop_unregister(src);
+	return err;
+}
+
+static int evloop_query(snd_evloop_source_t *src)
+{
+	struct pollfd *pfds;
+	snd_evloop_slot_t *slots;
+	int count;
+
+	count = src->ops->count(src->handle);
+	if (count < 0)
+		return count;
+	pfds = realloc(src->pfds, sizeof(*pfds) * (count ? count : 1));
+	if (!pfds)
+		return -ENOMEM;
+	src->pfds = pfds;
+	slots = realloc(src->slots, sizeof(*slots) * (count ? count : 1));
+	if (!slots)
+		return -ENOMEM;
+	src->slots = slots;
+	count = src->ops->descriptors(src->handle, pfds, count);
+	if (count < 0)
+		return count;
+	src->count = count;
+	return 0;
+}
+
+/**
+ * \brief Registers a handle with an event loop (internal).
+ * \param loop Event loop
+ * \param srcp Returned source, may be NULL
+ * \param ops Poll descriptor operations of the handle type
+ * \param handle The handle passed to \p ops
+ * \param events Poll events to wait for, 0 for all the handle asks
+ * \param callback Callback for events of the handle
+ * \param private_data Value for #snd_evloop_source_get_callback_private
+ * \return 0 on success otherwise a negative error code
+ */
+int snd_evloop_add_source(snd_evloop_t *loop, snd_evloop_source_t **srcp,
+			  const snd_evloop_ops_t *ops, void *handle, short events,
+			  snd_evloop_callback_t callback, void *private_data)
+{
+	snd_evloop_source_t *src;
+	int err;
+
+	assert(loop && ops && callback);
+	src = calloc(1, sizeof(*src));
+	if (!src)
+		return -ENOMEM;
+	src->loop = loop;
+	src->ops = ops;
+	src->handle = handle;
+	src->events = events;
+	src->callback = callback;
+	src->private_data = private_data;
+	err = evloop_query(src);
+	if (err >= 0)
+		err = evloop_register(src);
+	if (err < 0) {
+		evloop_free_source(src);
+		return err;
+	}
+	list_add_tail(&src->list, &loop->sources);
+	if (srcp)
+		*srcp = src;
+	return 0;
+}
+
+typedef struct {
+	unsigned int count;
+	struct pollfd pfds[0];
+} snd_evloop_fds_t;
+
+static int evloop_fds_count(void *handle)
+{
+	return ((snd_evloop_fds_t *)handle)->count;
+}
+
+static int evloop_fds_descriptors(void *handle, struct pollfd *pfds, unsigned int space)
+{
+	snd_evloop_fds_t *fds = handle;
+
+	if (space > fds->count)
+		space = fds->count;
+	memcpy(pfds, fds->pfds, sizeof(*pfds) * space);
+	return space;
+}
+
+static int evloop_fds_revents(void *handle ATTRIBUTE_UNUSED, struct pollfd *pfds,
+			      unsigned int nfds, unsigned short *revents)
+{
+	unsigned short res = 0;
+	unsigned int i;
+
+	for (i = 0; i < nfds; i++)
+		res |= pfds[i].revents;
+	*revents = res;
+	return 0;
+}
+
+static const snd_evloop_ops_t evloop_fds_ops = {
+	.count = evloop_fds_count,
+	.descriptors = evloop_fds_descriptors,
+	.revents = evloop_fds_revents,
+};
+
+/**
+ * \brief Registers plain poll descriptors with an event loop.
+ * \param loop Event loop
+ * \param srcp Returned source, may be NULL
+ * \param pfds Poll descriptors, copied
+ * \param count Count of poll descriptors
+ * \param callback Callback for events of the descriptors
+ * \param private_data Value for #snd_evloop_source_get_callback_private
+ * \return 0 on success otherwise a negative error code
+ *
+ * The callback gets the events of all descriptors or-ed together.
+ * Sockets, pipes and the like of the application can so be served by
+ * the same loop as the ALSA handles.
+ */
+int snd_evloop_add_fds(snd_evloop_t *loop, snd_evloop_source_t **srcp,
+		       const struct pollfd *pfds, unsigned int count,
+		       snd_evloop_callback_t callback, void *private_data)
+{
+	snd_evloop_source_t *src;
+	snd_evloop_fds_t *fds;
+	int err;
+
+	fds = malloc(sizeof(*fds) + sizeof(*pfds) * count);
+	if (!fds)
+		return -ENOMEM;
+	fds->count = count;
+	memcpy(fds->pfds, pfds, sizeof(*pfds) * count);
+	err = snd_evloop_add_source(loop, &src, &evloop_fds_ops, fds, 0,
+				    callback, private_data);
+	if (err < 0) {
+		free(fds);
+		return err;
+	}
+	if (srcp)
+		*srcp = src;
+	return 0;
+}
+
+typedef struct {
+	struct pollfd pfd;
+} snd_evloop_timer_t;
+
+static int evloop_timer_count(void *handle ATTRIBUTE_UNUSED)
+{
+	return 1;
+}
+
+static int evloop_timer_descriptors(void *handle, struct pollfd *pfds, unsigned int space)
+{
+	if (!space)
+		return 0;
+	*pfds = ((snd_evloop_timer_t *)handle)->pfd;
+	return 1;
+}
+
+/* consume the expirations, a level triggered timerfd stays readable */
+static int evloop_timer_revents(void *handle, struct pollfd *pfds,
+				unsigned int nfds, unsigned short *revents)
+{
+	snd_evloop_timer_t *timer = handle;
+	uint64_t expired;
+
+	*revents = 0;
+	if (!nfds || !(pfds->revents & POLLIN))
+		return 0;
+	if (read(timer->pfd.fd, &expired, sizeof(expired)) == sizeof(expired) &&
+	    expired)
+		*revents = POLLIN;
+	return 0;
+}
+
+static const snd_evloop_ops_t evloop_timer_ops = {
+	.count = evloop_timer_count,
+	.descriptors = evloop_timer_descriptors,
+	.revents = evloop_timer_revents,
+};
+
+static int evloop_timer_arm(int fd, unsigned int timeout, unsigned int interval)
+{
+	struct itimerspec its;
+
+	its.it_value.tv_sec = timeout / 1000;
+	its.it_value.tv_nsec = (timeout % 1000) * 1000000L;
+	its.it_interval.tv_sec = interval / 1000;
+	its.it_interval.tv_nsec = (interval % 1000) * 1000000L;
+	if (timerfd_settime(fd, 0, &its, NULL) < 0) {
+		SYSERR("timerfd_settime");
+		return -errno;
+	}
+	return 0;
+}
+
+/**
+ * \brief Registers a timer with an event loop.
+ * \param loop Event loop
+ * \param srcp Returned source, may be NULL
+ * \param timeout Milliseconds until the first expiration, 0 to add it stopped
+ * \param interval Milliseconds between the next expirations, 0 for once
+ * \param callback Callback for the expirations, with POLLIN
+ * \param private_data Value for #snd_evloop_source_get_callback_private
+ * \return 0 on success otherwise a negative error code
+ *
+ * The timer runs on CLOCK_MONOTONIC.  Expirations which passed while
+ * the loop did not dispatch give one callback.  A loop waiting for its
+ * handles with a timeout can so dispatch with -1 and count the timeout
+ * from an absolute point rather than from each wakeup.
+ *
+ * \sa snd_evloop_timer_set()
+ */
+int snd_evloop_add_timer(snd_evloop_t *loop, snd_evloop_source_t **srcp,
+			 unsigned int timeout, unsigned int interval,
+			 snd_evloop_callback_t callback, void *private_data)
+{
+	snd_evloop_source_t *src;
+	snd_evloop_timer_t *timer;
+	int err;
+
+	timer = malloc(sizeof(*timer));
+	if (!timer)
+		return -ENOMEM;
+	timer->pfd.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timer->pfd.fd < 0) {
+		err = -errno;
+		SYSERR("timerfd_create");
+		free(timer);
+		return err;
+	}
+	timer->pfd.events = POLLIN;
+	timer->pfd.revents = 0;
+	err = evloop_timer_arm(timer->pfd.fd, timeout, interval);
+	if (err >= 0)
+		err = snd_evloop_add_source(loop, &src, &evloop_timer_ops, timer, 0,
+					    callback, private_data);
+	if (err < 0) {
+		close(timer->pfd.fd);
+		free(timer);
+		return err;
+	}
+	if (srcp)
+		*srcp = src;
+	return 0;
+}
+
+/**
+ * \brief Starts a timer of an event loop again or stops it.
+ * \param src Source from #snd_evloop_add_timer
+ * \param timeout Milliseconds until the next expiration, 0 to stop it
+ * \param interval Milliseconds between the next expirations, 0 for once
+ * \return 0 on success otherwise a negative error code
+ *
+ * Pending expirations are dropped, so after this call from its
+ * callback, the timer fires only for the new setting.
+ */
+int snd_evloop_timer_set(snd_evloop_source_t *src, unsigned int timeout,
+			 unsigned int interval)
+{
+	snd_evloop_timer_t *timer;
+
+	assert(src && !src->removed);
+	if (src->ops != &evloop_timer_ops)
+		return -EINVAL;
+	timer = src->handle;
+	return evloop_timer_arm(timer->pfd.fd, timeout, interval);
+}
+
+/**
+ * \brief Removes a source from its event loop.
+ * \param src Source
+ * \return 0 on success otherwise a negative error code
+ *
+ * The source must be removed before its handle is closed.  It may be
+ * removed from a callback, also from its own; its callback is not
+ * called anymore once this returns.
+ */
+int snd_evloop_remove(snd_evloop_source_t *src)
+{
+	snd_evloop_t *loop;
+
+	assert(src);
+	loop = src->loop;
+	evloop_unregister(src);
+	list_del(&src->list);
+	if (src->ops == &evloop_timer_ops)
+		close(((snd_evloop_timer_t *)src->handle)->pfd.fd);
+	if (src->ops == &evloop_fds_ops || src->ops == &evloop_timer_ops)
+		free(src->handle);
+	src->handle = NULL;
+	src->removed = 1;
+	if (loop->dispatching)
+		list_add_tail(&src->list, &loop->zombies);
+	else
+		evloop_free_source(src);
+	return 0;
+}
+
+/**
+ * \brief Reads the poll descriptors of a source again.
+ * \param src Source
+ * \return 0 on success otherwise a negative error code
+ *
+ * The poll descriptors of a handle are read once when it is added.
+ * Some handles change them, a PCM for example when it is set up or
+ * a mixer when an hctl is attached; call this after such a change.
+ */
+int snd_evloop_source_refresh(snd_evloop_source_t *src)
+{
+	int err;
+
+	assert(src && !src->removed);
+	evloop_unregister(src);
+	err = evloop_query(src);
+	if (err >= 0)
+		err = evloop_register(src);
+	if (err < 0)
+		src->count = 0;
+	return err;
+}
+
+/**
+ * \brief Returns the handle of a source.
+ * \param src Source
+ * \return The handle it was added with
+ */
+void *snd_evloop_source_get_handle(snd_evloop_source_t *src)
+{
+	assert(src);
+	if (src->ops == &evloop_fds_ops || src->ops == &evloop_timer_ops)
+		return NULL;
+	return src->handle;
+}
+
+/**
+ * \brief Returns the private data of the callback of a source.
+ * \param src Source
+ * \return The private data it was added with
+ */
+void *snd_evloop_source_get_callback_private(snd_evloop_source_t *src)
+{
+	assert(src);
+	return src->private_data;
+}
+
+/**
+ * \brief Returns the epoll descriptor of an event loop.
+ * \param loop Event loop
+ * \return The descriptor
+ *
+ * The descriptor is readable while a source has events, so the loop
+ * can be nested in another loop.  Sources whose descriptors epoll
+ * does not take are not reflected; #snd_evloop_dispatch with a zero
+ * timeout serves them.
+ */
+int snd_evloop_get_fd(snd_evloop_t *loop)
+{
+	assert(loop);
+	return loop->epoll_fd;
+}
+
+static void evloop_mark(snd_evloop_t *loop, snd_evloop_source_t *src,
+			snd_evloop_source_t **ready)
+{
+	unsigned int i;
+
+	if (src->stamp == loop->stamp)
+		return;
+	src->stamp = loop->stamp;
+	for (i = 0; i < src->count; i++)
+		src->pfds[i].revents = 0;
+	src->ready = *ready;
+	*ready = src;
+}
+
+/**
+ * \brief Waits for events and calls the callbacks of the sources.
+ * \param loop Event loop
+ * \param timeout Maximum time to wait in milliseconds, -1 for ever
+ * \return The count of called callbacks otherwise a negative error code
+ *
+ * The events of a handle are translated with its
+ * poll_descriptors_revents function before its callback is called.
+ * The work per call is proportional to the sources with events, not
+ * to all registered sources.
+ */
+int snd_evloop_dispatch(snd_evloop_t *loop, int timeout)
+{
+	snd_evloop_source_t *ready = NULL, *src;
+	struct list_head *pos;
+	unsigned short revents;
+	int i, n, called = 0;
+
+	assert(loop && !loop->dispatching);
+	if (!list_empty(&loop->always))
+		timeout = 0;
+	n = epoll_wait(loop->epoll_fd, loop->events, EVLOOP_EVENTS, timeout);
+	if (n < 0) {
+		if (errno == EINTR)
+			return 0;
+		SYSERR("epoll_wait");
+		return -errno;
+	}
+	loop->stamp++;
+	for (i = 0; i < n; i++) {
+		snd_evloop_slot_t *slot = loop->events[i].data.ptr;
+
+		src = slot->src;
+		evloop_mark(loop, src, &ready);
+		/* EPOLLERR and EPOLLHUP have the values of poll() too */
+		src->pfds[slot - src->slots].revents = loop->events[i].events;
+	}
+	list_for_each(pos, &loop->always) {
+		unsigned int j;
+
+		src = list_entry(pos, snd_evloop_source_t, alist);
+		evloop_mark(loop, src, &ready);
+		for (j = 0; j < src->count; j++)
+			if (src->slots[j].always)
+				src->pfds[j].revents = src->pfds[j].events &
+					(POLLIN | POLLOUT | POLLPRI);
+	}
+	loop->dispatching = 1;
+	for (src = ready; src; src = src->ready) {
+		if (src->removed)
+			continue;
+		if (src->ops->revents(src->handle, src->pfds, src->count, &revents) < 0)
+			revents = POLLERR;
+		if (!revents)
+			continue;
+		src->callback(src, revents);
+		called++;
+	}
+	loop->dispatching = 0;
+	while (!list_empty(&loop->zombies)) {
+		src = list_entry(loop->zombies.next, snd_evloop_source_t, list);
+		list_del(&src->list);
+		evloop_free_source(src);
+	}
+	return called;
+}
+
+/**
+ * \brief Frees an event loop.
+ * \param loop Event loop
+ * \return 0 on success otherwise a negative error code
+ *
+ * The sources still registered are removed; their handles are not
+ * closed.
+ */
+int snd_evloop_close(snd_evloop_t *loop)
+{
+	assert(loop && !loop->dispatching);
+	while (!list_empty(&loop->sources))
+		snd_evloop_remove(list_entry(loop->sources.next,
+					     snd_evloop_source_t, list));
+	close(loop->epoll_fd);
+	free(loop);
+	return 0;
+}
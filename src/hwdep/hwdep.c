@@ -33,7 +33,10 @@
 #include <unistd.h>
 #include <string.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "hwdep_local.h"
 
 static int snd_hwdep_open_conf(snd_hwdep_t **hwdep,
@@ -323,6 +326,49 @@ int snd_hwdep_nonblock(snd_hwdep_t *hwdep, int nonblock)
 	return 0;
 }
 
+static int snd_hwdep_evloop_count(void *handle)
+{
+	return snd_hwdep_poll_descriptors_count(handle);
+}
+
+static int snd_hwdep_evloop_descriptors(void *handle, struct pollfd *pfds, unsigned int space)
+{
+	return snd_hwdep_poll_descriptors(handle, pfds, space);
+}
+
+static int snd_hwdep_evloop_revents(void *handle, struct pollfd *pfds, unsigned int nfds,
+		unsigned short *revents)
+{
+	return snd_hwdep_poll_descriptors_revents(handle, pfds, nfds, revents);
+}
+
+static const snd_evloop_ops_t snd_hwdep_evloop_ops = {
+	.count = snd_hwdep_evloop_count,
+	.descriptors = snd_hwdep_evloop_descriptors,
+	.revents = snd_hwdep_evloop_revents,
+};
+
+/**
+ * \brief Registers a hwdep handle with an event loop
+ * \param loop Event loop
+ * \param srcp Returned source, may be NULL
+ * \param hwdep HwDep handle
+ * \param callback Callback for the events of the handle
+ * \param private_data Value for #snd_evloop_source_get_callback_private
+ * \return 0 on success otherwise a negative error code
+ *
+ * The callback gets the events translated by
+ * #snd_hwdep_poll_descriptors_revents.  The poll descriptors are read
+ * once; see #snd_evloop_source_refresh.
+ */
+int snd_hwdep_evloop_add(snd_evloop_t *loop, snd_evloop_source_t **srcp, snd_hwdep_t *hwdep,
+		snd_evloop_callback_t callback, void *private_data)
+{
+	assert(hwdep);
+	return snd_evloop_add_source(loop, srcp, &snd_hwdep_evloop_ops, hwdep, 0,
+				     callback, private_data);
+}
+
 /**
  * \brief get size of the snd_hwdep_info_t structure in bytes
  * \return size of the snd_hwdep_info_t structure in bytes
@@ -519,6 +565,131 @@ int snd_hwdep_dsp_load(snd_hwdep_t *hwdep, snd_hwdep_dsp_image_t *block)
 	return hwdep->ops->ioctl(hwdep, SNDRV_HWDEP_IOCTL_DSP_LOAD, (void*)block);
 }
 
+#ifndef DOC_HIDDEN
+/* a chunk read with read() when the file cannot be mapped */
+static int dsp_read_chunk(int fd, off_t offset, void *buf, size_t size)
+{
+	ssize_t n;
+
+	while (size > 0) {
+		n = pread(fd, buf, size, offset);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (n == 0)
+			return -EIO;	/* the file is shorter than told */
+		buf = (char *)buf + n;
+		offset += n;
+		size -= n;
+	}
+	return 0;
+}
+#endif
+
+/**
+ * \brief load the DSP blocks from a file
+ * \param hwdep HwDep handle
+ * \param block the index, name and length of the image; the image pointer is ignored
+ * \param fd the file holding the image
+ * \param offset the position of the image in the file
+ * \param chunk_size the size of the blocks, 0 to load the image as one block
+ * \param progress function called after each block, or NULL
+ * \param private_data the last argument of \a progress
+ * \return 0 on success otherwise a negative error code
+ *
+ * The image is passed to the driver straight from the page cache: the
+ * file is mapped block by block and the next block is read ahead while
+ * the driver takes the current one, so no copy of the image is made.
+ * A length of 0 stands for the rest of the file.  With \a chunk_size,
+ * the image is split into blocks of that size with successive indexes
+ * starting at the index of \a block, for the drivers taking the firmware
+ * in indexed pieces; \a block is left with the index and length of the
+ * last block loaded.  When \a progress returns a negative value, the
+ * load stops with that value.  Files which cannot be mapped, e.g. pipes,
+ * are read into a buffer of one block.
+ */
+int snd_hwdep_dsp_load_fd(snd_hwdep_t *hwdep, snd_hwdep_dsp_image_t *block,
+			  int fd, off_t offset, size_t chunk_size,
+			  int (*progress)(snd_hwdep_t *hwdep, size_t done, size_t total,
+					  void *private_data),
+			  void *private_data)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	unsigned int index;
+	size_t total, done = 0, size, shift;
+	void *map, *buf = NULL;
+	struct stat st;
+	off_t start;
+	int err = 0;
+
+	assert(hwdep && block);
+	if (fd < 0 || offset < 0)
+		return -EINVAL;
+	if (fstat(fd, &st) < 0)
+		return -errno;
+	index = block->index;
+	total = block->length;
+	if (!total) {
+		if (!S_ISREG(st.st_mode) || st.st_size <= offset)
+			return -EINVAL;
+		total = st.st_size - offset;
+	} else if (S_ISREG(st.st_mode) &&
+		   (st.st_size < offset || (size_t)(st.st_size - offset) < total)) {
+		return -EINVAL;		/* a map past the end would fault */
+	}
+	if (!chunk_size || chunk_size > total)
+		chunk_size = total;
+	if (S_ISREG(st.st_mode))
+		posix_fadvise(fd, offset, total, POSIX_FADV_SEQUENTIAL);
+	while (done < total) {
+		size = total - done < chunk_size ? total - done : chunk_size;
+		start = offset + done;
+		shift = start % page;
+		map = MAP_FAILED;
+		if (!buf && S_ISREG(st.st_mode))
+			map = mmap(NULL, size + shift, PROT_READ, MAP_SHARED,
+				   fd, start - shift);
+		if (map != MAP_FAILED) {
+			block->image = (unsigned char *)map + shift;
+		} else {
+			if (!buf) {
+				buf = malloc(chunk_size);
+				if (!buf)
+					return -ENOMEM;
+			}
+			err = dsp_read_chunk(fd, start, buf, size);
+			if (err < 0)
+				break;
+			block->image = buf;
+		}
+		/* let the next block come in while the driver is busy */
+		if (map != MAP_FAILED && done + size < total)
+			posix_fadvise(fd, start + size,
+				      total - done - size < chunk_size ?
+				      total - done - size : chunk_size,
+				      POSIX_FADV_WILLNEED);
+		block->index = index++;
+		block->length = size;
+		err = snd_hwdep_dsp_load(hwdep, block);
+		if (map != MAP_FAILED)
+			munmap(map, size + shift);
+		if (err < 0)
+			break;
+		done += size;
+		if (progress) {
+			err = progress(hwdep, done, total, private_data);
+			if (err < 0)
+				break;
+			err = 0;
+		}
+	}
+	block->image = NULL;
+	free(buf);
+	return err;
+}
+
 /**
  * \brief get size of the snd_hwdep_dsp_status_t structure in bytes
  * \return size of the snd_hwdep_dsp_status_t structure in bytes
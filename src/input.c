@@ -31,6 +31,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #include "local.h"
 
 #ifndef DOC_HIDDEN
@@ -41,6 +42,7 @@ typedef struct _snd_input_ops {
 	char *(*(gets))(snd_input_t *input, char *str, size_t size);
 	int (*getch)(snd_input_t *input);
 	int (*ungetch)(snd_input_t *input, int c);
+	int (*span)(snd_input_t *input, const char **data, size_t *size);
 } snd_input_ops_t;
 
 struct _snd_input {
@@ -117,10 +119,25 @@ int snd_input_ungetc(snd_input_t *input, int c)
 	return input->ops->ungetch(input, c);
 }
 
+#ifndef DOC_HIDDEN
+/*
+ * Consume the rest of the input and return it as one block, which stays
+ * valid until the input is closed.  The config parser works on it in
+ * place instead of reading it character by character.
+ */
+int snd_input_span(snd_input_t *input, const char **data, size_t *size)
+{
+	if (!input->ops->span)
+		return -ENXIO;
+	return input->ops->span(input, data, size);
+}
+#endif
+
 #ifndef DOC_HIDDEN
 typedef struct _snd_input_stdio {
 	int close;
 	FILE *fp;
+	char *span;		/* the rest of the file read by span */
 } snd_input_stdio_t;
 
 static int snd_input_stdio_close(snd_input_t *input ATTRIBUTE_UNUSED)
@@ -128,6 +145,7 @@ static int snd_input_stdio_close(snd_input_t *input ATTRIBUTE_UNUSED)
 	snd_input_stdio_t *stdio = input->private_data;
 	if (stdio->close)
 		fclose(stdio->fp);
+	free(stdio->span);
 	free(stdio);
 	return 0;
 }
@@ -157,12 +175,53 @@ static int snd_input_stdio_ungetc(snd_input_t *input, int c)
 	return ungetc(c, stdio->fp);
 }
 
+static int snd_input_stdio_span(snd_input_t *input, const char **data, size_t *size)
+{
+	snd_input_stdio_t *stdio = input->private_data;
+	struct stat st;
+	size_t alloc = 4096, len = 0, n;
+	char *buf, *ptr;
+	long pos;
+
+	if (fstat(fileno(stdio->fp), &st) == 0 && S_ISREG(st.st_mode)) {
+		pos = ftell(stdio->fp);
+		if (pos >= 0 && pos < st.st_size)
+			alloc = st.st_size - pos + 1;
+	}
+	buf = malloc(alloc);
+	if (!buf)
+		return -ENOMEM;
+	/* read until the end, the file may still grow */
+	while ((n = fread(buf + len, 1, alloc - len, stdio->fp)) > 0) {
+		len += n;
+		if (len < alloc)
+			continue;
+		ptr = realloc(buf, alloc * 2);
+		if (!ptr) {
+			free(buf);
+			return -ENOMEM;
+		}
+		buf = ptr;
+		alloc *= 2;
+	}
+	if (ferror(stdio->fp)) {
+		free(buf);
+		return -EIO;
+	}
+	free(stdio->span);
+	stdio->span = buf;
+	*data = buf;
+	*size = len;
+	return 0;
+}
+
 static const snd_input_ops_t snd_input_stdio_ops = {
 	.close		= snd_input_stdio_close,
 	.scan		= snd_input_stdio_scan,
 	.gets		= snd_input_stdio_gets,
 	.getch		= snd_input_stdio_getc,
 	.ungetch	= snd_input_stdio_ungetc,
+	.span		= snd_input_stdio_span,
 };
 #endif
 
@@ -283,12 +342,23 @@ static int snd_input_buffer_ungetc(snd_input_t *input, int c)
 	return c;
 }
 
+static int snd_input_buffer_span(snd_input_t *input, const char **data, size_t *size)
+{
+	snd_input_buffer_t *buffer = input->private_data;
+	*data = (const char *)buffer->ptr;
+	*size = buffer->size;
+	buffer->ptr += buffer->size;
+	buffer->size = 0;
+	return 0;
+}
+
 static const snd_input_ops_t snd_input_buffer_ops = {
 	.close		= snd_input_buffer_close,
 	.scan		= snd_input_buffer_scan,
 	.gets		= snd_input_buffer_gets,
 	.getch		= snd_input_buffer_getc,
 	.ungetch	= snd_input_buffer_ungetc,
+	.span		= snd_input_buffer_span,
 };
 #endif
 
@@ -26,40 +26,65 @@ int bag_new(bag_t **bag)
 	bag_t *b = malloc(sizeof(*b));
 	if (!b)
 		return -ENOMEM;
-	INIT_LIST_HEAD(b);
+	bag_init(b);
 	*bag = b;
 	return 0;
 }
 
 void bag_free(bag_t *bag)
 {
-	assert(list_empty(bag));
+	assert(bag->count == 0);
+	bag_fini(bag);
 	free(bag);
 }
 
+void bag_init(bag_t *bag)
+{
+	bag->count = 0;
+	bag->alloc = 0;
+	bag->heap = NULL;
+}
+
+void bag_fini(bag_t *bag)
+{
+	free(bag->heap);
+	bag_init(bag);
+}
+
 int bag_empty(bag_t *bag)
 {
-	return list_empty(bag);
+	return bag->count == 0;
 }
 
 int bag_add(bag_t *bag, void *ptr)
 {
-	bag1_t *b = malloc(sizeof(*b));
-	if (!b)
-		return -ENOMEM;
-	b->ptr = ptr;
-	list_add_tail(&b->list, bag);
+	if (bag->count == (bag->heap ? bag->alloc : BAG_INLINE)) {
+		unsigned int alloc = bag->count * 2;
+		void **p;
+		if (bag->heap) {
+			p = realloc(bag->heap, alloc * sizeof(*p));
+		} else {
+			p = malloc(alloc * sizeof(*p));
+			if (p)
+				memcpy(p, bag->items, bag->count * sizeof(*p));
+		}
+		if (!p)
+			return -ENOMEM;
+		bag->heap = p;
+		bag->alloc = alloc;
+	}
+	bag_ptrs(bag)[bag->count++] = ptr;
 	return 0;
 }
 
 int bag_del(bag_t *bag, void *ptr)
 {
-	struct list_head *pos;
-	list_for_each(pos, bag) {
-		bag1_t *b = list_entry(pos, bag1_t, list);
-		if (b->ptr == ptr) {
-			list_del(&b->list);
-			free(b);
+	void **p = bag_ptrs(bag);
+	unsigned int idx;
+	for (idx = 0; idx < bag->count; idx++) {
+		if (p[idx] == ptr) {
+			memmove(p + idx, p + idx + 1,
+				(--bag->count - idx) * sizeof(*p));
 			return 0;
 		}
 	}
@@ -68,6 +93,5 @@ int bag_del(bag_t *bag, void *ptr)
 
 void bag_del_all(bag_t *bag)
 {
-	while (!list_empty(bag))
-		list_del(bag->next);
+	bag->count = 0;
 }
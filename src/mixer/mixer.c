@@ -46,11 +46,13 @@ This is an abstraction layer over the hcontrol layer.
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include "mixer_local.h"
+#include "mixer_simple.h"
 
 #ifndef DOC_HIDDEN
 typedef struct _snd_mixer_slave {
 	snd_hctl_t *hctl;
 	struct list_head list;
+	int ready;		/* poll reported activity on its descriptors */
 } snd_mixer_slave_t;
 
 #endif
@@ -138,8 +140,8 @@ static int hctl_elem_event_handler(snd_hctl_elem_t *helem,
 	if (mask == SND_CTL_EVENT_MASK_REMOVE) {
 		int res = 0;
 		int err;
-		bag_iterator_t i, n;
-		bag_for_each_safe(i, n, bag) {
+		bag_iterator_t i;
+		bag_for_each_safe(i, bag) {
 			snd_mixer_elem_t *melem = bag_iterator_entry(i);
 			snd_mixer_class_t *class = melem->class;
 			err = class->event(class, mask, helem, melem);
@@ -152,8 +154,8 @@ static int hctl_elem_event_handler(snd_hctl_elem_t *helem,
 	}
 	if (mask & (SND_CTL_EVENT_MASK_VALUE | SND_CTL_EVENT_MASK_INFO)) {
 		int err = 0;
-		bag_iterator_t i, n;
-		bag_for_each_safe(i, n, bag) {
+		bag_iterator_t i;
+		bag_for_each_safe(i, bag) {
 			snd_mixer_elem_t *melem = bag_iterator_entry(i);
 			snd_mixer_class_t *class = melem->class;
 			err = class->event(class, mask, helem, melem);
@@ -238,6 +240,7 @@ int snd_mixer_attach_hctl(snd_mixer_t *mixer, snd_hctl_t *hctl)
 	snd_hctl_set_callback_private(hctl, mixer);
 	slave->hctl = hctl;
 	list_add_tail(&slave->list, &mixer->slaves);
+	mixer->slaves_marked = 0;
 	return 0;
 }
 
@@ -316,11 +319,26 @@ static int snd_mixer_throw_event(snd_mixer_t *mixer, unsigned int mask,
 	return 0;
 }
 
+static void snd_mixer_bulk_sort(snd_mixer_t *mixer);
+static int snd_mixer_bulk_flush(snd_mixer_t *mixer);
+static void snd_mixer_bulk_begin(snd_mixer_t *mixer);
+static int snd_mixer_bulk_end(snd_mixer_t *mixer);
+
 static int snd_mixer_elem_throw_event(snd_mixer_elem_t *elem, unsigned int mask)
 {
-	elem->class->mixer->events++;
-	if (elem->callback)
+	snd_mixer_t *mixer = elem->class->mixer;
+	int err;
+
+	mixer->events++;
+	if (elem->callback) {
+		/* the application sees the batch complete before anything else */
+		if (mixer->added_count) {
+			err = snd_mixer_bulk_flush(mixer);
+			if (err < 0)
+				return err;
+		}
 		return elem->callback(elem, mask);
+	}
 	return 0;
 }
 
@@ -383,11 +401,103 @@ int snd_mixer_elem_new(snd_mixer_elem_t **elem,
 	melem->compare_weight = compare_weight;
 	melem->private_data = private_data;
 	melem->private_free = private_free;
-	INIT_LIST_HEAD(&melem->helems);
+	bag_init(&melem->helems);
 	*elem = melem;
 	return 0;
 }
 
+#ifndef DOC_HIDDEN
+#define SELEM_HASH_MIN	64
+#endif
+
+static unsigned int selem_id_hash(const snd_mixer_selem_id_t *id)
+{
+	const unsigned char *name = (const unsigned char *)id->name;
+	unsigned int hash = 2166136261U;
+
+	hash = (hash ^ id->index) * 16777619U;
+	while (*name && name < (const unsigned char *)id->name + sizeof(id->name))
+		hash = (hash ^ *name++) * 16777619U;
+	return hash;
+}
+
+static void mixer_selem_hash_add(snd_mixer_t *mixer, snd_mixer_elem_t *elem)
+{
+	snd_mixer_elem_t **slot;
+
+	if (!mixer->selem_hash_mask)
+		return;
+	slot = &mixer->selem_hash[selem_id_hash(sm_selem(elem)->id) &
+				  mixer->selem_hash_mask];
+	elem->selem_next = *slot;
+	*slot = elem;
+}
+
+static void mixer_selem_hash_del(snd_mixer_t *mixer, snd_mixer_elem_t *elem)
+{
+	snd_mixer_elem_t **slot;
+
+	if (!mixer->selem_hash_mask)
+		return;
+	slot = &mixer->selem_hash[selem_id_hash(sm_selem(elem)->id) &
+				  mixer->selem_hash_mask];
+	while (*slot != elem)
+		slot = &(*slot)->selem_next;
+	*slot = elem->selem_next;
+}
+
+static void mixer_selem_hash_free(snd_mixer_t *mixer)
+{
+	free(mixer->selem_hash);
+	mixer->selem_hash = NULL;
+	mixer->selem_hash_mask = 0;
+}
+
+/* size the hash for count simple elements; without memory, lookups scan */
+static void mixer_selem_hash_resize(snd_mixer_t *mixer, unsigned int count)
+{
+	snd_mixer_elem_t **hash;
+	unsigned int size = SELEM_HASH_MIN, k;
+
+	while (size < count)
+		size <<= 1;
+	if (size - 1 <= mixer->selem_hash_mask)
+		return;
+	hash = calloc(size, sizeof(*hash));
+	mixer_selem_hash_free(mixer);
+	if (!hash)
+		return;
+	mixer->selem_hash = hash;
+	mixer->selem_hash_mask = size - 1;
+	for (k = 0; k < mixer->count; k++)
+		if (mixer->pelems[k]->type == SND_MIXER_ELEM_SIMPLE)
+			mixer_selem_hash_add(mixer, mixer->pelems[k]);
+}
+
+/*
+ * Find a simple element by name and index in the hash.  hit is cleared
+ * when there is no hash and the caller has to scan the elements.
+ */
+snd_mixer_elem_t *snd_mixer_selem_hash_find(snd_mixer_t *mixer,
+					    const snd_mixer_selem_id_t *id,
+					    int *hit)
+{
+	snd_mixer_elem_t *elem;
+	sm_selem_t *s;
+
+	*hit = 0;
+	if (!mixer->selem_hash_mask)
+		return NULL;
+	*hit = 1;
+	elem = mixer->selem_hash[selem_id_hash(id) & mixer->selem_hash_mask];
+	for (; elem; elem = elem->selem_next) {
+		s = elem->private_data;
+		if (s->id->index == id->index && !strcmp(s->id->name, id->name))
+			return elem;
+	}
+	return NULL;
+}
+
 /**
  * \brief Add an element for a registered mixer element class
  * \param elem Mixer element
@@ -412,6 +522,29 @@ int snd_mixer_elem_add(snd_mixer_elem_t *elem, snd_mixer_class_t *class)
 		}
 		mixer->pelems = m;
 	}
+	if (mixer->bulk) {
+		/* appended now, put in order and announced when the batch ends */
+		if (mixer->added_count == mixer->added_alloc) {
+			snd_mixer_elem_t **m;
+			unsigned int alloc = mixer->added_alloc + 32;
+			m = realloc(mixer->added, sizeof(*m) * alloc);
+			if (!m)
+				return -ENOMEM;
+			mixer->added = m;
+			mixer->added_alloc = alloc;
+		}
+		mixer->added[mixer->added_count++] = elem;
+		list_add_tail(&elem->list, &mixer->elems);
+		mixer->pelems[mixer->count++] = elem;
+		if (elem->type == SND_MIXER_ELEM_SIMPLE) {
+			mixer->selem_count++;
+			if (mixer->selem_count > mixer->selem_hash_mask + 1)
+				mixer_selem_hash_resize(mixer, mixer->selem_count);
+			else
+				mixer_selem_hash_add(mixer, elem);
+		}
+		return 0;
+	}
 	if (mixer->count == 0) {
 		list_add_tail(&elem->list, &mixer->elems);
 		mixer->pelems[0] = elem;
@@ -430,6 +563,15 @@ int snd_mixer_elem_add(snd_mixer_elem_t *elem, snd_mixer_class_t *class)
 		mixer->pelems[idx] = elem;
 	}
 	mixer->count++;
+	mixer->sorted = mixer->count;
+	if (elem->type == SND_MIXER_ELEM_SIMPLE) {
+		mixer->selem_count++;
+		/* a resize hashes elem with the others */
+		if (mixer->selem_count > mixer->selem_hash_mask + 1)
+			mixer_selem_hash_resize(mixer, mixer->selem_count);
+		else
+			mixer_selem_hash_add(mixer, elem);
+	}
 	return snd_mixer_throw_event(mixer, SND_CTL_EVENT_MASK_ADD, elem);
 }
 
@@ -443,19 +585,32 @@ int snd_mixer_elem_add(snd_mixer_elem_t *elem, snd_mixer_class_t *class)
 int snd_mixer_elem_remove(snd_mixer_elem_t *elem)
 {
 	snd_mixer_t *mixer = elem->class->mixer;
-	bag_iterator_t i, n;
+	bag_iterator_t i;
 	int err, idx, dir;
 	unsigned int m;
 	assert(elem);
 	assert(mixer->count);
+	if (mixer->sorted < mixer->count)
+		snd_mixer_bulk_sort(mixer);
+	for (m = 0; m < mixer->added_count; m++) {
+		if (mixer->added[m] == elem) {
+			memmove(mixer->added + m, mixer->added + m + 1,
+				(--mixer->added_count - m) * sizeof(*mixer->added));
+			break;
+		}
+	}
 	idx = _snd_mixer_find_elem(mixer, elem, &dir);
 	if (dir != 0)
 		return -EINVAL;
-	bag_for_each_safe(i, n, &elem->helems) {
+	bag_for_each_safe(i, &elem->helems) {
 		snd_hctl_elem_t *helem = bag_iterator_entry(i);
 		snd_mixer_elem_detach(elem, helem);
 	}
 	err = snd_mixer_elem_throw_event(elem, SND_CTL_EVENT_MASK_REMOVE);
+	if (elem->type == SND_MIXER_ELEM_SIMPLE) {
+		mixer_selem_hash_del(mixer, elem);
+		mixer->selem_count--;
+	}
 	list_del(&elem->list);
 	snd_mixer_elem_free(elem);
 	mixer->count--;
@@ -464,6 +619,7 @@ int snd_mixer_elem_remove(snd_mixer_elem_t *elem)
 		memmove(mixer->pelems + idx,
 			mixer->pelems + idx + 1,
 			m * sizeof(snd_mixer_elem_t *));
+	mixer->sorted = mixer->count;
 	return err;
 }
 
@@ -478,6 +634,7 @@ void snd_mixer_elem_free(snd_mixer_elem_t *elem)
 {
 	if (elem->private_free)
 		elem->private_free(elem);
+	bag_fini(&elem->helems);
 	free(elem);
 }
 
@@ -568,15 +725,20 @@ int snd_mixer_class_unregister(snd_mixer_class_t *class)
 int snd_mixer_load(snd_mixer_t *mixer)
 {
 	struct list_head *pos;
+	int err = 0, err2;
+
+	snd_mixer_bulk_begin(mixer);
 	list_for_each(pos, &mixer->slaves) {
-		int err;
 		snd_mixer_slave_t *s;
 		s = list_entry(pos, snd_mixer_slave_t, list);
 		err = snd_hctl_load(s->hctl);
 		if (err < 0)
-			return err;
+			break;
 	}
-	return 0;
+	err2 = snd_mixer_bulk_end(mixer);
+	if (err < 0)
+		return err;
+	return err2 < 0 ? err2 : 0;
 }
 
 /**
@@ -611,6 +773,9 @@ int snd_mixer_close(snd_mixer_t *mixer)
 	assert(mixer->count == 0);
 	free(mixer->pelems);
 	mixer->pelems = NULL;
+	free(mixer->added);
+	mixer->added = NULL;
+	mixer_selem_hash_free(mixer);
 	while (!list_empty(&mixer->slaves)) {
 		int err;
 		snd_mixer_slave_t *s;
@@ -654,9 +819,76 @@ static int snd_mixer_sort(snd_mixer_t *mixer)
 	qsort(mixer->pelems, mixer->count, sizeof(snd_mixer_elem_t *), mixer_compare);
 	for (k = 0; k < mixer->count; k++)
 		list_add_tail(&mixer->pelems[k]->list, &mixer->elems);
+	mixer->sorted = mixer->count;
 	return 0;
 }
 
+/*
+ * Put the elements appended during a batch in order: sort them alone
+ * and merge them with the elements already in order.
+ */
+static void snd_mixer_bulk_sort(snd_mixer_t *mixer)
+{
+	snd_mixer_elem_t **merged, **a, **b, **a_end, **b_end;
+	unsigned int k;
+
+	if (mixer->sorted >= mixer->count)
+		return;
+	merged = malloc(mixer->count * sizeof(*merged));
+	if (!merged) {
+		snd_mixer_sort(mixer);
+		return;
+	}
+	qsort(mixer->pelems + mixer->sorted, mixer->count - mixer->sorted,
+	      sizeof(*mixer->pelems), mixer_compare);
+	a = mixer->pelems;
+	a_end = b = mixer->pelems + mixer->sorted;
+	b_end = mixer->pelems + mixer->count;
+	for (k = 0; a < a_end || b < b_end; k++) {
+		if (b == b_end || (a < a_end && mixer->compare(*a, *b) < 0))
+			merged[k] = *a++;
+		else
+			merged[k] = *b++;
+	}
+	memcpy(mixer->pelems, merged, mixer->count * sizeof(*merged));
+	free(merged);
+	INIT_LIST_HEAD(&mixer->elems);
+	for (k = 0; k < mixer->count; k++)
+		list_add_tail(&mixer->pelems[k]->list, &mixer->elems);
+	mixer->sorted = mixer->count;
+}
+
+/* end of a batch: order the new elements, then throw their ADD events */
+static int snd_mixer_bulk_flush(snd_mixer_t *mixer)
+{
+	snd_mixer_elem_t *elem;
+	int err, res = 0;
+
+	snd_mixer_bulk_sort(mixer);
+	while (mixer->added_count) {
+		/* callbacks may add or remove elements, take them one by one */
+		elem = mixer->added[0];
+		memmove(mixer->added, mixer->added + 1,
+			--mixer->added_count * sizeof(*mixer->added));
+		err = snd_mixer_throw_event(mixer, SND_CTL_EVENT_MASK_ADD, elem);
+		if (err < 0 && res >= 0)
+			res = err;
+	}
+	return res;
+}
+
+static void snd_mixer_bulk_begin(snd_mixer_t *mixer)
+{
+	mixer->bulk++;
+}
+
+static int snd_mixer_bulk_end(snd_mixer_t *mixer)
+{
+	if (--mixer->bulk > 0)
+		return 0;
+	return snd_mixer_bulk_flush(mixer);
+}
+
 /**
  * \brief Change mixer compare function and reorder elements
  * \param mixer Mixer handle
@@ -729,6 +961,37 @@ int snd_mixer_poll_descriptors(snd_mixer_t *mixer, struct pollfd *pfds, unsigned
 	return count;
 }
 
+/*
+ * Note which slaves have activity on their descriptors, so that the next
+ * snd_mixer_handle_events() reads only those.  Nothing is noted unless
+ * pfds are exactly the descriptors of snd_mixer_poll_descriptors().
+ */
+static void snd_mixer_mark_ready(snd_mixer_t *mixer, struct pollfd *pfds,
+				 unsigned int nfds)
+{
+	struct list_head *pos;
+	struct pollfd spfds[4];
+	unsigned int idx = 0, k;
+	int n;
+
+	mixer->slaves_marked = 0;
+	list_for_each(pos, &mixer->slaves) {
+		snd_mixer_slave_t *s;
+		s = list_entry(pos, snd_mixer_slave_t, list);
+		n = snd_hctl_poll_descriptors(s->hctl, spfds, 4);
+		if (n < 0 || n > 4 || idx + n > nfds)
+			return;
+		s->ready = 0;
+		for (k = 0; k < (unsigned int)n; k++, idx++) {
+			if (pfds[idx].fd != spfds[k].fd)
+				return;
+			if (pfds[idx].revents)
+				s->ready = 1;
+		}
+	}
+	mixer->slaves_marked = idx == nfds;
+}
+
 /**
  * \brief get returned events from poll descriptors
  * \param mixer Mixer handle
@@ -736,6 +999,9 @@ int snd_mixer_poll_descriptors(snd_mixer_t *mixer, struct pollfd *pfds, unsigned
  * \param nfds count of poll descriptors
  * \param revents returned events
  * \return zero if success, otherwise a negative error code
+ *
+ * The following snd_mixer_handle_events() call reads only the attached
+ * control handles with activity on their descriptors.
  */
 int snd_mixer_poll_descriptors_revents(snd_mixer_t *mixer, struct pollfd *pfds, unsigned int nfds, unsigned short *revents)
 {
@@ -745,17 +1011,65 @@ int snd_mixer_poll_descriptors_revents(snd_mixer_t *mixer, struct pollfd *pfds,
 	if (nfds == 0)
 		return -EINVAL;
 	res = 0;
-	for (idx = 0; idx < nfds; idx++, pfds++)
-		res |= pfds->revents & (POLLIN|POLLERR|POLLNVAL);
+	for (idx = 0; idx < nfds; idx++)
+		res |= pfds[idx].revents & (POLLIN|POLLERR|POLLNVAL);
 	*revents = res;
+	snd_mixer_mark_ready(mixer, pfds, nfds);
 	return 0;
 }
 
+static int snd_mixer_evloop_count(void *handle)
+{
+	return snd_mixer_poll_descriptors_count(handle);
+}
+
+static int snd_mixer_evloop_descriptors(void *handle, struct pollfd *pfds, unsigned int space)
+{
+	return snd_mixer_poll_descriptors(handle, pfds, space);
+}
+
+static int snd_mixer_evloop_revents(void *handle, struct pollfd *pfds, unsigned int nfds,
+		unsigned short *revents)
+{
+	return snd_mixer_poll_descriptors_revents(handle, pfds, nfds, revents);
+}
+
+static const snd_evloop_ops_t snd_mixer_evloop_ops = {
+	.count = snd_mixer_evloop_count,
+	.descriptors = snd_mixer_evloop_descriptors,
+	.revents = snd_mixer_evloop_revents,
+};
+
+/**
+ * \brief Registers a mixer handle with an event loop
+ * \param loop Event loop
+ * \param srcp Returned source, may be NULL
+ * \param mixer Mixer handle
+ * \param callback Callback for the events of the handle
+ * \param private_data Value for #snd_evloop_source_get_callback_private
+ * \return 0 on success otherwise a negative error code
+ *
+ * The callback gets the events translated by
+ * #snd_mixer_poll_descriptors_revents.  The poll descriptors are read
+ * once; see #snd_evloop_source_refresh.
+ */
+int snd_mixer_evloop_add(snd_evloop_t *loop, snd_evloop_source_t **srcp, snd_mixer_t *mixer,
+		snd_evloop_callback_t callback, void *private_data)
+{
+	assert(mixer);
+	return snd_evloop_add_source(loop, srcp, &snd_mixer_evloop_ops, mixer, 0,
+				     callback, private_data);
+}
+
 /**
  * \brief Wait for a mixer to become ready (i.e. at least one event pending)
  * \param mixer Mixer handle
  * \param timeout maximum time in milliseconds to wait
  * \return 0 otherwise a negative error code on failure
+ *
+ * The poll descriptors are read for each call.  To wait for many
+ * handles or in a loop with timeouts, add them to an event loop with
+ * #snd_mixer_evloop_add and #snd_evloop_add_timer instead.
  */
 int snd_mixer_wait(snd_mixer_t *mixer, int timeout)
 {
@@ -776,8 +1090,14 @@ int snd_mixer_wait(snd_mixer_t *mixer, int timeout)
 	}
 	err = poll(pfds, (unsigned int) count, timeout);
 	if (err < 0)
-		return -errno;
-	return 0;
+		err = -errno;
+	else {
+		snd_mixer_mark_ready(mixer, pfds, (unsigned int) count);
+		err = 0;
+	}
+	if (pfds != spfds)
+		free(pfds);
+	return err;
 }
 
 /**
@@ -840,16 +1160,26 @@ snd_mixer_elem_t *snd_mixer_elem_prev(snd_mixer_elem_t *elem)
 int snd_mixer_handle_events(snd_mixer_t *mixer)
 {
 	struct list_head *pos;
+	int err = 0, err2, marked;
 	assert(mixer);
 	mixer->events = 0;
+	marked = mixer->slaves_marked;
+	mixer->slaves_marked = 0;
+	snd_mixer_bulk_begin(mixer);
 	list_for_each(pos, &mixer->slaves) {
-		int err;
 		snd_mixer_slave_t *s;
 		s = list_entry(pos, snd_mixer_slave_t, list);
+		if (marked && !s->ready)
+			continue;
 		err = snd_hctl_handle_events(s->hctl);
 		if (err < 0)
-			return err;
+			break;
 	}
+	err2 = snd_mixer_bulk_end(mixer);
+	if (err < 0)
+		return err;
+	if (err2 < 0)
+		return err2;
 	return mixer->events;
 }
 
@@ -22,25 +22,41 @@
 
 #include "local.h"
 
-typedef struct _bag1 {
-	void *ptr;
-	struct list_head list;
-} bag1_t;
+#define BAG_INLINE	4
 
-typedef struct list_head bag_t;
+/* a small set of pointers, the first BAG_INLINE kept without allocation */
+typedef struct _bag {
+	unsigned int count;
+	unsigned int alloc;		/* entries in heap, 0 while inline */
+	void **heap;
+	void *items[BAG_INLINE];
+} bag_t;
 
 int bag_new(bag_t **bag);
 void bag_free(bag_t *bag);
+void bag_init(bag_t *bag);
+void bag_fini(bag_t *bag);
 int bag_add(bag_t *bag, void *ptr);
 int bag_del(bag_t *bag, void *ptr);
 int bag_empty(bag_t *bag);
 void bag_del_all(bag_t *bag);
 
-typedef struct list_head *bag_iterator_t;
+typedef struct {
+	unsigned int idx;
+	void *ptr;
+} bag_iterator_t;
 
-#define bag_iterator_entry(i) (list_entry((i), bag1_t, list)->ptr)
-#define bag_for_each(pos, bag) list_for_each(pos, bag)
-#define bag_for_each_safe(pos, next, bag) list_for_each_safe(pos, next, bag)
+#define bag_ptrs(bag) ((bag)->heap ? (bag)->heap : (bag)->items)
+#define bag_iterator_entry(i) ((i).ptr)
+#define bag_for_each(pos, bag) \
+	for ((pos).idx = 0; (pos).idx < (bag)->count && \
+	     ((pos).ptr = bag_ptrs(bag)[(pos).idx], 1); (pos).idx++)
+/* the body may delete the current entry */
+#define bag_for_each_safe(pos, bag) \
+	for ((pos).idx = 0; (pos).idx < (bag)->count && \
+	     ((pos).ptr = bag_ptrs(bag)[(pos).idx], 1); \
+	     (pos).idx += (pos).idx < (bag)->count && \
+			  bag_ptrs(bag)[(pos).idx] == (pos).ptr)
 
 struct _snd_mixer_class {
 	struct list_head list;
@@ -61,6 +77,7 @@ struct _snd_mixer_elem {
 	void *callback_private;
 	bag_t helems;
 	int compare_weight;		/* compare weight (reversed) */
+	snd_mixer_elem_t *selem_next;	/* chain in the simple element hash */
 };
 
 struct _snd_mixer {
@@ -70,6 +87,15 @@ struct _snd_mixer {
 	snd_mixer_elem_t **pelems;	/* array of all elems */
 	unsigned int count;
 	unsigned int alloc;
+	unsigned int selem_count;	/* simple elems */
+	unsigned int selem_hash_mask;	/* hash size - 1, 0 without hash */
+	snd_mixer_elem_t **selem_hash;	/* simple elems by name and index */
+	unsigned int bulk;		/* nesting of load/event batches */
+	unsigned int sorted;		/* pelems[0..sorted) are in order */
+	snd_mixer_elem_t **added;	/* elems whose ADD event is deferred */
+	unsigned int added_count;
+	unsigned int added_alloc;
+	int slaves_marked;		/* slave ready flags are valid */
 	unsigned int events;
 	snd_mixer_callback_t callback;
 	void *callback_private;
@@ -80,3 +106,11 @@ struct _snd_mixer_selem_id {
 	char name[60];
 	unsigned int index;
 };
+
+/* make local functions really local */
+#define snd_mixer_selem_hash_find \
+	snd1_mixer_selem_hash_find
+
+snd_mixer_elem_t *snd_mixer_selem_hash_find(snd_mixer_t *mixer,
+					    const snd_mixer_selem_id_t *id,
+					    int *hit);
@@ -110,6 +110,60 @@ int snd_mixer_selem_register(snd_mixer_t *mixer,
 #define COND_CAPS(xelem, what) \
 	!!(((sm_selem_t *)(elem)->private_data)->caps & (what))
 
+/* let the element write the changes of all channels at once */
+static void selem_hold_begin(snd_mixer_elem_t *elem)
+{
+	if (sm_selem_ops(elem)->hold)
+		sm_selem_ops(elem)->hold(elem, 1);
+}
+
+static int selem_hold_end(snd_mixer_elem_t *elem, int err)
+{
+	int err2 = 0;
+
+	if (sm_selem_ops(elem)->hold)
+		err2 = sm_selem_ops(elem)->hold(elem, 0);
+	if (err < 0)
+		return err;
+	return err2 < 0 ? err2 : 0;
+}
+
+/* volume and dB of all channels, channel by channel unless the element does better */
+static int selem_get_levels(snd_mixer_elem_t *elem, int dir, long *volume,
+			    long *dBvalue, unsigned int count)
+{
+	unsigned int caps = ((sm_selem_t *)elem->private_data)->caps;
+	unsigned int what = dir == SM_PLAY ? SM_CAP_PVOLUME : SM_CAP_CVOLUME;
+	unsigned int join = dir == SM_PLAY ? SM_CAP_PVOLUME_JOIN : SM_CAP_CVOLUME_JOIN;
+	snd_mixer_selem_channel_id_t chn, xchn;
+	int err, filled = 0;
+
+	if (!(caps & what))
+		return -EINVAL;
+	if (sm_selem_ops(elem)->get_levels)
+		return sm_selem_ops(elem)->get_levels(elem, dir, volume,
+						      dBvalue, count);
+	for (chn = 0; chn < count && chn <= SND_MIXER_SCHN_LAST; chn++) {
+		if (!sm_selem_ops(elem)->is(elem, dir, SM_OPS_IS_CHANNEL, (int)chn))
+			continue;
+		xchn = caps & join ? 0 : chn;
+		if (volume) {
+			err = sm_selem_ops(elem)->get_volume(elem, dir, xchn,
+							     &volume[chn]);
+			if (err < 0)
+				return err;
+		}
+		if (dBvalue) {
+			err = sm_selem_ops(elem)->get_dB(elem, dir, xchn,
+							 &dBvalue[chn]);
+			if (err < 0)
+				return err;
+		}
+		filled = chn + 1;
+	}
+	return filled;
+}
+
 #endif /* !DOC_HIDDEN */
 
 #ifndef DOC_HIDDEN
@@ -136,7 +190,11 @@ snd_mixer_elem_t *snd_mixer_find_selem(snd_mixer_t *mixer,
 	struct list_head *list;
 	snd_mixer_elem_t *e;
 	sm_selem_t *s;
+	int hit;
 
+	e = snd_mixer_selem_hash_find(mixer, id, &hit);
+	if (hit)
+		return e;
 	list_for_each(list, &mixer->elems) {
 		e = list_entry(list, snd_mixer_elem_t, list);
 		if (e->type != SND_MIXER_ELEM_SIMPLE)
@@ -421,6 +479,26 @@ int snd_mixer_selem_get_playback_dB(snd_mixer_elem_t *elem, snd_mixer_selem_chan
 	return sm_selem_ops(elem)->get_dB(elem, SM_PLAY, channel, value);
 }
 
+/**
+ * \brief Return playback volume and dB of all channels of a mixer simple element
+ * \param elem Mixer simple element handle
+ * \param volume array of count returned values indexed by channel, or NULL
+ * \param dBvalue array of count returned values (dB * 100), or NULL
+ * \param count size of the arrays
+ * \return the count of entries filled otherwise a negative error code
+ *
+ * The values are the ones #snd_mixer_selem_get_playback_volume() and
+ * #snd_mixer_selem_get_playback_dB() return for each channel, taken
+ * from the element state in one call; meters refreshing many elements
+ * save the per channel lookups.  Entries of channels the element does
+ * not have are left untouched.
+ */
+int snd_mixer_selem_get_playback_levels(snd_mixer_elem_t *elem, long *volume, long *dBvalue, unsigned int count)
+{
+	CHECK_BASIC(elem);
+	return selem_get_levels(elem, SM_PLAY, volume, dBvalue, count);
+}
+
 /**
  * \brief Return value of playback switch control of a mixer simple element
  * \param elem Mixer simple element handle
@@ -473,18 +551,20 @@ int snd_mixer_selem_set_playback_dB(snd_mixer_elem_t *elem, snd_mixer_selem_chan
 int snd_mixer_selem_set_playback_volume_all(snd_mixer_elem_t *elem, long value)
 {
 	snd_mixer_selem_channel_id_t chn;
-	int err;
+	int err = 0;
 
+	CHECK_BASIC(elem);
+	selem_hold_begin(elem);
 	for (chn = 0; chn < 32; chn++) {
 		if (!snd_mixer_selem_has_playback_channel(elem, chn))
 			continue;
 		err = snd_mixer_selem_set_playback_volume(elem, chn, value);
 		if (err < 0)
-			return err;
+			break;
 		if (chn == 0 && snd_mixer_selem_has_playback_volume_joined(elem))
-			return 0;
+			break;
 	}
-	return 0;
+	return selem_hold_end(elem, err);
 }
 
 /**
@@ -497,18 +577,20 @@ int snd_mixer_selem_set_playback_volume_all(snd_mixer_elem_t *elem, long value)
 int snd_mixer_selem_set_playback_dB_all(snd_mixer_elem_t *elem, long value, int dir)
 {
 	snd_mixer_selem_channel_id_t chn;
-	int err;
+	int err = 0;
 
+	CHECK_BASIC(elem);
+	selem_hold_begin(elem);
 	for (chn = 0; chn < 32; chn++) {
 		if (!snd_mixer_selem_has_playback_channel(elem, chn))
 			continue;
 		err = snd_mixer_selem_set_playback_dB(elem, chn, value, dir);
 		if (err < 0)
-			return err;
+			break;
 		if (chn == 0 && snd_mixer_selem_has_playback_volume_joined(elem))
-			return 0;
+			break;
 	}
-	return 0;
+	return selem_hold_end(elem, err);
 }
 
 /**
@@ -534,19 +616,20 @@ int snd_mixer_selem_set_playback_switch(snd_mixer_elem_t *elem, snd_mixer_selem_
 int snd_mixer_selem_set_playback_switch_all(snd_mixer_elem_t *elem, int value)
 {
 	snd_mixer_selem_channel_id_t chn;
-	int err;
+	int err = 0;
 
 	CHECK_BASIC(elem);
+	selem_hold_begin(elem);
 	for (chn = 0; chn < 32; chn++) {
 		if (!snd_mixer_selem_has_playback_channel(elem, chn))
 			continue;
 		err = snd_mixer_selem_set_playback_switch(elem, chn, value);
 		if (err < 0)
-			return err;
+			break;
 		if (chn == 0 && snd_mixer_selem_has_playback_switch_joined(elem))
-			return 0;
+			break;
 	}
-	return 0;
+	return selem_hold_end(elem, err);
 }
 
 /**
@@ -744,6 +827,22 @@ int snd_mixer_selem_get_capture_dB(snd_mixer_elem_t *elem, snd_mixer_selem_chann
 	return sm_selem_ops(elem)->get_dB(elem, SM_CAPT, channel, value);
 }
 
+/**
+ * \brief Return capture volume and dB of all channels of a mixer simple element
+ * \param elem Mixer simple element handle
+ * \param volume array of count returned values indexed by channel, or NULL
+ * \param dBvalue array of count returned values (dB * 100), or NULL
+ * \param count size of the arrays
+ * \return the count of entries filled otherwise a negative error code
+ *
+ * See #snd_mixer_selem_get_playback_levels().
+ */
+int snd_mixer_selem_get_capture_levels(snd_mixer_elem_t *elem, long *volume, long *dBvalue, unsigned int count)
+{
+	CHECK_BASIC(elem);
+	return selem_get_levels(elem, SM_CAPT, volume, dBvalue, count);
+}
+
 /**
  * \brief Return value of capture switch control of a mixer simple element
  * \param elem Mixer simple element handle
@@ -796,18 +895,20 @@ int snd_mixer_selem_set_capture_dB(snd_mixer_elem_t *elem, snd_mixer_selem_chann
 int snd_mixer_selem_set_capture_volume_all(snd_mixer_elem_t *elem, long value)
 {
 	snd_mixer_selem_channel_id_t chn;
-	int err;
+	int err = 0;
 
+	CHECK_BASIC(elem);
+	selem_hold_begin(elem);
 	for (chn = 0; chn < 32; chn++) {
 		if (!snd_mixer_selem_has_capture_channel(elem, chn))
 			continue;
 		err = snd_mixer_selem_set_capture_volume(elem, chn, value);
 		if (err < 0)
-			return err;
+			break;
 		if (chn == 0 && snd_mixer_selem_has_capture_volume_joined(elem))
-			return 0;
+			break;
 	}
-	return 0;
+	return selem_hold_end(elem, err);
 }
 
 /**
@@ -820,18 +921,20 @@ int snd_mixer_selem_set_capture_volume_all(snd_mixer_elem_t *elem, long value)
 int snd_mixer_selem_set_capture_dB_all(snd_mixer_elem_t *elem, long value, int dir)
 {
 	snd_mixer_selem_channel_id_t chn;
-	int err;
+	int err = 0;
 
+	CHECK_BASIC(elem);
+	selem_hold_begin(elem);
 	for (chn = 0; chn < 32; chn++) {
 		if (!snd_mixer_selem_has_capture_channel(elem, chn))
 			continue;
 		err = snd_mixer_selem_set_capture_dB(elem, chn, value, dir);
 		if (err < 0)
-			return err;
+			break;
 		if (chn == 0 && snd_mixer_selem_has_capture_volume_joined(elem))
-			return 0;
+			break;
 	}
-	return 0;
+	return selem_hold_end(elem, err);
 }
 
 /**
@@ -857,18 +960,20 @@ int snd_mixer_selem_set_capture_switch(snd_mixer_elem_t *elem, snd_mixer_selem_c
 int snd_mixer_selem_set_capture_switch_all(snd_mixer_elem_t *elem, int value)
 {
 	snd_mixer_selem_channel_id_t chn;
-	int err;
+	int err = 0;
 
+	CHECK_BASIC(elem);
+	selem_hold_begin(elem);
 	for (chn = 0; chn < 32; chn++) {
 		if (!snd_mixer_selem_has_capture_channel(elem, chn))
 			continue;
 		err = snd_mixer_selem_set_capture_switch(elem, chn, value);
 		if (err < 0)
-			return err;
+			break;
 		if (chn == 0 && snd_mixer_selem_has_capture_switch_joined(elem))
-			return 0;
+			break;
 	}
-	return 0;
+	return selem_hold_end(elem, err);
 }
 
 /**
@@ -35,21 +35,36 @@
 #include <sys/ioctl.h>
 #include <math.h>
 #include <dlfcn.h>
+#include <sys/stat.h>
+#include "local.h"
 #include "config.h"
-#include "asoundlib.h"
 #include "mixer_simple.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef DOC_HIDDEN
 
 #define SO_PATH ALSA_PLUGIN_DIR "/smixer"
 
+/* a module stays loaded until snd_mixer_simple_cache_cleanup() */
+struct smixer_module {
+	struct smixer_module *next;
+	char *path;
+	int full;			/* opened for alsa_mixer_simple_finit */
+	void *dlhandle;
+	snd_mixer_event_t event_func;
+	void *init_func;
+	unsigned int refs;		/* classes using the module */
+};
+
 typedef struct _class_priv {
 	char *device;
 	snd_ctl_t *ctl;
 	snd_hctl_t *hctl;
 	int attach_flag;
 	snd_ctl_card_info_t *info;
-	void *dlhandle;
+	struct smixer_module *module;
 	void *private_data;
 	void (*private_free)(snd_mixer_class_t *class);
 } class_priv_t;
@@ -59,19 +74,100 @@ typedef int (*snd_mixer_sfbasic_init_t)(snd_mixer_class_t *class,
 					snd_mixer_t *mixer,
 					const char *device);
 
+/*
+ * The parsed smixer.conf and the opened modules are kept for the whole
+ * process, so registering the class again for another mixer costs a
+ * stat() of the configuration file instead of parsing it and loading
+ * the module again.  The configuration is parsed again when the file
+ * changes.
+ */
+static struct {
+	char *file;
+	dev_t dev;
+	ino_t ino;
+	time_t mtime;
+	snd_config_t *top;
+} smixer_config;
+static struct smixer_module *smixer_modules;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t smixer_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void smixer_lock(void)
+{
+	pthread_mutex_lock(&smixer_mutex);
+}
+
+static inline void smixer_unlock(void)
+{
+	pthread_mutex_unlock(&smixer_mutex);
+}
+#else
+static inline void smixer_lock(void) {}
+static inline void smixer_unlock(void) {}
+#endif
+
 #endif /* !DOC_HIDDEN */
 
-static int try_open(snd_mixer_class_t *class, const char *lib)
+/* the configuration in file, parsed when not known; called locked */
+static int smixer_config_get(const char *file, snd_config_t **topp)
 {
-	class_priv_t *priv = snd_mixer_class_get_private(class);
-	snd_mixer_event_t event_func;
-	snd_mixer_sbasic_init_t init_func = NULL;
+	snd_config_t *top;
+	snd_input_t *input;
+	struct stat st;
+	int err;
+
+	if (stat(file, &st) < 0)
+		memset(&st, 0, sizeof(st));
+	if (smixer_config.top && !strcmp(smixer_config.file, file) &&
+	    st.st_ino && smixer_config.dev == st.st_dev &&
+	    smixer_config.ino == st.st_ino &&
+	    smixer_config.mtime == st.st_mtime) {
+		*topp = smixer_config.top;
+		return 0;
+	}
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = snd_input_stdio_open(&input, file, "r");
+	if (err < 0) {
+		SNDERR("unable to open simple mixer configuration file '%s'", file);
+		goto __error;
+	}
+	err = snd_config_load(top, input);
+	snd_input_close(input);
+	if (err < 0) {
+		SNDERR("%s may be old or corrupted: consider to remove or fix it", file);
+		goto __error;
+	}
+	if (smixer_config.top)
+		snd_config_delete(smixer_config.top);
+	free(smixer_config.file);
+	smixer_config.top = NULL;
+	smixer_config.file = strdup(file);
+	if (smixer_config.file) {
+		smixer_config.dev = st.st_dev;
+		smixer_config.ino = st.st_ino;
+		smixer_config.mtime = st.st_mtime;
+		smixer_config.top = top;
+	}
+	*topp = top;
+	return 0;
+      __error:
+	snd_config_delete(top);
+	return err;
+}
+
+/* find or load a module; called locked */
+static int smixer_module_get(const char *lib, int full,
+			     struct smixer_module **modp)
+{
+	const char *init_name = full ? "alsa_mixer_simple_finit" :
+				       "alsa_mixer_simple_init";
+	struct smixer_module *m;
 	char *xlib, *path;
 	void *h;
-	int err = 0;
 
-	if (!lib)
-		return -ENXIO;
 	path = getenv("ALSA_MIXER_SIMPLE_MODULES");
 	if (!path)
 		path = SO_PATH;
@@ -81,30 +177,93 @@ static int try_open(snd_mixer_class_t *class, const char *lib)
 	strcpy(xlib, path);
 	strcat(xlib, "/");
 	strcat(xlib, lib);
-	h = snd_dlopen(xlib, RTLD_NOW);
+	for (m = smixer_modules; m; m = m->next) {
+		if (m->full == full && !strcmp(m->path, xlib)) {
+			free(xlib);
+			*modp = m;
+			return 0;
+		}
+	}
+	/* note python modules requires RTLD_GLOBAL */
+	h = snd_dlopen(xlib, full ? RTLD_NOW|RTLD_GLOBAL : RTLD_NOW);
 	if (h == NULL) {
 		SNDERR("Unable to open library '%s'", xlib);
 		free(xlib);
 		return -ENXIO;
 	}
-	priv->dlhandle = h;
-	event_func = snd_dlsym(h, "alsa_mixer_simple_event", NULL);
-	if (event_func == NULL) {
+	m = calloc(1, sizeof(*m));
+	if (m == NULL) {
+		snd_dlclose(h);
+		free(xlib);
+		return -ENOMEM;
+	}
+	m->event_func = snd_dlsym(h, "alsa_mixer_simple_event", NULL);
+	if (m->event_func == NULL) {
 		SNDERR("Symbol 'alsa_mixer_simple_event' was not found in '%s'", xlib);
-		err = -ENXIO;
+		goto __error;
 	}
-	if (err == 0) {
-		init_func = snd_dlsym(h, "alsa_mixer_simple_init", NULL);
-		if (init_func == NULL) {
-			SNDERR("Symbol 'alsa_mixer_simple_init' was not found in '%s'", xlib);
-			err = -ENXIO;
-		}
+	m->init_func = snd_dlsym(h, init_name, NULL);
+	if (m->init_func == NULL) {
+		SNDERR("Symbol '%s' was not found in '%s'", init_name, xlib);
+		goto __error;
 	}
+	m->path = xlib;
+	m->full = full;
+	m->dlhandle = h;
+	m->next = smixer_modules;
+	smixer_modules = m;
+	*modp = m;
+	return 0;
+      __error:
+	snd_dlclose(h);
 	free(xlib);
-	err = err == 0 ? init_func(class) : err;
+	free(m);
+	return -ENXIO;
+}
+
+/* drop the parsed configuration and the modules no class uses */
+void snd_mixer_simple_cache_cleanup(void)
+{
+	struct smixer_module *m, **p;
+
+	smixer_lock();
+	if (smixer_config.top)
+		snd_config_delete(smixer_config.top);
+	free(smixer_config.file);
+	memset(&smixer_config, 0, sizeof(smixer_config));
+	p = &smixer_modules;
+	while ((m = *p) != NULL) {
+		if (m->refs) {
+			p = &m->next;
+			continue;
+		}
+		*p = m->next;
+		snd_dlclose(m->dlhandle);
+		free(m->path);
+		free(m);
+	}
+	smixer_unlock();
+}
+
+static int try_open(snd_mixer_class_t *class, const char *lib)
+{
+	class_priv_t *priv = snd_mixer_class_get_private(class);
+	struct smixer_module *m;
+	snd_mixer_sbasic_init_t init_func;
+	int err;
+
+	if (!lib)
+		return -ENXIO;
+	err = smixer_module_get(lib, 0, &m);
+	if (err < 0)
+		return err;
+	init_func = (snd_mixer_sbasic_init_t)m->init_func;
+	err = init_func(class);
 	if (err < 0)
 		return err;
-	snd_mixer_class_set_event(class, event_func);
+	m->refs++;
+	priv->module = m;
+	snd_mixer_class_set_event(class, m->event_func);
 	return 1;
 }
 
@@ -112,46 +271,20 @@ static int try_open_full(snd_mixer_class_t *class, snd_mixer_t *mixer,
 			 const char *lib, const char *device)
 {
 	class_priv_t *priv = snd_mixer_class_get_private(class);
-	snd_mixer_event_t event_func;
-	snd_mixer_sfbasic_init_t init_func = NULL;
-	char *xlib, *path;
-	void *h;
-	int err = 0;
+	struct smixer_module *m;
+	snd_mixer_sfbasic_init_t init_func;
+	int err;
 
-	path = getenv("ALSA_MIXER_SIMPLE_MODULES");
-	if (!path)
-		path = SO_PATH;
-	xlib = malloc(strlen(lib) + strlen(path) + 1 + 1);
-	if (xlib == NULL)
-		return -ENOMEM;
-	strcpy(xlib, path);
-	strcat(xlib, "/");
-	strcat(xlib, lib);
-	/* note python modules requires RTLD_GLOBAL */
-	h = snd_dlopen(xlib, RTLD_NOW|RTLD_GLOBAL);
-	if (h == NULL) {
-		SNDERR("Unable to open library '%s'", xlib);
-		free(xlib);
-		return -ENXIO;
-	}
-	priv->dlhandle = h;
-	event_func = snd_dlsym(h, "alsa_mixer_simple_event", NULL);
-	if (event_func == NULL) {
-		SNDERR("Symbol 'alsa_mixer_simple_event' was not found in '%s'", xlib);
-		err = -ENXIO;
-	}
-	if (err == 0) {
-		init_func = snd_dlsym(h, "alsa_mixer_simple_finit", NULL);
-		if (init_func == NULL) {
-			SNDERR("Symbol 'alsa_mixer_simple_finit' was not found in '%s'", xlib);
-			err = -ENXIO;
-		}
-	}
-	free(xlib);
-	err = err == 0 ? init_func(class, mixer, device) : err;
+	err = smixer_module_get(lib, 1, &m);
+	if (err < 0)
+		return err;
+	init_func = (snd_mixer_sfbasic_init_t)m->init_func;
+	err = init_func(class, mixer, device);
 	if (err < 0)
 		return err;
-	snd_mixer_class_set_event(class, event_func);
+	m->refs++;
+	priv->module = m;
+	snd_mixer_class_set_event(class, m->event_func);
 	return 1;
 }
 
@@ -247,8 +380,11 @@ static void private_free(snd_mixer_class_t *class)
 	
 	if (priv->private_free)
 		priv->private_free(class);
-	if (priv->dlhandle)
-		snd_dlclose(priv->dlhandle);
+	if (priv->module) {
+		smixer_lock();
+		priv->module->refs--;
+		smixer_unlock();
+	}
 	if (priv->info)
 		snd_ctl_card_info_free(priv->info);
 	if (priv->hctl) {
@@ -275,7 +411,6 @@ int snd_mixer_simple_basic_register(snd_mixer_t *mixer,
 	snd_mixer_class_t *class;
 	class_priv_t *priv = calloc(1, sizeof(*priv));
 	const char *file;
-	snd_input_t *input;
 	snd_config_t *top = NULL;
 	int err;
 
@@ -301,23 +436,13 @@ int snd_mixer_simple_basic_register(snd_mixer_t *mixer,
 	file = getenv("ALSA_MIXER_SIMPLE");
 	if (!file)
 		file = ALSA_CONFIG_DIR "/smixer.conf";
-	err = snd_config_top(&top);
-	if (err >= 0) {
-		err = snd_input_stdio_open(&input, file, "r");
-		if (err < 0) {
-			SNDERR("unable to open simple mixer configuration file '%s'", file);
-			goto __error;
-		}
-		err = snd_config_load(top, input);
-		snd_input_close(input);
-		if (err < 0) {
-			SNDERR("%s may be old or corrupted: consider to remove or fix it", file);
-			goto __error;
-		}
-		err = find_full(class, mixer, top, priv->device);
-		if (err >= 0)
-			goto __full;
-	}
+	smixer_lock();
+	err = smixer_config_get(file, &top);
+	if (err < 0)
+		goto __error;
+	err = find_full(class, mixer, top, priv->device);
+	if (err >= 0)
+		goto __full;
 	if (err >= 0) {
 		err = snd_ctl_open(&priv->ctl, priv->device, 0);
 		if (err < 0) {
@@ -336,23 +461,26 @@ int snd_mixer_simple_basic_register(snd_mixer_t *mixer,
 	}
 	if (err >= 0)
 		err = find_module(class, top);
+	smixer_unlock();
 	if (err >= 0)
 		err = snd_mixer_attach_hctl(mixer, priv->hctl);
 	if (err >= 0) {
 		priv->attach_flag = 1;
 		err = snd_mixer_class_register(class, mixer);
 	}
-      __full:
 	if (err < 0) {
-	      __error:
-		if (top)
-			snd_config_delete(top);
-	      	if (class)
-			snd_mixer_class_free(class);
+		snd_mixer_class_free(class);
 		return err;
 	}
-	if (top)
-		snd_config_delete(top);
+	goto __end;
+      __full:
+	smixer_unlock();
+	goto __end;
+      __error:
+	smixer_unlock();
+	snd_mixer_class_free(class);
+	return err;
+      __end:
 	if (classp)
 		*classp = class;
 	return 0;
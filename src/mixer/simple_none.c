@@ -70,14 +70,20 @@ typedef struct _selem_ctl {
 	snd_hctl_elem_t *elem;
 	snd_ctl_elem_type_t type;
 	unsigned int inactive: 1;
+	unsigned int is_volatile: 1;
+	unsigned int cached: 1;		/* raw holds the current values */
 	unsigned int values;
 	long min, max;
+	long *raw;			/* values of the first 32 channels,
+					   the diagonal for routes */
 } selem_ctl_t;
 
 typedef struct _selem_none {
 	sm_selem_t selem;
 	selem_ctl_t ctls[CTL_LAST + 1];
 	unsigned int capture_item;
+	unsigned int hold: 1;		/* changes are written when it ends */
+	unsigned int write_pending: 1;
 	struct selem_str {
 		unsigned int range: 1;	/* Forced range */
 		unsigned int db_initialized: 1;
@@ -87,6 +93,7 @@ typedef struct _selem_none {
 		long vol[32];
 		unsigned int sw;
 		unsigned int *db_info;
+		struct snd_tlv_dB_table *db_table; /* db_info for min..max */
 	} str[2];
 } selem_none_t;
 
@@ -232,57 +239,105 @@ static long from_user(selem_none_t *s, int dir, selem_ctl_t *c, long value)
 	return c->min + (n + (s->str[dir].max - s->str[dir].min) / 2) / (s->str[dir].max - s->str[dir].min);
 }
 
-static int elem_read_volume(selem_none_t *s, int dir, selem_ctl_type_t type)
+/* value of a channel as kept in raw */
+static long elem_raw_value(selem_ctl_t *c, selem_ctl_type_t type,
+			   snd_ctl_elem_value_t *ctl, unsigned int idx)
+{
+	if (type == CTL_GLOBAL_ROUTE || type == CTL_PLAYBACK_ROUTE ||
+	    type == CTL_CAPTURE_ROUTE)
+		return snd_ctl_elem_value_get_integer(ctl, idx * c->values + idx);
+	if (c->type == SND_CTL_ELEM_TYPE_ENUMERATED)
+		return snd_ctl_elem_value_get_enumerated(ctl, idx);
+	return snd_ctl_elem_value_get_integer(ctl, idx);
+}
+
+static int elem_keep(selem_ctl_t *c, selem_ctl_type_t type,
+		     snd_ctl_elem_value_t *ctl)
+{
+	unsigned int idx, n;
+
+	if (!c->raw) {
+		c->raw = calloc(32, sizeof(*c->raw));
+		if (!c->raw)
+			return -ENOMEM;
+	}
+	n = c->values < 32 ? c->values : 32;
+	for (idx = 0; idx < n; idx++)
+		c->raw[idx] = elem_raw_value(c, type, ctl, idx);
+	c->cached = 1;
+	return 0;
+}
+
+/* read the values of a control unless they are known already */
+static int elem_fetch(selem_none_t *s, selem_ctl_type_t type)
 {
 	snd_ctl_elem_value_t ctl = {0};
-	unsigned int idx;
 	int err;
 	selem_ctl_t *c = &s->ctls[type];
+	if (c->cached && !c->is_volatile)
+		return 0;
 	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
 		return err;
-	for (idx = 0; idx < s->str[dir].channels; idx++) {
-		unsigned int idx1 = idx;
-		if (idx >= c->values)
-			idx1 = 0;
-		s->str[dir].vol[idx] =
-			to_user(s, dir, c,
-				snd_ctl_elem_value_get_integer(&ctl, idx1));
+	return elem_keep(c, type, &ctl);
+}
+
+/*
+ * Write the whole value of a control.  The write is skipped when the
+ * control is known to hold these values; routes are always written
+ * because raw does not cover the channels off the diagonal.
+ */
+static int elem_commit(selem_none_t *s, selem_ctl_type_t type,
+		       snd_ctl_elem_value_t *ctl)
+{
+	selem_ctl_t *c = &s->ctls[type];
+	unsigned int idx;
+	int err;
+
+	if (c->cached && !c->is_volatile && c->values <= 32 &&
+	    type != CTL_GLOBAL_ROUTE && type != CTL_PLAYBACK_ROUTE &&
+	    type != CTL_CAPTURE_ROUTE) {
+		for (idx = 0; idx < c->values; idx++) {
+			if (c->raw[idx] != elem_raw_value(c, type, ctl, idx))
+				break;
+		}
+		if (idx == c->values)
+			return 0;
 	}
+	c->cached = 0;
+	if ((err = snd_hctl_elem_write(c->elem, ctl)) < 0)
+		return err;
+	elem_keep(c, type, ctl);
 	return 0;
 }
 
-static int elem_read_switch(selem_none_t *s, int dir, selem_ctl_type_t type)
+static int elem_read_volume(selem_none_t *s, int dir, selem_ctl_type_t type)
 {
-	snd_ctl_elem_value_t ctl = {0};
 	unsigned int idx;
 	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
+	if ((err = elem_fetch(s, type)) < 0)
 		return err;
 	for (idx = 0; idx < s->str[dir].channels; idx++) {
 		unsigned int idx1 = idx;
 		if (idx >= c->values)
 			idx1 = 0;
-		if (!snd_ctl_elem_value_get_integer(&ctl, idx1))
-			s->str[dir].sw &= ~(1 << idx);
+		s->str[dir].vol[idx] = to_user(s, dir, c, c->raw[idx1]);
 	}
 	return 0;
 }
 
-static int elem_read_route(selem_none_t *s, int dir, selem_ctl_type_t type)
+static int elem_read_switch(selem_none_t *s, int dir, selem_ctl_type_t type)
 {
-	snd_ctl_elem_value_t ctl = {0};
 	unsigned int idx;
 	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
+	if ((err = elem_fetch(s, type)) < 0)
 		return err;
 	for (idx = 0; idx < s->str[dir].channels; idx++) {
 		unsigned int idx1 = idx;
 		if (idx >= c->values)
 			idx1 = 0;
-		if (!snd_ctl_elem_value_get_integer(&ctl,
-						    idx1 * c->values + idx1))
+		if (!c->raw[idx1])
 			s->str[dir].sw &= ~(1 << idx);
 	}
 	return 0;
@@ -290,7 +345,6 @@ static int elem_read_route(selem_none_t *s, int dir, selem_ctl_type_t type)
 
 static int elem_read_enum(selem_none_t *s)
 {
-	snd_ctl_elem_value_t ctl = {0};
 	unsigned int idx;
 	int err;
 	int type;
@@ -304,19 +358,33 @@ static int elem_read_enum(selem_none_t *s)
 	else if (s->selem.caps & SM_CAP_CENUM)
 		type = CTL_CAPTURE_ENUM;
 	c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
+	if ((err = elem_fetch(s, type)) < 0)
 		return err;
 	for (idx = 0; idx < s->str[0].channels; idx++) {
 		unsigned int idx1 = idx;
 		if (idx >= c->values)
 			idx1 = 0;
-		s->str[0].vol[idx] =
-				snd_ctl_elem_value_get_enumerated(&ctl, idx1);
+		s->str[0].vol[idx] = c->raw[idx1];
 	}
 	return 0;
 }
 
-static int selem_read(snd_mixer_elem_t *elem)
+/* forget the values of helem, or of all controls when helem is NULL */
+static void selem_invalidate(selem_none_t *s, snd_hctl_elem_t *helem)
+{
+	int k;
+
+	for (k = 0; k <= CTL_LAST; k++) {
+		if (!helem || s->ctls[k].elem == helem)
+			s->ctls[k].cached = 0;
+	}
+}
+
+/*
+ * Rebuild the volumes and switches from the values of the controls;
+ * only the controls whose values are not known are read.
+ */
+static int selem_update_values(snd_mixer_elem_t *elem)
 {
 	selem_none_t *s;
 	unsigned int idx;
@@ -389,12 +457,12 @@ static int selem_read(snd_mixer_elem_t *elem)
 			return err;
 	}
 	if (s->ctls[CTL_PLAYBACK_ROUTE].elem) {
-		err = elem_read_route(s, SM_PLAY, CTL_PLAYBACK_ROUTE);
+		err = elem_read_switch(s, SM_PLAY, CTL_PLAYBACK_ROUTE);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_GLOBAL_ROUTE].elem) {
-		err = elem_read_route(s, SM_PLAY, CTL_GLOBAL_ROUTE);
+		err = elem_read_switch(s, SM_PLAY, CTL_GLOBAL_ROUTE);
 		if (err < 0)
 			return err;
 	}
@@ -431,27 +499,25 @@ static int selem_read(snd_mixer_elem_t *elem)
 			return err;
 	}
 	if (s->ctls[CTL_CAPTURE_ROUTE].elem) {
-		err = elem_read_route(s, SM_CAPT, CTL_CAPTURE_ROUTE);
+		err = elem_read_switch(s, SM_CAPT, CTL_CAPTURE_ROUTE);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_GLOBAL_ROUTE].elem) {
-		err = elem_read_route(s, SM_CAPT, CTL_GLOBAL_ROUTE);
+		err = elem_read_switch(s, SM_CAPT, CTL_GLOBAL_ROUTE);
 		if (err < 0)
 			return err;
 	}
 	if (s->ctls[CTL_CAPTURE_SOURCE].elem) {
-		snd_ctl_elem_value_t ctl = {0};
 		selem_ctl_t *c = &s->ctls[CTL_CAPTURE_SOURCE];
-		err = snd_hctl_elem_read(c->elem, &ctl);
+		err = elem_fetch(s, CTL_CAPTURE_SOURCE);
 		if (err < 0)
 			return err;
 		for (idx = 0; idx < s->str[SM_CAPT].channels; idx++) {
 			unsigned int idx1 = idx;
 			if (idx >= c->values)
 				idx1 = 0;
-			if (snd_ctl_elem_value_get_enumerated(&ctl, idx1) !=
-								s->capture_item)
+			if (c->raw[idx1] != (long)s->capture_item)
 				s->str[SM_CAPT].sw &= ~(1 << idx);
 		}
 	}
@@ -465,76 +531,61 @@ static int selem_read(snd_mixer_elem_t *elem)
 	return 0;
 }
 
+static int selem_read(snd_mixer_elem_t *elem)
+{
+	selem_invalidate(snd_mixer_elem_get_private(elem), NULL);
+	return selem_update_values(elem);
+}
+
 static int elem_write_volume(selem_none_t *s, int dir, selem_ctl_type_t type)
 {
 	snd_ctl_elem_value_t ctl = {0};
 	unsigned int idx;
-	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
-		return err;
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_integer(&ctl, idx,
 				from_user(s, dir, c, s->str[dir].vol[idx]));
-	if ((err = snd_hctl_elem_write(c->elem, &ctl)) < 0)
-		return err;
-	return 0;
+	return elem_commit(s, type, &ctl);
 }
 
 static int elem_write_switch(selem_none_t *s, int dir, selem_ctl_type_t type)
 {
 	snd_ctl_elem_value_t ctl = {0};
 	unsigned int idx;
-	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
-		return err;
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_integer(&ctl, idx,
 					!!(s->str[dir].sw & (1 << idx)));
-	if ((err = snd_hctl_elem_write(c->elem, &ctl)) < 0)
-		return err;
-	return 0;
+	return elem_commit(s, type, &ctl);
 }
 
 static int elem_write_switch_constant(selem_none_t *s, selem_ctl_type_t type, int val)
 {
 	snd_ctl_elem_value_t ctl = {0};
 	unsigned int idx;
-	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
-		return err;
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_integer(&ctl, idx, !!val);
-	if ((err = snd_hctl_elem_write(c->elem, &ctl)) < 0)
-		return err;
-	return 0;
+	return elem_commit(s, type, &ctl);
 }
 
 static int elem_write_route(selem_none_t *s, int dir, selem_ctl_type_t type)
 {
 	snd_ctl_elem_value_t ctl = {0};
 	unsigned int idx;
-	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
-		return err;
 	for (idx = 0; idx < c->values * c->values; idx++)
 		snd_ctl_elem_value_set_integer(&ctl, idx, 0);
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_integer(&ctl, idx * c->values + idx,
 					       !!(s->str[dir].sw & (1 << idx)));
-	if ((err = snd_hctl_elem_write(c->elem, &ctl)) < 0)
-		return err;
-	return 0;
+	return elem_commit(s, type, &ctl);
 }
 
 static int elem_write_enum(selem_none_t *s)
 {
 	snd_ctl_elem_value_t ctl = {0};
 	unsigned int idx;
-	int err;
 	int type;
 	selem_ctl_t *c;
 	type = CTL_GLOBAL_ENUM;
@@ -546,14 +597,10 @@ static int elem_write_enum(selem_none_t *s)
 	else if (s->selem.caps & SM_CAP_CENUM)
 		type = CTL_CAPTURE_ENUM;
 	c = &s->ctls[type];
-	if ((err = snd_hctl_elem_read(c->elem, &ctl)) < 0)
-		return err;
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_enumerated(&ctl, idx,
 					(unsigned int)s->str[0].vol[idx]);
-	if ((err = snd_hctl_elem_write(c->elem, &ctl)) < 0)
-		return err;
-	return 0;
+	return elem_commit(s, type, &ctl);
 }
 
 static int selem_write_main(snd_mixer_elem_t *elem)
@@ -660,12 +707,17 @@ static int selem_write(snd_mixer_elem_t *elem)
 static void selem_free(snd_mixer_elem_t *elem)
 {
 	selem_none_t *simple = snd_mixer_elem_get_private(elem);
+	int k;
 	assert(snd_mixer_elem_get_type(elem) == SND_MIXER_ELEM_SIMPLE);
 	if (simple->selem.id)
 		snd_mixer_selem_id_free(simple->selem.id);
 	/* free db range information */
 	free(simple->str[0].db_info);
 	free(simple->str[1].db_info);
+	snd_tlv_dB_table_free(simple->str[0].db_table);
+	snd_tlv_dB_table_free(simple->str[1].db_table);
+	for (k = 0; k <= CTL_LAST; k++)
+		free(simple->ctls[k].raw);
 	free(simple);
 }
 
@@ -1085,11 +1137,32 @@ static int get_volume_ops(snd_mixer_elem_t *elem, int dir,
 
 static int init_db_range(snd_hctl_elem_t *ctl, struct selem_str *rec);
 
+/* dB table for the current volume range, NULL when it cannot be built */
+static struct snd_tlv_dB_table *get_db_table(struct selem_str *rec)
+{
+	if (rec->db_table &&
+	    !snd_tlv_dB_table_match(rec->db_table, rec->db_info,
+				    rec->min, rec->max)) {
+		snd_tlv_dB_table_free(rec->db_table);
+		rec->db_table = NULL;
+	}
+	if (!rec->db_table &&
+	    snd_tlv_dB_table_new(&rec->db_table, rec->db_info,
+				 rec->min, rec->max) < 0)
+		rec->db_table = NULL;
+	return rec->db_table;
+}
+
 static int convert_to_dB(snd_hctl_elem_t *ctl, struct selem_str *rec,
 			 long volume, long *db_gain)
 {
+	struct snd_tlv_dB_table *table;
+
 	if (init_db_range(ctl, rec) < 0)
 		return -EINVAL;
+	table = get_db_table(rec);
+	if (table)
+		return snd_tlv_dB_table_to_dB(table, volume, db_gain);
 	return snd_tlv_convert_to_dB(rec->db_info, rec->min, rec->max,
 				     volume, db_gain);
 }
@@ -1109,7 +1182,7 @@ static int init_db_range(snd_hctl_elem_t *ctl, struct selem_str *rec)
 	if (rec->db_initialized)
 		return 0;
 
-	if (snd_hctl_elem_info(ctl, &info) < 0)
+	if (snd_hctl_elem_info_cached(ctl, &info) < 0)
 		goto error;
 	if (!snd_ctl_elem_info_is_tlv_readable(&info))
 		goto error;
@@ -1158,9 +1231,13 @@ static selem_ctl_t *get_selem_ctl(selem_none_t *s, int dir)
 static int get_dB_range(snd_hctl_elem_t *ctl, struct selem_str *rec,
 			long *min, long *max)
 {
+	struct snd_tlv_dB_table *table;
+
 	if (init_db_range(ctl, rec) < 0)
 		return -EINVAL;
-
+	table = get_db_table(rec);
+	if (table)
+		return snd_tlv_dB_table_get_range(table, min, max);
 	return snd_tlv_get_dB_range(rec->db_info, rec->min, rec->max, min, max);
 }
 	
@@ -1181,9 +1258,13 @@ static int get_dB_range_ops(snd_mixer_elem_t *elem, int dir,
 static int convert_from_dB(snd_hctl_elem_t *ctl, struct selem_str *rec,
 			   long db_gain, long *value, int xdir)
 {
+	struct snd_tlv_dB_table *table;
+
 	if (init_db_range(ctl, rec) < 0)
 		return -EINVAL;
-
+	table = get_db_table(rec);
+	if (table)
+		return snd_tlv_dB_table_from_dB(table, db_gain, value, xdir);
 	return snd_tlv_convert_from_dB(rec->db_info, rec->min, rec->max,
 				       db_gain, value, xdir);
 }
@@ -1228,6 +1309,48 @@ static int get_dB_ops(snd_mixer_elem_t *elem,
 	return err;
 }
 
+static int get_levels_ops(snd_mixer_elem_t *elem, int dir, long *volume,
+			  long *dBvalue, unsigned int count)
+{
+	selem_none_t *s = snd_mixer_elem_get_private(elem);
+	unsigned int join = dir == SM_PLAY ? SM_CAP_PVOLUME_JOIN : SM_CAP_CVOLUME_JOIN;
+	struct selem_str *rec;
+	struct snd_tlv_dB_table *table = NULL;
+	selem_ctl_t *c = NULL;
+	unsigned int idx, chn;
+	int err;
+
+	join &= s->selem.caps;
+	if (s->selem.caps & SM_CAP_GVOLUME)
+		dir = SM_PLAY;
+	rec = &s->str[dir];
+	if (count > rec->channels)
+		count = rec->channels;
+	if (dBvalue && count) {
+		c = get_selem_ctl(s, dir);
+		if (!c || init_db_range(c->elem, rec) < 0)
+			return -EINVAL;
+		table = get_db_table(rec);
+	}
+	for (idx = 0; idx < count; idx++) {
+		chn = join ? 0 : idx;
+		if (volume)
+			volume[idx] = rec->vol[chn];
+		if (!dBvalue)
+			continue;
+		if (table)
+			err = snd_tlv_dB_table_to_dB(table, rec->vol[chn],
+						     &dBvalue[idx]);
+		else
+			err = snd_tlv_convert_to_dB(rec->db_info, rec->min,
+						    rec->max, rec->vol[chn],
+						    &dBvalue[idx]);
+		if (err < 0)
+			return err;
+	}
+	return count;
+}
+
 static int get_switch_ops(snd_mixer_elem_t *elem, int dir,
 			  snd_mixer_selem_channel_id_t channel, int *value)
 {
@@ -1240,6 +1363,28 @@ static int get_switch_ops(snd_mixer_elem_t *elem, int dir,
 	return 0;
 }
 
+static int selem_write_changed(snd_mixer_elem_t *elem)
+{
+	selem_none_t *s = snd_mixer_elem_get_private(elem);
+
+	if (s->hold) {
+		s->write_pending = 1;
+		return 0;
+	}
+	return selem_write(elem);
+}
+
+static int hold_ops(snd_mixer_elem_t *elem, int hold)
+{
+	selem_none_t *s = snd_mixer_elem_get_private(elem);
+
+	s->hold = !!hold;
+	if (hold || !s->write_pending)
+		return 0;
+	s->write_pending = 0;
+	return selem_write(elem);
+}
+
 static int set_volume_ops(snd_mixer_elem_t *elem, int dir,
 			  snd_mixer_selem_channel_id_t channel, long value)
 {
@@ -1248,7 +1393,7 @@ static int set_volume_ops(snd_mixer_elem_t *elem, int dir,
 	if (changed < 0)
 		return changed;
 	if (changed)
-		return selem_write(elem);
+		return selem_write_changed(elem);
 	return 0;
 }
 
@@ -1304,7 +1449,7 @@ static int set_switch_ops(snd_mixer_elem_t *elem, int dir,
 	if (changed < 0)
 		return changed;
 	if (changed)
-		return selem_write(elem);
+		return selem_write_changed(elem);
 	return 0;
 }
 
@@ -1330,9 +1475,9 @@ static int enum_item_name_ops(snd_mixer_elem_t *elem,
 	assert(helem);
 	if (item >= (unsigned int)s->ctls[type].max)
 		return -EINVAL;
-	snd_hctl_elem_info(helem, &info);
+	snd_hctl_elem_info_cached(helem, &info);
 	snd_ctl_elem_info_set_item(&info, item);
-	snd_hctl_elem_info(helem, &info);
+	snd_hctl_elem_info_cached(helem, &info);
 	strncpy(buf, snd_ctl_elem_info_get_item_name(&info), maxlen);
 	return 0;
 }
@@ -1390,6 +1535,7 @@ static int set_enum_item_ops(snd_mixer_elem_t *elem,
 		return err;
 	}
 	snd_ctl_elem_value_set_enumerated(&ctl, channel, item);
+	s->ctls[type].cached = 0;
 	return snd_hctl_elem_write(helem, &ctl);
 }
 
@@ -1408,7 +1554,9 @@ static struct sm_elem_ops simple_none_ops = {
 	.set_switch	= set_switch_ops,
 	.enum_item_name	= enum_item_name_ops,
 	.get_enum_item	= get_enum_item_ops,
-	.set_enum_item	= set_enum_item_ops
+	.set_enum_item	= set_enum_item_ops,
+	.hold		= hold_ops,
+	.get_levels	= get_levels_ops,
 };
 
 static int simple_add1(snd_mixer_class_t *class, const char *name,
@@ -1425,7 +1573,7 @@ static int simple_add1(snd_mixer_class_t *class, const char *name,
 	snd_ctl_elem_type_t ctype;
 	unsigned long values;
 
-	err = snd_hctl_elem_info(helem, &info);
+	err = snd_hctl_elem_info_cached(helem, &info);
 	if (err < 0)
 		return err;
 	ctype = snd_ctl_elem_info_get_type(&info);
@@ -1554,6 +1702,8 @@ static int simple_add1(snd_mixer_class_t *class, const char *name,
 	simple->ctls[type].elem = helem;
 	simple->ctls[type].type = snd_ctl_elem_info_get_type(&info);
 	simple->ctls[type].inactive = snd_ctl_elem_info_is_inactive(&info);
+	simple->ctls[type].is_volatile = snd_ctl_elem_info_is_volatile(&info);
+	simple->ctls[type].cached = 0;
 	simple->ctls[type].values = values;
 	if ( (type == CTL_GLOBAL_ENUM) ||
 	     (type == CTL_PLAYBACK_ENUM) ||
@@ -1613,7 +1763,7 @@ static int simple_event_add(snd_mixer_class_t *class, snd_hctl_elem_t *helem)
 		snd_ctl_elem_info_t info = {0};
 		unsigned int k, items;
 		int err;
-		err = snd_hctl_elem_info(helem, &info);
+		err = snd_hctl_elem_info_cached(helem, &info);
 		assert(err >= 0);
 		if (snd_ctl_elem_info_get_type(&info) !=
 						SND_CTL_ELEM_TYPE_ENUMERATED)
@@ -1622,7 +1772,7 @@ static int simple_event_add(snd_mixer_class_t *class, snd_hctl_elem_t *helem)
 		for (k = 0; k < items; ++k) {
 			const char *n;
 			snd_ctl_elem_info_set_item(&info, k);
-			err = snd_hctl_elem_info(helem, &info);
+			err = snd_hctl_elem_info_cached(helem, &info);
 			if (err < 0)
 				return err;
 			n = snd_ctl_elem_info_get_item_name(&info);
@@ -1663,6 +1813,8 @@ static int simple_event_remove(snd_hctl_elem_t *helem,
 	}
 	assert(k <= CTL_LAST);
 	simple->ctls[k].elem = NULL;
+	free(simple->ctls[k].raw);
+	simple->ctls[k].raw = NULL;
 	err = snd_mixer_elem_detach(melem, helem);
 	if (err < 0)
 		return err;
@@ -1693,7 +1845,9 @@ static int simple_event(snd_mixer_class_t *class, unsigned int mask,
 		return 0;
 	}
 	if (mask & SND_CTL_EVENT_MASK_VALUE) {
-		err = selem_read(melem);
+		/* only helem changed, the other values are still known */
+		selem_invalidate(snd_mixer_elem_get_private(melem), helem);
+		err = selem_update_values(melem);
 		if (err < 0)
 			return err;
 		if (err) {
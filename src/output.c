@@ -47,6 +47,11 @@ struct _snd_output {
 	const snd_output_ops_t *ops;
 	void *private_data;
 };
+
+/* the memory buffer is written without going through the ops */
+static int snd_output_buffer_print(snd_output_t *output, const char *format, va_list args);
+static int snd_output_buffer_puts(snd_output_t *output, const char *str);
+static int snd_output_buffer_putc(snd_output_t *output, int c);
 #endif
 
 /**
@@ -73,7 +78,10 @@ int snd_output_printf(snd_output_t *output, const char *format, ...)
 	int result;
 	va_list args;
 	va_start(args, format);
-	result = output->ops->print(output, format, args);
+	if (output->type == SND_OUTPUT_BUFFER)
+		result = snd_output_buffer_print(output, format, args);
+	else
+		result = output->ops->print(output, format, args);
 	va_end(args);
 	return result;
 }
@@ -87,6 +95,8 @@ int snd_output_printf(snd_output_t *output, const char *format, ...)
  */
 int snd_output_vprintf(snd_output_t *output, const char *format, va_list args)
 {
+	if (output->type == SND_OUTPUT_BUFFER)
+		return snd_output_buffer_print(output, format, args);
 	return output->ops->print(output, format, args);
 }
 
@@ -98,6 +108,8 @@ int snd_output_vprintf(snd_output_t *output, const char *format, va_list args)
  */
 int snd_output_puts(snd_output_t *output, const char *str)
 {
+	if (output->type == SND_OUTPUT_BUFFER)
+		return snd_output_buffer_puts(output, str);
 	return output->ops->puts(output, str);
 }
 			
@@ -109,6 +121,8 @@ int snd_output_puts(snd_output_t *output, const char *str)
  */
 int snd_output_putc(snd_output_t *output, int c)
 {
+	if (output->type == SND_OUTPUT_BUFFER)
+		return snd_output_buffer_putc(output, c);
 	return output->ops->putch(output, c);
 }
 
@@ -255,7 +269,7 @@ static int snd_output_buffer_need(snd_output_t *output, size_t size)
 	if (_free >= size)
 		return _free;
 	if (buffer->alloc == 0)
-		alloc = 256;
+		alloc = 4096;
 	else
 		alloc = buffer->alloc;
 	while (alloc < buffer->size + size)
@@ -271,23 +285,25 @@ static int snd_output_buffer_need(snd_output_t *output, size_t size)
 static int snd_output_buffer_print(snd_output_t *output, const char *format, va_list args)
 {
 	snd_output_buffer_t *buffer = output->private_data;
-	size_t size = 256;
+	va_list copy;
 	int result;
-	result = snd_output_buffer_need(output, size);
+	result = snd_output_buffer_need(output, 256);
 	if (result < 0)
 		return result;
-	result = vsnprintf((char *)buffer->buf + buffer->size, size, format, args);
-	assert(result >= 0);
-	if ((size_t)result <= size) {
-		buffer->size += result;
-		return result;
-	}
-	size = result;
-	result = snd_output_buffer_need(output, size);
+	/* format straight into the free space, once more if it was short */
+	va_copy(copy, args);
+	result = vsnprintf((char *)buffer->buf + buffer->size,
+			   buffer->alloc - buffer->size, format, copy);
+	va_end(copy);
 	if (result < 0)
-		return result;
-	result = vsnprintf((char *)buffer->buf + buffer->size, result, format, args);
-	assert(result == (int)size);
+		return -EINVAL;
+	if ((size_t)result >= buffer->alloc - buffer->size) {
+		int err = snd_output_buffer_need(output, result + 1);
+		if (err < 0)
+			return err;
+		vsnprintf((char *)buffer->buf + buffer->size,
+			  buffer->alloc - buffer->size, format, args);
+	}
 	buffer->size += result;
 	return result;
 }
@@ -309,9 +325,11 @@ static int snd_output_buffer_putc(snd_output_t *output, int c)
 {
 	snd_output_buffer_t *buffer = output->private_data;
 	int err;
-	err = snd_output_buffer_need(output, 1);
-	if (err < 0)
-		return err;
+	if (buffer->size >= buffer->alloc) {
+		err = snd_output_buffer_need(output, 1);
+		if (err < 0)
+			return err;
+	}
 	buffer->buf[buffer->size++] = c;
 	return 0;
 }
@@ -31,6 +31,9 @@
 
 MASK_INLINE unsigned int ld2(u_int32_t v)
 {
+#if defined(__GNUC__)
+	return v ? 31 - __builtin_clz(v) : 0;
+#else
         unsigned r = 0;
 
         if (v >= 0x10000) {
@@ -52,15 +55,20 @@ MASK_INLINE unsigned int ld2(u_int32_t v)
         if (v >= 2)
                 r++;
         return r;
+#endif
 }
 
 MASK_INLINE unsigned int hweight32(u_int32_t v)
 {
+#if defined(__GNUC__)
+	return __builtin_popcount(v);
+#else
         v = (v & 0x55555555) + ((v >> 1) & 0x55555555);
         v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
         v = (v & 0x0F0F0F0F) + ((v >> 4) & 0x0F0F0F0F);
         v = (v & 0x00FF00FF) + ((v >> 8) & 0x00FF00FF);
         return (v & 0x0000FFFF) + ((v >> 16) & 0x0000FFFF);
+#endif
 }
 
 MASK_INLINE size_t snd_mask_sizeof(void)
@@ -138,20 +146,36 @@ MASK_INLINE void snd_mask_reset(snd_mask_t *mask, unsigned int val)
 	mask->bits[MASK_OFS(val)] &= ~MASK_BIT(val);
 }
 
+/* bits from..to (inclusive) of word w */
+MASK_INLINE u_int32_t mask_range_bits(unsigned int w, unsigned int from,
+				      unsigned int to)
+{
+	unsigned int lo = w << 5, hi = lo + 31;
+	u_int32_t bits = 0xffffffff;
+
+	if (from > hi || to < lo)
+		return 0;
+	if (from > lo)
+		bits &= 0xffffffff << (from - lo);
+	if (to < hi)
+		bits &= 0xffffffff >> (hi - to);
+	return bits;
+}
+
 MASK_INLINE void snd_mask_set_range(snd_mask_t *mask, unsigned int from, unsigned int to)
 {
 	unsigned int i;
 	assert(to <= SND_MASK_MAX && from <= to);
-	for (i = from; i <= to; i++)
-		mask->bits[MASK_OFS(i)] |= MASK_BIT(i);
+	for (i = MASK_OFS(from); i < MASK_SIZE && i <= MASK_OFS(to); i++)
+		mask->bits[i] |= mask_range_bits(i, from, to);
 }
 
 MASK_INLINE void snd_mask_reset_range(snd_mask_t *mask, unsigned int from, unsigned int to)
 {
 	unsigned int i;
 	assert(to <= SND_MASK_MAX && from <= to);
-	for (i = from; i <= to; i++)
-		mask->bits[MASK_OFS(i)] &= ~MASK_BIT(i);
+	for (i = MASK_OFS(from); i < MASK_SIZE && i <= MASK_OFS(to); i++)
+		mask->bits[i] &= ~mask_range_bits(i, from, to);
 }
 
 MASK_INLINE void snd_mask_leave(snd_mask_t *mask, unsigned int val)
@@ -195,30 +219,28 @@ MASK_INLINE int snd_mask_test(const snd_mask_t *mask, unsigned int val)
 
 MASK_INLINE int snd_mask_single(const snd_mask_t *mask)
 {
-	int i, c = 0;
 	assert(!snd_mask_empty(mask));
-	for (i = 0; i < MASK_SIZE; i++) {
-		if (! mask->bits[i])
-			continue;
-		if (mask->bits[i] & (mask->bits[i] - 1))
-			return 0;
-		if (c)
-			return 0;
-		c++;
-	}
-	return 1;
+	return snd_mask_count(mask) == 1;
 }
 
 MASK_INLINE int snd_mask_refine(snd_mask_t *mask, const snd_mask_t *v)
 {
-	snd_mask_t old;
-	if (snd_mask_empty(mask))
+	u_int32_t any = 0, lost = 0, left = 0;
+	int i;
+	/* one pass: intersect and track emptiness and change at once */
+	for (i = 0; i < MASK_SIZE; i++) {
+		u_int32_t b = mask->bits[i];
+		any |= b;
+		lost |= b & ~v->bits[i];
+		b &= v->bits[i];
+		left |= b;
+		mask->bits[i] = b;
+	}
+	if (!any)
 		return -ENOENT;
-	snd_mask_copy(&old, mask);
-	snd_mask_intersect(mask, v);
-	if (snd_mask_empty(mask))
+	if (!left)
 		return -EINVAL;
-	return !snd_mask_eq(mask, &old);
+	return lost != 0;
 }
 
 MASK_INLINE int snd_mask_refine_first(snd_mask_t *mask)
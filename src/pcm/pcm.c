@@ -426,6 +426,13 @@ before any read/write begin+commit operations.
 The function #snd_pcm_avail_delay() combines #snd_pcm_avail() and
 #snd_pcm_delay() and returns both values in sync.
 </p>
+<p>
+The function #snd_pcm_avail_status() goes one step further: it returns
+the state, avail, delay and the timestamps taken from a single pointer
+update, it can replace the calls of #snd_pcm_avail_update(),
+#snd_pcm_delay() and #snd_pcm_htimestamp() in each cycle of a processing
+loop.
+</p>
 
 \section pcm_action Managing the stream state
 
@@ -501,6 +508,25 @@ LIBASOUND_THREAD_SAFE=0 aplay foo.wav
 \endcode
 for making the debugging easier.
 
+Each PCM handle has its own lock, so the plugins of a chain are locked
+separately, and the hw plugin takes its lock only around the few operations
+changing the handle fields, the kernel serializes the rest.  A status or
+metering thread can therefore query a handle (#snd_pcm_avail_update(),
+#snd_pcm_delay(), #snd_pcm_status()) while another thread is blocked in
+#snd_pcm_writei() or #snd_pcm_readi(); the lock is released while waiting.
+An application owning a handle from a single thread can skip the locking
+for this handle and all its slaves by passing #SND_PCM_NO_THREAD_SAFE to
+#snd_pcm_open().
+
+The buffers which the plugins allocate on #snd_pcm_hw_params() (the mmap
+emulation buffers, and the client buffers of dmix, dshare and dsnoop) are
+paged in on demand, so the first periods after the start may page fault.
+A realtime client can pass #SND_PCM_LOCK_BUFFERS to #snd_pcm_open() to
+lock these buffers of the handle and all its slaves in memory and fault
+them in right away.  Without the privilege to lock the memory (see
+RLIMIT_MEMLOCK), the pages are only faulted in.  The shared segments of
+the direct plugins, including the dmix sum buffer, are always locked.
+
 \section pcm_dev_names PCM naming conventions
 
 The ALSA library uses a generic string representation for names of devices.
@@ -654,6 +680,7 @@ playback devices.
 #include <sys/mman.h>
 #include <limits.h>
 #include "pcm_local.h"
+#include "pcm_generic.h"
 
 /**
  * \brief get identifier of PCM handle
@@ -811,7 +838,7 @@ int snd_pcm_hw_params_current(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	snd_mask_set(&params->masks[SND_PCM_HW_PARAM_ACCESS - SND_PCM_HW_PARAM_FIRST_MASK], pcm->access);
 	snd_mask_set(&params->masks[SND_PCM_HW_PARAM_FORMAT - SND_PCM_HW_PARAM_FIRST_MASK], pcm->format);
 	snd_mask_set(&params->masks[SND_PCM_HW_PARAM_SUBFORMAT - SND_PCM_HW_PARAM_FIRST_MASK], pcm->subformat);
-	frame_bits = snd_pcm_format_physical_width(pcm->format) * pcm->channels;
+	frame_bits = __snd_pcm_format_physical_width(pcm->format) * pcm->channels;
 	snd_interval_set_value(&params->intervals[SND_PCM_HW_PARAM_FRAME_BITS - SND_PCM_HW_PARAM_FIRST_INTERVAL], frame_bits);
 	snd_interval_set_value(&params->intervals[SND_PCM_HW_PARAM_CHANNELS - SND_PCM_HW_PARAM_FIRST_INTERVAL], pcm->channels);
 	snd_interval_set_value(&params->intervals[SND_PCM_HW_PARAM_RATE - SND_PCM_HW_PARAM_FIRST_INTERVAL], pcm->rate);
@@ -879,11 +906,14 @@ int snd_pcm_hw_free(snd_pcm_t *pcm)
 	//        snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED);
 	err = pcm->ops->hw_free(pcm->op_arg);
 	pcm->setup = 0;
+	snd_pcm_hw_refine_invalidate();
 	if (err < 0)
 		return err;
 	return 0;
 }
 
+static void snd_pcm_wait_resolve(snd_pcm_t *pcm);
+
 /** \brief Install PCM software configuration defined by params
  * \param pcm PCM handle
  * \param params Configuration container
@@ -933,6 +963,7 @@ int snd_pcm_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t *params)
 	pcm->silence_threshold = params->silence_threshold;
 	pcm->silence_size = params->silence_size;
 	pcm->boundary = params->boundary;
+	snd_pcm_wait_resolve(pcm);
 	__snd_pcm_unlock(pcm);
 	return 0;
 }
@@ -1642,11 +1673,62 @@ int snd_pcm_poll_descriptors_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsign
 
 	assert(pcm && pfds && revents);
 	snd_pcm_lock(pcm);
-	err = __snd_pcm_poll_revents(pcm, pfds, nfds, revents);
+	if (pcm->stats) {
+		snd_htimestamp_t start;
+
+		snd_pcm_stat_start(&start);
+		err = __snd_pcm_poll_revents(pcm, pfds, nfds, revents);
+		snd_pcm_stat_update(pcm, SND_PCM_STAT_POLL_REVENTS, &start);
+	} else {
+		err = __snd_pcm_poll_revents(pcm, pfds, nfds, revents);
+	}
 	snd_pcm_unlock(pcm);
 	return err;
 }
 
+static int snd_pcm_evloop_count(void *handle)
+{
+	return snd_pcm_poll_descriptors_count(handle);
+}
+
+static int snd_pcm_evloop_descriptors(void *handle, struct pollfd *pfds, unsigned int space)
+{
+	return snd_pcm_poll_descriptors(handle, pfds, space);
+}
+
+static int snd_pcm_evloop_revents(void *handle, struct pollfd *pfds, unsigned int nfds,
+		unsigned short *revents)
+{
+	return snd_pcm_poll_descriptors_revents(handle, pfds, nfds, revents);
+}
+
+static const snd_evloop_ops_t snd_pcm_evloop_ops = {
+	.count = snd_pcm_evloop_count,
+	.descriptors = snd_pcm_evloop_descriptors,
+	.revents = snd_pcm_evloop_revents,
+};
+
+/**
+ * \brief Registers a PCM handle with an event loop
+ * \param loop Event loop
+ * \param srcp Returned source, may be NULL
+ * \param pcm PCM handle
+ * \param callback Callback for the events of the handle
+ * \param private_data Value for #snd_evloop_source_get_callback_private
+ * \return 0 on success otherwise a negative error code
+ *
+ * The callback gets the events translated by
+ * #snd_pcm_poll_descriptors_revents.  The poll descriptors are read
+ * once; see #snd_evloop_source_refresh.
+ */
+int snd_pcm_evloop_add(snd_evloop_t *loop, snd_evloop_source_t **srcp, snd_pcm_t *pcm,
+		snd_evloop_callback_t callback, void *private_data)
+{
+	assert(pcm);
+	return snd_evloop_add_source(loop, srcp, &snd_pcm_evloop_ops, pcm, 0,
+				     callback, private_data);
+}
+
 static int __snd_pcm_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds,
 				  unsigned int nfds, unsigned short *revents)
 {
@@ -2164,6 +2246,150 @@ int snd_pcm_dump(snd_pcm_t *pcm, snd_output_t *out)
 	assert(pcm);
 	assert(out);
 	pcm->ops->dump(pcm->op_arg, out);
+	if (pcm->stats)
+		snd_pcm_dump_stats(pcm, out);
+	return 0;
+}
+
+#ifndef DOC_HIDDEN
+#define STAT(v) [SND_PCM_STAT_##v] = #v
+
+static const char *const snd_pcm_stat_names[] = {
+	STAT(WRITE_AREAS),
+	STAT(READ_AREAS),
+	STAT(AVAIL_UPDATE),
+	STAT(MMAP_COMMIT),
+	STAT(HWSYNC),
+	STAT(POLL_REVENTS),
+};
+
+#undef STAT
+
+void snd_pcm_stat_start(snd_htimestamp_t *start)
+{
+	gettimestamp(start, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+}
+
+/* account one call begun at start; called with the PCM lock held */
+void snd_pcm_stat_update(snd_pcm_t *pcm, snd_pcm_stat_t stat,
+			 const snd_htimestamp_t *start)
+{
+	snd_pcm_stat_counter_t *counter;
+	snd_htimestamp_t now;
+	long long ns;
+
+	if (!pcm->stats)
+		return;
+	gettimestamp(&now, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+	ns = (now.tv_sec - start->tv_sec) * 1000000000LL +
+		now.tv_nsec - start->tv_nsec;
+	if (ns < 0)
+		ns = 0;
+	counter = &pcm->stats[stat];
+	counter->calls++;
+	counter->total_ns += ns;
+	if ((unsigned long long)ns > counter->max_ns)
+		counter->max_ns = ns;
+}
+#endif
+
+/**
+ * \brief get name of a PCM hot-path statistics slot
+ * \param stat statistics slot
+ * \return ascii name of the slot
+ */
+const char *snd_pcm_stat_name(const snd_pcm_stat_t stat)
+{
+	if (stat > SND_PCM_STAT_LAST)
+		return NULL;
+	return snd_pcm_stat_names[stat];
+}
+
+/**
+ * \brief Turn the hot-path statistics of a PCM on or off
+ * \param pcm PCM handle
+ * \param enable 0 = off, otherwise on
+ * \return 0 on success otherwise a negative error code
+ *
+ * Only this PCM is instrumented; a slave of a plugin keeps counting
+ * on its own once it is enabled as well.  Set the environment variable
+ * LIBASOUND_PCM_STATS to a non-zero value to enable the counters on
+ * every PCM at open time, which covers a whole plugin chain.
+ * Enabling the counters again clears them.
+ */
+int snd_pcm_stats_enable(snd_pcm_t *pcm, int enable)
+{
+	snd_pcm_stat_counter_t *stats = NULL;
+
+	assert(pcm);
+	if (enable) {
+		stats = calloc(SND_PCM_STAT_LAST + 1, sizeof(*stats));
+		if (!stats)
+			return -ENOMEM;
+	}
+	snd_pcm_lock(pcm);
+	free(pcm->stats);
+	pcm->stats = stats;
+	snd_pcm_unlock(pcm);
+	return 0;
+}
+
+/**
+ * \brief Read a hot-path statistics counter of a PCM
+ * \param pcm PCM handle
+ * \param stat statistics slot
+ * \param counter returned counter
+ * \return 0 on success, -ENXIO if the statistics are off
+ */
+int snd_pcm_stats_get(snd_pcm_t *pcm, snd_pcm_stat_t stat,
+		      snd_pcm_stat_counter_t *counter)
+{
+	assert(pcm && counter);
+	if (stat > SND_PCM_STAT_LAST)
+		return -EINVAL;
+	snd_pcm_lock(pcm);
+	if (!pcm->stats) {
+		snd_pcm_unlock(pcm);
+		return -ENXIO;
+	}
+	*counter = pcm->stats[stat];
+	snd_pcm_unlock(pcm);
+	return 0;
+}
+
+/**
+ * \brief Dump the hot-path statistics of a PCM
+ * \param pcm PCM handle
+ * \param out Output handle
+ * \return 0 on success, -ENXIO if the statistics are off
+ */
+int snd_pcm_dump_stats(snd_pcm_t *pcm, snd_output_t *out)
+{
+	snd_pcm_stat_counter_t stats[SND_PCM_STAT_LAST + 1];
+	unsigned int i;
+
+	assert(pcm);
+	assert(out);
+	snd_pcm_lock(pcm);
+	if (!pcm->stats) {
+		snd_pcm_unlock(pcm);
+		return -ENXIO;
+	}
+	memcpy(stats, pcm->stats, sizeof(stats));
+	snd_pcm_unlock(pcm);
+	snd_output_printf(out, "Stats of %s PCM", snd_pcm_type_name(pcm->type));
+	if (pcm->name)
+		snd_output_printf(out, " '%s'", pcm->name);
+	snd_output_printf(out, ":\n");
+	for (i = 0; i <= SND_PCM_STAT_LAST; i++) {
+		if (!stats[i].calls)
+			continue;
+		snd_output_printf(out, "  %-13s: %lu calls, %llu ns total, %llu ns avg, %llu ns max\n",
+				  snd_pcm_stat_names[i], stats[i].calls,
+				  stats[i].total_ns,
+				  stats[i].total_ns / stats[i].calls,
+				  stats[i].max_ns);
+	}
 	return 0;
 }
 
@@ -2255,7 +2481,8 @@ int snd_async_add_pcm_handler(snd_async_handler_t **handler, snd_pcm_t *pcm,
 	h->u.pcm = pcm;
 	was_empty = list_empty(&pcm->async_handlers);
 	list_add_tail(&h->hlist, &pcm->async_handlers);
-	if (was_empty) {
+	/* no signal with the dispatcher thread */
+	if (was_empty && snd_async_handler_get_signo(h)) {
 		err = snd_pcm_async(pcm, snd_async_handler_get_signo(h), getpid());
 		if (err < 0) {
 			snd_async_del_handler(h);
@@ -2329,7 +2556,7 @@ static int snd_pcm_open_conf(snd_pcm_t **pcmp, const char *name,
 		SNDERR("Invalid type for %s", id);
 		return err;
 	}
-	err = snd_config_search_definition(pcm_root, "pcm_type", str, &type_conf);
+	err = snd_config_search_definition_shared(pcm_root, "pcm_type", str, &type_conf);
 	if (err >= 0) {
 		if (snd_config_get_type(type_conf) != SND_CONFIG_TYPE_COMPOUND) {
 			SNDERR("Invalid type for PCM type %s definition", str);
@@ -2445,7 +2672,7 @@ static int snd_pcm_open_noupdate(snd_pcm_t **pcmp, snd_config_t *root,
 	snd_config_t *pcm_conf;
 	const char *str;
 
-	err = snd_config_search_definition(root, "pcm", name, &pcm_conf);
+	err = snd_config_search_definition_shared(root, "pcm", name, &pcm_conf);
 	if (err < 0) {
 		SNDERR("Unknown PCM %s", name);
 		return err;
@@ -2519,8 +2746,8 @@ int snd_pcm_open_fallback(snd_pcm_t **pcmp, snd_config_t *root,
 	assert(pcmp && name && root);
 	err = snd_pcm_open_noupdate(pcmp, root, name, stream, mode, 0);
 	if (err >= 0) {
-		free((*pcmp)->name);
-		(*pcmp)->name = orig_name ? strdup(orig_name) : NULL;
+		(*pcmp)->name = orig_name ?
+			snd_pcm_arena_strdup(*pcmp, orig_name) : NULL;
 	}
 	return err;
 }
@@ -2530,19 +2757,21 @@ int snd_pcm_new(snd_pcm_t **pcmp, snd_pcm_type_t type, const char *name,
 		snd_pcm_stream_t stream, int mode)
 {
 	snd_pcm_t *pcm;
-	pcm = calloc(1, sizeof(*pcm));
+	pcm = snd_pcm_arena_new();
 	if (!pcm)
 		return -ENOMEM;
 	pcm->type = type;
 	if (name)
-		pcm->name = strdup(name);
+		pcm->name = snd_pcm_arena_strdup(pcm, name);
 	pcm->stream = stream;
 	pcm->mode = mode;
 	pcm->poll_fd_count = 1;
 	pcm->poll_fd = -1;
+	pcm->wait_fd = -1;
 	pcm->op_arg = pcm;
 	pcm->fast_op_arg = pcm;
 	INIT_LIST_HEAD(&pcm->async_handlers);
+	snd_pcm_trace_init_env();
 #ifdef THREAD_SAFE_API
 	pthread_mutex_init(&pcm->lock, NULL);
 	{
@@ -2551,10 +2780,20 @@ int snd_pcm_new(snd_pcm_t **pcmp, snd_pcm_type_t type, const char *name,
 			char *p = getenv("LIBASOUND_THREAD_SAFE");
 			default_thread_safe = !p || *p != '0';
 		}
-		if (!default_thread_safe)
+		if (!default_thread_safe || (mode & SND_PCM_NO_THREAD_SAFE))
 			pcm->thread_safe = -1; /* force to disable */
 	}
 #endif
+	{
+		static int default_stats = -1;
+		if (default_stats < 0) {
+			char *p = getenv("LIBASOUND_PCM_STATS");
+			default_stats = p && *p && *p != '0';
+		}
+		if (default_stats)
+			pcm->stats = calloc(SND_PCM_STAT_LAST + 1,
+					    sizeof(*pcm->stats));
+	}
 	*pcmp = pcm;
 	return 0;
 }
@@ -2562,14 +2801,14 @@ int snd_pcm_new(snd_pcm_t **pcmp, snd_pcm_type_t type, const char *name,
 int snd_pcm_free(snd_pcm_t *pcm)
 {
 	assert(pcm);
-	free(pcm->name);
 	free(pcm->hw.link_dst);
 	free(pcm->appl.link_dst);
+	free(pcm->stats);
 	snd_dlobj_cache_put(pcm->open_func);
 #ifdef THREAD_SAFE_API
 	pthread_mutex_destroy(&pcm->lock);
 #endif
-	free(pcm);
+	snd_pcm_arena_release(pcm);
 	return 0;
 }
 
@@ -2630,9 +2869,85 @@ int __snd_pcm_wait_in_lock(snd_pcm_t *pcm, int timeout)
 			return 1;
 		}
 	}
+	if (snd_pcm_trace_active) {
+		int err;
+
+		snd_pcm_trace(pcm, SND_PCM_TRACE_WAIT, timeout);
+		err = snd_pcm_wait_nocheck(pcm, timeout);
+		snd_pcm_trace(pcm, SND_PCM_TRACE_WAKEUP, err);
+		return err;
+	}
 	return snd_pcm_wait_nocheck(pcm, timeout);
 }
 
+/*
+ * Resolve the poll descriptor of the whole plugin chain once, at sw_params
+ * time.  This works when every layer merely forwards the poll callbacks to
+ * its slave (the generic helpers) down to a PCM using the single default
+ * descriptor; in that case the revents need no translation either.  Any
+ * plugin with its own poll callbacks keeps the full dispatch.
+ */
+static void snd_pcm_wait_resolve(snd_pcm_t *pcm)
+{
+	snd_pcm_t *p = pcm;
+	const snd_pcm_fast_ops_t *ops;
+	int depth;
+
+	pcm->wait_fd = -1;
+	for (depth = 0; depth < 32; depth++) {
+		ops = p->fast_ops;
+		if (!ops->poll_descriptors_count && !ops->poll_descriptors &&
+		    !ops->poll_revents) {
+			if (p->poll_fd < 0 || p->poll_fd_count != 1)
+				return;
+			pcm->wait_fd = p->poll_fd;
+			pcm->wait_events = p->poll_events;
+			return;
+		}
+		if (ops->poll_descriptors_count != snd_pcm_generic_poll_descriptors_count ||
+		    ops->poll_descriptors != snd_pcm_generic_poll_descriptors ||
+		    ops->poll_revents != snd_pcm_generic_poll_revents)
+			return;
+		p = ((snd_pcm_generic_t *)p->fast_op_arg->private_data)->slave;
+	}
+}
+
+/* snd_pcm_wait_nocheck() on the descriptor cached by snd_pcm_wait_resolve() */
+static int snd_pcm_wait_fd(snd_pcm_t *pcm, int timeout)
+{
+	struct pollfd pfd;
+	int err_poll;
+
+	pfd.fd = pcm->wait_fd;
+	pfd.events = pcm->wait_events | POLLERR | POLLNVAL;
+	do {
+		pfd.revents = 0;
+		__snd_pcm_unlock(pcm);
+		err_poll = poll(&pfd, 1, timeout);
+		__snd_pcm_lock(pcm);
+		if (err_poll < 0) {
+			if (errno == EINTR && !PCMINABORT(pcm))
+				continue;
+			return -errno;
+		}
+		if (!err_poll)
+			return 0;
+		if (pfd.revents & (POLLERR | POLLNVAL)) {
+			switch (__snd_pcm_state(pcm)) {
+			case SND_PCM_STATE_XRUN:
+				return -EPIPE;
+			case SND_PCM_STATE_SUSPENDED:
+				return -ESTRPIPE;
+			case SND_PCM_STATE_DISCONNECTED:
+				return -ENODEV;
+			default:
+				return -EIO;
+			}
+		}
+	} while (!(pfd.revents & (POLLIN | POLLOUT)));
+	return 1;
+}
+
 /* 
  * like snd_pcm_wait() but doesn't check mmap_avail before calling poll()
  *
@@ -2646,6 +2961,8 @@ int snd_pcm_wait_nocheck(snd_pcm_t *pcm, int timeout)
 	unsigned short revents = 0;
 	int npfds, err, err_poll;
 	
+	if (pcm->wait_fd >= 0)
+		return snd_pcm_wait_fd(pcm, timeout);
 	npfds = __snd_pcm_poll_descriptors_count(pcm);
 	if (npfds <= 0 || npfds >= 16) {
 		SNDERR("Invalid poll_fds %d\n", npfds);
@@ -2702,6 +3019,193 @@ int snd_pcm_wait_nocheck(snd_pcm_t *pcm, int timeout)
 }
 #endif
 
+#ifndef DOC_HIDDEN
+/* 1 if the PCM needs no wait, 0 if it has to be polled, or an error */
+static int snd_pcm_wait_all_ready(snd_pcm_t *pcm)
+{
+	snd_pcm_sframes_t avail;
+	int err = 0;
+
+	__snd_pcm_lock(pcm);
+	avail = __snd_pcm_avail_update(pcm);
+	if (avail < 0)
+		err = avail;
+	else if (!snd_pcm_may_wait_for_avail_min(pcm, avail)) {
+		switch (__snd_pcm_state(pcm)) {
+		case SND_PCM_STATE_XRUN:
+			err = -EPIPE;
+			break;
+		case SND_PCM_STATE_SUSPENDED:
+			err = -ESTRPIPE;
+			break;
+		case SND_PCM_STATE_DISCONNECTED:
+			err = -ENODEV;
+			break;
+		default:
+			err = 1;
+			break;
+		}
+	}
+	__snd_pcm_unlock(pcm);
+	return err;
+}
+#endif
+
+#ifndef DOC_HIDDEN
+/* timeout is in ms, deadline in ns of CLOCK_MONOTONIC for a positive one */
+static int snd_pcm_wait_all_rounds(snd_pcm_t **pcms, unsigned int count,
+				   int timeout, long long deadline)
+{
+	snd_htimestamp_t now;
+	int ready[count];
+	int nfds[count];
+	unsigned int i, pending, total;
+	int err;
+
+	for (;;) {
+		pending = 0;
+		total = 0;
+		for (i = 0; i < count; i++) {
+			err = snd_pcm_wait_all_ready(pcms[i]);
+			if (err < 0)
+				return err;
+			ready[i] = err;
+			nfds[i] = 0;
+			if (ready[i])
+				continue;
+			nfds[i] = snd_pcm_poll_descriptors_count(pcms[i]);
+			if (nfds[i] <= 0 || nfds[i] >= 16) {
+				SNDERR("Invalid poll_fds %d\n", nfds[i]);
+				return -EIO;
+			}
+			total += nfds[i];
+			pending++;
+		}
+		if (!pending)
+			return 1;
+		{
+			struct pollfd pfds[total];
+			struct pollfd *pfd = pfds;
+
+			for (i = 0; i < count; i++) {
+				if (ready[i])
+					continue;
+				err = snd_pcm_poll_descriptors(pcms[i], pfd, nfds[i]);
+				if (err < 0)
+					return err;
+				if (err != nfds[i]) {
+					SNDMSG("invalid poll descriptors %d\n", err);
+					return -EIO;
+				}
+				pfd += nfds[i];
+			}
+			/* the rounds share the timeout */
+			if (timeout > 0) {
+				long long left;
+
+				gettimestamp(&now, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+				left = deadline - now.tv_sec * 1000000000LL -
+					now.tv_nsec;
+				timeout = left > 0 ? (left + 999999) / 1000000 : 0;
+			}
+			err = poll(pfds, total, timeout);
+			if (err < 0) {
+				if (errno == EINTR)
+					continue;
+				return -errno;
+			}
+			if (!err)
+				return 0;
+			pfd = pfds;
+			for (i = 0; i < count; i++) {
+				unsigned short revents;
+
+				if (ready[i])
+					continue;
+				err = snd_pcm_poll_descriptors_revents(pcms[i], pfd,
+								       nfds[i],
+								       &revents);
+				if (err < 0)
+					return err;
+				if (revents & (POLLERR | POLLNVAL)) {
+					err = snd_pcm_wait_all_ready(pcms[i]);
+					return err < 0 ? err : -EIO;
+				}
+				pfd += nfds[i];
+			}
+		}
+		/* the readiness is checked again on the next round */
+	}
+}
+#endif
+
+/**
+ * \brief Wait for a set of PCMs to become ready
+ * \param pcms array of PCM handles
+ * \param count number of PCM handles
+ * \param timeout maximum time in milliseconds to wait,
+ *        a negative value means infinity
+ * \return a positive value on success otherwise a negative error code
+ *         of the first failing PCM (see #snd_pcm_wait())
+ * \retval 0 timeout occurred
+ * \retval 1 all PCM streams are ready for I/O
+ *
+ * The descriptors of all PCMs which are not ready yet are polled together
+ * with a single poll() call, so that e.g. a group of streams linked with
+ * #snd_pcm_link() is serviced at once instead of one device after another.
+ *
+ * The function is thread-safe when built with the proper option.
+ */
+int snd_pcm_wait_all(snd_pcm_t **pcms, unsigned int count, int timeout)
+{
+	snd_htimestamp_t now;
+	long long deadline = 0;
+
+	assert(pcms || !count);
+	if (!count)
+		return 1;
+	if (timeout > 0) {
+		gettimestamp(&now, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+		deadline = now.tv_sec * 1000000000LL + now.tv_nsec +
+			timeout * 1000000LL;
+	}
+	return snd_pcm_wait_all_rounds(pcms, count, timeout, deadline);
+}
+
+
+/**
+ * \brief Update the available frames of a set of PCMs
+ * \param pcms array of PCM handles
+ * \param count number of PCM handles
+ * \param avail optional array receiving the available frames of each PCM
+ * \return the smallest count of available frames, or a negative error
+ *         code of the first failing PCM
+ *
+ * Calls #snd_pcm_avail_update() on each handle.  The minimum is the
+ * amount which can be transferred on every stream of the set, keeping
+ * them at the same position.
+ *
+ * The function is thread-safe when built with the proper option.
+ */
+snd_pcm_sframes_t snd_pcm_avail_update_all(snd_pcm_t **pcms, unsigned int count,
+					   snd_pcm_sframes_t *avail)
+{
+	snd_pcm_sframes_t result = 0, a;
+	unsigned int i;
+
+	assert(pcms || !count);
+	for (i = 0; i < count; i++) {
+		a = snd_pcm_avail_update(pcms[i]);
+		if (a < 0)
+			return a;
+		if (avail)
+			avail[i] = a;
+		if (i == 0 || a < result)
+			result = a;
+	}
+	return result;
+}
+
 /**
  * \brief Return number of frames ready to be read (capture) / written (playback)
  * \param pcm PCM handle
@@ -2811,6 +3315,50 @@ int snd_pcm_avail_delay(snd_pcm_t *pcm,
 	return err;
 }
 
+/**
+ * \brief Obtain state, avail, delay and timestamps from one pointer update
+ * \param pcm PCM handle
+ * \param status Status container
+ * \return 0 on success otherwise a negative error code
+ *
+ * The state, avail, delay, tstamp and trigger_tstamp fields of the status
+ * container are filled from a single update of the ring buffer pointers,
+ * which are synchronized as with #snd_pcm_avail_update(). The hw plugin
+ * takes everything from one kernel call, the other plugins from one pass
+ * down to their slave. The audio timestamp is filled by the hw plugin only,
+ * using the configuration already set in the status container.
+ *
+ * The function reports the xrun and suspended states in the state field,
+ * it does not fail for them.
+ *
+ * The function is thread-safe when built with the proper option.
+ */
+int snd_pcm_avail_status(snd_pcm_t *pcm, snd_pcm_status_t *status)
+{
+	int err;
+
+	assert(pcm && status);
+	if (CHECK_SANITY(! pcm->setup)) {
+		SNDMSG("PCM not set up");
+		return -EIO;
+	}
+	snd_pcm_lock(pcm);
+	err = __snd_pcm_avail_status(pcm, status);
+	snd_pcm_unlock(pcm);
+	return err;
+}
+
+#ifndef DOC_HIDDEN
+/* for the plugins without own implementation: sync the pointers, then ask for the status */
+int __snd_pcm_avail_status(snd_pcm_t *pcm, snd_pcm_status_t *status)
+{
+	if (pcm->fast_ops->avail_status)
+		return pcm->fast_ops->avail_status(pcm->fast_op_arg, status);
+	__snd_pcm_avail_update(pcm);
+	return pcm->fast_ops->status(pcm->fast_op_arg, status);
+}
+#endif
+
 /**
  * \brief Silence an area
  * \param dst_area area specification
@@ -2830,8 +3378,14 @@ int snd_pcm_area_silence(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes
 	if (!dst_area->addr)
 		return 0;
 	dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
-	width = snd_pcm_format_physical_width(format);
-	silence = snd_pcm_format_silence_64(format);
+	width = __snd_pcm_format_physical_width(format);
+	silence = __snd_pcm_format_silence_64(format);
+	if (dst_area->step == (unsigned int) width && width >= 8) {
+		snd_pcm_silence_block_t blk;
+		snd_pcm_silence_block_init(&blk, width, silence);
+		snd_pcm_silence_fill(dst, (size_t)samples * width / 8, &blk);
+		return 0;
+	}
 	if (dst_area->step == (unsigned int) width) {
 		unsigned int dwords = samples * width / 64;
 		u_int64_t *dstp = (u_int64_t *)dst;
@@ -2882,15 +3436,18 @@ int snd_pcm_area_silence(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes
 		break;
 	}
 	case 24:
+		while (samples-- > 0) {
 #ifdef SNDRV_LITTLE_ENDIAN
-		*(dst + 0) = silence >> 0;
-		*(dst + 1) = silence >> 8;
-		*(dst + 2) = silence >> 16;
+			*(dst + 0) = silence >> 0;
+			*(dst + 1) = silence >> 8;
+			*(dst + 2) = silence >> 16;
 #else
-		*(dst + 2) = silence >> 0;
-		*(dst + 1) = silence >> 8;
-		*(dst + 0) = silence >> 16;
+			*(dst + 2) = silence >> 0;
+			*(dst + 1) = silence >> 8;
+			*(dst + 0) = silence >> 16;
 #endif
+			dst += dst_step;
+		}
 		break;
 	case 32: {
 		u_int32_t sil = silence;
@@ -2926,7 +3483,7 @@ int snd_pcm_area_silence(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes
 int snd_pcm_areas_silence(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
 			  unsigned int channels, snd_pcm_uframes_t frames, snd_pcm_format_t format)
 {
-	int width = snd_pcm_format_physical_width(format);
+	int width = __snd_pcm_format_physical_width(format);
 	while (channels > 0) {
 		void *addr = dst_areas->addr;
 		unsigned int step = dst_areas->step;
@@ -2952,6 +3509,19 @@ int snd_pcm_areas_silence(const snd_pcm_channel_area_t *dst_areas, snd_pcm_ufram
 			d.step = width;
 			err = snd_pcm_area_silence(&d, dst_offset * chns, frames * chns, format);
 			channels -= chns;
+		} else if (chns > 1 && begin->addr && width >= 8 &&
+			   begin->first % 8 == 0 && step % 8 == 0) {
+			/* Adjacent channels of a wider frame: one pass */
+			snd_pcm_silence_block_t blk;
+			char *dst = snd_pcm_channel_area_addr(begin, dst_offset);
+			size_t run = chns * width / 8;
+			snd_pcm_uframes_t f;
+			snd_pcm_silence_block_init(&blk, width,
+					   __snd_pcm_format_silence_64(format));
+			for (f = 0; f < frames; f++, dst += step / 8)
+				snd_pcm_silence_fill(dst, run, &blk);
+			err = 0;
+			channels -= chns;
 		} else {
 			err = snd_pcm_area_silence(begin, dst_offset, frames, format);
 			dst_areas = begin + 1;
@@ -2964,19 +3534,150 @@ int snd_pcm_areas_silence(const snd_pcm_channel_area_t *dst_areas, snd_pcm_ufram
 }
 
 
-/**
- * \brief Copy an area
- * \param dst_area destination area specification
- * \param dst_offset offset in frames inside destination area
- * \param src_area source area specification
- * \param src_offset offset in frames inside source area
- * \param samples samples to copy
- * \param format PCM sample format
- * \return 0 on success otherwise a negative error code
+#ifndef DOC_HIDDEN
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+
+/*
+ * Copy with non-temporal stores, for buffers which are only read by the
+ * device (e.g. the mmap buffer of a hw PCM): the written data does not
+ * evict the working set from the cache.  Small copies stay in memcpy.
  */
-int snd_pcm_area_copy(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes_t dst_offset,
-		      const snd_pcm_channel_area_t *src_area, snd_pcm_uframes_t src_offset,
-		      unsigned int samples, snd_pcm_format_t format)
+#define STREAM_COPY_MIN		16384
+
+static void stream_memcpy(char *dst, const char *src, size_t bytes)
+{
+	size_t head = (16 - ((unsigned long)dst & 15)) & 15;
+
+	memcpy(dst, src, head);
+	dst += head;
+	src += head;
+	bytes -= head;
+	for (; bytes >= 64; bytes -= 64, dst += 64, src += 64) {
+		__m128i a = _mm_loadu_si128((const __m128i *)src);
+		__m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+		__m128i c = _mm_loadu_si128((const __m128i *)(src + 32));
+		__m128i d = _mm_loadu_si128((const __m128i *)(src + 48));
+		_mm_stream_si128((__m128i *)dst, a);
+		_mm_stream_si128((__m128i *)(dst + 16), b);
+		_mm_stream_si128((__m128i *)(dst + 32), c);
+		_mm_stream_si128((__m128i *)(dst + 48), d);
+	}
+	_mm_sfence();
+	memcpy(dst, src, bytes);
+}
+
+static inline void area_memcpy(char *dst, const char *src, size_t bytes,
+			       int stream)
+{
+	if (stream && bytes >= STREAM_COPY_MIN)
+		stream_memcpy(dst, src, bytes);
+	else
+		memcpy(dst, src, bytes);
+}
+#else
+#define area_memcpy(dst, src, bytes, stream)	memcpy(dst, src, bytes)
+#endif
+
+/*
+ * Copy all channels block by block when the source and the destination
+ * have a different layout (interleaved <-> non-interleaved, or a channel
+ * reorder): the per-channel loops would walk through the whole interleaved
+ * buffer once for every channel, here each block of it stays in the cache
+ * while all channels are gathered or scattered.
+ */
+#define TRANSPOSE_BLOCK		256
+
+#define AREAS_TRANSPOSE(bits)						\
+static void areas_transpose##bits(void **dst, void **src,		\
+				  size_t dst_step, size_t src_step,	\
+				  snd_pcm_uframes_t frames,		\
+				  unsigned int channels)		\
+{									\
+	snd_pcm_uframes_t f0, f, n;					\
+	unsigned int c;							\
+									\
+	for (f0 = 0; f0 < frames; f0 += n) {				\
+		n = frames - f0;					\
+		if (n > TRANSPOSE_BLOCK)				\
+			n = TRANSPOSE_BLOCK;				\
+		for (c = 0; c < channels; c++) {			\
+			u_int##bits##_t *d = (u_int##bits##_t *)dst[c] + \
+				f0 * dst_step;				\
+			const u_int##bits##_t *s =			\
+				(const u_int##bits##_t *)src[c] +	\
+				f0 * src_step;				\
+			for (f = 0; f < n; f++)				\
+				d[f * dst_step] = s[f * src_step];	\
+		}							\
+	}								\
+}
+
+AREAS_TRANSPOSE(8)
+AREAS_TRANSPOSE(16)
+AREAS_TRANSPOSE(32)
+AREAS_TRANSPOSE(64)
+
+/* returns 0 when done, -EINVAL if the layout is not handled here */
+static int areas_transpose(const snd_pcm_channel_area_t *dst_areas,
+			   snd_pcm_uframes_t dst_offset,
+			   const snd_pcm_channel_area_t *src_areas,
+			   snd_pcm_uframes_t src_offset,
+			   unsigned int channels, snd_pcm_uframes_t frames,
+			   unsigned int width)
+{
+	unsigned int dst_step = dst_areas[0].step;
+	unsigned int src_step = src_areas[0].step;
+	void *dst[channels], *src[channels];
+	unsigned int c;
+
+	if (channels < 2 || frames < 16)
+		return -EINVAL;
+	switch (width) {
+	case 8: case 16: case 32: case 64:
+		break;
+	default:
+		return -EINVAL;
+	}
+	/* same contiguous or same interleaved layout: memcpy does better */
+	if (dst_step == src_step &&
+	    (dst_step == width ||
+	     (snd_pcm_areas_interleaved(dst_areas, channels, width) &&
+	      snd_pcm_areas_interleaved(src_areas, channels, width))))
+		return -EINVAL;
+	for (c = 0; c < channels; c++) {
+		if (!dst_areas[c].addr || !src_areas[c].addr ||
+		    src_areas[c].addr == dst_areas[c].addr ||
+		    dst_areas[c].step != dst_step ||
+		    src_areas[c].step != src_step ||
+		    dst_areas[c].first % width || src_areas[c].first % width)
+			return -EINVAL;
+		dst[c] = snd_pcm_channel_area_addr(&dst_areas[c], dst_offset);
+		src[c] = snd_pcm_channel_area_addr(&src_areas[c], src_offset);
+	}
+	if (dst_step % width || src_step % width)
+		return -EINVAL;
+	dst_step /= width;
+	src_step /= width;
+	switch (width) {
+	case 8:
+		areas_transpose8(dst, src, dst_step, src_step, frames, channels);
+		break;
+	case 16:
+		areas_transpose16(dst, src, dst_step, src_step, frames, channels);
+		break;
+	case 32:
+		areas_transpose32(dst, src, dst_step, src_step, frames, channels);
+		break;
+	case 64:
+		areas_transpose64(dst, src, dst_step, src_step, frames, channels);
+		break;
+	}
+	return 0;
+}
+static int area_copy(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes_t dst_offset,
+		     const snd_pcm_channel_area_t *src_area, snd_pcm_uframes_t src_offset,
+		     unsigned int samples, snd_pcm_format_t format, int stream)
 {
 	/* FIXME: sub byte resolution and odd dst_offset */
 	const char *src;
@@ -2991,14 +3692,14 @@ int snd_pcm_area_copy(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes_t
 	if (!dst_area->addr)
 		return 0;
 	dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
-	width = snd_pcm_format_physical_width(format);
+	width = __snd_pcm_format_physical_width(format);
 	if (src_area->step == (unsigned int) width &&
 	    dst_area->step == (unsigned int) width) {
 		size_t bytes = samples * width / 8;
 		samples -= bytes * 8 / width;
 		assert(src < dst || src >= dst + bytes);
 		assert(dst < src || dst >= src + bytes);
-		memcpy(dst, src, bytes);
+		area_memcpy(dst, src, bytes, stream);
 		if (samples == 0)
 			return 0;
 	}
@@ -3083,23 +3784,33 @@ int snd_pcm_area_copy(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes_t
 	}
 	return 0;
 }
+#endif /* DOC_HIDDEN */
 
 /**
- * \brief Copy one or more areas
- * \param dst_areas destination areas specification (one for each channel)
+ * \brief Copy an area
+ * \param dst_area destination area specification
  * \param dst_offset offset in frames inside destination area
- * \param src_areas source areas specification (one for each channel)
+ * \param src_area source area specification
  * \param src_offset offset in frames inside source area
- * \param channels channels count
- * \param frames frames to copy
+ * \param samples samples to copy
  * \param format PCM sample format
  * \return 0 on success otherwise a negative error code
  */
-int snd_pcm_areas_copy(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
-		       const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
-		       unsigned int channels, snd_pcm_uframes_t frames, snd_pcm_format_t format)
+int snd_pcm_area_copy(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes_t dst_offset,
+		      const snd_pcm_channel_area_t *src_area, snd_pcm_uframes_t src_offset,
+		      unsigned int samples, snd_pcm_format_t format)
+{
+	return area_copy(dst_area, dst_offset, src_area, src_offset,
+			 samples, format, 0);
+}
+
+#ifndef DOC_HIDDEN
+static int areas_copy(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+		      const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+		      unsigned int channels, snd_pcm_uframes_t frames, snd_pcm_format_t format,
+		      int stream)
 {
-	int width = snd_pcm_format_physical_width(format);
+	int width = __snd_pcm_format_physical_width(format);
 	assert(dst_areas);
 	assert(src_areas);
 	if (! channels) {
@@ -3110,6 +3821,9 @@ int snd_pcm_areas_copy(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_
 		SNDMSG("invalid frames %ld", frames);
 		return -EINVAL;
 	}
+	if (areas_transpose(dst_areas, dst_offset, src_areas, src_offset,
+			    channels, frames, width) == 0)
+		return 0;
 	while (channels > 0) {
 		unsigned int step = src_areas->step;
 		void *src_addr = src_areas->addr;
@@ -3143,15 +3857,15 @@ int snd_pcm_areas_copy(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_
 				d.addr = dst_start->addr;
 				d.first = dst_start->first;
 				d.step = width;
-				snd_pcm_area_copy(&d, dst_offset * chns,
-						  &s, src_offset * chns, 
-						  frames * chns, format);
+				area_copy(&d, dst_offset * chns,
+					  &s, src_offset * chns,
+					  frames * chns, format, stream);
 			}
 			channels -= chns;
 		} else {
-			snd_pcm_area_copy(dst_start, dst_offset,
-					  src_start, src_offset,
-					  frames, format);
+			area_copy(dst_start, dst_offset,
+				  src_start, src_offset,
+				  frames, format, stream);
 			src_areas = src_start + 1;
 			dst_areas = dst_start + 1;
 			channels--;
@@ -3159,6 +3873,40 @@ int snd_pcm_areas_copy(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_
 	}
 	return 0;
 }
+#endif /* DOC_HIDDEN */
+
+/**
+ * \brief Copy one or more areas
+ * \param dst_areas destination areas specification (one for each channel)
+ * \param dst_offset offset in frames inside destination area
+ * \param src_areas source areas specification (one for each channel)
+ * \param src_offset offset in frames inside source area
+ * \param channels channels count
+ * \param frames frames to copy
+ * \param format PCM sample format
+ * \return 0 on success otherwise a negative error code
+ */
+int snd_pcm_areas_copy(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+		       const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+		       unsigned int channels, snd_pcm_uframes_t frames, snd_pcm_format_t format)
+{
+	return areas_copy(dst_areas, dst_offset, src_areas, src_offset,
+			  channels, frames, format, 0);
+}
+
+#ifndef DOC_HIDDEN
+/*
+ * Same as snd_pcm_areas_copy(), but for destination buffers which are
+ * not read back by the CPU (the mmap buffer of a hw PCM).
+ */
+int snd_pcm_areas_copy_stream(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+			      const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+			      unsigned int channels, snd_pcm_uframes_t frames, snd_pcm_format_t format)
+{
+	return areas_copy(dst_areas, dst_offset, src_areas, src_offset,
+			  channels, frames, format, 1);
+}
+#endif
 
 static void dump_one_param(snd_pcm_hw_params_t *params, unsigned int k, snd_output_t *out)
 {
@@ -4609,6 +5357,9 @@ int snd_pcm_hw_params_get_export_buffer(snd_pcm_t *pcm, snd_pcm_hw_params_t *par
  * To check whether the hardware does support disabling period wakeups, call
  * #snd_pcm_hw_params_can_disable_period_wakeup(). If the hardware does not
  * support this mode, standard period wakeups will be generated.
+ * The plugins pass the setting down to their slave. The dmix, dsnoop and
+ * dshare plugins support it themselves, whatever the slave is, by dropping
+ * the period ticks of their slave timer.
  *
  * Even with disabled period wakeups, the period size/time/count parameters
  * are valid; it is suggested to use #snd_pcm_hw_params_set_period_size_last().
@@ -5868,7 +6619,7 @@ int snd_pcm_hw_params_get_min_align(const snd_pcm_hw_params_t *params, snd_pcm_u
 	if (err < 0)
 		return err;
 	// compute frame bits
-	fb = snd_pcm_format_physical_width((snd_pcm_format_t)format) * channels;
+	fb = __snd_pcm_format_physical_width((snd_pcm_format_t)format) * channels;
         min_align = 1;
 	while (fb % 8) {
 		fb *= 2;
@@ -7033,6 +7784,69 @@ snd_pcm_sframes_t snd_pcm_mmap_commit(snd_pcm_t *pcm,
 	return result;
 }
 
+/**
+ * \brief Application request to access the same portion of a set of PCMs
+ * \param pcms array of PCM handles
+ * \param count number of PCM handles
+ * \param areas array receiving the mmap areas of each PCM
+ * \param offsets array receiving the mmap offset of each PCM
+ * \param frames in: frames wanted, out: frames accessible on all PCMs
+ * \return 0 on success otherwise a negative error code of the first
+ *         failing PCM
+ *
+ * Like #snd_pcm_mmap_begin(), but *frames is the smallest contiguous
+ * amount over the set, so that the same count of frames can be committed
+ * with #snd_pcm_mmap_commit_all() on every stream.
+ */
+int snd_pcm_mmap_begin_all(snd_pcm_t **pcms, unsigned int count,
+			   const snd_pcm_channel_area_t **areas,
+			   snd_pcm_uframes_t *offsets,
+			   snd_pcm_uframes_t *frames)
+{
+	snd_pcm_uframes_t f, result = *frames;
+	unsigned int i;
+	int err;
+
+	assert(pcms || !count);
+	for (i = 0; i < count; i++) {
+		f = *frames;
+		err = snd_pcm_mmap_begin(pcms[i], &areas[i], &offsets[i], &f);
+		if (err < 0)
+			return err;
+		if (f < result)
+			result = f;
+	}
+	*frames = result;
+	return 0;
+}
+
+/**
+ * \brief Application has completed the access to the areas of a set of PCMs
+ * \param pcms array of PCM handles
+ * \param count number of PCM handles
+ * \param offsets the mmap offsets returned by #snd_pcm_mmap_begin_all()
+ * \param frames frames to commit on each PCM
+ * \return count of frames committed on all PCMs, otherwise a negative
+ *         error code of the first failing PCM
+ */
+snd_pcm_sframes_t snd_pcm_mmap_commit_all(snd_pcm_t **pcms, unsigned int count,
+					  const snd_pcm_uframes_t *offsets,
+					  snd_pcm_uframes_t frames)
+{
+	snd_pcm_sframes_t result = frames, r;
+	unsigned int i;
+
+	assert(pcms || !count);
+	for (i = 0; i < count; i++) {
+		r = snd_pcm_mmap_commit(pcms[i], offsets[i], frames);
+		if (r < 0)
+			return r;
+		if (r < result)
+			result = r;
+	}
+	return result;
+}
+
 #ifndef DOC_HIDDEN
 /* locked version*/
 snd_pcm_sframes_t __snd_pcm_mmap_commit(snd_pcm_t *pcm,
@@ -7050,6 +7864,15 @@ snd_pcm_sframes_t __snd_pcm_mmap_commit(snd_pcm_t *pcm,
 		       snd_pcm_mmap_avail(pcm));
 		return -EPIPE;
 	}
+	if (pcm->stats) {
+		snd_htimestamp_t start;
+		snd_pcm_sframes_t result;
+
+		snd_pcm_stat_start(&start);
+		result = pcm->fast_ops->mmap_commit(pcm->fast_op_arg, offset, frames);
+		snd_pcm_stat_update(pcm, SND_PCM_STAT_MMAP_COMMIT, &start);
+		return result;
+	}
 	return pcm->fast_ops->mmap_commit(pcm->fast_op_arg, offset, frames);
 }
 
@@ -7091,6 +7914,23 @@ void snd_pcm_areas_from_bufs(snd_pcm_t *pcm, snd_pcm_channel_area_t *areas,
 	snd_pcm_unlock(pcm);
 }
 
+static snd_pcm_sframes_t xfer_areas(snd_pcm_t *pcm, snd_pcm_stat_t stat,
+				    snd_pcm_xfer_areas_func_t func,
+				    const snd_pcm_channel_area_t *areas,
+				    snd_pcm_uframes_t offset,
+				    snd_pcm_uframes_t frames)
+{
+	snd_htimestamp_t start;
+	snd_pcm_sframes_t err;
+
+	if (!pcm->stats)
+		return func(pcm, areas, offset, frames);
+	snd_pcm_stat_start(&start);
+	err = func(pcm, areas, offset, frames);
+	snd_pcm_stat_update(pcm, stat, &start);
+	return err;
+}
+
 snd_pcm_sframes_t snd_pcm_read_areas(snd_pcm_t *pcm, const snd_pcm_channel_area_t *areas,
 				     snd_pcm_uframes_t offset, snd_pcm_uframes_t size,
 				     snd_pcm_xfer_areas_func_t func)
@@ -7159,7 +7999,8 @@ snd_pcm_sframes_t snd_pcm_read_areas(snd_pcm_t *pcm, const snd_pcm_channel_area_
 			frames = avail;
 		if (! frames)
 			break;
-		err = func(pcm, areas, offset, frames);
+		err = xfer_areas(pcm, SND_PCM_STAT_READ_AREAS, func,
+				 areas, offset, frames);
 		if (err < 0)
 			break;
 		frames = err;
@@ -7234,7 +8075,8 @@ snd_pcm_sframes_t snd_pcm_write_areas(snd_pcm_t *pcm, const snd_pcm_channel_area
 			frames = avail;
 		if (! frames)
 			break;
-		err = func(pcm, areas, offset, frames);
+		err = xfer_areas(pcm, SND_PCM_STAT_WRITE_AREAS, func,
+				 areas, offset, frames);
 		if (err < 0)
 			break;
 		frames = err;
@@ -7305,7 +8147,7 @@ int snd_pcm_slave_conf(snd_config_t *root, snd_config_t *conf,
 	assert(conf);
 	assert(_pcm_conf);
 	if (snd_config_get_string(conf, &str) >= 0) {
-		err = snd_config_search_definition(root, "pcm_slave", str, &conf);
+		err = snd_config_search_definition_shared(root, "pcm_slave", str, &conf);
 		if (err < 0) {
 			SNDERR("Invalid slave definition");
 			return -EINVAL;
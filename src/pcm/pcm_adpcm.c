@@ -211,6 +211,83 @@ static int adpcm_decoder(unsigned char code, snd_pcm_adpcm_state_t * state)
 	return (state->pred_val);
 }
 
+/*
+ * Interleaved engine: both sides interleaved and the linear side CPU endian
+ * S16.  The codes are one nibble stream walked frame by frame with the
+ * channel states in the inner loop, so nothing is fetched per channel.
+ */
+static int adpcm_decode_interleaved(const snd_pcm_channel_area_t *dst_areas,
+				    snd_pcm_uframes_t dst_offset,
+				    const snd_pcm_channel_area_t *src_areas,
+				    snd_pcm_uframes_t src_offset,
+				    unsigned int channels, snd_pcm_uframes_t frames,
+				    snd_pcm_adpcm_state_t *states)
+{
+	const unsigned char *src;
+	int16_t *dst;
+	unsigned int srcbit, channel;
+
+	if (!snd_pcm_areas_interleaved(src_areas, channels, 4) ||
+	    !snd_pcm_areas_interleaved(dst_areas, channels, 16))
+		return 0;
+	srcbit = src_areas->first + src_areas->step * src_offset;
+	if (srcbit % 4)
+		return 0;
+	src = (const unsigned char *) src_areas->addr + srcbit / 8;
+	srcbit %= 8;
+	dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+	while (frames-- > 0) {
+		for (channel = 0; channel < channels; channel++) {
+			unsigned char v;
+			if (srcbit) {
+				v = *src++ & 0x0f;
+				srcbit = 0;
+			} else {
+				v = (*src >> 4) & 0x0f;
+				srcbit = 4;
+			}
+			*dst++ = adpcm_decoder(v, &states[channel]);
+		}
+	}
+	return 1;
+}
+
+static int adpcm_encode_interleaved(const snd_pcm_channel_area_t *dst_areas,
+				    snd_pcm_uframes_t dst_offset,
+				    const snd_pcm_channel_area_t *src_areas,
+				    snd_pcm_uframes_t src_offset,
+				    unsigned int channels, snd_pcm_uframes_t frames,
+				    snd_pcm_adpcm_state_t *states)
+{
+	const int16_t *src;
+	unsigned char *dst;
+	unsigned int dstbit, channel;
+
+	if (!snd_pcm_areas_interleaved(src_areas, channels, 16) ||
+	    !snd_pcm_areas_interleaved(dst_areas, channels, 4))
+		return 0;
+	dstbit = dst_areas->first + dst_areas->step * dst_offset;
+	if (dstbit % 4)
+		return 0;
+	dst = (unsigned char *) dst_areas->addr + dstbit / 8;
+	dstbit %= 8;
+	src = snd_pcm_channel_area_addr(src_areas, src_offset);
+	while (frames-- > 0) {
+		for (channel = 0; channel < channels; channel++) {
+			int v = adpcm_encoder(*src++, &states[channel]);
+			if (dstbit) {
+				*dst = (*dst & 0xf0) | v;
+				dst++;
+				dstbit = 0;
+			} else {
+				*dst = (*dst & 0x0f) | (v << 4);
+				dstbit = 4;
+			}
+		}
+	}
+	return 1;
+}
+
 #ifndef DOC_HIDDEN
 
 void snd_pcm_adpcm_decode(const snd_pcm_channel_area_t *dst_areas,
@@ -226,6 +303,10 @@ void snd_pcm_adpcm_decode(const snd_pcm_channel_area_t *dst_areas,
 #undef PUT16_LABELS
 	void *put = put16_labels[putidx];
 	unsigned int channel;
+	if (putidx == snd_pcm_linear_put_index(SND_PCM_FORMAT_S16, SND_PCM_FORMAT_S16) &&
+	    adpcm_decode_interleaved(dst_areas, dst_offset, src_areas, src_offset,
+				     channels, frames, states))
+		return;
 	for (channel = 0; channel < channels; ++channel, ++states) {
 		const char *src;
 		int srcbit;
@@ -280,6 +361,10 @@ void snd_pcm_adpcm_encode(const snd_pcm_channel_area_t *dst_areas,
 	void *get = get16_labels[getidx];
 	unsigned int channel;
 	int16_t sample = 0;
+	if (getidx == snd_pcm_linear_get_index(SND_PCM_FORMAT_S16, SND_PCM_FORMAT_S16) &&
+	    adpcm_encode_interleaved(dst_areas, dst_offset, src_areas, src_offset,
+				     channels, frames, states))
+		return;
 	for (channel = 0; channel < channels; ++channel, ++states) {
 		const char *src;
 		char *dst;
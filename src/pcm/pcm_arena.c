@@ -0,0 +1,181 @@
+/*
+ *  PCM - per handle arena for setup time allocations
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * Memory which lives as long as the PCM handle is carved from chunks
+ * owned by the handle and released in one go by snd_pcm_free().  The
+ * handle itself lives in its first chunk.  Released chunks of the
+ * standard size are kept in a small process wide pool, so a PCM opened
+ * and closed over and over does not go back to malloc.
+ */
+
+#include "pcm_local.h"
+
+#ifndef DOC_HIDDEN
+
+#define ARENA_CHUNK_SIZE	(16 * 1024)
+#define ARENA_POOL_MAX		16
+#define ARENA_ALIGN		16
+
+struct snd_pcm_arena_chunk {
+	struct snd_pcm_arena_chunk *next;
+	size_t size;			/* usable bytes after the header */
+	size_t used;
+} __attribute__((aligned(ARENA_ALIGN)));
+
+static struct snd_pcm_arena_chunk *arena_pool;
+static unsigned int arena_pool_count;
+
+#ifdef THREAD_SAFE_API
+static pthread_mutex_t arena_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static inline void arena_pool_lock(void)
+{
+	pthread_mutex_lock(&arena_pool_mutex);
+}
+static inline void arena_pool_unlock(void)
+{
+	pthread_mutex_unlock(&arena_pool_mutex);
+}
+#else
+static inline void arena_pool_lock(void) {}
+static inline void arena_pool_unlock(void) {}
+#endif
+
+static inline void *chunk_data(struct snd_pcm_arena_chunk *chunk)
+{
+	return chunk + 1;
+}
+
+static struct snd_pcm_arena_chunk *chunk_get(size_t size)
+{
+	struct snd_pcm_arena_chunk *chunk = NULL;
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	if (size <= ARENA_CHUNK_SIZE) {
+		size = ARENA_CHUNK_SIZE;
+		arena_pool_lock();
+		chunk = arena_pool;
+		if (chunk) {
+			arena_pool = chunk->next;
+			arena_pool_count--;
+		}
+		arena_pool_unlock();
+	}
+	if (!chunk) {
+		chunk = malloc(sizeof(*chunk) + size);
+		if (!chunk)
+			return NULL;
+		chunk->size = size;
+	}
+	chunk->next = NULL;
+	chunk->used = 0;
+	return chunk;
+}
+
+static void chunk_put(struct snd_pcm_arena_chunk *chunk)
+{
+	if (chunk->size == ARENA_CHUNK_SIZE) {
+		arena_pool_lock();
+		if (arena_pool_count < ARENA_POOL_MAX) {
+			chunk->next = arena_pool;
+			arena_pool = chunk;
+			arena_pool_count++;
+			chunk = NULL;
+		}
+		arena_pool_unlock();
+	}
+	free(chunk);
+}
+
+static void *chunk_alloc(struct snd_pcm_arena_chunk *chunk, size_t size)
+{
+	void *ptr;
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	if (chunk->size - chunk->used < size)
+		return NULL;
+	ptr = (char *)chunk_data(chunk) + chunk->used;
+	chunk->used += size;
+	memset(ptr, 0, size);
+	return ptr;
+}
+
+/*
+ * Allocate a zeroed PCM handle from a fresh arena.  The handle is freed
+ * with the arena by snd_pcm_arena_release().
+ */
+snd_pcm_t *snd_pcm_arena_new(void)
+{
+	struct snd_pcm_arena_chunk *chunk;
+	snd_pcm_t *pcm;
+
+	chunk = chunk_get(sizeof(*pcm));
+	if (!chunk)
+		return NULL;
+	pcm = chunk_alloc(chunk, sizeof(*pcm));
+	pcm->arena = chunk;
+	return pcm;
+}
+
+/*
+ * Allocate zeroed memory living as long as the PCM handle.  It must not
+ * be passed to free(); snd_pcm_close() releases it.  Plugins use it for
+ * data set up once per handle.
+ */
+void *snd_pcm_arena_alloc(snd_pcm_t *pcm, size_t size)
+{
+	struct snd_pcm_arena_chunk *chunk = pcm->arena;
+	void *ptr;
+
+	ptr = chunk_alloc(chunk, size);
+	if (ptr)
+		return ptr;
+	/* the handle stays in the first chunk, add the new one behind it */
+	chunk = chunk_get(size);
+	if (!chunk)
+		return NULL;
+	chunk->next = pcm->arena->next;
+	pcm->arena->next = chunk;
+	return chunk_alloc(chunk, size);
+}
+
+/* duplicate a string into the arena of the PCM handle */
+char *snd_pcm_arena_strdup(snd_pcm_t *pcm, const char *str)
+{
+	size_t len = strlen(str) + 1;
+	char *dst;
+
+	dst = snd_pcm_arena_alloc(pcm, len);
+	if (dst)
+		memcpy(dst, str, len);
+	return dst;
+}
+
+/* free the arena together with the PCM handle living in it */
+void snd_pcm_arena_release(snd_pcm_t *pcm)
+{
+	struct snd_pcm_arena_chunk *chunk = pcm->arena, *next;
+
+	for (; chunk; chunk = next) {
+		next = chunk->next;
+		chunk_put(chunk);
+	}
+}
+
+#endif /* DOC_HIDDEN */
@@ -0,0 +1,297 @@
+/*
+ *  PCM - audio clock analyzer
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * The analyzer follows the hw pointer of a PCM against CLOCK_MONOTONIC
+ * with a second order delay locked loop.  Each status sample gives the
+ * position of the stream and the time it was taken; the loop predicts
+ * the time of that position from the filtered time of the previous
+ * sample and the estimated frame period, and corrects both with the
+ * prediction error.  The loop gains follow the interval between the
+ * samples, so the samples need not be regular, and the bandwidth sets
+ * how fast the estimates follow changes against how well the pointer
+ * jitter is filtered.
+ *
+ * The positions are those of the PCM itself, so a plugin is measured
+ * in its own frames; the timestamps are those of the status when they
+ * are monotonic, otherwise the time the status was read.
+ */
+
+#include "pcm_local.h"
+#include <math.h>
+
+#ifndef DOC_HIDDEN
+
+#define CLOCK_JITTER_TIME	1.0	/* seconds averaged for the jitter */
+
+struct _snd_pcm_clock {
+	snd_pcm_t *pcm;
+	double bandwidth;		/* of the loop in Hz */
+	double nominal;			/* rate of the setup */
+	int running;
+	snd_pcm_uframes_t hw_ptr;	/* at the last sample */
+	unsigned long long frames;	/* since the reset */
+	double time;			/* filtered time of the last sample */
+	double period;			/* estimated seconds per frame */
+	double jitter;			/* mean square error in seconds^2 */
+	double elapsed;			/* seconds since the reset */
+	unsigned long samples;
+};
+
+static double clock_ts(const snd_htimestamp_t *ts)
+{
+	return ts->tv_sec + ts->tv_nsec / 1e9;
+}
+
+static int clock_feed(snd_pcm_clock_t *clock, snd_pcm_uframes_t hw_ptr,
+		      double t)
+{
+	snd_pcm_t *pcm = clock->pcm;
+	snd_pcm_sframes_t delta;
+	double dt, e, w, b, c;
+
+	if (!clock->running) {
+		clock->running = 1;
+		clock->hw_ptr = hw_ptr;
+		clock->frames = 0;
+		clock->time = t;
+		clock->period = 1.0 / clock->nominal;
+		clock->jitter = 0;
+		clock->elapsed = 0;
+		clock->samples = 1;
+		return 1;
+	}
+	delta = hw_ptr - clock->hw_ptr;
+	if (delta < 0)
+		delta += pcm->boundary;
+	if (delta == 0)
+		return 0;
+	if ((snd_pcm_uframes_t)delta > pcm->buffer_size) {
+		/* lost track, e.g. after an xrun or a long stall */
+		clock->running = 0;
+		return clock_feed(clock, hw_ptr, t);
+	}
+	clock->hw_ptr = hw_ptr;
+	clock->frames += delta;
+	dt = delta * clock->period;
+	e = t - (clock->time + dt);
+	w = 2 * M_PI * clock->bandwidth * dt;
+	b = M_SQRT2 * w;
+	c = w * w;
+	if (b > 1)
+		b = 1;
+	clock->time += dt + b * e;
+	clock->period += c * e / delta;
+	clock->elapsed += dt;
+	/* mean square error over about CLOCK_JITTER_TIME */
+	w = dt / CLOCK_JITTER_TIME;
+	if (w > 1)
+		w = 1;
+	clock->jitter += (e * e - clock->jitter) * w;
+	clock->samples++;
+	return 1;
+}
+
+#endif /* DOC_HIDDEN */
+
+/**
+ * \brief Open an analyzer of the audio clock of a PCM
+ * \param clockp Returned analyzer handle
+ * \param pcm PCM handle, set up
+ * \param bandwidth Bandwidth of the loop in Hz, 0 for the default 0.1
+ * \return 0 on success otherwise a negative error code
+ *
+ * The analyzer estimates the actual frame rate of the PCM against
+ * CLOCK_MONOTONIC, the drift to the nominal rate and the jitter of the
+ * pointer updates.  The estimates follow frequency changes within
+ * about 1/\a bandwidth seconds.  It is fed by #snd_pcm_clock_update,
+ * outside of the stream there is nothing to measure.
+ *
+ * \sa snd_pcm_clock_update(), snd_pcm_clock_close()
+ */
+int snd_pcm_clock_open(snd_pcm_clock_t **clockp, snd_pcm_t *pcm,
+		       double bandwidth)
+{
+	snd_pcm_clock_t *clock;
+
+	assert(clockp && pcm);
+	if (CHECK_SANITY(! pcm->setup)) {
+		SNDMSG("PCM not set up");
+		return -EBADFD;
+	}
+	if (bandwidth < 0 || bandwidth > 10)
+		return -EINVAL;
+	clock = calloc(1, sizeof(*clock));
+	if (!clock)
+		return -ENOMEM;
+	clock->pcm = pcm;
+	clock->bandwidth = bandwidth ? bandwidth : 0.1;
+	clock->nominal = pcm->rate;
+	*clockp = clock;
+	return 0;
+}
+
+/**
+ * \brief Close an audio clock analyzer
+ * \param clock Analyzer handle
+ */
+void snd_pcm_clock_close(snd_pcm_clock_t *clock)
+{
+	free(clock);
+}
+
+/**
+ * \brief Restart the estimates of an audio clock analyzer
+ * \param clock Analyzer handle
+ *
+ * Call this when the stream was restarted, the next sample starts the
+ * measurement again from the nominal rate.
+ */
+void snd_pcm_clock_reset(snd_pcm_clock_t *clock)
+{
+	assert(clock);
+	clock->running = 0;
+	clock->samples = 0;
+}
+
+/**
+ * \brief Feed an audio clock analyzer with a status of its PCM
+ * \param clock Analyzer handle
+ * \param status Status of the PCM, NULL to read it
+ * \return 1 if the sample was used, 0 if the stream did not move or
+ *         does not run, otherwise a negative error code
+ *
+ * An application calling #snd_pcm_status anyway, e.g. once a period,
+ * passes that status, which costs nothing more.  The estimates restart
+ * when the stream is not running or lost more than a buffer.
+ */
+int snd_pcm_clock_update(snd_pcm_clock_t *clock, const snd_pcm_status_t *status)
+{
+	snd_pcm_status_t local;
+	snd_htimestamp_t ts;
+	snd_pcm_t *pcm;
+	int err;
+
+	assert(clock);
+	pcm = clock->pcm;
+	if (!status) {
+		err = snd_pcm_status(pcm, &local);
+		if (err < 0)
+			return err;
+		status = &local;
+	}
+	if (status->state != SND_PCM_STATE_RUNNING &&
+	    status->state != SND_PCM_STATE_DRAINING) {
+		clock->running = 0;
+		return 0;
+	}
+	if (pcm->tstamp_type != SND_PCM_TSTAMP_TYPE_GETTIMEOFDAY &&
+	    (status->tstamp.tv_sec || status->tstamp.tv_nsec)) {
+		ts = status->tstamp;
+	} else {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		ts = now;
+	}
+	return clock_feed(clock, status->hw_ptr, clock_ts(&ts));
+}
+
+/**
+ * \brief Get the estimated frame rate of the PCM
+ * \param clock Analyzer handle
+ * \return frames per second of CLOCK_MONOTONIC, the nominal rate
+ *         before the first samples
+ */
+double snd_pcm_clock_get_rate(const snd_pcm_clock_t *clock)
+{
+	assert(clock);
+	if (clock->samples < 2)
+		return clock->nominal;
+	return 1.0 / clock->period;
+}
+
+/**
+ * \brief Get the drift of the PCM clock to its nominal rate
+ * \param clock Analyzer handle
+ * \return parts per million the audio clock runs faster (positive) or
+ *         slower than the nominal rate
+ */
+double snd_pcm_clock_get_drift(const snd_pcm_clock_t *clock)
+{
+	return (snd_pcm_clock_get_rate(clock) / clock->nominal - 1) * 1e6;
+}
+
+/**
+ * \brief Get the jitter of the pointer updates of the PCM
+ * \param clock Analyzer handle
+ * \return root mean square deviation of the samples from the filtered
+ *         clock in microseconds, over about the last second
+ */
+double snd_pcm_clock_get_jitter(const snd_pcm_clock_t *clock)
+{
+	assert(clock);
+	return sqrt(clock->jitter) * 1e6;
+}
+
+/**
+ * \brief Get the time the stream is measured for
+ * \param clock Analyzer handle
+ * \param frames Returned frames since the measurement started, may be NULL
+ * \return seconds of the audio clock since the measurement started
+ *
+ * The estimates are poor before the loop settled, which takes a few
+ * times 1/bandwidth seconds.
+ */
+double snd_pcm_clock_get_elapsed(const snd_pcm_clock_t *clock,
+				 unsigned long long *frames)
+{
+	assert(clock);
+	if (frames)
+		*frames = clock->running ? clock->frames : 0;
+	return clock->running ? clock->elapsed : 0;
+}
+
+/**
+ * \brief Get the monotonic time of a position of the stream
+ * \param clock Analyzer handle
+ * \param frames Frames after the last sample, negative for before
+ * \param tstamp Returned CLOCK_MONOTONIC time of that position
+ * \return 0 on success, -EAGAIN before the first sample
+ *
+ * With the position of the last sample this predicts, for example,
+ * when the frames of the buffer will be played.
+ */
+int snd_pcm_clock_get_tstamp(const snd_pcm_clock_t *clock,
+			     snd_pcm_sframes_t frames,
+			     snd_htimestamp_t *tstamp)
+{
+	double t;
+
+	assert(clock && tstamp);
+	if (!clock->running)
+		return -EAGAIN;
+	t = clock->time + frames * clock->period;
+	tstamp->tv_sec = (time_t)t;
+	tstamp->tv_nsec = (long)((t - tstamp->tv_sec) * 1e9);
+	if (tstamp->tv_nsec < 0) {
+		tstamp->tv_sec--;
+		tstamp->tv_nsec += 1000000000;
+	}
+	return 0;
+}
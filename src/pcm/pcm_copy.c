@@ -104,6 +104,36 @@ static int snd_pcm_copy_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 				       snd_pcm_generic_hw_params);
 }
 
+/* snd_pcm_areas_copy() in blocks when the layouts differ */
+static void snd_pcm_copy_areas_blocked(const snd_pcm_channel_area_t *dst_areas,
+				       snd_pcm_uframes_t dst_offset,
+				       const snd_pcm_channel_area_t *src_areas,
+				       snd_pcm_uframes_t src_offset,
+				       unsigned int channels,
+				       snd_pcm_uframes_t frames,
+				       snd_pcm_format_t format)
+{
+	unsigned int width = snd_pcm_format_physical_width(format);
+	snd_pcm_uframes_t block;
+
+	if (channels == 1 ||
+	    (snd_pcm_areas_interleaved(src_areas, channels, width) &&
+	     snd_pcm_areas_interleaved(dst_areas, channels, width))) {
+		snd_pcm_areas_copy(dst_areas, dst_offset, src_areas, src_offset,
+				   channels, frames, format);
+		return;
+	}
+	block = snd_pcm_plugin_block_frames(channels, width);
+	while (frames > 0) {
+		snd_pcm_uframes_t n = frames > block ? block : frames;
+		snd_pcm_areas_copy(dst_areas, dst_offset, src_areas, src_offset,
+				   channels, n, format);
+		dst_offset += n;
+		src_offset += n;
+		frames -= n;
+	}
+}
+
 static snd_pcm_uframes_t
 snd_pcm_copy_write_areas(snd_pcm_t *pcm,
 			 const snd_pcm_channel_area_t *areas,
@@ -113,11 +143,18 @@ snd_pcm_copy_write_areas(snd_pcm_t *pcm,
 			 snd_pcm_uframes_t slave_offset,
 			 snd_pcm_uframes_t *slave_sizep)
 {
+	snd_pcm_copy_t *copy = pcm->private_data;
+
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	snd_pcm_areas_copy(slave_areas, slave_offset,
-			   areas, offset,
-			   pcm->channels, size, pcm->format);
+	if (copy->plug.gen.slave->type == SND_PCM_TYPE_HW)
+		snd_pcm_areas_copy_stream(slave_areas, slave_offset,
+					  areas, offset,
+					  pcm->channels, size, pcm->format);
+	else
+		snd_pcm_copy_areas_blocked(slave_areas, slave_offset,
+					   areas, offset,
+					   pcm->channels, size, pcm->format);
 	*slave_sizep = size;
 	return size;
 }
@@ -133,9 +170,9 @@ snd_pcm_copy_read_areas(snd_pcm_t *pcm,
 {
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	snd_pcm_areas_copy(areas, offset, 
-			   slave_areas, slave_offset,
-			   pcm->channels, size, pcm->format);
+	snd_pcm_copy_areas_blocked(areas, offset,
+				   slave_areas, slave_offset,
+				   pcm->channels, size, pcm->format);
 	*slave_sizep = size;
 	return size;
 }
@@ -0,0 +1,273 @@
+/*
+ *  PCM - descriptors of resolved chains
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * A descriptor holds what an open of a PCM looked up and what its setup
+ * chose, so that another process can open the same chain without the
+ * configuration work.  It is built by opening the PCM once with the
+ * definition log of conf.c recording: every definition the open, the
+ * hw_params and the sw_params of the chain searched, the PCMs, slaves,
+ * controls and plugin types, is kept as its expanded result, with the
+ * arguments and the functions already applied.  The defaults of the
+ * configuration follow for the plugins which read them directly.  The
+ * hw_params and sw_params stored are those installed, with a single
+ * value for each parameter.
+ *
+ * Opening a descriptor replays the log, so the definitions come from it
+ * without searching or expanding the configuration, and installs the
+ * stored parameters, which leaves nothing to choose.  The plugins still
+ * parse their own definitions and open their devices.  A descriptor is
+ * tied to the library version it was built with, since the parameter
+ * containers are stored as they are.
+ */
+
+#include <stdint.h>
+#include "pcm_local.h"
+
+#ifndef DOC_HIDDEN
+
+#define PCM_DESCRIPTOR_MAGIC	0x44435041	/* "APCD" */
+#define PCM_DESCRIPTOR_VERSION	1
+
+struct pcm_descriptor_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t lib_version;		/* SND_LIB_VERSION */
+	uint32_t stream;
+	uint32_t hw_params;		/* sizes of the parts which follow */
+	uint32_t sw_params;
+	uint32_t conf;
+	uint32_t reserved;
+};
+
+/* the parts start at multiples of 8 bytes */
+#define PCM_DESCRIPTOR_ALIGN(size)	(((size) + 7) & ~(size_t)7)
+
+/* the tree of the descriptor, which takes the log */
+static int descriptor_conf(snd_config_t **topp, const char *name,
+			   snd_config_t *log)
+{
+	snd_config_t *top, *root, *n, *defaults;
+	int err;
+
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = snd_config_imake_string(&n, "name", name);
+	if (err >= 0)
+		err = snd_config_add(top, n);
+	if (err < 0)
+		goto _err;
+	err = snd_config_update_ref(&root);
+	if (err < 0)
+		goto _err;
+	if (snd_config_search(root, "defaults", &n) >= 0) {
+		err = snd_config_copy(&defaults, n);
+		if (err >= 0) {
+			err = snd_config_add(top, defaults);
+			if (err < 0)
+				snd_config_delete(defaults);
+		}
+	}
+	snd_config_unref(root);
+	if (err >= 0)
+		err = snd_config_add(top, log);
+	if (err < 0)
+		goto _err;
+	*topp = top;
+	return 0;
+ _err:
+	snd_config_delete(log);
+	snd_config_delete(top);
+	return err;
+}
+
+#endif /* DOC_HIDDEN */
+
+/**
+ * \brief Build the descriptor of a resolved and set up PCM
+ * \param descp Returned descriptor, to be freed with free()
+ * \param sizep Returned size of the descriptor in bytes
+ * \param name Name of the PCM
+ * \param stream Wanted stream
+ * \param mode Open mode (see #SND_PCM_NONBLOCK, #SND_PCM_ASYNC)
+ * \param hw_params Hardware parameters to install
+ * \param sw_params Software parameters to install, NULL for the defaults
+ *        of hw_params
+ * \return 0 on success otherwise a negative error code
+ *
+ * The PCM is opened and set up once to find out what the chain uses and
+ * chooses, and closed again.  The descriptor is a block of bytes which
+ * can be stored or sent to another process using the same library, for
+ * #snd_pcm_open_descriptor.  The hardware parameters are a configuration
+ * space like for #snd_pcm_hw_params, e.g. from #snd_pcm_hw_params_any
+ * and the snd_pcm_hw_params_set functions on a handle of the same PCM.
+ */
+int snd_pcm_descriptor_create(void **descp, size_t *sizep, const char *name,
+			      snd_pcm_stream_t stream, int mode,
+			      const snd_pcm_hw_params_t *hw_params,
+			      const snd_pcm_sw_params_t *sw_params)
+{
+	struct pcm_descriptor_header hdr;
+	snd_pcm_hw_params_t hw = *hw_params;
+	snd_pcm_sw_params_t sw;
+	snd_config_t *log, *top = NULL;
+	snd_pcm_t *pcm = NULL;
+	void *conf = NULL;
+	size_t conf_size = 0, size;
+	char *desc;
+	int err;
+
+	assert(descp && sizep && name && hw_params);
+	err = snd_config_make_compound(&log, "definitions", 0);
+	if (err < 0)
+		return err;
+	snd_config_definition_log(log, 0);
+	err = snd_pcm_open(&pcm, name, stream, mode);
+	if (err >= 0) {
+		err = snd_pcm_hw_params(pcm, &hw);
+		if (err >= 0 && sw_params) {
+			sw = *sw_params;
+			err = snd_pcm_sw_params(pcm, &sw);
+		}
+		if (err >= 0)
+			err = snd_pcm_sw_params_current(pcm, &sw);
+		/* hw holds the installed choice now, refined again on open */
+		hw.rmask = ~0U;
+	}
+	snd_config_definition_log(NULL, 0);
+	if (err >= 0) {
+		snd_pcm_close(pcm);
+		pcm = NULL;
+		err = descriptor_conf(&top, name, log);
+		log = NULL;
+	} else if (pcm) {
+		snd_pcm_close(pcm);
+	}
+	if (err >= 0)
+		err = snd_config_pack(top, &conf, &conf_size);
+	if (log)
+		snd_config_delete(log);
+	if (top)
+		snd_config_delete(top);
+	if (err < 0)
+		return err;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = PCM_DESCRIPTOR_MAGIC;
+	hdr.version = PCM_DESCRIPTOR_VERSION;
+	hdr.lib_version = SND_LIB_VERSION;
+	hdr.stream = stream;
+	hdr.hw_params = sizeof(hw);
+	hdr.sw_params = sizeof(sw);
+	hdr.conf = conf_size;
+	size = sizeof(hdr) + PCM_DESCRIPTOR_ALIGN(sizeof(hw)) +
+		PCM_DESCRIPTOR_ALIGN(sizeof(sw)) + conf_size;
+	desc = calloc(1, size);
+	if (!desc) {
+		free(conf);
+		return -ENOMEM;
+	}
+	memcpy(desc, &hdr, sizeof(hdr));
+	memcpy(desc + sizeof(hdr), &hw, sizeof(hw));
+	memcpy(desc + sizeof(hdr) + PCM_DESCRIPTOR_ALIGN(sizeof(hw)), &sw,
+	       sizeof(sw));
+	memcpy(desc + size - conf_size, conf, conf_size);
+	free(conf);
+	*descp = desc;
+	*sizep = size;
+	return 0;
+}
+
+/**
+ * \brief Open a PCM from a descriptor
+ * \param pcmp Returned PCM handle, set up and prepared
+ * \param desc Descriptor from #snd_pcm_descriptor_create
+ * \param size Size of the descriptor in bytes
+ * \param mode Open mode (see #SND_PCM_NONBLOCK, #SND_PCM_ASYNC)
+ * \return 0 on success otherwise a negative error code, -EINVAL for a
+ *         descriptor of another library version
+ *
+ * The chain is rebuilt from the definitions in the descriptor without
+ * searching and expanding the configuration, and gets the parameters
+ * which were chosen for the descriptor.  A device which cannot take
+ * them anymore, e.g. after it was replaced, fails the open; build the
+ * descriptor again in that case.
+ */
+int snd_pcm_open_descriptor(snd_pcm_t **pcmp, const void *desc, size_t size,
+			    int mode)
+{
+	struct pcm_descriptor_header hdr;
+	snd_pcm_hw_params_t hw;
+	snd_pcm_sw_params_t sw;
+	snd_config_t *top, *log, *n;
+	const char *name;
+	const char *p = desc;
+	void *conf;
+	size_t off;
+	int err;
+
+	assert(pcmp && desc);
+	if (size < sizeof(hdr))
+		return -EINVAL;
+	memcpy(&hdr, p, sizeof(hdr));
+	off = sizeof(hdr) + PCM_DESCRIPTOR_ALIGN(sizeof(hw)) +
+		PCM_DESCRIPTOR_ALIGN(sizeof(sw));
+	if (hdr.magic != PCM_DESCRIPTOR_MAGIC ||
+	    hdr.version != PCM_DESCRIPTOR_VERSION ||
+	    hdr.lib_version != SND_LIB_VERSION ||
+	    hdr.stream > SND_PCM_STREAM_LAST ||
+	    hdr.hw_params != sizeof(hw) || hdr.sw_params != sizeof(sw) ||
+	    size != off + hdr.conf)
+		return -EINVAL;
+	memcpy(&hw, p + sizeof(hdr), sizeof(hw));
+	memcpy(&sw, p + sizeof(hdr) + PCM_DESCRIPTOR_ALIGN(sizeof(hw)),
+	       sizeof(sw));
+	/* the packed nodes are read in place, from an aligned copy */
+	conf = malloc(hdr.conf);
+	if (!conf)
+		return -ENOMEM;
+	memcpy(conf, p + off, hdr.conf);
+	err = snd_config_top(&top);
+	if (err < 0) {
+		free(conf);
+		return err;
+	}
+	err = snd_config_unpack(top, conf, hdr.conf);
+	free(conf);
+	if (err < 0 ||
+	    snd_config_search(top, "name", &n) < 0 ||
+	    snd_config_get_string(n, &name) < 0 ||
+	    snd_config_search(top, "definitions", &log) < 0) {
+		snd_config_delete(top);
+		return -EINVAL;
+	}
+	snd_config_definition_log(log, 1);
+	err = snd_pcm_open_lconf(pcmp, name, hdr.stream, mode, top);
+	if (err >= 0) {
+		err = snd_pcm_hw_params(*pcmp, &hw);
+		if (err >= 0)
+			err = snd_pcm_sw_params(*pcmp, &sw);
+		if (err < 0)
+			snd_pcm_close(*pcmp);
+	}
+	snd_config_definition_log(NULL, 0);
+	snd_config_delete(top);
+	return err;
+}
@@ -38,6 +38,9 @@
 #include <sys/stat.h>
 #include <sys/un.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 #include "pcm_direct.h"
 
 /*
@@ -412,6 +415,7 @@ static void server_job(snd_pcm_direct_t *dmix)
 
 int snd_pcm_direct_server_create(snd_pcm_direct_t *dmix)
 {
+	snd_thread_sched_t sched;
 	int ret;
 
 	dmix->server_fd = -1;
@@ -431,14 +435,18 @@ int snd_pcm_direct_server_create(snd_pcm_direct_t *dmix)
 		return ret;
 	}
 	
+	/* taken before the fork, the child must not touch the config lock */
+	snd_thread_sched_get(&sched);
 	ret = fork();
 	if (ret < 0) {
 		close(dmix->server_fd);
 		return ret;
 	} else if (ret == 0) {
 		ret = fork();
-		if (ret == 0)
+		if (ret == 0) {
+			snd_thread_sched_apply_self(&sched);
 			server_job(dmix);
+		}
 		_exit(EXIT_SUCCESS);
 	} else {
 		waitpid(ret, NULL, 0);
@@ -448,6 +456,82 @@ int snd_pcm_direct_server_create(snd_pcm_direct_t *dmix)
 	return 0;
 }
 
+/*
+ * linger: when the last client closes, a detached helper process keeps
+ * the slave fd and the shared memory for dmix->linger ms, so that a client
+ * opened meanwhile takes the fast secondary path instead of setting up the
+ * hardware again; the slave runs on the silence filled in by the driver
+ */
+static void linger_job(snd_pcm_direct_t *dmix, int hw_fd,
+		       void (*linger_free)(snd_pcm_direct_t *dmix))
+{
+	struct timespec ts;
+	struct shmid_ds buf;
+	int i;
+
+	i = sysconf(_SC_OPEN_MAX);
+	while (--i >= 0) {
+		if (i != hw_fd)
+			close(i);
+	}
+	setsid();
+	ts.tv_sec = dmix->linger / 1000;
+	ts.tv_nsec = (dmix->linger % 1000) * 1000000L;
+	while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+		;
+	if (snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT) < 0)
+		_exit(EXIT_SUCCESS);
+	if (shmctl(dmix->shmid, IPC_STAT, &buf) < 0 || buf.shm_nattch != 1) {
+		/* a new client took over, it cleans up after itself */
+		snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
+		_exit(EXIT_SUCCESS);
+	}
+	close(hw_fd);
+	if (linger_free)
+		linger_free(dmix);
+	if (_snd_pcm_direct_shm_discard(dmix)) {
+		if (snd_pcm_direct_semaphore_discard(dmix))
+			snd_pcm_direct_semaphore_final(dmix, DIRECT_IPC_SEM_CLIENT);
+	} else
+		snd_pcm_direct_semaphore_final(dmix, DIRECT_IPC_SEM_CLIENT);
+	_exit(EXIT_SUCCESS);
+}
+
+/* called from close with DIRECT_IPC_SEM_CLIENT held, before the slave is closed */
+void snd_pcm_direct_linger(snd_pcm_direct_t *dmix,
+			   void (*linger_free)(snd_pcm_direct_t *dmix))
+{
+	struct shmid_ds buf;
+	struct pollfd pfd;
+	pid_t pid;
+
+	if (dmix->linger <= 0 || !dmix->spcm || dmix->shmptr->use_server)
+		return;
+	/* only for the last client */
+	if (shmctl(dmix->shmid, IPC_STAT, &buf) < 0 || buf.shm_nattch != 1)
+		return;
+	switch (snd_pcm_state(dmix->spcm)) {
+	case SND_PCM_STATE_PREPARED:
+	case SND_PCM_STATE_RUNNING:
+		break;
+	default:
+		return;
+	}
+	if (snd_pcm_poll_descriptors(dmix->spcm, &pfd, 1) != 1)
+		return;
+	pid = fork();
+	if (pid < 0) {
+		SYSMSG("fork failed, not lingering");
+		return;
+	}
+	if (pid == 0) {
+		if (fork() == 0)
+			linger_job(dmix, pfd.fd, linger_free);
+		_exit(EXIT_SUCCESS);
+	}
+	waitpid(pid, NULL, 0);
+}
+
 int snd_pcm_direct_server_discard(snd_pcm_direct_t *dmix)
 {
 	if (dmix->server) {
@@ -541,14 +625,62 @@ void snd_pcm_direct_clear_timer_queue(snd_pcm_direct_t *dmix)
 				;
 		}
 	}
+	if (dmix->slice_fd >= 0) {
+		uint64_t expirations;
+		/* only the readiness matters, not the count */
+		if (read(dmix->slice_fd, &expirations, sizeof(expirations)) < 0)
+			return;
+	}
+}
+
+/* arm the sub-period timer; a zero interval disarms it */
+static void snd_pcm_direct_set_slices(snd_pcm_direct_t *dmix, long interval)
+{
+	struct itimerspec its;
+
+	its.it_interval.tv_sec = interval / 1000000000L;
+	its.it_interval.tv_nsec = interval % 1000000000L;
+	its.it_value = its.it_interval;
+	timerfd_settime(dmix->slice_fd, 0, &its, NULL);
+}
+
+int snd_pcm_direct_timer_start(snd_pcm_direct_t *dmix)
+{
+	int err;
+
+	err = snd_timer_start(dmix->timer);
+	if (err < 0)
+		return err;
+	if (dmix->slice_fd >= 0 && !dmix->no_period_wakeup)
+		snd_pcm_direct_set_slices(dmix,
+			(long)((unsigned long long)dmix->slave_period_size *
+			       1000000000ULL /
+			       ((unsigned long long)dmix->shmptr->s.rate *
+				dmix->timer_slices)));
+	return 0;
 }
 
 int snd_pcm_direct_timer_stop(snd_pcm_direct_t *dmix)
 {
 	snd_timer_stop(dmix->timer);
+	if (dmix->slice_fd >= 0)
+		snd_pcm_direct_set_slices(dmix, 0);
 	return 0;
 }
 
+void snd_pcm_direct_timer_close(snd_pcm_direct_t *dmix)
+{
+	if (dmix->timer)
+		snd_timer_close(dmix->timer);
+	dmix->timer = NULL;
+	if (dmix->slice_fd >= 0)
+		close(dmix->slice_fd);
+	dmix->slice_fd = -1;
+	if (dmix->epoll_fd >= 0)
+		close(dmix->epoll_fd);
+	dmix->epoll_fd = -1;
+}
+
 int snd_pcm_direct_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsigned int nfds, unsigned short *revents)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
@@ -596,6 +728,26 @@ int snd_pcm_direct_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsigned in
 	return 0;
 }
 
+/*
+ * avail_status after a sync_ptr: everything comes from the pointers just
+ * synced and the status page of the slave, no status call on the slave
+ */
+void snd_pcm_direct_fill_avail_status(snd_pcm_t *pcm, snd_pcm_status_t *status)
+{
+	snd_pcm_direct_t *dmix = pcm->private_data;
+
+	memset(status, 0, sizeof(*status));
+	status->state = __snd_pcm_state(pcm);
+	status->trigger_tstamp = dmix->trigger_tstamp;
+	status->tstamp = snd_pcm_hw_fast_tstamp(dmix->spcm);
+	status->avail = snd_pcm_mmap_avail(pcm);
+	status->avail_max = status->avail > dmix->avail_max ? status->avail : dmix->avail_max;
+	dmix->avail_max = 0;
+	status->delay = snd_pcm_mmap_delay(pcm);
+	status->appl_ptr = *pcm->appl.ptr;
+	status->hw_ptr = *pcm->hw.ptr;
+}
+
 int snd_pcm_direct_info(snd_pcm_t *pcm, snd_pcm_info_t * info)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
@@ -748,6 +900,9 @@ int snd_pcm_direct_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		} while (changed);
 	}
 	params->info = dshare->shmptr->s.info;
+	/* the ticks can be filtered out of the timer queue */
+	if (dshare->tread)
+		params->info |= SND_PCM_INFO_NO_PERIOD_WAKEUP;
 #ifdef REFINE_DEBUG
 	snd_output_puts(log, "DMIX REFINE (end):\n");
 	snd_pcm_hw_params_dump(params, log);
@@ -761,6 +916,10 @@ int snd_pcm_direct_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	snd_pcm_direct_t *dmix = pcm->private_data;
 
 	params->info = dmix->shmptr->s.info;
+	if (dmix->tread)
+		params->info |= SND_PCM_INFO_NO_PERIOD_WAKEUP;
+	dmix->no_period_wakeup = dmix->tread &&
+		(params->flags & SND_PCM_HW_PARAMS_NO_PERIOD_WAKEUP);
 	params->rate_num = dmix->shmptr->s.rate;
 	params->rate_den = 1;
 	params->fifo_size = 0;
@@ -813,11 +972,61 @@ int snd_pcm_direct_set_chmap(snd_pcm_t *pcm, const snd_pcm_chmap_t *map)
 	return snd_pcm_set_chmap(dmix->spcm, map);
 }
 
+/*
+ * hwsync the slave unless another client did it within hwsync_window us;
+ * the kernel status page they share holds the refreshed hw_ptr then, so
+ * N clients polling the same period cost one ioctl instead of N
+ */
+int snd_pcm_direct_hwsync(snd_pcm_direct_t *dmix)
+{
+	snd_pcm_direct_share_t *shm = dmix->shmptr;
+	struct timespec ts;
+	unsigned long long now;
+	int err;
+
+	if (dmix->hwsync_window <= 0 || !snd_pcm_hw_status_shared(dmix->spcm))
+		return snd_pcm_hwsync(dmix->spcm);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	if (now - __atomic_load_n(&shm->hwsync_ns, __ATOMIC_ACQUIRE) <
+	    dmix->hwsync_window * 1000ULL)
+		return 0;
+	err = snd_pcm_hwsync(dmix->spcm);
+	if (err >= 0)
+		__atomic_store_n(&shm->hwsync_ns, now, __ATOMIC_RELEASE);
+	return err;
+}
+
+/*
+ * Restart a playback client right after its xrun while the slave plays
+ * on: the frames of silence ahead of the current slave position are
+ * mixed at once, so the data of the application follows them without
+ * waiting for the start threshold or a period boundary.
+ */
+static int snd_pcm_direct_rejoin(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
+{
+	snd_pcm_direct_t *dmix = pcm->private_data;
+	int err;
+
+	if (frames > pcm->period_size)
+		frames = pcm->period_size;
+	snd_pcm_areas_silence(snd_pcm_mmap_areas(pcm), 0, pcm->channels,
+			      frames, pcm->format);
+	dmix->appl_ptr = dmix->last_appl_ptr = frames;
+	dmix->rejoin = 1;
+	err = pcm->fast_ops->start(pcm->fast_op_arg);
+	dmix->rejoin = 0;
+	return err;
+}
+
 int snd_pcm_direct_prepare(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
+	snd_pcm_uframes_t rejoin = 0;
 	int err;
 
+	if (dmix->fast_recover && dmix->state == SND_PCM_STATE_XRUN)
+		rejoin = dmix->fast_recover;
 	switch (snd_pcm_state(dmix->spcm)) {
 	case SND_PCM_STATE_SETUP:
 	case SND_PCM_STATE_XRUN:
@@ -826,6 +1035,8 @@ int snd_pcm_direct_prepare(snd_pcm_t *pcm)
 		if (err < 0)
 			return err;
 		snd_pcm_start(dmix->spcm);
+		/* the slave restarts, nothing to rejoin */
+		rejoin = 0;
 		break;
 	case SND_PCM_STATE_OPEN:
 	case SND_PCM_STATE_DISCONNECTED:
@@ -837,7 +1048,10 @@ int snd_pcm_direct_prepare(snd_pcm_t *pcm)
 	dmix->state = SND_PCM_STATE_PREPARED;
 	dmix->appl_ptr = dmix->last_appl_ptr = 0;
 	dmix->hw_ptr = 0;
-	return snd_pcm_direct_set_timer_params(dmix);
+	err = snd_pcm_direct_set_timer_params(dmix);
+	if (err < 0 || !rejoin)
+		return err;
+	return snd_pcm_direct_rejoin(pcm, rejoin);
 }
 
 int snd_pcm_direct_resume(snd_pcm_t *pcm)
@@ -906,6 +1120,92 @@ static void save_slave_setting(snd_pcm_direct_t *dmix, snd_pcm_t *spcm)
 
 #undef COPY_SLAVE
 
+/*
+ * set up the mixing lock, by the first client; the kernel marks it with
+ * FUTEX_OWNER_DIED when the owner dies holding it, whatever its pid is
+ * by then, and the next locker gets EOWNERDEAD
+ */
+int snd_pcm_direct_futex_init(snd_pcm_direct_t *dmix)
+{
+#ifdef DIRECT_HAVE_FUTEX
+	pthread_mutexattr_t attr;
+	int err;
+
+	pthread_mutexattr_init(&attr);
+	err = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	if (!err)
+		err = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	if (!err)
+		err = pthread_mutex_init(&dmix->shmptr->mix_lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+	return -err;
+#else
+	return -ENOSYS;
+#endif
+}
+
+/* the lock was taken over from a client which died holding it */
+void snd_pcm_direct_futex_recover(snd_pcm_direct_t *dmix)
+{
+#ifdef DIRECT_HAVE_FUTEX
+	SNDMSG("dmix lock owner died, recovering");
+	pthread_mutex_consistent(&dmix->shmptr->mix_lock);
+#endif
+}
+
+/*
+ * extra shmget() flags for the data segments (the dmix sum buffer)
+ */
+int snd_pcm_direct_shm_flags(snd_pcm_direct_t *dmix)
+{
+	return dmix->hugepages ? SHM_HUGETLB : 0;
+}
+
+#ifndef DOC_HIDDEN
+#define DIRECT_MPOL_PREFERRED	1
+#define DIRECT_MPOL_MF_MOVE	(1 << 1)
+#endif
+
+/*
+ * prefer the memory of the card's NUMA node for an attached segment;
+ * pages touched already are migrated
+ */
+void snd_pcm_direct_shm_bind(snd_pcm_direct_t *dmix, void *addr, size_t size)
+{
+#ifdef __NR_mbind
+	unsigned long mask;
+
+	if (dmix->numa_node < 0 ||
+	    dmix->numa_node >= (int)sizeof(mask) * 8)
+		return;
+	mask = 1UL << dmix->numa_node;
+	if (syscall(__NR_mbind, addr, size, DIRECT_MPOL_PREFERRED, &mask,
+		    sizeof(mask) * 8, DIRECT_MPOL_MF_MOVE) < 0)
+		SYSMSG("mbind to NUMA node %d failed", dmix->numa_node);
+#endif
+}
+
+/* NUMA node of the sound card device from sysfs, -1 if not known */
+static int snd_pcm_direct_card_node(snd_pcm_t *spcm)
+{
+	snd_pcm_info_t info;
+	char path[64];
+	FILE *fp;
+	int node = -1;
+
+	if (snd_pcm_info(spcm, &info) < 0 || snd_pcm_info_get_card(&info) < 0)
+		return -1;
+	snprintf(path, sizeof(path), "/sys/class/sound/card%d/device/numa_node",
+		 snd_pcm_info_get_card(&info));
+	fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+	if (fscanf(fp, "%d", &node) != 1)
+		node = -1;
+	fclose(fp);
+	return node;
+}
+
 /*
  * this function initializes hardware and starts playback operation with
  * no stop threshold (it operates all time without xrun checking)
@@ -956,6 +1256,7 @@ int snd_pcm_direct_initialize_slave(snd_pcm_direct_t *dmix, snd_pcm_t *spcm, str
 			SND_PCM_FORMAT_S24_LE,
 			SND_PCM_FORMAT_S24_3LE,
 			SND_PCM_FORMAT_U8,
+			SND_PCM_FORMAT_FLOAT,
 		};
 		snd_pcm_format_t format;
 		unsigned int i;
@@ -1165,9 +1466,48 @@ int snd_pcm_direct_initialize_slave(snd_pcm_direct_t *dmix, snd_pcm_t *spcm, str
 			dmix->shmptr->use_server = 1;
 	}
 
+	if (dmix->numa_bind) {
+		dmix->numa_node = snd_pcm_direct_card_node(spcm);
+		snd_pcm_direct_shm_bind(dmix, dmix->shmptr,
+					sizeof(snd_pcm_direct_share_t));
+	}
+
 	return 0;
 }
 
+/*
+ * the slave timer ticks once per slave period; for more frequent wakeups
+ * a timerfd firing timer_slices times per period is joined with the timer
+ * into an epoll fd, which then serves as poll_fd
+ */
+static void snd_pcm_direct_initialize_slices(snd_pcm_direct_t *dmix)
+{
+	struct epoll_event ev;
+
+	dmix->slice_fd = timerfd_create(CLOCK_MONOTONIC,
+					TFD_NONBLOCK | TFD_CLOEXEC);
+	if (dmix->slice_fd < 0)
+		goto _err;
+	dmix->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (dmix->epoll_fd < 0)
+		goto _err;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	if (epoll_ctl(dmix->epoll_fd, EPOLL_CTL_ADD, dmix->timer_fd.fd, &ev) < 0 ||
+	    epoll_ctl(dmix->epoll_fd, EPOLL_CTL_ADD, dmix->slice_fd, &ev) < 0)
+		goto _err;
+	dmix->poll_fd = dmix->epoll_fd;
+	return;
+
+ _err:
+	SYSMSG("unable to set up timer_slices, using period wakeups");
+	if (dmix->epoll_fd >= 0)
+		close(dmix->epoll_fd);
+	if (dmix->slice_fd >= 0)
+		close(dmix->slice_fd);
+	dmix->slice_fd = dmix->epoll_fd = -1;
+}
+
 /*
  * the trick is used here; we cannot use effectively the hardware handle because
  * we cannot drive multiple accesses to appl_ptr; so we use slave timer of given
@@ -1178,7 +1518,8 @@ int snd_pcm_direct_initialize_poll_fd(snd_pcm_direct_t *dmix)
 	int ret;
 	snd_pcm_info_t info = {0};
 	char name[128];
-	int capture = dmix->type == SND_PCM_TYPE_DSNOOP ? 1 : 0;
+	int capture = dmix->type == SND_PCM_TYPE_DSNOOP &&
+		      !dmix->u.dsnoop.monitor;
 
 	dmix->tread = 1;
 	dmix->timer_need_poll = 0;
@@ -1210,6 +1551,8 @@ int snd_pcm_direct_initialize_poll_fd(snd_pcm_direct_t *dmix)
 	}
 	snd_timer_poll_descriptors(dmix->timer, &dmix->timer_fd, 1);
 	dmix->poll_fd = dmix->timer_fd.fd;
+	if (dmix->timer_slices > 1)
+		snd_pcm_direct_initialize_slices(dmix);
 
 	dmix->timer_events = (1<<SND_TIMER_EVENT_MSUSPEND) |
 			     (1<<SND_TIMER_EVENT_MRESUME) |
@@ -1367,8 +1710,13 @@ int snd_pcm_direct_set_timer_params(snd_pcm_direct_t *dmix)
 		snd_timer_params_set_early_event(&params, 1);
 	snd_timer_params_set_ticks(&params, 1);
 	if (dmix->tread) {
-		filter = (1<<SND_TIMER_EVENT_TICK) |
-			 dmix->timer_events;
+		/*
+		 * without the period wakeups only the stop and suspend
+		 * events are queued, poll() then reports the errors only
+		 */
+		filter = dmix->timer_events;
+		if (!dmix->no_period_wakeup)
+			filter |= 1<<SND_TIMER_EVENT_TICK;
 		snd_timer_params_set_filter(&params, filter);
 	}
 	ret = snd_timer_params(dmix->timer, &params);
@@ -1389,7 +1737,7 @@ int snd_pcm_direct_check_interleave(snd_pcm_direct_t *dmix, snd_pcm_t *pcm)
 	const snd_pcm_channel_area_t *dst_areas;
 	const snd_pcm_channel_area_t *src_areas;
 
-	bits = snd_pcm_format_physical_width(pcm->format);
+	bits = __snd_pcm_format_physical_width(pcm->format);
 	if ((bits % 8) != 0)
 		interleaved = 0;
 	channels = dmix->channels;
@@ -1655,6 +2003,18 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 	rec->ipc_gid = -1;
 	rec->slowptr = 1;
 	rec->max_periods = 0;
+	rec->lockless = -1;
+	rec->mix_slots = 0;
+	rec->mix_thread = 0;
+	rec->timer_slices = 1;
+	rec->linger = 0;
+	rec->hwsync_window = 500;
+	rec->fast_recover = 0;
+	rec->hugepages = 0;
+	rec->numa_bind = 0;
+	rec->ipc_futex = 0;
+	rec->zerocopy = 0;
+	rec->monitor = 0;
 
 	/* read defaults */
 	if (snd_config_search(root, "defaults.pcm.dmix_max_periods", &n) >= 0) {
@@ -1761,6 +2121,120 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 			rec->max_periods = val;
 			continue;
 		}
+		if (strcmp(id, "lockless") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->lockless = err;
+			continue;
+		}
+		if (strcmp(id, "mix_slots") == 0) {
+			long val;
+			err = snd_config_get_integer(n, &val);
+			if (err < 0)
+				return err;
+			if (val < 0) {
+				SNDERR("Invalid mix_slots %ld", val);
+				return -EINVAL;
+			}
+			rec->mix_slots = val;
+			continue;
+		}
+		if (strcmp(id, "mix_thread") == 0) {
+			long val;
+			err = snd_config_get_integer(n, &val);
+			if (err < 0)
+				return err;
+			if (val < 0 || val > 99) {
+				SNDERR("Invalid mix_thread priority %ld", val);
+				return -EINVAL;
+			}
+			rec->mix_thread = val;
+			continue;
+		}
+		if (strcmp(id, "timer_slices") == 0) {
+			long val;
+			err = snd_config_get_integer(n, &val);
+			if (err < 0)
+				return err;
+			if (val < 1 || val > 64) {
+				SNDERR("Invalid timer_slices %ld", val);
+				return -EINVAL;
+			}
+			rec->timer_slices = val;
+			continue;
+		}
+		if (strcmp(id, "linger") == 0) {
+			long val;
+			err = snd_config_get_integer(n, &val);
+			if (err < 0)
+				return err;
+			if (val < 0 || val > 60000) {
+				SNDERR("Invalid linger %ld", val);
+				return -EINVAL;
+			}
+			rec->linger = val;
+			continue;
+		}
+		if (strcmp(id, "hwsync_window") == 0) {
+			long val;
+			err = snd_config_get_integer(n, &val);
+			if (err < 0)
+				return err;
+			if (val < 0 || val > 100000) {
+				SNDERR("Invalid hwsync_window %ld", val);
+				return -EINVAL;
+			}
+			rec->hwsync_window = val;
+			continue;
+		}
+		if (strcmp(id, "fast_recover") == 0) {
+			long val;
+			err = snd_config_get_integer(n, &val);
+			if (err < 0)
+				return err;
+			if (val < 0 || val > 65536) {
+				SNDERR("Invalid fast_recover %ld", val);
+				return -EINVAL;
+			}
+			rec->fast_recover = val;
+			continue;
+		}
+		if (strcmp(id, "hugepages") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->hugepages = err;
+			continue;
+		}
+		if (strcmp(id, "numa_bind") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->numa_bind = err;
+			continue;
+		}
+		if (strcmp(id, "ipc_futex") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->ipc_futex = err;
+			continue;
+		}
+		if (strcmp(id, "zerocopy") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->zerocopy = err;
+			continue;
+		}
+		if (strcmp(id, "monitor") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			rec->monitor = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1774,6 +2248,9 @@ int snd_pcm_direct_parse_open_conf(snd_config_t *root, snd_config_t *conf,
 	}
 	if (ipc_key_add_uid)
 		rec->ipc_key += getuid();
+	/* a monitor shares the IPC instance of the playback slave */
+	if (rec->monitor)
+		stream = SND_PCM_STREAM_PLAYBACK;
 	err = snd_pcm_direct_get_slave_ipc_offset(root, conf, stream);
 	if (err < 0)
 		return err;
@@ -20,6 +20,16 @@
  */
 
 #include "pcm_local.h"  
+#include <sys/syscall.h>
+
+#ifndef SHM_HUGETLB
+#define SHM_HUGETLB		0
+#endif
+
+/* the mixing lock is a robust mutex, on the robust futex list of the owner */
+#if defined(__NR_futex) && defined(_POSIX_THREADS)
+#define DIRECT_HAVE_FUTEX	1
+#endif
 
 #define DIRECT_IPC_SEMS         1
 #define DIRECT_IPC_SEM_CLIENT   0
@@ -44,6 +54,11 @@ typedef void (mix_areas_24_t)(unsigned int size,
 			      volatile signed int *sum, size_t dst_step,
 			      size_t src_step, size_t sum_step);
 
+typedef void (mix_areas_float_t)(unsigned int size,
+				 volatile float *dst, float *src,
+				 volatile float *sum, size_t dst_step,
+				 size_t src_step, size_t sum_step);
+
 typedef void (mix_areas_u8_t)(unsigned int size,
 			      volatile unsigned char *dst, unsigned char *src,
 			      volatile signed int *sum, size_t dst_step,
@@ -66,6 +81,15 @@ typedef struct {
 	char socket_name[256];			/* name of communication socket */
 	snd_pcm_type_t type;			/* PCM type (currently only hw) */
 	int use_server;
+	int lockless_mix;			/* dmix: mixing without semaphore */
+	int mix_slots;				/* dmix: number of private mix slots */
+	unsigned int mix_slot_mask;		/* dmix: claimed mix slots */
+	unsigned long long mix_merge_ptr;	/* dmix: slave position merged so far */
+	int use_futex;				/* dmix: mixing lock is mix_lock */
+	pthread_mutex_t mix_lock;		/* dmix: robust, process shared */
+	int mix_thread;				/* dmix: mixer thread priority, 0 = none */
+	unsigned int mix_thread_owner;		/* dmix: pid running the mixer thread */
+	unsigned long long hwsync_ns;		/* CLOCK_MONOTONIC of the last slave hwsync */
 	struct {
 		unsigned int format;
 		snd_interval_t rate;
@@ -146,13 +170,25 @@ struct snd_pcm_direct {
 	int poll_fd;
 	int tread: 1;
 	int timer_need_poll: 1;
+	int no_period_wakeup: 1;	/* client disabled the period wakeups */
 	unsigned int timer_events;
 	int server_fd;
 	pid_t server_pid;
 	snd_timer_t *timer; 		/* timer used as poll_fd */
+	int timer_slices;		/* wakeups per slave period */
+	int linger;			/* ms to keep the slave after the last close */
+	int hwsync_window;		/* us to reuse the hwsync of another client */
+	int fast_recover;		/* frames of silence to restart with after an xrun */
+	int rejoin;			/* start mid-period, set while recovering */
+	int slice_fd;			/* timerfd for the sub-period wakeups */
+	int epoll_fd;			/* poll_fd joining timer and slice_fd */
 	int interleaved;	 	/* we have interleaved buffer */
 	int slowptr;			/* use slow but more precise ptr updates */
 	int max_periods;		/* max periods (-1 = fixed periods, 0 = max buffer size) */
+	int hugepages;			/* back the data segments with huge pages */
+	int numa_bind;			/* bind the segments to the card's NUMA node */
+	int numa_node;			/* card's NUMA node, -1 = unknown */
+	unsigned int lock_id;		/* our pid, see mix_thread_owner */
 	unsigned int channels;		/* client's channels */
 	unsigned int *bindings;
 	union {
@@ -163,15 +199,27 @@ struct snd_pcm_direct {
 			mix_areas_32_t *mix_areas_32;
 			mix_areas_24_t *mix_areas_24;
 			mix_areas_u8_t *mix_areas_u8;
+			mix_areas_float_t *mix_areas_float;
 			mix_areas_16_t *remix_areas_16;
 			mix_areas_32_t *remix_areas_32;
 			mix_areas_24_t *remix_areas_24;
 			mix_areas_u8_t *remix_areas_u8;
+			mix_areas_float_t *remix_areas_float;
+			int use_sem;			/* serialize mixing via snd_pcm_direct_mix_lock() */
+			int shmid_slots;		/* IPC private mix slots memory identification */
+			signed int *slots;		/* private mix slots of all clients */
+			size_t slot_size;		/* bytes per slot (cache line aligned) */
+			int slot;			/* own slot index, -1 = mix directly */
+			struct snd_pcm_dmix_mixer *mixer; /* own mixer thread, NULL = none */
 		} dmix;
 		struct {
+			int zerocopy;			/* allow areas into the slave buffer */
+			int monitor;			/* tap the ring of a dmix playback slave */
 		} dsnoop;
 		struct {
 			unsigned long long chn_mask;
+			snd_pcm_uframes_t dirty;	/* frames written since the last silence */
+			snd_pcm_uframes_t dirty_end;	/* slave position after the dirty run */
 		} dshare;
 	} u;
 	void (*server_free)(snd_pcm_direct_t *direct);
@@ -196,6 +244,14 @@ struct snd_pcm_direct {
 	snd1_pcm_direct_initialize_slave
 #define snd_pcm_direct_initialize_secondary_slave \
 	snd1_pcm_direct_initialize_secondary_slave
+#define snd_pcm_direct_futex_init \
+	snd1_pcm_direct_futex_init
+#define snd_pcm_direct_futex_recover \
+	snd1_pcm_direct_futex_recover
+#define snd_pcm_direct_shm_flags \
+	snd1_pcm_direct_shm_flags
+#define snd_pcm_direct_shm_bind \
+	snd1_pcm_direct_shm_bind
 #define snd_pcm_direct_initialize_poll_fd \
 	snd1_pcm_direct_initialize_poll_fd
 #define snd_pcm_direct_check_interleave \
@@ -208,6 +264,8 @@ struct snd_pcm_direct {
 	snd1_pcm_direct_async
 #define snd_pcm_direct_poll_revents \
 	snd1_pcm_direct_poll_revents
+#define snd_pcm_direct_fill_avail_status \
+	snd1_pcm_direct_fill_avail_status
 #define snd_pcm_direct_info \
 	snd1_pcm_direct_info
 #define snd_pcm_direct_hw_refine \
@@ -228,12 +286,20 @@ struct snd_pcm_direct {
 	snd1_pcm_direct_prepare
 #define snd_pcm_direct_resume \
 	snd1_pcm_direct_resume
+#define snd_pcm_direct_timer_start \
+	snd1_pcm_direct_timer_start
 #define snd_pcm_direct_timer_stop \
 	snd1_pcm_direct_timer_stop
+#define snd_pcm_direct_timer_close \
+	snd1_pcm_direct_timer_close
 #define snd_pcm_direct_clear_timer_queue \
 	snd1_pcm_direct_clear_timer_queue
 #define snd_pcm_direct_set_timer_params \
 	snd1_pcm_direct_set_timer_params
+#define snd_pcm_direct_linger \
+	snd1_pcm_direct_linger
+#define snd_pcm_direct_hwsync \
+	snd1_pcm_direct_hwsync
 #define snd_pcm_direct_open_secondary_client \
 	snd1_pcm_direct_open_secondary_client
 #define snd_pcm_direct_parse_open_conf \
@@ -282,6 +348,36 @@ static inline int snd_pcm_direct_semaphore_final(snd_pcm_direct_t *dmix, int sem
 	return snd_pcm_direct_semaphore_up(dmix, sem_num);
 }
 
+int snd_pcm_direct_futex_init(snd_pcm_direct_t *dmix);
+void snd_pcm_direct_futex_recover(snd_pcm_direct_t *dmix);
+
+/*
+ * the lock for the mixing state (sum buffer, mix slots); with use_futex
+ * set in the shared memory, an uncontended lock doesn't enter the kernel
+ */
+static inline void snd_pcm_direct_mix_lock(snd_pcm_direct_t *dmix)
+{
+#ifdef DIRECT_HAVE_FUTEX
+	if (dmix->shmptr->use_futex) {
+		if (pthread_mutex_lock(&dmix->shmptr->mix_lock) == EOWNERDEAD)
+			snd_pcm_direct_futex_recover(dmix);
+		return;
+	}
+#endif
+	snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT);
+}
+
+static inline void snd_pcm_direct_mix_unlock(snd_pcm_direct_t *dmix)
+{
+#ifdef DIRECT_HAVE_FUTEX
+	if (dmix->shmptr->use_futex) {
+		pthread_mutex_unlock(&dmix->shmptr->mix_lock);
+		return;
+	}
+#endif
+	snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT);
+}
+
 int snd_pcm_direct_shm_create_or_connect(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_shm_discard(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_server_create(snd_pcm_direct_t *dmix);
@@ -291,6 +387,8 @@ int snd_pcm_direct_client_discard(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_initialize_slave(snd_pcm_direct_t *dmix, snd_pcm_t *spcm, struct slave_params *params);
 int snd_pcm_direct_initialize_secondary_slave(snd_pcm_direct_t *dmix, snd_pcm_t *spcm, struct slave_params *params);
 int snd_pcm_direct_initialize_poll_fd(snd_pcm_direct_t *dmix);
+int snd_pcm_direct_shm_flags(snd_pcm_direct_t *dmix);
+void snd_pcm_direct_shm_bind(snd_pcm_direct_t *dmix, void *addr, size_t size);
 int snd_pcm_direct_check_interleave(snd_pcm_direct_t *dmix, snd_pcm_t *pcm);
 int snd_pcm_direct_parse_bindings(snd_pcm_direct_t *dmix,
 				  struct slave_params *params,
@@ -298,6 +396,7 @@ int snd_pcm_direct_parse_bindings(snd_pcm_direct_t *dmix,
 int snd_pcm_direct_nonblock(snd_pcm_t *pcm, int nonblock);
 int snd_pcm_direct_async(snd_pcm_t *pcm, int sig, pid_t pid);
 int snd_pcm_direct_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
+void snd_pcm_direct_fill_avail_status(snd_pcm_t *pcm, snd_pcm_status_t *status);
 int snd_pcm_direct_info(snd_pcm_t *pcm, snd_pcm_info_t * info);
 int snd_pcm_direct_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
 int snd_pcm_direct_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params);
@@ -308,9 +407,14 @@ int snd_pcm_direct_mmap(snd_pcm_t *pcm);
 int snd_pcm_direct_munmap(snd_pcm_t *pcm);
 int snd_pcm_direct_prepare(snd_pcm_t *pcm);
 int snd_pcm_direct_resume(snd_pcm_t *pcm);
+int snd_pcm_direct_timer_start(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_timer_stop(snd_pcm_direct_t *dmix);
+void snd_pcm_direct_timer_close(snd_pcm_direct_t *dmix);
 void snd_pcm_direct_clear_timer_queue(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_set_timer_params(snd_pcm_direct_t *dmix);
+void snd_pcm_direct_linger(snd_pcm_direct_t *dmix,
+			   void (*linger_free)(snd_pcm_direct_t *dmix));
+int snd_pcm_direct_hwsync(snd_pcm_direct_t *dmix);
 int snd_pcm_direct_open_secondary_client(snd_pcm_t **spcmp, snd_pcm_direct_t *dmix, const char *client_name);
 
 snd_pcm_chmap_query_t **snd_pcm_direct_query_chmaps(snd_pcm_t *pcm);
@@ -319,6 +423,7 @@ int snd_pcm_direct_set_chmap(snd_pcm_t *pcm, const snd_pcm_chmap_t *map);
 
 int snd_timer_async(snd_timer_t *timer, int sig, pid_t pid);
 struct timespec snd_pcm_hw_fast_tstamp(snd_pcm_t *pcm);
+int snd_pcm_hw_status_shared(snd_pcm_t *pcm);
 
 struct snd_pcm_direct_open_conf {
 	key_t ipc_key;
@@ -326,6 +431,18 @@ struct snd_pcm_direct_open_conf {
 	int ipc_gid;
 	int slowptr;
 	int max_periods;
+	int lockless;
+	int mix_slots;
+	int mix_thread;
+	int timer_slices;
+	int linger;
+	int hwsync_window;
+	int fast_recover;
+	int hugepages;
+	int numa_bind;
+	int ipc_futex;
+	int zerocopy;
+	int monitor;
 	snd_config_t *slave;
 	snd_config_t *bindings;
 };
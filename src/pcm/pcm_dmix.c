@@ -67,17 +67,23 @@ static int shm_sum_discard(snd_pcm_direct_t *dmix);
 static int shm_sum_create_or_connect(snd_pcm_direct_t *dmix)
 {
 	struct shmid_ds buf;
-	int tmpid, err;
+	int tmpid, err, flags;
 	size_t size;
 
 	size = dmix->shmptr->s.channels *
 	       dmix->shmptr->s.buffer_size *
 	       sizeof(signed int);	
+	flags = IPC_CREAT | dmix->ipc_perm | snd_pcm_direct_shm_flags(dmix);
 retryshm:
-	dmix->u.dmix.shmid_sum = shmget(dmix->ipc_key + 1, size,
-					IPC_CREAT | dmix->ipc_perm);
+	dmix->u.dmix.shmid_sum = shmget(dmix->ipc_key + 1, size, flags);
 	err = -errno;
 	if (dmix->u.dmix.shmid_sum < 0) {
+		if ((flags & SHM_HUGETLB) &&
+		    (errno == ENOMEM || errno == EPERM)) {
+			/* no huge pages reserved or allowed */
+			flags &= ~SHM_HUGETLB;
+			goto retryshm;
+		}
 		if (errno == EINVAL)
 		if ((tmpid = shmget(dmix->ipc_key + 1, 0, dmix->ipc_perm)) != -1)
 		if (!shmctl(tmpid, IPC_STAT, &buf))
@@ -102,6 +108,7 @@ retryshm:
 		shm_sum_discard(dmix);
 		return err;
 	}
+	snd_pcm_direct_shm_bind(dmix, dmix->u.dmix.sum_buffer, size);
 	mlock(dmix->u.dmix.sum_buffer, size);
 	return 0;
 }
@@ -127,11 +134,103 @@ static int shm_sum_discard(snd_pcm_direct_t *dmix)
 	return ret;
 }
 
+static int shm_slots_discard(snd_pcm_direct_t *dmix);
+
+/*
+ *  private mix slots shared memory area, one slot per client;
+ *  each slot has the layout of the sum ring buffer
+ */
+static int shm_slots_create_or_connect(snd_pcm_direct_t *dmix)
+{
+	struct shmid_ds buf;
+	int tmpid, err, flags;
+	size_t size;
+
+	dmix->u.dmix.slot_size = (dmix->shmptr->s.channels *
+				  dmix->shmptr->s.buffer_size *
+				  sizeof(signed int) + 63) & ~(size_t)63;
+	size = dmix->u.dmix.slot_size * dmix->shmptr->mix_slots;
+	flags = IPC_CREAT | dmix->ipc_perm | snd_pcm_direct_shm_flags(dmix);
+retryshm:
+	dmix->u.dmix.shmid_slots = shmget(dmix->ipc_key + 2, size, flags);
+	err = -errno;
+	if (dmix->u.dmix.shmid_slots < 0) {
+		if ((flags & SHM_HUGETLB) &&
+		    (errno == ENOMEM || errno == EPERM)) {
+			/* no huge pages reserved or allowed */
+			flags &= ~SHM_HUGETLB;
+			goto retryshm;
+		}
+		if (errno == EINVAL)
+		if ((tmpid = shmget(dmix->ipc_key + 2, 0, dmix->ipc_perm)) != -1)
+		if (!shmctl(tmpid, IPC_STAT, &buf))
+		if (!buf.shm_nattch)
+		/* no users so destroy the segment */
+		if (!shmctl(tmpid, IPC_RMID, NULL))
+		    goto retryshm;
+		return err;
+	}
+	if (dmix->ipc_gid >= 0 &&
+	    !shmctl(dmix->u.dmix.shmid_slots, IPC_STAT, &buf)) {
+		buf.shm_perm.gid = dmix->ipc_gid;
+		shmctl(dmix->u.dmix.shmid_slots, IPC_SET, &buf);
+	}
+	dmix->u.dmix.slots = shmat(dmix->u.dmix.shmid_slots, 0, 0);
+	if (dmix->u.dmix.slots == (void *) -1) {
+		err = -errno;
+		shm_slots_discard(dmix);
+		return err;
+	}
+	if (shmctl(dmix->u.dmix.shmid_slots, IPC_STAT, &buf) < 0) {
+		err = -errno;
+		shm_slots_discard(dmix);
+		return err;
+	}
+	if (buf.shm_nattch == 1)	/* a left-over segment may be dirty */
+		memset(dmix->u.dmix.slots, 0, size);
+	snd_pcm_direct_shm_bind(dmix, dmix->u.dmix.slots, size);
+	mlock(dmix->u.dmix.slots, size);
+	return 0;
+}
+
+static int shm_slots_discard(snd_pcm_direct_t *dmix)
+{
+	struct shmid_ds buf;
+	int ret = 0;
+
+	if (dmix->u.dmix.shmid_slots < 0)
+		return -EINVAL;
+	if (dmix->u.dmix.slots != (void *) -1 && shmdt(dmix->u.dmix.slots) < 0)
+		return -errno;
+	dmix->u.dmix.slots = (void *) -1;
+	if (shmctl(dmix->u.dmix.shmid_slots, IPC_STAT, &buf) < 0)
+		return -errno;
+	if (buf.shm_nattch == 0) {	/* we're the last user, destroy the segment */
+		if (shmctl(dmix->u.dmix.shmid_slots, IPC_RMID, NULL) < 0)
+			return -errno;
+		ret = 1;
+	}
+	dmix->u.dmix.shmid_slots = -1;
+	return ret;
+}
+
 static void dmix_server_free(snd_pcm_direct_t *dmix)
 {
 	/* remove the memory region */
 	shm_sum_create_or_connect(dmix);
 	shm_sum_discard(dmix);
+	if (dmix->shmptr->mix_slots) {
+		shm_slots_create_or_connect(dmix);
+		shm_slots_discard(dmix);
+	}
+}
+
+/* the lingering helper holds the segments already, it only removes them */
+static void dmix_linger_free(snd_pcm_direct_t *dmix)
+{
+	shm_sum_discard(dmix);
+	if (dmix->u.dmix.shmid_slots >= 0)
+		shm_slots_discard(dmix);
 }
 
 /*
@@ -140,6 +239,7 @@ static void dmix_server_free(snd_pcm_direct_t *dmix)
  */
 
 #include "pcm_dmix_generic.c"
+#include "pcm_dmix_simd.c"
 #if defined(__i386__)
 #include "pcm_dmix_i386.c"
 #elif defined(__x86_64__)
@@ -151,6 +251,360 @@ static void dmix_server_free(snd_pcm_direct_t *dmix)
 #endif
 #endif
 
+#ifndef DOC_HIDDEN
+#if defined(__i386__) || defined(__x86_64__)
+/* the asm kernels are lock-free by themselves */
+#define lockless_mix_select_callbacks(x)
+#define dmix_lockless_format \
+	((1ULL << SND_PCM_FORMAT_S16_LE) | (1ULL << SND_PCM_FORMAT_S32_LE))
+#define dmix_lockless_default 0
+#else
+#define lockless_mix_select_callbacks(x) generic_lockless_mix_select_callbacks(x)
+#define dmix_lockless_format generic_dmix_lockless_format
+#define dmix_lockless_default 1
+#endif
+#endif
+
+/*
+ * choose the mixing kernels; all clients of a slave must agree whether
+ * the semaphore protects the sum buffer, so the first instance decides
+ * and stores the choice into the shared memory
+ */
+static void dmix_select_engine(snd_pcm_direct_t *dmix, int first_instance,
+			       int lockless)
+{
+	if (first_instance) {
+		if (lockless < 0)
+			lockless = dmix_lockless_default;
+		if (!(dmix_lockless_format & (1ULL << dmix->shmptr->s.format)))
+			lockless = 0;
+		/* the mix slots are guarded by the mixing lock */
+		if (dmix->shmptr->mix_slots)
+			lockless = 0;
+		dmix->shmptr->lockless_mix = lockless;
+	}
+	dmix->u.dmix.use_sem = !dmix->shmptr->lockless_mix;
+	mix_select_callbacks(dmix);
+	if (dmix->u.dmix.use_sem)
+		simd_mix_select_callbacks(dmix);
+	else
+		lockless_mix_select_callbacks(dmix);
+}
+
+/*
+ * private mix slots
+ *
+ * A client owning a slot adds the samples lying ahead of the shared merge
+ * position into its own slot instead of the shared sum buffer, so the
+ * clients don't bounce the same cache lines.  Whichever client notices a
+ * new slave period first merges all slots into the sum and slave buffers
+ * up to two periods ahead of the hardware pointer.  Everything behind the
+ * merge position is mixed directly as before.  The slots and the merge
+ * position are protected by the mixing lock.
+ */
+#ifndef DOC_HIDDEN
+#define DMIX_MAX_SLOTS	32
+#define DMIX_THREAD_SLOTS	8	/* mix_slots implied by mix_thread */
+#define dmix_slots_format \
+	((1ULL << SND_PCM_FORMAT_S16) | (1ULL << SND_PCM_FORMAT_S32))
+#endif
+
+static void dmix_select_slots(snd_pcm_direct_t *dmix, int first_instance,
+			      int slots)
+{
+	snd_pcm_direct_share_t *share = dmix->shmptr;
+
+	if (!first_instance)
+		return;
+	if (slots > DMIX_MAX_SLOTS)
+		slots = DMIX_MAX_SLOTS;
+	if (!(dmix_slots_format & (1ULL << share->s.format)))
+		slots = 0;
+	share->mix_slots = slots;
+	share->mix_slot_mask = 0;
+	share->mix_merge_ptr = 0;
+}
+
+static void dmix_claim_slot(snd_pcm_direct_t *dmix)
+{
+	snd_pcm_direct_share_t *share = dmix->shmptr;
+	int i;
+
+	for (i = 0; i < share->mix_slots; i++) {
+		if (!(share->mix_slot_mask & (1U << i))) {
+			share->mix_slot_mask |= 1U << i;
+			dmix->u.dmix.slot = i;
+			return;
+		}
+	}
+	/* all slots taken, mix directly */
+}
+
+static inline signed int *dmix_slot_ptr(snd_pcm_direct_t *dmix, int slot)
+{
+	return (signed int *)((char *)dmix->u.dmix.slots +
+			      slot * dmix->u.dmix.slot_size);
+}
+
+static void dmix_release_slot(snd_pcm_direct_t *dmix)
+{
+	int slot = dmix->u.dmix.slot;
+
+	if (slot < 0)
+		return;
+	memset(dmix_slot_ptr(dmix, slot), 0, dmix->u.dmix.slot_size);
+	dmix->shmptr->mix_slot_mask &= ~(1U << slot);
+	dmix->u.dmix.slot = -1;
+}
+
+/* drop the slot contents of the given frames (ring offset, may wrap) */
+static void dmix_clear_slots(snd_pcm_direct_t *dmix, snd_pcm_uframes_t ofs,
+			     snd_pcm_uframes_t frames)
+{
+	unsigned int mask = dmix->shmptr->mix_slot_mask;
+	unsigned int channels = dmix->shmptr->s.channels;
+	snd_pcm_uframes_t transfer;
+	int i;
+
+	while (frames) {
+		transfer = frames;
+		if (ofs + transfer > dmix->slave_buffer_size)
+			transfer = dmix->slave_buffer_size - ofs;
+		for (i = 0; i < dmix->shmptr->mix_slots; i++)
+			if (mask & (1U << i))
+				memset(dmix_slot_ptr(dmix, i) + ofs * channels, 0,
+				       transfer * channels * sizeof(signed int));
+		frames -= transfer;
+		ofs = 0;
+	}
+}
+
+static void dmix_merge_areas(snd_pcm_direct_t *dmix, snd_pcm_uframes_t ofs,
+			     snd_pcm_uframes_t frames)
+{
+	const snd_pcm_channel_area_t *dst_areas = snd_pcm_mmap_areas(dmix->spcm);
+	unsigned int mask = dmix->shmptr->mix_slot_mask;
+	unsigned int channels = dmix->shmptr->s.channels;
+	int is16 = dmix->shmptr->s.format == SND_PCM_FORMAT_S16;
+	signed int *sum = dmix->u.dmix.sum_buffer + ofs * channels;
+	signed int *slot, sample;
+	snd_pcm_uframes_t f, n = frames * channels;
+	snd_pcm_uframes_t runs = frames;
+	unsigned int chn, runs_chn = channels, stride = channels, step;
+	int contiguous, i;
+	char *dst;
+
+	/* an interleaved slave is walked as a single contiguous channel */
+	contiguous = dmix->spcm->access == SND_PCM_ACCESS_MMAP_INTERLEAVED;
+	if (contiguous) {
+		runs = n;
+		runs_chn = stride = 1;
+	}
+	/* the driver clears the played areas; a zero sample resets the sum */
+	for (chn = 0; chn < runs_chn; chn++) {
+		step = dst_areas[chn].step / 8;
+		dst = (char *)dst_areas[chn].addr + dst_areas[chn].first / 8 +
+		      ofs * step;
+		if (contiguous)
+			step /= channels;
+		for (f = 0; f < runs; f++, dst += step)
+			if (is16 ? !*(signed short *)dst : !*(signed int *)dst)
+				sum[f * stride + chn] = 0;
+	}
+	for (i = 0; i < dmix->shmptr->mix_slots; i++) {
+		if (!(mask & (1U << i)))
+			continue;
+		slot = dmix_slot_ptr(dmix, i) + ofs * channels;
+		for (f = 0; f < n; f++) {
+			sum[f] += slot[f];
+			slot[f] = 0;
+		}
+	}
+	for (chn = 0; chn < runs_chn; chn++) {
+		step = dst_areas[chn].step / 8;
+		dst = (char *)dst_areas[chn].addr + dst_areas[chn].first / 8 +
+		      ofs * step;
+		if (contiguous)
+			step /= channels;
+		for (f = 0; f < runs; f++, dst += step) {
+			sample = sum[f * stride + chn];
+			if (is16) {
+				if (sample > 0x7fff)
+					sample = 0x7fff;
+				else if (sample < -0x8000)
+					sample = -0x8000;
+				*(signed short *)dst = sample;
+			} else {
+				if (sample > 0x7fffff)
+					sample = 0x7fffffff;
+				else if (sample < -0x800000)
+					sample = -0x80000000;
+				else
+					sample *= 256;
+				*(signed int *)dst = sample;
+			}
+		}
+	}
+}
+
+/*
+ * merge the slots up to two periods ahead of the hardware pointer;
+ * the caller holds the mixing lock
+ */
+static void dmix_merge_slots(snd_pcm_direct_t *dmix)
+{
+	snd_pcm_direct_share_t *share = dmix->shmptr;
+	snd_pcm_uframes_t boundary = dmix->slave_boundary;
+	snd_pcm_uframes_t buffer_size = dmix->slave_buffer_size;
+	snd_pcm_uframes_t hw, base, merge, target, dist, ofs, transfer;
+
+	hw = *dmix->spcm->hw.ptr;
+	base = hw - hw % dmix->slave_period_size;
+	dist = 2 * dmix->slave_period_size;
+	if (dist > buffer_size)
+		dist = buffer_size;
+	target = (base + dist) % boundary;
+	merge = share->mix_merge_ptr % boundary;
+	if ((merge + boundary - base) % boundary > buffer_size) {
+		/* the hardware overtook the merge position (or the slave
+		 * was restarted); what the slots hold there is stale
+		 */
+		dist = (base + boundary - merge) % boundary;
+		if (dist > buffer_size)
+			dist = buffer_size;
+		dmix_clear_slots(dmix, merge % buffer_size, dist);
+		merge = base;
+	}
+	dist = (target + boundary - merge) % boundary;
+	if (dist > buffer_size)		/* already ahead */
+		return;
+	if (share->mix_slot_mask) {
+		ofs = merge % buffer_size;
+		while (dist) {
+			transfer = dist;
+			if (ofs + transfer > buffer_size)
+				transfer = buffer_size - ofs;
+			dmix_merge_areas(dmix, ofs, transfer);
+			dist -= transfer;
+			ofs = (ofs + transfer) % buffer_size;
+		}
+	}
+	share->mix_merge_ptr = target;
+}
+
+/*
+ * mixer thread
+ *
+ * With mix_thread set, one client of the slave runs a SCHED_FIFO thread
+ * merging the mix slots twice per slave period on a timer, so that the
+ * data reaches the slave buffer independently of how the clients get
+ * scheduled; the clients only store into their slots then.  The pid of
+ * the owner is kept in the shared memory.  When the owner closes (or
+ * dies), the next client seeing a new period takes over; until then the
+ * clients merge the slots themselves as without the thread.
+ */
+#ifdef THREAD_SAFE_API
+struct snd_pcm_dmix_mixer {
+	pthread_t thread;
+	volatile int running;
+};
+
+static void *dmix_mixer_thread(void *arg)
+{
+	snd_pcm_direct_t *dmix = arg;
+	struct snd_pcm_dmix_mixer *mixer = dmix->u.dmix.mixer;
+	struct timespec ts;
+	sigset_t mask;
+	long interval;
+
+	/* leave the signals to the application threads */
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+	interval = (long)((unsigned long long)dmix->slave_period_size *
+			  1000000000ULL / (2 * dmix->shmptr->s.rate));
+	if (interval <= 0)
+		interval = 1000000;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	while (mixer->running) {
+		ts.tv_nsec += interval;
+		while (ts.tv_nsec >= 1000000000L) {
+			ts.tv_nsec -= 1000000000L;
+			ts.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		if (dmix->slowptr)
+			snd_pcm_direct_hwsync(dmix);
+		snd_pcm_direct_mix_lock(dmix);
+		dmix_merge_slots(dmix);
+		snd_pcm_direct_mix_unlock(dmix);
+	}
+	return NULL;
+}
+
+/*
+ * start the mixer thread unless a live client runs it already;
+ * the caller holds the mixing lock
+ */
+static void dmix_adopt_mixer(snd_pcm_direct_t *dmix)
+{
+	snd_pcm_direct_share_t *share = dmix->shmptr;
+	struct snd_pcm_dmix_mixer *mixer;
+	struct sched_param param;
+	pthread_attr_t attr;
+	unsigned int owner;
+	int err;
+
+	if (!share->mix_thread || !share->mix_slots || dmix->u.dmix.mixer)
+		return;
+	owner = share->mix_thread_owner;
+	if (owner && (kill(owner, 0) == 0 || errno != ESRCH))
+		return;
+	mixer = calloc(1, sizeof(*mixer));
+	if (!mixer)
+		return;
+	mixer->running = 1;
+	dmix->u.dmix.mixer = mixer;
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	param.sched_priority = share->mix_thread;
+	pthread_attr_setschedparam(&attr, &param);
+	err = snd_thread_create(&mixer->thread, &attr, dmix_mixer_thread, dmix);
+	pthread_attr_destroy(&attr);
+	if (err == EPERM) {
+		SNDMSG("no realtime scheduling for the dmix mixer thread");
+		err = snd_thread_create(&mixer->thread, NULL,
+					dmix_mixer_thread, dmix);
+	}
+	if (err) {
+		SNDERR("unable to create the dmix mixer thread (%d)", err);
+		dmix->u.dmix.mixer = NULL;
+		free(mixer);
+		return;
+	}
+	share->mix_thread_owner = dmix->lock_id;
+}
+
+static void dmix_stop_mixer(snd_pcm_direct_t *dmix)
+{
+	struct snd_pcm_dmix_mixer *mixer = dmix->u.dmix.mixer;
+
+	if (!mixer)
+		return;
+	mixer->running = 0;
+	pthread_join(mixer->thread, NULL);
+	dmix->u.dmix.mixer = NULL;
+	free(mixer);
+	snd_pcm_direct_mix_lock(dmix);
+	if (dmix->shmptr->mix_thread_owner == dmix->lock_id)
+		dmix->shmptr->mix_thread_owner = 0;
+	snd_pcm_direct_mix_unlock(dmix);
+}
+#else
+#define dmix_adopt_mixer(dmix)	do { } while (0)
+#define dmix_stop_mixer(dmix)	do { } while (0)
+#endif
+
 static void mix_areas(snd_pcm_direct_t *dmix,
 		      const snd_pcm_channel_area_t *src_areas,
 		      const snd_pcm_channel_area_t *dst_areas,
@@ -186,6 +640,10 @@ static void mix_areas(snd_pcm_direct_t *dmix,
 		sample_size = 1;
 		do_mix_areas = (mix_areas_t *)dmix->u.dmix.mix_areas_u8;
 		break;
+	case SND_PCM_FORMAT_FLOAT:
+		sample_size = 4;
+		do_mix_areas = (mix_areas_t *)dmix->u.dmix.mix_areas_float;
+		break;
 	default:
 		return;
 	}
@@ -254,6 +712,10 @@ static void remix_areas(snd_pcm_direct_t *dmix,
 		sample_size = 1;
 		do_remix_areas = (mix_areas_t *)dmix->u.dmix.remix_areas_u8;
 		break;
+	case SND_PCM_FORMAT_FLOAT:
+		sample_size = 4;
+		do_remix_areas = (mix_areas_t *)dmix->u.dmix.remix_areas_float;
+		break;
 	default:
 		return;
 	}
@@ -287,19 +749,119 @@ static void remix_areas(snd_pcm_direct_t *dmix,
 	}
 }
 
+/* add the samples to the own mix slot */
+static void dmix_store_slot(snd_pcm_direct_t *dmix,
+			    const snd_pcm_channel_area_t *src_areas,
+			    snd_pcm_uframes_t src_ofs,
+			    snd_pcm_uframes_t dst_ofs,
+			    snd_pcm_uframes_t size)
+{
+	unsigned int channels = dmix->shmptr->s.channels;
+	int is16 = dmix->shmptr->s.format == SND_PCM_FORMAT_S16;
+	signed int *slot = dmix_slot_ptr(dmix, dmix->u.dmix.slot);
+	signed int *dst;
+	unsigned int chn, dchn, src_step;
+	snd_pcm_uframes_t f;
+	const char *src;
+
+	if (dmix->interleaved) {
+		/*
+		 * the client and the slot frames match sample by sample,
+		 * add them as one contiguous run like mix_areas() does
+		 */
+		snd_pcm_uframes_t n = size * channels;
+		dst = slot + dst_ofs * channels;
+		if (is16) {
+			const signed short *s16 = (const signed short *)src_areas[0].addr +
+						  src_ofs * channels;
+			for (f = 0; f < n; f++)
+				dst[f] += s16[f];
+		} else {
+			const signed int *s32 = (const signed int *)src_areas[0].addr +
+						src_ofs * channels;
+			for (f = 0; f < n; f++)
+				dst[f] += s32[f] >> 8;
+		}
+		return;
+	}
+	for (chn = 0; chn < dmix->channels; chn++) {
+		dchn = dmix->bindings ? dmix->bindings[chn] : chn;
+		if (dchn >= channels)
+			continue;
+		src_step = src_areas[chn].step / 8;
+		src = (const char *)src_areas[chn].addr +
+		      src_areas[chn].first / 8 + src_ofs * src_step;
+		dst = slot + dst_ofs * channels + dchn;
+		for (f = 0; f < size; f++, src += src_step, dst += channels) {
+			if (is16)
+				*dst += *(const signed short *)src;
+			else
+				*dst += *(const signed int *)src >> 8;
+		}
+	}
+}
+
+/*
+ * mix a chunk starting at the absolute slave position slave_pos;
+ * the part behind the merge position goes to the shared buffers directly
+ */
+static void dmix_mix_chunk(snd_pcm_direct_t *dmix,
+			   const snd_pcm_channel_area_t *src_areas,
+			   const snd_pcm_channel_area_t *dst_areas,
+			   snd_pcm_uframes_t src_ofs,
+			   snd_pcm_uframes_t slave_pos,
+			   snd_pcm_uframes_t size, int remix)
+{
+	snd_pcm_uframes_t dst_ofs = slave_pos % dmix->slave_buffer_size;
+	snd_pcm_uframes_t direct = size;
+
+	if (dmix->u.dmix.slot >= 0) {
+		direct = (dmix->shmptr->mix_merge_ptr + dmix->slave_boundary -
+			  slave_pos) % dmix->slave_boundary;
+		if (direct > dmix->slave_buffer_size)
+			direct = 0;
+		if (direct > size)
+			direct = size;
+	}
+	if (direct) {
+		if (remix)
+			remix_areas(dmix, src_areas, dst_areas, src_ofs, dst_ofs, direct);
+		else
+			mix_areas(dmix, src_areas, dst_areas, src_ofs, dst_ofs, direct);
+	}
+	if (direct == size)
+		return;
+	if (remix) {
+		/*
+		 * the slot holds nothing but our own samples there, so
+		 * a rewind simply drops them: one memset, and the source
+		 * ring isn't read at all
+		 */
+		unsigned int channels = dmix->shmptr->s.channels;
+		memset(dmix_slot_ptr(dmix, dmix->u.dmix.slot) +
+		       (dst_ofs + direct) * channels, 0,
+		       (size - direct) * channels * sizeof(signed int));
+		return;
+	}
+	dmix_store_slot(dmix, src_areas, src_ofs + direct,
+			dst_ofs + direct, size - direct);
+}
+
 /*
  * if no concurrent access is allowed in the mixing routines, we need to protect
  * the area via semaphore
  */
-#ifndef DOC_HIDDEN
-#ifdef NO_CONCURRENT_ACCESS
-#define dmix_down_sem(dmix) snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT)
-#define dmix_up_sem(dmix) snd_pcm_direct_semaphore_up(dmix, DIRECT_IPC_SEM_CLIENT)
-#else
-#define dmix_down_sem(dmix)
-#define dmix_up_sem(dmix)
-#endif
-#endif
+static inline void dmix_down_sem(snd_pcm_direct_t *dmix)
+{
+	if (dmix->u.dmix.use_sem)
+		snd_pcm_direct_mix_lock(dmix);
+}
+
+static inline void dmix_up_sem(snd_pcm_direct_t *dmix)
+{
+	if (dmix->u.dmix.use_sem)
+		snd_pcm_direct_mix_unlock(dmix);
+}
 
 /*
  *  synchronize shm ring buffer with hardware
@@ -307,7 +869,7 @@ static void remix_areas(snd_pcm_direct_t *dmix,
 static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
-	snd_pcm_uframes_t slave_hw_ptr, slave_appl_ptr, slave_size;
+	snd_pcm_uframes_t slave_hw_ptr, slave_appl_ptr, slave_size, slave_pos;
 	snd_pcm_uframes_t appl_ptr, size, transfer;
 	const snd_pcm_channel_area_t *src_areas, *dst_areas;
 	
@@ -366,20 +928,25 @@ static void snd_pcm_dmix_sync_area(snd_pcm_t *pcm)
 	appl_ptr = dmix->last_appl_ptr % pcm->buffer_size;
 	dmix->last_appl_ptr += size;
 	dmix->last_appl_ptr %= pcm->boundary;
-	slave_appl_ptr = dmix->slave_appl_ptr % dmix->slave_buffer_size;
+	slave_pos = dmix->slave_appl_ptr;
+	slave_appl_ptr = slave_pos % dmix->slave_buffer_size;
 	dmix->slave_appl_ptr += size;
 	dmix->slave_appl_ptr %= dmix->slave_boundary;
 	dmix_down_sem(dmix);
+	if (dmix->u.dmix.slot >= 0 && !dmix->shmptr->mix_thread_owner)
+		dmix_merge_slots(dmix);
 	for (;;) {
 		transfer = size;
 		if (appl_ptr + transfer > pcm->buffer_size)
 			transfer = pcm->buffer_size - appl_ptr;
 		if (slave_appl_ptr + transfer > dmix->slave_buffer_size)
 			transfer = dmix->slave_buffer_size - slave_appl_ptr;
-		mix_areas(dmix, src_areas, dst_areas, appl_ptr, slave_appl_ptr, transfer);
+		dmix_mix_chunk(dmix, src_areas, dst_areas, appl_ptr, slave_pos, transfer, 0);
 		size -= transfer;
 		if (! size)
 			break;
+		slave_pos += transfer;
+		slave_pos %= dmix->slave_boundary;
 		slave_appl_ptr += transfer;
 		slave_appl_ptr %= dmix->slave_buffer_size;
 		appl_ptr += transfer;
@@ -405,12 +972,21 @@ static int snd_pcm_dmix_sync_ptr(snd_pcm_t *pcm)
 		break;
 	}
 	if (dmix->slowptr)
-		snd_pcm_hwsync(dmix->spcm);
+		snd_pcm_direct_hwsync(dmix);
 	old_slave_hw_ptr = dmix->slave_hw_ptr;
 	slave_hw_ptr = dmix->slave_hw_ptr = *dmix->spcm->hw.ptr;
 	diff = slave_hw_ptr - old_slave_hw_ptr;
 	if (diff == 0)		/* fast path */
 		return 0;
+	if (dmix->shmptr->mix_slots &&
+	    slave_hw_ptr / dmix->slave_period_size !=
+	    old_slave_hw_ptr / dmix->slave_period_size) {
+		/* a new period, merge the mix slots unless done already */
+		snd_pcm_direct_mix_lock(dmix);
+		dmix_adopt_mixer(dmix);
+		dmix_merge_slots(dmix);
+		snd_pcm_direct_mix_unlock(dmix);
+	}
 	if (dmix->state != SND_PCM_STATE_RUNNING &&
 	    dmix->state != SND_PCM_STATE_DRAINING)
 		/* not really started yet - don't update hw_ptr */
@@ -421,6 +997,7 @@ static int snd_pcm_dmix_sync_ptr(snd_pcm_t *pcm)
 	}
 	dmix->hw_ptr += diff;
 	dmix->hw_ptr %= pcm->boundary;
+	snd_pcm_trace(pcm, SND_PCM_TRACE_DIRECT_SYNC, diff);
 	if (pcm->stop_threshold >= pcm->boundary)	/* don't care */
 		return 0;
 	avail = snd_pcm_mmap_playback_avail(pcm);
@@ -537,7 +1114,7 @@ static int snd_pcm_dmix_hwsync(snd_pcm_t *pcm)
 static void reset_slave_ptr(snd_pcm_t *pcm, snd_pcm_direct_t *dmix)
 {
 	dmix->slave_appl_ptr = dmix->slave_hw_ptr = *dmix->spcm->hw.ptr;
-	if (pcm->buffer_size > pcm->period_size * 2)
+	if (pcm->buffer_size > pcm->period_size * 2 || dmix->rejoin)
 		return;
 	/* If we have too litte periods, better to align the start position
 	 * to the period boundary so that the interrupt can be handled properly
@@ -562,7 +1139,7 @@ static int snd_pcm_dmix_start_timer(snd_pcm_t *pcm, snd_pcm_direct_t *dmix)
 
 	snd_pcm_hwsync(dmix->spcm);
 	reset_slave_ptr(pcm, dmix);
-	err = snd_timer_start(dmix->timer);
+	err = snd_pcm_direct_timer_start(dmix);
 	if (err < 0)
 		return err;
 	dmix->state = SND_PCM_STATE_RUNNING;
@@ -683,7 +1260,7 @@ static snd_pcm_sframes_t snd_pcm_dmix_rewindable(snd_pcm_t *pcm)
 static snd_pcm_sframes_t snd_pcm_dmix_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
-	snd_pcm_uframes_t slave_appl_ptr, slave_size;
+	snd_pcm_uframes_t slave_appl_ptr, slave_size, slave_pos;
 	snd_pcm_uframes_t appl_ptr, size, transfer, result;
 	int err;
 	const snd_pcm_channel_area_t *src_areas, *dst_areas;
@@ -730,7 +1307,8 @@ static snd_pcm_sframes_t snd_pcm_dmix_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t f
 	appl_ptr = dmix->last_appl_ptr % pcm->buffer_size;
 	dmix->slave_appl_ptr -= size;
 	dmix->slave_appl_ptr %= dmix->slave_boundary;
-	slave_appl_ptr = dmix->slave_appl_ptr % dmix->slave_buffer_size;
+	slave_pos = dmix->slave_appl_ptr;
+	slave_appl_ptr = slave_pos % dmix->slave_buffer_size;
 	dmix_down_sem(dmix);
 	for (;;) {
 		transfer = size;
@@ -738,10 +1316,12 @@ static snd_pcm_sframes_t snd_pcm_dmix_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t f
 			transfer = pcm->buffer_size - appl_ptr;
 		if (slave_appl_ptr + transfer > dmix->slave_buffer_size)
 			transfer = dmix->slave_buffer_size - slave_appl_ptr;
-		remix_areas(dmix, src_areas, dst_areas, appl_ptr, slave_appl_ptr, transfer);
+		dmix_mix_chunk(dmix, src_areas, dst_areas, appl_ptr, slave_pos, transfer, 1);
 		size -= transfer;
 		if (! size)
 			break;
+		slave_pos += transfer;
+		slave_pos %= dmix->slave_boundary;
 		slave_appl_ptr += transfer;
 		slave_appl_ptr %= dmix->slave_buffer_size;
 		appl_ptr += transfer;
@@ -788,15 +1368,26 @@ static int snd_pcm_dmix_close(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dmix = pcm->private_data;
 
-	if (dmix->timer)
-		snd_timer_close(dmix->timer);
+	snd_pcm_direct_timer_close(dmix);
+	dmix_stop_mixer(dmix);
 	snd_pcm_direct_semaphore_down(dmix, DIRECT_IPC_SEM_CLIENT);
+	if (dmix->u.dmix.slot >= 0) {
+		/* the semaphore alone doesn't keep off the mixing clients */
+		if (dmix->shmptr->use_futex)
+			snd_pcm_direct_mix_lock(dmix);
+		dmix_release_slot(dmix);
+		if (dmix->shmptr->use_futex)
+			snd_pcm_direct_mix_unlock(dmix);
+	}
+	snd_pcm_direct_linger(dmix, dmix_linger_free);
 	snd_pcm_close(dmix->spcm);
  	if (dmix->server)
  		snd_pcm_direct_server_discard(dmix);
  	if (dmix->client)
  		snd_pcm_direct_client_discard(dmix);
  	shm_sum_discard(dmix);
+	if (dmix->u.dmix.shmid_slots >= 0)
+		shm_slots_discard(dmix);
 	if (snd_pcm_direct_shm_discard(dmix)) {
 		if (snd_pcm_direct_semaphore_discard(dmix))
 			snd_pcm_direct_semaphore_final(dmix, DIRECT_IPC_SEM_CLIENT);
@@ -916,6 +1507,22 @@ static const snd_pcm_ops_t snd_pcm_dmix_ops = {
 	.set_chmap = snd_pcm_direct_set_chmap,
 };
 
+static int snd_pcm_dmix_avail_status(snd_pcm_t *pcm, snd_pcm_status_t *status)
+{
+	snd_pcm_direct_t *dmix = pcm->private_data;
+	int err;
+
+	if (dmix->state == SND_PCM_STATE_RUNNING ||
+	    dmix->state == SND_PCM_STATE_DRAINING) {
+		err = snd_pcm_dmix_sync_ptr(pcm);
+		/* an xrun shows up in the state */
+		if (err < 0 && err != -EPIPE)
+			return err;
+	}
+	snd_pcm_direct_fill_avail_status(pcm, status);
+	return 0;
+}
+
 static const snd_pcm_fast_ops_t snd_pcm_dmix_fast_ops = {
 	.status = snd_pcm_dmix_status,
 	.state = snd_pcm_dmix_state,
@@ -942,6 +1549,7 @@ static const snd_pcm_fast_ops_t snd_pcm_dmix_fast_ops = {
 	.avail_update = snd_pcm_dmix_avail_update,
 	.mmap_commit = snd_pcm_dmix_mmap_commit,
 	.htimestamp = snd_pcm_dmix_htimestamp,
+	.avail_status = snd_pcm_dmix_avail_status,
 	.poll_descriptors = NULL,
 	.poll_descriptors_count = NULL,
 	.poll_revents = snd_pcm_dmix_poll_revents,
@@ -993,8 +1601,21 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 	dmix->ipc_key = opts->ipc_key;
 	dmix->ipc_perm = opts->ipc_perm;
 	dmix->ipc_gid = opts->ipc_gid;
+	dmix->hugepages = opts->hugepages;
+	dmix->numa_bind = opts->numa_bind;
+	dmix->numa_node = -1;
 	dmix->semid = -1;
 	dmix->shmid = -1;
+	dmix->slice_fd = -1;
+	dmix->epoll_fd = -1;
+	dmix->timer_slices = opts->timer_slices;
+	dmix->linger = opts->linger;
+	dmix->hwsync_window = opts->hwsync_window;
+	dmix->fast_recover = opts->fast_recover;
+	dmix->u.dmix.shmid_slots = -1;
+	dmix->u.dmix.slots = (void *) -1;
+	dmix->u.dmix.slot = -1;
+	dmix->u.dmix.mixer = NULL;
 
 	ret = snd_pcm_new(&pcm, dmix->type = SND_PCM_TYPE_DMIX, name, stream, mode);
 	if (ret < 0)
@@ -1120,13 +1741,45 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 		goto _err;
 	}
 
+	if (first_instance && opts->ipc_futex) {
+		ret = snd_pcm_direct_futex_init(dmix);
+		if (ret < 0)
+			SNDERR("ipc_futex ignored: %s", snd_strerror(ret));
+		dmix->shmptr->use_futex = ret >= 0;
+	}
+	dmix->lock_id = getpid();
+
+	if (first_instance) {
+		dmix->shmptr->mix_thread = opts->mix_thread;
+		dmix->shmptr->mix_thread_owner = 0;
+	}
+	/* the mixer thread works on the slots, so give it some by default */
+	dmix_select_slots(dmix, first_instance,
+			  opts->mix_thread && !opts->mix_slots ?
+			  DMIX_THREAD_SLOTS : opts->mix_slots);
+	if (dmix->shmptr->mix_slots) {
+		ret = shm_slots_create_or_connect(dmix);
+		if (ret < 0) {
+			SNDERR("unable to initialize mix slots");
+			goto _err;
+		}
+	}
+
 	ret = snd_pcm_direct_initialize_poll_fd(dmix);
 	if (ret < 0) {
 		SNDERR("unable to initialize poll_fd");
 		goto _err;
 	}
 
-	mix_select_callbacks(dmix);
+	dmix_select_engine(dmix, first_instance, opts->lockless);
+	if (dmix->u.dmix.shmid_slots >= 0) {
+		if (dmix->shmptr->use_futex)
+			snd_pcm_direct_mix_lock(dmix);
+		dmix_claim_slot(dmix);
+		dmix_adopt_mixer(dmix);
+		if (dmix->shmptr->use_futex)
+			snd_pcm_direct_mix_unlock(dmix);
+	}
 		
 	pcm->poll_fd = dmix->poll_fd;
 	pcm->poll_events = POLLIN;	/* it's different than other plugins */
@@ -1144,8 +1797,7 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 	return 0;
 	
  _err:
-	if (dmix->timer)
-		snd_timer_close(dmix->timer);
+	snd_pcm_direct_timer_close(dmix);
 	if (dmix->server)
 		snd_pcm_direct_server_discard(dmix);
 	if (dmix->client)
@@ -1154,6 +1806,8 @@ int snd_pcm_dmix_open(snd_pcm_t **pcmp, const char *name,
 		snd_pcm_close(spcm);
 	if (dmix->u.dmix.shmid_sum >= 0)
 		shm_sum_discard(dmix);
+	if (dmix->u.dmix.shmid_slots >= 0)
+		shm_slots_discard(dmix);
 	if (dmix->shmid >= 0)
 		snd_pcm_direct_shm_discard(dmix);
 	if (snd_pcm_direct_semaphore_discard(dmix) < 0)
@@ -1203,6 +1857,16 @@ pcm.name {
 		N INT		# maps slave channel to client channel N
 	}
 	slowptr BOOL		# slow but more precise pointer updates
+	hwsync_window INT	# us to share a slave pointer update (default 500)
+	lockless BOOL		# mix without the IPC semaphore
+	mix_slots INT		# private mix slots (default 0 = none)
+	mix_thread INT		# mixer thread priority (default 0 = none)
+	hugepages BOOL		# back the sum buffer with huge pages
+	numa_bind BOOL		# keep the shared memory on the card's NUMA node
+	ipc_futex BOOL		# serialize mixing with a futex, not the semaphore
+	timer_slices INT	# wakeups per slave period (default 1)
+	linger INT		# ms to keep the slave after the last close (default 0)
+	fast_recover INT	# frames of silence to restart with after an xrun (default 0 = off)
 }
 \endcode
 
@@ -1214,6 +1878,77 @@ added to the value set in <code>ipc_key</code>.  This will
 avoid the confliction of the same IPC key with different users
 concurrently.
 
+<code>lockless</code> selects the lock-free mixing kernels, so that the
+clients don't serialize on the IPC semaphore while mixing.  It's used
+only for native endian \c S16 and \c S32 slave formats, and it's
+enabled by default except on x86, where the vectorized kernels (which
+need the semaphore) are preferred.  The value set by the first client
+of the slave is used by all others.
+
+<code>mix_slots</code> gives the number of private mix slots (up to 32).
+The first <code>mix_slots</code> clients of the slave each get a private
+slot and put the samples lying more than two periods ahead of the
+hardware pointer there instead of adding them into the shared sum
+buffer; the slots are merged into the slave buffer once per period by
+whichever client notices the period first.  Further clients mix
+directly.  It's used only for native endian \c S16 and \c S32 slave
+formats, it implies <code>lockless false</code>, and like
+<code>lockless</code> the value of the first client is used by all
+others.  A rewind of a slot client only clears the samples still held
+in its slot, without reading the client buffer back; just the last two
+periods before the hardware pointer are remixed as usual.
+
+<code>mix_thread</code> runs the merging of the mix slots in a dedicated
+thread of one client, woken twice per slave period with the given
+\c SCHED_FIFO priority (a normal thread is used when realtime scheduling
+isn't permitted).  The data of all clients then reaches the hardware in
+time even when a client gets scheduled late.  When the client running
+the thread closes, another one takes over at its next period.  It
+implies <code>mix_slots 8</code> unless set, and the value of the first
+client is used by all others.
+
+<code>hugepages</code> allocates the sum buffer (and the mix slots) with
+\c SHM_HUGETLB to save TLB misses on large slave buffers; without
+reserved huge pages the normal pages are used.  <code>numa_bind</code>
+prefers the memory of the NUMA node the sound card is attached to for
+the shared segments, as reported by sysfs.  Both take effect when the
+segments are created, i.e. by the first client.
+
+<code>ipc_futex</code> replaces the IPC semaphore by a futex in the shared
+memory for serializing the mixing (the semaphore still guards open and
+close).  An uncontended lock costs no system call.  The futex is the
+one of a robust mutex: when a client dies holding it, the kernel hands
+it on to the next locker.  The value of the first client is used by all
+others.
+
+<code>timer_slices</code> wakes the clients this many times per slave
+period (default 1) from a timerfd next to the slave timer, so that a
+client with an <code>avail_min</code> below the slave period size is
+served without changing the hardware period.
+
+<code>linger</code> keeps the slave open and running for the given time
+(in milliseconds) after the last client has closed.  A client opened
+meanwhile attaches to it like to a running instance and skips the setup
+of the hardware.  A detached helper process holds the slave and the
+shared memory for that time.  It is not used with the old kernels which
+need the server mode.
+
+<code>hwsync_window</code> lets a client reuse the slave pointer update
+done by another client within the given time (in microseconds, default
+500, 0 = off) with <code>slowptr</code>, instead of asking the kernel
+itself, so that the clients woken up by the same period do a single
+update.  It has no effect when the slave status cannot be mmapped.
+
+<code>fast_recover</code> restarts a client within #snd_pcm_prepare,
+e.g. from #snd_pcm_recover, after its own xrun while the slave plays on:
+the given number of frames of silence (at most a period) is queued at
+the current slave position, mid-period, and the stream is running
+again, so the next write is heard after that silence instead of after
+refilling up to the start threshold and waiting for a period boundary.
+It is not applied when the slave itself has to be restarted.  As the
+stream runs after the prepare, an application which starts it
+explicitly gets -EBADFD from #snd_pcm_start.
+
 Note that the dmix plugin itself supports only a single configuration.
 That is, it supports only the fixed rate (default 48000), format
 (\c S16), channels (2), and period_time (125000).
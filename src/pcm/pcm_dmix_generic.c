@@ -1,129 +1,9 @@
-#if 0
-//#if defined(__i386__) || defined(__x86_64__)
-#define LOCK_PREFIX "lock ; "
-#define ARCH_ADD(p,a)					\
-	__asm__ __volatile__(LOCK_PREFIX "addl %1,%0"	\
-			     :"=m" (*p)			\
-			     :"ir" (a), "m" (*p))
-struct __xchg_dummy { unsigned long a[100]; };
-#define __xg(x) ((struct __xchg_dummy *)(x))
-static inline unsigned long __cmpxchg(volatile void *ptr, unsigned long old,
-				      unsigned long new, int size)
-{
-	unsigned long prev;
-	switch (size) {
-	case 1:
-		__asm__ __volatile__(LOCK_PREFIX "cmpxchgb %b1,%2"
-				     : "=a"(prev)
-				     : "q"(new), "m"(*__xg(ptr)), "0"(old)
-				     : "memory");
-		return prev;
-	case 2:
-		__asm__ __volatile__(LOCK_PREFIX "cmpxchgw %w1,%2"
-				     : "=a"(prev)
-				     : "q"(new), "m"(*__xg(ptr)), "0"(old)
-				     : "memory");
-		return prev;
-	case 4:
-		__asm__ __volatile__(LOCK_PREFIX "cmpxchgl %1,%2"
-				     : "=a"(prev)
-				     : "q"(new), "m"(*__xg(ptr)), "0"(old)
-				     : "memory");
-		return prev;
-	}
-	return old;
-}
-
-#define ARCH_CMPXCHG(ptr,o,n)\
-	((__typeof__(*(ptr)))__cmpxchg((ptr),(unsigned long)(o),\
-					(unsigned long)(n),sizeof(*(ptr))))
-#define IS_CONCURRENT	1	/* check race */
-#endif
-
-#ifndef ARCH_ADD
-#define ARCH_ADD(p,a) (*(p) += (a))
-#define ARCH_CMPXCHG(p,a,b) (*(p)) /* fake */
-#define NO_CONCURRENT_ACCESS	/* use semaphore to avoid race */
-#define IS_CONCURRENT	0	/* no race check */
-#endif
-
-#if IS_CONCURRENT
-static void mix_areas_16(unsigned int size,
-			 volatile signed short *dst, signed short *src,
-			 volatile signed int *sum, size_t dst_step,
-			 size_t src_step, size_t sum_step)
-{
-	register signed int sample, old_sample;
-
-	for (;;) {
-		sample = *src;
-		old_sample = *sum;
-		if (ARCH_CMPXCHG(dst, 0, 1) == 0)
-			sample -= old_sample;
-		ARCH_ADD(sum, sample);
-		do {
-			old_sample = *sum;
-			if (old_sample > 0x7fff)
-				sample = 0x7fff;
-			else if (old_sample < -0x8000)
-				sample = -0x8000;
-			else
-				sample = old_sample;
-			*dst = sample;
-		} while (IS_CONCURRENT && *sum != old_sample);
-		if (!--size)
-			return;
-		src = (signed short *) ((char *)src + src_step);
-		dst = (signed short *) ((char *)dst + dst_step);
-		sum = (signed int *)   ((char *)sum + sum_step);
-	}
-}
-
-static void mix_areas_32(unsigned int size,
-			 volatile signed int *dst, signed int *src,
-			 volatile signed int *sum, size_t dst_step,
-			 size_t src_step, size_t sum_step)
-{
-	register signed int sample, old_sample;
-
-	for (;;) {
-		sample = *src >> 8;
-		old_sample = *sum;
-		if (ARCH_CMPXCHG(dst, 0, 1) == 0)
-			sample -= old_sample;
-		ARCH_ADD(sum, sample);
-		do {
-			old_sample = *sum;
-			if (old_sample > 0x7fffff)
-				sample = 0x7fffffff;
-			else if (old_sample < -0x800000)
-				sample = -0x80000000;
-			else
-				sample = old_sample * 256;
-			*dst = sample;
-		} while (IS_CONCURRENT && *sum != old_sample);
-		if (!--size)
-			return;
-		src = (signed int *) ((char *)src + src_step);
-		dst = (signed int *) ((char *)dst + dst_step);
-		sum = (signed int *) ((char *)sum + sum_step);
-	}
-}
-
-static void mix_select_callbacks(snd_pcm_direct_t *dmix)
-{
-	dmix->u.dmix.mix_areas_16 = mix_areas_16;
-	dmix->u.dmix.mix_areas_32 = mix_areas_32;
-}
-
-#else
-
 /* non-concurrent version, supporting both endians */
 #define generic_dmix_supported_format \
 	((1ULL << SND_PCM_FORMAT_S16_LE) | (1ULL << SND_PCM_FORMAT_S32_LE) |\
 	 (1ULL << SND_PCM_FORMAT_S16_BE) | (1ULL << SND_PCM_FORMAT_S32_BE) |\
 	 (1ULL << SND_PCM_FORMAT_S24_LE) | (1ULL << SND_PCM_FORMAT_S24_3LE) | \
-	 (1ULL << SND_PCM_FORMAT_U8))
+	 (1ULL << SND_PCM_FORMAT_U8) | (1ULL << SND_PCM_FORMAT_FLOAT))
 
 #include "bswap.h"
 
@@ -512,6 +392,71 @@ static void generic_remix_areas_u8(unsigned int size,
 	}
 }
 
+/*
+ * native endian float; the sum buffer keeps the unclipped float sum,
+ * the output is clipped to the nominal range
+ */
+static void generic_mix_areas_float(unsigned int size,
+				    volatile float *dst,
+				    float *src,
+				    volatile float *sum,
+				    size_t dst_step,
+				    size_t src_step,
+				    size_t sum_step)
+{
+	register float sample;
+
+	for (;;) {
+		sample = *src;
+		if (*dst == 0.0f) {
+			*sum = sample;
+		} else {
+			sample += *sum;
+			*sum = sample;
+		}
+		if (sample > 1.0f)
+			sample = 1.0f;
+		else if (sample < -1.0f)
+			sample = -1.0f;
+		*dst = sample;
+		if (!--size)
+			return;
+		src = (float *) ((char *)src + src_step);
+		dst = (float *) ((char *)dst + dst_step);
+		sum = (float *) ((char *)sum + sum_step);
+	}
+}
+
+static void generic_remix_areas_float(unsigned int size,
+				      volatile float *dst,
+				      float *src,
+				      volatile float *sum,
+				      size_t dst_step,
+				      size_t src_step,
+				      size_t sum_step)
+{
+	register float sample;
+
+	for (;;) {
+		sample = *src;
+		if (*dst == 0.0f) {
+			sample = -sample;
+			*sum = sample;
+		} else {
+			*sum = sample = *sum - sample;
+		}
+		if (sample > 1.0f)
+			sample = 1.0f;
+		else if (sample < -1.0f)
+			sample = -1.0f;
+		*dst = sample;
+		if (!--size)
+			return;
+		src = (float *) ((char *)src + src_step);
+		dst = (float *) ((char *)dst + dst_step);
+		sum = (float *) ((char *)sum + sum_step);
+	}
+}
 
 static void generic_mix_select_callbacks(snd_pcm_direct_t *dmix)
 {
@@ -530,6 +475,179 @@ static void generic_mix_select_callbacks(snd_pcm_direct_t *dmix)
 	dmix->u.dmix.mix_areas_u8 = generic_mix_areas_u8;
 	dmix->u.dmix.remix_areas_24 = generic_remix_areas_24;
 	dmix->u.dmix.remix_areas_u8 = generic_remix_areas_u8;
+	dmix->u.dmix.mix_areas_float = generic_mix_areas_float;
+	dmix->u.dmix.remix_areas_float = generic_remix_areas_float;
 }
 
+/*
+ * lock-free version, using the compiler atomic builtins
+ *
+ * Clients may mix concurrently: the first writer to a slot claims it by
+ * changing the destination sample from zero, and discards the stale sum;
+ * the destination is rewritten until it matches the current sum.
+ * Only native endian 16 and 32 bit formats are handled.
+ */
+#ifdef __ATOMIC_SEQ_CST
+
+#define generic_dmix_lockless_format \
+	((1ULL << SND_PCM_FORMAT_S16) | (1ULL << SND_PCM_FORMAT_S32))
+
+static void generic_mix_areas_16_atomic(unsigned int size,
+					volatile signed short *dst,
+					signed short *src,
+					volatile signed int *sum,
+					size_t dst_step,
+					size_t src_step,
+					size_t sum_step)
+{
+	register signed int sample, old_sample;
+	signed short empty;
+
+	for (;;) {
+		sample = *src;
+		old_sample = __atomic_load_n(sum, __ATOMIC_RELAXED);
+		empty = 0;
+		if (__atomic_compare_exchange_n(dst, &empty, 1, 0,
+						__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			sample -= old_sample;
+		__atomic_add_fetch(sum, sample, __ATOMIC_ACQ_REL);
+		do {
+			old_sample = __atomic_load_n(sum, __ATOMIC_ACQUIRE);
+			if (old_sample > 0x7fff)
+				sample = 0x7fff;
+			else if (old_sample < -0x8000)
+				sample = -0x8000;
+			else
+				sample = old_sample;
+			__atomic_store_n(dst, sample, __ATOMIC_RELEASE);
+		} while (__atomic_load_n(sum, __ATOMIC_ACQUIRE) != old_sample);
+		if (!--size)
+			return;
+		src = (signed short *) ((char *)src + src_step);
+		dst = (signed short *) ((char *)dst + dst_step);
+		sum = (signed int *)   ((char *)sum + sum_step);
+	}
+}
+
+static void generic_remix_areas_16_atomic(unsigned int size,
+					  volatile signed short *dst,
+					  signed short *src,
+					  volatile signed int *sum,
+					  size_t dst_step,
+					  size_t src_step,
+					  size_t sum_step)
+{
+	register signed int sample, old_sample;
+	signed short empty;
+
+	for (;;) {
+		sample = *src;
+		old_sample = __atomic_load_n(sum, __ATOMIC_RELAXED);
+		empty = 0;
+		if (__atomic_compare_exchange_n(dst, &empty, 1, 0,
+						__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			sample += old_sample;
+		__atomic_sub_fetch(sum, sample, __ATOMIC_ACQ_REL);
+		do {
+			old_sample = __atomic_load_n(sum, __ATOMIC_ACQUIRE);
+			if (old_sample > 0x7fff)
+				sample = 0x7fff;
+			else if (old_sample < -0x8000)
+				sample = -0x8000;
+			else
+				sample = old_sample;
+			__atomic_store_n(dst, sample, __ATOMIC_RELEASE);
+		} while (__atomic_load_n(sum, __ATOMIC_ACQUIRE) != old_sample);
+		if (!--size)
+			return;
+		src = (signed short *) ((char *)src + src_step);
+		dst = (signed short *) ((char *)dst + dst_step);
+		sum = (signed int *)   ((char *)sum + sum_step);
+	}
+}
+
+static void generic_mix_areas_32_atomic(unsigned int size,
+					volatile signed int *dst,
+					signed int *src,
+					volatile signed int *sum,
+					size_t dst_step,
+					size_t src_step,
+					size_t sum_step)
+{
+	register signed int sample, old_sample;
+	signed int empty;
+
+	for (;;) {
+		sample = *src >> 8;
+		old_sample = __atomic_load_n(sum, __ATOMIC_RELAXED);
+		empty = 0;
+		if (__atomic_compare_exchange_n(dst, &empty, 1, 0,
+						__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			sample -= old_sample;
+		__atomic_add_fetch(sum, sample, __ATOMIC_ACQ_REL);
+		do {
+			old_sample = __atomic_load_n(sum, __ATOMIC_ACQUIRE);
+			if (old_sample > 0x7fffff)
+				sample = 0x7fffffff;
+			else if (old_sample < -0x800000)
+				sample = -0x80000000;
+			else
+				sample = old_sample * 256;
+			__atomic_store_n(dst, sample, __ATOMIC_RELEASE);
+		} while (__atomic_load_n(sum, __ATOMIC_ACQUIRE) != old_sample);
+		if (!--size)
+			return;
+		src = (signed int *) ((char *)src + src_step);
+		dst = (signed int *) ((char *)dst + dst_step);
+		sum = (signed int *) ((char *)sum + sum_step);
+	}
+}
+
+static void generic_remix_areas_32_atomic(unsigned int size,
+					  volatile signed int *dst,
+					  signed int *src,
+					  volatile signed int *sum,
+					  size_t dst_step,
+					  size_t src_step,
+					  size_t sum_step)
+{
+	register signed int sample, old_sample;
+	signed int empty;
+
+	for (;;) {
+		sample = *src >> 8;
+		old_sample = __atomic_load_n(sum, __ATOMIC_RELAXED);
+		empty = 0;
+		if (__atomic_compare_exchange_n(dst, &empty, 1, 0,
+						__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			sample += old_sample;
+		__atomic_sub_fetch(sum, sample, __ATOMIC_ACQ_REL);
+		do {
+			old_sample = __atomic_load_n(sum, __ATOMIC_ACQUIRE);
+			if (old_sample > 0x7fffff)
+				sample = 0x7fffffff;
+			else if (old_sample < -0x800000)
+				sample = -0x80000000;
+			else
+				sample = old_sample * 256;
+			__atomic_store_n(dst, sample, __ATOMIC_RELEASE);
+		} while (__atomic_load_n(sum, __ATOMIC_ACQUIRE) != old_sample);
+		if (!--size)
+			return;
+		src = (signed int *) ((char *)src + src_step);
+		dst = (signed int *) ((char *)dst + dst_step);
+		sum = (signed int *) ((char *)sum + sum_step);
+	}
+}
+
+static void generic_lockless_mix_select_callbacks(snd_pcm_direct_t *dmix)
+{
+	dmix->u.dmix.mix_areas_16 = generic_mix_areas_16_atomic;
+	dmix->u.dmix.mix_areas_32 = generic_mix_areas_32_atomic;
+	dmix->u.dmix.remix_areas_16 = generic_remix_areas_16_atomic;
+	dmix->u.dmix.remix_areas_32 = generic_remix_areas_32_atomic;
+}
+
+#else
+#define generic_dmix_lockless_format	0ULL
 #endif
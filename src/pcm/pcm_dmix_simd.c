@@ -0,0 +1,510 @@
+/*
+ * vectorized mixing code (SSE2, SSSE3, AVX2, NEON)
+ *
+ * The kernels below implement the same sum buffer protocol as the
+ * generic ones: the sum buffer keeps the unclipped 32-bit sum, and a zero
+ * destination sample means that no client has written to the slot yet,
+ * so that the stale sum is discarded.  Mixing is serialized by the
+ * DIRECT_IPC_SEM_CLIENT semaphore, hence plain loads and stores are used.
+ *
+ * Only the contiguous case (interleaved areas processed in one run) is
+ * vectorized; strided areas fall back to the generic native kernels.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DMIX_SIMD_X86
+#include <immintrin.h>
+#elif defined(__GNUC__) && (defined(__aarch64__) || defined(__ARM_NEON))
+#define DMIX_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#define simd_dmix_supported_format \
+	((1ULL << SND_PCM_FORMAT_S16) | (1ULL << SND_PCM_FORMAT_S32) | \
+	 (1ULL << SND_PCM_FORMAT_S24_3LE) | (1ULL << SND_PCM_FORMAT_FLOAT))
+
+#define SIMD_CONTIGUOUS(dst_step, src_step, sum_step) \
+	((dst_step) == (src_step) && (dst_step) == sizeof(*dst) && \
+	 (sum_step) == sizeof(signed int))
+
+#ifdef DMIX_SIMD_X86
+
+#ifdef __x86_64__
+#define SSE2_TARGET
+#else
+#define SSE2_TARGET	__attribute__((target("sse2")))
+#endif
+#define SSSE3_TARGET	__attribute__((target("ssse3")))
+#define AVX2_TARGET	__attribute__((target("avx2")))
+
+/*
+ * SSE2: 8 samples (16-bit) or 4 samples (32-bit) per iteration
+ *
+ * A sample which is the first in its slot is stored like the scalar code
+ * does, without saturation: negated for the remix, -32768 stays -32768.
+ */
+
+#define SSE2_FIRST_MIX(zero, s)		(s)
+#define SSE2_FIRST_REMIX(zero, s)	_mm_sub_epi32(zero, s)
+#define SSE2_FIRST_REMIX_16(zero, s)	_mm_sub_epi16(zero, s)
+
+#define SSE2_MIX_16(name, op, first, scalar)				\
+SSE2_TARGET static void name(unsigned int size,				\
+			     volatile signed short *dst,		\
+			     signed short *src,				\
+			     volatile signed int *sum,			\
+			     size_t dst_step, size_t src_step,		\
+			     size_t sum_step)				\
+{									\
+	const __m128i zero = _mm_setzero_si128();			\
+	__m128i s, d, m, slo, shi, mlo, mhi, sumlo, sumhi;		\
+									\
+	if (!SIMD_CONTIGUOUS(dst_step, src_step, sum_step)) {	\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	for (; size >= 8; size -= 8) {					\
+		s = _mm_loadu_si128((__m128i *)src);			\
+		d = _mm_loadu_si128((__m128i *)dst);			\
+		m = _mm_cmpeq_epi16(d, zero);				\
+		slo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);	\
+		shi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);	\
+		mlo = _mm_unpacklo_epi16(m, m);				\
+		mhi = _mm_unpackhi_epi16(m, m);				\
+		sumlo = _mm_andnot_si128(mlo, _mm_loadu_si128((__m128i *)sum)); \
+		sumhi = _mm_andnot_si128(mhi, _mm_loadu_si128((__m128i *)(sum + 4))); \
+		sumlo = op(sumlo, slo);					\
+		sumhi = op(sumhi, shi);					\
+		_mm_storeu_si128((__m128i *)sum, sumlo);		\
+		_mm_storeu_si128((__m128i *)(sum + 4), sumhi);		\
+		d = _mm_andnot_si128(m, _mm_packs_epi32(sumlo, sumhi));	\
+		d = _mm_or_si128(d, _mm_and_si128(m, first(zero, s)));	\
+		_mm_storeu_si128((__m128i *)dst, d);			\
+		src += 8;						\
+		dst += 8;						\
+		sum += 8;						\
+	}								\
+	if (size)							\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+}
+
+SSE2_MIX_16(sse2_mix_areas_16, _mm_add_epi32, SSE2_FIRST_MIX,
+	    generic_mix_areas_16_native)
+SSE2_MIX_16(sse2_remix_areas_16, _mm_sub_epi32, SSE2_FIRST_REMIX_16,
+	    generic_remix_areas_16_native)
+
+/* clip the 24-bit sum and scale it back to 32 bits */
+SSE2_TARGET static inline __m128i sse2_clip_32(__m128i v)
+{
+	const __m128i maxv = _mm_set1_epi32(0x7fffff);
+	const __m128i minv = _mm_set1_epi32(-0x800000);
+	__m128i gt = _mm_cmpgt_epi32(v, maxv);
+	__m128i lt = _mm_cmplt_epi32(v, minv);
+	__m128i r = _mm_slli_epi32(v, 8);
+
+	r = _mm_andnot_si128(_mm_or_si128(gt, lt), r);
+	r = _mm_or_si128(r, _mm_and_si128(gt, _mm_set1_epi32(0x7fffffff)));
+	return _mm_or_si128(r, _mm_and_si128(lt, _mm_set1_epi32((int)0x80000000)));
+}
+
+#define SSE2_MIX_32(name, op, first, scalar)				\
+SSE2_TARGET static void name(unsigned int size,				\
+			     volatile signed int *dst,			\
+			     signed int *src,				\
+			     volatile signed int *sum,			\
+			     size_t dst_step, size_t src_step,		\
+			     size_t sum_step)				\
+{									\
+	const __m128i zero = _mm_setzero_si128();			\
+	__m128i s, d, m, v;						\
+									\
+	if (!SIMD_CONTIGUOUS(dst_step, src_step, sum_step)) {	\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	for (; size >= 4; size -= 4) {					\
+		s = _mm_loadu_si128((__m128i *)src);			\
+		d = _mm_loadu_si128((__m128i *)dst);			\
+		m = _mm_cmpeq_epi32(d, zero);				\
+		v = _mm_andnot_si128(m, _mm_loadu_si128((__m128i *)sum)); \
+		v = op(v, _mm_srai_epi32(s, 8));			\
+		_mm_storeu_si128((__m128i *)sum, v);			\
+		v = _mm_or_si128(_mm_andnot_si128(m, sse2_clip_32(v)),	\
+				 _mm_and_si128(m, first(zero, s)));	\
+		_mm_storeu_si128((__m128i *)dst, v);			\
+		src += 4;						\
+		dst += 4;						\
+		sum += 4;						\
+	}								\
+	if (size)							\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+}
+
+SSE2_MIX_32(sse2_mix_areas_32, _mm_add_epi32, SSE2_FIRST_MIX,
+	    generic_mix_areas_32_native)
+SSE2_MIX_32(sse2_remix_areas_32, _mm_sub_epi32, SSE2_FIRST_REMIX,
+	    generic_remix_areas_32_native)
+
+#define SSE2_FIRST_MIX_FLOAT(s)		(s)
+#define SSE2_FIRST_REMIX_FLOAT(s)	_mm_xor_ps(s, _mm_set1_ps(-0.0f))
+
+#define SSE2_MIX_FLOAT(name, op, first, scalar)			\
+SSE2_TARGET static void name(unsigned int size,				\
+			     volatile float *dst,			\
+			     float *src,				\
+			     volatile float *sum,			\
+			     size_t dst_step, size_t src_step,		\
+			     size_t sum_step)				\
+{									\
+	const __m128 zero = _mm_setzero_ps();				\
+	const __m128 maxv = _mm_set1_ps(1.0f);				\
+	const __m128 minv = _mm_set1_ps(-1.0f);				\
+	__m128 s, m, v;							\
+									\
+	if (!SIMD_CONTIGUOUS(dst_step, src_step, sum_step)) {	\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	for (; size >= 4; size -= 4) {					\
+		s = _mm_loadu_ps(src);					\
+		m = _mm_cmpeq_ps(_mm_loadu_ps((float *)dst), zero);	\
+		v = _mm_andnot_ps(m, op(_mm_loadu_ps((float *)sum), s)); \
+		v = _mm_or_ps(v, _mm_and_ps(m, first(s)));		\
+		_mm_storeu_ps((float *)sum, v);				\
+		_mm_storeu_ps((float *)dst,				\
+			      _mm_max_ps(_mm_min_ps(v, maxv), minv));	\
+		src += 4;						\
+		dst += 4;						\
+		sum += 4;						\
+	}								\
+	if (size)							\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+}
+
+SSE2_MIX_FLOAT(sse2_mix_areas_float, _mm_add_ps, SSE2_FIRST_MIX_FLOAT,
+	       generic_mix_areas_float)
+SSE2_MIX_FLOAT(sse2_remix_areas_float, _mm_sub_ps, SSE2_FIRST_REMIX_FLOAT,
+	       generic_remix_areas_float)
+
+/*
+ * SSSE3: 4 packed 24-bit samples per iteration; the samples are
+ * shuffled into the upper three bytes of 32-bit lanes and back
+ */
+
+#define SSSE3_MIX_24(name, op, scalar)					\
+SSSE3_TARGET static void name(unsigned int size,			\
+			      volatile unsigned char *dst,		\
+			      unsigned char *src,			\
+			      volatile signed int *sum,			\
+			      size_t dst_step, size_t src_step,		\
+			      size_t sum_step)				\
+{									\
+	const __m128i unpack = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5,	\
+					     -1, 6, 7, 8, -1, 9, 10, 11); \
+	const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9,	\
+					   10, 12, 13, 14, -1, -1, -1, -1); \
+	const __m128i zero = _mm_setzero_si128();			\
+	const __m128i maxv = _mm_set1_epi32(0x7fffff);			\
+	const __m128i minv = _mm_set1_epi32(-0x800000);			\
+	__m128i s, m, v, gt, lt, r;					\
+	int tail;							\
+									\
+	if (dst_step != 3 || src_step != 3 ||				\
+	    sum_step != sizeof(signed int)) {				\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	/* a 16 byte load covers 4 samples and a part of the next two */ \
+	for (; size >= 6; size -= 4) {					\
+		s = _mm_loadu_si128((__m128i *)src);			\
+		s = _mm_srai_epi32(_mm_shuffle_epi8(s, unpack), 8);	\
+		m = _mm_loadu_si128((__m128i *)dst);			\
+		m = _mm_cmpeq_epi32(_mm_shuffle_epi8(m, unpack), zero);	\
+		v = _mm_andnot_si128(m, _mm_loadu_si128((__m128i *)sum)); \
+		v = op(v, s);						\
+		_mm_storeu_si128((__m128i *)sum, v);			\
+		gt = _mm_andnot_si128(m, _mm_cmpgt_epi32(v, maxv));	\
+		lt = _mm_andnot_si128(m, _mm_cmplt_epi32(v, minv));	\
+		r = _mm_andnot_si128(_mm_or_si128(gt, lt), v);		\
+		r = _mm_or_si128(r, _mm_and_si128(gt, maxv));		\
+		r = _mm_or_si128(r, _mm_and_si128(lt, minv));		\
+		r = _mm_shuffle_epi8(r, pack);				\
+		_mm_storel_epi64((__m128i *)dst, r);			\
+		tail = _mm_cvtsi128_si32(_mm_srli_si128(r, 8));		\
+		memcpy((unsigned char *)dst + 8, &tail, 4);		\
+		src += 12;						\
+		dst += 12;						\
+		sum += 4;						\
+	}								\
+	scalar(size, dst, src, sum, dst_step, src_step, sum_step);	\
+}
+
+SSSE3_MIX_24(ssse3_mix_areas_24, _mm_add_epi32, generic_mix_areas_24)
+SSSE3_MIX_24(ssse3_remix_areas_24, _mm_sub_epi32, generic_remix_areas_24)
+
+/*
+ * AVX2: 8 samples per iteration
+ */
+
+#define AVX2_MIX_16(name, op, first, scalar)				\
+AVX2_TARGET static void name(unsigned int size,				\
+			     volatile signed short *dst,		\
+			     signed short *src,				\
+			     volatile signed int *sum,			\
+			     size_t dst_step, size_t src_step,		\
+			     size_t sum_step)				\
+{									\
+	const __m128i zero = _mm_setzero_si128();			\
+	__m256i s, m, v;						\
+	__m128i s16, d, m16;						\
+									\
+	if (!SIMD_CONTIGUOUS(dst_step, src_step, sum_step)) {	\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	for (; size >= 8; size -= 8) {					\
+		s16 = _mm_loadu_si128((__m128i *)src);			\
+		s = _mm256_cvtepi16_epi32(s16);				\
+		d = _mm_loadu_si128((__m128i *)dst);			\
+		m16 = _mm_cmpeq_epi16(d, zero);				\
+		m = _mm256_cvtepi16_epi32(m16);				\
+		v = _mm256_andnot_si256(m, _mm256_loadu_si256((__m256i *)sum)); \
+		v = op(v, s);						\
+		_mm256_storeu_si256((__m256i *)sum, v);			\
+		d = _mm_packs_epi32(_mm256_castsi256_si128(v),		\
+				    _mm256_extracti128_si256(v, 1));	\
+		d = _mm_blendv_epi8(d, first(zero, s16), m16);		\
+		_mm_storeu_si128((__m128i *)dst, d);			\
+		src += 8;						\
+		dst += 8;						\
+		sum += 8;						\
+	}								\
+	if (size)							\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+}
+
+AVX2_MIX_16(avx2_mix_areas_16, _mm256_add_epi32, SSE2_FIRST_MIX,
+	    generic_mix_areas_16_native)
+AVX2_MIX_16(avx2_remix_areas_16, _mm256_sub_epi32, SSE2_FIRST_REMIX_16,
+	    generic_remix_areas_16_native)
+
+#define AVX2_MIX_32(name, op, first, scalar)				\
+AVX2_TARGET static void name(unsigned int size,				\
+			     volatile signed int *dst,			\
+			     signed int *src,				\
+			     volatile signed int *sum,			\
+			     size_t dst_step, size_t src_step,		\
+			     size_t sum_step)				\
+{									\
+	const __m256i zero = _mm256_setzero_si256();			\
+	const __m256i maxv = _mm256_set1_epi32(0x7fffff);		\
+	const __m256i minv = _mm256_set1_epi32(-0x800000);		\
+	const __m256i lsb = _mm256_set1_epi32(0xff);			\
+	__m256i s, m, v, r;						\
+									\
+	if (!SIMD_CONTIGUOUS(dst_step, src_step, sum_step)) {	\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	for (; size >= 8; size -= 8) {					\
+		s = _mm256_loadu_si256((__m256i *)src);			\
+		m = _mm256_cmpeq_epi32(_mm256_loadu_si256((__m256i *)dst), zero); \
+		v = _mm256_andnot_si256(m, _mm256_loadu_si256((__m256i *)sum)); \
+		v = op(v, _mm256_srai_epi32(s, 8));			\
+		_mm256_storeu_si256((__m256i *)sum, v);			\
+		r = _mm256_max_epi32(_mm256_min_epi32(v, maxv), minv);	\
+		r = _mm256_or_si256(_mm256_slli_epi32(r, 8),		\
+				    _mm256_and_si256(_mm256_cmpgt_epi32(v, maxv), lsb)); \
+		r = _mm256_blendv_epi8(r, first(zero, s), m);		\
+		_mm256_storeu_si256((__m256i *)dst, r);			\
+		src += 8;						\
+		dst += 8;						\
+		sum += 8;						\
+	}								\
+	if (size)							\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+}
+
+#define AVX2_FIRST_MIX(zero, s)		(s)
+#define AVX2_FIRST_REMIX(zero, s)	_mm256_sub_epi32(zero, s)
+
+AVX2_MIX_32(avx2_mix_areas_32, _mm256_add_epi32, AVX2_FIRST_MIX,
+	    generic_mix_areas_32_native)
+AVX2_MIX_32(avx2_remix_areas_32, _mm256_sub_epi32, AVX2_FIRST_REMIX,
+	    generic_remix_areas_32_native)
+
+#endif /* DMIX_SIMD_X86 */
+
+#ifdef DMIX_SIMD_NEON
+
+/*
+ * NEON: 8 samples (16-bit) or 4 samples (32-bit) per iteration
+ */
+
+#define NEON_FIRST_MIX(s)	(s)
+#define NEON_FIRST_REMIX(s)	vnegq_s32(s)
+#define NEON_FIRST_REMIX_16(s)	vnegq_s16(s)
+
+#define NEON_MIX_16(name, op, first, scalar)				\
+static void name(unsigned int size,					\
+		 volatile signed short *dst,				\
+		 signed short *src,					\
+		 volatile signed int *sum,				\
+		 size_t dst_step, size_t src_step,			\
+		 size_t sum_step)					\
+{									\
+	int16x8_t s;							\
+	int32x4_t m, sumlo, sumhi;					\
+	uint16x8_t z;							\
+									\
+	if (!SIMD_CONTIGUOUS(dst_step, src_step, sum_step)) {	\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	for (; size >= 8; size -= 8) {					\
+		s = vld1q_s16(src);					\
+		z = vceqq_s16(vld1q_s16((signed short *)dst), vdupq_n_s16(0)); \
+		m = vmovl_s16(vreinterpret_s16_u16(vget_low_u16(z)));	\
+		sumlo = vbicq_s32(vld1q_s32((signed int *)sum), m);	\
+		m = vmovl_s16(vreinterpret_s16_u16(vget_high_u16(z)));	\
+		sumhi = vbicq_s32(vld1q_s32((signed int *)sum + 4), m);	\
+		sumlo = op(sumlo, vmovl_s16(vget_low_s16(s)));		\
+		sumhi = op(sumhi, vmovl_s16(vget_high_s16(s)));		\
+		vst1q_s32((signed int *)sum, sumlo);			\
+		vst1q_s32((signed int *)sum + 4, sumhi);		\
+		vst1q_s16((signed short *)dst,				\
+			  vbslq_s16(z, first(s),			\
+				    vcombine_s16(vqmovn_s32(sumlo),	\
+						 vqmovn_s32(sumhi))));	\
+		src += 8;						\
+		dst += 8;						\
+		sum += 8;						\
+	}								\
+	if (size)							\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+}
+
+NEON_MIX_16(neon_mix_areas_16, vaddq_s32, NEON_FIRST_MIX,
+	    generic_mix_areas_16_native)
+NEON_MIX_16(neon_remix_areas_16, vsubq_s32, NEON_FIRST_REMIX_16,
+	    generic_remix_areas_16_native)
+
+#define NEON_MIX_32(name, op, first, scalar)				\
+static void name(unsigned int size,					\
+		 volatile signed int *dst,				\
+		 signed int *src,					\
+		 volatile signed int *sum,				\
+		 size_t dst_step, size_t src_step,			\
+		 size_t sum_step)					\
+{									\
+	const int32x4_t maxv = vdupq_n_s32(0x7fffff);			\
+	const int32x4_t minv = vdupq_n_s32(-0x800000);			\
+	int32x4_t s, v, r;						\
+	uint32x4_t m;							\
+									\
+	if (!SIMD_CONTIGUOUS(dst_step, src_step, sum_step)) {	\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	for (; size >= 4; size -= 4) {					\
+		s = vld1q_s32(src);					\
+		m = vceqq_s32(vld1q_s32((signed int *)dst), vdupq_n_s32(0)); \
+		v = vbicq_s32(vld1q_s32((signed int *)sum), vreinterpretq_s32_u32(m)); \
+		v = op(v, vshrq_n_s32(s, 8));				\
+		vst1q_s32((signed int *)sum, v);			\
+		r = vshlq_n_s32(vmaxq_s32(vminq_s32(v, maxv), minv), 8); \
+		r = vorrq_s32(r, vandq_s32(vreinterpretq_s32_u32(vcgtq_s32(v, maxv)), \
+					   vdupq_n_s32(0xff)));		\
+		vst1q_s32((signed int *)dst, vbslq_s32(m, first(s), r)); \
+		src += 4;						\
+		dst += 4;						\
+		sum += 4;						\
+	}								\
+	if (size)							\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+}
+
+NEON_MIX_32(neon_mix_areas_32, vaddq_s32, NEON_FIRST_MIX,
+	    generic_mix_areas_32_native)
+NEON_MIX_32(neon_remix_areas_32, vsubq_s32, NEON_FIRST_REMIX,
+	    generic_remix_areas_32_native)
+
+#define NEON_FIRST_REMIX_FLOAT(s)	vnegq_f32(s)
+
+#define NEON_MIX_FLOAT(name, op, first, scalar)			\
+static void name(unsigned int size,					\
+		 volatile float *dst,					\
+		 float *src,						\
+		 volatile float *sum,					\
+		 size_t dst_step, size_t src_step,			\
+		 size_t sum_step)					\
+{									\
+	const float32x4_t maxv = vdupq_n_f32(1.0f);			\
+	const float32x4_t minv = vdupq_n_f32(-1.0f);			\
+	float32x4_t s, v;						\
+	uint32x4_t m;							\
+									\
+	if (!SIMD_CONTIGUOUS(dst_step, src_step, sum_step)) {	\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+		return;							\
+	}								\
+	for (; size >= 4; size -= 4) {					\
+		s = vld1q_f32(src);					\
+		m = vceqq_f32(vld1q_f32((float *)dst), vdupq_n_f32(0.0f)); \
+		v = vbslq_f32(m, first(s), op(vld1q_f32((float *)sum), s)); \
+		vst1q_f32((float *)sum, v);				\
+		vst1q_f32((float *)dst, vmaxq_f32(vminq_f32(v, maxv), minv)); \
+		src += 4;						\
+		dst += 4;						\
+		sum += 4;						\
+	}								\
+	if (size)							\
+		scalar(size, dst, src, sum, dst_step, src_step, sum_step); \
+}
+
+NEON_MIX_FLOAT(neon_mix_areas_float, vaddq_f32, NEON_FIRST_MIX,
+	       generic_mix_areas_float)
+NEON_MIX_FLOAT(neon_remix_areas_float, vsubq_f32, NEON_FIRST_REMIX_FLOAT,
+	       generic_remix_areas_float)
+
+#endif /* DMIX_SIMD_NEON */
+
+/*
+ * override the callbacks chosen by mix_select_callbacks()
+ * when the CPU provides a vector unit
+ */
+static void simd_mix_select_callbacks(snd_pcm_direct_t *dmix)
+{
+	if (!((1ULL << dmix->shmptr->s.format) & simd_dmix_supported_format))
+		return;
+#if defined(DMIX_SIMD_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2")) {
+		dmix->u.dmix.mix_areas_float = sse2_mix_areas_float;
+		dmix->u.dmix.remix_areas_float = sse2_remix_areas_float;
+	}
+	if (dmix->shmptr->s.format == SND_PCM_FORMAT_S24_3LE &&
+	    __builtin_cpu_supports("ssse3")) {
+		dmix->u.dmix.mix_areas_24 = ssse3_mix_areas_24;
+		dmix->u.dmix.remix_areas_24 = ssse3_remix_areas_24;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		dmix->u.dmix.mix_areas_16 = avx2_mix_areas_16;
+		dmix->u.dmix.remix_areas_16 = avx2_remix_areas_16;
+		dmix->u.dmix.mix_areas_32 = avx2_mix_areas_32;
+		dmix->u.dmix.remix_areas_32 = avx2_remix_areas_32;
+	} else if (__builtin_cpu_supports("sse2")) {
+		dmix->u.dmix.mix_areas_16 = sse2_mix_areas_16;
+		dmix->u.dmix.remix_areas_16 = sse2_remix_areas_16;
+		dmix->u.dmix.mix_areas_32 = sse2_mix_areas_32;
+		dmix->u.dmix.remix_areas_32 = sse2_remix_areas_32;
+	}
+#elif defined(DMIX_SIMD_NEON)
+	dmix->u.dmix.mix_areas_16 = neon_mix_areas_16;
+	dmix->u.dmix.remix_areas_16 = neon_remix_areas_16;
+	dmix->u.dmix.mix_areas_32 = neon_mix_areas_32;
+	dmix->u.dmix.remix_areas_32 = neon_remix_areas_32;
+	dmix->u.dmix.mix_areas_float = neon_mix_areas_float;
+	dmix->u.dmix.remix_areas_float = neon_remix_areas_float;
+#endif
+}
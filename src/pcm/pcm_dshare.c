@@ -55,19 +55,49 @@ const char *_snd_module_pcm_dshare = "";
 #define STATE_RUN_PENDING	1024
 #endif
 
+/*
+ * silence what this client wrote to the slave buffer since the last call;
+ * only the dirty run of frames is touched unless it covers the buffer
+ */
 static void do_silence(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dshare = pcm->private_data;
 	const snd_pcm_channel_area_t *dst_areas;
 	unsigned int chn, dchn, channels;
+	snd_pcm_uframes_t buffer_size, dirty, ofs, frames;
 	snd_pcm_format_t format;
 
+	dirty = dshare->u.dshare.dirty;
+	if (!dirty)
+		return;
+	dshare->u.dshare.dirty = 0;
 	dst_areas = snd_pcm_mmap_areas(dshare->spcm);
 	channels = dshare->channels;
 	format = dshare->shmptr->s.format;
-	for (chn = 0; chn < channels; chn++) {
-		dchn = dshare->bindings ? dshare->bindings[chn] : chn;
-		snd_pcm_area_silence(&dst_areas[dchn], 0, dshare->shmptr->s.buffer_size, format);
+	buffer_size = dshare->shmptr->s.buffer_size;
+	{
+		/* let adjacent bound channels be silenced in one pass */
+		snd_pcm_channel_area_t areas[channels];
+		for (chn = 0; chn < channels; chn++) {
+			dchn = dshare->bindings ? dshare->bindings[chn] : chn;
+			areas[chn] = dst_areas[dchn];
+		}
+		if (dirty >= buffer_size) {
+			snd_pcm_areas_silence(areas, 0, channels,
+					      buffer_size, format);
+			return;
+		}
+		ofs = (dshare->u.dshare.dirty_end + buffer_size - dirty) %
+		      buffer_size;
+		while (dirty) {
+			frames = dirty;
+			if (ofs + frames > buffer_size)
+				frames = buffer_size - ofs;
+			snd_pcm_areas_silence(areas, ofs, channels, frames,
+					      format);
+			dirty -= frames;
+			ofs = 0;
+		}
 	}
 }
 
@@ -84,7 +114,7 @@ static void share_areas(snd_pcm_direct_t *dshare,
 	channels = dshare->channels;
 	format = dshare->shmptr->s.format;
 	if (dshare->interleaved) {
-		unsigned int fbytes = snd_pcm_format_physical_width(format) / 8;
+		unsigned int fbytes = __snd_pcm_format_physical_width(format) / 8;
 		memcpy(((char *)dst_areas[0].addr) + (dst_ofs * channels * fbytes),
 		       ((char *)src_areas[0].addr) + (src_ofs * channels * fbytes),
 		       size * channels * fbytes);
@@ -135,8 +165,18 @@ static void snd_pcm_dshare_sync_area(snd_pcm_t *pcm)
 	dshare->last_appl_ptr += size;
 	dshare->last_appl_ptr %= pcm->boundary;
 	slave_appl_ptr = dshare->slave_appl_ptr % dshare->slave_buffer_size;
+	/* a write not continuing the dirty run (after a reset or a skip)
+	 * leaves older data behind, so take the whole buffer as dirty
+	 */
+	if (dshare->u.dshare.dirty &&
+	    dshare->u.dshare.dirty_end != dshare->slave_appl_ptr)
+		dshare->u.dshare.dirty = dshare->slave_buffer_size;
+	dshare->u.dshare.dirty += size;
+	if (dshare->u.dshare.dirty > dshare->slave_buffer_size)
+		dshare->u.dshare.dirty = dshare->slave_buffer_size;
 	dshare->slave_appl_ptr += size;
 	dshare->slave_appl_ptr %= dshare->slave_boundary;
+	dshare->u.dshare.dirty_end = dshare->slave_appl_ptr;
 	for (;;) {
 		snd_pcm_uframes_t transfer = size;
 		if (appl_ptr + transfer > pcm->buffer_size)
@@ -171,7 +211,7 @@ static int snd_pcm_dshare_sync_ptr(snd_pcm_t *pcm)
 		break;
 	}
 	if (dshare->slowptr)
-		snd_pcm_hwsync(dshare->spcm);
+		snd_pcm_direct_hwsync(dshare);
 	old_slave_hw_ptr = dshare->slave_hw_ptr;
 	slave_hw_ptr = dshare->slave_hw_ptr = *dshare->spcm->hw.ptr;
 	diff = slave_hw_ptr - old_slave_hw_ptr;
@@ -187,6 +227,7 @@ static int snd_pcm_dshare_sync_ptr(snd_pcm_t *pcm)
 	}
 	dshare->hw_ptr += diff;
 	dshare->hw_ptr %= pcm->boundary;
+	snd_pcm_trace(pcm, SND_PCM_TRACE_DIRECT_SYNC, diff);
 	// printf("sync ptr diff = %li\n", diff);
 	if (pcm->stop_threshold >= pcm->boundary)	/* don't care */
 		return 0;
@@ -314,7 +355,7 @@ static int snd_pcm_dshare_start_timer(snd_pcm_direct_t *dshare)
 
 	snd_pcm_hwsync(dshare->spcm);
 	dshare->slave_appl_ptr = dshare->slave_hw_ptr = *dshare->spcm->hw.ptr;
-	err = snd_timer_start(dshare->timer);
+	err = snd_pcm_direct_timer_start(dshare);
 	if (err < 0)
 		return err;
 	dshare->state = SND_PCM_STATE_RUNNING;
@@ -474,11 +515,11 @@ static int snd_pcm_dshare_close(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dshare = pcm->private_data;
 
-	if (dshare->timer)
-		snd_timer_close(dshare->timer);
+	snd_pcm_direct_timer_close(dshare);
 	do_silence(pcm);
 	snd_pcm_direct_semaphore_down(dshare, DIRECT_IPC_SEM_CLIENT);
 	dshare->shmptr->u.dshare.chn_mask &= ~dshare->u.dshare.chn_mask;
+	snd_pcm_direct_linger(dshare, NULL);
 	snd_pcm_close(dshare->spcm);
  	if (dshare->server)
  		snd_pcm_direct_server_discard(dshare);
@@ -593,6 +634,22 @@ static const snd_pcm_ops_t snd_pcm_dshare_ops = {
 	.set_chmap = snd_pcm_direct_set_chmap,
 };
 
+static int snd_pcm_dshare_avail_status(snd_pcm_t *pcm, snd_pcm_status_t *status)
+{
+	snd_pcm_direct_t *dshare = pcm->private_data;
+	int err;
+
+	if (dshare->state == SND_PCM_STATE_RUNNING ||
+	    dshare->state == SND_PCM_STATE_DRAINING) {
+		err = snd_pcm_dshare_sync_ptr(pcm);
+		/* an xrun shows up in the state */
+		if (err < 0 && err != -EPIPE)
+			return err;
+	}
+	snd_pcm_direct_fill_avail_status(pcm, status);
+	return 0;
+}
+
 static const snd_pcm_fast_ops_t snd_pcm_dshare_fast_ops = {
 	.status = snd_pcm_dshare_status,
 	.state = snd_pcm_dshare_state,
@@ -619,6 +676,7 @@ static const snd_pcm_fast_ops_t snd_pcm_dshare_fast_ops = {
 	.avail_update = snd_pcm_dshare_avail_update,
 	.mmap_commit = snd_pcm_dshare_mmap_commit,
 	.htimestamp = snd_pcm_dshare_htimestamp,
+	.avail_status = snd_pcm_dshare_avail_status,
 	.poll_descriptors = NULL,
 	.poll_descriptors_count = NULL,
 	.poll_revents = snd_pcm_direct_poll_revents,
@@ -677,8 +735,17 @@ int snd_pcm_dshare_open(snd_pcm_t **pcmp, const char *name,
 	dshare->ipc_key = opts->ipc_key;
 	dshare->ipc_perm = opts->ipc_perm;
 	dshare->ipc_gid = opts->ipc_gid;
+	dshare->hugepages = opts->hugepages;
+	dshare->numa_bind = opts->numa_bind;
+	dshare->numa_node = -1;
 	dshare->semid = -1;
 	dshare->shmid = -1;
+	dshare->slice_fd = -1;
+	dshare->epoll_fd = -1;
+	dshare->timer_slices = opts->timer_slices;
+	dshare->linger = opts->linger;
+	dshare->hwsync_window = opts->hwsync_window;
+	dshare->fast_recover = opts->fast_recover;
 
 	ret = snd_pcm_new(&pcm, dshare->type = SND_PCM_TYPE_DSHARE, name, stream, mode);
 	if (ret < 0)
@@ -827,8 +894,7 @@ int snd_pcm_dshare_open(snd_pcm_t **pcmp, const char *name,
  _err:
 	if (dshare->shmptr)
 		dshare->shmptr->u.dshare.chn_mask &= ~dshare->u.dshare.chn_mask;
-	if (dshare->timer)
-		snd_timer_close(dshare->timer);
+	snd_pcm_direct_timer_close(dshare);
 	if (dshare->server)
 		snd_pcm_direct_server_discard(dshare);
 	if (dshare->client)
@@ -887,9 +953,42 @@ pcm.name {
 		N INT		# maps slave channel to client channel N
 	}
 	slowptr BOOL		# slow but more precise pointer updates
+	hwsync_window INT	# us to share a slave pointer update (default 500)
+	numa_bind BOOL		# keep the shared memory on the card's NUMA node
+	timer_slices INT	# wakeups per slave period (default 1)
+	linger INT		# ms to keep the slave after the last close (default 0)
+	fast_recover INT	# frames of silence to restart with after an xrun (default 0 = off)
 }
 \endcode
 
+<code>timer_slices</code> wakes the clients this many times per slave
+period (default 1) from a timerfd next to the slave timer, so that a
+client with an <code>avail_min</code> below the slave period size is
+served without changing the hardware period.
+
+<code>linger</code> keeps the slave open and running for the given time
+(in milliseconds) after the last client has closed.  A client opened
+meanwhile attaches to it like to a running instance and skips the setup
+of the hardware.  A detached helper process holds the slave and the
+shared memory for that time.  It is not used with the old kernels which
+need the server mode.
+
+<code>hwsync_window</code> lets a client reuse the slave pointer update
+done by another client within the given time (in microseconds, default
+500, 0 = off) with <code>slowptr</code>, instead of asking the kernel
+itself, so that the clients woken up by the same period do a single
+update.  It has no effect when the slave status cannot be mmapped.
+
+<code>fast_recover</code> restarts a client within #snd_pcm_prepare,
+e.g. from #snd_pcm_recover, after its own xrun while the slave plays on:
+the given number of frames of silence (at most a period) is queued at
+the current slave position, mid-period, and the stream is running
+again, so the next write is heard after that silence instead of after
+refilling up to the start threshold and waiting for a period boundary.
+It is not applied when the slave itself has to be restarted.  As the
+stream runs after the prepare, an application which starts it
+explicitly gets -EBADFD from #snd_pcm_start.
+
 \subsection pcm_plugins_dshare_funcref Function reference
 
 <UL>
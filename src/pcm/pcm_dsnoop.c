@@ -67,6 +67,15 @@ static int snoop_timestamp(snd_pcm_t *pcm)
 		ptr1 = ptr2;
 		dsnoop->update_tstamp = snd_pcm_hw_fast_tstamp(dsnoop->spcm);
 	}
+	if (dsnoop->u.dsnoop.monitor) {
+		/* the dmix clients keep off the period being played, so it
+		 * holds the final mix; the played frames are silenced already
+		 */
+		ptr1 += dsnoop->slave_period_size -
+			ptr1 % dsnoop->slave_period_size;
+		if (ptr1 >= dsnoop->slave_boundary)
+			ptr1 -= dsnoop->slave_boundary;
+	}
 	dsnoop->slave_hw_ptr = ptr1;
 	return 0;
 }
@@ -84,7 +93,7 @@ static void snoop_areas(snd_pcm_direct_t *dsnoop,
 	channels = dsnoop->channels;
 	format = dsnoop->shmptr->s.format;
 	if (dsnoop->interleaved) {
-		unsigned int fbytes = snd_pcm_format_physical_width(format) / 8;
+		unsigned int fbytes = __snd_pcm_format_physical_width(format) / 8;
 		memcpy(((char *)dst_areas[0].addr) + (dst_ofs * channels * fbytes),
 		       ((char *)src_areas[0].addr) + (src_ofs * channels * fbytes),
 		       size * channels * fbytes);
@@ -106,6 +115,8 @@ static void snd_pcm_dsnoop_sync_area(snd_pcm_t *pcm, snd_pcm_uframes_t slave_hw_
 	snd_pcm_uframes_t transfer;
 	const snd_pcm_channel_area_t *src_areas, *dst_areas;
 	
+	if (pcm->mmap_shadow)	/* zero-copy, the areas are the slave ones */
+		return;
 	/* add sample areas here */
 	dst_areas = snd_pcm_mmap_areas(pcm);
 	src_areas = snd_pcm_mmap_areas(dsnoop->spcm);
@@ -141,7 +152,7 @@ static int snd_pcm_dsnoop_sync_ptr(snd_pcm_t *pcm)
 		break;
 	}
 	if (dsnoop->slowptr)
-		snd_pcm_hwsync(dsnoop->spcm);
+		snd_pcm_direct_hwsync(dsnoop);
 	old_slave_hw_ptr = dsnoop->slave_hw_ptr;
 	snoop_timestamp(pcm);
 	slave_hw_ptr = dsnoop->slave_hw_ptr;
@@ -155,6 +166,7 @@ static int snd_pcm_dsnoop_sync_ptr(snd_pcm_t *pcm)
 	snd_pcm_dsnoop_sync_area(pcm, old_slave_hw_ptr, diff);
 	dsnoop->hw_ptr += diff;
 	dsnoop->hw_ptr %= pcm->boundary;
+	snd_pcm_trace(pcm, SND_PCM_TRACE_DIRECT_SYNC, diff);
 	// printf("sync ptr diff = %li\n", diff);
 	if (pcm->stop_threshold >= pcm->boundary)	/* don't care */
 		return 0;
@@ -263,7 +275,9 @@ static int snd_pcm_dsnoop_hwsync(snd_pcm_t *pcm)
 static int snd_pcm_dsnoop_reset(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dsnoop = pcm->private_data;
-	dsnoop->hw_ptr %= pcm->period_size;
+	/* in zero-copy mode hw_ptr stays in phase with the slave buffer */
+	if (!pcm->mmap_shadow)
+		dsnoop->hw_ptr %= pcm->period_size;
 	dsnoop->appl_ptr = dsnoop->hw_ptr;
 	dsnoop->slave_appl_ptr = dsnoop->slave_hw_ptr;
 	return 0;
@@ -279,7 +293,10 @@ static int snd_pcm_dsnoop_start(snd_pcm_t *pcm)
 	snd_pcm_hwsync(dsnoop->spcm);
 	snoop_timestamp(pcm);
 	dsnoop->slave_appl_ptr = dsnoop->slave_hw_ptr;
-	err = snd_timer_start(dsnoop->timer);
+	if (pcm->mmap_shadow)
+		dsnoop->appl_ptr = dsnoop->hw_ptr =
+			dsnoop->slave_hw_ptr % pcm->buffer_size;
+	err = snd_pcm_direct_timer_start(dsnoop);
 	if (err < 0)
 		return err;
 	dsnoop->state = SND_PCM_STATE_RUNNING;
@@ -293,7 +310,7 @@ static int snd_pcm_dsnoop_drop(snd_pcm_t *pcm)
 	if (dsnoop->state == SND_PCM_STATE_OPEN)
 		return -EBADFD;
 	dsnoop->state = SND_PCM_STATE_SETUP;
-	snd_timer_stop(dsnoop->timer);
+	snd_pcm_direct_timer_stop(dsnoop);
 	return 0;
 }
 
@@ -382,9 +399,9 @@ static int snd_pcm_dsnoop_close(snd_pcm_t *pcm)
 {
 	snd_pcm_direct_t *dsnoop = pcm->private_data;
 
-	if (dsnoop->timer)
-		snd_timer_close(dsnoop->timer);
+	snd_pcm_direct_timer_close(dsnoop);
 	snd_pcm_direct_semaphore_down(dsnoop, DIRECT_IPC_SEM_CLIENT);
+	snd_pcm_direct_linger(dsnoop, NULL);
 	snd_pcm_close(dsnoop->spcm);
  	if (dsnoop->server)
  		snd_pcm_direct_server_discard(dsnoop);
@@ -476,24 +493,140 @@ static void snd_pcm_dsnoop_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_pcm_dump(dsnoop->spcm, out);
 }
 
+/*
+ * zero-copy mode: the client areas point into the slave buffer, so that
+ * no data is copied at all; the buffer sizes must match and the slave
+ * layout must be what the requested access type promises
+ */
+static int dsnoop_zerocopy_ok(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
+{
+	snd_pcm_direct_t *dsnoop = pcm->private_data;
+	snd_pcm_t *spcm = dsnoop->spcm;
+	unsigned int chn, schn, channels;
+	snd_pcm_uframes_t buffer_size;
+	snd_pcm_access_t access;
+
+	if (!dsnoop->u.dsnoop.zerocopy || dsnoop->u.dsnoop.monitor)
+		return 0;
+	if (INTERNAL(snd_pcm_hw_params_get_buffer_size)(params, &buffer_size) < 0 ||
+	    INTERNAL(snd_pcm_hw_params_get_channels)(params, &channels) < 0 ||
+	    INTERNAL(snd_pcm_hw_params_get_access)(params, &access) < 0)
+		return 0;
+	if (buffer_size != dsnoop->slave_buffer_size)
+		return 0;
+	for (chn = 0; chn < channels; chn++) {
+		schn = dsnoop->bindings ? dsnoop->bindings[chn] : chn;
+		if (schn >= spcm->channels)
+			return 0;
+	}
+	switch (access) {
+	case SND_PCM_ACCESS_MMAP_INTERLEAVED:
+		if (spcm->access != SND_PCM_ACCESS_MMAP_INTERLEAVED ||
+		    channels != spcm->channels)
+			return 0;
+		for (chn = 0; chn < channels; chn++)
+			if (dsnoop->bindings && dsnoop->bindings[chn] != chn)
+				return 0;
+		return 1;
+	case SND_PCM_ACCESS_MMAP_NONINTERLEAVED:
+		return spcm->access == SND_PCM_ACCESS_MMAP_NONINTERLEAVED;
+	default:
+		/* read via snd_pcm_mmap_readi/n(), any layout is fine */
+		return 1;
+	}
+}
+
+static int snd_pcm_dsnoop_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
+{
+	pcm->mmap_shadow = dsnoop_zerocopy_ok(pcm, params);
+	return snd_pcm_direct_hw_params(pcm, params);
+}
+
+static int snd_pcm_dsnoop_channel_info(snd_pcm_t *pcm, snd_pcm_channel_info_t *info)
+{
+	snd_pcm_direct_t *dsnoop = pcm->private_data;
+	unsigned int chn = info->channel;
+	int err;
+
+	if (!pcm->mmap_shadow)
+		return snd_pcm_direct_channel_info(pcm, info);
+	info->channel = dsnoop->bindings ? dsnoop->bindings[chn] : chn;
+	err = snd_pcm_channel_info(dsnoop->spcm, info);
+	info->channel = chn;
+	return err;
+}
+
+static int snd_pcm_dsnoop_mmap(snd_pcm_t *pcm)
+{
+	snd_pcm_direct_t *dsnoop = pcm->private_data;
+	snd_pcm_t *spcm = dsnoop->spcm;
+	unsigned int chn, schn;
+
+	if (!pcm->mmap_shadow)
+		return 0;
+	pcm->mmap_channels = calloc(pcm->channels, sizeof(pcm->mmap_channels[0]));
+	pcm->running_areas = calloc(pcm->channels, sizeof(pcm->running_areas[0]));
+	if (!pcm->mmap_channels || !pcm->running_areas) {
+		free(pcm->mmap_channels);
+		free(pcm->running_areas);
+		pcm->mmap_channels = NULL;
+		pcm->running_areas = NULL;
+		return -ENOMEM;
+	}
+	for (chn = 0; chn < pcm->channels; chn++) {
+		schn = dsnoop->bindings ? dsnoop->bindings[chn] : chn;
+		pcm->mmap_channels[chn] = spcm->mmap_channels[schn];
+		pcm->mmap_channels[chn].channel = chn;
+		pcm->running_areas[chn] = spcm->running_areas[schn];
+	}
+	return 0;
+}
+
+static int snd_pcm_dsnoop_munmap(snd_pcm_t *pcm)
+{
+	if (!pcm->mmap_shadow)
+		return 0;
+	free(pcm->mmap_channels);
+	free(pcm->running_areas);
+	pcm->mmap_channels = NULL;
+	pcm->running_areas = NULL;
+	return 0;
+}
+
 static const snd_pcm_ops_t snd_pcm_dsnoop_ops = {
 	.close = snd_pcm_dsnoop_close,
 	.info = snd_pcm_direct_info,
 	.hw_refine = snd_pcm_direct_hw_refine,
-	.hw_params = snd_pcm_direct_hw_params,
+	.hw_params = snd_pcm_dsnoop_hw_params,
 	.hw_free = snd_pcm_direct_hw_free,
 	.sw_params = snd_pcm_direct_sw_params,
-	.channel_info = snd_pcm_direct_channel_info,
+	.channel_info = snd_pcm_dsnoop_channel_info,
 	.dump = snd_pcm_dsnoop_dump,
 	.nonblock = snd_pcm_direct_nonblock,
 	.async = snd_pcm_direct_async,
-	.mmap = snd_pcm_direct_mmap,
-	.munmap = snd_pcm_direct_munmap,
+	.mmap = snd_pcm_dsnoop_mmap,
+	.munmap = snd_pcm_dsnoop_munmap,
 	.query_chmaps = snd_pcm_direct_query_chmaps,
 	.get_chmap = snd_pcm_direct_get_chmap,
 	.set_chmap = snd_pcm_direct_set_chmap,
 };
 
+static int snd_pcm_dsnoop_avail_status(snd_pcm_t *pcm, snd_pcm_status_t *status)
+{
+	snd_pcm_direct_t *dsnoop = pcm->private_data;
+	int err;
+
+	if (dsnoop->state == SND_PCM_STATE_RUNNING ||
+	    dsnoop->state == SND_PCM_STATE_DRAINING) {
+		err = snd_pcm_dsnoop_sync_ptr(pcm);
+		/* an xrun shows up in the state */
+		if (err < 0 && err != -EPIPE)
+			return err;
+	}
+	snd_pcm_direct_fill_avail_status(pcm, status);
+	return 0;
+}
+
 static const snd_pcm_fast_ops_t snd_pcm_dsnoop_fast_ops = {
 	.status = snd_pcm_dsnoop_status,
 	.state = snd_pcm_dsnoop_state,
@@ -520,6 +653,7 @@ static const snd_pcm_fast_ops_t snd_pcm_dsnoop_fast_ops = {
 	.avail_update = snd_pcm_dsnoop_avail_update,
 	.mmap_commit = snd_pcm_dsnoop_mmap_commit,
 	.htimestamp = snd_pcm_dsnoop_htimestamp,
+	.avail_status = snd_pcm_dsnoop_avail_status,
 	.poll_descriptors = NULL,
 	.poll_descriptors_count = NULL,
 	.poll_revents = snd_pcm_direct_poll_revents,
@@ -548,6 +682,7 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 {
 	snd_pcm_t *pcm = NULL, *spcm = NULL;
 	snd_pcm_direct_t *dsnoop = NULL;
+	snd_pcm_stream_t sstream;
 	int ret, first_instance, fail_sem_loop = 10;
 
 	assert(pcmp);
@@ -556,6 +691,8 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 		SNDERR("The dsnoop plugin supports only capture stream");
 		return -EINVAL;
 	}
+	/* a monitor reads the slave of a dmix, it's a playback stream */
+	sstream = opts->monitor ? SND_PCM_STREAM_PLAYBACK : stream;
 
 	dsnoop = calloc(1, sizeof(snd_pcm_direct_t));
 	if (!dsnoop) {
@@ -570,8 +707,18 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 	dsnoop->ipc_key = opts->ipc_key;
 	dsnoop->ipc_perm = opts->ipc_perm;
 	dsnoop->ipc_gid = opts->ipc_gid;
+	dsnoop->hugepages = opts->hugepages;
+	dsnoop->numa_bind = opts->numa_bind;
+	dsnoop->numa_node = -1;
+	dsnoop->u.dsnoop.zerocopy = opts->zerocopy;
+	dsnoop->u.dsnoop.monitor = opts->monitor;
 	dsnoop->semid = -1;
 	dsnoop->shmid = -1;
+	dsnoop->slice_fd = -1;
+	dsnoop->epoll_fd = -1;
+	dsnoop->timer_slices = opts->timer_slices;
+	dsnoop->linger = opts->linger;
+	dsnoop->hwsync_window = opts->hwsync_window;
 
 	ret = snd_pcm_new(&pcm, dsnoop->type = SND_PCM_TYPE_DSNOOP, name, stream, mode);
 	if (ret < 0)
@@ -599,6 +746,12 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 		SNDERR("unable to create IPC shm instance");
 		goto _err;
 	}
+	if (first_instance && opts->monitor) {
+		SNDERR("no dmix instance to monitor for ipc_key %d",
+		       dsnoop->ipc_key);
+		ret = -ENODEV;
+		goto _err;
+	}
 		
 	pcm->ops = &snd_pcm_dsnoop_ops;
 	pcm->fast_ops = &snd_pcm_dsnoop_fast_ops;
@@ -658,7 +811,7 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 				goto _err;
 		} else {
 
-			ret = snd_pcm_open_slave(&spcm, root, sconf, stream,
+			ret = snd_pcm_open_slave(&spcm, root, sconf, sstream,
 						 mode | SND_PCM_NONBLOCK |
 						 SND_PCM_APPEND,
 						 NULL);
@@ -666,6 +819,11 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 				/* all other streams have been closed;
 				 * retry as the first instance
 				 */
+				if (ret == -EBADFD && opts->monitor) {
+					SNDERR("the monitored dmix has been closed");
+					ret = -ENODEV;
+					goto _err;
+				}
 				if (ret == -EBADFD) {
 					first_instance = 1;
 					goto retry;
@@ -711,8 +869,7 @@ int snd_pcm_dsnoop_open(snd_pcm_t **pcmp, const char *name,
 	return 0;
 	
  _err:
- 	if (dsnoop->timer)
-		snd_timer_close(dsnoop->timer);
+ 	snd_pcm_direct_timer_close(dsnoop);
 	if (dsnoop->server)
 		snd_pcm_direct_server_discard(dsnoop);
 	if (dsnoop->client)
@@ -770,9 +927,51 @@ pcm.name {
 		N INT		# maps slave channel to client channel N
 	}
 	slowptr BOOL		# slow but more precise pointer updates
+	hwsync_window INT	# us to share a slave pointer update (default 500)
+	numa_bind BOOL		# keep the shared memory on the card's NUMA node
+	zerocopy BOOL		# read straight from the slave buffer
+	monitor BOOL		# capture the mix of a running dmix
+	timer_slices INT	# wakeups per slave period (default 1)
+	linger INT		# ms to keep the slave after the last close (default 0)
 }
 \endcode
 
+<code>timer_slices</code> wakes the clients this many times per slave
+period (default 1) from a timerfd next to the slave timer, so that a
+client with an <code>avail_min</code> below the slave period size is
+served without changing the hardware period.
+
+<code>linger</code> keeps the slave open and running for the given time
+(in milliseconds) after the last client has closed.  A client opened
+meanwhile attaches to it like to a running instance and skips the setup
+of the hardware.  A detached helper process holds the slave and the
+shared memory for that time.  It is not used with the old kernels which
+need the server mode.
+
+<code>hwsync_window</code> lets a client reuse the slave pointer update
+done by another client within the given time (in microseconds, default
+500, 0 = off) with <code>slowptr</code>, instead of asking the kernel
+itself, so that the clients woken up by the same period do a single
+update.  It has no effect when the slave status cannot be mmapped.
+
+With <code>zerocopy</code> set, a client whose buffer size equals the
+slave buffer size gets the mmap areas of the slave buffer itself, with
+only its own pointers, so that no data is copied for it.  For the
+\c MMAP_INTERLEAVED access the slave must be interleaved with the same
+channels in the same order, for \c MMAP_NONINTERLEAVED it must be
+non-interleaved; the read/write accesses work with any layout.  In
+other cases the data is copied as before.  The client must not write to
+the areas.
+
+With <code>monitor</code> set, the plugin does not open a capture
+stream but attaches to a running \ref pcm_plugins_dmix "dmix" instance
+with the same <code>ipc_key</code> and slave, and captures what it
+plays: each client reads the mixed slave buffer with its own pointer,
+up to the end of the period being played, where the mix is complete.
+Opening fails when no such dmix is running.  The data a dmix client
+writes into the period being played, after an underrun, is not seen.
+<code>zerocopy</code> is ignored in this mode.
+
 \subsection pcm_plugins_dsnoop_funcref Function reference
 
 <UL>
@@ -71,6 +71,7 @@ int snd_ext_parm_set_minmax(struct snd_ext_parm *parm, unsigned int min, unsigne
 	parm->min = min;
 	parm->max = max;
 	parm->active = 1;
+	snd_pcm_hw_refine_invalidate();
 	return 0;
 }
 
@@ -96,6 +97,7 @@ int snd_ext_parm_set_list(struct snd_ext_parm *parm, unsigned int num_list, cons
 	parm->num_list = num_list;
 	parm->list = new_list;
 	parm->active = 1;
+	snd_pcm_hw_refine_invalidate();
 	return 0;
 }
 
@@ -103,6 +105,7 @@ void snd_ext_parm_clear(struct snd_ext_parm *parm)
 {
 	free(parm->list);
 	memset(parm, 0, sizeof(*parm));
+	snd_pcm_hw_refine_invalidate();
 }
 
 /*
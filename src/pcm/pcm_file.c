@@ -26,12 +26,23 @@
  *
  */
   
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE	/* O_DIRECT */
+#endif
 #include "bswap.h"
 #include <ctype.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
 
+#if defined(THREAD_SAFE_API) && defined(__ATOMIC_ACQUIRE)
+#include <signal.h>
+#include <semaphore.h>
+#define FILE_HAVE_WRITER
+#endif
+
 #ifndef PIC
 /* entry for static linking */
 const char *_snd_module_pcm_file = "";
@@ -49,9 +60,17 @@ const char *_snd_module_pcm_file = "";
 /* maximum length of a value */
 #define VALUE_MAXLEN	64
 
+/* smallest ring of the writer thread */
+#define ASYNC_RING_MIN	4096
+/* ring of the writer thread for direct_io unless given */
+#define ASYNC_RING_DIRECT	(1024 * 1024)
+/* alignment of O_DIRECT buffers, offsets and sizes */
+#define DIRECT_BLOCK	4096
+
 typedef enum _snd_pcm_file_format {
 	SND_PCM_FILE_FORMAT_RAW,
-	SND_PCM_FILE_FORMAT_WAV
+	SND_PCM_FILE_FORMAT_WAV,
+	SND_PCM_FILE_FORMAT_FLAC
 } snd_pcm_file_format_t;
 
 /* WAV format chunk */
@@ -73,6 +92,11 @@ typedef struct {
 	int fd;
 	char *ifname;
 	int ifd;
+	int infile_mmap;		/* map ifd instead of reading it */
+	char *imap;			/* mapped infile, NULL = use read() */
+	size_t imap_len;		/* length of the mapping */
+	size_t imap_size;		/* end of the data in the mapping */
+	size_t imap_pos;		/* next byte to be captured */
 	int format;
 	snd_pcm_uframes_t appl_ptr;
 	snd_pcm_uframes_t file_ptr_bytes;
@@ -87,8 +111,848 @@ typedef struct {
 	size_t buffer_bytes;
 	struct wav_fmt wav_header;
 	size_t filelen;
+	size_t async_ring;		/* writer thread ring in bytes, 0 = none */
+	int direct_io;			/* writer thread bypasses the page cache */
+	struct snd_pcm_file_writer *writer;
+	struct snd_pcm_file_flac *flac;	/* FLAC encoder, set up with the data */
 } snd_pcm_file_t;
 
+/*
+ * FLAC output
+ *
+ * The stream is encoded to FLAC frames of FLAC_BLOCK frames without an
+ * external library: each channel of a frame is coded as a constant, as
+ * one of the fixed polynomial predictors of order 0 to 4 with the
+ * residual in Rice partitions, or verbatim, whichever is the shortest,
+ * after the zero low bits common to the block are dropped.  That gets
+ * most of what the reference encoder gets at its fast settings and
+ * costs a few operations per sample.  The STREAMINFO block is written
+ * with the first data and completed at close when the file is seekable.
+ *
+ * A FLAC stream carries at most 8 channels, so a wider stream goes to
+ * one file per group of 8 channels, the group starting at channel N in
+ * "FILE.chN".  Signed 8, 16, 24 and 32 bit samples in little endian are
+ * supported.  With the writer thread the encoding is done there, off the
+ * audio path.
+ */
+
+#define FLAC_BLOCK		4096	/* frames per FLAC frame */
+#define FLAC_MAX_CHANNELS	8	/* per FLAC stream */
+#define FLAC_MAX_ORDER		4	/* of the fixed predictors */
+#define FLAC_MAX_PORDER		8	/* Rice partition order */
+#define FLAC_STREAMINFO_OFS	8	/* after "fLaC" and the block header */
+
+struct flac_stream {
+	int fd;
+	unsigned int first;		/* first channel of the group */
+	unsigned int channels;
+	unsigned int min_frame;		/* bytes, 0 = none yet */
+	unsigned int max_frame;
+};
+
+struct snd_pcm_file_flac {
+	snd_pcm_format_t format;
+	unsigned int channels;
+	unsigned int rate;
+	unsigned int bits;
+	unsigned int sample_bytes;
+	unsigned int frame_bytes;
+	unsigned int fill;		/* frames in block */
+	unsigned int partial;		/* bytes of an incomplete frame */
+	unsigned char *part;
+	int32_t *block;			/* channels x FLAC_BLOCK samples */
+	int32_t *residual;
+	unsigned char *out;		/* encoded frame */
+	unsigned long long frames;	/* encoded */
+	unsigned int frame_no;
+	unsigned int nstreams;
+	struct flac_stream *streams;
+	unsigned char crc8[256];
+	unsigned short crc16[256];
+};
+
+struct flac_bits {
+	unsigned char *p;
+	u_int64_t acc;
+	unsigned int n;			/* bits in acc */
+};
+
+static inline void flac_put(struct flac_bits *b, u_int32_t v, unsigned int bits)
+{
+	if (!bits)
+		return;
+	b->acc = (b->acc << bits) | (v & (0xffffffffU >> (32 - bits)));
+	b->n += bits;
+	while (b->n >= 8) {
+		b->n -= 8;
+		*b->p++ = b->acc >> b->n;
+	}
+}
+
+/* q zero bits and a one */
+static inline void flac_put_unary(struct flac_bits *b, u_int32_t q)
+{
+	while (q >= 31) {
+		flac_put(b, 0, 31);
+		q -= 31;
+	}
+	flac_put(b, 1, q + 1);
+}
+
+static inline void flac_align(struct flac_bits *b)
+{
+	if (b->n)
+		flac_put(b, 0, 8 - b->n);
+}
+
+static void flac_init_crc(struct snd_pcm_file_flac *flac)
+{
+	unsigned int i, j, c;
+
+	for (i = 0; i < 256; i++) {
+		c = i;
+		for (j = 0; j < 8; j++)
+			c = (c & 0x80) ? (c << 1) ^ 0x07 : c << 1;
+		flac->crc8[i] = c;
+		c = i << 8;
+		for (j = 0; j < 8; j++)
+			c = (c & 0x8000) ? (c << 1) ^ 0x8005 : c << 1;
+		flac->crc16[i] = c;
+	}
+}
+
+static int flac_write_all(int fd, const unsigned char *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static void flac_streaminfo(struct snd_pcm_file_flac *flac,
+			    struct flac_stream *s, unsigned char *buf)
+{
+	struct flac_bits b = { buf, 0, 0 };
+	unsigned long long total = flac->frames;
+
+	/* more than 36 bits is unknown */
+	if (total >> 36)
+		total = 0;
+	flac_put(&b, FLAC_BLOCK, 16);
+	flac_put(&b, FLAC_BLOCK, 16);
+	flac_put(&b, s->min_frame, 24);
+	flac_put(&b, s->max_frame, 24);
+	flac_put(&b, flac->rate, 20);
+	flac_put(&b, s->channels - 1, 3);
+	flac_put(&b, flac->bits - 1, 5);
+	flac_put(&b, total >> 32, 4);
+	flac_put(&b, total, 32);
+	memset(b.p, 0, 16);		/* no MD5 signature */
+}
+
+static int flac_write_header(struct snd_pcm_file_flac *flac,
+			     struct flac_stream *s)
+{
+	unsigned char buf[FLAC_STREAMINFO_OFS + 34] = {
+		'f', 'L', 'a', 'C',
+		0x80, 0, 0, 34,		/* last metadata block, STREAMINFO */
+	};
+
+	flac_streaminfo(flac, s, buf + FLAC_STREAMINFO_OFS);
+	return flac_write_all(s->fd, buf, sizeof(buf));
+}
+
+/* sample rate code of the frame header, 0 = from STREAMINFO */
+static unsigned int flac_rate_code(unsigned int rate)
+{
+	static const unsigned int rates[] = {
+		0, 88200, 176400, 192000, 8000, 16000, 22050, 24000,
+		32000, 44100, 48000, 96000
+	};
+	unsigned int i;
+
+	for (i = 1; i < ARRAY_SIZE(rates); i++)
+		if (rates[i] == rate)
+			return i;
+	return 0;
+}
+
+static unsigned int flac_bits_code(unsigned int bits)
+{
+	switch (bits) {
+	case 8:
+		return 1;
+	case 16:
+		return 4;
+	case 24:
+		return 6;
+	default:
+		return 0;
+	}
+}
+
+/* largest k with n << k not above sum */
+static unsigned int flac_rice_param(u_int64_t sum, unsigned int n)
+{
+	unsigned int k = 0;
+
+	while (k < 30 && ((u_int64_t)n << (k + 1)) <= sum)
+		k++;
+	return k;
+}
+
+static void flac_residual(const int32_t *x, int32_t *r, unsigned int n,
+			  unsigned int order)
+{
+	unsigned int i;
+
+	/* in 64 bits, only the result is known to fit */
+	switch (order) {
+	case 0:
+		for (i = 0; i < n; i++)
+			r[i] = x[i];
+		break;
+	case 1:
+		for (i = 1; i < n; i++)
+			r[i] = (int64_t)x[i] - x[i - 1];
+		break;
+	case 2:
+		for (i = 2; i < n; i++)
+			r[i] = (int64_t)x[i] - 2 * (int64_t)x[i - 1] + x[i - 2];
+		break;
+	case 3:
+		for (i = 3; i < n; i++)
+			r[i] = (int64_t)x[i] - 3 * ((int64_t)x[i - 1] - x[i - 2]) -
+				x[i - 3];
+		break;
+	case 4:
+		for (i = 4; i < n; i++)
+			r[i] = (int64_t)x[i] - 4 * ((int64_t)x[i - 1] + x[i - 3]) +
+				6 * (int64_t)x[i - 2] + x[i - 4];
+		break;
+	}
+}
+
+/*
+ * pick the fixed predictor by the sum of the absolute residuals; with
+ * more than 27 bits only the orders whose residual fits in 32 bits
+ */
+static int flac_best_order(const int32_t *x, unsigned int n,
+			   unsigned int bits)
+{
+	u_int64_t sum[FLAC_MAX_ORDER + 1] = { 0 };
+	int64_t e0, e1, e2, e3, e4, limit = 0x7fffffffLL;
+	int64_t big[FLAC_MAX_ORDER + 1] = { 0 };
+	unsigned int i, o, best = 0;
+
+	for (i = FLAC_MAX_ORDER; i < n; i++) {
+		e0 = x[i];
+		e1 = e0 - x[i - 1];
+		e2 = e1 - ((int64_t)x[i - 1] - x[i - 2]);
+		e3 = e2 - ((int64_t)x[i - 1] - 2 * (int64_t)x[i - 2] + x[i - 3]);
+		e4 = e3 - ((int64_t)x[i - 1] - 3 * ((int64_t)x[i - 2] - x[i - 3]) - x[i - 4]);
+		sum[0] += e0 < 0 ? -e0 : e0;
+		sum[1] += e1 < 0 ? -e1 : e1;
+		sum[2] += e2 < 0 ? -e2 : e2;
+		sum[3] += e3 < 0 ? -e3 : e3;
+		sum[4] += e4 < 0 ? -e4 : e4;
+		if (bits > 27) {
+			big[1] |= e1 > limit || e1 < -limit;
+			big[2] |= e2 > limit || e2 < -limit;
+			big[3] |= e3 > limit || e3 < -limit;
+			big[4] |= e4 > limit || e4 < -limit;
+		}
+	}
+	for (o = 1; o <= FLAC_MAX_ORDER; o++)
+		if (!big[o] && sum[o] < sum[best])
+			best = o;
+	return best;
+}
+
+/* code the residual, returns the bits or 0 when verbatim is better */
+static u_int64_t flac_rice_plan(const int32_t *r, unsigned int n,
+				unsigned int order, unsigned int *porder,
+				unsigned int *params)
+{
+	u_int64_t sums[1 << FLAC_MAX_PORDER];
+	u_int64_t best = ~(u_int64_t)0, bits;
+	unsigned int pmax = 0, p, j, i, cnt, parts;
+
+	while (pmax < FLAC_MAX_PORDER && !(n % (2U << pmax)) &&
+	       (n >> (pmax + 1)) > order)
+		pmax++;
+	parts = 1U << pmax;
+	cnt = n >> pmax;
+	for (j = 0, i = order; j < parts; j++) {
+		u_int64_t s = 0;
+		for (; i < (j + 1) * cnt; i++)
+			s += ((u_int32_t)r[i] << 1) ^ (u_int32_t)(r[i] >> 31);
+		sums[j] = s;
+	}
+	for (p = pmax + 1; p-- > 0; ) {
+		unsigned int k[1 << FLAC_MAX_PORDER];
+		parts = 1U << p;
+		cnt = n >> p;
+		bits = 0;
+		for (j = 0; j < parts; j++) {
+			unsigned int m = cnt - (j ? 0 : order);
+			k[j] = flac_rice_param(sums[j], m);
+			bits += 5 + (u_int64_t)m * (k[j] + 1) + (sums[j] >> k[j]);
+		}
+		if (bits < best) {
+			best = bits;
+			*porder = p;
+			memcpy(params, k, parts * sizeof(*k));
+		}
+		/* merge the partitions for the next lower order */
+		for (j = 0; j < parts / 2; j++)
+			sums[j] = sums[2 * j] + sums[2 * j + 1];
+	}
+	return best + 6;
+}
+
+static void flac_subframe(struct snd_pcm_file_flac *flac, struct flac_bits *b,
+			  int32_t *x, unsigned int n)
+{
+	unsigned int params[1 << FLAC_MAX_PORDER];
+	unsigned int i, j, bps = flac->bits, wasted = 0, order, porder = 0;
+	unsigned int method, cnt;
+	u_int32_t any = 0;
+	int32_t *r = flac->residual;
+	u_int64_t bits;
+
+	for (i = 1; i < n; i++)
+		if (x[i] != x[0])
+			break;
+	if (i == n) {
+		flac_put(b, 0x00, 8);	/* CONSTANT */
+		flac_put(b, x[0], bps);
+		return;
+	}
+	for (i = 0; i < n; i++)
+		any |= x[i];
+	while (!(any & 1)) {
+		any >>= 1;
+		wasted++;
+	}
+	if (wasted) {
+		for (i = 0; i < n; i++)
+			x[i] >>= wasted;
+		bps -= wasted;
+	}
+	bits = 0;
+	if (n > FLAC_MAX_ORDER) {
+		order = flac_best_order(x, n, bps);
+		flac_residual(x, r, n, order);
+		bits = flac_rice_plan(r, n, order, &porder, params) +
+			order * bps;
+	}
+	if (!bits || bits >= (u_int64_t)n * bps) {
+		flac_put(b, 0x02 | !!wasted, 8);	/* VERBATIM */
+		if (wasted)
+			flac_put(b, 1, wasted);
+		for (i = 0; i < n; i++)
+			flac_put(b, x[i], bps);
+		return;
+	}
+	flac_put(b, ((0x08 | order) << 1) | !!wasted, 8);	/* FIXED */
+	if (wasted)
+		flac_put(b, 1, wasted);
+	for (i = 0; i < order; i++)
+		flac_put(b, x[i], bps);
+	method = 0;
+	for (j = 0; j < (1U << porder); j++)
+		if (params[j] > 14)
+			method = 1;
+	flac_put(b, method, 2);
+	flac_put(b, porder, 4);
+	cnt = n >> porder;
+	for (j = 0, i = order; j < (1U << porder); j++) {
+		unsigned int k = params[j];
+		flac_put(b, k, method ? 5 : 4);
+		for (; i < (j + 1) * cnt; i++) {
+			u_int32_t u = ((u_int32_t)r[i] << 1) ^
+				(u_int32_t)(r[i] >> 31);
+			u_int32_t q = u >> k;
+			if (q <= 31 - k) {
+				flac_put(b, (1U << k) | (u & ((1U << k) - 1)),
+					 q + 1 + k);
+			} else {
+				flac_put_unary(b, q);
+				flac_put(b, u, k);
+			}
+		}
+	}
+}
+
+static int flac_encode_block(struct snd_pcm_file_flac *flac)
+{
+	unsigned int n = flac->fill, g, c, i, len;
+	unsigned int rate_code = flac_rate_code(flac->rate);
+	u_int32_t num = flac->frame_no;
+	int err;
+
+	for (g = 0; g < flac->nstreams; g++) {
+		struct flac_stream *s = &flac->streams[g];
+		struct flac_bits b = { flac->out, 0, 0 };
+		unsigned char crc8 = 0;
+		unsigned short crc16 = 0;
+		unsigned char *p;
+
+		flac_put(&b, 0x3ffe, 14);	/* sync */
+		flac_put(&b, 0, 2);		/* fixed block size */
+		flac_put(&b, n == FLAC_BLOCK ? 12 : 7, 4);
+		flac_put(&b, rate_code, 4);
+		flac_put(&b, s->channels - 1, 4);
+		flac_put(&b, flac_bits_code(flac->bits), 3);
+		flac_put(&b, 0, 1);
+		/* frame number, coded like UTF-8 */
+		if (num < 0x80) {
+			flac_put(&b, num, 8);
+		} else {
+			unsigned int extra = 1;
+			while (extra < 6 && num >= (1U << (5 * extra + 6)))
+				extra++;
+			flac_put(&b, (0xff00 >> (extra + 1)) |
+				 (extra < 6 ? num >> (6 * extra) : 0), 8);
+			for (i = extra; i-- > 0; )
+				flac_put(&b, 0x80 | ((num >> (6 * i)) & 0x3f), 8);
+		}
+		if (n != FLAC_BLOCK)
+			flac_put(&b, n - 1, 16);
+		for (p = flac->out; p < b.p; p++)
+			crc8 = flac->crc8[crc8 ^ *p];
+		flac_put(&b, crc8, 8);
+		for (c = 0; c < s->channels; c++)
+			flac_subframe(flac, &b,
+				      flac->block + (s->first + c) * FLAC_BLOCK, n);
+		flac_align(&b);
+		for (p = flac->out; p < b.p; p++)
+			crc16 = (crc16 << 8) ^ flac->crc16[(crc16 >> 8) ^ *p];
+		flac_put(&b, crc16, 16);
+		len = b.p - flac->out;
+		err = flac_write_all(s->fd, flac->out, len);
+		if (err < 0)
+			return err;
+		if (!s->min_frame || len < s->min_frame)
+			s->min_frame = len;
+		if (len > s->max_frame)
+			s->max_frame = len;
+	}
+	flac->frames += n;
+	flac->frame_no++;
+	flac->fill = 0;
+	return 0;
+}
+
+static void flac_load_frame(struct snd_pcm_file_flac *flac,
+			    const unsigned char *p)
+{
+	int32_t *x = flac->block + flac->fill;
+	unsigned int c;
+
+	for (c = 0; c < flac->channels; c++, x += FLAC_BLOCK,
+	     p += flac->sample_bytes) {
+		switch (flac->format) {
+		case SND_PCM_FORMAT_S8:
+			*x = (int8_t)p[0];
+			break;
+		case SND_PCM_FORMAT_S16_LE:
+			*x = (int16_t)(p[0] | p[1] << 8);
+			break;
+		case SND_PCM_FORMAT_S24_LE:
+		case SND_PCM_FORMAT_S24_3LE:
+			*x = (int32_t)((u_int32_t)(p[0] | p[1] << 8 |
+						   p[2] << 16) << 8) >> 8;
+			break;
+		default:	/* S32_LE */
+			*x = (int32_t)(p[0] | p[1] << 8 | p[2] << 16 |
+				       (u_int32_t)p[3] << 24);
+			break;
+		}
+	}
+	flac->fill++;
+}
+
+/* encode the stream data, returns the bytes consumed */
+static ssize_t snd_pcm_file_flac_put(snd_pcm_file_t *file,
+				     const void *buf, size_t bytes)
+{
+	struct snd_pcm_file_flac *flac = file->flac;
+	const unsigned char *p = buf;
+	size_t left = bytes;
+	int err;
+
+	while (left > 0) {
+		if (flac->partial || left < flac->frame_bytes) {
+			size_t n = flac->frame_bytes - flac->partial;
+			if (n > left)
+				n = left;
+			memcpy(flac->part + flac->partial, p, n);
+			flac->partial += n;
+			p += n;
+			left -= n;
+			if (flac->partial < flac->frame_bytes)
+				break;
+			flac->partial = 0;
+			flac_load_frame(flac, flac->part);
+		} else {
+			flac_load_frame(flac, p);
+			p += flac->frame_bytes;
+			left -= flac->frame_bytes;
+		}
+		if (flac->fill == FLAC_BLOCK) {
+			err = flac_encode_block(flac);
+			if (err < 0) {
+				errno = -err;
+				return -1;
+			}
+		}
+	}
+	return bytes;
+}
+
+static void snd_pcm_file_flac_free(snd_pcm_file_t *file)
+{
+	struct snd_pcm_file_flac *flac = file->flac;
+	unsigned int g;
+
+	for (g = 1; g < flac->nstreams; g++)
+		if (flac->streams[g].fd >= 0)
+			close(flac->streams[g].fd);
+	free(flac->streams);
+	free(flac->part);
+	free(flac->block);
+	free(flac->residual);
+	free(flac->out);
+	free(flac);
+	file->flac = NULL;
+}
+
+/* set up the encoder and write the headers with the first data */
+static int snd_pcm_file_flac_start(snd_pcm_t *pcm)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	struct snd_pcm_file_flac *flac;
+	unsigned int g, width;
+	int err;
+
+	/* the format was checked by hw_params */
+	if (pcm->channels > FLAC_MAX_CHANNELS &&
+	    (!file->final_fname || file->final_fname[0] == '|')) {
+		SNDERR("FLAC output of %u channels needs a file name",
+		       pcm->channels);
+		return -EINVAL;
+	}
+	flac = calloc(1, sizeof(*flac));
+	if (!flac)
+		return -ENOMEM;
+	file->flac = flac;
+	flac->format = pcm->format;
+	flac->channels = pcm->channels;
+	flac->rate = pcm->rate;
+	flac->bits = snd_pcm_format_width(pcm->format);
+	flac->sample_bytes = snd_pcm_format_physical_width(pcm->format) / 8;
+	flac->frame_bytes = pcm->frame_bits / 8;
+	flac->nstreams = (pcm->channels + FLAC_MAX_CHANNELS - 1) /
+		FLAC_MAX_CHANNELS;
+	width = pcm->channels < FLAC_MAX_CHANNELS ? pcm->channels :
+		FLAC_MAX_CHANNELS;
+	flac->part = malloc(flac->frame_bytes);
+	flac->block = malloc(pcm->channels * FLAC_BLOCK * sizeof(int32_t));
+	flac->residual = malloc(FLAC_BLOCK * sizeof(int32_t));
+	/* verbatim subframes and the headers */
+	flac->out = malloc(width * (FLAC_BLOCK * 4 + 8) + 32);
+	flac->streams = calloc(flac->nstreams, sizeof(*flac->streams));
+	if (!flac->part || !flac->block || !flac->residual || !flac->out ||
+	    !flac->streams) {
+		err = -ENOMEM;
+		goto _err;
+	}
+	flac_init_crc(flac);
+	for (g = 0; g < flac->nstreams; g++) {
+		struct flac_stream *s = &flac->streams[g];
+		s->first = g * FLAC_MAX_CHANNELS;
+		s->channels = pcm->channels - s->first;
+		if (s->channels > FLAC_MAX_CHANNELS)
+			s->channels = FLAC_MAX_CHANNELS;
+		s->fd = -1;
+	}
+	flac->streams[0].fd = file->fd;
+	for (g = 1; g < flac->nstreams; g++) {
+		struct flac_stream *s = &flac->streams[g];
+		size_t len = strlen(file->final_fname) + 16;
+		char *name = malloc(len);
+		if (!name) {
+			err = -ENOMEM;
+			goto _err;
+		}
+		snprintf(name, len, "%s.ch%u", file->final_fname, s->first);
+		s->fd = open(name, O_WRONLY | O_CREAT |
+			     (file->trunc ? O_TRUNC : O_EXCL), file->perm);
+		if (s->fd < 0) {
+			err = -errno;
+			SYSERR("open %s for writing failed", name);
+			free(name);
+			goto _err;
+		}
+		free(name);
+	}
+	for (g = 0; g < flac->nstreams; g++) {
+		err = flac_write_header(flac, &flac->streams[g]);
+		if (err < 0) {
+			SYSERR("Write error.\n");
+			goto _err;
+		}
+	}
+	return 0;
+ _err:
+	snd_pcm_file_flac_free(file);
+	return err;
+}
+
+/* encode the last block and complete the STREAMINFO blocks */
+static void snd_pcm_file_flac_finish(snd_pcm_file_t *file)
+{
+	struct snd_pcm_file_flac *flac = file->flac;
+	unsigned char info[34];
+	unsigned int g;
+
+	if (flac->fill && flac_encode_block(flac) < 0)
+		SYSERR("write failed");
+	for (g = 0; g < flac->nstreams; g++) {
+		struct flac_stream *s = &flac->streams[g];
+		flac_streaminfo(flac, s, info);
+		if (lseek(s->fd, FLAC_STREAMINFO_OFS, SEEK_SET) ==
+		    FLAC_STREAMINFO_OFS &&
+		    write(s->fd, info, sizeof(info)) < 0)
+			SYSERR("write failed");
+	}
+	snd_pcm_file_flac_free(file);
+}
+
+/* the bytes leaving the plugin: into the file or through the encoder */
+static ssize_t snd_pcm_file_sink(snd_pcm_file_t *file, const void *buf,
+				 size_t bytes)
+{
+	if (file->flac)
+		return snd_pcm_file_flac_put(file, buf, bytes);
+	return write(file->fd, buf, bytes);
+}
+
+#ifdef FILE_HAVE_WRITER
+/*
+ * asynchronous writer
+ *
+ * With async_ring set, the data leaving wbuf is only copied into a
+ * single producer / single consumer ring, which a writer thread empties
+ * into the file, so that a stalled disk doesn't stall the audio path.
+ * When the ring is full, the data is dropped and counted instead.
+ */
+struct snd_pcm_file_writer {
+	pthread_t thread;
+	sem_t wakeup;
+	char *ring;
+	size_t mask;			/* ring size - 1, a power of two */
+	size_t head;			/* advanced by the audio path */
+	size_t tail;			/* advanced by the writer thread */
+	volatile int running;
+	int direct;			/* fd is in O_DIRECT mode */
+	int failed;			/* write error reported, discard the rest */
+	unsigned int frame_bytes;	/* of the stream, the unit of drops */
+	unsigned long long dropped;	/* bytes lost to a full ring */
+	unsigned long long discarded;	/* bytes lost after a write error */
+};
+
+static void snd_pcm_file_writer_direct_off(snd_pcm_file_t *file)
+{
+	int flags = fcntl(file->fd, F_GETFL);
+
+	if (flags >= 0)
+		fcntl(file->fd, F_SETFL, flags & ~O_DIRECT);
+	file->writer->direct = 0;
+}
+
+/*
+ * write out the queued data; in O_DIRECT mode only whole blocks go out
+ * (the ring and the file offset stay block aligned), the rest is written
+ * through the page cache at the end
+ */
+static void snd_pcm_file_writer_flush(snd_pcm_file_t *file, int final)
+{
+	struct snd_pcm_file_writer *w = file->writer;
+	size_t head = __atomic_load_n(&w->head, __ATOMIC_ACQUIRE);
+	size_t tail = w->tail;
+	ssize_t n;
+
+	if (final && w->direct)
+		snd_pcm_file_writer_direct_off(file);
+	while (tail != head) {
+		size_t ofs = tail & w->mask;
+		size_t len = head - tail;
+		if (len > w->mask + 1 - ofs)
+			len = w->mask + 1 - ofs;
+		if (w->direct) {
+			len &= ~(size_t)(DIRECT_BLOCK - 1);
+			if (!len)
+				break;
+		}
+		if (w->failed) {
+			n = len;
+			w->discarded += n;
+		} else {
+			n = snd_pcm_file_sink(file, w->ring + ofs, len);
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				if (errno == EINVAL && w->direct) {
+					snd_pcm_file_writer_direct_off(file);
+					continue;
+				}
+				SYSERR("write failed");
+				w->failed = 1;
+				continue;
+			}
+		}
+		tail += n;
+		__atomic_store_n(&w->tail, tail, __ATOMIC_RELEASE);
+	}
+}
+
+static void *snd_pcm_file_writer_thread(void *arg)
+{
+	snd_pcm_file_t *file = arg;
+	struct snd_pcm_file_writer *w = file->writer;
+	sigset_t mask;
+
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+	for (;;) {
+		while (sem_wait(&w->wakeup) < 0 && errno == EINTR)
+			;
+		if (!w->running) {
+			snd_pcm_file_writer_flush(file, 1);
+			break;
+		}
+		snd_pcm_file_writer_flush(file, 0);
+	}
+	return NULL;
+}
+
+/* queue the data for the writer thread; returns the bytes consumed */
+static size_t snd_pcm_file_writer_put(snd_pcm_file_t *file,
+				      const char *buf, size_t bytes)
+{
+	struct snd_pcm_file_writer *w = file->writer;
+	size_t head = w->head;
+	size_t avail = w->mask + 1 -
+		(head - __atomic_load_n(&w->tail, __ATOMIC_ACQUIRE));
+	size_t n = bytes, ofs, cont;
+
+	/* drop whole frames only, the file and the encoder keep in step */
+	if (n > avail) {
+		n = avail - avail % w->frame_bytes;
+		w->dropped += bytes - n;
+	}
+	ofs = head & w->mask;
+	cont = w->mask + 1 - ofs;
+	if (cont > n)
+		cont = n;
+	memcpy(w->ring + ofs, buf, cont);
+	memcpy(w->ring, buf + cont, n - cont);
+	if (n) {
+		__atomic_store_n(&w->head, head + n, __ATOMIC_RELEASE);
+		sem_post(&w->wakeup);
+	}
+	return bytes;
+}
+
+static int snd_pcm_file_writer_start(snd_pcm_file_t *file)
+{
+	struct snd_pcm_file_writer *w;
+	size_t size = ASYNC_RING_MIN;
+	int err;
+
+	while (size < (file->async_ring ? file->async_ring :
+		       ASYNC_RING_DIRECT))
+		size <<= 1;
+	w = calloc(1, sizeof(*w));
+	if (!w)
+		return -ENOMEM;
+	if (posix_memalign((void **)&w->ring, DIRECT_BLOCK, size)) {
+		free(w);
+		return -ENOMEM;
+	}
+	if (file->direct_io && file->format == SND_PCM_FILE_FORMAT_FLAC) {
+		SNDMSG("no O_DIRECT with FLAC output");
+	} else if (file->direct_io) {
+		int flags = fcntl(file->fd, F_GETFL);
+		if (flags >= 0 && lseek(file->fd, 0, SEEK_CUR) == 0 &&
+		    fcntl(file->fd, F_SETFL, flags | O_DIRECT) == 0)
+			w->direct = 1;
+		else
+			SNDMSG("O_DIRECT not available, writing through the page cache");
+	}
+	w->mask = size - 1;
+	w->running = 1;
+	sem_init(&w->wakeup, 0, 0);
+	file->writer = w;
+	err = snd_thread_create(&w->thread, NULL, snd_pcm_file_writer_thread,
+				file);
+	if (err) {
+		SNDERR("unable to create the writer thread");
+		file->writer = NULL;
+		sem_destroy(&w->wakeup);
+		free(w->ring);
+		free(w);
+		return -err;
+	}
+	return 0;
+}
+
+/* let the thread write out the queued data and quit */
+static void snd_pcm_file_writer_stop(snd_pcm_file_t *file)
+{
+	struct snd_pcm_file_writer *w = file->writer;
+
+	if (!w)
+		return;
+	w->running = 0;
+	sem_post(&w->wakeup);
+	pthread_join(w->thread, NULL);
+	if (w->dropped)
+		SNDERR("%s: %llu bytes dropped, the disk was too slow",
+		       file->fname ? file->fname : "file",
+		       w->dropped);
+	/* filelen counts what was queued */
+	file->filelen -= w->dropped + w->discarded;
+	file->writer = NULL;
+	sem_destroy(&w->wakeup);
+	free(w->ring);
+	free(w);
+}
+#endif /* FILE_HAVE_WRITER */
+
+/* write to the output file, or queue it with the writer thread */
+static ssize_t snd_pcm_file_output(snd_pcm_file_t *file, const void *buf,
+				   size_t bytes)
+{
+#ifdef FILE_HAVE_WRITER
+	if (file->writer)
+		return snd_pcm_file_writer_put(file, buf, bytes);
+#endif
+	return snd_pcm_file_sink(file, buf, bytes);
+}
+
 #if __BYTE_ORDER == __LITTLE_ENDIAN
 #define TO_LE32(x)	(x)
 #define TO_LE16(x)	(x)
@@ -273,7 +1137,7 @@ static void setup_wav_header(snd_pcm_t *pcm, struct wav_fmt *fmt)
 	fmt->rate = TO_LE32(pcm->rate);
 	fmt->bwidth = pcm->frame_bits / 8;
 	fmt->bps = fmt->bwidth * pcm->rate;
-	fmt->bits = snd_pcm_format_width(pcm->format);
+	fmt->bits = __snd_pcm_format_width(pcm->format);
 	fmt->bps = TO_LE32(fmt->bps);
 	fmt->bwidth = TO_LE16(fmt->bwidth);
 	fmt->bits = TO_LE16(fmt->bits);
@@ -296,10 +1160,12 @@ static int write_wav_header(snd_pcm_t *pcm)
 	
 	setup_wav_header(pcm, &file->wav_header);
 
-	if (write(file->fd, header, sizeof(header)) != sizeof(header) ||
-	    write(file->fd, &file->wav_header, sizeof(file->wav_header)) !=
+	if (snd_pcm_file_output(file, header, sizeof(header)) != sizeof(header) ||
+	    snd_pcm_file_output(file, &file->wav_header,
+				sizeof(file->wav_header)) !=
 	    sizeof(file->wav_header) ||
-	    write(file->fd, header2, sizeof(header2)) != sizeof(header2)) {
+	    snd_pcm_file_output(file, header2, sizeof(header2)) !=
+	    sizeof(header2)) {
 		int err = errno;
 		SYSERR("Write error.\n");
 		return -err;
@@ -346,6 +1212,10 @@ static void snd_pcm_file_write_bytes(snd_pcm_t *pcm, size_t bytes)
 		if (write_wav_header(pcm) < 0)
 			return;
 	}
+	if (file->format == SND_PCM_FILE_FORMAT_FLAC && !file->flac) {
+		if (snd_pcm_file_flac_start(pcm) < 0)
+			return;
+	}
 
 	while (bytes > 0) {
 		snd_pcm_sframes_t err;
@@ -353,7 +1223,8 @@ static void snd_pcm_file_write_bytes(snd_pcm_t *pcm, size_t bytes)
 		size_t cont = file->wbuf_size_bytes - file->file_ptr_bytes;
 		if (n > cont)
 			n = cont;
-		err = write(file->fd, file->wbuf + file->file_ptr_bytes, n);
+		err = snd_pcm_file_output(file,
+					  file->wbuf + file->file_ptr_bytes, n);
 		if (err < 0) {
 			SYSERR("write failed");
 			break;
@@ -401,6 +1272,11 @@ static void snd_pcm_file_add_frames(snd_pcm_t *pcm,
 static int snd_pcm_file_close(snd_pcm_t *pcm)
 {
 	snd_pcm_file_t *file = pcm->private_data;
+#ifdef FILE_HAVE_WRITER
+	snd_pcm_file_writer_stop(file);
+#endif
+	if (file->flac)
+		snd_pcm_file_flac_finish(file);
 	if (file->fname) {
 		if (file->wav_header.fmt)
 			fixup_wav_header(pcm);
@@ -409,6 +1285,8 @@ static int snd_pcm_file_close(snd_pcm_t *pcm)
 			close(file->fd);
 		}
 	}
+	if (file->imap)
+		munmap(file->imap, file->imap_len);
 	if (file->ifname) {
 		free((void *)file->ifname);
 		close(file->ifd);
@@ -540,6 +1418,61 @@ static snd_pcm_sframes_t snd_pcm_file_writen(snd_pcm_t *pcm, void **bufs, snd_pc
 	return n;
 }
 
+/*
+ * map the whole infile; a WAV file is replayed from its data chunk on
+ */
+static void snd_pcm_file_map_infile(snd_pcm_file_t *file)
+{
+	struct stat st;
+	const char *p;
+	size_t pos, len;
+	void *map;
+
+	file->infile_mmap = 0;		/* try only once */
+	if (fstat(file->ifd, &st) < 0 || !S_ISREG(st.st_mode) ||
+	    st.st_size <= 0 || (off_t)(size_t)st.st_size != st.st_size) {
+		SNDMSG("infile can't be mapped, using read()");
+		return;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, file->ifd, 0);
+	if (map == MAP_FAILED) {
+		SYSMSG("mmap of infile failed, using read()");
+		return;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+	file->imap = map;
+	file->imap_len = st.st_size;
+	file->imap_size = st.st_size;
+	file->imap_pos = 0;
+	p = map;
+	if (file->imap_size < 12 || memcmp(p, "RIFF", 4) ||
+	    memcmp(p + 8, "WAVE", 4))
+		return;
+	for (pos = 12; pos + 8 <= file->imap_size; pos += 8 + len + (len & 1)) {
+		len = (unsigned char)p[pos + 4] |
+		      (unsigned char)p[pos + 5] << 8 |
+		      (unsigned char)p[pos + 6] << 16 |
+		      (size_t)(unsigned char)p[pos + 7] << 24;
+		if (!memcmp(p + pos, "data", 4)) {
+			file->imap_pos = pos + 8;
+			if (len && file->imap_pos + len < file->imap_size)
+				file->imap_size = file->imap_pos + len;
+			return;
+		}
+	}
+}
+
+/* frames left in the mapped infile, at most size */
+static snd_pcm_uframes_t snd_pcm_file_mapped_frames(snd_pcm_t *pcm,
+						    snd_pcm_uframes_t size)
+{
+	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_uframes_t left;
+
+	left = snd_pcm_bytes_to_frames(pcm, file->imap_size - file->imap_pos);
+	return size < left ? size : left;
+}
+
 /* locking */
 static snd_pcm_sframes_t snd_pcm_file_readi(snd_pcm_t *pcm, void *buffer, snd_pcm_uframes_t size)
 {
@@ -551,6 +1484,16 @@ static snd_pcm_sframes_t snd_pcm_file_readi(snd_pcm_t *pcm, void *buffer, snd_pc
 		return n;
 	if (file->ifd >= 0) {
 		__snd_pcm_lock(pcm);
+		if (file->infile_mmap)
+			snd_pcm_file_map_infile(file);
+		if (file->imap) {
+			n = snd_pcm_file_mapped_frames(pcm, n);
+			memcpy(buffer, file->imap + file->imap_pos,
+			       snd_pcm_frames_to_bytes(pcm, n));
+			file->imap_pos += snd_pcm_frames_to_bytes(pcm, n);
+			__snd_pcm_unlock(pcm);
+			return n;
+		}
 		n = read(file->ifd, buffer, n * pcm->frame_bits / 8);
 		__snd_pcm_unlock(pcm);
 		if (n < 0)
@@ -564,14 +1507,38 @@ static snd_pcm_sframes_t snd_pcm_file_readi(snd_pcm_t *pcm, void *buffer, snd_pc
 static snd_pcm_sframes_t snd_pcm_file_readn(snd_pcm_t *pcm, void **bufs, snd_pcm_uframes_t size)
 {
 	snd_pcm_file_t *file = pcm->private_data;
+	snd_pcm_channel_area_t areas[pcm->channels];
+	snd_pcm_channel_area_t src_areas[pcm->channels];
 	snd_pcm_sframes_t n;
+	unsigned int channel;
 
-	if (file->ifd >= 0) {
+	if (file->ifd >= 0 && !file->imap && !file->infile_mmap) {
 		SNDERR("DEBUG: Noninterleaved read not yet implemented.\n");
 		return 0;	/* TODO: Noninterleaved read */
 	}
 
 	n = _snd_pcm_readn(file->gen.slave, bufs, size);
+	if (n <= 0 || file->ifd < 0)
+		return n;
+	snd_pcm_areas_from_bufs(pcm, areas, bufs);
+	/* the mapped infile serves as interleaved source areas */
+	__snd_pcm_lock(pcm);
+	if (file->infile_mmap)
+		snd_pcm_file_map_infile(file);
+	if (!file->imap) {
+		__snd_pcm_unlock(pcm);
+		return 0;
+	}
+	n = snd_pcm_file_mapped_frames(pcm, n);
+	for (channel = 0; channel < pcm->channels; channel++) {
+		src_areas[channel].addr = file->imap + file->imap_pos;
+		src_areas[channel].first = channel * pcm->sample_bits;
+		src_areas[channel].step = pcm->frame_bits;
+	}
+	snd_pcm_areas_copy(areas, 0, src_areas, 0, pcm->channels, n,
+			   pcm->format);
+	file->imap_pos += snd_pcm_frames_to_bytes(pcm, n);
+	__snd_pcm_unlock(pcm);
 	return n;
 }
 
@@ -610,7 +1577,27 @@ static int snd_pcm_file_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	snd_pcm_file_t *file = pcm->private_data;
 	unsigned int channel;
 	snd_pcm_t *slave = file->gen.slave;
-	int err = _snd_pcm_hw_params_internal(slave, params);
+	snd_pcm_format_t format;
+	int err;
+
+	if (file->format == SND_PCM_FILE_FORMAT_FLAC) {
+		err = INTERNAL(snd_pcm_hw_params_get_format)(params, &format);
+		if (err < 0)
+			return err;
+		switch (format) {
+		case SND_PCM_FORMAT_S8:
+		case SND_PCM_FORMAT_S16_LE:
+		case SND_PCM_FORMAT_S24_LE:
+		case SND_PCM_FORMAT_S24_3LE:
+		case SND_PCM_FORMAT_S32_LE:
+			break;
+		default:
+			SNDERR("format %s is not supported by FLAC output",
+			       snd_pcm_format_name(format));
+			return -EINVAL;
+		}
+	}
+	err = _snd_pcm_hw_params_internal(slave, params);
 	if (err < 0)
 		return err;
 	file->buffer_bytes = snd_pcm_frames_to_bytes(slave, slave->buffer_size);
@@ -642,6 +1629,16 @@ static int snd_pcm_file_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 			return err;
 		}
 	}
+#ifdef FILE_HAVE_WRITER
+	if ((file->async_ring || file->direct_io) && file->fd >= 0 &&
+	    !file->writer) {
+		err = snd_pcm_file_writer_start(file);
+		if (err < 0)
+			return err;
+	}
+	if (file->writer)
+		file->writer->frame_bytes = (slave->frame_bits + 7) / 8;
+#endif
 	return 0;
 }
 
@@ -655,6 +1652,12 @@ static void snd_pcm_file_dump(snd_pcm_t *pcm, snd_output_t *out)
 	if (file->final_fname)
 		snd_output_printf(out, "Final file PCM (file=%s)\n",
 				file->final_fname);
+#ifdef FILE_HAVE_WRITER
+	if (file->writer)
+		snd_output_printf(out, "Writer thread ring %lu bytes, %llu bytes dropped\n",
+				  (unsigned long)file->writer->mask + 1,
+				  file->writer->dropped);
+#endif
 
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
@@ -723,7 +1726,7 @@ static const snd_pcm_fast_ops_t snd_pcm_file_fast_ops = {
  * \param ifd Input file descriptor (if (ifd < 0) && (ifname == NULL), no input
  *            redirection will be performed)
  * \param trunc Truncate the file if it already exists
- * \param fmt File format ("raw" or "wav" are available)
+ * \param fmt File format ("raw", "wav" or "flac" are available)
  * \param perm File permission
  * \param slave Slave PCM handle
  * \param close_slave When set, the slave PCM handle is closed with copy PCM
@@ -751,6 +1754,8 @@ int snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 		format = SND_PCM_FILE_FORMAT_RAW;
 	else if (!strcmp(fmt, "wav"))
 		format = SND_PCM_FILE_FORMAT_WAV;
+	else if (!strcmp(fmt, "flac"))
+		format = SND_PCM_FILE_FORMAT_FLAC;
 	else {
 		SNDERR("file format %s is unknown", fmt);
 		return -EINVAL;
@@ -842,11 +1847,44 @@ pcm.name {
 	infile STR		# Input filename - only raw format
 	or
 	infile INT		# Input file descriptor number
-	[format STR]		# File format ("raw" or "wav")
+	[infile_mmap BOOL]	# Map the input file instead of reading it
+	[format STR]		# File format ("raw", "wav" or "flac")
 	[perm INT]		# Output file permission (octal, def. 0600)
+	[async_ring INT]	# Writer thread ring in bytes (def. 0 = no thread)
+	[direct_io BOOL]	# Writer thread uses O_DIRECT (def. false)
 }
 \endcode
 
+With <code>async_ring</code> set, the output file is written by a
+background thread, fed through a ring of the given size (rounded up to
+a power of two, at least 4096 bytes), so that a slow disk or a stalled
+network file system doesn't block the audio path.  When the thread
+falls behind by more than the ring, the data is dropped; the number of
+dropped bytes is shown by the dump and reported when the PCM is closed.
+
+With <code>infile_mmap</code>, the input file is mapped into memory as
+a whole with sequential readahead, and the captured data is copied
+straight from the mapping, which also serves the non-interleaved read.
+A WAV input file is then replayed from its data chunk on; only files
+in the stream format make sense.  When the file can't be mapped, it's
+read as before.
+
+<code>direct_io</code> makes the writer thread (started with a 1 MiB ring
+unless <code>async_ring</code> is given) write the file with \c O_DIRECT
+in aligned blocks of 4096 bytes, bypassing the page cache for long
+recordings.  The last partial block and the WAV header fixup are written
+normally at close.  File systems or pipes not supporting \c O_DIRECT
+are written as before.
+
+The <code>flac</code> format compresses the stream losslessly to FLAC,
+for signed 8, 16, 24 and 32 bit samples in little endian; other formats
+are refused.  The encoder is built in and fast rather than thorough,
+and it runs in the writer thread when there is one.  A FLAC stream has
+at most 8 channels, so the channels from N to N+7 of a wider stream go
+to the file named after the output file with ".chN" appended, N being
+8, 16 and so on.  The total length is written into the files at close,
+a pipe gets streams of unknown length.
+
 \subsection pcm_plugins_file_funcref Function reference
 
 <UL>
@@ -881,6 +1919,9 @@ int _snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 	const char *format = NULL;
 	long fd = -1, ifd = -1, trunc = 1;
 	long perm = 0600;
+	long async_ring = 0;
+	int direct_io = 0;
+	int infile_mmap = 0;
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		const char *id;
@@ -941,6 +1982,32 @@ int _snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 			trunc = err;
 			continue;
 		}
+		if (strcmp(id, "async_ring") == 0) {
+			err = snd_config_get_integer(n, &async_ring);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				return err;
+			}
+			if (async_ring < 0) {
+				SNDERR("Invalid async_ring %ld", async_ring);
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (strcmp(id, "infile_mmap") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return -EINVAL;
+			infile_mmap = err;
+			continue;
+		}
+		if (strcmp(id, "direct_io") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return -EINVAL;
+			direct_io = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -973,9 +2040,21 @@ int _snd_pcm_file_open(snd_pcm_t **pcmp, const char *name,
 		return err;
 	err = snd_pcm_file_open(pcmp, name, fname, fd, ifname, ifd,
 				trunc, format, perm, spcm, 1, stream);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
-	return err;
+		return err;
+	}
+	((snd_pcm_file_t *)(*pcmp)->private_data)->infile_mmap = infile_mmap;
+#ifdef FILE_HAVE_WRITER
+	((snd_pcm_file_t *)(*pcmp)->private_data)->async_ring = async_ring;
+	((snd_pcm_file_t *)(*pcmp)->private_data)->direct_io = direct_io;
+#else
+	if (async_ring)
+		SNDMSG("no writer thread support, async_ring ignored");
+	if (direct_io)
+		SNDMSG("no writer thread support, direct_io ignored");
+#endif
+	return 0;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_file_open, SND_PCM_DLSYM_VERSION);
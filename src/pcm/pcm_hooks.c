@@ -29,6 +29,10 @@
   
 #include "pcm_local.h"
 #include "pcm_generic.h"
+#ifdef THREAD_SAFE_API
+#include <signal.h>
+#define HOOKS_HAVE_WORKER
+#endif
 
 #ifndef PIC
 /* entry for static linking */
@@ -44,7 +48,7 @@ struct _snd_pcm_hook {
 };
 
 struct snd_pcm_hook_dllist {
-	void *dlobj;
+	void *install_func;	/* reference in the dlobj cache */
 	struct list_head list;
 };
 
@@ -52,10 +56,15 @@ typedef struct {
 	snd_pcm_generic_t gen;
 	struct list_head hooks[SND_PCM_HOOK_TYPE_LAST + 1];
 	struct list_head dllist;
+	int deferred;			/* run hw_params hooks in a worker */
+#ifdef HOOKS_HAVE_WORKER
+	pthread_t worker;
+	int worker_running;
+#endif
 } snd_pcm_hooks_t;
 #endif
 
-static int hook_add_dlobj(snd_pcm_t *pcm, void *dlobj)
+static int hook_add_dlobj(snd_pcm_t *pcm, void *install_func)
 {
 	snd_pcm_hooks_t *h = pcm->private_data;
 	struct snd_pcm_hook_dllist *dl;
@@ -64,7 +73,7 @@ static int hook_add_dlobj(snd_pcm_t *pcm, void *dlobj)
 	if (!dl)
 		return -ENOMEM;
 
-	dl->dlobj = dlobj;
+	dl->install_func = install_func;
 	list_add_tail(&dl->list, &h->dllist);
 	return 0;
 }
@@ -72,10 +81,64 @@ static int hook_add_dlobj(snd_pcm_t *pcm, void *dlobj)
 static void hook_remove_dlobj(struct snd_pcm_hook_dllist *dl)
 {
 	list_del(&dl->list);
-	snd_dlclose(dl->dlobj);
+	snd_dlobj_cache_put(dl->install_func);
 	free(dl);
 }
 
+static int snd_pcm_hooks_run(snd_pcm_hooks_t *h, int type)
+{
+	struct list_head *pos, *next;
+	int err;
+
+	list_for_each_safe(pos, next, &h->hooks[type]) {
+		snd_pcm_hook_t *hook = list_entry(pos, snd_pcm_hook_t, list);
+		err = hook->func(hook);
+		if (err < 0)
+			return err;
+	}
+	return 0;
+}
+
+#ifdef HOOKS_HAVE_WORKER
+static void *snd_pcm_hooks_worker(void *arg)
+{
+	snd_pcm_hooks_t *h = arg;
+	sigset_t mask;
+	int err;
+
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+	err = snd_pcm_hooks_run(h, SND_PCM_HOOK_TYPE_HW_PARAMS);
+	if (err < 0)
+		SNDERR("deferred hw_params hooks failed: %s", snd_strerror(err));
+	return NULL;
+}
+
+/* start the hw_params hooks in the background, 0 if not possible */
+static int snd_pcm_hooks_defer(snd_pcm_hooks_t *h)
+{
+	if (!h->deferred ||
+	    list_empty(&h->hooks[SND_PCM_HOOK_TYPE_HW_PARAMS]))
+		return 0;
+	if (snd_thread_create(&h->worker, NULL, snd_pcm_hooks_worker, h))
+		return 0;
+	h->worker_running = 1;
+	return 1;
+}
+
+/* wait until the deferred hooks have been run */
+static void snd_pcm_hooks_sync(snd_pcm_hooks_t *h)
+{
+	if (h->worker_running) {
+		pthread_join(h->worker, NULL);
+		h->worker_running = 0;
+	}
+}
+#else
+#define snd_pcm_hooks_defer(h)	0
+#define snd_pcm_hooks_sync(h)	do { } while (0)
+#endif
+
 static int snd_pcm_hooks_close(snd_pcm_t *pcm)
 {
 	snd_pcm_hooks_t *h = pcm->private_data;
@@ -83,6 +146,7 @@ static int snd_pcm_hooks_close(snd_pcm_t *pcm)
 	unsigned int k;
 	int res = 0, err;
 
+	snd_pcm_hooks_sync(h);
 	list_for_each_safe(pos, next, &h->hooks[SND_PCM_HOOK_TYPE_CLOSE]) {
 		snd_pcm_hook_t *hook = list_entry(pos, snd_pcm_hook_t, list);
 		err = hook->func(hook);
@@ -111,39 +175,33 @@ static int snd_pcm_hooks_close(snd_pcm_t *pcm)
 static int snd_pcm_hooks_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
 	snd_pcm_hooks_t *h = pcm->private_data;
-	struct list_head *pos, *next;
-	int err = snd_pcm_generic_hw_params(pcm, params);
+	int err;
+
+	snd_pcm_hooks_sync(h);
+	err = snd_pcm_generic_hw_params(pcm, params);
 	if (err < 0)
 		return err;
-	list_for_each_safe(pos, next, &h->hooks[SND_PCM_HOOK_TYPE_HW_PARAMS]) {
-		snd_pcm_hook_t *hook = list_entry(pos, snd_pcm_hook_t, list);
-		err = hook->func(hook);
-		if (err < 0)
-			return err;
-	}
-	return 0;
+	if (snd_pcm_hooks_defer(h))
+		return 0;
+	return snd_pcm_hooks_run(h, SND_PCM_HOOK_TYPE_HW_PARAMS);
 }
 
 static int snd_pcm_hooks_hw_free(snd_pcm_t *pcm)
 {
 	snd_pcm_hooks_t *h = pcm->private_data;
-	struct list_head *pos, *next;
-	int err = snd_pcm_generic_hw_free(pcm);
+	int err;
+
+	snd_pcm_hooks_sync(h);
+	err = snd_pcm_generic_hw_free(pcm);
 	if (err < 0)
 		return err;
-	list_for_each_safe(pos, next, &h->hooks[SND_PCM_HOOK_TYPE_HW_FREE]) {
-		snd_pcm_hook_t *hook = list_entry(pos, snd_pcm_hook_t, list);
-		err = hook->func(hook);
-		if (err < 0)
-			return err;
-	}
-	return 0;
+	return snd_pcm_hooks_run(h, SND_PCM_HOOK_TYPE_HW_FREE);
 }
 
 static void snd_pcm_hooks_dump(snd_pcm_t *pcm, snd_output_t *out)
 {
 	snd_pcm_hooks_t *h = pcm->private_data;
-	snd_output_printf(out, "Hooks PCM\n");
+	snd_output_printf(out, "Hooks PCM%s\n", h->deferred ? " (deferred)" : "");
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -292,9 +350,15 @@ pcm.NAME {
 		# or
 		ID { }		# Hook definition (see pcm_hook)
 	}
+	[deferred BOOL]		# Run hw_params hooks in a worker thread
 }
 \endcode
 
+With <code>deferred</code> set, the hw_params hooks run in a background
+thread, so snd_pcm_hw_params() does not wait for them.  hw_free, close
+and the next hw_params wait for that thread to finish first.  Errors of
+deferred hooks are only reported through the error handler.
+
 Example:
 
 \code
@@ -347,7 +411,6 @@ static int snd_pcm_hook_add_conf(snd_pcm_t *pcm, snd_config_t *root, snd_config_
 	snd_config_t *type = NULL, *args = NULL;
 	snd_config_iterator_t i, next;
 	int (*install_func)(snd_pcm_t *pcm, snd_config_t *args) = NULL;
-	void *h = NULL;
 
 	if (snd_config_get_type(conf) != SND_CONFIG_TYPE_COMPOUND) {
 		SNDERR("Invalid hook definition");
@@ -424,19 +487,9 @@ static int snd_pcm_hook_add_conf(snd_pcm_t *pcm, snd_config_t *root, snd_config_
 		install = buf;
 		snprintf(buf, sizeof(buf), "_snd_pcm_hook_%s_install", str);
 	}
-	h = snd_dlopen(lib, RTLD_NOW);
-	install_func = h ? snd_dlsym(h, install, SND_DLSYM_VERSION(SND_PCM_DLSYM_VERSION)) : NULL;
-	err = 0;
-	if (!h) {
-		SNDERR("Cannot open shared library %s",
-		       lib ? lib : "[builtin]");
-		err = -ENOENT;
-	} else if (!install_func) {
-		SNDERR("symbol %s is not defined inside %s", install,
-		       lib ? lib : "[builtin]");
-		snd_dlclose(h);
-		err = -ENXIO;
-	}
+	install_func = snd_dlobj_cache_get(lib, install,
+			SND_DLSYM_VERSION(SND_PCM_DLSYM_VERSION), 1);
+	err = install_func ? 0 : -ENXIO;
        _err:
 	if (type)
 		snd_config_delete(type);
@@ -454,11 +507,10 @@ static int snd_pcm_hook_add_conf(snd_pcm_t *pcm, snd_config_t *root, snd_config_
 		err = install_func(pcm, args);
 
 	if (err >= 0)
-		err = hook_add_dlobj(pcm, h);
+		err = hook_add_dlobj(pcm, install_func);
 
 	if (err < 0) {
-		if(h)
-			snd_dlclose(h);
+		snd_dlobj_cache_put(install_func);
 		return err;
 	}
 	return 0;
@@ -486,6 +538,7 @@ int _snd_pcm_hooks_open(snd_pcm_t **pcmp, const char *name,
 	snd_pcm_t *rpcm = NULL, *spcm;
 	snd_config_t *slave = NULL, *sconf;
 	snd_config_t *hooks = NULL;
+	int deferred = 0;
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		const char *id;
@@ -505,6 +558,13 @@ int _snd_pcm_hooks_open(snd_pcm_t **pcmp, const char *name,
 			hooks = n;
 			continue;
 		}
+		if (strcmp(id, "deferred") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				return err;
+			deferred = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -524,6 +584,7 @@ int _snd_pcm_hooks_open(snd_pcm_t **pcmp, const char *name,
 		snd_pcm_close(spcm);
 		return err;
 	}
+	((snd_pcm_hooks_t *)rpcm->private_data)->deferred = deferred;
 	if (!hooks)
 		goto _done;
 	snd_config_for_each(i, next, hooks) {
@@ -637,24 +698,113 @@ int snd_pcm_hook_remove(snd_pcm_hook_t *hook)
  *
  */
 
+#ifndef DOC_HIDDEN
+/*
+ * CTL handles shared by all ctl_elems hooks of a card in this process,
+ * so that every hooked PCM does not open its own
+ */
+struct hook_ctl {
+	int card;
+	snd_ctl_t *ctl;
+	unsigned int refs;
+	struct list_head list;
+};
+
+typedef struct {
+	snd_sctl_t *sctl;
+	struct hook_ctl *ctl;
+} hook_ctl_elems_t;
+#endif
+
+static LIST_HEAD(hook_ctls);
+
+#ifdef THREAD_SAFE_API
+static pthread_mutex_t hook_ctls_mutex = PTHREAD_MUTEX_INITIALIZER;
+static inline void hook_ctls_lock(void)
+{
+	pthread_mutex_lock(&hook_ctls_mutex);
+}
+static inline void hook_ctls_unlock(void)
+{
+	pthread_mutex_unlock(&hook_ctls_mutex);
+}
+#else
+static inline void hook_ctls_lock(void) {}
+static inline void hook_ctls_unlock(void) {}
+#endif
+
+static int hook_ctl_get(int card, struct hook_ctl **ctlp)
+{
+	struct list_head *pos;
+	struct hook_ctl *c;
+	char ctl_name[16];
+	int err;
+
+	hook_ctls_lock();
+	list_for_each(pos, &hook_ctls) {
+		c = list_entry(pos, struct hook_ctl, list);
+		if (c->card == card) {
+			c->refs++;
+			*ctlp = c;
+			hook_ctls_unlock();
+			return 0;
+		}
+	}
+	c = calloc(1, sizeof(*c));
+	if (!c) {
+		hook_ctls_unlock();
+		return -ENOMEM;
+	}
+	sprintf(ctl_name, "hw:%d", card);
+	err = snd_ctl_open(&c->ctl, ctl_name, 0);
+	if (err < 0) {
+		SNDERR("Cannot open CTL %s", ctl_name);
+		free(c);
+		hook_ctls_unlock();
+		return err;
+	}
+	c->card = card;
+	c->refs = 1;
+	list_add_tail(&c->list, &hook_ctls);
+	*ctlp = c;
+	hook_ctls_unlock();
+	return 0;
+}
+
+static int hook_ctl_put(struct hook_ctl *c)
+{
+	int err = 0;
+
+	hook_ctls_lock();
+	if (!--c->refs) {
+		list_del(&c->list);
+		err = snd_ctl_close(c->ctl);
+		free(c);
+	}
+	hook_ctls_unlock();
+	return err;
+}
+
 static int snd_pcm_hook_ctl_elems_hw_params(snd_pcm_hook_t *hook)
 {
-	snd_sctl_t *h = snd_pcm_hook_get_private(hook);
-	return snd_sctl_install(h);
+	hook_ctl_elems_t *h = snd_pcm_hook_get_private(hook);
+	return snd_sctl_install(h->sctl);
 }
 
 static int snd_pcm_hook_ctl_elems_hw_free(snd_pcm_hook_t *hook)
 {
-	snd_sctl_t *h = snd_pcm_hook_get_private(hook);
-	return snd_sctl_remove(h);
+	hook_ctl_elems_t *h = snd_pcm_hook_get_private(hook);
+	return snd_sctl_remove(h->sctl);
 }
 
 static int snd_pcm_hook_ctl_elems_close(snd_pcm_hook_t *hook)
 {
-	snd_sctl_t *h = snd_pcm_hook_get_private(hook);
-	int err = snd_sctl_free(h);
+	hook_ctl_elems_t *h = snd_pcm_hook_get_private(hook);
+	int err = snd_sctl_free(h->sctl);
+	int err1 = hook_ctl_put(h->ctl);
+	free(h);
 	snd_pcm_hook_set_private(hook, NULL);
-	return err;
+	return err < 0 ? err : err1;
 }
 
 /**
@@ -662,15 +812,16 @@ static int snd_pcm_hook_ctl_elems_close(snd_pcm_hook_t *hook)
  * \param pcm PCM handle
  * \param conf Configuration node with CTL settings
  * \return zero on success otherwise a negative error code
+ *
+ * The CTL handle of the card is opened once and shared with the other
+ * ctl_elems hooks of the same card in this process.
  */
 int _snd_pcm_hook_ctl_elems_install(snd_pcm_t *pcm, snd_config_t *conf)
 {
 	int err;
 	int card;
 	snd_pcm_info_t info = {0};
-	char ctl_name[16];
-	snd_ctl_t *ctl;
-	snd_sctl_t *sctl = NULL;
+	hook_ctl_elems_t *elems;
 	snd_config_t *pcm_conf = NULL;
 	snd_pcm_hook_t *h_hw_params = NULL, *h_hw_free = NULL, *h_close = NULL;
 	assert(conf);
@@ -684,28 +835,31 @@ int _snd_pcm_hook_ctl_elems_install(snd_pcm_t *pcm, snd_config_t *conf)
 		SNDERR("No card for this PCM");
 		return -EINVAL;
 	}
-	sprintf(ctl_name, "hw:%d", card);
-	err = snd_ctl_open(&ctl, ctl_name, 0);
+	elems = calloc(1, sizeof(*elems));
+	if (!elems)
+		return -ENOMEM;
+	err = hook_ctl_get(card, &elems->ctl);
 	if (err < 0) {
-		SNDERR("Cannot open CTL %s", ctl_name);
+		free(elems);
 		return err;
 	}
 	err = snd_config_imake_pointer(&pcm_conf, "pcm_handle", pcm);
 	if (err < 0)
 		goto _err;
-	err = snd_sctl_build(&sctl, ctl, conf, pcm_conf, 0);
+	err = snd_sctl_build(&elems->sctl, elems->ctl->ctl, conf, pcm_conf,
+			     SND_SCTL_NOFREE);
 	if (err < 0)
 		goto _err;
 	err = snd_pcm_hook_add(&h_hw_params, pcm, SND_PCM_HOOK_TYPE_HW_PARAMS,
-			       snd_pcm_hook_ctl_elems_hw_params, sctl);
+			       snd_pcm_hook_ctl_elems_hw_params, elems);
 	if (err < 0)
 		goto _err;
 	err = snd_pcm_hook_add(&h_hw_free, pcm, SND_PCM_HOOK_TYPE_HW_FREE,
-			       snd_pcm_hook_ctl_elems_hw_free, sctl);
+			       snd_pcm_hook_ctl_elems_hw_free, elems);
 	if (err < 0)
 		goto _err;
 	err = snd_pcm_hook_add(&h_close, pcm, SND_PCM_HOOK_TYPE_CLOSE,
-			       snd_pcm_hook_ctl_elems_close, sctl);
+			       snd_pcm_hook_ctl_elems_close, elems);
 	if (err < 0)
 		goto _err;
 	snd_config_delete(pcm_conf);
@@ -717,8 +871,10 @@ int _snd_pcm_hook_ctl_elems_install(snd_pcm_t *pcm, snd_config_t *conf)
 		snd_pcm_hook_remove(h_hw_free);
 	if (h_close)
 		snd_pcm_hook_remove(h_close);
-	if (sctl)
-		snd_sctl_free(sctl);
+	if (elems->sctl)
+		snd_sctl_free(elems->sctl);
+	hook_ctl_put(elems->ctl);
+	free(elems);
 	if (pcm_conf)
 		snd_config_delete(pcm_conf);
 	return err;
@@ -91,6 +91,12 @@ typedef struct {
 	int fd;
 	int card, device, subdevice;
 	int sync_ptr_ioctl;
+	int fast_ptr;
+	unsigned long fast_ptr_saved;	/* ioctls answered from the status page */
+	unsigned long fast_ptr_synced;	/* ioctls still issued in fast_ptr mode */
+	snd_pcm_uframes_t defer_appl;	/* appl_ptr publish granularity, 0 = off */
+	snd_pcm_uframes_t appl_pending;	/* committed frames not yet published */
+	unsigned long defer_saved;	/* SYNC_PTR ioctls skipped by deferring */
 	volatile struct snd_pcm_mmap_status * mmap_status;
 	struct snd_pcm_mmap_control *mmap_control;
 	struct snd_pcm_sync_ptr *sync_ptr;
@@ -126,6 +132,14 @@ struct timespec snd_pcm_hw_fast_tstamp(snd_pcm_t *pcm)
 		res.tv_nsec *= 1000L;
 	return res;
 }
+
+/* the status is mmapped, so a hwsync through any fd of the substream
+ * refreshes the hw_ptr seen by all of them */
+int snd_pcm_hw_status_shared(snd_pcm_t *pcm)
+{
+	snd_pcm_hw_t *hw = pcm->private_data;
+	return hw->sync_ptr == NULL;
+}
 #endif /* DOC_HIDDEN */
 
 static int sync_ptr1(snd_pcm_hw_t *hw, unsigned int flags)
@@ -138,6 +152,7 @@ static int sync_ptr1(snd_pcm_hw_t *hw, unsigned int flags)
 		SYSMSG("SNDRV_PCM_IOCTL_SYNC_PTR failed (%i)", err);
 		return err;
 	}
+	hw->appl_pending = 0;
 	return 0;
 }
 
@@ -146,6 +161,88 @@ static inline int sync_ptr(snd_pcm_hw_t *hw, unsigned int flags)
 	return hw->sync_ptr ? sync_ptr1(hw, flags) : 0;
 }
 
+/*
+ * Deferred appl_ptr publishing (defer_appl_ptr option): with SYNC_PTR in
+ * use, a playback commit only reaches the kernel once defer_appl frames
+ * have accumulated, or when the data the kernel knows about runs low.
+ * The check uses the hw_ptr of the last sync, which only moves forward,
+ * hence the margin of twice the granularity.
+ */
+static snd_pcm_uframes_t defer_appl_size(snd_pcm_t *pcm)
+{
+	snd_pcm_hw_t *hw = pcm->private_data;
+
+	if (!hw->defer_appl || !hw->sync_ptr ||
+	    pcm->stream != SND_PCM_STREAM_PLAYBACK)
+		return 0;
+	return hw->defer_appl < pcm->period_size ?
+		hw->defer_appl : pcm->period_size;
+}
+
+static int defer_appl_ok(snd_pcm_t *pcm, snd_pcm_uframes_t size)
+{
+	snd_pcm_hw_t *hw = pcm->private_data;
+	snd_pcm_sframes_t queued;
+
+	if (hw->appl_pending >= size ||
+	    FAST_PCM_STATE(hw) != SNDRV_PCM_STATE_RUNNING)
+		return 0;
+	queued = snd_pcm_mmap_playback_hw_avail(pcm) - hw->appl_pending;
+	return queued >= (snd_pcm_sframes_t)(2 * size);
+}
+
+/* push out the deferred appl_ptr before the kernel acts on it */
+static inline int flush_appl(snd_pcm_hw_t *hw)
+{
+	return hw->appl_pending ? sync_ptr1(hw, 0) : 0;
+}
+
+/*
+ * In fast_ptr mode the mmapped status page is trusted while the stream
+ * is running: hw_ptr there is refreshed by the driver on each period
+ * update, so HWSYNC and DELAY need no kernel round-trip.  Any other state
+ * goes to the kernel so that transitions and errors are still reported.
+ */
+static inline int hw_fast_ptr(snd_pcm_hw_t *hw)
+{
+	if (!hw->fast_ptr || hw->sync_ptr)
+		return 0;
+	if (FAST_PCM_STATE(hw) == SNDRV_PCM_STATE_RUNNING)
+		return 1;
+	hw->fast_ptr_synced++;
+	return 0;
+}
+
+static snd_pcm_sframes_t fast_ptr_delay(snd_pcm_t *pcm)
+{
+	snd_pcm_hw_t *hw = pcm->private_data;
+	snd_pcm_sframes_t delay = snd_pcm_mmap_delay(pcm);
+	snd_htimestamp_t now, tstamp;
+	long long elapsed;
+	snd_pcm_sframes_t frames;
+
+	/* the driver stamps the status page only with tstamp mode enabled */
+	if (pcm->tstamp_mode != SND_PCM_TSTAMP_ENABLE)
+		return delay;
+	tstamp = snd_pcm_hw_fast_tstamp(pcm);
+	gettimestamp(&now, pcm->tstamp_type);
+	elapsed = (now.tv_sec - tstamp.tv_sec) * 1000000000LL +
+		(now.tv_nsec - tstamp.tv_nsec);
+	if (elapsed <= 0)
+		return delay;
+	frames = elapsed * pcm->rate / 1000000000LL;
+	/* hw_ptr cannot lag more than a period behind the hardware */
+	if ((snd_pcm_uframes_t)frames > pcm->period_size)
+		frames = pcm->period_size;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		delay -= frames;
+		if (delay < 0)
+			delay = 0;
+	} else
+		delay += frames;
+	return delay;
+}
+
 static int snd_pcm_hw_clear_timer_queue(snd_pcm_hw_t *hw)
 {
 	if (hw->period_timer_need_poll) {
@@ -514,6 +611,7 @@ static int snd_pcm_hw_channel_info(snd_pcm_t *pcm, snd_pcm_channel_info_t * info
 	info->type = SND_PCM_AREA_MMAP;
 	info->u.mmap.fd = fd;
 	info->u.mmap.offset = i.offset;
+	info->u.mmap.memfd = 0;
 	return 0;
 }
 
@@ -554,6 +652,14 @@ static int snd_pcm_hw_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
+	if (hw_fast_ptr(hw)) {
+		hw->fast_ptr_saved++;
+		*delayp = fast_ptr_delay(pcm);
+		return 0;
+	}
+	err = flush_appl(hw);
+	if (err < 0)
+		return err;
 	if (ioctl(fd, SNDRV_PCM_IOCTL_DELAY, delayp) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_DELAY failed (%i)", err);
@@ -566,6 +672,10 @@ static int snd_pcm_hw_hwsync(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int fd = hw->fd, err;
+	if (hw_fast_ptr(hw)) {
+		hw->fast_ptr_saved++;
+		return 0;
+	}
 	if (SNDRV_PROTOCOL_VERSION(2, 0, 3) <= hw->version) {
 		if (hw->sync_ptr) {
 			err = sync_ptr1(hw, SNDRV_PCM_SYNC_PTR_HWSYNC);
@@ -656,6 +766,9 @@ static int snd_pcm_hw_drain(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	err = flush_appl(hw);
+	if (err < 0)
+		return err;
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_DRAIN) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_DRAIN failed (%i)", err);
@@ -668,6 +781,9 @@ static int snd_pcm_hw_pause(snd_pcm_t *pcm, int enable)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	err = flush_appl(hw);
+	if (err < 0)
+		return err;
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_PAUSE, enable) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_PAUSE failed (%i)", err);
@@ -685,6 +801,9 @@ static snd_pcm_sframes_t snd_pcm_hw_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t fra
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	err = flush_appl(hw);
+	if (err < 0)
+		return err;
 	if (ioctl(hw->fd, SNDRV_PCM_IOCTL_REWIND, &frames) < 0) {
 		err = -errno;
 		SYSMSG("SNDRV_PCM_IOCTL_REWIND failed (%i)", err);
@@ -705,6 +824,9 @@ static snd_pcm_sframes_t snd_pcm_hw_forward(snd_pcm_t *pcm, snd_pcm_uframes_t fr
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	int err;
+	err = flush_appl(hw);
+	if (err < 0)
+		return err;
 	if (SNDRV_PROTOCOL_VERSION(2, 0, 4) <= hw->version) {
 		if (ioctl(hw->fd, SNDRV_PCM_IOCTL_FORWARD, &frames) < 0) {
 			err = -errno;
@@ -807,6 +929,9 @@ static snd_pcm_sframes_t snd_pcm_hw_writei(snd_pcm_t *pcm, const void *buffer, s
 	xferi.buf = (char*) buffer;
 	xferi.frames = size;
 	xferi.result = 0; /* make valgrind happy */
+	err = flush_appl(hw);
+	if (err < 0)
+		return snd_pcm_check_error(pcm, err);
 	err = ioctl(fd, SNDRV_PCM_IOCTL_WRITEI_FRAMES, &xferi);
 	err = err >= 0 ? sync_ptr(hw, SNDRV_PCM_SYNC_PTR_APPL) : -errno;
 #ifdef DEBUG_RW
@@ -826,6 +951,9 @@ static snd_pcm_sframes_t snd_pcm_hw_writen(snd_pcm_t *pcm, void **bufs, snd_pcm_
 	memset(&xfern, 0, sizeof(xfern)); /* make valgrind happy */
 	xfern.bufs = bufs;
 	xfern.frames = size;
+	err = flush_appl(hw);
+	if (err < 0)
+		return snd_pcm_check_error(pcm, err);
 	err = ioctl(fd, SNDRV_PCM_IOCTL_WRITEN_FRAMES, &xfern);
 	err = err >= 0 ? sync_ptr(hw, SNDRV_PCM_SYNC_PTR_APPL) : -errno;
 #ifdef DEBUG_RW
@@ -993,8 +1121,16 @@ static snd_pcm_sframes_t snd_pcm_hw_mmap_commit(snd_pcm_t *pcm,
 						snd_pcm_uframes_t size)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
+	snd_pcm_uframes_t defer = defer_appl_size(pcm);
 
 	snd_pcm_mmap_appl_forward(pcm, size);
+	if (defer) {
+		hw->appl_pending += size;
+		if (defer_appl_ok(pcm, defer)) {
+			hw->defer_saved++;
+			return size;
+		}
+	}
 	sync_ptr(hw, 0);
 #ifdef DEBUG_MMAP
 	fprintf(stderr, "appl_forward: hw_ptr = %li, appl_ptr = %li, size = %li\n", *pcm->hw.ptr, *pcm->appl.ptr, size);
@@ -1002,12 +1138,18 @@ static snd_pcm_sframes_t snd_pcm_hw_mmap_commit(snd_pcm_t *pcm,
 	return size;
 }
 
-static snd_pcm_sframes_t snd_pcm_hw_avail_update(snd_pcm_t *pcm)
+static snd_pcm_sframes_t hw_avail_update(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
-	snd_pcm_uframes_t avail;
+	snd_pcm_uframes_t avail, defer = defer_appl_size(pcm);
 
-	sync_ptr(hw, 0);
+	/* with enough room known already, the refresh can wait as well */
+	if (defer && hw->appl_pending &&
+	    snd_pcm_mmap_avail(pcm) >= pcm->avail_min &&
+	    defer_appl_ok(pcm, defer))
+		hw->defer_saved++;
+	else
+		sync_ptr(hw, 0);
 	avail = snd_pcm_mmap_avail(pcm);
 	switch (FAST_PCM_STATE(hw)) {
 	case SNDRV_PCM_STATE_RUNNING:
@@ -1029,6 +1171,14 @@ static snd_pcm_sframes_t snd_pcm_hw_avail_update(snd_pcm_t *pcm)
 	return avail;
 }
 
+static snd_pcm_sframes_t snd_pcm_hw_avail_update(snd_pcm_t *pcm)
+{
+	snd_pcm_sframes_t avail = hw_avail_update(pcm);
+
+	snd_pcm_trace(pcm, SND_PCM_TRACE_HW_AVAIL_UPDATE, avail);
+	return avail;
+}
+
 static int snd_pcm_hw_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail,
 				 snd_htimestamp_t *tstamp)
 {
@@ -1049,6 +1199,28 @@ static int snd_pcm_hw_htimestamp(snd_pcm_t *pcm, snd_pcm_uframes_t *avail,
 	return 0;
 }
 
+/*
+ * one STATUS ioctl refreshes the hw_ptr and returns everything else from
+ * the same update; only the cached copy of the pointers needs to follow
+ */
+static int snd_pcm_hw_avail_status(snd_pcm_t *pcm, snd_pcm_status_t *status)
+{
+	snd_pcm_hw_t *hw = pcm->private_data;
+	int err;
+
+	err = flush_appl(hw);
+	if (err < 0)
+		return err;
+	err = snd_pcm_hw_status(pcm, status);
+	if (err < 0)
+		return err;
+	if (hw->sync_ptr) {
+		hw->sync_ptr->s.status.state = status->state;
+		hw->sync_ptr->s.status.hw_ptr = status->hw_ptr;
+	}
+	return 0;
+}
+
 static void __fill_chmap_ctl_id(snd_ctl_elem_id_t *id, int dev, int subdev,
 				int stream)
 {
@@ -1073,41 +1245,17 @@ static int is_chmap_type(int type)
 		type <= SND_CTL_TLVT_CHMAP_PAIRED);
 }
 
-/**
- * \!brief Query the available channel maps
- * \param card the card number
- * \param dev the PCM device number
- * \param subdev the PCM substream index
- * \param stream the direction of PCM stream
- * \return the NULL-terminated array of integer pointers, or NULL at error.
- *
- * This function works like snd_pcm_query_chmaps() but it takes the card,
- * device, substream and stream numbers instead of the already opened
- * snd_pcm_t instance, so that you can query available channel maps of
- * a PCM before actually opening it.
- *
- * As the parameters stand, the query is performed only to the hw PCM
- * devices, not the abstracted PCM object in alsa-lib.
- */
-snd_pcm_chmap_query_t **
-snd_pcm_query_chmaps_from_hw(int card, int dev, int subdev,
-			     snd_pcm_stream_t stream)
+/* read and parse the channel map TLV, NULL at error */
+static snd_pcm_chmap_query_t **chmap_read_tlv(snd_ctl_t *ctl, int dev,
+					       int subdev, int stream)
 {
-	snd_ctl_t *ctl;
 	snd_ctl_elem_id_t id = {0};
 	unsigned int tlv[2048], *start;
 	snd_pcm_chmap_query_t **map;
 	int i, ret, nums;
 
-	ret = snd_ctl_hw_open(&ctl, NULL, card, 0);
-	if (ret < 0) {
-		SYSMSG("Cannot open the associated CTL\n");
-		return NULL;
-	}
-
 	__fill_chmap_ctl_id(&id, dev, subdev, stream);
 	ret = snd_ctl_elem_tlv_read(ctl, &id, tlv, sizeof(tlv));
-	snd_ctl_close(ctl);
 	if (ret < 0) {
 		SYSMSG("Cannot read Channel Map TLV\n");
 		return NULL;
@@ -1160,6 +1308,243 @@ snd_pcm_query_chmaps_from_hw(int card, int dev, int subdev,
 	return map;
 }
 
+/*
+ * Process wide cache of the channel map queries
+ *
+ * The TLVs of the channel map controls only change together with the
+ * elements of the PCM interface, e.g. when an HDMI sink is plugged and
+ * the driver updates its ELD.  The parsed queries are kept per card
+ * along with a control handle subscribed to the events of the card; the
+ * queued events are drained before each lookup, and any event of a PCM
+ * interface element or the removal of all elements drops the queries of
+ * the card.  A cached query then costs one read of the empty event
+ * queue, the failed queries of devices without channel maps included.
+ * The handle of the cache serves the reads and writes of the current
+ * maps too, those are not cached: the drivers change them with the
+ * stream setup without an event.  After fork() the event queue of the
+ * handle is shared with the parent, so a child process drops the caches
+ * it inherited and subscribes with its own handle.
+ *
+ * Setting LIBASOUND_CHMAP_CACHE=0 in the environment disables the cache.
+ */
+
+#define CHMAP_CACHE_EVENTS	32
+
+struct chmap_cache_entry {
+	struct chmap_cache_entry *next;
+	int dev;
+	int subdev;
+	int stream;
+	snd_pcm_chmap_query_t **maps;	/* NULL when the query failed */
+};
+
+struct chmap_cache {
+	struct chmap_cache *next;
+	int card;
+	snd_ctl_t *ctl;			/* subscribed to the card events */
+	pid_t pid;			/* process which subscribed ctl */
+	struct chmap_cache_entry *entries;
+};
+
+static struct chmap_cache *chmap_cache_list;
+
+#ifdef THREAD_SAFE_API
+static pthread_mutex_t chmap_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static inline void chmap_cache_lock(void)
+{
+	pthread_mutex_lock(&chmap_cache_mutex);
+}
+static inline void chmap_cache_unlock(void)
+{
+	pthread_mutex_unlock(&chmap_cache_mutex);
+}
+#else
+static inline void chmap_cache_lock(void) {}
+static inline void chmap_cache_unlock(void) {}
+#endif
+
+static void chmap_cache_flush(struct chmap_cache *cache)
+{
+	struct chmap_cache_entry *e, *next;
+
+	for (e = cache->entries; e; e = next) {
+		next = e->next;
+		snd_pcm_free_chmaps(e->maps);
+		free(e);
+	}
+	cache->entries = NULL;
+}
+
+/* apply the queued events of the card, called with the lock held */
+static int chmap_cache_drain(struct chmap_cache *cache)
+{
+	snd_ctl_event_t events[CHMAP_CACHE_EVENTS];
+	int i, res;
+
+	while ((res = cache->ctl->ops->read_many(cache->ctl, events,
+						 CHMAP_CACHE_EVENTS)) > 0) {
+		for (i = 0; i < res; i++) {
+			if (events[i].type != SND_CTL_EVENT_ELEM)
+				continue;
+			if (events[i].data.elem.id.iface == SNDRV_CTL_ELEM_IFACE_PCM ||
+			    events[i].data.elem.mask == SNDRV_CTL_EVENT_MASK_REMOVE)
+				chmap_cache_flush(cache);
+		}
+	}
+	return res == -EAGAIN ? 0 : res;
+}
+
+/*
+ * Get the cache of a card, called with the lock held.  NULL is returned
+ * when the cache is disabled or the card cannot be opened.
+ */
+static struct chmap_cache *chmap_cache_get(int card)
+{
+	static int enabled = -1;
+	struct chmap_cache *cache, **p;
+	int err;
+
+	if (enabled < 0) {
+		char *env = getenv("LIBASOUND_CHMAP_CACHE");
+		enabled = !env || *env != '0';
+	}
+	if (!enabled)
+		return NULL;
+	for (p = &chmap_cache_list; (cache = *p) != NULL; p = &cache->next) {
+		if (cache->card != card)
+			continue;
+		/* the card went away or the queue is the parent's, start over */
+		if (cache->pid == getpid() && chmap_cache_drain(cache) >= 0)
+			return cache;
+		*p = cache->next;
+		chmap_cache_flush(cache);
+		snd_ctl_close(cache->ctl);
+		free(cache);
+		break;
+	}
+	cache = calloc(1, sizeof(*cache));
+	if (!cache)
+		return NULL;
+	err = snd_ctl_hw_open(&cache->ctl, "hw", card, SND_CTL_NONBLOCK);
+	if (err >= 0) {
+		err = snd_ctl_subscribe_events(cache->ctl, 1);
+		if (err < 0)
+			snd_ctl_close(cache->ctl);
+	}
+	if (err < 0) {
+		free(cache);
+		return NULL;
+	}
+	cache->card = card;
+	cache->pid = getpid();
+	cache->next = chmap_cache_list;
+	chmap_cache_list = cache;
+	return cache;
+}
+
+/*
+ * Read or write a channel map control of a card.  *no_ctl is set when
+ * the card cannot be opened.
+ */
+static int chmap_ctl_elem(int card, snd_ctl_elem_value_t *val, int write,
+			  int *no_ctl)
+{
+	struct chmap_cache *cache;
+	snd_ctl_t *ctl;
+	int ret;
+
+	*no_ctl = 0;
+	chmap_cache_lock();
+	cache = chmap_cache_get(card);
+	if (cache) {
+		if (write)
+			ret = snd_ctl_elem_write(cache->ctl, val);
+		else
+			ret = snd_ctl_elem_read(cache->ctl, val);
+		chmap_cache_unlock();
+		return ret;
+	}
+	chmap_cache_unlock();
+	ret = snd_ctl_hw_open(&ctl, NULL, card, 0);
+	if (ret < 0) {
+		SYSMSG("Cannot open the associated CTL\n");
+		*no_ctl = 1;
+		return ret;
+	}
+	if (write)
+		ret = snd_ctl_elem_write(ctl, val);
+	else
+		ret = snd_ctl_elem_read(ctl, val);
+	snd_ctl_close(ctl);
+	return ret;
+}
+
+/**
+ * \!brief Query the available channel maps
+ * \param card the card number
+ * \param dev the PCM device number
+ * \param subdev the PCM substream index
+ * \param stream the direction of PCM stream
+ * \return the NULL-terminated array of integer pointers, or NULL at error.
+ *
+ * This function works like snd_pcm_query_chmaps() but it takes the card,
+ * device, substream and stream numbers instead of the already opened
+ * snd_pcm_t instance, so that you can query available channel maps of
+ * a PCM before actually opening it.
+ *
+ * As the parameters stand, the query is performed only to the hw PCM
+ * devices, not the abstracted PCM object in alsa-lib.
+ *
+ * The results are cached per card until a control event of the card
+ * may have changed them.
+ */
+snd_pcm_chmap_query_t **
+snd_pcm_query_chmaps_from_hw(int card, int dev, int subdev,
+			     snd_pcm_stream_t stream)
+{
+	struct chmap_cache *cache;
+	struct chmap_cache_entry *e;
+	snd_pcm_chmap_query_t **map;
+	snd_ctl_t *ctl;
+	int ret;
+
+	chmap_cache_lock();
+	cache = chmap_cache_get(card);
+	if (cache) {
+		for (e = cache->entries; e; e = e->next) {
+			if (e->dev == dev && e->subdev == subdev &&
+			    e->stream == (int)stream)
+				break;
+		}
+		if (!e) {
+			e = calloc(1, sizeof(*e));
+			if (!e) {
+				chmap_cache_unlock();
+				return NULL;
+			}
+			e->dev = dev;
+			e->subdev = subdev;
+			e->stream = stream;
+			e->maps = chmap_read_tlv(cache->ctl, dev, subdev, stream);
+			e->next = cache->entries;
+			cache->entries = e;
+		}
+		map = e->maps ? _snd_pcm_copy_chmap_query(e->maps) : NULL;
+		chmap_cache_unlock();
+		return map;
+	}
+	chmap_cache_unlock();
+
+	ret = snd_ctl_hw_open(&ctl, NULL, card, 0);
+	if (ret < 0) {
+		SYSMSG("Cannot open the associated CTL\n");
+		return NULL;
+	}
+	map = chmap_read_tlv(ctl, dev, subdev, stream);
+	snd_ctl_close(ctl);
+	return map;
+}
+
 enum { CHMAP_CTL_QUERY, CHMAP_CTL_GET, CHMAP_CTL_SET };
 
 static int chmap_caps(snd_pcm_hw_t *hw, int type)
@@ -1205,11 +1590,10 @@ static snd_pcm_chmap_t *snd_pcm_hw_get_chmap(snd_pcm_t *pcm)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
 	snd_pcm_chmap_t *map;
-	snd_ctl_t *ctl;
 	snd_ctl_elem_id_t id = {0};
 	snd_ctl_elem_value_t val = {0};
 	unsigned int i;
-	int ret;
+	int ret, no_ctl;
 
 	if (hw->chmap_override)
 		return _snd_pcm_choose_fixed_chmap(pcm, hw->chmap_override);
@@ -1234,20 +1618,13 @@ static snd_pcm_chmap_t *snd_pcm_hw_get_chmap(snd_pcm_t *pcm)
 	if (!map)
 		return NULL;
 	map->channels = pcm->channels;
-	ret = snd_ctl_hw_open(&ctl, NULL, hw->card, 0);
-	if (ret < 0) {
-		free(map);
-		SYSMSG("Cannot open the associated CTL\n");
-		chmap_caps_set_error(hw, CHMAP_CTL_GET);
-		return NULL;
-	}
 	fill_chmap_ctl_id(pcm, &id);
 	snd_ctl_elem_value_set_id(&val, &id);
-	ret = snd_ctl_elem_read(ctl, &val);
-	snd_ctl_close(ctl);
+	ret = chmap_ctl_elem(hw->card, &val, 0, &no_ctl);
 	if (ret < 0) {
 		free(map);
-		SYSMSG("Cannot read Channel Map ctl\n");
+		if (!no_ctl)
+			SYSMSG("Cannot read Channel Map ctl\n");
 		chmap_caps_set_error(hw, CHMAP_CTL_GET);
 		return NULL;
 	}
@@ -1260,11 +1637,10 @@ static snd_pcm_chmap_t *snd_pcm_hw_get_chmap(snd_pcm_t *pcm)
 static int snd_pcm_hw_set_chmap(snd_pcm_t *pcm, const snd_pcm_chmap_t *map)
 {
 	snd_pcm_hw_t *hw = pcm->private_data;
-	snd_ctl_t *ctl;
 	snd_ctl_elem_id_t id = {0};
 	snd_ctl_elem_value_t val = {0};
 	unsigned int i;
-	int ret;
+	int ret, no_ctl;
 
 	if (hw->chmap_override)
 		return -ENXIO;
@@ -1281,19 +1657,15 @@ static int snd_pcm_hw_set_chmap(snd_pcm_t *pcm, const snd_pcm_chmap_t *map)
 		       snd_pcm_state_name(FAST_PCM_STATE(hw)));
 		return -EBADFD;
 	}
-	ret = snd_ctl_hw_open(&ctl, NULL, hw->card, 0);
-	if (ret < 0) {
-		SYSMSG("Cannot open the associated CTL\n");
-		chmap_caps_set_error(hw, CHMAP_CTL_SET);
-		return ret;
-	}
-
 	fill_chmap_ctl_id(pcm, &id);
 	snd_ctl_elem_value_set_id(&val, &id);
 	for (i = 0; i < map->channels; i++)
 		snd_ctl_elem_value_set_integer(&val, i, map->pos[i]);
-	ret = snd_ctl_elem_write(ctl, &val);
-	snd_ctl_close(ctl);
+	ret = chmap_ctl_elem(hw->card, &val, 1, &no_ctl);
+	if (no_ctl) {
+		chmap_caps_set_error(hw, CHMAP_CTL_SET);
+		return ret;
+	}
 	if (ret >= 0)
 		chmap_caps_set_ok(hw, CHMAP_CTL_SET);
 	else if (ret == -ENOENT || ret == -EPERM || ret == -ENXIO) {
@@ -1323,6 +1695,16 @@ static void snd_pcm_hw_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "  appl_ptr     : %li\n", hw->mmap_control->appl_ptr);
 		snd_output_printf(out, "  hw_ptr       : %li\n", hw->mmap_status->hw_ptr);
 	}
+	if (hw->fast_ptr) {
+		snd_output_printf(out, "  fast_ptr     : %s\n",
+				  hw->sync_ptr ? "unavailable (no status mmap)" : "on");
+		snd_output_printf(out, "  ioctls saved : %lu\n", hw->fast_ptr_saved);
+		snd_output_printf(out, "  ioctls issued: %lu\n", hw->fast_ptr_synced);
+	}
+	if (hw->defer_appl) {
+		snd_output_printf(out, "  defer_appl   : %lu frames\n", hw->defer_appl);
+		snd_output_printf(out, "  syncs saved  : %lu\n", hw->defer_saved);
+	}
 }
 
 static const snd_pcm_ops_t snd_pcm_hw_ops = {
@@ -1369,6 +1751,7 @@ static const snd_pcm_fast_ops_t snd_pcm_hw_fast_ops = {
 	.avail_update = snd_pcm_hw_avail_update,
 	.mmap_commit = snd_pcm_hw_mmap_commit,
 	.htimestamp = snd_pcm_hw_htimestamp,
+	.avail_status = snd_pcm_hw_avail_status,
 	.poll_descriptors = NULL,
 	.poll_descriptors_count = NULL,
 	.poll_revents = NULL,
@@ -1400,6 +1783,7 @@ static const snd_pcm_fast_ops_t snd_pcm_hw_fast_ops_timer = {
 	.avail_update = snd_pcm_hw_avail_update,
 	.mmap_commit = snd_pcm_hw_mmap_commit,
 	.htimestamp = snd_pcm_hw_htimestamp,
+	.avail_status = snd_pcm_hw_avail_status,
 	.poll_descriptors = snd_pcm_hw_poll_descriptors,
 	.poll_descriptors_count = snd_pcm_hw_poll_descriptors_count,
 	.poll_revents = snd_pcm_hw_poll_revents,
@@ -1514,7 +1898,8 @@ int snd_pcm_hw_open_fd(snd_pcm_t **pcmp, const char *name,
 	pcm->poll_events = info.stream == SND_PCM_STREAM_PLAYBACK ? POLLOUT : POLLIN;
 	pcm->tstamp_type = tstamp_type;
 #ifdef THREAD_SAFE_API
-	pcm->thread_safe = 1;
+	if (pcm->thread_safe >= 0)
+		pcm->thread_safe = 1; /* the kernel serializes the ioctls */
 #endif
 
 	ret = snd_pcm_hw_mmap_status(pcm);
@@ -1614,7 +1999,12 @@ int snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 		}
 	}
 	snd_ctl_close(ctl);
-	return snd_pcm_hw_open_fd(pcmp, name, fd, 0, sync_ptr_ioctl);
+	ret = snd_pcm_hw_open_fd(pcmp, name, fd, 0, sync_ptr_ioctl);
+#ifdef THREAD_SAFE_API
+	if (ret >= 0 && (mode & SND_PCM_NO_THREAD_SAFE))
+		(*pcmp)->thread_safe = -1;
+#endif
+	return ret;
        _err:
 	snd_ctl_close(ctl);
 	return ret;
@@ -1634,6 +2024,23 @@ changed by this option.  This influences only on the blocking behavior at
 opening the device.  If you would like to keep the compatibility with the
 older ALSA stuff, turn this option off.
 
+The fast_ptr option answers hwsync and delay requests of a running stream
+from the mmapped status page without entering the kernel.  The position is
+then only as fresh as the last period update of the driver; the delay is
+extrapolated from the status timestamp when the timestamp mode is enabled.
+The ioctls are still issued in any state other than running, and when the
+status page cannot be mmapped the option has no effect.  The counts of the
+saved and issued ioctls are shown by snd_pcm_dump().
+
+The defer_appl_ptr option batches the SYNC_PTR ioctls of a playback stream
+which commits in small chunks through mmap, when the control page cannot be
+mmapped (e.g. with sync_ptr_ioctl set).  The application pointer is then
+published after the given number of frames, at most one period, or earlier
+when less than twice that amount is known to be queued in the kernel.  The
+pointer is always published before drain, pause, rewind, forward, delay and
+read/write.  With a mmapped control page the pointer is visible to the
+kernel without any ioctl and the option has no effect.
+
 \code
 pcm.name {
 	type hw			# Kernel PCM
@@ -1641,6 +2048,8 @@ pcm.name {
 	[device INT]		# Device number (default 0)
 	[subdevice INT]		# Subdevice number (default -1: first available)
 	[sync_ptr_ioctl BOOL]	# Use SYNC_PTR ioctl rather than the direct mmap access for control structures
+	[fast_ptr BOOL]		# Serve hwsync and delay from the status page while running
+	[defer_appl_ptr INT]	# Publish appl_ptr only every INT frames (0 = off)
 	[nonblock BOOL]		# Force non-blocking open mode
 	[format STR]		# Restrict only to the given format
 	[channels INT]		# Restrict only to the given channels
@@ -1677,7 +2086,8 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 	snd_config_iterator_t i, next;
 	long card = -1, device = 0, subdevice = -1;
 	const char *str;
-	int err, sync_ptr_ioctl = 0;
+	int err, sync_ptr_ioctl = 0, fast_ptr = 0;
+	long defer_appl = 0;
 	int rate = 0, channels = 0;
 	snd_pcm_format_t format = SND_PCM_FORMAT_UNKNOWN;
 	snd_config_t *n;
@@ -1739,6 +2149,24 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 			sync_ptr_ioctl = err;
 			continue;
 		}
+		if (strcmp(id, "fast_ptr") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				goto fail;
+			}
+			fast_ptr = err;
+			continue;
+		}
+		if (strcmp(id, "defer_appl_ptr") == 0) {
+			err = snd_config_get_integer(n, &defer_appl);
+			if (err < 0 || defer_appl < 0) {
+				SNDERR("Invalid value for %s", id);
+				err = -EINVAL;
+				goto fail;
+			}
+			continue;
+		}
 		if (strcmp(id, "nonblock") == 0) {
 			err = snd_config_get_bool(n);
 			if (err < 0)
@@ -1809,7 +2237,9 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 		(*pcmp)->mode |= mode & (SND_PCM_NO_AUTO_RESAMPLE|
 					 SND_PCM_NO_AUTO_CHANNELS|
 					 SND_PCM_NO_AUTO_FORMAT|
-					 SND_PCM_NO_SOFTVOL);
+					 SND_PCM_NO_SOFTVOL|
+					 SND_PCM_NO_THREAD_SAFE|
+					 SND_PCM_LOCK_BUFFERS);
 
 	hw = (*pcmp)->private_data;
 	if (format != SND_PCM_FORMAT_UNKNOWN)
@@ -1820,6 +2250,8 @@ int _snd_pcm_hw_open(snd_pcm_t **pcmp, const char *name,
 		hw->rate = rate;
 	if (chmap)
 		hw->chmap_override = chmap;
+	hw->fast_ptr = fast_ptr;
+	hw->defer_appl = defer_appl;
 
 	return 0;
 
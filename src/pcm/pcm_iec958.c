@@ -62,6 +62,7 @@ struct snd_pcm_iec958 {
 	unsigned char status[24];
 	unsigned int byteswap;
 	unsigned char preamble[3];	/* B/M/W or Z/X/Y */
+	u_int32_t block[2][192];	/* status, its parity and preamble */
 	snd_pcm_fast_ops_t fops;
 };
 
@@ -70,23 +71,22 @@ enum { PREAMBLE_Z, PREAMBLE_X, PREAMBLE_Y };
 #endif /* DOC_HIDDEN */
 
 /*
- * Determine parity for time slots 4 upto 30
- * to be sure that bit 4 upt 31 will carry
- * an even number of ones and zeros.
+ * Precompute the constant part of the subframes of one block of
+ * 192 frames: the channel status bit (time slot 30), the parity it
+ * contributes and the preamble, for the first and the other sub frames.
  */
-static unsigned int iec958_parity(unsigned int data)
+static void iec958_build_block(snd_pcm_iec958_t *iec)
 {
-	unsigned int parity;
-	int bit;
-
-	data >>= 4;     /* start from bit 4 */
-	parity = 0;
-	for (bit = 4; bit <= 30; bit++) {
-		if (data & 1)
-			parity++;
-		data >>= 1;
+	unsigned int counter;
+
+	for (counter = 0; counter < 192; counter++) {
+		u_int32_t bits = 0;
+		if (iec->status[counter >> 3] & (1 << (counter & 7)))
+			bits = 0xc0000000;
+		iec->block[0][counter] = bits |
+			iec->preamble[counter ? PREAMBLE_X : PREAMBLE_Z];
+		iec->block[1][counter] = bits | iec->preamble[PREAMBLE_Y];
 	}
-	return (parity & 1);
 }
 
 /*
@@ -104,27 +104,13 @@ static unsigned int iec958_parity(unsigned int data)
 
 static inline u_int32_t iec958_subframe(snd_pcm_iec958_t *iec, u_int32_t data, int channel)
 {
-	unsigned int byte = iec->counter >> 3;
-	unsigned int mask = 1 << (iec->counter - (byte << 3));
-
 	/* bit 4-27 */
 	data >>= 4;
 	data &= ~0xf;
 
-	/* set IEC status bits (up to 192 bits) */
-	if (iec->status[byte] & mask)
-		data |= 0x40000000;
-
-	if (iec958_parity(data))	/* parity bit 4-30 */
-		data |= 0x80000000;
-
-	/* Preamble */
-	if (channel)
-		data |= iec->preamble[PREAMBLE_Y];	/* odd sub frame, 'Y' */
-	else if (! iec->counter)
-		data |= iec->preamble[PREAMBLE_Z];	/* Block start, 'Z' */
-	else
-		data |= iec->preamble[PREAMBLE_X];	/* even sub frame, 'X' */
+	/* status and preamble from the block table, parity bit 4-30 */
+	data = (data | iec->block[channel != 0][iec->counter]) ^
+	       ((u_int32_t)__builtin_parity(data) << 31);
 
 	if (iec->byteswap)
 		data = bswap_32(data);
@@ -179,6 +165,41 @@ static void snd_pcm_iec958_decode(snd_pcm_iec958_t *iec,
 	}
 }
 
+/* CPU endian S32 with both sides interleaved, one pass over the frames */
+static int iec958_encode_s32(snd_pcm_iec958_t *iec,
+			     const snd_pcm_channel_area_t *dst_areas,
+			     snd_pcm_uframes_t dst_offset,
+			     const snd_pcm_channel_area_t *src_areas,
+			     snd_pcm_uframes_t src_offset,
+			     unsigned int channels, snd_pcm_uframes_t frames)
+{
+	const u_int32_t *src;
+	u_int32_t *dst;
+	unsigned int channel, counter = iec->counter;
+
+	if (!snd_pcm_areas_interleaved(src_areas, channels, 32) ||
+	    !snd_pcm_areas_interleaved(dst_areas, channels, 32))
+		return 0;
+	src = snd_pcm_channel_area_addr(src_areas, src_offset);
+	dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+	while (frames-- > 0) {
+		const u_int32_t first = iec->block[0][counter];
+		const u_int32_t other = iec->block[1][counter];
+		for (channel = 0; channel < channels; channel++) {
+			u_int32_t data = (*src++ >> 4) & ~0xf;
+			data = (data | (channel ? other : first)) ^
+			       ((u_int32_t)__builtin_parity(data) << 31);
+			if (iec->byteswap)
+				data = bswap_32(data);
+			*dst++ = data;
+		}
+		if (++counter == 192)
+			counter = 0;
+	}
+	iec->counter = counter;
+	return 1;
+}
+
 static void snd_pcm_iec958_encode(snd_pcm_iec958_t *iec,
 				  const snd_pcm_channel_area_t *dst_areas,
 				  snd_pcm_uframes_t dst_offset,
@@ -193,6 +214,10 @@ static void snd_pcm_iec958_encode(snd_pcm_iec958_t *iec,
 	unsigned int channel;
 	int32_t sample = 0;
 	int counter = iec->counter;
+	if (iec->getput_idx == snd_pcm_linear_get_index(SND_PCM_FORMAT_S32, SND_PCM_FORMAT_S32) &&
+	    iec958_encode_s32(iec, dst_areas, dst_offset, src_areas, src_offset,
+			      channels, frames))
+		return;
 	for (channel = 0; channel < channels; ++channel) {
 		const char *src;
 		u_int32_t *dst;
@@ -518,6 +543,7 @@ int snd_pcm_iec958_open(snd_pcm_t **pcmp, const char *name, snd_pcm_format_t sfo
 		memcpy(iec->status, default_status_bits, sizeof(default_status_bits));
 
 	memcpy(iec->preamble, preamble_vals, 3);
+	iec958_build_block(iec);
 
 	err = snd_pcm_new(&pcm, SND_PCM_TYPE_IEC958, name, slave->stream, slave->mode);
 	if (err < 0) {
@@ -54,7 +54,12 @@ static void snd_pcm_ioplug_hw_ptr_update(snd_pcm_t *pcm)
 	ioplug_priv_t *io = pcm->private_data;
 	snd_pcm_sframes_t hw;
 
-	hw = io->data->callback->pointer(io->data);
+	if (io->data->version >= 0x010003 && io->data->hw_pos)
+		hw = *io->data->hw_pos;
+	else if (io->data->callback->pointer)
+		hw = io->data->callback->pointer(io->data);
+	else
+		hw = -EIO;
 	if (hw >= 0) {
 		unsigned int delta;
 		if ((unsigned int)hw >= io->last_hw)
@@ -83,6 +88,17 @@ static int snd_pcm_ioplug_info(snd_pcm_t *pcm, snd_pcm_info_t *info)
 
 static int snd_pcm_ioplug_channel_info(snd_pcm_t *pcm, snd_pcm_channel_info_t *info)
 {
+	ioplug_priv_t *io = pcm->private_data;
+
+	if (io->data->version >= 0x010003 && io->data->mmap_areas) {
+		/* the plugin's own buffer, no copy in between */
+		const snd_pcm_channel_area_t *a = &io->data->mmap_areas[info->channel];
+		info->addr = a->addr;
+		info->first = a->first;
+		info->step = a->step;
+		info->type = SND_PCM_AREA_EXTERN;
+		return 0;
+	}
 	return snd_pcm_channel_info_shm(pcm, info, -1);
 }
 
@@ -902,6 +918,18 @@ When poll_fd, poll_events and mmap_rw fields are changed after
 #snd_pcm_ioplug_create(), call #snd_pcm_ioplug_reinit_status() to
 reflect the changes.
 
+Since version 1.0.3, a plugin with its own ring buffer (a socket or
+Bluetooth backend, for example) can let the PCM use that buffer
+directly: the hw_params callback sets mmap_areas to the areas of a
+buffer of buffer_size frames, and the plugin sets mmap_rw.  The
+application then reads and writes the plugin's buffer, and there's
+no copy to a local buffer nor a transfer callback needed; the areas
+must stay valid until the hw_free or close callback.  The plugin may
+also set hw_pos to a position (0 ... buffer_size - 1, or a negative
+value for an xrun) which it updates as the data is consumed; the
+position is then read without calling the pointer callback, which
+can be left NULL.
+
 The driver can set an arbitrary value (pointer) to private_data
 field to refer its own data in the callbacks.
 
@@ -980,8 +1008,9 @@ int snd_pcm_ioplug_create(snd_pcm_ioplug_t *ioplug, const char *name,
 
 	assert(ioplug && ioplug->callback);
 	assert(ioplug->callback->start &&
-	       ioplug->callback->stop &&
-	       ioplug->callback->pointer);
+	       ioplug->callback->stop);
+	/* v1.0.3 plugins may publish hw_pos instead */
+	assert(ioplug->callback->pointer || ioplug->version >= 0x010003);
 
 	/* We support 1.0.0 to current */
 	if (ioplug->version < 0x010000 ||
@@ -35,8 +35,18 @@
 #include <dirent.h>
 #include <locale.h>
 #include <math.h>
+#include <sys/stat.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
+#ifdef THREAD_SAFE_API
+#include <signal.h>
+#include <semaphore.h>
+#define LADSPA_HAVE_WORKERS
+#endif
 
 #include "ladspa.h"
 
@@ -62,7 +72,20 @@ typedef struct {
 	struct list_head cplugins;
 	unsigned int channels;			/* forced input channels, 0 = auto */
 	unsigned int allocated;			/* count of allocated samples */
+	unsigned int block_size;		/* frames per run, 0 = auto */
 	LADSPA_Data *zero[2];			/* zero input or dummy output */
+	unsigned int threads;			/* caller + worker threads */
+	struct snd_pcm_ladspa_worker *workers;	/* threads - 1 workers */
+#ifdef LADSPA_HAVE_WORKERS
+	sem_t done;
+#endif
+	/* current job of the workers */
+	struct snd_pcm_ladspa_plugin *job_plugin;
+	const snd_pcm_channel_area_t *job_in_areas;
+	snd_pcm_uframes_t job_in_offset;
+	const snd_pcm_channel_area_t *job_out_areas;
+	snd_pcm_uframes_t job_out_offset;
+	unsigned long job_size;
 } snd_pcm_ladspa_t;
  
 typedef struct {
@@ -97,7 +120,7 @@ typedef struct {
 	LADSPA_Data *controls;			/* index = LADSPA control port index */
 } snd_pcm_ladspa_plugin_io_t;
 
-typedef struct {
+typedef struct snd_pcm_ladspa_plugin {
 	struct list_head list;
 	snd_pcm_ladspa_policy_t policy;
 	char *filename;
@@ -106,10 +129,165 @@ typedef struct {
 	snd_pcm_ladspa_plugin_io_t input;
 	snd_pcm_ladspa_plugin_io_t output;
 	struct list_head instances;		/* one LADSPA plugin might be used multiple times */
+	unsigned int instances_count;
 } snd_pcm_ladspa_plugin_t;
 
+typedef struct snd_pcm_ladspa_worker {
+	snd_pcm_ladspa_t *ladspa;
+	unsigned int index;			/* runs instances index, index + threads, ... */
+#ifdef LADSPA_HAVE_WORKERS
+	pthread_t thread;
+	sem_t go;
+#endif
+	int quit;
+} snd_pcm_ladspa_worker_t;
+
 #endif /* DOC_HIDDEN */
 
+static void snd_pcm_ladspa_run_instance(snd_pcm_ladspa_instance_t *instance,
+					const snd_pcm_channel_area_t *in_areas,
+					snd_pcm_uframes_t in_offset,
+					const snd_pcm_channel_area_t *out_areas,
+					snd_pcm_uframes_t out_offset,
+					unsigned long size)
+{
+	LADSPA_Data *data;
+	unsigned int idx, chn;
+
+	for (idx = 0; idx < instance->input.channels.size; idx++) {
+		chn = instance->input.channels.array[idx];
+		data = instance->input.data[idx];
+		if (data == NULL) {
+			data = (LADSPA_Data *)((char *)in_areas[chn].addr + (in_areas[chn].first / 8));
+			data += in_offset;
+		}
+		instance->desc->connect_port(instance->handle, instance->input.ports.array[idx], data);
+	}
+	for (idx = 0; idx < instance->output.channels.size; idx++) {
+		chn = instance->output.channels.array[idx];
+		data = instance->output.data[idx];
+		if (data == NULL) {
+			data = (LADSPA_Data *)((char *)out_areas[chn].addr + (out_areas[chn].first / 8));
+			data += out_offset;
+		}
+		instance->desc->connect_port(instance->handle, instance->output.ports.array[idx], data);
+	}
+	instance->desc->run(instance->handle, size);
+}
+
+/* run the instances of the current job which belong to the given thread */
+static void snd_pcm_ladspa_run_job(snd_pcm_ladspa_t *ladspa, unsigned int index)
+{
+	snd_pcm_ladspa_plugin_t *plugin = ladspa->job_plugin;
+	struct list_head *pos;
+	unsigned int idx = 0;
+
+	list_for_each(pos, &plugin->instances) {
+		if (idx++ % ladspa->threads != index)
+			continue;
+		snd_pcm_ladspa_run_instance(list_entry(pos, snd_pcm_ladspa_instance_t, list),
+					    ladspa->job_in_areas, ladspa->job_in_offset,
+					    ladspa->job_out_areas, ladspa->job_out_offset,
+					    ladspa->job_size);
+	}
+}
+
+#ifdef LADSPA_HAVE_WORKERS
+static void *snd_pcm_ladspa_worker(void *arg)
+{
+	snd_pcm_ladspa_worker_t *worker = arg;
+	snd_pcm_ladspa_t *ladspa = worker->ladspa;
+	sigset_t mask;
+
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+	for (;;) {
+		while (sem_wait(&worker->go) < 0 && errno == EINTR)
+			;
+		if (worker->quit)
+			break;
+		snd_pcm_ladspa_run_job(ladspa, worker->index);
+		sem_post(&ladspa->done);
+	}
+	return NULL;
+}
+
+static void snd_pcm_ladspa_stop_workers(snd_pcm_ladspa_t *ladspa)
+{
+	unsigned int i;
+
+	if (!ladspa->workers)
+		return;
+	for (i = 0; i < ladspa->threads - 1; i++) {
+		snd_pcm_ladspa_worker_t *worker = &ladspa->workers[i];
+		if (!worker->ladspa)
+			continue;
+		worker->quit = 1;
+		sem_post(&worker->go);
+		pthread_join(worker->thread, NULL);
+		sem_destroy(&worker->go);
+	}
+	sem_destroy(&ladspa->done);
+	free(ladspa->workers);
+	ladspa->workers = NULL;
+	ladspa->threads = 1;
+}
+
+static int snd_pcm_ladspa_start_workers(snd_pcm_ladspa_t *ladspa)
+{
+	unsigned int i;
+	int err;
+
+	if (ladspa->threads <= 1)
+		return 0;
+	ladspa->workers = calloc(ladspa->threads - 1, sizeof(*ladspa->workers));
+	if (!ladspa->workers)
+		return -ENOMEM;
+	sem_init(&ladspa->done, 0, 0);
+	for (i = 0; i < ladspa->threads - 1; i++) {
+		snd_pcm_ladspa_worker_t *worker = &ladspa->workers[i];
+		worker->ladspa = ladspa;
+		worker->index = i + 1;
+		sem_init(&worker->go, 0, 0);
+		err = snd_thread_create(&worker->thread, NULL,
+					snd_pcm_ladspa_worker, worker);
+		if (err) {
+			SNDERR("unable to create a LADSPA worker thread");
+			sem_destroy(&worker->go);
+			worker->ladspa = NULL;
+			snd_pcm_ladspa_stop_workers(ladspa);
+			return -err;
+		}
+	}
+	return 0;
+}
+
+/* run the current job on the caller and the needed workers */
+static void snd_pcm_ladspa_run_parallel(snd_pcm_ladspa_t *ladspa)
+{
+	unsigned int i, n = ladspa->threads - 1;
+
+	if (n > ladspa->job_plugin->instances_count - 1)
+		n = ladspa->job_plugin->instances_count - 1;
+	for (i = 0; i < n; i++)
+		sem_post(&ladspa->workers[i].go);
+	snd_pcm_ladspa_run_job(ladspa, 0);
+	for (i = 0; i < n; i++)
+		while (sem_wait(&ladspa->done) < 0 && errno == EINTR)
+			;
+}
+#else
+#define snd_pcm_ladspa_stop_workers(ladspa)	do { } while (0)
+#define snd_pcm_ladspa_run_parallel(ladspa)	snd_pcm_ladspa_run_job(ladspa, 0)
+static int snd_pcm_ladspa_start_workers(snd_pcm_ladspa_t *ladspa)
+{
+	if (ladspa->threads > 1)
+		SNDMSG("no thread support, threads ignored");
+	ladspa->threads = 1;
+	return 0;
+}
+#endif
+
 static unsigned int snd_pcm_ladspa_count_ports(snd_pcm_ladspa_plugin_t *lplug,
                                                LADSPA_PortDescriptor pdesc)
 {
@@ -196,6 +374,7 @@ static void snd_pcm_ladspa_free(snd_pcm_ladspa_t *ladspa)
 {
         unsigned int idx;
 
+	snd_pcm_ladspa_stop_workers(ladspa);
 	snd_pcm_ladspa_free_plugins(&ladspa->pplugins);
 	snd_pcm_ladspa_free_plugins(&ladspa->cplugins);
 	for (idx = 0; idx < 2; idx++) {
@@ -344,6 +523,7 @@ static void snd_pcm_ladspa_free_instances(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
                                 free(instance->input.data);
                                 free(instance->output.data);
 				list_del(&(instance->list));
+				plugin->instances_count--;
 				snd_pcm_ladspa_free_eps(&instance->input);
 				snd_pcm_ladspa_free_eps(&instance->output);
 				free(instance);
@@ -645,6 +825,7 @@ static int snd_pcm_ladspa_allocate_instances(snd_pcm_t *pcm, snd_pcm_ladspa_t *l
 				return -EINVAL;
 			}
 			list_add_tail(&instance->list, &plugin->instances);
+			plugin->instances_count++;
 			if (plugin->policy == SND_PCM_LADSPA_POLICY_DUPLICATE) {
 				err = snd_pcm_ladspa_connect_plugin_duplicate(plugin, &plugin->input, &plugin->output, instance, idx);
 				if (err < 0) {
@@ -695,6 +876,9 @@ static int snd_pcm_ladspa_allocate_memory(snd_pcm_t *pcm, snd_pcm_ladspa_t *lads
         ladspa->allocated = 2048;
         if (pcm->buffer_size > ladspa->allocated)
                 ladspa->allocated = pcm->buffer_size;
+	/* smaller runs keep the scratch buffers of the chain in cache */
+	if (ladspa->block_size)
+		ladspa->allocated = ladspa->block_size;
         if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
                 ichannels = pcm->channels;
                 ochannels = ladspa->plug.gen.slave->channels;
@@ -847,6 +1031,56 @@ static int snd_pcm_ladspa_hw_free(snd_pcm_t *pcm)
 	return snd_pcm_generic_hw_free(pcm);
 }
 
+/*
+ * Run the plugin chain over size frames, in runs of at most allocated
+ * frames.  The independent instances of a plugin (policy duplicate) are
+ * spread over the worker threads; the next plugin starts when all of them
+ * are done.
+ */
+static void snd_pcm_ladspa_process(snd_pcm_t *pcm, struct list_head *list,
+				   const snd_pcm_channel_area_t *in_areas,
+				   snd_pcm_uframes_t in_offset,
+				   const snd_pcm_channel_area_t *out_areas,
+				   snd_pcm_uframes_t out_offset,
+				   snd_pcm_uframes_t size)
+{
+	snd_pcm_ladspa_t *ladspa = pcm->private_data;
+	struct list_head *pos, *pos1;
+	unsigned int size1;
+
+	if (list_empty(list)) {
+		/* no plugins for this direction, FLOAT goes through */
+		snd_pcm_areas_copy(out_areas, out_offset, in_areas, in_offset,
+				   pcm->channels, size, pcm->format);
+		return;
+	}
+	while (size > 0) {
+		size1 = size;
+		if (size1 > ladspa->allocated)
+			size1 = ladspa->allocated;
+		list_for_each(pos, list) {
+			snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
+			if (ladspa->threads > 1 && plugin->instances_count > 1) {
+				ladspa->job_plugin = plugin;
+				ladspa->job_in_areas = in_areas;
+				ladspa->job_in_offset = in_offset;
+				ladspa->job_out_areas = out_areas;
+				ladspa->job_out_offset = out_offset;
+				ladspa->job_size = size1;
+				snd_pcm_ladspa_run_parallel(ladspa);
+				continue;
+			}
+			list_for_each(pos1, &plugin->instances)
+				snd_pcm_ladspa_run_instance(list_entry(pos1, snd_pcm_ladspa_instance_t, list),
+							    in_areas, in_offset,
+							    out_areas, out_offset, size1);
+		}
+		in_offset += size1;
+		out_offset += size1;
+		size -= size1;
+	}
+}
+
 static snd_pcm_uframes_t
 snd_pcm_ladspa_write_areas(snd_pcm_t *pcm,
 			   const snd_pcm_channel_area_t *areas,
@@ -857,55 +1091,13 @@ snd_pcm_ladspa_write_areas(snd_pcm_t *pcm,
 			   snd_pcm_uframes_t *slave_sizep)
 {
 	snd_pcm_ladspa_t *ladspa = pcm->private_data;
-	snd_pcm_ladspa_instance_t *instance;
-	struct list_head *pos, *pos1;
-	LADSPA_Data *data;
-	unsigned int idx, chn, size1, size2;
-	
+
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-        size2 = size;
-#if 0	/* no processing - for testing purposes only */
-	snd_pcm_areas_copy(slave_areas, slave_offset,
-			   areas, offset,
-			   pcm->channels, size, pcm->format);
-#else
-        while (size > 0) {
-                size1 = size;
-                if (size1 > ladspa->allocated)
-                        size1 = ladspa->allocated;
-        	list_for_each(pos, &ladspa->pplugins) {
-        		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
-        		list_for_each(pos1, &plugin->instances) {
-        			instance = list_entry(pos1, snd_pcm_ladspa_instance_t, list);
-        			for (idx = 0; idx < instance->input.channels.size; idx++) {
-                                        chn = instance->input.channels.array[idx];
-                                        data = instance->input.data[idx];
-                                        if (data == NULL) {
-                                		data = (LADSPA_Data *)((char *)areas[chn].addr + (areas[chn].first / 8));
-                                       		data += offset;
-                                        }
-                                        instance->desc->connect_port(instance->handle, instance->input.ports.array[idx], data);
-        			}
-        			for (idx = 0; idx < instance->output.channels.size; idx++) {
-                                        chn = instance->output.channels.array[idx];
-                                        data = instance->output.data[idx];
-                                        if (data == NULL) {
-                                		data = (LADSPA_Data *)((char *)slave_areas[chn].addr + (areas[chn].first / 8));
-                                		data += slave_offset;
-                                        }
-					instance->desc->connect_port(instance->handle, instance->output.ports.array[idx], data);
-        			}
-        			instance->desc->run(instance->handle, size1);
-        		}
-        	}
-        	offset += size1;
-        	slave_offset += size1;
-        	size -= size1;
-	}
-#endif
-	*slave_sizep = size2;
-	return size2;
+	snd_pcm_ladspa_process(pcm, &ladspa->pplugins, areas, offset,
+			       slave_areas, slave_offset, size);
+	*slave_sizep = size;
+	return size;
 }
 
 static snd_pcm_uframes_t
@@ -918,55 +1110,13 @@ snd_pcm_ladspa_read_areas(snd_pcm_t *pcm,
 			  snd_pcm_uframes_t *slave_sizep)
 {
 	snd_pcm_ladspa_t *ladspa = pcm->private_data;
-	snd_pcm_ladspa_instance_t *instance;
-	struct list_head *pos, *pos1;
-	LADSPA_Data *data;
-	unsigned int idx, chn, size1, size2;;
 
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-        size2 = size;
-#if 0	/* no processing - for testing purposes only */
-	snd_pcm_areas_copy(areas, offset,
-			   slave_areas, slave_offset,
-			   pcm->channels, size, pcm->format);
-#else
-        while (size > 0) {
-                size1 = size;
-                if (size1 > ladspa->allocated)
-                        size1 = ladspa->allocated;
-        	list_for_each(pos, &ladspa->cplugins) {
-        		snd_pcm_ladspa_plugin_t *plugin = list_entry(pos, snd_pcm_ladspa_plugin_t, list);
-        		list_for_each(pos1, &plugin->instances) {
-        			instance = list_entry(pos1, snd_pcm_ladspa_instance_t, list);
-        			for (idx = 0; idx < instance->input.channels.size; idx++) {
-                                        chn = instance->input.channels.array[idx];
-                                        data = instance->input.data[idx];
-                                        if (data == NULL) {
-                                		data = (LADSPA_Data *)((char *)slave_areas[chn].addr + (areas[chn].first / 8));
-                                		data += slave_offset;
-                                        }	
-                			instance->desc->connect_port(instance->handle, instance->input.ports.array[idx], data);
-        			}
-        			for (idx = 0; idx < instance->output.channels.size; idx++) {
-                                        chn = instance->output.channels.array[idx];
-                                        data = instance->output.data[idx];
-                                        if (data == NULL) {
-                                		data = (LADSPA_Data *)((char *)areas[chn].addr + (areas[chn].first / 8));
-                                       		data += offset;
-                                        }
-        		        	instance->desc->connect_port(instance->handle, instance->output.ports.array[idx], data);
-        			}
-        			instance->desc->run(instance->handle, size1);
-        		}
-        	}
-        	offset += size1;
-        	slave_offset += size1;
-        	size -= size1;
-	}
-#endif
-	*slave_sizep = size2;
-	return size2;
+	snd_pcm_ladspa_process(pcm, &ladspa->cplugins, slave_areas, slave_offset,
+			       areas, offset, size);
+	*slave_sizep = size;
+	return size;
 }
 
 static void snd_pcm_ladspa_dump_direction(snd_pcm_ladspa_plugin_t *plugin,
@@ -1141,54 +1291,218 @@ static int snd_pcm_ladspa_check_file(snd_pcm_ladspa_plugin_t * const plugin,
 	return -ENOENT;
 }
 
-static int snd_pcm_ladspa_check_dir(snd_pcm_ladspa_plugin_t * const plugin,
-				    const char *path,
-				    const char *label,
-				    const unsigned long ladspa_id)
+#ifndef DOC_HIDDEN
+/*
+ * The labels of the plugins found in a directory.  The first lookup by
+ * label loads every file of the directory once to index its plugins;
+ * later lookups load only the file with the label, until the mtime of
+ * the directory changes.  The index is shared by the PCMs of the process.
+ */
+typedef struct {
+	char *label;
+	unsigned long id;
+	unsigned int file;		/* index in files */
+	unsigned long index;		/* of the descriptor in the file */
+} snd_pcm_ladspa_dir_entry_t;
+
+typedef struct snd_pcm_ladspa_dir {
+	struct snd_pcm_ladspa_dir *next;
+	char *path;
+	struct timespec mtime;
+	char **files;
+	unsigned int files_count;
+	snd_pcm_ladspa_dir_entry_t *entries;
+	unsigned int count;
+} snd_pcm_ladspa_dir_t;
+
+static snd_pcm_ladspa_dir_t *snd_pcm_ladspa_dirs;
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t snd_pcm_ladspa_dirs_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+#endif /* DOC_HIDDEN */
+
+static void snd_pcm_ladspa_dir_clear(snd_pcm_ladspa_dir_t *dir)
 {
-	DIR *dir;
-	struct dirent * dirent;
-	int len = strlen(path), err;
-	int need_slash;
-	char *filename;
-	
-	if (len < 1)
+	unsigned int i;
+
+	for (i = 0; i < dir->count; i++)
+		free(dir->entries[i].label);
+	for (i = 0; i < dir->files_count; i++)
+		free(dir->files[i]);
+	free(dir->entries);
+	free(dir->files);
+	dir->entries = NULL;
+	dir->files = NULL;
+	dir->count = dir->files_count = 0;
+}
+
+static int snd_pcm_ladspa_dir_index_file(snd_pcm_ladspa_dir_t *dir, char *filename)
+{
+	LADSPA_Descriptor_Function fcn;
+	const LADSPA_Descriptor *d;
+	snd_pcm_ladspa_dir_entry_t *e;
+	void *handle;
+	char **files;
+	long idx;
+	int err = 0;
+
+	handle = dlopen(filename, RTLD_LAZY);
+	if (!handle) {
+		free(filename);
 		return 0;
-	need_slash = path[len - 1] != '/';
-	
-	dir = opendir(path);
-	if (!dir)
-		return -ENOENT;
-		
-	while (1) {
-		dirent = readdir(dir);
-		if (!dirent) {
-			closedir(dir);
-			return 0;
+	}
+	fcn = (LADSPA_Descriptor_Function)dlsym(handle, "ladspa_descriptor");
+	if (!fcn)
+		goto _out;
+	files = realloc(dir->files, (dir->files_count + 1) * sizeof(*files));
+	if (!files) {
+		err = -ENOMEM;
+		goto _out;
+	}
+	dir->files = files;
+	dir->files[dir->files_count++] = filename;
+	filename = NULL;
+	for (idx = 0; (d = fcn(idx)) != NULL; idx++) {
+		e = realloc(dir->entries, (dir->count + 1) * sizeof(*e));
+		if (!e) {
+			err = -ENOMEM;
+			break;
 		}
-		
+		dir->entries = e;
+		e += dir->count;
+		e->label = strdup(d->Label ? d->Label : "");
+		if (!e->label) {
+			err = -ENOMEM;
+			break;
+		}
+		e->id = d->UniqueID;
+		e->file = dir->files_count - 1;
+		e->index = idx;
+		dir->count++;
+	}
+ _out:
+	dlclose(handle);
+	free(filename);
+	return err;
+}
+
+static int snd_pcm_ladspa_dir_index(snd_pcm_ladspa_dir_t *dir)
+{
+	DIR *d;
+	struct dirent *dirent;
+	int len = strlen(dir->path), err = 0;
+	int need_slash = dir->path[len - 1] != '/';
+	char *filename;
+
+	d = opendir(dir->path);
+	if (!d)
+		return -ENOENT;
+	while (err >= 0 && (dirent = readdir(d)) != NULL) {
 		filename = malloc(len + strlen(dirent->d_name) + 1 + need_slash);
 		if (filename == NULL) {
-			closedir(dir);
-			return -ENOMEM;
+			err = -ENOMEM;
+			break;
 		}
-		strcpy(filename, path);
+		strcpy(filename, dir->path);
 		if (need_slash)
 			strcat(filename, "/");
 		strcat(filename, dirent->d_name);
-		err = snd_pcm_ladspa_check_file(plugin, filename, label, ladspa_id);
-		free(filename);
-		if (err < 0 && err != -ENOENT) {
-			closedir(dir);
-			return err;
-		}
-		if (err > 0) {
-			closedir(dir);
-			return 1;
+		err = snd_pcm_ladspa_dir_index_file(dir, filename);
+	}
+	closedir(d);
+	return err;
+}
+
+/* the index of a directory, made again when the directory has changed */
+static snd_pcm_ladspa_dir_t *snd_pcm_ladspa_dir_get(const char *path, int *errp)
+{
+	snd_pcm_ladspa_dir_t *dir;
+	struct stat st;
+	int err;
+
+	if (stat(path, &st) < 0) {
+		*errp = -ENOENT;
+		return NULL;
+	}
+	for (dir = snd_pcm_ladspa_dirs; dir; dir = dir->next) {
+		if (!strcmp(dir->path, path))
+			break;
+	}
+	if (dir && dir->mtime.tv_sec == st.st_mtim.tv_sec &&
+	    dir->mtime.tv_nsec == st.st_mtim.tv_nsec)
+		return dir;
+	if (!dir) {
+		dir = calloc(1, sizeof(*dir));
+		if (!dir)
+			goto _nomem;
+		dir->path = strdup(path);
+		if (!dir->path) {
+			free(dir);
+			goto _nomem;
 		}
+		dir->next = snd_pcm_ladspa_dirs;
+		snd_pcm_ladspa_dirs = dir;
 	}
-	/* never reached */
-	return 0;
+	snd_pcm_ladspa_dir_clear(dir);
+	err = snd_pcm_ladspa_dir_index(dir);
+	if (err < 0) {
+		snd_pcm_ladspa_dir_clear(dir);
+		dir->mtime.tv_sec = dir->mtime.tv_nsec = 0;
+		*errp = err;
+		return NULL;
+	}
+	dir->mtime = st.st_mtim;
+	return dir;
+ _nomem:
+	*errp = -ENOMEM;
+	return NULL;
+}
+
+static int snd_pcm_ladspa_check_dir(snd_pcm_ladspa_plugin_t * const plugin,
+				    const char *path,
+				    const char *label,
+				    const unsigned long ladspa_id)
+{
+	snd_pcm_ladspa_dir_t *dir;
+	snd_pcm_ladspa_dir_entry_t *e;
+	char *labellocale = NULL;
+	unsigned int i;
+	int err = 0;
+	
+	if (strlen(path) < 1)
+		return 0;
+	/* avoid locale problems - see ALSA bug#1553 */
+	if (label != NULL) {
+		labellocale = strdup(label);
+		if (labellocale == NULL)
+			return -ENOMEM;
+		if (strrchr(labellocale, '.'))
+			*strrchr(labellocale, '.') = *localeconv()->decimal_point;
+	}
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&snd_pcm_ladspa_dirs_mutex);
+#endif
+	dir = snd_pcm_ladspa_dir_get(path, &err);
+	for (i = 0; dir && i < dir->count; i++) {
+		e = &dir->entries[i];
+		if (label != NULL && strcmp(label, e->label) &&
+		    strcmp(labellocale, e->label))
+			continue;
+		if (ladspa_id > 0 && e->id != ladspa_id)
+			continue;
+		err = snd_pcm_ladspa_check_file(plugin, dir->files[e->file],
+						label, ladspa_id);
+		if (err != -ENOENT)
+			break;
+		/* the file changed in place, index the directory again */
+		dir->mtime.tv_sec = dir->mtime.tv_nsec = 0;
+		err = 0;
+	}
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&snd_pcm_ladspa_dirs_mutex);
+#endif
+	free(labellocale);
+	return err;
 }
 
 static int snd_pcm_ladspa_look_for_plugin(snd_pcm_ladspa_plugin_t * const plugin,
@@ -1613,6 +1927,7 @@ int snd_pcm_ladspa_open(snd_pcm_t **pcmp, const char *name,
 	INIT_LIST_HEAD(&ladspa->pplugins);
 	INIT_LIST_HEAD(&ladspa->cplugins);
 	ladspa->channels = channels;
+	ladspa->threads = 1;
 
 	if (slave->stream == SND_PCM_STREAM_PLAYBACK) {
 		err = snd_pcm_ladspa_build_plugins(&ladspa->pplugins, ladspa_path, ladspa_pplugins, reverse);
@@ -1672,6 +1987,13 @@ connected to a dummy sample area.
 
 Instances of LADSPA plugins are created dynamically.
 
+The chain runs over at most <code>block_size</code> frames at once (by
+default the buffer size), so a smaller value keeps the intermediate
+buffers in the cache.  With <code>threads</code> above one, the instances
+of a plugin with the policy duplicate, one per channel, are spread over
+that many threads; the next plugin of the chain starts when all of them
+finished.  A direction without plugins passes the samples unchanged.
+
 \code
 pcm.name {
         type ladspa             # ALSA<->LADSPA PCM
@@ -1684,6 +2006,8 @@ pcm.name {
         }
         [channels INT]		# count input channels (input to LADSPA plugin chain)
 	[path STR]		# Path (directory) with LADSPA plugins
+	[block_size INT]	# Frames per run of the plugin chain
+	[threads INT]		# Threads for the instances of a plugin
 	plugins |		# Definition for both directions
         playback_plugins |	# Definition for playback direction
 	capture_plugins {	# Definition for capture direction
@@ -1737,9 +2061,10 @@ int _snd_pcm_ladspa_open(snd_pcm_t **pcmp, const char *name,
 	snd_config_iterator_t i, next;
 	int err;
 	snd_pcm_t *spcm;
+	snd_pcm_ladspa_t *ladspa;
 	snd_config_t *slave = NULL, *sconf;
 	const char *path = NULL;
-	long channels = 0;
+	long channels = 0, block_size = 0, threads = 1;
 	snd_config_t *plugins = NULL, *pplugins = NULL, *cplugins = NULL;
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1764,6 +2089,22 @@ int _snd_pcm_ladspa_open(snd_pcm_t **pcmp, const char *name,
                                 channels = 0;
 			continue;
 		}
+		if (strcmp(id, "block_size") == 0) {
+			if (snd_config_get_integer(n, &block_size) < 0 ||
+			    block_size < 0) {
+				SNDERR("Invalid value for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (strcmp(id, "threads") == 0) {
+			if (snd_config_get_integer(n, &threads) < 0 ||
+			    threads < 1 || threads > 64) {
+				SNDERR("Invalid value for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
 		if (strcmp(id, "plugins") == 0) {
 			plugins = n;
 			continue;
@@ -1799,8 +2140,16 @@ int _snd_pcm_ladspa_open(snd_pcm_t **pcmp, const char *name,
 	if (err < 0)
 		return err;
 	err = snd_pcm_ladspa_open(pcmp, name, path, channels, pplugins, cplugins, spcm, 1);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
+		return err;
+	}
+	ladspa = (*pcmp)->private_data;
+	ladspa->block_size = block_size;
+	ladspa->threads = threads;
+	err = snd_pcm_ladspa_start_workers(ladspa);
+	if (err < 0)
+		snd_pcm_close(*pcmp);
 	return err;
 }
 #ifndef DOC_HIDDEN
@@ -46,11 +46,17 @@ typedef double double_t;
 const char *_snd_module_pcm_lfloat = "";
 #endif
 
+typedef void (*lfloat_kernel_t)(char *dst, int dst_step,
+				const char *src, int src_step,
+				snd_pcm_uframes_t samples);
+
 typedef struct {
 	/* This field need to be the first */
 	snd_pcm_plugin_t plug;
 	unsigned int int32_idx;
 	unsigned int float32_idx;
+	lfloat_kernel_t kernel;
+	unsigned int src_width, dst_width;
 	snd_pcm_format_t sformat;
 	void (*func)(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
 		     const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
@@ -77,7 +83,7 @@ int snd_pcm_lfloat_get_s32_index(snd_pcm_format_t format)
 #ifdef SND_LITTLE_ENDIAN
 	endian = snd_pcm_format_big_endian(format);
 #else
-	endian = snd_pcm_format_little_endian(format);
+	endian = __snd_pcm_format_little_endian(format);
 #endif
 	return ((width / 32)-1) * 2 + endian;
 }
@@ -183,6 +189,144 @@ void snd_pcm_lfloat_convert_float_integer(const snd_pcm_channel_area_t *dst_area
 	}
 }
 
+/*
+ * specialized kernels for the native endian integer <-> float conversions
+ *
+ * They do the same arithmetic as the label tables above (including the
+ * clipping to [-1.0, 1.0) for float -> integer), but on a fixed pair of
+ * types, so that contiguous runs can be vectorized by the compiler.
+ */
+
+#define LFLOAT_KERNEL(name, stype, dtype, conv)				\
+static void name(char *dst, int dst_step, const char *src,		\
+		 int src_step, snd_pcm_uframes_t samples)		\
+{									\
+	if (src_step == sizeof(stype) && dst_step == sizeof(dtype)) {	\
+		const stype *s = (const stype *)src;			\
+		dtype *d = (dtype *)dst;				\
+		snd_pcm_uframes_t i;					\
+		for (i = 0; i < samples; i++)				\
+			d[i] = conv(s[i]);				\
+		return;							\
+	}								\
+	while (samples-- > 0) {						\
+		*(dtype *)dst = conv(*(const stype *)src);		\
+		src += src_step;					\
+		dst += dst_step;					\
+	}								\
+}
+
+#define S16_TO_S32(v)	((int32_t)((u_int32_t)(v) << 16))
+#define S24_TO_S32(v)	((int32_t)((u_int32_t)(v) << 8))
+#define S32_TO_FLOAT(v)	((float_t)(v) / (float_t)0x80000000UL)
+#define S32_TO_DOUBLE(v) ((double_t)(v) / (double_t)0x80000000UL)
+
+#define FLOAT_TO_S32(v)	((v) >= 1.0 ? (int32_t)0x7fffffff : \
+			 (v) <= -1.0 ? (int32_t)0x80000000 : \
+			 (int32_t)((v) * (float_t)0x80000000UL))
+#define DOUBLE_TO_S32(v) ((v) >= 1.0 ? (int32_t)0x7fffffff : \
+			 (v) <= -1.0 ? (int32_t)0x80000000 : \
+			 (int32_t)((v) * (double_t)0x80000000UL))
+
+#define S16_TO_F(v)	S32_TO_FLOAT(S16_TO_S32(v))
+#define S24_TO_F(v)	S32_TO_FLOAT(S24_TO_S32(v))
+#define S32_TO_F(v)	S32_TO_FLOAT(v)
+#define S16_TO_D(v)	S32_TO_DOUBLE(S16_TO_S32(v))
+#define S24_TO_D(v)	S32_TO_DOUBLE(S24_TO_S32(v))
+#define S32_TO_D(v)	S32_TO_DOUBLE(v)
+LFLOAT_KERNEL(lfloat_s16_float, int16_t, float_t, S16_TO_F)
+LFLOAT_KERNEL(lfloat_s24_float, int32_t, float_t, S24_TO_F)
+LFLOAT_KERNEL(lfloat_s32_float, int32_t, float_t, S32_TO_F)
+LFLOAT_KERNEL(lfloat_s16_float64, int16_t, double_t, S16_TO_D)
+LFLOAT_KERNEL(lfloat_s24_float64, int32_t, double_t, S24_TO_D)
+LFLOAT_KERNEL(lfloat_s32_float64, int32_t, double_t, S32_TO_D)
+
+#define F_TO_S16(v)	((int16_t)(FLOAT_TO_S32(v) >> 16))
+#define F_TO_S24(v)	(FLOAT_TO_S32(v) >> 8)
+#define F_TO_S32(v)	FLOAT_TO_S32(v)
+#define D_TO_S16(v)	((int16_t)(DOUBLE_TO_S32(v) >> 16))
+#define D_TO_S24(v)	(DOUBLE_TO_S32(v) >> 8)
+#define D_TO_S32(v)	DOUBLE_TO_S32(v)
+LFLOAT_KERNEL(lfloat_float_s16, float_t, int16_t, F_TO_S16)
+LFLOAT_KERNEL(lfloat_float_s24, float_t, int32_t, F_TO_S24)
+LFLOAT_KERNEL(lfloat_float_s32, float_t, int32_t, F_TO_S32)
+LFLOAT_KERNEL(lfloat_float64_s16, double_t, int16_t, D_TO_S16)
+LFLOAT_KERNEL(lfloat_float64_s24, double_t, int32_t, D_TO_S24)
+LFLOAT_KERNEL(lfloat_float64_s32, double_t, int32_t, D_TO_S32)
+
+static const struct {
+	snd_pcm_format_t src, dst;
+	lfloat_kernel_t kernel;
+} lfloat_kernels[] = {
+	{ SND_PCM_FORMAT_S16, SND_PCM_FORMAT_FLOAT, lfloat_s16_float },
+	{ SND_PCM_FORMAT_S24, SND_PCM_FORMAT_FLOAT, lfloat_s24_float },
+	{ SND_PCM_FORMAT_S32, SND_PCM_FORMAT_FLOAT, lfloat_s32_float },
+	{ SND_PCM_FORMAT_S16, SND_PCM_FORMAT_FLOAT64, lfloat_s16_float64 },
+	{ SND_PCM_FORMAT_S24, SND_PCM_FORMAT_FLOAT64, lfloat_s24_float64 },
+	{ SND_PCM_FORMAT_S32, SND_PCM_FORMAT_FLOAT64, lfloat_s32_float64 },
+	{ SND_PCM_FORMAT_FLOAT, SND_PCM_FORMAT_S16, lfloat_float_s16 },
+	{ SND_PCM_FORMAT_FLOAT, SND_PCM_FORMAT_S24, lfloat_float_s24 },
+	{ SND_PCM_FORMAT_FLOAT, SND_PCM_FORMAT_S32, lfloat_float_s32 },
+	{ SND_PCM_FORMAT_FLOAT64, SND_PCM_FORMAT_S16, lfloat_float64_s16 },
+	{ SND_PCM_FORMAT_FLOAT64, SND_PCM_FORMAT_S24, lfloat_float64_s24 },
+	{ SND_PCM_FORMAT_FLOAT64, SND_PCM_FORMAT_S32, lfloat_float64_s32 },
+};
+
+static lfloat_kernel_t snd_pcm_lfloat_find_kernel(snd_pcm_format_t src_format,
+						  snd_pcm_format_t dst_format)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(lfloat_kernels); i++) {
+		if (lfloat_kernels[i].src == src_format &&
+		    lfloat_kernels[i].dst == dst_format)
+			return lfloat_kernels[i].kernel;
+	}
+	return NULL;
+}
+
+static void snd_pcm_lfloat_convert_kernel(snd_pcm_lfloat_t *lfloat,
+					  const snd_pcm_channel_area_t *dst_areas,
+					  snd_pcm_uframes_t dst_offset,
+					  const snd_pcm_channel_area_t *src_areas,
+					  snd_pcm_uframes_t src_offset,
+					  unsigned int channels,
+					  snd_pcm_uframes_t frames)
+{
+	snd_pcm_uframes_t block;
+	unsigned int channel;
+
+	if (snd_pcm_areas_interleaved(src_areas, channels, lfloat->src_width) &&
+	    snd_pcm_areas_interleaved(dst_areas, channels, lfloat->dst_width)) {
+		/* convert all channels in one run */
+		lfloat->kernel(snd_pcm_channel_area_addr(dst_areas, dst_offset),
+			       lfloat->dst_width / 8,
+			       snd_pcm_channel_area_addr(src_areas, src_offset),
+			       lfloat->src_width / 8,
+			       frames * channels);
+		return;
+	}
+	/* in blocks, e.g. from an interleaved slave into planar buffers */
+	block = snd_pcm_plugin_block_frames(channels,
+					    lfloat->src_width > lfloat->dst_width ?
+					    lfloat->src_width : lfloat->dst_width);
+	while (frames > 0) {
+		snd_pcm_uframes_t n = frames > block ? block : frames;
+		for (channel = 0; channel < channels; ++channel) {
+			const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+			const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+			lfloat->kernel(snd_pcm_channel_area_addr(dst_area, dst_offset),
+				       snd_pcm_channel_area_step(dst_area),
+				       snd_pcm_channel_area_addr(src_area, src_offset),
+				       snd_pcm_channel_area_step(src_area),
+				       n);
+		}
+		dst_offset += n;
+		src_offset += n;
+		frames -= n;
+	}
+}
+
 #endif /* DOC_HIDDEN */
 
 static int snd_pcm_lfloat_hw_refine_cprepare(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
@@ -294,6 +438,9 @@ static int snd_pcm_lfloat_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 		lfloat->float32_idx = snd_pcm_lfloat_get_s32_index(src_format);
 		lfloat->func = snd_pcm_lfloat_convert_float_integer;
 	}
+	lfloat->kernel = snd_pcm_lfloat_find_kernel(src_format, dst_format);
+	lfloat->src_width = __snd_pcm_format_physical_width(src_format);
+	lfloat->dst_width = __snd_pcm_format_physical_width(dst_format);
 	return 0;
 }
 
@@ -309,10 +456,15 @@ snd_pcm_lfloat_write_areas(snd_pcm_t *pcm,
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	lfloat->func(slave_areas, slave_offset,
-		     areas, offset, 
-		     pcm->channels, size,
-		     lfloat->int32_idx, lfloat->float32_idx);
+	if (lfloat->kernel)
+		snd_pcm_lfloat_convert_kernel(lfloat, slave_areas, slave_offset,
+					      areas, offset,
+					      pcm->channels, size);
+	else
+		lfloat->func(slave_areas, slave_offset,
+			     areas, offset, 
+			     pcm->channels, size,
+			     lfloat->int32_idx, lfloat->float32_idx);
 	*slave_sizep = size;
 	return size;
 }
@@ -329,10 +481,15 @@ snd_pcm_lfloat_read_areas(snd_pcm_t *pcm,
 	snd_pcm_lfloat_t *lfloat = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	lfloat->func(areas, offset, 
-		     slave_areas, slave_offset,
-		     pcm->channels, size,
-		     lfloat->int32_idx, lfloat->float32_idx);
+	if (lfloat->kernel)
+		snd_pcm_lfloat_convert_kernel(lfloat, areas, offset,
+					      slave_areas, slave_offset,
+					      pcm->channels, size);
+	else
+		lfloat->func(areas, offset, 
+			     slave_areas, slave_offset,
+			     pcm->channels, size,
+			     lfloat->int32_idx, lfloat->float32_idx);
 	*slave_sizep = size;
 	return size;
 }
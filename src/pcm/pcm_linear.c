@@ -38,12 +38,18 @@ const char *_snd_module_pcm_linear = "";
 #endif
 
 #ifndef DOC_HIDDEN
+typedef void (*linear_kernel_t)(char *dst, int dst_step,
+				const char *src, int src_step,
+				snd_pcm_uframes_t samples);
+
 typedef struct {
 	/* This field need to be the first */
 	snd_pcm_plugin_t plug;
 	unsigned int use_getput;
 	unsigned int conv_idx;
 	unsigned int get_idx, put_idx;
+	linear_kernel_t kernel;
+	unsigned int src_width, dst_width;
 	snd_pcm_format_t sformat;
 } snd_pcm_linear_t;
 #endif
@@ -55,14 +61,14 @@ int snd_pcm_linear_convert_index(snd_pcm_format_t src_format,
 {
 	int src_endian, dst_endian, sign, src_width, dst_width;
 
-	sign = (snd_pcm_format_signed(src_format) !=
-		snd_pcm_format_signed(dst_format));
+	sign = (__snd_pcm_format_signed(src_format) !=
+		__snd_pcm_format_signed(dst_format));
 #ifdef SND_LITTLE_ENDIAN
 	src_endian = snd_pcm_format_big_endian(src_format);
 	dst_endian = snd_pcm_format_big_endian(dst_format);
 #else
-	src_endian = snd_pcm_format_little_endian(src_format);
-	dst_endian = snd_pcm_format_little_endian(dst_format);
+	src_endian = __snd_pcm_format_little_endian(src_format);
+	dst_endian = __snd_pcm_format_little_endian(dst_format);
 #endif
 
 	if (src_endian < 0)
@@ -70,8 +76,8 @@ int snd_pcm_linear_convert_index(snd_pcm_format_t src_format,
 	if (dst_endian < 0)
 		dst_endian = 0;
 
-	src_width = snd_pcm_format_width(src_format) / 8 - 1;
-	dst_width = snd_pcm_format_width(dst_format) / 8 - 1;
+	src_width = __snd_pcm_format_width(src_format) / 8 - 1;
+	dst_width = __snd_pcm_format_width(dst_format) / 8 - 1;
 
 	return src_width * 32 + src_endian * 16 + sign * 8 + dst_width * 2 + dst_endian;
 }
@@ -79,17 +85,17 @@ int snd_pcm_linear_convert_index(snd_pcm_format_t src_format,
 int snd_pcm_linear_get_index(snd_pcm_format_t src_format, snd_pcm_format_t dst_format)
 {
 	int sign, width, pwidth, endian;
-	sign = (snd_pcm_format_signed(src_format) != 
-		snd_pcm_format_signed(dst_format));
+	sign = (__snd_pcm_format_signed(src_format) != 
+		__snd_pcm_format_signed(dst_format));
 #ifdef SND_LITTLE_ENDIAN
 	endian = snd_pcm_format_big_endian(src_format);
 #else
-	endian = snd_pcm_format_little_endian(src_format);
+	endian = __snd_pcm_format_little_endian(src_format);
 #endif
 	if (endian < 0)
 		endian = 0;
-	pwidth = snd_pcm_format_physical_width(src_format);
-	width = snd_pcm_format_width(src_format);
+	pwidth = __snd_pcm_format_physical_width(src_format);
+	width = __snd_pcm_format_width(src_format);
 	if (pwidth == 24) {
 		switch (width) {
 		case 24:
@@ -110,17 +116,17 @@ int snd_pcm_linear_get_index(snd_pcm_format_t src_format, snd_pcm_format_t dst_f
 int snd_pcm_linear_put_index(snd_pcm_format_t src_format, snd_pcm_format_t dst_format)
 {
 	int sign, width, pwidth, endian;
-	sign = (snd_pcm_format_signed(src_format) != 
-		snd_pcm_format_signed(dst_format));
+	sign = (__snd_pcm_format_signed(src_format) != 
+		__snd_pcm_format_signed(dst_format));
 #ifdef SND_LITTLE_ENDIAN
 	endian = snd_pcm_format_big_endian(dst_format);
 #else
-	endian = snd_pcm_format_little_endian(dst_format);
+	endian = __snd_pcm_format_little_endian(dst_format);
 #endif
 	if (endian < 0)
 		endian = 0;
-	pwidth = snd_pcm_format_physical_width(dst_format);
-	width = snd_pcm_format_width(dst_format);
+	pwidth = __snd_pcm_format_physical_width(dst_format);
+	width = __snd_pcm_format_width(dst_format);
 	if (pwidth == 24) {
 		switch (width) {
 		case 24:
@@ -208,6 +214,148 @@ void snd_pcm_linear_getput(const snd_pcm_channel_area_t *dst_areas, snd_pcm_ufra
 	}
 }
 
+/*
+ * specialized kernels for the common native endian conversions
+ *
+ * Each kernel converts a run of samples with a fixed type at both sides,
+ * so that there is no indirect jump per sample as with the label tables
+ * above.  When both steps are equal to the sample sizes, the loop works
+ * on plain arrays and can be vectorized by the compiler.  The results are
+ * bit-exact with the generic conversions.
+ */
+
+#define LINEAR_KERNEL(name, stype, dtype, sload, dstore)		\
+static void name(char *dst, int dst_step, const char *src,		\
+		 int src_step, snd_pcm_uframes_t samples)		\
+{									\
+	if (src_step == sizeof(stype) && dst_step == sizeof(dtype)) {	\
+		const stype *s = (const stype *)src;			\
+		dtype *d = (dtype *)dst;				\
+		snd_pcm_uframes_t i;					\
+		for (i = 0; i < samples; i++)				\
+			dstore(&d[i], sload(&s[i]));			\
+		return;							\
+	}								\
+	while (samples-- > 0) {						\
+		dstore((dtype *)dst, sload((const stype *)src));	\
+		src += src_step;					\
+		dst += dst_step;					\
+	}								\
+}
+
+typedef struct { u_int8_t b[3]; } linear_s24_3le_t;
+
+#define LOAD_S16(p)	((int32_t)*(p))
+#define LOAD_S32(p)	(*(p))
+#define LOAD_S24_3LE(p)	((int32_t)(((u_int32_t)(p)->b[0] << 8) | \
+				   ((u_int32_t)(p)->b[1] << 16) | \
+				   ((u_int32_t)(p)->b[2] << 24)) >> 8)
+#define STORE_S16(p, v)	(*(p) = (int16_t)(v))
+#define STORE_S32(p, v)	(*(p) = (int32_t)(v))
+#define STORE_S24_3LE(p, v) do { \
+	u_int32_t _v = (v); \
+	(p)->b[0] = _v; \
+	(p)->b[1] = _v >> 8; \
+	(p)->b[2] = _v >> 16; \
+} while (0)
+
+/* 16 <-> 32 */
+#define S16_TO_S32(p)		((int32_t)((u_int32_t)LOAD_S16(p) << 16))
+#define S32_TO_S16(p)		(LOAD_S32(p) >> 16)
+LINEAR_KERNEL(linear_s16_s32, int16_t, int32_t, S16_TO_S32, STORE_S32)
+LINEAR_KERNEL(linear_s32_s16, int32_t, int16_t, S32_TO_S16, STORE_S16)
+
+/* 16 <-> 24 (packed) */
+#define S16_TO_S24(p)		((int32_t)((u_int32_t)LOAD_S16(p) << 8))
+#define S24_3LE_TO_S16(p)	(LOAD_S24_3LE(p) >> 8)
+LINEAR_KERNEL(linear_s16_s24_3le, int16_t, linear_s24_3le_t, S16_TO_S24, STORE_S24_3LE)
+LINEAR_KERNEL(linear_s24_3le_s16, linear_s24_3le_t, int16_t, S24_3LE_TO_S16, STORE_S16)
+
+/* 32 <-> 24 (packed) */
+#define S32_TO_S24(p)		(LOAD_S32(p) >> 8)
+#define S24_3LE_TO_S32(p)	((int32_t)((u_int32_t)LOAD_S24_3LE(p) << 8))
+LINEAR_KERNEL(linear_s32_s24_3le, int32_t, linear_s24_3le_t, S32_TO_S24, STORE_S24_3LE)
+LINEAR_KERNEL(linear_s24_3le_s32, linear_s24_3le_t, int32_t, S24_3LE_TO_S32, STORE_S32)
+
+/* 24 (in 32-bit container) <-> 16/32 */
+#define S24_TO_S16(p)		((int32_t)((u_int32_t)LOAD_S32(p) << 8) >> 16)
+#define S24_TO_S32(p)		((int32_t)((u_int32_t)LOAD_S32(p) << 8))
+LINEAR_KERNEL(linear_s16_s24, int16_t, int32_t, S16_TO_S24, STORE_S32)
+LINEAR_KERNEL(linear_s24_s16, int32_t, int16_t, S24_TO_S16, STORE_S16)
+LINEAR_KERNEL(linear_s32_s24, int32_t, int32_t, S32_TO_S24, STORE_S32)
+LINEAR_KERNEL(linear_s24_s32, int32_t, int32_t, S24_TO_S32, STORE_S32)
+
+static const struct {
+	snd_pcm_format_t src, dst;
+	linear_kernel_t kernel;
+} linear_kernels[] = {
+	{ SND_PCM_FORMAT_S16, SND_PCM_FORMAT_S32, linear_s16_s32 },
+	{ SND_PCM_FORMAT_S32, SND_PCM_FORMAT_S16, linear_s32_s16 },
+	{ SND_PCM_FORMAT_S16, SND_PCM_FORMAT_S24, linear_s16_s24 },
+	{ SND_PCM_FORMAT_S24, SND_PCM_FORMAT_S16, linear_s24_s16 },
+	{ SND_PCM_FORMAT_S32, SND_PCM_FORMAT_S24, linear_s32_s24 },
+	{ SND_PCM_FORMAT_S24, SND_PCM_FORMAT_S32, linear_s24_s32 },
+	{ SND_PCM_FORMAT_S16, SND_PCM_FORMAT_S24_3LE, linear_s16_s24_3le },
+	{ SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_S16, linear_s24_3le_s16 },
+	{ SND_PCM_FORMAT_S32, SND_PCM_FORMAT_S24_3LE, linear_s32_s24_3le },
+	{ SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_S32, linear_s24_3le_s32 },
+};
+
+static linear_kernel_t snd_pcm_linear_find_kernel(snd_pcm_format_t src_format,
+						  snd_pcm_format_t dst_format)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(linear_kernels); i++) {
+		if (linear_kernels[i].src == src_format &&
+		    linear_kernels[i].dst == dst_format)
+			return linear_kernels[i].kernel;
+	}
+	return NULL;
+}
+
+static void snd_pcm_linear_convert_kernel(snd_pcm_linear_t *linear,
+					  const snd_pcm_channel_area_t *dst_areas,
+					  snd_pcm_uframes_t dst_offset,
+					  const snd_pcm_channel_area_t *src_areas,
+					  snd_pcm_uframes_t src_offset,
+					  unsigned int channels,
+					  snd_pcm_uframes_t frames)
+{
+	snd_pcm_uframes_t block;
+	unsigned int channel;
+
+	if (snd_pcm_areas_interleaved(src_areas, channels, linear->src_width) &&
+	    snd_pcm_areas_interleaved(dst_areas, channels, linear->dst_width)) {
+		/* convert all channels in one run */
+		linear->kernel(snd_pcm_channel_area_addr(dst_areas, dst_offset),
+			       linear->dst_width / 8,
+			       snd_pcm_channel_area_addr(src_areas, src_offset),
+			       linear->src_width / 8,
+			       frames * channels);
+		return;
+	}
+	/* in blocks, e.g. from an interleaved slave into planar buffers */
+	block = snd_pcm_plugin_block_frames(channels,
+					    linear->src_width > linear->dst_width ?
+					    linear->src_width : linear->dst_width);
+	while (frames > 0) {
+		snd_pcm_uframes_t n = frames > block ? block : frames;
+		for (channel = 0; channel < channels; ++channel) {
+			const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+			const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+			linear->kernel(snd_pcm_channel_area_addr(dst_area, dst_offset),
+				       snd_pcm_channel_area_step(dst_area),
+				       snd_pcm_channel_area_addr(src_area, src_offset),
+				       snd_pcm_channel_area_step(src_area),
+				       n);
+		}
+		dst_offset += n;
+		src_offset += n;
+		frames -= n;
+	}
+}
+
 #endif /* DOC_HIDDEN */
 
 static int snd_pcm_linear_hw_refine_cprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t *params)
@@ -302,8 +450,20 @@ static int snd_pcm_linear_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	err = INTERNAL(snd_pcm_hw_params_get_format)(params, &format);
 	if (err < 0)
 		return err;
-	linear->use_getput = (snd_pcm_format_physical_width(format) == 24 ||
-			      snd_pcm_format_physical_width(linear->sformat) == 24);
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		linear->kernel = snd_pcm_linear_find_kernel(format, linear->sformat);
+	else
+		linear->kernel = snd_pcm_linear_find_kernel(linear->sformat, format);
+	if (linear->kernel) {
+		int app_width = __snd_pcm_format_physical_width(format);
+		int slave_width = __snd_pcm_format_physical_width(linear->sformat);
+		linear->src_width = pcm->stream == SND_PCM_STREAM_PLAYBACK ?
+			app_width : slave_width;
+		linear->dst_width = pcm->stream == SND_PCM_STREAM_PLAYBACK ?
+			slave_width : app_width;
+	}
+	linear->use_getput = (__snd_pcm_format_physical_width(format) == 24 ||
+			      __snd_pcm_format_physical_width(linear->sformat) == 24);
 	if (linear->use_getput) {
 		if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
 			linear->get_idx = snd_pcm_linear_get_index(format, SND_PCM_FORMAT_S32);
@@ -335,7 +495,11 @@ snd_pcm_linear_write_areas(snd_pcm_t *pcm,
 	snd_pcm_linear_t *linear = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	if (linear->use_getput)
+	if (linear->kernel)
+		snd_pcm_linear_convert_kernel(linear, slave_areas, slave_offset,
+					      areas, offset,
+					      pcm->channels, size);
+	else if (linear->use_getput)
 		snd_pcm_linear_getput(slave_areas, slave_offset,
 				      areas, offset, 
 				      pcm->channels, size,
@@ -360,7 +524,11 @@ snd_pcm_linear_read_areas(snd_pcm_t *pcm,
 	snd_pcm_linear_t *linear = pcm->private_data;
 	if (size > *slave_sizep)
 		size = *slave_sizep;
-	if (linear->use_getput)
+	if (linear->kernel)
+		snd_pcm_linear_convert_kernel(linear, areas, offset,
+					      slave_areas, slave_offset,
+					      pcm->channels, size);
+	else if (linear->use_getput)
 		snd_pcm_linear_getput(areas, offset, 
 				      slave_areas, slave_offset,
 				      pcm->channels, size,
@@ -121,7 +121,8 @@ typedef struct _snd_pcm_channel_info {
 	void *addr;			/* base address of channel samples */
 	unsigned int first;		/* offset to first sample in bits */
 	unsigned int step;		/* samples distance in bits */
-	enum { SND_PCM_AREA_SHM, SND_PCM_AREA_MMAP, SND_PCM_AREA_LOCAL } type;
+	enum { SND_PCM_AREA_SHM, SND_PCM_AREA_MMAP, SND_PCM_AREA_LOCAL,
+	       SND_PCM_AREA_EXTERN /* owned by the plugin, never freed */ } type;
 	union {
 		struct {
 			struct snd_shm_area *area;
@@ -130,6 +131,7 @@ typedef struct _snd_pcm_channel_info {
 		struct {
 			int fd;
 			off_t offset;
+			int memfd;	/* fd created by snd_pcm_mmap(), closed on munmap */
 		} mmap;
 	} u;
 	char reserved[64];
@@ -179,6 +181,7 @@ typedef struct {
 	snd_pcm_sframes_t (*avail_update)(snd_pcm_t *pcm); /* locked */
 	snd_pcm_sframes_t (*mmap_commit)(snd_pcm_t *pcm, snd_pcm_uframes_t offset, snd_pcm_uframes_t size); /* locked */
 	int (*htimestamp)(snd_pcm_t *pcm, snd_pcm_uframes_t *avail, snd_htimestamp_t *tstamp); /* locked */
+	int (*avail_status)(snd_pcm_t *pcm, snd_pcm_status_t *status); /* locked, optional */
 	int (*poll_descriptors_count)(snd_pcm_t *pcm); /* locked */
 	int (*poll_descriptors)(snd_pcm_t *pcm, struct pollfd *pfds, unsigned int space); /* locked */
 	int (*poll_revents)(snd_pcm_t *pcm, struct pollfd *pfds, unsigned int nfds, unsigned short *revents); /* locked */
@@ -195,6 +198,10 @@ struct _snd_pcm {
 	int poll_fd_count;
 	int poll_fd;
 	unsigned short poll_events;
+	int wait_fd;			/* resolved poll fd of the chain, or -1 */
+	unsigned short wait_events;
+	struct snd_pcm_refine_cache *refine_cache;	/* see snd_pcm_hw_refine() */
+	struct snd_pcm_arena_chunk *arena;	/* see snd_pcm_arena_alloc() */
 	int setup: 1,
 	    compat: 1;
 	snd_pcm_access_t access;	/* access mode */
@@ -243,6 +250,7 @@ struct _snd_pcm {
 	snd_pcm_t *fast_op_arg;
 	void *private_data;
 	struct list_head async_handlers;
+	snd_pcm_stat_counter_t *stats;	/* hot-path counters, NULL if off */
 #ifdef THREAD_SAFE_API
 	int thread_safe;
 	pthread_mutex_t lock;
@@ -264,10 +272,20 @@ struct _snd_pcm {
 	snd1_pcm_new
 #define snd_pcm_free \
 	snd1_pcm_free
+#define snd_pcm_arena_new \
+	snd1_pcm_arena_new
+#define snd_pcm_arena_alloc \
+	snd1_pcm_arena_alloc
+#define snd_pcm_arena_strdup \
+	snd1_pcm_arena_strdup
+#define snd_pcm_arena_release \
+	snd1_pcm_arena_release
 #define snd_pcm_areas_from_buf \
 	snd1_pcm_areas_from_buf
 #define snd_pcm_areas_from_bufs \
 	snd1_pcm_areas_from_bufs
+#define snd_pcm_areas_copy_stream \
+	snd1_pcm_areas_copy_stream
 #define snd_pcm_open_named_slave \
 	snd1_pcm_open_named_slave
 #define snd_pcm_hw_open_fd \
@@ -302,6 +320,16 @@ struct _snd_pcm {
 	snd1_pcm_read_areas
 #define snd_pcm_write_areas \
 	snd1_pcm_write_areas
+#define snd_pcm_stat_start \
+	snd1_pcm_stat_start
+#define snd_pcm_stat_update \
+	snd1_pcm_stat_update
+#define snd_pcm_trace_active \
+	snd1_pcm_trace_active
+#define snd_pcm_trace_put \
+	snd1_pcm_trace_put
+#define snd_pcm_trace_init_env \
+	snd1_pcm_trace_init_env
 #define snd_pcm_read_mmap \
 	snd1_pcm_read_mmap
 #define snd_pcm_write_mmap \
@@ -310,6 +338,8 @@ struct _snd_pcm {
 	snd1_pcm_channel_info_shm
 #define snd_pcm_hw_refine_soft \
 	snd1_pcm_hw_refine_soft
+#define snd_pcm_hw_refine_invalidate \
+	snd1_pcm_hw_refine_invalidate
 #define snd_pcm_hw_refine_slave \
 	snd1_pcm_hw_refine_slave
 #define snd_pcm_hw_params_slave \
@@ -330,6 +360,12 @@ struct _snd_pcm {
 	snd1_pcm_hw_param_get_interval
 #define snd_pcm_hw_param_any \
 	snd1_pcm_hw_param_any
+#define snd_pcm_format_descs \
+	snd1_pcm_format_descs
+#define snd_pcm_silence_block_init \
+	snd1_pcm_silence_block_init
+#define snd_pcm_silence_fill \
+	snd1_pcm_silence_fill
 #define snd_pcm_hw_param_set_integer \
 	snd1_pcm_hw_param_set_integer
 #define snd_pcm_hw_param_set_first \
@@ -361,8 +397,16 @@ int snd_pcm_new(snd_pcm_t **pcmp, snd_pcm_type_t type, const char *name,
 		snd_pcm_stream_t stream, int mode);
 int snd_pcm_free(snd_pcm_t *pcm);
 
+snd_pcm_t *snd_pcm_arena_new(void);
+void *snd_pcm_arena_alloc(snd_pcm_t *pcm, size_t size);
+char *snd_pcm_arena_strdup(snd_pcm_t *pcm, const char *str);
+void snd_pcm_arena_release(snd_pcm_t *pcm);
+
 void snd_pcm_areas_from_buf(snd_pcm_t *pcm, snd_pcm_channel_area_t *areas, void *buf);
 void snd_pcm_areas_from_bufs(snd_pcm_t *pcm, snd_pcm_channel_area_t *areas, void **bufs);
+int snd_pcm_areas_copy_stream(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+			      const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+			      unsigned int channels, snd_pcm_uframes_t frames, snd_pcm_format_t format);
 
 int snd_pcm_async(snd_pcm_t *pcm, int sig, pid_t pid);
 int snd_pcm_mmap(snd_pcm_t *pcm);
@@ -400,6 +444,83 @@ snd_pcm_sframes_t snd_pcm_read_mmap(snd_pcm_t *pcm, snd_pcm_uframes_t offset,
 				    snd_pcm_uframes_t size);
 snd_pcm_sframes_t snd_pcm_write_mmap(snd_pcm_t *pcm, snd_pcm_uframes_t offset,
 				     snd_pcm_uframes_t size);
+/* properties of a sample format, see snd_pcm_format_descs */
+#define SND_PCM_FMTF_LINEAR	(1 << 0)	/* signedness is defined */
+#define SND_PCM_FMTF_SIGNED	(1 << 1)
+#define SND_PCM_FMTF_ENDIAN	(1 << 2)	/* byte order is defined */
+#define SND_PCM_FMTF_LE		(1 << 3)
+#define SND_PCM_FMTF_FLOAT	(1 << 4)
+#define SND_PCM_FMTF_SILENCE	(1 << 5)	/* silence is defined */
+
+typedef struct {
+	u_int64_t silence;		/* 64 bits of silence, CPU byte order */
+	signed char width;		/* nominal bits, 0 = not applicable */
+	signed char phys_width;		/* stored bits, 0 = not applicable */
+	unsigned char flags;		/* SND_PCM_FMTF_* */
+} snd_pcm_format_desc_t;
+
+/* indexed by the format, the last entry describes unknown formats */
+extern const snd_pcm_format_desc_t snd_pcm_format_descs[SND_PCM_FORMAT_LAST + 2];
+
+static inline const snd_pcm_format_desc_t *snd_pcm_format_desc(snd_pcm_format_t format)
+{
+	if ((unsigned int)format > SND_PCM_FORMAT_LAST)
+		return &snd_pcm_format_descs[SND_PCM_FORMAT_LAST + 1];
+	return &snd_pcm_format_descs[format];
+}
+
+static inline int __snd_pcm_format_width(snd_pcm_format_t format)
+{
+	int width = snd_pcm_format_desc(format)->width;
+	return width ? width : -EINVAL;
+}
+
+static inline int __snd_pcm_format_physical_width(snd_pcm_format_t format)
+{
+	int width = snd_pcm_format_desc(format)->phys_width;
+	return width ? width : -EINVAL;
+}
+
+static inline int __snd_pcm_format_signed(snd_pcm_format_t format)
+{
+	unsigned int flags = snd_pcm_format_desc(format)->flags;
+	if (!(flags & SND_PCM_FMTF_LINEAR))
+		return -EINVAL;
+	return !!(flags & SND_PCM_FMTF_SIGNED);
+}
+
+static inline int __snd_pcm_format_little_endian(snd_pcm_format_t format)
+{
+	unsigned int flags = snd_pcm_format_desc(format)->flags;
+	if (!(flags & SND_PCM_FMTF_ENDIAN))
+		return -EINVAL;
+	return !!(flags & SND_PCM_FMTF_LE);
+}
+
+static inline u_int64_t __snd_pcm_format_silence_64(snd_pcm_format_t format)
+{
+	const snd_pcm_format_desc_t *desc = snd_pcm_format_desc(format);
+	assert(desc->flags & SND_PCM_FMTF_SILENCE);
+	return desc->silence;
+}
+
+/* silence pattern for bulk fills, see snd_pcm_silence_block_init() */
+#define SND_PCM_SILENCE_BLOCK_MAX	64
+
+typedef struct {
+	union {
+		u_int64_t q[SND_PCM_SILENCE_BLOCK_MAX / 8];
+		unsigned char b[SND_PCM_SILENCE_BLOCK_MAX];
+	} u;
+	unsigned int bytes;	/* block size */
+	unsigned int period;	/* bytes after which the pattern repeats */
+	int byte;		/* >= 0: silence is this repeated byte */
+} snd_pcm_silence_block_t;
+
+void snd_pcm_silence_block_init(snd_pcm_silence_block_t *blk, unsigned int width,
+				u_int64_t silence);
+void snd_pcm_silence_fill(char *dst, size_t bytes, const snd_pcm_silence_block_t *blk);
+
 static inline int snd_pcm_channel_info(snd_pcm_t *pcm, snd_pcm_channel_info_t *info)
 {
 	return pcm->ops->channel_info(pcm, info);
@@ -416,10 +537,40 @@ snd_pcm_sframes_t __snd_pcm_mmap_commit(snd_pcm_t *pcm,
 					snd_pcm_uframes_t offset,
 					snd_pcm_uframes_t frames);
 int __snd_pcm_wait_in_lock(snd_pcm_t *pcm, int timeout);
+int __snd_pcm_avail_status(snd_pcm_t *pcm, snd_pcm_status_t *status);
+
+void snd_pcm_stat_start(snd_htimestamp_t *start);
+void snd_pcm_stat_update(snd_pcm_t *pcm, snd_pcm_stat_t stat,
+			 const snd_htimestamp_t *start);
+
+extern snd_pcm_trace_ring_t *snd_pcm_trace_active;
+void snd_pcm_trace_put(snd_pcm_t *pcm, snd_pcm_trace_event_t event,
+		       snd_pcm_uframes_t hw_ptr, snd_pcm_uframes_t appl_ptr,
+		       long result);
+void snd_pcm_trace_init_env(void);
+
+/* record an event with the current pointers of the PCM */
+static inline void snd_pcm_trace(snd_pcm_t *pcm, snd_pcm_trace_event_t event,
+				 long result)
+{
+	if (snd_pcm_trace_active)
+		snd_pcm_trace_put(pcm, event,
+				  pcm->hw.ptr ? *pcm->hw.ptr : 0,
+				  pcm->appl.ptr ? *pcm->appl.ptr : 0,
+				  result);
+}
 
 static inline snd_pcm_sframes_t __snd_pcm_avail_update(snd_pcm_t *pcm)
 {
-	return pcm->fast_ops->avail_update(pcm->fast_op_arg);
+	snd_htimestamp_t start;
+	snd_pcm_sframes_t avail;
+
+	if (!pcm->stats)
+		return pcm->fast_ops->avail_update(pcm->fast_op_arg);
+	snd_pcm_stat_start(&start);
+	avail = pcm->fast_ops->avail_update(pcm->fast_op_arg);
+	snd_pcm_stat_update(pcm, SND_PCM_STAT_AVAIL_UPDATE, &start);
+	return avail;
 }
 
 static inline int __snd_pcm_start(snd_pcm_t *pcm)
@@ -434,7 +585,15 @@ static inline snd_pcm_state_t __snd_pcm_state(snd_pcm_t *pcm)
 
 static inline int __snd_pcm_hwsync(snd_pcm_t *pcm)
 {
-	return pcm->fast_ops->hwsync(pcm->fast_op_arg);
+	snd_htimestamp_t start;
+	int err;
+
+	if (!pcm->stats)
+		return pcm->fast_ops->hwsync(pcm->fast_op_arg);
+	snd_pcm_stat_start(&start);
+	err = pcm->fast_ops->hwsync(pcm->fast_op_arg);
+	snd_pcm_stat_update(pcm, SND_PCM_STAT_HWSYNC, &start);
+	return err;
 }
 
 static inline int __snd_pcm_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
@@ -572,6 +731,22 @@ static inline unsigned int snd_pcm_channel_area_step(const snd_pcm_channel_area_
 	return area->step / 8;
 }
 
+/* check whether the areas are packed interleaved samples of the given width */
+static inline int snd_pcm_areas_interleaved(const snd_pcm_channel_area_t *areas,
+					    unsigned int channels,
+					    unsigned int width)
+{
+	unsigned int chn;
+
+	for (chn = 0; chn < channels; chn++) {
+		if (areas[chn].addr != areas[0].addr ||
+		    areas[chn].first != areas[0].first + chn * width ||
+		    areas[chn].step != channels * width)
+			return 0;
+	}
+	return 1;
+}
+
 static inline snd_pcm_sframes_t _snd_pcm_writei(snd_pcm_t *pcm, const void *buffer, snd_pcm_uframes_t size)
 {
 	/* lock handled in the callback */
@@ -634,6 +809,7 @@ static inline int muldiv_near(int a, int b, int c)
 }
 
 int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
+void snd_pcm_hw_refine_invalidate(void);
 int _snd_pcm_hw_params_internal(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
 #undef _snd_pcm_hw_params
 int snd_pcm_hw_refine_soft(snd_pcm_t *pcm, snd_pcm_hw_params_t *params);
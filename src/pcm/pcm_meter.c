@@ -31,6 +31,9 @@
 #include <time.h>
 #include <pthread.h>
 #include <dlfcn.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <math.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
 
@@ -45,15 +48,23 @@ const char *_snd_module_pcm_meter = "";
 
 #ifndef DOC_HIDDEN
 #define FREQUENCY 50
+#define METER_RANGES 64		/* power of two */
 
 struct _snd_pcm_scope {
 	int enabled;
 	char *name;
 	const snd_pcm_scope_ops_t *ops;
+	snd_pcm_scope_range_callback_t range;
 	void *private_data;
 	struct list_head list;
 };
 
+/* frames copied into the meter buffer */
+typedef struct {
+	snd_pcm_uframes_t ptr;
+	snd_pcm_uframes_t frames;
+} snd_pcm_meter_range_t;
+
 typedef struct _snd_pcm_meter {
 	snd_pcm_generic_t gen;
 	snd_pcm_uframes_t rptr;
@@ -66,7 +77,12 @@ typedef struct _snd_pcm_meter {
 	int running;
 	int reset;
 	pthread_t thread;
-	pthread_mutex_t update_mutex;
+	/* single producer (the audio path), single consumer (the thread) */
+	snd_pcm_meter_range_t ranges[METER_RANGES];
+	unsigned int range_head;
+	unsigned int range_tail;
+	unsigned int range_reset;	/* head at the last prepare */
+	snd_pcm_meter_range_t pending;	/* producer only, ring was full */
 	pthread_mutex_t running_mutex;
 	pthread_cond_t running_cond;
 	struct timespec delay;
@@ -99,48 +115,67 @@ static void snd_pcm_meter_add_frames(snd_pcm_t *pcm,
 	}
 }
 
-static void snd_pcm_meter_update_main(snd_pcm_t *pcm)
+/* publish a range to the meter thread, never blocks */
+static void snd_pcm_meter_push_range(snd_pcm_meter_t *meter,
+				     snd_pcm_uframes_t ptr,
+				     snd_pcm_uframes_t frames)
+{
+	unsigned int head = meter->range_head;
+	snd_pcm_meter_range_t *r;
+
+	if (meter->pending.frames) {
+		/* the consumer only looks at the covered span */
+		ptr = meter->pending.ptr;
+		frames += meter->pending.frames;
+		meter->pending.frames = 0;
+	}
+	if (head - __atomic_load_n(&meter->range_tail, __ATOMIC_ACQUIRE) >=
+	    METER_RANGES) {
+		meter->pending.ptr = ptr;
+		meter->pending.frames = frames;
+		return;
+	}
+	r = &meter->ranges[head % METER_RANGES];
+	r->ptr = ptr;
+	r->frames = frames;
+	__atomic_store_n(&meter->range_head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* take all published ranges as one span; returns the frames count */
+static snd_pcm_uframes_t snd_pcm_meter_pop_ranges(snd_pcm_t *pcm,
+						  snd_pcm_uframes_t *ptr)
 {
 	snd_pcm_meter_t *meter = pcm->private_data;
-	snd_pcm_sframes_t frames;
-	snd_pcm_uframes_t rptr, old_rptr;
-	const snd_pcm_channel_area_t *areas;
-	int locked;
-	locked = (pthread_mutex_trylock(&meter->update_mutex) >= 0);
-	areas = snd_pcm_mmap_areas(pcm);
-	rptr = *pcm->hw.ptr;
-	old_rptr = meter->rptr;
-	meter->rptr = rptr;
-	frames = rptr - old_rptr;
-	if (frames < 0)
-		frames += pcm->boundary;
-	if (frames > 0) {
-		assert((snd_pcm_uframes_t) frames <= pcm->buffer_size);
-		snd_pcm_meter_add_frames(pcm, areas, old_rptr,
-					 (snd_pcm_uframes_t) frames);
+	unsigned int tail = meter->range_tail;
+	unsigned int head = __atomic_load_n(&meter->range_head,
+					    __ATOMIC_ACQUIRE);
+	snd_pcm_uframes_t frames = 0;
+
+	if (tail == head)
+		return 0;
+	*ptr = meter->ranges[tail % METER_RANGES].ptr;
+	for (; tail != head; tail++)
+		frames += meter->ranges[tail % METER_RANGES].frames;
+	__atomic_store_n(&meter->range_tail, tail, __ATOMIC_RELEASE);
+	if (frames > meter->buf_size) {
+		/* older frames were overwritten in the meter buffer */
+		*ptr += frames - meter->buf_size;
+		if (*ptr >= pcm->boundary)
+			*ptr -= pcm->boundary;
+		frames = meter->buf_size;
 	}
-	if (locked)
-		pthread_mutex_unlock(&meter->update_mutex);
+	return frames;
 }
 
-static int snd_pcm_meter_update_scope(snd_pcm_t *pcm)
+static void snd_pcm_meter_update_main(snd_pcm_t *pcm)
 {
 	snd_pcm_meter_t *meter = pcm->private_data;
 	snd_pcm_sframes_t frames;
 	snd_pcm_uframes_t rptr, old_rptr;
 	const snd_pcm_channel_area_t *areas;
-	int reset = 0;
-	/* Wait main thread */
-	pthread_mutex_lock(&meter->update_mutex);
 	areas = snd_pcm_mmap_areas(pcm);
- _again:
 	rptr = *pcm->hw.ptr;
 	old_rptr = meter->rptr;
-	if (atomic_read(&meter->reset)) {
-		reset = 1;
-		atomic_dec(&meter->reset);
-		goto _again;
-	}
 	meter->rptr = rptr;
 	frames = rptr - old_rptr;
 	if (frames < 0)
@@ -149,9 +184,9 @@ static int snd_pcm_meter_update_scope(snd_pcm_t *pcm)
 		assert((snd_pcm_uframes_t) frames <= pcm->buffer_size);
 		snd_pcm_meter_add_frames(pcm, areas, old_rptr,
 					 (snd_pcm_uframes_t) frames);
+		snd_pcm_meter_push_range(meter, old_rptr,
+					 (snd_pcm_uframes_t) frames);
 	}
-	pthread_mutex_unlock(&meter->update_mutex);
-	return reset;
 }
 
 static int snd_pcm_scope_remove(snd_pcm_scope_t *scope)
@@ -187,6 +222,8 @@ static void *snd_pcm_meter_thread(void *data)
 	snd_pcm_t *spcm = meter->gen.slave;
 	struct list_head *pos;
 	snd_pcm_scope_t *scope;
+	snd_pcm_uframes_t range_ptr, range_frames;
+	unsigned int range_reset;
 	int reset;
 	list_for_each(pos, &meter->scopes) {
 		scope = list_entry(pos, snd_pcm_scope_t, list);
@@ -225,16 +262,18 @@ static void *snd_pcm_meter_thread(void *data)
 				now -= pcm->boundary;
 		}
 		meter->now = now;
-		if (pcm->stream == SND_PCM_STREAM_CAPTURE)
-			reset = snd_pcm_meter_update_scope(pcm);
-		else {
-			reset = 0;
-			while (atomic_read(&meter->reset)) {
-				reset = 1;
-				atomic_dec(&meter->reset);
-			}
+		reset = 0;
+		while (atomic_read(&meter->reset)) {
+			reset = 1;
+			atomic_dec(&meter->reset);
 		}
 		if (reset) {
+			/* the ranges published before prepare are stale */
+			range_reset = __atomic_load_n(&meter->range_reset,
+						      __ATOMIC_ACQUIRE);
+			if ((int)(range_reset - meter->range_tail) > 0)
+				__atomic_store_n(&meter->range_tail,
+						 range_reset, __ATOMIC_RELEASE);
 			list_for_each(pos, &meter->scopes) {
 				scope = list_entry(pos, snd_pcm_scope_t, list);
 				if (scope->enabled)
@@ -250,10 +289,14 @@ static void *snd_pcm_meter_thread(void *data)
 			}
 			meter->running = 1;
 		}
+		range_frames = snd_pcm_meter_pop_ranges(pcm, &range_ptr);
 		list_for_each(pos, &meter->scopes) {
 			scope = list_entry(pos, snd_pcm_scope_t, list);
-			if (scope->enabled)
-				scope->ops->update(scope);
+			if (!scope->enabled)
+				continue;
+			if (range_frames && scope->range)
+				scope->range(scope, range_ptr, range_frames);
+			scope->ops->update(scope);
 		}
 	        nanosleep(&meter->delay, NULL);
 	}
@@ -270,7 +313,6 @@ static int snd_pcm_meter_close(snd_pcm_t *pcm)
 	snd_pcm_meter_t *meter = pcm->private_data;
 	struct list_head *pos, *npos;
 	int err = 0;
-	pthread_mutex_destroy(&meter->update_mutex);
 	pthread_mutex_destroy(&meter->running_mutex);
 	pthread_cond_destroy(&meter->running_cond);
 	if (meter->gen.close_slave)
@@ -290,6 +332,9 @@ static int snd_pcm_meter_prepare(snd_pcm_t *pcm)
 {
 	snd_pcm_meter_t *meter = pcm->private_data;
 	int err;
+	meter->pending.frames = 0;
+	__atomic_store_n(&meter->range_reset, meter->range_head,
+			 __ATOMIC_RELEASE);
 	atomic_add(&meter->reset, 1);
 	err = snd_pcm_prepare(meter->gen.slave);
 	if (err >= 0) {
@@ -353,6 +398,7 @@ static snd_pcm_sframes_t snd_pcm_meter_mmap_commit(snd_pcm_t *pcm,
 		return result;
 	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
 		snd_pcm_meter_add_frames(pcm, snd_pcm_mmap_areas(pcm), old_rptr, result);
+		snd_pcm_meter_push_range(meter, old_rptr, result);
 		meter->rptr = *pcm->appl.ptr;
 	}
 	return result;
@@ -469,7 +515,7 @@ static int snd_pcm_meter_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 		a->step = slave->sample_bits;
 	}
 	meter->closed = 0;
-	err = pthread_create(&meter->thread, NULL, snd_pcm_meter_thread, pcm);
+	err = snd_thread_create(&meter->thread, NULL, snd_pcm_meter_thread, pcm);
 	assert(err == 0);
 	return 0;
 }
@@ -595,7 +641,6 @@ int snd_pcm_meter_open(snd_pcm_t **pcmp, const char *name, unsigned int frequenc
 	snd_pcm_link_appl_ptr(pcm, slave);
 	*pcmp = pcm;
 
-	pthread_mutex_init(&meter->update_mutex, NULL);
 	pthread_mutex_init(&meter->running_mutex, NULL);
 	pthread_cond_init(&meter->running_cond, NULL);
 	return 0;
@@ -729,6 +774,19 @@ pcm.name {
 }
 \endcode
 
+The built-in <code>peak</code> scope type measures the peak and RMS
+level of every channel on CPU endian S16, S32 or FLOAT frames without
+converting them.  With an <code>ipc_key</code> the results are kept in
+a shared memory segment (see #snd_pcm_scope_peak_info_t), so level
+meters in other processes can read them without opening the PCM.
+
+\code
+pcm_scope.name {
+	type peak
+	[ipc_key INT]		# Shared memory key for the results
+}
+\endcode
+
 \subsection pcm_plugins_meter_funcref Function reference
 
 <UL>
@@ -971,6 +1029,20 @@ void snd_pcm_scope_set_ops(snd_pcm_scope_t *scope, const snd_pcm_scope_ops_t *va
 	scope->ops = val;
 }
 
+/**
+ * \brief Set the batched update callback for a #SND_PCM_TYPE_METER PCM scope
+ * \param scope PCM meter scope
+ * \param val callback, or NULL
+ *
+ * Before each update callback, the callback gets the span of frames
+ * added to the meter buffer since the previous call, if any.
+ */
+void snd_pcm_scope_set_range_callback(snd_pcm_scope_t *scope,
+				      snd_pcm_scope_range_callback_t val)
+{
+	scope->range = val;
+}
+
 /**
  * \brief Get callbacks private value for a #SND_PCM_TYPE_METER PCM scope
  * \param scope PCM meter scope
@@ -1218,6 +1290,336 @@ int16_t *snd_pcm_scope_s16_get_channel_buffer(snd_pcm_scope_t *scope,
 	return s16->buf_areas[channel].addr;
 }
 
+#ifndef DOC_HIDDEN
+#define PEAK_LANES 8
+
+typedef struct _snd_pcm_scope_peak {
+	snd_pcm_t *pcm;
+	snd_pcm_uframes_t old;
+	key_t ipc_key;
+	int shmid;
+	snd_pcm_scope_peak_info_t *info;	/* header, peaks, rms */
+} snd_pcm_scope_peak_t;
+
+/*
+ * The meter buffer keeps each channel contiguous, so the kernels walk
+ * plain sample arrays.  They keep PEAK_LANES partial results, which lets
+ * the compiler vectorize the loops without reassociating float sums.
+ */
+static void peak_s16(const int16_t *src, snd_pcm_uframes_t n,
+		     float *peak, float *sum)
+{
+	int max[PEAK_LANES] = { 0 };
+	float acc[PEAK_LANES] = { 0 };
+	unsigned int j;
+	for (; n >= PEAK_LANES; n -= PEAK_LANES, src += PEAK_LANES) {
+		for (j = 0; j < PEAK_LANES; j++) {
+			int x = src[j];
+			int a = x < 0 ? -x : x;
+			float f = x;
+			max[j] = a > max[j] ? a : max[j];
+			acc[j] += f * f;
+		}
+	}
+	for (j = 0; j < n; j++) {
+		int x = src[j];
+		int a = x < 0 ? -x : x;
+		max[j] = a > max[j] ? a : max[j];
+		acc[j] += (float)x * x;
+	}
+	for (j = 0; j < PEAK_LANES; j++) {
+		float p = max[j] / 32768.0f;
+		*peak = p > *peak ? p : *peak;
+		*sum += acc[j] / (32768.0f * 32768.0f);
+	}
+}
+
+static void peak_s32(const int32_t *src, snd_pcm_uframes_t n,
+		     float *peak, float *sum)
+{
+	/* x ^ (x >> 31) is |x| - 1 for negatives, but never overflows */
+	int32_t max[PEAK_LANES] = { 0 };
+	float acc[PEAK_LANES] = { 0 };
+	unsigned int j;
+	for (; n >= PEAK_LANES; n -= PEAK_LANES, src += PEAK_LANES) {
+		for (j = 0; j < PEAK_LANES; j++) {
+			int32_t x = src[j];
+			int32_t a = x ^ (x >> 31);
+			float f = x * (1.0f / 2147483648.0f);
+			max[j] = a > max[j] ? a : max[j];
+			acc[j] += f * f;
+		}
+	}
+	for (j = 0; j < n; j++) {
+		int32_t x = src[j];
+		int32_t a = x ^ (x >> 31);
+		float f = x * (1.0f / 2147483648.0f);
+		max[j] = a > max[j] ? a : max[j];
+		acc[j] += f * f;
+	}
+	for (j = 0; j < PEAK_LANES; j++) {
+		float p = max[j] / 2147483648.0f;
+		*peak = p > *peak ? p : *peak;
+		*sum += acc[j];
+	}
+}
+
+static void peak_float(const float *src, snd_pcm_uframes_t n,
+		       float *peak, float *sum)
+{
+	float max[PEAK_LANES] = { 0 };
+	float acc[PEAK_LANES] = { 0 };
+	unsigned int j;
+	for (; n >= PEAK_LANES; n -= PEAK_LANES, src += PEAK_LANES) {
+		for (j = 0; j < PEAK_LANES; j++) {
+			float x = src[j];
+			float a = x < 0 ? -x : x;
+			max[j] = a > max[j] ? a : max[j];
+			acc[j] += x * x;
+		}
+	}
+	for (j = 0; j < n; j++) {
+		float x = src[j];
+		float a = x < 0 ? -x : x;
+		max[j] = a > max[j] ? a : max[j];
+		acc[j] += x * x;
+	}
+	for (j = 0; j < PEAK_LANES; j++) {
+		*peak = max[j] > *peak ? max[j] : *peak;
+		*sum += acc[j];
+	}
+}
+
+static void peak_run(snd_pcm_format_t format, const void *src,
+		     snd_pcm_uframes_t n, float *peak, float *sum)
+{
+	switch (format) {
+	case SND_PCM_FORMAT_S16:
+		peak_s16(src, n, peak, sum);
+		break;
+	case SND_PCM_FORMAT_S32:
+		peak_s32(src, n, peak, sum);
+		break;
+	default:
+		peak_float(src, n, peak, sum);
+		break;
+	}
+}
+
+static size_t peak_info_size(unsigned int channels)
+{
+	return sizeof(snd_pcm_scope_peak_info_t) + 2 * channels * sizeof(float);
+}
+
+static int peak_enable(snd_pcm_scope_t *scope)
+{
+	snd_pcm_scope_peak_t *peak = scope->private_data;
+	snd_pcm_meter_t *meter = peak->pcm->private_data;
+	snd_pcm_t *spcm = meter->gen.slave;
+	size_t size = peak_info_size(spcm->channels);
+	switch (spcm->format) {
+	case SND_PCM_FORMAT_S16:
+	case SND_PCM_FORMAT_S32:
+	case SND_PCM_FORMAT_FLOAT:
+		break;
+	default:
+		SNDERR("peak scope: format %s is not supported",
+		       snd_pcm_format_name(spcm->format));
+		return -EINVAL;
+	}
+	if (peak->ipc_key) {
+		peak->shmid = shmget(peak->ipc_key, size, IPC_CREAT | 0644);
+		if (peak->shmid < 0) {
+			SYSERR("peak scope: shmget failed");
+			return -errno;
+		}
+		peak->info = shmat(peak->shmid, NULL, 0);
+		if (peak->info == (void *) -1) {
+			SYSERR("peak scope: shmat failed");
+			peak->info = NULL;
+			shmctl(peak->shmid, IPC_RMID, NULL);
+			return -errno;
+		}
+		memset(peak->info, 0, size);
+	} else {
+		peak->info = calloc(1, size);
+		if (!peak->info)
+			return -ENOMEM;
+	}
+	peak->info->channels = spcm->channels;
+	return 0;
+}
+
+static void peak_disable(snd_pcm_scope_t *scope)
+{
+	snd_pcm_scope_peak_t *peak = scope->private_data;
+	if (peak->ipc_key) {
+		shmdt(peak->info);
+		shmctl(peak->shmid, IPC_RMID, NULL);
+	} else
+		free(peak->info);
+	peak->info = NULL;
+}
+
+static void peak_close(snd_pcm_scope_t *scope)
+{
+	free(scope->private_data);
+}
+
+static void peak_start(snd_pcm_scope_t *scope ATTRIBUTE_UNUSED)
+{
+}
+
+static void peak_stop(snd_pcm_scope_t *scope ATTRIBUTE_UNUSED)
+{
+}
+
+static void peak_update(snd_pcm_scope_t *scope)
+{
+	snd_pcm_scope_peak_t *peak = scope->private_data;
+	snd_pcm_meter_t *meter = peak->pcm->private_data;
+	snd_pcm_t *spcm = meter->gen.slave;
+	snd_pcm_scope_peak_info_t *info = peak->info;
+	unsigned int c, channels = spcm->channels;
+	float *peaks = (float *)(info + 1), *rms = peaks + channels;
+	snd_pcm_sframes_t size;
+	snd_pcm_uframes_t offset, size1;
+	size = meter->now - peak->old;
+	if (size < 0)
+		size += spcm->boundary;
+	if (size == 0)
+		return;
+	if ((snd_pcm_uframes_t) size > meter->buf_size)
+		size = meter->buf_size;
+	offset = (meter->now - size) % meter->buf_size;
+	size1 = meter->buf_size - offset;
+	if (size1 > (snd_pcm_uframes_t) size)
+		size1 = size;
+	/* odd while the values are changing */
+	__atomic_store_n(&info->seq, info->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	for (c = 0; c < channels; c++) {
+		const char *src = meter->buf_areas[c].addr;
+		unsigned int bytes = spcm->sample_bits / 8;
+		float p = 0, sum = 0;
+		peak_run(spcm->format, src + offset * bytes, size1, &p, &sum);
+		if ((snd_pcm_uframes_t) size > size1)
+			peak_run(spcm->format, src, size - size1, &p, &sum);
+		peaks[c] = p;
+		rms[c] = sqrtf(sum / size);
+	}
+	info->frames = size;
+	__atomic_store_n(&info->seq, info->seq + 1, __ATOMIC_RELEASE);
+	peak->old = meter->now;
+}
+
+static void peak_reset(snd_pcm_scope_t *scope)
+{
+	snd_pcm_scope_peak_t *peak = scope->private_data;
+	snd_pcm_meter_t *meter = peak->pcm->private_data;
+	peak->old = meter->now;
+}
+
+static const snd_pcm_scope_ops_t peak_ops = {
+	.enable = peak_enable,
+	.disable = peak_disable,
+	.close = peak_close,
+	.start = peak_start,
+	.stop = peak_stop,
+	.update = peak_update,
+	.reset = peak_reset,
+};
+
+#endif
+
+/**
+ * \brief Add a peak/RMS scope to a #SND_PCM_TYPE_METER PCM
+ * \param pcm The pcm handle
+ * \param name Scope name
+ * \param ipc_key SysV shared memory key for the results, 0 for private memory
+ * \param scopep Pointer to newly created and added scope
+ * \return 0 on success otherwise a negative error code
+ *
+ * The peak scope measures the peak and RMS level of each channel since its
+ * previous update, directly on CPU endian S16, S32 or FLOAT frames.  The
+ * results are kept in a #snd_pcm_scope_peak_info_t block; with an ipc_key,
+ * the block is a shared memory segment which other processes can attach to
+ * read the levels without opening the PCM.
+ */
+int snd_pcm_scope_peak_open(snd_pcm_t *pcm, const char *name, long ipc_key,
+			    snd_pcm_scope_t **scopep)
+{
+	snd_pcm_meter_t *meter;
+	snd_pcm_scope_t *scope;
+	snd_pcm_scope_peak_t *peak;
+	assert(pcm->type == SND_PCM_TYPE_METER);
+	meter = pcm->private_data;
+	scope = calloc(1, sizeof(*scope));
+	if (!scope)
+		return -ENOMEM;
+	peak = calloc(1, sizeof(*peak));
+	if (!peak) {
+		free(scope);
+		return -ENOMEM;
+	}
+	if (name)
+		scope->name = strdup(name);
+	peak->pcm = pcm;
+	peak->ipc_key = ipc_key;
+	scope->ops = &peak_ops;
+	scope->private_data = peak;
+	list_add_tail(&scope->list, &meter->scopes);
+	*scopep = scope;
+	return 0;
+}
+
+/**
+ * \brief Get the results block of a peak scope
+ * \param scope peak scope handle
+ * \return The block, or NULL while the scope is not enabled
+ *
+ * The block is followed by the peak values of all channels and then by
+ * their RMS values, as floats with 1.0 for full scale.
+ */
+const snd_pcm_scope_peak_info_t *snd_pcm_scope_peak_get_info(snd_pcm_scope_t *scope)
+{
+	snd_pcm_scope_peak_t *peak;
+	assert(scope->ops == &peak_ops);
+	peak = scope->private_data;
+	return peak->info;
+}
+
+#ifndef DOC_HIDDEN
+int _snd_pcm_scope_peak_open(snd_pcm_t *pcm, const char *name,
+			     snd_config_t *root ATTRIBUTE_UNUSED,
+			     snd_config_t *conf)
+{
+	snd_config_iterator_t i, next;
+	snd_pcm_scope_t *scope;
+	long ipc_key = 0;
+	snd_config_for_each(i, next, conf) {
+		snd_config_t *n = snd_config_iterator_entry(i);
+		const char *id;
+		if (snd_config_get_id(n, &id) < 0)
+			continue;
+		if (strcmp(id, "comment") == 0)
+			continue;
+		if (strcmp(id, "type") == 0)
+			continue;
+		if (strcmp(id, "ipc_key") == 0) {
+			if (snd_config_get_integer(n, &ipc_key) < 0) {
+				SNDERR("Invalid type for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
+		SNDERR("Unknown field %s", id);
+		return -EINVAL;
+	}
+	return snd_pcm_scope_peak_open(pcm, name, ipc_key, &scope);
+}
+#endif
+
 /**
  * \brief allocate an invalid #snd_pcm_scope_t using standard malloc
  * \param ptr returned pointer
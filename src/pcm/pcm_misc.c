@@ -27,6 +27,100 @@
 #include "pcm_local.h"
 
 
+#ifdef SNDRV_LITTLE_ENDIAN
+#define SILENCE_U16_LE		0x8000800080008000ULL
+#define SILENCE_U16_BE		0x0080008000800080ULL
+#define SILENCE_U24_LE		0x0080000000800000ULL
+#define SILENCE_U24_BE		0x0000800000008000ULL
+#define SILENCE_U32_LE		0x8000000080000000ULL
+#define SILENCE_U32_BE		0x0000008000000080ULL
+#define SILENCE_U24_3LE		0x0000800000800000ULL
+#define SILENCE_U24_3BE		0x0080000080000080ULL
+#define SILENCE_U20_3LE		0x0000080000080000ULL
+#define SILENCE_U20_3BE		0x0008000008000008ULL
+#define SILENCE_U18_3LE		0x0000020000020000ULL
+#define SILENCE_U18_3BE		0x0002000002000002ULL
+#else
+#define SILENCE_U16_LE		0x0080008000800080ULL
+#define SILENCE_U16_BE		0x8000800080008000ULL
+#define SILENCE_U24_LE		0x0000800000008000ULL
+#define SILENCE_U24_BE		0x0080000000800000ULL
+#define SILENCE_U32_LE		0x0000008000000080ULL
+#define SILENCE_U32_BE		0x8000000080000000ULL
+#define SILENCE_U24_3LE		0x0080000080000080ULL
+#define SILENCE_U24_3BE		0x0000800000800000ULL
+#define SILENCE_U20_3LE		0x0008000008000008ULL
+#define SILENCE_U20_3BE		0x0000080000080000ULL
+#define SILENCE_U18_3LE		0x0002000002000002ULL
+#define SILENCE_U18_3BE		0x0000020000020000ULL
+#endif
+
+#define LIN	(SND_PCM_FMTF_LINEAR | SND_PCM_FMTF_SILENCE)
+#define SIG	(LIN | SND_PCM_FMTF_SIGNED)
+#define LE	(SND_PCM_FMTF_ENDIAN | SND_PCM_FMTF_LE)
+#define BE	SND_PCM_FMTF_ENDIAN
+#define FLT	(SND_PCM_FMTF_FLOAT | SND_PCM_FMTF_SILENCE)
+#define SIL	SND_PCM_FMTF_SILENCE
+
+#define FORMAT(fmt, w, pw, fl, sil) \
+	[SNDRV_PCM_FORMAT_##fmt] = { .silence = (sil), .width = (w), \
+				     .phys_width = (pw), .flags = (fl) }
+
+/* the zero bit patterns of the floats are positive zeros */
+const snd_pcm_format_desc_t snd_pcm_format_descs[SND_PCM_FORMAT_LAST + 2] = {
+	FORMAT(S8, 8, 8, SIG, 0),
+	FORMAT(U8, 8, 8, LIN, 0x8080808080808080ULL),
+	FORMAT(S16_LE, 16, 16, SIG | LE, 0),
+	FORMAT(S16_BE, 16, 16, SIG | BE, 0),
+	FORMAT(U16_LE, 16, 16, LIN | LE, SILENCE_U16_LE),
+	FORMAT(U16_BE, 16, 16, LIN | BE, SILENCE_U16_BE),
+	FORMAT(S24_LE, 24, 32, SIG | LE, 0),
+	FORMAT(S24_BE, 24, 32, SIG | BE, 0),
+	FORMAT(U24_LE, 24, 32, LIN | LE, SILENCE_U24_LE),
+	FORMAT(U24_BE, 24, 32, LIN | BE, SILENCE_U24_BE),
+	FORMAT(S32_LE, 32, 32, SIG | LE, 0),
+	FORMAT(S32_BE, 32, 32, SIG | BE, 0),
+	FORMAT(U32_LE, 32, 32, LIN | LE, SILENCE_U32_LE),
+	FORMAT(U32_BE, 32, 32, LIN | BE, SILENCE_U32_BE),
+	FORMAT(FLOAT_LE, 32, 32, FLT | LE, 0),
+	FORMAT(FLOAT_BE, 32, 32, FLT | BE, 0),
+	FORMAT(FLOAT64_LE, 64, 64, FLT | LE, 0),
+	FORMAT(FLOAT64_BE, 64, 64, FLT | BE, 0),
+	FORMAT(IEC958_SUBFRAME_LE, 32, 32, SIL | LE, 0),
+	FORMAT(IEC958_SUBFRAME_BE, 32, 32, SIL | BE, 0),
+	FORMAT(MU_LAW, 8, 8, SIL, 0x7f7f7f7f7f7f7f7fULL),
+	FORMAT(A_LAW, 8, 8, SIL, 0x5555555555555555ULL),
+	FORMAT(IMA_ADPCM, 4, 4, SIL, 0),
+	FORMAT(MPEG, 0, 0, SIL, 0),
+	FORMAT(GSM, 0, 0, SIL, 0),
+	FORMAT(SPECIAL, 0, 0, SIL, 0),
+	FORMAT(S24_3LE, 24, 24, SIG | LE, 0),
+	FORMAT(S24_3BE, 24, 24, SIG | BE, 0),
+	FORMAT(U24_3LE, 24, 24, LIN | LE, SILENCE_U24_3LE),
+	FORMAT(U24_3BE, 24, 24, LIN | BE, SILENCE_U24_3BE),
+	FORMAT(S20_3LE, 20, 24, SIG | LE, 0),
+	FORMAT(S20_3BE, 20, 24, SIG | BE, 0),
+	FORMAT(U20_3LE, 20, 24, LIN | LE, SILENCE_U20_3LE),
+	FORMAT(U20_3BE, 20, 24, LIN | BE, SILENCE_U20_3BE),
+	FORMAT(S18_3LE, 18, 24, SIG | LE, 0),
+	FORMAT(S18_3BE, 18, 24, SIG | BE, 0),
+	FORMAT(U18_3LE, 18, 24, LIN | LE, SILENCE_U18_3LE),
+	FORMAT(U18_3BE, 18, 24, LIN | BE, SILENCE_U18_3BE),
+	FORMAT(DSD_U8, 8, 8, LIN, 0x6969696969696969ULL),
+	FORMAT(DSD_U16_LE, 16, 16, LIN | LE, 0x6969696969696969ULL),
+	FORMAT(DSD_U32_LE, 32, 32, LIN | LE, 0x6969696969696969ULL),
+	FORMAT(DSD_U16_BE, 16, 16, LIN | BE, 0x6969696969696969ULL),
+	FORMAT(DSD_U32_BE, 32, 32, LIN | BE, 0x6969696969696969ULL),
+};
+
+#undef LIN
+#undef SIG
+#undef LE
+#undef BE
+#undef FLT
+#undef SIL
+#undef FORMAT
+
 /**
  * \brief Return sign info for a PCM sample linear format
  * \param format Format
@@ -34,43 +128,7 @@
  */
 int snd_pcm_format_signed(snd_pcm_format_t format)
 {
-	switch (format) {
-	case SNDRV_PCM_FORMAT_S8:
-	case SNDRV_PCM_FORMAT_S16_LE:
-	case SNDRV_PCM_FORMAT_S16_BE:
-	case SNDRV_PCM_FORMAT_S24_LE:
-	case SNDRV_PCM_FORMAT_S24_BE:
-	case SNDRV_PCM_FORMAT_S32_LE:
-	case SNDRV_PCM_FORMAT_S32_BE:
-	case SNDRV_PCM_FORMAT_S24_3LE:
-	case SNDRV_PCM_FORMAT_S24_3BE:
-	case SNDRV_PCM_FORMAT_S20_3LE:
-	case SNDRV_PCM_FORMAT_S20_3BE:
-	case SNDRV_PCM_FORMAT_S18_3LE:
-	case SNDRV_PCM_FORMAT_S18_3BE:
-		return 1;
-	case SNDRV_PCM_FORMAT_U8:
-	case SNDRV_PCM_FORMAT_U16_LE:
-	case SNDRV_PCM_FORMAT_U16_BE:
-	case SNDRV_PCM_FORMAT_U24_LE:
-	case SNDRV_PCM_FORMAT_U24_BE:
-	case SNDRV_PCM_FORMAT_U32_LE:
-	case SNDRV_PCM_FORMAT_U32_BE:
-	case SNDRV_PCM_FORMAT_U24_3LE:
-	case SNDRV_PCM_FORMAT_U24_3BE:
-	case SNDRV_PCM_FORMAT_U20_3LE:
-	case SNDRV_PCM_FORMAT_U20_3BE:
-	case SNDRV_PCM_FORMAT_U18_3LE:
-	case SNDRV_PCM_FORMAT_U18_3BE:
-	case SNDRV_PCM_FORMAT_DSD_U8:
-	case SNDRV_PCM_FORMAT_DSD_U16_LE:
-	case SNDRV_PCM_FORMAT_DSD_U32_LE:
-	case SNDRV_PCM_FORMAT_DSD_U16_BE:
-	case SNDRV_PCM_FORMAT_DSD_U32_BE:
-		return 0;
-	default:
-		return -EINVAL;
-	}
+	return __snd_pcm_format_signed(format);
 }
 
 /**
@@ -82,7 +140,7 @@ int snd_pcm_format_unsigned(snd_pcm_format_t format)
 {
 	int val;
 
-	val = snd_pcm_format_signed(format);
+	val = __snd_pcm_format_signed(format);
 	if (val < 0)
 		return val;
 	return !val;
@@ -95,7 +153,7 @@ int snd_pcm_format_unsigned(snd_pcm_format_t format)
  */
 int snd_pcm_format_linear(snd_pcm_format_t format)
 {
-	return snd_pcm_format_signed(format) >= 0;
+	return !!(snd_pcm_format_desc(format)->flags & SND_PCM_FMTF_LINEAR);
 }
 
 /**
@@ -105,15 +163,7 @@ int snd_pcm_format_linear(snd_pcm_format_t format)
  */
 int snd_pcm_format_float(snd_pcm_format_t format)
 {
-	switch (format) {
-	case SNDRV_PCM_FORMAT_FLOAT_LE:
-	case SNDRV_PCM_FORMAT_FLOAT_BE:
-	case SNDRV_PCM_FORMAT_FLOAT64_LE:
-	case SNDRV_PCM_FORMAT_FLOAT64_BE:
-		return 1;
-	default:
-		return 0;
-	}
+	return !!(snd_pcm_format_desc(format)->flags & SND_PCM_FMTF_FLOAT);
 }
 
 /**
@@ -123,46 +173,7 @@ int snd_pcm_format_float(snd_pcm_format_t format)
  */
 int snd_pcm_format_little_endian(snd_pcm_format_t format)
 {
-	switch (format) {
-	case SNDRV_PCM_FORMAT_S16_LE:
-	case SNDRV_PCM_FORMAT_U16_LE:
-	case SNDRV_PCM_FORMAT_S24_LE:
-	case SNDRV_PCM_FORMAT_U24_LE:
-	case SNDRV_PCM_FORMAT_S32_LE:
-	case SNDRV_PCM_FORMAT_U32_LE:
-	case SNDRV_PCM_FORMAT_FLOAT_LE:
-	case SNDRV_PCM_FORMAT_FLOAT64_LE:
-	case SNDRV_PCM_FORMAT_IEC958_SUBFRAME_LE:
-	case SNDRV_PCM_FORMAT_S24_3LE:
-	case SNDRV_PCM_FORMAT_S20_3LE:
-	case SNDRV_PCM_FORMAT_S18_3LE:
-	case SNDRV_PCM_FORMAT_U24_3LE:
-	case SNDRV_PCM_FORMAT_U20_3LE:
-	case SNDRV_PCM_FORMAT_U18_3LE:
-	case SNDRV_PCM_FORMAT_DSD_U16_LE:
-	case SNDRV_PCM_FORMAT_DSD_U32_LE:
-		return 1;
-	case SNDRV_PCM_FORMAT_S16_BE:
-	case SNDRV_PCM_FORMAT_U16_BE:
-	case SNDRV_PCM_FORMAT_S24_BE:
-	case SNDRV_PCM_FORMAT_U24_BE:
-	case SNDRV_PCM_FORMAT_S32_BE:
-	case SNDRV_PCM_FORMAT_U32_BE:
-	case SNDRV_PCM_FORMAT_FLOAT_BE:
-	case SNDRV_PCM_FORMAT_FLOAT64_BE:
-	case SNDRV_PCM_FORMAT_IEC958_SUBFRAME_BE:
-	case SNDRV_PCM_FORMAT_S24_3BE:
-	case SNDRV_PCM_FORMAT_S20_3BE:
-	case SNDRV_PCM_FORMAT_S18_3BE:
-	case SNDRV_PCM_FORMAT_U24_3BE:
-	case SNDRV_PCM_FORMAT_U20_3BE:
-	case SNDRV_PCM_FORMAT_U18_3BE:
-	case SNDRV_PCM_FORMAT_DSD_U16_BE:
-	case SNDRV_PCM_FORMAT_DSD_U32_BE:
-		return 0;
-	default:
-		return -EINVAL;
-	}
+	return __snd_pcm_format_little_endian(format);
 }
 
 /**
@@ -174,7 +185,7 @@ int snd_pcm_format_big_endian(snd_pcm_format_t format)
 {
 	int val;
 
-	val = snd_pcm_format_little_endian(format);
+	val = __snd_pcm_format_little_endian(format);
 	if (val < 0)
 		return val;
 	return !val;
@@ -201,60 +212,7 @@ int snd_pcm_format_cpu_endian(snd_pcm_format_t format)
  */
 int snd_pcm_format_width(snd_pcm_format_t format)
 {
-	switch (format) {
-	case SNDRV_PCM_FORMAT_S8:
-	case SNDRV_PCM_FORMAT_U8:
-	case SNDRV_PCM_FORMAT_DSD_U8:
-		return 8;
-	case SNDRV_PCM_FORMAT_S16_LE:
-	case SNDRV_PCM_FORMAT_S16_BE:
-	case SNDRV_PCM_FORMAT_U16_LE:
-	case SNDRV_PCM_FORMAT_U16_BE:
-	case SNDRV_PCM_FORMAT_DSD_U16_LE:
-	case SNDRV_PCM_FORMAT_DSD_U16_BE:
-		return 16;
-	case SNDRV_PCM_FORMAT_S18_3LE:
-	case SNDRV_PCM_FORMAT_S18_3BE:
-	case SNDRV_PCM_FORMAT_U18_3LE:
-	case SNDRV_PCM_FORMAT_U18_3BE:
-		return 18;
-	case SNDRV_PCM_FORMAT_S20_3LE:
-	case SNDRV_PCM_FORMAT_S20_3BE:
-	case SNDRV_PCM_FORMAT_U20_3LE:
-	case SNDRV_PCM_FORMAT_U20_3BE:
-		return 20;
-	case SNDRV_PCM_FORMAT_S24_LE:
-	case SNDRV_PCM_FORMAT_S24_BE:
-	case SNDRV_PCM_FORMAT_U24_LE:
-	case SNDRV_PCM_FORMAT_U24_BE:
-	case SNDRV_PCM_FORMAT_S24_3LE:
-	case SNDRV_PCM_FORMAT_S24_3BE:
-	case SNDRV_PCM_FORMAT_U24_3LE:
-	case SNDRV_PCM_FORMAT_U24_3BE:
-		return 24;
-	case SNDRV_PCM_FORMAT_S32_LE:
-	case SNDRV_PCM_FORMAT_S32_BE:
-	case SNDRV_PCM_FORMAT_U32_LE:
-	case SNDRV_PCM_FORMAT_U32_BE:
-	case SNDRV_PCM_FORMAT_FLOAT_LE:
-	case SNDRV_PCM_FORMAT_FLOAT_BE:
-	case SNDRV_PCM_FORMAT_DSD_U32_LE:
-	case SNDRV_PCM_FORMAT_DSD_U32_BE:
-		return 32;
-	case SNDRV_PCM_FORMAT_FLOAT64_LE:
-	case SNDRV_PCM_FORMAT_FLOAT64_BE:
-		return 64;
-	case SNDRV_PCM_FORMAT_IEC958_SUBFRAME_LE:
-	case SNDRV_PCM_FORMAT_IEC958_SUBFRAME_BE:
-		return 32;
-	case SNDRV_PCM_FORMAT_MU_LAW:
-	case SNDRV_PCM_FORMAT_A_LAW:
-		return 8;
-	case SNDRV_PCM_FORMAT_IMA_ADPCM:
-		return 4;
-	default:
-		return -EINVAL;
-	}
+	return __snd_pcm_format_width(format);
 }
 
 /**
@@ -264,57 +222,7 @@ int snd_pcm_format_width(snd_pcm_format_t format)
  */
 int snd_pcm_format_physical_width(snd_pcm_format_t format)
 {
-	switch (format) {
-	case SNDRV_PCM_FORMAT_S8:
-	case SNDRV_PCM_FORMAT_U8:
-	case SNDRV_PCM_FORMAT_DSD_U8:
-		return 8;
-	case SNDRV_PCM_FORMAT_S16_LE:
-	case SNDRV_PCM_FORMAT_S16_BE:
-	case SNDRV_PCM_FORMAT_U16_LE:
-	case SNDRV_PCM_FORMAT_U16_BE:
-	case SNDRV_PCM_FORMAT_DSD_U16_LE:
-	case SNDRV_PCM_FORMAT_DSD_U16_BE:
-		return 16;
-	case SNDRV_PCM_FORMAT_S18_3LE:
-	case SNDRV_PCM_FORMAT_S18_3BE:
-	case SNDRV_PCM_FORMAT_U18_3LE:
-	case SNDRV_PCM_FORMAT_U18_3BE:
-	case SNDRV_PCM_FORMAT_S20_3LE:
-	case SNDRV_PCM_FORMAT_S20_3BE:
-	case SNDRV_PCM_FORMAT_U20_3LE:
-	case SNDRV_PCM_FORMAT_U20_3BE:
-	case SNDRV_PCM_FORMAT_S24_3LE:
-	case SNDRV_PCM_FORMAT_S24_3BE:
-	case SNDRV_PCM_FORMAT_U24_3LE:
-	case SNDRV_PCM_FORMAT_U24_3BE:
-		return 24;
-	case SNDRV_PCM_FORMAT_S24_LE:
-	case SNDRV_PCM_FORMAT_S24_BE:
-	case SNDRV_PCM_FORMAT_U24_LE:
-	case SNDRV_PCM_FORMAT_U24_BE:
-	case SNDRV_PCM_FORMAT_S32_LE:
-	case SNDRV_PCM_FORMAT_S32_BE:
-	case SNDRV_PCM_FORMAT_U32_LE:
-	case SNDRV_PCM_FORMAT_U32_BE:
-	case SNDRV_PCM_FORMAT_FLOAT_LE:
-	case SNDRV_PCM_FORMAT_FLOAT_BE:
-	case SNDRV_PCM_FORMAT_IEC958_SUBFRAME_LE:
-	case SNDRV_PCM_FORMAT_IEC958_SUBFRAME_BE:
-	case SNDRV_PCM_FORMAT_DSD_U32_LE:
-	case SNDRV_PCM_FORMAT_DSD_U32_BE:
-		return 32;
-	case SNDRV_PCM_FORMAT_FLOAT64_LE:
-	case SNDRV_PCM_FORMAT_FLOAT64_BE:
-		return 64;
-	case SNDRV_PCM_FORMAT_MU_LAW:
-	case SNDRV_PCM_FORMAT_A_LAW:
-		return 8;
-	case SNDRV_PCM_FORMAT_IMA_ADPCM:
-		return 4;
-	default:
-		return -EINVAL;
-	}
+	return __snd_pcm_format_physical_width(format);
 }
 
 /**
@@ -325,60 +233,18 @@ int snd_pcm_format_physical_width(snd_pcm_format_t format)
  */
 ssize_t snd_pcm_format_size(snd_pcm_format_t format, size_t samples)
 {
-	switch (format) {
-	case SNDRV_PCM_FORMAT_S8:
-	case SNDRV_PCM_FORMAT_U8:
-	case SNDRV_PCM_FORMAT_DSD_U8:
-		return samples;
-	case SNDRV_PCM_FORMAT_S16_LE:
-	case SNDRV_PCM_FORMAT_S16_BE:
-	case SNDRV_PCM_FORMAT_U16_LE:
-	case SNDRV_PCM_FORMAT_U16_BE:
-	case SNDRV_PCM_FORMAT_DSD_U16_LE:
-	case SNDRV_PCM_FORMAT_DSD_U16_BE:
-		return samples * 2;
-	case SNDRV_PCM_FORMAT_S18_3LE:
-	case SNDRV_PCM_FORMAT_S18_3BE:
-	case SNDRV_PCM_FORMAT_U18_3LE:
-	case SNDRV_PCM_FORMAT_U18_3BE:
-	case SNDRV_PCM_FORMAT_S20_3LE:
-	case SNDRV_PCM_FORMAT_S20_3BE:
-	case SNDRV_PCM_FORMAT_U20_3LE:
-	case SNDRV_PCM_FORMAT_U20_3BE:
-	case SNDRV_PCM_FORMAT_S24_3LE:
-	case SNDRV_PCM_FORMAT_S24_3BE:
-	case SNDRV_PCM_FORMAT_U24_3LE:
-	case SNDRV_PCM_FORMAT_U24_3BE:
-		return samples * 3;
-	case SNDRV_PCM_FORMAT_S24_LE:
-	case SNDRV_PCM_FORMAT_S24_BE:
-	case SNDRV_PCM_FORMAT_U24_LE:
-	case SNDRV_PCM_FORMAT_U24_BE:
-	case SNDRV_PCM_FORMAT_S32_LE:
-	case SNDRV_PCM_FORMAT_S32_BE:
-	case SNDRV_PCM_FORMAT_U32_LE:
-	case SNDRV_PCM_FORMAT_U32_BE:
-	case SNDRV_PCM_FORMAT_FLOAT_LE:
-	case SNDRV_PCM_FORMAT_FLOAT_BE:
-	case SNDRV_PCM_FORMAT_DSD_U32_LE:
-	case SNDRV_PCM_FORMAT_DSD_U32_BE:
-		return samples * 4;
-	case SNDRV_PCM_FORMAT_FLOAT64_LE:
-	case SNDRV_PCM_FORMAT_FLOAT64_BE:
-		return samples * 8;
-	case SNDRV_PCM_FORMAT_IEC958_SUBFRAME_LE:
-	case SNDRV_PCM_FORMAT_IEC958_SUBFRAME_BE:
-		return samples * 4;
-	case SNDRV_PCM_FORMAT_MU_LAW:
-	case SNDRV_PCM_FORMAT_A_LAW:
-		return samples;
-	case SNDRV_PCM_FORMAT_IMA_ADPCM:
+	int width = snd_pcm_format_desc(format)->phys_width;
+
+	switch (width) {
+	case 0:
+		assert(0);
+		return -EINVAL;
+	case 4:
 		if (samples & 1)
 			return -EINVAL;
 		return samples / 2;
 	default:
-		assert(0);
-		return -EINVAL;
+		return samples * (width / 8);
 	}
 }
 
@@ -389,149 +255,7 @@ ssize_t snd_pcm_format_size(snd_pcm_format_t format, size_t samples)
  */
 u_int64_t snd_pcm_format_silence_64(snd_pcm_format_t format)
 {
-	switch (format) {
-	case SNDRV_PCM_FORMAT_S8:
-	case SNDRV_PCM_FORMAT_S16_LE:
-	case SNDRV_PCM_FORMAT_S16_BE:
-	case SNDRV_PCM_FORMAT_S24_LE:
-	case SNDRV_PCM_FORMAT_S24_BE:
-	case SNDRV_PCM_FORMAT_S32_LE:
-	case SNDRV_PCM_FORMAT_S32_BE:
-	case SNDRV_PCM_FORMAT_S24_3LE:
-	case SNDRV_PCM_FORMAT_S24_3BE:
-	case SNDRV_PCM_FORMAT_S20_3LE:
-	case SNDRV_PCM_FORMAT_S20_3BE:
-	case SNDRV_PCM_FORMAT_S18_3LE:
-	case SNDRV_PCM_FORMAT_S18_3BE:
-		return 0;
-	case SNDRV_PCM_FORMAT_U8:
-		return 0x8080808080808080ULL;
-	case SNDRV_PCM_FORMAT_DSD_U8:
-	case SNDRV_PCM_FORMAT_DSD_U16_LE:
-	case SNDRV_PCM_FORMAT_DSD_U32_LE:
-	case SNDRV_PCM_FORMAT_DSD_U16_BE:
-	case SNDRV_PCM_FORMAT_DSD_U32_BE:
-		return 0x6969696969696969ULL;
-#ifdef SNDRV_LITTLE_ENDIAN
-	case SNDRV_PCM_FORMAT_U16_LE:
-		return 0x8000800080008000ULL;
-	case SNDRV_PCM_FORMAT_U24_LE:
-		return 0x0080000000800000ULL;
-	case SNDRV_PCM_FORMAT_U32_LE:
-		return 0x8000000080000000ULL;
-	case SNDRV_PCM_FORMAT_U16_BE:
-		return 0x0080008000800080ULL;
-	case SNDRV_PCM_FORMAT_U24_BE:
-		return 0x0000800000008000ULL;
-	case SNDRV_PCM_FORMAT_U32_BE:
-		return 0x0000008000000080ULL;
-	case SNDRV_PCM_FORMAT_U24_3LE:
-		return 0x0000800000800000ULL;
-	case SNDRV_PCM_FORMAT_U24_3BE:
-		return 0x0080000080000080ULL;
-	case SNDRV_PCM_FORMAT_U20_3LE:
-		return 0x0000080000080000ULL;
-	case SNDRV_PCM_FORMAT_U20_3BE:
-		return 0x0008000008000008ULL;
-	case SNDRV_PCM_FORMAT_U18_3LE:
-		return 0x0000020000020000ULL;
-	case SNDRV_PCM_FORMAT_U18_3BE:
-		return 0x0002000002000002ULL;
-#else
-	case SNDRV_PCM_FORMAT_U16_LE:
-		return 0x0080008000800080ULL;
-	case SNDRV_PCM_FORMAT_U24_LE:
-		return 0x0000800000008000ULL;
-	case SNDRV_PCM_FORMAT_U32_LE:
-		return 0x0000008000000080ULL;
-	case SNDRV_PCM_FORMAT_U16_BE:
-		return 0x8000800080008000ULL;
-	case SNDRV_PCM_FORMAT_U24_BE:
-		return 0x0080000000800000ULL;
-	case SNDRV_PCM_FORMAT_U32_BE:
-		return 0x8000000080000000ULL;
-	case SNDRV_PCM_FORMAT_U24_3LE:
-		return 0x0080000080000080ULL;
-	case SNDRV_PCM_FORMAT_U24_3BE:
-		return 0x0000800000800000ULL;
-	case SNDRV_PCM_FORMAT_U20_3LE:
-		return 0x0008000008000008ULL;
-	case SNDRV_PCM_FORMAT_U20_3BE:
-		return 0x0000080000080000ULL;
-	case SNDRV_PCM_FORMAT_U18_3LE:
-		return 0x0002000002000002ULL;
-	case SNDRV_PCM_FORMAT_U18_3BE:
-		return 0x0000020000020000ULL;
-#endif
-	case SNDRV_PCM_FORMAT_FLOAT_LE:
-	{
-		union {
-			float f[2];
-			u_int64_t i;
-		} u;
-		u.f[0] = u.f[1] = 0.0;
-#ifdef SNDRV_LITTLE_ENDIAN
-		return u.i;
-#else
-		return bswap_64(u.i);
-#endif
-	}
-	case SNDRV_PCM_FORMAT_FLOAT64_LE:
-	{
-		union {
-			double f;
-			u_int64_t i;
-		} u;
-		u.f = 0.0;
-#ifdef SNDRV_LITTLE_ENDIAN
-		return u.i;
-#else
-		return bswap_64(u.i);
-#endif
-	}
-	case SNDRV_PCM_FORMAT_FLOAT_BE:		
-	{
-		union {
-			float f[2];
-			u_int64_t i;
-		} u;
-		u.f[0] = u.f[1] = 0.0;
-#ifdef SNDRV_LITTLE_ENDIAN
-		return bswap_64(u.i);
-#else
-		return u.i;
-#endif
-	}
-	case SNDRV_PCM_FORMAT_FLOAT64_BE:
-	{
-		union {
-			double f;
-			u_int64_t i;
-		} u;
-		u.f = 0.0;
-#ifdef SNDRV_LITTLE_ENDIAN
-		return bswap_64(u.i);
-#else
-		return u.i;
-#endif
-	}
-	case SNDRV_PCM_FORMAT_IEC958_SUBFRAME_LE:
-	case SNDRV_PCM_FORMAT_IEC958_SUBFRAME_BE:
-		return 0;	
-	case SNDRV_PCM_FORMAT_MU_LAW:
-		return 0x7f7f7f7f7f7f7f7fULL;
-	case SNDRV_PCM_FORMAT_A_LAW:
-		return 0x5555555555555555ULL;
-	case SNDRV_PCM_FORMAT_IMA_ADPCM:	/* special case */
-	case SNDRV_PCM_FORMAT_MPEG:
-	case SNDRV_PCM_FORMAT_GSM:
-	case SNDRV_PCM_FORMAT_SPECIAL:
-		return 0;
-	default:
-		assert(0);
-		return 0;
-	}
-	return 0;
+	return __snd_pcm_format_silence_64(format);
 }
 
 /**
@@ -541,8 +265,8 @@ u_int64_t snd_pcm_format_silence_64(snd_pcm_format_t format)
  */
 u_int32_t snd_pcm_format_silence_32(snd_pcm_format_t format)
 {
-	assert(snd_pcm_format_physical_width(format) <= 32);
-	return (u_int32_t)snd_pcm_format_silence_64(format);
+	assert(__snd_pcm_format_physical_width(format) <= 32);
+	return (u_int32_t)__snd_pcm_format_silence_64(format);
 }
 
 /**
@@ -552,8 +276,8 @@ u_int32_t snd_pcm_format_silence_32(snd_pcm_format_t format)
  */
 u_int16_t snd_pcm_format_silence_16(snd_pcm_format_t format)
 {
-	assert(snd_pcm_format_physical_width(format) <= 16);
-	return (u_int16_t)snd_pcm_format_silence_64(format);
+	assert(__snd_pcm_format_physical_width(format) <= 16);
+	return (u_int16_t)__snd_pcm_format_silence_64(format);
 }
 
 /**
@@ -563,10 +287,126 @@ u_int16_t snd_pcm_format_silence_16(snd_pcm_format_t format)
  */
 u_int8_t snd_pcm_format_silence(snd_pcm_format_t format)
 {
-	assert(snd_pcm_format_physical_width(format) <= 8);
-	return (u_int8_t)snd_pcm_format_silence_64(format);
+	assert(__snd_pcm_format_physical_width(format) <= 8);
+	return (u_int8_t)__snd_pcm_format_silence_64(format);
+}
+
+#ifndef DOC_HIDDEN
+/*
+ * Bulk silence: a block holding a whole number of samples (and of
+ * 64-bit words, 48 bytes for the packed 24-bit formats) is built from
+ * the silence pattern once and then stored with constant size copies,
+ * which the compiler turns into wide stores at any alignment.  Formats
+ * whose silence is a repeated byte go to memset directly.
+ */
+void snd_pcm_silence_block_init(snd_pcm_silence_block_t *blk, unsigned int width,
+				u_int64_t silence)
+{
+	unsigned int i;
+
+	if (width == 24) {
+		/* take one sample the same way as the per-sample loop */
+		unsigned char sample[3];
+#ifdef SNDRV_LITTLE_ENDIAN
+		sample[0] = silence >> 0;
+		sample[1] = silence >> 8;
+		sample[2] = silence >> 16;
+#else
+		sample[2] = silence >> 0;
+		sample[1] = silence >> 8;
+		sample[0] = silence >> 16;
+#endif
+		/* the pattern runs on past the block for unaligned reads */
+		blk->bytes = 48;
+		blk->period = 3;
+		for (i = 0; i < SND_PCM_SILENCE_BLOCK_MAX; i++)
+			blk->u.b[i] = sample[i % 3];
+	} else {
+		blk->bytes = SND_PCM_SILENCE_BLOCK_MAX;
+		blk->period = 8;
+		for (i = 0; i < SND_PCM_SILENCE_BLOCK_MAX / 8; i++)
+			blk->u.q[i] = silence;
+	}
+	blk->byte = blk->u.b[0];
+	for (i = 1; i < blk->bytes; i++) {
+		if (blk->u.b[i] != blk->byte) {
+			blk->byte = -1;
+			break;
+		}
+	}
 }
 
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+
+/*
+ * Regions of this size, e.g. a whole dmix or dshare slave buffer at
+ * prepare time, are far larger than the caches, so patterns which are
+ * not a repeated byte are filled with non-temporal stores which do not
+ * evict the working set (memset takes care of that on its own).
+ */
+#define SILENCE_STREAM_MIN	(1024 * 1024)
+
+static void silence_stream(char *dst, size_t bytes, const snd_pcm_silence_block_t *blk)
+{
+	size_t head = (16 - ((unsigned long)dst & 15)) & 15;
+	const unsigned char *pat;
+	__m128i a, b, c;
+
+	memcpy(dst, blk->u.b, head);
+	dst += head;
+	bytes -= head;
+	/* the pattern continues at this phase on the aligned address */
+	pat = blk->u.b + head % blk->period;
+	a = _mm_loadu_si128((const __m128i *)pat);
+	if (blk->period == 3) {
+		b = _mm_loadu_si128((const __m128i *)(pat + 16));
+		c = _mm_loadu_si128((const __m128i *)(pat + 32));
+		for (; bytes >= 48; bytes -= 48, dst += 48) {
+			_mm_stream_si128((__m128i *)dst, a);
+			_mm_stream_si128((__m128i *)(dst + 16), b);
+			_mm_stream_si128((__m128i *)(dst + 32), c);
+		}
+	} else {
+		for (; bytes >= 64; bytes -= 64, dst += 64) {
+			_mm_stream_si128((__m128i *)dst, a);
+			_mm_stream_si128((__m128i *)(dst + 16), a);
+			_mm_stream_si128((__m128i *)(dst + 32), a);
+			_mm_stream_si128((__m128i *)(dst + 48), a);
+		}
+		for (; bytes >= 16; bytes -= 16, dst += 16)
+			_mm_stream_si128((__m128i *)dst, a);
+	}
+	_mm_sfence();
+	memcpy(dst, pat, bytes);
+}
+#endif
+
+void snd_pcm_silence_fill(char *dst, size_t bytes, const snd_pcm_silence_block_t *blk)
+{
+	if (blk->byte >= 0) {
+		memset(dst, blk->byte, bytes);
+		return;
+	}
+#ifdef SILENCE_STREAM_MIN
+	if (bytes >= SILENCE_STREAM_MIN) {
+		silence_stream(dst, bytes, blk);
+		return;
+	}
+#endif
+	if (blk->bytes == 48) {
+		for (; bytes >= 48; bytes -= 48, dst += 48)
+			memcpy(dst, blk->u.b, 48);
+	} else {
+		for (; bytes >= SND_PCM_SILENCE_BLOCK_MAX;
+		     bytes -= SND_PCM_SILENCE_BLOCK_MAX,
+			     dst += SND_PCM_SILENCE_BLOCK_MAX)
+			memcpy(dst, blk->u.b, SND_PCM_SILENCE_BLOCK_MAX);
+	}
+	memcpy(dst, blk->u.b, bytes);
+}
+#endif /* DOC_HIDDEN */
+
 /**
  * \brief Silence a PCM samples buffer
  * \param format Sample format
@@ -576,11 +416,15 @@ u_int8_t snd_pcm_format_silence(snd_pcm_format_t format)
  */
 int snd_pcm_format_set_silence(snd_pcm_format_t format, void *data, unsigned int samples)
 {
+	snd_pcm_silence_block_t blk;
+	int width;
+
 	if (samples == 0)
 		return 0;
-	switch (snd_pcm_format_physical_width(format)) {
+	width = __snd_pcm_format_physical_width(format);
+	switch (width) {
 	case 4: {
-		u_int8_t silence = snd_pcm_format_silence_64(format);
+		u_int8_t silence = __snd_pcm_format_silence_64(format);
 		unsigned int samples1;
 		if (samples % 2 != 0)
 			return -EINVAL;
@@ -588,64 +432,15 @@ int snd_pcm_format_set_silence(snd_pcm_format_t format, void *data, unsigned int
 		memset(data, silence, samples1);
 		break;
 	}
-	case 8: {
-		u_int8_t silence = snd_pcm_format_silence_64(format);
-		memset(data, silence, samples);
+	case 8:
+	case 16:
+	case 24:
+	case 32:
+	case 64:
+		snd_pcm_silence_block_init(&blk, width,
+					   __snd_pcm_format_silence_64(format));
+		snd_pcm_silence_fill(data, (size_t)samples * (width / 8), &blk);
 		break;
-	}
-	case 16: {
-		u_int16_t silence = snd_pcm_format_silence_64(format);
-		u_int16_t *pdata = (u_int16_t *)data;
-		if (! silence)
-			memset(data, 0, samples * 2);
-		else {
-			while (samples-- > 0)
-				*pdata++ = silence;
-		}
-		break;
-	}
-	case 24: {
-		u_int32_t silence = snd_pcm_format_silence_64(format);
-		u_int8_t *pdata = (u_int8_t *)data;
-		if (! silence)
-			memset(data, 0, samples * 3);
-		else {
-			while (samples-- > 0) {
-#ifdef SNDRV_LITTLE_ENDIAN
-				*pdata++ = silence >> 0;
-				*pdata++ = silence >> 8;
-				*pdata++ = silence >> 16;
-#else
-				*pdata++ = silence >> 16;
-				*pdata++ = silence >> 8;
-				*pdata++ = silence >> 0;
-#endif
-			}
-		}
-		break;
-	}
-	case 32: {
-		u_int32_t silence = snd_pcm_format_silence_64(format);
-		u_int32_t *pdata = (u_int32_t *)data;
-		if (! silence)
-			memset(data, 0, samples * 4);
-		else {
-			while (samples-- > 0)
-				*pdata++ = silence;
-		}
-		break;
-	}
-	case 64: {
-		u_int64_t silence = snd_pcm_format_silence_64(format);
-		u_int64_t *pdata = (u_int64_t *)data;
-		if (! silence)
-			memset(data, 0, samples * 8);
-		else {
-			while (samples-- > 0)
-				*pdata++ = silence;
-		}
-		break;
-	}
 	default:
 		assert(0);
 		return -EINVAL;
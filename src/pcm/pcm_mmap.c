@@ -83,10 +83,16 @@ static snd_pcm_sframes_t snd_pcm_mmap_write_areas(snd_pcm_t *pcm,
 		snd_pcm_sframes_t result;
 
 		__snd_pcm_mmap_begin(pcm, &pcm_areas, &pcm_offset, &frames);
-		snd_pcm_areas_copy(pcm_areas, pcm_offset,
-				   areas, offset, 
-				   pcm->channels, 
-				   frames, pcm->format);
+		if (pcm->type == SND_PCM_TYPE_HW)
+			snd_pcm_areas_copy_stream(pcm_areas, pcm_offset,
+						  areas, offset,
+						  pcm->channels,
+						  frames, pcm->format);
+		else
+			snd_pcm_areas_copy(pcm_areas, pcm_offset,
+					   areas, offset, 
+					   pcm->channels, 
+					   frames, pcm->format);
 		result = __snd_pcm_mmap_commit(pcm, pcm_offset, frames);
 		if (result < 0)
 			return xfer > 0 ? (snd_pcm_sframes_t)xfer : result;
@@ -248,14 +254,45 @@ int snd_pcm_channel_info_shm(snd_pcm_t *pcm, snd_pcm_channel_info_t *info, int s
 	}
 	info->addr = 0;
 	if (pcm->hw_flags & SND_PCM_HW_PARAMS_EXPORT_BUFFER) {
+#ifdef HAVE_MEMFD_CREATE
+		/* an anonymous file, passed to the peer as a descriptor */
+		info->type = SND_PCM_AREA_MMAP;
+		info->u.mmap.fd = -1;
+		info->u.mmap.offset = 0;
+		info->u.mmap.memfd = 1;
+		if (pcm->mmap_channels && pcm->mmap_channels[info->channel].addr)
+			info->u.mmap.fd = pcm->mmap_channels[info->channel].u.mmap.fd;
+#else
 		info->type = SND_PCM_AREA_SHM;
 		info->u.shm.shmid = shmid;
 		info->u.shm.area = NULL;
+#endif
 	} else
 		info->type = SND_PCM_AREA_LOCAL;
 	return 0;
 }	
 
+/*
+ * With SND_PCM_LOCK_BUFFERS, a buffer allocated here is pinned and all
+ * its pages are faulted in now, so that the first periods after the
+ * start do not page fault in a realtime thread.  Without the privilege
+ * to lock, the pages are at least touched; the atomic no-op write keeps
+ * the data of a segment shared with other processes intact.
+ */
+static void lock_buffer(snd_pcm_t *pcm, void *addr, size_t size)
+{
+	size_t i, psize;
+
+	if (!(pcm->mode & SND_PCM_LOCK_BUFFERS))
+		return;
+	if (mlock(addr, size) == 0)
+		return;
+	SYSMSG("mlock of %zu bytes failed, prefaulting only", size);
+	psize = getpagesize();
+	for (i = 0; i < size; i += psize)
+		__sync_fetch_and_or((char *)addr + i, 0);
+}
+
 int snd_pcm_mmap(snd_pcm_t *pcm)
 {
 	int err;
@@ -336,11 +373,37 @@ int snd_pcm_mmap(snd_pcm_t *pcm)
 		size = page_align(size);
 		switch (i->type) {
 		case SND_PCM_AREA_MMAP:
+#ifdef HAVE_MEMFD_CREATE
+			if (i->u.mmap.fd < 0 && i->u.mmap.memfd) {
+				int fd = memfd_create("alsa-pcm", MFD_CLOEXEC);
+				if (fd < 0) {
+					SYSERR("memfd_create failed");
+					return -errno;
+				}
+				if (ftruncate(fd, size) < 0) {
+					SYSERR("ftruncate failed");
+					close(fd);
+					return -errno;
+				}
+				i->u.mmap.fd = fd;
+				if (pcm->access == SND_PCM_ACCESS_MMAP_INTERLEAVED ||
+				    pcm->access == SND_PCM_ACCESS_RW_INTERLEAVED) {
+					for (c1 = c + 1; c1 < pcm->channels; c1++) {
+						snd_pcm_channel_info_t *i1 = &pcm->mmap_channels[c1];
+						if (i1->type == SND_PCM_AREA_MMAP &&
+						    i1->u.mmap.memfd && i1->u.mmap.fd < 0)
+							i1->u.mmap.fd = fd;
+					}
+				}
+			}
+#endif
 			ptr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_FILE|MAP_SHARED, i->u.mmap.fd, i->u.mmap.offset);
 			if (ptr == MAP_FAILED) {
 				SYSERR("mmap failed");
 				return -errno;
 			}
+			if (i->u.mmap.memfd)
+				lock_buffer(pcm, ptr, size);
 			i->addr = ptr;
 			break;
 		case SND_PCM_AREA_SHM:
@@ -364,6 +427,7 @@ int snd_pcm_mmap(snd_pcm_t *pcm)
 					SYSERR("shmctl mark remove failed");
 					return -errno;
 				}
+				lock_buffer(pcm, ptr, size);
 				i->u.shm.area = snd_shm_area_create(id, ptr);
 				if (i->u.shm.area == NULL) {
 					SYSERR("snd_shm_area_create failed");
@@ -386,6 +450,7 @@ int snd_pcm_mmap(snd_pcm_t *pcm)
 					SYSERR("shmat failed");
 					return -errno;
 				}
+				lock_buffer(pcm, ptr, size);
 			}
 			i->addr = ptr;
 			break;
@@ -394,10 +459,20 @@ int snd_pcm_mmap(snd_pcm_t *pcm)
 			return -ENOSYS;
 #endif
 		case SND_PCM_AREA_LOCAL:
-			ptr = malloc(size);
-			if (ptr == NULL) {
-				SYSERR("malloc failed");
-				return -errno;
+			if (pcm->mode & SND_PCM_LOCK_BUFFERS) {
+				/* whole pages, unlocked again on munmap */
+				err = posix_memalign((void **)&ptr, getpagesize(), size);
+				if (err) {
+					SNDERR("posix_memalign failed");
+					return -err;
+				}
+				lock_buffer(pcm, ptr, size);
+			} else {
+				ptr = malloc(size);
+				if (ptr == NULL) {
+					SYSERR("malloc failed");
+					return -errno;
+				}
 			}
 			i->addr = ptr;
 			break;
@@ -472,6 +547,16 @@ int snd_pcm_munmap(snd_pcm_t *pcm)
 				return -errno;
 			}
 			errno = 0;
+			if (i->u.mmap.memfd && i->u.mmap.fd >= 0) {
+				for (c1 = c + 1; c1 < pcm->channels; ++c1) {
+					snd_pcm_channel_info_t *i1 = &pcm->mmap_channels[c1];
+					if (i1->type == SND_PCM_AREA_MMAP &&
+					    i1->u.mmap.fd == i->u.mmap.fd)
+						i1->u.mmap.fd = -1;
+				}
+				close(i->u.mmap.fd);
+				i->u.mmap.fd = -1;
+			}
 			break;
 		case SND_PCM_AREA_SHM:
 #ifdef HAVE_SYS_SHM_H
@@ -496,8 +581,12 @@ int snd_pcm_munmap(snd_pcm_t *pcm)
 			return -ENOSYS;
 #endif
 		case SND_PCM_AREA_LOCAL:
+			if (pcm->mode & SND_PCM_LOCK_BUFFERS)
+				munlock(i->addr, size);
 			free(i->addr);
 			break;
+		case SND_PCM_AREA_EXTERN:
+			break;
 		default:
 			assert(0);
 		}
@@ -269,6 +269,48 @@ snd_pcm_mmap_emul_forward(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
 	return frames;
 }
 
+/*
+ * write a chunk of the mmap buffer straight to the slave PCM; the areas
+ * are the ones the caller has just filled, so no copy is made here
+ */
+static snd_pcm_sframes_t
+write_slave_areas(snd_pcm_t *pcm, snd_pcm_uframes_t offset,
+		  snd_pcm_uframes_t size)
+{
+	mmap_emul_t *map = pcm->private_data;
+	snd_pcm_t *slave = map->gen.slave;
+	const snd_pcm_channel_area_t *areas = snd_pcm_mmap_areas(pcm);
+	snd_pcm_uframes_t xfer = 0;
+	snd_pcm_sframes_t err = 0;
+
+	while (xfer < size) {
+		snd_pcm_uframes_t frames = size - xfer;
+		snd_pcm_uframes_t cont = pcm->buffer_size - offset;
+		if (cont < frames)
+			frames = cont;
+		snd_pcm_unlock(pcm); /* to avoid deadlock */
+		if (pcm->access == SND_PCM_ACCESS_MMAP_INTERLEAVED) {
+			err = _snd_pcm_writei(slave,
+					      snd_pcm_channel_area_addr(areas, offset),
+					      frames);
+		} else {
+			void *bufs[pcm->channels];
+			unsigned int c;
+			for (c = 0; c < pcm->channels; c++)
+				bufs[c] = snd_pcm_channel_area_addr(&areas[c], offset);
+			err = _snd_pcm_writen(slave, bufs, frames);
+		}
+		snd_pcm_lock(pcm);
+		if (err <= 0)
+			break;
+		xfer += err;
+		offset = (offset + err) % pcm->buffer_size;
+	}
+	if (xfer > 0)
+		return xfer;
+	return err;
+}
+
 /* write out the uncommitted chunk on mmap buffer to the slave PCM */
 static snd_pcm_sframes_t
 sync_slave_write(snd_pcm_t *pcm)
@@ -286,7 +328,7 @@ sync_slave_write(snd_pcm_t *pcm)
 		size += pcm->boundary;
 	if (size) {
 		offset = *slave->appl.ptr % pcm->buffer_size;
-		size = snd_pcm_write_mmap(pcm, offset, size);
+		size = write_slave_areas(pcm, offset, size);
 	}
 	pcm->start_threshold = map->start_threshold; /* restore */
 	return size;
@@ -26,6 +26,7 @@
  *
  */
   
+#include <stdint.h>
 #include "bswap.h"
 #include "pcm_local.h"
 #include "pcm_plugin.h"
@@ -156,6 +157,96 @@ static int ulaw_to_s16(unsigned char u_val)
 	return ((u_val & 0x80) ? (0x84 - t) : (t - 0x84));
 }
 
+/*
+ * Lookup tables: every code word and every S16 value, built on the first
+ * use from the functions above.  Racing callers store the same values.
+ */
+static int16_t ulaw_dec_table[256];
+static unsigned char ulaw_enc_table[65536];
+static int ulaw_tables_ready;
+
+static void ulaw_init_tables(void)
+{
+	unsigned int i;
+
+	if (__atomic_load_n(&ulaw_tables_ready, __ATOMIC_ACQUIRE))
+		return;
+	for (i = 0; i < 256; i++)
+		ulaw_dec_table[i] = ulaw_to_s16(i);
+	for (i = 0; i < 65536; i++)
+		ulaw_enc_table[i] = s16_to_ulaw((int16_t)i);
+	__atomic_store_n(&ulaw_tables_ready, 1, __ATOMIC_RELEASE);
+}
+
+/* CPU endian S16 kernels, interleaved areas are done in one run */
+static int ulaw_decode_s16(const snd_pcm_channel_area_t *dst_areas,
+			   snd_pcm_uframes_t dst_offset,
+			   const snd_pcm_channel_area_t *src_areas,
+			   snd_pcm_uframes_t src_offset,
+			   unsigned int channels, snd_pcm_uframes_t frames)
+{
+	unsigned int channel;
+	snd_pcm_uframes_t i, n;
+
+	if (snd_pcm_areas_interleaved(src_areas, channels, 8) &&
+	    snd_pcm_areas_interleaved(dst_areas, channels, 16)) {
+		const unsigned char *src = snd_pcm_channel_area_addr(src_areas, src_offset);
+		int16_t *dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+		n = frames * channels;
+		for (i = 0; i < n; i++)
+			dst[i] = ulaw_dec_table[src[i]];
+		return 1;
+	}
+	for (channel = 0; channel < channels; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const unsigned char *src = snd_pcm_channel_area_addr(src_area, src_offset);
+		int16_t *dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		unsigned int src_step = snd_pcm_channel_area_step(src_area);
+		unsigned int dst_step = snd_pcm_channel_area_step(dst_area);
+		if (dst_step % 2)
+			return 0;
+		dst_step /= 2;
+		for (i = 0; i < frames; i++)
+			dst[i * dst_step] = ulaw_dec_table[src[i * src_step]];
+	}
+	return 1;
+}
+
+static int ulaw_encode_s16(const snd_pcm_channel_area_t *dst_areas,
+			   snd_pcm_uframes_t dst_offset,
+			   const snd_pcm_channel_area_t *src_areas,
+			   snd_pcm_uframes_t src_offset,
+			   unsigned int channels, snd_pcm_uframes_t frames)
+{
+	unsigned int channel;
+	snd_pcm_uframes_t i, n;
+
+	if (snd_pcm_areas_interleaved(src_areas, channels, 16) &&
+	    snd_pcm_areas_interleaved(dst_areas, channels, 8)) {
+		const uint16_t *src = snd_pcm_channel_area_addr(src_areas, src_offset);
+		unsigned char *dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+		n = frames * channels;
+		for (i = 0; i < n; i++)
+			dst[i] = ulaw_enc_table[src[i]];
+		return 1;
+	}
+	for (channel = 0; channel < channels; ++channel) {
+		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const uint16_t *src = snd_pcm_channel_area_addr(src_area, src_offset);
+		unsigned char *dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		unsigned int src_step = snd_pcm_channel_area_step(src_area);
+		unsigned int dst_step = snd_pcm_channel_area_step(dst_area);
+		if (src_step % 2)
+			return 0;
+		src_step /= 2;
+		for (i = 0; i < frames; i++)
+			dst[i * dst_step] = ulaw_enc_table[src[i * src_step]];
+	}
+	return 1;
+}
+
 #ifndef DOC_HIDDEN
 
 void snd_pcm_mulaw_decode(const snd_pcm_channel_area_t *dst_areas,
@@ -170,6 +261,11 @@ void snd_pcm_mulaw_decode(const snd_pcm_channel_area_t *dst_areas,
 #undef PUT16_LABELS
 	void *put = put16_labels[putidx];
 	unsigned int channel;
+	ulaw_init_tables();
+	if (putidx == snd_pcm_linear_put_index(SND_PCM_FORMAT_S16, SND_PCM_FORMAT_S16) &&
+	    ulaw_decode_s16(dst_areas, dst_offset, src_areas, src_offset,
+			    channels, frames))
+		return;
 	for (channel = 0; channel < channels; ++channel) {
 		const unsigned char *src;
 		char *dst;
@@ -183,7 +279,7 @@ void snd_pcm_mulaw_decode(const snd_pcm_channel_area_t *dst_areas,
 		dst_step = snd_pcm_channel_area_step(dst_area);
 		frames1 = frames;
 		while (frames1-- > 0) {
-			int16_t sample = ulaw_to_s16(*src);
+			int16_t sample = ulaw_dec_table[*src];
 			goto *put;
 #define PUT16_END after
 #include "plugin_ops.h"
@@ -208,6 +304,11 @@ void snd_pcm_mulaw_encode(const snd_pcm_channel_area_t *dst_areas,
 	void *get = get16_labels[getidx];
 	unsigned int channel;
 	int16_t sample = 0;
+	ulaw_init_tables();
+	if (getidx == snd_pcm_linear_get_index(SND_PCM_FORMAT_S16, SND_PCM_FORMAT_S16) &&
+	    ulaw_encode_s16(dst_areas, dst_offset, src_areas, src_offset,
+			    channels, frames))
+		return;
 	for (channel = 0; channel < channels; ++channel) {
 		const char *src;
 		char *dst;
@@ -226,7 +327,7 @@ void snd_pcm_mulaw_encode(const snd_pcm_channel_area_t *dst_areas,
 #include "plugin_ops.h"
 #undef GET16_END
 		after:
-			*dst = s16_to_ulaw(sample);
+			*dst = ulaw_enc_table[(uint16_t)sample];
 			src += src_step;
 			dst += dst_step;
 		}
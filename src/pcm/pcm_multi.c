@@ -34,6 +34,12 @@
 #include "pcm_local.h"
 #include "pcm_generic.h"
 
+#ifdef THREAD_SAFE_API
+#include <signal.h>
+#include <semaphore.h>
+#define MULTI_HAVE_WORKERS
+#endif
+
 #ifndef PIC
 /* entry for static linking */
 const char *_snd_module_pcm_multi = "";
@@ -41,11 +47,25 @@ const char *_snd_module_pcm_multi = "";
 
 #ifndef DOC_HIDDEN
 
+struct snd_pcm_multi;
+
 typedef struct {
 	snd_pcm_t *pcm;
 	unsigned int channels_count;
 	int close_slave;
 	snd_pcm_t *linked;
+#ifdef MULTI_HAVE_WORKERS
+	struct snd_pcm_multi *multi;	/* owner, for the worker */
+	pthread_t worker;
+	int has_worker;
+	sem_t go;			/* posted when an op is to be run */
+#endif
+	snd_pcm_sframes_t result;	/* result of the last parallel op */
+	snd_pcm_status_t status;	/* snapshot by the last status op */
+	int drift_valid;		/* drift_base was taken */
+	int drift_warned;
+	snd_pcm_sframes_t drift_base;	/* offset to the master at start */
+	snd_pcm_sframes_t drift;	/* frames run ahead of the master */
 } snd_pcm_multi_slave_t;
 
 typedef struct {
@@ -53,21 +73,193 @@ typedef struct {
 	unsigned int slave_channel;
 } snd_pcm_multi_channel_t;
 
-typedef struct {
+typedef enum {
+	MULTI_OP_QUIT,
+	MULTI_OP_AVAIL_UPDATE,
+	MULTI_OP_MMAP_COMMIT,
+	MULTI_OP_REWIND,
+	MULTI_OP_FORWARD,
+	MULTI_OP_STATUS,
+	MULTI_OP_PREPARE,
+	MULTI_OP_RESET,
+	MULTI_OP_START,
+	MULTI_OP_DROP,
+	MULTI_OP_DRAIN,
+} snd_pcm_multi_op_t;
+
+typedef struct snd_pcm_multi {
 	unsigned int slaves_count;
 	unsigned int master_slave;
 	snd_pcm_multi_slave_t *slaves;
 	unsigned int channels_count;
 	snd_pcm_multi_channel_t *channels;
+	int parallel;			/* slave ops run on worker threads */
+#ifdef MULTI_HAVE_WORKERS
+	sem_t done;			/* posted by each finished worker */
+#endif
+	snd_pcm_multi_op_t op;		/* current parallel op and its args */
+	snd_pcm_uframes_t offset;
+	snd_pcm_uframes_t size;
+	snd_pcm_uframes_t drift_threshold; /* 0 = no drift monitoring */
+	snd_htimestamp_t drift_start;	/* first and last measurement */
+	snd_htimestamp_t drift_last;
 } snd_pcm_multi_t;
 
 #endif
 
+/*
+ * parallel slave ops
+ *
+ * With the parallel option, each slave but the first one gets a worker
+ * thread.  The ops which make system calls on every slave are run on all
+ * slaves at once, the caller doing the first slave itself and then
+ * waiting for the workers; so the cost of a call is that of the slowest
+ * slave instead of the sum over all slaves.
+ */
+static snd_pcm_sframes_t snd_pcm_multi_slave_op(snd_pcm_multi_t *multi,
+						snd_pcm_multi_slave_t *slave)
+{
+	switch (multi->op) {
+	case MULTI_OP_AVAIL_UPDATE:
+		return snd_pcm_avail_update(slave->pcm);
+	case MULTI_OP_MMAP_COMMIT:
+		return snd_pcm_mmap_commit(slave->pcm, multi->offset,
+					   multi->size);
+	case MULTI_OP_REWIND:
+		return snd_pcm_rewind(slave->pcm, multi->size);
+	case MULTI_OP_FORWARD:
+		return INTERNAL(snd_pcm_forward)(slave->pcm, multi->size);
+	case MULTI_OP_STATUS:
+		return snd_pcm_status(slave->pcm, &slave->status);
+	case MULTI_OP_PREPARE:
+		return snd_pcm_prepare(slave->pcm);
+	case MULTI_OP_RESET:
+		return snd_pcm_reset(slave->pcm);
+	case MULTI_OP_START:
+		return slave->linked ? 0 : snd_pcm_start(slave->pcm);
+	case MULTI_OP_DROP:
+		return slave->linked ? 0 : snd_pcm_drop(slave->pcm);
+	case MULTI_OP_DRAIN:
+		return slave->linked ? 0 : snd_pcm_drain(slave->pcm);
+	default:
+		return 0;
+	}
+}
+
+#ifdef MULTI_HAVE_WORKERS
+static void *snd_pcm_multi_worker(void *arg)
+{
+	snd_pcm_multi_slave_t *slave = arg;
+	snd_pcm_multi_t *multi = slave->multi;
+	sigset_t mask;
+
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+	for (;;) {
+		while (sem_wait(&slave->go) < 0 && errno == EINTR)
+			;
+		if (multi->op == MULTI_OP_QUIT)
+			break;
+		slave->result = snd_pcm_multi_slave_op(multi, slave);
+		sem_post(&multi->done);
+	}
+	return NULL;
+}
+#endif
+
+/* run the op on all slaves, the results are left in slaves[].result */
+static void snd_pcm_multi_run(snd_pcm_multi_t *multi, snd_pcm_multi_op_t op)
+{
+	unsigned int i;
+
+	multi->op = op;
+#ifdef MULTI_HAVE_WORKERS
+	if (multi->parallel) {
+		for (i = 1; i < multi->slaves_count; ++i)
+			sem_post(&multi->slaves[i].go);
+		multi->slaves[0].result =
+			snd_pcm_multi_slave_op(multi, &multi->slaves[0]);
+		for (i = 1; i < multi->slaves_count; ++i)
+			while (sem_wait(&multi->done) < 0 && errno == EINTR)
+				;
+		return;
+	}
+#endif
+	for (i = 0; i < multi->slaves_count; ++i)
+		multi->slaves[i].result =
+			snd_pcm_multi_slave_op(multi, &multi->slaves[i]);
+}
+
+/* the first error of the last parallel op, or zero */
+static int snd_pcm_multi_run_error(snd_pcm_multi_t *multi)
+{
+	unsigned int i;
+
+	for (i = 0; i < multi->slaves_count; ++i)
+		if (multi->slaves[i].result < 0)
+			return multi->slaves[i].result;
+	return 0;
+}
+
+static void snd_pcm_multi_stop_workers(snd_pcm_multi_t *multi)
+{
+#ifdef MULTI_HAVE_WORKERS
+	unsigned int i;
+
+	if (!multi->parallel)
+		return;
+	multi->op = MULTI_OP_QUIT;
+	for (i = 1; i < multi->slaves_count; ++i) {
+		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
+		if (!slave->has_worker)
+			continue;
+		sem_post(&slave->go);
+		pthread_join(slave->worker, NULL);
+		sem_destroy(&slave->go);
+		slave->has_worker = 0;
+	}
+	sem_destroy(&multi->done);
+	multi->parallel = 0;
+#endif
+}
+
+static int snd_pcm_multi_start_workers(snd_pcm_multi_t *multi)
+{
+#ifdef MULTI_HAVE_WORKERS
+	unsigned int i;
+	int err;
+
+	if (multi->slaves_count < 2)
+		return 0;
+	sem_init(&multi->done, 0, 0);
+	multi->parallel = 1;
+	for (i = 1; i < multi->slaves_count; ++i) {
+		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
+		slave->multi = multi;
+		sem_init(&slave->go, 0, 0);
+		err = snd_thread_create(&slave->worker, NULL,
+					snd_pcm_multi_worker, slave);
+		if (err) {
+			SNDERR("unable to create a multi worker thread");
+			sem_destroy(&slave->go);
+			snd_pcm_multi_stop_workers(multi);
+			return -err;
+		}
+		slave->has_worker = 1;
+	}
+	return 0;
+#else
+	SNDMSG("no thread support, parallel ignored");
+	return 0;
+#endif
+}
+
 static int snd_pcm_multi_close(snd_pcm_t *pcm)
 {
 	snd_pcm_multi_t *multi = pcm->private_data;
 	unsigned int i;
 	int ret = 0;
+	snd_pcm_multi_stop_workers(multi);
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
 		if (slave->close_slave) {
@@ -391,7 +583,27 @@ static int snd_pcm_multi_status(snd_pcm_t *pcm, snd_pcm_status_t *status)
 {
 	snd_pcm_multi_t *multi = pcm->private_data;
 	snd_pcm_t *slave = multi->slaves[multi->master_slave].pcm;
-	return snd_pcm_status(slave, status);
+	unsigned int i;
+	int err;
+
+	if (!multi->parallel)
+		return snd_pcm_status(slave, status);
+	/* a snapshot of all slaves taken at once; the master's status
+	 * with the least avail and the largest delay among the slaves
+	 */
+	snd_pcm_multi_run(multi, MULTI_OP_STATUS);
+	err = snd_pcm_multi_run_error(multi);
+	if (err < 0)
+		return err;
+	*status = multi->slaves[multi->master_slave].status;
+	for (i = 0; i < multi->slaves_count; ++i) {
+		snd_pcm_status_t *s = &multi->slaves[i].status;
+		if (s->avail < status->avail)
+			status->avail = s->avail;
+		if (s->delay > status->delay)
+			status->delay = s->delay;
+	}
+	return 0;
 }
 
 static snd_pcm_state_t snd_pcm_multi_state(snd_pcm_t *pcm)
@@ -415,19 +627,115 @@ static int snd_pcm_multi_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 	return snd_pcm_delay(slave, delayp);
 }
 
+/*
+ * drift monitoring
+ *
+ * Unlinked slaves run on their own clocks.  Since all slaves share the
+ * application pointer, the difference of avail between a slave and the
+ * master, at the same instant, is how far the slave clock ran ahead of
+ * the master; the htimestamp of each slave brings both avails to the
+ * master's instant.  The difference at the first measurement is the
+ * start skew and is taken as the base.
+ */
+static int snd_pcm_multi_same_clock(snd_pcm_multi_t *multi, unsigned int i)
+{
+	unsigned int m = multi->master_slave;
+
+	return (i == 0 || multi->slaves[i].linked) &&
+	       (m == 0 || multi->slaves[m].linked);
+}
+
+static long long snd_pcm_multi_ts_diff(const snd_htimestamp_t *a,
+				       const snd_htimestamp_t *b)
+{
+	return (long long)(a->tv_sec - b->tv_sec) * 1000000000LL +
+	       (a->tv_nsec - b->tv_nsec);
+}
+
+static void snd_pcm_multi_drift_reset(snd_pcm_multi_t *multi)
+{
+	unsigned int i;
+
+	for (i = 0; i < multi->slaves_count; ++i) {
+		multi->slaves[i].drift_valid = 0;
+		multi->slaves[i].drift_warned = 0;
+		multi->slaves[i].drift = 0;
+	}
+	multi->drift_start.tv_sec = multi->drift_start.tv_nsec = 0;
+	multi->drift_last = multi->drift_start;
+}
+
+static void snd_pcm_multi_drift_update(snd_pcm_t *pcm)
+{
+	snd_pcm_multi_t *multi = pcm->private_data;
+	snd_pcm_t *master = multi->slaves[multi->master_slave].pcm;
+	snd_pcm_uframes_t mavail, avail;
+	snd_htimestamp_t mts, ts;
+	unsigned int i;
+
+	if (snd_pcm_state(master) != SND_PCM_STATE_RUNNING)
+		return;
+	if (snd_pcm_htimestamp(master, &mavail, &mts) < 0)
+		return;
+	/* once per period is plenty */
+	if (multi->drift_start.tv_sec || multi->drift_start.tv_nsec) {
+		if (snd_pcm_multi_ts_diff(&mts, &multi->drift_last) <
+		    (long long)pcm->period_size * 1000000000LL / pcm->rate)
+			return;
+	} else
+		multi->drift_start = mts;
+	multi->drift_last = mts;
+	for (i = 0; i < multi->slaves_count; ++i) {
+		snd_pcm_multi_slave_t *slave = &multi->slaves[i];
+		snd_pcm_sframes_t d;
+
+		if (snd_pcm_multi_same_clock(multi, i) ||
+		    i == multi->master_slave)
+			continue;
+		if (snd_pcm_htimestamp(slave->pcm, &avail, &ts) < 0)
+			continue;
+		d = (snd_pcm_sframes_t)avail - (snd_pcm_sframes_t)mavail -
+		    snd_pcm_multi_ts_diff(&ts, &mts) * pcm->rate / 1000000000LL;
+		if (!slave->drift_valid) {
+			slave->drift_base = d;
+			slave->drift_valid = 1;
+		}
+		slave->drift = d - slave->drift_base;
+		if (!slave->drift_warned &&
+		    (snd_pcm_uframes_t)labs(slave->drift) > multi->drift_threshold) {
+			SNDERR("multi slave #%u drifted %ld frames off the master",
+			       i, (long)slave->drift);
+			slave->drift_warned = 1;
+		}
+	}
+}
+
 static snd_pcm_sframes_t snd_pcm_multi_avail_update(snd_pcm_t *pcm)
 {
 	snd_pcm_multi_t *multi = pcm->private_data;
 	snd_pcm_sframes_t ret = LONG_MAX;
 	unsigned int i;
-	for (i = 0; i < multi->slaves_count; ++i) {
-		snd_pcm_sframes_t avail;
-		avail = snd_pcm_avail_update(multi->slaves[i].pcm);
-		if (avail < 0)
-			return avail;
-		if (ret > avail)
-			ret = avail;
+	if (multi->parallel) {
+		snd_pcm_multi_run(multi, MULTI_OP_AVAIL_UPDATE);
+		for (i = 0; i < multi->slaves_count; ++i) {
+			snd_pcm_sframes_t avail = multi->slaves[i].result;
+			if (avail < 0)
+				return avail;
+			if (ret > avail)
+				ret = avail;
+		}
+	} else {
+		for (i = 0; i < multi->slaves_count; ++i) {
+			snd_pcm_sframes_t avail;
+			avail = snd_pcm_avail_update(multi->slaves[i].pcm);
+			if (avail < 0)
+				return avail;
+			if (ret > avail)
+				ret = avail;
+		}
 	}
+	if (multi->drift_threshold)
+		snd_pcm_multi_drift_update(pcm);
 	return ret;
 }
 
@@ -444,6 +752,11 @@ static int snd_pcm_multi_prepare(snd_pcm_t *pcm)
 	snd_pcm_multi_t *multi = pcm->private_data;
 	int result = 0, err;
 	unsigned int i;
+	snd_pcm_multi_drift_reset(multi);
+	if (multi->parallel) {
+		snd_pcm_multi_run(multi, MULTI_OP_PREPARE);
+		return snd_pcm_multi_run_error(multi);
+	}
 	for (i = 0; i < multi->slaves_count; ++i) {
 		/* We call prepare to each slave even if it's linked.
 		 * This is to make sure to sync non-mmaped control/status.
@@ -460,6 +773,11 @@ static int snd_pcm_multi_reset(snd_pcm_t *pcm)
 	snd_pcm_multi_t *multi = pcm->private_data;
 	int result = 0, err;
 	unsigned int i;
+	snd_pcm_multi_drift_reset(multi);
+	if (multi->parallel) {
+		snd_pcm_multi_run(multi, MULTI_OP_RESET);
+		return snd_pcm_multi_run_error(multi);
+	}
 	for (i = 0; i < multi->slaves_count; ++i) {
 		/* Reset each slave, as well as in prepare */
 		err = snd_pcm_reset(multi->slaves[i].pcm);
@@ -480,6 +798,10 @@ static int snd_pcm_multi_start(snd_pcm_t *pcm)
 	unsigned int i;
 	if (multi->slaves[0].linked)
 		return snd_pcm_start(multi->slaves[0].linked);
+	if (multi->parallel) {
+		snd_pcm_multi_run(multi, MULTI_OP_START);
+		return snd_pcm_multi_run_error(multi);
+	}
 	for (i = 0; i < multi->slaves_count; ++i) {
 		if (multi->slaves[i].linked)
 			continue;
@@ -497,6 +819,10 @@ static int snd_pcm_multi_drop(snd_pcm_t *pcm)
 	unsigned int i;
 	if (multi->slaves[0].linked)
 		return snd_pcm_drop(multi->slaves[0].linked);
+	if (multi->parallel) {
+		snd_pcm_multi_run(multi, MULTI_OP_DROP);
+		return snd_pcm_multi_run_error(multi);
+	}
 	for (i = 0; i < multi->slaves_count; ++i) {
 		if (multi->slaves[i].linked)
 			continue;
@@ -514,6 +840,10 @@ static int snd_pcm_multi_drain(snd_pcm_t *pcm)
 	unsigned int i;
 	if (multi->slaves[0].linked)
 		return snd_pcm_drain(multi->slaves[0].linked);
+	if (multi->parallel) {
+		snd_pcm_multi_run(multi, MULTI_OP_DRAIN);
+		return snd_pcm_multi_run_error(multi);
+	}
 	for (i = 0; i < multi->slaves_count; ++i) {
 		if (multi->slaves[i].linked)
 			continue;
@@ -591,64 +921,62 @@ static snd_pcm_sframes_t snd_pcm_multi_forwardable(snd_pcm_t *pcm)
 
 }
 
-static snd_pcm_sframes_t snd_pcm_multi_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
+/*
+ * The slaves share the application pointer of the multi PCM, so they are
+ * moved together: by no more than all of them can move, which each slave
+ * then normally does, and on all of them at once with the parallel
+ * option.  A slave which still moved less than the others, e.g. a plugin
+ * rounding to its own frames, sets how far the whole PCM moves and the
+ * others are moved back to it.
+ */
+static snd_pcm_sframes_t snd_pcm_multi_move(snd_pcm_t *pcm,
+					    snd_pcm_uframes_t frames,
+					    int rewind)
 {
 	snd_pcm_multi_t *multi = pcm->private_data;
+	snd_pcm_sframes_t avail, result;
+	snd_pcm_uframes_t f;
 	unsigned int i;
-	snd_pcm_uframes_t pos[multi->slaves_count];
-	memset(pos, 0, sizeof(pos));
+
+	avail = rewind ? snd_pcm_multi_rewindable(pcm) :
+			 snd_pcm_multi_forwardable(pcm);
+	if (avail <= 0)
+		return avail;
+	if (frames > (snd_pcm_uframes_t)avail)
+		frames = avail;
+	multi->size = frames;
+	snd_pcm_multi_run(multi, rewind ? MULTI_OP_REWIND : MULTI_OP_FORWARD);
 	for (i = 0; i < multi->slaves_count; ++i) {
-		snd_pcm_t *slave_i = multi->slaves[i].pcm;
-		snd_pcm_sframes_t f = snd_pcm_rewind(slave_i, frames);
-		if (f < 0)
-			return f;
-		pos[i] = f;
-		frames = f;
+		result = multi->slaves[i].result;
+		if (result < 0)
+			return result;
+		if ((snd_pcm_uframes_t)result < frames)
+			frames = result;
 	}
 	/* Realign the pointers */
 	for (i = 0; i < multi->slaves_count; ++i) {
 		snd_pcm_t *slave_i = multi->slaves[i].pcm;
-		snd_pcm_uframes_t f = pos[i] - frames;
-		snd_pcm_sframes_t result;
-		if (f > 0) {
-			result = INTERNAL(snd_pcm_forward)(slave_i, f);
-			if (result < 0)
-				return result;
-			if ((snd_pcm_uframes_t)result != f)
-				return -EIO;
-		}
+		f = multi->slaves[i].result - frames;
+		if (!f)
+			continue;
+		result = rewind ? INTERNAL(snd_pcm_forward)(slave_i, f) :
+				  snd_pcm_rewind(slave_i, f);
+		if (result < 0)
+			return result;
+		if ((snd_pcm_uframes_t)result != f)
+			return -EIO;
 	}
 	return frames;
 }
 
+static snd_pcm_sframes_t snd_pcm_multi_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
+{
+	return snd_pcm_multi_move(pcm, frames, 1);
+}
+
 static snd_pcm_sframes_t snd_pcm_multi_forward(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
 {
-	snd_pcm_multi_t *multi = pcm->private_data;
-	unsigned int i;
-	snd_pcm_uframes_t pos[multi->slaves_count];
-	memset(pos, 0, sizeof(pos));
-	for (i = 0; i < multi->slaves_count; ++i) {
-		snd_pcm_t *slave_i = multi->slaves[i].pcm;
-		snd_pcm_sframes_t f = INTERNAL(snd_pcm_forward)(slave_i, frames);
-		if (f < 0)
-			return f;
-		pos[i] = f;
-		frames = f;
-	}
-	/* Realign the pointers */
-	for (i = 0; i < multi->slaves_count; ++i) {
-		snd_pcm_t *slave_i = multi->slaves[i].pcm;
-		snd_pcm_uframes_t f = pos[i] - frames;
-		snd_pcm_sframes_t result;
-		if (f > 0) {
-			result = snd_pcm_rewind(slave_i, f);
-			if (result < 0)
-				return result;
-			if ((snd_pcm_uframes_t)result != f)
-				return -EIO;
-		}
-	}
-	return frames;
+	return snd_pcm_multi_move(pcm, frames, 0);
 }
 
 static int snd_pcm_multi_resume(snd_pcm_t *pcm)
@@ -723,6 +1051,19 @@ static snd_pcm_sframes_t snd_pcm_multi_mmap_commit(snd_pcm_t *pcm,
 	unsigned int i;
 	snd_pcm_sframes_t result;
 
+	if (multi->parallel) {
+		multi->offset = offset;
+		multi->size = size;
+		snd_pcm_multi_run(multi, MULTI_OP_MMAP_COMMIT);
+		for (i = 0; i < multi->slaves_count; ++i) {
+			result = multi->slaves[i].result;
+			if (result < 0)
+				return result;
+			if ((snd_pcm_uframes_t)result != size)
+				return -EIO;
+		}
+		return size;
+	}
 	for (i = 0; i < multi->slaves_count; ++i) {
 		slave = multi->slaves[i].pcm;
 		result = snd_pcm_mmap_commit(slave, offset, size);
@@ -927,6 +1268,21 @@ static void snd_pcm_multi_dump(snd_pcm_t *pcm, snd_output_t *out)
 		snd_output_printf(out, "    %d: slave %d, channel %d\n", 
 			k, c->slave_idx, c->slave_channel);
 	}
+	if (multi->drift_threshold && pcm->setup) {
+		long long frames = snd_pcm_multi_ts_diff(&multi->drift_last,
+							 &multi->drift_start) *
+				   pcm->rate / 1000000000LL;
+		snd_output_printf(out, "  Drift to the master (threshold %lu):\n",
+				  (unsigned long)multi->drift_threshold);
+		for (k = 0; k < multi->slaves_count; ++k) {
+			snd_pcm_multi_slave_t *slave = &multi->slaves[k];
+			if (!slave->drift_valid)
+				continue;
+			snd_output_printf(out, "    slave %d: %ld frames (%lld ppm)\n",
+					  k, (long)slave->drift, frames > 0 ?
+					  slave->drift * 1000000LL / frames : 0);
+		}
+	}
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -1112,9 +1468,33 @@ pcm.name {
 		}
 	}
 	[master INT]		# Define the master slave
+	[parallel BOOL]		# Run the slave operations concurrently
+	[drift_threshold INT]	# Report slave clock drift over INT frames
 }
 \endcode
 
+With <code>parallel</code> set, each slave besides the first one gets a
+worker thread, and the operations touching every slave (avail_update,
+mmap_commit, rewind, forward, status, prepare, reset, start, drop and
+drain) run on all slaves concurrently; a call then costs as much as the
+slowest slave instead of all slaves together, which pays off for slaves
+with expensive system calls like several USB devices.  The status is
+then a snapshot of all slaves with the least avail and the largest
+delay.
+
+The channel areas of the multi PCM are those of the slaves, so the
+mmap access and the plugins above write straight into the slave
+buffers without a copy.  A rewind or forward moves all slaves by the
+same number of frames, at most what every slave can move.
+
+Slaves which are not linked to the master run on their own clocks and
+slowly drift apart.  With <code>drift_threshold</code> set, the plugin
+follows the position of each such slave against the master through
+their htimestamps, reports a slave drifting off by more than the given
+number of frames and shows the drift and its rate in ppm in the dump.
+The slaves share the application pointer of the multi PCM, so the drift
+cannot be corrected here; put a rate plugin on a slave to adjust it.
+
 For example, to bind two PCM streams with two-channel stereo (hw:0,0 and
 hw:0,1) as one 4-channel stereo PCM stream, define like this:
 \code
@@ -1191,6 +1571,8 @@ int _snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 	unsigned int *channels_schannel = NULL;
 	unsigned int slaves_count = 0;
 	long master_slave = 0;
+	int parallel = 0;
+	long drift_threshold = 0;
 	unsigned int channels_count = 0;
 	snd_config_for_each(i, inext, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1222,6 +1604,20 @@ int _snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 			}
 			continue;
 		}
+		if (strcmp(id, "drift_threshold") == 0) {
+			if (snd_config_get_integer(n, &drift_threshold) < 0 ||
+			    drift_threshold < 0) {
+				SNDERR("Invalid value for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (strcmp(id, "parallel") == 0) {
+			parallel = snd_config_get_bool(n);
+			if (parallel < 0)
+				return -EINVAL;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1371,6 +1767,18 @@ int _snd_pcm_multi_open(snd_pcm_t **pcmp, const char *name,
 				 channels_count,
 				 channels_sidx, channels_schannel,
 				 1);
+	if (err >= 0)
+		((snd_pcm_multi_t *)(*pcmp)->private_data)->drift_threshold =
+			drift_threshold;
+	if (err >= 0 && parallel) {
+		snd_pcm_multi_t *multi = (*pcmp)->private_data;
+		err = snd_pcm_multi_start_workers(multi);
+		if (err < 0) {
+			/* the slaves are closed with the multi PCM */
+			snd_pcm_close(*pcmp);
+			goto _free_conf;
+		}
+	}
 _free:
 	if (err < 0) {
 		for (idx = 0; idx < slaves_count; ++idx) {
@@ -1378,6 +1786,7 @@ _free:
 				snd_pcm_close(slaves_pcm[idx]);
 		}
 	}
+_free_conf:
 	if (slaves_conf) {
 		for (idx = 0; idx < slaves_count; ++idx) {
 			if (slaves_conf[idx])
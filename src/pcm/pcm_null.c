@@ -28,6 +28,7 @@
   
 #include "bswap.h"
 #include <limits.h>
+#include <sys/timerfd.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
 
@@ -44,13 +45,119 @@ typedef struct {
 	snd_pcm_uframes_t hw_ptr;
 	int poll_fd;
 	snd_pcm_chmap_query_t **chmap;
+	/* clock emulation, hw_ptr follows the monotonic clock */
+	int realtime;
+	double speed;			/* clock rate relative to realtime */
+	int timer_fd;
+	unsigned long long clock_base;	/* ns at the (re)start */
+	snd_pcm_uframes_t clock_frames;	/* frames elapsed since clock_base */
+	/* throughput statistics */
+	int stats;
+	unsigned long long frames;
+	unsigned long long periods;
+	unsigned long long first_ns;
+	unsigned long long period_start_ns;
+	unsigned long long period_total_ns;
+	unsigned long long period_max_ns;
+	snd_pcm_uframes_t period_pos;
 } snd_pcm_null_t;
 #endif
 
+static inline unsigned long long snd_pcm_null_now(void)
+{
+	snd_htimestamp_t ts;
+
+	gettimestamp(&ts, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* account frames passed by the application */
+static void snd_pcm_null_account(snd_pcm_t *pcm, snd_pcm_uframes_t size)
+{
+	snd_pcm_null_t *null = pcm->private_data;
+	unsigned long long now, dt;
+	snd_pcm_uframes_t n;
+
+	if (!null->stats || !size)
+		return;
+	now = snd_pcm_null_now();
+	if (!null->frames)
+		null->first_ns = null->period_start_ns = now;
+	null->frames += size;
+	null->period_pos += size;
+	if (null->period_pos < pcm->period_size)
+		return;
+	n = null->period_pos / pcm->period_size;
+	null->period_pos %= pcm->period_size;
+	null->periods += n;
+	dt = now - null->period_start_ns;
+	null->period_total_ns += dt;
+	if (dt / n > null->period_max_ns)
+		null->period_max_ns = dt / n;
+	null->period_start_ns = now;
+}
+
+/* arm the wakeup timer; zero interval disarms, ~0 fires once at once */
+static void snd_pcm_null_set_timer(snd_pcm_null_t *null, unsigned long long interval)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	if (interval == ~0ULL) {
+		its.it_value.tv_nsec = 1;
+	} else {
+		its.it_interval.tv_sec = interval / 1000000000ULL;
+		its.it_interval.tv_nsec = interval % 1000000000ULL;
+		its.it_value = its.it_interval;
+	}
+	timerfd_settime(null->timer_fd, 0, &its, NULL);
+}
+
+/* restart the clock from the current hw_ptr */
+static void snd_pcm_null_clock_start(snd_pcm_t *pcm)
+{
+	snd_pcm_null_t *null = pcm->private_data;
+	snd_pcm_uframes_t wakeup = pcm->avail_min;
+
+	if (!wakeup || wakeup > pcm->period_size)
+		wakeup = pcm->period_size;
+	null->clock_base = snd_pcm_null_now();
+	null->clock_frames = 0;
+	snd_pcm_null_set_timer(null, wakeup * 1000000000ULL /
+			       (pcm->rate * null->speed));
+}
+
+/* move hw_ptr to the position of the emulated clock */
+static void snd_pcm_null_clock_update(snd_pcm_t *pcm)
+{
+	snd_pcm_null_t *null = pcm->private_data;
+	snd_pcm_uframes_t frames, delta, room;
+
+	if (null->state != SND_PCM_STATE_RUNNING)
+		return;
+	frames = (snd_pcm_uframes_t)((snd_pcm_null_now() - null->clock_base) *
+				     (pcm->rate * null->speed / 1000000000.0));
+	delta = frames - null->clock_frames;
+	if (!delta)
+		return;
+	null->clock_frames = frames;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		room = snd_pcm_mmap_playback_hw_avail(pcm);
+	else
+		room = pcm->buffer_size - snd_pcm_mmap_capture_avail(pcm);
+	snd_pcm_mmap_hw_forward(pcm, delta < room ? delta : room);
+	if (snd_pcm_mmap_avail(pcm) >= pcm->stop_threshold) {
+		null->state = SND_PCM_STATE_XRUN;
+		snd_pcm_null_set_timer(null, 0);
+	}
+}
+
 static int snd_pcm_null_close(snd_pcm_t *pcm)
 {
 	snd_pcm_null_t *null = pcm->private_data;
 	close(null->poll_fd);
+	if (null->timer_fd >= 0)
+		close(null->timer_fd);
 	free(null);
 	return 0;
 }
@@ -82,6 +189,12 @@ static int snd_pcm_null_info(snd_pcm_t *pcm, snd_pcm_info_t * info)
 static snd_pcm_sframes_t snd_pcm_null_avail_update(snd_pcm_t *pcm)
 {
 	snd_pcm_null_t *null = pcm->private_data;
+	if (null->realtime) {
+		snd_pcm_null_clock_update(pcm);
+		if (null->state == SND_PCM_STATE_XRUN)
+			return -EPIPE;
+		return snd_pcm_mmap_avail(pcm);
+	}
         if (null->state == SND_PCM_STATE_PREPARED) {
                 /* it is required to return the correct avail count for */
                 /* the prepared stream, otherwise the start is not called */
@@ -99,6 +212,13 @@ static int snd_pcm_null_status(snd_pcm_t *pcm, snd_pcm_status_t * status)
 	gettimestamp(&status->tstamp, pcm->tstamp_type);
 	status->avail = snd_pcm_null_avail_update(pcm);
 	status->avail_max = pcm->buffer_size;
+	if (null->realtime) {
+		status->state = null->state;
+		status->avail = snd_pcm_mmap_avail(pcm);
+		status->delay = snd_pcm_mmap_hw_avail(pcm);
+		status->appl_ptr = *pcm->appl.ptr;
+		status->hw_ptr = *pcm->hw.ptr;
+	}
 	return 0;
 }
 
@@ -108,13 +228,22 @@ static snd_pcm_state_t snd_pcm_null_state(snd_pcm_t *pcm)
 	return null->state;
 }
 
-static int snd_pcm_null_hwsync(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+static int snd_pcm_null_hwsync(snd_pcm_t *pcm)
 {
+	snd_pcm_null_t *null = pcm->private_data;
+	if (null->realtime)
+		snd_pcm_null_clock_update(pcm);
 	return 0;
 }
 
-static int snd_pcm_null_delay(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_sframes_t *delayp)
+static int snd_pcm_null_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp)
 {
+	snd_pcm_null_t *null = pcm->private_data;
+	if (null->realtime) {
+		snd_pcm_null_clock_update(pcm);
+		*delayp = snd_pcm_mmap_hw_avail(pcm);
+		return 0;
+	}
 	*delayp = 0;
 	return 0;
 }
@@ -130,6 +259,9 @@ static int snd_pcm_null_prepare(snd_pcm_t *pcm)
 {
 	snd_pcm_null_t *null = pcm->private_data;
 	null->state = SND_PCM_STATE_PREPARED;
+	null->period_pos = 0;
+	if (null->realtime)	/* report the empty buffer to poll() */
+		snd_pcm_null_set_timer(null, ~0ULL);
 	return snd_pcm_null_reset(pcm);
 }
 
@@ -138,6 +270,11 @@ static int snd_pcm_null_start(snd_pcm_t *pcm)
 	snd_pcm_null_t *null = pcm->private_data;
 	assert(null->state == SND_PCM_STATE_PREPARED);
 	null->state = SND_PCM_STATE_RUNNING;
+	if (null->realtime) {
+		/* the queued frames are played from hw_ptr on */
+		snd_pcm_null_clock_start(pcm);
+		return 0;
+	}
 	if (pcm->stream == SND_PCM_STREAM_CAPTURE)
 		*pcm->hw.ptr = *pcm->appl.ptr + pcm->buffer_size;
 	else
@@ -150,6 +287,8 @@ static int snd_pcm_null_drop(snd_pcm_t *pcm)
 	snd_pcm_null_t *null = pcm->private_data;
 	assert(null->state != SND_PCM_STATE_OPEN);
 	null->state = SND_PCM_STATE_SETUP;
+	if (null->realtime)
+		snd_pcm_null_set_timer(null, 0);
 	return 0;
 }
 
@@ -157,7 +296,23 @@ static int snd_pcm_null_drain(snd_pcm_t *pcm)
 {
 	snd_pcm_null_t *null = pcm->private_data;
 	assert(null->state != SND_PCM_STATE_OPEN);
+	if (null->realtime && null->state == SND_PCM_STATE_RUNNING &&
+	    pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		/* play out the queued frames */
+		snd_pcm_null_clock_update(pcm);
+		if (null->state == SND_PCM_STATE_RUNNING) {
+			unsigned long long ns = snd_pcm_mmap_playback_hw_avail(pcm) *
+				1000000000ULL / (pcm->rate * null->speed);
+			struct timespec ts = {
+				.tv_sec = ns / 1000000000ULL,
+				.tv_nsec = ns % 1000000000ULL
+			};
+			nanosleep(&ts, NULL);
+		}
+	}
 	null->state = SND_PCM_STATE_SETUP;
+	if (null->realtime)
+		snd_pcm_null_set_timer(null, 0);
 	return 0;
 }
 
@@ -167,22 +322,38 @@ static int snd_pcm_null_pause(snd_pcm_t *pcm, int enable)
 	if (enable) {
 		if (null->state != SND_PCM_STATE_RUNNING)
 			return -EBADFD;
+		if (null->realtime) {
+			snd_pcm_null_clock_update(pcm);
+			snd_pcm_null_set_timer(null, 0);
+		}
 		null->state = SND_PCM_STATE_PAUSED;
 	} else {
 		if (null->state != SND_PCM_STATE_PAUSED)
 			return -EBADFD;
 		null->state = SND_PCM_STATE_RUNNING;
+		if (null->realtime)
+			snd_pcm_null_clock_start(pcm);
 	}
 	return 0;
 }
 
 static snd_pcm_sframes_t snd_pcm_null_rewindable(snd_pcm_t *pcm)
 {
+	snd_pcm_null_t *null = pcm->private_data;
+	if (null->realtime) {
+		snd_pcm_null_clock_update(pcm);
+		return snd_pcm_mmap_hw_avail(pcm);
+	}
 	return pcm->buffer_size;
 }
 
-static snd_pcm_sframes_t snd_pcm_null_forwardable(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+static snd_pcm_sframes_t snd_pcm_null_forwardable(snd_pcm_t *pcm)
 {
+	snd_pcm_null_t *null = pcm->private_data;
+	if (null->realtime) {
+		snd_pcm_null_clock_update(pcm);
+		return snd_pcm_mmap_avail(pcm);
+	}
 	return 0;
 }
 
@@ -190,6 +361,13 @@ static snd_pcm_sframes_t snd_pcm_null_forwardable(snd_pcm_t *pcm ATTRIBUTE_UNUSE
 static snd_pcm_sframes_t snd_pcm_null_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
 {
 	snd_pcm_null_t *null = pcm->private_data;
+	if (null->realtime) {
+		snd_pcm_sframes_t avail = snd_pcm_null_rewindable(pcm);
+		if ((snd_pcm_uframes_t)avail < frames)
+			frames = avail;
+		snd_pcm_mmap_appl_backward(pcm, frames);
+		return frames;
+	}
 	switch (null->state) {
 	case SND_PCM_STATE_RUNNING:
 		snd_pcm_mmap_hw_backward(pcm, frames);
@@ -205,6 +383,13 @@ static snd_pcm_sframes_t snd_pcm_null_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t f
 static snd_pcm_sframes_t snd_pcm_null_forward(snd_pcm_t *pcm, snd_pcm_uframes_t frames)
 {
 	snd_pcm_null_t *null = pcm->private_data;
+	if (null->realtime) {
+		snd_pcm_sframes_t avail = snd_pcm_null_forwardable(pcm);
+		if ((snd_pcm_uframes_t)avail < frames)
+			frames = avail;
+		snd_pcm_mmap_appl_forward(pcm, frames);
+		return frames;
+	}
 	switch (null->state) {
 	case SND_PCM_STATE_RUNNING:
 		snd_pcm_mmap_hw_forward(pcm, frames);
@@ -227,8 +412,11 @@ static snd_pcm_sframes_t snd_pcm_null_xfer_areas(snd_pcm_t *pcm,
 						 snd_pcm_uframes_t offset ATTRIBUTE_UNUSED,
 						 snd_pcm_uframes_t size)
 {
+	snd_pcm_null_t *null = pcm->private_data;
 	snd_pcm_mmap_appl_forward(pcm, size);
-	snd_pcm_mmap_hw_forward(pcm, size);
+	if (!null->realtime)
+		snd_pcm_mmap_hw_forward(pcm, size);
+	snd_pcm_null_account(pcm, size);
 	return size;
 }
 
@@ -256,9 +444,46 @@ static snd_pcm_sframes_t snd_pcm_null_mmap_commit(snd_pcm_t *pcm,
 						  snd_pcm_uframes_t offset ATTRIBUTE_UNUSED,
 						  snd_pcm_uframes_t size)
 {
+	snd_pcm_null_t *null = pcm->private_data;
+	snd_pcm_null_account(pcm, size);
+	if (null->realtime) {
+		snd_pcm_mmap_appl_forward(pcm, size);
+		return size;
+	}
 	return snd_pcm_null_forward(pcm, size);
 }
 
+static int snd_pcm_null_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds,
+				     unsigned int nfds, unsigned short *revents)
+{
+	snd_pcm_null_t *null = pcm->private_data;
+	unsigned long long expirations;
+	unsigned short events;
+
+	if (nfds != 1 || pfds->fd != null->timer_fd)
+		return -EINVAL;
+	if (pfds->revents & POLLIN) {
+		/* only the readiness matters, not the count */
+		if (read(null->timer_fd, &expirations, sizeof(expirations)) < 0)
+			expirations = 0;
+	}
+	events = pcm->stream == SND_PCM_STREAM_PLAYBACK ? POLLOUT : POLLIN;
+	snd_pcm_null_clock_update(pcm);
+	switch (null->state) {
+	case SND_PCM_STATE_XRUN:
+		*revents = events | POLLERR;
+		break;
+	case SND_PCM_STATE_RUNNING:
+	case SND_PCM_STATE_PREPARED:
+		*revents = snd_pcm_mmap_avail(pcm) >= pcm->avail_min ? events : 0;
+		break;
+	default:
+		*revents = 0;
+		break;
+	}
+	return 0;
+}
+
 static int snd_pcm_null_hw_refine(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t *params)
 {
 	int err = snd_pcm_hw_refine_soft(pcm, params);
@@ -303,7 +528,24 @@ static snd_pcm_chmap_t *snd_pcm_null_get_chmap(snd_pcm_t *pcm)
 
 static void snd_pcm_null_dump(snd_pcm_t *pcm, snd_output_t *out)
 {
+	snd_pcm_null_t *null = pcm->private_data;
+
 	snd_output_printf(out, "Null PCM\n");
+	if (null->realtime)
+		snd_output_printf(out, "  clock: realtime x%g\n", null->speed);
+	if (null->stats && null->frames) {
+		double secs = (null->period_start_ns - null->first_ns) / 1000000000.0;
+		snd_output_printf(out, "  frames: %llu in %.6f s", null->frames, secs);
+		if (secs > 0 && pcm->rate)
+			snd_output_printf(out, " (%.2fx realtime)",
+					  null->frames / (secs * pcm->rate));
+		snd_output_printf(out, "\n  periods: %llu", null->periods);
+		if (null->periods)
+			snd_output_printf(out, ", avg %llu ns, max %llu ns",
+					  null->period_total_ns / null->periods,
+					  null->period_max_ns);
+		snd_output_printf(out, "\n");
+	}
 	if (pcm->setup) {
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
@@ -353,6 +595,33 @@ static const snd_pcm_fast_ops_t snd_pcm_null_fast_ops = {
 	.htimestamp = snd_pcm_generic_real_htimestamp,
 };
 
+/* the clock emulation wakes up poll() from a timerfd */
+static const snd_pcm_fast_ops_t snd_pcm_null_clock_fast_ops = {
+	.status = snd_pcm_null_status,
+	.state = snd_pcm_null_state,
+	.hwsync = snd_pcm_null_hwsync,
+	.delay = snd_pcm_null_delay,
+	.prepare = snd_pcm_null_prepare,
+	.reset = snd_pcm_null_reset,
+	.start = snd_pcm_null_start,
+	.drop = snd_pcm_null_drop,
+	.drain = snd_pcm_null_drain,
+	.pause = snd_pcm_null_pause,
+	.rewindable = snd_pcm_null_rewindable,
+	.rewind = snd_pcm_null_rewind,
+	.forwardable = snd_pcm_null_forwardable,
+	.forward = snd_pcm_null_forward,
+	.resume = snd_pcm_null_resume,
+	.writei = snd_pcm_null_writei,
+	.writen = snd_pcm_null_writen,
+	.readi = snd_pcm_null_readi,
+	.readn = snd_pcm_null_readn,
+	.avail_update = snd_pcm_null_avail_update,
+	.mmap_commit = snd_pcm_null_mmap_commit,
+	.htimestamp = snd_pcm_generic_real_htimestamp,
+	.poll_revents = snd_pcm_null_poll_revents,
+};
+
 /**
  * \brief Creates a new null PCM
  * \param pcmp Returns created PCM handle
@@ -390,6 +659,8 @@ int snd_pcm_null_open(snd_pcm_t **pcmp, const char *name, snd_pcm_stream_t strea
 		return -ENOMEM;
 	}
 	null->poll_fd = fd;
+	null->timer_fd = -1;
+	null->speed = 1.0;
 	null->state = SND_PCM_STATE_OPEN;
 	
 	err = snd_pcm_new(&pcm, SND_PCM_TYPE_NULL, name, stream, mode);
@@ -424,9 +695,24 @@ and /dev/full (capture, must be readable).
 pcm.name {
         type null               # Null PCM
 	[chmap MAP]		# Provide channel maps; MAP is a string array
+	[clock STR]		# "fast" (default) or "realtime"
+	[speed REAL]		# realtime clock speed factor (default 1.0)
+	[stats BOOL]		# Collect throughput statistics (default no)
 }
 \endcode
 
+By default the stream position follows the transfers at once, so a
+chain of plugins on top runs as fast as the CPU allows.  With clock
+realtime the hardware pointer advances with the monotonic clock like
+a sound card, scaled by speed (e.g. 4.0 runs four times faster than
+realtime); the stream then wakes up poll() once per period and can
+run into an xrun.
+
+With stats, snd_pcm_dump() reports the frames passed, the throughput
+relative to realtime and the average and maximal time between two
+completed periods, i.e. the time the chain above needs per period
+with the fast clock.
+
 \subsection pcm_plugins_null_funcref Function reference
 
 <UL>
@@ -456,6 +742,8 @@ int _snd_pcm_null_open(snd_pcm_t **pcmp, const char *name,
 	snd_config_iterator_t i, next;
 	snd_pcm_null_t *null;
 	snd_pcm_chmap_query_t **chmap = NULL;
+	int realtime = 0, stats = 0;
+	double speed = 1.0;
 	int err;
 
 	snd_config_for_each(i, next, conf) {
@@ -474,19 +762,70 @@ int _snd_pcm_null_open(snd_pcm_t **pcmp, const char *name,
 			}
 			continue;
 		}
+		if (strcmp(id, "clock") == 0) {
+			const char *str;
+			err = snd_config_get_string(n, &str);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				goto _err;
+			}
+			if (strcmp(str, "realtime") == 0)
+				realtime = 1;
+			else if (strcmp(str, "fast") == 0)
+				realtime = 0;
+			else {
+				SNDERR("Invalid clock %s", str);
+				err = -EINVAL;
+				goto _err;
+			}
+			continue;
+		}
+		if (strcmp(id, "speed") == 0) {
+			err = snd_config_get_ireal(n, &speed);
+			if (err < 0 || speed <= 0) {
+				SNDERR("Invalid value for %s", id);
+				err = -EINVAL;
+				goto _err;
+			}
+			continue;
+		}
+		if (strcmp(id, "stats") == 0) {
+			err = snd_config_get_bool(n);
+			if (err < 0)
+				goto _err;
+			stats = err;
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
-		snd_pcm_free_chmaps(chmap);
-		return -EINVAL;
+		err = -EINVAL;
+		goto _err;
 	}
 	err = snd_pcm_null_open(pcmp, name, stream, mode);
-	if (err < 0) {
-		snd_pcm_free_chmaps(chmap);
-		return err;
-	}
+	if (err < 0)
+		goto _err;
 
 	null = (*pcmp)->private_data;
+	null->stats = stats;
+	if (realtime) {
+		null->timer_fd = timerfd_create(CLOCK_MONOTONIC,
+						TFD_NONBLOCK | TFD_CLOEXEC);
+		if (null->timer_fd < 0) {
+			SYSERR("Cannot create timerfd");
+			err = -errno;
+			snd_pcm_close(*pcmp);
+			goto _err;
+		}
+		null->realtime = 1;
+		null->speed = speed;
+		(*pcmp)->fast_ops = &snd_pcm_null_clock_fast_ops;
+		(*pcmp)->poll_fd = null->timer_fd;
+		(*pcmp)->poll_events = POLLIN;
+	}
 	null->chmap = chmap;
 	return 0;
+ _err:
+	snd_pcm_free_chmaps(chmap);
+	return err;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_null_open, SND_PCM_DLSYM_VERSION);
@@ -1744,7 +1744,7 @@ static int snd_pcm_hw_rule_format(snd_pcm_hw_params_t *params,
 		int bits;
 		if (!snd_pcm_format_mask_test(mask, k))
 			continue;
-		bits = snd_pcm_format_physical_width(k);
+		bits = __snd_pcm_format_physical_width(k);
 		if (bits < 0)
 			continue;
 		if (!snd_interval_test(i, (unsigned int) bits)) {
@@ -1772,7 +1772,7 @@ static int snd_pcm_hw_rule_sample_bits(snd_pcm_hw_params_t *params,
 		int bits;
 		if (!snd_pcm_format_mask_test(mask, k))
 			continue;
-		bits = snd_pcm_format_physical_width(k);
+		bits = __snd_pcm_format_physical_width(k);
 		if (bits < 0)
 			continue;
 		if (min > (unsigned)bits)
@@ -2008,10 +2008,10 @@ int snd_pcm_hw_refine_soft(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t
 {
 	unsigned int k;
 	snd_interval_t *i;
-	unsigned int rstamps[RULES];
-	unsigned int vstamps[SND_PCM_HW_PARAM_LAST_INTERVAL + 1];
-	unsigned int stamp = 2;
-	int changed, again;
+	/* rules depending on each parameter, and rules still to be run */
+	unsigned int users[SND_PCM_HW_PARAM_LAST_INTERVAL + 1];
+	unsigned int pending = 0;
+	int changed;
 #ifdef RULES_DEBUG
 	snd_output_t *log;
 	snd_output_stdio_attach(&log, stderr, 0);
@@ -2041,24 +2041,28 @@ int snd_pcm_hw_refine_soft(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t
 			goto _err;
 	}
 
-	for (k = 0; k < RULES; k++)
-		rstamps[k] = 0;
+	/* a rule is run again only after one of its deps has changed */
+	assert(RULES <= sizeof(pending) * 8);
 	for (k = 0; k <= SND_PCM_HW_PARAM_LAST_INTERVAL; k++)
-		vstamps[k] = (params->rmask & (1 << k)) ? 1 : 0;
-	do {
-		again = 0;
+		users[k] = 0;
+	for (k = 0; k < RULES; k++) {
+		const snd_pcm_hw_rule_t *r = &refine_rules[k];
+		unsigned int d;
+		for (d = 0; r->deps[d] >= 0; d++) {
+			users[r->deps[d]] |= 1U << k;
+			if (params->rmask & (1 << r->deps[d]))
+				pending |= 1U << k;
+		}
+	}
+	while (pending) {
 		for (k = 0; k < RULES; k++) {
 			const snd_pcm_hw_rule_t *r = &refine_rules[k];
+#ifdef RULES_DEBUG
 			unsigned int d;
-			int doit = 0;
-			for (d = 0; r->deps[d] >= 0; d++) {
-				if (vstamps[r->deps[d]] > rstamps[k]) {
-					doit = 1;
-					break;
-				}
-			}
-			if (!doit)
+#endif
+			if (!(pending & (1U << k)))
 				continue;
+			pending &= ~(1U << k);
 #ifdef RULES_DEBUG
 			snd_output_printf(log, "Rule %d (%p): ", k, r->func);
 			if (r->var >= 0) {
@@ -2077,17 +2081,14 @@ int snd_pcm_hw_refine_soft(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t
 			}
 			snd_output_putc(log, '\n');
 #endif
-			rstamps[k] = stamp;
 			if (changed && r->var >= 0) {
 				params->cmask |= 1 << r->var;
-				vstamps[r->var] = stamp;
-				again = 1;
+				pending |= users[r->var] & ~(1U << k);
 			}
 			if (changed < 0)
 				goto _err;
-			stamp++;
 		}
-	} while (again);
+	}
 	if (!params->msbits) {
 		i = hw_param_interval(params, SND_PCM_HW_PARAM_SAMPLE_BITS);
 		if (snd_interval_single(i))
@@ -2280,9 +2281,123 @@ static int snd_pcm_sw_params_default(snd_pcm_t *pcm, snd_pcm_sw_params_t *params
 #define REFINE_DEBUG
 #endif
 
+/*
+ * Memoized refine results.  A refine is a pure function of the input
+ * params for a given PCM as long as the constraints of the chain don't
+ * change, so the last few results are kept per PCM, keyed by the whole
+ * input struct.  Anything which may alter constraints (hw_params and
+ * hw_free on any PCM, ioplug/extplug parameter changes) bumps the global
+ * generation, which drops every cached entry.
+ *
+ * Only refines done entirely in software are kept.  What the kernel or
+ * a shared slave answers depends on state outside of the handle (other
+ * substreams, linked clocks, rates locked by other processes), so a
+ * refine which reached such a PCM is never stored, neither for that PCM
+ * nor for the plugins above it.
+ */
+#define REFINE_CACHE_SIZE	4
+
+#ifdef HAVE___THREAD
+#define TLS_PFX		__thread
+#else
+#define TLS_PFX		/* NOP */
+#endif
+
+struct snd_pcm_refine_cache {
+	unsigned int generation;
+	unsigned int next;
+	unsigned int count;
+	struct {
+		snd_pcm_hw_params_t in;
+		snd_pcm_hw_params_t out;
+		int res;
+	} entry[REFINE_CACHE_SIZE];
+};
+
+static unsigned int refine_generation;
+/* set while a refine of this thread reached a PCM which is not cached */
+static TLS_PFX int refine_uncached;
+
+void snd_pcm_hw_refine_invalidate(void)
+{
+	__atomic_add_fetch(&refine_generation, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline unsigned int refine_cache_generation(void)
+{
+	return __atomic_load_n(&refine_generation, __ATOMIC_SEQ_CST);
+}
+
+/* the answer depends on the kernel or on other processes */
+static int refine_cacheable(snd_pcm_t *pcm)
+{
+	switch (pcm->type) {
+	case SND_PCM_TYPE_HW:
+	case SND_PCM_TYPE_SHM:
+	case SND_PCM_TYPE_SHARE:
+	case SND_PCM_TYPE_DMIX:
+	case SND_PCM_TYPE_DSNOOP:
+	case SND_PCM_TYPE_DSHARE:
+		return 0;
+	default:
+		return 1;
+	}
+}
+
+static int refine_cache_lookup(snd_pcm_t *pcm, snd_pcm_hw_params_t *params,
+			       unsigned int generation, int *res)
+{
+	struct snd_pcm_refine_cache *cache = pcm->refine_cache;
+	unsigned int i;
+
+	if (!cache)
+		return 0;
+	if (cache->generation != generation) {
+		cache->generation = generation;
+		cache->count = 0;
+		cache->next = 0;
+		return 0;
+	}
+	for (i = 0; i < cache->count; i++) {
+		if (!memcmp(&cache->entry[i].in, params, sizeof(*params))) {
+			*params = cache->entry[i].out;
+			*res = cache->entry[i].res;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void refine_cache_store(snd_pcm_t *pcm, const snd_pcm_hw_params_t *in,
+			       const snd_pcm_hw_params_t *out,
+			       unsigned int generation, int res)
+{
+	struct snd_pcm_refine_cache *cache = pcm->refine_cache;
+	unsigned int i;
+
+	if (!cache) {
+		cache = snd_pcm_arena_alloc(pcm, sizeof(*cache));
+		if (!cache)
+			return;
+		cache->generation = generation;
+		pcm->refine_cache = cache;
+	}
+	if (cache->generation != generation)
+		return;
+	i = cache->next;
+	cache->entry[i].in = *in;
+	cache->entry[i].out = *out;
+	cache->entry[i].res = res;
+	cache->next = (i + 1) % REFINE_CACHE_SIZE;
+	if (cache->count < REFINE_CACHE_SIZE)
+		cache->count++;
+}
+
 int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
-	int res;
+	snd_pcm_hw_params_t in;
+	unsigned int generation;
+	int res, outer;
 #ifdef REFINE_DEBUG
 	snd_output_t *log;
 	snd_output_stdio_attach(&log, stderr, 0);
@@ -2292,7 +2407,23 @@ int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	snd_output_printf(log, "REFINE called:\n");
 	snd_pcm_hw_params_dump(params, log);
 #endif
+	if (!refine_cacheable(pcm)) {
+		res = pcm->ops->hw_refine(pcm->op_arg, params);
+		refine_uncached = 1;
+		goto _done;
+	}
+	generation = refine_cache_generation();
+	in = *params;
+	if (refine_cache_lookup(pcm, params, generation, &res))
+		goto _done;
+	outer = refine_uncached;
+	refine_uncached = 0;
 	res = pcm->ops->hw_refine(pcm->op_arg, params);
+	/* don't cache a result computed across a constraint change */
+	if (!refine_uncached && generation == refine_cache_generation())
+		refine_cache_store(pcm, &in, params, generation, res);
+	refine_uncached |= outer;
+ _done:
 #ifdef REFINE_DEBUG
 	snd_output_printf(log, "refine done - result = %i\n", res);
 	snd_pcm_hw_params_dump(params, log);
@@ -2313,23 +2444,153 @@ int snd_pcm_hw_refine(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
    max periods
    Return 0 on success otherwise a negative error code
 */
+/*
+ * Configuration plans: the outcome of snd_pcm_hw_params_choose() for a
+ * refined request, remembered across opens of the same named PCM (the
+ * search is the expensive part of every hw_params call).  A saved choice
+ * is checked with a single refine before use, so a device whose
+ * constraints changed in the meantime just falls back to the search.
+ */
+#define HW_PLAN_SIZE	16
+
+struct hw_plan {
+	char *name;
+	snd_pcm_type_t type;
+	snd_pcm_stream_t stream;
+	unsigned int lru;
+	snd_pcm_hw_params_t in;
+	snd_pcm_hw_params_t out;
+};
+
+static struct hw_plan hw_plans[HW_PLAN_SIZE];
+static unsigned int hw_plan_clock;
+
+#ifdef THREAD_SAFE_API
+static pthread_mutex_t hw_plan_mutex = PTHREAD_MUTEX_INITIALIZER;
+static inline void hw_plan_lock(void)
+{
+	pthread_mutex_lock(&hw_plan_mutex);
+}
+static inline void hw_plan_unlock(void)
+{
+	pthread_mutex_unlock(&hw_plan_mutex);
+}
+#else
+static inline void hw_plan_lock(void) {}
+static inline void hw_plan_unlock(void) {}
+#endif
+
+static struct hw_plan *hw_plan_find(snd_pcm_t *pcm,
+				    const snd_pcm_hw_params_t *params)
+{
+	unsigned int i;
+
+	if (!pcm->name)
+		return NULL;
+	for (i = 0; i < HW_PLAN_SIZE; i++) {
+		struct hw_plan *plan = &hw_plans[i];
+		if (plan->name && plan->type == pcm->type &&
+		    plan->stream == pcm->stream &&
+		    !strcmp(plan->name, pcm->name) &&
+		    !memcmp(&plan->in, params, sizeof(*params)))
+			return plan;
+	}
+	return NULL;
+}
+
+static int hw_plan_equal(const snd_pcm_hw_params_t *a,
+			 const snd_pcm_hw_params_t *b)
+{
+	return !memcmp(a->masks, b->masks, sizeof(a->masks)) &&
+		!memcmp(a->intervals, b->intervals, sizeof(a->intervals));
+}
+
+/* replace params with the saved choice; 0 if there is no usable one */
+static int hw_plan_apply(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
+{
+	struct hw_plan *plan;
+	snd_pcm_hw_params_t choice;
+
+	hw_plan_lock();
+	plan = hw_plan_find(pcm, params);
+	if (plan) {
+		choice = plan->out;
+		plan->lru = ++hw_plan_clock;
+	}
+	hw_plan_unlock();
+	if (!plan)
+		return 0;
+	if (snd_pcm_hw_refine(pcm, &choice) < 0 ||
+	    !hw_plan_equal(&choice, &plan->out))
+		return 0;
+	*params = choice;
+	return 1;
+}
+
+static void hw_plan_store(snd_pcm_t *pcm, const snd_pcm_hw_params_t *in,
+			  const snd_pcm_hw_params_t *out)
+{
+	struct hw_plan *plan, *victim = NULL;
+	unsigned int i;
+	char *name;
+
+	if (!pcm->name)
+		return;
+	hw_plan_lock();
+	plan = hw_plan_find(pcm, in);
+	if (!plan) {
+		for (i = 0; i < HW_PLAN_SIZE; i++) {
+			plan = &hw_plans[i];
+			if (!plan->name) {
+				victim = plan;
+				break;
+			}
+			if (!victim || plan->lru < victim->lru)
+				victim = plan;
+		}
+		name = strdup(pcm->name);
+		if (!name) {
+			hw_plan_unlock();
+			return;
+		}
+		plan = victim;
+		free(plan->name);
+		plan->name = name;
+		plan->type = pcm->type;
+		plan->stream = pcm->stream;
+		plan->in = *in;
+	}
+	plan->out = *out;
+	plan->lru = ++hw_plan_clock;
+	hw_plan_unlock();
+}
+
 int _snd_pcm_hw_params_internal(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
 	int err;
 	snd_pcm_sw_params_t sw;
 	int fb, min_align;
+	snd_pcm_hw_params_t request, choice;
+	int planned;
 	err = snd_pcm_hw_refine(pcm, params);
 	if (err < 0)
 		return err;
-	snd_pcm_hw_params_choose(pcm, params);
+	request = *params;
+	planned = hw_plan_apply(pcm, params);
+	if (!planned)
+		snd_pcm_hw_params_choose(pcm, params);
+	choice = *params;
 	if (pcm->setup) {
 		err = snd_pcm_hw_free(pcm);
 		if (err < 0)
 			return err;
 	}
 	err = pcm->ops->hw_params(pcm->op_arg, params);
+	snd_pcm_hw_refine_invalidate();
 	if (err < 0)
 		return err;
+	if (!planned)
+		hw_plan_store(pcm, &request, &choice);
 
 	pcm->setup = 1;
 	INTERNAL(snd_pcm_hw_params_get_access)(params, &pcm->access);
@@ -2340,7 +2601,7 @@ int _snd_pcm_hw_params_internal(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 	INTERNAL(snd_pcm_hw_params_get_period_time)(params, &pcm->period_time, 0);
 	INTERNAL(snd_pcm_hw_params_get_period_size)(params, &pcm->period_size, 0);
 	INTERNAL(snd_pcm_hw_params_get_buffer_size)(params, &pcm->buffer_size);
-	pcm->sample_bits = snd_pcm_format_physical_width(pcm->format);
+	pcm->sample_bits = __snd_pcm_format_physical_width(pcm->format);
 	pcm->frame_bits = pcm->sample_bits * pcm->channels;
 	fb = pcm->frame_bits;
 	min_align = 1;
@@ -55,6 +55,8 @@ typedef struct {
 	snd_pcm_route_ttable_entry_t *ttable;
 	int ttable_ok;
 	unsigned int tt_ssize, tt_cused, tt_sused;
+	int access_remap;		/* slave buffer is exposed as is */
+	snd_pcm_access_t saccess;	/* slave access when remapped */
 } snd_pcm_plug_t;
 
 #endif
@@ -311,7 +313,7 @@ static snd_pcm_format_t snd_pcm_plug_slave_format(snd_pcm_format_t format, const
 #endif
 		return SND_PCM_FORMAT_UNKNOWN;
 	} else {
-		w = snd_pcm_format_width(format);
+		w = __snd_pcm_format_width(format);
 		u = snd_pcm_format_unsigned(format);
 		e = snd_pcm_format_big_endian(format);
 	}
@@ -341,6 +343,7 @@ static void snd_pcm_plug_clear(snd_pcm_t *pcm)
 		pcm->fast_ops = slave->fast_ops;
 		pcm->fast_op_arg = slave->fast_op_arg;
 	}
+	plug->access_remap = 0;
 }
 
 #ifndef DOC_HIDDEN
@@ -385,7 +388,8 @@ static int snd_pcm_plug_change_channels(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm
 	if (clt->rate != slv->rate &&
 	    clt->channels > slv->channels)
 		return 0;
-	assert(snd_pcm_format_linear(slv->format));
+	assert(snd_pcm_format_linear(slv->format) ||
+	       slv->format == SND_PCM_FORMAT_FLOAT);
 	tt_ssize = slv->channels;
 	tt_cused = clt->channels;
 	tt_sused = slv->channels;
@@ -527,6 +531,13 @@ static int snd_pcm_plug_change_format(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_p
 		if (snd_pcm_format_linear(clt->format)) {
 			cfmt = clt->format;
 			f = snd_pcm_lfloat_open;
+#ifdef BUILD_PCM_PLUGIN_ROUTE
+		} else if (clt->format == SND_PCM_FORMAT_FLOAT &&
+			   slv->format == SND_PCM_FORMAT_FLOAT &&
+			   clt->rate == slv->rate) {
+			/* the route plugin mixes native floats itself */
+			return 0;
+#endif
 		} else if (clt->rate != slv->rate || clt->channels != slv->channels ||
 			   (plug->ttable && !plug->ttable_ok)) {
 			cfmt = SND_PCM_FORMAT_S16;
@@ -569,12 +580,46 @@ static int snd_pcm_plug_change_format(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_p
 	return 1;
 }
 
+/*
+ * Check whether the mmap buffer of the slave can be handed to the client
+ * directly although the access types differ: a complex client takes any
+ * channel areas, and with one channel interleaved and non-interleaved
+ * buffers have the same layout.
+ */
+static int snd_pcm_plug_access_remap(snd_pcm_access_t caccess,
+				     snd_pcm_access_t saccess,
+				     unsigned int channels)
+{
+	switch (saccess) {
+	case SND_PCM_ACCESS_MMAP_INTERLEAVED:
+	case SND_PCM_ACCESS_MMAP_NONINTERLEAVED:
+		break;
+	default:
+		return 0;
+	}
+	switch (caccess) {
+	case SND_PCM_ACCESS_MMAP_COMPLEX:
+		return 1;
+	case SND_PCM_ACCESS_MMAP_INTERLEAVED:
+	case SND_PCM_ACCESS_MMAP_NONINTERLEAVED:
+		return channels == 1;
+	default:
+		return 0;
+	}
+}
+
 static int snd_pcm_plug_change_access(snd_pcm_t *pcm, snd_pcm_t **new, snd_pcm_plug_params_t *clt, snd_pcm_plug_params_t *slv)
 {
 	snd_pcm_plug_t *plug = pcm->private_data;
 	int err;
 	if (clt->access == slv->access)
 		return 0;
+	if (snd_pcm_plug_access_remap(clt->access, slv->access, clt->channels)) {
+		plug->access_remap = 1;
+		plug->saccess = slv->access;
+		slv->access = clt->access;
+		return 0;
+	}
 	err = snd_pcm_copy_open(new, NULL, plug->gen.slave, plug->gen.slave != plug->req_slave);
 	if (err < 0)
 		return err;
@@ -1024,7 +1069,18 @@ static int snd_pcm_plug_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 			return err;
 	}
 	slave = plug->gen.slave;
-	err = _snd_pcm_hw_params_internal(slave, params);
+	if (plug->access_remap) {
+		snd_pcm_access_mask_t *mask;
+
+		sparams = *params;
+		mask = (snd_pcm_access_mask_t *)
+			snd_pcm_hw_param_get_mask(&sparams,
+						  SND_PCM_HW_PARAM_ACCESS);
+		snd_pcm_access_mask_none(mask);
+		snd_pcm_access_mask_set(mask, plug->saccess);
+		err = _snd_pcm_hw_params_internal(slave, &sparams);
+	} else
+		err = _snd_pcm_hw_params_internal(slave, params);
 	if (err < 0) {
 		snd_pcm_plug_clear(pcm);
 		return err;
@@ -1173,6 +1229,11 @@ pcm.name {
 }
 \endcode
 
+When only the access type differs and the slave mmap buffer can be used
+as it is (a client requesting #SND_PCM_ACCESS_MMAP_COMPLEX, or a single
+channel where interleaved and non-interleaved layouts are equal), no copy
+plugin is inserted and the client works on the slave buffer directly.
+
 \subsection pcm_plugins_plug_funcref Function reference
 
 <UL>
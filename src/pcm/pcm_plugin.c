@@ -234,6 +234,188 @@ snd_pcm_sframes_t snd_pcm_plugin_forward(snd_pcm_t *pcm, snd_pcm_uframes_t frame
 	return (snd_pcm_sframes_t) frames;
 }
 
+/*
+ * Fused playback chains
+ *
+ * A chain of plugins (e.g. route -> linear -> lfloat as built by the plug
+ * plugin) normally converts each chunk into the mmap buffer of the next
+ * plugin which converts it again on its own commit, so every stage walks
+ * through a whole buffer of memory.  When the slave is a plugin as well,
+ * the chain is run block by block through two small scratch buffers and
+ * only the last stage writes into the buffer of the first real slave.
+ * All the transfer callbacks of the plugins converting 1:1 in frames is
+ * what makes this possible; the rate plugin has its own fast ops and so
+ * ends the chain.
+ */
+#define FUSED_MAX_STAGES	8
+#define FUSED_BLOCK_BYTES	8192
+
+static int snd_pcm_plugin_fusable(snd_pcm_t *pcm)
+{
+	snd_pcm_plugin_t *plugin;
+
+	if (pcm->fast_ops != &snd_pcm_plugin_fast_ops ||
+	    pcm->fast_op_arg != pcm ||
+	    pcm->stream != SND_PCM_STREAM_PLAYBACK || !pcm->setup)
+		return 0;
+	plugin = pcm->private_data;
+	return plugin->write &&
+		plugin->undo_write == snd_pcm_plugin_undo_write_generic;
+}
+
+static void snd_pcm_plugin_scratch_areas(snd_pcm_t *pcm,
+					 snd_pcm_channel_area_t *areas,
+					 void *buf)
+{
+	unsigned int width = __snd_pcm_format_physical_width(pcm->format);
+	unsigned int channel;
+
+	for (channel = 0; channel < pcm->channels; channel++) {
+		areas[channel].addr = buf;
+		areas[channel].first = channel * width;
+		areas[channel].step = pcm->channels * width;
+	}
+}
+
+typedef struct {
+	snd_pcm_t *stages[FUSED_MAX_STAGES];	/* stages[0] is the top plugin */
+	unsigned int nstages;
+	unsigned int channels;			/* max. channels of stages[1..] */
+	snd_pcm_t *sink;			/* first non-plugin slave */
+	snd_pcm_uframes_t block;		/* frames per scratch block */
+} snd_pcm_plugin_chain_t;
+
+/* returns the number of fused stages, 0 for the plain path */
+static unsigned int snd_pcm_plugin_chain(snd_pcm_t *pcm,
+					 snd_pcm_plugin_chain_t *chain)
+{
+	snd_pcm_plugin_t *plugin = pcm->private_data;
+	snd_pcm_t *slave = plugin->gen.slave;
+	unsigned int bits = 0;
+
+	if (!snd_pcm_plugin_fusable(slave) || !snd_pcm_plugin_fusable(pcm))
+		return 0;
+	chain->stages[0] = pcm;
+	chain->nstages = 1;
+	chain->channels = 0;
+	while (chain->nstages < FUSED_MAX_STAGES &&
+	       snd_pcm_plugin_fusable(slave)) {
+		unsigned int b = __snd_pcm_format_physical_width(slave->format) *
+			slave->channels;
+		if (b > bits)
+			bits = b;
+		if (slave->channels > chain->channels)
+			chain->channels = slave->channels;
+		chain->stages[chain->nstages++] = slave;
+		plugin = slave->private_data;
+		slave = plugin->gen.slave;
+	}
+	/* do not bother with blocks shorter than 16 frames */
+	if (bits == 0 || bits > FUSED_BLOCK_BYTES * 8 / 16)
+		return 0;
+	chain->sink = slave;
+	chain->block = FUSED_BLOCK_BYTES * 8 / bits;
+	return chain->nstages;
+}
+
+/*
+ * Run size frames from areas through the whole chain into the sink.
+ * The lock of stages[0] is held by the caller, the locks of the inner
+ * stages are taken in the same order as the plain path nests them.
+ */
+static snd_pcm_sframes_t
+snd_pcm_plugin_chain_write(snd_pcm_plugin_chain_t *chain,
+			   const snd_pcm_channel_area_t *areas,
+			   snd_pcm_uframes_t offset,
+			   snd_pcm_uframes_t size)
+{
+	u_int64_t scratch[2][FUSED_BLOCK_BYTES / sizeof(u_int64_t)];
+	snd_pcm_channel_area_t scratch_areas[chain->nstages][chain->channels];
+	unsigned int i, last = chain->nstages - 1;
+	snd_pcm_uframes_t xfer = 0;
+	snd_pcm_sframes_t result;
+	int err = 0;
+
+	/* input of stage i is the output of stage i - 1 */
+	for (i = 1; i < chain->nstages; i++)
+		snd_pcm_plugin_scratch_areas(chain->stages[i], scratch_areas[i],
+					     scratch[i & 1]);
+	while (size > 0) {
+		snd_pcm_uframes_t frames = size;
+		const snd_pcm_channel_area_t *src_areas = areas;
+		snd_pcm_uframes_t src_offset = offset;
+		const snd_pcm_channel_area_t *sink_areas;
+		snd_pcm_uframes_t sink_offset;
+		snd_pcm_uframes_t sink_frames = ULONG_MAX;
+
+		err = snd_pcm_mmap_begin(chain->sink, &sink_areas, &sink_offset,
+					 &sink_frames);
+		if (err < 0 || sink_frames == 0)
+			break;
+		if (frames > chain->block)
+			frames = chain->block;
+		if (frames > sink_frames)
+			frames = sink_frames;
+		for (i = 1; i < chain->nstages; i++) {
+			snd_pcm_lock(chain->stages[i]);
+			if (frames > snd_pcm_mmap_playback_avail(chain->stages[i]))
+				frames = snd_pcm_mmap_playback_avail(chain->stages[i]);
+		}
+		for (i = 0; i < chain->nstages && frames > 0; i++) {
+			snd_pcm_t *stage = chain->stages[i];
+			snd_pcm_plugin_t *plugin = stage->private_data;
+			const snd_pcm_channel_area_t *dst_areas;
+			snd_pcm_uframes_t dst_offset, dst_frames = frames;
+
+			if (i == last) {
+				dst_areas = sink_areas;
+				dst_offset = sink_offset;
+			} else {
+				dst_areas = scratch_areas[i + 1];
+				dst_offset = 0;
+			}
+			frames = plugin->write(stage, src_areas, src_offset,
+					       frames, dst_areas, dst_offset,
+					       &dst_frames);
+			src_areas = dst_areas;
+			src_offset = dst_offset;
+		}
+		result = frames > 0 ?
+			snd_pcm_mmap_commit(chain->sink, sink_offset, frames) : 0;
+		if (result > 0) {
+			/* all stages undo the generic way */
+			for (i = 1; i < chain->nstages; i++)
+				snd_pcm_mmap_appl_forward(chain->stages[i], result);
+		}
+		for (i = chain->nstages - 1; i > 0; i--)
+			snd_pcm_unlock(chain->stages[i]);
+		if (result <= 0) {
+			err = result;
+			break;
+		}
+		snd_pcm_mmap_appl_forward(chain->stages[0], result);
+		offset += result;
+		xfer += result;
+		size -= result;
+	}
+	return xfer > 0 ? (snd_pcm_sframes_t)xfer : err;
+}
+
+/*
+ * A transfer which reaches the end of the slave buffer is continued at
+ * its start and committed together when the commit of the slave takes a
+ * range across the end, so a wrap costs one pass through the slave
+ * instead of two.  The hw and null commits only move the pointer and the
+ * plugin commit splits the range itself.
+ */
+static int snd_pcm_plugin_commit_wraps(snd_pcm_t *slave)
+{
+	return slave->type == SND_PCM_TYPE_HW ||
+		slave->type == SND_PCM_TYPE_NULL ||
+		(slave->fast_ops == &snd_pcm_plugin_fast_ops &&
+		 slave->fast_op_arg == slave);
+}
+
 static snd_pcm_sframes_t snd_pcm_plugin_write_areas(snd_pcm_t *pcm,
 						    const snd_pcm_channel_area_t *areas,
 						    snd_pcm_uframes_t offset,
@@ -241,10 +423,13 @@ static snd_pcm_sframes_t snd_pcm_plugin_write_areas(snd_pcm_t *pcm,
 {
 	snd_pcm_plugin_t *plugin = pcm->private_data;
 	snd_pcm_t *slave = plugin->gen.slave;
+	snd_pcm_plugin_chain_t chain;
 	snd_pcm_uframes_t xfer = 0;
 	snd_pcm_sframes_t result;
 	int err;
 
+	if (snd_pcm_plugin_chain(pcm, &chain))
+		return snd_pcm_plugin_chain_write(&chain, areas, offset, size);
 	while (size > 0) {
 		snd_pcm_uframes_t frames = size;
 		const snd_pcm_channel_area_t *slave_areas;
@@ -256,6 +441,19 @@ static snd_pcm_sframes_t snd_pcm_plugin_write_areas(snd_pcm_t *pcm,
 			break;
 		frames = plugin->write(pcm, areas, offset, frames,
 				       slave_areas, slave_offset, &slave_frames);
+		if (frames < size &&
+		    slave_offset + slave_frames == slave->buffer_size &&
+		    plugin->undo_write == snd_pcm_plugin_undo_write_generic &&
+		    snd_pcm_plugin_commit_wraps(slave)) {
+			snd_pcm_uframes_t rest = snd_pcm_mmap_playback_avail(slave) - slave_frames;
+
+			if (rest > 0) {
+				frames += plugin->write(pcm, areas, offset + frames,
+							size - frames, slave_areas,
+							0, &rest);
+				slave_frames += rest;
+			}
+		}
 		if (CHECK_SANITY(slave_frames > snd_pcm_mmap_playback_avail(slave))) {
 			SNDMSG("write overflow %ld > %ld", slave_frames,
 			       snd_pcm_mmap_playback_avail(slave));
@@ -309,6 +507,19 @@ static snd_pcm_sframes_t snd_pcm_plugin_read_areas(snd_pcm_t *pcm,
 			break;
 		frames = (plugin->read)(pcm, areas, offset, frames,
 				      slave_areas, slave_offset, &slave_frames);
+		if (frames < size &&
+		    slave_offset + slave_frames == slave->buffer_size &&
+		    plugin->undo_read == snd_pcm_plugin_undo_read_generic &&
+		    snd_pcm_plugin_commit_wraps(slave)) {
+			snd_pcm_uframes_t rest = snd_pcm_mmap_capture_avail(slave) - slave_frames;
+
+			if (rest > 0) {
+				frames += (plugin->read)(pcm, areas, offset + frames,
+							 size - frames, slave_areas,
+							 0, &rest);
+				slave_frames += rest;
+			}
+		}
 		if (CHECK_SANITY(slave_frames > snd_pcm_mmap_capture_avail(slave))) {
 			SNDMSG("read overflow %ld > %ld", slave_frames,
 			       snd_pcm_mmap_playback_avail(slave));
@@ -389,6 +600,7 @@ snd_pcm_plugin_mmap_commit(snd_pcm_t *pcm,
 	snd_pcm_uframes_t appl_offset;
 	snd_pcm_sframes_t slave_size;
 	snd_pcm_sframes_t xfer;
+	snd_pcm_plugin_chain_t chain;
 	int err;
 
 	if (pcm->stream == SND_PCM_STREAM_CAPTURE) {
@@ -401,6 +613,31 @@ snd_pcm_plugin_mmap_commit(snd_pcm_t *pcm,
 	areas = snd_pcm_mmap_areas(pcm);
 	appl_offset = snd_pcm_mmap_offset(pcm);
 	xfer = 0;
+	if (snd_pcm_plugin_chain(pcm, &chain)) {
+		while (size > 0 && slave_size > 0) {
+			snd_pcm_uframes_t frames = size;
+			snd_pcm_uframes_t cont = pcm->buffer_size - appl_offset;
+			snd_pcm_sframes_t result;
+
+			if (frames > cont)
+				frames = cont;
+			if (frames > (snd_pcm_uframes_t)slave_size)
+				frames = slave_size;
+			result = snd_pcm_plugin_chain_write(&chain, areas,
+							    appl_offset, frames);
+			if (result <= 0) {
+				err = result;
+				goto error;
+			}
+			appl_offset = (appl_offset + result) % pcm->buffer_size;
+			size -= result;
+			slave_size -= result;
+			xfer += result;
+			if ((snd_pcm_uframes_t)result != frames)
+				break;
+		}
+		goto done;
+	}
 	while (size > 0 && slave_size > 0) {
 		snd_pcm_uframes_t frames = size;
 		snd_pcm_uframes_t cont = pcm->buffer_size - appl_offset;
@@ -440,6 +677,7 @@ snd_pcm_plugin_mmap_commit(snd_pcm_t *pcm,
 		slave_size -= frames;
 		xfer += frames;
 	}
+ done:
 	if (CHECK_SANITY(size)) {
 		SNDMSG("short commit: %ld", size);
 		return -EPIPE;
@@ -450,14 +688,14 @@ snd_pcm_plugin_mmap_commit(snd_pcm_t *pcm,
 	return xfer > 0 ? xfer : err;
 }
 
-static snd_pcm_sframes_t snd_pcm_plugin_avail_update(snd_pcm_t *pcm)
+/* follow the slave pointers, slave_size is the result of its avail update */
+static snd_pcm_sframes_t snd_pcm_plugin_sync_avail(snd_pcm_t *pcm,
+						   snd_pcm_sframes_t slave_size)
 {
 	snd_pcm_plugin_t *plugin = pcm->private_data;
 	snd_pcm_t *slave = plugin->gen.slave;
-	snd_pcm_sframes_t slave_size;
 	int err;
 
-	slave_size = snd_pcm_avail_update(slave);
 	if (pcm->stream == SND_PCM_STREAM_CAPTURE &&
 	    pcm->access != SND_PCM_ACCESS_RW_INTERLEAVED &&
 	    pcm->access != SND_PCM_ACCESS_RW_NONINTERLEAVED)
@@ -519,6 +757,14 @@ static snd_pcm_sframes_t snd_pcm_plugin_avail_update(snd_pcm_t *pcm)
 	}
 }
 
+static snd_pcm_sframes_t snd_pcm_plugin_avail_update(snd_pcm_t *pcm)
+{
+	snd_pcm_plugin_t *plugin = pcm->private_data;
+
+	return snd_pcm_plugin_sync_avail(pcm,
+					 snd_pcm_avail_update(plugin->gen.slave));
+}
+
 static int snd_pcm_plugin_status(snd_pcm_t *pcm, snd_pcm_status_t * status)
 {
 	snd_pcm_plugin_t *plugin = pcm->private_data;
@@ -535,6 +781,27 @@ static int snd_pcm_plugin_status(snd_pcm_t *pcm, snd_pcm_status_t * status)
 	return 0;
 }
 
+static int snd_pcm_plugin_avail_status(snd_pcm_t *pcm, snd_pcm_status_t *status)
+{
+	snd_pcm_plugin_t *plugin = pcm->private_data;
+	snd_pcm_sframes_t avail;
+	int err;
+
+	err = snd_pcm_avail_status(plugin->gen.slave, status);
+	if (err < 0)
+		return err;
+	avail = snd_pcm_plugin_sync_avail(pcm, status->avail);
+	if (avail >= 0)
+		status->avail = avail;
+	if (pcm->stream == SND_PCM_STREAM_CAPTURE &&
+	    pcm->access != SND_PCM_ACCESS_RW_INTERLEAVED &&
+	    pcm->access != SND_PCM_ACCESS_RW_NONINTERLEAVED)
+		status->delay += snd_pcm_mmap_capture_avail(pcm);
+	status->appl_ptr = *pcm->appl.ptr;
+	status->hw_ptr = *pcm->hw.ptr;
+	return 0;
+}
+
 const snd_pcm_fast_ops_t snd_pcm_plugin_fast_ops = {
 	.status = snd_pcm_plugin_status,
 	.state = snd_pcm_generic_state,
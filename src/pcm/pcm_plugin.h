@@ -62,6 +62,22 @@ typedef struct {
 	snd1_pcm_plugin_forward
 
 void snd_pcm_plugin_init(snd_pcm_plugin_t *plugin);
+
+/*
+ * Frames converted per pass over the channels when the two sides are laid
+ * out differently, e.g. an interleaved capture read into the planar
+ * buffers of snd_pcm_readn(): the interleaved side of a block stays in the
+ * cache while each of its channels is converted, instead of being read
+ * from memory once per channel.
+ */
+#define SND_PCM_PLUGIN_BLOCK_BYTES	16384
+
+static inline snd_pcm_uframes_t
+snd_pcm_plugin_block_frames(unsigned int channels, unsigned int width)
+{
+	snd_pcm_uframes_t frames = SND_PCM_PLUGIN_BLOCK_BYTES * 8 / (channels * width);
+	return frames < 64 ? 64 : frames;
+}
 snd_pcm_sframes_t snd_pcm_plugin_rewind(snd_pcm_t *pcm, snd_pcm_uframes_t frames);
 snd_pcm_sframes_t snd_pcm_plugin_forward(snd_pcm_t *pcm, snd_pcm_uframes_t frames);
 
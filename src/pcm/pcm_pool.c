@@ -0,0 +1,323 @@
+/*
+ *  PCM - pool of prepared handles
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * The pool moves the open, the hw_params, the sw_params and the prepare
+ * of a stream off its critical path.  It keeps handles of one PCM name
+ * set up with the same parameters and prepared; acquiring one pops it,
+ * releasing one drops its stream and prepares it again for the next
+ * user.  The opens behind the pool are the usual ones, so they profit
+ * from the configuration cache and from the saved hw_params choice of
+ * the PCM, and a refill is cheap after the first handle.
+ *
+ * A pool of N handles holds N streams of the device open: that needs a
+ * device with enough subdevices or a sharing plugin like dmix or dsnoop.
+ * A refill which cannot open another stream just keeps fewer handles.
+ */
+
+#include "pcm_local.h"
+
+#ifndef DOC_HIDDEN
+
+struct _snd_pcm_pool {
+	char *name;
+	snd_pcm_stream_t stream;
+	int mode;
+	snd_pcm_hw_params_t hw_params;
+	snd_pcm_sw_params_t sw_params;
+	int has_sw_params;
+	unsigned int count;		/* handles kept ready */
+	unsigned int avail;		/* handles in ready[] */
+	unsigned int pending;		/* opens of the refills in progress */
+	snd_pcm_t **ready;
+#ifdef THREAD_SAFE_API
+	pthread_mutex_t lock;
+#endif
+};
+
+#ifdef THREAD_SAFE_API
+static inline void pool_lock(snd_pcm_pool_t *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+}
+
+static inline void pool_unlock(snd_pcm_pool_t *pool)
+{
+	pthread_mutex_unlock(&pool->lock);
+}
+#else
+#define pool_lock(pool)		do { } while (0)
+#define pool_unlock(pool)	do { } while (0)
+#endif
+
+static int pool_open_one(snd_pcm_pool_t *pool, snd_pcm_t **pcmp)
+{
+	snd_pcm_hw_params_t hw_params = pool->hw_params;
+	snd_pcm_sw_params_t sw_params = pool->sw_params;
+	snd_pcm_t *pcm;
+	int err;
+
+	err = snd_pcm_open(&pcm, pool->name, pool->stream, pool->mode);
+	if (err < 0)
+		return err;
+	/* hw_params prepares the stream */
+	err = snd_pcm_hw_params(pcm, &hw_params);
+	if (err >= 0 && pool->has_sw_params)
+		err = snd_pcm_sw_params(pcm, &sw_params);
+	if (err < 0) {
+		snd_pcm_close(pcm);
+		return err;
+	}
+	*pcmp = pcm;
+	return 0;
+}
+
+/*
+ * make a handle ready to start again: a kept handle which is prepared
+ * has no frames queued yet, a released one may hold frames which were
+ * written but never started, so it is always dropped
+ */
+static int pool_rearm(snd_pcm_t *pcm, int released)
+{
+	switch (snd_pcm_state(pcm)) {
+	case SND_PCM_STATE_PREPARED:
+		if (!released)
+			return 0;
+		/* fall through */
+	case SND_PCM_STATE_RUNNING:
+	case SND_PCM_STATE_DRAINING:
+	case SND_PCM_STATE_PAUSED:
+		snd_pcm_drop(pcm);
+		/* fall through */
+	default:
+		return snd_pcm_prepare(pcm);
+	case SND_PCM_STATE_DISCONNECTED:
+		return -ENODEV;
+	}
+}
+
+#endif /* DOC_HIDDEN */
+
+/**
+ * \brief Open a pool of prepared PCM handles
+ * \param poolp Returned pool handle
+ * \param name Name of the PCM of the handles
+ * \param stream Wanted stream
+ * \param mode Open mode (see #SND_PCM_NONBLOCK, #SND_PCM_ASYNC)
+ * \param hw_params Hardware parameters of the handles
+ * \param sw_params Software parameters of the handles, NULL for the
+ *        defaults of hw_params
+ * \param count Number of handles to keep ready
+ * \return 0 on success otherwise a negative error code
+ *
+ * The parameters are refined and installed on each handle like
+ * #snd_pcm_hw_params does it, so they come from a handle of the same PCM,
+ * e.g. #snd_pcm_hw_params_current and #snd_pcm_sw_params_current of a
+ * handle set up once.  The pool starts empty, #snd_pcm_pool_fill opens
+ * the handles.
+ *
+ * \sa snd_pcm_pool_acquire(), snd_pcm_pool_close()
+ */
+int snd_pcm_pool_open(snd_pcm_pool_t **poolp, const char *name,
+		      snd_pcm_stream_t stream, int mode,
+		      const snd_pcm_hw_params_t *hw_params,
+		      const snd_pcm_sw_params_t *sw_params,
+		      unsigned int count)
+{
+	snd_pcm_pool_t *pool;
+
+	assert(poolp && name && hw_params);
+	if (count == 0)
+		return -EINVAL;
+	pool = calloc(1, sizeof(*pool));
+	if (!pool)
+		return -ENOMEM;
+	pool->name = strdup(name);
+	pool->ready = calloc(count, sizeof(*pool->ready));
+	if (!pool->name || !pool->ready) {
+		free(pool->name);
+		free(pool->ready);
+		free(pool);
+		return -ENOMEM;
+	}
+	pool->stream = stream;
+	pool->mode = mode;
+	pool->hw_params = *hw_params;
+	if (sw_params) {
+		pool->sw_params = *sw_params;
+		pool->has_sw_params = 1;
+	}
+	pool->count = count;
+#ifdef THREAD_SAFE_API
+	pthread_mutex_init(&pool->lock, NULL);
+#endif
+	*poolp = pool;
+	return 0;
+}
+
+/**
+ * \brief Close a pool of prepared PCM handles
+ * \param pool Pool handle
+ *
+ * Closes the handles kept ready.  The handles which are acquired stay
+ * open, they are closed with #snd_pcm_close.  No refill may run.
+ */
+void snd_pcm_pool_close(snd_pcm_pool_t *pool)
+{
+	unsigned int i;
+
+	if (!pool)
+		return;
+	assert(!pool->pending);
+	for (i = 0; i < pool->avail; i++)
+		snd_pcm_close(pool->ready[i]);
+#ifdef THREAD_SAFE_API
+	pthread_mutex_destroy(&pool->lock);
+#endif
+	free(pool->ready);
+	free(pool->name);
+	free(pool);
+}
+
+/**
+ * \brief Open the missing handles of a pool
+ * \param pool Pool handle
+ * \return number of handles ready on success otherwise a negative error
+ *         code of the first open which failed
+ *
+ * This takes the time of the opens, call it outside of the critical
+ * path, e.g. at startup and after an acquire.  In the thread-safe
+ * library it may run in another thread than the acquires, the opens do
+ * not hold the lock of the pool.
+ */
+int snd_pcm_pool_fill(snd_pcm_pool_t *pool)
+{
+	snd_pcm_t *pcm;
+	int err;
+
+	assert(pool);
+	for (;;) {
+		pool_lock(pool);
+		if (pool->avail + pool->pending >= pool->count) {
+			err = pool->avail;
+			pool_unlock(pool);
+			return err;
+		}
+		pool->pending++;
+		pool_unlock(pool);
+
+		err = pool_open_one(pool, &pcm);
+
+		pool_lock(pool);
+		pool->pending--;
+		if (err >= 0 && pool->avail < pool->count) {
+			pool->ready[pool->avail++] = pcm;
+			pcm = NULL;
+		}
+		pool_unlock(pool);
+		if (err < 0)
+			return err;
+		if (pcm)
+			snd_pcm_close(pcm);
+	}
+}
+
+/**
+ * \brief Take a prepared handle from a pool
+ * \param pool Pool handle
+ * \param pcmp Returned PCM handle, prepared
+ * \return 0 on success otherwise a negative error code
+ *
+ * The handle is ready for writes, reads or #snd_pcm_start.  When the
+ * pool is empty the handle is opened right now, which takes as long as
+ * without the pool.  The handle belongs to the caller until
+ * #snd_pcm_pool_release or #snd_pcm_close.
+ */
+int snd_pcm_pool_acquire(snd_pcm_pool_t *pool, snd_pcm_t **pcmp)
+{
+	snd_pcm_t *pcm;
+
+	assert(pool && pcmp);
+	for (;;) {
+		pool_lock(pool);
+		if (!pool->avail) {
+			pool_unlock(pool);
+			return pool_open_one(pool, pcmp);
+		}
+		pcm = pool->ready[--pool->avail];
+		pool_unlock(pool);
+		/* e.g. a device which went away while it was kept */
+		if (pool_rearm(pcm, 0) >= 0)
+			break;
+		snd_pcm_close(pcm);
+	}
+	*pcmp = pcm;
+	return 0;
+}
+
+/**
+ * \brief Give a handle back to a pool
+ * \param pool Pool handle
+ * \param pcm PCM handle from #snd_pcm_pool_acquire
+ * \return 1 if the handle is kept ready, 0 if it was closed, otherwise
+ *         a negative error code and the handle is closed
+ *
+ * The stream is stopped like #snd_pcm_drop does it, which also discards
+ * the frames written but not started, and prepared again with the same
+ * parameters.  A handle is closed when the pool is full or
+ * the stream cannot be prepared.
+ */
+int snd_pcm_pool_release(snd_pcm_pool_t *pool, snd_pcm_t *pcm)
+{
+	int err;
+
+	assert(pool && pcm);
+	err = pool_rearm(pcm, 1);
+	if (err < 0) {
+		snd_pcm_close(pcm);
+		return err;
+	}
+	pool_lock(pool);
+	if (pool->avail < pool->count) {
+		pool->ready[pool->avail++] = pcm;
+		pcm = NULL;
+	}
+	pool_unlock(pool);
+	if (pcm) {
+		snd_pcm_close(pcm);
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * \brief Get the number of handles ready in a pool
+ * \param pool Pool handle
+ * \return handles which #snd_pcm_pool_acquire returns without an open
+ */
+unsigned int snd_pcm_pool_get_avail(snd_pcm_pool_t *pool)
+{
+	unsigned int avail;
+
+	assert(pool);
+	pool_lock(pool);
+	avail = pool->avail;
+	pool_unlock(pool);
+	return avail;
+}
@@ -28,6 +28,7 @@
  *
  */
 #include <inttypes.h>
+#include <math.h>
 #include "bswap.h"
 #include "pcm_local.h"
 #include "pcm_plugin.h"
@@ -39,6 +40,12 @@
 #define DEBUG_REFINE
 #endif
 
+#ifdef THREAD_SAFE_API
+#include <signal.h>
+#include <semaphore.h>
+#define RATE_HAVE_WORKERS
+#endif
+
 #ifndef PIC
 /* entry for static linking */
 const char *_snd_module_pcm_rate = "";
@@ -48,6 +55,25 @@ const char *_snd_module_pcm_rate = "";
 
 typedef struct _snd_pcm_rate snd_pcm_rate_t;
 
+/* the channels converted by one thread, with a converter of their own */
+typedef struct snd_pcm_rate_group {
+	void *obj;			/* rate->obj for the first group */
+	unsigned int first;		/* first channel */
+	unsigned int channels;
+	int16_t *src_buf;		/* slices of the S16 buffers */
+	int16_t *dst_buf;
+} snd_pcm_rate_group_t;
+
+typedef struct snd_pcm_rate_worker {
+	snd_pcm_rate_t *rate;
+	unsigned int index;		/* converts the group of this index */
+#ifdef RATE_HAVE_WORKERS
+	pthread_t thread;
+	sem_t go;
+#endif
+	int quit;
+} snd_pcm_rate_worker_t;
+
 struct _snd_pcm_rate {
 	snd_pcm_generic_t gen;
 	snd_pcm_uframes_t appl_ptr, hw_ptr;
@@ -70,12 +96,94 @@ struct _snd_pcm_rate {
 	snd_htimestamp_t trigger_tstamp;
 	unsigned int plugin_version;
 	unsigned int rate_min, rate_max;
+	u_int64_t in_formats;	/* formats handled natively by ops.convert */
+	u_int64_t out_formats;
+	unsigned int plugin_flags;
+	int native;		/* ops.convert is used for the current formats */
+	void *states;		/* converter states saved before each committed period */
+	size_t state_size;
+	unsigned int state_count;	/* slots in states */
+	unsigned int state_head;	/* slot for the next committed period */
+	unsigned int state_valid;	/* committed periods which can be rolled back */
+	unsigned int drift_max;		/* max. ratio correction in ppm, 0 = off */
+	int flexible;			/* periods are not linked to the slave */
+	snd_pcm_uframes_t speriod;	/* slave frames converted per period */
+	snd_pcm_uframes_t speriod_max;
+	double speriod_base;		/* average slave frames per period */
+	double speriod_frac;		/* rounding carried to the next period */
+	unsigned int drift_count;	/* periods measured since start */
+	double drift_delay;		/* filtered delay in slave frames */
+	double drift_target;
+	double drift_integ;
+	double drift_adj;		/* slave frames added to each period */
+	snd_pcm_rate_open_func_t open;	/* opens the converters of the groups */
+	unsigned int threads;		/* caller + worker threads */
+	snd_pcm_rate_worker_t *workers;	/* threads - 1 workers */
+#ifdef RATE_HAVE_WORKERS
+	sem_t done;
+#endif
+	void **objs;			/* converters of the groups after the first */
+	unsigned int objs_count;
+	snd_pcm_rate_group_t *groups;	/* NULL when obj converts all channels */
+	unsigned int groups_count;
+	int groups_init;		/* the converters are initialized */
+	/* current job of the workers */
+	const snd_pcm_channel_area_t *job_dst_areas;
+	snd_pcm_uframes_t job_dst_offset;
+	unsigned int job_dst_frames;
+	const snd_pcm_channel_area_t *job_src_areas;
+	snd_pcm_uframes_t job_src_offset;
+	unsigned int job_src_frames;
 };
 
 #define SND_PCM_RATE_PLUGIN_VERSION_OLD	0x010001	/* old rate plugin */
 
+/* drift compensation: time in seconds averaged for the target delay,
+ * time constants of the delay filter and of the PI controller
+ */
+#define DRIFT_SETTLE	1.0
+#define DRIFT_FILTER	0.5
+#define DRIFT_TIME	4.0
+
 #endif /* DOC_HIDDEN */
 
+static void rate_format_mask(snd_pcm_format_mask_t *mask, u_int64_t formats)
+{
+	snd_mask_none(mask);
+	mask->bits[0] = (u_int32_t)formats;
+	mask->bits[1] = (u_int32_t)(formats >> 32);
+}
+
+/* restrict the formats of one side when there is no S16 fallback */
+static int rate_refine_formats(snd_pcm_rate_t *rate, snd_pcm_hw_params_t *params,
+			       int input)
+{
+	snd_pcm_format_mask_t mask;
+	u_int64_t formats;
+
+	if (rate->ops.convert_s16)
+		return 0;
+	formats = input ? rate->in_formats : rate->out_formats;
+	if ((rate->plugin_flags & SND_PCM_RATE_FLAG_SYNC_FORMATS) &&
+	    rate->sformat != SND_PCM_FORMAT_UNKNOWN)
+		formats &= 1ULL << rate->sformat;
+	rate_format_mask(&mask, formats);
+	return _snd_pcm_hw_param_set_mask(params, SND_PCM_HW_PARAM_FORMAT, &mask);
+}
+
+static int rate_format_native(snd_pcm_rate_t *rate, snd_pcm_format_t in,
+			      snd_pcm_format_t out)
+{
+	if (! rate->ops.convert)
+		return 0;
+	if (!(rate->in_formats & (1ULL << in)) ||
+	    !(rate->out_formats & (1ULL << out)))
+		return 0;
+	if ((rate->plugin_flags & SND_PCM_RATE_FLAG_SYNC_FORMATS) && in != out)
+		return 0;
+	return 1;
+}
+
 static int snd_pcm_rate_hw_refine_cprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t *params)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
@@ -90,6 +198,10 @@ static int snd_pcm_rate_hw_refine_cprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_
 					 &format_mask);
 	if (err < 0)
 		return err;
+	err = rate_refine_formats(rate, params,
+				  pcm->stream == SND_PCM_STREAM_PLAYBACK);
+	if (err < 0)
+		return err;
 	err = _snd_pcm_hw_params_set_subformat(params, SND_PCM_SUBFORMAT_STD);
 	if (err < 0)
 		return err;
@@ -120,6 +232,8 @@ static int snd_pcm_rate_hw_refine_sprepare(snd_pcm_t *pcm, snd_pcm_hw_params_t *
 		_snd_pcm_hw_params_set_format(sparams, rate->sformat);
 		_snd_pcm_hw_params_set_subformat(sparams, SND_PCM_SUBFORMAT_STD);
 	}
+	rate_refine_formats(rate, sparams,
+			    pcm->stream != SND_PCM_STREAM_PLAYBACK);
 	_snd_pcm_hw_param_set_minmax(sparams, SND_PCM_HW_PARAM_RATE,
 				     rate->srate, 0, rate->srate + 1, -1);
 	return 0;
@@ -148,6 +262,18 @@ static int snd_pcm_rate_hw_refine_schange(snd_pcm_t *pcm, snd_pcm_hw_params_t *p
 	err = _snd_pcm_hw_param_set_interval(sparams, SND_PCM_HW_PARAM_BUFFER_SIZE, &t);
 	if (err < 0)
 		return err;
+	if (rate->flexible) {
+		/* prefer the period time of the client when the slave can
+		 * do it, otherwise let the slave pick its own periods
+		 */
+		snd_pcm_hw_params_t tmp = *sparams;
+		links &= ~(SND_PCM_HW_PARBIT_PERIOD_TIME |
+			   SND_PCM_HW_PARBIT_TICK_TIME);
+		if (_snd_pcm_hw_params_refine(&tmp, SND_PCM_HW_PARBIT_PERIOD_TIME,
+					      params) >= 0 &&
+		    snd_pcm_hw_refine(rate->gen.slave, &tmp) >= 0)
+			*sparams = tmp;
+	}
 	err = _snd_pcm_hw_params_refine(sparams, links, params);
 	if (err < 0)
 		return err;
@@ -173,6 +299,9 @@ static int snd_pcm_rate_hw_refine_cchange(snd_pcm_t *pcm, snd_pcm_hw_params_t *p
 			  SND_PCM_HW_PARBIT_SUBFORMAT |
 			  SND_PCM_HW_PARBIT_SAMPLE_BITS |
 			  SND_PCM_HW_PARBIT_FRAME_BITS);
+	if (rate->flexible)
+		links &= ~(SND_PCM_HW_PARBIT_PERIOD_TIME |
+			   SND_PCM_HW_PARBIT_TICK_TIME);
 	sbuffer_size = snd_pcm_hw_param_get_interval(sparams, SND_PCM_HW_PARAM_BUFFER_SIZE);
 	crate = snd_pcm_hw_param_get_interval(params, SND_PCM_HW_PARAM_RATE);
 	srate = snd_pcm_hw_param_get_interval(sparams, SND_PCM_HW_PARAM_RATE);
@@ -235,6 +364,117 @@ static int snd_pcm_rate_hw_refine(snd_pcm_t *pcm,
 				       snd_pcm_generic_hw_refine);
 }
 
+/* the slave frames of each period vary around speriod_base */
+static inline int snd_pcm_rate_speriod_varies(snd_pcm_rate_t *rate)
+{
+	return rate->drift_max || rate->flexible;
+}
+
+/* slave frames per period the converter was initialized with */
+static inline snd_pcm_uframes_t snd_pcm_rate_speriod_nominal(snd_pcm_t *pcm)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		return rate->info.out.period_size;
+	return rate->info.in.period_size;
+}
+
+/* apply a callback of the converter to the converter of each group */
+#define rate_for_each_obj(rate, g, obj)					\
+	for (g = 0; g < ((rate)->groups ? (rate)->groups_count : 1) &&	\
+		    ((obj = (rate)->groups ? (rate)->groups[g].obj : (rate)->obj), 1); \
+	     g++)
+
+static void rate_free_groups(snd_pcm_rate_t *rate)
+{
+	unsigned int g;
+	void *obj;
+
+	if (rate->groups_init && rate->ops.free) {
+		rate_for_each_obj(rate, g, obj)
+			rate->ops.free(obj);
+	}
+	rate->groups_init = 0;
+	free(rate->groups);
+	rate->groups = NULL;
+	rate->groups_count = 0;
+}
+
+/*
+ * Split the channels into one group per thread and initialize the
+ * converter of each group.  Without threads, obj converts all channels.
+ */
+static int rate_init_groups(snd_pcm_rate_t *rate, unsigned int channels)
+{
+	snd_pcm_rate_info_t info = rate->info;
+	snd_pcm_rate_ops_t ops;
+	unsigned int g, count = rate->threads;
+	void **objs;
+	int err;
+
+	if (count > channels)
+		count = channels;
+	if (count <= 1 || !rate->open || rate->plugin_version < 0x010002) {
+		err = rate->ops.init(rate->obj, &rate->info);
+		if (err < 0)
+			return err;
+		rate->groups_init = 1;
+		return 0;
+	}
+	if (rate->objs_count < count - 1) {
+		objs = realloc(rate->objs, (count - 1) * sizeof(*objs));
+		if (!objs)
+			return -ENOMEM;
+		rate->objs = objs;
+		while (rate->objs_count < count - 1) {
+			err = rate->open(SND_PCM_RATE_PLUGIN_VERSION,
+					 &rate->objs[rate->objs_count], &ops);
+			if (err < 0)
+				return err;
+			rate->objs_count++;
+		}
+	}
+	rate->groups = calloc(count, sizeof(*rate->groups));
+	if (!rate->groups)
+		return -ENOMEM;
+	rate->groups_count = count;
+	for (g = 0; g < count; g++) {
+		snd_pcm_rate_group_t *grp = &rate->groups[g];
+		grp->obj = g ? rate->objs[g - 1] : rate->obj;
+		grp->first = channels * g / count;
+		grp->channels = channels * (g + 1) / count - grp->first;
+		info.channels = grp->channels;
+		err = rate->ops.init(grp->obj, &info);
+		if (err < 0) {
+			/* free the converters initialized so far */
+			rate->groups_count = g;
+			rate->groups_init = 1;
+			rate_free_groups(rate);
+			return err;
+		}
+	}
+	rate->groups_init = 1;
+	return 0;
+}
+
+static int rate_adjust_pitch(snd_pcm_rate_t *rate, snd_pcm_rate_info_t *info)
+{
+	snd_pcm_rate_info_t ginfo = *info;
+	unsigned int g;
+	void *obj;
+	int err;
+
+	rate_for_each_obj(rate, g, obj) {
+		if (rate->groups)
+			ginfo.channels = rate->groups[g].channels;
+		err = rate->ops.adjust_pitch(obj, &ginfo);
+		if (err < 0)
+			return err;
+	}
+	return 0;
+}
+
 static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
@@ -276,24 +516,53 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	sinfo->format = slave->format;
 	sinfo->rate = slave->rate;
 	sinfo->buffer_size = slave->buffer_size;
-	sinfo->period_size = slave->period_size;
+	rate->speriod = slave->period_size;
+	rate->speriod_max = slave->period_size;
+	rate->speriod_base = slave->period_size;
+	if (rate->flexible)
+		rate->speriod_base = (double)cinfo->period_size * sinfo->rate /
+			cinfo->rate;
+	if (snd_pcm_rate_speriod_varies(rate)) {
+		double d = rate->speriod_base * rate->drift_max / 1000000;
+		if (d >= rate->speriod_base - 1) {
+			SNDERR("drift_max is too large for the slave period");
+			return -EINVAL;
+		}
+		rate->speriod = floor(rate->speriod_base + 0.5);
+		rate->speriod_max = ceil(rate->speriod_base + d) + 1;
+	}
+	sinfo->period_size = rate->speriod;
 
 	if (CHECK_SANITY(rate->pareas)) {
 		SNDMSG("rate plugin already in use");
 		return -EBUSY;
 	}
-	err = rate->ops.init(rate->obj, &rate->info);
+	err = rate_init_groups(rate, channels);
 	if (err < 0)
 		return err;
+	/* the converter sets itself up for the longest slave period here, so
+	 * that the retunes of the running stream only change the ratio */
+	if (rate->speriod_max != rate->speriod && rate->ops.adjust_pitch) {
+		snd_pcm_rate_info_t info = rate->info;
+		if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+			info.out.period_size = rate->speriod_max;
+		else
+			info.in.period_size = rate->speriod_max;
+		err = rate_adjust_pitch(rate, &info);
+		if (err >= 0)
+			err = rate_adjust_pitch(rate, &rate->info);
+		if (err < 0)
+			goto error_free;
+	}
 
 	rate->pareas = malloc(2 * channels * sizeof(*rate->pareas));
 	if (rate->pareas == NULL)
 		goto error;
 
-	cwidth = snd_pcm_format_physical_width(cinfo->format);
-	swidth = snd_pcm_format_physical_width(sinfo->format);
+	cwidth = __snd_pcm_format_physical_width(cinfo->format);
+	swidth = __snd_pcm_format_physical_width(sinfo->format);
 	rate->pareas[0].addr = malloc(((cwidth * channels * cinfo->period_size) / 8) +
-				      ((swidth * channels * sinfo->period_size) / 8));
+				      ((swidth * channels * rate->speriod_max) / 8));
 	if (rate->pareas[0].addr == NULL)
 		goto error;
 
@@ -303,33 +572,62 @@ static int snd_pcm_rate_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 		rate->pareas[chn].addr = rate->pareas[0].addr + (cwidth * chn * cinfo->period_size) / 8;
 		rate->pareas[chn].first = 0;
 		rate->pareas[chn].step = cwidth;
-		rate->sareas[chn].addr = rate->sareas[0].addr + (swidth * chn * sinfo->period_size) / 8;
+		rate->sareas[chn].addr = rate->sareas[0].addr + (swidth * chn * rate->speriod_max) / 8;
 		rate->sareas[chn].first = 0;
 		rate->sareas[chn].step = swidth;
 	}
 
-	if (rate->ops.convert_s16) {
+	rate->native = rate_format_native(rate, rate->info.in.format,
+					  rate->info.out.format);
+	free(rate->src_buf);
+	free(rate->dst_buf);
+	rate->src_buf = rate->dst_buf = NULL;
+	if (! rate->native) {
+		if (! rate->ops.convert_s16) {
+			SNDERR("rate converter cannot handle %s -> %s",
+			       snd_pcm_format_name(rate->info.in.format),
+			       snd_pcm_format_name(rate->info.out.format));
+			err = -EINVAL;
+			goto error_free;
+		}
 		rate->get_idx = snd_pcm_linear_get_index(rate->info.in.format, SND_PCM_FORMAT_S16);
 		rate->put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S16, rate->info.out.format);
-		free(rate->src_buf);
-		rate->src_buf = malloc(channels * rate->info.in.period_size * 2);
-		free(rate->dst_buf);
-		rate->dst_buf = malloc(channels * rate->info.out.period_size * 2);
+		if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+			rate->src_buf = malloc(channels * rate->info.in.period_size * 2);
+			rate->dst_buf = malloc(channels * rate->speriod_max * 2);
+		} else {
+			rate->src_buf = malloc(channels * rate->speriod_max * 2);
+			rate->dst_buf = malloc(channels * rate->info.out.period_size * 2);
+		}
 		if (! rate->src_buf || ! rate->dst_buf)
 			goto error;
+		for (chn = 0; chn < rate->groups_count; chn++) {
+			snd_pcm_rate_group_t *grp = &rate->groups[chn];
+			if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+				grp->src_buf = rate->src_buf + grp->first * rate->info.in.period_size;
+				grp->dst_buf = rate->dst_buf + grp->first * rate->speriod_max;
+			} else {
+				grp->src_buf = rate->src_buf + grp->first * rate->speriod_max;
+				grp->dst_buf = rate->dst_buf + grp->first * rate->info.out.period_size;
+			}
+		}
 	}
 
 	return 0;
 
  error:
+	err = -ENOMEM;
+ error_free:
 	if (rate->pareas) {
 		free(rate->pareas[0].addr);
 		free(rate->pareas);
 		rate->pareas = NULL;
 	}
-	if (rate->ops.free)
-		rate->ops.free(rate->obj);
-	return -ENOMEM;
+	free(rate->src_buf);
+	free(rate->dst_buf);
+	rate->src_buf = rate->dst_buf = NULL;
+	rate_free_groups(rate);
+	return err;
 }
 
 static int snd_pcm_rate_hw_free(snd_pcm_t *pcm)
@@ -341,11 +639,13 @@ static int snd_pcm_rate_hw_free(snd_pcm_t *pcm)
 		rate->pareas = NULL;
 		rate->sareas = NULL;
 	}
-	if (rate->ops.free)
-		rate->ops.free(rate->obj);
+	rate_free_groups(rate);
 	free(rate->src_buf);
 	free(rate->dst_buf);
 	rate->src_buf = rate->dst_buf = NULL;
+	free(rate->states);
+	rate->states = NULL;
+	rate->state_size = rate->state_count = 0;
 	return snd_pcm_hw_free(rate->gen.slave);
 }
 
@@ -357,6 +657,8 @@ static void recalc(snd_pcm_t *pcm, snd_pcm_uframes_t *val)
 
 	if (*val == pcm->buffer_size) {
 		*val = slave->buffer_size;
+	} else if (rate->flexible) {
+		*val = muldiv_near(*val, slave->rate, pcm->rate);
 	} else {
 		div = *val / pcm->period_size;
 		if (div * pcm->period_size == *val)
@@ -391,7 +693,8 @@ static int snd_pcm_rate_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t * params)
 	sparams->boundary = sboundary;
 
 	if (rate->ops.adjust_pitch)
-		rate->ops.adjust_pitch(rate->obj, &rate->info);
+		rate_adjust_pitch(rate, &rate->info);
+	rate->speriod = snd_pcm_rate_speriod_nominal(pcm);
 
 	recalc(pcm, &sparams->avail_min);
 	rate->orig_avail_min = sparams->avail_min;
@@ -415,15 +718,165 @@ static int snd_pcm_rate_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t * params)
 	return snd_pcm_sw_params(slave, sparams);
 }
 
+/*
+ * Allocate one converter state per slave period, so that the committed
+ * periods still queued in the slave buffer can be rewound.
+ */
+static int snd_pcm_rate_alloc_states(snd_pcm_t *pcm)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_t *slave = rate->gen.slave;
+	unsigned int count;
+	size_t size = 0;
+
+	rate->state_head = 0;
+	rate->state_valid = 0;
+	/* the groups are not saved, so only one converter is rolled back */
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK &&
+	    ! snd_pcm_rate_speriod_varies(rate) && ! rate->groups && rate->plugin_version >= 0x010003 && rate->ops.state_size &&
+	    rate->ops.save_state && rate->ops.restore_state)
+		size = rate->ops.state_size(rate->obj);
+	count = slave->buffer_size / slave->period_size + 1;
+	if (size == rate->state_size && count == rate->state_count)
+		return 0;
+	free(rate->states);
+	rate->states = NULL;
+	rate->state_size = rate->state_count = 0;
+	if (! size)
+		return 0;
+	rate->states = malloc(size * count);
+	if (! rate->states)
+		return -ENOMEM;
+	rate->state_size = size;
+	rate->state_count = count;
+	return 0;
+}
+
+/* change the slave frames per period and retune the converter to it */
+static int snd_pcm_rate_set_speriod(snd_pcm_t *pcm, snd_pcm_uframes_t speriod)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_rate_info_t info;
+	int err;
+
+	if (speriod == rate->speriod)
+		return 0;
+	info = rate->info;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		info.out.period_size = speriod;
+	else
+		info.in.period_size = speriod;
+	err = rate_adjust_pitch(rate, &info);
+	if (err < 0)
+		return err;
+	rate->speriod = speriod;
+	return 0;
+}
+
+/*
+ * When the application clock and the slave clock drift apart, the
+ * delay between them slowly grows or shrinks.  A PI controller on the
+ * filtered delay lengthens or shortens the slave period by a fraction
+ * of a frame per period on average, which keeps the delay at the level
+ * measured right after the start.
+ */
+static int snd_pcm_rate_drift_update(snd_pcm_t *pcm, double delay)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_t *slave = rate->gen.slave;
+	double speriod = rate->speriod_base;
+	double ptime = speriod / slave->rate;
+	double w = ptime / DRIFT_TIME;
+	double err, adj, max, f;
+	unsigned int settle;
+
+	settle = ceil(DRIFT_SETTLE / ptime);
+	if (rate->drift_count < settle) {
+		rate->drift_delay += delay;
+		if (++rate->drift_count == settle) {
+			rate->drift_delay /= settle;
+			rate->drift_target = rate->drift_delay;
+		}
+		return 0;
+	}
+	f = ptime / DRIFT_FILTER;
+	if (f > 1.0)
+		f = 1.0;
+	rate->drift_delay += (delay - rate->drift_delay) * f;
+	err = rate->drift_delay - rate->drift_target;
+	max = speriod * rate->drift_max / 1000000;
+	/* critically damped: gains 2w and w^2 per period */
+	rate->drift_integ += err * w * w;
+	if (rate->drift_integ > max)
+		rate->drift_integ = max;
+	else if (rate->drift_integ < -max)
+		rate->drift_integ = -max;
+	adj = err * 2 * w + rate->drift_integ;
+	if (adj > max)
+		adj = max;
+	else if (adj < -max)
+		adj = -max;
+	/* a growing playback delay needs fewer slave frames per period,
+	 * a growing capture delay needs more
+	 */
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK)
+		adj = -adj;
+	rate->drift_adj = adj;
+	return 0;
+}
+
+/*
+ * Pick the slave frames of the next period, so that they average to
+ * speriod_base plus the drift correction over the periods.
+ */
+static int snd_pcm_rate_next_speriod(snd_pcm_t *pcm)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_sframes_t d;
+
+	if (! snd_pcm_rate_speriod_varies(rate))
+		return 0;
+	rate->speriod_frac += rate->speriod_base + rate->drift_adj;
+	d = floor(rate->speriod_frac + 0.5);
+	rate->speriod_frac -= d;
+	return snd_pcm_rate_set_speriod(pcm, d);
+}
+
+static int snd_pcm_rate_drift_running(snd_pcm_rate_t *rate)
+{
+	if (snd_pcm_state(rate->gen.slave) == SND_PCM_STATE_RUNNING)
+		return 1;
+	/* measure again after the next start */
+	rate->drift_count = 0;
+	rate->drift_delay = 0;
+	rate->drift_adj = 0;
+	return 0;
+}
+
 static int snd_pcm_rate_init(snd_pcm_t *pcm)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
+	unsigned int g;
+	void *obj;
+	int err;
 
-	if (rate->ops.reset)
-		rate->ops.reset(rate->obj);
+	if (rate->ops.reset) {
+		rate_for_each_obj(rate, g, obj)
+			rate->ops.reset(obj);
+	}
 	rate->last_commit_ptr = 0;
 	rate->start_pending = 0;
-	return 0;
+	if (snd_pcm_rate_speriod_varies(rate)) {
+		rate->drift_count = 0;
+		rate->drift_delay = 0;
+		rate->drift_integ = 0;
+		rate->drift_adj = 0;
+		rate->speriod_frac = 0;
+		err = snd_pcm_rate_next_speriod(pcm);
+		if (err < 0)
+			return err;
+	}
+	return snd_pcm_rate_alloc_states(pcm);
 }
 
 static void convert_to_s16(snd_pcm_rate_t *rate, int16_t *buf,
@@ -502,35 +955,166 @@ static void convert_from_s16(snd_pcm_rate_t *rate, const int16_t *buf,
 	}
 }
 
-static void do_convert(const snd_pcm_channel_area_t *dst_areas,
-		       snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
-		       const snd_pcm_channel_area_t *src_areas,
-		       snd_pcm_uframes_t src_offset, unsigned int src_frames,
-		       unsigned int channels,
-		       snd_pcm_rate_t *rate)
+static void do_convert1(snd_pcm_rate_t *rate, void *obj,
+			int16_t *src_buf, int16_t *dst_buf,
+			const snd_pcm_channel_area_t *dst_areas,
+			snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+			const snd_pcm_channel_area_t *src_areas,
+			snd_pcm_uframes_t src_offset, unsigned int src_frames,
+			unsigned int channels)
 {
-	if (rate->ops.convert_s16) {
+	if (! rate->native) {
 		const int16_t *src;
 		int16_t *dst;
-		if (! rate->src_buf)
-			src = src_areas->addr + src_offset * 2 * channels;
+		if (rate->info.in.format == SND_PCM_FORMAT_S16 &&
+		    snd_pcm_areas_interleaved(src_areas, channels, 16))
+			src = (const int16_t *)snd_pcm_channel_area_addr(src_areas, src_offset);
 		else {
-			convert_to_s16(rate, rate->src_buf, src_areas, src_offset,
+			convert_to_s16(rate, src_buf, src_areas, src_offset,
 				       src_frames, channels);
-			src = rate->src_buf;
+			src = src_buf;
 		}
-		if (! rate->dst_buf)
-			dst = dst_areas->addr + dst_offset * 2 * channels;
+		if (rate->info.out.format == SND_PCM_FORMAT_S16 &&
+		    snd_pcm_areas_interleaved(dst_areas, channels, 16))
+			dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
 		else
-			dst = rate->dst_buf;
-		rate->ops.convert_s16(rate->obj, dst, dst_frames, src, src_frames);
-		if (dst == rate->dst_buf)
-			convert_from_s16(rate, rate->dst_buf, dst_areas, dst_offset,
+			dst = dst_buf;
+		rate->ops.convert_s16(obj, dst, dst_frames, src, src_frames);
+		if (dst == dst_buf)
+			convert_from_s16(rate, dst_buf, dst_areas, dst_offset,
 					 dst_frames, channels);
 	} else {
-		rate->ops.convert(rate->obj, dst_areas, dst_offset, dst_frames,
-				   src_areas, src_offset, src_frames);
+		rate->ops.convert(obj, dst_areas, dst_offset, dst_frames,
+				  src_areas, src_offset, src_frames);
+	}
+}
+
+/* convert the channels of a group for the current job */
+static void snd_pcm_rate_run_job(snd_pcm_rate_t *rate, unsigned int index)
+{
+	snd_pcm_rate_group_t *grp = &rate->groups[index];
+
+	do_convert1(rate, grp->obj, grp->src_buf, grp->dst_buf,
+		    rate->job_dst_areas + grp->first, rate->job_dst_offset,
+		    rate->job_dst_frames,
+		    rate->job_src_areas + grp->first, rate->job_src_offset,
+		    rate->job_src_frames, grp->channels);
+}
+
+#ifdef RATE_HAVE_WORKERS
+static void *snd_pcm_rate_worker(void *arg)
+{
+	snd_pcm_rate_worker_t *worker = arg;
+	snd_pcm_rate_t *rate = worker->rate;
+	sigset_t mask;
+
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+	for (;;) {
+		while (sem_wait(&worker->go) < 0 && errno == EINTR)
+			;
+		if (worker->quit)
+			break;
+		snd_pcm_rate_run_job(rate, worker->index);
+		sem_post(&rate->done);
+	}
+	return NULL;
+}
+
+static void snd_pcm_rate_stop_workers(snd_pcm_rate_t *rate)
+{
+	unsigned int i;
+
+	if (!rate->workers)
+		return;
+	for (i = 0; i < rate->threads - 1; i++) {
+		snd_pcm_rate_worker_t *worker = &rate->workers[i];
+		if (!worker->rate)
+			continue;
+		worker->quit = 1;
+		sem_post(&worker->go);
+		pthread_join(worker->thread, NULL);
+		sem_destroy(&worker->go);
+	}
+	sem_destroy(&rate->done);
+	free(rate->workers);
+	rate->workers = NULL;
+}
+
+static int snd_pcm_rate_start_workers(snd_pcm_rate_t *rate)
+{
+	unsigned int i;
+	int err;
+
+	if (rate->threads <= 1)
+		return 0;
+	rate->workers = calloc(rate->threads - 1, sizeof(*rate->workers));
+	if (!rate->workers)
+		return -ENOMEM;
+	sem_init(&rate->done, 0, 0);
+	for (i = 0; i < rate->threads - 1; i++) {
+		snd_pcm_rate_worker_t *worker = &rate->workers[i];
+		worker->rate = rate;
+		worker->index = i + 1;
+		sem_init(&worker->go, 0, 0);
+		err = snd_thread_create(&worker->thread, NULL,
+					snd_pcm_rate_worker, worker);
+		if (err) {
+			SNDERR("unable to create a rate worker thread");
+			sem_destroy(&worker->go);
+			worker->rate = NULL;
+			snd_pcm_rate_stop_workers(rate);
+			rate->threads = 1;
+			return -err;
+		}
+	}
+	return 0;
+}
+
+/* run the current job on the caller and the workers of the other groups */
+static void snd_pcm_rate_run_parallel(snd_pcm_rate_t *rate)
+{
+	unsigned int i, n = rate->groups_count - 1;
+
+	for (i = 0; i < n; i++)
+		sem_post(&rate->workers[i].go);
+	snd_pcm_rate_run_job(rate, 0);
+	for (i = 0; i < n; i++)
+		while (sem_wait(&rate->done) < 0 && errno == EINTR)
+			;
+}
+#else
+#define snd_pcm_rate_stop_workers(rate)	do { } while (0)
+#define snd_pcm_rate_run_parallel(rate)	do { } while (0)
+static int snd_pcm_rate_start_workers(snd_pcm_rate_t *rate)
+{
+	if (rate->threads > 1)
+		SNDMSG("no thread support, threads ignored");
+	rate->threads = 1;
+	return 0;
+}
+#endif
+
+static void do_convert(const snd_pcm_channel_area_t *dst_areas,
+		       snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+		       const snd_pcm_channel_area_t *src_areas,
+		       snd_pcm_uframes_t src_offset, unsigned int src_frames,
+		       unsigned int channels,
+		       snd_pcm_rate_t *rate)
+{
+	if (! rate->groups) {
+		do_convert1(rate, rate->obj, rate->src_buf, rate->dst_buf,
+			    dst_areas, dst_offset, dst_frames,
+			    src_areas, src_offset, src_frames, channels);
+		return;
 	}
+	rate->job_dst_areas = dst_areas;
+	rate->job_dst_offset = dst_offset;
+	rate->job_dst_frames = dst_frames;
+	rate->job_src_areas = src_areas;
+	rate->job_src_offset = src_offset;
+	rate->job_src_frames = src_frames;
+	snd_pcm_rate_run_parallel(rate);
 }
 
 static inline void
@@ -541,7 +1125,7 @@ snd_pcm_rate_write_areas1(snd_pcm_t *pcm,
 			 snd_pcm_uframes_t slave_offset)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
-	do_convert(slave_areas, slave_offset, rate->gen.slave->period_size,
+	do_convert(slave_areas, slave_offset, rate->speriod,
 		   areas, offset, pcm->period_size,
 		   pcm->channels, rate);
 }
@@ -555,7 +1139,7 @@ snd_pcm_rate_read_areas1(snd_pcm_t *pcm,
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
 	do_convert(areas, offset, pcm->period_size,
-		   slave_areas, slave_offset, rate->gen.slave->period_size,
+		   slave_areas, slave_offset, rate->speriod,
 		   pcm->channels, rate);
 }
 
@@ -566,6 +1150,27 @@ static inline void snd_pcm_rate_sync_hwptr(snd_pcm_t *pcm)
 
 	if (pcm->stream != SND_PCM_STREAM_PLAYBACK)
 		return;
+	if (snd_pcm_rate_speriod_varies(rate)) {
+		/* slave periods vary in size, count back from the last
+		 * committed frame instead
+		 */
+		snd_pcm_t *slave = rate->gen.slave;
+		snd_pcm_uframes_t queued, hw_ptr;
+
+		queued = snd_pcm_mmap_playback_hw_avail(slave) *
+			(double)pcm->period_size / rate->speriod_base + 0.5;
+		if (queued > pcm->buffer_size)
+			queued = pcm->buffer_size;
+		if (rate->last_commit_ptr < queued)
+			hw_ptr = rate->last_commit_ptr + pcm->boundary - queued;
+		else
+			hw_ptr = rate->last_commit_ptr - queued;
+		/* never move backwards */
+		if ((hw_ptr + pcm->boundary - rate->hw_ptr) % pcm->boundary <=
+		    pcm->buffer_size)
+			rate->hw_ptr = hw_ptr;
+		return;
+	}
 	/* FIXME: boundary overlap of slave hw_ptr isn't evaluated here!
 	 *        e.g. if slave rate is small... 
 	 */
@@ -624,26 +1229,155 @@ static int snd_pcm_rate_reset(snd_pcm_t *pcm)
 	return 0;
 }
 
-static snd_pcm_sframes_t snd_pcm_rate_rewindable(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+static int snd_pcm_rate_sync_playback_area(snd_pcm_t *pcm, snd_pcm_uframes_t appl_ptr);
+
+static snd_pcm_uframes_t snd_pcm_rate_uncommitted(snd_pcm_t *pcm)
 {
-	return 0;
+	snd_pcm_rate_t *rate = pcm->private_data;
+
+	if (rate->appl_ptr < rate->last_commit_ptr)
+		return rate->appl_ptr - rate->last_commit_ptr + pcm->boundary;
+	return rate->appl_ptr - rate->last_commit_ptr;
 }
 
-static snd_pcm_sframes_t snd_pcm_rate_forwardable(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+/*
+ * Playback frames not yet committed to the slave can always be rewound.
+ * Committed periods can be rewound as long as the slave can rewind them
+ * as a whole and the converter state before them was saved.
+ */
+static snd_pcm_sframes_t snd_pcm_rate_playback_rewindable(snd_pcm_t *pcm,
+							  unsigned int *periods)
 {
-	return 0;
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_sframes_t avail, n = 0;
+
+	if (rate->state_valid) {
+		n = snd_pcm_rewindable(rate->gen.slave);
+		if (n < 0)
+			return n;
+		n /= rate->gen.slave->period_size;
+		if (n > rate->state_valid)
+			n = rate->state_valid;
+	}
+	*periods = n;
+	snd_pcm_rate_sync_hwptr(pcm);
+	avail = snd_pcm_rate_uncommitted(pcm) + n * pcm->period_size;
+	if ((snd_pcm_uframes_t)avail > snd_pcm_mmap_hw_rewindable(pcm))
+		avail = snd_pcm_mmap_hw_rewindable(pcm);
+	return avail;
+}
+
+static snd_pcm_sframes_t snd_pcm_rate_rewindable(snd_pcm_t *pcm)
+{
+	unsigned int periods;
+
+	if (pcm->stream != SND_PCM_STREAM_PLAYBACK)
+		return snd_pcm_mmap_hw_rewindable(pcm);
+	return snd_pcm_rate_playback_rewindable(pcm, &periods);
+}
+
+static snd_pcm_sframes_t snd_pcm_rate_forwardable(snd_pcm_t *pcm)
+{
+	snd_pcm_rate_sync_hwptr(pcm);
+	return snd_pcm_mmap_avail(pcm);
 }
 
-static snd_pcm_sframes_t snd_pcm_rate_rewind(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
-                                             snd_pcm_uframes_t frames ATTRIBUTE_UNUSED)
+/* roll back the given number of committed periods */
+static snd_pcm_sframes_t snd_pcm_rate_rewind_periods(snd_pcm_t *pcm,
+						     unsigned int periods)
 {
-        return 0;
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_t *slave = rate->gen.slave;
+	snd_pcm_uframes_t sframes = periods * slave->period_size;
+	snd_pcm_uframes_t frames;
+	snd_pcm_sframes_t n, err;
+
+	n = snd_pcm_rewind(slave, sframes);
+	if (n < 0)
+		return n;
+	if ((snd_pcm_uframes_t)n < sframes) {
+		/* only whole periods can be converted again */
+		if (n % slave->period_size) {
+			sframes = n % slave->period_size;
+			n -= sframes;
+			err = INTERNAL(snd_pcm_forward)(slave, sframes);
+			if (err < 0)
+				return err;
+		}
+		periods = n / slave->period_size;
+		if (! periods)
+			return 0;
+	}
+	rate->state_head = (rate->state_head + rate->state_count - periods) %
+		rate->state_count;
+	rate->state_valid -= periods;
+	rate->ops.restore_state(rate->obj, (char *)rate->states +
+				rate->state_head * rate->state_size);
+	frames = periods * pcm->period_size;
+	if (rate->last_commit_ptr < frames)
+		rate->last_commit_ptr += pcm->boundary - frames;
+	else
+		rate->last_commit_ptr -= frames;
+	return periods;
 }
 
-static snd_pcm_sframes_t snd_pcm_rate_forward(snd_pcm_t *pcm ATTRIBUTE_UNUSED,
-                                              snd_pcm_uframes_t frames ATTRIBUTE_UNUSED)
+static snd_pcm_sframes_t snd_pcm_rate_rewind(snd_pcm_t *pcm,
+                                             snd_pcm_uframes_t frames)
 {
-        return 0;
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_uframes_t uncommitted;
+	snd_pcm_sframes_t n;
+	unsigned int periods;
+
+	if (pcm->stream != SND_PCM_STREAM_PLAYBACK)
+		n = snd_pcm_mmap_hw_rewindable(pcm);
+	else
+		n = snd_pcm_rate_playback_rewindable(pcm, &periods);
+	if (n < 0)
+		return n;
+	if (frames > (snd_pcm_uframes_t)n)
+		frames = n;
+	if (frames == 0)
+		return 0;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		uncommitted = snd_pcm_rate_uncommitted(pcm);
+		if (frames > uncommitted) {
+			/* the rest of the last rolled back period stays
+			 * in the buffer and is committed again later
+			 */
+			periods = (frames - uncommitted + pcm->period_size - 1) /
+				pcm->period_size;
+			n = snd_pcm_rate_rewind_periods(pcm, periods);
+			if (n < 0)
+				return n;
+			if (frames > uncommitted + n * pcm->period_size)
+				frames = uncommitted + n * pcm->period_size;
+		}
+	}
+	snd_pcm_mmap_appl_backward(pcm, frames);
+	return frames;
+}
+
+static snd_pcm_sframes_t snd_pcm_rate_forward(snd_pcm_t *pcm,
+                                              snd_pcm_uframes_t frames)
+{
+	snd_pcm_rate_t *rate = pcm->private_data;
+	snd_pcm_sframes_t n = snd_pcm_rate_forwardable(pcm);
+	int err;
+
+	if (n < 0)
+		return n;
+	if (frames > (snd_pcm_uframes_t)n)
+		frames = n;
+	if (frames == 0)
+		return 0;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK) {
+		err = snd_pcm_rate_sync_playback_area(pcm, rate->appl_ptr + frames);
+		if (err < 0)
+			return err;
+	}
+	snd_pcm_mmap_appl_forward(pcm, frames);
+	return frames;
 }
 
 static int snd_pcm_rate_commit_area(snd_pcm_t *pcm, snd_pcm_rate_t *rate,
@@ -756,9 +1490,26 @@ static int snd_pcm_rate_commit_area(snd_pcm_t *pcm, snd_pcm_rate_t *rate,
 static int snd_pcm_rate_commit_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t appl_offset)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
+	void *state = NULL;
+	int err;
 
-	return snd_pcm_rate_commit_area(pcm, rate, appl_offset, pcm->period_size,
-					rate->gen.slave->period_size);
+	if (rate->states) {
+		state = (char *)rate->states + rate->state_head * rate->state_size;
+		rate->ops.save_state(rate->obj, state);
+	}
+	err = snd_pcm_rate_commit_area(pcm, rate, appl_offset, pcm->period_size,
+				       rate->speriod);
+	if (state) {
+		if (err > 0) {
+			rate->state_head = (rate->state_head + 1) % rate->state_count;
+			if (rate->state_valid < rate->state_count)
+				rate->state_valid++;
+		} else {
+			/* the period is converted again on the next commit */
+			rate->ops.restore_state(rate->obj, state);
+		}
+	}
+	return err;
 }
 
 static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_offset)
@@ -769,6 +1520,7 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 	const snd_pcm_channel_area_t *slave_areas;
 	snd_pcm_uframes_t slave_offset, xfer;
 	snd_pcm_uframes_t slave_frames = ULONG_MAX;
+	snd_pcm_uframes_t speriod = rate->speriod;
 	snd_pcm_sframes_t result;
 
 	areas = snd_pcm_mmap_areas(pcm);
@@ -776,12 +1528,12 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 		result = snd_pcm_mmap_begin(rate->gen.slave, &slave_areas, &slave_offset, &slave_frames);
 		if (result < 0)
 			return result;
-		if (slave_frames < rate->gen.slave->period_size)
+		if (slave_frames < speriod)
 			goto __partial;
 		snd_pcm_rate_read_areas1(pcm, areas, hw_offset,
 					 slave_areas, slave_offset);
-		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, rate->gen.slave->period_size);
-		if (result < (snd_pcm_sframes_t)rate->gen.slave->period_size) {
+		result = snd_pcm_mmap_commit(rate->gen.slave, slave_offset, speriod);
+		if (result < (snd_pcm_sframes_t)speriod) {
 			if (result < 0)
 				return result;
 			result = snd_pcm_rewind(rate->gen.slave, result);
@@ -797,8 +1549,8 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 	      __partial:
 		xfer = 0;
 		cont = slave_frames;
-		if (cont > rate->gen.slave->period_size)
-			cont = rate->gen.slave->period_size;
+		if (cont > speriod)
+			cont = speriod;
 		snd_pcm_areas_copy(rate->sareas, 0,
 				   slave_areas, slave_offset,
 				   pcm->channels, cont,
@@ -814,11 +1566,11 @@ static int snd_pcm_rate_grab_next_period(snd_pcm_t *pcm, snd_pcm_uframes_t hw_of
 		}
 		xfer = cont;
 
-		if (xfer == rate->gen.slave->period_size)
+		if (xfer == speriod)
 			goto __transfer;
 
 		/* grab second fragment */
-		cont = rate->gen.slave->period_size - cont;
+		cont = speriod - cont;
 		slave_frames = cont;
 		result = snd_pcm_mmap_begin(rate->gen.slave, &slave_areas, &slave_offset, &slave_frames);
 		if (result < 0)
@@ -881,18 +1633,29 @@ static int snd_pcm_rate_sync_playback_area(snd_pcm_t *pcm, snd_pcm_uframes_t app
 		xfer = appl_ptr - rate->last_commit_ptr + pcm->boundary;
 	else
 		xfer = appl_ptr - rate->last_commit_ptr;
+	if (rate->drift_max && xfer >= pcm->period_size &&
+	    snd_pcm_rate_drift_running(rate)) {
+		err = snd_pcm_rate_drift_update(pcm, (slave->buffer_size - slave_size) +
+						(double)xfer * rate->speriod_base /
+						pcm->period_size);
+		if (err < 0)
+			return err;
+	}
 	while (xfer >= pcm->period_size &&
-	       (snd_pcm_uframes_t)slave_size >= rate->gen.slave->period_size) {
+	       (snd_pcm_uframes_t)slave_size >= rate->speriod) {
 		err = snd_pcm_rate_commit_next_period(pcm, rate->last_commit_ptr % pcm->buffer_size);
 		if (err == 0)
 			break;
 		if (err < 0)
 			return err;
 		xfer -= pcm->period_size;
-		slave_size -= rate->gen.slave->period_size;
+		slave_size -= rate->speriod;
 		rate->last_commit_ptr += pcm->period_size;
 		if (rate->last_commit_ptr >= pcm->boundary)
 			rate->last_commit_ptr = 0;
+		err = snd_pcm_rate_next_speriod(pcm);
+		if (err < 0)
+			return err;
 	}
 	return 0;
 }
@@ -933,8 +1696,16 @@ static snd_pcm_sframes_t snd_pcm_rate_avail_update(snd_pcm_t *pcm)
 	xfer = snd_pcm_mmap_capture_avail(pcm);
 	size = pcm->buffer_size - xfer;
 	hw_offset = snd_pcm_mmap_hw_offset(pcm);
+	if (rate->drift_max && (snd_pcm_sframes_t)slave_size >= 0 &&
+	    slave_size >= rate->speriod && snd_pcm_rate_drift_running(rate)) {
+		int err = snd_pcm_rate_drift_update(pcm, slave_size +
+						    (double)xfer * rate->speriod_base /
+						    pcm->period_size);
+		if (err < 0)
+			return err;
+	}
 	while (size >= pcm->period_size &&
-	       slave_size >= rate->gen.slave->period_size) {
+	       slave_size >= rate->speriod) {
 		int err = snd_pcm_rate_grab_next_period(pcm, hw_offset);
 		if (err < 0)
 			return err;
@@ -942,10 +1713,13 @@ static snd_pcm_sframes_t snd_pcm_rate_avail_update(snd_pcm_t *pcm)
 			return (snd_pcm_sframes_t)xfer;
 		xfer += pcm->period_size;
 		size -= pcm->period_size;
-		slave_size -= rate->gen.slave->period_size;
+		slave_size -= rate->speriod;
 		hw_offset += pcm->period_size;
 		hw_offset %= pcm->buffer_size;
 		snd_pcm_mmap_hw_forward(pcm, pcm->period_size);
+		err = snd_pcm_rate_next_speriod(pcm);
+		if (err < 0)
+			return err;
 	}
 	return (snd_pcm_sframes_t)xfer;
  }
@@ -1007,6 +1781,8 @@ static int snd_pcm_rate_drain(snd_pcm_t *pcm)
 
 		size = rate->appl_ptr - rate->last_commit_ptr;
 		ofs = rate->last_commit_ptr % pcm->buffer_size;
+		/* partial periods cannot be rolled back */
+		rate->state_valid = 0;
 		while (size > 0) {
 			snd_pcm_uframes_t psize, spsize;
 			int err;
@@ -1016,7 +1792,7 @@ static int snd_pcm_rate_drain(snd_pcm_t *pcm)
 				break;
 			if (size > pcm->period_size) {
 				psize = pcm->period_size;
-				spsize = rate->gen.slave->period_size;
+				spsize = rate->speriod;
 			} else {
 				psize = size;
 				spsize = rate->ops.output_frames(rate->obj, size);
@@ -1025,6 +1801,7 @@ static int snd_pcm_rate_drain(snd_pcm_t *pcm)
 			}
 			snd_pcm_rate_commit_area(pcm, rate, ofs,
 						 psize, spsize);
+			snd_pcm_rate_next_speriod(pcm);
 			ofs = (ofs + psize) % pcm->buffer_size;
 			size -= psize;
 		}
@@ -1112,6 +1889,19 @@ static void snd_pcm_rate_dump(snd_pcm_t *pcm, snd_output_t *out)
 		rate->ops.dump(rate->obj, out);
 	snd_output_printf(out, "Protocol version: %x\n", rate->plugin_version);
 	if (pcm->setup) {
+		snd_output_printf(out, "Sample path: %s\n",
+				  rate->native ? "native" : "S16");
+		if (rate->groups)
+			snd_output_printf(out, "Threads: %u channel groups\n",
+					  rate->groups_count);
+		if (rate->drift_max)
+			snd_output_printf(out, "Drift compensation: max %u ppm, "
+					  "slave period %lu\n", rate->drift_max,
+					  (unsigned long)rate->speriod);
+		if (rate->flexible)
+			snd_output_printf(out, "Flexible periods: %g slave "
+					  "frames per period\n",
+					  rate->speriod_base);
 		snd_output_printf(out, "Its setup is:\n");
 		snd_pcm_dump_setup(pcm, out);
 	}
@@ -1122,9 +1912,15 @@ static void snd_pcm_rate_dump(snd_pcm_t *pcm, snd_output_t *out)
 static int snd_pcm_rate_close(snd_pcm_t *pcm)
 {
 	snd_pcm_rate_t *rate = pcm->private_data;
+	unsigned int i;
 
-	if (rate->ops.close)
+	snd_pcm_rate_stop_workers(rate);
+	if (rate->ops.close) {
+		for (i = 0; i < rate->objs_count; i++)
+			rate->ops.close(rate->objs[i]);
 		rate->ops.close(rate->obj);
+	}
+	free(rate->objs);
 	if (rate->open_func)
 		snd_dlobj_cache_put(rate->open_func);
 	return snd_pcm_generic_close(pcm);
@@ -1191,22 +1987,97 @@ const snd_config_t *snd_pcm_rate_get_default_converter(snd_config_t *root)
 	return NULL;
 }
 
+/*
+ * Converters without get_supported_formats handle every linear format
+ * in convert, or only interleaved S16 in convert_s16.
+ */
+static void rate_get_supported_formats(snd_pcm_rate_t *rate)
+{
+	snd_pcm_format_mask_t linear = { SND_PCM_FMTBIT_LINEAR };
+
+	rate->in_formats = rate->out_formats = 0;
+	rate->plugin_flags = 0;
+	if (rate->plugin_version >= 0x010003 &&
+	    rate->ops.get_supported_formats) {
+		if (rate->ops.get_supported_formats(rate->obj,
+						    &rate->in_formats,
+						    &rate->out_formats,
+						    &rate->plugin_flags) < 0)
+			rate->in_formats = rate->out_formats = 0;
+	} else if (rate->ops.convert) {
+		rate->in_formats = linear.bits[0] |
+			((u_int64_t)linear.bits[1] << 32);
+		rate->out_formats = rate->in_formats;
+	}
+}
+
 #ifdef PIC
 static int is_builtin_plugin(const char *type)
 {
-	return strcmp(type, "linear") == 0;
+	return strcmp(type, "linear") == 0 || strcmp(type, "sinc") == 0;
 }
 
 static const char *const default_rate_plugins[] = {
 	"speexrate", "linear", NULL
 };
 
+/*
+ * Resolved converter entries stay in the dlobj cache after close.  The
+ * converters whose module or entry could not be found are remembered
+ * here, so the default list does not retry a missing speexrate with a
+ * dlopen() for every new stream.
+ */
+#define RATE_MISSING_MAX	8
+
+static char rate_missing[RATE_MISSING_MAX][32];
+static unsigned int rate_missing_count;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t rate_missing_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define rate_missing_lock()	pthread_mutex_lock(&rate_missing_mutex)
+#define rate_missing_unlock()	pthread_mutex_unlock(&rate_missing_mutex)
+#else
+#define rate_missing_lock()	do { } while (0)
+#define rate_missing_unlock()	do { } while (0)
+#endif
+
+static int rate_is_missing(const char *type)
+{
+	unsigned int i;
+	int found = 0;
+
+	rate_missing_lock();
+	for (i = 0; i < rate_missing_count; i++) {
+		if (!strcmp(rate_missing[i], type)) {
+			found = 1;
+			break;
+		}
+	}
+	rate_missing_unlock();
+	return found;
+}
+
+static void rate_set_missing(const char *type)
+{
+	if (strlen(type) >= sizeof(rate_missing[0]))
+		return;
+	rate_missing_lock();
+	if (rate_missing_count < RATE_MISSING_MAX)
+		strcpy(rate_missing[rate_missing_count++], type);
+	rate_missing_unlock();
+}
+
 static int rate_open_func(snd_pcm_rate_t *rate, const char *type, int verbose)
 {
 	char open_name[64], lib_name[128], *lib = NULL;
 	snd_pcm_rate_open_func_t open_func;
 	int err;
 
+	if (rate_is_missing(type)) {
+		if (verbose)
+			SNDERR("Rate converter %s is not available", type);
+		return -ENOENT;
+	}
 	snprintf(open_name, sizeof(open_name), "_snd_pcm_rate_%s_open", type);
 	if (!is_builtin_plugin(type)) {
 		snprintf(lib_name, sizeof(lib_name),
@@ -1214,10 +2085,13 @@ static int rate_open_func(snd_pcm_rate_t *rate, const char *type, int verbose)
 		lib = lib_name;
 	}
 	open_func = snd_dlobj_cache_get(lib, open_name, NULL, verbose);
-	if (!open_func)
+	if (!open_func) {
+		rate_set_missing(type);
 		return -ENOENT;
+	}
 
 	rate->open_func = open_func;
+	rate->open = open_func;
 	rate->rate_min = SND_PCM_PLUGIN_RATE_MIN;
 	rate->rate_max = SND_PCM_PLUGIN_RATE_MAX;
 	rate->plugin_version = SND_PCM_RATE_PLUGIN_VERSION;
@@ -1239,6 +2113,7 @@ static int rate_open_func(snd_pcm_rate_t *rate, const char *type, int verbose)
 	if (err) {
 		snd_dlobj_cache_put(open_func);
 		rate->open_func = NULL;
+		rate->open = NULL;
 	}
 	return err;
 }
@@ -1270,6 +2145,7 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 #ifndef PIC
 	snd_pcm_rate_open_func_t open_func;
 	extern int SND_PCM_RATE_PLUGIN_ENTRY(linear) (unsigned int version, void **objp, snd_pcm_rate_ops_t *ops);
+	extern int SND_PCM_RATE_PLUGIN_ENTRY(sinc) (unsigned int version, void **objp, snd_pcm_rate_ops_t *ops);
 #endif
 
 	assert(pcmp && slave);
@@ -1284,6 +2160,7 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 	rate->gen.close_slave = close_slave;
 	rate->srate = srate;
 	rate->sformat = sformat;
+	rate->threads = 1;
 
 	err = snd_pcm_new(&pcm, SND_PCM_TYPE_RATE, name, slave->stream, slave->mode);
 	if (err < 0) {
@@ -1327,14 +2204,21 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 		return -ENOENT;
 	}
 #else
-	type = "linear";
-	open_func = SND_PCM_RATE_PLUGIN_ENTRY(linear);
+	if (converter && !snd_config_get_string(converter, &type) &&
+	    strcmp(type, "sinc") == 0) {
+		open_func = SND_PCM_RATE_PLUGIN_ENTRY(sinc);
+	} else {
+		type = "linear";
+		open_func = SND_PCM_RATE_PLUGIN_ENTRY(linear);
+	}
 	err = open_func(SND_PCM_RATE_PLUGIN_VERSION, &rate->obj, &rate->ops);
 	if (err < 0) {
 		snd_pcm_free(pcm);
 		free(rate);
 		return err;
 	}
+	rate->plugin_version = rate->ops.version;
+	rate->open = open_func;
 #endif
 
 	if (! rate->ops.init || ! (rate->ops.convert || rate->ops.convert_s16) ||
@@ -1344,6 +2228,7 @@ int snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 		free(rate);
 		return err;
 	}
+	rate_get_supported_formats(rate);
 
 	pcm->ops = &snd_pcm_rate_ops;
 	pcm->fast_ops = &snd_pcm_rate_fast_ops;
@@ -1382,9 +2267,54 @@ pcm.name {
 	converter [ STR1 STR2 ... ]	# optional
 				# Converter type, default is taken from
 				# defaults.pcm.rate_converter
+	[drift_max INT]		# Enable clock drift compensation with
+				# the given max. ratio correction in ppm
+	[flexible_periods BOOL]	# Choose the periods apart from the slave
+	[threads INT]		# Threads converting groups of channels
 }
 \endcode
 
+Two converters are built in: "linear" (linear interpolation) and "sinc"
+(polyphase windowed-sinc filter, higher quality at a higher CPU cost and
+a delay of a few dozen frames).  Other converters such as "speexrate"
+or "samplerate" are loaded from external plugins.
+
+Converters which report their native formats via get_supported_formats
+(both built-in ones do) process the samples directly.  Other formats are
+converted to S16 for the convert_s16 callback of the converter.
+
+Playback streams can be rewound.  Frames not yet passed to the slave are
+always rewindable.  Periods already converted can be rolled back when the
+slave can rewind them and the converter saves its state via the
+state_size/save_state/restore_state callbacks; both built-in converters
+do.
+
+With drift_max set, the plugin compensates the drift between the clock
+of the application and the clock of the slave, e.g. when a network
+stream is played on a local card.  It tracks the delay between both
+sides and slowly tunes the conversion ratio so that the delay stays at
+the level measured right after the start.  Each slave period then
+varies by a few frames, and the converter is retuned through its
+adjust_pitch callback.  Converted periods cannot be rewound in this
+mode.
+
+Normally a period of the client is converted into exactly one period of
+the slave, so both period times are linked, which may force odd period
+sizes or fail to find a configuration at all.  With flexible_periods
+set, the period size of the client is chosen apart from the slave, and
+each client period is converted into the slave frames matching the
+rate ratio, alternating between the two nearest sizes; the slave ring
+buffer queues the converted frames.  A slave period time equal to the
+client one is still preferred when the slave supports it.  The
+converter is retuned through its adjust_pitch callback, and converted
+periods cannot be rewound in this mode.
+
+With <code>threads</code> above one, the channels are split into that
+many groups, each converted by a converter of its own.  The caller
+converts the first group and persistent worker threads convert the
+others, so streams with many channels spread over several cores.
+Converted periods cannot be rewound in this mode either.
+
 \subsection pcm_plugins_rate_funcref Function reference
 
 <UL>
@@ -1418,6 +2348,8 @@ int _snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 	snd_pcm_format_t sformat = SND_PCM_FORMAT_UNKNOWN;
 	int srate = -1;
 	const snd_config_t *converter = NULL;
+	long drift_max = 0, threads = 1;
+	int flexible = 0;
 
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1434,6 +2366,28 @@ int _snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 			converter = n;
 			continue;
 		}
+		if (strcmp(id, "drift_max") == 0) {
+			err = snd_config_get_integer(n, &drift_max);
+			if (err < 0 || drift_max < 0 || drift_max > 100000) {
+				SNDERR("Invalid drift_max value");
+				return -EINVAL;
+			}
+			continue;
+		}
+		if (strcmp(id, "flexible_periods") == 0) {
+			flexible = snd_config_get_bool(n);
+			if (flexible < 0)
+				return flexible;
+			continue;
+		}
+		if (strcmp(id, "threads") == 0) {
+			if (snd_config_get_integer(n, &threads) < 0 ||
+			    threads < 1 || threads > 64) {
+				SNDERR("Invalid threads value");
+				return -EINVAL;
+			}
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -1459,9 +2413,37 @@ int _snd_pcm_rate_open(snd_pcm_t **pcmp, const char *name,
 		return err;
 	err = snd_pcm_rate_open(pcmp, name, sformat, (unsigned int) srate,
 				converter, spcm, 1);
-	if (err < 0)
+	if (err < 0) {
 		snd_pcm_close(spcm);
-	return err;
+		return err;
+	}
+	if (drift_max) {
+		snd_pcm_rate_t *rate = (*pcmp)->private_data;
+		if (! rate->ops.adjust_pitch) {
+			SNDERR("rate converter cannot compensate drift");
+			snd_pcm_close(*pcmp);
+			return -EINVAL;
+		}
+		rate->drift_max = drift_max;
+	}
+	if (flexible) {
+		snd_pcm_rate_t *rate = (*pcmp)->private_data;
+		if (! rate->ops.adjust_pitch) {
+			SNDERR("rate converter cannot vary the period size");
+			snd_pcm_close(*pcmp);
+			return -EINVAL;
+		}
+		rate->flexible = 1;
+	}
+	if (threads > 1) {
+		snd_pcm_rate_t *rate = (*pcmp)->private_data;
+		rate->threads = threads;
+		err = snd_pcm_rate_start_workers(rate);
+		if (err < 0)
+			snd_pcm_close(*pcmp);
+		return err;
+	}
+	return 0;
 }
 #ifndef DOC_HIDDEN
 SND_DLSYM_BUILD_VERSION(_snd_pcm_rate_open, SND_PCM_DLSYM_VERSION);
@@ -400,6 +400,28 @@ static void linear_reset(void *obj)
 		memset(rate->old_sample, 0, sizeof(*rate->old_sample) * rate->channels);
 }
 
+/* the state carried over a period boundary is the last input sample */
+static size_t linear_state_size(void *obj)
+{
+	struct rate_linear *rate = obj;
+
+	return sizeof(*rate->old_sample) * rate->channels;
+}
+
+static void linear_save_state(void *obj, void *buf)
+{
+	struct rate_linear *rate = obj;
+
+	memcpy(buf, rate->old_sample, sizeof(*rate->old_sample) * rate->channels);
+}
+
+static void linear_restore_state(void *obj, const void *buf)
+{
+	struct rate_linear *rate = obj;
+
+	memcpy(rate->old_sample, buf, sizeof(*rate->old_sample) * rate->channels);
+}
+
 static void linear_close(void *obj)
 {
 	free(obj);
@@ -418,6 +440,18 @@ static void linear_dump(ATTRIBUTE_UNUSED void *rate, snd_output_t *out)
 	snd_output_printf(out, "Converter: linear-interpolation\n");
 }
 
+static int get_supported_formats(ATTRIBUTE_UNUSED void *obj,
+				 u_int64_t *in_formats, u_int64_t *out_formats,
+				 unsigned int *flags)
+{
+	snd_pcm_format_mask_t linear = { SND_PCM_FMTBIT_LINEAR };
+
+	*in_formats = linear.bits[0] | ((u_int64_t)linear.bits[1] << 32);
+	*out_formats = *in_formats;
+	*flags = 0;
+	return 0;
+}
+
 static const snd_pcm_rate_ops_t linear_ops = {
 	.close = linear_close,
 	.init = linear_init,
@@ -430,6 +464,10 @@ static const snd_pcm_rate_ops_t linear_ops = {
 	.version = SND_PCM_RATE_PLUGIN_VERSION,
 	.get_supported_rates = get_supported_rates,
 	.dump = linear_dump,
+	.get_supported_formats = get_supported_formats,
+	.state_size = linear_state_size,
+	.save_state = linear_save_state,
+	.restore_state = linear_restore_state,
 };
 
 int SND_PCM_RATE_PLUGIN_ENTRY(linear) (ATTRIBUTE_UNUSED unsigned int version,
@@ -0,0 +1,535 @@
+/*
+ *  Polyphase windowed-sinc rate converter plugin
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include "bswap.h"
+#include "pcm_local.h"
+#include "pcm_plugin.h"
+#include "pcm_rate.h"
+
+#include "plugin_ops.h"
+
+/*
+ * The converter works on the ratio of the period sizes, like the linear
+ * one, so that each call consumes exactly in.period_size frames and
+ * produces exactly out.period_size frames.  With the reduced ratio M/L,
+ * output n is taken at input position n * M / L.
+ *
+ * The filter bank holds one row of SINC_ZERO_CROSSINGS * 2 taps (more
+ * when downsampling) per phase.  When L is small enough, as for the usual
+ * 44.1k <-> 48k or 48k <-> 96k setups, there is an exact row for each
+ * of the L phases; otherwise SINC_MAX_PHASES rows are computed and the
+ * coefficients are interpolated between the two nearest rows.
+ */
+
+#define SINC_ZERO_CROSSINGS	16
+#define SINC_MAX_TAPS		256
+#define SINC_MAX_PHASES		512
+#define SINC_KAISER_BETA	8.6
+#define SINC_CUTOFF		0.95
+
+struct rate_sinc {
+	unsigned int channels;
+	unsigned int get_idx;
+	unsigned int put_idx;
+	snd_pcm_format_t in_format;
+	snd_pcm_format_t out_format;
+	unsigned int in_period;
+	unsigned int out_period;
+	unsigned int step_int;	/* M / L */
+	unsigned int step_frac;	/* M % L */
+	unsigned int L;
+	unsigned int phases;	/* rows in the bank */
+	unsigned int taps;	/* taps per row, multiple of 4 */
+	float *bank;		/* (phases + 1) * taps coefficients */
+	float *hist;		/* channels * hist_size samples */
+	unsigned int hist_size;	/* at least taps + in_period */
+	unsigned int frac;	/* current phase, 0 .. L - 1 */
+	double cutoff;		/* cutoff of the bank */
+};
+
+static snd_pcm_uframes_t input_frames(void *obj, snd_pcm_uframes_t frames)
+{
+	struct rate_sinc *rate = obj;
+	if (frames == 0)
+		return 0;
+	return muldiv_near(frames, rate->in_period, rate->out_period);
+}
+
+static snd_pcm_uframes_t output_frames(void *obj, snd_pcm_uframes_t frames)
+{
+	struct rate_sinc *rate = obj;
+	if (frames == 0)
+		return 0;
+	return muldiv_near(frames, rate->out_period, rate->in_period);
+}
+
+static unsigned int gcd(unsigned int a, unsigned int b)
+{
+	while (b) {
+		unsigned int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/* zeroth order modified Bessel function of the first kind */
+static double bessel_i0(double x)
+{
+	double sum = 1.0, term = 1.0, q = x * x / 4.0;
+	unsigned int k;
+
+	for (k = 1; k < 32; k++) {
+		term *= q / ((double)k * k);
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+/* coefficients for the window starting at the input frame before the
+ * interpolated position, which is at taps / 2 - 1 + phase
+ */
+static void sinc_make_row(float *row, unsigned int taps, double phase,
+			  double cutoff)
+{
+	double half = taps / 2.0, sum = 0.0;
+	double i0_beta = bessel_i0(SINC_KAISER_BETA);
+	unsigned int k;
+
+	for (k = 0; k < taps; k++) {
+		double x = (double)k - (half - 1.0) - phase;
+		double r = x / half, w, s;
+		if (r <= -1.0 || r >= 1.0) {
+			row[k] = 0.0;
+			continue;
+		}
+		w = bessel_i0(SINC_KAISER_BETA * sqrt(1.0 - r * r)) / i0_beta;
+		s = x == 0.0 ? 1.0 : sin(M_PI * cutoff * x) / (M_PI * cutoff * x);
+		row[k] = cutoff * s * w;
+		sum += row[k];
+	}
+	/* unity gain at DC for each phase */
+	for (k = 0; k < taps; k++)
+		row[k] /= sum;
+}
+
+/* four partial sums, so that the compiler can vectorize the loop */
+static inline float sinc_dot(const float *x, const float *c,
+			     unsigned int taps)
+{
+	float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	unsigned int k;
+
+	for (k = 0; k < taps; k += 4) {
+		s0 += x[k] * c[k];
+		s1 += x[k + 1] * c[k + 1];
+		s2 += x[k + 2] * c[k + 2];
+		s3 += x[k + 3] * c[k + 3];
+	}
+	return (s0 + s1) + (s2 + s3);
+}
+
+static void sinc_load(struct rate_sinc *rate, float *dst,
+		      const snd_pcm_channel_area_t *src_area,
+		      snd_pcm_uframes_t src_offset, unsigned int frames)
+{
+#define GET32_LABELS
+#include "plugin_ops.h"
+#undef GET32_LABELS
+	void *get = get32_labels[rate->get_idx];
+	const char *src = snd_pcm_channel_area_addr(src_area, src_offset);
+	int src_step = snd_pcm_channel_area_step(src_area);
+	int32_t sample = 0;
+	unsigned int i;
+
+	switch (rate->in_format) {
+	case SND_PCM_FORMAT_S16:
+		for (i = 0; i < frames; i++, src += src_step)
+			dst[i] = *(const int16_t *)src * (1.0f / 0x8000);
+		return;
+	case SND_PCM_FORMAT_S32:
+		for (i = 0; i < frames; i++, src += src_step)
+			dst[i] = *(const int32_t *)src * (1.0f / 0x80000000UL);
+		return;
+	default:
+		break;
+	}
+	for (i = 0; i < frames; i++) {
+		goto *get;
+#define GET32_END after_get
+#include "plugin_ops.h"
+#undef GET32_END
+	after_get:
+		dst[i] = sample * (1.0f / 0x80000000UL);
+		src += src_step;
+	}
+}
+
+static inline int32_t sinc_float_to_s32(float v)
+{
+	v *= (float)0x80000000UL;
+	if (v >= (float)0x7fffffff)
+		return 0x7fffffff;
+	if (v <= -(float)0x80000000UL)
+		return (int32_t)0x80000000;
+	return lrintf(v);
+}
+
+static void sinc_store(struct rate_sinc *rate, char *dst, float v)
+{
+#define PUT32_LABELS
+#include "plugin_ops.h"
+#undef PUT32_LABELS
+	void *put = put32_labels[rate->put_idx];
+	int32_t sample;
+
+	if (rate->out_format == SND_PCM_FORMAT_S16) {
+		v *= 0x8000;
+		if (v >= 0x7fff)
+			*(int16_t *)dst = 0x7fff;
+		else if (v <= -0x8000)
+			*(int16_t *)dst = -0x8000;
+		else
+			*(int16_t *)dst = lrintf(v);
+		return;
+	}
+	sample = sinc_float_to_s32(v);
+	if (rate->out_format == SND_PCM_FORMAT_S32) {
+		*(int32_t *)dst = sample;
+		return;
+	}
+	goto *put;
+#define PUT32_END after_put
+#include "plugin_ops.h"
+#undef PUT32_END
+ after_put:
+	return;
+}
+
+static void sinc_convert(void *obj,
+			 const snd_pcm_channel_area_t *dst_areas,
+			 snd_pcm_uframes_t dst_offset, unsigned int dst_frames,
+			 const snd_pcm_channel_area_t *src_areas,
+			 snd_pcm_uframes_t src_offset, unsigned int src_frames)
+{
+	struct rate_sinc *rate = obj;
+	unsigned int taps = rate->taps;
+	unsigned int channel, frac = rate->frac;
+
+	if (CHECK_SANITY(src_frames > rate->in_period)) {
+		SNDERR("src_frames overflow");
+		src_frames = rate->in_period;
+	}
+	for (channel = 0; channel < rate->channels; ++channel) {
+		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		float *hist = rate->hist + channel * rate->hist_size;
+		char *dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+		int dst_step = snd_pcm_channel_area_step(dst_area);
+		unsigned int pos = 0, n;
+
+		sinc_load(rate, hist + taps, &src_areas[channel], src_offset,
+			  src_frames);
+		frac = rate->frac;
+		for (n = 0; n < dst_frames; n++) {
+			const float *x = hist + pos;
+			float v;
+			if (rate->phases == rate->L) {
+				v = sinc_dot(x, rate->bank + frac * taps, taps);
+			} else {
+				/* interpolate between the nearest rows */
+				uint64_t p = (uint64_t)frac * rate->phases;
+				unsigned int row = p / rate->L;
+				float f = (float)(p % rate->L) / rate->L;
+				const float *c = rate->bank + row * taps;
+				v = sinc_dot(x, c, taps) * (1.0f - f) +
+				    sinc_dot(x, c + taps, taps) * f;
+			}
+			sinc_store(rate, dst, v);
+			dst += dst_step;
+			pos += rate->step_int;
+			frac += rate->step_frac;
+			if (frac >= rate->L) {
+				frac -= rate->L;
+				pos++;
+			}
+			if (CHECK_SANITY(pos > src_frames)) {
+				SNDERR("dst_frames overflow");
+				break;
+			}
+		}
+		/* keep the last taps input frames for the next call */
+		memmove(hist, hist + src_frames, taps * sizeof(*hist));
+	}
+	rate->frac = frac;
+}
+
+static void sinc_free(void *obj)
+{
+	struct rate_sinc *rate = obj;
+
+	free(rate->bank);
+	rate->bank = NULL;
+	free(rate->hist);
+	rate->hist = NULL;
+}
+
+/* compute the rows of the bank, allocated when its size changes */
+static int sinc_make_bank(struct rate_sinc *rate, unsigned int taps,
+			  unsigned int phases, double cutoff)
+{
+	unsigned int p;
+
+	if (!rate->bank || taps != rate->taps || phases != rate->phases) {
+		free(rate->bank);
+		rate->bank = malloc((phases + 1) * taps * sizeof(*rate->bank));
+		if (!rate->bank)
+			return -ENOMEM;
+	}
+	for (p = 0; p <= phases; p++)
+		sinc_make_row(rate->bank + p * taps, taps,
+			      (double)p / phases, cutoff);
+	rate->phases = phases;
+	rate->cutoff = cutoff;
+	return 0;
+}
+
+/*
+ * Set up the filter for the period sizes in info.  Called again when the
+ * ratio is retuned, which the drift compensation of pcm_rate does from
+ * the audio path, so a retune neither allocates nor computes: it keeps
+ * the taps and the cutoff, which the small changes of the ratio don't
+ * move noticeably, and the history as long as it is long enough.  The
+ * first retune switches an exact bank to SINC_MAX_PHASES interpolated
+ * rows, which serve any ratio; pcm_rate retunes to the longest slave
+ * period at hw_params, so that the bank and the history are set up for
+ * all periods before the stream starts.
+ */
+static int sinc_setup(struct rate_sinc *rate, snd_pcm_rate_info_t *info)
+{
+	unsigned int g, M, L, taps, phases, hist_size;
+	double cutoff;
+	int err;
+
+	if (!info->in.period_size || !info->out.period_size)
+		return -EINVAL;
+	g = gcd(info->in.period_size, info->out.period_size);
+	M = info->in.period_size / g;
+	L = info->out.period_size / g;
+
+	if (!rate->bank) {
+		/* lower the cutoff and widen the filter when downsampling */
+		cutoff = SINC_CUTOFF;
+		taps = SINC_ZERO_CROSSINGS * 2;
+		if (M > L) {
+			cutoff *= (double)L / M;
+			taps = ceil(SINC_ZERO_CROSSINGS * 2 * (double)M / L);
+		}
+		taps = (taps + 3) & ~3;
+		if (taps > SINC_MAX_TAPS)
+			taps = SINC_MAX_TAPS;
+		phases = L <= SINC_MAX_PHASES ? L : SINC_MAX_PHASES;
+		err = sinc_make_bank(rate, taps, phases, cutoff);
+		if (err < 0)
+			return err;
+	} else {
+		taps = rate->taps;
+		if (rate->phases != L && rate->phases != SINC_MAX_PHASES) {
+			err = sinc_make_bank(rate, taps, SINC_MAX_PHASES,
+					     rate->cutoff);
+			if (err < 0)
+				return err;
+		}
+	}
+
+	hist_size = taps + info->in.period_size;
+	if (!rate->hist || taps != rate->taps || hist_size > rate->hist_size) {
+		float *hist = calloc(rate->channels * hist_size, sizeof(*hist));
+		unsigned int channel;
+
+		if (!hist)
+			return -ENOMEM;
+		if (rate->hist && taps == rate->taps) {
+			for (channel = 0; channel < rate->channels; channel++)
+				memcpy(hist + channel * hist_size,
+				       rate->hist + channel * rate->hist_size,
+				       taps * sizeof(*hist));
+		} else {
+			rate->frac = 0;
+		}
+		free(rate->hist);
+		rate->hist = hist;
+		rate->hist_size = hist_size;
+	}
+	if (rate->L && L != rate->L)
+		rate->frac = (uint64_t)rate->frac * L / rate->L;
+
+	rate->taps = taps;
+	rate->L = L;
+	rate->step_int = M / L;
+	rate->step_frac = M % L;
+	rate->in_period = info->in.period_size;
+	rate->out_period = info->out.period_size;
+	return 0;
+}
+
+static int sinc_init(void *obj, snd_pcm_rate_info_t *info)
+{
+	struct rate_sinc *rate = obj;
+
+	rate->in_format = info->in.format;
+	rate->out_format = info->out.format;
+	rate->get_idx = snd_pcm_linear_get_index(info->in.format, SND_PCM_FORMAT_S32);
+	rate->put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S32, info->out.format);
+	rate->channels = info->channels;
+	free(rate->bank);
+	rate->bank = NULL;
+	free(rate->hist);
+	rate->hist = NULL;
+	rate->L = 0;
+	rate->frac = 0;
+	return sinc_setup(rate, info);
+}
+
+static int sinc_adjust_pitch(void *obj, snd_pcm_rate_info_t *info)
+{
+	struct rate_sinc *rate = obj;
+
+	if (info->in.period_size == rate->in_period &&
+	    info->out.period_size == rate->out_period)
+		return 0;
+	return sinc_setup(rate, info);
+}
+
+static void sinc_reset(void *obj)
+{
+	struct rate_sinc *rate = obj;
+
+	if (rate->hist)
+		memset(rate->hist, 0, rate->channels * rate->hist_size *
+		       sizeof(*rate->hist));
+	rate->frac = 0;
+}
+
+/* the state carried over a period boundary is the phase and the history */
+static size_t sinc_state_size(void *obj)
+{
+	struct rate_sinc *rate = obj;
+
+	return sizeof(rate->frac) +
+		rate->channels * rate->taps * sizeof(*rate->hist);
+}
+
+static void sinc_save_state(void *obj, void *buf)
+{
+	struct rate_sinc *rate = obj;
+	char *p = buf;
+	unsigned int channel;
+
+	memcpy(p, &rate->frac, sizeof(rate->frac));
+	p += sizeof(rate->frac);
+	for (channel = 0; channel < rate->channels; channel++) {
+		memcpy(p, rate->hist + channel * rate->hist_size,
+		       rate->taps * sizeof(*rate->hist));
+		p += rate->taps * sizeof(*rate->hist);
+	}
+}
+
+static void sinc_restore_state(void *obj, const void *buf)
+{
+	struct rate_sinc *rate = obj;
+	const char *p = buf;
+	unsigned int channel;
+
+	memcpy(&rate->frac, p, sizeof(rate->frac));
+	p += sizeof(rate->frac);
+	for (channel = 0; channel < rate->channels; channel++) {
+		memcpy(rate->hist + channel * rate->hist_size, p,
+		       rate->taps * sizeof(*rate->hist));
+		p += rate->taps * sizeof(*rate->hist);
+	}
+}
+
+static void sinc_close(void *obj)
+{
+	free(obj);
+}
+
+static int get_supported_rates(ATTRIBUTE_UNUSED void *rate,
+			       unsigned int *rate_min, unsigned int *rate_max)
+{
+	*rate_min = SND_PCM_PLUGIN_RATE_MIN;
+	*rate_max = SND_PCM_PLUGIN_RATE_MAX;
+	return 0;
+}
+
+static void sinc_dump(void *obj, snd_output_t *out)
+{
+	struct rate_sinc *rate = obj;
+
+	snd_output_printf(out, "Converter: polyphase windowed-sinc "
+			  "(taps %u, phases %u%s)\n", rate->taps, rate->phases,
+			  rate->phases != rate->L ? ", interpolated" : "");
+}
+
+static int get_supported_formats(ATTRIBUTE_UNUSED void *obj,
+				 u_int64_t *in_formats, u_int64_t *out_formats,
+				 unsigned int *flags)
+{
+	snd_pcm_format_mask_t linear = { SND_PCM_FMTBIT_LINEAR };
+
+	*in_formats = linear.bits[0] | ((u_int64_t)linear.bits[1] << 32);
+	*out_formats = *in_formats;
+	*flags = 0;
+	return 0;
+}
+
+static const snd_pcm_rate_ops_t sinc_ops = {
+	.close = sinc_close,
+	.init = sinc_init,
+	.free = sinc_free,
+	.reset = sinc_reset,
+	.adjust_pitch = sinc_adjust_pitch,
+	.convert = sinc_convert,
+	.input_frames = input_frames,
+	.output_frames = output_frames,
+	.version = SND_PCM_RATE_PLUGIN_VERSION,
+	.get_supported_rates = get_supported_rates,
+	.dump = sinc_dump,
+	.get_supported_formats = get_supported_formats,
+	.state_size = sinc_state_size,
+	.save_state = sinc_save_state,
+	.restore_state = sinc_restore_state,
+};
+
+int SND_PCM_RATE_PLUGIN_ENTRY(sinc) (ATTRIBUTE_UNUSED unsigned int version,
+				     void **objp, snd_pcm_rate_ops_t *ops)
+{
+	struct rate_sinc *rate;
+
+	rate = calloc(1, sizeof(*rate));
+	if (! rate)
+		return -ENOMEM;
+
+	*objp = rate;
+	*ops = sinc_ops;
+	return 0;
+}
@@ -30,6 +30,7 @@
 #include <math.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
+#include "pcm_special.h"
 
 #include "plugin_ops.h"
 
@@ -59,17 +60,29 @@ typedef struct {
 
 typedef struct snd_pcm_route_ttable_dst snd_pcm_route_ttable_dst_t;
 
-typedef struct {
+typedef struct snd_pcm_route_params {
 	enum {UINT64, FLOAT} sum_idx;
 	unsigned int get_idx;
 	unsigned int put_idx;
 	unsigned int conv_idx;
 	int use_getput;
 	unsigned int src_size;
+	unsigned int dst_size;
 	snd_pcm_format_t dst_sfmt;
 	unsigned int nsrcs;
 	unsigned int ndsts;
 	snd_pcm_route_ttable_dst_t *dsts;
+	snd_pcm_route_ttable_src_t *matrix;	/* dense ndsts x nsrcs table */
+	int use_matrix;
+	int *select;		/* source of each destination, -1 for none */
+	int use_select;
+	unsigned int select_size;	/* physical sample bytes */
+	u_int64_t select_silence;
+	int use_float;		/* native FLOAT on both sides */
+	/* kernel of SND_PCM_SPECIALIZE for the square matrix */
+	void (*special)(void *dst, const void *src, snd_pcm_uframes_t frames,
+			const struct snd_pcm_route_params *params);
+	unsigned int special_size;	/* physical sample bytes */
 } snd_pcm_route_params_t;
 
 
@@ -395,6 +408,435 @@ static void snd_pcm_route_convert1_many(const snd_pcm_channel_area_t *dst_area,
 	}
 }
 
+/*
+ * Matrix engine for dense tables on interleaved native S16/S32 buffers
+ *
+ * The frames are processed in blocks: the source channels of a block are
+ * expanded to 32-bit once, then each destination is accumulated over the
+ * whole block with one multiply-add loop per source, which the compiler
+ * can vectorize.  The sums are built in the same order and with the same
+ * arithmetic as snd_pcm_route_convert1_many(), so the output is the same.
+ */
+
+#define ROUTE_MATRIX_BLOCK	64
+#define ROUTE_MATRIX_MAX_SRCS	32
+
+static inline void snd_pcm_route_matrix_sum(int32_t *out,
+					    int32_t in[][ROUTE_MATRIX_BLOCK],
+					    const snd_pcm_route_ttable_src_t *row,
+					    unsigned int nsrcs, unsigned int n)
+{
+	unsigned int s, f;
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	float sum[ROUTE_MATRIX_BLOCK];
+
+	for (f = 0; f < n; f++)
+		sum[f] = 0.0;
+	for (s = 0; s < nsrcs; s++) {
+		float c = row[s].as_float;
+		if (c == 0.0)
+			continue;
+		for (f = 0; f < n; f++)
+			sum[f] += in[s][f] * c;
+	}
+	for (f = 0; f < n; f++) {
+		float v = rint(sum[f]);
+		if (v > (int64_t)0x7fffffff)
+			out[f] = 0x7fffffff;	/* maximum positive value */
+		else if (v < -(int64_t)0x80000000)
+			out[f] = 0x80000000;	/* maximum negative value */
+		else
+			out[f] = v;
+	}
+#else
+	int64_t sum[ROUTE_MATRIX_BLOCK];
+
+	for (f = 0; f < n; f++)
+		sum[f] = 0;
+	for (s = 0; s < nsrcs; s++) {
+		int c = row[s].as_int;
+		if (c == 0)
+			continue;
+		for (f = 0; f < n; f++)
+			sum[f] += (int64_t) in[s][f] * c;
+	}
+	for (f = 0; f < n; f++) {
+		/* non attenuated tables have only full entries, so the
+		 * division is exact for them */
+		div(sum[f]);
+		if (sum[f] > (int64_t)0x7fffffff)
+			out[f] = 0x7fffffff;	/* maximum positive value */
+		else if (sum[f] < -(int64_t)0x80000000)
+			out[f] = 0x80000000;	/* maximum negative value */
+		else
+			out[f] = sum[f];
+	}
+#endif
+}
+
+/* the engine on src and dst, also expanded with constant arguments */
+#define ROUTE_MATRIX(NSRCS, NDSTS, SRC_SIZE, DST_SIZE) do {		\
+	int32_t in[NSRCS][ROUTE_MATRIX_BLOCK];				\
+	int32_t out[ROUTE_MATRIX_BLOCK];				\
+	while (frames > 0) {						\
+		unsigned int n = frames > ROUTE_MATRIX_BLOCK ? ROUTE_MATRIX_BLOCK : frames; \
+		unsigned int s, d, f;					\
+		for (s = 0; s < NSRCS; s++) {				\
+			if (SRC_SIZE == 2) {				\
+				const int16_t *p = (const int16_t *)src + s; \
+				for (f = 0; f < n; f++, p += NSRCS)	\
+					in[s][f] = (u_int32_t)(u_int16_t)*p << 16; \
+			} else {					\
+				const int32_t *p = (const int32_t *)src + s; \
+				for (f = 0; f < n; f++, p += NSRCS)	\
+					in[s][f] = *p;			\
+			}						\
+		}							\
+		for (d = 0; d < NDSTS; d++) {				\
+			const snd_pcm_route_ttable_dst_t *dt = &params->dsts[d]; \
+			const int32_t *res = out;			\
+			if (dt->nsrcs == 0)				\
+				memset(out, 0, n * sizeof(*out));	\
+			else if (dt->nsrcs == 1 &&			\
+				 dt->srcs[0].as_int == SND_PCM_PLUGIN_ROUTE_RESOLUTION) \
+				res = in[dt->srcs[0].channel];		\
+			else						\
+				snd_pcm_route_matrix_sum(out, in,	\
+							 &params->matrix[d * NSRCS], \
+							 NSRCS, n);	\
+			if (DST_SIZE == 2) {				\
+				int16_t *p = (int16_t *)dst + d;	\
+				for (f = 0; f < n; f++, p += NDSTS)	\
+					*p = res[f] >> 16;		\
+			} else {					\
+				int32_t *p = (int32_t *)dst + d;	\
+				for (f = 0; f < n; f++, p += NDSTS)	\
+					*p = res[f];			\
+			}						\
+		}							\
+		src += n * NSRCS * SRC_SIZE;				\
+		dst += n * NDSTS * DST_SIZE;				\
+		frames -= n;						\
+	}								\
+} while (0)
+
+static void snd_pcm_route_convert_matrix(const snd_pcm_channel_area_t *dst_areas,
+					 snd_pcm_uframes_t dst_offset,
+					 const snd_pcm_channel_area_t *src_areas,
+					 snd_pcm_uframes_t src_offset,
+					 snd_pcm_uframes_t frames,
+					 const snd_pcm_route_params_t *params)
+{
+	const char *src = snd_pcm_channel_area_addr(src_areas, src_offset);
+	char *dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+
+	ROUTE_MATRIX(params->nsrcs, params->ndsts,
+		     params->src_size, params->dst_size);
+}
+
+/*
+ * Specialized matrix kernels
+ *
+ * For the entries of SND_PCM_SPECIALIZE a table with as many sources as
+ * destinations, e.g. a crossfeed or a balance of the channels, runs on
+ * constant channel counts.  Up to ROUTE_SPECIAL_FRAMES_MAX channels a
+ * frame is mixed at once with both loops over the channels unrolled;
+ * above, the blocks of the matrix engine are faster and it is expanded
+ * with the constant strides.  The sums and the clipping are those of the
+ * generic engines, FLOAT always mixes frame by frame.
+ */
+
+#define ROUTE_SPECIAL_FRAMES_MAX	4
+
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+typedef float route_special_sum_t;
+#define ROUTE_SPECIAL_COEF(src)	((src)->as_float)
+#else
+typedef int64_t route_special_sum_t;
+#define ROUTE_SPECIAL_COEF(src)	((int64_t)(src)->as_int)
+#endif
+
+static inline int32_t snd_pcm_route_special_clip(route_special_sum_t sum)
+{
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	sum = rint(sum);
+#else
+	div(sum);
+#endif
+	if (sum > (int64_t)0x7fffffff)
+		return 0x7fffffff;	/* maximum positive value */
+	if (sum < -(int64_t)0x80000000)
+		return 0x80000000;	/* maximum negative value */
+	return sum;
+}
+
+#define ROUTE_SPECIAL_GET_2(x)	((int32_t)((u_int32_t)(u_int16_t)(x) << 16))
+#define ROUTE_SPECIAL_PUT_2(x)	((x) >> 16)
+#define ROUTE_SPECIAL_GET_4(x)	(x)
+#define ROUTE_SPECIAL_PUT_4(x)	(x)
+
+#define ROUTE_SPECIAL_short(fmt, CH)	ROUTE_SPECIAL_INT(fmt, CH, int16_t, 2)
+#define ROUTE_SPECIAL_int(fmt, CH)	ROUTE_SPECIAL_INT(fmt, CH, int32_t, 4)
+
+#define ROUTE_SPECIAL_INT(fmt, CH, TYPE, SIZE) \
+static void snd_pcm_route_special_##fmt##_##CH(void *dstp, const void *srcp, \
+					       snd_pcm_uframes_t frames, \
+					       const snd_pcm_route_params_t *params) \
+{ \
+	if (CH > ROUTE_SPECIAL_FRAMES_MAX) { \
+		const char *src = srcp; \
+		char *dst = dstp; \
+		ROUTE_MATRIX(CH, CH, SIZE, SIZE); \
+	} else { \
+		const TYPE *src = srcp; \
+		TYPE *dst = dstp; \
+		route_special_sum_t coef[CH * CH]; \
+		int copy[CH]; \
+		snd_pcm_uframes_t f; \
+		unsigned int s, d; \
+		for (s = 0; s < CH * CH; s++) \
+			coef[s] = ROUTE_SPECIAL_COEF(&params->matrix[s]); \
+		for (d = 0; d < CH; d++) { \
+			const snd_pcm_route_ttable_dst_t *dt = &params->dsts[d]; \
+			copy[d] = dt->nsrcs == 1 && \
+				dt->srcs[0].as_int == SND_PCM_PLUGIN_ROUTE_RESOLUTION ? \
+				(int)dt->srcs[0].channel : -1; \
+		} \
+		for (f = 0; f < frames; f++, src += CH, dst += CH) { \
+			int32_t in[CH]; \
+			for (s = 0; s < CH; s++) \
+				in[s] = ROUTE_SPECIAL_GET_##SIZE(src[s]); \
+			for (d = 0; d < CH; d++) { \
+				route_special_sum_t sum = 0; \
+				if (copy[d] >= 0) { \
+					dst[d] = src[copy[d]]; \
+					continue; \
+				} \
+				for (s = 0; s < CH; s++) \
+					sum += in[s] * coef[d * CH + s]; \
+				dst[d] = ROUTE_SPECIAL_PUT_##SIZE(snd_pcm_route_special_clip(sum)); \
+			} \
+		} \
+	} \
+}
+
+#define ROUTE_SPECIAL_float(fmt, CH) \
+static void snd_pcm_route_special_##fmt##_##CH(void *dstp, const void *srcp, \
+					       snd_pcm_uframes_t frames, \
+					       const snd_pcm_route_params_t *params) \
+{ \
+	float *dst = dstp; \
+	const float *src = srcp; \
+	float coef[CH * CH]; \
+	snd_pcm_uframes_t f; \
+	unsigned int s, d; \
+	for (s = 0; s < CH * CH; s++) \
+		coef[s] = snd_pcm_route_coef(&params->matrix[s]); \
+	for (f = 0; f < frames; f++, src += CH, dst += CH) { \
+		float in[CH]; \
+		for (s = 0; s < CH; s++) \
+			in[s] = src[s]; \
+		for (d = 0; d < CH; d++) { \
+			float sum = 0; \
+			for (s = 0; s < CH; s++) \
+				sum += in[s] * coef[d * CH + s]; \
+			dst[d] = sum; \
+		} \
+	} \
+}
+
+#define ROUTE_SPECIAL(fmt, CH, TYPE)	ROUTE_SPECIAL_##TYPE(fmt, CH)
+
+/* the kernels are expanded after snd_pcm_route_coef() */
+
+/*
+ * Selection engine for tables which only pick or reorder channels
+ *
+ * With the same format on both sides a destination is a plain copy of
+ * its source, so the frames are gathered sample by sample in one pass
+ * over interleaved buffers, or copied channel by channel otherwise.
+ */
+
+#define ROUTE_GATHER(type) do {						\
+	const type *s = (const type *)src;				\
+	type *p = (type *)dst;						\
+	type silence = (type)params->select_silence;			\
+	for (f = 0; f < frames; f++, s += src_channels, p += dst_channels) \
+		for (d = 0; d < dst_channels; d++)			\
+			p[d] = map[d] < 0 ? silence : s[map[d]];	\
+} while (0)
+
+static void snd_pcm_route_convert_select(const snd_pcm_channel_area_t *dst_areas,
+					 snd_pcm_uframes_t dst_offset,
+					 const snd_pcm_channel_area_t *src_areas,
+					 snd_pcm_uframes_t src_offset,
+					 unsigned int src_channels,
+					 unsigned int dst_channels,
+					 snd_pcm_uframes_t frames,
+					 const snd_pcm_route_params_t *params)
+{
+	unsigned int bits = params->select_size * 8;
+	int map[dst_channels];
+	int gather;
+	unsigned int d;
+	snd_pcm_uframes_t f;
+
+	gather = snd_pcm_areas_interleaved(src_areas, src_channels, bits) &&
+		snd_pcm_areas_interleaved(dst_areas, dst_channels, bits);
+	for (d = 0; d < dst_channels; d++) {
+		int c = d < params->ndsts ? params->select[d] : -1;
+		if (c >= (int)src_channels || (c >= 0 && !src_areas[c].addr))
+			c = -1;
+		map[d] = c;
+	}
+	if (gather) {
+		const char *src = snd_pcm_channel_area_addr(src_areas, src_offset);
+		char *dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+
+		switch (params->select_size) {
+		case 1:
+			ROUTE_GATHER(u_int8_t);
+			return;
+		case 2:
+			ROUTE_GATHER(u_int16_t);
+			return;
+		case 4:
+			ROUTE_GATHER(u_int32_t);
+			return;
+		case 8:
+			ROUTE_GATHER(u_int64_t);
+			return;
+		}
+	}
+	for (d = 0; d < dst_channels; d++) {
+		if (map[d] < 0)
+			snd_pcm_area_silence(&dst_areas[d], dst_offset, frames,
+					     params->dst_sfmt);
+		else
+			snd_pcm_area_copy(&dst_areas[d], dst_offset,
+					  &src_areas[map[d]], src_offset,
+					  frames, params->dst_sfmt);
+	}
+}
+
+#undef ROUTE_GATHER
+
+/*
+ * Float engine for native FLOAT on both sides
+ *
+ * The sums stay in float, without the round trip through 32-bit
+ * integers and without clipping, so the headroom of the format is kept
+ * for the next stage.  Like in the matrix engine, a block of each used
+ * source is loaded once and every destination is accumulated over the
+ * block with one multiply-add loop per source; the compiler vectorizes
+ * these loops and contracts them to fused multiply-adds where the
+ * target has them.  Any layout of the areas is handled.
+ */
+
+static inline float snd_pcm_route_coef(const snd_pcm_route_ttable_src_t *src)
+{
+#if SND_PCM_PLUGIN_ROUTE_FLOAT
+	return src->as_float;
+#else
+	return (float)src->as_int / SND_PCM_PLUGIN_ROUTE_RESOLUTION;
+#endif
+}
+
+static void snd_pcm_route_convert_float(const snd_pcm_channel_area_t *dst_areas,
+					snd_pcm_uframes_t dst_offset,
+					const snd_pcm_channel_area_t *src_areas,
+					snd_pcm_uframes_t src_offset,
+					unsigned int src_channels,
+					unsigned int dst_channels,
+					snd_pcm_uframes_t frames,
+					const snd_pcm_route_params_t *params)
+{
+	float in[src_channels][ROUTE_MATRIX_BLOCK];
+	float out[ROUTE_MATRIX_BLOCK];
+	const float *sp[src_channels];
+	float *dp[dst_channels];
+	unsigned int sstep[src_channels], dstep[dst_channels];
+	unsigned int ndsts = params->ndsts < dst_channels ? params->ndsts : dst_channels;
+	unsigned int s, d, i, f;
+
+	for (s = 0; s < src_channels; s++)
+		sp[s] = NULL;
+	for (d = 0; d < ndsts; d++) {
+		const snd_pcm_route_ttable_dst_t *dt = &params->dsts[d];
+		for (i = 0; i < dt->nsrcs; i++) {
+			s = dt->srcs[i].channel;
+			if (s < src_channels && src_areas[s].addr) {
+				sp[s] = snd_pcm_channel_area_addr(&src_areas[s], src_offset);
+				sstep[s] = src_areas[s].step / 32;
+			}
+		}
+	}
+	for (d = 0; d < dst_channels; d++) {
+		dp[d] = snd_pcm_channel_area_addr(&dst_areas[d], dst_offset);
+		dstep[d] = dst_areas[d].step / 32;
+	}
+
+	while (frames > 0) {
+		unsigned int n = frames > ROUTE_MATRIX_BLOCK ? ROUTE_MATRIX_BLOCK : frames;
+
+		for (s = 0; s < src_channels; s++) {
+			const float *p = sp[s];
+			if (!p)
+				continue;
+			for (f = 0; f < n; f++, p += sstep[s])
+				in[s][f] = *p;
+			sp[s] = p;
+		}
+		for (d = 0; d < dst_channels; d++) {
+			unsigned int nsum = 0;
+			float *p = dp[d];
+			if (d < ndsts) {
+				const snd_pcm_route_ttable_dst_t *dt = &params->dsts[d];
+				for (i = 0; i < dt->nsrcs; i++) {
+					const float *x;
+					float c;
+					s = dt->srcs[i].channel;
+					if (s >= src_channels || !sp[s])
+						continue;
+					x = in[s];
+					c = snd_pcm_route_coef(&dt->srcs[i]);
+					if (nsum++ == 0) {
+						for (f = 0; f < n; f++)
+							out[f] = x[f] * c;
+					} else {
+						for (f = 0; f < n; f++)
+							out[f] += x[f] * c;
+					}
+				}
+			}
+			if (nsum == 0)
+				memset(out, 0, n * sizeof(*out));
+			for (f = 0; f < n; f++, p += dstep[d])
+				*p = out[f];
+			dp[d] = p;
+		}
+		frames -= n;
+	}
+}
+
+#define SND_PCM_SPECIAL(fmt, ch) \
+	SND_PCM_SPECIAL_EXPAND(ROUTE_SPECIAL, fmt, ch)
+SND_PCM_SPECIALIZE
+#undef SND_PCM_SPECIAL
+
+static const struct snd_pcm_route_special {
+	snd_pcm_format_t format;
+	unsigned int channels;
+	void (*func)(void *dst, const void *src, snd_pcm_uframes_t frames,
+		     const snd_pcm_route_params_t *params);
+} snd_pcm_route_specials[] = {
+#define SND_PCM_SPECIAL(fmt, ch) \
+	{ SND_PCM_FORMAT_##fmt, ch, snd_pcm_route_special_##fmt##_##ch },
+	SND_PCM_SPECIALIZE
+#undef SND_PCM_SPECIAL
+	{ SND_PCM_FORMAT_UNKNOWN, 0, NULL }
+};
+
 #endif /* DOC_HIDDEN */
 
 static void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
@@ -410,6 +852,38 @@ static void snd_pcm_route_convert(const snd_pcm_channel_area_t *dst_areas,
 	snd_pcm_route_ttable_dst_t *dstp;
 	const snd_pcm_channel_area_t *dst_area;
 
+	if (params->use_select) {
+		snd_pcm_route_convert_select(dst_areas, dst_offset,
+					     src_areas, src_offset,
+					     src_channels, dst_channels,
+					     frames, params);
+		return;
+	}
+	if (params->special &&
+	    src_channels == params->nsrcs && dst_channels == params->ndsts &&
+	    snd_pcm_areas_interleaved(src_areas, src_channels, params->special_size * 8) &&
+	    snd_pcm_areas_interleaved(dst_areas, dst_channels, params->special_size * 8)) {
+		params->special(snd_pcm_channel_area_addr(dst_areas, dst_offset),
+				snd_pcm_channel_area_addr(src_areas, src_offset),
+				frames, params);
+		return;
+	}
+	if (params->use_float) {
+		snd_pcm_route_convert_float(dst_areas, dst_offset,
+					    src_areas, src_offset,
+					    src_channels, dst_channels,
+					    frames, params);
+		return;
+	}
+	if (params->use_matrix &&
+	    src_channels == params->nsrcs && dst_channels == params->ndsts &&
+	    snd_pcm_areas_interleaved(src_areas, src_channels, params->src_size * 8) &&
+	    snd_pcm_areas_interleaved(dst_areas, dst_channels, params->dst_size * 8)) {
+		snd_pcm_route_convert_matrix(dst_areas, dst_offset,
+					     src_areas, src_offset,
+					     frames, params);
+		return;
+	}
 	dstp = params->dsts;
 	dst_area = dst_areas;
 	for (dst_channel = 0; dst_channel < dst_channels; ++dst_channel) {
@@ -440,15 +914,24 @@ static int snd_pcm_route_close(snd_pcm_t *pcm)
 		}
 		free(params->dsts);
 	}
+	free(params->matrix);
+	free(params->select);
 	free(route->chmap);
 	return snd_pcm_generic_close(pcm);
 }
 
-static int snd_pcm_route_hw_refine_cprepare(snd_pcm_t *pcm ATTRIBUTE_UNUSED, snd_pcm_hw_params_t *params)
+static int snd_pcm_route_hw_refine_cprepare(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
+	snd_pcm_route_t *route = pcm->private_data;
 	int err;
 	snd_pcm_access_mask_t access_mask = { SND_PCM_ACCBIT_SHM };
 	snd_pcm_format_mask_t format_mask = { SND_PCM_FMTBIT_LINEAR };
+	/* native floats are mixed as floats, into floats only */
+	if (route->sformat == SND_PCM_FORMAT_FLOAT)
+		snd_pcm_format_mask_none(&format_mask);
+	if (route->sformat == SND_PCM_FORMAT_UNKNOWN ||
+	    route->sformat == SND_PCM_FORMAT_FLOAT)
+		snd_pcm_format_mask_set(&format_mask, SND_PCM_FORMAT_FLOAT);
 	err = _snd_pcm_hw_param_set_mask(params, SND_PCM_HW_PARAM_ACCESS,
 					 &access_mask);
 	if (err < 0)
@@ -565,15 +1048,46 @@ static int snd_pcm_route_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * params)
 	}
 	if (err < 0)
 		return err;
+	route->params.use_float = src_format == SND_PCM_FORMAT_FLOAT &&
+		dst_format == SND_PCM_FORMAT_FLOAT;
+	if (!route->params.use_float &&
+	    (!snd_pcm_format_linear(src_format) ||
+	     !snd_pcm_format_linear(dst_format))) {
+		SNDERR("Route of %s to %s is not supported",
+		       snd_pcm_format_name(src_format),
+		       snd_pcm_format_name(dst_format));
+		return -EINVAL;
+	}
 	/* 3 bytes formats? */
 	route->params.use_getput =
-		(snd_pcm_format_physical_width(src_format) + 7) / 3 == 3 ||
-		(snd_pcm_format_physical_width(dst_format) + 7) / 3 == 3;
+		(__snd_pcm_format_physical_width(src_format) + 7) / 3 == 3 ||
+		(__snd_pcm_format_physical_width(dst_format) + 7) / 3 == 3;
 	route->params.get_idx = snd_pcm_linear_get_index(src_format, SND_PCM_FORMAT_S32);
 	route->params.put_idx = snd_pcm_linear_put_index(SND_PCM_FORMAT_S32, dst_format);
 	route->params.conv_idx = snd_pcm_linear_convert_index(src_format, dst_format);
-	route->params.src_size = snd_pcm_format_width(src_format) / 8;
+	route->params.src_size = __snd_pcm_format_width(src_format) / 8;
+	route->params.dst_size = __snd_pcm_format_width(dst_format) / 8;
 	route->params.dst_sfmt = dst_format;
+	route->params.use_matrix = route->params.matrix &&
+		(src_format == SND_PCM_FORMAT_S16 || src_format == SND_PCM_FORMAT_S32) &&
+		(dst_format == SND_PCM_FORMAT_S16 || dst_format == SND_PCM_FORMAT_S32);
+	route->params.use_select = route->params.select && src_format == dst_format;
+	route->params.select_size = __snd_pcm_format_physical_width(dst_format) / 8;
+	route->params.select_silence = __snd_pcm_format_silence_64(dst_format);
+	route->params.special = NULL;
+	route->params.special_size = __snd_pcm_format_physical_width(dst_format) / 8;
+	if (route->params.matrix && src_format == dst_format &&
+	    route->params.nsrcs == route->params.ndsts &&
+	    snd_pcm_format_cpu_endian(dst_format)) {
+		const struct snd_pcm_route_special *sp;
+		for (sp = snd_pcm_route_specials; sp->func; sp++) {
+			if (sp->format == dst_format &&
+			    sp->channels == route->params.nsrcs) {
+				route->params.special = sp->func;
+				break;
+			}
+		}
+	}
 #if SND_PCM_PLUGIN_ROUTE_FLOAT
 	route->params.sum_idx = FLOAT;
 #else
@@ -924,6 +1438,7 @@ static int route_load_ttable(snd_pcm_route_params_t *params, snd_pcm_stream_t st
 	unsigned int src_channel, dst_channel;
 	snd_pcm_route_ttable_dst_t *dptr;
 	unsigned int sused, dused, smul, dmul;
+	unsigned int nentries = 0, nmixed = 0, natt = 0;
 	if (stream == SND_PCM_STREAM_PLAYBACK) {
 		sused = tt_cused;
 		dused = tt_sused;
@@ -970,6 +1485,10 @@ static int route_load_ttable(snd_pcm_route_params_t *params, snd_pcm_stream_t st
 #endif
 		dptr->att = att;
 		dptr->nsrcs = nsrcs;
+		nentries += nsrcs;
+		if (nsrcs > 1)
+			nmixed++;
+		natt += att;
 		if (nsrcs == 0)
 			dptr->func = snd_pcm_route_convert1_zero;
 		else
@@ -983,6 +1502,29 @@ static int route_load_ttable(snd_pcm_route_params_t *params, snd_pcm_stream_t st
 			dptr->srcs = 0;
 		dptr++;
 	}
+	/* a dense table with real mixing is handled by the matrix engine */
+	if (nmixed > 0 && sused <= ROUTE_MATRIX_MAX_SRCS &&
+	    nentries * 2 >= sused * dused) {
+		params->matrix = calloc(dused * sused, sizeof(*params->matrix));
+		if (!params->matrix)
+			return -ENOMEM;
+		for (dst_channel = 0; dst_channel < dused; ++dst_channel) {
+			snd_pcm_route_ttable_dst_t *d = &params->dsts[dst_channel];
+			unsigned int k;
+			for (k = 0; k < d->nsrcs; k++)
+				params->matrix[dst_channel * sused + d->srcs[k].channel] = d->srcs[k];
+		}
+	}
+	/* identity, swaps and channel subsets are copies */
+	if (nmixed == 0 && natt == 0) {
+		params->select = calloc(dused, sizeof(*params->select));
+		if (!params->select)
+			return -ENOMEM;
+		for (dst_channel = 0; dst_channel < dused; ++dst_channel) {
+			snd_pcm_route_ttable_dst_t *d = &params->dsts[dst_channel];
+			params->select[dst_channel] = d->nsrcs ? d->srcs[0].channel : -1;
+		}
+	}
 	return 0;
 }
 
@@ -1015,6 +1557,7 @@ int snd_pcm_route_open(snd_pcm_t **pcmp, const char *name,
 	int err;
 	assert(pcmp && slave && ttable);
 	if (sformat != SND_PCM_FORMAT_UNKNOWN && 
+	    sformat != SND_PCM_FORMAT_FLOAT &&
 	    snd_pcm_format_linear(sformat) != 1)
 		return -EINVAL;
 	route = calloc(1, sizeof(snd_pcm_route_t));
@@ -1233,6 +1776,14 @@ The format and rate must match for both of them.
 SCHANNEL can be a channel name instead of a number (e g FL, LFE).
 If so, a matching channel map will be selected for the slave.
 
+Dense transfer tables (e.g. up- or downmix matrices with up to 32 source
+channels) are processed frame block by frame block when both sides are
+interleaved S16 or S32 in native endian.
+
+With FLOAT in native endian on both sides the channels are mixed in
+floating point, without clipping.  The slave format is then FLOAT too,
+set or linked.
+
 \code
 pcm.name {
         type route              # Route & Volume conversion PCM
@@ -1326,9 +1877,10 @@ int _snd_pcm_route_open(snd_pcm_t **pcmp, const char *name,
 	if (err < 0)
 		return err;
 	if (sformat != SND_PCM_FORMAT_UNKNOWN &&
+	    sformat != SND_PCM_FORMAT_FLOAT &&
 	    snd_pcm_format_linear(sformat) != 1) {
 	    	snd_config_delete(sconf);
-		SNDERR("slave format is not linear");
+		SNDERR("slave format is not linear or native float");
 		return -EINVAL;
 	}
 
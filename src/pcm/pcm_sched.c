@@ -0,0 +1,343 @@
+/*
+ *  PCM - timer driven servicing of many streams
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * A scheduler owns one timer and a set of mmap PCMs.  Each expiry of
+ * the timer services every stream of the set in one loop: the avail
+ * is updated, the areas of the available frames are handed to the
+ * callback of the stream and the frames it processed are committed.
+ * Many streams thus share a single wakeup instead of being polled one
+ * by one.
+ */
+
+#include "pcm_local.h"
+#include "../timer/timer_local.h"
+
+#ifndef DOC_HIDDEN
+
+struct snd_pcm_sched_entry {
+	snd_pcm_t *pcm;
+	snd_pcm_sched_callback_t callback;
+	void *private_data;
+	int error;			/* stops the servicing when set */
+};
+
+struct _snd_pcm_sched {
+	snd_timer_t *timer;
+	struct snd_pcm_sched_entry *entries;
+	unsigned int count;
+	unsigned int alloc;
+};
+
+static struct snd_pcm_sched_entry *sched_find(snd_pcm_sched_t *sched, snd_pcm_t *pcm)
+{
+	unsigned int i;
+
+	for (i = 0; i < sched->count; i++) {
+		if (sched->entries[i].pcm == pcm)
+			return &sched->entries[i];
+	}
+	return NULL;
+}
+
+static int sched_open_timer(snd_pcm_sched_t *sched, const char *timer_name)
+{
+	if (timer_name)
+		return snd_timer_open(&sched->timer, timer_name, SND_TIMER_OPEN_NONBLOCK);
+	if (snd_timer_hw_open(&sched->timer, "pcm-sched", SND_TIMER_CLASS_GLOBAL,
+			      SND_TIMER_SCLASS_NONE, 0, SND_TIMER_GLOBAL_HRTIMER, 0,
+			      SND_TIMER_OPEN_NONBLOCK) >= 0)
+		return 0;
+	return snd_timer_hw_open(&sched->timer, "pcm-sched", SND_TIMER_CLASS_GLOBAL,
+				 SND_TIMER_SCLASS_NONE, 0, SND_TIMER_GLOBAL_SYSTEM, 0,
+				 SND_TIMER_OPEN_NONBLOCK);
+}
+
+/* service one stream until its avail is used or the callback stops */
+static int sched_service(struct snd_pcm_sched_entry *e)
+{
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t offset, frames;
+	snd_pcm_sframes_t avail, res;
+	int err;
+
+	avail = snd_pcm_avail_update(e->pcm);
+	if (avail < 0) {
+		err = snd_pcm_recover(e->pcm, avail, 1);
+		if (err < 0)
+			return err;
+		avail = snd_pcm_avail_update(e->pcm);
+		if (avail < 0)
+			return avail;
+	}
+	if ((snd_pcm_uframes_t)avail < e->pcm->avail_min)
+		return 0;
+	while (avail > 0) {
+		frames = avail;
+		err = snd_pcm_mmap_begin(e->pcm, &areas, &offset, &frames);
+		if (err < 0)
+			return err;
+		if (!frames)
+			break;
+		res = e->callback(e->pcm, areas, offset, frames, e->private_data);
+		if (res < 0)
+			return res;
+		if (res > (snd_pcm_sframes_t)frames)
+			res = frames;
+		res = snd_pcm_mmap_commit(e->pcm, offset, res);
+		if (res < 0)
+			return res;
+		if ((snd_pcm_uframes_t)res < frames)
+			break;
+		avail -= res;
+	}
+	return 1;
+}
+
+#endif /* DOC_HIDDEN */
+
+/**
+ * \brief Open a scheduler servicing several PCMs from one timer
+ * \param schedp Returned scheduler handle
+ * \param timer_name Name of the timer, NULL for the system hrtimer
+ * \param period_us Interval of the servicing in microseconds
+ * \return 0 on success otherwise a negative error code
+ *
+ * Without a name the high resolution system timer is used, or the
+ * system timer when there is none.  The interval is rounded to the
+ * resolution of the timer, which starts at once.
+ *
+ * \sa snd_pcm_sched_add(), snd_pcm_sched_run(), snd_pcm_sched_close()
+ */
+int snd_pcm_sched_open(snd_pcm_sched_t **schedp, const char *timer_name,
+		       unsigned int period_us)
+{
+	snd_pcm_sched_t *sched;
+	snd_timer_info_t info;
+	snd_timer_params_t params = {0};
+	unsigned long ticks;
+	int err;
+
+	assert(schedp);
+	if (!period_us)
+		return -EINVAL;
+	sched = calloc(1, sizeof(*sched));
+	if (!sched)
+		return -ENOMEM;
+	err = sched_open_timer(sched, timer_name);
+	if (err < 0) {
+		SNDERR("unable to open the scheduler timer");
+		free(sched);
+		return err;
+	}
+	err = snd_timer_info(sched->timer, &info);
+	if (err < 0)
+		goto _err;
+	ticks = 1;
+	if (info.resolution) {
+		ticks = (period_us * 1000ULL + info.resolution / 2) / info.resolution;
+		if (!ticks)
+			ticks = 1;
+	}
+	snd_timer_params_set_auto_start(&params, 1);
+	snd_timer_params_set_ticks(&params, ticks);
+	err = snd_timer_params(sched->timer, &params);
+	if (err < 0) {
+		SNDERR("unable to set the scheduler timer parameters");
+		goto _err;
+	}
+	err = snd_timer_start(sched->timer);
+	if (err < 0)
+		goto _err;
+	*schedp = sched;
+	return 0;
+ _err:
+	snd_timer_close(sched->timer);
+	free(sched);
+	return err;
+}
+
+/**
+ * \brief Close a scheduler
+ * \param sched Scheduler handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The PCMs of the set are not closed.
+ */
+int snd_pcm_sched_close(snd_pcm_sched_t *sched)
+{
+	int err;
+
+	assert(sched);
+	err = snd_timer_close(sched->timer);
+	free(sched->entries);
+	free(sched);
+	return err;
+}
+
+/**
+ * \brief Add a PCM to the set of a scheduler
+ * \param sched Scheduler handle
+ * \param pcm PCM handle, set up for mmap access
+ * \param callback Function processing the available frames
+ * \param private_data Value passed to \a callback
+ * \return 0 on success otherwise a negative error code
+ *
+ * At each expiry of the timer, once the stream has at least avail_min
+ * frames available, \a callback gets the areas of a contiguous part of
+ * them and returns the count of frames it processed, which is committed.
+ * It is called again for the part after the end of the ring buffer.
+ * Returning fewer frames than given ends the servicing of the stream for
+ * this expiry.  A negative return value, like an error the PCM cannot be
+ * recovered from, stops the servicing of the stream; see
+ * snd_pcm_sched_status().  An xrun is recovered with snd_pcm_recover().
+ *
+ * \sa snd_pcm_sched_remove()
+ */
+int snd_pcm_sched_add(snd_pcm_sched_t *sched, snd_pcm_t *pcm,
+		      snd_pcm_sched_callback_t callback, void *private_data)
+{
+	struct snd_pcm_sched_entry *e;
+
+	assert(sched && pcm && callback);
+	if (!pcm->setup)
+		return -EBADFD;
+	switch (pcm->access) {
+	case SND_PCM_ACCESS_MMAP_INTERLEAVED:
+	case SND_PCM_ACCESS_MMAP_NONINTERLEAVED:
+	case SND_PCM_ACCESS_MMAP_COMPLEX:
+		break;
+	default:
+		return -EINVAL;
+	}
+	if (sched_find(sched, pcm))
+		return -EBUSY;
+	if (sched->count == sched->alloc) {
+		unsigned int alloc = sched->alloc ? sched->alloc * 2 : 16;
+		e = realloc(sched->entries, alloc * sizeof(*e));
+		if (!e)
+			return -ENOMEM;
+		sched->entries = e;
+		sched->alloc = alloc;
+	}
+	e = &sched->entries[sched->count++];
+	e->pcm = pcm;
+	e->callback = callback;
+	e->private_data = private_data;
+	e->error = 0;
+	return 0;
+}
+
+/**
+ * \brief Remove a PCM from the set of a scheduler
+ * \param sched Scheduler handle
+ * \param pcm PCM handle
+ * \return 0 on success otherwise a negative error code
+ */
+int snd_pcm_sched_remove(snd_pcm_sched_t *sched, snd_pcm_t *pcm)
+{
+	struct snd_pcm_sched_entry *e;
+
+	assert(sched && pcm);
+	e = sched_find(sched, pcm);
+	if (!e)
+		return -ENOENT;
+	*e = sched->entries[--sched->count];
+	return 0;
+}
+
+/**
+ * \brief Get the error which stopped the servicing of a PCM
+ * \param sched Scheduler handle
+ * \param pcm PCM handle
+ * \return 0 while the PCM is serviced, the error otherwise
+ *
+ * Remove the PCM and add it again to resume the servicing.
+ */
+int snd_pcm_sched_status(snd_pcm_sched_t *sched, snd_pcm_t *pcm)
+{
+	struct snd_pcm_sched_entry *e;
+
+	assert(sched && pcm);
+	e = sched_find(sched, pcm);
+	if (!e)
+		return -ENOENT;
+	return e->error;
+}
+
+/**
+ * \brief Wait for the timer and service the PCMs of the set
+ * \param sched Scheduler handle
+ * \param timeout Longest wait in milliseconds, -1 = forever, 0 = none
+ * \return the count of PCMs given frames, 0 on timeout, otherwise a
+ *         negative error code
+ *
+ * The PCMs are serviced once per expiry, however many ticks passed
+ * since the last call.  With a zero timeout the set is serviced only if
+ * the timer expired, which suits an application polling the descriptors
+ * of snd_pcm_sched_poll_descriptors() itself.
+ */
+int snd_pcm_sched_run(snd_pcm_sched_t *sched, int timeout)
+{
+	struct pollfd pfd;
+	unsigned int i;
+	long ticks;
+	int err, n = 0;
+
+	assert(sched);
+	if (snd_timer_poll_descriptors(sched->timer, &pfd, 1) != 1)
+		return -EIO;
+	err = poll(&pfd, 1, timeout);
+	if (err < 0)
+		return -errno;
+	if (err == 0)
+		return 0;
+	ticks = snd_timer_read_ticks(sched->timer, NULL, NULL);
+	if (ticks < 0)
+		return ticks == -EAGAIN ? 0 : ticks;
+	for (i = 0; i < sched->count; i++) {
+		struct snd_pcm_sched_entry *e = &sched->entries[i];
+
+		if (e->error)
+			continue;
+		err = sched_service(e);
+		if (err < 0)
+			e->error = err;
+		else
+			n += err;
+	}
+	return n;
+}
+
+/**
+ * \brief Get the poll descriptors of a scheduler
+ * \param sched Scheduler handle
+ * \param pfds Array of poll descriptors
+ * \param space Space in the array
+ * \return the count of filled descriptors
+ *
+ * The descriptor turns readable when the timer expires; call
+ * snd_pcm_sched_run() with a zero timeout then.
+ */
+int snd_pcm_sched_poll_descriptors(snd_pcm_sched_t *sched, struct pollfd *pfds,
+				   unsigned int space)
+{
+	assert(sched);
+	return snd_timer_poll_descriptors(sched->timer, pfds, space);
+}
@@ -71,6 +71,13 @@ do { \
 #define Pthread_mutex_unlock(mutex) pthread_mutex_unlock(mutex)
 #endif
 
+/* the client hw_ptr is read without the mutex by avail_update */
+#ifdef __ATOMIC_RELAXED
+#define share_store_ptr(p, v)	__atomic_store_n(p, v, __ATOMIC_RELAXED)
+#else
+#define share_store_ptr(p, v)	(*(volatile snd_pcm_uframes_t *)(p) = (v))
+#endif
+
 typedef struct {
 	struct list_head clients;
 	struct list_head list;
@@ -216,7 +223,7 @@ static snd_pcm_uframes_t _snd_pcm_share_missing(snd_pcm_t *pcm)
 	default:
 		return INT_MAX;
 	}
-	share->hw_ptr = slave->hw_ptr;
+	share_store_ptr(&share->hw_ptr, slave->hw_ptr);
 	avail = snd_pcm_mmap_avail(pcm);
 	if (avail >= pcm->stop_threshold) {
 		_snd_pcm_share_stop(pcm, share->state == SND_PCM_STATE_DRAINING ? SND_PCM_STATE_SETUP : SND_PCM_STATE_XRUN);
@@ -782,16 +789,29 @@ static snd_pcm_sframes_t snd_pcm_share_avail_update(snd_pcm_t *pcm)
 	snd_pcm_share_t *share = pcm->private_data;
 	snd_pcm_share_slave_t *slave = share->slave;
 	snd_pcm_sframes_t avail;
-	Pthread_mutex_lock(&slave->mutex);
-	if (share->state == SND_PCM_STATE_RUNNING) {
-		avail = snd_pcm_avail_update(slave->pcm);
-		if (avail < 0) {
-			Pthread_mutex_unlock(&slave->mutex);
-			return avail;
+	int locked;
+	/* a running stream doesn't queue up behind the slave thread or the
+	 * other clients; when the mutex is busy, it uses the hw_ptr last
+	 * published by the slave thread (which refreshes it on every wakeup)
+	 * or a commit.  In the other states the slave pointer is read as
+	 * before, nothing else refreshes it in them.
+	 */
+	locked = pthread_mutex_trylock(&slave->mutex) == 0;
+	if (!locked && share->state != SND_PCM_STATE_RUNNING) {
+		Pthread_mutex_lock(&slave->mutex);
+		locked = 1;
+	}
+	if (locked) {
+		if (share->state == SND_PCM_STATE_RUNNING) {
+			avail = snd_pcm_avail_update(slave->pcm);
+			if (avail < 0) {
+				Pthread_mutex_unlock(&slave->mutex);
+				return avail;
+			}
 		}
-		share->hw_ptr = *slave->pcm->hw.ptr;
+		share_store_ptr(&share->hw_ptr, *slave->pcm->hw.ptr);
+		Pthread_mutex_unlock(&slave->mutex);
 	}
-	Pthread_mutex_unlock(&slave->mutex);
 	avail = snd_pcm_mmap_avail(pcm);
 	if ((snd_pcm_uframes_t)avail > pcm->buffer_size)
 		return -EPIPE;
@@ -1495,7 +1515,7 @@ int snd_pcm_share_open(snd_pcm_t **pcmp, const char *name, const char *sname,
 		pthread_cond_init(&slave->poll_cond, NULL);
 		list_add_tail(&slave->list, &snd_pcm_share_slaves);
 		Pthread_mutex_lock(&slave->mutex);
-		err = pthread_create(&slave->thread, NULL, snd_pcm_share_thread, slave);
+		err = snd_thread_create(&slave->thread, NULL, snd_pcm_share_thread, slave);
 		assert(err == 0);
 		Pthread_mutex_unlock(&snd_pcm_share_slaves_mutex);
 	} else {
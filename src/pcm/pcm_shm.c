@@ -40,6 +40,7 @@
 #include <sys/un.h>
 #include <sys/mman.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <net/if.h>
 #include <netdb.h>
@@ -54,9 +55,179 @@ const char *_snd_module_pcm_shm = "";
 typedef struct {
 	int socket;
 	volatile snd_pcm_shm_ctrl_t *ctrl;
+	int tcp;			/* ctrl is local, messages go over socket */
+	int poll_socket;		/* tcp: a byte per readiness of the PCM */
+	unsigned int depth;		/* tcp: periods the socket buffers hold */
+	void *buf;			/* tcp: frames on the wire */
+	size_t buf_size;
 } snd_pcm_shm_t;
 #endif
 
+/*
+ * TCP transport: the control block travels over the socket instead of
+ * being shared, in both directions per request.  The pointers are the
+ * values of the last answer.  The audio frames follow the messages,
+ * interleaved: a playback commit carries the committed frames and gets
+ * no answer, its errors show on the next request; an answer for capture
+ * carries the frames captured since the previous one.
+ */
+static int snd_pcm_shm_tcp_send(int sock, struct iovec *iov, int count)
+{
+	struct msghdr msg;
+	ssize_t n;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = count;
+	while (msg.msg_iovlen) {
+		n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		while (msg.msg_iovlen && (size_t)n >= msg.msg_iov->iov_len) {
+			n -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+		if (msg.msg_iovlen) {
+			msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + n;
+			msg.msg_iov->iov_len -= n;
+		}
+	}
+	return 0;
+}
+
+static int snd_pcm_shm_tcp_recv(int sock, void *buf, size_t size)
+{
+	ssize_t n;
+
+	while (size) {
+		n = recv(sock, buf, size, MSG_WAITALL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return n < 0 ? -errno : -EPIPE;
+		buf = (char *)buf + n;
+		size -= n;
+	}
+	return 0;
+}
+
+static void *snd_pcm_shm_tcp_buf(snd_pcm_shm_t *shm, size_t size)
+{
+	void *buf;
+
+	if (size > shm->buf_size) {
+		buf = realloc(shm->buf, size);
+		if (!buf)
+			return NULL;
+		shm->buf = buf;
+		shm->buf_size = size;
+	}
+	return shm->buf;
+}
+
+/* copy between the mmap ring and interleaved frames, wrapping at the end */
+static void snd_pcm_shm_tcp_copy(snd_pcm_t *pcm, void *buf,
+				 snd_pcm_uframes_t offset,
+				 snd_pcm_uframes_t frames, int to_ring)
+{
+	snd_pcm_channel_area_t *areas = alloca(pcm->channels * sizeof(*areas));
+	snd_pcm_uframes_t done = 0, n;
+	unsigned int c;
+
+	for (c = 0; c < pcm->channels; c++) {
+		areas[c].addr = buf;
+		areas[c].first = c * pcm->sample_bits;
+		areas[c].step = pcm->frame_bits;
+	}
+	while (done < frames) {
+		n = pcm->buffer_size - offset;
+		if (n > frames - done)
+			n = frames - done;
+		if (to_ring)
+			snd_pcm_areas_copy(pcm->running_areas, offset, areas, done,
+					   pcm->channels, n, pcm->format);
+		else
+			snd_pcm_areas_copy(areas, done, pcm->running_areas, offset,
+					   pcm->channels, n, pcm->format);
+		done += n;
+		offset = 0;
+	}
+}
+
+static long snd_pcm_shm_tcp_action(snd_pcm_t *pcm)
+{
+	snd_pcm_shm_t *shm = pcm->private_data;
+	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	struct iovec iov;
+	snd_pcm_uframes_t frames, hw;
+	size_t size;
+	void *buf;
+
+	ctrl->data_frames = 0;
+	iov.iov_base = (void *)ctrl;
+	iov.iov_len = PCM_SHM_SIZE;
+	if (snd_pcm_shm_tcp_send(shm->socket, &iov, 1) < 0 ||
+	    snd_pcm_shm_tcp_recv(shm->socket, (void *)ctrl, PCM_SHM_SIZE) < 0)
+		return -EBADFD;
+	frames = ctrl->data_frames;
+	if (frames) {
+		if (!pcm->running_areas || frames > pcm->buffer_size)
+			return -EBADFD;
+		size = snd_pcm_frames_to_bytes(pcm, frames);
+		buf = snd_pcm_shm_tcp_buf(shm, size);
+		if (!buf)
+			return -ENOMEM;
+		if (snd_pcm_shm_tcp_recv(shm->socket, buf, size) < 0)
+			return -EBADFD;
+		/* the frames end at the avail of the answer */
+		hw = (ctrl->appl.ptr + ctrl->result) % pcm->boundary;
+		hw = hw >= frames ? hw - frames : hw + pcm->boundary - frames;
+		snd_pcm_shm_tcp_copy(pcm, buf, hw % pcm->buffer_size, frames, 1);
+	}
+	return ctrl->result;
+}
+
+static snd_pcm_sframes_t snd_pcm_shm_tcp_commit(snd_pcm_t *pcm,
+						snd_pcm_uframes_t offset,
+						snd_pcm_uframes_t size)
+{
+	snd_pcm_shm_t *shm = pcm->private_data;
+	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	struct iovec iov[2];
+	int count = 1;
+
+	ctrl->cmd = SND_PCM_IOCTL_MMAP_COMMIT;
+	ctrl->u.mmap_commit.offset = offset;
+	ctrl->u.mmap_commit.frames = size;
+	ctrl->data_frames = 0;
+	iov[0].iov_base = (void *)ctrl;
+	iov[0].iov_len = PCM_SHM_SIZE;
+	if (pcm->stream == SND_PCM_STREAM_PLAYBACK && size) {
+		iov[1].iov_len = snd_pcm_frames_to_bytes(pcm, size);
+		if (pcm->access == SND_PCM_ACCESS_MMAP_INTERLEAVED) {
+			/* the ring holds the frames as they go out */
+			iov[1].iov_base = (char *)pcm->running_areas[0].addr +
+				iov[1].iov_len / size * offset;
+		} else {
+			iov[1].iov_base = snd_pcm_shm_tcp_buf(shm, iov[1].iov_len);
+			if (!iov[1].iov_base)
+				return -ENOMEM;
+			snd_pcm_shm_tcp_copy(pcm, iov[1].iov_base, offset, size, 0);
+		}
+		ctrl->data_frames = size;
+		count++;
+	}
+	if (snd_pcm_shm_tcp_send(shm->socket, iov, count) < 0)
+		return -EBADFD;
+	ctrl->cmd = 0;
+	snd_pcm_mmap_appl_forward(pcm, size);
+	return size;
+}
+
 static long snd_pcm_shm_action_fd0(snd_pcm_t *pcm, int *fd)
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
@@ -116,6 +287,8 @@ static long snd_pcm_shm_action(snd_pcm_t *pcm)
 	char buf[1];
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
 
+	if (shm->tcp)
+		return snd_pcm_shm_tcp_action(pcm);
 	if (ctrl->hw.changed || ctrl->appl.changed)
 		return -EBADFD;
 	err = write(shm->socket, buf, 1);
@@ -178,6 +351,22 @@ static long snd_pcm_shm_action_fd(snd_pcm_t *pcm, int *fd)
 	return ctrl->result;
 }
 
+/*
+ * The state of a direct server PCM, read from the kernel status page the
+ * hw_ptr is mapped from; -1 while the pointers are not mapped yet.
+ */
+static int snd_pcm_shm_direct_state(snd_pcm_t *pcm)
+{
+	snd_pcm_shm_t *shm = pcm->private_data;
+	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+
+	if (!ctrl->direct || ctrl->hw.changed || ctrl->appl.changed ||
+	    pcm->hw.fd < 0 || pcm->appl.fd < 0)
+		return -1;
+	return *(volatile snd_pcm_state_t *)((char *)pcm->hw.ptr -
+		offsetof(struct snd_pcm_mmap_status, hw_ptr));
+}
+
 static int snd_pcm_shm_nonblock(snd_pcm_t *pcm ATTRIBUTE_UNUSED, int nonblock ATTRIBUTE_UNUSED)
 {
 	return 0;
@@ -187,6 +376,8 @@ static int snd_pcm_shm_async(snd_pcm_t *pcm, int sig, pid_t pid)
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	if (shm->tcp)
+		return -ENOSYS;
 	ctrl->cmd = SND_PCM_IOCTL_ASYNC;
 	ctrl->u.async.sig = sig;
 	ctrl->u.async.pid = pid;
@@ -327,8 +518,18 @@ static int snd_pcm_shm_sw_params(snd_pcm_t *pcm, snd_pcm_sw_params_t * params)
 	return err;
 }
 
-static int snd_pcm_shm_mmap(snd_pcm_t *pcm ATTRIBUTE_UNUSED)
+static int snd_pcm_shm_mmap(snd_pcm_t *pcm)
 {
+	snd_pcm_shm_t *shm = pcm->private_data;
+	int size;
+
+	if (!shm->tcp || !shm->depth)
+		return 0;
+	size = snd_pcm_frames_to_bytes(pcm, pcm->period_size) * shm->depth;
+	if (setsockopt(shm->socket, SOL_SOCKET,
+		       pcm->stream == SND_PCM_STREAM_PLAYBACK ? SO_SNDBUF : SO_RCVBUF,
+		       &size, sizeof(size)) < 0)
+		SYSMSG("cannot set the socket buffer size");
 	return 0;
 }
 
@@ -366,6 +567,9 @@ static int snd_pcm_shm_channel_info(snd_pcm_t *pcm, snd_pcm_channel_info_t * inf
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
 	int err;
 	int fd;
+	/* the client keeps its own ring, the frames are copied over */
+	if (shm->tcp)
+		return snd_pcm_channel_info_shm(pcm, info, -1);
 	ctrl->cmd = SNDRV_PCM_IOCTL_CHANNEL_INFO;
 	ctrl->u.channel_info = *info;
 	err = snd_pcm_shm_action_fd(pcm, &fd);
@@ -404,6 +608,10 @@ static snd_pcm_state_t snd_pcm_shm_state(snd_pcm_t *pcm)
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	int state = snd_pcm_shm_direct_state(pcm);
+
+	if (state >= 0)
+		return state;
 	ctrl->cmd = SND_PCM_IOCTL_STATE;
 	return snd_pcm_shm_action(pcm);
 }
@@ -433,7 +641,15 @@ static snd_pcm_sframes_t snd_pcm_shm_avail_update(snd_pcm_t *pcm)
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+	snd_pcm_uframes_t avail;
 	int err;
+
+	/* an xrun still to be flagged goes to the server */
+	if (snd_pcm_shm_direct_state(pcm) == SND_PCM_STATE_RUNNING) {
+		avail = snd_pcm_mmap_avail(pcm);
+		if (avail < pcm->stop_threshold)
+			return avail;
+	}
 	ctrl->cmd = SND_PCM_IOCTL_AVAIL_UPDATE;
 	err = snd_pcm_shm_action(pcm);
 	if (err < 0)
@@ -550,6 +766,13 @@ static snd_pcm_sframes_t snd_pcm_shm_mmap_commit(snd_pcm_t *pcm,
 {
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
+
+	if (shm->tcp)
+		return snd_pcm_shm_tcp_commit(pcm, offset, size);
+	if (snd_pcm_shm_direct_state(pcm) >= 0) {
+		snd_pcm_mmap_appl_forward(pcm, size);
+		return size;
+	}
 	ctrl->cmd = SND_PCM_IOCTL_MMAP_COMMIT;
 	ctrl->u.mmap_commit.offset = offset;
 	ctrl->u.mmap_commit.frames = size;
@@ -573,6 +796,15 @@ static int snd_pcm_shm_close(snd_pcm_t *pcm)
 	snd_pcm_shm_t *shm = pcm->private_data;
 	volatile snd_pcm_shm_ctrl_t *ctrl = shm->ctrl;
 	int result;
+	if (shm->tcp) {
+		/* the server closes its PCM on the hangup */
+		close(shm->socket);
+		close(shm->poll_socket);
+		free((void *)ctrl);
+		free(shm->buf);
+		free(shm);
+		return 0;
+	}
 	ctrl->cmd = SND_PCM_IOCTL_CLOSE;
 	result = snd_pcm_shm_action(pcm);
 	shmdt((void *)ctrl);
@@ -582,6 +814,27 @@ static int snd_pcm_shm_close(snd_pcm_t *pcm)
 	return result;
 }
 
+static int snd_pcm_shm_poll_revents(snd_pcm_t *pcm, struct pollfd *pfds,
+				    unsigned int nfds, unsigned short *revents)
+{
+	snd_pcm_shm_t *shm = pcm->private_data;
+	char buf[16];
+	ssize_t n;
+
+	if (nfds != 1)
+		return -EINVAL;
+	*revents = pfds->revents;
+	if (!shm->tcp || !(pfds->revents & POLLIN))
+		return 0;
+	while ((n = recv(shm->poll_socket, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+		;
+	*revents &= ~POLLIN;
+	*revents |= pcm->stream == SND_PCM_STREAM_PLAYBACK ? POLLOUT : POLLIN;
+	if (n == 0)
+		*revents |= POLLERR;
+	return 0;
+}
+
 static void snd_pcm_shm_dump(snd_pcm_t *pcm, snd_output_t *out)
 {
 	snd_output_printf(out, "Shm PCM\n");
@@ -629,6 +882,7 @@ static const snd_pcm_fast_ops_t snd_pcm_shm_fast_ops = {
 	.avail_update = snd_pcm_shm_avail_update,
 	.mmap_commit = snd_pcm_shm_mmap_commit,
 	.htimestamp = snd_pcm_shm_htimestamp,
+	.poll_revents = snd_pcm_shm_poll_revents,
 };
 
 static int make_local_socket(const char *filename)
@@ -654,6 +908,150 @@ static int make_local_socket(const char *filename)
 	return sock;
 }
 
+/* ask the server to open the PCM on its side */
+static int snd_pcm_shm_request(int sock, const char *sname, int transport_type,
+			       snd_pcm_stream_t stream, int mode,
+			       snd_client_open_answer_t *ans)
+{
+	snd_client_open_request_t *req;
+	size_t snamelen = strlen(sname), reqlen;
+	int err;
+
+	reqlen = sizeof(*req) + snamelen;
+	req = alloca(reqlen);
+	memcpy(req->name, sname, snamelen);
+	req->dev_type = SND_DEV_TYPE_PCM;
+	req->transport_type = transport_type;
+	req->stream = stream;
+	req->mode = mode;
+	req->namelen = snamelen;
+	err = write(sock, req, reqlen);
+	if (err < 0) {
+		SYSERR("write error");
+		return -errno;
+	}
+	if ((size_t) err != reqlen) {
+		SNDERR("write size error");
+		return -EINVAL;
+	}
+	err = snd_pcm_shm_tcp_recv(sock, ans, sizeof(*ans));
+	if (err < 0) {
+		SNDERR("read error");
+		return -EINVAL;
+	}
+	return ans->result;
+}
+
+/*
+ * connect to the inet port of the server; it pairs the two sockets of a
+ * client, the first for the poll wakeups, by the cookie they send
+ */
+static int make_inet_socket(const char *host, long port, uint32_t cookie)
+{
+	struct addrinfo hints, *res, *ai;
+	char service[16];
+	uint32_t echo;
+	int sock = -1, one = 1, err;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_socktype = SOCK_STREAM;
+	snprintf(service, sizeof(service), "%ld", port);
+	err = getaddrinfo(host, service, &hints, &res);
+	if (err) {
+		SNDERR("cannot resolve %s: %s", host, gai_strerror(err));
+		return -ENOENT;
+	}
+	err = -ECONNREFUSED;
+	for (ai = res; ai; ai = ai->ai_next) {
+		sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (sock < 0)
+			continue;
+		if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0)
+			break;
+		err = -errno;
+		close(sock);
+		sock = -1;
+	}
+	freeaddrinfo(res);
+	if (sock < 0) {
+		SNDERR("connect to %s:%ld failed", host, port);
+		return err;
+	}
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	if (write(sock, &cookie, sizeof(cookie)) != sizeof(cookie) ||
+	    snd_pcm_shm_tcp_recv(sock, &echo, sizeof(echo)) < 0 ||
+	    echo != cookie) {
+		close(sock);
+		return -EBADFD;
+	}
+	return sock;
+}
+
+static int snd_pcm_shm_tcp_open(snd_pcm_t **pcmp, const char *name,
+				const char *host, long port, unsigned int depth,
+				const char *sname, snd_pcm_stream_t stream, int mode)
+{
+	snd_pcm_t *pcm;
+	snd_pcm_shm_t *shm;
+	snd_client_open_answer_t ans;
+	uint32_t cookie;
+	int err;
+
+	if (strlen(sname) > 255)
+		return -EINVAL;
+	shm = calloc(1, sizeof(snd_pcm_shm_t));
+	if (!shm)
+		return -ENOMEM;
+	shm->ctrl = calloc(1, PCM_SHM_SIZE);
+	if (!shm->ctrl) {
+		free(shm);
+		return -ENOMEM;
+	}
+	shm->tcp = 1;
+	shm->depth = depth;
+	shm->socket = shm->poll_socket = -1;
+	cookie = ((uint32_t)getpid() << 16) ^ (uint32_t)time(NULL) ^
+		 (uint32_t)(uintptr_t)shm;
+	if (!cookie)
+		cookie = 1;
+
+	err = make_inet_socket(host, port, cookie);
+	if (err < 0)
+		goto _err;
+	shm->poll_socket = err;
+	err = make_inet_socket(host, port, cookie);
+	if (err < 0)
+		goto _err;
+	shm->socket = err;
+	err = snd_pcm_shm_request(shm->socket, sname, SND_TRANSPORT_TYPE_TCP,
+				  stream, mode, &ans);
+	if (err < 0)
+		goto _err;
+
+	err = snd_pcm_new(&pcm, SND_PCM_TYPE_SHM, name, stream, mode);
+	if (err < 0)
+		goto _err;
+	pcm->mmap_rw = 1;
+	pcm->ops = &snd_pcm_shm_ops;
+	pcm->fast_ops = &snd_pcm_shm_fast_ops;
+	pcm->private_data = shm;
+	pcm->poll_fd = shm->poll_socket;
+	pcm->poll_events = POLLIN;
+	snd_pcm_set_hw_ptr(pcm, (snd_pcm_uframes_t *)&shm->ctrl->hw.ptr, -1, 0);
+	snd_pcm_set_appl_ptr(pcm, (snd_pcm_uframes_t *)&shm->ctrl->appl.ptr, -1, 0);
+	*pcmp = pcm;
+	return 0;
+
+ _err:
+	if (shm->socket >= 0)
+		close(shm->socket);
+	if (shm->poll_socket >= 0)
+		close(shm->poll_socket);
+	free((void *)shm->ctrl);
+	free(shm);
+	return err;
+}
+
 /**
  * \brief Creates a new shared memory PCM
  * \param pcmp Returns created PCM handle
@@ -673,15 +1071,12 @@ int snd_pcm_shm_open(snd_pcm_t **pcmp, const char *name,
 {
 	snd_pcm_t *pcm;
 	snd_pcm_shm_t *shm = NULL;
-	snd_client_open_request_t *req;
 	snd_client_open_answer_t ans;
-	size_t snamelen, reqlen;
 	int err;
 	int result;
 	snd_pcm_shm_ctrl_t *ctrl = NULL;
 	int sock = -1;
-	snamelen = strlen(sname);
-	if (snamelen > 255)
+	if (strlen(sname) > 255)
 		return -EINVAL;
 
 	result = make_local_socket(sockname);
@@ -691,37 +1086,8 @@ int snd_pcm_shm_open(snd_pcm_t **pcmp, const char *name,
 	}
 	sock = result;
 
-	reqlen = sizeof(*req) + snamelen;
-	req = alloca(reqlen);
-	memcpy(req->name, sname, snamelen);
-	req->dev_type = SND_DEV_TYPE_PCM;
-	req->transport_type = SND_TRANSPORT_TYPE_SHM;
-	req->stream = stream;
-	req->mode = mode;
-	req->namelen = snamelen;
-	err = write(sock, req, reqlen);
-	if (err < 0) {
-		SYSERR("write error");
-		result = -errno;
-		goto _err;
-	}
-	if ((size_t) err != reqlen) {
-		SNDERR("write size error");
-		result = -EINVAL;
-		goto _err;
-	}
-	err = read(sock, &ans, sizeof(ans));
-	if (err < 0) {
-		SYSERR("read error");
-		result = -errno;
-		goto _err;
-	}
-	if (err != sizeof(ans)) {
-		SNDERR("read size error");
-		result = -EINVAL;
-		goto _err;
-	}
-	result = ans.result;
+	result = snd_pcm_shm_request(sock, sname, SND_TRANSPORT_TYPE_SHM,
+				     stream, mode, &ans);
 	if (result < 0)
 		goto _err;
 
@@ -778,11 +1144,18 @@ This plugin communicates with aserver via shared memory. It is a raw
 communication without any conversions, but it can be expected worse
 performance.
 
+When the server definition has no socket but a host and a port, the
+PCM is reached over TCP instead.  The frames are then copied through
+the connection in the batches the application commits, usually a
+period, and the client keeps its own ring buffer.  Both hosts must
+share the architecture.
+
 \code
 pcm.name {
         type shm                # Shared memory PCM
 	server STR		# Server name
 	pcm STR			# PCM name
+	[depth INT]		# TCP: periods the socket buffer holds
 }
 \endcode
 
@@ -816,7 +1189,9 @@ int _snd_pcm_shm_open(snd_pcm_t **pcmp, const char *name,
 	const char *pcm_name = NULL;
 	snd_config_t *sconfig;
 	const char *sockname = NULL;
+	const char *host = NULL;
 	long port = -1;
+	long depth = 0;
 	int err;
 
 	snd_config_for_each(i, next, conf) {
@@ -842,6 +1217,14 @@ int _snd_pcm_shm_open(snd_pcm_t **pcmp, const char *name,
 			}
 			continue;
 		}
+		if (strcmp(id, "depth") == 0) {
+			err = snd_config_get_integer(n, &depth);
+			if (err < 0 || depth < 0) {
+				SNDERR("Invalid value for %s", id);
+				return -EINVAL;
+			}
+			continue;
+		}
 		SNDERR("Unknown field %s", id);
 		return -EINVAL;
 	}
@@ -869,8 +1252,14 @@ int _snd_pcm_shm_open(snd_pcm_t **pcmp, const char *name,
 			continue;
 		if (strcmp(id, "comment") == 0)
 			continue;
-		if (strcmp(id, "host") == 0)
+		if (strcmp(id, "host") == 0) {
+			err = snd_config_get_string(n, &host);
+			if (err < 0) {
+				SNDERR("Invalid type for %s", id);
+				goto _err;
+			}
 			continue;
+		}
 		if (strcmp(id, "socket") == 0) {
 			err = snd_config_get_string(n, &sockname);
 			if (err < 0) {
@@ -893,6 +1282,11 @@ int _snd_pcm_shm_open(snd_pcm_t **pcmp, const char *name,
 		goto __error;
 	}
 
+	if (!sockname && host && port >= 0) {
+		err = snd_pcm_shm_tcp_open(pcmp, name, host, port, depth,
+					   pcm_name, stream, mode);
+		goto __error;
+	}
 	if (!sockname) {
 		SNDERR("socket is not defined");
 		goto _err;
@@ -30,6 +30,11 @@
 #include <math.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
+#include "pcm_special.h"
+#ifdef THREAD_SAFE_API
+#include <signal.h>
+#define SOFTVOL_HAVE_EVENTS
+#endif
 
 #ifndef PIC
 /* entry for static linking */
@@ -38,19 +43,51 @@ const char *_snd_module_pcm_softvol = "";
 
 #ifndef DOC_HIDDEN
 
+/*
+ * CTL handles are shared by all softvol instances of a card in the
+ * process.  A thread per card reads the control events and bumps the
+ * volume generation of the watching instances, so the volume is read
+ * only after it has changed.
+ */
+struct softvol_card {
+	int card;
+	snd_ctl_t *ctl;
+	unsigned int refs;
+	struct list_head list;
+	struct list_head users;		/* watching instances */
+#ifdef SOFTVOL_HAVE_EVENTS
+	snd_ctl_t *ev_ctl;
+	int quit_fd[2];
+	pthread_t thread;
+	int thread_running;
+#endif
+};
+
 typedef struct {
 	/* This field need to be the first */
 	snd_pcm_plugin_t plug;
 	snd_pcm_format_t sformat;
 	unsigned int cchannels;
+	struct softvol_card *card;
 	snd_ctl_t *ctl;
 	snd_ctl_elem_value_t elem;
+	struct list_head watch;		/* in card->users */
+	int watched;			/* volume changes come as events */
+	unsigned int vol_gen;		/* bumped on each change event */
+	unsigned int vol_seen;
 	unsigned int cur_vol[2];
 	unsigned int max_val;     /* max index */
 	unsigned int zero_dB_val; /* index at 0 dB */
 	double min_dB;
 	double max_dB;
 	unsigned int *dB_value;
+	unsigned int ramp_frames;	/* length of the gain ramp, 0 = none */
+	unsigned int ramp_pos;
+	int ramp_valid;
+	unsigned int ramp_from[3];	/* left, right, center */
+	unsigned int ramp_to[3];
+	void (*special)(void *dst, const void *src, snd_pcm_uframes_t frames,
+			const unsigned int *scales);
 } snd_pcm_softvol_t;
 
 #define VOL_SCALE_SHIFT		16
@@ -168,12 +205,117 @@ static inline short MULTI_DIV_short(short a, unsigned int b, int swap)
 	return swap ? (short)bswap_16((short)fraction) : (short)fraction;
 }
 
+static inline float MULTI_DIV_float(float a, unsigned int b, int swap)
+{
+	snd_tmp_float_t v;
+	v.f = a;
+	if (swap)
+		v.i = bswap_32(v.i);
+	v.f *= (float)b / (float)(1 << VOL_SCALE_SHIFT);
+	if (swap)
+		v.i = bswap_32(v.i);
+	return v.f;
+}
+
+/*
+ * native endian kernels
+ *
+ * The same arithmetic as MULTI_DIV_*() written as plain loops, so that
+ * the compiler can vectorize them.  (a * b) >> 16 is exactly what
+ * the split 32x16 multiplication above computes.
+ */
+#define SOFTVOL_KERNEL(TYPE, ATT, BOOST) \
+static void softvol_kernel_##TYPE(TYPE *dst, unsigned int dst_step, \
+				  const TYPE *src, unsigned int src_step, \
+				  snd_pcm_uframes_t frames, \
+				  unsigned int vol_scale) \
+{ \
+	snd_pcm_uframes_t i; \
+	if (dst_step == 1 && src_step == 1) { \
+		if (vol_scale <= VOL_SCALE_MASK) { \
+			for (i = 0; i < frames; i++) \
+				dst[i] = ATT(src[i], vol_scale); \
+		} else { \
+			for (i = 0; i < frames; i++) \
+				dst[i] = BOOST(src[i], vol_scale); \
+		} \
+		return; \
+	} \
+	for (i = 0; i < frames; i++) { \
+		*dst = BOOST(*src, vol_scale); \
+		src += src_step; \
+		dst += dst_step; \
+	} \
+}
+
+#define ATT_short(a, b)		((short)(((int)(a) * (int)(b)) >> VOL_SCALE_SHIFT))
+#define BOOST_short(a, b)	clip_short(((long long)(a) * (b)) >> VOL_SCALE_SHIFT)
+#define ATT_int(a, b)		((int)(((long long)(a) * (b)) >> VOL_SCALE_SHIFT))
+#define BOOST_int(a, b)		clip_int(((long long)(a) * (b)) >> VOL_SCALE_SHIFT)
+#define ATT_float(a, b)		((a) * ((float)(b) / (float)(1 << VOL_SCALE_SHIFT)))
+#define BOOST_float(a, b)	ATT_float(a, b)
+
+static inline short clip_short(long long v)
+{
+	return v > 0x7fff ? 0x7fff : v < -0x8000 ? -0x8000 : v;
+}
+
+static inline int clip_int(long long v)
+{
+	return v > (int)0x7fffffff ? (int)0x7fffffff :
+	       v < (int)0x80000000 ? (int)0x80000000 : v;
+}
+
+SOFTVOL_KERNEL(short, ATT_short, BOOST_short)
+SOFTVOL_KERNEL(int, ATT_int, BOOST_int)
+SOFTVOL_KERNEL(float, ATT_float, BOOST_float)
+
+/*
+ * kernels for the interleaved layouts of SND_PCM_SPECIALIZE with a
+ * scale per channel, e.g. a stereo control with different left and
+ * right volumes.  0 dB is a multiplication by 1 << VOL_SCALE_SHIFT, so
+ * all channels run the same clipped multiplication, which gives the
+ * same result as the separate attenuation, boost and copy paths.
+ */
+#define SOFTVOL_SPECIAL(fmt, CH, TYPE) \
+static void softvol_special_##fmt##_##CH(void *dstp, const void *srcp, \
+					 snd_pcm_uframes_t frames, \
+					 const unsigned int *scales) \
+{ \
+	TYPE *dst = dstp; \
+	const TYPE *src = srcp; \
+	unsigned int scale[CH], ch; \
+	snd_pcm_uframes_t i; \
+	for (ch = 0; ch < CH; ch++) \
+		scale[ch] = scales[ch] == 0xffff ? 1 << VOL_SCALE_SHIFT : \
+			    scales[ch]; \
+	for (i = 0; i < frames; i++, src += CH, dst += CH) \
+		for (ch = 0; ch < CH; ch++) \
+			dst[ch] = BOOST_##TYPE(src[ch], scale[ch]); \
+}
+
+#define SND_PCM_SPECIAL(fmt, ch) \
+	SND_PCM_SPECIAL_EXPAND(SOFTVOL_SPECIAL, fmt, ch)
+SND_PCM_SPECIALIZE
+#undef SND_PCM_SPECIAL
+
+static const struct softvol_special {
+	snd_pcm_format_t format;
+	unsigned int channels;
+	void (*func)(void *dst, const void *src, snd_pcm_uframes_t frames,
+		     const unsigned int *scales);
+} softvol_specials[] = {
+#define SND_PCM_SPECIAL(fmt, ch) \
+	{ SND_PCM_FORMAT_##fmt, ch, softvol_special_##fmt##_##ch },
+	SND_PCM_SPECIALIZE
+#undef SND_PCM_SPECIAL
+	{ SND_PCM_FORMAT_UNKNOWN, 0, NULL }
+};
+
 #endif /* DOC_HIDDEN */
 
 /*
  * apply volumue attenuation
- *
- * TODO: use SIMD operations
  */
 
 #ifndef DOC_HIDDEN
@@ -200,6 +342,9 @@ static inline short MULTI_DIV_short(short a, unsigned int b, int swap)
 				src += src_step; \
 				dst += dst_step; \
 			} \
+		} else if (!swap) { \
+			softvol_kernel_##TYPE(dst, dst_step, src, src_step, \
+					      fr, vol_scale); \
 		} else { \
 			while (fr--) { \
 				*dst = (TYPE) MULTI_DIV_##TYPE(*src, vol_scale, swap); \
@@ -210,6 +355,54 @@ static inline short MULTI_DIV_short(short a, unsigned int b, int swap)
 	} \
 } while (0)
 
+/* apply a linear gain ramp, the scale is computed for each frame */
+#define CONVERT_AREA_RAMP(TYPE, swap) do {	\
+	unsigned int ch, fr; \
+	TYPE *src, *dst; \
+	for (ch = 0; ch < channels; ch++) { \
+		src_area = &src_areas[ch]; \
+		dst_area = &dst_areas[ch]; \
+		src = snd_pcm_channel_area_addr(src_area, src_offset); \
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset); \
+		src_step = snd_pcm_channel_area_step(src_area) / sizeof(TYPE); \
+		dst_step = snd_pcm_channel_area_step(dst_area) / sizeof(TYPE); \
+		GET_VOL_IDX; \
+		for (fr = 0; fr < frames; fr++) { \
+			vol_scale = RAMP_VOL_SCALE(fr); \
+			*dst = (TYPE) MULTI_DIV_##TYPE(*src, vol_scale, swap); \
+			src += src_step; \
+			dst += dst_step; \
+		} \
+	} \
+} while (0)
+
+#define CONVERT_AREA_RAMP_S24_3LE() do {				\
+	unsigned int ch, fr;						\
+	unsigned char *src, *dst;					\
+	int tmp;							\
+	for (ch = 0; ch < channels; ch++) {				\
+		src_area = &src_areas[ch];				\
+		dst_area = &dst_areas[ch];				\
+		src = snd_pcm_channel_area_addr(src_area, src_offset);	\
+		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);	\
+		src_step = snd_pcm_channel_area_step(src_area);		\
+		dst_step = snd_pcm_channel_area_step(dst_area);		\
+		GET_VOL_IDX;						\
+		for (fr = 0; fr < frames; fr++) {			\
+			vol_scale = RAMP_VOL_SCALE(fr);			\
+			tmp = src[0] |					\
+			      (src[1] << 8) |				\
+			      (((signed char *) src)[2] << 16);		\
+			tmp = MULTI_DIV_24(tmp, vol_scale);		\
+			dst[0] = tmp;					\
+			dst[1] = tmp >> 8;				\
+			dst[2] = tmp >> 16;				\
+			src += src_step;				\
+			dst += dst_step;				\
+		}							\
+	}								\
+} while (0)
+
 #define CONVERT_AREA_S24_3LE() do {					\
 	unsigned int ch, fr;						\
 	unsigned char *src, *dst;					\
@@ -267,8 +460,106 @@ static inline short MULTI_DIV_short(short a, unsigned int b, int swap)
 		break; \
 	}
 
+/* index to ramp_from/ramp_to, following GET_VOL_SCALE */
+#define GET_VOL_IDX \
+	if (svol->cchannels == 1) \
+		idx = 0; \
+	else if (ch == 0 || ch == 2) \
+		idx = (channels == ch + 1) ? 2 : 0; \
+	else if (ch == 4 || ch == 5) \
+		idx = 2; \
+	else \
+		idx = ch & 1
+
+#define RAMP_VOL_SCALE(fr) \
+	softvol_ramp_scale(svol, idx, svol->ramp_pos + (fr) + 1)
+
 #endif /* DOC_HIDDEN */
 
+/* volume scale at the given position of the gain ramp */
+static inline unsigned int softvol_ramp_scale(snd_pcm_softvol_t *svol,
+					      unsigned int idx,
+					      unsigned int pos)
+{
+	long long delta = (long long)svol->ramp_to[idx] - svol->ramp_from[idx];
+	return svol->ramp_from[idx] + delta * pos / svol->ramp_frames;
+}
+
+/*
+ * convert interleaved native endian buffers with a single volume over
+ * all channels in one run; returns 0 if the layout doesn't allow it
+ */
+static int softvol_convert_interleaved(snd_pcm_softvol_t *svol,
+				       const snd_pcm_channel_area_t *dst_areas,
+				       snd_pcm_uframes_t dst_offset,
+				       const snd_pcm_channel_area_t *src_areas,
+				       snd_pcm_uframes_t src_offset,
+				       unsigned int channels,
+				       snd_pcm_uframes_t frames,
+				       unsigned int vol_scale)
+{
+	unsigned int width = __snd_pcm_format_physical_width(svol->sformat);
+	snd_pcm_uframes_t samples = frames * channels;
+	void *dst;
+	const void *src;
+
+	if (!vol_scale || vol_scale == 0xffff ||
+	    svol->sformat == SND_PCM_FORMAT_S24_3LE ||
+	    !snd_pcm_format_cpu_endian(svol->sformat) ||
+	    !snd_pcm_areas_interleaved(src_areas, channels, width) ||
+	    !snd_pcm_areas_interleaved(dst_areas, channels, width))
+		return 0;
+	src = snd_pcm_channel_area_addr(src_areas, src_offset);
+	dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+	switch (svol->sformat) {
+	case SND_PCM_FORMAT_S16_LE:
+	case SND_PCM_FORMAT_S16_BE:
+		softvol_kernel_short(dst, 1, src, 1, samples, vol_scale);
+		break;
+	case SND_PCM_FORMAT_S32_LE:
+	case SND_PCM_FORMAT_S32_BE:
+		softvol_kernel_int(dst, 1, src, 1, samples, vol_scale);
+		break;
+	case SND_PCM_FORMAT_FLOAT_LE:
+		softvol_kernel_float(dst, 1, src, 1, samples, vol_scale);
+		break;
+	default:
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * convert with the specialized kernel of the setup; vol and vol_c are
+ * the scales of GET_VOL_SCALE.  Returns 0 if the layout doesn't allow it
+ */
+static int softvol_convert_special(snd_pcm_softvol_t *svol,
+				   const snd_pcm_channel_area_t *dst_areas,
+				   snd_pcm_uframes_t dst_offset,
+				   const snd_pcm_channel_area_t *src_areas,
+				   snd_pcm_uframes_t src_offset,
+				   unsigned int channels,
+				   snd_pcm_uframes_t frames,
+				   const unsigned int *vol, unsigned int vol_c)
+{
+	unsigned int width = __snd_pcm_format_physical_width(svol->sformat);
+	unsigned int scales[channels];
+	unsigned int ch, vol_scale;
+
+	if (!svol->special ||
+	    !snd_pcm_areas_interleaved(src_areas, channels, width) ||
+	    !snd_pcm_areas_interleaved(dst_areas, channels, width))
+		return 0;
+	for (ch = 0; ch < channels; ch++) {
+		GET_VOL_SCALE;
+		scales[ch] = vol_scale;
+	}
+	svol->special(snd_pcm_channel_area_addr(dst_areas, dst_offset),
+		      snd_pcm_channel_area_addr(src_areas, src_offset),
+		      frames, scales);
+	return 1;
+}
+
 /* 2-channel stereo control */
 static void softvol_convert_stereo_vol(snd_pcm_softvol_t *svol,
 				       const snd_pcm_channel_area_t *dst_areas,
@@ -302,6 +593,15 @@ static void softvol_convert_stereo_vol(snd_pcm_softvol_t *svol,
 		vol[1] = svol->dB_value[svol->cur_vol[1]];
 		vol_c = svol->dB_value[(svol->cur_vol[0] + svol->cur_vol[1]) / 2];
 	}
+	if ((channels == 1 || (vol[0] == vol[1] && vol[0] == vol_c)) &&
+	    softvol_convert_interleaved(svol, dst_areas, dst_offset,
+					src_areas, src_offset, channels, frames,
+					channels == 1 ? vol_c : vol[0]))
+		return;
+	if (softvol_convert_special(svol, dst_areas, dst_offset,
+				    src_areas, src_offset, channels, frames,
+				    vol, vol_c))
+		return;
 	switch (svol->sformat) {
 	case SND_PCM_FORMAT_S16_LE:
 	case SND_PCM_FORMAT_S16_BE:
@@ -315,6 +615,10 @@ static void softvol_convert_stereo_vol(snd_pcm_softvol_t *svol,
 		CONVERT_AREA(int,
 			     !snd_pcm_format_cpu_endian(svol->sformat));
 		break;
+	case SND_PCM_FORMAT_FLOAT_LE:
+		CONVERT_AREA(float,
+			     !snd_pcm_format_cpu_endian(svol->sformat));
+		break;
 	case SND_PCM_FORMAT_S24_3LE:
 		CONVERT_AREA_S24_3LE();
 		break;
@@ -337,7 +641,7 @@ static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
 {
 	const snd_pcm_channel_area_t *dst_area, *src_area;
 	unsigned int src_step, dst_step;
-	unsigned int vol_scale;
+	unsigned int vol_scale, vol[2];
 
 	if (svol->cur_vol[0] == 0) {
 		snd_pcm_areas_silence(dst_areas, dst_offset, channels, frames,
@@ -353,6 +657,15 @@ static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
 		vol_scale = svol->cur_vol[0] ? 0xffff : 0;
 	else
 		vol_scale = svol->dB_value[svol->cur_vol[0]];
+	vol[0] = vol[1] = vol_scale;
+	if (softvol_convert_interleaved(svol, dst_areas, dst_offset,
+					src_areas, src_offset, channels, frames,
+					vol_scale))
+		return;
+	if (softvol_convert_special(svol, dst_areas, dst_offset,
+				    src_areas, src_offset, channels, frames,
+				    vol, vol_scale))
+		return;
 	switch (svol->sformat) {
 	case SND_PCM_FORMAT_S16_LE:
 	case SND_PCM_FORMAT_S16_BE:
@@ -366,6 +679,10 @@ static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
 		CONVERT_AREA(int,
 			     !snd_pcm_format_cpu_endian(svol->sformat));
 		break;
+	case SND_PCM_FORMAT_FLOAT_LE:
+		CONVERT_AREA(float,
+			     !snd_pcm_format_cpu_endian(svol->sformat));
+		break;
 	case SND_PCM_FORMAT_S24_3LE:
 		CONVERT_AREA_S24_3LE();
 		break;
@@ -374,16 +691,310 @@ static void softvol_convert_mono_vol(snd_pcm_softvol_t *svol,
 	}
 }
 
+/* scales for the left, right and center channels */
+static void softvol_get_scales(snd_pcm_softvol_t *svol, unsigned int *scales)
+{
+	unsigned int l = svol->cur_vol[0];
+	unsigned int r = svol->cchannels == 1 ? l : svol->cur_vol[1];
+
+	if (svol->max_val == 1) {
+		scales[0] = l ? 0xffff : 0;
+		scales[1] = r ? 0xffff : 0;
+		scales[2] = scales[0] | scales[1];
+	} else {
+		scales[0] = svol->dB_value[l];
+		scales[1] = svol->dB_value[r];
+		scales[2] = svol->dB_value[(l + r) / 2];
+	}
+}
+
+/* apply the running gain ramp */
+static void softvol_convert_ramp(snd_pcm_softvol_t *svol,
+				 const snd_pcm_channel_area_t *dst_areas,
+				 snd_pcm_uframes_t dst_offset,
+				 const snd_pcm_channel_area_t *src_areas,
+				 snd_pcm_uframes_t src_offset,
+				 unsigned int channels,
+				 snd_pcm_uframes_t frames)
+{
+	const snd_pcm_channel_area_t *dst_area, *src_area;
+	unsigned int src_step, dst_step;
+	unsigned int vol_scale, idx;
+
+	switch (svol->sformat) {
+	case SND_PCM_FORMAT_S16_LE:
+	case SND_PCM_FORMAT_S16_BE:
+		CONVERT_AREA_RAMP(short,
+				  !snd_pcm_format_cpu_endian(svol->sformat));
+		break;
+	case SND_PCM_FORMAT_S32_LE:
+	case SND_PCM_FORMAT_S32_BE:
+		CONVERT_AREA_RAMP(int,
+				  !snd_pcm_format_cpu_endian(svol->sformat));
+		break;
+	case SND_PCM_FORMAT_FLOAT_LE:
+		CONVERT_AREA_RAMP(float,
+				  !snd_pcm_format_cpu_endian(svol->sformat));
+		break;
+	case SND_PCM_FORMAT_S24_3LE:
+		CONVERT_AREA_RAMP_S24_3LE();
+		break;
+	default:
+		break;
+	}
+}
+
+static void softvol_convert(snd_pcm_softvol_t *svol,
+			    const snd_pcm_channel_area_t *dst_areas,
+			    snd_pcm_uframes_t dst_offset,
+			    const snd_pcm_channel_area_t *src_areas,
+			    snd_pcm_uframes_t src_offset,
+			    unsigned int channels,
+			    snd_pcm_uframes_t frames)
+{
+	if (svol->ramp_frames) {
+		unsigned int scales[3];
+		softvol_get_scales(svol, scales);
+		if (!svol->ramp_valid) {
+			/* no ramp for the initial volume */
+			memcpy(svol->ramp_to, scales, sizeof(scales));
+			svol->ramp_pos = svol->ramp_frames;
+			svol->ramp_valid = 1;
+		} else if (memcmp(svol->ramp_to, scales, sizeof(scales))) {
+			/* start from the current position of a running ramp */
+			unsigned int idx;
+			for (idx = 0; idx < 3; idx++)
+				svol->ramp_from[idx] =
+					softvol_ramp_scale(svol, idx, svol->ramp_pos);
+			memcpy(svol->ramp_to, scales, sizeof(scales));
+			svol->ramp_pos = 0;
+		}
+		if (svol->ramp_pos < svol->ramp_frames) {
+			snd_pcm_uframes_t n = svol->ramp_frames - svol->ramp_pos;
+			if (n > frames)
+				n = frames;
+			softvol_convert_ramp(svol, dst_areas, dst_offset,
+					     src_areas, src_offset,
+					     channels, n);
+			svol->ramp_pos += n;
+			dst_offset += n;
+			src_offset += n;
+			frames -= n;
+			if (!frames)
+				return;
+		}
+	}
+	if (svol->cchannels == 1)
+		softvol_convert_mono_vol(svol, dst_areas, dst_offset,
+					 src_areas, src_offset, channels, frames);
+	else
+		softvol_convert_stereo_vol(svol, dst_areas, dst_offset,
+					   src_areas, src_offset, channels, frames);
+}
+
+static LIST_HEAD(softvol_cards);
+
+#ifdef THREAD_SAFE_API
+static pthread_mutex_t softvol_cards_mutex = PTHREAD_MUTEX_INITIALIZER;
+static inline void softvol_cards_lock(void)
+{
+	pthread_mutex_lock(&softvol_cards_mutex);
+}
+static inline void softvol_cards_unlock(void)
+{
+	pthread_mutex_unlock(&softvol_cards_mutex);
+}
+#else
+static inline void softvol_cards_lock(void) {}
+static inline void softvol_cards_unlock(void) {}
+#endif
+
+static int softvol_card_get(int card, struct softvol_card **cardp)
+{
+	struct list_head *pos;
+	struct softvol_card *c;
+	char name[16];
+	int err;
+
+	softvol_cards_lock();
+	list_for_each(pos, &softvol_cards) {
+		c = list_entry(pos, struct softvol_card, list);
+		if (c->card == card) {
+			c->refs++;
+			*cardp = c;
+			softvol_cards_unlock();
+			return 0;
+		}
+	}
+	c = calloc(1, sizeof(*c));
+	if (!c) {
+		softvol_cards_unlock();
+		return -ENOMEM;
+	}
+	sprintf(name, "hw:%d", card);
+	err = snd_ctl_open(&c->ctl, name, 0);
+	if (err < 0) {
+		SNDERR("Cannot open CTL %s", name);
+		free(c);
+		softvol_cards_unlock();
+		return err;
+	}
+	c->card = card;
+	c->refs = 1;
+	INIT_LIST_HEAD(&c->users);
+	list_add_tail(&c->list, &softvol_cards);
+	*cardp = c;
+	softvol_cards_unlock();
+	return 0;
+}
+
+#ifdef SOFTVOL_HAVE_EVENTS
+static int softvol_same_id(const snd_ctl_elem_id_t *a,
+			   const snd_ctl_elem_id_t *b)
+{
+	return a->iface == b->iface && a->device == b->device &&
+		a->subdevice == b->subdevice && a->index == b->index &&
+		!strcmp((const char *)a->name, (const char *)b->name);
+}
+
+static void *softvol_event_thread(void *arg)
+{
+	struct softvol_card *c = arg;
+	struct pollfd pfd[2];
+	snd_ctl_event_t ev;
+	struct list_head *pos;
+	sigset_t mask;
+
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+	pfd[0].fd = c->quit_fd[0];
+	pfd[0].events = POLLIN;
+	if (snd_ctl_poll_descriptors(c->ev_ctl, &pfd[1], 1) != 1)
+		return NULL;
+	for (;;) {
+		if (poll(pfd, 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (pfd[0].revents)
+			break;
+		while (snd_ctl_read(c->ev_ctl, &ev) > 0) {
+			if (ev.type != SND_CTL_EVENT_ELEM)
+				continue;
+			softvol_cards_lock();
+			list_for_each(pos, &c->users) {
+				snd_pcm_softvol_t *svol =
+					list_entry(pos, snd_pcm_softvol_t, watch);
+				if (softvol_same_id(&svol->elem.id, &ev.data.elem.id))
+					__atomic_add_fetch(&svol->vol_gen, 1,
+							   __ATOMIC_RELEASE);
+			}
+			softvol_cards_unlock();
+		}
+	}
+	return NULL;
+}
+
+/* called with the cards lock held */
+static int softvol_card_start_events(struct softvol_card *c)
+{
+	char name[16];
+	int err;
+
+	if (c->thread_running)
+		return 0;
+	sprintf(name, "hw:%d", c->card);
+	err = snd_ctl_open(&c->ev_ctl, name, SND_CTL_NONBLOCK);
+	if (err < 0)
+		return err;
+	err = snd_ctl_subscribe_events(c->ev_ctl, 1);
+	if (err < 0)
+		goto _close;
+	if (pipe(c->quit_fd) < 0) {
+		err = -errno;
+		goto _close;
+	}
+	if (snd_thread_create(&c->thread, NULL, softvol_event_thread, c)) {
+		err = -EAGAIN;
+		close(c->quit_fd[0]);
+		close(c->quit_fd[1]);
+		goto _close;
+	}
+	c->thread_running = 1;
+	return 0;
+ _close:
+	snd_ctl_close(c->ev_ctl);
+	c->ev_ctl = NULL;
+	return err;
+}
+
+static void softvol_card_stop_events(struct softvol_card *c)
+{
+	if (!c->thread_running)
+		return;
+	if (write(c->quit_fd[1], "q", 1) != 1)
+		SYSERR("softvol: cannot stop event thread");
+	pthread_join(c->thread, NULL);
+	close(c->quit_fd[0]);
+	close(c->quit_fd[1]);
+	snd_ctl_close(c->ev_ctl);
+	c->thread_running = 0;
+}
+
+/* follow the volume through control events, otherwise it is polled */
+static void softvol_watch(snd_pcm_softvol_t *svol)
+{
+	softvol_cards_lock();
+	if (softvol_card_start_events(svol->card) >= 0) {
+		svol->vol_gen = 1;
+		svol->vol_seen = 0;
+		list_add_tail(&svol->watch, &svol->card->users);
+		svol->watched = 1;
+	}
+	softvol_cards_unlock();
+}
+#else
+#define softvol_card_stop_events(c)	do { } while (0)
+#define softvol_watch(svol)		do { } while (0)
+#endif
+
+static void softvol_card_put(snd_pcm_softvol_t *svol)
+{
+	struct softvol_card *c = svol->card;
+
+	softvol_cards_lock();
+	if (svol->watched)
+		list_del(&svol->watch);
+	if (--c->refs) {
+		c = NULL;
+	} else {
+		list_del(&c->list);
+	}
+	softvol_cards_unlock();
+	if (c) {
+		softvol_card_stop_events(c);
+		snd_ctl_close(c->ctl);
+		free(c);
+	}
+}
+
 /*
  * get the current volume value from driver
  *
- * TODO: mmap support?
+ * With control events the value is read only after a change event.
  */
 static void get_current_volume(snd_pcm_softvol_t *svol)
 {
-	unsigned int val;
+	unsigned int val, gen;
 	unsigned int i;
 
+	if (svol->watched) {
+		gen = __atomic_load_n(&svol->vol_gen, __ATOMIC_ACQUIRE);
+		if (gen == svol->vol_seen)
+			return;
+		svol->vol_seen = gen;
+	}
 	if (snd_ctl_elem_read(svol->ctl, &svol->elem) < 0)
 		return;
 	for (i = 0; i < svol->cchannels; i++) {
@@ -398,8 +1009,8 @@ static void softvol_free(snd_pcm_softvol_t *svol)
 {
 	if (svol->plug.gen.close_slave)
 		snd_pcm_close(svol->plug.gen.slave);
-	if (svol->ctl)
-		snd_ctl_close(svol->ctl);
+	if (svol->card)
+		softvol_card_put(svol);
 	if (svol->dB_value && svol->dB_value != preset_dB_value)
 		free(svol->dB_value);
 	free(svol);
@@ -423,7 +1034,8 @@ static int snd_pcm_softvol_hw_refine_cprepare(snd_pcm_t *pcm,
 			(1ULL << SND_PCM_FORMAT_S16_LE) |
 			(1ULL << SND_PCM_FORMAT_S16_BE) |
 			(1ULL << SND_PCM_FORMAT_S32_LE) |
- 			(1ULL << SND_PCM_FORMAT_S32_BE),
+ 			(1ULL << SND_PCM_FORMAT_S32_BE) |
+			(1ULL << SND_PCM_FORMAT_FLOAT_LE),
 			(1ULL << (SND_PCM_FORMAT_S24_3LE - 32))
 		}
 	};
@@ -578,12 +1190,34 @@ static int snd_pcm_softvol_hw_params(snd_pcm_t *pcm, snd_pcm_hw_params_t * param
 	    slave->format != SND_PCM_FORMAT_S16_BE &&
 	    slave->format != SND_PCM_FORMAT_S24_3LE && 
 	    slave->format != SND_PCM_FORMAT_S32_LE &&
-	    slave->format != SND_PCM_FORMAT_S32_BE) {
-		SNDERR("softvol supports only S16_LE, S16_BE, S24_3LE, S32_LE "
-		       " or S32_BE");
+	    slave->format != SND_PCM_FORMAT_S32_BE &&
+	    slave->format != SND_PCM_FORMAT_FLOAT_LE) {
+		SNDERR("softvol supports only S16_LE, S16_BE, S24_3LE, S32_LE, "
+		       "S32_BE or FLOAT_LE");
 		return -EINVAL;
 	}
 	svol->sformat = slave->format;
+	svol->special = NULL;
+	if (snd_pcm_format_cpu_endian(svol->sformat)) {
+		const struct softvol_special *sp;
+		for (sp = softvol_specials; sp->func; sp++) {
+			if (sp->format == svol->sformat &&
+			    sp->channels == pcm->channels) {
+				svol->special = sp->func;
+				break;
+			}
+		}
+	}
+	return 0;
+}
+
+/* prepare and reset: the stream restarts at the current volume, a ramp
+ * still running from the previous one is dropped */
+static int snd_pcm_softvol_init(snd_pcm_t *pcm)
+{
+	snd_pcm_softvol_t *svol = pcm->private_data;
+
+	svol->ramp_valid = 0;
 	return 0;
 }
 
@@ -600,12 +1234,8 @@ snd_pcm_softvol_write_areas(snd_pcm_t *pcm,
 	if (size > *slave_sizep)
 		size = *slave_sizep;
 	get_current_volume(svol);
-	if (svol->cchannels == 1)
-		softvol_convert_mono_vol(svol, slave_areas, slave_offset,
-					 areas, offset, pcm->channels, size);
-	else
-		softvol_convert_stereo_vol(svol, slave_areas, slave_offset,
-					   areas, offset, pcm->channels, size);
+	softvol_convert(svol, slave_areas, slave_offset,
+			areas, offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -623,12 +1253,8 @@ snd_pcm_softvol_read_areas(snd_pcm_t *pcm,
 	if (size > *slave_sizep)
 		size = *slave_sizep;
 	get_current_volume(svol);
-	if (svol->cchannels == 1)
-		softvol_convert_mono_vol(svol, areas, offset, slave_areas,
-					 slave_offset, pcm->channels, size);
-	else
-		softvol_convert_stereo_vol(svol, areas, offset, slave_areas,
-					   slave_offset, pcm->channels, size);
+	softvol_convert(svol, areas, offset, slave_areas,
+			slave_offset, pcm->channels, size);
 	*slave_sizep = size;
 	return size;
 }
@@ -718,11 +1344,10 @@ static int softvol_load_control(snd_pcm_t *pcm, snd_pcm_softvol_t *svol,
 		}
 	}
 	sprintf(tmp_name, "hw:%d", ctl_card);
-	err = snd_ctl_open(&svol->ctl, tmp_name, 0);
-	if (err < 0) {
-		SNDERR("Cannot open CTL %s", tmp_name);
+	err = softvol_card_get(ctl_card, &svol->card);
+	if (err < 0)
 		return err;
-	}
+	svol->ctl = svol->card->ctl;
 
 	svol->elem.id = *ctl_id;
 	svol->max_val = resolution - 1;
@@ -830,30 +1455,13 @@ static const snd_pcm_ops_t snd_pcm_softvol_ops = {
 	.set_chmap = snd_pcm_generic_set_chmap,
 };
 
-/**
- * \brief Creates a new SoftVolume PCM
- * \param pcmp Returns created PCM handle
- * \param name Name of PCM
- * \param sformat Slave format
- * \param ctl_card card index of the control
- * \param ctl_id The control element
- * \param cchannels PCM channels
- * \param min_dB minimal dB value
- * \param max_dB maximal dB value
- * \param resolution resolution of control
- * \param slave Slave PCM handle
- * \param close_slave When set, the slave PCM handle is closed with copy PCM
- * \retval zero on success otherwise a negative error code
- * \warning Using of this function might be dangerous in the sense
- *          of compatibility reasons. The prototype might be freely
- *          changed in future.
- */
-int snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
-			 snd_pcm_format_t sformat,
-			 int ctl_card, snd_ctl_elem_id_t *ctl_id,
-			 int cchannels,
-			 double min_dB, double max_dB, int resolution,
-			 snd_pcm_t *slave, int close_slave)
+static int softvol_open(snd_pcm_t **pcmp, const char *name,
+			snd_pcm_format_t sformat,
+			int ctl_card, snd_ctl_elem_id_t *ctl_id,
+			int cchannels,
+			double min_dB, double max_dB, int resolution,
+			unsigned int ramp_frames,
+			snd_pcm_t *slave, int close_slave)
 {
 	snd_pcm_t *pcm;
 	snd_pcm_softvol_t *svol;
@@ -864,7 +1472,8 @@ int snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	    sformat != SND_PCM_FORMAT_S16_BE &&
 	    sformat != SND_PCM_FORMAT_S24_3LE && 
 	    sformat != SND_PCM_FORMAT_S32_LE &&
-	    sformat != SND_PCM_FORMAT_S32_BE)
+	    sformat != SND_PCM_FORMAT_S32_BE &&
+	    sformat != SND_PCM_FORMAT_FLOAT_LE)
 		return -EINVAL;
 	svol = calloc(1, sizeof(*svol));
 	if (! svol)
@@ -887,12 +1496,15 @@ int snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	snd_pcm_plugin_init(&svol->plug);
 	svol->sformat = sformat;
 	svol->cchannels = cchannels;
+	svol->ramp_frames = ramp_frames;
+	svol->plug.init = snd_pcm_softvol_init;
 	svol->plug.read = snd_pcm_softvol_read_areas;
 	svol->plug.write = snd_pcm_softvol_write_areas;
 	svol->plug.undo_read = snd_pcm_plugin_undo_read_generic;
 	svol->plug.undo_write = snd_pcm_plugin_undo_write_generic;
 	svol->plug.gen.slave = slave;
 	svol->plug.gen.close_slave = close_slave;
+	softvol_watch(svol);
 
 	err = snd_pcm_new(&pcm, SND_PCM_TYPE_SOFTVOL, name, slave->stream, slave->mode);
 	if (err < 0) {
@@ -918,6 +1530,35 @@ int snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	return 0;
 }
 
+/**
+ * \brief Creates a new SoftVolume PCM
+ * \param pcmp Returns created PCM handle
+ * \param name Name of PCM
+ * \param sformat Slave format
+ * \param ctl_card card index of the control
+ * \param ctl_id The control element
+ * \param cchannels PCM channels
+ * \param min_dB minimal dB value
+ * \param max_dB maximal dB value
+ * \param resolution resolution of control
+ * \param slave Slave PCM handle
+ * \param close_slave When set, the slave PCM handle is closed with copy PCM
+ * \retval zero on success otherwise a negative error code
+ * \warning Using of this function might be dangerous in the sense
+ *          of compatibility reasons. The prototype might be freely
+ *          changed in future.
+ */
+int snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
+			 snd_pcm_format_t sformat,
+			 int ctl_card, snd_ctl_elem_id_t *ctl_id,
+			 int cchannels,
+			 double min_dB, double max_dB, int resolution,
+			 snd_pcm_t *slave, int close_slave)
+{
+	return softvol_open(pcmp, name, sformat, ctl_card, ctl_id, cchannels,
+			    min_dB, max_dB, resolution, 0, slave, close_slave);
+}
+
 /* in pcm_misc.c */
 int snd_pcm_parse_control_id(snd_config_t *conf, snd_ctl_elem_id_t *ctl_id, int *cardp,
 			     int *cchannelsp, int *hwctlp);
@@ -960,9 +1601,17 @@ pcm.name {
 	[max_dB REAL]           # maximal dB value (default:   0.0)
 	[resolution INT]        # resolution (default: 256)
 				# resolution = 2 means a mute switch
+	[ramp INT]              # volume change ramp in frames (default: 0)
 }
 \endcode
 
+When ramp is set, a volume change is applied as a linear gain ramp over
+the given number of frames instead of a jump to the new value.
+
+All softvol PCMs of a card in the process share one control handle.
+With the thread-safe API the control value follows the control events
+of the card, so it is read again only after a change.
+
 \subsection pcm_plugins_softvol_funcref Function reference
 
 <UL>
@@ -1000,6 +1649,7 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 	double min_dB = PRESET_MIN_DB;
 	double max_dB = ZERO_DB;
 	int card = -1, cchannels = 2;
+	long ramp = 0;
 
 	snd_config_for_each(i, next, conf) {
 		snd_config_t *n = snd_config_iterator_entry(i);
@@ -1026,6 +1676,14 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 			resolution = v;
 			continue;
 		}
+		if (strcmp(id, "ramp") == 0) {
+			err = snd_config_get_integer(n, &ramp);
+			if (err < 0 || ramp < 0) {
+				SNDERR("Invalid ramp value");
+				return err < 0 ? err : -EINVAL;
+			}
+			continue;
+		}
 		if (strcmp(id, "min_dB") == 0) {
 			err = snd_config_get_real(n, &min_dB);
 			if (err < 0) {
@@ -1083,8 +1741,9 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 		    sformat != SND_PCM_FORMAT_S16_BE &&
 		    sformat != SND_PCM_FORMAT_S24_3LE && 
 		    sformat != SND_PCM_FORMAT_S32_LE &&
-		    sformat != SND_PCM_FORMAT_S32_BE) {
-			SNDERR("only S16_LE, S16_BE, S24_3LE, S32_LE or S32_BE format is supported");
+		    sformat != SND_PCM_FORMAT_S32_BE &&
+		    sformat != SND_PCM_FORMAT_FLOAT_LE) {
+			SNDERR("only S16_LE, S16_BE, S24_3LE, S32_LE, S32_BE or FLOAT_LE format is supported");
 			snd_config_delete(sconf);
 			return -EINVAL;
 		}
@@ -1098,9 +1757,9 @@ int _snd_pcm_softvol_open(snd_pcm_t **pcmp, const char *name,
 			snd_pcm_close(spcm);
 			return err;
 		}
-		err = snd_pcm_softvol_open(pcmp, name, sformat, card, &ctl_id,
-					   cchannels, min_dB, max_dB,
-					   resolution, spcm, 1);
+		err = softvol_open(pcmp, name, sformat, card, &ctl_id,
+				   cchannels, min_dB, max_dB,
+				   resolution, ramp, spcm, 1);
 		if (err < 0)
 			snd_pcm_close(spcm);
 	}
@@ -0,0 +1,57 @@
+/*
+ *  PCM - build-time specialized kernels
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * configure --with-pcm-specialize=S16_LE:2,... defines SND_PCM_SPECIALIZE
+ * as a list of SND_PCM_SPECIAL(format, channels) entries.  A plugin
+ * defines SND_PCM_SPECIAL before expanding the list, once to build a
+ * kernel for each entry with the sample type and the channel count as
+ * constants, so the compiler unrolls the loop over the channels, and
+ * once for the table it picks the kernel from at hw_params.  Without the
+ * option the list is empty and the generic code runs as before.
+ *
+ * The kernels work on interleaved native endian samples; the entries of
+ * the other byte order are built but never picked.
+ */
+
+#ifndef __PCM_SPECIAL_H
+#define __PCM_SPECIAL_H
+
+#ifndef SND_PCM_SPECIALIZE
+#define SND_PCM_SPECIALIZE
+#endif
+
+/* sample type of the formats configure accepts */
+#define SND_PCM_SPECIAL_TYPE_S16_LE	short
+#define SND_PCM_SPECIAL_TYPE_S16_BE	short
+#define SND_PCM_SPECIAL_TYPE_S32_LE	int
+#define SND_PCM_SPECIAL_TYPE_S32_BE	int
+#define SND_PCM_SPECIAL_TYPE_FLOAT_LE	float
+#define SND_PCM_SPECIAL_TYPE_FLOAT_BE	float
+
+/*
+ * expand KERNEL(format, channels, type) for an entry; the indirection
+ * lets the type name be pasted into other macro names
+ */
+#define SND_PCM_SPECIAL_EXPAND(KERNEL, fmt, ch) \
+	SND_PCM_SPECIAL_EXPAND1(KERNEL, fmt, ch, SND_PCM_SPECIAL_TYPE_##fmt)
+#define SND_PCM_SPECIAL_EXPAND1(KERNEL, fmt, ch, type) \
+	KERNEL(fmt, ch, type)
+
+#endif /* __PCM_SPECIAL_H */
@@ -0,0 +1,225 @@
+/*
+ *  PCM - process wide trace ring
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include "pcm_local.h"
+
+#ifndef DOC_HIDDEN
+
+/* the ring while recording, NULL otherwise */
+snd_pcm_trace_ring_t *snd_pcm_trace_active;
+
+/* the ring once set up; it is never freed so readers can stay attached */
+static snd_pcm_trace_ring_t *trace_ring;
+static long trace_ipc_key;
+
+#define TRACE_MAX_RECORDS	(1U << 20)
+
+static inline snd_pcm_trace_record_t *trace_records(snd_pcm_trace_ring_t *ring)
+{
+	return (snd_pcm_trace_record_t *)(ring + 1);
+}
+
+/*
+ * Claim the next slot and fill it.  The seq field is written last, so a
+ * reader seeing seq == index + 1 knows the slot holds that record.
+ */
+void snd_pcm_trace_put(snd_pcm_t *pcm, snd_pcm_trace_event_t event,
+		       snd_pcm_uframes_t hw_ptr, snd_pcm_uframes_t appl_ptr,
+		       long result)
+{
+	snd_pcm_trace_ring_t *ring = snd_pcm_trace_active;
+	snd_pcm_trace_record_t *rec;
+	snd_htimestamp_t now;
+	unsigned long long idx;
+
+	if (!ring)
+		return;
+	idx = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED);
+	rec = &trace_records(ring)[idx & (ring->size - 1)];
+	__atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	gettimestamp(&now, SND_PCM_TSTAMP_TYPE_MONOTONIC);
+	rec->tstamp_ns = now.tv_sec * 1000000000ULL + now.tv_nsec;
+	rec->handle = (unsigned long)pcm;
+	rec->event = event;
+	rec->result = result;
+	rec->hw_ptr = hw_ptr;
+	rec->appl_ptr = appl_ptr;
+	__atomic_store_n(&rec->seq, idx + 1, __ATOMIC_RELEASE);
+}
+
+static int trace_setup(unsigned int records, long ipc_key)
+{
+	snd_pcm_trace_ring_t *ring;
+	size_t size;
+
+	if (trace_ring) {
+		if (records != trace_ring->size || ipc_key != trace_ipc_key)
+			return -EBUSY;
+		return 0;
+	}
+	size = sizeof(*ring) + records * sizeof(snd_pcm_trace_record_t);
+	if (ipc_key) {
+		int shmid = shmget(ipc_key, size, IPC_CREAT | 0644);
+		if (shmid < 0) {
+			SYSERR("trace: shmget failed");
+			return -errno;
+		}
+		ring = shmat(shmid, NULL, 0);
+		if (ring == (void *) -1) {
+			SYSERR("trace: shmat failed");
+			return -errno;
+		}
+		memset(ring, 0, size);
+	} else {
+		ring = calloc(1, size);
+		if (!ring)
+			return -ENOMEM;
+	}
+	ring->magic = SND_PCM_TRACE_MAGIC;
+	ring->size = records;
+	trace_ipc_key = ipc_key;
+	trace_ring = ring;
+	return 0;
+}
+
+/* LIBASOUND_PCM_TRACE=records[,ipc_key] starts the trace at the first open */
+void snd_pcm_trace_init_env(void)
+{
+	static int done;
+	const char *p;
+	char *end;
+	unsigned long records;
+	long ipc_key = 0;
+
+	if (done)
+		return;
+	done = 1;
+	p = getenv("LIBASOUND_PCM_TRACE");
+	if (!p || !*p)
+		return;
+	records = strtoul(p, &end, 0);
+	if (*end == ',')
+		ipc_key = strtol(end + 1, NULL, 0);
+	if (records)
+		snd_pcm_trace_start(records, ipc_key);
+}
+
+#define EVENT(v) [SND_PCM_TRACE_##v] = #v
+
+static const char *const trace_event_names[] = {
+	EVENT(HW_AVAIL_UPDATE),
+	EVENT(WAIT),
+	EVENT(WAKEUP),
+	EVENT(DIRECT_SYNC),
+};
+
+#undef EVENT
+#endif /* DOC_HIDDEN */
+
+/**
+ * \brief get name of a PCM trace event
+ * \param event trace event
+ * \return ascii name of the event
+ */
+const char *snd_pcm_trace_event_name(const snd_pcm_trace_event_t event)
+{
+	if (event > SND_PCM_TRACE_LAST)
+		return NULL;
+	return trace_event_names[event];
+}
+
+/**
+ * \brief Start recording the process wide PCM trace ring
+ * \param records ring size in records, a power of two
+ * \param ipc_key when non-zero, the ring is placed in a SysV shared
+ *        memory segment with this key
+ * \return 0 on success otherwise a negative error code
+ *
+ * The ring holds fixed size records, nothing is allocated while
+ * recording.  A shared memory ring starts with #snd_pcm_trace_ring_t,
+ * followed by \a records #snd_pcm_trace_record_t; another process can
+ * attach to it and read it after an xrun.  The ring is set up once per
+ * process; a second start with different parameters fails with -EBUSY.
+ *
+ * The environment variable LIBASOUND_PCM_TRACE=records[,ipc_key] starts
+ * the trace when the first PCM is opened.
+ */
+int snd_pcm_trace_start(unsigned int records, long ipc_key)
+{
+	int err;
+
+	if (records < 2 || records > TRACE_MAX_RECORDS ||
+	    (records & (records - 1)))
+		return -EINVAL;
+	err = trace_setup(records, ipc_key);
+	if (err < 0)
+		return err;
+	__atomic_store_n(&snd_pcm_trace_active, trace_ring, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/**
+ * \brief Stop recording the PCM trace ring
+ *
+ * The recorded data stays available for snd_pcm_trace_dump() and
+ * shared memory readers.
+ */
+void snd_pcm_trace_stop(void)
+{
+	__atomic_store_n(&snd_pcm_trace_active, NULL, __ATOMIC_RELEASE);
+}
+
+/**
+ * \brief Dump the PCM trace ring, oldest record first
+ * \param out Output handle
+ * \return 0 on success, -ENXIO if the trace was never started
+ */
+int snd_pcm_trace_dump(snd_output_t *out)
+{
+	snd_pcm_trace_ring_t *ring = trace_ring;
+	unsigned long long head, idx;
+
+	assert(out);
+	if (!ring)
+		return -ENXIO;
+	head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	idx = head > ring->size ? head - ring->size : 0;
+	snd_output_printf(out, "PCM trace: %llu records, showing %llu\n",
+			  head, head - idx);
+	for (; idx < head; idx++) {
+		snd_pcm_trace_record_t *slot = &trace_records(ring)[idx & (ring->size - 1)];
+		snd_pcm_trace_record_t rec;
+		if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != idx + 1)
+			continue;	/* being written or overwritten */
+		rec = *slot;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != idx + 1)
+			continue;
+		snd_output_printf(out, "%llu.%09llu %#llx %-15s hw %llu appl %llu result %lld\n",
+				  rec.tstamp_ns / 1000000000ULL,
+				  rec.tstamp_ns % 1000000000ULL,
+				  rec.handle,
+				  snd_pcm_trace_event_name(rec.event),
+				  rec.hw_ptr, rec.appl_ptr, rec.result);
+	}
+	return 0;
+}
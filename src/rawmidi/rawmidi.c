@@ -139,6 +139,9 @@ This example shows open and read/write rawmidi operations.
 #include <stdarg.h>
 #include <unistd.h>
 #include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/uio.h>
 #include "rawmidi_local.h"
 
 /**
@@ -348,6 +351,10 @@ int snd_rawmidi_close(snd_rawmidi_t *rawmidi)
 {
 	int err;
   	assert(rawmidi);
+	if (rawmidi->obuf) {
+		snd_rawmidi_flush(rawmidi);
+		free(rawmidi->obuf);
+	}
 	err = rawmidi->ops->close(rawmidi);
 	free(rawmidi->name);
 	if (rawmidi->dl_handle)
@@ -443,6 +450,49 @@ int snd_rawmidi_poll_descriptors_revents(snd_rawmidi_t *rawmidi, struct pollfd *
         return -EINVAL;
 }
 
+static int snd_rawmidi_evloop_count(void *handle)
+{
+	return snd_rawmidi_poll_descriptors_count(handle);
+}
+
+static int snd_rawmidi_evloop_descriptors(void *handle, struct pollfd *pfds, unsigned int space)
+{
+	return snd_rawmidi_poll_descriptors(handle, pfds, space);
+}
+
+static int snd_rawmidi_evloop_revents(void *handle, struct pollfd *pfds, unsigned int nfds,
+		unsigned short *revents)
+{
+	return snd_rawmidi_poll_descriptors_revents(handle, pfds, nfds, revents);
+}
+
+static const snd_evloop_ops_t snd_rawmidi_evloop_ops = {
+	.count = snd_rawmidi_evloop_count,
+	.descriptors = snd_rawmidi_evloop_descriptors,
+	.revents = snd_rawmidi_evloop_revents,
+};
+
+/**
+ * \brief Registers a RawMidi handle with an event loop
+ * \param loop Event loop
+ * \param srcp Returned source, may be NULL
+ * \param rawmidi RawMidi handle
+ * \param callback Callback for the events of the handle
+ * \param private_data Value for #snd_evloop_source_get_callback_private
+ * \return 0 on success otherwise a negative error code
+ *
+ * The callback gets the events translated by
+ * #snd_rawmidi_poll_descriptors_revents.  The poll descriptors are read
+ * once; see #snd_evloop_source_refresh.
+ */
+int snd_rawmidi_evloop_add(snd_evloop_t *loop, snd_evloop_source_t **srcp, snd_rawmidi_t *rawmidi,
+		snd_evloop_callback_t callback, void *private_data)
+{
+	assert(rawmidi);
+	return snd_evloop_add_source(loop, srcp, &snd_rawmidi_evloop_ops, rawmidi, 0,
+				     callback, private_data);
+}
+
 /**
  * \brief set nonblock mode
  * \param rawmidi RawMidi handle
@@ -950,6 +1000,7 @@ int snd_rawmidi_status(snd_rawmidi_t *rawmidi, snd_rawmidi_status_t * status)
 int snd_rawmidi_drop(snd_rawmidi_t *rawmidi)
 {
 	assert(rawmidi);
+	rawmidi->obufused = 0;
 	return rawmidi->ops->drop(rawmidi);
 }
 
@@ -959,26 +1010,156 @@ int snd_rawmidi_drop(snd_rawmidi_t *rawmidi)
  * \return 0 on success otherwise a negative error code
  *
  * Waits until all MIDI bytes are not drained (sent) to the
- * hardware device.
+ * hardware device.  The bytes of the output buffer are written first.
  */
 int snd_rawmidi_drain(snd_rawmidi_t *rawmidi)
 {
+	int err;
+
 	assert(rawmidi);
+	err = snd_rawmidi_flush(rawmidi);
+	if (err < 0)
+		return err;
 	return rawmidi->ops->drain(rawmidi);
 }
 
+/**
+ * \brief set up the output buffer coalescing small writes
+ * \param rawmidi RawMidi handle
+ * \param size the buffer size in bytes, 0 = no buffer
+ * \param threshold the fill level that writes the buffer, 0 = full
+ * \return 0 on success otherwise a negative error code
+ *
+ * With a buffer, snd_rawmidi_write() copies small messages to it instead of
+ * writing each one to the device.  The buffer is written when it reaches
+ * \a threshold bytes, when a message does not fit any more, and on
+ * snd_rawmidi_flush(), snd_rawmidi_drain() and snd_rawmidi_close().  There
+ * is no timer: an application which stops writing calls snd_rawmidi_flush()
+ * to send what is left.  Bytes still buffered are written before the
+ * buffer is changed.
+ *
+ * \sa snd_rawmidi_flush(), snd_rawmidi_writev()
+ */
+int snd_rawmidi_set_output_buffer(snd_rawmidi_t *rawmidi, size_t size, size_t threshold)
+{
+	char *buf = NULL;
+	int err;
+
+	assert(rawmidi);
+	if (rawmidi->stream != SND_RAWMIDI_STREAM_OUTPUT)
+		return -EINVAL;
+	err = snd_rawmidi_flush(rawmidi);
+	if (err < 0)
+		return err;
+	if (size) {
+		buf = malloc(size);
+		if (!buf)
+			return -ENOMEM;
+	}
+	free(rawmidi->obuf);
+	rawmidi->obuf = buf;
+	rawmidi->obufsize = size;
+	rawmidi->othreshold = threshold && threshold < size ? threshold : size;
+	return 0;
+}
+
+/**
+ * \brief write the bytes of the output buffer
+ * \param rawmidi RawMidi handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * In nonblocking mode \c -EAGAIN is returned while the device takes no
+ * more bytes; the rest stays buffered.
+ *
+ * \sa snd_rawmidi_set_output_buffer()
+ */
+int snd_rawmidi_flush(snd_rawmidi_t *rawmidi)
+{
+	ssize_t res;
+
+	assert(rawmidi);
+	while (rawmidi->obufused > 0) {
+		res = rawmidi->ops->write(rawmidi, rawmidi->obuf, rawmidi->obufused);
+		if (res < 0)
+			return res;
+		if (res == 0)
+			return -EAGAIN;
+		rawmidi->obufused -= res;
+		if (rawmidi->obufused)
+			memmove(rawmidi->obuf, rawmidi->obuf + res, rawmidi->obufused);
+	}
+	return 0;
+}
+
 /**
  * \brief write MIDI bytes to MIDI stream
  * \param rawmidi RawMidi handle
  * \param buffer buffer containing MIDI bytes
  * \param size output buffer size in bytes
+ *
+ * With an output buffer set up, the bytes may stay in the buffer until
+ * it is written, see snd_rawmidi_set_output_buffer().
  */
 ssize_t snd_rawmidi_write(snd_rawmidi_t *rawmidi, const void *buffer, size_t size)
 {
+	int err;
+
 	assert(rawmidi);
 	assert(rawmidi->stream == SND_RAWMIDI_STREAM_OUTPUT);
 	assert(buffer || size == 0);
-	return rawmidi->ops->write(rawmidi, buffer, size);
+	if (!rawmidi->obuf)
+		return rawmidi->ops->write(rawmidi, buffer, size);
+	if (rawmidi->obufsize - rawmidi->obufused < size) {
+		err = snd_rawmidi_flush(rawmidi);
+		if (err < 0 && rawmidi->obufsize - rawmidi->obufused < size)
+			return err;
+	}
+	if (size >= rawmidi->obufsize)
+		return rawmidi->ops->write(rawmidi, buffer, size);
+	memcpy(rawmidi->obuf + rawmidi->obufused, buffer, size);
+	rawmidi->obufused += size;
+	/* the bytes are taken; a failed write is reported by the next call */
+	if (rawmidi->obufused >= rawmidi->othreshold)
+		snd_rawmidi_flush(rawmidi);
+	return size;
+}
+
+/**
+ * \brief write several MIDI messages at once
+ * \param rawmidi RawMidi handle
+ * \param iov the messages
+ * \param iovcnt the count of messages
+ * \return the count of bytes written otherwise a negative error code
+ *
+ * The messages go to the device in one submission where the device
+ * supports it, after the bytes of the output buffer.  Like
+ * snd_rawmidi_write(), fewer bytes than given may be written in
+ * nonblocking mode.
+ *
+ * \sa snd_rawmidi_write()
+ */
+ssize_t snd_rawmidi_writev(snd_rawmidi_t *rawmidi, const struct iovec *iov, int iovcnt)
+{
+	ssize_t res, result = 0;
+	int i, err;
+
+	assert(rawmidi);
+	assert(rawmidi->stream == SND_RAWMIDI_STREAM_OUTPUT);
+	assert(iov || iovcnt == 0);
+	err = snd_rawmidi_flush(rawmidi);
+	if (err < 0)
+		return err;
+	if (rawmidi->ops->writev)
+		return rawmidi->ops->writev(rawmidi, iov, iovcnt);
+	for (i = 0; i < iovcnt; i++) {
+		res = rawmidi->ops->write(rawmidi, iov[i].iov_base, iov[i].iov_len);
+		if (res < 0)
+			return result > 0 ? result : res;
+		result += res;
+		if ((size_t)res < iov[i].iov_len)
+			break;
+	}
+	return result;
 }
 
 /**
@@ -994,3 +1175,83 @@ ssize_t snd_rawmidi_read(snd_rawmidi_t *rawmidi, void *buffer, size_t size)
 	assert(buffer || size == 0);
 	return (rawmidi->ops->read)(rawmidi, buffer, size);
 }
+
+/**
+ * \brief set the wakeup window of timestamped reads
+ * \param rawmidi RawMidi handle
+ * \param usec the window in microseconds, 0 = none
+ * \return 0 on success otherwise a negative error code
+ *
+ * With a window set, a blocking snd_rawmidi_tread() on a hardware device
+ * waits for the first byte, then lets the input collect for \a usec
+ * microseconds before it reads, so dense input is taken with one wakeup
+ * per window.  The timestamp of the read is the arrival of its first byte.
+ *
+ * \sa snd_rawmidi_tread(), snd_rawmidi_params_set_avail_min()
+ */
+int snd_rawmidi_set_wakeup_window(snd_rawmidi_t *rawmidi, unsigned int usec)
+{
+	assert(rawmidi);
+	if (rawmidi->stream != SND_RAWMIDI_STREAM_INPUT)
+		return -EINVAL;
+	if (usec >= 1000000)
+		return -EINVAL;
+	rawmidi->wakeup_window = usec;
+	return 0;
+}
+
+/**
+ * \brief get the wakeup window of timestamped reads
+ * \param rawmidi RawMidi handle
+ * \return the window in microseconds
+ *
+ * \sa snd_rawmidi_set_wakeup_window()
+ */
+unsigned int snd_rawmidi_get_wakeup_window(snd_rawmidi_t *rawmidi)
+{
+	assert(rawmidi);
+	return rawmidi->wakeup_window;
+}
+
+/**
+ * \brief read MIDI bytes with their receive timestamp
+ * \param rawmidi RawMidi handle
+ * \param tstamp the CLOCK_MONOTONIC time the bytes were received
+ * \param buffer buffer to store the input MIDI bytes
+ * \param size input buffer size in bytes
+ * \return the count of bytes read otherwise a negative error code
+ *
+ * Reads like snd_rawmidi_read() and stamps the run of bytes.  Without a
+ * wakeup window the stamp is the time the bytes were taken from the
+ * driver, which is their arrival when the read had to wait for them.
+ * With a window it is the arrival of the first byte of the run.
+ *
+ * \sa snd_rawmidi_read(), snd_rawmidi_set_wakeup_window()
+ */
+ssize_t snd_rawmidi_tread(snd_rawmidi_t *rawmidi, snd_htimestamp_t *tstamp,
+			  void *buffer, size_t size)
+{
+	struct pollfd pfd;
+	struct timespec ts;
+	ssize_t res;
+
+	assert(rawmidi && tstamp);
+	assert(rawmidi->stream == SND_RAWMIDI_STREAM_INPUT);
+	assert(buffer || size == 0);
+	if (rawmidi->wakeup_window && rawmidi->type == SND_RAWMIDI_TYPE_HW &&
+	    !(rawmidi->mode & SND_RAWMIDI_NONBLOCK)) {
+		pfd.fd = rawmidi->poll_fd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, -1) < 0)
+			return -errno;
+		clock_gettime(CLOCK_MONOTONIC, tstamp);
+		ts.tv_sec = 0;
+		ts.tv_nsec = rawmidi->wakeup_window * 1000L;
+		while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+			;
+		return rawmidi->ops->read(rawmidi, buffer, size);
+	}
+	res = rawmidi->ops->read(rawmidi, buffer, size);
+	clock_gettime(CLOCK_MONOTONIC, tstamp);
+	return res;
+}
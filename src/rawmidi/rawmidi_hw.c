@@ -146,6 +146,16 @@ static ssize_t snd_rawmidi_hw_write(snd_rawmidi_t *rmidi, const void *buffer, si
 	return result;
 }
 
+static ssize_t snd_rawmidi_hw_writev(snd_rawmidi_t *rmidi, const struct iovec *iov, int iovcnt)
+{
+	snd_rawmidi_hw_t *hw = rmidi->private_data;
+	ssize_t result;
+	result = writev(hw->fd, iov, iovcnt);
+	if (result < 0)
+		return -errno;
+	return result;
+}
+
 static ssize_t snd_rawmidi_hw_read(snd_rawmidi_t *rmidi, void *buffer, size_t size)
 {
 	snd_rawmidi_hw_t *hw = rmidi->private_data;
@@ -166,6 +176,7 @@ static const snd_rawmidi_ops_t snd_rawmidi_hw_ops = {
 	.drain = snd_rawmidi_hw_drain,
 	.write = snd_rawmidi_hw_write,
 	.read = snd_rawmidi_hw_read,
+	.writev = snd_rawmidi_hw_writev,
 };
 
 
@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <sys/uio.h>
 #include "local.h"
 
 typedef struct {
@@ -34,6 +35,8 @@ typedef struct {
 	int (*drain)(snd_rawmidi_t *rawmidi);
 	ssize_t (*write)(snd_rawmidi_t *rawmidi, const void *buffer, size_t size);
 	ssize_t (*read)(snd_rawmidi_t *rawmidi, void *buffer, size_t size);
+	/* optional, one submission for several messages */
+	ssize_t (*writev)(snd_rawmidi_t *rawmidi, const struct iovec *iov, int iovcnt);
 } snd_rawmidi_ops_t;
 
 struct _snd_rawmidi {
@@ -48,6 +51,11 @@ struct _snd_rawmidi {
 	size_t buffer_size;
 	size_t avail_min;
 	unsigned int no_active_sensing: 1;
+	unsigned int wakeup_window;	/* usec, see snd_rawmidi_tread() */
+	char *obuf;			/* see snd_rawmidi_set_output_buffer() */
+	size_t obufsize;
+	size_t obufused;
+	size_t othreshold;
 };
 
 int snd_rawmidi_hw_open(snd_rawmidi_t **input, snd_rawmidi_t **output,
@@ -36,6 +36,8 @@ const char *_snd_module_rawmidi_virt = "";
 
 
 #ifndef DOC_HIDDEN
+#define VIRT_EVENTS	32
+
 typedef struct {
 	int open;
 
@@ -44,14 +46,17 @@ typedef struct {
 
 	snd_midi_event_t *midi_event;
 
-	snd_seq_event_t *in_event;
+	snd_seq_event_t *in_events[VIRT_EVENTS];	/* batch of input events */
+	unsigned int in_count;
+	unsigned int in_next;
 	int in_buf_size;
 	int in_buf_ofs;
 	char *in_buf_ptr;
 	char in_tmp_buf[16];
 
-	snd_seq_event_t out_event;
-	int pending;
+	snd_seq_event_t out_events[VIRT_EVENTS];	/* encoded, not yet queued */
+	unsigned int out_count;
+	unsigned int out_next;
 } snd_rawmidi_virtual_t;
 
 int _snd_seq_open_lconf(snd_seq_t **seqp, const char *name, 
@@ -161,12 +166,39 @@ static int snd_rawmidi_virtual_drop(snd_rawmidi_t *rmidi)
 	if (rmidi->stream == SND_RAWMIDI_STREAM_OUTPUT) {
 		snd_seq_drop_output(virt->handle);
 		snd_midi_event_reset_encode(virt->midi_event);
-		virt->pending = 0;
+		virt->out_count = virt->out_next = 0;
 	} else {
 		snd_seq_drop_input(virt->handle);
 		snd_midi_event_reset_decode(virt->midi_event);
-		virt->in_buf_ofs = 0;
+		virt->in_count = virt->in_next = 0;
+		virt->in_buf_ofs = virt->in_buf_size = 0;
+	}
+	return 0;
+}
+
+/* queue the encoded events on the output buffer */
+static int snd_rawmidi_virtual_flush_events(snd_rawmidi_virtual_t *virt)
+{
+	snd_seq_event_t *ev;
+	int err;
+
+	while (virt->out_next < virt->out_count) {
+		ev = &virt->out_events[virt->out_next];
+		snd_seq_ev_set_subs(ev);
+		snd_seq_ev_set_source(ev, virt->port);
+		snd_seq_ev_set_direct(ev);
+		err = snd_seq_event_output(virt->handle, ev);
+		if (err < 0) {
+			if (err != -EAGAIN)
+				/* we got some fatal error. removing this event
+				 * at the next time
+				 */
+				virt->out_next++;
+			return err;
+		}
+		virt->out_next++;
 	}
+	virt->out_count = virt->out_next = 0;
 	return 0;
 }
 
@@ -176,63 +208,105 @@ static int snd_rawmidi_virtual_drain(snd_rawmidi_t *rmidi)
 	int err;
 
 	if (rmidi->stream == SND_RAWMIDI_STREAM_OUTPUT) {
-		if (virt->pending) {
-			err = snd_seq_event_output(virt->handle, &virt->out_event);
-			if (err < 0)
-				return err;
-			virt->pending = 0;
-		}
+		err = snd_rawmidi_virtual_flush_events(virt);
+		if (err < 0)
+			return err;
 		snd_seq_drain_output(virt->handle);
 		snd_seq_sync_output_queue(virt->handle);
 	}
 	return snd_rawmidi_virtual_drop(rmidi);
 }
 
-static ssize_t snd_rawmidi_virtual_write(snd_rawmidi_t *rmidi, const void *buffer, size_t size)
+/* encode the bytes and queue the events, without writing the sequencer */
+static ssize_t snd_rawmidi_virtual_encode(snd_rawmidi_virtual_t *virt, const void *buffer, size_t size)
 {
-	snd_rawmidi_virtual_t *virt = rmidi->private_data;
 	ssize_t result = 0;
-	ssize_t size1;
+	long size1;
 	int err;
 
-	if (virt->pending) {
-		err = snd_seq_event_output(virt->handle, &virt->out_event);
-		if (err < 0) {
-			if (err != -EAGAIN)
-				/* we got some fatal error. removing this event
-				 * at the next time
-				 */
-				virt->pending = 0;
-			return err;
-		}
-		virt->pending = 0;
-	}
+	err = snd_rawmidi_virtual_flush_events(virt);
+	if (err < 0)
+		return err;
 
 	while (size > 0) {
-		size1 = snd_midi_event_encode(virt->midi_event, buffer, size, &virt->out_event);
+		size1 = snd_midi_event_encode_many(virt->midi_event, buffer, size,
+						   virt->out_events, VIRT_EVENTS,
+						   &virt->out_count);
 		if (size1 <= 0)
 			break;
 		size -= size1;
 		result += size1;
 		buffer += size1;
-		if (virt->out_event.type == SND_SEQ_EVENT_NONE)
-			continue;
-		snd_seq_ev_set_subs(&virt->out_event);
-		snd_seq_ev_set_source(&virt->out_event, virt->port);
-		snd_seq_ev_set_direct(&virt->out_event);
-		err = snd_seq_event_output(virt->handle, &virt->out_event);
-		if (err < 0) {
-			virt->pending = 1;
-			return result > 0 ? result : err;
-		}
+		/* a sysex event points into the parser, queue it right away */
+		err = snd_rawmidi_virtual_flush_events(virt);
+		if (err < 0)
+			break;
 	}
 
+	return result > 0 ? result : err;
+}
+
+static ssize_t snd_rawmidi_virtual_write(snd_rawmidi_t *rmidi, const void *buffer, size_t size)
+{
+	snd_rawmidi_virtual_t *virt = rmidi->private_data;
+	ssize_t result;
+
+	result = snd_rawmidi_virtual_encode(virt, buffer, size);
+	/* one write to the sequencer for the whole call */
 	if (result > 0)
 		snd_seq_drain_output(virt->handle);
+	return result;
+}
 
+static ssize_t snd_rawmidi_virtual_writev(snd_rawmidi_t *rmidi, const struct iovec *iov, int iovcnt)
+{
+	snd_rawmidi_virtual_t *virt = rmidi->private_data;
+	ssize_t res, result = 0;
+	int i;
+
+	for (i = 0; i < iovcnt; i++) {
+		res = snd_rawmidi_virtual_encode(virt, iov[i].iov_base, iov[i].iov_len);
+		if (res < 0) {
+			if (!result)
+				return res;
+			break;
+		}
+		result += res;
+		if ((size_t)res < iov[i].iov_len)
+			break;
+	}
+	if (result > 0)
+		snd_seq_drain_output(virt->handle);
 	return result;
 }
 
+/* the MIDI bytes of the next input event; 0 when the event has none */
+static int snd_rawmidi_virtual_next(snd_rawmidi_virtual_t *virt, snd_seq_event_t *ev,
+				    void *buffer, size_t size)
+{
+	long len;
+
+	if (ev->type == SND_SEQ_EVENT_SYSEX) {
+		virt->in_buf_ptr = ev->data.ext.ptr;
+		virt->in_buf_size = ev->data.ext.len;
+		virt->in_buf_ofs = 0;
+		return 0;
+	}
+	/* decode straight to the caller when the message fits */
+	len = snd_midi_event_decode(virt->midi_event, buffer, size, ev);
+	if (len != -ENOMEM)
+		return len < 0 ? 0 : len;
+	len = snd_midi_event_decode(virt->midi_event,
+				    (unsigned char *)virt->in_tmp_buf,
+				    sizeof(virt->in_tmp_buf), ev);
+	if (len > 0) {
+		virt->in_buf_ptr = virt->in_tmp_buf;
+		virt->in_buf_size = len;
+		virt->in_buf_ofs = 0;
+	}
+	return 0;
+}
+
 static ssize_t snd_rawmidi_virtual_read(snd_rawmidi_t *rmidi, void *buffer, size_t size)
 {
 	snd_rawmidi_virtual_t *virt = rmidi->private_data;
@@ -240,39 +314,35 @@ static ssize_t snd_rawmidi_virtual_read(snd_rawmidi_t *rmidi, void *buffer, size
 	int size1, err;
 
 	while (size > 0) {
-		if (! virt->in_buf_ofs) {
-			err = snd_seq_event_input_pending(virt->handle, 1);
-			if (err <= 0 && result > 0)
+		if (virt->in_buf_ofs < virt->in_buf_size) {
+			/* the rest of a message that did not fit */
+			size1 = virt->in_buf_size - virt->in_buf_ofs;
+			if ((size_t)size1 > size)
+				size1 = size;
+			memcpy(buffer, virt->in_buf_ptr + virt->in_buf_ofs, size1);
+			virt->in_buf_ofs += size1;
+			size -= size1;
+			result += size1;
+			buffer += size1;
+			continue;
+		}
+		if (virt->in_next == virt->in_count) {
+			if (result > 0 &&
+			    snd_seq_event_input_pending(virt->handle, 1) <= 0)
 				return result;
-			err = snd_seq_event_input(virt->handle, &virt->in_event);
+			err = snd_seq_event_input_many(virt->handle, virt->in_events,
+						       VIRT_EVENTS);
 			if (err < 0)
 				return result > 0 ? result : err;
-
-			if (virt->in_event->type == SND_SEQ_EVENT_SYSEX) {
-				virt->in_buf_ptr = virt->in_event->data.ext.ptr;
-				virt->in_buf_size = virt->in_event->data.ext.len;
-			} else {
-				virt->in_buf_ptr = virt->in_tmp_buf;
-				virt->in_buf_size = snd_midi_event_decode(virt->midi_event,
-									  (unsigned char *)virt->in_tmp_buf,
-									  sizeof(virt->in_tmp_buf),
-									  virt->in_event);
-			}
-			if (virt->in_buf_size <= 0)
-				continue;
-		}
-		size1 = virt->in_buf_size - virt->in_buf_ofs;
-		if ((size_t)size1 > size) {
-			virt->in_buf_ofs += size1 - size;
-			memcpy(buffer, virt->in_buf_ptr, size);
-			result += size;
-			break;
+			virt->in_count = err;
+			virt->in_next = 0;
+			continue;
 		}
-		memcpy(buffer, virt->in_buf_ptr + virt->in_buf_ofs, size1);
+		size1 = snd_rawmidi_virtual_next(virt, virt->in_events[virt->in_next++],
+						 buffer, size);
 		size -= size1;
 		result += size1;
 		buffer += size1;
-		virt->in_buf_ofs = 0;
 	}
 
 	return result;
@@ -288,6 +358,7 @@ static const snd_rawmidi_ops_t snd_rawmidi_virtual_ops = {
 	.drain = snd_rawmidi_virtual_drain,
 	.write = snd_rawmidi_virtual_write,
 	.read = snd_rawmidi_virtual_read,
+	.writev = snd_rawmidi_virtual_writev,
 };
 
 
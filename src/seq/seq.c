@@ -1038,12 +1038,14 @@ int snd_seq_close(snd_seq_t *seq)
 {
 	int err;
 	assert(seq);
+	snd_seq_direct_close(seq);
 	err = seq->ops->close(seq);
 	if (seq->dl_handle)
 		snd_dlclose(seq->dl_handle);
 	free(seq->obuf);
 	free(seq->ibuf);
 	free(seq->tmpbuf);
+	free(seq->qclock);
 	free(seq->name);
 	free(seq);
 	return err;
@@ -1073,7 +1075,11 @@ int snd_seq_poll_descriptors_count(snd_seq_t *seq, short events)
 		assert(seq->streams & SND_SEQ_OPEN_OUTPUT);
 		result++;
 	}
-	return result ? 1 : 0;
+	if (!result)
+		return 0;
+	if ((events & POLLIN) && seq->direct_in)
+		return 1 + snd_seq_direct_poll_count(seq);
+	return 1;
 }
 
 /**
@@ -1111,6 +1117,8 @@ int snd_seq_poll_descriptors(snd_seq_t *seq, struct pollfd *pfds, unsigned int s
 		return 0;
 	pfds->fd = seq->poll_fd;
 	pfds->events = revents;
+	if ((events & POLLIN) && seq->direct_in)
+		return 1 + snd_seq_direct_poll_descriptors(seq, pfds + 1, space - 1);
 	return 1;
 }
 
@@ -1126,12 +1134,66 @@ int snd_seq_poll_descriptors(snd_seq_t *seq, struct pollfd *pfds, unsigned int s
  */
 int snd_seq_poll_descriptors_revents(snd_seq_t *seq, struct pollfd *pfds, unsigned int nfds, unsigned short *revents)
 {
+        unsigned int i;
+
         assert(seq && pfds && revents);
         if (nfds == 1) {
                 *revents = pfds->revents;
                 return 0;
         }
-        return -EINVAL;
+        /* the direct links follow the sequencer descriptor */
+        if (nfds != 1 + snd_seq_direct_poll_count(seq))
+                return -EINVAL;
+        *revents = pfds->revents;
+        for (i = 1; i < nfds; i++) {
+                if (pfds[i].revents & POLLIN)
+                        *revents |= POLLIN;
+        }
+        return 0;
+}
+
+static int snd_seq_evloop_count(void *handle)
+{
+	return snd_seq_poll_descriptors_count(handle, POLLIN | POLLOUT);
+}
+
+static int snd_seq_evloop_descriptors(void *handle, struct pollfd *pfds, unsigned int space)
+{
+	return snd_seq_poll_descriptors(handle, pfds, space, POLLIN | POLLOUT);
+}
+
+static int snd_seq_evloop_revents(void *handle, struct pollfd *pfds, unsigned int nfds,
+		unsigned short *revents)
+{
+	return snd_seq_poll_descriptors_revents(handle, pfds, nfds, revents);
+}
+
+static const snd_evloop_ops_t snd_seq_evloop_ops = {
+	.count = snd_seq_evloop_count,
+	.descriptors = snd_seq_evloop_descriptors,
+	.revents = snd_seq_evloop_revents,
+};
+
+/**
+ * \brief Registers a sequencer handle with an event loop
+ * \param loop Event loop
+ * \param srcp Returned source, may be NULL
+ * \param seq Sequencer handle
+ * \param events POLLIN and/or POLLOUT to wait for
+ * \param callback Callback for the events of the handle
+ * \param private_data Value for #snd_evloop_source_get_callback_private
+ * \return 0 on success otherwise a negative error code
+ *
+ * The callback gets the events translated by
+ * #snd_seq_poll_descriptors_revents.  The poll descriptors are read
+ * once; see #snd_evloop_source_refresh.
+ */
+int snd_seq_evloop_add(snd_evloop_t *loop, snd_evloop_source_t **srcp, snd_seq_t *seq, short events,
+		snd_evloop_callback_t callback, void *private_data)
+{
+	assert(seq);
+	return snd_evloop_add_source(loop, srcp, &snd_seq_evloop_ops, seq, events,
+				     callback, private_data);
 }
 
 /**
@@ -1231,6 +1293,7 @@ int snd_seq_set_output_buffer_size(snd_seq_t *seq, size_t size)
 	assert(seq && seq->obuf);
 	assert(size >= sizeof(snd_seq_event_t));
 	snd_seq_drop_output(seq);
+	seq->oreserved = 0;
 	if (size != seq->obufsize) {
 		char *newbuf;
 		newbuf = calloc(1, size);
@@ -1240,6 +1303,51 @@ int snd_seq_set_output_buffer_size(snd_seq_t *seq, size_t size)
 		seq->obuf = newbuf;
 		seq->obufsize = size;
 	}
+	seq->obufbase = size;
+	return 0;
+}
+
+/**
+ * \brief Let the output buffer grow on bursts
+ * \param seq sequencer handle
+ * \param size the largest size of output buffer in bytes, 0 for a fixed size
+ * \return 0 on success otherwise a negative error code
+ *
+ * When an event does not fit on the output buffer, the buffer is grown
+ * up to \a size instead of being drained, so a burst of events or a large
+ * SysEx dump is sent with few writes when the application drains the
+ * buffer.  Once a drain empties the buffer after sending less than the
+ * size set by snd_seq_set_output_buffer_size(), the buffer shrinks back
+ * to that size.
+ *
+ * \sa snd_seq_set_output_buffer_size(), snd_seq_get_output_flush_stats()
+ */
+int snd_seq_set_output_buffer_max(snd_seq_t *seq, size_t size)
+{
+	assert(seq && seq->obuf);
+	seq->obufmax = size > seq->obufbase ? size : 0;
+	return 0;
+}
+
+/**
+ * \brief Get the counters of output buffer flushes
+ * \param seq sequencer handle
+ * \param flushes pointer to store the number of writes to the sequencer, or NULL
+ * \param bytes pointer to store the bytes sent by them, or NULL
+ * \return 0 on success otherwise a negative error code
+ *
+ * The counters cover the writes of snd_seq_drain_output(), including the
+ * ones done when snd_seq_event_output() finds the buffer full.
+ *
+ * \sa snd_seq_set_output_buffer_max()
+ */
+int snd_seq_get_output_flush_stats(snd_seq_t *seq, unsigned long *flushes, unsigned long *bytes)
+{
+	assert(seq);
+	if (flushes)
+		*flushes = seq->oflushes;
+	if (bytes)
+		*bytes = seq->oflushbytes;
 	return 0;
 }
 
@@ -3415,6 +3523,148 @@ int snd_seq_get_queue_status(snd_seq_t *seq, int q, snd_seq_queue_status_t * sta
 	return seq->ops->get_queue_status(seq, status);
 }
 
+#ifndef DOC_HIDDEN
+
+#define QCLOCK_QUEUES		32		/* SNDRV_SEQ_MAX_QUEUES */
+#define QCLOCK_RESYNC_NS	1000000000LL	/* longest extrapolation */
+
+struct snd_seq_qclock {
+	int valid;
+	int wait_flush;			/* a queue control event is buffered */
+	unsigned long flushes;		/* oflushes when it was buffered */
+	struct timespec stamp;		/* CLOCK_MONOTONIC of the snapshot */
+	snd_seq_queue_status_t status;
+	unsigned int tempo;
+	unsigned int ppq;
+	unsigned int skew;
+	unsigned int skew_base;
+};
+
+static int qclock_resync(snd_seq_t *seq, struct snd_seq_qclock *c, int q)
+{
+	snd_seq_queue_tempo_t tempo;
+	struct timespec t0;
+	long long ns;
+	int err;
+
+	err = snd_seq_get_queue_tempo(seq, q, &tempo);
+	if (err < 0)
+		return err;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	err = snd_seq_get_queue_status(seq, q, &c->status);
+	if (err < 0)
+		return err;
+	clock_gettime(CLOCK_MONOTONIC, &c->stamp);
+	/* the status was taken somewhere between both stamps */
+	ns = ((c->stamp.tv_sec - t0.tv_sec) * 1000000000LL +
+	      c->stamp.tv_nsec - t0.tv_nsec) / 2;
+	c->stamp = t0;
+	c->stamp.tv_nsec += ns;
+	while (c->stamp.tv_nsec >= 1000000000L) {
+		c->stamp.tv_nsec -= 1000000000L;
+		c->stamp.tv_sec++;
+	}
+	c->tempo = tempo.tempo;
+	c->ppq = tempo.ppq;
+	c->skew = tempo.skew_value;
+	c->skew_base = tempo.skew_base;
+	c->valid = 1;
+	return 0;
+}
+
+/* note a queue control event passing this handle */
+static void qclock_event(snd_seq_t *seq, const snd_seq_event_t *ev, int buffered)
+{
+	struct snd_seq_qclock *c;
+
+	switch (ev->type) {
+	case SND_SEQ_EVENT_START:
+	case SND_SEQ_EVENT_CONTINUE:
+	case SND_SEQ_EVENT_STOP:
+	case SND_SEQ_EVENT_SETPOS_TICK:
+	case SND_SEQ_EVENT_SETPOS_TIME:
+	case SND_SEQ_EVENT_TEMPO:
+	case SND_SEQ_EVENT_QUEUE_SKEW:
+		break;
+	default:
+		return;
+	}
+	if (ev->data.queue.queue >= QCLOCK_QUEUES)
+		return;
+	c = &seq->qclock[ev->data.queue.queue];
+	c->valid = 0;
+	if (buffered) {
+		c->wait_flush = 1;
+		c->flushes = seq->oflushes;
+	}
+}
+
+#endif /* DOC_HIDDEN */
+
+/**
+ * \brief obtain the running state of the queue without a kernel call
+ * \param seq sequencer handle
+ * \param q queue id to query
+ * \param status pointer to store the current status
+ * \return 0 on success otherwise a negative error code
+ *
+ * Like snd_seq_get_queue_status() but the tick and real time positions
+ * of a running queue are extrapolated from a snapshot of the status and
+ * the tempo, so frequent calls, e.g. for a display, cost no system calls.
+ * The snapshot is taken again after a second and whenever a start, stop,
+ * continue, position, tempo or skew event of the queue is sent or received
+ * through this handle, or the tempo is set with snd_seq_set_queue_tempo().
+ * Changes made by other clients are only noticed by receiving their events,
+ * e.g. by subscribing to the system timer port.  The count of scheduled
+ * events is the one of the snapshot, and the positions may be ahead of
+ * the kernel by up to one timer period.
+ *
+ * \sa snd_seq_get_queue_status()
+ */
+int snd_seq_get_queue_clock(snd_seq_t *seq, int q, snd_seq_queue_status_t *status)
+{
+	struct snd_seq_qclock *c;
+	struct timespec now;
+	long long ns, t;
+	int err;
+
+	assert(seq && status);
+	if (q < 0 || q >= QCLOCK_QUEUES)
+		return snd_seq_get_queue_status(seq, q, status);
+	if (!seq->qclock) {
+		seq->qclock = calloc(QCLOCK_QUEUES, sizeof(*seq->qclock));
+		if (!seq->qclock)
+			return -ENOMEM;
+	}
+	c = &seq->qclock[q];
+	if (c->wait_flush) {
+		/* the event has not reached the queue yet */
+		if (seq->obufused && seq->oflushes == c->flushes)
+			return snd_seq_get_queue_status(seq, q, status);
+		c->wait_flush = 0;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ns = (now.tv_sec - c->stamp.tv_sec) * 1000000000LL +
+	     now.tv_nsec - c->stamp.tv_nsec;
+	if (!c->valid || ns < 0 || ns >= QCLOCK_RESYNC_NS) {
+		err = qclock_resync(seq, c, q);
+		if (err < 0) {
+			c->valid = 0;
+			return err;
+		}
+		ns = 0;
+	}
+	*status = c->status;
+	if (!c->status.running || !ns || !c->skew_base || !c->tempo)
+		return 0;
+	ns = ns * c->skew / c->skew_base;
+	t = status->time.tv_nsec + ns;
+	status->time.tv_sec += t / 1000000000LL;
+	status->time.tv_nsec = t % 1000000000LL;
+	status->tick += ns * c->ppq / (c->tempo * 1000LL);
+	return 0;
+}
+
 
 /**
  * \brief get size of #snd_seq_queue_tempo_t
@@ -3610,6 +3860,8 @@ int snd_seq_set_queue_tempo(snd_seq_t *seq, int q, snd_seq_queue_tempo_t * tempo
 {
 	assert(seq && tempo);
 	tempo->queue = q;
+	if (seq->qclock && (unsigned int)q < QCLOCK_QUEUES)
+		seq->qclock[q].valid = 0;
 	return seq->ops->set_queue_tempo(seq, tempo);
 }
 
@@ -3839,6 +4091,49 @@ ssize_t snd_seq_event_length(snd_seq_event_t *ev)
  * output to sequencer
  */
 
+/*
+ * grow the output buffer for len more bytes, see snd_seq_set_output_buffer_max()
+ */
+static int snd_seq_output_grow(snd_seq_t *seq, size_t len)
+{
+	size_t size = seq->obufsize;
+	char *newbuf;
+
+	if (seq->obufmax <= size)
+		return -EAGAIN;
+	while (size < seq->obufmax &&
+	       (len >= size || size - seq->obufused < len))
+		size *= 2;
+	if (size > seq->obufmax)
+		size = seq->obufmax;
+	if (len >= size || size - seq->obufused < len)
+		return -EAGAIN;
+	newbuf = realloc(seq->obuf, size);
+	if (newbuf == NULL)
+		return -ENOMEM;
+	seq->obuf = newbuf;
+	seq->obufsize = size;
+	seq->oreserved = 0;
+	return 0;
+}
+
+/*
+ * back to the application's size after a drain that emptied a grown buffer
+ */
+static void snd_seq_output_shrink(snd_seq_t *seq, size_t sent)
+{
+	char *newbuf;
+
+	if (seq->obufsize <= seq->obufbase || sent >= seq->obufbase)
+		return;
+	newbuf = realloc(seq->obuf, seq->obufbase);
+	if (newbuf == NULL)
+		return;
+	seq->obuf = newbuf;
+	seq->obufsize = seq->obufbase;
+	seq->oreserved = 0;
+}
+
 /**
  * \brief output an event
  * \param seq sequencer handle
@@ -3861,6 +4156,12 @@ int snd_seq_event_output(snd_seq_t *seq, snd_seq_event_t *ev)
 {
 	int result;
 
+	seq->oreserved = 0;
+	if (seq->direct_out) {
+		result = snd_seq_direct_output(seq, ev);
+		if (result)
+			return result < 0 ? result : (int)seq->obufused;
+	}
 	result = snd_seq_event_output_buffer(seq, ev);
 	if (result == -EAGAIN) {
 		result = snd_seq_drain_output(seq);
@@ -3885,12 +4186,22 @@ int snd_seq_event_output_buffer(snd_seq_t *seq, snd_seq_event_t *ev)
 {
 	int len;
 	assert(seq && ev);
+	seq->oreserved = 0;
+	if (seq->direct_out) {
+		len = snd_seq_direct_output(seq, ev);
+		if (len)
+			return len < 0 ? len : (int)seq->obufused;
+	}
 	len = snd_seq_event_length(ev);
 	if (len < 0)
 		return -EINVAL;
-	if ((size_t) len >= seq->obufsize)
+	if (seq->qclock && ev->dest.client == SND_SEQ_CLIENT_SYSTEM)
+		qclock_event(seq, ev, 1);
+	if ((size_t) len >= seq->obufsize &&
+	    snd_seq_output_grow(seq, len) < 0)
 		return -EINVAL;
-	if ((seq->obufsize - seq->obufused) < (size_t) len)
+	if ((seq->obufsize - seq->obufused) < (size_t) len &&
+	    snd_seq_output_grow(seq, len) < 0)
 		return -EAGAIN;
 	memcpy(seq->obuf + seq->obufused, ev, sizeof(snd_seq_event_t));
 	seq->obufused += sizeof(snd_seq_event_t);
@@ -3901,6 +4212,84 @@ int snd_seq_event_output_buffer(snd_seq_t *seq, snd_seq_event_t *ev)
 	return seq->obufused;
 }
 
+/**
+ * \brief reserve room for events on the output buffer
+ * \param seq sequencer handle
+ * \param evp pointer to store the address of the first reserved event
+ * \param count the number of events to reserve
+ * \return \a count on success, \c -EAGAIN if the buffer could not be
+ *         drained enough, otherwise a negative error code
+ *
+ * The reserved events lie on the output buffer itself; the application
+ * fills them in place and queues them with snd_seq_event_output_commit(),
+ * so nothing is copied.  Only fixed length events can be written this
+ * way; variable length events go through snd_seq_event_output().
+ * The contents of the reserved events are undefined.
+ *
+ * The output buffer is drained when the room is missing, like
+ * snd_seq_event_output() does.  The reservation is valid until the next
+ * call on the output buffer; anything but the commit discards it.
+ *
+ * \sa snd_seq_event_output_commit(), snd_seq_event_output()
+ */
+int snd_seq_event_output_reserve(snd_seq_t *seq, snd_seq_event_t **evp, unsigned int count)
+{
+	const size_t align = __alignof__(snd_seq_event_t);
+	size_t len;
+	int err;
+
+	assert(seq && evp);
+	seq->oreserved = 0;
+	len = (size_t)count * sizeof(snd_seq_event_t);
+	if (count == 0 || len >= seq->obufsize)
+		return -EINVAL;
+	/* variable length data may have left the buffer end unaligned */
+	if ((seq->obufsize - seq->obufused) < len || seq->obufused % align) {
+		err = snd_seq_drain_output(seq);
+		if (err < 0)
+			return err;
+		if ((seq->obufsize - seq->obufused) < len || seq->obufused % align)
+			return -EAGAIN;
+	}
+	seq->oreserve_pos = seq->obufused;
+	seq->oreserved = count;
+	*evp = (snd_seq_event_t *)(seq->obuf + seq->obufused);
+	return count;
+}
+
+/**
+ * \brief queue events filled in place on the output buffer
+ * \param seq sequencer handle
+ * \param count the number of reserved events to queue
+ * \return the byte size of remaining events or a negative error code
+ *
+ * Queues the first \a count events reserved by
+ * snd_seq_event_output_reserve(); the rest of the reservation is
+ * dropped.  \c -EINVAL is returned and nothing is queued when the
+ * reservation is gone or one of the events is a variable length event.
+ *
+ * \sa snd_seq_event_output_reserve(), snd_seq_drain_output()
+ */
+int snd_seq_event_output_commit(snd_seq_t *seq, unsigned int count)
+{
+	snd_seq_event_t *ev;
+	unsigned int i;
+
+	assert(seq);
+	if (count > seq->oreserved || seq->obufused != seq->oreserve_pos) {
+		seq->oreserved = 0;
+		return -EINVAL;
+	}
+	seq->oreserved = 0;
+	ev = (snd_seq_event_t *)(seq->obuf + seq->obufused);
+	for (i = 0; i < count; i++) {
+		if (snd_seq_ev_is_variable(&ev[i]))
+			return -EINVAL;
+	}
+	seq->obufused += (size_t)count * sizeof(snd_seq_event_t);
+	return seq->obufused;
+}
+
 /*
  * allocate the temporary buffer
  */
@@ -3942,10 +4331,17 @@ int snd_seq_event_output_direct(snd_seq_t *seq, snd_seq_event_t *ev)
 	ssize_t len;
 	void *buf;
 
+	if (seq->direct_out) {
+		len = snd_seq_direct_output(seq, ev);
+		if (len)
+			return len < 0 ? len : (ssize_t)sizeof(*ev);
+	}
 	len = snd_seq_event_length(ev);
 	if (len < 0)
 		return len;
-	else if (len == sizeof(*ev)) {
+	if (seq->qclock && ev->dest.client == SND_SEQ_CLIENT_SYSTEM)
+		qclock_event(seq, ev, 0);
+	if (len == sizeof(*ev)) {
 		buf = ev;
 	} else {
 		if (alloc_tmpbuf(seq, (size_t)len) < 0)
@@ -3989,6 +4385,7 @@ int snd_seq_drain_output(snd_seq_t *seq)
 {
 	ssize_t result, processed = 0;
 	assert(seq);
+	seq->oreserved = 0;
 	while (seq->obufused > 0) {
 		result = seq->ops->write(seq, seq->obuf, seq->obufused);
 		if (result < 0) {
@@ -3996,10 +4393,14 @@ int snd_seq_drain_output(snd_seq_t *seq)
 				return seq->obufused;
 			return result;
 		}
+		seq->oflushes++;
+		seq->oflushbytes += result;
+		processed += result;
 		if ((size_t)result < seq->obufused)
 			memmove(seq->obuf, seq->obuf + result, seq->obufused - result);
 		seq->obufused -= result;
 	}
+	snd_seq_output_shrink(seq, processed);
 	return 0;
 }
 
@@ -4019,6 +4420,7 @@ int snd_seq_extract_output(snd_seq_t *seq, snd_seq_event_t **ev_res)
 	size_t len, olen;
 	snd_seq_event_t ev;
 	assert(seq);
+	seq->oreserved = 0;
 	if (ev_res)
 		*ev_res = NULL;
 	if ((olen = seq->obufused) < sizeof(snd_seq_event_t))
@@ -4057,26 +4459,58 @@ static ssize_t snd_seq_event_read_buffer(snd_seq_t *seq)
 	return seq->ibuflen;
 }
 
+/*
+ * check an input event against the filter, see snd_seq_input_filter_add_type()
+ */
+int snd_seq_event_filtered(snd_seq_t *seq, const snd_seq_event_t *ev)
+{
+	if ((seq->ifilter & SND_SEQ_IFILTER_TYPE) &&
+	    !snd_seq_get_bit(ev->type, seq->ifilter_type))
+		return 1;
+	if ((seq->ifilter & SND_SEQ_IFILTER_PORT) &&
+	    !snd_seq_get_bit(ev->dest.port, seq->ifilter_port))
+		return 1;
+	if ((seq->ifilter & SND_SEQ_IFILTER_CHANNEL) &&
+	    snd_seq_ev_is_channel_type(ev)) {
+		unsigned int channel = snd_seq_ev_is_note_type(ev) ?
+			ev->data.note.channel : ev->data.control.channel;
+		if (channel >= 16 || !(seq->ifilter_channel & (1U << channel)))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * retrieve the next event passing the filter; 0 when the buffer ran out
+ */
 static int snd_seq_event_retrieve_buffer(snd_seq_t *seq, snd_seq_event_t **retp)
 {
 	size_t ncells;
 	snd_seq_event_t *ev;
 
-	*retp = ev = &seq->ibuf[seq->ibufptr];
-	seq->ibufptr++;
-	seq->ibuflen--;
-	if (! snd_seq_ev_is_variable(ev))
-		return 1;
-	ncells = (ev->data.ext.len + sizeof(snd_seq_event_t) - 1) / sizeof(snd_seq_event_t);
-	if (seq->ibuflen < ncells) {
-		seq->ibuflen = 0; /* clear buffer */
-		*retp = NULL;
-		return -EINVAL;
+	*retp = NULL;
+	while (seq->ibuflen > 0) {
+		ev = &seq->ibuf[seq->ibufptr];
+		seq->ibufptr++;
+		seq->ibuflen--;
+		if (snd_seq_ev_is_variable(ev)) {
+			ncells = (ev->data.ext.len + sizeof(snd_seq_event_t) - 1) / sizeof(snd_seq_event_t);
+			if (seq->ibuflen < ncells) {
+				seq->ibuflen = 0; /* clear buffer */
+				return -EINVAL;
+			}
+			ev->data.ext.ptr = ev + 1;
+			seq->ibuflen -= ncells;
+			seq->ibufptr += ncells;
+		}
+		if (seq->qclock)
+			qclock_event(seq, ev, 0);
+		if (!seq->ifilter || !snd_seq_event_filtered(seq, ev)) {
+			*retp = ev;
+			return 1;
+		}
 	}
-	ev->data.ext.ptr = ev + 1;
-	seq->ibuflen -= ncells;
-	seq->ibufptr += ncells;
-	return 1;
+	return 0;
 }
 
 /**
@@ -4114,12 +4548,70 @@ int snd_seq_event_input(snd_seq_t *seq, snd_seq_event_t **ev)
 	int err;
 	assert(seq);
 	*ev = NULL;
-	if (seq->ibuflen <= 0) {
-		if ((err = snd_seq_event_read_buffer(seq)) < 0)
+	if (seq->direct_in) {
+		err = snd_seq_direct_input(seq, ev, 1, seq->ibuflen <= 0 &&
+					   !(seq->mode & SND_SEQ_NONBLOCK));
+		if (err != 0)
 			return err;
 	}
+	do {
+		if (seq->ibuflen <= 0) {
+			if ((err = snd_seq_event_read_buffer(seq)) < 0)
+				return err;
+		}
+		err = snd_seq_event_retrieve_buffer(seq, ev);
+	} while (err == 0);	/* all filtered out */
+	return err;
+}
+
+/**
+ * \brief retrieve several events from sequencer at once
+ * \param seq sequencer handle
+ * \param evs array to store the event pointers
+ * \param count size of the array
+ * \return the number of events stored or a negative error code
+ *
+ * Like snd_seq_event_input(), but hands out up to \a count events of the
+ * input buffer in one call.  The sequencer is read only when the input
+ * buffer is empty, and then only once; the events are the ones this read
+ * (or an earlier one) brought, so fewer than \a count may be returned.
+ * The pointers stay valid until the input buffer is read again.
+ *
+ * The errors are the ones of snd_seq_event_input().  A broken variable
+ * length event ends the batch; it is reported only when no event
+ * precedes it.
+ *
+ * \sa snd_seq_event_input(), snd_seq_event_input_pending()
+ */
+int snd_seq_event_input_many(snd_seq_t *seq, snd_seq_event_t **evs, unsigned int count)
+{
+	unsigned int n = 0;
+	int err;
 
-	return snd_seq_event_retrieve_buffer(seq, ev);
+	assert(seq && evs);
+	if (count == 0)
+		return 0;
+	if (seq->direct_in) {
+		err = snd_seq_direct_input(seq, evs, count, seq->ibuflen <= 0 &&
+					   !(seq->mode & SND_SEQ_NONBLOCK));
+		if (err != 0)
+			return err;
+	}
+	do {
+		if (seq->ibuflen <= 0) {
+			if ((err = snd_seq_event_read_buffer(seq)) < 0)
+				return err;
+		}
+		while (n < count) {
+			err = snd_seq_event_retrieve_buffer(seq, &evs[n]);
+			if (err < 0)
+				return n ? (int)n : err;
+			if (err == 0)
+				break;
+			n++;
+		}
+	} while (n == 0);	/* all filtered out */
+	return n;
 }
 
 /*
@@ -4153,17 +4645,112 @@ static int snd_seq_event_input_feed(snd_seq_t *seq, int timeout)
  * and the number of received events are returned.
  * If fetch_sequencer argument is zero and
  * no events remain on the input buffer, function simply returns zero.
+ * A handle in non-blocking mode is fetched with a single read, without
+ * polling it first.
  *
  * \sa snd_seq_event_input()
  */
 int snd_seq_event_input_pending(snd_seq_t *seq, int fetch_sequencer)
 {
+	int err;
+
+	if (seq->direct_in && snd_seq_direct_pending(seq))
+		return seq->ibuflen + snd_seq_direct_pending(seq);
 	if (seq->ibuflen == 0 && fetch_sequencer) {
-		return snd_seq_event_input_feed(seq, 0);
+		if (!(seq->mode & SND_SEQ_NONBLOCK))
+			return snd_seq_event_input_feed(seq, 0);
+		err = snd_seq_event_read_buffer(seq);
+		return err == -EAGAIN ? 0 : err;
 	}
 	return seq->ibuflen;
 }
 
+/**
+ * \brief remove the input filter
+ * \param seq sequencer handle
+ *
+ * All events are delivered again by snd_seq_event_input().
+ *
+ * \sa snd_seq_input_filter_add_type()
+ */
+void snd_seq_input_filter_clear(snd_seq_t *seq)
+{
+	assert(seq);
+	seq->ifilter = 0;
+	memset(seq->ifilter_type, 0, sizeof(seq->ifilter_type));
+	memset(seq->ifilter_port, 0, sizeof(seq->ifilter_port));
+	seq->ifilter_channel = 0;
+}
+
+/**
+ * \brief let an event type through the input filter
+ * \param seq sequencer handle
+ * \param event_type event type to be delivered
+ * \return 0 on success otherwise a negative error code
+ *
+ * Once a type is added, snd_seq_event_input() and
+ * snd_seq_event_input_many() skip the events of all other types while
+ * they scan the input buffer.  Unlike the filter of
+ * snd_seq_client_info_event_filter_add(), which the kernel applies, this
+ * filter works on this handle only and the skipped events are still read.
+ * Types, ports and channels combine; an event must pass all the
+ * filters set.
+ *
+ * \sa snd_seq_input_filter_add_port(), snd_seq_input_filter_add_channel(),
+ *     snd_seq_input_filter_clear()
+ */
+int snd_seq_input_filter_add_type(snd_seq_t *seq, int event_type)
+{
+	assert(seq);
+	if (event_type < 0 || event_type > 255)
+		return -EINVAL;
+	seq->ifilter |= SND_SEQ_IFILTER_TYPE;
+	snd_seq_set_bit(event_type, seq->ifilter_type);
+	return 0;
+}
+
+/**
+ * \brief let events to a port through the input filter
+ * \param seq sequencer handle
+ * \param port destination port of the events to be delivered
+ * \return 0 on success otherwise a negative error code
+ *
+ * Once a port is added, events to all other ports of the client are
+ * skipped.
+ *
+ * \sa snd_seq_input_filter_add_type()
+ */
+int snd_seq_input_filter_add_port(snd_seq_t *seq, int port)
+{
+	assert(seq);
+	if (port < 0 || port > 255)
+		return -EINVAL;
+	seq->ifilter |= SND_SEQ_IFILTER_PORT;
+	snd_seq_set_bit(port, seq->ifilter_port);
+	return 0;
+}
+
+/**
+ * \brief let a MIDI channel through the input filter
+ * \param seq sequencer handle
+ * \param channel channel (0-15) of the note and control events to be delivered
+ * \return 0 on success otherwise a negative error code
+ *
+ * Once a channel is added, note and control events of all other channels
+ * are skipped; events without a channel are not affected.
+ *
+ * \sa snd_seq_input_filter_add_type()
+ */
+int snd_seq_input_filter_add_channel(snd_seq_t *seq, int channel)
+{
+	assert(seq);
+	if (channel < 0 || channel > 15)
+		return -EINVAL;
+	seq->ifilter |= SND_SEQ_IFILTER_CHANNEL;
+	seq->ifilter_channel |= 1U << channel;
+	return 0;
+}
+
 /*----------------------------------------------------------------*/
 
 /*
@@ -4184,6 +4771,7 @@ int snd_seq_drop_output_buffer(snd_seq_t *seq)
 {
 	assert(seq);
 	seq->obufused = 0;
+	seq->oreserved = 0;
 	return 0;
 }
 
@@ -4539,6 +5127,35 @@ static int remove_match(snd_seq_remove_events_t *info, snd_seq_event_t *ev)
 	return 1;
 }
 
+/*
+ * Drop the matching events of the output buffer in one pass: the kept
+ * events slide down behind the write position, so each byte moves at
+ * most once however many events match.
+ */
+static void remove_output_buffer(snd_seq_t *seq, snd_seq_remove_events_t *rmp)
+{
+	char *rp = seq->obuf, *wp = seq->obuf;
+	char *end = seq->obuf + seq->obufused;
+	snd_seq_event_t ev;
+	size_t len;
+
+	while (end - rp >= (ssize_t)sizeof(ev)) {
+		memcpy(&ev, rp, sizeof(ev));
+		len = snd_seq_event_length(&ev);
+		if (len > (size_t)(end - rp))
+			break;
+		if (!remove_match(rmp, &ev)) {
+			if (wp != rp)
+				memmove(wp, rp, len);
+			wp += len;
+		}
+		rp += len;
+	}
+	if (wp != rp)
+		memmove(wp, rp, end - rp);
+	seq->obufused -= rp - wp;
+}
+
 /**
  * \brief remove events on input/output buffers and pools
  * \param seq sequencer handle
@@ -4565,28 +5182,12 @@ int snd_seq_remove_events(snd_seq_t *seq, snd_seq_remove_events_t *rmp)
 		 * First deal with any events that are still buffered
 		 * in the library.
 		 */
+		seq->oreserved = 0;
 		 if (! (rmp->remove_mode & ~(SNDRV_SEQ_REMOVE_INPUT|SNDRV_SEQ_REMOVE_OUTPUT))) {
 			 /* The simple case - remove all */
 			 snd_seq_drop_output_buffer(seq);
 		} else {
-			char *ep;
-			size_t len;
-			snd_seq_event_t *ev;
-
-			ep = seq->obuf;
-			while (ep - seq->obuf < (ssize_t)seq->obufused) {
-
-				ev = (snd_seq_event_t *)ep;
-				len = snd_seq_event_length(ev);
-
-				if (remove_match(rmp, ev)) {
-					/* Remove event */
-					seq->obufused -= len;
-					memmove(ep, ep + len, seq->obufused - (ep - seq->obuf));
-				} else {
-					ep += len;
-				}
-			}
+			remove_output_buffer(seq, rmp);
 		}
 	}
 
@@ -0,0 +1,337 @@
+/*
+ *  Sequencer Interface - direct links between handles of a process
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * A direct link carries the events of one port of a producer handle to
+ * one port of a consumer handle of the same process without passing the
+ * kernel.  The events go through a single producer, single consumer ring
+ * of fixed length events; an eventfd wakes the consumer when the ring
+ * turns non-empty, so a burst costs one wakeup.
+ *
+ * The consumer hands out pointers into the ring; the slots are given
+ * back on its next input call.  Three indexes describe the ring:
+ * head (written by the producer), read (events handed out) and tail
+ * (slots given back).  The producer wakes the consumer when it finds
+ * nothing unread before its event.
+ */
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include "seq_local.h"
+
+#ifndef DOC_HIDDEN
+
+#define DIRECT_MIN_SIZE		16
+
+struct snd_seq_direct {
+	snd_seq_direct_t *out_next;	/* in the list of the producer */
+	snd_seq_direct_t *in_next;	/* in the list of the consumer */
+	snd_seq_t *src;
+	snd_seq_t *dest;
+	int src_port;
+	int dest_port;
+	int efd;			/* wakes the consumer */
+	unsigned int mask;		/* ring size - 1 */
+	unsigned int head __attribute__((aligned(64)));
+	unsigned int read __attribute__((aligned(64)));
+	unsigned int tail;
+	snd_seq_event_t ring[0] __attribute__((aligned(64)));
+};
+
+static void direct_unlink(snd_seq_direct_t *d)
+{
+	snd_seq_direct_t **p;
+
+	for (p = &d->src->direct_out; *p != d; p = &(*p)->out_next)
+		;
+	*p = d->out_next;
+	for (p = &d->dest->direct_in; *p != d; p = &(*p)->in_next)
+		;
+	*p = d->in_next;
+	close(d->efd);
+	free(d);
+}
+
+static snd_seq_direct_t *direct_find(snd_seq_t *src, int src_port,
+				     snd_seq_t *dest, int dest_port)
+{
+	snd_seq_direct_t *d;
+
+	for (d = src->direct_out; d; d = d->out_next) {
+		if (d->src_port == src_port && d->dest == dest &&
+		    d->dest_port == dest_port)
+			return d;
+	}
+	return NULL;
+}
+
+#endif /* DOC_HIDDEN */
+
+/**
+ * \brief connect two ports of this process directly
+ * \param src sequencer handle sending the events
+ * \param src_port port of \a src the events come from
+ * \param dest sequencer handle receiving the events
+ * \param dest_port port of \a dest the events go to
+ * \param size the number of events the link holds, rounded up to a power of two
+ * \return 0 on success otherwise a negative error code
+ *
+ * Fixed length events sent with #SND_SEQ_QUEUE_DIRECT from \a src_port to
+ * \a dest_port of \a dest, addressed to that port explicitly, no longer pass
+ * the kernel: snd_seq_event_output(), snd_seq_event_output_buffer() and
+ * snd_seq_event_output_direct() put them on the link at once, and
+ * snd_seq_event_input() of \a dest returns them before the events from the
+ * kernel.  Events to subscribers, scheduled events and variable length
+ * events keep the kernel path, so their order relative to the events of
+ * the link is not kept.
+ *
+ * The output functions return \c -EAGAIN while the link is full.  The poll
+ * descriptors of \a dest for \c POLLIN include the link.  Both handles must
+ * stay open while connected; closing either one disconnects the link.
+ * Connecting and disconnecting must not run while the handles do I/O.
+ *
+ * \sa snd_seq_direct_disconnect()
+ */
+int snd_seq_direct_connect(snd_seq_t *src, int src_port, snd_seq_t *dest, int dest_port, unsigned int size)
+{
+	snd_seq_direct_t *d;
+	unsigned int n;
+
+	assert(src && dest);
+	if (!(src->streams & SND_SEQ_OPEN_OUTPUT) ||
+	    !(dest->streams & SND_SEQ_OPEN_INPUT))
+		return -EINVAL;
+	if (src_port < 0 || src_port > 255 || dest_port < 0 || dest_port > 255)
+		return -EINVAL;
+	if (direct_find(src, src_port, dest, dest_port))
+		return -EBUSY;
+	if (size > 0x10000000)
+		return -EINVAL;
+	for (n = DIRECT_MIN_SIZE; n < size; n <<= 1)
+		;
+	if (posix_memalign((void **)&d, 64, sizeof(*d) + n * sizeof(snd_seq_event_t)))
+		return -ENOMEM;
+	memset(d, 0, sizeof(*d));
+	d->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (d->efd < 0) {
+		SYSERR("eventfd failed");
+		free(d);
+		return -errno;
+	}
+	d->src = src;
+	d->dest = dest;
+	d->src_port = src_port;
+	d->dest_port = dest_port;
+	d->mask = n - 1;
+	d->out_next = src->direct_out;
+	src->direct_out = d;
+	d->in_next = dest->direct_in;
+	dest->direct_in = d;
+	return 0;
+}
+
+/**
+ * \brief remove a direct link
+ * \param src sequencer handle sending the events
+ * \param src_port port of \a src the events come from
+ * \param dest sequencer handle receiving the events
+ * \param dest_port port of \a dest the events go to
+ * \return 0 on success otherwise a negative error code
+ *
+ * Events still on the link are dropped.
+ *
+ * \sa snd_seq_direct_connect()
+ */
+int snd_seq_direct_disconnect(snd_seq_t *src, int src_port, snd_seq_t *dest, int dest_port)
+{
+	snd_seq_direct_t *d;
+
+	assert(src && dest);
+	d = direct_find(src, src_port, dest, dest_port);
+	if (!d)
+		return -ENOENT;
+	direct_unlink(d);
+	return 0;
+}
+
+#ifndef DOC_HIDDEN
+
+/* drop all links of a closing handle */
+void snd_seq_direct_close(snd_seq_t *seq)
+{
+	while (seq->direct_out)
+		direct_unlink(seq->direct_out);
+	while (seq->direct_in)
+		direct_unlink(seq->direct_in);
+}
+
+/*
+ * put an event on its link; 1 when done, 0 when the event takes the
+ * kernel path, -EAGAIN when the link is full
+ */
+int snd_seq_direct_output(snd_seq_t *seq, snd_seq_event_t *ev)
+{
+	snd_seq_direct_t *d;
+	unsigned int head, tail;
+	snd_seq_event_t *slot;
+	uint64_t one = 1;
+
+	if (!snd_seq_ev_is_fixed(ev) || ev->queue != SND_SEQ_QUEUE_DIRECT)
+		return 0;
+	for (d = seq->direct_out; d; d = d->out_next) {
+		if (d->src_port == ev->source.port &&
+		    d->dest->client == ev->dest.client &&
+		    d->dest_port == ev->dest.port)
+			break;
+	}
+	if (!d)
+		return 0;
+	head = d->head;
+	tail = __atomic_load_n(&d->tail, __ATOMIC_ACQUIRE);
+	if (head - tail > d->mask)
+		return -EAGAIN;
+	slot = &d->ring[head & d->mask];
+	*slot = *ev;
+	slot->source.client = seq->client;
+	__atomic_store_n(&d->head, head + 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&d->read, __ATOMIC_SEQ_CST) == head) {
+		if (write(d->efd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+			return -errno;
+	}
+	return 1;
+}
+
+/* give back the slots handed out by the last input */
+static void direct_release(snd_seq_t *seq)
+{
+	snd_seq_direct_t *d;
+
+	for (d = seq->direct_in; d; d = d->in_next)
+		__atomic_store_n(&d->tail, d->read, __ATOMIC_RELEASE);
+}
+
+/* take the next unread event of a link, clearing the wakeup when empty */
+static snd_seq_event_t *direct_take(snd_seq_direct_t *d)
+{
+	unsigned int pos = d->read;
+	uint64_t cnt;
+
+	if (__atomic_load_n(&d->head, __ATOMIC_SEQ_CST) == pos) {
+		if (read(d->efd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN)
+			return NULL;
+		if (__atomic_load_n(&d->head, __ATOMIC_SEQ_CST) == pos)
+			return NULL;
+	}
+	__atomic_store_n(&d->read, pos + 1, __ATOMIC_SEQ_CST);
+	return &d->ring[pos & d->mask];
+}
+
+/* wait until a link or the kernel has input; 1 for a link */
+static int direct_wait(snd_seq_t *seq)
+{
+	struct pollfd *pfds;
+	snd_seq_direct_t *d;
+	unsigned int n = 1, i;
+
+	pfds = alloca(sizeof(*pfds) * (1 + snd_seq_direct_poll_count(seq)));
+	pfds[0].fd = seq->poll_fd;
+	pfds[0].events = POLLIN;
+	for (d = seq->direct_in; d; d = d->in_next) {
+		pfds[n].fd = d->efd;
+		pfds[n].events = POLLIN;
+		n++;
+	}
+	if (poll(pfds, n, -1) < 0)
+		return -errno;
+	for (i = 1; i < n; i++) {
+		if (pfds[i].revents & POLLIN)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * hand out up to count events of the links; with wait set, block until
+ * a link or the kernel has input.  Returns the number of events stored.
+ */
+int snd_seq_direct_input(snd_seq_t *seq, snd_seq_event_t **evs,
+			 unsigned int count, int wait)
+{
+	snd_seq_direct_t *d;
+	snd_seq_event_t *ev;
+	unsigned int n = 0;
+	int err;
+
+	direct_release(seq);
+	for (;;) {
+		for (d = seq->direct_in; d && n < count; d = d->in_next) {
+			while (n < count && (ev = direct_take(d)) != NULL) {
+				if (seq->ifilter && snd_seq_event_filtered(seq, ev))
+					continue;
+				evs[n++] = ev;
+			}
+		}
+		if (n || !wait)
+			return n;
+		err = direct_wait(seq);
+		if (err <= 0)
+			return err;
+	}
+}
+
+/* the number of unread events on the links */
+unsigned int snd_seq_direct_pending(snd_seq_t *seq)
+{
+	snd_seq_direct_t *d;
+	unsigned int n = 0;
+
+	for (d = seq->direct_in; d; d = d->in_next)
+		n += __atomic_load_n(&d->head, __ATOMIC_ACQUIRE) - d->read;
+	return n;
+}
+
+/* the number of poll descriptors of the links */
+unsigned int snd_seq_direct_poll_count(snd_seq_t *seq)
+{
+	snd_seq_direct_t *d;
+	unsigned int n = 0;
+
+	for (d = seq->direct_in; d; d = d->in_next)
+		n++;
+	return n;
+}
+
+/* fill the poll descriptors of the links */
+unsigned int snd_seq_direct_poll_descriptors(snd_seq_t *seq, struct pollfd *pfds,
+					     unsigned int space)
+{
+	snd_seq_direct_t *d;
+	unsigned int n = 0;
+
+	for (d = seq->direct_in; d && n < space; d = d->in_next) {
+		pfds[n].fd = d->efd;
+		pfds[n].events = POLLIN;
+		pfds[n].revents = 0;
+		n++;
+	}
+	return n;
+}
+
+#endif /* DOC_HIDDEN */
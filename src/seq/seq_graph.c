@@ -0,0 +1,517 @@
+/*
+ *  Sequencer Interface - client, port and subscription graph snapshot
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * The graph keeps copies of all client and port infos and of all
+ * subscriptions.  The kernel has no bulk query, so a full scan still
+ * costs one ioctl per client, port and subscription; but only the ports
+ * with a non-zero read_use are asked for their subscribers, and after
+ * the scan the graph is kept current from the announce events of the
+ * system port 0:1, which re-query just the client or port concerned.
+ *
+ * Clients are kept sorted by number, ports by address; subscriptions
+ * are kept in the order they were found.
+ */
+
+#include "seq_local.h"
+
+#ifndef DOC_HIDDEN
+
+struct _snd_seq_graph {
+	snd_seq_t *seq;
+	snd_seq_client_info_t *clients;
+	unsigned int clients_count, clients_alloc;
+	snd_seq_port_info_t *ports;
+	unsigned int ports_count, ports_alloc;
+	snd_seq_port_subscribe_t *subs;
+	unsigned int subs_count, subs_alloc;
+};
+
+/* make room for one more element at index pos */
+static void *graph_insert(void *array, unsigned int *count, unsigned int *alloc,
+			  unsigned int pos, size_t size)
+{
+	char *p = array;
+
+	if (*count == *alloc) {
+		unsigned int n = *alloc ? *alloc * 2 : 16;
+		p = realloc(array, n * size);
+		if (!p)
+			return NULL;
+		*alloc = n;
+	}
+	memmove(p + (pos + 1) * size, p + pos * size, (*count - pos) * size);
+	(*count)++;
+	return p;
+}
+
+static void graph_remove(void *array, unsigned int *count, unsigned int pos,
+			 size_t size)
+{
+	char *p = array;
+
+	(*count)--;
+	memmove(p + pos * size, p + (pos + 1) * size, (*count - pos) * size);
+}
+
+/* index of the client, or of the place to insert it when not found */
+static unsigned int graph_client_pos(snd_seq_graph_t *graph, int client, int *found)
+{
+	unsigned int i;
+	int c;
+
+	*found = 0;
+	for (i = 0; i < graph->clients_count; i++) {
+		c = snd_seq_client_info_get_client(&graph->clients[i]);
+		if (c >= client) {
+			*found = c == client;
+			break;
+		}
+	}
+	return i;
+}
+
+static int addr_cmp(const snd_seq_addr_t *a, int client, int port)
+{
+	if (a->client != client)
+		return a->client - client;
+	return a->port - port;
+}
+
+static unsigned int graph_port_pos(snd_seq_graph_t *graph, int client, int port, int *found)
+{
+	unsigned int i;
+	int d;
+
+	*found = 0;
+	for (i = 0; i < graph->ports_count; i++) {
+		d = addr_cmp(snd_seq_port_info_get_addr(&graph->ports[i]), client, port);
+		if (d >= 0) {
+			*found = d == 0;
+			break;
+		}
+	}
+	return i;
+}
+
+static int graph_sub_pos(snd_seq_graph_t *graph, const snd_seq_addr_t *sender,
+			 const snd_seq_addr_t *dest)
+{
+	const snd_seq_port_subscribe_t *sub;
+	unsigned int i;
+
+	for (i = 0; i < graph->subs_count; i++) {
+		sub = &graph->subs[i];
+		if (!addr_cmp(snd_seq_port_subscribe_get_sender(sub),
+			      sender->client, sender->port) &&
+		    !addr_cmp(snd_seq_port_subscribe_get_dest(sub),
+			      dest->client, dest->port))
+			return i;
+	}
+	return -1;
+}
+
+static int graph_set_client(snd_seq_graph_t *graph, const snd_seq_client_info_t *info)
+{
+	unsigned int pos;
+	int found;
+	void *p;
+
+	pos = graph_client_pos(graph, snd_seq_client_info_get_client(info), &found);
+	if (!found) {
+		p = graph_insert(graph->clients, &graph->clients_count,
+				 &graph->clients_alloc, pos, sizeof(*info));
+		if (!p)
+			return -ENOMEM;
+		graph->clients = p;
+	}
+	graph->clients[pos] = *info;
+	return 0;
+}
+
+static int graph_set_port(snd_seq_graph_t *graph, const snd_seq_port_info_t *info)
+{
+	const snd_seq_addr_t *addr = snd_seq_port_info_get_addr(info);
+	unsigned int pos;
+	int found;
+	void *p;
+
+	pos = graph_port_pos(graph, addr->client, addr->port, &found);
+	if (!found) {
+		p = graph_insert(graph->ports, &graph->ports_count,
+				 &graph->ports_alloc, pos, sizeof(*info));
+		if (!p)
+			return -ENOMEM;
+		graph->ports = p;
+	}
+	graph->ports[pos] = *info;
+	return 0;
+}
+
+static int graph_set_sub(snd_seq_graph_t *graph, const snd_seq_port_subscribe_t *sub)
+{
+	int pos;
+	void *p;
+
+	pos = graph_sub_pos(graph, snd_seq_port_subscribe_get_sender(sub),
+			    snd_seq_port_subscribe_get_dest(sub));
+	if (pos < 0) {
+		pos = graph->subs_count;
+		p = graph_insert(graph->subs, &graph->subs_count,
+				 &graph->subs_alloc, pos, sizeof(*sub));
+		if (!p)
+			return -ENOMEM;
+		graph->subs = p;
+	}
+	graph->subs[pos] = *sub;
+	return 0;
+}
+
+/* drop the subscriptions from or to the port; port < 0 means any port */
+static void graph_drop_subs(snd_seq_graph_t *graph, int client, int port)
+{
+	const snd_seq_addr_t *sender, *dest;
+	unsigned int i = 0;
+
+	while (i < graph->subs_count) {
+		sender = snd_seq_port_subscribe_get_sender(&graph->subs[i]);
+		dest = snd_seq_port_subscribe_get_dest(&graph->subs[i]);
+		if ((sender->client == client &&
+		     (port < 0 || sender->port == port)) ||
+		    (dest->client == client &&
+		     (port < 0 || dest->port == port)))
+			graph_remove(graph->subs, &graph->subs_count, i,
+				     sizeof(*graph->subs));
+		else
+			i++;
+	}
+}
+
+static void graph_drop_port(snd_seq_graph_t *graph, int client, int port)
+{
+	unsigned int pos;
+	int found;
+
+	pos = graph_port_pos(graph, client, port, &found);
+	if (found)
+		graph_remove(graph->ports, &graph->ports_count, pos,
+			     sizeof(*graph->ports));
+	graph_drop_subs(graph, client, port);
+}
+
+static void graph_drop_client(snd_seq_graph_t *graph, int client)
+{
+	unsigned int pos;
+	int found;
+
+	pos = graph_client_pos(graph, client, &found);
+	if (found)
+		graph_remove(graph->clients, &graph->clients_count, pos,
+			     sizeof(*graph->clients));
+	pos = graph_port_pos(graph, client, 0, &found);
+	while (pos < graph->ports_count &&
+	       snd_seq_port_info_get_client(&graph->ports[pos]) == client)
+		graph_remove(graph->ports, &graph->ports_count, pos,
+			     sizeof(*graph->ports));
+	graph_drop_subs(graph, client, -1);
+}
+
+/* read the subscriptions going out of the port */
+static int graph_scan_subs(snd_seq_graph_t *graph, const snd_seq_port_info_t *pinfo)
+{
+	snd_seq_query_subscribe_t query;
+	snd_seq_port_subscribe_t sub;
+	int err;
+
+	if (!snd_seq_port_info_get_read_use(pinfo))
+		return 0;
+	memset(&query, 0, sizeof(query));
+	snd_seq_query_subscribe_set_root(&query, snd_seq_port_info_get_addr(pinfo));
+	snd_seq_query_subscribe_set_type(&query, SND_SEQ_QUERY_SUBS_READ);
+	while (snd_seq_query_port_subscribers(graph->seq, &query) >= 0) {
+		memset(&sub, 0, sizeof(sub));
+		snd_seq_port_subscribe_set_sender(&sub, snd_seq_port_info_get_addr(pinfo));
+		snd_seq_port_subscribe_set_dest(&sub, snd_seq_query_subscribe_get_addr(&query));
+		snd_seq_port_subscribe_set_queue(&sub, snd_seq_query_subscribe_get_queue(&query));
+		snd_seq_port_subscribe_set_exclusive(&sub, snd_seq_query_subscribe_get_exclusive(&query));
+		snd_seq_port_subscribe_set_time_update(&sub, snd_seq_query_subscribe_get_time_update(&query));
+		snd_seq_port_subscribe_set_time_real(&sub, snd_seq_query_subscribe_get_time_real(&query));
+		err = graph_set_sub(graph, &sub);
+		if (err < 0)
+			return err;
+		snd_seq_query_subscribe_set_index(&query,
+			snd_seq_query_subscribe_get_index(&query) + 1);
+	}
+	return 0;
+}
+
+static int graph_scan_ports(snd_seq_graph_t *graph, int client)
+{
+	snd_seq_port_info_t pinfo;
+	int err;
+
+	memset(&pinfo, 0, sizeof(pinfo));
+	snd_seq_port_info_set_client(&pinfo, client);
+	snd_seq_port_info_set_port(&pinfo, -1);
+	while (snd_seq_query_next_port(graph->seq, &pinfo) >= 0) {
+		err = graph_set_port(graph, &pinfo);
+		if (err < 0)
+			return err;
+		err = graph_scan_subs(graph, &pinfo);
+		if (err < 0)
+			return err;
+	}
+	return 0;
+}
+
+static int graph_scan_client(snd_seq_graph_t *graph, int client)
+{
+	snd_seq_client_info_t cinfo;
+	int err;
+
+	graph_drop_client(graph, client);
+	err = snd_seq_get_any_client_info(graph->seq, client, &cinfo);
+	if (err < 0)
+		return err == -ENOENT ? 0 : err;	/* gone already */
+	err = graph_set_client(graph, &cinfo);
+	if (err < 0)
+		return err;
+	return graph_scan_ports(graph, client);
+}
+
+#endif /* DOC_HIDDEN */
+
+/**
+ * \brief create a snapshot of the sequencer clients, ports and subscriptions
+ * \param seq sequencer handle used for the queries
+ * \param graphp the returned graph
+ * \return 0 on success otherwise a negative error code
+ *
+ * The graph is filled at once like with snd_seq_graph_refresh().  To keep
+ * it current, subscribe a port of \a seq to the system announce port
+ * (#SND_SEQ_CLIENT_SYSTEM:#SND_SEQ_PORT_SYSTEM_ANNOUNCE) and pass the
+ * events received from it to snd_seq_graph_update().
+ *
+ * \sa snd_seq_graph_free(), snd_seq_graph_refresh(), snd_seq_graph_update()
+ */
+int snd_seq_graph_create(snd_seq_t *seq, snd_seq_graph_t **graphp)
+{
+	snd_seq_graph_t *graph;
+	int err;
+
+	assert(seq && graphp);
+	graph = calloc(1, sizeof(*graph));
+	if (!graph)
+		return -ENOMEM;
+	graph->seq = seq;
+	err = snd_seq_graph_refresh(graph);
+	if (err < 0) {
+		snd_seq_graph_free(graph);
+		return err;
+	}
+	*graphp = graph;
+	return 0;
+}
+
+/**
+ * \brief free a graph snapshot
+ * \param graph the graph
+ */
+void snd_seq_graph_free(snd_seq_graph_t *graph)
+{
+	if (!graph)
+		return;
+	free(graph->clients);
+	free(graph->ports);
+	free(graph->subs);
+	free(graph);
+}
+
+/**
+ * \brief read the whole graph again
+ * \param graph the graph
+ * \return 0 on success otherwise a negative error code
+ *
+ * It queries every client, port and subscription; only the ports
+ * which are read by someone are asked for their subscribers.
+ */
+int snd_seq_graph_refresh(snd_seq_graph_t *graph)
+{
+	snd_seq_client_info_t cinfo;
+	int err;
+
+	assert(graph);
+	graph->clients_count = graph->ports_count = graph->subs_count = 0;
+	memset(&cinfo, 0, sizeof(cinfo));
+	snd_seq_client_info_set_client(&cinfo, -1);
+	while (snd_seq_query_next_client(graph->seq, &cinfo) >= 0) {
+		err = graph_set_client(graph, &cinfo);
+		if (err < 0)
+			return err;
+		err = graph_scan_ports(graph, snd_seq_client_info_get_client(&cinfo));
+		if (err < 0)
+			return err;
+	}
+	return 0;
+}
+
+/**
+ * \brief apply an announce event to the graph
+ * \param graph the graph
+ * \param ev the event received from the system announce port
+ * \return 1 if the graph was changed, 0 if the event doesn't concern it,
+ *         otherwise a negative error code
+ *
+ * Only the client, port or subscription named in the event is queried
+ * again.  The pointers returned by the get functions of the graph are
+ * invalid after a change.
+ */
+int snd_seq_graph_update(snd_seq_graph_t *graph, const snd_seq_event_t *ev)
+{
+	const snd_seq_addr_t *addr = &ev->data.addr;
+	snd_seq_client_info_t cinfo;
+	snd_seq_port_info_t pinfo;
+	snd_seq_port_subscribe_t sub;
+	int err, pos;
+
+	assert(graph && ev);
+	switch (ev->type) {
+	case SND_SEQ_EVENT_CLIENT_START:
+		err = graph_scan_client(graph, addr->client);
+		break;
+	case SND_SEQ_EVENT_CLIENT_EXIT:
+		graph_drop_client(graph, addr->client);
+		err = 0;
+		break;
+	case SND_SEQ_EVENT_CLIENT_CHANGE:
+		err = snd_seq_get_any_client_info(graph->seq, addr->client, &cinfo);
+		if (err >= 0)
+			err = graph_set_client(graph, &cinfo);
+		else if (err == -ENOENT) {
+			graph_drop_client(graph, addr->client);
+			err = 0;
+		}
+		break;
+	case SND_SEQ_EVENT_PORT_START:
+	case SND_SEQ_EVENT_PORT_CHANGE:
+		err = snd_seq_get_any_port_info(graph->seq, addr->client,
+						addr->port, &pinfo);
+		if (err >= 0)
+			err = graph_set_port(graph, &pinfo);
+		else if (err == -ENOENT) {
+			graph_drop_port(graph, addr->client, addr->port);
+			err = 0;
+		}
+		break;
+	case SND_SEQ_EVENT_PORT_EXIT:
+		graph_drop_port(graph, addr->client, addr->port);
+		err = 0;
+		break;
+	case SND_SEQ_EVENT_PORT_SUBSCRIBED:
+		memset(&sub, 0, sizeof(sub));
+		snd_seq_port_subscribe_set_sender(&sub, &ev->data.connect.sender);
+		snd_seq_port_subscribe_set_dest(&sub, &ev->data.connect.dest);
+		err = snd_seq_get_port_subscription(graph->seq, &sub);
+		if (err >= 0)
+			err = graph_set_sub(graph, &sub);
+		else if (err == -ENOENT)
+			err = 0;	/* removed meanwhile */
+		break;
+	case SND_SEQ_EVENT_PORT_UNSUBSCRIBED:
+		pos = graph_sub_pos(graph, &ev->data.connect.sender,
+				    &ev->data.connect.dest);
+		if (pos >= 0)
+			graph_remove(graph->subs, &graph->subs_count, pos,
+				     sizeof(*graph->subs));
+		err = 0;
+		break;
+	default:
+		return 0;
+	}
+	return err < 0 ? err : 1;
+}
+
+/**
+ * \brief get the number of clients in the graph
+ * \param graph the graph
+ * \return the number of clients
+ */
+unsigned int snd_seq_graph_get_clients_count(const snd_seq_graph_t *graph)
+{
+	assert(graph);
+	return graph->clients_count;
+}
+
+/**
+ * \brief get a client of the graph
+ * \param graph the graph
+ * \param idx the index, clients are sorted by number
+ * \return the client info or NULL when \a idx is out of range
+ */
+const snd_seq_client_info_t *snd_seq_graph_get_client(const snd_seq_graph_t *graph, unsigned int idx)
+{
+	assert(graph);
+	return idx < graph->clients_count ? &graph->clients[idx] : NULL;
+}
+
+/**
+ * \brief get the number of ports in the graph
+ * \param graph the graph
+ * \return the number of ports
+ */
+unsigned int snd_seq_graph_get_ports_count(const snd_seq_graph_t *graph)
+{
+	assert(graph);
+	return graph->ports_count;
+}
+
+/**
+ * \brief get a port of the graph
+ * \param graph the graph
+ * \param idx the index, ports are sorted by client and port number
+ * \return the port info or NULL when \a idx is out of range
+ */
+const snd_seq_port_info_t *snd_seq_graph_get_port(const snd_seq_graph_t *graph, unsigned int idx)
+{
+	assert(graph);
+	return idx < graph->ports_count ? &graph->ports[idx] : NULL;
+}
+
+/**
+ * \brief get the number of subscriptions in the graph
+ * \param graph the graph
+ * \return the number of subscriptions
+ */
+unsigned int snd_seq_graph_get_subs_count(const snd_seq_graph_t *graph)
+{
+	assert(graph);
+	return graph->subs_count;
+}
+
+/**
+ * \brief get a subscription of the graph
+ * \param graph the graph
+ * \param idx the index
+ * \return the subscription or NULL when \a idx is out of range
+ */
+const snd_seq_port_subscribe_t *snd_seq_graph_get_sub(const snd_seq_graph_t *graph, unsigned int idx)
+{
+	assert(graph);
+	return idx < graph->subs_count ? &graph->subs[idx] : NULL;
+}
@@ -492,6 +492,7 @@ int snd_seq_hw_open(snd_seq_t **handle, const char *name, int streams, int mode)
 	hw->version = ver;
 	if (streams & SND_SEQ_OPEN_OUTPUT) {
 		seq->obuf = (char *) malloc(seq->obufsize = SND_SEQ_OBUF_SIZE);
+		seq->obufbase = seq->obufsize;
 		if (!seq->obuf) {
 			free(hw);
 			free(seq);
@@ -70,6 +70,12 @@ typedef struct {
 	int (*query_next_port)(snd_seq_t *seq, snd_seq_port_info_t *info);
 } snd_seq_ops_t;
 
+#define SND_SEQ_IFILTER_TYPE	(1<<0)
+#define SND_SEQ_IFILTER_PORT	(1<<1)
+#define SND_SEQ_IFILTER_CHANNEL	(1<<2)
+
+typedef struct snd_seq_direct snd_seq_direct_t;
+
 struct _snd_seq {
 	char *name;
 	snd_seq_type_t type;
@@ -84,14 +90,48 @@ struct _snd_seq {
 	char *obuf;		/* output buffer */
 	size_t obufsize;		/* output buffer size */
 	size_t obufused;		/* output buffer used size */
+	size_t obufbase;	/* size set by the application */
+	size_t obufmax;		/* growth limit, 0 = fixed size */
+	unsigned long oflushes;	/* writes done by snd_seq_drain_output() */
+	unsigned long oflushbytes;	/* bytes written by them */
+	size_t oreserve_pos;	/* obufused when the events were reserved */
+	unsigned int oreserved;	/* events reserved in place, see output_reserve */
 	snd_seq_event_t *ibuf;	/* input buffer */
 	size_t ibufptr;		/* current pointer of input buffer */
 	size_t ibuflen;		/* queued length */
 	size_t ibufsize;		/* input buffer size */
+	unsigned int ifilter;	/* SND_SEQ_IFILTER_* bitmaps in use */
+	unsigned int ifilter_type[8];	/* allowed event types */
+	unsigned int ifilter_port[8];	/* allowed destination ports */
+	unsigned int ifilter_channel;	/* allowed channels of channel events */
 	snd_seq_event_t *tmpbuf;	/* temporary event for extracted event */
 	size_t tmpbufsize;		/* size of errbuf */
+	snd_seq_direct_t *direct_out;	/* direct links from this handle */
+	snd_seq_direct_t *direct_in;	/* direct links to this handle */
+	struct snd_seq_qclock *qclock;	/* see snd_seq_get_queue_clock() */
 };
 
 int snd_seq_hw_open(snd_seq_t **handle, const char *name, int streams, int mode);
 
+/* make local functions really local */
+#define snd_seq_event_filtered		snd1_seq_event_filtered
+#define snd_seq_direct_close		snd1_seq_direct_close
+#define snd_seq_direct_output		snd1_seq_direct_output
+#define snd_seq_direct_input		snd1_seq_direct_input
+#define snd_seq_direct_pending		snd1_seq_direct_pending
+#define snd_seq_direct_poll_count	snd1_seq_direct_poll_count
+#define snd_seq_direct_poll_descriptors	snd1_seq_direct_poll_descriptors
+
+int snd_seq_event_filtered(snd_seq_t *seq, const snd_seq_event_t *ev);
+
+/* direct links between the handles of a process, see seq_direct.c */
+void snd_seq_direct_close(snd_seq_t *seq);
+int snd_seq_direct_output(snd_seq_t *seq, snd_seq_event_t *ev);
+int snd_seq_direct_input(snd_seq_t *seq, snd_seq_event_t **evs,
+			 unsigned int count, int wait);
+unsigned int snd_seq_direct_pending(snd_seq_t *seq);
+unsigned int snd_seq_direct_poll_count(snd_seq_t *seq);
+unsigned int snd_seq_direct_poll_descriptors(snd_seq_t *seq, struct pollfd *pfds,
+					     unsigned int space);
+
 #endif
@@ -126,6 +126,32 @@ static const struct extra_event_list_t {
 };
 
 #define numberof(ary)	(sizeof(ary)/sizeof(ary[0]))
+
+/* by sequencer event type: status_event[] index + 1, EXTRA_EVENT + extra_event[] index, 0 if none */
+#define EXTRA_EVENT	0x40
+static const unsigned char decode_index[256] = {
+	[SND_SEQ_EVENT_NOTEOFF] = 0 + 1,
+	[SND_SEQ_EVENT_NOTEON] = 1 + 1,
+	[SND_SEQ_EVENT_KEYPRESS] = 2 + 1,
+	[SND_SEQ_EVENT_CONTROLLER] = 3 + 1,
+	[SND_SEQ_EVENT_PGMCHANGE] = 4 + 1,
+	[SND_SEQ_EVENT_CHANPRESS] = 5 + 1,
+	[SND_SEQ_EVENT_PITCHBEND] = 6 + 1,
+	[SND_SEQ_EVENT_SYSEX] = ST_SYSEX + 1,
+	[SND_SEQ_EVENT_QFRAME] = ST_SPECIAL + 1 + 1,
+	[SND_SEQ_EVENT_SONGPOS] = ST_SPECIAL + 2 + 1,
+	[SND_SEQ_EVENT_SONGSEL] = ST_SPECIAL + 3 + 1,
+	[SND_SEQ_EVENT_TUNE_REQUEST] = ST_SPECIAL + 6 + 1,
+	[SND_SEQ_EVENT_CLOCK] = ST_SPECIAL + 8 + 1,
+	[SND_SEQ_EVENT_START] = ST_SPECIAL + 10 + 1,
+	[SND_SEQ_EVENT_CONTINUE] = ST_SPECIAL + 11 + 1,
+	[SND_SEQ_EVENT_STOP] = ST_SPECIAL + 12 + 1,
+	[SND_SEQ_EVENT_SENSING] = ST_SPECIAL + 14 + 1,
+	[SND_SEQ_EVENT_RESET] = ST_SPECIAL + 15 + 1,
+	[SND_SEQ_EVENT_CONTROL14] = EXTRA_EVENT + 0,
+	[SND_SEQ_EVENT_NONREGPARAM] = EXTRA_EVENT + 1,
+	[SND_SEQ_EVENT_REGPARAM] = EXTRA_EVENT + 2,
+};
 #endif /* DOC_HIDDEN */
 
 /**
@@ -294,6 +320,72 @@ int snd_midi_event_resize_buffer(snd_midi_event_t *dev, size_t bufsize)
 	return 0;
 }
 
+/* the byte encoder, shared by the single and the bulk interfaces */
+static inline int encode_byte(snd_midi_event_t *dev, int c, snd_seq_event_t *ev)
+{
+	int rc = 0;
+
+	c &= 0xff;
+
+	if (c >= MIDI_CMD_COMMON_CLOCK) {
+		/* real-time event */
+		ev->type = status_event[ST_SPECIAL + c - 0xf0].event;
+		ev->flags &= ~SND_SEQ_EVENT_LENGTH_MASK;
+		ev->flags |= SND_SEQ_EVENT_LENGTH_FIXED;
+		return ev->type != SND_SEQ_EVENT_NONE;
+	}
+
+	if ((c & 0x80) &&
+	    (c != MIDI_CMD_COMMON_SYSEX_END || dev->type != ST_SYSEX)) {
+		/* new command */
+		dev->buf[0] = c;
+		if ((c & 0xf0) == 0xf0) /* system message */
+			dev->type = (c & 0x0f) + ST_SPECIAL;
+		else
+			dev->type = (c >> 4) & 0x07;
+		dev->read = 1;
+		dev->qlen = status_event[dev->type].qlen;
+	} else {
+		if (dev->qlen > 0) {
+			/* rest of command */
+			dev->buf[dev->read++] = c;
+			if (dev->type != ST_SYSEX)
+				dev->qlen--;
+		} else {
+			/* running status */
+			dev->buf[1] = c;
+			dev->qlen = status_event[dev->type].qlen - 1;
+			dev->read = 2;
+		}
+	}
+	if (dev->qlen == 0) {
+		ev->type = status_event[dev->type].event;
+		ev->flags &= ~SND_SEQ_EVENT_LENGTH_MASK;
+		ev->flags |= SND_SEQ_EVENT_LENGTH_FIXED;
+		if (status_event[dev->type].encode) /* set data values */
+			status_event[dev->type].encode(dev, ev);
+		if (dev->type >= ST_SPECIAL)
+			dev->type = ST_INVALID;
+		rc = 1;
+	} else 	if (dev->type == ST_SYSEX) {
+		if (c == MIDI_CMD_COMMON_SYSEX_END ||
+		    dev->read >= dev->bufsize) {
+			ev->flags &= ~SND_SEQ_EVENT_LENGTH_MASK;
+			ev->flags |= SND_SEQ_EVENT_LENGTH_VARIABLE;
+			ev->type = SND_SEQ_EVENT_SYSEX;
+			ev->data.ext.len = dev->read;
+			ev->data.ext.ptr = dev->buf;
+			if (c != MIDI_CMD_COMMON_SYSEX_END)
+				dev->read = 0; /* continue to parse */
+			else
+				reset_encode(dev); /* all parsed */
+			rc = 1;
+		}
+	}
+
+	return rc;
+}
+
 /**
  * \brief Encodes bytes to sequencer event.
  * \param[in] dev MIDI event parser.
@@ -365,7 +457,7 @@ long snd_midi_event_encode(snd_midi_event_t *dev, const unsigned char *buf, long
 	ev->type = SND_SEQ_EVENT_NONE;
 
 	while (count-- > 0) {
-		rc = snd_midi_event_encode_byte(dev, *buf++, ev);
+		rc = encode_byte(dev, *buf++, ev);
 		result++;
 		if (rc < 0)
 			return rc;
@@ -376,6 +468,56 @@ long snd_midi_event_encode(snd_midi_event_t *dev, const unsigned char *buf, long
 	return result;
 }
 
+/**
+ * \brief Encodes a raw MIDI stream to several sequencer events.
+ * \param[in] dev MIDI event parser.
+ * \param[in] buf Buffer containing the raw MIDI stream.
+ * \param[in] count Number of bytes in \a buf.
+ * \param[out] evs Array of sequencer events.
+ * \param[in] nevs Number of events in \a evs.
+ * \param[out] nencoded Number of completed events stored in \a evs.
+ * \return The number of bytes consumed, or a negative error code.
+ *
+ * This works like calling #snd_midi_event_encode repeatedly: the bytes are
+ * parsed in one pass, running status included, and each completed message
+ * goes to the next event of \a evs.  Only the type, the length flags and
+ * the data of the events are set, as #snd_midi_event_encode does.
+ *
+ * Parsing stops when \a evs is full, when \a buf is consumed, or after a
+ * System Exclusive event, whose data points into the parser buffer and
+ * would be overwritten by the next one.  An incomplete message at the end
+ * of \a buf is kept in the parser and completed by the next call.
+ *
+ * \sa snd_midi_event_encode, snd_midi_event_decode_many
+ */
+long snd_midi_event_encode_many(snd_midi_event_t *dev, const unsigned char *buf, long count,
+				snd_seq_event_t *evs, unsigned int nevs, unsigned int *nencoded)
+{
+	const unsigned char *p = buf, *end = buf + count;
+	unsigned int n = 0;
+	int rc;
+
+	*nencoded = 0;
+	if (count <= 0 || nevs == 0)
+		return 0;
+	evs[0].type = SND_SEQ_EVENT_NONE;
+	while (p < end) {
+		rc = encode_byte(dev, *p++, &evs[n]);
+		if (rc < 0) {
+			*nencoded = n;
+			return rc;
+		}
+		if (rc == 0)
+			continue;
+		rc = evs[n].type == SND_SEQ_EVENT_SYSEX;
+		if (++n == nevs || rc)
+			break;
+		evs[n].type = SND_SEQ_EVENT_NONE;
+	}
+	*nencoded = n;
+	return p - buf;
+}
+
 /**
  * \brief Encodes byte to sequencer event.
  * \param[in] dev MIDI event parser.
@@ -397,67 +539,7 @@ long snd_midi_event_encode(snd_midi_event_t *dev, const unsigned char *buf, long
  */
 int snd_midi_event_encode_byte(snd_midi_event_t *dev, int c, snd_seq_event_t *ev)
 {
-	int rc = 0;
-
-	c &= 0xff;
-
-	if (c >= MIDI_CMD_COMMON_CLOCK) {
-		/* real-time event */
-		ev->type = status_event[ST_SPECIAL + c - 0xf0].event;
-		ev->flags &= ~SND_SEQ_EVENT_LENGTH_MASK;
-		ev->flags |= SND_SEQ_EVENT_LENGTH_FIXED;
-		return ev->type != SND_SEQ_EVENT_NONE;
-	}
-
-	if ((c & 0x80) &&
-	    (c != MIDI_CMD_COMMON_SYSEX_END || dev->type != ST_SYSEX)) {
-		/* new command */
-		dev->buf[0] = c;
-		if ((c & 0xf0) == 0xf0) /* system message */
-			dev->type = (c & 0x0f) + ST_SPECIAL;
-		else
-			dev->type = (c >> 4) & 0x07;
-		dev->read = 1;
-		dev->qlen = status_event[dev->type].qlen;
-	} else {
-		if (dev->qlen > 0) {
-			/* rest of command */
-			dev->buf[dev->read++] = c;
-			if (dev->type != ST_SYSEX)
-				dev->qlen--;
-		} else {
-			/* running status */
-			dev->buf[1] = c;
-			dev->qlen = status_event[dev->type].qlen - 1;
-			dev->read = 2;
-		}
-	}
-	if (dev->qlen == 0) {
-		ev->type = status_event[dev->type].event;
-		ev->flags &= ~SND_SEQ_EVENT_LENGTH_MASK;
-		ev->flags |= SND_SEQ_EVENT_LENGTH_FIXED;
-		if (status_event[dev->type].encode) /* set data values */
-			status_event[dev->type].encode(dev, ev);
-		if (dev->type >= ST_SPECIAL)
-			dev->type = ST_INVALID;
-		rc = 1;
-	} else 	if (dev->type == ST_SYSEX) {
-		if (c == MIDI_CMD_COMMON_SYSEX_END ||
-		    dev->read >= dev->bufsize) {
-			ev->flags &= ~SND_SEQ_EVENT_LENGTH_MASK;
-			ev->flags |= SND_SEQ_EVENT_LENGTH_VARIABLE;
-			ev->type = SND_SEQ_EVENT_SYSEX;
-			ev->data.ext.len = dev->read;
-			ev->data.ext.ptr = dev->buf;
-			if (c != MIDI_CMD_COMMON_SYSEX_END)
-				dev->read = 0; /* continue to parse */
-			else
-				reset_encode(dev); /* all parsed */
-			rc = 1;
-		}
-	}
-
-	return rc;
+	return encode_byte(dev, c, ev);
 }
 
 /* encode note event */
@@ -560,20 +642,12 @@ long snd_midi_event_decode(snd_midi_event_t *dev, unsigned char *buf, long count
 	long qlen;
 	unsigned int type;
 
-	if (ev->type == SND_SEQ_EVENT_NONE)
+	type = decode_index[ev->type];
+	if (type == 0)
 		return -ENOENT;
-
-	for (type = 0; type < numberof(status_event); type++) {
-		if (ev->type == status_event[type].event)
-			goto __found;
-	}
-	for (type = 0; type < numberof(extra_event); type++) {
-		if (ev->type == extra_event[type].event)
-			return extra_event[type].decode(dev, buf, count, ev);
-	}
-	return -ENOENT;
-
-      __found:
+	if (type >= EXTRA_EVENT)
+		return extra_event[type - EXTRA_EVENT].decode(dev, buf, count, ev);
+	type--;
 	if (type >= ST_SPECIAL)
 		cmd = 0xf0 + (type - ST_SPECIAL);
 	else
@@ -596,7 +670,6 @@ long snd_midi_event_decode(snd_midi_event_t *dev, unsigned char *buf, long count
 		unsigned char xbuf[4];
 
 		if ((cmd & 0xf0) == 0xf0 || dev->lastcmd != cmd || dev->nostat) {
-			dev->lastcmd = cmd;
 			xbuf[0] = cmd;
 			if (status_event[type].decode)
 				status_event[type].decode(ev, xbuf + 1);
@@ -608,12 +681,52 @@ long snd_midi_event_decode(snd_midi_event_t *dev, unsigned char *buf, long count
 		}
 		if (count < qlen)
 			return -ENOMEM;
+		dev->lastcmd = cmd;	/* only once the message is written */
 		memcpy(buf, xbuf, qlen);
 		return qlen;
 	}
 }
 
 
+/**
+ * \brief Decodes several sequencer events to a MIDI byte stream.
+ * \param[in] dev MIDI event parser.
+ * \param[out] buf Buffer for the resulting MIDI byte stream.
+ * \param[in] count Number of bytes in \a buf.
+ * \param[in] evs Array of sequencer events to decode.
+ * \param[in] nevs Number of events in \a evs.
+ * \param[out] ndecoded Number of events of \a evs processed.
+ * \return The number of bytes written to \a buf, or a negative error code.
+ *
+ * This works like calling #snd_midi_event_decode for each event, with
+ * running status kept across the events.  Events without a MIDI message
+ * are skipped.  Decoding stops before the first event that does not fit
+ * into the rest of \a buf; \a ndecoded tells where to continue.  An
+ * invalid event stops the decoding too, and its error is returned when no
+ * byte has been written.
+ *
+ * \sa snd_midi_event_decode, snd_midi_event_encode_many
+ */
+long snd_midi_event_decode_many(snd_midi_event_t *dev, unsigned char *buf, long count,
+				const snd_seq_event_t *evs, unsigned int nevs, unsigned int *ndecoded)
+{
+	long used = 0, len;
+	unsigned int n;
+
+	for (n = 0; n < nevs; n++) {
+		len = snd_midi_event_decode(dev, buf + used, count - used, &evs[n]);
+		if (len == -ENOENT)
+			continue;
+		if (len < 0) {
+			*ndecoded = n;
+			return used ? used : len;
+		}
+		used += len;
+	}
+	*ndecoded = n;
+	return used;
+}
+
 /* decode note event */
 static void note_decode(const snd_seq_event_t *ev, unsigned char *buf)
 {
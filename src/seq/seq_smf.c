@@ -0,0 +1,658 @@
+/*
+ *  Sequencer Interface - streaming Standard MIDI File player
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/*
+ * The file is mapped, not read: every track is a cursor into the map
+ * with the absolute tick of its next event.  A binary min-heap of the
+ * track cursors, ordered by tick and then track number, merges the
+ * tracks; so an SMF of type 1 plays in the same order as the single
+ * track of an equivalent type 0 file.
+ *
+ * Events are decoded straight into sequencer events with absolute tick
+ * time stamps, in batches.  The only data not pointing into the map are
+ * the F0 system exclusive messages, which need the F0 byte in front of
+ * the stored bytes; they are copied to a scratch buffer owned by the
+ * batch, which grows only when a single message does not fit.
+ * The player queues the events of a batch up to a bounded lookahead in
+ * front of the queue position, read with snd_seq_get_queue_clock().
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "seq_local.h"
+
+#ifndef DOC_HIDDEN
+
+#define SMF_BATCH		64	/* events decoded at once */
+#define SMF_SCRATCH		4096	/* initial sysex scratch size */
+
+struct smf_track {
+	const unsigned char *start;
+	const unsigned char *pos;
+	const unsigned char *end;
+	unsigned int tick;		/* of the event at pos */
+	unsigned char status;		/* running status, 0 = none */
+};
+
+struct snd_seq_smf {
+	unsigned char *map;
+	size_t size;
+	int format;
+	int ppq;			/* ticks per quarter, or per second for SMPTE */
+	int smpte;
+	int port;
+	int queue;
+	unsigned int ntracks;
+	struct smf_track *tracks;
+	unsigned int *heap;		/* track numbers, earliest first */
+	unsigned int heap_len;
+	unsigned char *scratch;		/* F0 sysex data of the batch */
+	size_t scratch_size, scratch_used;
+	snd_seq_event_t batch[SMF_BATCH];
+	unsigned int batch_pos, batch_len;
+};
+
+static inline unsigned int get16(const unsigned char *p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static inline unsigned int get32(const unsigned char *p)
+{
+	return ((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/* variable length quantity; -1 when truncated or longer than 4 bytes */
+static int get_var(struct smf_track *t, unsigned int *val)
+{
+	unsigned int v = 0;
+	int i;
+
+	for (i = 0; i < 4 && t->pos < t->end; i++) {
+		unsigned char c = *t->pos++;
+		v = (v << 7) | (c & 0x7f);
+		if (!(c & 0x80)) {
+			*val = v;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+static inline int heap_less(snd_seq_smf_t *smf, unsigned int a, unsigned int b)
+{
+	unsigned int ta = smf->tracks[a].tick, tb = smf->tracks[b].tick;
+	return ta < tb || (ta == tb && a < b);
+}
+
+static void heap_down(snd_seq_smf_t *smf, unsigned int i)
+{
+	unsigned int *heap = smf->heap;
+	unsigned int child, t = heap[i];
+
+	for (;;) {
+		child = 2 * i + 1;
+		if (child >= smf->heap_len)
+			break;
+		if (child + 1 < smf->heap_len &&
+		    heap_less(smf, heap[child + 1], heap[child]))
+			child++;
+		if (!heap_less(smf, heap[child], t))
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = t;
+}
+
+/* drop the earliest track from the heap */
+static void heap_pop(snd_seq_smf_t *smf)
+{
+	smf->heap[0] = smf->heap[--smf->heap_len];
+	if (smf->heap_len)
+		heap_down(smf, 0);
+}
+
+static void smf_event_init(snd_seq_smf_t *smf, snd_seq_event_t *ev,
+			   unsigned int tick)
+{
+	memset(ev, 0, sizeof(*ev));
+	ev->flags = SND_SEQ_TIME_STAMP_TICK | SND_SEQ_TIME_MODE_ABS;
+	ev->time.tick = tick;
+	ev->queue = smf->queue;
+	ev->source.port = smf->port;
+	ev->dest.client = SND_SEQ_ADDRESS_SUBSCRIBERS;
+	ev->dest.port = SND_SEQ_ADDRESS_UNKNOWN;
+}
+
+/*
+ * decode the event of the earliest track into ev;
+ * returns 1 with an event, 0 for an event not played, -1 at the end of
+ * the track and -EAGAIN when a sysex doesn't fit the scratch buffer
+ */
+static int smf_decode(snd_seq_smf_t *smf, struct smf_track *t,
+		      snd_seq_event_t *ev)
+{
+	const unsigned char *start = t->pos;
+	unsigned char status, type, d1, d2 = 0;
+	unsigned int len;
+
+	if (t->pos >= t->end)
+		return -1;
+	status = *t->pos;
+	if (status & 0x80)
+		t->pos++;
+	else if (t->status)
+		status = t->status;
+	else
+		return -1;		/* data byte without status */
+
+	if (status < 0xf0) {
+		t->status = status;
+		if (t->pos >= t->end)
+			return -1;
+		d1 = *t->pos++ & 0x7f;
+		if ((status & 0xe0) != 0xc0) {	/* all but program, pressure */
+			if (t->pos >= t->end)
+				return -1;
+			d2 = *t->pos++ & 0x7f;
+		}
+		smf_event_init(smf, ev, t->tick);
+		switch (status & 0xf0) {
+		case 0x80:
+		case 0x90:
+		case 0xa0:
+			ev->type = (status & 0xf0) == 0x80 ? SND_SEQ_EVENT_NOTEOFF :
+				   (status & 0xf0) == 0x90 ? SND_SEQ_EVENT_NOTEON :
+				   SND_SEQ_EVENT_KEYPRESS;
+			ev->data.note.channel = status & 0x0f;
+			ev->data.note.note = d1;
+			ev->data.note.velocity = d2;
+			break;
+		case 0xb0:
+			ev->type = SND_SEQ_EVENT_CONTROLLER;
+			ev->data.control.channel = status & 0x0f;
+			ev->data.control.param = d1;
+			ev->data.control.value = d2;
+			break;
+		case 0xc0:
+		case 0xd0:
+			ev->type = (status & 0xf0) == 0xc0 ? SND_SEQ_EVENT_PGMCHANGE :
+				   SND_SEQ_EVENT_CHANPRESS;
+			ev->data.control.channel = status & 0x0f;
+			ev->data.control.value = d1;
+			break;
+		case 0xe0:
+			ev->type = SND_SEQ_EVENT_PITCHBEND;
+			ev->data.control.channel = status & 0x0f;
+			ev->data.control.value = ((d2 << 7) | d1) - 8192;
+			break;
+		}
+		return 1;
+	}
+
+	/* system exclusive and meta events cancel the running status */
+	t->status = 0;
+	switch (status) {
+	case 0xf0:
+	case 0xf7:
+		if (get_var(t, &len) < 0 || len > (size_t)(t->end - t->pos))
+			return -1;
+		smf_event_init(smf, ev, t->tick);
+		if (status == 0xf0) {
+			unsigned char *buf = smf->scratch + smf->scratch_used;
+
+			if (smf->scratch_used + len + 1 > smf->scratch_size) {
+				t->pos = start;	/* retry in the next batch */
+				return -EAGAIN;
+			}
+			buf[0] = 0xf0;
+			memcpy(buf + 1, t->pos, len);
+			smf->scratch_used += len + 1;
+			ev->data.ext.ptr = buf;
+			ev->data.ext.len = len + 1;
+		} else {
+			/* escaped bytes are sent as they are stored */
+			ev->data.ext.ptr = (void *)t->pos;
+			ev->data.ext.len = len;
+		}
+		t->pos += len;
+		ev->type = SND_SEQ_EVENT_SYSEX;
+		ev->flags |= SND_SEQ_EVENT_LENGTH_VARIABLE;
+		return ev->data.ext.len ? 1 : 0;
+	case 0xff:
+		if (t->pos >= t->end)
+			return -1;
+		type = *t->pos++;
+		if (get_var(t, &len) < 0 || len > (size_t)(t->end - t->pos))
+			return -1;
+		if (type == 0x2f)	/* end of track */
+			return -1;
+		if (type == 0x51 && len == 3) {
+			smf_event_init(smf, ev, t->tick);
+			ev->type = SND_SEQ_EVENT_TEMPO;
+			ev->dest.client = SND_SEQ_CLIENT_SYSTEM;
+			ev->dest.port = SND_SEQ_PORT_SYSTEM_TIMER;
+			ev->data.queue.queue = smf->queue;
+			ev->data.queue.param.value =
+				(t->pos[0] << 16) | (t->pos[1] << 8) | t->pos[2];
+			t->pos += len;
+			/* the tempo isn't used with SMPTE time stamps */
+			return !smf->smpte;
+		}
+		t->pos += len;
+		return 0;
+	default:
+		return -1;		/* not valid in a file */
+	}
+}
+
+static int smf_scratch_grow(snd_seq_smf_t *smf, const struct smf_track *t)
+{
+	struct smf_track tmp = *t;
+	unsigned int len;
+	unsigned char *p;
+
+	tmp.pos++;
+	if (get_var(&tmp, &len) < 0)
+		return -EINVAL;
+	p = realloc(smf->scratch, len + 1);
+	if (!p)
+		return -ENOMEM;
+	smf->scratch = p;
+	smf->scratch_size = len + 1;
+	return 0;
+}
+
+static int smf_parse(snd_seq_smf_t *smf)
+{
+	const unsigned char *p = smf->map, *end = smf->map + smf->size;
+	unsigned int len, division, i, n;
+
+	if (smf->size < 14 || memcmp(p, "MThd", 4) || get32(p + 4) < 6) {
+		SNDERR("not a Standard MIDI File");
+		return -EINVAL;
+	}
+	smf->format = get16(p + 8);
+	n = get16(p + 10);
+	division = get16(p + 12);
+	if (smf->format > 2 || n == 0) {
+		SNDERR("unsupported SMF format %d", smf->format);
+		return -EINVAL;
+	}
+	if (division & 0x8000) {
+		/* frames per second (negative) times ticks per frame */
+		smf->smpte = 1;
+		smf->ppq = -(signed char)(division >> 8) * (division & 0xff);
+	} else
+		smf->ppq = division;
+	if (smf->ppq <= 0) {
+		SNDERR("invalid SMF time division");
+		return -EINVAL;
+	}
+	smf->tracks = calloc(n, sizeof(*smf->tracks));
+	smf->heap = calloc(n, sizeof(*smf->heap));
+	if (!smf->tracks || !smf->heap)
+		return -ENOMEM;
+	p += 8 + get32(p + 4);
+	for (i = 0; i < n && end - p >= 8; ) {
+		len = get32(p + 4);
+		if (memcmp(p, "MTrk", 4)) {
+			/* unknown chunks are skipped */
+			if (len > (size_t)(end - p - 8))
+				break;
+			p += 8 + len;
+			continue;
+		}
+		p += 8;
+		smf->tracks[i].start = p;
+		/* a truncated last track is played as far as it goes */
+		if (len > (size_t)(end - p))
+			len = end - p;
+		smf->tracks[i].end = p + len;
+		p += len;
+		i++;
+	}
+	if (!i) {
+		SNDERR("no track in the SMF");
+		return -EINVAL;
+	}
+	smf->ntracks = i;
+	return 0;
+}
+
+#endif /* DOC_HIDDEN */
+
+/**
+ * \brief open a Standard MIDI File for playing
+ * \param smfp the returned player
+ * \param filename the file name
+ * \return 0 on success otherwise a negative error code
+ *
+ * The file is mapped into memory; formats 0, 1 and 2 are accepted, the
+ * tracks of the format 1 and 2 files are merged by time.  The events go
+ * to the subscribers of port 0 on queue 0 until snd_seq_smf_set_output()
+ * is called.
+ *
+ * \sa snd_seq_smf_close(), snd_seq_smf_play(), snd_seq_smf_read()
+ */
+int snd_seq_smf_open(snd_seq_smf_t **smfp, const char *filename)
+{
+	snd_seq_smf_t *smf;
+	struct stat st;
+	int fd, err;
+
+	assert(smfp && filename);
+	smf = calloc(1, sizeof(*smf));
+	if (!smf)
+		return -ENOMEM;
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		err = -errno;
+		free(smf);
+		return err;
+	}
+	if (fstat(fd, &st) < 0) {
+		err = -errno;
+		close(fd);
+		free(smf);
+		return err;
+	}
+	smf->size = st.st_size;
+	smf->map = smf->size ? mmap(NULL, smf->size, PROT_READ, MAP_PRIVATE, fd, 0) :
+			       MAP_FAILED;
+	err = smf->map == MAP_FAILED ? (smf->size ? -errno : -EINVAL) : 0;
+	close(fd);
+	if (err < 0) {
+		smf->map = NULL;
+		goto _err;
+	}
+	madvise(smf->map, smf->size, MADV_SEQUENTIAL);
+	smf->scratch = malloc(SMF_SCRATCH);
+	if (!smf->scratch) {
+		err = -ENOMEM;
+		goto _err;
+	}
+	smf->scratch_size = SMF_SCRATCH;
+	err = smf_parse(smf);
+	if (err < 0)
+		goto _err;
+	snd_seq_smf_rewind(smf);
+	*smfp = smf;
+	return 0;
+
+ _err:
+	snd_seq_smf_close(smf);
+	return err;
+}
+
+/**
+ * \brief close a Standard MIDI File player
+ * \param smf the player
+ */
+void snd_seq_smf_close(snd_seq_smf_t *smf)
+{
+	if (!smf)
+		return;
+	if (smf->map)
+		munmap(smf->map, smf->size);
+	free(smf->tracks);
+	free(smf->heap);
+	free(smf->scratch);
+	free(smf);
+}
+
+/**
+ * \brief get the format of the file
+ * \param smf the player
+ * \return 0, 1 or 2
+ */
+int snd_seq_smf_get_format(const snd_seq_smf_t *smf)
+{
+	assert(smf);
+	return smf->format;
+}
+
+/**
+ * \brief get the number of tracks of the file
+ * \param smf the player
+ * \return the number of tracks found
+ */
+unsigned int snd_seq_smf_get_tracks(const snd_seq_smf_t *smf)
+{
+	assert(smf);
+	return smf->ntracks;
+}
+
+/**
+ * \brief get the time resolution of the file
+ * \param smf the player
+ * \return ticks per quarter note, or ticks per second for the files
+ *         using SMPTE time
+ */
+int snd_seq_smf_get_ppq(const snd_seq_smf_t *smf)
+{
+	assert(smf);
+	return smf->ppq;
+}
+
+/**
+ * \brief set the source port and the queue of the events
+ * \param smf the player
+ * \param port the port of the playing client, the events go to its subscribers
+ * \param queue the queue scheduling the events
+ *
+ * It applies to the events decoded afterwards.
+ */
+void snd_seq_smf_set_output(snd_seq_smf_t *smf, int port, int queue)
+{
+	assert(smf);
+	smf->port = port;
+	smf->queue = queue;
+}
+
+/**
+ * \brief set the resolution and the initial tempo of the queue
+ * \param smf the player
+ * \param seq sequencer handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The queue set with snd_seq_smf_set_output() gets the time division of
+ * the file and 120 beats per minute, or a second per quarter for SMPTE
+ * time, so that the ticks of the events are the ticks of the queue.
+ */
+int snd_seq_smf_init_queue(snd_seq_smf_t *smf, snd_seq_t *seq)
+{
+	snd_seq_queue_tempo_t *tempo;
+
+	assert(smf && seq);
+	snd_seq_queue_tempo_alloca(&tempo);
+	snd_seq_queue_tempo_set_ppq(tempo, smf->ppq);
+	snd_seq_queue_tempo_set_tempo(tempo, smf->smpte ? 1000000 : 500000);
+	return snd_seq_set_queue_tempo(seq, smf->queue, tempo);
+}
+
+/**
+ * \brief restart playing from the start of the file
+ * \param smf the player
+ *
+ * Events decoded but not queued yet are dropped.
+ */
+void snd_seq_smf_rewind(snd_seq_smf_t *smf)
+{
+	struct smf_track *t;
+	unsigned int i, delta;
+
+	assert(smf);
+	smf->heap_len = 0;
+	for (i = 0; i < smf->ntracks; i++) {
+		t = &smf->tracks[i];
+		t->pos = t->start;
+		t->tick = 0;
+		t->status = 0;
+		if (get_var(t, &delta) < 0)
+			continue;	/* empty track */
+		t->tick = delta;
+		smf->heap[smf->heap_len++] = i;
+	}
+	for (i = smf->heap_len / 2; i-- > 0; )
+		heap_down(smf, i);
+	smf->batch_pos = smf->batch_len = 0;
+	smf->scratch_used = 0;
+}
+
+/**
+ * \brief decode the next events of the file
+ * \param smf the player
+ * \param evs the array to store the events
+ * \param count the size of \a evs
+ * \return the number of events stored, 0 at the end of the file,
+ *         otherwise a negative error code
+ *
+ * The events are in time order, with absolute tick time stamps, from
+ * the port and on the queue given by snd_seq_smf_set_output(), going to
+ * the subscribers of the port; tempo changes go to the system timer.
+ * The data of the system exclusive events is valid until the next call.
+ * Meta events other than the tempo are not returned.
+ */
+int snd_seq_smf_read(snd_seq_smf_t *smf, snd_seq_event_t *evs, unsigned int count)
+{
+	struct smf_track *t;
+	unsigned int n = 0, delta;
+	int err;
+
+	assert(smf && evs);
+	smf->scratch_used = 0;
+	while (n < count && smf->heap_len) {
+		t = &smf->tracks[smf->heap[0]];
+		err = smf_decode(smf, t, &evs[n]);
+		if (err == -EAGAIN) {
+			if (n)
+				break;
+			err = smf_scratch_grow(smf, t);
+			if (err < 0)
+				return err;
+			continue;
+		}
+		if (err < 0 || get_var(t, &delta) < 0) {
+			/* the last event of a track comes without delta */
+			if (err > 0)
+				n++;
+			heap_pop(smf);
+			continue;
+		}
+		if (err > 0)
+			n++;
+		t->tick += delta;
+		heap_down(smf, 0);
+	}
+	return n;
+}
+
+/**
+ * \brief queue the events due within the lookahead
+ * \param smf the player
+ * \param seq sequencer handle
+ * \param lookahead how many ticks in front of the queue position to queue
+ * \return the number of events queued, otherwise a negative error code
+ *
+ * The events with a time stamp before the queue position plus
+ * \a lookahead are put on the output buffer, in place as far as they
+ * are of fixed length, and the buffer is drained.  Call it again before
+ * the queue reaches the lookahead, e.g. every half of it; it returns 0
+ * when nothing was due.  In the non-blocking mode it stops with what was
+ * queued when the output buffer cannot be drained; the remaining events
+ * follow on the next call.  snd_seq_smf_eof() tells when all the events
+ * have been queued.
+ */
+int snd_seq_smf_play(snd_seq_smf_t *smf, snd_seq_t *seq, unsigned int lookahead)
+{
+	snd_seq_queue_status_t status;
+	snd_seq_event_t *ev, *dst;
+	snd_seq_tick_time_t limit;
+	unsigned int i, n, done = 0;
+	int err, ret;
+
+	assert(smf && seq);
+	memset(&status, 0, sizeof(status));
+	err = snd_seq_get_queue_clock(seq, smf->queue, &status);
+	if (err < 0)
+		return err;
+	limit = snd_seq_queue_status_get_tick_time(&status) + lookahead;
+	for (;;) {
+		if (smf->batch_pos == smf->batch_len) {
+			ret = snd_seq_smf_read(smf, smf->batch, SMF_BATCH);
+			if (ret <= 0) {
+				err = ret;
+				break;
+			}
+			smf->batch_pos = 0;
+			smf->batch_len = ret;
+		}
+		ev = &smf->batch[smf->batch_pos];
+		if ((int)(ev->time.tick - limit) >= 0) {
+			err = 0;
+			break;
+		}
+		if (snd_seq_ev_is_variable(ev)) {
+			err = snd_seq_event_output(seq, ev);
+			if (err < 0)
+				break;
+			smf->batch_pos++;
+			done++;
+			continue;
+		}
+		/* copy the run of due fixed length events at once */
+		for (n = 1; smf->batch_pos + n < smf->batch_len; n++) {
+			ev = &smf->batch[smf->batch_pos + n];
+			if (snd_seq_ev_is_variable(ev) ||
+			    (int)(ev->time.tick - limit) >= 0)
+				break;
+		}
+		err = snd_seq_event_output_reserve(seq, &dst, n);
+		if (err < 0)
+			break;
+		for (i = 0; i < n; i++)
+			dst[i] = smf->batch[smf->batch_pos + i];
+		err = snd_seq_event_output_commit(seq, n);
+		if (err < 0)
+			break;
+		smf->batch_pos += n;
+		done += n;
+	}
+	ret = snd_seq_drain_output(seq);
+	if (err == -EAGAIN || (err >= 0 && ret == -EAGAIN))
+		return done;
+	if (err < 0)
+		return err;
+	return ret < 0 ? ret : (int)done;
+}
+
+/**
+ * \brief check whether all the events of the file have been queued
+ * \param smf the player
+ * \return 1 after the last event was queued, otherwise 0
+ */
+int snd_seq_smf_eof(const snd_seq_smf_t *smf)
+{
+	assert(smf);
+	return !smf->heap_len && smf->batch_pos == smf->batch_len;
+}
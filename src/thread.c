@@ -0,0 +1,284 @@
+/**
+ * \file thread.c
+ * \brief Scheduling of the threads of the library
+ * \date 2026
+ *
+ * The threads and helper processes the library starts for itself get
+ * the scheduling policy, priority and CPU affinity of the configuration
+ * or of the application.
+ */
+/*
+ *  Scheduling of the library threads
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#include "local.h"
+#include <ctype.h>
+#include <limits.h>
+
+/*
+ * The settings come from defaults.thread of the configuration, read
+ * when a thread starts so an updated configuration applies to the next
+ * one, unless the application set them with #snd_lib_thread_set_scheduler
+ * or #snd_lib_thread_set_affinity.  A setting the system refuses, e.g.
+ * SCHED_FIFO without the privilege, is reported and the thread runs
+ * with the inherited one.
+ */
+
+#ifndef DOC_HIDDEN
+
+static int app_policy_set;
+static int app_policy = -1;
+static int app_priority;
+static int app_affinity_set;
+static int app_affinity;
+static cpu_set_t app_cpus;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t sched_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define sched_lock()	pthread_mutex_lock(&sched_mutex)
+#define sched_unlock()	pthread_mutex_unlock(&sched_mutex)
+#else
+#define sched_lock()	do { } while (0)
+#define sched_unlock()	do { } while (0)
+#endif
+
+/* a list like "0-3,6" */
+static int parse_cpus(const char *str, cpu_set_t *cpus)
+{
+	const char *s = str;
+	char *end;
+	unsigned long first, last;
+
+	CPU_ZERO(cpus);
+	while (isspace((unsigned char)*s))
+		s++;
+	while (*s) {
+		if (!isdigit((unsigned char)*s))
+			goto _err;
+		first = last = strtoul(s, &end, 10);
+		s = end;
+		if (*s == '-') {
+			s++;
+			if (!isdigit((unsigned char)*s))
+				goto _err;
+			last = strtoul(s, &end, 10);
+			s = end;
+		}
+		if (first > last || last >= CPU_SETSIZE)
+			goto _err;
+		for (; first <= last; first++)
+			CPU_SET(first, cpus);
+		while (isspace((unsigned char)*s))
+			s++;
+		if (*s == ',') {
+			s++;
+			while (isspace((unsigned char)*s))
+				s++;
+		} else if (*s) {
+			goto _err;
+		}
+	}
+	return CPU_COUNT(cpus) > 0;
+ _err:
+	SNDERR("Invalid CPU list '%s'", str);
+	return -EINVAL;
+}
+
+static int parse_policy(const char *str)
+{
+	if (!strcmp(str, "inherit"))
+		return -1;
+	if (!strcmp(str, "other"))
+		return SCHED_OTHER;
+	if (!strcmp(str, "fifo"))
+		return SCHED_FIFO;
+	if (!strcmp(str, "rr"))
+		return SCHED_RR;
+	SNDERR("Invalid scheduling policy '%s'", str);
+	return -EINVAL;
+}
+
+static void sched_from_config(snd_thread_sched_t *sched)
+{
+	snd_config_t *top, *n;
+	const char *str;
+	long val;
+	int err;
+
+	if (snd_config_update_ref(&top) < 0)
+		return;
+	if (snd_config_search(top, "defaults.thread.policy", &n) >= 0 &&
+	    snd_config_get_string(n, &str) >= 0) {
+		err = parse_policy(str);
+		if (err != -EINVAL)
+			sched->policy = err;
+	}
+	if (snd_config_search(top, "defaults.thread.priority", &n) >= 0 &&
+	    snd_config_get_integer(n, &val) >= 0)
+		sched->priority = val;
+	if (snd_config_search(top, "defaults.thread.cpus", &n) >= 0 &&
+	    snd_config_get_string(n, &str) >= 0) {
+		err = parse_cpus(str, &sched->cpus);
+		sched->affinity = err > 0;
+	}
+	snd_config_unref(top);
+}
+
+/**
+ * \brief Get the scheduling for a thread or process of the library
+ * \param sched Returned settings
+ */
+void snd_thread_sched_get(snd_thread_sched_t *sched)
+{
+	memset(sched, 0, sizeof(*sched));
+	sched->policy = -1;
+	sched_lock();
+	if (!app_policy_set || !app_affinity_set)
+		sched_from_config(sched);
+	if (app_policy_set) {
+		sched->policy = app_policy;
+		sched->priority = app_priority;
+	}
+	if (app_affinity_set) {
+		sched->affinity = app_affinity;
+		sched->cpus = app_cpus;
+	}
+	sched_unlock();
+}
+
+/**
+ * \brief Apply the scheduling settings to the calling process
+ * \param sched Settings from #snd_thread_sched_get
+ *
+ * For the helper processes, e.g. the server of the direct plugins; the
+ * settings are taken before the fork.
+ */
+void snd_thread_sched_apply_self(const snd_thread_sched_t *sched)
+{
+	struct sched_param param;
+
+	if (sched->policy >= 0) {
+		param.sched_priority = sched->priority;
+		if (sched_setscheduler(0, sched->policy, &param) < 0)
+			SYSMSG("sched_setscheduler failed");
+	}
+	if (sched->affinity &&
+	    sched_setaffinity(0, sizeof(sched->cpus), &sched->cpus) < 0)
+		SYSMSG("sched_setaffinity failed");
+}
+
+#ifdef HAVE_LIBPTHREAD
+/**
+ * \brief Start a thread of the library
+ * \param thread Returned thread
+ * \param attr Attributes, may be NULL
+ * \param func Thread function
+ * \param arg Argument of the thread function
+ * \return 0 on success otherwise an error number like pthread_create()
+ *
+ * Like pthread_create(), the policy and priority are applied unless
+ * \a attr sets them explicitly, the CPU affinity always.
+ */
+int snd_thread_create(pthread_t *thread, const pthread_attr_t *attr,
+		      void *(*func)(void *), void *arg)
+{
+	snd_thread_sched_t sched;
+	struct sched_param param;
+	int inherit = PTHREAD_INHERIT_SCHED, err;
+
+	err = pthread_create(thread, attr, func, arg);
+	if (err)
+		return err;
+	snd_thread_sched_get(&sched);
+	if (attr)
+		pthread_attr_getinheritsched(attr, &inherit);
+	if (sched.policy >= 0 && inherit == PTHREAD_INHERIT_SCHED) {
+		param.sched_priority = sched.priority;
+		err = pthread_setschedparam(*thread, sched.policy, &param);
+		if (err)
+			SNDMSG("pthread_setschedparam failed (%d)", err);
+	}
+	if (sched.affinity) {
+		err = pthread_setaffinity_np(*thread, sizeof(sched.cpus),
+					     &sched.cpus);
+		if (err)
+			SNDMSG("pthread_setaffinity_np failed (%d)", err);
+	}
+	return 0;
+}
+#endif
+
+#endif /* DOC_HIDDEN */
+
+/**
+ * \brief Set the scheduling of the threads the library starts
+ * \param policy SCHED_OTHER, SCHED_FIFO or SCHED_RR, -1 for the
+ *        setting of the configuration (defaults.thread.policy)
+ * \param priority Static priority for the policy
+ * \return 0 on success otherwise a negative error code
+ *
+ * This covers the internal threads of the plugins, e.g. the share,
+ * meter, file and rate plugins, the asynchronous dispatcher and the
+ * server process of the direct plugins, which start after this call.
+ * The threads already running keep their scheduling.
+ */
+int snd_lib_thread_set_scheduler(int policy, int priority)
+{
+	if (policy >= 0) {
+		if (policy != SCHED_OTHER && policy != SCHED_FIFO &&
+		    policy != SCHED_RR)
+			return -EINVAL;
+		if (priority < sched_get_priority_min(policy) ||
+		    priority > sched_get_priority_max(policy))
+			return -EINVAL;
+	}
+	sched_lock();
+	app_policy_set = policy >= 0;
+	app_policy = policy;
+	app_priority = priority;
+	sched_unlock();
+	return 0;
+}
+
+/**
+ * \brief Set the CPU affinity of the threads the library starts
+ * \param cpus List of CPUs like "2,3" or "4-7", an empty string for the
+ *        inherited affinity, NULL for the setting of the configuration
+ *        (defaults.thread.cpus)
+ * \return 0 on success otherwise a negative error code
+ *
+ * Applies to the same threads as #snd_lib_thread_set_scheduler.
+ */
+int snd_lib_thread_set_affinity(const char *cpus)
+{
+	cpu_set_t set;
+	int err = 0;
+
+	if (cpus) {
+		err = parse_cpus(cpus, &set);
+		if (err < 0)
+			return err;
+	}
+	sched_lock();
+	app_affinity_set = cpus != NULL;
+	app_affinity = err > 0;
+	if (app_affinity)
+		app_cpus = set;
+	sched_unlock();
+	return 0;
+}
@@ -306,7 +306,8 @@ int snd_async_add_timer_handler(snd_async_handler_t **handler, snd_timer_t *time
 	h->u.timer = timer;
 	was_empty = list_empty(&timer->async_handlers);
 	list_add_tail(&h->hlist, &timer->async_handlers);
-	if (was_empty) {
+	/* no signal with the dispatcher thread */
+	if (was_empty && snd_async_handler_get_signo(h)) {
 		err = snd_timer_async(timer, snd_async_handler_get_signo(h), getpid());
 		if (err < 0) {
 			snd_async_del_handler(h);
@@ -390,6 +391,49 @@ int snd_timer_poll_descriptors_revents(snd_timer_t *timer, struct pollfd *pfds,
         return -EINVAL;
 }
 
+static int snd_timer_evloop_count(void *handle)
+{
+	return snd_timer_poll_descriptors_count(handle);
+}
+
+static int snd_timer_evloop_descriptors(void *handle, struct pollfd *pfds, unsigned int space)
+{
+	return snd_timer_poll_descriptors(handle, pfds, space);
+}
+
+static int snd_timer_evloop_revents(void *handle, struct pollfd *pfds, unsigned int nfds,
+		unsigned short *revents)
+{
+	return snd_timer_poll_descriptors_revents(handle, pfds, nfds, revents);
+}
+
+static const snd_evloop_ops_t snd_timer_evloop_ops = {
+	.count = snd_timer_evloop_count,
+	.descriptors = snd_timer_evloop_descriptors,
+	.revents = snd_timer_evloop_revents,
+};
+
+/**
+ * \brief Registers a timer handle with an event loop
+ * \param loop Event loop
+ * \param srcp Returned source, may be NULL
+ * \param timer Timer handle
+ * \param callback Callback for the events of the handle
+ * \param private_data Value for #snd_evloop_source_get_callback_private
+ * \return 0 on success otherwise a negative error code
+ *
+ * The callback gets the events translated by
+ * #snd_timer_poll_descriptors_revents.  The poll descriptors are read
+ * once; see #snd_evloop_source_refresh.
+ */
+int snd_timer_evloop_add(snd_evloop_t *loop, snd_evloop_source_t **srcp, snd_timer_t *timer,
+		snd_evloop_callback_t callback, void *private_data)
+{
+	assert(timer);
+	return snd_evloop_add_source(loop, srcp, &snd_timer_evloop_ops, timer, 0,
+				     callback, private_data);
+}
+
 /**
  * \brief set nonblock mode
  * \param timer timer handle
@@ -943,6 +987,80 @@ ssize_t snd_timer_read(snd_timer_t *timer, void *buffer, size_t size)
 	return (timer->ops->read)(timer, buffer, size);
 }
 
+#ifndef DOC_HIDDEN
+#define TIMER_READ_BATCH	128	/* the default queue size of the driver */
+#endif
+
+/**
+ * \brief read all queued ticks at once
+ * \param timer timer handle
+ * \param resolution if not NULL, the tick resolution in nanoseconds
+ * \param tstamp if not NULL, the time stamp of the last tick
+ * \return the count of ticks happened otherwise a negative error code
+ *
+ * The queued records are taken with one read and their ticks summed up,
+ * so a consumer waking up late gets all ticks it missed from one call.
+ * The resolution comes with the records; it replaces a status query.
+ * The time stamp is known only for handles opened with
+ * #SND_TIMER_OPEN_TREAD and is zero otherwise.  Records other than ticks
+ * and resolution changes are skipped; read them with snd_timer_read().
+ *
+ * In nonblocking mode \c -EAGAIN is returned when no record is queued.
+ *
+ * \sa snd_timer_read()
+ */
+long snd_timer_read_ticks(snd_timer_t *timer, unsigned long *resolution, snd_htimestamp_t *tstamp)
+{
+	union {
+		snd_timer_read_t r[TIMER_READ_BATCH];
+		snd_timer_tread_t t[TIMER_READ_BATCH];
+	} buf;
+	snd_timer_info_t info;
+	unsigned long ticks = 0;
+	ssize_t res;
+	size_t i, n;
+
+	assert(timer);
+	if (tstamp)
+		memset(tstamp, 0, sizeof(*tstamp));
+	if (!timer->tread) {
+		res = snd_timer_read(timer, buf.r, sizeof(buf.r));
+		if (res < 0)
+			return res;
+		n = res / sizeof(buf.r[0]);
+		for (i = 0; i < n; i++)
+			ticks += buf.r[i].ticks;
+		if (n)
+			timer->resolution = buf.r[n - 1].resolution;
+	} else {
+		res = snd_timer_read(timer, buf.t, sizeof(buf.t));
+		if (res < 0)
+			return res;
+		n = res / sizeof(buf.t[0]);
+		for (i = 0; i < n; i++) {
+			switch (buf.t[i].event) {
+			case SND_TIMER_EVENT_TICK:
+				ticks += buf.t[i].val;
+				if (tstamp)
+					*tstamp = buf.t[i].tstamp;
+				break;
+			case SND_TIMER_EVENT_RESOLUTION:
+				timer->resolution = buf.t[i].val;
+				break;
+			default:
+				break;
+			}
+		}
+	}
+	if (resolution) {
+		/* ticks records carry no resolution, ask the driver once */
+		if (!timer->resolution && snd_timer_info(timer, &info) >= 0)
+			timer->resolution = info.resolution;
+		*resolution = timer->resolution;
+	}
+	return ticks;
+}
+
 /**
  * \brief (DEPRECATED) get maximum timer ticks
  * \param info pointer to #snd_timer_info_t structure
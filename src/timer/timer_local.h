@@ -47,6 +47,8 @@ struct _snd_timer {
 	const snd_timer_ops_t *ops;
 	void *private_data;
 	struct list_head async_handlers;
+	int tread;			/* reads snd_timer_tread_t records */
+	unsigned int resolution;	/* last known, see snd_timer_read_ticks() */
 };
 
 typedef struct {
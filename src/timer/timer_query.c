@@ -27,6 +27,9 @@
  */
 
 #include "timer_local.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 static int snd_timer_query_open_conf(snd_timer_query_t **timer,
 				     const char *name, snd_config_t *timer_root,
@@ -431,6 +434,158 @@ int snd_timer_query_status(snd_timer_query_t *timer, snd_timer_gstatus_t *status
 }
 use_default_symbol_version(__snd_timer_query_status, snd_timer_query_status, ALSA_0.9.0);
 
+/*
+ * The timers of the hw interface, with their information, are kept per
+ * process.  The global timers do not change and the card timers come and
+ * go with their cards, so the list is valid as long as the set of cards
+ * stays the same.
+ */
+#ifndef DOC_HIDDEN
+static snd_timer_ginfo_t *tq_cache_list;
+static unsigned int tq_cache_count;
+static unsigned int tq_cache_cards;		/* bit of each present card */
+static int tq_cache_valid;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t tq_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static inline void tq_cache_lock(void)
+{
+	pthread_mutex_lock(&tq_cache_mutex);
+}
+static inline void tq_cache_unlock(void)
+{
+	pthread_mutex_unlock(&tq_cache_mutex);
+}
+#else
+static inline void tq_cache_lock(void) {}
+static inline void tq_cache_unlock(void) {}
+#endif
+
+static unsigned int tq_card_mask(void)
+{
+	unsigned int mask = 0;
+	int card = -1;
+
+	while (snd_card_next(&card) >= 0 && card >= 0) {
+		if (card < 32)
+			mask |= 1U << card;
+	}
+	return mask;
+}
+
+/* enumerate the timers of a query handle */
+static int tq_enumerate(snd_timer_query_t *timer, snd_timer_ginfo_t **listp,
+			unsigned int *countp)
+{
+	snd_timer_ginfo_t *list = NULL, *n;
+	unsigned int count = 0, alloc = 0;
+	snd_timer_id_t tid;
+	int err;
+
+	memset(&tid, 0, sizeof(tid));
+	tid.dev_class = -1;
+	for (;;) {
+		err = timer->ops->next_device(timer, &tid);
+		if (err < 0)
+			goto _err;
+		if (tid.dev_class < 0)
+			break;
+		if (count == alloc) {
+			alloc = alloc ? alloc * 2 : 16;
+			n = realloc(list, alloc * sizeof(*list));
+			if (!n) {
+				err = -ENOMEM;
+				goto _err;
+			}
+			list = n;
+		}
+		memset(&list[count], 0, sizeof(*list));
+		list[count].tid = tid;
+		if (timer->ops->info(timer, &list[count]) < 0)
+			continue;
+		count++;
+	}
+	*listp = list;
+	*countp = count;
+	return 0;
+ _err:
+	free(list);
+	return err;
+}
+
+void snd_timer_query_cache_cleanup(void)
+{
+	tq_cache_lock();
+	free(tq_cache_list);
+	tq_cache_list = NULL;
+	tq_cache_count = 0;
+	tq_cache_valid = 0;
+	tq_cache_unlock();
+}
+#endif /* DOC_HIDDEN */
+
+/**
+ * \brief obtain all timers with their global information at once
+ * \param timer timer handle
+ * \param listp returned array of pointers to the information of each
+ *        timer, freed with one free()
+ * \param countp returned count of the timers
+ * \return 0 on success otherwise a negative error code
+ *
+ * The list replaces the walk with snd_timer_query_next_device() and
+ * snd_timer_query_info().  For the hw interface it is built once per
+ * process and built again only when a card appears or disappears, so
+ * the count of clients of each timer is the one seen at that time.
+ */
+int snd_timer_query_list(snd_timer_query_t *timer, snd_timer_ginfo_t ***listp,
+			 unsigned int *countp)
+{
+	snd_timer_ginfo_t *list, *own = NULL, **res;
+	unsigned int cards, count, i;
+	int err;
+
+	assert(timer && listp && countp);
+	if (timer->type != SND_TIMER_TYPE_HW) {
+		err = tq_enumerate(timer, &own, &count);
+		if (err < 0)
+			return err;
+		list = own;
+	} else {
+		cards = tq_card_mask();
+		tq_cache_lock();
+		if (!tq_cache_valid || tq_cache_cards != cards) {
+			err = tq_enumerate(timer, &list, &count);
+			if (err < 0) {
+				tq_cache_unlock();
+				return err;
+			}
+			free(tq_cache_list);
+			tq_cache_list = list;
+			tq_cache_count = count;
+			tq_cache_cards = cards;
+			tq_cache_valid = 1;
+		}
+		list = tq_cache_list;
+		count = tq_cache_count;
+	}
+	/* the pointers, then the copies they point to */
+	res = malloc(count * (sizeof(*res) + sizeof(*list)) + 1);
+	if (res) {
+		for (i = 0; i < count; i++) {
+			res[i] = (snd_timer_ginfo_t *)(res + count) + i;
+			*res[i] = list[i];
+		}
+	}
+	if (!own)
+		tq_cache_unlock();
+	free(own);
+	if (!res)
+		return -ENOMEM;
+	*listp = res;
+	*countp = count;
+	return 0;
+}
+
 /**
  * \brief get size of the snd_timer_id_t structure in bytes
  * \return size of the snd_timer_id_t structure in bytes
@@ -28,7 +28,7 @@ static void verbose(snd_tplg_t *tplg, const char *fmt, ...)
 	if (!tplg->verbose)
 		return;
 
-	offset = lseek(tplg->out_fd, 0, SEEK_CUR);
+	offset = tplg->bin_pos;
 
 	va_start(va, fmt);
 	fprintf(stdout, "0x%6.6x/%6.6d -", offset, offset);
@@ -36,14 +36,33 @@ static void verbose(snd_tplg_t *tplg, const char *fmt, ...)
 	va_end(va);
 }
 
-/* write out block header to output file */
-static int write_block_header(snd_tplg_t *tplg, unsigned int type,
+/* append data to the output binary, growing it as needed */
+static int write_data(snd_tplg_t *tplg, const void *data, size_t size)
+{
+	size_t alloc;
+	void *bin;
+
+	if (tplg->bin_pos + size > tplg->bin_size) {
+		alloc = tplg->bin_size ? tplg->bin_size : 16384;
+		while (alloc < tplg->bin_pos + size)
+			alloc *= 2;
+		bin = realloc(tplg->bin, alloc);
+		if (!bin)
+			return -ENOMEM;
+		tplg->bin = bin;
+		tplg->bin_size = alloc;
+	}
+	memcpy((char *)tplg->bin + tplg->bin_pos, data, size);
+	tplg->bin_pos += size;
+	return size;
+}
+
+/* fill in the block header at offset pos of the output binary */
+static void write_block_header(snd_tplg_t *tplg, size_t pos, unsigned int type,
 	unsigned int vendor_type, unsigned int version, unsigned int index,
 	size_t payload_size, int count)
 {
 	struct snd_soc_tplg_hdr hdr;
-	size_t bytes;
-	int offset = lseek(tplg->out_fd, 0, SEEK_CUR);
 
 	memset(&hdr, 0, sizeof(hdr));
 	hdr.magic = SND_SOC_TPLG_MAGIC;
@@ -56,51 +75,27 @@ static int write_block_header(snd_tplg_t *tplg, unsigned int type,
 	hdr.size = sizeof(hdr);
 	hdr.count = count;
 
-	/* make sure file offset is aligned with the calculated HDR offset */
-	if ((unsigned int)offset != tplg->next_hdr_pos) {
-		SNDERR("error: New header is at offset 0x%x but file"
-			" offset 0x%x is %s by %d bytes\n",
-			tplg->next_hdr_pos, offset,
-			(unsigned int)offset > tplg->next_hdr_pos ? "ahead" : "behind",
-			abs(offset - tplg->next_hdr_pos));
-		exit(-EINVAL);
-	}
-
-	verbose(tplg, " header type %d size 0x%lx/%ld vendor %d "
-		"version %d\n", type, (long unsigned int)payload_size,
-		(long int)payload_size, vendor_type, version);
-
-	tplg->next_hdr_pos += hdr.payload_size + sizeof(hdr);
-
-	bytes = write(tplg->out_fd, &hdr, sizeof(hdr));
-	if (bytes != sizeof(hdr)) {
-		SNDERR("error: can't write section header %lu\n",
-			(long unsigned int)bytes);
-		return bytes;
-	}
-
-	return bytes;
+	memcpy((char *)tplg->bin + pos, &hdr, sizeof(hdr));
 }
 
 static int write_elem_block(snd_tplg_t *tplg,
-	struct list_head *base, int size, int tplg_type, const char *obj_name)
+	struct list_head *base, int tplg_type, const char *obj_name)
 {
+	struct snd_soc_tplg_hdr hdr;
 	struct list_head *pos;
 	struct tplg_elem *elem;
-	int ret, wsize = 0, count = 0, vendor_type;
+	int ret, count = 0, vendor_type;
+	size_t hdr_pos, size;
 
-	/* count number of elements */
-	list_for_each(pos, base)
-		count++;
-	if (!count)
+	if (list_empty(base))
 		return 0;
 
-	/* write the header for this block */
+	/* reserve the header, it is filled once the size is known */
 	elem = list_entry(base->next, struct tplg_elem, list);
 	vendor_type = elem->vendor_type;
-
-	ret = write_block_header(tplg, tplg_type, vendor_type,
-		tplg->version, 0, size, count);
+	hdr_pos = tplg->bin_pos;
+	memset(&hdr, 0, sizeof(hdr));
+	ret = write_data(tplg, &hdr, sizeof(hdr));
 	if (ret < 0) {
 		SNDERR("error: failed to write %s block %d\n",
 			obj_name, ret);
@@ -111,6 +106,7 @@ static int write_elem_block(snd_tplg_t *tplg,
 	list_for_each(pos, base) {
 
 		elem = list_entry(pos, struct tplg_elem, list);
+		count++;
 
 		/* compound elems have already been copied to other elems */
 		if (elem->compound_elem)
@@ -123,86 +119,63 @@ static int write_elem_block(snd_tplg_t *tplg,
 			verbose(tplg, " %s '%s': write %d bytes\n",
 				obj_name, elem->route->source, elem->size);
 
-		count = write(tplg->out_fd, elem->obj, elem->size);
-		if (count < 0) {
+		ret = write_data(tplg, elem->obj, elem->size);
+		if (ret < 0) {
 			SNDERR("error: failed to write %s %d\n",
 				obj_name, ret);
 			return ret;
 		}
-
-		wsize += count;
 	}
 
-	/* make sure we have written the correct size */
-	if (wsize != size) {
-		SNDERR("error: size mismatch. Expected %d wrote %d\n",
-			size, wsize);
-		return -EIO;
+	/* a block of compound elems only is not written */
+	size = tplg->bin_pos - hdr_pos - sizeof(hdr);
+	if (!size) {
+		tplg->bin_pos = hdr_pos;
+		return 0;
 	}
 
-	return 0;
-}
-
-static int calc_block_size(struct list_head *base)
-{
-	struct list_head *pos;
-	struct tplg_elem *elem;
-	int size = 0;
-
-	list_for_each(pos, base) {
-
-		elem = list_entry(pos, struct tplg_elem, list);
-
-		/* compound elems have already been copied to other elems */
-		if (elem->compound_elem)
-			continue;
-
-		size += elem->size;
-	}
+	write_block_header(tplg, hdr_pos, tplg_type, vendor_type,
+		tplg->version, 0, size, count);
+	if (tplg->verbose)
+		fprintf(stdout, "0x%6.6x/%6.6d - header type %d size 0x%lx/%ld "
+			"vendor %d version %d count %d\n", (int)hdr_pos,
+			(int)hdr_pos, tplg_type, (long unsigned int)size,
+			(long int)size, vendor_type, tplg->version, count);
 
-	return size;
+	return 0;
 }
 
 static int write_block(snd_tplg_t *tplg, struct list_head *base,
 	int type)
 {
-	int size;
-
-	/* calculate the block size in bytes for all elems in this list */
-	size = calc_block_size(base);
-	if (size <= 0)
-		return size;
-
-	verbose(tplg, " block size for type %d is %d\n", type, size);
-
 	/* write each elem for this block */
 	switch (type) {
 	case SND_TPLG_TYPE_MIXER:
-		return write_elem_block(tplg, base, size,
+		return write_elem_block(tplg, base,
 			SND_SOC_TPLG_TYPE_MIXER, "mixer");
 	case SND_TPLG_TYPE_BYTES:
-		return write_elem_block(tplg, base, size,
+		return write_elem_block(tplg, base,
 			SND_SOC_TPLG_TYPE_BYTES, "bytes");
 	case SND_TPLG_TYPE_ENUM:
-		return write_elem_block(tplg, base, size,
+		return write_elem_block(tplg, base,
 			SND_SOC_TPLG_TYPE_ENUM, "enum");
 	case SND_TPLG_TYPE_DAPM_GRAPH:
-		return write_elem_block(tplg, base, size,
+		return write_elem_block(tplg, base,
 			SND_SOC_TPLG_TYPE_DAPM_GRAPH, "route");
 	case SND_TPLG_TYPE_DAPM_WIDGET:
-		return write_elem_block(tplg, base, size,
+		return write_elem_block(tplg, base,
 			SND_SOC_TPLG_TYPE_DAPM_WIDGET, "widget");
 	case SND_TPLG_TYPE_PCM:
-		return write_elem_block(tplg, base, size,
+		return write_elem_block(tplg, base,
 			SND_SOC_TPLG_TYPE_PCM, "pcm");
 	case SND_TPLG_TYPE_BE:
-		return write_elem_block(tplg, base, size,
+		return write_elem_block(tplg, base,
 			SND_SOC_TPLG_TYPE_BACKEND_LINK, "be");
 	case SND_TPLG_TYPE_CC:
-		return write_elem_block(tplg, base, size,
+		return write_elem_block(tplg, base,
 			SND_SOC_TPLG_TYPE_CODEC_LINK, "cc");
 	case SND_TPLG_TYPE_DATA:
-		return write_elem_block(tplg, base, size,
+		return write_elem_block(tplg, base,
 			SND_SOC_TPLG_TYPE_PDATA, "data");
 	default:
 		return -EINVAL;
@@ -214,26 +187,30 @@ static int write_block(snd_tplg_t *tplg, struct list_head *base,
 /* write the manifest including its private data */
 static int write_manifest_data(snd_tplg_t *tplg)
 {
+	struct snd_soc_tplg_hdr hdr;
+	size_t hdr_pos = tplg->bin_pos;
 	int ret;
 
 	/* write the header for this block */
-	ret = write_block_header(tplg, SND_SOC_TPLG_TYPE_MANIFEST, 0,
-		tplg->version, 0,
-		sizeof(tplg->manifest) + tplg->manifest.priv.size, 1);
+	memset(&hdr, 0, sizeof(hdr));
+	ret = write_data(tplg, &hdr, sizeof(hdr));
 	if (ret < 0) {
 		SNDERR("error: failed to write manifest block %d\n", ret);
 		return ret;
 	}
+	write_block_header(tplg, hdr_pos, SND_SOC_TPLG_TYPE_MANIFEST, 0,
+		tplg->version, 0,
+		sizeof(tplg->manifest) + tplg->manifest.priv.size, 1);
 
 	verbose(tplg, "manifest : write %d bytes\n", sizeof(tplg->manifest));
-	ret = write(tplg->out_fd, &tplg->manifest, sizeof(tplg->manifest));
+	ret = write_data(tplg, &tplg->manifest, sizeof(tplg->manifest));
 	if (ret < 0) {
 		SNDERR("error: failed to write manifest %d\n", ret);
 		return ret;
 	}
 
 	verbose(tplg, "manifest : write %d priv bytes\n", tplg->manifest.priv.size);
-	ret = write(tplg->out_fd, tplg->manifest_pdata, tplg->manifest.priv.size);
+	ret = write_data(tplg, tplg->manifest_pdata, tplg->manifest.priv.size);
 	if (ret < 0) {
 		SNDERR("error: failed to write manifest priv data %d\n", ret);
 		return ret;
@@ -242,10 +219,16 @@ static int write_manifest_data(snd_tplg_t *tplg)
 	return 0;
 }
 
+/*
+ * Assemble the binary in tplg->bin; the caller writes it out or hands
+ * it over.  Any previous binary is discarded.
+ */
 int tplg_write_data(snd_tplg_t *tplg)
 {
 	int ret;
 
+	tplg->bin_pos = 0;
+
 	/* write manifest */
 	ret = write_manifest_data(tplg);
 	if (ret < 0) {
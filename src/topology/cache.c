@@ -0,0 +1,193 @@
+/*
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of version 2 of the GNU General Public License as
+  published by the Free Software Foundation.
+
+  This program is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+*/
+
+/*
+ * Build cache of snd_tplg_build_file().  The key hashes everything the
+ * output depends on: the loaded configuration with its includes, the
+ * data files it refers to and the ABI and vendor versions.  A hit
+ * returns the binary of an earlier build without parsing and building.
+ */
+
+#include "list.h"
+#include "tplg_local.h"
+#include <stdio.h>
+
+#define CACHE_FNV_OFFSET	0xcbf29ce484222325ULL
+#define CACHE_FNV_PRIME		0x100000001b3ULL
+
+struct cache_key {
+	uint64_t h[2];
+};
+
+/* two FNV-1a hashes with different offsets, 128 bits together */
+static void cache_hash(struct cache_key *key, const void *data, size_t size)
+{
+	const unsigned char *p = data;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		key->h[0] = (key->h[0] ^ p[i]) * CACHE_FNV_PRIME;
+		key->h[1] = (key->h[1] ^ p[i]) * CACHE_FNV_PRIME;
+	}
+}
+
+static int cache_hash_file(struct cache_key *key, const char *file)
+{
+	char filename[MAX_FILE];
+	char buf[4096];
+	size_t n;
+	FILE *fp;
+
+	tplg_data_file_path(filename, sizeof(filename), file);
+	fp = fopen(filename, "r");
+	if (fp == NULL)
+		return -errno;
+
+	cache_hash(key, filename, strlen(filename) + 1);
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+		cache_hash(key, buf, n);
+
+	fclose(fp);
+	return 0;
+}
+
+/* hash the data files named by the data sections */
+static int cache_hash_data_files(struct cache_key *key, snd_config_t *cfg)
+{
+	snd_config_iterator_t i, next, j, jnext;
+	snd_config_t *sections, *n, *m;
+	const char *id, *file;
+	int err;
+
+	if (snd_config_search(cfg, "SectionData", &sections) < 0 ||
+	    snd_config_get_type(sections) != SND_CONFIG_TYPE_COMPOUND)
+		return 0;
+
+	snd_config_for_each(i, next, sections) {
+		n = snd_config_iterator_entry(i);
+		if (snd_config_get_type(n) != SND_CONFIG_TYPE_COMPOUND)
+			continue;
+
+		snd_config_for_each(j, jnext, n) {
+			m = snd_config_iterator_entry(j);
+			if (snd_config_get_id(m, &id) < 0 ||
+			    strcmp(id, "file") ||
+			    snd_config_get_string(m, &file) < 0)
+				continue;
+
+			err = cache_hash_file(key, file);
+			if (err < 0)
+				return err;
+		}
+	}
+
+	return 0;
+}
+
+static int cache_make_key(snd_tplg_t *tplg, snd_config_t *cfg)
+{
+	struct cache_key key = {
+		{ CACHE_FNV_OFFSET, CACHE_FNV_OFFSET ^ 0x5bd1e9955bd1e995ULL }
+	};
+	unsigned int versions[2] = { SND_SOC_TPLG_ABI_VERSION, tplg->version };
+	snd_output_t *out;
+	char *text;
+	size_t size;
+	int err;
+
+	err = snd_output_buffer_open(&out);
+	if (err < 0)
+		return err;
+
+	err = snd_config_save(cfg, out);
+	if (err >= 0) {
+		size = snd_output_buffer_string(out, &text);
+		cache_hash(&key, text, size);
+		cache_hash(&key, versions, sizeof(versions));
+		err = cache_hash_data_files(&key, cfg);
+	}
+
+	snd_output_close(out);
+	if (err < 0)
+		return err;
+
+	if (snprintf(tplg->cache_file, sizeof(tplg->cache_file),
+		"%s/%016llx%016llx.tplg", tplg->cache_dir,
+		(unsigned long long)key.h[0], (unsigned long long)key.h[1])
+		>= (int)sizeof(tplg->cache_file))
+		return -ENAMETOOLONG;
+	return 0;
+}
+
+/*
+ * Look up the configuration in the build cache.  Returns 1 with the
+ * binary in tplg->bin on a hit, 0 when the configuration must be built.
+ */
+int tplg_cache_lookup(snd_tplg_t *tplg, snd_config_t *cfg)
+{
+	FILE *fp;
+	long size;
+	void *bin;
+
+	tplg->cache_file[0] = 0;
+
+	/* objects added to the instance are not part of the key */
+	if (!tplg->cache_dir || tplg->manifest_pdata ||
+	    tplg->elem_hash_count)
+		return 0;
+
+	if (cache_make_key(tplg, cfg) < 0) {
+		tplg->cache_file[0] = 0;
+		return 0;
+	}
+
+	fp = fopen(tplg->cache_file, "r");
+	if (fp == NULL)
+		return 0;
+
+	fseek(fp, 0L, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0L, SEEK_SET);
+	bin = size > 0 ? malloc(size) : NULL;
+	if (!bin || fread(bin, 1, size, fp) != (size_t)size) {
+		free(bin);
+		fclose(fp);
+		return 0;
+	}
+	fclose(fp);
+
+	tplg_dbg("topology cache hit %s\n", tplg->cache_file);
+	free(tplg->bin);
+	tplg->bin = bin;
+	tplg->bin_pos = tplg->bin_size = size;
+	return 1;
+}
+
+/* keep the binary of a build looked up before */
+void tplg_cache_store(snd_tplg_t *tplg)
+{
+	char tmp[sizeof(tplg->cache_file) + 16];
+	FILE *fp;
+	int ok;
+
+	if (!tplg->cache_file[0])
+		return;
+
+	/* written aside and renamed, for builds running concurrently */
+	snprintf(tmp, sizeof(tmp), "%s.%d", tplg->cache_file, (int)getpid());
+	fp = fopen(tmp, "w");
+	if (fp == NULL)
+		return;
+
+	ok = fwrite(tplg->bin, 1, tplg->bin_pos, fp) == tplg->bin_pos;
+	if (fclose(fp) || !ok || rename(tmp, tplg->cache_file) < 0)
+		unlink(tmp);
+}
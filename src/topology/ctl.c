@@ -133,7 +133,7 @@ static int tplg_build_mixer_control(snd_tplg_t *tplg,
 			continue;
 
 		if (ref->type == SND_TPLG_TYPE_TLV) {
-			ref->elem = tplg_elem_lookup(&tplg->tlv_list,
+			ref->elem = tplg_elem_lookup(tplg,
 						ref->id, SND_TPLG_TYPE_TLV);
 			if (ref->elem)
 				 err = copy_tlv(elem, ref->elem);
@@ -181,7 +181,7 @@ static int tplg_build_enum_control(snd_tplg_t *tplg,
 			continue;
 
 		if (ref->type == SND_TPLG_TYPE_TEXT) {
-			ref->elem = tplg_elem_lookup(&tplg->text_list,
+			ref->elem = tplg_elem_lookup(tplg,
 						ref->id, SND_TPLG_TYPE_TEXT);
 			if (ref->elem)
 				copy_enum_texts(elem, ref->elem);
@@ -229,45 +229,31 @@ static int tplg_build_bytes_control(snd_tplg_t *tplg, struct tplg_elem *elem)
 
 int tplg_build_controls(snd_tplg_t *tplg)
 {
-	struct list_head *base, *pos;
-	struct tplg_elem *elem;
-	int err = 0;
-
-	base = &tplg->mixer_list;
-	list_for_each(pos, base) {
-
-		elem = list_entry(pos, struct tplg_elem, list);
-		err = tplg_build_mixer_control(tplg, elem);
-		if (err < 0)
-			return err;
+	struct list_head *pos;
+	int err;
 
-		/* add control to manifest */
-		tplg->manifest.control_elems++;
-	}
+	err = tplg_build_list(tplg, &tplg->mixer_list,
+		tplg_build_mixer_control);
+	if (err < 0)
+		return err;
 
-	base = &tplg->enum_list;
-	list_for_each(pos, base) {
+	err = tplg_build_list(tplg, &tplg->enum_list,
+		tplg_build_enum_control);
+	if (err < 0)
+		return err;
 
-		elem = list_entry(pos, struct tplg_elem, list);
-		err = tplg_build_enum_control(tplg, elem);
-		if (err < 0)
-			return err;
+	err = tplg_build_list(tplg, &tplg->bytes_ext_list,
+		tplg_build_bytes_control);
+	if (err < 0)
+		return err;
 
-		/* add control to manifest */
+	/* add controls to manifest */
+	list_for_each(pos, &tplg->mixer_list)
 		tplg->manifest.control_elems++;
-	}
-
-	base = &tplg->bytes_ext_list;
-	list_for_each(pos, base) {
-
-		elem = list_entry(pos, struct tplg_elem, list);
-		err = tplg_build_bytes_control(tplg, elem);
-		if (err < 0)
-			return err;
-
-		/* add control to manifest */
+	list_for_each(pos, &tplg->enum_list)
+		tplg->manifest.control_elems++;
+	list_for_each(pos, &tplg->bytes_ext_list)
 		tplg->manifest.control_elems++;
-	}
 
 	return 0;
 }
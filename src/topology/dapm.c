@@ -146,7 +146,7 @@ static int copy_dapm_control(struct tplg_elem *elem, struct tplg_elem *ref)
 	elem->size += ref->size;
 
 	widget->num_kcontrols++;
-	ref->compound_elem = 1;
+	__atomic_store_n(&ref->compound_elem, 1, __ATOMIC_RELAXED);
 	return 0;
 }
 
@@ -168,7 +168,7 @@ static int tplg_build_widget(snd_tplg_t *tplg,
 		switch (ref->type) {
 		case SND_TPLG_TYPE_MIXER:
 			if (!ref->elem)
-				ref->elem = tplg_elem_lookup(&tplg->mixer_list,
+				ref->elem = tplg_elem_lookup(tplg,
 						ref->id, SND_TPLG_TYPE_MIXER);
 			if (ref->elem)
 				err = copy_dapm_control(elem, ref->elem);
@@ -176,7 +176,7 @@ static int tplg_build_widget(snd_tplg_t *tplg,
 
 		case SND_TPLG_TYPE_ENUM:
 			if (!ref->elem)
-				ref->elem = tplg_elem_lookup(&tplg->enum_list,
+				ref->elem = tplg_elem_lookup(tplg,
 						ref->id, SND_TPLG_TYPE_ENUM);
 			if (ref->elem)
 				err = copy_dapm_control(elem, ref->elem);
@@ -184,7 +184,7 @@ static int tplg_build_widget(snd_tplg_t *tplg,
 
 		case SND_TPLG_TYPE_BYTES:
 			if (!ref->elem)
-				ref->elem = tplg_elem_lookup(&tplg->bytes_ext_list,
+				ref->elem = tplg_elem_lookup(tplg,
 						ref->id, SND_TPLG_TYPE_BYTES);
 			if (ref->elem)
 				err = copy_dapm_control(elem, ref->elem);
@@ -214,30 +214,30 @@ static int tplg_build_widget(snd_tplg_t *tplg,
 	return 0;
 }
 
-int tplg_build_widgets(snd_tplg_t *tplg)
+static int tplg_check_build_widget(snd_tplg_t *tplg, struct tplg_elem *elem)
 {
+	if (!elem->widget || elem->type != SND_TPLG_TYPE_DAPM_WIDGET) {
+		SNDERR("error: invalid widget '%s'\n",
+			elem->id);
+		return -EINVAL;
+	}
 
-	struct list_head *base, *pos;
-	struct tplg_elem *elem;
-	int err;
-
-	base = &tplg->widget_list;
-	list_for_each(pos, base) {
+	return tplg_build_widget(tplg, elem);
+}
 
-		elem = list_entry(pos, struct tplg_elem, list);
-		if (!elem->widget || elem->type != SND_TPLG_TYPE_DAPM_WIDGET) {
-			SNDERR("error: invalid widget '%s'\n",
-				elem->id);
-			return -EINVAL;
-		}
+int tplg_build_widgets(snd_tplg_t *tplg)
+{
+	struct list_head *pos;
+	int err;
 
-		err = tplg_build_widget(tplg, elem);
-		if (err < 0)
-			return err;
+	err = tplg_build_list(tplg, &tplg->widget_list,
+		tplg_check_build_widget);
+	if (err < 0)
+		return err;
 
-		/* add widget to manifest */
+	/* add widgets to manifest */
+	list_for_each(pos, &tplg->widget_list)
 		tplg->manifest.widget_elems++;
-	}
 
 	return 0;
 }
@@ -269,7 +269,7 @@ int tplg_build_routes(snd_tplg_t *tplg)
 			return -EINVAL;
 
 		}
-		if (!tplg_elem_lookup(&tplg->widget_list, route->sink,
+		if (!tplg_elem_lookup(tplg, route->sink,
 			SND_TPLG_TYPE_DAPM_WIDGET)) {
 			SNDERR("warning: undefined sink widget/stream '%s'\n",
 				route->sink);
@@ -277,9 +277,9 @@ int tplg_build_routes(snd_tplg_t *tplg)
 
 		/* validate control name */
 		if (strlen(route->control)) {
-			if (!tplg_elem_lookup(&tplg->mixer_list,
+			if (!tplg_elem_lookup(tplg,
 				route->control, SND_TPLG_TYPE_MIXER) &&
-			!tplg_elem_lookup(&tplg->enum_list,
+			!tplg_elem_lookup(tplg,
 				route->control, SND_TPLG_TYPE_ENUM)) {
 				SNDERR("warning: Undefined mixer/enum control '%s'\n",
 					route->control);
@@ -292,7 +292,7 @@ int tplg_build_routes(snd_tplg_t *tplg)
 			return -EINVAL;
 
 		}
-		if (!tplg_elem_lookup(&tplg->widget_list, route->source,
+		if (!tplg_elem_lookup(tplg, route->source,
 			SND_TPLG_TYPE_DAPM_WIDGET)) {
 			SNDERR("warning: Undefined source widget/stream '%s'\n",
 				route->source);
@@ -54,13 +54,21 @@ struct snd_soc_tplg_private *get_priv_data(struct tplg_elem *elem)
 	return priv;
 }
 
+/* path of a data file, relative to the topology directory */
+void tplg_data_file_path(char *filename, size_t size, const char *file)
+{
+	char *env = getenv(ALSA_CONFIG_TPLG_VAR);
+
+	/* prepend alsa config directory to path */
+	snprintf(filename, size, "%s/%s", env ? env : ALSA_TPLG_DIR, file);
+}
+
 /* Get Private data from a file. */
 static int tplg_parse_data_file(snd_config_t *cfg, struct tplg_elem *elem)
 {
 	struct snd_soc_tplg_private *priv = NULL;
 	const char *value = NULL;
 	char filename[MAX_FILE];
-	char *env = getenv(ALSA_CONFIG_TPLG_VAR);
 	FILE *fp;
 	size_t size, bytes_read;
 	int ret = 0;
@@ -70,9 +78,7 @@ static int tplg_parse_data_file(snd_config_t *cfg, struct tplg_elem *elem)
 	if (snd_config_get_string(cfg, &value) < 0)
 		return -EINVAL;
 
-	/* prepend alsa config directory to path */
-	snprintf(filename, sizeof(filename), "%s/%s",
-		env ? env : ALSA_TPLG_DIR, value);
+	tplg_data_file_path(filename, sizeof(filename), value);
 
 	fp = fopen(filename, "r");
 	if (fp == NULL) {
@@ -138,46 +144,69 @@ static void dump_priv_data(struct tplg_elem *elem)
 	tplg_dbg("\n\n");
 }
 
-/* get number of hex value elements in CSV list */
-static int get_hex_num(const char *str)
-{
-	int commas = 0, values = 0, len = strlen(str);
-	const char *end = str + len;
-
-	/* we expect "0x0, 0x0, 0x0" */
-	while (str < end) {
+/* value plus one of each hex digit, zero for any other character */
+static const unsigned char hex_digit[256] = {
+	['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+	['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+	['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+	['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
 
-		/* skip white space */
-		if (isspace(*str)) {
+/*
+ * decode a CSV list of hex values, "0x0, 0x0, 0x0", into values of
+ * width bytes at buf; returns the number of values
+ */
+static int decode_hex(char *buf, const char *str, int width)
+{
+	unsigned long val;
+	unsigned int d;
+	uint16_t v16;
+	uint32_t v32;
+	int num = 0;
+
+	for (;;) {
+		while (isspace((unsigned char)*str))
 			str++;
-			continue;
-		}
 
-		/* find delimeters */
-		if (*str == ',') {
-			commas++;
+		/* find 0x[0-9a-f]+ value */
+		if (str[0] != '0' || (str[1] != 'x' && str[1] != 'X') ||
+		    !hex_digit[(unsigned char)str[2]])
+			return -EINVAL;
+		str += 2;
+		val = 0;
+		while ((d = hex_digit[(unsigned char)*str]) != 0) {
+			if (val > (ULONG_MAX >> 4))
+				return -EINVAL;
+			val = (val << 4) | (d - 1);
 			str++;
-			continue;
 		}
 
-		/* find 0x[0-9] values */
-		if (*str == '0' && str + 2 <= end) {
-			if (str[1] == 'x' && str[2] >= '0' && str[2] <= 'f') {
-				values++;
-				str += 3;
-			} else {
-				str++;
-			}
+		switch (width) {
+		case 1:
+			buf[num] = val;
+			break;
+		case 2:
+			v16 = val;
+			memcpy(buf + num * 2, &v16, 2);
+			break;
+		case 4:
+			v32 = val;
+			memcpy(buf + num * 4, &v32, 4);
+			break;
+		default:
+			return -EINVAL;
 		}
+		num++;
 
-		str++;
-	}
-
-	/* there should always be one less comma than value */
-	if (values -1 != commas)
-		return -EINVAL;
+		while (isspace((unsigned char)*str))
+			str++;
+		if (!*str)
+			return num;
 
-	return values;
+		/* find delimeter */
+		if (*str++ != ',')
+			return -EINVAL;
+	}
 }
 
 /* get uuid from a string made by 16 characters separated by commas */
@@ -223,111 +252,51 @@ out:
 	return ret;
 }
 
-static int write_hex(char *buf, char *str, int width)
-{
-	long val;
-	void *p = &val;
-
-        errno = 0;
-	val = strtol(str, NULL, 16);
-
-	if ((errno == ERANGE && (val == LONG_MAX || val == LONG_MIN))
-		|| (errno != 0 && val == 0)) {
-		return -EINVAL;
-        }
-
-	switch (width) {
-	case 1:
-		*(unsigned char *)buf = *(unsigned char *)p;
-		break;
-	case 2:
-		*(unsigned short *)buf = *(unsigned short *)p;
-		break;
-	case 4:
-		*(unsigned int *)buf = *(unsigned int *)p;
-		break;
-	default:
-		return -EINVAL;
-	}
-
-	return 0;
-}
-
-static int copy_data_hex(char *data, int off, const char *str, int width)
-{
-	char *tmp, *s = NULL, *p = data;
-	int ret;
-
-	tmp = strdup(str);
-	if (tmp == NULL)
-		return -ENOMEM;
-
-	p += off;
-	s = strtok(tmp, ",");
-
-	while (s != NULL) {
-		ret = write_hex(p, s, width);
-		if (ret < 0) {
-			free(tmp);
-			return ret;
-		}
-
-		s = strtok(NULL, ",");
-		p += width;
-	}
-
-	free(tmp);
-	return 0;
-}
-
 static int tplg_parse_data_hex(snd_config_t *cfg, struct tplg_elem *elem,
 	int width)
 {
 	struct snd_soc_tplg_private *priv;
 	const char *value = NULL;
-	int size, esize, off, num;
-	int ret;
+	int size, off, num, max;
 
 	tplg_dbg(" data: %s\n", elem->id);
 
 	if (snd_config_get_string(cfg, &value) < 0)
 		return -EINVAL;
 
-	num = get_hex_num(value);
+	/* n values take at least 4n - 1 characters */
+	max = (strlen(value) + 1) / 4;
+
+	/* decode straight behind the present data, trimmed afterwards */
+	priv = elem->data;
+	off = priv ? priv->size : 0;
+	priv = realloc(priv, sizeof(*priv) + off + max * width);
+	if (!priv)
+		return -ENOMEM;
+	if (!elem->data)
+		memset(priv, 0, sizeof(*priv));
+	elem->data = priv;
+
+	num = max ? decode_hex(priv->data + off, value, width) : -EINVAL;
 	if (num <= 0) {
 		SNDERR("error: malformed hex variable list %s\n", value);
 		return -EINVAL;
 	}
 
 	size = num * width;
-	priv = elem->data;
-
 	if (size > TPLG_MAX_PRIV_SIZE) {
 		SNDERR("error: data too big %d\n", size);
 		return -EINVAL;
 	}
 
-	if (priv != NULL) {
-		off = priv->size;
-		esize = elem->size + size;
-		priv = realloc(priv, esize);
-	} else {
-		off = 0;
-		esize = sizeof(*priv) + size;
-		priv = calloc(1, esize);
-	}
-
-	if (!priv)
-		return -ENOMEM;
-
-	elem->data = priv;
 	priv->size += size;
-	elem->size = esize;
-
-	ret = copy_data_hex(priv->data, off, value, width);
+	elem->size = sizeof(*priv) + priv->size;
+	priv = realloc(priv, elem->size);
+	if (priv)
+		elem->data = priv;
 
 	dump_priv_data(elem);
-	return ret;
+	return 0;
 }
 
 /* get the token integer value from its id */
@@ -359,12 +328,10 @@ static struct tplg_elem *get_tokens(snd_tplg_t *tplg, struct tplg_elem *elem)
 		if (!ref->id || ref->type != SND_TPLG_TYPE_TOKEN)
 			continue;
 
-		if (!ref->elem) {
-			ref->elem = tplg_elem_lookup(&tplg->token_list,
-						ref->id, SND_TPLG_TYPE_TOKEN);
-		}
-
-		return ref->elem;
+		/* not cached, the tuples may be shared by the build threads */
+		if (ref->elem)
+			return ref->elem;
+		return tplg_elem_lookup(tplg, ref->id, SND_TPLG_TYPE_TOKEN);
 	}
 
 	return NULL;
@@ -423,39 +390,45 @@ static int copy_tuples(struct tplg_elem *elem,
 		return -EINVAL;
 	}
 
+	/* size the private data of all sets at once */
 	size = 0;
 	for (i = 0; i < tuples->num_sets ; i++) {
 		tuple_set = tuples->set[i];
-		set_size = sizeof(struct snd_soc_tplg_vendor_array)
+		size += sizeof(struct snd_soc_tplg_vendor_array)
 			+ get_tuple_size(tuple_set->type)
 			* tuple_set->num_tuples;
-		size += set_size;
 		if (size > TPLG_MAX_PRIV_SIZE) {
 			SNDERR("error: data too big %d\n", size);
 			return -EINVAL;
 		}
+	}
 
-		if (priv != NULL)
-			priv = realloc(priv, sizeof(*priv) + size);
-		else
-			priv = calloc(1, sizeof(*priv) + size);
-		if (!priv)
-			return -ENOMEM;
+	priv = calloc(1, sizeof(*priv) + size);
+	if (!priv)
+		return -ENOMEM;
+	priv->size = size;
 
-		off = priv->size;
-		priv->size = size;
+	off = 0;
+	for (i = 0; i < tuples->num_sets ; i++) {
+		tuple_set = tuples->set[i];
+		set_size = sizeof(struct snd_soc_tplg_vendor_array)
+			+ get_tuple_size(tuple_set->type)
+			* tuple_set->num_tuples;
 
 		array = (struct snd_soc_tplg_vendor_array *)(priv->data + off);
 		array->size = set_size;
 		array->type = tuple_set->type;
 		array->num_elems = tuple_set->num_tuples;
+		off += set_size;
 
 		/* fill the private data buffer */
 		for (j = 0; j < tuple_set->num_tuples; j++) {
 			tuple = &tuple_set->tuple[j];
 			token_val = get_token_value(tuple->token, tokens);
-			if (token_val  < 0)
+			if (token_val  < 0) {
+				free(priv);
 				return -EINVAL;
+			}
 
 			switch (tuple_set->type) {
 			case SND_SOC_TPLG_TUPLE_TYPE_UUID:
@@ -502,7 +475,7 @@ static int build_tuples(snd_tplg_t *tplg, struct tplg_elem *elem)
 		tplg_dbg("look up tuples %s\n", ref->id);
 
 		if (!ref->elem)
-			ref->elem = tplg_elem_lookup(&tplg->tuple_list,
+			ref->elem = tplg_elem_lookup(tplg,
 						ref->id, SND_TPLG_TYPE_TUPLE);
 		tuples = ref->elem;
 		if (!tuples)
@@ -1039,7 +1012,7 @@ int tplg_copy_data(snd_tplg_t *tplg, struct tplg_elem *elem,
 	int priv_data_size, old_priv_data_size;
 	void *obj;
 
-	ref_elem = tplg_elem_lookup(&tplg->pdata_list,
+	ref_elem = tplg_elem_lookup(tplg,
 				     ref->id, SND_TPLG_TYPE_DATA);
 	if (!ref_elem) {
 		SNDERR("error: cannot find data '%s' referenced by"
@@ -1073,7 +1046,7 @@ int tplg_copy_data(snd_tplg_t *tplg, struct tplg_elem *elem,
 	/* merge the new data block */
 	elem->size += priv_data_size;
 	priv->size = priv_data_size + old_priv_data_size;
-	ref_elem->compound_elem = 1;
+	__atomic_store_n(&ref_elem->compound_elem, 1, __ATOMIC_RELAXED);
 	memcpy(priv->data + old_priv_data_size,
 	       ref_elem->data->data, priv_data_size);
 
@@ -1081,23 +1054,16 @@ int tplg_copy_data(snd_tplg_t *tplg, struct tplg_elem *elem,
 	return 0;
 }
 
-/* check data objects and build those with tuples */
-int tplg_build_data(snd_tplg_t *tplg)
+static int tplg_build_data_elem(snd_tplg_t *tplg, struct tplg_elem *elem)
 {
-	struct list_head *base, *pos;
-	struct tplg_elem *elem;
-	int err = 0;
-
-	base = &tplg->pdata_list;
-	list_for_each(pos, base) {
-
-		elem = list_entry(pos, struct tplg_elem, list);
-		if (has_tuples(elem)) {
-			err = build_tuples(tplg, elem);
-			if (err < 0)
-				return err;
-		}
-	}
+	if (has_tuples(elem))
+		return build_tuples(tplg, elem);
 
 	return 0;
 }
+
+/* check data objects and build those with tuples */
+int tplg_build_data(snd_tplg_t *tplg)
+{
+	return tplg_build_list(tplg, &tplg->pdata_list, tplg_build_data_elem);
+}
@@ -18,6 +18,9 @@
 
 #include "list.h"
 #include "tplg_local.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 int tplg_ref_add(struct tplg_elem *elem, int type, const char* id)
 {
@@ -76,8 +79,69 @@ struct tplg_elem *tplg_elem_new(void)
 	return elem;
 }
 
+/* hash of element type and id */
+static unsigned int elem_hash(const char *id, unsigned int type)
+{
+	unsigned int h = type * 0x9e3779b1;
+	int i;
+
+	for (i = 0; i < SNDRV_CTL_ELEM_ID_NAME_MAXLEN && id[i]; i++)
+		h = h * 31 + (unsigned char)id[i];
+	return h;
+}
+
+/* append to the end of a chain, so duplicate ids resolve to the first */
+static void elem_hash_link(struct tplg_elem **p, struct tplg_elem *elem)
+{
+	while (*p)
+		p = &(*p)->hash_next;
+	elem->hash_next = NULL;
+	elem->hash_pprev = p;
+	*p = elem;
+}
+
+static void elem_hash_unlink(struct tplg_elem *elem)
+{
+	if (!elem->hash_pprev)
+		return;
+	*elem->hash_pprev = elem->hash_next;
+	if (elem->hash_next)
+		elem->hash_next->hash_pprev = elem->hash_pprev;
+	elem->hash_pprev = NULL;
+}
+
+/* add an element to the index, doubling it as the element count grows */
+static int elem_hash_add(snd_tplg_t *tplg, struct tplg_elem *elem)
+{
+	struct tplg_elem **hash, *e, *next;
+	unsigned int i, size;
+
+	if (tplg->elem_hash_count >= tplg->elem_hash_size) {
+		size = tplg->elem_hash_size ? tplg->elem_hash_size * 2 : 256;
+		hash = calloc(size, sizeof(*hash));
+		if (!hash)
+			return -ENOMEM;
+		for (i = 0; i < tplg->elem_hash_size; i++) {
+			for (e = tplg->elem_hash[i]; e; e = next) {
+				next = e->hash_next;
+				elem_hash_link(&hash[e->hash & (size - 1)], e);
+			}
+		}
+		free(tplg->elem_hash);
+		tplg->elem_hash = hash;
+		tplg->elem_hash_size = size;
+	}
+
+	elem->hash = elem_hash(elem->id, elem->type);
+	elem_hash_link(&tplg->elem_hash[elem->hash & (tplg->elem_hash_size - 1)],
+		elem);
+	tplg->elem_hash_count++;
+	return 0;
+}
+
 void tplg_elem_free(struct tplg_elem *elem)
 {
+	elem_hash_unlink(elem);
 	tplg_ref_free_list(&elem->ref_list);
 
 	/* free struct snd_tplg_ object,
@@ -105,23 +169,138 @@ void tplg_elem_free_list(struct list_head *base)
 	}
 }
 
-struct tplg_elem *tplg_elem_lookup(struct list_head *base, const char* id,
+struct tplg_elem *tplg_elem_lookup(snd_tplg_t *tplg, const char* id,
 	unsigned int type)
 {
-	struct list_head *pos;
 	struct tplg_elem *elem;
+	unsigned int hash;
 
-	list_for_each(pos, base) {
-
-		elem = list_entry(pos, struct tplg_elem, list);
+	if (!tplg->elem_hash_size)
+		return NULL;
 
-		if (!strcmp(elem->id, id) && elem->type == type)
+	hash = elem_hash(id, type);
+	for (elem = tplg->elem_hash[hash & (tplg->elem_hash_size - 1)];
+	     elem; elem = elem->hash_next) {
+		if (elem->hash == hash && elem->type == type &&
+		    !strcmp(elem->id, id))
 			return elem;
 	}
 
 	return NULL;
 }
 
+#ifdef HAVE_LIBPTHREAD
+struct build_work {
+	snd_tplg_t *tplg;
+	int (*build)(snd_tplg_t *tplg, struct tplg_elem *elem);
+	struct tplg_elem **elems;
+	unsigned int count;
+	unsigned int next;		/* next element to build */
+	unsigned int failed;		/* lowest failed element */
+	int err;
+};
+
+static void *build_worker(void *arg)
+{
+	struct build_work *w = arg;
+	unsigned int i, failed;
+	int err;
+
+	for (;;) {
+		i = __atomic_fetch_add(&w->next, 1, __ATOMIC_RELAXED);
+		if (i >= w->count ||
+		    i > __atomic_load_n(&w->failed, __ATOMIC_RELAXED))
+			return NULL;
+		err = w->build(w->tplg, w->elems[i]);
+		if (err >= 0)
+			continue;
+		failed = __atomic_load_n(&w->failed, __ATOMIC_RELAXED);
+		while (i < failed) {
+			if (__atomic_compare_exchange_n(&w->failed, &failed, i, 0,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				w->err = err;
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * Elements are handed out in list order, so each one before a failed
+ * element is built too and the error of the first failed element is
+ * the one a serial build returns.
+ */
+static int build_list_parallel(snd_tplg_t *tplg, struct list_head *base,
+	unsigned int count, int (*build)(snd_tplg_t *tplg, struct tplg_elem *elem))
+{
+	struct build_work w;
+	struct list_head *pos;
+	pthread_t *threads;
+	unsigned int i, n;
+
+	w.elems = malloc(count * sizeof(*w.elems));
+	threads = malloc(tplg->threads * sizeof(*threads));
+	if (!w.elems || !threads) {
+		free(w.elems);
+		free(threads);
+		return -ENOMEM;
+	}
+
+	i = 0;
+	list_for_each(pos, base)
+		w.elems[i++] = list_entry(pos, struct tplg_elem, list);
+	w.tplg = tplg;
+	w.build = build;
+	w.count = count;
+	w.next = 0;
+	w.failed = UINT_MAX;
+	w.err = 0;
+
+	/* the calling thread builds too, alone if no thread starts */
+	for (n = 0; n < tplg->threads - 1 && n < count - 1; n++) {
+		if (snd_thread_create(&threads[n], NULL, build_worker, &w))
+			break;
+	}
+	build_worker(&w);
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+	free(w.elems);
+	return w.err;
+}
+#endif
+
+/*
+ * Build each element of a list, on several threads when enabled.  The
+ * build function may only modify its element and the references of it.
+ */
+int tplg_build_list(snd_tplg_t *tplg, struct list_head *base,
+	int (*build)(snd_tplg_t *tplg, struct tplg_elem *elem))
+{
+	struct list_head *pos;
+	int err;
+
+#ifdef HAVE_LIBPTHREAD
+	if (tplg->threads > 1) {
+		unsigned int count = 0;
+
+		list_for_each(pos, base)
+			count++;
+		if (count > 1)
+			return build_list_parallel(tplg, base, count, build);
+	}
+#endif
+
+	list_for_each(pos, base) {
+		err = build(tplg, list_entry(pos, struct tplg_elem, list));
+		if (err < 0)
+			return err;
+	}
+
+	return 0;
+}
+
 /* create a new common element and object */
 struct tplg_elem* tplg_elem_new_common(snd_tplg_t *tplg,
 	snd_config_t *cfg, const char *name, enum snd_tplg_type type)
@@ -222,5 +401,12 @@ struct tplg_elem* tplg_elem_new_common(snd_tplg_t *tplg,
 	}
 
 	elem->type = type;
+
+	if (elem_hash_add(tplg, elem) < 0) {
+		list_del(&elem->list);
+		tplg_elem_free(elem);
+		return NULL;
+	}
+
 	return elem;
 }
@@ -286,25 +286,53 @@ static int tplg_build_integ(snd_tplg_t *tplg)
 	return err;
 }
 
-int snd_tplg_build_file(snd_tplg_t *tplg, const char *infile,
-	const char *outfile)
+/* write the assembled binary to the output file */
+static int tplg_save(snd_tplg_t *tplg, const char *outfile)
 {
-	snd_config_t *cfg = NULL;
-	int err = 0;
+	size_t pos = 0;
+	ssize_t res;
+	int fd, err = 0;
 
-	tplg->out_fd =
-		open(outfile, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
-	if (tplg->out_fd < 0) {
+	fd = open(outfile, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
 		SNDERR("error: failed to open %s err %d\n",
 			outfile, -errno);
 		return -errno;
 	}
 
+	while (pos < tplg->bin_pos) {
+		res = write(fd, (char *)tplg->bin + pos, tplg->bin_pos - pos);
+		if (res < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			SNDERR("error: failed to write %s err %d\n",
+				outfile, err);
+			break;
+		}
+		pos += res;
+	}
+
+	close(fd);
+	return err;
+}
+
+int snd_tplg_build_file(snd_tplg_t *tplg, const char *infile,
+	const char *outfile)
+{
+	snd_config_t *cfg = NULL;
+	int err = 0;
+
 	err = tplg_load_config(infile, &cfg);
 	if (err < 0) {
 		SNDERR("error: failed to load topology file %s\n",
 			infile);
-		goto out_close;
+		return err;
+	}
+
+	if (tplg_cache_lookup(tplg, cfg) > 0) {
+		err = tplg_save(tplg, outfile);
+		goto out;
 	}
 
 	err = tplg_parse_config(tplg, cfg);
@@ -325,10 +353,11 @@ int snd_tplg_build_file(snd_tplg_t *tplg, const char *infile,
 		goto out;
 	}
 
+	tplg_cache_store(tplg);
+	err = tplg_save(tplg, outfile);
+
 out:
 	snd_config_delete(cfg);
-out_close:
-	close(tplg->out_fd);
 	return err;
 }
 
@@ -360,29 +389,42 @@ int snd_tplg_build(snd_tplg_t *tplg, const char *outfile)
 {
 	int err;
 
-	tplg->out_fd =
-		open(outfile, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
-	if (tplg->out_fd < 0) {
-		SNDERR("error: failed to open %s err %d\n",
-			outfile, -errno);
-		return -errno;
+	err = tplg_build_integ(tplg);
+	if (err < 0) {
+		SNDERR("error: failed to check topology integrity\n");
+		return err;
+	}
+
+	err = tplg_write_data(tplg);
+	if (err < 0) {
+		SNDERR("error: failed to write data %d\n", err);
+		return err;
 	}
 
+	return tplg_save(tplg, outfile);
+}
+
+int snd_tplg_build_bin(snd_tplg_t *tplg, void **bin, size_t *size)
+{
+	int err;
+
 	err = tplg_build_integ(tplg);
 	if (err < 0) {
 		SNDERR("error: failed to check topology integrity\n");
-		goto out;
+		return err;
 	}
 
 	err = tplg_write_data(tplg);
 	if (err < 0) {
 		SNDERR("error: failed to write data %d\n", err);
-		goto out;
+		return err;
 	}
 
-out:
-	close(tplg->out_fd);
-	return err;
+	*bin = tplg->bin;
+	*size = tplg->bin_pos;
+	tplg->bin = NULL;
+	tplg->bin_pos = tplg->bin_size = 0;
+	return 0;
 }
 
 int snd_tplg_set_manifest_data(snd_tplg_t *tplg, const void *data, int len)
@@ -412,6 +454,32 @@ void snd_tplg_verbose(snd_tplg_t *tplg, int verbose)
 	tplg->verbose = verbose;
 }
 
+int snd_tplg_set_cache(snd_tplg_t *tplg, const char *dir)
+{
+	char *d = NULL;
+
+	if (dir) {
+		d = strdup(dir);
+		if (!d)
+			return -ENOMEM;
+	}
+	free(tplg->cache_dir);
+	tplg->cache_dir = d;
+
+	return 0;
+}
+
+int snd_tplg_set_threads(snd_tplg_t *tplg, unsigned int threads)
+{
+#ifndef HAVE_LIBPTHREAD
+	if (threads > 1)
+		return -ENOSYS;
+#endif
+	tplg->threads = threads;
+
+	return 0;
+}
+
 static bool is_little_endian(void)
 {
 #ifdef __BYTE_ORDER
@@ -462,6 +530,9 @@ void snd_tplg_free(snd_tplg_t *tplg)
 	if (tplg->manifest_pdata)
 		free(tplg->manifest_pdata);
 
+	free(tplg->bin);
+	free(tplg->cache_dir);
+
 	tplg_elem_free_list(&tplg->tlv_list);
 	tplg_elem_free_list(&tplg->widget_list);
 	tplg_elem_free_list(&tplg->pcm_list);
@@ -479,5 +550,6 @@ void snd_tplg_free(snd_tplg_t *tplg)
 	tplg_elem_free_list(&tplg->token_list);
 	tplg_elem_free_list(&tplg->tuple_list);
 
+	free(tplg->elem_hash);
 	free(tplg);
 }
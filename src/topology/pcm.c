@@ -60,7 +60,7 @@ static int tplg_build_stream_caps(snd_tplg_t *tplg,
 	unsigned int i;
 
 	for (i = 0; i < 2; i++) {
-		ref_elem = tplg_elem_lookup(&tplg->pcm_caps_list,
+		ref_elem = tplg_elem_lookup(tplg,
 			caps[i].name, SND_TPLG_TYPE_STREAM_CAPS);
 
 		if (ref_elem != NULL)
@@ -106,7 +106,7 @@ static int tplg_build_stream_cfg(snd_tplg_t *tplg,
 
 	for (i = 0; i < num_streams; i++) {
 		strm = stream + i;
-		ref_elem = tplg_elem_lookup(&tplg->pcm_config_list,
+		ref_elem = tplg_elem_lookup(tplg,
 			strm->name, SND_TPLG_TYPE_STREAM_CONFIG);
 
 		if (ref_elem && ref_elem->stream_cfg)
@@ -45,14 +45,20 @@ struct snd_tplg {
 	int vendor_fd;
 	char *vendor_name;
 
-	/* out file */
-	int out_fd;
+	/* build cache, see cache.c */
+	char *cache_dir;
+	char cache_file[MAX_FILE];	/* of the current build, or empty */
+
+	/* out binary, assembled in memory */
+	void *bin;
+	size_t bin_pos;		/* bytes written */
+	size_t bin_size;	/* bytes allocated */
 
 	int verbose;
 	unsigned int version;
+	unsigned int threads;	/* of the build passes, 0 or 1 = serial */
 
 	/* runtime state */
-	unsigned int next_hdr_pos;
 	int index;
 	int channel_idx;
 
@@ -79,6 +85,11 @@ struct snd_tplg {
 	struct list_head mixer_list;
 	struct list_head enum_list;
 	struct list_head bytes_ext_list;
+
+	/* index of the elements on type and id */
+	struct tplg_elem **elem_hash;
+	unsigned int elem_hash_size;
+	unsigned int elem_hash_count;
 };
 
 /* object text references */
@@ -166,6 +177,11 @@ struct tplg_elem {
 	struct list_head ref_list;
 	struct list_head list; /* list of all elements with same type */
 
+	/* chain of the elements with the same hash */
+	struct tplg_elem *hash_next;
+	struct tplg_elem **hash_pprev;
+	unsigned int hash;
+
 	void (*free)(void *obj);
 };
 
@@ -245,7 +261,13 @@ int tplg_ref_add_elem(struct tplg_elem *elem, struct tplg_elem *elem_ref);
 struct tplg_elem *tplg_elem_new(void);
 void tplg_elem_free(struct tplg_elem *elem);
 void tplg_elem_free_list(struct list_head *base);
-struct tplg_elem *tplg_elem_lookup(struct list_head *base,
+void tplg_data_file_path(char *filename, size_t size, const char *file);
+int tplg_cache_lookup(snd_tplg_t *tplg, snd_config_t *cfg);
+void tplg_cache_store(snd_tplg_t *tplg);
+
+int tplg_build_list(snd_tplg_t *tplg, struct list_head *base,
+	int (*build)(snd_tplg_t *tplg, struct tplg_elem *elem));
+struct tplg_elem *tplg_elem_lookup(snd_tplg_t *tplg,
 				const char* id,
 				unsigned int type);
 struct tplg_elem* tplg_elem_new_common(snd_tplg_t *tplg,
@@ -40,13 +40,14 @@
  * misc
  */
 
-static int get_value1(char **value, struct list_head *value_list,
+static int get_value1(char **value, struct ucm_index *value_index,
                       const char *identifier);
 static int get_value3(char **value,
 		      const char *identifier,
-		      struct list_head *value_list1,
-		      struct list_head *value_list2,
-		      struct list_head *value_list3);
+		      struct ucm_index *value_index1,
+		      struct ucm_index *value_index2,
+		      struct ucm_index *value_index3);
+static int cset_batch_flush(snd_use_case_mgr_t *uc_mgr);
 
 static int check_identifier(const char *identifier, const char *prefix)
 {
@@ -143,6 +144,10 @@ static int open_ctl(snd_use_case_mgr_t *uc_mgr,
 		return 0;
 	}
 	if (uc_mgr->ctl_dev) {
+		err = cset_batch_flush(uc_mgr);
+		if (err < 0)
+			return err;
+		uc_mgr_free_cset_info(uc_mgr);
 		free(uc_mgr->ctl_dev);
 		uc_mgr->ctl_dev = NULL;
 		snd_ctl_close(uc_mgr->ctl);
@@ -266,38 +271,220 @@ static int binary_file_parse(snd_ctl_elem_value_t *dst,
 	return err;
 }
 
-extern int __snd_ctl_ascii_elem_id_parse(snd_ctl_elem_id_t *dst,
-					 const char *str,
-					 const char **ret_ptr);
+static inline struct list_head *cset_info_hash(snd_use_case_mgr_t *uc_mgr,
+					       const struct sequence_element *s)
+{
+	return &uc_mgr->cset_info[((unsigned long)s / sizeof(*s)) %
+				  UC_MGR_CSET_HASH];
+}
+
+/**
+ * \brief Get the element info of a cset
+ * \param uc_mgr Use case manager
+ * \param ctl Control handle
+ * \param s Sequence element
+ * \param info Returned element info
+ * \return zero on success, otherwise a negative error code
+ *
+ * The info is looked up once per ctl handle; its id carries the numid,
+ * which the kernel resolves faster than the name.
+ */
+static int get_cset_info(snd_use_case_mgr_t *uc_mgr, snd_ctl_t *ctl,
+			 const struct sequence_element *s,
+			 snd_ctl_elem_info_t **info)
+{
+	struct list_head *base = cset_info_hash(uc_mgr, s), *pos;
+	struct ucm_cset_info *ci;
+	int err;
+
+	list_for_each(pos, base) {
+		ci = list_entry(pos, struct ucm_cset_info, list);
+		if (ci->seq == s) {
+			*info = &ci->info;
+			return 0;
+		}
+	}
+	ci = calloc(1, sizeof(*ci));
+	if (ci == NULL)
+		return -ENOMEM;
+	snd_ctl_elem_info_set_id(&ci->info, s->cset_id);
+	err = snd_ctl_elem_info(ctl, &ci->info);
+	if (err < 0) {
+		free(ci);
+		return err;
+	}
+	ci->seq = s;
+	list_add(&ci->list, base);
+	*info = &ci->info;
+	return 0;
+}
+
+static void put_cset_info(snd_ctl_elem_info_t *info)
+{
+	struct ucm_cset_info *ci;
+
+	ci = list_entry(info, struct ucm_cset_info, info);
+	list_del(&ci->list);
+	free(ci);
+}
+
+/**
+ * \brief Start a batch of csets
+ * \param uc_mgr Use case manager
+ *
+ * Until the matching cset_batch_end(), the csets only compute the final
+ * value of their elements.  Each element is written once, in the order of
+ * the last cset setting it, and only when the value changes.
+ */
+static void cset_batch_begin(snd_use_case_mgr_t *uc_mgr)
+{
+	uc_mgr->batch_depth++;
+}
+
+/**
+ * \brief Write the elements changed by the csets of the batch
+ * \param uc_mgr Use case manager
+ * \return zero on success, otherwise a negative error code
+ */
+static int cset_batch_flush(snd_use_case_mgr_t *uc_mgr)
+{
+	snd_ctl_elem_value_t cur, *value;
+	unsigned int i;
+	int err = 0;
+
+	for (i = 0; i < uc_mgr->batch_count; i++) {
+		value = &uc_mgr->batch[i];
+		memset(&cur, 0, sizeof(cur));
+		cur.id = value->id;
+		err = snd_ctl_elem_read(uc_mgr->batch_ctl, &cur);
+		if (err < 0)
+			break;
+		if (memcmp(&cur.value, &value->value, sizeof(cur.value)) == 0)
+			continue;
+		err = snd_ctl_elem_write(uc_mgr->batch_ctl, value);
+		if (err < 0)
+			break;
+	}
+	if (err < 0)
+		uc_error("unable to write control %s: %s",
+			 value->id.name, snd_strerror(err));
+	uc_mgr->batch_count = 0;
+	return err < 0 ? err : 0;
+}
+
+/**
+ * \brief End a batch of csets
+ * \param uc_mgr Use case manager
+ * \return zero on success, otherwise a negative error code
+ */
+static int cset_batch_end(snd_use_case_mgr_t *uc_mgr)
+{
+	if (--uc_mgr->batch_depth > 0)
+		return 0;
+	return cset_batch_flush(uc_mgr);
+}
 
-static int execute_cset(snd_ctl_t *ctl, const char *cset, unsigned int type)
+static int cset_same_elem(const snd_ctl_elem_id_t *id1,
+			  const snd_ctl_elem_id_t *id2)
 {
-	const char *pos;
+	/* not all ctl plugins fill the numid in */
+	if (id1->numid && id2->numid)
+		return id1->numid == id2->numid;
+	return id1->iface == id2->iface &&
+	       id1->device == id2->device &&
+	       id1->subdevice == id2->subdevice &&
+	       id1->index == id2->index &&
+	       strcmp((const char *)id1->name, (const char *)id2->name) == 0;
+}
+
+/**
+ * \brief Apply a cset value to the final value of its element
+ * \param uc_mgr Use case manager
+ * \param ctl Control handle
+ * \param info Element info
+ * \param str Value text of the cset
+ * \return zero on success, otherwise a negative error code
+ */
+static int cset_batch_add(snd_use_case_mgr_t *uc_mgr, snd_ctl_t *ctl,
+			  snd_ctl_elem_info_t *info, const char *str)
+{
+	snd_ctl_elem_value_t value, prev, *batch;
+	unsigned int i;
 	int err;
-	snd_ctl_elem_id_t *id;
-	snd_ctl_elem_value_t *value;
+
+	if (uc_mgr->batch_count > 0 && uc_mgr->batch_ctl != ctl) {
+		err = cset_batch_flush(uc_mgr);
+		if (err < 0)
+			return err;
+	}
+	uc_mgr->batch_ctl = ctl;
+	if (uc_mgr->batch_count == uc_mgr->batch_alloc) {
+		unsigned int alloc = uc_mgr->batch_alloc ?
+				     uc_mgr->batch_alloc * 2 : 16;
+		batch = realloc(uc_mgr->batch, alloc * sizeof(*batch));
+		if (batch == NULL)
+			return -ENOMEM;
+		uc_mgr->batch = batch;
+		uc_mgr->batch_alloc = alloc;
+	}
+
+	for (i = 0; i < uc_mgr->batch_count; i++) {
+		if (cset_same_elem(&uc_mgr->batch[i].id, &info->id))
+			break;
+	}
+	if (i < uc_mgr->batch_count) {
+		/* written after the elements set before this cset */
+		value = uc_mgr->batch[i];
+		memmove(&uc_mgr->batch[i], &uc_mgr->batch[i + 1],
+			(uc_mgr->batch_count - i - 1) * sizeof(value));
+		uc_mgr->batch_count--;
+	} else {
+		memset(&value, 0, sizeof(value));
+		snd_ctl_elem_info_get_id(info, &value.id);
+		err = snd_ctl_elem_read(ctl, &value);
+		if (err < 0)
+			return err;
+	}
+	prev = value;
+	err = snd_ctl_ascii_value_parse(ctl, &value, info, str);
+	if (err < 0)
+		value = prev;
+	uc_mgr->batch[uc_mgr->batch_count++] = value;
+	return err;
+}
+
+static int execute_cset(snd_use_case_mgr_t *uc_mgr, snd_ctl_t *ctl,
+			const struct sequence_element *s, int retry)
+{
+	const char *pos = s->cset_value;
+	int err;
+	snd_ctl_elem_id_t id;
+	snd_ctl_elem_value_t value;
 	snd_ctl_elem_info_t *info;
 	unsigned int *res = NULL;
 
-	snd_ctl_elem_id_malloc(&id);
-	snd_ctl_elem_value_malloc(&value);
-	snd_ctl_elem_info_malloc(&info);
-
-	err = __snd_ctl_ascii_elem_id_parse(id, cset, &pos);
+	if (s->cset_id == NULL) {
+		/* not split by the parser, find out why */
+		memset(&id, 0, sizeof(id));
+		err = __snd_ctl_ascii_elem_id_parse(&id, s->data.cset, &pos);
+		if (err < 0)
+			return err;
+		uc_error("undefined value for cset >%s<", s->data.cset);
+		return -EINVAL;
+	}
+	err = get_cset_info(uc_mgr, ctl, s, &info);
 	if (err < 0)
-		goto __fail;
-	while (*pos && isspace(*pos))
-		pos++;
-	if (!*pos) {
-		uc_error("undefined value for cset >%s<", cset);
-		err = -EINVAL;
+		return err;
+	if (s->type == SEQUENCE_ELEMENT_TYPE_CSET) {
+		err = cset_batch_add(uc_mgr, ctl, info, pos);
 		goto __fail;
 	}
-	snd_ctl_elem_info_set_id(info, id);
-	err = snd_ctl_elem_info(ctl, info);
+	/* the elements set so far are written first */
+	err = cset_batch_flush(uc_mgr);
 	if (err < 0)
-		goto __fail;
-	if (type == SEQUENCE_ELEMENT_TYPE_CSET_TLV) {
+		return err;
+	snd_ctl_elem_info_get_id(info, &id);
+	if (s->type == SEQUENCE_ELEMENT_TYPE_CSET_TLV) {
 		if (!snd_ctl_elem_info_is_tlv_writable(info)) {
 			err = -EINVAL;
 			goto __fail;
@@ -305,49 +492,39 @@ static int execute_cset(snd_ctl_t *ctl, const char *cset, unsigned int type)
 		err = read_tlv_file(&res, pos);
 		if (err < 0)
 			goto __fail;
-		err = snd_ctl_elem_tlv_write(ctl, id, res);
+		err = snd_ctl_elem_tlv_write(ctl, &id, res);
 		if (err < 0)
 			goto __fail;
 	} else {
-		snd_ctl_elem_value_set_id(value, id);
-		err = snd_ctl_elem_read(ctl, value);
+		memset(&value, 0, sizeof(value));
+		snd_ctl_elem_value_set_id(&value, &id);
+		err = snd_ctl_elem_read(ctl, &value);
 		if (err < 0)
 			goto __fail;
-		if (type == SEQUENCE_ELEMENT_TYPE_CSET_BIN_FILE)
-			err = binary_file_parse(value, info, pos);
-		else
-			err = snd_ctl_ascii_value_parse(ctl, value, info, pos);
+		err = binary_file_parse(&value, info, pos);
 		if (err < 0)
 			goto __fail;
-		err = snd_ctl_elem_write(ctl, value);
+		err = snd_ctl_elem_write(ctl, &value);
 		if (err < 0)
 			goto __fail;
 	}
 	err = 0;
       __fail:
-	if (id != NULL)
-		free(id);
-	if (value != NULL)
-		free(value);
-	if (info != NULL)
-		free(info);
-	if (res != NULL)
-		free(res);
-
+	free(res);
+	/* the element was replaced since its info was looked up */
+	if (err == -ENOENT) {
+		put_cset_info(info);
+		if (retry)
+			return execute_cset(uc_mgr, ctl, s, 0);
+	}
 	return err;
 }
 
-/**
- * \brief Execute the sequence
- * \param uc_mgr Use case manager
- * \param seq Sequence
- * \return zero on success, otherwise a negative error code
- */
-static int execute_sequence(snd_use_case_mgr_t *uc_mgr,
-			    struct list_head *seq,
-			    struct list_head *value_list1,
-			    struct list_head *value_list2,
-			    struct list_head *value_list3)
+static int execute_sequence0(snd_use_case_mgr_t *uc_mgr,
+			     struct list_head *seq,
+			     struct ucm_index *value_index1,
+			     struct ucm_index *value_index2,
+			     struct ucm_index *value_index3)
 {
 	struct list_head *pos;
 	struct sequence_element *s;
@@ -371,17 +548,17 @@ static int execute_sequence(snd_use_case_mgr_t *uc_mgr,
 				char *capture_ctl = NULL;
 
 				err = get_value3(&playback_ctl, "PlaybackCTL",
-						 value_list1,
-						 value_list2,
-						 value_list3);
+						 value_index1,
+						 value_index2,
+						 value_index3);
 				if (err < 0 && err != -ENOENT) {
 					uc_error("cdev is not defined!");
 					return err;
 				}
 				err = get_value3(&capture_ctl, "CaptureCTL",
-						 value_list1,
-						 value_list2,
-						 value_list3);
+						 value_index1,
+						 value_index2,
+						 value_index3);
 				if (err < 0 && err != -ENOENT) {
 					free(playback_ctl);
 					uc_error("cdev is not defined!");
@@ -413,16 +590,22 @@ static int execute_sequence(snd_use_case_mgr_t *uc_mgr,
 					goto __fail;
 				}
 			}
-			err = execute_cset(ctl, s->data.cset, s->type);
+			err = execute_cset(uc_mgr, ctl, s, 1);
 			if (err < 0) {
 				uc_error("unable to execute cset '%s'\n", s->data.cset);
 				goto __fail;
 			}
 			break;
 		case SEQUENCE_ELEMENT_TYPE_SLEEP:
+			err = cset_batch_flush(uc_mgr);
+			if (err < 0)
+				goto __fail;
 			usleep(s->data.sleep);
 			break;
 		case SEQUENCE_ELEMENT_TYPE_EXEC:
+			err = cset_batch_flush(uc_mgr);
+			if (err < 0)
+				goto __fail;
 			err = system(s->data.exec);
 			if (err < 0)
 				goto __fail;
@@ -442,6 +625,30 @@ static int execute_sequence(snd_use_case_mgr_t *uc_mgr,
 
 }
 
+/**
+ * \brief Execute the sequence
+ * \param uc_mgr Use case manager
+ * \param seq Sequence
+ * \return zero on success, otherwise a negative error code
+ *
+ * The csets up to the next sleep, exec or binary cset are collected and
+ * each element they set is written once; see cset_batch_begin().
+ */
+static int execute_sequence(snd_use_case_mgr_t *uc_mgr,
+			    struct list_head *seq,
+			    struct ucm_index *value_index1,
+			    struct ucm_index *value_index2,
+			    struct ucm_index *value_index3)
+{
+	int err, err1;
+
+	cset_batch_begin(uc_mgr);
+	err = execute_sequence0(uc_mgr, seq, value_index1, value_index2,
+				value_index3);
+	err1 = cset_batch_end(uc_mgr);
+	return err < 0 ? err : err1;
+}
+
 /**
  * \brief Import master config and execute the default sequence
  * \param uc_mgr Use case manager
@@ -454,42 +661,13 @@ static int import_master_config(snd_use_case_mgr_t *uc_mgr)
 	err = uc_mgr_import_master_config(uc_mgr);
 	if (err < 0)
 		return err;
-	err = execute_sequence(uc_mgr, &uc_mgr->default_list,
-			       &uc_mgr->value_list, NULL, NULL);
+	err = execute_sequence(uc_mgr, &uc_mgr->tree->default_list,
+			       &uc_mgr->tree->value_index, NULL, NULL);
 	if (err < 0)
 		uc_error("Unable to execute default sequence");
 	return err;
 }
 
-/**
- * \brief Universal find - string in a list
- * \param list List of structures
- * \param offset Offset of list structure
- * \param soffset Offset of string structure
- * \param match String to match
- * \return structure on success, otherwise a NULL (not found)
- */
-static void *find0(struct list_head *list,
-		   unsigned long offset,
-		   unsigned long soffset,
-		   const char *match)
-{
-	struct list_head *pos;
-	char *ptr, *str;
-
-	list_for_each(pos, list) {
-		ptr = list_entry_offset(pos, char, offset);
-		str = *((char **)(ptr + soffset));
-		if (strcmp(str, match) == 0)
-			return ptr;
-	}
-	return NULL;
-}
-
-#define find(list, type, member, value, match) \
-	find0(list, (unsigned long)(&((type *)0)->member), \
-		    (unsigned long)(&((type *)0)->value), match)
-
 /**
  * \brief Universal string list
  * \param list List of structures
@@ -605,16 +783,15 @@ static int get_list20(struct list_head *list,
 static inline struct use_case_verb *find_verb(snd_use_case_mgr_t *uc_mgr,
 					      const char *verb_name)
 {
-	return find(&uc_mgr->verb_list,
-		    struct use_case_verb, list, name,
-		    verb_name);
+	return uc_mgr_index_find(&uc_mgr->tree->verb_index, verb_name,
+				 strlen(verb_name), NULL);
 }
 
 static int is_devlist_supported(snd_use_case_mgr_t *uc_mgr, 
 	struct dev_list *dev_list)
 {
 	struct dev_list_node *device;
-	struct use_case_device *adev;
+	struct ucm_active *adev;
 	struct list_head *pos, *pos1;
 	int found_ret;
 
@@ -634,8 +811,7 @@ static int is_devlist_supported(snd_use_case_mgr_t *uc_mgr,
 		device = list_entry(pos, struct dev_list_node, list);
 
 		list_for_each(pos1, &uc_mgr->active_devices) {
-			adev = list_entry(pos1, struct use_case_device,
-					    active_list);
+			adev = list_entry(pos1, struct ucm_active, list);
 			if (!strcmp(device->name, adev->name))
 				return found_ret;
 		}
@@ -668,6 +844,16 @@ static inline struct use_case_device *
 	struct use_case_device *device;
 	struct list_head *pos;
 
+	device = uc_mgr_index_find(&verb->device_index, device_name,
+				   strlen(device_name), NULL);
+	if (device == NULL)
+		return NULL;
+	if (!check_supported || is_device_supported(uc_mgr, device))
+		return device;
+	if (!verb->device_index.dups)
+		return NULL;
+
+	/* another device of the same name may be supported */
 	list_for_each(pos, &verb->device_list) {
 		device = list_entry(pos, struct use_case_device, list);
 
@@ -696,6 +882,16 @@ static struct use_case_modifier *
 	struct use_case_modifier *modifier;
 	struct list_head *pos;
 
+	modifier = uc_mgr_index_find(&verb->modifier_index, modifier_name,
+				     strlen(modifier_name), NULL);
+	if (modifier == NULL)
+		return NULL;
+	if (!check_supported || is_modifier_supported(uc_mgr, modifier))
+		return modifier;
+	if (!verb->modifier_index.dups)
+		return NULL;
+
+	/* another modifier of the same name may be supported */
 	list_for_each(pos, &verb->modifier_list) {
 		modifier = list_entry(pos, struct use_case_modifier, list);
 
@@ -714,11 +910,11 @@ static struct use_case_modifier *
 long device_status(snd_use_case_mgr_t *uc_mgr,
                    const char *device_name)
 {
-        struct use_case_device *dev;
+        struct ucm_active *dev;
         struct list_head *pos;
 
         list_for_each(pos, &uc_mgr->active_devices) {
-                dev = list_entry(pos, struct use_case_device, active_list);
+                dev = list_entry(pos, struct ucm_active, list);
                 if (strcmp(dev->name, device_name) == 0)
                         return 1;
         }
@@ -728,17 +924,71 @@ long device_status(snd_use_case_mgr_t *uc_mgr,
 long modifier_status(snd_use_case_mgr_t *uc_mgr,
                      const char *modifier_name)
 {
-        struct use_case_modifier *mod;
+        struct ucm_active *mod;
         struct list_head *pos;
 
         list_for_each(pos, &uc_mgr->active_modifiers) {
-                mod = list_entry(pos, struct use_case_modifier, active_list);
+                mod = list_entry(pos, struct ucm_active, list);
                 if (strcmp(mod->name, modifier_name) == 0)
                         return 1;
         }
         return 0;
 }
 
+/**
+ * \brief Mark a device or modifier enabled
+ * \param base List of the enabled devices or modifiers
+ * \param name Name of the device or modifier
+ * \param elem Device or modifier
+ * \return zero on success, otherwise a negative error code
+ */
+static int add_active(struct list_head *base, const char *name, void *elem)
+{
+	struct ucm_active *active;
+
+	active = malloc(sizeof(*active));
+	if (active == NULL)
+		return -ENOMEM;
+	active->name = name;
+	active->u.device = elem;
+	list_add_tail(&active->list, base);
+	return 0;
+}
+
+/**
+ * \brief Find an enabled device or modifier
+ * \param base List of the enabled devices or modifiers
+ * \param elem Device or modifier
+ * \return structure on success, otherwise a NULL (not enabled)
+ */
+static struct ucm_active *find_active(struct list_head *base, void *elem)
+{
+	struct ucm_active *active;
+	struct list_head *pos;
+
+	list_for_each(pos, base) {
+		active = list_entry(pos, struct ucm_active, list);
+		if (active->u.device == elem)
+			return active;
+	}
+	return NULL;
+}
+
+/**
+ * \brief Mark a device or modifier disabled
+ * \param base List of the enabled devices or modifiers
+ * \param elem Device or modifier
+ */
+static void del_active(struct list_head *base, void *elem)
+{
+	struct ucm_active *active = find_active(base, elem);
+
+	if (active != NULL) {
+		list_del(&active->list);
+		free(active);
+	}
+}
+
 /**
  * \brief Set verb
  * \param uc_mgr Use case manager
@@ -759,8 +1009,8 @@ static int set_verb(snd_use_case_mgr_t *uc_mgr,
 		seq = &verb->disable_list;
 	}
 	err = execute_sequence(uc_mgr, seq,
-			       &verb->value_list,
-			       &uc_mgr->value_list,
+			       &verb->value_index,
+			       &uc_mgr->tree->value_index,
 			       NULL);
 	if (enable && err >= 0)
 		uc_mgr->active_verb = verb;
@@ -790,13 +1040,14 @@ static int set_modifier(snd_use_case_mgr_t *uc_mgr,
 		seq = &modifier->disable_list;
 	}
 	err = execute_sequence(uc_mgr, seq,
-			       &modifier->value_list,
-			       &uc_mgr->active_verb->value_list,
-			       &uc_mgr->value_list);
+			       &modifier->value_index,
+			       &uc_mgr->active_verb->value_index,
+			       &uc_mgr->tree->value_index);
 	if (enable && err >= 0) {
-		list_add_tail(&modifier->active_list, &uc_mgr->active_modifiers);
+		err = add_active(&uc_mgr->active_modifiers, modifier->name,
+				 modifier);
 	} else if (!enable) {
-		list_del(&modifier->active_list);
+		del_active(&uc_mgr->active_modifiers, modifier);
 	}
 	return err;
 }
@@ -824,13 +1075,14 @@ static int set_device(snd_use_case_mgr_t *uc_mgr,
 		seq = &device->disable_list;
 	}
 	err = execute_sequence(uc_mgr, seq,
-			       &device->value_list,
-			       &uc_mgr->active_verb->value_list,
-			       &uc_mgr->value_list);
+			       &device->value_index,
+			       &uc_mgr->active_verb->value_index,
+			       &uc_mgr->tree->value_index);
 	if (enable && err >= 0) {
-		list_add_tail(&device->active_list, &uc_mgr->active_devices);
+		err = add_active(&uc_mgr->active_devices, device->name,
+				 device);
 	} else if (!enable) {
-		list_del(&device->active_list);
+		del_active(&uc_mgr->active_devices, device);
 	}
 	return err;
 }
@@ -845,17 +1097,17 @@ int snd_use_case_mgr_open(snd_use_case_mgr_t **uc_mgr,
 			  const char *card_name)
 {
 	snd_use_case_mgr_t *mgr;
+	unsigned int i;
 	int err;
 
 	/* create a new UCM */
 	mgr = calloc(1, sizeof(snd_use_case_mgr_t));
 	if (mgr == NULL)
 		return -ENOMEM;
-	INIT_LIST_HEAD(&mgr->verb_list);
-	INIT_LIST_HEAD(&mgr->default_list);
-	INIT_LIST_HEAD(&mgr->value_list);
 	INIT_LIST_HEAD(&mgr->active_modifiers);
 	INIT_LIST_HEAD(&mgr->active_devices);
+	for (i = 0; i < UC_MGR_CSET_HASH; i++)
+		INIT_LIST_HEAD(&mgr->cset_info[i]);
 	pthread_mutex_init(&mgr->mutex, NULL);
 
 	mgr->card_name = strdup(card_name);
@@ -928,22 +1180,18 @@ static int dismantle_use_case(snd_use_case_mgr_t *uc_mgr)
 	int err;
 
 	list_for_each_safe(pos, npos, &uc_mgr->active_modifiers) {
-		modifier = list_entry(pos, struct use_case_modifier,
-				      active_list);
+		modifier = list_entry(pos, struct ucm_active, list)->u.modifier;
 		err = set_modifier(uc_mgr, modifier, 0);
 		if (err < 0)
 			uc_error("Unable to disable modifier %s", modifier->name);
 	}
-	INIT_LIST_HEAD(&uc_mgr->active_modifiers);
 
 	list_for_each_safe(pos, npos, &uc_mgr->active_devices) {
-		device = list_entry(pos, struct use_case_device,
-				    active_list);
+		device = list_entry(pos, struct ucm_active, list)->u.device;
 		err = set_device(uc_mgr, device, 0);
 		if (err < 0)
 			uc_error("Unable to disable device %s", device->name);
 	}
-	INIT_LIST_HEAD(&uc_mgr->active_devices);
 
 	err = set_verb(uc_mgr, uc_mgr->active_verb, 0);
 	if (err < 0) {
@@ -952,8 +1200,8 @@ static int dismantle_use_case(snd_use_case_mgr_t *uc_mgr)
 	}
 	uc_mgr->active_verb = NULL;
 
-	err = execute_sequence(uc_mgr, &uc_mgr->default_list,
-			       &uc_mgr->value_list, NULL, NULL);
+	err = execute_sequence(uc_mgr, &uc_mgr->tree->default_list,
+			       &uc_mgr->tree->value_index, NULL, NULL);
 	
 	return err;
 }
@@ -968,10 +1216,10 @@ int snd_use_case_mgr_reset(snd_use_case_mgr_t *uc_mgr)
         int err;
 
 	pthread_mutex_lock(&uc_mgr->mutex);
-	err = execute_sequence(uc_mgr, &uc_mgr->default_list,
-			       &uc_mgr->value_list, NULL, NULL);
-	INIT_LIST_HEAD(&uc_mgr->active_modifiers);
-	INIT_LIST_HEAD(&uc_mgr->active_devices);
+	err = execute_sequence(uc_mgr, &uc_mgr->tree->default_list,
+			       &uc_mgr->tree->value_index, NULL, NULL);
+	uc_mgr_free_active(&uc_mgr->active_modifiers);
+	uc_mgr_free_active(&uc_mgr->active_devices);
 	uc_mgr->active_verb = NULL;
 	pthread_mutex_unlock(&uc_mgr->mutex);
 	return err;
@@ -985,7 +1233,7 @@ int snd_use_case_mgr_reset(snd_use_case_mgr_t *uc_mgr)
  */
 static int get_verb_list(snd_use_case_mgr_t *uc_mgr, const char **list[])
 {
-        return get_list2(&uc_mgr->verb_list, list,
+        return get_list2(&uc_mgr->tree->verb_list, list,
                          struct use_case_verb, list,
                          name, comment);
 }
@@ -1178,7 +1426,7 @@ static int get_value_list(snd_use_case_mgr_t *uc_mgr,
         if (verb == NULL)
                 return -ENOENT;
         INIT_LIST_HEAD(&mylist);
-	err = add_values(&mylist, identifier, &uc_mgr->value_list);
+	err = add_values(&mylist, identifier, &uc_mgr->tree->value_list);
 	if (err < 0)
 		goto __fail;
         err = add_values(&mylist, identifier, &verb->value_list);
@@ -1231,7 +1479,7 @@ static int get_enabled_device_list(snd_use_case_mgr_t *uc_mgr,
         if (uc_mgr->active_verb == NULL)
                 return -EINVAL;
         return get_list(&uc_mgr->active_devices, list,
-                        struct use_case_device, active_list,
+                        struct ucm_active, list,
                         name);
 }
 
@@ -1247,7 +1495,7 @@ static int get_enabled_modifier_list(snd_use_case_mgr_t *uc_mgr,
         if (uc_mgr->active_verb == NULL)
                 return -EINVAL;
         return get_list(&uc_mgr->active_modifiers, list,
-                        struct use_case_modifier, active_list,
+                        struct ucm_active, list,
                         name);
 }
 
@@ -1305,42 +1553,55 @@ int snd_use_case_get_list(snd_use_case_mgr_t *uc_mgr,
 	return err;
 }
 
-static int get_value1(char **value, struct list_head *value_list,
+static int get_value1(char **value, struct ucm_index *value_index,
                       const char *identifier)
 {
-        struct ucm_value *val;
-        struct list_head *pos;
-        
-	if (!value_list)
+        struct ucm_value *val, *found = NULL;
+        unsigned int pos, found_pos = 0;
+        const char *p;
+
+	if (!value_index)
 		return -ENOENT;
 
-        list_for_each(pos, value_list) {
-              val = list_entry(pos, struct ucm_value, list);
-              if (check_identifier(identifier, val->name)) {
-                      *value = strdup(val->data);
-                      if (*value == NULL)
-                              return -ENOMEM;
-                      return 0;
-              }
-        }
-        return -ENOENT;
+	/*
+	 * The value named by the identifier or by a part of it before a
+	 * slash; the first one in the list when there are several.
+	 */
+	for (p = identifier; ; p++) {
+		if (*p != '/' && *p != '\0')
+			continue;
+		val = uc_mgr_index_find(value_index, identifier,
+					p - identifier, &pos);
+		if (val != NULL && (found == NULL || pos < found_pos)) {
+			found = val;
+			found_pos = pos;
+		}
+		if (*p == '\0')
+			break;
+	}
+	if (found == NULL)
+		return -ENOENT;
+	*value = strdup(found->data);
+	if (*value == NULL)
+		return -ENOMEM;
+	return 0;
 }
 
 static int get_value3(char **value,
 		      const char *identifier,
-		      struct list_head *value_list1,
-		      struct list_head *value_list2,
-		      struct list_head *value_list3)
+		      struct ucm_index *value_index1,
+		      struct ucm_index *value_index2,
+		      struct ucm_index *value_index3)
 {
 	int err;
 
-	err = get_value1(value, value_list1, identifier);
+	err = get_value1(value, value_index1, identifier);
 	if (err >= 0 || err != -ENOENT)
 		return err;
-	err = get_value1(value, value_list2, identifier);
+	err = get_value1(value, value_index2, identifier);
 	if (err >= 0 || err != -ENOENT)
 		return err;
-	err = get_value1(value, value_list3, identifier);
+	err = get_value1(value, value_index3, identifier);
 	if (err >= 0 || err != -ENOENT)
 		return err;
 	return -ENOENT;
@@ -1378,7 +1639,7 @@ static int get_value(snd_use_case_mgr_t *uc_mgr,
 						    mod_dev_name, 0);
 				if (mod) {
 					err = get_value1(value,
-							 &mod->value_list,
+							 &mod->value_index,
 							 identifier);
 					if (err >= 0 || err != -ENOENT)
 						return err;
@@ -1388,7 +1649,7 @@ static int get_value(snd_use_case_mgr_t *uc_mgr,
 						  mod_dev_name, 0);
 				if (dev) {
 					err = get_value1(value,
-							 &dev->value_list,
+							 &dev->value_index,
 							 identifier);
 					if (err >= 0 || err != -ENOENT)
 						return err;
@@ -1398,7 +1659,7 @@ static int get_value(snd_use_case_mgr_t *uc_mgr,
 					return -ENOENT;
 			}
 
-			err = get_value1(value, &verb->value_list, identifier);
+			err = get_value1(value, &verb->value_index, identifier);
 			if (err >= 0 || err != -ENOENT)
 				return err;
 		}
@@ -1407,7 +1668,7 @@ static int get_value(snd_use_case_mgr_t *uc_mgr,
 			return -ENOENT;
 	}
 
-	err = get_value1(value, &uc_mgr->value_list, identifier);
+	err = get_value1(value, &uc_mgr->tree->value_index, identifier);
 	if (err >= 0 || err != -ENOENT)
 		return err;
 
@@ -1568,8 +1829,8 @@ static int handle_transition_verb(snd_use_case_mgr_t *uc_mgr,
                 trans = list_entry(pos, struct transition_sequence, list);
                 if (strcmp(trans->name, new_verb->name) == 0) {
                         err = execute_sequence(uc_mgr, &trans->transition_list,
-					       &uc_mgr->active_verb->value_list,
-					       &uc_mgr->value_list,
+					       &uc_mgr->active_verb->value_index,
+					       &uc_mgr->tree->value_index,
 					       NULL);
                         if (err >= 0)
                                 return 1;
@@ -1652,6 +1913,7 @@ static int switch_device(snd_use_case_mgr_t *uc_mgr,
                          const char *new_device)
 {
         struct use_case_device *xold, *xnew;
+        struct ucm_active *active;
         struct transition_sequence *trans;
         struct list_head *pos;
         int err, seq_found = 0;
@@ -1669,9 +1931,12 @@ static int switch_device(snd_use_case_mgr_t *uc_mgr,
         xold = find_device(uc_mgr, uc_mgr->active_verb, old_device, 1);
         if (xold == NULL)
                 return -ENOENT;
-        list_del(&xold->active_list);
+        active = find_active(&uc_mgr->active_devices, xold);
+        if (active == NULL)
+                return -ENOENT;
+        list_del(&active->list);
         xnew = find_device(uc_mgr, uc_mgr->active_verb, new_device, 1);
-        list_add_tail(&xold->active_list, &uc_mgr->active_devices);
+        list_add_tail(&active->list, &uc_mgr->active_devices);
         if (xnew == NULL)
                 return -ENOENT;
         err = 0;
@@ -1679,12 +1944,14 @@ static int switch_device(snd_use_case_mgr_t *uc_mgr,
                 trans = list_entry(pos, struct transition_sequence, list);
                 if (strcmp(trans->name, new_device) == 0) {
                         err = execute_sequence(uc_mgr, &trans->transition_list,
-					       &xold->value_list,
-					       &uc_mgr->active_verb->value_list,
-					       &uc_mgr->value_list);
+					       &xold->value_index,
+					       &uc_mgr->active_verb->value_index,
+					       &uc_mgr->tree->value_index);
                         if (err >= 0) {
-                                list_del(&xold->active_list);
-                                list_add_tail(&xnew->active_list, &uc_mgr->active_devices);
+                                active->name = xnew->name;
+                                active->u.device = xnew;
+                                list_del(&active->list);
+                                list_add_tail(&active->list, &uc_mgr->active_devices);
                         }
                         seq_found = 1;
                         break;
@@ -1706,6 +1973,7 @@ static int switch_modifier(snd_use_case_mgr_t *uc_mgr,
                            const char *new_modifier)
 {
         struct use_case_modifier *xold, *xnew;
+        struct ucm_active *active;
         struct transition_sequence *trans;
         struct list_head *pos;
         int err, seq_found = 0;
@@ -1723,6 +1991,9 @@ static int switch_modifier(snd_use_case_mgr_t *uc_mgr,
         xold = find_modifier(uc_mgr, uc_mgr->active_verb, old_modifier, 1);
         if (xold == NULL)
                 return -ENOENT;
+        active = find_active(&uc_mgr->active_modifiers, xold);
+        if (active == NULL)
+                return -ENOENT;
         xnew = find_modifier(uc_mgr, uc_mgr->active_verb, new_modifier, 1);
         if (xnew == NULL)
                 return -ENOENT;
@@ -1731,12 +2002,14 @@ static int switch_modifier(snd_use_case_mgr_t *uc_mgr,
                 trans = list_entry(pos, struct transition_sequence, list);
                 if (strcmp(trans->name, new_modifier) == 0) {
                         err = execute_sequence(uc_mgr, &trans->transition_list,
-					       &xold->value_list,
-					       &uc_mgr->active_verb->value_list,
-					       &uc_mgr->value_list);
+					       &xold->value_index,
+					       &uc_mgr->active_verb->value_index,
+					       &uc_mgr->tree->value_index);
                         if (err >= 0) {
-                                list_del(&xold->active_list);
-                                list_add_tail(&xnew->active_list, &uc_mgr->active_modifiers);
+                                active->name = xnew->name;
+                                active->u.modifier = xnew;
+                                list_del(&active->list);
+                                list_add_tail(&active->list, &uc_mgr->active_modifiers);
                         }
                         seq_found = 1;
                         break;
@@ -1765,9 +2038,11 @@ int snd_use_case_set(snd_use_case_mgr_t *uc_mgr,
                      const char *value)
 {
 	char *str, *str1;
-	int err = 0;
+	int err = 0, err1;
 
 	pthread_mutex_lock(&uc_mgr->mutex);
+	/* the sequences of a switch set each element once */
+	cset_batch_begin(uc_mgr);
 	if (strcmp(identifier, "_verb") == 0)
 	        err = set_verb_user(uc_mgr, value);
         else if (strcmp(identifier, "_enadev") == 0)
@@ -1800,6 +2075,9 @@ int snd_use_case_set(snd_use_case_mgr_t *uc_mgr,
                         free(str);
         }
       __end:
+	err1 = cset_batch_end(uc_mgr);
+	if (err >= 0 && err1 < 0)
+		err = err1;
 	pthread_mutex_unlock(&uc_mgr->mutex);
         return err;
 }
@@ -31,11 +31,14 @@
  */
 
 #include "ucm_local.h"
+#include <ctype.h>
 #include <dirent.h>
+#include <sys/stat.h>
 
 /** The name of the environment variable containing the UCM directory */
 #define ALSA_CONFIG_UCM_VAR "ALSA_CONFIG_UCM"
 
+static int tree_add_file(struct ucm_tree *tree, const char *filename);
 static int parse_sequence(snd_use_case_mgr_t *uc_mgr,
 			  struct list_head *base,
 			  snd_config_t *cfg);
@@ -235,6 +238,33 @@ static int parse_device_list(snd_use_case_mgr_t *uc_mgr ATTRIBUTE_UNUSED,
 	return 0;
 }
 
+/*
+ * Split a cset in the element id and the value.  A cset which cannot be
+ * split is left for the execution to report.
+ */
+static int parse_cset(struct sequence_element *curr)
+{
+	snd_ctl_elem_id_t *id;
+	const char *pos;
+
+	id = calloc(1, sizeof(*id));
+	if (id == NULL)
+		return -ENOMEM;
+	if (__snd_ctl_ascii_elem_id_parse(id, curr->data.cset, &pos) < 0) {
+		free(id);
+		return 0;
+	}
+	while (*pos && isspace(*pos))
+		pos++;
+	if (!*pos) {
+		free(id);
+		return 0;
+	}
+	curr->cset_id = id;
+	curr->cset_value = pos;
+	return 0;
+}
+
 /*
  * Parse sequences.
  *
@@ -303,6 +333,9 @@ static int parse_sequence(snd_use_case_mgr_t *uc_mgr ATTRIBUTE_UNUSED,
 				uc_error("error: cset requires a string!");
 				return err;
 			}
+			err = parse_cset(curr);
+			if (err < 0)
+				return err;
 			continue;
 		}
 
@@ -313,6 +346,9 @@ static int parse_sequence(snd_use_case_mgr_t *uc_mgr ATTRIBUTE_UNUSED,
 				uc_error("error: cset-bin-file requires a string!");
 				return err;
 			}
+			err = parse_cset(curr);
+			if (err < 0)
+				return err;
 			continue;
 		}
 
@@ -323,6 +359,9 @@ static int parse_sequence(snd_use_case_mgr_t *uc_mgr ATTRIBUTE_UNUSED,
 				uc_error("error: cset-tlv requires a string!");
 				return err;
 			}
+			err = parse_cset(curr);
+			if (err < 0)
+				return err;
 			continue;
 		}
 
@@ -940,7 +979,7 @@ static int parse_verb_file(snd_use_case_mgr_t *uc_mgr,
 	INIT_LIST_HEAD(&verb->device_list);
 	INIT_LIST_HEAD(&verb->modifier_list);
 	INIT_LIST_HEAD(&verb->value_list);
-	list_add_tail(&verb->list, &uc_mgr->verb_list);
+	list_add_tail(&verb->list, &uc_mgr->tree->verb_list);
 	if (use_case_name == NULL)
 		return -EINVAL;
 	verb->name = strdup(use_case_name);
@@ -958,7 +997,10 @@ static int parse_verb_file(snd_use_case_mgr_t *uc_mgr,
 		env ? env : ALSA_USE_CASE_DIR,
 		uc_mgr->card_name, file);
 	filename[sizeof(filename)-1] = '\0';
-	
+
+	err = tree_add_file(uc_mgr->tree, filename);
+	if (err < 0)
+		return err;
 	err = uc_mgr_config_load(filename, &cfg);
 	if (err < 0) {
 		uc_error("error: failed to open verb file %s : %d",
@@ -1087,11 +1129,11 @@ static int parse_controls(snd_use_case_mgr_t *uc_mgr, snd_config_t *cfg)
 {
 	int err;
 	
-	if (!list_empty(&uc_mgr->default_list)) {
+	if (!list_empty(&uc_mgr->tree->default_list)) {
 		uc_error("Default list is not empty");
 		return -EINVAL;
 	}
-	err = parse_sequence(uc_mgr, &uc_mgr->default_list, cfg);
+	err = parse_sequence(uc_mgr, &uc_mgr->tree->default_list, cfg);
 	if (err < 0) {
 		uc_error("Unable to parse SectionDefaults");
 		return err;
@@ -1163,7 +1205,7 @@ static int parse_master_file(snd_use_case_mgr_t *uc_mgr, snd_config_t *cfg)
 			continue;
 
 		if (strcmp(id, "Comment") == 0) {
-			err = parse_string(n, &uc_mgr->comment);
+			err = parse_string(n, &uc_mgr->tree->comment);
 			if (err < 0) {
 				uc_error("error: failed to get master comment");
 				return err;
@@ -1191,7 +1233,7 @@ static int parse_master_file(snd_use_case_mgr_t *uc_mgr, snd_config_t *cfg)
 
 		/* get the default values */
 		if (strcmp(id, "ValueDefaults") == 0) {
-			err = parse_value(uc_mgr, &uc_mgr->value_list, n);
+			err = parse_value(uc_mgr, &uc_mgr->tree->value_list, n);
 			if (err < 0) {
 				uc_error("error: failed to parse ValueDefaults");
 				return err;
@@ -1204,17 +1246,22 @@ static int parse_master_file(snd_use_case_mgr_t *uc_mgr, snd_config_t *cfg)
 	return 0;
 }
 
-static int load_master_config(const char *card_name, snd_config_t **cfg)
+static void master_file_name(char *filename, const char *card_name)
 {
-	char filename[MAX_FILE];
 	char *env = getenv(ALSA_CONFIG_UCM_VAR);
-	int err;
 
-	snprintf(filename, sizeof(filename)-1,
+	snprintf(filename, MAX_FILE-1,
 		"%s/%s/%s.conf", env ? env : ALSA_USE_CASE_DIR,
 		card_name, card_name);
 	filename[MAX_FILE-1] = '\0';
+}
+
+static int load_master_config(const char *card_name, snd_config_t **cfg)
+{
+	char filename[MAX_FILE];
+	int err;
 
+	master_file_name(filename, card_name);
 	err = uc_mgr_config_load(filename, cfg);
 	if (err < 0) {
 		uc_error("error: could not parse configuration for card %s",
@@ -1225,23 +1272,170 @@ static int load_master_config(const char *card_name, snd_config_t **cfg)
 	return 0;
 }
 
+/*
+ * Cache of the parsed configurations.  A tree stays cached after its last
+ * manager is closed; it is dropped once one of its files changed.
+ */
+static LIST_HEAD(tree_cache);
+static pthread_mutex_t tree_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* remember a file read by the parser, before reading it */
+static int tree_add_file(struct ucm_tree *tree, const char *filename)
+{
+	struct ucm_file *file;
+	struct stat st;
+
+	/* a missing file fails the parsing anyway */
+	if (stat(filename, &st) < 0)
+		return 0;
+	file = calloc(1, sizeof(*file));
+	if (file == NULL)
+		return -ENOMEM;
+	file->name = strdup(filename);
+	if (file->name == NULL) {
+		free(file);
+		return -ENOMEM;
+	}
+	file->dev = st.st_dev;
+	file->ino = st.st_ino;
+	file->size = st.st_size;
+	file->mtime = st.st_mtim;
+	list_add_tail(&file->list, &tree->file_list);
+	return 0;
+}
+
+static int tree_is_stale(struct ucm_tree *tree)
+{
+	struct list_head *pos;
+	struct ucm_file *file;
+	struct stat st;
+
+	list_for_each(pos, &tree->file_list) {
+		file = list_entry(pos, struct ucm_file, list);
+		if (stat(file->name, &st) < 0 ||
+		    st.st_dev != file->dev || st.st_ino != file->ino ||
+		    st.st_size != file->size ||
+		    st.st_mtim.tv_sec != file->mtime.tv_sec ||
+		    st.st_mtim.tv_nsec != file->mtime.tv_nsec)
+			return 1;
+	}
+	return 0;
+}
+
+/* called with the cache locked */
+static struct ucm_tree *tree_cache_find(const char *master)
+{
+	struct list_head *pos, *npos;
+	struct ucm_tree *tree;
+
+	list_for_each_safe(pos, npos, &tree_cache) {
+		tree = list_entry(pos, struct ucm_tree, list);
+		if (strcmp(tree->master, master))
+			continue;
+		if (!tree_is_stale(tree))
+			return tree;
+		list_del(&tree->list);
+		tree->cached = 0;
+		if (tree->refs == 0)
+			uc_mgr_free_tree(tree);
+	}
+	return NULL;
+}
+
+static struct ucm_tree *tree_new(const char *master)
+{
+	struct ucm_tree *tree;
+
+	tree = calloc(1, sizeof(*tree));
+	if (tree == NULL)
+		return NULL;
+	tree->master = strdup(master);
+	if (tree->master == NULL) {
+		free(tree);
+		return NULL;
+	}
+	tree->refs = 1;
+	INIT_LIST_HEAD(&tree->verb_list);
+	INIT_LIST_HEAD(&tree->default_list);
+	INIT_LIST_HEAD(&tree->value_list);
+	INIT_LIST_HEAD(&tree->file_list);
+	return tree;
+}
+
+/* release a tree of a manager */
+void uc_mgr_put_tree(struct ucm_tree *tree)
+{
+	pthread_mutex_lock(&tree_cache_mutex);
+	if (--tree->refs == 0 && !tree->cached)
+		uc_mgr_free_tree(tree);
+	pthread_mutex_unlock(&tree_cache_mutex);
+}
+
 /* load master use case file for sound card */
 int uc_mgr_import_master_config(snd_use_case_mgr_t *uc_mgr)
 {
+	char filename[MAX_FILE];
+	struct ucm_tree *tree;
 	snd_config_t *cfg;
 	int err;
 
+	master_file_name(filename, uc_mgr->card_name);
+
+	pthread_mutex_lock(&tree_cache_mutex);
+	tree = tree_cache_find(filename);
+	if (tree != NULL)
+		tree->refs++;
+	pthread_mutex_unlock(&tree_cache_mutex);
+	if (tree != NULL) {
+		uc_mgr->tree = tree;
+		return 0;
+	}
+
+	uc_mgr->tree = tree_new(filename);
+	if (uc_mgr->tree == NULL)
+		return -ENOMEM;
+	err = tree_add_file(uc_mgr->tree, filename);
+	if (err < 0)
+		goto __err;
 	err = load_master_config(uc_mgr->card_name, &cfg);
 	if (err < 0)
-		return err;
+		goto __err;
 	err = parse_master_file(uc_mgr, cfg);
 	snd_config_delete(cfg);
 	if (err < 0)
-		uc_mgr_free_verb(uc_mgr);
+		goto __err;
+	err = uc_mgr_index_tree(uc_mgr->tree);
+	if (err < 0)
+		goto __err;
+
+	pthread_mutex_lock(&tree_cache_mutex);
+	uc_mgr->tree->cached = 1;
+	list_add(&uc_mgr->tree->list, &tree_cache);
+	pthread_mutex_unlock(&tree_cache_mutex);
+	return 0;
 
+      __err:
+	uc_mgr_free_verb(uc_mgr);
 	return err;
 }
 
+/* free the cached trees no manager uses */
+void snd_ucm_cache_cleanup(void)
+{
+	struct list_head *pos, *npos;
+	struct ucm_tree *tree;
+
+	pthread_mutex_lock(&tree_cache_mutex);
+	list_for_each_safe(pos, npos, &tree_cache) {
+		tree = list_entry(pos, struct ucm_tree, list);
+		if (tree->refs)
+			continue;
+		list_del(&tree->list);
+		uc_mgr_free_tree(tree);
+	}
+	pthread_mutex_unlock(&tree_cache_mutex);
+}
+
 static int filename_filter(const struct dirent *dirent)
 {
 	if (dirent == NULL)
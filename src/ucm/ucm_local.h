@@ -50,6 +50,22 @@
 #define SEQUENCE_ELEMENT_TYPE_CSET_BIN_FILE	5
 #define SEQUENCE_ELEMENT_TYPE_CSET_TLV	6
 
+/*
+ * Name index of a list, built once the configuration is parsed.
+ * The position keeps the list order for names found more than once.
+ */
+struct ucm_index_slot {
+	const char *name;
+	void *elem;
+	unsigned int pos;
+};
+
+struct ucm_index {
+	unsigned int mask;		/* table size - 1 */
+	unsigned int dups: 1;		/* a name is in the list twice */
+	struct ucm_index_slot *table;
+};
+
 struct ucm_value {
         struct list_head list;
         char *name;
@@ -65,6 +81,9 @@ struct sequence_element {
 		char *cset;
 		char *exec;
 	} data;
+	/* cset: element id parsed at load time and the value after it */
+	snd_ctl_elem_id_t *cset_id;
+	const char *cset_value;
 };
 
 /*
@@ -101,7 +120,6 @@ struct dev_list {
  */
 struct use_case_modifier {
 	struct list_head list;
-	struct list_head active_list;
 
 	char *name;
 	char *comment;
@@ -118,6 +136,7 @@ struct use_case_modifier {
 
 	/* values */
 	struct list_head value_list;
+	struct ucm_index value_index;
 };
 
 /*
@@ -126,7 +145,6 @@ struct use_case_modifier {
  */
 struct use_case_device {
 	struct list_head list;
-	struct list_head active_list;
 
 	char *name;
 	char *comment;
@@ -143,6 +161,7 @@ struct use_case_device {
 
 	/* value list */
 	struct list_head value_list;
+	struct ucm_index value_index;
 };
 
 /*
@@ -166,29 +185,88 @@ struct use_case_verb {
 
 	/* hardware devices that can be used with this use case */
 	struct list_head device_list;
+	struct ucm_index device_index;
 
 	/* modifiers that can be used with this use case */
 	struct list_head modifier_list;
+	struct ucm_index modifier_index;
 
 	/* value list */
 	struct list_head value_list;
+	struct ucm_index value_index;
 };
 
 /*
- *  Manages a sound card and all its use cases.
+ * Enabled device or modifier of a manager.  The parsed configuration
+ * is shared, so the state is kept aside.
  */
-struct snd_use_case_mgr {
-	char *card_name;
+struct ucm_active {
+	struct list_head list;
+	const char *name;
+	union {
+		struct use_case_device *device;
+		struct use_case_modifier *modifier;
+	} u;
+};
+
+/*
+ * File read by the parser, to find out when a cached tree is stale.
+ */
+struct ucm_file {
+	struct list_head list;
+	char *name;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+};
+
+/*
+ * Parsed configuration of a sound card, shared by the managers of the
+ * process opened on the same card and kept cached while the files are
+ * unchanged.  Read only once parsed.
+ */
+struct ucm_tree {
+	struct list_head list;		/* in the cache */
+	unsigned int refs;
+	int cached;
+	char *master;			/* path of the master file */
 	char *comment;
 
 	/* use case verb, devices and modifier configs parsed from files */
 	struct list_head verb_list;
+	struct ucm_index verb_index;
 
 	/* default settings - sequence */
 	struct list_head default_list;
 
 	/* default settings - value list */
 	struct list_head value_list;
+	struct ucm_index value_index;
+
+	/* files parsed */
+	struct list_head file_list;
+};
+
+/*
+ * Element info of an executed cset, resolved once per ctl handle.
+ */
+struct ucm_cset_info {
+	struct list_head list;
+	const struct sequence_element *seq;
+	snd_ctl_elem_info_t info;
+};
+
+#define UC_MGR_CSET_HASH	64
+
+/*
+ *  Manages a sound card and all its use cases.
+ */
+struct snd_use_case_mgr {
+	char *card_name;
+
+	/* parsed configuration */
+	struct ucm_tree *tree;
 
 	/* current status */
 	struct use_case_verb *active_verb;
@@ -201,6 +279,16 @@ struct snd_use_case_mgr {
 	/* change to list of ctl handles */
 	snd_ctl_t *ctl;
 	char *ctl_dev;
+
+	/* element info of the csets executed on ctl */
+	struct list_head cset_info[UC_MGR_CSET_HASH];
+
+	/* final values of the elements set by the running sequences */
+	snd_ctl_elem_value_t *batch;
+	unsigned int batch_count;
+	unsigned int batch_alloc;
+	unsigned int batch_depth;
+	snd_ctl_t *batch_ctl;
 };
 
 #define uc_error SNDERR
@@ -217,8 +305,21 @@ void uc_mgr_stdout(const char *fmt, ...);
 int uc_mgr_config_load(const char *file, snd_config_t **cfg);
 int uc_mgr_import_master_config(snd_use_case_mgr_t *uc_mgr);
 int uc_mgr_scan_master_configs(const char **_list[]);
+void uc_mgr_put_tree(struct ucm_tree *tree);
+
+int uc_mgr_index_tree(struct ucm_tree *tree);
+void *uc_mgr_index_find(const struct ucm_index *index, const char *name,
+			size_t len, unsigned int *pos);
 
 void uc_mgr_free_sequence_element(struct sequence_element *seq);
 void uc_mgr_free_transition_element(struct transition_sequence *seq);
+void uc_mgr_free_active(struct list_head *base);
+void uc_mgr_free_cset_info(snd_use_case_mgr_t *uc_mgr);
+void uc_mgr_free_tree(struct ucm_tree *tree);
 void uc_mgr_free_verb(snd_use_case_mgr_t *uc_mgr);
 void uc_mgr_free(snd_use_case_mgr_t *uc_mgr);
+
+/* used by UCM parser, too */
+extern int __snd_ctl_ascii_elem_id_parse(snd_ctl_elem_id_t *dst,
+					 const char *str,
+					 const char **ret_ptr);
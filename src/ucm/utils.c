@@ -85,6 +85,142 @@ int uc_mgr_config_load(const char *file, snd_config_t **cfg)
 	return 0;
 }
 
+static unsigned int index_hash(const char *name, size_t len)
+{
+	unsigned int h = 2166136261U;
+
+	while (len-- > 0)
+		h = (h ^ (unsigned char)*name++) * 16777619U;
+	return h;
+}
+
+static int index_build(struct ucm_index *index, struct list_head *list,
+		       unsigned long offset, unsigned long soffset)
+{
+	struct list_head *pos;
+	struct ucm_index_slot *slot;
+	unsigned int size = 8, cnt = 0, h;
+	char *ptr, *str;
+
+	list_for_each(pos, list)
+		cnt++;
+	if (cnt == 0)
+		return 0;
+	while (size < cnt * 2)
+		size <<= 1;
+	index->table = calloc(size, sizeof(*index->table));
+	if (index->table == NULL)
+		return -ENOMEM;
+	index->mask = size - 1;
+	cnt = 0;
+	list_for_each(pos, list) {
+		ptr = list_entry_offset(pos, char, offset);
+		str = *((char **)(ptr + soffset));
+		h = index_hash(str, strlen(str));
+		for (;; h++) {
+			slot = &index->table[h & index->mask];
+			if (slot->name == NULL) {
+				slot->name = str;
+				slot->elem = ptr;
+				slot->pos = cnt;
+				break;
+			}
+			/* the first one in the list is found */
+			if (strcmp(slot->name, str) == 0) {
+				index->dups = 1;
+				break;
+			}
+		}
+		cnt++;
+	}
+	return 0;
+}
+
+#define index_list(index, base, type, member, s1) \
+	index_build(index, base, \
+		    (unsigned long)(&((type *)0)->member), \
+		    (unsigned long)(&((type *)0)->s1))
+
+#define index_values(index, base) \
+	index_list(index, base, struct ucm_value, list, name)
+
+/*
+ * Find the first element of an indexed list named by the first len
+ * characters of name.
+ */
+void *uc_mgr_index_find(const struct ucm_index *index, const char *name,
+			size_t len, unsigned int *pos)
+{
+	struct ucm_index_slot *slot;
+	unsigned int h;
+
+	if (index->table == NULL)
+		return NULL;
+	for (h = index_hash(name, len); ; h++) {
+		slot = &index->table[h & index->mask];
+		if (slot->name == NULL)
+			return NULL;
+		if (strncmp(slot->name, name, len) == 0 &&
+		    slot->name[len] == '\0') {
+			if (pos)
+				*pos = slot->pos;
+			return slot->elem;
+		}
+	}
+}
+
+static void index_free(struct ucm_index *index)
+{
+	free(index->table);
+	index->table = NULL;
+	index->mask = 0;
+}
+
+/* index the names of a parsed tree */
+int uc_mgr_index_tree(struct ucm_tree *tree)
+{
+	struct list_head *pos, *pos1;
+	struct use_case_verb *verb;
+	struct use_case_device *dev;
+	struct use_case_modifier *mod;
+	int err;
+
+	err = index_list(&tree->verb_index, &tree->verb_list,
+			 struct use_case_verb, list, name);
+	if (err < 0)
+		return err;
+	err = index_values(&tree->value_index, &tree->value_list);
+	if (err < 0)
+		return err;
+	list_for_each(pos, &tree->verb_list) {
+		verb = list_entry(pos, struct use_case_verb, list);
+		err = index_list(&verb->device_index, &verb->device_list,
+				 struct use_case_device, list, name);
+		if (err < 0)
+			return err;
+		err = index_list(&verb->modifier_index, &verb->modifier_list,
+				 struct use_case_modifier, list, name);
+		if (err < 0)
+			return err;
+		err = index_values(&verb->value_index, &verb->value_list);
+		if (err < 0)
+			return err;
+		list_for_each(pos1, &verb->device_list) {
+			dev = list_entry(pos1, struct use_case_device, list);
+			err = index_values(&dev->value_index, &dev->value_list);
+			if (err < 0)
+				return err;
+		}
+		list_for_each(pos1, &verb->modifier_list) {
+			mod = list_entry(pos1, struct use_case_modifier, list);
+			err = index_values(&mod->value_index, &mod->value_list);
+			if (err < 0)
+				return err;
+		}
+	}
+	return 0;
+}
+
 void uc_mgr_free_value(struct list_head *base)
 {
 	struct list_head *pos, *npos;
@@ -118,6 +254,11 @@ void uc_mgr_free_sequence_element(struct sequence_element *seq)
 		return;
 	switch (seq->type) {
 	case SEQUENCE_ELEMENT_TYPE_CSET:
+	case SEQUENCE_ELEMENT_TYPE_CSET_BIN_FILE:
+	case SEQUENCE_ELEMENT_TYPE_CSET_TLV:
+		free(seq->cset_id);
+		free(seq->data.cset);
+		break;
 	case SEQUENCE_ELEMENT_TYPE_EXEC:
 		free(seq->data.exec);
 		break;
@@ -172,6 +313,7 @@ void uc_mgr_free_modifier(struct list_head *base)
 		uc_mgr_free_transition(&mod->transition_list);
 		uc_mgr_free_dev_list(&mod->dev_list);
 		uc_mgr_free_value(&mod->value_list);
+		index_free(&mod->value_index);
 		list_del(&mod->list);
 		free(mod);
 	}
@@ -191,17 +333,31 @@ void uc_mgr_free_device(struct list_head *base)
 		uc_mgr_free_transition(&dev->transition_list);
 		uc_mgr_free_dev_list(&dev->dev_list);
 		uc_mgr_free_value(&dev->value_list);
+		index_free(&dev->value_index);
 		list_del(&dev->list);
 		free(dev);
 	}
 }
 
-void uc_mgr_free_verb(snd_use_case_mgr_t *uc_mgr)
+void uc_mgr_free_file(struct list_head *base)
+{
+	struct list_head *pos, *npos;
+	struct ucm_file *file;
+
+	list_for_each_safe(pos, npos, base) {
+		file = list_entry(pos, struct ucm_file, list);
+		free(file->name);
+		list_del(&file->list);
+		free(file);
+	}
+}
+
+void uc_mgr_free_tree(struct ucm_tree *tree)
 {
 	struct list_head *pos, *npos;
 	struct use_case_verb *verb;
 
-	list_for_each_safe(pos, npos, &uc_mgr->verb_list) {
+	list_for_each_safe(pos, npos, &tree->verb_list) {
 		verb = list_entry(pos, struct use_case_verb, list);
 		free(verb->name);
 		free(verb->comment);
@@ -211,27 +367,71 @@ void uc_mgr_free_verb(snd_use_case_mgr_t *uc_mgr)
 		uc_mgr_free_value(&verb->value_list);
 		uc_mgr_free_device(&verb->device_list);
 		uc_mgr_free_modifier(&verb->modifier_list);
+		index_free(&verb->value_index);
+		index_free(&verb->device_index);
+		index_free(&verb->modifier_index);
 		list_del(&verb->list);
 		free(verb);
 	}
-	uc_mgr_free_sequence(&uc_mgr->default_list);
-	uc_mgr_free_value(&uc_mgr->value_list);
-	free(uc_mgr->comment);
-	uc_mgr->comment = NULL;
+	uc_mgr_free_sequence(&tree->default_list);
+	uc_mgr_free_value(&tree->value_list);
+	uc_mgr_free_file(&tree->file_list);
+	index_free(&tree->verb_index);
+	index_free(&tree->value_index);
+	free(tree->comment);
+	free(tree->master);
+	free(tree);
+}
+
+void uc_mgr_free_active(struct list_head *base)
+{
+	struct list_head *pos, *npos;
+	struct ucm_active *active;
+
+	list_for_each_safe(pos, npos, base) {
+		active = list_entry(pos, struct ucm_active, list);
+		list_del(&active->list);
+		free(active);
+	}
+}
+
+void uc_mgr_free_cset_info(snd_use_case_mgr_t *uc_mgr)
+{
+	struct list_head *pos, *npos;
+	struct ucm_cset_info *ci;
+	unsigned int i;
+
+	for (i = 0; i < UC_MGR_CSET_HASH; i++) {
+		list_for_each_safe(pos, npos, &uc_mgr->cset_info[i]) {
+			ci = list_entry(pos, struct ucm_cset_info, list);
+			list_del(&ci->list);
+			free(ci);
+		}
+	}
+}
+
+void uc_mgr_free_verb(snd_use_case_mgr_t *uc_mgr)
+{
 	uc_mgr->active_verb = NULL;
-	INIT_LIST_HEAD(&uc_mgr->active_devices);
-	INIT_LIST_HEAD(&uc_mgr->active_modifiers);
+	uc_mgr_free_active(&uc_mgr->active_devices);
+	uc_mgr_free_active(&uc_mgr->active_modifiers);
+	uc_mgr_free_cset_info(uc_mgr);
 	if (uc_mgr->ctl != NULL) {
 		snd_ctl_close(uc_mgr->ctl);
 		uc_mgr->ctl = NULL;
 	}
 	free(uc_mgr->ctl_dev);
 	uc_mgr->ctl_dev = NULL;
+	if (uc_mgr->tree != NULL) {
+		uc_mgr_put_tree(uc_mgr->tree);
+		uc_mgr->tree = NULL;
+	}
 }
 
 void uc_mgr_free(snd_use_case_mgr_t *uc_mgr)
 {
 	uc_mgr_free_verb(uc_mgr);
+	free(uc_mgr->batch);
 	free(uc_mgr->card_name);
 	free(uc_mgr);
 }
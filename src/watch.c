@@ -0,0 +1,245 @@
+/**
+ * \file watch.c
+ * \brief Shared inotify instance of the library
+ * \date 2026
+ *
+ * The caches of the library which depend on files, the configuration
+ * files and the device directory, learn about changes from one inotify
+ * instance per process.
+ */
+/*
+ *  Shared inotify instance
+ *
+ *   This library is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU Lesser General Public License as
+ *   published by the Free Software Foundation; either version 2.1 of
+ *   the License, or (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#include "local.h"
+#include <sys/inotify.h>
+
+/*
+ * Each watched directory has a count of the events seen for it.  A user
+ * keeps the count it last acted on and compares; the queue is drained by
+ * whichever user looks first, so nothing is consumed on behalf of the
+ * others.  Users watching the same directory share its watch descriptor,
+ * with the union of their masks, and see each other's events.
+ *
+ * The instance is replaced when its queue overflowed and in a child
+ * process, which shares the queue of the parent after fork().  The
+ * epoch counts the instances: a watch from an earlier one is dead and
+ * has to be added again.  With fs.inotify.max_user_instances being 128
+ * by default, one instance per process instead of one per cache matters.
+ */
+
+#ifndef DOC_HIDDEN
+
+struct watch_dir {
+	int wd;
+	unsigned int refs;
+	unsigned int events;
+	int dead;			/* IN_IGNORED, the directory went away */
+};
+
+static int watch_fd = -1;
+static pid_t watch_pid;
+static unsigned int watch_epoch = 1;
+static struct watch_dir *watch_dirs;
+static unsigned int watch_count;
+static unsigned int watch_size;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t watch_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define watch_lock()	pthread_mutex_lock(&watch_mutex)
+#define watch_unlock()	pthread_mutex_unlock(&watch_mutex)
+#else
+#define watch_lock()	do { } while (0)
+#define watch_unlock()	do { } while (0)
+#endif
+
+/* drop the instance, every watch of it is dead */
+static void watch_close(void)
+{
+	if (watch_fd >= 0)
+		close(watch_fd);
+	watch_fd = -1;
+	watch_count = 0;
+	watch_epoch++;
+}
+
+static struct watch_dir *watch_find(int wd)
+{
+	unsigned int i;
+
+	for (i = 0; i < watch_count; i++)
+		if (watch_dirs[i].wd == wd)
+			return &watch_dirs[i];
+	return NULL;
+}
+
+/* read the queue into the counts, called with the lock held */
+static void watch_drain(void)
+{
+	char buf[1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	struct watch_dir *dir;
+	ssize_t len;
+
+	if (watch_fd >= 0 && watch_pid != getpid())
+		watch_close();
+	if (watch_fd < 0)
+		return;
+	while ((len = read(watch_fd, buf, sizeof(buf))) > 0) {
+		for (ev = (void *)buf; (char *)ev < buf + len;
+		     ev = (void *)((char *)(ev + 1) + ev->len)) {
+			if (ev->mask & IN_Q_OVERFLOW) {
+				watch_close();
+				return;
+			}
+			dir = watch_find(ev->wd);
+			if (!dir)
+				continue;
+			dir->events++;
+			if (ev->mask & IN_IGNORED)
+				dir->dead = 1;
+		}
+	}
+	if (len < 0 && errno != EAGAIN)
+		watch_close();
+}
+
+/**
+ * \brief Watch a directory
+ * \param w Returned watch
+ * \param path Directory
+ * \param mask Events of interest (IN_*)
+ * \return 0 on success otherwise a negative error code
+ *
+ * Events which happen from now on make #snd_watch_changed report the
+ * watch as changed.
+ */
+int snd_watch_add(snd_watch_t *w, const char *path, unsigned int mask)
+{
+	struct watch_dir *dir;
+	int wd, err = 0;
+
+	watch_lock();
+	watch_drain();
+	if (watch_fd < 0) {
+		watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (watch_fd < 0) {
+			err = -errno;
+			goto _end;
+		}
+		watch_pid = getpid();
+	}
+	wd = inotify_add_watch(watch_fd, path, mask | IN_MASK_ADD);
+	if (wd < 0) {
+		err = -errno;
+		goto _end;
+	}
+	dir = watch_find(wd);
+	if (dir && dir->dead) {
+		/* the number was given again, the old users see a change */
+		dir->dead = 0;
+		dir->events++;
+	} else if (!dir) {
+		if (watch_count == watch_size) {
+			unsigned int size = watch_size ? watch_size * 2 : 4;
+			dir = realloc(watch_dirs, size * sizeof(*dir));
+			if (!dir) {
+				inotify_rm_watch(watch_fd, wd);
+				err = -ENOMEM;
+				goto _end;
+			}
+			watch_dirs = dir;
+			watch_size = size;
+		}
+		dir = &watch_dirs[watch_count++];
+		dir->wd = wd;
+		dir->refs = 0;
+		dir->events = 0;
+		dir->dead = 0;
+	}
+	dir->refs++;
+	w->epoch = watch_epoch;
+	w->wd = wd;
+	w->events = dir->events;
+ _end:
+	watch_unlock();
+	return err;
+}
+
+/**
+ * \brief Check a watch for events
+ * \param w Watch from #snd_watch_add
+ * \return 0 when nothing happened, 1 after events since the watch was
+ *         added or reset, a negative error code when the watch is not
+ *         working anymore and has to be removed and added again
+ */
+int snd_watch_changed(const snd_watch_t *w)
+{
+	struct watch_dir *dir;
+	int res;
+
+	watch_lock();
+	watch_drain();
+	dir = w->epoch == watch_epoch ? watch_find(w->wd) : NULL;
+	if (!dir || dir->dead)
+		res = -ENOENT;
+	else
+		res = dir->events != w->events;
+	watch_unlock();
+	return res;
+}
+
+/**
+ * \brief Forget the events seen so far
+ * \param w Watch from #snd_watch_add
+ */
+void snd_watch_reset(snd_watch_t *w)
+{
+	struct watch_dir *dir;
+
+	watch_lock();
+	watch_drain();
+	dir = w->epoch == watch_epoch ? watch_find(w->wd) : NULL;
+	if (dir)
+		w->events = dir->events;
+	watch_unlock();
+}
+
+/**
+ * \brief Stop a watch
+ * \param w Watch from #snd_watch_add
+ */
+void snd_watch_remove(snd_watch_t *w)
+{
+	struct watch_dir *dir;
+
+	watch_lock();
+	if (watch_pid != getpid() || w->epoch != watch_epoch)
+		goto _end;
+	dir = watch_find(w->wd);
+	if (!dir || --dir->refs > 0)
+		goto _end;
+	if (!dir->dead)
+		inotify_rm_watch(watch_fd, dir->wd);
+	*dir = watch_dirs[--watch_count];
+ _end:
+	w->epoch = 0;
+	watch_unlock();
+}
+
+#endif /* DOC_HIDDEN */
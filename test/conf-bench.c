@@ -0,0 +1,372 @@
+/*
+ *  Configuration benchmark
+ *
+ *  Times loading the configuration, searching and expanding PCM
+ *  definitions and opening PCMs by name, and reports as CSV:
+ *
+ *    op,name,iterations,ns,ns_per_op,allocs_per_op
+ *
+ *  The conf.d lines load the configuration plus a generated directory
+ *  of that many files.  Operations which fail (e.g. without a sound
+ *  card) are reported as comment lines starting with '#'.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../include/asoundlib.h"
+
+#ifndef BENCH_CONF
+#define BENCH_CONF	NULL
+#endif
+
+static const char *names[] = {
+	"default", "null", "hw:0,0", "plughw:0", "sysdefault", "dmix", "front:0",
+	NULL
+};
+
+static const unsigned int confd_sizes[] = { 10, 100, 1000 };
+
+static const char *config = BENCH_CONF;
+static unsigned int iterations = 100;
+
+/*
+ * Count the allocations of the library by wrapping the allocator of
+ * glibc; other C libraries report 0.
+ */
+static unsigned long allocs;
+
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+	allocs++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	allocs++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	allocs++;
+	return __libc_realloc(ptr, size);
+}
+#endif
+
+static void silent_error(const char *file ATTRIBUTE_UNUSED,
+			 int line ATTRIBUTE_UNUSED,
+			 const char *function ATTRIBUTE_UNUSED,
+			 int err ATTRIBUTE_UNUSED,
+			 const char *fmt ATTRIBUTE_UNUSED, ...)
+{
+}
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned long long start_ns;
+static unsigned long start_allocs;
+
+static void start(void)
+{
+	start_allocs = allocs;
+	start_ns = now_ns();
+}
+
+static void report(const char *op, const char *name, unsigned int n, int err)
+{
+	unsigned long long ns = now_ns() - start_ns;
+	unsigned long a = allocs - start_allocs;
+
+	if (err < 0) {
+		printf("# %s,%s: %s\n", op, name, snd_strerror(err));
+		return;
+	}
+	printf("%s,%s,%u,%llu,%.0f,%.1f\n", op, name, n, ns,
+	       (double)ns / n, (double)a / n);
+}
+
+/* a full load, as the first open of a process does it */
+static int load(snd_config_t **top, const char *cfgs)
+{
+	snd_config_update_t *update = NULL;
+	int err;
+
+	*top = NULL;
+	err = snd_config_update_r(top, &update, cfgs);
+	if (update)
+		snd_config_update_free(update);
+	return err < 0 ? err : 0;
+}
+
+static void bench_load(const char *op, const char *name, const char *cfgs)
+{
+	snd_config_t *top;
+	unsigned int i;
+	int err = 0;
+
+	start();
+	for (i = 0; i < iterations && err >= 0; i++) {
+		err = load(&top, cfgs);
+		if (top)
+			snd_config_delete(top);
+	}
+	report(op, name, iterations, err);
+}
+
+/* the check of an open whether the files changed */
+static void bench_update(const char *cfgs)
+{
+	snd_config_t *top = NULL;
+	snd_config_update_t *update = NULL;
+	unsigned int i;
+	int err;
+
+	err = snd_config_update_r(&top, &update, cfgs);
+	start();
+	for (i = 0; i < iterations && err >= 0; i++)
+		err = snd_config_update_r(&top, &update, cfgs);
+	report("update", cfgs ? cfgs : "(default)", iterations, err);
+	if (update)
+		snd_config_update_free(update);
+	if (top)
+		snd_config_delete(top);
+}
+
+static void bench_search(snd_config_t *top, const char *name)
+{
+	snd_config_t *conf;
+	unsigned int i;
+	int err = 0;
+
+	start();
+	for (i = 0; i < iterations && err >= 0; i++) {
+		err = snd_config_search_definition(top, "pcm", name, &conf);
+		if (err >= 0)
+			snd_config_delete(conf);
+	}
+	report("search_definition", name, iterations, err);
+}
+
+static void bench_expand(snd_config_t *top, const char *name)
+{
+	char key[64];
+	snd_config_t *conf, *res;
+	unsigned int i;
+	int err;
+
+	snprintf(key, sizeof(key), "pcm.%s", name);
+	if (strchr(name, ':')) {
+		/* only the plain names expand without arguments */
+		return;
+	}
+	err = snd_config_search(top, key, &conf);
+	start();
+	for (i = 0; i < iterations && err >= 0; i++) {
+		err = snd_config_expand(conf, top, NULL, NULL, &res);
+		if (err >= 0)
+			snd_config_delete(res);
+	}
+	report("expand", name, iterations, err);
+}
+
+static void bench_open(snd_config_t *top, const char *name)
+{
+	snd_pcm_t *pcm;
+	unsigned int i;
+	int err = 0;
+
+	start();
+	for (i = 0; i < iterations && err >= 0; i++) {
+		err = snd_pcm_open_lconf(&pcm, name, SND_PCM_STREAM_PLAYBACK,
+					 SND_PCM_NONBLOCK, top);
+		if (err >= 0)
+			snd_pcm_close(pcm);
+	}
+	report("open", name, iterations, err);
+}
+
+/* a directory of files with a PCM and a CTL definition each */
+static int make_confd(char *dir, unsigned int files, char *cfgs, size_t size)
+{
+	char path[PATH_MAX];
+	unsigned int i;
+	FILE *f;
+
+	for (i = 0; i < files; i++) {
+		snprintf(path, sizeof(path), "%s/conf.d/%04u-bench.conf", dir, i);
+		f = fopen(path, "w");
+		if (!f)
+			return -errno;
+		fprintf(f,
+			"pcm.bench%u {\n"
+			"\t@args [ CARD DEV ]\n"
+			"\t@args.CARD { type string default 0 }\n"
+			"\t@args.DEV { type integer default %u }\n"
+			"\ttype hw\n\tcard $CARD\n\tdevice $DEV\n"
+			"\thint.description \"Bench %u\"\n"
+			"}\n"
+			"ctl.bench%u { type hw card 0 }\n",
+			i, i % 8, i, i);
+		fclose(f);
+	}
+	snprintf(path, sizeof(path), "%s/top.conf", dir);
+	f = fopen(path, "w");
+	if (!f)
+		return -errno;
+	/* after the hook of alsa.conf, the hooks are merged by index */
+	fprintf(f, "@hooks.%d { func load files [ \"%s/conf.d\" ] errors false }\n",
+		config ? 1 : 0, dir);
+	fclose(f);
+	snprintf(cfgs, size, "%s%s%s", config ? config : "",
+		 config ? ":" : "", path);
+	return 0;
+}
+
+static void clean_confd(const char *dir, unsigned int files)
+{
+	char path[PATH_MAX];
+	unsigned int i;
+
+	for (i = 0; i < files; i++) {
+		snprintf(path, sizeof(path), "%s/conf.d/%04u-bench.conf", dir, i);
+		unlink(path);
+	}
+	snprintf(path, sizeof(path), "%s/top.conf", dir);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/conf.d", dir);
+	rmdir(path);
+	rmdir(dir);
+}
+
+static void bench_confd(unsigned int files)
+{
+	char dir[] = "/tmp/conf-bench.XXXXXX";
+	char path[PATH_MAX], cfgs[PATH_MAX * 2], op[32];
+	snd_config_t *top;
+	int err;
+
+	if (!mkdtemp(dir)) {
+		printf("# conf.d,%u: %s\n", files, strerror(errno));
+		return;
+	}
+	snprintf(path, sizeof(path), "%s/conf.d", dir);
+	if (mkdir(path, 0700) < 0) {
+		printf("# conf.d,%u: %s\n", files, strerror(errno));
+		rmdir(dir);
+		return;
+	}
+	err = make_confd(dir, files, cfgs, sizeof(cfgs));
+	if (err < 0) {
+		printf("# conf.d,%u: %s\n", files, snd_strerror(err));
+	} else {
+		snprintf(op, sizeof(op), "load_confd_%u", files);
+		bench_load(op, "conf.d", cfgs);
+		if (load(&top, cfgs) >= 0 && top) {
+			snprintf(op, sizeof(op), "bench%u", files - 1);
+			bench_search(top, op);
+			snd_config_delete(top);
+		}
+	}
+	clean_confd(dir, files);
+}
+
+static void help(void)
+{
+	printf(
+"Usage: conf-bench [OPTION]...\n"
+"-h,--help		help\n"
+"-c,--config		configuration files, separated by ':' (default %s)\n"
+"-i,--iterations	iterations per operation (default %u)\n"
+"\n", config ? config : "the library default", iterations);
+}
+
+int main(int argc, char *argv[])
+{
+	struct option long_option[] =
+	{
+		{"help", 0, NULL, 'h'},
+		{"config", 1, NULL, 'c'},
+		{"iterations", 1, NULL, 'i'},
+		{NULL, 0, NULL, 0},
+	};
+	snd_config_t *top;
+	unsigned int i;
+	int err;
+
+	while (1) {
+		int opt;
+		if ((opt = getopt_long(argc, argv, "hc:i:", long_option, NULL)) < 0)
+			break;
+		switch (opt) {
+		case 'h':
+			help();
+			return 0;
+		case 'c':
+			config = optarg;
+			break;
+		case 'i':
+			iterations = strtoul(optarg, NULL, 0);
+			if (iterations < 1)
+				iterations = 1;
+			break;
+		default:
+			help();
+			return 1;
+		}
+	}
+
+	snd_lib_error_set_handler(silent_error);
+	printf("op,name,iterations,ns,ns_per_op,allocs_per_op\n");
+	bench_load("load", config ? config : "(default)", config);
+	bench_update(config);
+	for (i = 0; i < sizeof(confd_sizes) / sizeof(confd_sizes[0]); i++)
+		bench_confd(confd_sizes[i]);
+	err = load(&top, config);
+	if (err < 0 || !top) {
+		printf("# load: %s\n", snd_strerror(err));
+		return 1;
+	}
+	for (i = 0; names[i]; i++)
+		bench_search(top, names[i]);
+	for (i = 0; names[i]; i++)
+		bench_expand(top, names[i]);
+	for (i = 0; names[i]; i++)
+		bench_open(top, names[i]);
+	snd_config_delete(top);
+	snd_config_update_free_global();
+	return 0;
+}
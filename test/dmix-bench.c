@@ -0,0 +1,443 @@
+/*
+ *  dmix scaling benchmark
+ *
+ *  Plays from many clients to one dmix instance and reports for each
+ *  engine configuration and client count, as CSV:
+ *
+ *    config,processes,threads,frames,cpu_ns_per_frame,max_cpu_ns_per_frame,
+ *    lock_wait_ns_per_frame,lock_waits,xruns,errors
+ *
+ *  The clients are processes or threads of one process.  The CPU time
+ *  is the time a client spent in snd_pcm_writei() (which mixes), the
+ *  lock wait the time spent in semop() and futex waits, as the clients
+ *  write only what fits and do not block for room.  Growing CPU time per
+ *  frame with the client count shows contention on the sum buffer.
+ *
+ *  The slave must be a hw device, snd-dummy will do.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/sem.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "../include/asoundlib.h"
+
+#define RATE		48000
+#define CHANNELS	2
+#define PERIOD		1024
+#define MAX_CLIENTS	64
+#define IPC_KEY		0x646d6200
+
+static const struct config {
+	const char *name;
+	const char *opts;
+} configs[] = {
+	{ "default", "" },
+	{ "locked", "lockless false" },
+	{ "lockless", "lockless true" },
+	{ "futex", "ipc_futex true" },
+	{ "slots", "mix_slots 8" },
+	{ "thread", "mix_thread 1" },
+	{ NULL, NULL }
+};
+
+static const char *slave = "hw:0";
+static unsigned int duration = 1000;	/* ms */
+static unsigned int counts[16] = { 1, 2, 4, 8 };
+static unsigned int ncounts = 4;
+
+struct client_stats {
+	unsigned long long frames;
+	unsigned long long cpu_ns;
+	unsigned long long lock_ns;
+	unsigned long lock_waits;
+	unsigned long xruns;
+	int err;
+};
+
+struct shared {
+	int ready;
+	int go;
+	struct client_stats c[MAX_CLIENTS];
+};
+
+static struct shared *shared;
+
+/* the waits of the calling client */
+static __thread unsigned long long lock_ns;
+static __thread unsigned long lock_waits;
+
+static unsigned long long clock_ns(clockid_t id)
+{
+	struct timespec ts;
+
+	clock_gettime(id, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int semop(int semid, struct sembuf *sops, size_t nsops)
+{
+	static int (*libc_semop)(int, struct sembuf *, size_t);
+	unsigned long long t;
+	int err;
+
+	if (!libc_semop)
+		libc_semop = dlsym(RTLD_NEXT, "semop");
+	t = clock_ns(CLOCK_MONOTONIC);
+	err = libc_semop(semid, sops, nsops);
+	lock_ns += clock_ns(CLOCK_MONOTONIC) - t;
+	lock_waits++;
+	return err;
+}
+
+long syscall(long number, ...)
+{
+	static long (*libc_syscall)(long, ...);
+	unsigned long long t;
+	long a[6], res;
+	va_list ap;
+	int i;
+
+	if (!libc_syscall)
+		libc_syscall = dlsym(RTLD_NEXT, "syscall");
+	va_start(ap, number);
+	for (i = 0; i < 6; i++)
+		a[i] = va_arg(ap, long);
+	va_end(ap);
+	if (number != SYS_futex || (a[1] & FUTEX_CMD_MASK) != FUTEX_WAIT)
+		return libc_syscall(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+	t = clock_ns(CLOCK_MONOTONIC);
+	res = libc_syscall(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+	lock_ns += clock_ns(CLOCK_MONOTONIC) - t;
+	lock_waits++;
+	return res;
+}
+
+static void silent_error(const char *file ATTRIBUTE_UNUSED,
+			 int line ATTRIBUTE_UNUSED,
+			 const char *function ATTRIBUTE_UNUSED,
+			 int err ATTRIBUTE_UNUSED,
+			 const char *fmt ATTRIBUTE_UNUSED, ...)
+{
+}
+
+static int open_dmix(snd_pcm_t **pcm, const struct config *config)
+{
+	char conf[512];
+	snd_config_t *top;
+	snd_input_t *in;
+	int err;
+
+	snprintf(conf, sizeof(conf),
+		 "pcm.bench { type dmix ipc_key %d ipc_perm 0600 "
+		 "slave { pcm \"%s\" period_size %d buffer_size %d } %s }",
+		 IPC_KEY + (int)(config - configs), slave, PERIOD, PERIOD * 4,
+		 config->opts);
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, conf, -1);
+	if (err < 0)
+		goto _end;
+	err = snd_config_load(top, in);
+	snd_input_close(in);
+	if (err < 0)
+		goto _end;
+	err = snd_pcm_open_lconf(pcm, "bench", SND_PCM_STREAM_PLAYBACK, 0, top);
+	if (err < 0)
+		goto _end;
+	err = snd_pcm_set_params(*pcm, SND_PCM_FORMAT_S16_LE,
+				 SND_PCM_ACCESS_RW_INTERLEAVED, CHANNELS, RATE,
+				 1, 100000);
+	if (err < 0)
+		snd_pcm_close(*pcm);
+ _end:
+	snd_config_delete(top);
+	return err;
+}
+
+static void run_client(const struct config *config, struct client_stats *st)
+{
+	short buf[PERIOD * CHANNELS];
+	unsigned long long end, t;
+	snd_pcm_sframes_t avail, n;
+	snd_pcm_t *pcm;
+	unsigned int i;
+	int err;
+
+	memset(st, 0, sizeof(*st));
+	for (i = 0; i < PERIOD * CHANNELS; i++)
+		buf[i] = (short)(i * 997);
+	err = open_dmix(&pcm, config);
+	__atomic_add_fetch(&shared->ready, 1, __ATOMIC_SEQ_CST);
+	if (err < 0) {
+		st->err = err;
+		return;
+	}
+	while (!__atomic_load_n(&shared->go, __ATOMIC_SEQ_CST))
+		usleep(1000);
+	lock_ns = 0;
+	lock_waits = 0;
+	end = clock_ns(CLOCK_MONOTONIC) + duration * 1000000ULL;
+	while (clock_ns(CLOCK_MONOTONIC) < end) {
+		err = snd_pcm_wait(pcm, 100);
+		if (err < 0)
+			goto _xrun;
+		avail = snd_pcm_avail_update(pcm);
+		if (avail < 0) {
+			err = avail;
+			goto _xrun;
+		}
+		if (avail > PERIOD)
+			avail = PERIOD;
+		if (!avail)
+			continue;
+		t = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+		n = snd_pcm_writei(pcm, buf, avail);
+		st->cpu_ns += clock_ns(CLOCK_THREAD_CPUTIME_ID) - t;
+		if (n >= 0) {
+			st->frames += n;
+			continue;
+		}
+		err = n;
+	 _xrun:
+		st->xruns++;
+		err = snd_pcm_recover(pcm, err, 1);
+		if (err < 0) {
+			st->err = err;
+			break;
+		}
+	}
+	st->lock_ns = lock_ns;
+	st->lock_waits = lock_waits;
+	snd_pcm_drop(pcm);
+	snd_pcm_close(pcm);
+}
+
+struct thread_arg {
+	const struct config *config;
+	struct client_stats *st;
+};
+
+static void *client_thread(void *arg)
+{
+	struct thread_arg *a = arg;
+
+	run_client(a->config, a->st);
+	return NULL;
+}
+
+/* the clients of one process */
+static void run_process(const struct config *config, unsigned int first,
+			unsigned int threads)
+{
+	pthread_t tid[MAX_CLIENTS];
+	struct thread_arg args[MAX_CLIENTS];
+	int started[MAX_CLIENTS];
+	unsigned int i;
+	int err;
+
+	for (i = 0; i < threads; i++) {
+		args[i].config = config;
+		args[i].st = &shared->c[first + i];
+		err = pthread_create(&tid[i], NULL, client_thread, &args[i]);
+		started[i] = !err;
+		if (err) {
+			shared->c[first + i].err = -err;
+			__atomic_add_fetch(&shared->ready, 1, __ATOMIC_SEQ_CST);
+		}
+	}
+	for (i = 0; i < threads; i++)
+		if (started[i])
+			pthread_join(tid[i], NULL);
+}
+
+static void bench(const struct config *config, unsigned int processes,
+		  unsigned int threads)
+{
+	unsigned int clients = processes * threads, i, errors = 0;
+	unsigned long long frames = 0, cpu = 0, lock = 0;
+	unsigned long waits = 0, xruns = 0;
+	double max = 0;
+	pid_t pid;
+	int err = 0;
+
+	fflush(stdout);
+	memset(shared, 0, sizeof(*shared));
+	for (i = 0; i < processes; i++) {
+		pid = fork();
+		if (pid < 0) {
+			err = -errno;
+			processes = i;
+			break;
+		}
+		if (pid == 0) {
+			run_process(config, i * threads, threads);
+			_exit(0);
+		}
+	}
+	while (__atomic_load_n(&shared->ready, __ATOMIC_SEQ_CST) <
+	       (int)(processes * threads))
+		usleep(1000);
+	__atomic_store_n(&shared->go, 1, __ATOMIC_SEQ_CST);
+	while (wait(NULL) > 0)
+		;
+	if (err < 0) {
+		printf("# %s,%u,%u: %s\n", config->name, processes, threads,
+		       snd_strerror(err));
+		return;
+	}
+	for (i = 0; i < clients; i++) {
+		struct client_stats *st = &shared->c[i];
+
+		if (st->err < 0) {
+			if (!errors++)
+				err = st->err;
+			continue;
+		}
+		frames += st->frames;
+		cpu += st->cpu_ns;
+		lock += st->lock_ns;
+		waits += st->lock_waits;
+		xruns += st->xruns;
+		if (st->frames && (double)st->cpu_ns / st->frames > max)
+			max = (double)st->cpu_ns / st->frames;
+	}
+	if (!frames) {
+		printf("# %s,%u,%u: %s\n", config->name, processes, threads,
+		       snd_strerror(err ? err : -EIO));
+		return;
+	}
+	printf("%s,%u,%u,%llu,%.1f,%.1f,%.1f,%lu,%lu,%u\n",
+	       config->name, processes, threads, frames,
+	       (double)cpu / frames, max, (double)lock / frames,
+	       waits, xruns, errors);
+	fflush(stdout);
+}
+
+static int parse_counts(const char *str)
+{
+	char *end;
+
+	ncounts = 0;
+	while (*str && ncounts < sizeof(counts) / sizeof(counts[0])) {
+		counts[ncounts] = strtoul(str, &end, 0);
+		if (end == str || counts[ncounts] < 1 ||
+		    counts[ncounts] > MAX_CLIENTS)
+			return -EINVAL;
+		ncounts++;
+		str = *end == ',' ? end + 1 : end;
+	}
+	return ncounts ? 0 : -EINVAL;
+}
+
+static void help(void)
+{
+	const struct config *config;
+
+	printf(
+"Usage: dmix-bench [OPTION]... [CONFIG]...\n"
+"-h,--help	help\n"
+"-D,--device	hw slave device (default %s)\n"
+"-c,--clients	comma separated client counts (default 1,2,4,8)\n"
+"-d,--duration	ms to play per run (default %u)\n"
+"\n", slave, duration);
+	printf("Recognized configs are:");
+	for (config = configs; config->name; config++)
+		printf(" %s", config->name);
+	printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct option long_option[] =
+	{
+		{"help", 0, NULL, 'h'},
+		{"device", 1, NULL, 'D'},
+		{"clients", 1, NULL, 'c'},
+		{"duration", 1, NULL, 'd'},
+		{NULL, 0, NULL, 0},
+	};
+	const struct config *config;
+	unsigned int k;
+	int i;
+
+	while (1) {
+		int opt;
+		if ((opt = getopt_long(argc, argv, "hD:c:d:", long_option, NULL)) < 0)
+			break;
+		switch (opt) {
+		case 'h':
+			help();
+			return 0;
+		case 'D':
+			slave = optarg;
+			break;
+		case 'c':
+			if (parse_counts(optarg) < 0) {
+				fprintf(stderr, "invalid client counts %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'd':
+			duration = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			help();
+			return 1;
+		}
+	}
+
+	shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	snd_lib_error_set_handler(silent_error);
+	printf("config,processes,threads,frames,cpu_ns_per_frame,max_cpu_ns_per_frame,"
+	       "lock_wait_ns_per_frame,lock_waits,xruns,errors\n");
+	for (config = configs; config->name; config++) {
+		if (optind < argc) {
+			for (i = optind; i < argc; i++)
+				if (!strcmp(argv[i], config->name))
+					break;
+			if (i == argc)
+				continue;
+		}
+		for (k = 0; k < ncounts; k++) {
+			bench(config, counts[k], 1);
+			if (counts[k] > 1)
+				bench(config, 1, counts[k]);
+		}
+	}
+	munmap(shared, sizeof(*shared));
+	return 0;
+}
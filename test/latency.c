@@ -10,6 +10,11 @@
  *  capture and playback. This latency is measured from driver (diff when
  *  playback and capture was started). Scheduler is set to SCHED_RR.
  *
+ *  With --histogram, each cycle of the loop records the wakeup jitter,
+ *  the capture avail at the wakeup and the processing time, and the
+ *  percentiles are shown at the end of the run (and every --interval
+ *  seconds of a long run).
+ *
  *
  *   This program is free software; you can redistribute it and/or modify
  *   it under the terms of the GNU General Public License as published by
@@ -27,10 +32,12 @@
  *
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sched.h>
+#include <time.h>
 #include <errno.h>
 #include <getopt.h>
 #include "../include/asoundlib.h"
@@ -50,6 +57,11 @@ int loop_sec = 30;		/* seconds */
 int block = 0;			/* block mode */
 int use_poll = 0;
 int resample = 1;
+int priority = -1;		/* highest */
+int cpu = -1;			/* no pinning */
+int histogram = 0;
+int report_sec = 0;		/* only at the end */
+char *histfile = NULL;
 unsigned long loop_limit;
 
 snd_output_t *output = NULL;
@@ -312,11 +324,26 @@ void setscheduler(void)
 {
 	struct sched_param sched_param;
 
+	if (cpu >= 0) {
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		if (sched_setaffinity(0, sizeof(set), &set) < 0)
+			printf("!!!Pinning to CPU %i FAILED!!!\n", cpu);
+		else
+			printf("Pinned to CPU %i...\n", cpu);
+	}
 	if (sched_getparam(0, &sched_param) < 0) {
 		printf("Scheduler getparam failed...\n");
 		return;
 	}
-	sched_param.sched_priority = sched_get_priority_max(SCHED_RR);
+	if (priority == 0) {
+		printf("Scheduler not changed...\n");
+		return;
+	}
+	sched_param.sched_priority = priority > 0 ? priority :
+		sched_get_priority_max(SCHED_RR);
 	if (!sched_setscheduler(0, SCHED_RR, &sched_param)) {
 		printf("Scheduler set to Round Robin with priority %i...\n", sched_param.sched_priority);
 		fflush(stdout);
@@ -325,6 +352,128 @@ void setscheduler(void)
 	printf("!!!Scheduler set to Round Robin with priority %i FAILED!!!\n", sched_param.sched_priority);
 }
 
+/*
+ * Histograms with one bin per unit (us or frames), values beyond the
+ * last bin are counted as overflow.
+ */
+struct histogram {
+	const char *name;
+	const char *unit;
+	unsigned long *bins;
+	unsigned long size;
+	unsigned long count;
+	unsigned long overflow;
+	long max;
+};
+
+#define HIST_US		100000	/* 100ms */
+#define HIST_FRAMES	65536
+
+struct histogram hist_jitter = { "Wakeup jitter", "us" };
+struct histogram hist_avail = { "Avail at wakeup", "frames" };
+struct histogram hist_process = { "Processing time", "us" };
+
+void hist_init(struct histogram *h, unsigned long size)
+{
+	h->bins = calloc(size, sizeof(*h->bins));
+	if (!h->bins) {
+		printf("No memory for the histograms\n");
+		exit(EXIT_FAILURE);
+	}
+	h->size = size;
+}
+
+void hist_reset(struct histogram *h)
+{
+	memset(h->bins, 0, h->size * sizeof(*h->bins));
+	h->count = h->overflow = 0;
+	h->max = 0;
+}
+
+void hist_add(struct histogram *h, long value)
+{
+	if (value < 0)
+		value = -value;
+	if ((unsigned long)value < h->size)
+		h->bins[value]++;
+	else
+		h->overflow++;
+	if (value > h->max)
+		h->max = value;
+	h->count++;
+}
+
+/* the value below which permille of the samples lie */
+long hist_percentile(struct histogram *h, unsigned int permille)
+{
+	unsigned long want, sum = 0, i;
+
+	want = (h->count * permille + 999) / 1000;
+	for (i = 0; i < h->size; i++) {
+		sum += h->bins[i];
+		if (sum >= want)
+			return i;
+	}
+	return h->max;
+}
+
+void hist_show(struct histogram *h)
+{
+	if (!h->count)
+		return;
+	printf("%s: %lu samples, p50 %li%s, p99 %li%s, p99.9 %li%s, max %li%s",
+	       h->name, h->count,
+	       hist_percentile(h, 500), h->unit,
+	       hist_percentile(h, 990), h->unit,
+	       hist_percentile(h, 999), h->unit,
+	       h->max, h->unit);
+	if (h->overflow)
+		printf(", %lu over %lu%s", h->overflow, h->size - 1, h->unit);
+	printf("\n");
+}
+
+/* histogram,value,count lines of the non-empty bins */
+void hist_save(struct histogram *h, FILE *f)
+{
+	unsigned long i;
+
+	for (i = 0; i < h->size; i++)
+		if (h->bins[i])
+			fprintf(f, "%s (%s),%lu,%lu\n", h->name, h->unit, i, h->bins[i]);
+	if (h->overflow)
+		fprintf(f, "%s (%s),>%lu,%lu\n", h->name, h->unit, h->size - 1, h->overflow);
+}
+
+void showhistograms(void)
+{
+	FILE *f;
+
+	hist_show(&hist_jitter);
+	hist_show(&hist_avail);
+	hist_show(&hist_process);
+	fflush(stdout);
+	if (!histfile)
+		return;
+	f = fopen(histfile, "w");
+	if (!f) {
+		printf("Cannot write %s: %s\n", histfile, strerror(errno));
+		return;
+	}
+	fprintf(f, "histogram,value,count\n");
+	hist_save(&hist_jitter, f);
+	hist_save(&hist_avail, f);
+	hist_save(&hist_process, f);
+	fclose(f);
+}
+
+long long now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
 long timediff(snd_timestamp_t t1, snd_timestamp_t t2)
 {
 	signed long l;
@@ -453,6 +602,11 @@ void help(void)
 "-b,--block     block mode\n"
 "-p,--poll      use poll (wait for event - reduces CPU usage)\n"
 "-e,--effect    apply an effect (bandpass filter sweep)\n"
+"-H,--histogram record wakeup jitter, avail and processing time histograms\n"
+"-o,--histfile  save the histograms as CSV to the given file\n"
+"-I,--interval  show the histograms every given seconds\n"
+"-R,--priority  SCHED_RR priority (default highest, 0 = keep the scheduler)\n"
+"-a,--cpu       pin to the given CPU\n"
 );
         printf("Recognized sample formats are:");
         for (k = 0; k < SND_PCM_FORMAT_LAST; ++k) {
@@ -467,6 +621,8 @@ void help(void)
 "  latency -m 8192 -M 8192 -t 1 -p\n"
 "Tip #2 (superb latency, non-blocking mode, but heavy CPU usage):\n"
 "  latency -m 128 -M 128\n"
+"Tip #3 (tail latency of a long unattended run):\n"
+"  latency -m 256 -M 256 -p -s 3600 -H -I 60 -a 1 -o latency.csv\n"
 );
 }
 
@@ -489,6 +645,11 @@ int main(int argc, char *argv[])
 		{"block", 0, NULL, 'b'},
 		{"poll", 0, NULL, 'p'},
 		{"effect", 0, NULL, 'e'},
+		{"histogram", 0, NULL, 'H'},
+		{"histfile", 1, NULL, 'o'},
+		{"interval", 1, NULL, 'I'},
+		{"priority", 1, NULL, 'R'},
+		{"cpu", 1, NULL, 'a'},
 		{NULL, 0, NULL, 0},
 	};
 	snd_pcm_t *phandle, *chandle;
@@ -499,10 +660,13 @@ int main(int argc, char *argv[])
 	ssize_t r;
 	size_t frames_in, frames_out, in_max;
 	int effect = 0;
+	long long wake, last_wake, next_report;
+	long expected;
+	snd_pcm_sframes_t avail;
 	morehelp = 0;
 	while (1) {
 		int c;
-		if ((c = getopt_long(argc, argv, "hP:C:m:M:F:f:c:r:B:E:s:bpen", long_option, NULL)) < 0)
+		if ((c = getopt_long(argc, argv, "hP:C:m:M:F:f:c:r:B:E:s:bpenHo:I:R:a:", long_option, NULL)) < 0)
 			break;
 		switch (c) {
 		case 'h':
@@ -563,6 +727,25 @@ int main(int argc, char *argv[])
 		case 'n':
 			resample = 0;
 			break;
+		case 'H':
+			histogram = 1;
+			break;
+		case 'o':
+			histogram = 1;
+			histfile = strdup(optarg);
+			break;
+		case 'I':
+			histogram = 1;
+			err = atoi(optarg);
+			report_sec = err >= 0 ? err : 0;
+			break;
+		case 'R':
+			err = atoi(optarg);
+			priority = err >= 0 ? err : -1;
+			break;
+		case 'a':
+			cpu = atoi(optarg);
+			break;
 		}
 	}
 
@@ -579,6 +762,11 @@ int main(int argc, char *argv[])
 	loop_limit = loop_sec * rate;
 	latency = latency_min - 4;
 	buffer = malloc((latency_max * snd_pcm_format_width(format) / 8) * 2);
+	if (histogram) {
+		hist_init(&hist_jitter, HIST_US);
+		hist_init(&hist_avail, HIST_FRAMES);
+		hist_init(&hist_process, HIST_US);
+	}
 
 	setscheduler();
 
@@ -650,11 +838,29 @@ int main(int argc, char *argv[])
 
 		ok = 1;
 		in_max = 0;
+		if (histogram) {
+			hist_reset(&hist_jitter);
+			hist_reset(&hist_avail);
+			hist_reset(&hist_process);
+		}
+		wake = last_wake = 0;
+		expected = 0;
+		next_report = report_sec ? now_us() + report_sec * 1000000LL : 0;
 		while (ok && frames_in < loop_limit) {
 			if (use_poll) {
 				/* use poll to wait for next event */
 				snd_pcm_wait(chandle, 1000);
 			}
+			if (histogram) {
+				/* the previous cycle should have taken its frames */
+				wake = now_us();
+				if (last_wake)
+					hist_add(&hist_jitter, wake - last_wake - expected);
+				last_wake = wake;
+				avail = snd_pcm_avail_update(chandle);
+				if (avail >= 0)
+					hist_add(&hist_avail, avail);
+			}
 			if ((r = readbuf(chandle, buffer, latency, &frames_in, &in_max)) < 0)
 				ok = 0;
 			else {
@@ -663,6 +869,14 @@ int main(int argc, char *argv[])
 			 	if (writebuf(phandle, buffer, r, &frames_out) < 0)
 					ok = 0;
 			}
+			if (histogram) {
+				expected = r > 0 ? r * 1000000LL / rate : 0;
+				hist_add(&hist_process, now_us() - wake);
+				if (next_report && now_us() >= next_report) {
+					showhistograms();
+					next_report += report_sec * 1000000LL;
+				}
+			}
 		}
 		if (ok)
 			printf("Success\n");
@@ -673,6 +887,8 @@ int main(int argc, char *argv[])
 		printf("Capture:\n");
 		showstat(chandle, frames_in);
 		showinmax(in_max);
+		if (histogram)
+			showhistograms();
 		if (p_tstamp.tv_sec == p_tstamp.tv_sec &&
 		    p_tstamp.tv_usec == c_tstamp.tv_usec)
 			printf("Hardware sync\n");
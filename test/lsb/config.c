@@ -1,5 +1,7 @@
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
 #include <errno.h>
 #include "test.h"
 
@@ -29,6 +31,7 @@ static int configs_equal(snd_config_t *c1, snd_config_t *c2)
 {
 	long i1, i2;
 	long long i641, i642;
+	double r1, r2;
 	const char *s1, *s2;
 
 	if (snd_config_get_type(c1) != snd_config_get_type(c2))
@@ -42,6 +45,10 @@ static int configs_equal(snd_config_t *c1, snd_config_t *c2)
 		return snd_config_get_integer64(c1, &i641) >= 0 &&
 			snd_config_get_integer64(c2, &i642) >= 0 &&
 			i641 == i642;
+	case SND_CONFIG_TYPE_REAL:
+		return snd_config_get_real(c1, &r1) >= 0 &&
+			snd_config_get_real(c2, &r2) >= 0 &&
+			r1 == r2;
 	case SND_CONFIG_TYPE_STRING:
 		return snd_config_get_string(c1, &s1) >= 0 &&
 			snd_config_get_string(c2, &s2) >= 0 &&
@@ -139,6 +146,219 @@ static void test_save(void)
 	ALSA_CHECK(snd_config_delete(saved));
 }
 
+/* a temporary file with text, for the stdio input */
+static int open_text(snd_input_t **input, const char *text, int stdio)
+{
+	char path[] = "/tmp/alsa-lsb-config-XXXXXX";
+	ssize_t len = strlen(text);
+	int fd, err;
+
+	if (!stdio)
+		return snd_input_buffer_open(input, text, len);
+	fd = mkstemp(path);
+	if (fd < 0)
+		return -errno;
+	err = write(fd, text, len) == len ? 0 : -EIO;
+	close(fd);
+	if (err >= 0)
+		err = snd_input_stdio_open(input, path, "r");
+	unlink(path);
+	return err;
+}
+
+static int load_text(snd_config_t **config, const char *text, int stdio)
+{
+	snd_input_t *input;
+	int err;
+
+	err = snd_config_top(config);
+	if (err < 0)
+		return err;
+	err = open_text(&input, text, stdio);
+	if (err >= 0) {
+		err = snd_config_load(*config, input);
+		snd_input_close(input);
+	}
+	if (err < 0)
+		snd_config_delete(*config);
+	return err;
+}
+
+static void test_load_save(int stdio)
+{
+	const char *text =
+		"# a comment\n"
+		"a.b.c 'x.y.z'\t# after a value\n"
+		"i -42 l 8589934592 r 0.25\n"
+		"quoted \"tab\\there \\101 \\\"q\\\"\"\n"
+		"long 'a string which is longer than the buffer of the tokenizer for the short ones'\n"
+		"q { qq=qqq; q2 = 'q q' }\n"
+		"arr [ 1 2 3 '...' { x 1 } ]\n"
+		"id_with-digits0 cont<inued\n"
+		"last \"no end of line\" # comment";
+	snd_config_t *orig, *saved, *n;
+	snd_output_t *output;
+	snd_input_t *input;
+	const char *str;
+	long long i64;
+	double r;
+	long i;
+	char *buf;
+	size_t buf_size;
+
+	if (ALSA_CHECK(load_text(&orig, text, stdio)) < 0)
+		return;
+	TEST_CHECK(snd_config_search(orig, "a.b.c", &n) >= 0 &&
+		   snd_config_get_string(n, &str) >= 0 &&
+		   !strcmp(str, "x.y.z"));
+	TEST_CHECK(snd_config_search(orig, "i", &n) >= 0 &&
+		   snd_config_get_integer(n, &i) >= 0 && i == -42);
+	TEST_CHECK(snd_config_search(orig, "l", &n) >= 0 &&
+		   snd_config_get_integer64(n, &i64) >= 0 &&
+		   i64 == 8589934592LL);
+	TEST_CHECK(snd_config_search(orig, "r", &n) >= 0 &&
+		   snd_config_get_real(n, &r) >= 0 && r == 0.25);
+	TEST_CHECK(snd_config_search(orig, "quoted", &n) >= 0 &&
+		   snd_config_get_string(n, &str) >= 0 &&
+		   !strcmp(str, "tab\there A \"q\""));
+	TEST_CHECK(snd_config_search(orig, "long", &n) >= 0 &&
+		   snd_config_get_string(n, &str) >= 0 && strlen(str) == 76);
+	TEST_CHECK(snd_config_search(orig, "q.q2", &n) >= 0 &&
+		   snd_config_get_string(n, &str) >= 0 && !strcmp(str, "q q"));
+	TEST_CHECK(snd_config_search(orig, "arr.4.x", &n) >= 0);
+	TEST_CHECK(snd_config_search(orig, "id_with-digits0", &n) >= 0 &&
+		   snd_config_get_string(n, &str) >= 0 &&
+		   !strcmp(str, "cont<inued"));
+	TEST_CHECK(snd_config_search(orig, "last", &n) >= 0 &&
+		   snd_config_get_string(n, &str) >= 0 &&
+		   !strcmp(str, "no end of line"));
+
+	ALSA_CHECK(snd_output_buffer_open(&output));
+	ALSA_CHECK(snd_config_save(orig, output));
+	buf_size = snd_output_buffer_string(output, &buf);
+	ALSA_CHECK(snd_input_buffer_open(&input, buf, buf_size));
+	ALSA_CHECK(snd_config_top(&saved));
+	ALSA_CHECK(snd_config_load(saved, input));
+	ALSA_CHECK(snd_input_close(input));
+	ALSA_CHECK(snd_output_close(output));
+	TEST_CHECK(configs_equal(orig, saved));
+	ALSA_CHECK(snd_config_delete(orig));
+	ALSA_CHECK(snd_config_delete(saved));
+}
+
+static char error_text[256];
+
+static void error_handler(const char *file, int line, const char *function,
+			  int err, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(error_text, sizeof(error_text), fmt, ap);
+	va_end(ap);
+}
+
+/* the position reported for a broken text, ":line:column:" */
+static void check_error(const char *text, int stdio, int line, int column)
+{
+	snd_config_t *config;
+	char pos[32];
+
+	sprintf(pos, ":%d:%d:", line, column);
+	error_text[0] = '\0';
+	if (load_text(&config, text, stdio) >= 0) {
+		TEST_CHECK(0);
+		snd_config_delete(config);
+		return;
+	}
+	if (!strstr(error_text, pos)) {
+		fprintf(stderr, "%s: expected %s\n", error_text, pos);
+		TEST_CHECK(0);
+	}
+}
+
+static void test_error_position(int stdio)
+{
+	const char *comment = "x { # a comment which runs to the end of the input";
+
+	snd_lib_error_set_handler(error_handler);
+	check_error(comment, stdio, 1, strlen(comment));
+	check_error("x {\n\ty 1 # a comment", stdio, 2, 8 + 15);
+	check_error("a 1\nb 2 }\n", stdio, 2, 5);
+	check_error("a 1\n\tb \"no end", stdio, 2, 8 + 9);
+	check_error("a {\n b [ 1 2\n", stdio, 3, 0);
+	snd_lib_error_set_handler(NULL);
+}
+
+/* equal ids and values share one copy, which no setter changes */
+static void test_intern(void)
+{
+	const char *text = "a v\nb v\nc { v v }\n";
+	snd_config_t *top, *copy, *a, *b, *c, *n;
+	const char *sa, *sb, *sc, *id1, *id2;
+	char id[32], value[32];
+	int i, ok;
+
+	if (ALSA_CHECK(load_text(&top, text, 0)) < 0)
+		return;
+	TEST_CHECK(snd_config_search(top, "a", &a) >= 0 &&
+		   snd_config_get_string(a, &sa) >= 0);
+	TEST_CHECK(snd_config_search(top, "b", &b) >= 0 &&
+		   snd_config_get_string(b, &sb) >= 0);
+	TEST_CHECK(snd_config_search(top, "c.v", &c) >= 0 &&
+		   snd_config_get_string(c, &sc) >= 0 &&
+		   snd_config_get_id(c, &id1) >= 0);
+	TEST_CHECK(sa == sb && sa == sc && sc == id1);
+
+	/* the copy shares the strings of the tree */
+	ALSA_CHECK(snd_config_copy(&copy, top));
+	TEST_CHECK(snd_config_search(copy, "c.v", &n) >= 0 &&
+		   snd_config_get_string(n, &sb) >= 0 &&
+		   snd_config_get_id(n, &id2) >= 0);
+	TEST_CHECK(sb == sa && id2 == id1);
+
+	/* a new value of the tree leaves the copy alone */
+	ALSA_CHECK(snd_config_set_string(a, "w"));
+	ALSA_CHECK(snd_config_set_id(c, "x"));
+	TEST_CHECK(snd_config_search(copy, "a", &n) >= 0 &&
+		   snd_config_get_string(n, &sb) >= 0 && !strcmp(sb, "v"));
+	TEST_CHECK(snd_config_search(copy, "c.v", &n) >= 0);
+	TEST_CHECK(snd_config_search(top, "c.x", &n) >= 0 &&
+		   snd_config_get_string(n, &sb) >= 0 && !strcmp(sb, "v"));
+
+	/* a safe string is sanitized in its own copy */
+	ALSA_CHECK(snd_config_imake_string(&a, "s", "x.y"));
+	ALSA_CHECK(snd_config_imake_safe_string(&b, "t", "x.y"));
+	TEST_CHECK(snd_config_get_string(a, &sa) >= 0 && !strcmp(sa, "x.y"));
+	TEST_CHECK(snd_config_get_string(b, &sb) >= 0 && !strcmp(sb, "x_y"));
+	ALSA_CHECK(snd_config_delete(a));
+	ALSA_CHECK(snd_config_delete(b));
+
+	/* the strings of a deleted tree stay with the copy */
+	ALSA_CHECK(snd_config_delete(top));
+	TEST_CHECK(snd_config_search(copy, "b", &n) >= 0 &&
+		   snd_config_get_string(n, &sb) >= 0 && !strcmp(sb, "v"));
+
+	/* enough strings to grow the table, all of them kept */
+	for (i = 0; i < 5000; i++) {
+		sprintf(id, "id%d", i);
+		sprintf(value, "value %d", i);
+		if (ALSA_CHECK(snd_config_imake_string(&n, id, value)) < 0 ||
+		    ALSA_CHECK(snd_config_add(copy, n)) < 0)
+			break;
+	}
+	ok = 1;
+	for (i = 0; i < 5000 && ok; i++) {
+		sprintf(id, "id%d", i);
+		sprintf(value, "value %d", i);
+		ok = snd_config_search(copy, id, &n) >= 0 &&
+			snd_config_get_string(n, &sb) >= 0 &&
+			!strcmp(sb, value);
+	}
+	TEST_CHECK(ok);
+	ALSA_CHECK(snd_config_delete(copy));
+}
+
 static void test_update(void)
 {
 	ALSA_CHECK(snd_config_update_free_global());
@@ -553,6 +773,11 @@ int main(void)
 	test_top();
 	test_load();
 	test_save();
+	test_load_save(0);
+	test_load_save(1);
+	test_error_position(0);
+	test_error_position(1);
+	test_intern();
 	test_update();
 	test_search();
 	test_searchv();
@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "test.h"
+
+/* the layout of the cache written by conf.c */
+struct cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t files;
+	uint32_t nodes;
+	uint32_t strings;
+	uint32_t reserved;
+};
+
+#define CACHE_FILE_SIZE	32
+#define CACHE_NODE_SIZE	24
+#define CACHE_NODE_TYPE	4		/* offset of the type in a node */
+
+static char dir[] = "/tmp/alsa-lsb-cache-XXXXXX";
+static char conf_path[64], cache_path[64];
+
+static int write_file(const char *path, const char *text)
+{
+	int fd;
+	ssize_t len = strlen(text);
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return -errno;
+	if (write(fd, text, len) != len) {
+		close(fd);
+		return -EIO;
+	}
+	return close(fd) < 0 ? -errno : 0;
+}
+
+/* reads the file like the first snd_config_update, checks value */
+static void check_update(long value, const char *str)
+{
+	snd_config_t *top = NULL, *n;
+	snd_config_update_t *update = NULL;
+	const char *s;
+	long i;
+
+	if (ALSA_CHECK(snd_config_update_r(&top, &update, conf_path)) < 0)
+		return;
+	TEST_CHECK(snd_config_search(top, "a", &n) >= 0 &&
+		   snd_config_get_integer(n, &i) >= 0 && i == value);
+	TEST_CHECK(snd_config_search(top, "b.c", &n) >= 0 &&
+		   snd_config_get_string(n, &s) >= 0 && !strcmp(s, str));
+	snd_config_delete(top);
+	snd_config_update_free(update);
+}
+
+/* rewrites the file without changing what the cache checks */
+static void rewrite_unchanged(const char *text)
+{
+	struct stat st;
+	struct timespec times[2];
+
+	if (stat(conf_path, &st) < 0) {
+		TEST_CHECK(0);
+		return;
+	}
+	ALSA_CHECK(write_file(conf_path, text));
+	times[0] = st.st_atim;
+	times[1] = st.st_mtim;
+	TEST_CHECK(utimensat(AT_FDCWD, conf_path, times, 0) == 0);
+}
+
+/* sets the type of the node of the cache after the top node */
+static void corrupt_type(uint32_t type)
+{
+	struct cache_header hdr;
+	off_t off;
+	int fd;
+
+	fd = open(cache_path, O_RDWR);
+	if (fd < 0) {
+		TEST_CHECK(0);
+		return;
+	}
+	TEST_CHECK(read(fd, &hdr, sizeof(hdr)) == sizeof(hdr));
+	TEST_CHECK(hdr.nodes > 1);
+	off = sizeof(hdr) + hdr.files * CACHE_FILE_SIZE + CACHE_NODE_SIZE +
+		CACHE_NODE_TYPE;
+	TEST_CHECK(pwrite(fd, &type, sizeof(type), off) == sizeof(type));
+	close(fd);
+}
+
+static void truncate_cache(void)
+{
+	struct stat st;
+
+	TEST_CHECK(stat(cache_path, &st) == 0);
+	TEST_CHECK(truncate(cache_path, st.st_size / 2) == 0);
+}
+
+static void test_cache(void)
+{
+	struct stat st;
+	struct timespec times[2];
+	static const uint32_t types[] = {
+		SND_CONFIG_TYPE_POINTER, 5, SND_CONFIG_TYPE_COMPOUND - 1,
+		SND_CONFIG_TYPE_COMPOUND + 1, 0xffffffff,
+	};
+	unsigned int k;
+
+	ALSA_CHECK(write_file(conf_path, "a 1\nb.c \"one\"\n"));
+
+	/* miss: the file is parsed and the cache is written */
+	check_update(1, "one");
+	TEST_CHECK(stat(cache_path, &st) == 0);
+
+	/* hit: the tree comes from the cache, not from the file */
+	rewrite_unchanged("a 2\nb.c \"two\"\n");
+	check_update(1, "one");
+
+	/* a corrupt cache is dropped and the file is parsed again */
+	for (k = 0; k < sizeof(types) / sizeof(types[0]); k++) {
+		corrupt_type(types[k]);
+		check_update(2, "two");
+		/* the parse wrote a good cache again */
+		rewrite_unchanged("a 3\nb.c \"three\"\n");
+		check_update(2, "two");
+		rewrite_unchanged("a 2\nb.c \"two\"\n");
+	}
+	truncate_cache();
+	check_update(2, "two");
+	TEST_CHECK(write_file(cache_path, "garbage") == 0);
+	check_update(2, "two");
+
+	/* stale: a changed file is parsed again */
+	ALSA_CHECK(write_file(conf_path, "a 4\nb.c \"four\"\n"));
+	TEST_CHECK(stat(conf_path, &st) == 0);
+	times[0] = st.st_atim;
+	times[1] = st.st_mtim;
+	times[1].tv_sec += 10;
+	TEST_CHECK(utimensat(AT_FDCWD, conf_path, times, 0) == 0);
+	check_update(4, "four");
+}
+
+int main(void)
+{
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	sprintf(conf_path, "%s/test.conf", dir);
+	sprintf(cache_path, "%s/test.cache", dir);
+	setenv("ALSA_CONFIG_CACHE", cache_path, 1);
+	test_cache();
+	unlink(conf_path);
+	unlink(cache_path);
+	rmdir(dir);
+	return TEST_EXIT_CODE();
+}
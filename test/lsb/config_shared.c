@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "test.h"
+
+/*
+ * The definitions without arguments are used in place by the opens, the
+ * one with arguments is expanded into a copy.
+ */
+static const char config_text[] =
+	"pcm.nulldev {\n"
+	"	type null\n"
+	"}\n"
+	"pcm.plugnull {\n"
+	"	type plug\n"
+	"	slave.pcm nulldev\n"
+	"}\n"
+	"pcm.argtest {\n"
+	"	@args [ SLAVE ]\n"
+	"	@args.SLAVE {\n"
+	"		type string\n"
+	"		default nulldev\n"
+	"	}\n"
+	"	type plug\n"
+	"	slave.pcm $SLAVE\n"
+	"}\n"
+	"pcm.loop {\n"
+	"	type plug\n"
+	"	slave.pcm loop\n"
+	"}\n";
+
+#define THREADS	4
+#define OPENS	200
+
+static snd_config_t *top;
+
+static int configs_saved_equal(snd_config_t *c1, snd_config_t *c2)
+{
+	snd_output_t *o1, *o2;
+	char *s1, *s2;
+	size_t l1, l2;
+	int equal = 0;
+
+	if (snd_output_buffer_open(&o1) < 0)
+		return 0;
+	if (snd_output_buffer_open(&o2) < 0) {
+		snd_output_close(o1);
+		return 0;
+	}
+	if (snd_config_save(c1, o1) >= 0 && snd_config_save(c2, o2) >= 0) {
+		l1 = snd_output_buffer_string(o1, &s1);
+		l2 = snd_output_buffer_string(o2, &s2);
+		equal = l1 == l2 && !memcmp(s1, s2, l1);
+	}
+	snd_output_close(o1);
+	snd_output_close(o2);
+	return equal;
+}
+
+static int open_close(const char *name)
+{
+	snd_pcm_t *pcm;
+	int err;
+
+	err = snd_pcm_open_lconf(&pcm, name, SND_PCM_STREAM_PLAYBACK, 0, top);
+	if (err < 0)
+		return err;
+	return snd_pcm_close(pcm);
+}
+
+static void test_open(void)
+{
+	static const char *const names[] = {
+		"nulldev", "plugnull", "argtest", "argtest:nulldev",
+	};
+	snd_pcm_t *pcm1, *pcm2;
+	snd_config_t *copy;
+	unsigned int k;
+
+	if (ALSA_CHECK(snd_config_copy(&copy, top)) < 0)
+		return;
+	for (k = 0; k < sizeof(names) / sizeof(names[0]); k++)
+		ALSA_CHECK(open_close(names[k]));
+
+	/* two handles on one definition at the same time */
+	if (ALSA_CHECK(snd_pcm_open_lconf(&pcm1, "plugnull",
+					  SND_PCM_STREAM_PLAYBACK, 0, top)) >= 0) {
+		if (ALSA_CHECK(snd_pcm_open_lconf(&pcm2, "plugnull",
+						  SND_PCM_STREAM_PLAYBACK, 0,
+						  top)) >= 0)
+			ALSA_CHECK(snd_pcm_close(pcm2));
+		ALSA_CHECK(snd_pcm_close(pcm1));
+	}
+
+	/* a definition which refers to itself runs out of hops */
+	TEST_CHECK(open_close("loop") < 0);
+	TEST_CHECK(open_close("plugnull") >= 0);
+
+	/* the opens read the definitions only */
+	TEST_CHECK(configs_saved_equal(top, copy));
+	snd_config_delete(copy);
+}
+
+static void *open_thread(void *arg)
+{
+	const char *name = arg;
+	int i, failed = 0;
+
+	for (i = 0; i < OPENS && !failed; i++) {
+		if (open_close(name) < 0)
+			failed = 1;
+		if (open_close("loop") >= 0)
+			failed = 1;
+	}
+	return failed ? arg : NULL;
+}
+
+/* the hops of concurrent opens of the same definitions are their own */
+static void test_threads(void)
+{
+	static const char *const names[] = { "plugnull", "argtest" };
+	pthread_t threads[THREADS];
+	void *res;
+	int i, started;
+
+	for (started = 0; started < THREADS; started++) {
+		if (pthread_create(&threads[started], NULL, open_thread,
+				   (void *)names[started % 2]))
+			break;
+	}
+	TEST_CHECK(started == THREADS);
+	for (i = 0; i < started; i++) {
+		TEST_CHECK(pthread_join(threads[i], &res) == 0 && res == NULL);
+	}
+}
+
+static void error_handler(const char *file, int line, const char *function,
+			  int err, const char *fmt, ...)
+{
+	/* the loops report their error on every open */
+}
+
+int main(void)
+{
+	snd_input_t *input;
+
+	ALSA_CHECK(snd_config_top(&top));
+	ALSA_CHECK(snd_input_buffer_open(&input, config_text, strlen(config_text)));
+	ALSA_CHECK(snd_config_load(top, input));
+	ALSA_CHECK(snd_input_close(input));
+	snd_lib_error_set_handler(error_handler);
+	test_open();
+	test_threads();
+	snd_lib_error_set_handler(NULL);
+	ALSA_CHECK(snd_config_delete(top));
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,147 @@
+/*
+ * Checks that the vector mixing kernels of dmix give the same samples and
+ * sums as the scalar ones, for random data and the extremes.
+ */
+#include <string.h>
+#include <sys/sem.h>
+#include "pcm_direct.h"
+
+/* the internal headers of the plugin clash with test.h */
+static int any_test_failed;
+
+#include "pcm_dmix_generic.c"
+#include "pcm_dmix_simd.c"
+
+#define FRAMES	1027	/* not a multiple of any vector width */
+#define ROUNDS	16
+
+static unsigned int seed = 1;
+
+static unsigned int rnd(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+/* random values with zeros and the extremes mixed in */
+static void fill(void *buf, unsigned int bytes, unsigned int width)
+{
+	unsigned char *p = buf;
+	unsigned int i, j;
+
+	for (i = 0; i < bytes; i += width) {
+		switch (rnd() % 8) {
+		case 0:
+			memset(p + i, 0, width);
+			break;
+		case 1:
+			memset(p + i, 0xff, width - 1);
+			p[i + width - 1] = 0x7f;
+			break;
+		case 2:
+			memset(p + i, 0, width - 1);
+			p[i + width - 1] = 0x80;
+			break;
+		default:
+			for (j = 0; j < width; j++)
+				p[i + j] = rnd();
+			break;
+		}
+	}
+}
+
+/* floats around the clip level, with both zeros */
+static void fill_float(float *buf, unsigned int count)
+{
+	static const float special[] = { 0.0f, -0.0f, 1.0f, -1.0f, 2.5f, -2.5f };
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		if (rnd() % 4 == 0)
+			buf[i] = special[rnd() % 6];
+		else
+			buf[i] = ((float)(rnd() % 20001) - 10000.0f) / 5000.0f;
+	}
+}
+
+/*
+ * Runs the same sequence of mixes and remixes, on destinations which are
+ * partly zero, through the scalar and the vector kernel and compares the
+ * destinations and the sums after each call.
+ */
+static void check_kernel(const char *name, mix_areas_t *scalar,
+			 mix_areas_t *vector, unsigned int width,
+			 int is_float)
+{
+	unsigned char src[FRAMES * 4];
+	unsigned char dst1[FRAMES * 4], dst2[FRAMES * 4];
+	signed int sum1[FRAMES], sum2[FRAMES];
+	unsigned int round, i;
+
+	memset(dst1, 0, sizeof(dst1));
+	memset(sum1, 0, sizeof(sum1));
+	for (round = 0; round < ROUNDS; round++) {
+		if (is_float)
+			fill_float((float *)src, FRAMES);
+		else
+			fill(src, FRAMES * width, width);
+		/* some slots are free again, the sums there are stale */
+		for (i = 0; i < FRAMES; i++)
+			if (rnd() % 4 == 0)
+				memset(dst1 + i * width, 0, width);
+		memcpy(dst2, dst1, sizeof(dst1));
+		memcpy(sum2, sum1, sizeof(sum1));
+		scalar(FRAMES, dst1, src, sum1, width, width, sizeof(*sum1));
+		vector(FRAMES, dst2, src, sum2, width, width, sizeof(*sum2));
+		if (memcmp(dst1, dst2, FRAMES * width) ||
+		    memcmp(sum1, sum2, sizeof(sum1))) {
+			fprintf(stderr, "%s differs from the scalar kernel in round %u\n",
+				name, round);
+			any_test_failed = 1;
+			return;
+		}
+	}
+}
+
+#define CHECK(scalar, vector, width, is_float) \
+	check_kernel(#vector, (mix_areas_t *)scalar, (mix_areas_t *)vector, \
+		     width, is_float)
+
+int main(void)
+{
+	/* the kernels are called directly, not as dmix selects them */
+	(void)generic_mix_select_callbacks;
+#ifdef __ATOMIC_SEQ_CST
+	(void)generic_lockless_mix_select_callbacks;
+#endif
+	(void)simd_mix_select_callbacks;
+#if defined(DMIX_SIMD_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2")) {
+		CHECK(generic_mix_areas_16_native, sse2_mix_areas_16, 2, 0);
+		CHECK(generic_remix_areas_16_native, sse2_remix_areas_16, 2, 0);
+		CHECK(generic_mix_areas_32_native, sse2_mix_areas_32, 4, 0);
+		CHECK(generic_remix_areas_32_native, sse2_remix_areas_32, 4, 0);
+		CHECK(generic_mix_areas_float, sse2_mix_areas_float, 4, 1);
+		CHECK(generic_remix_areas_float, sse2_remix_areas_float, 4, 1);
+	}
+	if (__builtin_cpu_supports("ssse3")) {
+		CHECK(generic_mix_areas_24, ssse3_mix_areas_24, 3, 0);
+		CHECK(generic_remix_areas_24, ssse3_remix_areas_24, 3, 0);
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		CHECK(generic_mix_areas_16_native, avx2_mix_areas_16, 2, 0);
+		CHECK(generic_remix_areas_16_native, avx2_remix_areas_16, 2, 0);
+		CHECK(generic_mix_areas_32_native, avx2_mix_areas_32, 4, 0);
+		CHECK(generic_remix_areas_32_native, avx2_remix_areas_32, 4, 0);
+	}
+#elif defined(DMIX_SIMD_NEON)
+	CHECK(generic_mix_areas_16_native, neon_mix_areas_16, 2, 0);
+	CHECK(generic_remix_areas_16_native, neon_remix_areas_16, 2, 0);
+	CHECK(generic_mix_areas_32_native, neon_mix_areas_32, 4, 0);
+	CHECK(generic_remix_areas_32_native, neon_remix_areas_32, 4, 0);
+	CHECK(generic_mix_areas_float, neon_mix_areas_float, 4, 1);
+	CHECK(generic_remix_areas_float, neon_remix_areas_float, 4, 1);
+#endif
+	return any_test_failed;
+}
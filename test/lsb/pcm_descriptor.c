@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include "test.h"
+
+/* the layout of a descriptor and of its packed tree */
+#define DESC_HEADER_SIZE	32
+#define DESC_CONF_OFS		24	/* of the size of the tree */
+#define PACK_HEADER_SIZE	24
+#define PACK_NODES_OFS		12	/* of the number of nodes */
+#define PACK_NODE_SIZE		24
+#define PACK_NODE_ID		0
+#define PACK_NODE_TYPE		4
+#define PACK_NODE_CHILDREN	12
+
+static const char config_text[] =
+	"pcm.desctest {\n"
+	"	type plug\n"
+	"	slave.pcm {\n"
+	"		type null\n"
+	"	}\n"
+	"}\n";
+
+static char config_path[] = "/tmp/alsa-lsb-desc-XXXXXX";
+
+static int write_config(const char *text)
+{
+	FILE *fp;
+	int err;
+
+	fp = fopen(config_path, "w");
+	if (!fp)
+		return -errno;
+	err = fputs(text, fp) < 0 ? -EIO : 0;
+	if (fclose(fp))
+		err = -EIO;
+	/* the next open reads the files again */
+	snd_config_update_free_global();
+	return err;
+}
+
+static int create(void **descp, size_t *sizep)
+{
+	snd_pcm_t *pcm;
+	snd_pcm_hw_params_t *params;
+	snd_pcm_uframes_t period = 1024, buffer = 4096;
+	int err;
+
+	err = snd_pcm_open(&pcm, "desctest", SND_PCM_STREAM_PLAYBACK, 0);
+	if (err < 0)
+		return err;
+	snd_pcm_hw_params_alloca(&params);
+	snd_pcm_hw_params_any(pcm, params);
+	snd_pcm_hw_params_set_access(pcm, params, SND_PCM_ACCESS_RW_INTERLEAVED);
+	snd_pcm_hw_params_set_format(pcm, params, SND_PCM_FORMAT_S16_LE);
+	snd_pcm_hw_params_set_channels(pcm, params, 2);
+	snd_pcm_hw_params_set_rate(pcm, params, 44100, 0);
+	snd_pcm_hw_params_set_period_size_near(pcm, params, &period, 0);
+	snd_pcm_hw_params_set_buffer_size_near(pcm, params, &buffer);
+	snd_pcm_close(pcm);
+	return snd_pcm_descriptor_create(descp, sizep, "desctest",
+					 SND_PCM_STREAM_PLAYBACK, 0, params,
+					 NULL);
+}
+
+static void check_opened(snd_pcm_t *pcm)
+{
+	snd_pcm_hw_params_t *params;
+	snd_pcm_format_t format;
+	unsigned int channels, rate;
+	snd_pcm_uframes_t buffer, period;
+	short frames[2 * 100] = { 0 };
+
+	snd_pcm_hw_params_alloca(&params);
+	TEST_CHECK(snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED);
+	if (ALSA_CHECK(snd_pcm_hw_params_current(pcm, params)) < 0)
+		return;
+	TEST_CHECK(snd_pcm_hw_params_get_format(params, &format) >= 0 &&
+		   format == SND_PCM_FORMAT_S16_LE);
+	TEST_CHECK(snd_pcm_hw_params_get_channels(params, &channels) >= 0 &&
+		   channels == 2);
+	TEST_CHECK(snd_pcm_hw_params_get_rate(params, &rate, NULL) >= 0 &&
+		   rate == 44100);
+	TEST_CHECK(snd_pcm_hw_params_get_period_size(params, &period, NULL) >= 0 &&
+		   period == 1024);
+	TEST_CHECK(snd_pcm_hw_params_get_buffer_size(params, &buffer) >= 0 &&
+		   buffer == 4096);
+	TEST_CHECK(snd_pcm_writei(pcm, frames, 100) == 100);
+}
+
+/* a broken descriptor must fail the open, and nothing else */
+static void check_broken(const void *desc, size_t size, const char *what,
+			 unsigned int at)
+{
+	snd_pcm_t *pcm;
+	int err;
+
+	err = snd_pcm_open_descriptor(&pcm, desc, size, 0);
+	if (err >= 0) {
+		fprintf(stderr, "%s at %u: opened\n", what, at);
+		TEST_CHECK(0);
+		snd_pcm_close(pcm);
+	}
+}
+
+static void silent_handler(const char *file, int line, const char *function,
+			   int err, const char *fmt, ...)
+{
+	/* the failing opens report their errors */
+}
+
+static void set32(unsigned char *p, uint32_t v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+static uint32_t get32(const unsigned char *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static void test_broken(const unsigned char *desc, size_t size)
+{
+	static const uint32_t types[] = {
+		SND_CONFIG_TYPE_POINTER, 5, SND_CONFIG_TYPE_COMPOUND - 1,
+		SND_CONFIG_TYPE_COMPOUND + 1, 0xffffffff,
+	};
+	unsigned char *copy;
+	size_t conf_size, conf, len;
+	uint32_t nodes, k, t;
+
+	copy = malloc(size);
+	if (!copy)
+		return;
+	conf_size = get32(desc + DESC_CONF_OFS);
+	TEST_CHECK(conf_size > PACK_HEADER_SIZE && conf_size < size);
+	conf = size - conf_size;
+	nodes = get32(desc + conf + PACK_NODES_OFS);
+
+	/* truncated anywhere */
+	for (len = 0; len < size; len++)
+		check_broken(desc, len, "truncated", len);
+
+	/* a shorter tree with its size in the header */
+	for (len = 0; len < conf_size; len++) {
+		memcpy(copy, desc, size);
+		set32(copy + DESC_CONF_OFS, len);
+		check_broken(copy, conf + len, "short tree", len);
+	}
+
+	/* nodes of types which are never stored */
+	for (k = 0; k < nodes; k++) {
+		for (t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+			memcpy(copy, desc, size);
+			set32(copy + conf + PACK_HEADER_SIZE +
+			      k * PACK_NODE_SIZE + PACK_NODE_TYPE, types[t]);
+			check_broken(copy, size, "node type", k);
+		}
+	}
+
+	/* ids out of the strings and children which are not there */
+	for (k = 0; k < nodes; k++) {
+		memcpy(copy, desc, size);
+		set32(copy + conf + PACK_HEADER_SIZE + k * PACK_NODE_SIZE +
+		      PACK_NODE_ID, 0x7fffffff);
+		/* the id of the top node is not read */
+		if (k)
+			check_broken(copy, size, "node id", k);
+		memcpy(copy, desc, size);
+		set32(copy + conf + PACK_HEADER_SIZE + k * PACK_NODE_SIZE +
+		      PACK_NODE_CHILDREN, nodes);
+		if (get32(copy + conf + PACK_HEADER_SIZE + k * PACK_NODE_SIZE +
+			  PACK_NODE_TYPE) == SND_CONFIG_TYPE_COMPOUND)
+			check_broken(copy, size, "node children", k);
+	}
+
+	/* another library version */
+	memcpy(copy, desc, size);
+	set32(copy + 8, get32(copy + 8) + 1);
+	check_broken(copy, size, "version", 0);
+	free(copy);
+}
+
+int main(void)
+{
+	snd_pcm_t *pcm;
+	void *desc;
+	size_t size;
+	int fd;
+
+	fd = mkstemp(config_path);
+	if (fd < 0) {
+		perror("mkstemp");
+		return 1;
+	}
+	close(fd);
+	setenv("ALSA_CONFIG_PATH", config_path, 1);
+	if (ALSA_CHECK(write_config(config_text)) < 0 ||
+	    ALSA_CHECK(create(&desc, &size)) < 0)
+		goto _end;
+
+	/* the chain comes from the descriptor, not from the configuration */
+	ALSA_CHECK(write_config("# no PCMs\n"));
+	snd_lib_error_set_handler(silent_handler);
+	TEST_CHECK(snd_pcm_open(&pcm, "desctest", SND_PCM_STREAM_PLAYBACK, 0) < 0);
+	snd_lib_error_set_handler(NULL);
+	if (ALSA_CHECK(snd_pcm_open_descriptor(&pcm, desc, size, 0)) >= 0) {
+		check_opened(pcm);
+		ALSA_CHECK(snd_pcm_close(pcm));
+	}
+	/* a descriptor can be opened many times */
+	if (ALSA_CHECK(snd_pcm_open_descriptor(&pcm, desc, size, 0)) >= 0)
+		ALSA_CHECK(snd_pcm_close(pcm));
+
+	snd_lib_error_set_handler(silent_handler);
+	test_broken(desc, size);
+	snd_lib_error_set_handler(NULL);
+	free(desc);
+ _end:
+	snd_config_update_free_global();
+	unlink(config_path);
+	return TEST_EXIT_CODE();
+}
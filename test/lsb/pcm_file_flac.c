@@ -0,0 +1,500 @@
+/*
+ * Checks the FLAC output of the file plugin: the streams written for
+ * a known signal are decoded again and must give the same samples.  The
+ * decoder below covers what the plugin writes, the constant, verbatim
+ * and fixed predictor subframes, and it checks both CRCs of each frame.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include "test.h"
+
+#define FRAMES		(3 * 4096 + 1000)	/* with a partial last block */
+#define CHUNK		1000
+#define MAX_GROUP	8			/* channels of a FLAC stream */
+
+struct bit_reader {
+	const unsigned char *buf;
+	size_t len;
+	size_t pos;				/* in bits */
+	int err;
+};
+
+static uint32_t get_bits(struct bit_reader *b, unsigned int n)
+{
+	uint32_t v = 0;
+
+	while (n--) {
+		if ((b->pos >> 3) >= b->len) {
+			b->err = 1;
+			return 0;
+		}
+		v = v << 1 | ((b->buf[b->pos >> 3] >> (7 - (b->pos & 7))) & 1);
+		b->pos++;
+	}
+	return v;
+}
+
+static int32_t get_signed(struct bit_reader *b, unsigned int n)
+{
+	uint32_t v = get_bits(b, n);
+
+	if (n < 32 && (v & (1U << (n - 1))))
+		v |= ~0U << n;
+	return (int32_t)v;
+}
+
+static uint32_t get_unary(struct bit_reader *b)
+{
+	uint32_t q = 0;
+
+	while (!b->err && !get_bits(b, 1))
+		q++;
+	return q;
+}
+
+static unsigned char crc8(const unsigned char *p, size_t len)
+{
+	unsigned char c = 0;
+	int i;
+
+	while (len--) {
+		c ^= *p++;
+		for (i = 0; i < 8; i++)
+			c = c & 0x80 ? (c << 1) ^ 0x07 : c << 1;
+	}
+	return c;
+}
+
+static unsigned short crc16(const unsigned char *p, size_t len)
+{
+	unsigned short c = 0;
+	int i;
+
+	while (len--) {
+		c ^= *p++ << 8;
+		for (i = 0; i < 8; i++)
+			c = c & 0x8000 ? (c << 1) ^ 0x8005 : c << 1;
+	}
+	return c;
+}
+
+static int decode_residual(struct bit_reader *b, int32_t *r, unsigned int n,
+			   unsigned int order)
+{
+	unsigned int method, porder, part, i, k, cnt, esc;
+	uint32_t u;
+
+	method = get_bits(b, 2);
+	if (method > 1)
+		return -1;
+	porder = get_bits(b, 4);
+	if ((n >> porder) < order || (n >> porder) << porder != n)
+		return -1;
+	esc = method ? 31 : 15;
+	for (part = 0, i = order; part < (1U << porder); part++) {
+		k = get_bits(b, method ? 5 : 4);
+		cnt = (part + 1) * (n >> porder);
+		for (; i < cnt; i++) {
+			if (k == esc)
+				return -1;	/* not written by the plugin */
+			u = get_unary(b) << k;
+			u |= get_bits(b, k);
+			r[i] = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+		}
+	}
+	return b->err ? -1 : 0;
+}
+
+static int decode_subframe(struct bit_reader *b, int32_t *x, unsigned int n,
+			   unsigned int bps)
+{
+	static const int coefs[5][4] = {
+		{ 0 }, { 1 }, { 2, -1 }, { 3, -3, 1 }, { 4, -6, 4, -1 },
+	};
+	unsigned int type, wasted = 0, order, i, j;
+	int32_t r[4096];
+
+	if (get_bits(b, 1))
+		return -1;
+	type = get_bits(b, 6);
+	if (get_bits(b, 1))
+		wasted = get_unary(b) + 1;
+	if (wasted >= bps)
+		return -1;
+	bps -= wasted;
+	if (type == 0) {
+		x[0] = get_signed(b, bps);
+		for (i = 1; i < n; i++)
+			x[i] = x[0];
+	} else if (type == 1) {
+		for (i = 0; i < n; i++)
+			x[i] = get_signed(b, bps);
+	} else if (type >= 8 && type <= 12) {
+		order = type - 8;
+		if (order > n)
+			return -1;
+		for (i = 0; i < order; i++)
+			x[i] = get_signed(b, bps);
+		if (decode_residual(b, r, n, order) < 0)
+			return -1;
+		for (i = order; i < n; i++) {
+			int64_t v = r[i];
+			for (j = 0; j < order; j++)
+				v += (int64_t)coefs[order][j] * x[i - 1 - j];
+			x[i] = (int32_t)v;
+		}
+	} else {
+		return -1;
+	}
+	for (i = 0; i < n; i++)
+		x[i] = (int32_t)((uint32_t)x[i] << wasted);
+	return b->err ? -1 : 0;
+}
+
+/* the frame number, coded like UTF-8 */
+static int get_utf8(struct bit_reader *b, uint32_t *num)
+{
+	uint32_t v = get_bits(b, 8), c;
+	unsigned int ones = 0;
+
+	while (ones < 8 && (v & (0x80 >> ones)))
+		ones++;
+	if (ones == 1 || ones > 7)
+		return -1;
+	if (ones)
+		v &= 0xff >> (ones + 1);
+	for (; ones > 1; ones--) {
+		c = get_bits(b, 8);
+		if ((c & 0xc0) != 0x80)
+			return -1;
+		v = v << 6 | (c & 0x3f);
+	}
+	*num = v;
+	return 0;
+}
+
+/* decodes one FLAC stream to interleaved samples, returns the frames */
+static long decode(const unsigned char *buf, size_t len,
+		   unsigned int rate, unsigned int channels, unsigned int bps,
+		   int32_t *out)
+{
+	struct bit_reader b = { buf, len, 0, 0 };
+	unsigned int last, type, size, st_channels, st_bps, st_rate;
+	uint64_t total;
+	uint32_t num, frame_no = 0;
+	long frames = 0;
+	int32_t x[MAX_GROUP][4096];
+
+	if (len < 4 || memcmp(buf, "fLaC", 4))
+		return -1;
+	b.pos = 32;
+	do {
+		last = get_bits(&b, 1);
+		type = get_bits(&b, 7);
+		size = get_bits(&b, 24);
+		if (type != 0) {
+			b.pos += size * 8;
+			continue;
+		}
+		if (size != 34)
+			return -1;
+		get_bits(&b, 16);		/* block sizes */
+		get_bits(&b, 16);
+		get_bits(&b, 24);		/* frame sizes */
+		get_bits(&b, 24);
+		st_rate = get_bits(&b, 20);
+		st_channels = get_bits(&b, 3) + 1;
+		st_bps = get_bits(&b, 5) + 1;
+		total = (uint64_t)get_bits(&b, 4) << 32;
+		total |= get_bits(&b, 32);
+		b.pos += 128;			/* MD5 */
+		if (st_rate != rate || st_channels != channels ||
+		    st_bps != bps || total != FRAMES)
+			return -1;
+	} while (!last && !b.err);
+
+	while (!b.err && (b.pos >> 3) < len) {
+		size_t start = b.pos >> 3;
+		unsigned int bs_code, rate_code, ch, bits_code, n, c, i;
+
+		if (get_bits(&b, 14) != 0x3ffe || get_bits(&b, 1) ||
+		    get_bits(&b, 1))
+			return -1;
+		bs_code = get_bits(&b, 4);
+		rate_code = get_bits(&b, 4);
+		ch = get_bits(&b, 4);
+		bits_code = get_bits(&b, 3);
+		if (get_bits(&b, 1) || ch >= 8 || ch + 1 != channels)
+			return -1;
+		if (get_utf8(&b, &num) < 0 || num != frame_no)
+			return -1;
+		if (bs_code == 1)
+			n = 192;
+		else if (bs_code >= 2 && bs_code <= 5)
+			n = 576 << (bs_code - 2);
+		else if (bs_code == 6)
+			n = get_bits(&b, 8) + 1;
+		else if (bs_code == 7)
+			n = get_bits(&b, 16) + 1;
+		else if (bs_code >= 8)
+			n = 256 << (bs_code - 8);
+		else
+			return -1;
+		if (rate_code == 12)
+			get_bits(&b, 8);
+		else if (rate_code == 13 || rate_code == 14)
+			get_bits(&b, 16);
+		else if (rate_code == 15)
+			return -1;
+		/* 0 takes the size of STREAMINFO */
+		if (bits_code != 0 &&
+		    bits_code != (bps == 8 ? 1 : bps == 16 ? 4 : 6))
+			return -1;
+		if (n > 4096 || frames + n > FRAMES ||
+		    crc8(buf + start, (b.pos >> 3) - start) != get_bits(&b, 8))
+			return -1;
+		for (c = 0; c < channels; c++)
+			if (decode_subframe(&b, x[c], n, bps) < 0)
+				return -1;
+		b.pos = (b.pos + 7) & ~(size_t)7;
+		if (crc16(buf + start, (b.pos >> 3) - start) != get_bits(&b, 16))
+			return -1;
+		for (i = 0; i < n; i++)
+			for (c = 0; c < channels; c++)
+				out[(frames + i) * channels + c] = x[c][i];
+		frames += n;
+		frame_no++;
+	}
+	return b.err ? -1 : frames;
+}
+
+static unsigned int seed = 1;
+
+static unsigned int rnd(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+/* noise over a ramp, a constant block and a block with zero low bits */
+static int32_t make_sample(unsigned int f, unsigned int c, unsigned int bits)
+{
+	int64_t max = ((int64_t)1 << (bits - 1)) - 1;
+	int64_t v;
+
+	if (c == 1 && f / 4096 == 1)
+		return 123;
+	if (c == 2 && f / 4096 == 0)
+		return f & 1 ? max : -max - 1;
+	v = (int64_t)((f * (c + 1) * 37) % 512 - 256) * (max / 300) +
+		(int)(rnd() % 65) - 32;
+	if (c == 0 && f / 4096 == 2)
+		v &= ~(int64_t)7;
+	if (v > max)
+		v = max;
+	if (v < -max - 1)
+		v = -max - 1;
+	return (int32_t)v;
+}
+
+static void pack_sample(unsigned char *p, int32_t v, snd_pcm_format_t format)
+{
+	uint32_t u = (uint32_t)v;
+
+	switch (format) {
+	case SND_PCM_FORMAT_S8:
+		p[0] = u;
+		break;
+	case SND_PCM_FORMAT_S16_LE:
+		p[0] = u;
+		p[1] = u >> 8;
+		break;
+	case SND_PCM_FORMAT_S24_3LE:
+		p[0] = u;
+		p[1] = u >> 8;
+		p[2] = u >> 16;
+		break;
+	default:
+		p[0] = u;
+		p[1] = u >> 8;
+		p[2] = u >> 16;
+		p[3] = u >> 24;
+		break;
+	}
+}
+
+static int read_file(const char *path, unsigned char **bufp, size_t *lenp)
+{
+	FILE *fp;
+	long len;
+	unsigned char *buf;
+
+	fp = fopen(path, "rb");
+	if (!fp)
+		return -errno;
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	rewind(fp);
+	buf = malloc(len ? len : 1);
+	if (!buf || fread(buf, 1, len, fp) != (size_t)len) {
+		free(buf);
+		fclose(fp);
+		return -EIO;
+	}
+	fclose(fp);
+	*bufp = buf;
+	*lenp = len;
+	return 0;
+}
+
+/* writes the signal to a file PCM, returns the samples written */
+static int32_t *write_stream(const char *path, snd_pcm_format_t format,
+			     unsigned int channels, unsigned int rate,
+			     unsigned int async_ring)
+{
+	char text[512];
+	unsigned int bits = snd_pcm_format_width(format);
+	unsigned int bytes = snd_pcm_format_physical_width(format) / 8;
+	snd_pcm_uframes_t period = 1024, buffer = 4096;
+	snd_config_t *top;
+	snd_input_t *input;
+	snd_pcm_t *pcm;
+	snd_pcm_hw_params_t *params;
+	unsigned char *data;
+	int32_t *samples;
+	unsigned int f, c;
+	int err;
+
+	snprintf(text, sizeof(text),
+		 "pcm.flactest {\n"
+		 "	type file\n"
+		 "	slave.pcm { type null clock %s }\n"
+		 "	file \"%s\"\n"
+		 "	format flac\n"
+		 "	async_ring %u\n"
+		 "}\n",
+		 /* the writer thread only keeps up with a paced stream */
+		 async_ring ? "realtime" : "fast", path, async_ring);
+	samples = malloc(sizeof(*samples) * FRAMES * channels);
+	data = malloc(bytes * FRAMES * channels);
+	if (!samples || !data)
+		goto _err;
+	for (f = 0; f < FRAMES; f++)
+		for (c = 0; c < channels; c++) {
+			samples[f * channels + c] = make_sample(f, c, bits);
+			pack_sample(data + (f * channels + c) * bytes,
+				    samples[f * channels + c], format);
+		}
+
+	if (ALSA_CHECK(snd_config_top(&top)) < 0)
+		goto _err;
+	ALSA_CHECK(snd_input_buffer_open(&input, text, strlen(text)));
+	ALSA_CHECK(snd_config_load(top, input));
+	ALSA_CHECK(snd_input_close(input));
+	err = ALSA_CHECK(snd_pcm_open_lconf(&pcm, "flactest",
+					    SND_PCM_STREAM_PLAYBACK, 0, top));
+	snd_config_delete(top);
+	if (err < 0)
+		goto _err;
+	snd_pcm_hw_params_alloca(&params);
+	snd_pcm_hw_params_any(pcm, params);
+	snd_pcm_hw_params_set_access(pcm, params, SND_PCM_ACCESS_RW_INTERLEAVED);
+	snd_pcm_hw_params_set_format(pcm, params, format);
+	snd_pcm_hw_params_set_channels(pcm, params, channels);
+	snd_pcm_hw_params_set_rate(pcm, params, rate, 0);
+	snd_pcm_hw_params_set_period_size_near(pcm, params, &period, 0);
+	snd_pcm_hw_params_set_buffer_size_near(pcm, params, &buffer);
+	err = ALSA_CHECK(snd_pcm_hw_params(pcm, params));
+	for (f = 0; err >= 0 && f < FRAMES; f += CHUNK) {
+		unsigned int n = FRAMES - f < CHUNK ? FRAMES - f : CHUNK;
+		snd_pcm_sframes_t w;
+
+		w = snd_pcm_writei(pcm, data + f * channels * bytes, n);
+		if (w != (snd_pcm_sframes_t)n) {
+			fprintf(stderr, "write of %u frames: %ld\n", n, (long)w);
+			err = -EIO;
+		}
+	}
+	if (err >= 0)
+		ALSA_CHECK(snd_pcm_drain(pcm));
+	ALSA_CHECK(snd_pcm_close(pcm));
+	if (err < 0)
+		goto _err;
+	free(data);
+	return samples;
+ _err:
+	TEST_CHECK(0);
+	free(data);
+	free(samples);
+	return NULL;
+}
+
+static void test_flac(const char *dir, snd_pcm_format_t format,
+		      unsigned int channels, unsigned int rate,
+		      unsigned int async_ring)
+{
+	char path[256], name[280];
+	unsigned int bits = snd_pcm_format_width(format);
+	int32_t *samples, *decoded;
+	unsigned int first, group, f, c;
+	unsigned char *buf;
+	size_t len;
+	long frames;
+	int equal;
+
+	snprintf(path, sizeof(path), "%s/out.flac", dir);
+	samples = write_stream(path, format, channels, rate, async_ring);
+	if (!samples)
+		return;
+	decoded = malloc(sizeof(*decoded) * FRAMES * MAX_GROUP);
+	for (first = 0; decoded && first < channels; first += MAX_GROUP) {
+		group = channels - first < MAX_GROUP ? channels - first : MAX_GROUP;
+		if (first)
+			snprintf(name, sizeof(name), "%s.ch%u", path, first);
+		else
+			snprintf(name, sizeof(name), "%s", path);
+		if (ALSA_CHECK(read_file(name, &buf, &len)) < 0)
+			break;
+		frames = decode(buf, len, rate, group, bits, decoded);
+		free(buf);
+		unlink(name);
+		if (frames != FRAMES) {
+			fprintf(stderr, "%s %u channels: stream of %s: %ld frames\n",
+				snd_pcm_format_name(format), channels, name, frames);
+			TEST_CHECK(0);
+			continue;
+		}
+		equal = 1;
+		for (f = 0; f < FRAMES && equal; f++)
+			for (c = 0; c < group; c++)
+				if (decoded[f * group + c] !=
+				    samples[f * channels + first + c])
+					equal = 0;
+		if (!equal)
+			fprintf(stderr, "%s %u channels: %s differs at frame %u\n",
+				snd_pcm_format_name(format), channels, name, f - 1);
+		TEST_CHECK(equal);
+	}
+	free(decoded);
+	free(samples);
+}
+
+int main(void)
+{
+	char dir[] = "/tmp/alsa-lsb-flac-XXXXXX";
+
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	test_flac(dir, SND_PCM_FORMAT_S16_LE, 2, 44100, 0);
+	test_flac(dir, SND_PCM_FORMAT_S8, 3, 8000, 0);
+	test_flac(dir, SND_PCM_FORMAT_S24_3LE, 10, 48000, 0);
+	test_flac(dir, SND_PCM_FORMAT_S24_LE, 4, 96000, 65536);
+	test_flac(dir, SND_PCM_FORMAT_S32_LE, 1, 22050, 65536);
+	rmdir(dir);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,144 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include "test.h"
+
+#define WRITTEN		1000
+
+static const char config_text[] =
+	"pcm.pooltest {\n"
+	"	type null\n"
+	"	clock realtime\n"
+	"}\n";
+
+static snd_pcm_uframes_t period_size = 1200;
+static snd_pcm_uframes_t buffer_size = 4800;
+
+static char config_path[] = "/tmp/alsa-lsb-pool-XXXXXX";
+
+/*
+ * the global configuration of the test, only the pcm of the pool; the
+ * realtime clock keeps the written frames in the buffer like a device
+ */
+static int setup_config(void)
+{
+	int fd;
+
+	fd = mkstemp(config_path);
+	if (fd < 0)
+		return -errno;
+	if (write(fd, config_text, strlen(config_text)) !=
+	    (ssize_t)strlen(config_text)) {
+		close(fd);
+		return -EIO;
+	}
+	close(fd);
+	setenv("ALSA_CONFIG_PATH", config_path, 1);
+	return 0;
+}
+
+/* parameters of the handles, taken from a handle set up once */
+static int make_params(snd_pcm_hw_params_t *hw_params,
+		       snd_pcm_sw_params_t *sw_params)
+{
+	snd_pcm_t *pcm;
+	int err;
+
+	err = ALSA_CHECK(snd_pcm_open(&pcm, "pooltest", SND_PCM_STREAM_PLAYBACK, 0));
+	if (err < 0)
+		return err;
+	snd_pcm_hw_params_any(pcm, hw_params);
+	snd_pcm_hw_params_set_access(pcm, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED);
+	snd_pcm_hw_params_set_format(pcm, hw_params, SND_PCM_FORMAT_S16_LE);
+	snd_pcm_hw_params_set_channels(pcm, hw_params, 2);
+	snd_pcm_hw_params_set_rate(pcm, hw_params, 48000, 0);
+	snd_pcm_hw_params_set_period_size_near(pcm, hw_params, &period_size, 0);
+	snd_pcm_hw_params_set_buffer_size_near(pcm, hw_params, &buffer_size);
+	err = ALSA_CHECK(snd_pcm_hw_params(pcm, hw_params));
+	if (err >= 0) {
+		snd_pcm_sw_params_current(pcm, sw_params);
+		/* the writes of the test never start the stream */
+		snd_pcm_sw_params_set_start_threshold(pcm, sw_params, buffer_size);
+		err = ALSA_CHECK(snd_pcm_sw_params(pcm, sw_params));
+	}
+	snd_pcm_close(pcm);
+	return err;
+}
+
+/* a handle from the pool is prepared with an empty buffer */
+static void check_fresh(snd_pcm_t *pcm)
+{
+	snd_pcm_sframes_t delay = -1;
+
+	TEST_CHECK(snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED);
+	TEST_CHECK(snd_pcm_avail(pcm) == (snd_pcm_sframes_t)buffer_size);
+	TEST_CHECK(snd_pcm_delay(pcm, &delay) >= 0 && delay == 0);
+}
+
+static void test_release(snd_pcm_hw_params_t *hw_params,
+			 snd_pcm_sw_params_t *sw_params)
+{
+	static short frames[WRITTEN * 2];
+	snd_pcm_pool_t *pool;
+	snd_pcm_t *pcm, *pcm2;
+
+	if (ALSA_CHECK(snd_pcm_pool_open(&pool, "pooltest",
+					 SND_PCM_STREAM_PLAYBACK, 0,
+					 hw_params, sw_params, 1)) < 0)
+		return;
+	TEST_CHECK(snd_pcm_pool_fill(pool) == 1);
+	TEST_CHECK(snd_pcm_pool_get_avail(pool) == 1);
+
+	if (ALSA_CHECK(snd_pcm_pool_acquire(pool, &pcm)) < 0)
+		goto out;
+	TEST_CHECK(snd_pcm_pool_get_avail(pool) == 0);
+	check_fresh(pcm);
+
+	/* frames written but never started do not reach the next user */
+	TEST_CHECK(snd_pcm_writei(pcm, frames, WRITTEN) == WRITTEN);
+	TEST_CHECK(snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED);
+	TEST_CHECK(snd_pcm_pool_release(pool, pcm) == 1);
+	TEST_CHECK(snd_pcm_pool_get_avail(pool) == 1);
+
+	if (ALSA_CHECK(snd_pcm_pool_acquire(pool, &pcm2)) < 0)
+		goto out;
+	TEST_CHECK(pcm2 == pcm);
+	check_fresh(pcm2);
+
+	/* a running stream is stopped */
+	TEST_CHECK(snd_pcm_writei(pcm2, frames, WRITTEN) == WRITTEN);
+	ALSA_CHECK(snd_pcm_start(pcm2));
+	TEST_CHECK(snd_pcm_state(pcm2) == SND_PCM_STATE_RUNNING);
+	TEST_CHECK(snd_pcm_pool_release(pool, pcm2) == 1);
+	if (ALSA_CHECK(snd_pcm_pool_acquire(pool, &pcm)) < 0)
+		goto out;
+	check_fresh(pcm);
+
+	/* the pool is full: the second handle is closed */
+	if (ALSA_CHECK(snd_pcm_pool_acquire(pool, &pcm2)) >= 0) {
+		TEST_CHECK(snd_pcm_pool_release(pool, pcm2) == 1);
+		TEST_CHECK(snd_pcm_pool_release(pool, pcm) == 0);
+	} else {
+		snd_pcm_close(pcm);
+	}
+	TEST_CHECK(snd_pcm_pool_get_avail(pool) == 1);
+out:
+	snd_pcm_pool_close(pool);
+}
+
+int main(void)
+{
+	snd_pcm_hw_params_t *hw_params;
+	snd_pcm_sw_params_t *sw_params;
+
+	if (ALSA_CHECK(setup_config()) < 0)
+		return TEST_EXIT_CODE();
+	snd_pcm_hw_params_alloca(&hw_params);
+	snd_pcm_sw_params_alloca(&sw_params);
+	if (make_params(hw_params, sw_params) >= 0)
+		test_release(hw_params, sw_params);
+	snd_config_update_free_global();
+	unlink(config_path);
+	return TEST_EXIT_CODE();
+}
@@ -0,0 +1,150 @@
+/*
+ * Checks that the events reserved on the output buffer of a sequencer
+ * handle are only committed while nothing else used the buffer.  The
+ * handle is a fake one, its writes are counted instead of sent.
+ */
+#include <string.h>
+#include "seq_local.h"
+
+/* the internal headers of the sequencer clash with test.h */
+static int any_test_failed;
+
+#define TEST_CHECK(cond) do \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: test failed: %s\n", __FILE__, __LINE__, #cond); \
+			any_test_failed = 1; \
+		} \
+	while (0)
+
+static size_t written;		/* bytes of the writes since the last check */
+static unsigned char last_type;	/* type of the last event written */
+
+static ssize_t test_write(snd_seq_t *seq, void *buf, size_t len)
+{
+	snd_seq_event_t *ev = buf;
+
+	written += len;
+	if (len >= sizeof(*ev))
+		last_type = ev[len / sizeof(*ev) - 1].type;
+	return len;
+}
+
+static int test_remove_events(snd_seq_t *seq, snd_seq_remove_events_t *rmp)
+{
+	return 0;
+}
+
+static const snd_seq_ops_t test_ops = {
+	.write = test_write,
+	.remove_events = test_remove_events,
+};
+
+static snd_seq_t *test_open(void)
+{
+	snd_seq_t *seq;
+
+	seq = calloc(1, sizeof(*seq));
+	if (!seq)
+		return NULL;
+	seq->ops = &test_ops;
+	seq->obufsize = seq->obufbase = SND_SEQ_OBUF_SIZE;
+	seq->obuf = calloc(1, seq->obufsize);
+	if (!seq->obuf) {
+		free(seq);
+		return NULL;
+	}
+	return seq;
+}
+
+static void test_close(snd_seq_t *seq)
+{
+	free(seq->obuf);
+	free(seq->tmpbuf);
+	free(seq);
+}
+
+static void make_event(snd_seq_event_t *ev, unsigned char type)
+{
+	snd_seq_ev_clear(ev);
+	ev->type = type;
+	snd_seq_ev_set_direct(ev);
+	snd_seq_ev_set_subs(ev);
+}
+
+/* a reservation which is filled and committed is sent by the drain */
+static void test_commit(snd_seq_t *seq)
+{
+	snd_seq_event_t *ev;
+
+	TEST_CHECK(snd_seq_event_output_reserve(seq, &ev, 3) == 3);
+	make_event(&ev[0], SND_SEQ_EVENT_NOTEON);
+	make_event(&ev[1], SND_SEQ_EVENT_NOTEOFF);
+	TEST_CHECK(snd_seq_event_output_commit(seq, 2) ==
+		   2 * sizeof(snd_seq_event_t));
+	TEST_CHECK(snd_seq_event_output_commit(seq, 1) == -EINVAL);
+	written = 0;
+	TEST_CHECK(snd_seq_drain_output(seq) == 0);
+	TEST_CHECK(written == 2 * sizeof(snd_seq_event_t));
+	TEST_CHECK(last_type == SND_SEQ_EVENT_NOTEOFF);
+}
+
+/*
+ * reserve, output, drain, commit: the buffer is back where it was
+ * reserved, but the reserved room holds the event of the output
+ */
+static void test_output_drain(snd_seq_t *seq)
+{
+	snd_seq_event_t *ev, out;
+
+	TEST_CHECK(snd_seq_event_output_reserve(seq, &ev, 1) == 1);
+	make_event(ev, SND_SEQ_EVENT_NOTEON);
+	make_event(&out, SND_SEQ_EVENT_CONTROLLER);
+	TEST_CHECK(snd_seq_event_output(seq, &out) == sizeof(out));
+	written = 0;
+	TEST_CHECK(snd_seq_drain_output(seq) == 0);
+	TEST_CHECK(written == sizeof(out));
+	TEST_CHECK(snd_seq_event_output_commit(seq, 1) == -EINVAL);
+	TEST_CHECK(snd_seq_event_output_pending(seq) == 0);
+}
+
+/* the other users of the buffer discard the reservation too */
+static void test_discard(snd_seq_t *seq)
+{
+	snd_seq_event_t *ev, out;
+
+	make_event(&out, SND_SEQ_EVENT_CONTROLLER);
+
+	TEST_CHECK(snd_seq_event_output_reserve(seq, &ev, 1) == 1);
+	TEST_CHECK(snd_seq_drain_output(seq) == 0);
+	TEST_CHECK(snd_seq_event_output_commit(seq, 1) == -EINVAL);
+
+	TEST_CHECK(snd_seq_event_output_reserve(seq, &ev, 1) == 1);
+	TEST_CHECK(snd_seq_event_output_buffer(seq, &out) == sizeof(out));
+	TEST_CHECK(snd_seq_drop_output_buffer(seq) == 0);
+	TEST_CHECK(snd_seq_event_output_commit(seq, 1) == -EINVAL);
+
+	TEST_CHECK(snd_seq_event_output_reserve(seq, &ev, 1) == 1);
+	TEST_CHECK(snd_seq_drop_output(seq) == 0);
+	TEST_CHECK(snd_seq_event_output_commit(seq, 1) == -EINVAL);
+
+	TEST_CHECK(snd_seq_event_output_buffer(seq, &out) == sizeof(out));
+	TEST_CHECK(snd_seq_event_output_reserve(seq, &ev, 1) == 1);
+	TEST_CHECK(snd_seq_extract_output(seq, NULL) == 0);
+	TEST_CHECK(snd_seq_event_output_commit(seq, 1) == -EINVAL);
+
+	TEST_CHECK(snd_seq_event_output_pending(seq) == 0);
+}
+
+int main(void)
+{
+	snd_seq_t *seq;
+
+	seq = test_open();
+	if (!seq)
+		return 1;
+	test_commit(seq);
+	test_output_drain(seq);
+	test_discard(seq);
+	test_close(seq);
+	return any_test_failed;
+}
@@ -0,0 +1,366 @@
+/*
+ *  Control and mixer benchmark
+ *
+ *  Adds sets of user elements to a card (volumes and switches, like
+ *  user-ctl-element-set does) and times loading them through hctl and
+ *  the simple mixer, event storms and bulk value reads and writes,
+ *  reported as CSV:
+ *
+ *    op,elements,iterations,ns,ns_per_op,ioctls_per_op
+ *
+ *  The card needs room for user elements, snd-dummy or snd-aloop will
+ *  do.  The elements are removed at the end.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <dlfcn.h>
+#include "../include/asoundlib.h"
+
+#define VOLUME_NAME	"Bench Playback Volume"
+#define SWITCH_NAME	"Bench Playback Switch"
+
+static const char *card = "hw:0";
+static unsigned int elements = 256;
+static unsigned int iterations = 20;
+
+/* count the ioctls of the library by wrapping the one of the C library */
+static unsigned long ioctls;
+
+int ioctl(int fd, unsigned long request, ...)
+{
+	static int (*libc_ioctl)(int fd, unsigned long request, ...);
+	va_list ap;
+	void *arg;
+
+	if (!libc_ioctl)
+		libc_ioctl = dlsym(RTLD_NEXT, "ioctl");
+	va_start(ap, request);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+	ioctls++;
+	return libc_ioctl(fd, request, arg);
+}
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned long long start_ns;
+static unsigned long start_ioctls;
+
+static void start(void)
+{
+	start_ioctls = ioctls;
+	start_ns = now_ns();
+}
+
+static void report(const char *op, unsigned int n, int err)
+{
+	unsigned long long ns = now_ns() - start_ns;
+	unsigned long c = ioctls - start_ioctls;
+
+	if (err < 0) {
+		printf("# %s,%u: %s\n", op, elements, snd_strerror(err));
+		return;
+	}
+	printf("%s,%u,%u,%llu,%.0f,%.1f\n", op, elements, n, ns,
+	       (double)ns / n, (double)c / n);
+}
+
+static void set_id(snd_ctl_elem_id_t *id, const char *name, unsigned int index)
+{
+	snd_ctl_elem_id_clear(id);
+	snd_ctl_elem_id_set_interface(id, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name(id, name);
+	snd_ctl_elem_id_set_index(id, index);
+}
+
+static int add_elems(snd_ctl_t *ctl)
+{
+	snd_ctl_elem_info_t *info;
+	snd_ctl_elem_id_t *id;
+	int err;
+
+	snd_ctl_elem_info_alloca(&info);
+	snd_ctl_elem_id_alloca(&id);
+	set_id(id, VOLUME_NAME, 0);
+	snd_ctl_elem_info_set_id(info, id);
+	err = snd_ctl_add_integer_elem_set(ctl, info, elements, 2, 0, 100, 1);
+	if (err < 0)
+		return err;
+	set_id(id, SWITCH_NAME, 0);
+	snd_ctl_elem_info_set_id(info, id);
+	return snd_ctl_add_boolean_elem_set(ctl, info, elements, 2);
+}
+
+static void remove_elems(snd_ctl_t *ctl)
+{
+	snd_ctl_elem_id_t *id;
+
+	snd_ctl_elem_id_alloca(&id);
+	/* removing one element removes its set */
+	set_id(id, VOLUME_NAME, 0);
+	snd_ctl_elem_remove(ctl, id);
+	set_id(id, SWITCH_NAME, 0);
+	snd_ctl_elem_remove(ctl, id);
+}
+
+static int open_mixer(snd_mixer_t **mixerp)
+{
+	snd_mixer_t *mixer;
+	int err;
+
+	err = snd_mixer_open(&mixer, 0);
+	if (err < 0)
+		return err;
+	err = snd_mixer_attach(mixer, card);
+	if (err >= 0)
+		err = snd_mixer_selem_register(mixer, NULL, NULL);
+	if (err >= 0)
+		err = snd_mixer_load(mixer);
+	if (err < 0) {
+		snd_mixer_close(mixer);
+		return err;
+	}
+	*mixerp = mixer;
+	return 0;
+}
+
+static void bench_hctl_load(void)
+{
+	snd_hctl_t *hctl;
+	unsigned int i;
+	int err = 0;
+
+	start();
+	for (i = 0; i < iterations && err >= 0; i++) {
+		err = snd_hctl_open(&hctl, card, 0);
+		if (err < 0)
+			break;
+		err = snd_hctl_load(hctl);
+		snd_hctl_close(hctl);
+	}
+	report("hctl_load", iterations, err);
+}
+
+static void bench_mixer_load(void)
+{
+	snd_mixer_t *mixer;
+	unsigned int i;
+	int err = 0;
+
+	start();
+	for (i = 0; i < iterations && err >= 0; i++) {
+		err = open_mixer(&mixer);
+		if (err >= 0)
+			snd_mixer_close(mixer);
+	}
+	report("mixer_load", iterations, err);
+}
+
+static int is_bench(snd_mixer_elem_t *elem)
+{
+	return !strcmp(snd_mixer_selem_get_name(elem), "Bench");
+}
+
+/* the values of all elements changed by another client */
+static void bench_events(snd_mixer_t *mixer, snd_ctl_t *ctl)
+{
+	snd_ctl_elem_value_t *value;
+	snd_ctl_elem_id_t *id;
+	unsigned int i, k;
+	int err = 0;
+	unsigned long long ns = 0;
+	unsigned long c = 0;
+
+	snd_ctl_elem_value_alloca(&value);
+	snd_ctl_elem_id_alloca(&id);
+	for (k = 0; k < iterations && err >= 0; k++) {
+		for (i = 0; i < elements && err >= 0; i++) {
+			set_id(id, VOLUME_NAME, i);
+			snd_ctl_elem_value_set_id(value, id);
+			snd_ctl_elem_value_set_integer(value, 0, (i + k) % 101);
+			snd_ctl_elem_value_set_integer(value, 1, (i + k) % 101);
+			err = snd_ctl_elem_write(ctl, value);
+		}
+		if (err < 0)
+			break;
+		start();
+		do {
+			err = snd_mixer_handle_events(mixer);
+		} while (err > 0);
+		ns += now_ns() - start_ns;
+		c += ioctls - start_ioctls;
+	}
+	if (err < 0) {
+		printf("# events,%u: %s\n", elements, snd_strerror(err));
+		return;
+	}
+	printf("events,%u,%u,%llu,%.0f,%.1f\n", elements, iterations, ns,
+	       (double)ns / iterations, (double)c / iterations);
+}
+
+static void bench_selem(snd_mixer_t *mixer)
+{
+	snd_mixer_elem_t *elem;
+	unsigned int i;
+	long vol;
+	int sw, err = 0;
+
+	start();
+	for (i = 0; i < iterations && err >= 0; i++)
+		for (elem = snd_mixer_first_elem(mixer); elem && err >= 0;
+		     elem = snd_mixer_elem_next(elem))
+			if (is_bench(elem))
+				err = snd_mixer_selem_set_playback_volume_all(elem, i % 101);
+	report("selem_write", iterations, err);
+
+	start();
+	for (i = 0; i < iterations && err >= 0; i++)
+		for (elem = snd_mixer_first_elem(mixer); elem && err >= 0;
+		     elem = snd_mixer_elem_next(elem))
+			if (is_bench(elem)) {
+				err = snd_mixer_selem_get_playback_volume(elem, 0, &vol);
+				if (err >= 0)
+					err = snd_mixer_selem_get_playback_switch(elem, 0, &sw);
+			}
+	report("selem_read", iterations, err);
+}
+
+static void bench_ctl(snd_ctl_t *ctl)
+{
+	snd_ctl_elem_value_t *value;
+	snd_ctl_elem_id_t *id;
+	unsigned int i, k;
+	int err = 0;
+
+	snd_ctl_elem_value_alloca(&value);
+	snd_ctl_elem_id_alloca(&id);
+	start();
+	for (k = 0; k < iterations && err >= 0; k++)
+		for (i = 0; i < elements && err >= 0; i++) {
+			set_id(id, SWITCH_NAME, i);
+			snd_ctl_elem_value_set_id(value, id);
+			snd_ctl_elem_value_set_boolean(value, 0, k & 1);
+			snd_ctl_elem_value_set_boolean(value, 1, k & 1);
+			err = snd_ctl_elem_write(ctl, value);
+		}
+	report("ctl_write", iterations, err);
+
+	start();
+	for (k = 0; k < iterations && err >= 0; k++)
+		for (i = 0; i < elements && err >= 0; i++) {
+			set_id(id, SWITCH_NAME, i);
+			snd_ctl_elem_value_set_id(value, id);
+			err = snd_ctl_elem_read(ctl, value);
+		}
+	report("ctl_read", iterations, err);
+}
+
+static void help(void)
+{
+	printf(
+"Usage: mixer-bench [OPTION]...\n"
+"-h,--help		help\n"
+"-D,--device		control device (default %s)\n"
+"-e,--elements		elements per set (default %u)\n"
+"-i,--iterations	iterations per operation (default %u)\n"
+"\n", card, elements, iterations);
+}
+
+int main(int argc, char *argv[])
+{
+	struct option long_option[] =
+	{
+		{"help", 0, NULL, 'h'},
+		{"device", 1, NULL, 'D'},
+		{"elements", 1, NULL, 'e'},
+		{"iterations", 1, NULL, 'i'},
+		{NULL, 0, NULL, 0},
+	};
+	snd_ctl_t *ctl;
+	snd_mixer_t *mixer;
+	int err;
+
+	while (1) {
+		int opt;
+		if ((opt = getopt_long(argc, argv, "hD:e:i:", long_option, NULL)) < 0)
+			break;
+		switch (opt) {
+		case 'h':
+			help();
+			return 0;
+		case 'D':
+			card = optarg;
+			break;
+		case 'e':
+			elements = strtoul(optarg, NULL, 0);
+			if (elements < 1)
+				elements = 1;
+			break;
+		case 'i':
+			iterations = strtoul(optarg, NULL, 0);
+			if (iterations < 1)
+				iterations = 1;
+			break;
+		default:
+			help();
+			return 1;
+		}
+	}
+
+	err = snd_ctl_open(&ctl, card, 0);
+	if (err < 0) {
+		printf("# open %s: %s\n", card, snd_strerror(err));
+		return 1;
+	}
+	remove_elems(ctl);
+	err = add_elems(ctl);
+	if (err < 0) {
+		printf("# add elements: %s\n", snd_strerror(err));
+		remove_elems(ctl);
+		snd_ctl_close(ctl);
+		return 1;
+	}
+	printf("op,elements,iterations,ns,ns_per_op,ioctls_per_op\n");
+	bench_hctl_load();
+	bench_mixer_load();
+	err = open_mixer(&mixer);
+	if (err >= 0) {
+		bench_events(mixer, ctl);
+		bench_selem(mixer);
+		snd_mixer_close(mixer);
+	} else {
+		printf("# mixer,%u: %s\n", elements, snd_strerror(err));
+	}
+	bench_ctl(ctl);
+	remove_elems(ctl);
+	snd_ctl_close(ctl);
+	return 0;
+}
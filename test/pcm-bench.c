@@ -0,0 +1,263 @@
+/*
+ *  PCM plugin benchmark
+ *
+ *  Pushes frames through plugin chains ending in the null PCM and
+ *  reports the throughput of each chain as CSV:
+ *
+ *    chain,format,channels,rate,frames,ns,frames_per_sec,ns_per_frame
+ *
+ *  Chains which cannot be set up (e.g. softvol or dmix without a sound
+ *  card) are reported as comment lines starting with '#'.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include "../include/asoundlib.h"
+
+#define RATE		44100
+#define PERIOD		1024
+
+/*
+ * @SINK@ is replaced with the sink definition, @TTABLE@ with a table
+ * mixing all channels down to stereo.
+ */
+static const struct chain {
+	const char *name;
+	const char *conf;
+} chains[] = {
+	{ "null", "@SINK@" },
+	{ "linear", "{ type linear slave { pcm @SINK@ format S32_LE } }" },
+	{ "lfloat", "{ type lfloat slave { pcm @SINK@ format FLOAT_LE } }" },
+	{ "route", "{ type route slave { pcm @SINK@ channels 2 } ttable { @TTABLE@ } }" },
+	{ "rate", "{ type rate slave { pcm @SINK@ rate 48000 } converter \"linear\" }" },
+	{ "softvol", "{ type softvol slave.pcm @SINK@ control.name \"Bench Volume\" }" },
+	{ "mulaw", "{ type mulaw slave { pcm @SINK@ format MU_LAW } }" },
+	{ "alaw", "{ type alaw slave { pcm @SINK@ format A_LAW } }" },
+	{ "adpcm", "{ type adpcm slave { pcm @SINK@ format IMA_ADPCM } }" },
+	{ "iec958", "{ type iec958 slave { pcm @SINK@ format IEC958_SUBFRAME_LE } }" },
+	{ "dmix", "{ type dmix ipc_key 0x62656e63 slave.pcm \"hw:0\" }" },
+	{ "plug", "{ type plug slave { pcm @SINK@ format FLOAT_LE rate 48000 channels 2 } }" },
+	{ "plug_s16", "{ type plug slave { pcm @SINK@ format S16_LE rate 48000 channels 2 } }" },
+	{ NULL, NULL }
+};
+
+static const snd_pcm_format_t formats[] = {
+	SND_PCM_FORMAT_S16_LE,
+	SND_PCM_FORMAT_S32_LE,
+	SND_PCM_FORMAT_FLOAT_LE,
+};
+
+static const unsigned int channel_counts[] = { 1, 2, 6 };
+
+static const char *sink = "{ type null }";
+static unsigned long total_frames = RATE * 20;
+
+static void silent_error(const char *file ATTRIBUTE_UNUSED,
+			 int line ATTRIBUTE_UNUSED,
+			 const char *function ATTRIBUTE_UNUSED,
+			 int err ATTRIBUTE_UNUSED,
+			 const char *fmt ATTRIBUTE_UNUSED, ...)
+{
+}
+
+/* append src to dst with the placeholders expanded */
+static void expand(char *dst, size_t size, const char *src, unsigned int channels)
+{
+	size_t len = 0;
+	unsigned int c;
+
+	while (*src && len + 1 < size) {
+		if (!strncmp(src, "@SINK@", 6)) {
+			len += snprintf(dst + len, size - len, "%s", sink);
+			src += 6;
+		} else if (!strncmp(src, "@TTABLE@", 8)) {
+			for (c = 0; c < channels && len < size; c++)
+				len += snprintf(dst + len, size - len,
+						"%u.%u %s ", c, c % 2,
+						channels > 2 ? "0.5" : "1");
+			src += 8;
+		} else {
+			dst[len++] = *src++;
+		}
+	}
+	if (len >= size)
+		len = size - 1;
+	dst[len] = '\0';
+}
+
+static int open_chain(snd_pcm_t **pcm, const struct chain *chain,
+		      unsigned int channels)
+{
+	char conf[1024];
+	int len;
+	snd_config_t *top;
+	snd_input_t *in;
+	int err;
+
+	len = snprintf(conf, sizeof(conf), "pcm.bench ");
+	expand(conf + len, sizeof(conf) - len, chain->conf, channels);
+	err = snd_config_top(&top);
+	if (err < 0)
+		return err;
+	err = snd_input_buffer_open(&in, conf, -1);
+	if (err < 0)
+		goto _end;
+	err = snd_config_load(top, in);
+	snd_input_close(in);
+	if (err < 0)
+		goto _end;
+	err = snd_pcm_open_lconf(pcm, "bench", SND_PCM_STREAM_PLAYBACK, 0, top);
+ _end:
+	snd_config_delete(top);
+	return err;
+}
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bench(const struct chain *chain, snd_pcm_format_t format,
+		 unsigned int channels)
+{
+	snd_pcm_t *pcm;
+	void *buf;
+	unsigned long frames = 0;
+	unsigned long long start, ns;
+	snd_pcm_sframes_t n;
+	int err;
+
+	err = open_chain(&pcm, chain, channels);
+	if (err < 0)
+		goto _skip;
+	err = snd_pcm_set_params(pcm, format, SND_PCM_ACCESS_RW_INTERLEAVED,
+				 channels, RATE, 1, 100000);
+	if (err < 0) {
+		snd_pcm_close(pcm);
+		goto _skip;
+	}
+	buf = calloc(PERIOD, snd_pcm_format_physical_width(format) / 8 * channels);
+	if (!buf) {
+		snd_pcm_close(pcm);
+		return -ENOMEM;
+	}
+	snd_pcm_format_set_silence(format, buf, PERIOD * channels);
+	start = now_ns();
+	while (frames < total_frames) {
+		n = snd_pcm_writei(pcm, buf, PERIOD);
+		if (n < 0)
+			n = snd_pcm_recover(pcm, n, 1);
+		if (n < 0) {
+			err = n;
+			break;
+		}
+		frames += n;
+	}
+	snd_pcm_drain(pcm);
+	ns = now_ns() - start;
+	free(buf);
+	snd_pcm_close(pcm);
+	if (err < 0)
+		goto _skip;
+	if (!ns)
+		ns = 1;
+	printf("%s,%s,%u,%u,%lu,%llu,%.0f,%.3f\n",
+	       chain->name, snd_pcm_format_name(format), channels, RATE,
+	       frames, ns, frames * 1e9 / ns, (double)ns / frames);
+	return 0;
+
+ _skip:
+	printf("# %s,%s,%u: %s\n", chain->name, snd_pcm_format_name(format),
+	       channels, snd_strerror(err));
+	return err;
+}
+
+static void help(void)
+{
+	const struct chain *chain;
+
+	printf(
+"Usage: pcm-bench [OPTION]... [CHAIN]...\n"
+"-h,--help	help\n"
+"-f,--frames	frames to transfer per run (default %lu)\n"
+"-s,--sink	sink PCM definition (default \"%s\")\n"
+"\n", total_frames, sink);
+	printf("Recognized chains are:");
+	for (chain = chains; chain->name; chain++)
+		printf(" %s", chain->name);
+	printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct option long_option[] =
+	{
+		{"help", 0, NULL, 'h'},
+		{"frames", 1, NULL, 'f'},
+		{"sink", 1, NULL, 's'},
+		{NULL, 0, NULL, 0},
+	};
+	const struct chain *chain;
+	unsigned int f, c;
+	int i;
+
+	while (1) {
+		int opt;
+		if ((opt = getopt_long(argc, argv, "hf:s:", long_option, NULL)) < 0)
+			break;
+		switch (opt) {
+		case 'h':
+			help();
+			return 0;
+		case 'f':
+			total_frames = strtoul(optarg, NULL, 0);
+			if (total_frames < PERIOD)
+				total_frames = PERIOD;
+			break;
+		case 's':
+			sink = optarg;
+			break;
+		default:
+			help();
+			return 1;
+		}
+	}
+
+	snd_lib_error_set_handler(silent_error);
+	printf("chain,format,channels,rate,frames,ns,frames_per_sec,ns_per_frame\n");
+	for (chain = chains; chain->name; chain++) {
+		if (optind < argc) {
+			for (i = optind; i < argc; i++)
+				if (!strcmp(argv[i], chain->name))
+					break;
+			if (i == argc)
+				continue;
+		}
+		for (f = 0; f < sizeof(formats) / sizeof(formats[0]); f++)
+			for (c = 0; c < sizeof(channel_counts) / sizeof(channel_counts[0]); c++)
+				bench(chain, formats[f], channel_counts[c]);
+	}
+	return 0;
+}
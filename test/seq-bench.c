@@ -0,0 +1,482 @@
+/*
+ *  Sequencer and rawmidi benchmark
+ *
+ *  Measures the event rate and the latency of events sent from one
+ *  sequencer client to another, of bytes through a virtual rawmidi
+ *  port (looped back to itself), and the rate of the MIDI event
+ *  encoder and decoder, reported as CSV:
+ *
+ *    op,events,ns,events_per_sec,p50_ns,p90_ns,p99_ns,max_ns
+ *
+ *  The flood lines send batches of events and read them back, the
+ *  ping lines send one event at a time and wait for it; the latency
+ *  columns are 0 where not measured.
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include "../include/asoundlib.h"
+
+#define BATCH		64	/* fits the default input pool of a client */
+#define VIRTUAL_PORT	"Virtual RawMIDI"
+
+static unsigned int total_events = 100000;
+static unsigned int ping_events = 10000;
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int cmp_ns(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report_rate(const char *op, unsigned int events,
+			unsigned long long ns)
+{
+	if (!ns)
+		ns = 1;
+	printf("%s,%u,%llu,%.0f,0,0,0,0\n", op, events, ns, events * 1e9 / ns);
+}
+
+static void report_latency(const char *op, unsigned long long *lat,
+			   unsigned int events, unsigned long long ns)
+{
+	if (!ns)
+		ns = 1;
+	qsort(lat, events, sizeof(*lat), cmp_ns);
+	printf("%s,%u,%llu,%.0f,%llu,%llu,%llu,%llu\n", op, events, ns,
+	       events * 1e9 / ns, lat[events / 2], lat[events * 9 / 10],
+	       lat[events * 99 / 100], lat[events - 1]);
+}
+
+static void report_error(const char *op, int err)
+{
+	printf("# %s: %s\n", op, snd_strerror(err));
+}
+
+static int open_client(snd_seq_t **seqp, const char *name, unsigned int caps)
+{
+	snd_seq_t *seq;
+	int err;
+
+	err = snd_seq_open(&seq, "default", SND_SEQ_OPEN_DUPLEX, 0);
+	if (err < 0)
+		return err;
+	snd_seq_set_client_name(seq, name);
+	err = snd_seq_create_simple_port(seq, name, caps,
+					 SND_SEQ_PORT_TYPE_MIDI_GENERIC |
+					 SND_SEQ_PORT_TYPE_APPLICATION);
+	if (err < 0) {
+		snd_seq_close(seq);
+		return err;
+	}
+	*seqp = seq;
+	return 0;
+}
+
+static void set_note(snd_seq_event_t *ev, unsigned int i)
+{
+	snd_seq_ev_clear(ev);
+	snd_seq_ev_set_source(ev, 0);
+	snd_seq_ev_set_subs(ev);
+	snd_seq_ev_set_direct(ev);
+	snd_seq_ev_set_noteon(ev, i & 15, i & 127, 64);
+}
+
+static int seq_flood(snd_seq_t *tx, snd_seq_t *rx)
+{
+	snd_seq_event_t ev, *evp;
+	unsigned long long start;
+	unsigned int i, b;
+	int err;
+
+	start = now_ns();
+	for (i = 0; i < total_events; i += BATCH) {
+		for (b = 0; b < BATCH; b++) {
+			set_note(&ev, i + b);
+			err = snd_seq_event_output(tx, &ev);
+			if (err < 0)
+				return err;
+		}
+		err = snd_seq_drain_output(tx);
+		if (err < 0)
+			return err;
+		for (b = 0; b < BATCH; b++) {
+			err = snd_seq_event_input(rx, &evp);
+			if (err < 0)
+				return err;
+		}
+	}
+	report_rate("seq_flood", i, now_ns() - start);
+	return 0;
+}
+
+static int seq_ping(snd_seq_t *tx, snd_seq_t *rx, unsigned long long *lat)
+{
+	snd_seq_event_t ev, *evp;
+	unsigned long long start, t;
+	unsigned int i;
+	int err;
+
+	start = now_ns();
+	for (i = 0; i < ping_events; i++) {
+		set_note(&ev, i);
+		t = now_ns();
+		err = snd_seq_event_output_direct(tx, &ev);
+		if (err < 0)
+			return err;
+		err = snd_seq_event_input(rx, &evp);
+		if (err < 0)
+			return err;
+		lat[i] = now_ns() - t;
+	}
+	report_latency("seq_ping", lat, ping_events, now_ns() - start);
+	return 0;
+}
+
+static void bench_seq(unsigned long long *lat)
+{
+	snd_seq_t *tx, *rx;
+	int err;
+
+	err = open_client(&tx, "Bench Sender",
+			  SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ);
+	if (err < 0) {
+		report_error("seq", err);
+		return;
+	}
+	err = open_client(&rx, "Bench Receiver",
+			  SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE);
+	if (err < 0) {
+		report_error("seq", err);
+		snd_seq_close(tx);
+		return;
+	}
+	err = snd_seq_connect_to(tx, 0, snd_seq_client_id(rx), 0);
+	if (err >= 0)
+		err = seq_flood(tx, rx);
+	if (err >= 0)
+		err = seq_ping(tx, rx, lat);
+	if (err < 0)
+		report_error("seq", err);
+	snd_seq_close(rx);
+	snd_seq_close(tx);
+}
+
+/* the client of the virtual rawmidi port opened last */
+static int find_virtual(snd_seq_t *seq, snd_seq_addr_t *addr)
+{
+	snd_seq_client_info_t *cinfo;
+	snd_seq_port_info_t *pinfo;
+	int found = 0;
+
+	snd_seq_client_info_alloca(&cinfo);
+	snd_seq_port_info_alloca(&pinfo);
+	snd_seq_client_info_set_client(cinfo, -1);
+	while (snd_seq_query_next_client(seq, cinfo) >= 0) {
+		int client = snd_seq_client_info_get_client(cinfo);
+
+		snd_seq_port_info_set_client(pinfo, client);
+		snd_seq_port_info_set_port(pinfo, -1);
+		while (snd_seq_query_next_port(seq, pinfo) >= 0) {
+			if (strcmp(snd_seq_port_info_get_name(pinfo), VIRTUAL_PORT))
+				continue;
+			addr->client = client;
+			addr->port = snd_seq_port_info_get_port(pinfo);
+			found = 1;
+		}
+	}
+	return found ? 0 : -ENODEV;
+}
+
+/* note on and off alternate, so no running status drops a byte */
+static void set_message(unsigned char *buf, unsigned int i)
+{
+	buf[0] = (i & 1 ? 0x80 : 0x90) | (i & 15);
+	buf[1] = i & 127;
+	buf[2] = 64;
+}
+
+static int rawmidi_read_all(snd_rawmidi_t *in, unsigned char *buf, size_t size)
+{
+	ssize_t n;
+
+	while (size > 0) {
+		n = snd_rawmidi_read(in, buf, size);
+		if (n < 0)
+			return n;
+		buf += n;
+		size -= n;
+	}
+	return 0;
+}
+
+static int rawmidi_flood(snd_rawmidi_t *in, snd_rawmidi_t *out)
+{
+	unsigned char buf[BATCH * 3];
+	unsigned long long start;
+	unsigned int i, b;
+	ssize_t n;
+	int err;
+
+	start = now_ns();
+	for (i = 0; i < total_events; i += BATCH) {
+		for (b = 0; b < BATCH; b++)
+			set_message(buf + b * 3, i + b);
+		n = snd_rawmidi_write(out, buf, sizeof(buf));
+		if (n < 0)
+			return n;
+		err = rawmidi_read_all(in, buf, sizeof(buf));
+		if (err < 0)
+			return err;
+	}
+	report_rate("rawmidi_flood", i, now_ns() - start);
+	return 0;
+}
+
+static int rawmidi_ping(snd_rawmidi_t *in, snd_rawmidi_t *out,
+			unsigned long long *lat)
+{
+	unsigned char buf[3];
+	unsigned long long start, t;
+	unsigned int i;
+	ssize_t n;
+	int err;
+
+	start = now_ns();
+	for (i = 0; i < ping_events; i++) {
+		set_message(buf, i);
+		t = now_ns();
+		n = snd_rawmidi_write(out, buf, sizeof(buf));
+		if (n < 0)
+			return n;
+		err = rawmidi_read_all(in, buf, sizeof(buf));
+		if (err < 0)
+			return err;
+		lat[i] = now_ns() - t;
+	}
+	report_latency("rawmidi_ping", lat, ping_events, now_ns() - start);
+	return 0;
+}
+
+static void bench_rawmidi(unsigned long long *lat)
+{
+	snd_rawmidi_t *in, *out;
+	snd_seq_t *seq;
+	snd_seq_port_subscribe_t *sub;
+	snd_seq_addr_t addr;
+	int err;
+
+	err = snd_rawmidi_open(&in, &out, "virtual", 0);
+	if (err < 0) {
+		report_error("rawmidi", err);
+		return;
+	}
+	err = snd_seq_open(&seq, "default", SND_SEQ_OPEN_DUPLEX, 0);
+	if (err < 0) {
+		report_error("rawmidi", err);
+		goto _close;
+	}
+	/* loop the port back to itself */
+	err = find_virtual(seq, &addr);
+	if (err >= 0) {
+		snd_seq_port_subscribe_alloca(&sub);
+		snd_seq_port_subscribe_set_sender(sub, &addr);
+		snd_seq_port_subscribe_set_dest(sub, &addr);
+		err = snd_seq_subscribe_port(seq, sub);
+	}
+	if (err >= 0)
+		err = rawmidi_flood(in, out);
+	if (err >= 0)
+		err = rawmidi_ping(in, out, lat);
+	if (err < 0)
+		report_error("rawmidi", err);
+	snd_seq_close(seq);
+ _close:
+	snd_rawmidi_close(in);
+	snd_rawmidi_close(out);
+}
+
+/* channel messages of all kinds, with runs in running status */
+static size_t make_stream(unsigned char *buf, unsigned int messages)
+{
+	unsigned char *p = buf;
+	unsigned int i;
+
+	for (i = 0; i < messages; i++) {
+		unsigned char ch = i & 15;
+
+		switch (i % 8) {
+		case 0:
+			*p++ = 0x90 | ch;
+			/* fall through */
+		case 1:
+		case 2:
+			*p++ = i & 127;
+			*p++ = 100;
+			break;
+		case 3:
+			*p++ = 0x80 | ch;
+			*p++ = i & 127;
+			*p++ = 0;
+			break;
+		case 4:
+			*p++ = 0xb0 | ch;
+			*p++ = 7;
+			*p++ = i & 127;
+			break;
+		case 5:
+			*p++ = 0xc0 | ch;
+			*p++ = i & 127;
+			break;
+		case 6:
+			*p++ = 0xe0 | ch;
+			*p++ = i & 127;
+			*p++ = 0x40;
+			break;
+		case 7:
+			*p++ = 0xd0 | ch;
+			*p++ = i & 127;
+			break;
+		}
+	}
+	return p - buf;
+}
+
+static void bench_midi_event(void)
+{
+	snd_midi_event_t *enc, *dec;
+	snd_seq_event_t *evs;
+	unsigned char *stream, out[16];
+	unsigned long long start;
+	size_t size, left;
+	unsigned int count = 0, i;
+	const unsigned char *p;
+	long n;
+	int err;
+
+	stream = malloc(total_events * 3);
+	evs = malloc(sizeof(*evs) * total_events);
+	if (!stream || !evs) {
+		report_error("midi_event", -ENOMEM);
+		goto _free;
+	}
+	size = make_stream(stream, total_events);
+	err = snd_midi_event_new(256, &enc);
+	if (err < 0) {
+		report_error("midi_event", err);
+		goto _free;
+	}
+	err = snd_midi_event_new(256, &dec);
+	if (err < 0) {
+		report_error("midi_event", err);
+		snd_midi_event_free(enc);
+		goto _free;
+	}
+
+	start = now_ns();
+	for (p = stream, left = size; left > 0; p += n, left -= n) {
+		snd_seq_ev_clear(&evs[count]);
+		n = snd_midi_event_encode(enc, p, left, &evs[count]);
+		if (n <= 0)
+			break;
+		if (evs[count].type != SND_SEQ_EVENT_NONE)
+			count++;
+	}
+	report_rate("midi_event_encode", count, now_ns() - start);
+
+	start = now_ns();
+	for (i = 0; i < count; i++)
+		snd_midi_event_decode(dec, out, sizeof(out), &evs[i]);
+	report_rate("midi_event_decode", count, now_ns() - start);
+
+	snd_midi_event_free(dec);
+	snd_midi_event_free(enc);
+ _free:
+	free(evs);
+	free(stream);
+}
+
+static void help(void)
+{
+	printf(
+"Usage: seq-bench [OPTION]...\n"
+"-h,--help	help\n"
+"-e,--events	events per flood and coder run (default %u)\n"
+"-p,--ping	events per ping run (default %u)\n"
+"\n", total_events, ping_events);
+}
+
+int main(int argc, char *argv[])
+{
+	struct option long_option[] =
+	{
+		{"help", 0, NULL, 'h'},
+		{"events", 1, NULL, 'e'},
+		{"ping", 1, NULL, 'p'},
+		{NULL, 0, NULL, 0},
+	};
+	unsigned long long *lat;
+
+	while (1) {
+		int opt;
+		if ((opt = getopt_long(argc, argv, "he:p:", long_option, NULL)) < 0)
+			break;
+		switch (opt) {
+		case 'h':
+			help();
+			return 0;
+		case 'e':
+			total_events = strtoul(optarg, NULL, 0);
+			if (total_events < BATCH)
+				total_events = BATCH;
+			break;
+		case 'p':
+			ping_events = strtoul(optarg, NULL, 0);
+			if (ping_events < 1)
+				ping_events = 1;
+			break;
+		default:
+			help();
+			return 1;
+		}
+	}
+
+	lat = malloc(sizeof(*lat) * ping_events);
+	if (!lat)
+		return 1;
+	printf("op,events,ns,events_per_sec,p50_ns,p90_ns,p99_ns,max_ns\n");
+	bench_seq(lat);
+	bench_rawmidi(lat);
+	bench_midi_event();
+	free(lat);
+	return 0;
+}